@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppAsync_p.h"
+
+#include <utility>
+
+using namespace QXmpp::Private;
+
+namespace {
+
+// detaches the receiver when the thread exits
+struct ThreadReceiverHolder
+{
+    ~ThreadReceiverHolder()
+    {
+        receiver->detach();
+    }
+
+    std::shared_ptr<ThreadReceiver> receiver = std::make_shared<ThreadReceiver>();
+};
+
+}  // namespace
+
+ThreadReceiver::ThreadReceiver()
+    : m_object(new QObject)
+{
+}
+
+// Returns the receiver of the calling thread.
+std::shared_ptr<ThreadReceiver> ThreadReceiver::current()
+{
+    thread_local ThreadReceiverHolder holder;
+    return holder.receiver;
+}
+
+// Destroys the functions that have not been delivered yet. Called in the
+// thread of the receiver when it exits.
+void ThreadReceiver::detach()
+{
+    QObject *object;
+    {
+        QMutexLocker locker(&m_mutex);
+        object = std::exchange(m_object, nullptr);
+    }
+    // the destroyed functions may post again, so this is done unlocked
+    delete object;
+}
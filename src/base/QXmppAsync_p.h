@@ -0,0 +1,98 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPASYNC_P_H
+#define QXMPPASYNC_P_H
+
+#include "QXmppPromise.h"
+
+#include <memory>
+#include <type_traits>
+
+#include <QMutex>
+#include <QObject>
+#include <QThreadPool>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API.  This header file may change from
+// version to version without notice, or even be removed.
+//
+// We mean it.
+//
+
+namespace QXmpp::Private {
+
+//
+// Delivers functions from any thread to the event loop of the thread it
+// belongs to.
+//
+// There is one receiver per thread, shared by all users. When the thread
+// exits, functions that have not been delivered yet are destroyed in that
+// thread and post() refuses new ones.
+//
+class QXMPP_EXPORT ThreadReceiver
+{
+public:
+    ThreadReceiver();
+
+    static std::shared_ptr<ThreadReceiver> current();
+
+    // Queues the function in the thread of the receiver. Returns false if
+    // the thread has already exited and the function has been dropped.
+    template<typename Function>
+    bool post(Function &&function)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_object) {
+            return false;
+        }
+        QMetaObject::invokeMethod(m_object, std::forward<Function>(function), Qt::QueuedConnection);
+        return true;
+    }
+
+    void detach();
+
+private:
+    QMutex m_mutex;
+    QObject *m_object;
+};
+
+//
+// Runs the function in the thread pool and returns a task that is finished
+// with its result in the calling thread.
+//
+// The promise is only moved around by the worker, never copied or destroyed
+// there, so the non-thread-safe state of the task is only touched by the
+// calling thread. No QObject, QFutureWatcher or QFutureInterface is needed
+// per call.
+//
+template<typename Function>
+auto runAsync(QThreadPool *pool, Function function) -> QXmppTask<std::invoke_result_t<Function>>
+{
+    using Result = std::invoke_result_t<Function>;
+
+    QXmppPromise<Result> promise;
+    auto task = promise.task();
+
+    pool->start([receiver = ThreadReceiver::current(), promise = std::move(promise), function = std::move(function)]() mutable {
+        if constexpr (std::is_void_v<Result>) {
+            function();
+            receiver->post([promise = std::move(promise)]() mutable {
+                promise.finish();
+            });
+        } else {
+            receiver->post([promise = std::move(promise), result = function()]() mutable {
+                promise.finish(std::move(result));
+            });
+        }
+    });
+    return task;
+}
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPASYNC_P_H
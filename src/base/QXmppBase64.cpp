@@ -0,0 +1,153 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppBase64_p.h"
+
+#include "QXmppAsync_p.h"
+#include "QXmppFutureUtils_p.h"
+
+#include <array>
+
+#include <QThreadPool>
+
+using namespace QXmpp::Private;
+
+// values of the base64 characters, -1 for all others
+static constexpr auto base64Values = []() {
+    std::array<int8_t, 128> values {};
+    for (auto &value : values) {
+        value = -1;
+    }
+    constexpr char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (int8_t i = 0; i < 64; i++) {
+        values[size_t(alphabet[i])] = i;
+    }
+    return values;
+}();
+
+static inline int base64Value(char16_t character)
+{
+    return character < 128 ? base64Values[character] : -1;
+}
+
+//
+// Decodes base64 directly from UTF-16 text.
+//
+// Blocks of four valid characters are decoded at once. Whitespace (e.g. line
+// breaks in vCards) and other invalid characters are skipped and decoding
+// stops at the padding, like QByteArray::fromBase64() does by default, but
+// without converting the text to Latin-1 first.
+//
+QByteArray QXmpp::Private::decodeBase64(QStringView text)
+{
+    QByteArray result(int(text.size() / 4 * 3 + 2), Qt::Uninitialized);
+    auto *begin = reinterpret_cast<uint8_t *>(result.data());
+    auto *out = begin;
+
+    const auto *in = text.utf16();
+    const auto size = text.size();
+    qsizetype i = 0;
+
+    uint32_t bits = 0;
+    int count = 0;
+    while (i < size) {
+        if (count == 0 && size - i >= 4) {
+            const int a = base64Value(in[i]);
+            const int b = base64Value(in[i + 1]);
+            const int c = base64Value(in[i + 2]);
+            const int d = base64Value(in[i + 3]);
+            // all values are valid if no sign bit is set
+            if ((a | b | c | d) >= 0) {
+                const uint32_t block = (uint32_t(a) << 18) | (uint32_t(b) << 12) | (uint32_t(c) << 6) | uint32_t(d);
+                out[0] = uint8_t(block >> 16);
+                out[1] = uint8_t(block >> 8);
+                out[2] = uint8_t(block);
+                out += 3;
+                i += 4;
+                continue;
+            }
+        }
+
+        const char16_t character = in[i++];
+        if (character == u'=') {
+            break;
+        }
+        const int value = base64Value(character);
+        if (value < 0) {
+            continue;
+        }
+        bits = (bits << 6) | uint32_t(value);
+        if (++count == 4) {
+            out[0] = uint8_t(bits >> 16);
+            out[1] = uint8_t(bits >> 8);
+            out[2] = uint8_t(bits);
+            out += 3;
+            bits = 0;
+            count = 0;
+        }
+    }
+
+    // incomplete last block
+    if (count == 2) {
+        *out++ = uint8_t(bits >> 4);
+    } else if (count == 3) {
+        *out++ = uint8_t(bits >> 10);
+        *out++ = uint8_t(bits >> 2);
+    }
+
+    result.truncate(int(out - begin));
+    return result;
+}
+
+Base64Data::Base64Data(const QByteArray &data)
+    : m_data(data)
+{
+}
+
+Base64Data Base64Data::fromBase64(const QString &text)
+{
+    Base64Data data;
+    if (!text.isEmpty()) {
+        data.m_encoded = std::make_shared<Encoded>();
+        data.m_encoded->text = text;
+    }
+    return data;
+}
+
+bool Base64Data::isEmpty() const
+{
+    return m_encoded ? m_encoded->text.isEmpty() : m_data.isEmpty();
+}
+
+QByteArray Base64Data::data() const
+{
+    if (!m_encoded) {
+        return m_data;
+    }
+    std::call_once(m_encoded->once, [encoded = m_encoded.get()]() {
+        encoded->data = decodeBase64(encoded->text);
+        encoded->isDecoded = true;
+    });
+    return m_encoded->data;
+}
+
+QString Base64Data::toBase64() const
+{
+    if (m_encoded) {
+        return m_encoded->text;
+    }
+    return QString::fromLatin1(m_data.toBase64());
+}
+
+// Decodes the data in the global thread pool, the task is finished in the
+// calling thread.
+QXmppTask<QByteArray> Base64Data::decodeAsync() const
+{
+    if (!m_encoded || m_encoded->isDecoded) {
+        return makeReadyTask(data());
+    }
+    return runAsync(QThreadPool::globalInstance(), [data = *this]() {
+        return data.data();
+    });
+}
@@ -0,0 +1,68 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPBASE64_P_H
+#define QXMPPBASE64_P_H
+
+#include "QXmppTask.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include <QByteArray>
+#include <QString>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API.  This header file may change from
+// version to version without notice, or even be removed.
+//
+// We mean it.
+//
+
+namespace QXmpp::Private {
+
+QXMPP_EXPORT QByteArray decodeBase64(QStringView text);
+
+//
+// Binary data that is decoded from base64 when it is first needed.
+//
+// Parsing only keeps the text, so the time to parse a stanza does not depend
+// on the size of its media. Serializing data that has not been decoded writes
+// the original text again.
+//
+// Copies share the decoded data, decoding is thread-safe.
+//
+class QXMPP_EXPORT Base64Data
+{
+public:
+    Base64Data() = default;
+    Base64Data(const QByteArray &data);
+
+    static Base64Data fromBase64(const QString &text);
+
+    bool isEmpty() const;
+    QByteArray data() const;
+    QString toBase64() const;
+    QXmppTask<QByteArray> decodeAsync() const;
+
+private:
+    struct Encoded
+    {
+        QString text;
+        std::once_flag once;
+        std::atomic<bool> isDecoded = false;
+        QByteArray data;
+    };
+
+    QByteArray m_data;
+    std::shared_ptr<Encoded> m_encoded;
+};
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPBASE64_P_H
@@ -2,10 +2,12 @@
 //
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#include "QXmppBase64_p.h"
 #include "QXmppBitsOfBinaryContentId.h"
 #include "QXmppBitsOfBinaryDataList.h"
 #include "QXmppConstants_p.h"
 #include "QXmppUtils.h"
+#include "QXmppUtils_p.h"
 
 #include <QDomElement>
 #include <QMimeDatabase>
@@ -13,6 +15,8 @@
 #include <QSharedData>
 #include <QXmlStreamWriter>
 
+using namespace QXmpp::Private;
+
 class QXmppBitsOfBinaryDataPrivate : public QSharedData
 {
 public:
@@ -21,7 +25,7 @@ public:
     QXmppBitsOfBinaryContentId cid;
     int maxAge;
     QMimeType contentType;
-    QByteArray data;
+    QXmpp::Private::Base64Data data;
 };
 
 QXmppBitsOfBinaryDataPrivate::QXmppBitsOfBinaryDataPrivate()
@@ -58,7 +62,7 @@ QXmppBitsOfBinaryData QXmppBitsOfBinaryData::fromByteArray(QByteArray data)
 
     QXmppBitsOfBinaryData bobData;
     bobData.d->cid = std::move(cid);
-    bobData.d->data = std::move(data);
+    bobData.d->data = QXmpp::Private::Base64Data(data);
 
     return bobData;
 }
@@ -146,9 +150,25 @@ void QXmppBitsOfBinaryData::setContentType(const QMimeType &contentType)
 ///
 /// Returns the included data in binary form
 ///
+/// Received data is only decoded from base64 when it is accessed for the first
+/// time. Use dataAsync() to decode large data without blocking.
+///
 QByteArray QXmppBitsOfBinaryData::data() const
 {
-    return d->data;
+    return d->data.data();
+}
+
+///
+/// Returns the included data in binary form, decoded in a thread pool if it
+/// has not been decoded yet.
+///
+/// The task is finished in the calling thread.
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QByteArray> QXmppBitsOfBinaryData::dataAsync() const
+{
+    return d->data.decodeAsync();
 }
 
 ///
@@ -164,7 +184,7 @@ void QXmppBitsOfBinaryData::setData(const QByteArray &data)
 ///
 bool QXmppBitsOfBinaryData::isBitsOfBinaryData(const QDomElement &element)
 {
-    return element.tagName() == QStringLiteral("data") && element.namespaceURI() == ns_bob;
+    return isElement(element, u"data", ns_bob);
 }
 
 /// \cond
@@ -173,7 +193,7 @@ void QXmppBitsOfBinaryData::parseElementFromChild(const QDomElement &dataElement
     d->cid = QXmppBitsOfBinaryContentId::fromContentId(dataElement.attribute(QStringLiteral("cid")));
     d->maxAge = dataElement.attribute(QStringLiteral("max-age"), QStringLiteral("-1")).toInt();
     d->contentType = QMimeDatabase().mimeTypeForName(dataElement.attribute(QStringLiteral("type")));
-    d->data = QByteArray::fromBase64(dataElement.text().toUtf8());
+    d->data = QXmpp::Private::Base64Data::fromBase64(dataElement.text());
 }
 
 void QXmppBitsOfBinaryData::toXmlElementFromChild(QXmlStreamWriter *writer) const
@@ -198,7 +218,7 @@ bool QXmppBitsOfBinaryData::operator==(const QXmppBitsOfBinaryData &other) const
     return d->cid == other.cid() &&
         d->maxAge == other.maxAge() &&
         d->contentType == other.contentType() &&
-        d->data == other.data();
+        d->data.data() == other.data();
 }
 
 ///
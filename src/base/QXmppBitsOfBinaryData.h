@@ -6,6 +6,7 @@
 #define QXMPPBITSOFBINARYDATA_H
 
 #include "QXmppGlobal.h"
+#include "QXmppTask.h"
 
 #include <QSharedDataPointer>
 
@@ -38,6 +39,7 @@ public:
     void setContentType(const QMimeType &contentType);
 
     QByteArray data() const;
+    QXmppTask<QByteArray> dataAsync() const;
     void setData(const QByteArray &data);
 
     bool static isBitsOfBinaryData(const QDomElement &element);
@@ -0,0 +1,525 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppBlake3_p.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include <QSemaphore>
+#include <QThreadPool>
+
+using ChainingValue = QXmpp::Private::Blake3Hasher::ChainingValue;
+
+constexpr std::size_t BLOCK_LENGTH = 64;
+constexpr std::size_t CHUNK_LENGTH = 1024;
+constexpr std::size_t BLOCKS_PER_CHUNK = CHUNK_LENGTH / BLOCK_LENGTH;
+
+// number of chunks that are compressed at once, 8 lanes of 32 bits fit into
+// one AVX2 register or two SSE2/NEON registers
+constexpr std::size_t LANES = 8;
+// subtrees with at least this number of chunks are split over multiple threads
+constexpr std::size_t PARALLEL_MIN_CHUNKS = 128;
+// minimum number of chunks hashed by one thread
+constexpr std::size_t PIECE_MIN_CHUNKS = 32;
+
+// domain separation flags
+constexpr uint32_t ChunkStart = 1 << 0;
+constexpr uint32_t ChunkEnd = 1 << 1;
+constexpr uint32_t Parent = 1 << 2;
+constexpr uint32_t Root = 1 << 3;
+
+constexpr ChainingValue IV = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+// order of the message words in each of the seven rounds
+constexpr uint8_t MESSAGE_SCHEDULE[7][16] = {
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+    { 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 },
+    { 3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1 },
+    { 10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6 },
+    { 12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4 },
+    { 9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7 },
+    { 11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13 },
+};
+
+static inline uint32_t load32(const uint8_t *data)
+{
+    return uint32_t(data[0]) | uint32_t(data[1]) << 8 | uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24;
+}
+
+static inline uint32_t rotateRight(uint32_t value, int bits)
+{
+    return (value >> bits) | (value << (32 - bits));
+}
+
+static inline void g(uint32_t *v, int a, int b, int c, int d, uint32_t x, uint32_t y)
+{
+    v[a] = v[a] + v[b] + x;
+    v[d] = rotateRight(v[d] ^ v[a], 16);
+    v[c] = v[c] + v[d];
+    v[b] = rotateRight(v[b] ^ v[c], 12);
+    v[a] = v[a] + v[b] + y;
+    v[d] = rotateRight(v[d] ^ v[a], 8);
+    v[c] = v[c] + v[d];
+    v[b] = rotateRight(v[b] ^ v[c], 7);
+}
+
+// Compresses one block, the output is used for the chaining value (first 8
+// words) or as root output.
+static void compress(const ChainingValue &cv, const uint8_t *block, uint64_t counter, uint32_t blockLength, uint32_t flags, uint32_t *out)
+{
+    uint32_t m[16];
+    for (int i = 0; i < 16; i++) {
+        m[i] = load32(block + 4 * i);
+    }
+
+    uint32_t v[16] = {
+        cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+        IV[0], IV[1], IV[2], IV[3],
+        uint32_t(counter), uint32_t(counter >> 32), blockLength, flags
+    };
+    for (const auto &s : MESSAGE_SCHEDULE) {
+        g(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+        g(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+        g(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+        g(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+        g(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+        g(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+        g(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+        g(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+    }
+    for (int i = 0; i < 8; i++) {
+        out[i] = v[i] ^ v[i + 8];
+        out[i + 8] = v[i + 8] ^ cv[i];
+    }
+}
+
+static ChainingValue compressToCv(const ChainingValue &cv, const uint8_t *block, uint64_t counter, uint32_t blockLength, uint32_t flags)
+{
+    uint32_t out[16];
+    compress(cv, block, counter, blockLength, flags, out);
+    ChainingValue result;
+    std::copy(out, out + 8, result.begin());
+    return result;
+}
+
+static ChainingValue parentCv(const ChainingValue &left, const ChainingValue &right)
+{
+    uint8_t block[BLOCK_LENGTH];
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 4; j++) {
+            block[4 * i + j] = uint8_t(left[i] >> (8 * j));
+            block[32 + 4 * i + j] = uint8_t(right[i] >> (8 * j));
+        }
+    }
+    return compressToCv(IV, block, 0, BLOCK_LENGTH, Parent);
+}
+
+#if defined(__GNUC__)
+// GCC and Clang generate SIMD instructions for operations on vector types
+typedef uint32_t Vector __attribute__((vector_size(4 * LANES)));
+#else
+struct Vector
+{
+    uint32_t lanes[LANES];
+
+    uint32_t &operator[](std::size_t i) { return lanes[i]; }
+    uint32_t operator[](std::size_t i) const { return lanes[i]; }
+    Vector operator+(const Vector &other) const
+    {
+        Vector result;
+        for (std::size_t i = 0; i < LANES; i++) {
+            result[i] = lanes[i] + other[i];
+        }
+        return result;
+    }
+    Vector operator^(const Vector &other) const
+    {
+        Vector result;
+        for (std::size_t i = 0; i < LANES; i++) {
+            result[i] = lanes[i] ^ other[i];
+        }
+        return result;
+    }
+    Vector operator|(const Vector &other) const
+    {
+        Vector result;
+        for (std::size_t i = 0; i < LANES; i++) {
+            result[i] = lanes[i] | other[i];
+        }
+        return result;
+    }
+    Vector operator>>(int bits) const
+    {
+        Vector result;
+        for (std::size_t i = 0; i < LANES; i++) {
+            result[i] = lanes[i] >> bits;
+        }
+        return result;
+    }
+    Vector operator<<(int bits) const
+    {
+        Vector result;
+        for (std::size_t i = 0; i < LANES; i++) {
+            result[i] = lanes[i] << bits;
+        }
+        return result;
+    }
+};
+#endif
+
+// x86 CPUs without AVX2 get a version with SSE2
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__GLIBC__) && (!defined(__clang__) || __clang_major__ >= 14)
+#define TARGET_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define TARGET_CLONES
+#endif
+
+static inline void setLanes(Vector &vector, uint32_t value)
+{
+    for (std::size_t i = 0; i < LANES; i++) {
+        vector[i] = value;
+    }
+}
+
+static inline void gLanes(Vector *v, int a, int b, int c, int d, const Vector &x, const Vector &y)
+{
+    v[a] = v[a] + v[b] + x;
+    v[d] = v[d] ^ v[a];
+    v[d] = (v[d] >> 16) | (v[d] << 16);
+    v[c] = v[c] + v[d];
+    v[b] = v[b] ^ v[c];
+    v[b] = (v[b] >> 12) | (v[b] << 20);
+    v[a] = v[a] + v[b] + y;
+    v[d] = v[d] ^ v[a];
+    v[d] = (v[d] >> 8) | (v[d] << 24);
+    v[c] = v[c] + v[d];
+    v[b] = v[b] ^ v[c];
+    v[b] = (v[b] >> 7) | (v[b] << 25);
+}
+
+// Compresses LANES complete chunks at once, each one in a lane.
+TARGET_CLONES static void hashChunksLanes(const uint8_t *input, uint64_t counter, ChainingValue *out)
+{
+    Vector cv[8];
+    for (int i = 0; i < 8; i++) {
+        setLanes(cv[i], IV[i]);
+    }
+    Vector counterLow, counterHigh;
+    for (std::size_t lane = 0; lane < LANES; lane++) {
+        counterLow[lane] = uint32_t(counter + lane);
+        counterHigh[lane] = uint32_t((counter + lane) >> 32);
+    }
+
+    for (std::size_t block = 0; block < BLOCKS_PER_CHUNK; block++) {
+        // transpose the message words, so each word of all chunks is in one vector
+        Vector m[16];
+        for (std::size_t lane = 0; lane < LANES; lane++) {
+            const auto *data = input + lane * CHUNK_LENGTH + block * BLOCK_LENGTH;
+            for (int i = 0; i < 16; i++) {
+                m[i][lane] = load32(data + 4 * i);
+            }
+        }
+
+        Vector v[16];
+        for (int i = 0; i < 8; i++) {
+            v[i] = cv[i];
+        }
+        for (int i = 0; i < 4; i++) {
+            setLanes(v[8 + i], IV[i]);
+        }
+        v[12] = counterLow;
+        v[13] = counterHigh;
+        setLanes(v[14], BLOCK_LENGTH);
+        setLanes(v[15], (block == 0 ? ChunkStart : 0U) | (block == BLOCKS_PER_CHUNK - 1 ? ChunkEnd : 0U));
+
+        for (const auto &s : MESSAGE_SCHEDULE) {
+            gLanes(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+            gLanes(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+            gLanes(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+            gLanes(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+            gLanes(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+            gLanes(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+            gLanes(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+            gLanes(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+        }
+
+        for (int i = 0; i < 8; i++) {
+            cv[i] = v[i] ^ v[i + 8];
+        }
+    }
+
+    for (std::size_t lane = 0; lane < LANES; lane++) {
+        for (int i = 0; i < 8; i++) {
+            out[lane][i] = cv[i][lane];
+        }
+    }
+}
+
+// Hashes a complete chunk that is not the root.
+static ChainingValue hashChunk(const uint8_t *input, uint64_t counter)
+{
+    auto cv = IV;
+    for (std::size_t block = 0; block < BLOCKS_PER_CHUNK; block++) {
+        const uint32_t flags = (block == 0 ? ChunkStart : 0U) | (block == BLOCKS_PER_CHUNK - 1 ? ChunkEnd : 0U);
+        cv = compressToCv(cv, input + block * BLOCK_LENGTH, counter, BLOCK_LENGTH, flags);
+    }
+    return cv;
+}
+
+// Merges the chaining values of adjacent subtrees in pairs until only count are left.
+static void reduceChainingValues(std::vector<ChainingValue> &cvs, std::size_t count)
+{
+    while (cvs.size() > count) {
+        for (std::size_t i = 0; i < cvs.size() / 2; i++) {
+            cvs[i] = parentCv(cvs[2 * i], cvs[2 * i + 1]);
+        }
+        cvs.resize(cvs.size() / 2);
+    }
+}
+
+// Returns the chaining values of all chunks of complete chunks.
+static std::vector<ChainingValue> hashChunks(const uint8_t *input, std::size_t chunks, uint64_t counter)
+{
+    std::vector<ChainingValue> cvs(chunks);
+    std::size_t i = 0;
+    for (; i + LANES <= chunks; i += LANES) {
+        hashChunksLanes(input + i * CHUNK_LENGTH, counter + i, cvs.data() + i);
+    }
+    for (; i < chunks; i++) {
+        cvs[i] = hashChunk(input + i * CHUNK_LENGTH, counter + i);
+    }
+    return cvs;
+}
+
+// Runs function(i) for all i < count on the calling thread and idle threads of
+// the global thread pool.
+template<typename Function>
+static void parallelFor(std::size_t count, Function function)
+{
+    std::atomic<std::size_t> next { 0 };
+    const auto work = [&]() {
+        for (auto i = next++; i < count; i = next++) {
+            function(i);
+        }
+    };
+
+    // Only idle threads are used and the calling thread works as well, so this
+    // can't deadlock if it is called from the thread pool.
+    auto *pool = QThreadPool::globalInstance();
+    QSemaphore finished;
+    int helpers = 0;
+    while (std::size_t(helpers + 1) < std::min<std::size_t>(count, pool->maxThreadCount()) &&
+           pool->tryStart([&]() { work(); finished.release(); })) {
+        helpers++;
+    }
+    work();
+    finished.acquire(helpers);
+}
+
+// Hashes a complete subtree with a power of two number of chunks (at least
+// two) and returns the chaining values of its two halves. They are not merged
+// because the parent could be the root.
+static std::array<ChainingValue, 2> hashSubtree(const uint8_t *input, std::size_t chunks, uint64_t counter)
+{
+    std::vector<ChainingValue> cvs;
+    if (chunks < PARALLEL_MIN_CHUNKS) {
+        cvs = hashChunks(input, chunks, counter);
+    } else {
+        const std::size_t threads = std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+        std::size_t pieces = 2;
+        while (pieces < 2 * threads && chunks / pieces >= 2 * PIECE_MIN_CHUNKS) {
+            pieces *= 2;
+        }
+        const auto pieceChunks = chunks / pieces;
+
+        cvs.resize(pieces);
+        parallelFor(pieces, [&](std::size_t piece) {
+            auto pieceCvs = hashChunks(input + piece * pieceChunks * CHUNK_LENGTH, pieceChunks, counter + piece * pieceChunks);
+            reduceChainingValues(pieceCvs, 1);
+            cvs[piece] = pieceCvs.front();
+        });
+    }
+
+    reduceChainingValues(cvs, 2);
+    return { cvs[0], cvs[1] };
+}
+
+namespace QXmpp::Private {
+
+Blake3Hasher::Blake3Hasher()
+    : m_chunkCv(IV),
+      m_block({})
+{
+}
+
+void Blake3Hasher::addData(const char *data, std::size_t size)
+{
+    auto *input = reinterpret_cast<const uint8_t *>(data);
+
+    // complete the current chunk
+    if (chunkLength() > 0) {
+        const auto length = std::min(CHUNK_LENGTH - chunkLength(), size);
+        addChunkData(input, length);
+        input += length;
+        size -= length;
+        if (size == 0) {
+            return;
+        }
+
+        // more data follows, so this chunk is not the root
+        const auto cv = compressToCv(m_chunkCv, m_block.data(), m_chunkCounter, m_blockLength, (m_blocksCompressed == 0 ? ChunkStart : 0U) | ChunkEnd);
+        pushChainingValue(cv, m_chunkCounter);
+        resetChunk(m_chunkCounter + 1);
+    }
+
+    // hash whole subtrees directly from the input
+    while (size > CHUNK_LENGTH) {
+        // largest power of two of chunks that fits and is aligned in the tree
+        std::size_t chunks = 1;
+        while (chunks * 2 * CHUNK_LENGTH <= size && (m_chunkCounter & (chunks * 2 - 1)) == 0) {
+            chunks *= 2;
+        }
+
+        if (chunks == 1) {
+            pushChainingValue(hashChunk(input, m_chunkCounter), m_chunkCounter);
+        } else {
+            const auto cvs = hashSubtree(input, chunks, m_chunkCounter);
+            pushChainingValue(cvs[0], m_chunkCounter);
+            pushChainingValue(cvs[1], m_chunkCounter + chunks / 2);
+        }
+        resetChunk(m_chunkCounter + chunks);
+        input += chunks * CHUNK_LENGTH;
+        size -= chunks * CHUNK_LENGTH;
+    }
+
+    // the last chunk, it could be the root
+    if (size > 0) {
+        addChunkData(input, size);
+        mergeChainingValues(m_chunkCounter);
+    }
+}
+
+QByteArray Blake3Hasher::result() const
+{
+    // output of the last node: the current chunk, or the parent of the last
+    // two subtrees if the input ended at a subtree boundary
+    ChainingValue cv;
+    std::array<uint8_t, BLOCK_LENGTH> block;
+    uint32_t blockLength;
+    uint64_t counter;
+    uint32_t flags;
+    auto remaining = m_cvStack.size();
+
+    const auto setParent = [&](const ChainingValue &left, const ChainingValue &right) {
+        for (int i = 0; i < 8; i++) {
+            for (int j = 0; j < 4; j++) {
+                block[4 * i + j] = uint8_t(left[i] >> (8 * j));
+                block[32 + 4 * i + j] = uint8_t(right[i] >> (8 * j));
+            }
+        }
+        cv = IV;
+        blockLength = BLOCK_LENGTH;
+        counter = 0;
+        flags = Parent;
+    };
+
+    if (chunkLength() > 0 || m_cvStack.empty()) {
+        cv = m_chunkCv;
+        block = m_block;
+        blockLength = m_blockLength;
+        counter = m_chunkCounter;
+        flags = (m_blocksCompressed == 0 ? ChunkStart : 0U) | ChunkEnd;
+    } else {
+        remaining -= 2;
+        setParent(m_cvStack[remaining], m_cvStack[remaining + 1]);
+    }
+
+    while (remaining > 0) {
+        remaining--;
+        setParent(m_cvStack[remaining], compressToCv(cv, block.data(), counter, blockLength, flags));
+    }
+
+    uint32_t out[16];
+    compress(cv, block.data(), counter, blockLength, flags | Root, out);
+
+    QByteArray hash(32, Qt::Uninitialized);
+    for (int i = 0; i < 8; i++) {
+        for (int j = 0; j < 4; j++) {
+            hash[4 * i + j] = char(out[i] >> (8 * j));
+        }
+    }
+    return hash;
+}
+
+QByteArray Blake3Hasher::hash(const QByteArray &data)
+{
+    Blake3Hasher hasher;
+    hasher.addData(data.constData(), std::size_t(data.size()));
+    return hasher.result();
+}
+
+// Adds data to the current chunk, which must fit.
+void Blake3Hasher::addChunkData(const uint8_t *data, std::size_t size)
+{
+    while (size > 0) {
+        // a full block is only compressed when more data follows, the last
+        // block gets the ChunkEnd flag
+        if (m_blockLength == BLOCK_LENGTH) {
+            m_chunkCv = compressToCv(m_chunkCv, m_block.data(), m_chunkCounter, BLOCK_LENGTH, m_blocksCompressed == 0 ? ChunkStart : 0U);
+            m_blocksCompressed++;
+            m_blockLength = 0;
+            m_block.fill(0);
+        }
+
+        const auto length = std::min(BLOCK_LENGTH - m_blockLength, size);
+        std::memcpy(m_block.data() + m_blockLength, data, length);
+        m_blockLength += uint8_t(length);
+        data += length;
+        size -= length;
+    }
+}
+
+std::size_t Blake3Hasher::chunkLength() const
+{
+    return BLOCK_LENGTH * m_blocksCompressed + m_blockLength;
+}
+
+void Blake3Hasher::resetChunk(uint64_t counter)
+{
+    m_chunkCv = IV;
+    m_block.fill(0);
+    m_blockLength = 0;
+    m_blocksCompressed = 0;
+    m_chunkCounter = counter;
+}
+
+// Pushes the chaining value of a subtree starting at chunkCounter. The
+// previous subtrees are merged first, the new one is only merged when more
+// data follows, because it could be a child of the root.
+void Blake3Hasher::pushChainingValue(const ChainingValue &cv, uint64_t chunkCounter)
+{
+    mergeChainingValues(chunkCounter);
+    m_cvStack.push_back(cv);
+}
+
+// Merges the completed subtrees, so there is one for each bit set in the
+// number of chunks before.
+void Blake3Hasher::mergeChainingValues(uint64_t chunkCounter)
+{
+    std::size_t subtrees = 0;
+    for (auto count = chunkCounter; count != 0; count &= count - 1) {
+        subtrees++;
+    }
+    while (m_cvStack.size() > subtrees) {
+        const auto right = m_cvStack.back();
+        m_cvStack.pop_back();
+        m_cvStack.back() = parentCv(m_cvStack.back(), right);
+    }
+}
+
+}  // namespace QXmpp::Private
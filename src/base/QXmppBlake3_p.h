@@ -0,0 +1,73 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPBLAKE3_P_H
+#define QXMPPBLAKE3_P_H
+
+#include "QXmppGlobal.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <QByteArray>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API. It exists for the convenience
+// of QXmppHashing.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+namespace QXmpp::Private {
+
+//
+// Incremental BLAKE3 hash with 256 bits of output.
+//
+// BLAKE3 splits the input into chunks of 1 kB, which are the leaves of a
+// binary tree. Large inputs are split into subtrees whose chunks are
+// compressed in parallel: several chunks at once in the lanes of vector
+// registers and several parts of the subtree on the threads of the global
+// QThreadPool. Passing large blocks of memory, e.g. a mapped file, to
+// addData() therefore uses all cores.
+//
+class QXMPP_EXPORT Blake3Hasher
+{
+public:
+    using ChainingValue = std::array<uint32_t, 8>;
+
+    Blake3Hasher();
+
+    void addData(const char *data, std::size_t size);
+    QByteArray result() const;
+
+    static QByteArray hash(const QByteArray &data);
+
+private:
+    void addChunkData(const uint8_t *data, std::size_t size);
+    std::size_t chunkLength() const;
+    void resetChunk(uint64_t counter);
+    void pushChainingValue(const ChainingValue &cv, uint64_t chunkCounter);
+    void mergeChainingValues(uint64_t chunkCounter);
+
+    // state of the current chunk
+    ChainingValue m_chunkCv;
+    std::array<uint8_t, 64> m_block;
+    uint8_t m_blockLength = 0;
+    uint8_t m_blocksCompressed = 0;
+    uint64_t m_chunkCounter = 0;
+
+    // chaining values of the completed subtrees, largest first
+    std::vector<ChainingValue> m_cvStack;
+};
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPBLAKE3_P_H
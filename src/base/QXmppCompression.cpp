@@ -0,0 +1,123 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppCompression_p.h"
+
+#include <zlib.h>
+
+namespace QXmpp::Private {
+
+ZlibCompressor::ZlibCompressor()
+    : m_stream(std::make_unique<z_stream_s>())
+{
+    m_valid = deflateInit(m_stream.get(), Z_DEFAULT_COMPRESSION) == Z_OK;
+}
+
+ZlibCompressor::~ZlibCompressor()
+{
+    if (m_valid) {
+        deflateEnd(m_stream.get());
+    }
+}
+
+QByteArray ZlibCompressor::compress(const QByteArray &data)
+{
+    if (!m_valid || data.isEmpty()) {
+        return {};
+    }
+
+    m_stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.constData()));
+    m_stream->avail_in = uInt(data.size());
+
+    // XML usually shrinks a lot, the buffer is grown if it does not
+    QByteArray output(data.size() / 2 + 64, Qt::Uninitialized);
+    qsizetype written = 0;
+    do {
+        if (written == output.size()) {
+            output.resize(output.size() * 2);
+        }
+        m_stream->next_out = reinterpret_cast<Bytef *>(output.data() + written);
+        m_stream->avail_out = uInt(output.size() - written);
+
+        const auto result = deflate(m_stream.get(), Z_SYNC_FLUSH);
+        if (result != Z_OK && result != Z_BUF_ERROR) {
+            deflateEnd(m_stream.get());
+            m_valid = false;
+            return {};
+        }
+        written = output.size() - m_stream->avail_out;
+    } while (m_stream->avail_out == 0);
+
+    output.truncate(written);
+    return output;
+}
+
+ZlibDecompressor::ZlibDecompressor()
+    : m_stream(std::make_unique<z_stream_s>())
+{
+    m_valid = inflateInit(m_stream.get()) == Z_OK;
+}
+
+ZlibDecompressor::~ZlibDecompressor()
+{
+    if (m_valid) {
+        inflateEnd(m_stream.get());
+    }
+}
+
+void ZlibDecompressor::addData(const QByteArray &data)
+{
+    if (m_input.isEmpty()) {
+        m_input = data;
+    } else {
+        m_input.append(data);
+    }
+}
+
+//
+// Returns up to maxSize bytes of decompressed data, an empty array if all
+// input has been decompressed, or nullopt if the input is invalid.
+//
+std::optional<QByteArray> ZlibDecompressor::read(qsizetype maxSize)
+{
+    if (!m_valid) {
+        return std::nullopt;
+    }
+
+    QByteArray output(maxSize, Qt::Uninitialized);
+    m_stream->next_out = reinterpret_cast<Bytef *>(output.data());
+    m_stream->avail_out = uInt(maxSize);
+
+    // inflate() is also called without input, it may still hold output that
+    // did not fit into the buffer of the last call
+    while (m_stream->avail_out > 0) {
+        m_stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(m_input.constData() + m_inputPosition));
+        m_stream->avail_in = uInt(m_input.size() - m_inputPosition);
+
+        const auto result = inflate(m_stream.get(), Z_SYNC_FLUSH);
+        m_inputPosition = m_input.size() - m_stream->avail_in;
+        if (result == Z_BUF_ERROR || result == Z_STREAM_END) {
+            // no progress possible
+            break;
+        }
+        if (result != Z_OK) {
+            inflateEnd(m_stream.get());
+            m_valid = false;
+            return std::nullopt;
+        }
+        if (m_stream->avail_in == 0) {
+            break;
+        }
+    }
+
+    if (m_inputPosition == m_input.size()) {
+        m_input.clear();
+        m_inputPosition = 0;
+    }
+
+    output.truncate(maxSize - qsizetype(m_stream->avail_out));
+    return output;
+}
+
+}  // namespace QXmpp::Private
@@ -0,0 +1,80 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPCOMPRESSION_P_H
+#define QXMPPCOMPRESSION_P_H
+
+#include "QXmppGlobal.h"
+
+#include <memory>
+#include <optional>
+
+#include <QByteArray>
+
+struct z_stream_s;
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API. It exists for the convenience
+// of QXmppStream.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+namespace QXmpp::Private {
+
+//
+// Compresses the outgoing data of a stream for XEP-0138: Stream Compression
+// using zlib.
+//
+// The deflate context is kept for the whole stream, so later data is
+// compressed using the dictionary of the earlier data. Every call ends with a
+// sync flush, so the peer can decompress everything that has been written.
+//
+class QXMPP_EXPORT ZlibCompressor
+{
+public:
+    ZlibCompressor();
+    ~ZlibCompressor();
+
+    bool isValid() const { return m_valid; }
+    QByteArray compress(const QByteArray &data);
+
+private:
+    std::unique_ptr<z_stream_s> m_stream;
+    bool m_valid = false;
+};
+
+//
+// Decompresses the incoming data of a stream for XEP-0138: Stream
+// Compression using zlib.
+//
+// The output is read in chunks of limited size, so a small amount of
+// compressed data can not expand into a huge buffer at once.
+//
+class QXMPP_EXPORT ZlibDecompressor
+{
+public:
+    ZlibDecompressor();
+    ~ZlibDecompressor();
+
+    bool isValid() const { return m_valid; }
+    void addData(const QByteArray &data);
+    std::optional<QByteArray> read(qsizetype maxSize);
+
+private:
+    std::unique_ptr<z_stream_s> m_stream;
+    QByteArray m_input;
+    qsizetype m_inputPosition = 0;
+    bool m_valid = false;
+};
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPCOMPRESSION_P_H
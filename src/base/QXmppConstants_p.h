@@ -5,6 +5,10 @@
 #ifndef QXMPPCONSTANTS_H
 #define QXMPPCONSTANTS_H
 
+#include <cstddef>
+
+#include <QString>
+
 //
 //  W A R N I N G
 //  -------------
@@ -16,216 +20,251 @@
 // We mean it.
 //
 
-extern const char *ns_stream;
-extern const char *ns_client;
-extern const char *ns_server;
-extern const char *ns_roster;
-extern const char *ns_tls;
-extern const char *ns_sasl;
-extern const char *ns_bind;
-extern const char *ns_session;
-extern const char *ns_stanza;
-extern const char *ns_pre_approval;
-extern const char *ns_rosterver;
+namespace QXmpp::Private {
+
+// Creates the QLatin1String of a namespace at compile time. Its length is
+// taken from the array because QLatin1String(const char *) isn't constexpr
+// with Qt 5.
+template<std::size_t N>
+constexpr QLatin1String xmlnsLiteral(const char (&xmlns)[N])
+{
+    return QLatin1String(xmlns, int(N - 1));
+}
+
+}  // namespace QXmpp::Private
+
+// The namespaces are QLatin1Strings, so they can be compared with QStrings and
+// QStringViews without converting them first.
+inline constexpr auto ns_stream = QXmpp::Private::xmlnsLiteral("http://etherx.jabber.org/streams");
+inline constexpr auto ns_client = QXmpp::Private::xmlnsLiteral("jabber:client");
+inline constexpr auto ns_server = QXmpp::Private::xmlnsLiteral("jabber:server");
+inline constexpr auto ns_roster = QXmpp::Private::xmlnsLiteral("jabber:iq:roster");
+inline constexpr auto ns_tls = QXmpp::Private::xmlnsLiteral("urn:ietf:params:xml:ns:xmpp-tls");
+inline constexpr auto ns_sasl = QXmpp::Private::xmlnsLiteral("urn:ietf:params:xml:ns:xmpp-sasl");
+inline constexpr auto ns_bind = QXmpp::Private::xmlnsLiteral("urn:ietf:params:xml:ns:xmpp-bind");
+inline constexpr auto ns_session = QXmpp::Private::xmlnsLiteral("urn:ietf:params:xml:ns:xmpp-session");
+inline constexpr auto ns_stanza = QXmpp::Private::xmlnsLiteral("urn:ietf:params:xml:ns:xmpp-stanzas");
+inline constexpr auto ns_pre_approval = QXmpp::Private::xmlnsLiteral("urn:xmpp:features:pre-approval");
+inline constexpr auto ns_rosterver = QXmpp::Private::xmlnsLiteral("urn:xmpp:features:rosterver");
 // XEP-0009: Jabber-RPC
-extern const char *ns_rpc;
+inline constexpr auto ns_rpc = QXmpp::Private::xmlnsLiteral("jabber:iq:rpc");
 // XEP-0020: Feature Negotiation
-extern const char *ns_feature_negotiation;
+inline constexpr auto ns_feature_negotiation = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/feature-neg");
 // XEP-0027: Current Jabber OpenPGP Usage
-extern const char *ns_legacy_openpgp;
+inline constexpr auto ns_legacy_openpgp = QXmpp::Private::xmlnsLiteral("jabber:x:encrypted");
 // XEP-0030: Service Discovery
-extern const char *ns_disco_info;
-extern const char *ns_disco_items;
+inline constexpr auto ns_disco_info = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/disco#info");
+inline constexpr auto ns_disco_items = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/disco#items");
 // XEP-0033: Extended Stanza Addressing
-extern const char *ns_extended_addressing;
+inline constexpr auto ns_extended_addressing = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/address");
 // XEP-0045: Multi-User Chat
-extern const char *ns_muc;
-extern const char *ns_muc_admin;
-extern const char *ns_muc_owner;
-extern const char *ns_muc_user;
+inline constexpr auto ns_muc = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/muc");
+inline constexpr auto ns_muc_admin = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/muc#admin");
+inline constexpr auto ns_muc_owner = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/muc#owner");
+inline constexpr auto ns_muc_user = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/muc#user");
 // XEP-0047: In-Band Bytestreams
-extern const char *ns_ibb;
+inline constexpr auto ns_ibb = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/ibb");
 // XEP-0049: Private XML Storage
-extern const char *ns_private;
+inline constexpr auto ns_private = QXmpp::Private::xmlnsLiteral("jabber:iq:private");
 // XEP-0054: vcard-temp
-extern const char *ns_vcard;
+inline constexpr auto ns_vcard = QXmpp::Private::xmlnsLiteral("vcard-temp");
 // XEP-0059: Result Set Management
-extern const char *ns_rsm;
+inline constexpr auto ns_rsm = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/rsm");
 // XEP-0060: Publish-Subscribe
-extern const char *ns_pubsub;
-extern const char *ns_pubsub_auto_create;
-extern const char *ns_pubsub_config_node;
-extern const char *ns_pubsub_config_node_max;
-extern const char *ns_pubsub_create_and_configure;
-extern const char *ns_pubsub_create_nodes;
-extern const char *ns_pubsub_errors;
-extern const char *ns_pubsub_event;
-extern const char *ns_pubsub_multi_items;
-extern const char *ns_pubsub_node_config;
-extern const char *ns_pubsub_owner;
-extern const char *ns_pubsub_publish;
-extern const char *ns_pubsub_publish_options;
-extern const char *ns_pubsub_rsm;
+inline constexpr auto ns_pubsub = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/pubsub");
+inline constexpr auto ns_pubsub_auto_create = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/pubsub#auto-create");
+inline constexpr auto ns_pubsub_config_node = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/pubsub#config-node");
+inline constexpr auto ns_pubsub_config_node_max = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/pubsub#config-node-max");
+inline constexpr auto ns_pubsub_create_and_configure = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/pubsub#create-and-configure");
+inline constexpr auto ns_pubsub_create_nodes = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/pubsub#create-nodes");
+inline constexpr auto ns_pubsub_errors = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/pubsub#errors");
+inline constexpr auto ns_pubsub_event = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/pubsub#event");
+inline constexpr auto ns_pubsub_multi_items = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/pubsub#multi-items");
+inline constexpr auto ns_pubsub_node_config = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/pubsub#node_config");
+inline constexpr auto ns_pubsub_owner = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/pubsub#owner");
+inline constexpr auto ns_pubsub_publish = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/pubsub#publish");
+inline constexpr auto ns_pubsub_publish_options = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/pubsub#publish-options");
+inline constexpr auto ns_pubsub_rsm = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/pubsub#rsm");
 // XEP-0065: SOCKS5 Bytestreams
-extern const char *ns_bytestreams;
+inline constexpr auto ns_bytestreams = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/bytestreams");
 // XEP-0066: Out of Band Data
-extern const char *ns_oob;
+inline constexpr auto ns_oob = QXmpp::Private::xmlnsLiteral("jabber:x:oob");
 // XEP-0071: XHTML-IM
-extern const char *ns_xhtml;
-extern const char *ns_xhtml_im;
+inline constexpr auto ns_xhtml = QXmpp::Private::xmlnsLiteral("http://www.w3.org/1999/xhtml");
+inline constexpr auto ns_xhtml_im = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/xhtml-im");
 // XEP-0077: In-Band Registration
-extern const char *ns_register;
-extern const char *ns_register_feature;
+inline constexpr auto ns_register = QXmpp::Private::xmlnsLiteral("jabber:iq:register");
+inline constexpr auto ns_register_feature = QXmpp::Private::xmlnsLiteral("http://jabber.org/features/iq-register");
 // XEP-0078: Non-SASL Authentication
-extern const char *ns_auth;
-extern const char *ns_authFeature;
+inline constexpr auto ns_auth = QXmpp::Private::xmlnsLiteral("jabber:iq:auth");
+inline constexpr auto ns_authFeature = QXmpp::Private::xmlnsLiteral("http://jabber.org/features/iq-auth");
 // XEP-0080: User Location
-extern const char *ns_geoloc;
-extern const char *ns_geoloc_notify;
+inline constexpr auto ns_geoloc = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/geoloc");
+inline constexpr auto ns_geoloc_notify = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/geoloc+notify");
 // XEP-0085: Chat State Notifications
-extern const char *ns_chat_states;
+inline constexpr auto ns_chat_states = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/chatstates");
 // XEP-0091: Legacy Delayed Delivery
-extern const char *ns_legacy_delayed_delivery;
+inline constexpr auto ns_legacy_delayed_delivery = QXmpp::Private::xmlnsLiteral("jabber:x:delay");
 // XEP-0092: Software Version
-extern const char *ns_version;
-extern const char *ns_data;
+inline constexpr auto ns_version = QXmpp::Private::xmlnsLiteral("jabber:iq:version");
+inline constexpr auto ns_data = QXmpp::Private::xmlnsLiteral("jabber:x:data");
 // XEP-0095: Stream Initiation
-extern const char *ns_stream_initiation;
-extern const char *ns_stream_initiation_file_transfer;
+inline constexpr auto ns_stream_initiation = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/si");
+inline constexpr auto ns_stream_initiation_file_transfer = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/si/profile/file-transfer");
 // XEP-0103: URL Address Information
-extern const char *ns_url_data;
+inline constexpr auto ns_url_data = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/url-data");
 // XEP-0108: User Activity
-extern const char *ns_activity;
+inline constexpr auto ns_activity = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/activity");
 // XEP-0115: Entity Capabilities
-extern const char *ns_capabilities;
+inline constexpr auto ns_capabilities = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/caps");
 // XEP-0118: User Tune
-extern const char *ns_tune;
-extern const char *ns_tune_notify;
+inline constexpr auto ns_tune = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/tune");
+inline constexpr auto ns_tune_notify = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/tune+notify");
 // XEP-0136: Message Archiving
-extern const char *ns_archive;
+inline constexpr auto ns_archive = QXmpp::Private::xmlnsLiteral("urn:xmpp:archive");
 // XEP-0138: Stream Compression
-extern const char *ns_compress;
-extern const char *ns_compressFeature;
+inline constexpr auto ns_compress = QXmpp::Private::xmlnsLiteral("http://jabber.org/protocol/compress");
+inline constexpr auto ns_compressFeature = QXmpp::Private::xmlnsLiteral("http://jabber.org/features/compress");
 // XEP-0145: Annotations
-extern const char *ns_rosternotes;
+inline constexpr auto ns_rosternotes = QXmpp::Private::xmlnsLiteral("storage:rosternotes");
 // XEP-0153: vCard-Based Avatars
-extern const char *ns_vcard_update;
+inline constexpr auto ns_vcard_update = QXmpp::Private::xmlnsLiteral("vcard-temp:x:update");
 // XEP-0158: CAPTCHA Forms
-extern const char *ns_captcha;
+inline constexpr auto ns_captcha = QXmpp::Private::xmlnsLiteral("urn:xmpp:captcha");
 // XEP-0166: Jingle
-extern const char *ns_jingle;
-extern const char *ns_jingle_ice_udp;
-extern const char *ns_jingle_raw_udp;
+inline constexpr auto ns_jingle = QXmpp::Private::xmlnsLiteral("urn:xmpp:jingle:1");
+inline constexpr auto ns_jingle_raw_udp = QXmpp::Private::xmlnsLiteral("urn:xmpp:jingle:transports:raw-udp:1");
+inline constexpr auto ns_jingle_ice_udp = QXmpp::Private::xmlnsLiteral("urn:xmpp:jingle:transports:ice-udp:1");
 // XEP-0167: Jingle RTP Sessions
-extern const char *ns_jingle_rtp;
-extern const char *ns_jingle_rtp_audio;
-extern const char *ns_jingle_rtp_video;
-extern const char *ns_jingle_rtp_info;
-extern const char *ns_jingle_rtp_errors;
+inline constexpr auto ns_jingle_rtp = QXmpp::Private::xmlnsLiteral("urn:xmpp:jingle:apps:rtp:1");
+inline constexpr auto ns_jingle_rtp_audio = QXmpp::Private::xmlnsLiteral("urn:xmpp:jingle:apps:rtp:audio");
+inline constexpr auto ns_jingle_rtp_video = QXmpp::Private::xmlnsLiteral("urn:xmpp:jingle:apps:rtp:video");
+inline constexpr auto ns_jingle_rtp_info = QXmpp::Private::xmlnsLiteral("urn:xmpp:jingle:apps:rtp:info:1");
+inline constexpr auto ns_jingle_rtp_errors = QXmpp::Private::xmlnsLiteral("urn:xmpp:jingle:apps:rtp:errors:1");
 // XEP-0184: Message Receipts
-extern const char *ns_message_receipts;
+inline constexpr auto ns_message_receipts = QXmpp::Private::xmlnsLiteral("urn:xmpp:receipts");
 // XEP-0198: Stream Management
-extern const char *ns_stream_management;
+inline constexpr auto ns_stream_management = QXmpp::Private::xmlnsLiteral("urn:xmpp:sm:3");
 // XEP-0199: XMPP Ping
-extern const char *ns_ping;
+inline constexpr auto ns_ping = QXmpp::Private::xmlnsLiteral("urn:xmpp:ping");
 // XEP-0202: Entity Time
-extern const char *ns_entity_time;
+inline constexpr auto ns_entity_time = QXmpp::Private::xmlnsLiteral("urn:xmpp:time");
 // XEP-0203: Delayed Delivery
-extern const char *ns_delayed_delivery;
+inline constexpr auto ns_delayed_delivery = QXmpp::Private::xmlnsLiteral("urn:xmpp:delay");
 // XEP-0215: External Service Discovery
-extern const char *ns_external_service_discovery;
+inline constexpr auto ns_external_service_discovery = QXmpp::Private::xmlnsLiteral("urn:xmpp:extdisco:2");
 // XEP-0220: Server Dialback
-extern const char *ns_server_dialback;
+inline constexpr auto ns_server_dialback = QXmpp::Private::xmlnsLiteral("jabber:server:dialback");
 // XEP-0221: Data Forms Media Element
-extern const char *ns_media_element;
+inline constexpr auto ns_media_element = QXmpp::Private::xmlnsLiteral("urn:xmpp:media-element");
 // XEP-0224: Attention
-extern const char *ns_attention;
+inline constexpr auto ns_attention = QXmpp::Private::xmlnsLiteral("urn:xmpp:attention:0");
 // XEP-0231: Bits of Binary
-extern const char *ns_bob;
+inline constexpr auto ns_bob = QXmpp::Private::xmlnsLiteral("urn:xmpp:bob");
+// XEP-0234: Jingle File Transfer
+inline constexpr auto ns_jingle_file_transfer = QXmpp::Private::xmlnsLiteral("urn:xmpp:jingle:apps:file-transfer:5");
 // XEP-0249: Direct MUC Invitations
-extern const char *ns_conference;
+inline constexpr auto ns_conference = QXmpp::Private::xmlnsLiteral("jabber:x:conference");
 // XEP-0264: Jingle Content Thumbnails
-extern const char *ns_thumbs;
+inline constexpr auto ns_thumbs = QXmpp::Private::xmlnsLiteral("urn:xmpp:thumbs:1");
 // XEP-0272: Multiparty Jingle (Muji)
-extern const char *ns_muji;
+inline constexpr auto ns_muji = QXmpp::Private::xmlnsLiteral("urn:xmpp:jingle:muji:0");
 // XEP-0280: Message Carbons
-extern const char *ns_carbons;
+inline constexpr auto ns_carbons = QXmpp::Private::xmlnsLiteral("urn:xmpp:carbons:2");
+// XEP-0288: Bidirectional Server-to-Server Connections
+inline constexpr auto ns_bidi = QXmpp::Private::xmlnsLiteral("urn:xmpp:bidi");
+inline constexpr auto ns_bidi_feature = QXmpp::Private::xmlnsLiteral("urn:xmpp:features:bidi");
 // XEP-0293: Jingle RTP Feedback Negotiation
-extern const char *ns_jingle_rtp_feedback_negotiation;
+inline constexpr auto ns_jingle_rtp_feedback_negotiation = QXmpp::Private::xmlnsLiteral("urn:xmpp:jingle:apps:rtp:rtcp-fb:0");
 // XEP-0294: Jingle RTP Header Extensions Negotiation
-extern const char *ns_jingle_rtp_header_extensions_negotiation;
+inline constexpr auto ns_jingle_rtp_header_extensions_negotiation = QXmpp::Private::xmlnsLiteral("urn:xmpp:jingle:apps:rtp:rtp-hdrext:0");
 // XEP-0297: Stanza Forwarding
-extern const char *ns_forwarding;
+inline constexpr auto ns_forwarding = QXmpp::Private::xmlnsLiteral("urn:xmpp:forward:0");
 // XEP-0300: Use of Cryptographic Hash Functions in XMPP
-extern const char *ns_hashes;
+inline constexpr auto ns_hashes = QXmpp::Private::xmlnsLiteral("urn:xmpp:hashes:2");
 // XEP-0308: Last Message Correction
-extern const char *ns_message_correct;
+inline constexpr auto ns_message_correct = QXmpp::Private::xmlnsLiteral("urn:xmpp:message-correct:0");
 // XEP-0313: Message Archive Management
-extern const char *ns_mam;
+inline constexpr auto ns_mam = QXmpp::Private::xmlnsLiteral("urn:xmpp:mam:2");
 // XEP-0319: Last User Interaction in Presence
-extern const char *ns_idle;
+inline constexpr auto ns_idle = QXmpp::Private::xmlnsLiteral("urn:xmpp:idle:1");
 // XEP-0320: Use of DTLS-SRTP in Jingle Sessions
-extern const char *ns_jingle_dtls;
-// XEP-0333: Char Markers
-extern const char *ns_chat_markers;
-// XEP-0334: Message Processing Hints:
-extern const char *ns_message_processing_hints;
+inline constexpr auto ns_jingle_dtls = QXmpp::Private::xmlnsLiteral("urn:xmpp:jingle:apps:dtls:0");
+// XEP-0333: Chat Markers
+inline constexpr auto ns_chat_markers = QXmpp::Private::xmlnsLiteral("urn:xmpp:chat-markers:0");
+// XEP-0334: Message Processing Hints
+inline constexpr auto ns_message_processing_hints = QXmpp::Private::xmlnsLiteral("urn:xmpp:hints");
+// XEP-0338: Jingle Grouping Framework
+inline constexpr auto ns_jingle_grouping = QXmpp::Private::xmlnsLiteral("urn:xmpp:jingle:apps:grouping:0");
 // XEP-0352: Client State Indication
-extern const char *ns_csi;
+inline constexpr auto ns_csi = QXmpp::Private::xmlnsLiteral("urn:xmpp:csi:0");
 // XEP-0353: Jingle Message Initiation
-extern const char *ns_jingle_message_initiation;
+inline constexpr auto ns_jingle_message_initiation = QXmpp::Private::xmlnsLiteral("urn:xmpp:jingle-message:0");
 // XEP-0357: Push Notifications
-extern const char *ns_push;
+inline constexpr auto ns_push = QXmpp::Private::xmlnsLiteral("urn:xmpp:push:0");
+inline constexpr auto ns_push_summary = QXmpp::Private::xmlnsLiteral("urn:xmpp:push:summary");
 // XEP-0359: Unique and Stable Stanza IDs
-extern const char *ns_sid;
+inline constexpr auto ns_sid = QXmpp::Private::xmlnsLiteral("urn:xmpp:sid:0");
 // XEP-0363: HTTP File Upload
-extern const char *ns_http_upload;
+inline constexpr auto ns_http_upload = QXmpp::Private::xmlnsLiteral("urn:xmpp:http:upload:0");
 // XEP-0364: Current Off-the-Record Messaging Usage
-extern const char *ns_otr;
+inline constexpr auto ns_otr = QXmpp::Private::xmlnsLiteral("urn:xmpp:otr:0");
 // XEP-0367: Message Attaching
-extern const char *ns_message_attaching;
+inline constexpr auto ns_message_attaching = QXmpp::Private::xmlnsLiteral("urn:xmpp:message-attaching:1");
 // XEP-0369: Mediated Information eXchange (MIX)
-extern const char *ns_mix;
-extern const char *ns_mix_create_channel;
-extern const char *ns_mix_searchable;
-extern const char *ns_mix_node_messages;
-extern const char *ns_mix_node_participants;
-extern const char *ns_mix_node_presence;
-extern const char *ns_mix_node_config;
-extern const char *ns_mix_node_info;
+inline constexpr auto ns_mix = QXmpp::Private::xmlnsLiteral("urn:xmpp:mix:core:1");
+inline constexpr auto ns_mix_create_channel = QXmpp::Private::xmlnsLiteral("urn:xmpp:mix:core:1#create-channel");
+inline constexpr auto ns_mix_searchable = QXmpp::Private::xmlnsLiteral("urn:xmpp:mix:core:1#searchable");
+inline constexpr auto ns_mix_node_messages = QXmpp::Private::xmlnsLiteral("urn:xmpp:mix:nodes:messages");
+inline constexpr auto ns_mix_node_participants = QXmpp::Private::xmlnsLiteral("urn:xmpp:mix:nodes:participants");
+inline constexpr auto ns_mix_node_presence = QXmpp::Private::xmlnsLiteral("urn:xmpp:mix:nodes:presence");
+inline constexpr auto ns_mix_node_config = QXmpp::Private::xmlnsLiteral("urn:xmpp:mix:nodes:config");
+inline constexpr auto ns_mix_node_info = QXmpp::Private::xmlnsLiteral("urn:xmpp:mix:nodes:info");
 // XEP-0373: OpenPGP for XMPP
-extern const char *ns_ox;
+inline constexpr auto ns_ox = QXmpp::Private::xmlnsLiteral("urn:xmpp:openpgp:0");
 // XEP-0380: Explicit Message Encryption
-extern const char *ns_eme;
+inline constexpr auto ns_eme = QXmpp::Private::xmlnsLiteral("urn:xmpp:eme:0");
 // XEP-0382: Spoiler messages
-extern const char *ns_spoiler;
+inline constexpr auto ns_spoiler = QXmpp::Private::xmlnsLiteral("urn:xmpp:spoiler:0");
 // XEP-0384: OMEMO Encryption
-extern const char *ns_omemo;
-extern const char *ns_omemo_1;
-extern const char *ns_omemo_2;
-extern const char *ns_omemo_2_bundles;
-extern const char *ns_omemo_2_devices;
+inline constexpr auto ns_omemo = QXmpp::Private::xmlnsLiteral("eu.siacs.conversations.axolotl");
+inline constexpr auto ns_omemo_1 = QXmpp::Private::xmlnsLiteral("urn:xmpp:omemo:1");
+inline constexpr auto ns_omemo_2 = QXmpp::Private::xmlnsLiteral("urn:xmpp:omemo:2");
+inline constexpr auto ns_omemo_2_bundles = QXmpp::Private::xmlnsLiteral("urn:xmpp:omemo:2:bundles");
+inline constexpr auto ns_omemo_2_devices = QXmpp::Private::xmlnsLiteral("urn:xmpp:omemo:2:devices");
+// XEP-0386: Bind 2
+inline constexpr auto ns_bind2 = QXmpp::Private::xmlnsLiteral("urn:xmpp:bind:0");
+// XEP-0388: Extensible SASL Profile
+inline constexpr auto ns_sasl_2 = QXmpp::Private::xmlnsLiteral("urn:xmpp:sasl:2");
+// XEP-0402: PEP Native Bookmarks
+inline constexpr auto ns_bookmarks_1 = QXmpp::Private::xmlnsLiteral("urn:xmpp:bookmarks:1");
+inline constexpr auto ns_bookmarks_1_notify = QXmpp::Private::xmlnsLiteral("urn:xmpp:bookmarks:1+notify");
 // XEP-0405: Mediated Information eXchange (MIX): Participant Server Requirements
-extern const char *ns_mix_pam;
-extern const char *ns_mix_roster;
-extern const char *ns_mix_presence;
+inline constexpr auto ns_mix_pam = QXmpp::Private::xmlnsLiteral("urn:xmpp:mix:pam:1");
+inline constexpr auto ns_mix_roster = QXmpp::Private::xmlnsLiteral("urn:xmpp:mix:roster:0");
+inline constexpr auto ns_mix_presence = QXmpp::Private::xmlnsLiteral("urn:xmpp:presence:0");
 // XEP-0407: Mediated Information eXchange (MIX): Miscellaneous Capabilities
-extern const char *ns_mix_misc;
+inline constexpr auto ns_mix_misc = QXmpp::Private::xmlnsLiteral("urn:xmpp:mix:misc:0");
 // XEP-0428: Fallback Indication
-extern const char *ns_fallback_indication;
+inline constexpr auto ns_fallback_indication = QXmpp::Private::xmlnsLiteral("urn:xmpp:fallback:0");
 // XEP-0434: Trust Messages (TM)
-extern const char *ns_tm;
+inline constexpr auto ns_tm = QXmpp::Private::xmlnsLiteral("urn:xmpp:tm:1");
 // XEP-0444: Message Reactions
-extern const char *ns_reactions;
+inline constexpr auto ns_reactions = QXmpp::Private::xmlnsLiteral("urn:xmpp:reactions:0");
 // XEP-0446: File metadata element
-extern const char *ns_file_metadata;
+inline constexpr auto ns_file_metadata = QXmpp::Private::xmlnsLiteral("urn:xmpp:file:metadata:0");
 // XEP-0447: Stateless file sharing
-extern const char *ns_sfs;
+inline constexpr auto ns_sfs = QXmpp::Private::xmlnsLiteral("urn:xmpp:sfs:0");
 // XEP-0448: Encryption for stateless file sharing
-extern const char *ns_esfs;
+inline constexpr auto ns_esfs = QXmpp::Private::xmlnsLiteral("urn:xmpp:esfs:0");
 // XEP-0450: Automatic Trust Management (ATM)
-extern const char *ns_atm;
+inline constexpr auto ns_atm = QXmpp::Private::xmlnsLiteral("urn:xmpp:atm:1");
 // XEP-0482: Call Invites
-extern const char *ns_call_invites;
+inline constexpr auto ns_call_invites = QXmpp::Private::xmlnsLiteral("urn:xmpp:call-invites:0");
+// XEP-0484: Fast Authentication Streamlining Tokens
+inline constexpr auto ns_fast = QXmpp::Private::xmlnsLiteral("urn:xmpp:fast:0");
+// QXmpp: application-specific stream error condition with the seconds to wait
+// before reconnecting
+inline constexpr auto ns_qxmpp_retry_after = QXmpp::Private::xmlnsLiteral("urn:qxmpp:retry-after:0");
 
 #endif  // QXMPPCONSTANTS_H
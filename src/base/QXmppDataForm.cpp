@@ -7,91 +7,60 @@
 
 #include "QXmppConstants_p.h"
 #include "QXmppDataFormBase.h"
+#include "QXmppEnumStrings_p.h"
 #include "QXmppUtils.h"
 
+#include <algorithm>
 #include <optional>
 
 #include <QDebug>
 #include <QDomElement>
+#include <QHash>
 #include <QMimeDatabase>
 #include <QMimeType>
 #include <QSize>
 #include <QStringList>
 #include <QUrl>
 
-struct field_type
-{
-    QXmppDataForm::Field::Type type;
-    const char *str;
-};
-
-static field_type field_types[] = {
-    { QXmppDataForm::Field::BooleanField, "boolean" },
-    { QXmppDataForm::Field::FixedField, "fixed" },
-    { QXmppDataForm::Field::HiddenField, "hidden" },
-    { QXmppDataForm::Field::JidMultiField, "jid-multi" },
-    { QXmppDataForm::Field::JidSingleField, "jid-single" },
-    { QXmppDataForm::Field::ListMultiField, "list-multi" },
-    { QXmppDataForm::Field::ListSingleField, "list-single" },
-    { QXmppDataForm::Field::TextMultiField, "text-multi" },
-    { QXmppDataForm::Field::TextPrivateField, "text-private" },
-    { QXmppDataForm::Field::TextSingleField, "text-single" },
-    { static_cast<QXmppDataForm::Field::Type>(-1), nullptr },
-};
+using namespace QXmpp::Private;
+
+constexpr auto FIELD_TYPES = enumStrings<QXmppDataForm::Field::Type>(
+    u"boolean",
+    u"fixed",
+    u"hidden",
+    u"jid-multi",
+    u"jid-single",
+    u"list-multi",
+    u"list-single",
+    u"text-multi",
+    u"text-private",
+    u"text-single");
+
+constexpr auto FORM_TYPES = enumStrings<QXmppDataForm::Type>(
+    u"",
+    u"form",
+    u"submit",
+    u"cancel",
+    u"result");
 
 std::optional<QXmppDataForm::Field::Type> fieldTypeFromString(const QString &type)
 {
-    struct field_type *ptr;
-    for (ptr = field_types; ptr->str; ptr++) {
-        if (type == ptr->str) {
-            return ptr->type;
-        }
-    }
-    return {};
+    return FIELD_TYPES.fromString(type);
 }
 
 QString fieldTypeToString(QXmppDataForm::Field::Type type)
 {
-    struct field_type *ptr;
-    for (ptr = field_types; ptr->str; ptr++) {
-        if (type == ptr->type) {
-            return ptr->str;
-        }
-    }
-    return {};
+    return FIELD_TYPES.toString(type);
 }
 
 std::optional<QXmppDataForm::Type> formTypeFromString(const QString &type)
 {
-    if (type == "form") {
-        return QXmppDataForm::Form;
-    }
-    if (type == "submit") {
-        return QXmppDataForm::Submit;
-    }
-    if (type == "cancel") {
-        return QXmppDataForm::Cancel;
-    }
-    if (type == "result") {
-        return QXmppDataForm::Result;
-    }
-    return {};
+    return FORM_TYPES.fromString(type);
 }
 
 QString formTypeToString(QXmppDataForm::Type type)
 {
-    switch (type) {
-    case QXmppDataForm::Form:
-        return "form";
-    case QXmppDataForm::Submit:
-        return "submit";
-    case QXmppDataForm::Cancel:
-        return "cancel";
-    case QXmppDataForm::Result:
-        return "result";
-    default:
-        return {};
-    }
+    return FORM_TYPES.toString(type);
 }
 
 class QXmppDataFormMediaSourcePrivate : public QSharedData
@@ -631,8 +600,54 @@ public:
     QList<QXmppDataForm::Field> fields;
     QString title;
     QXmppDataForm::Type type = QXmppDataForm::None;
+
+    void buildFieldIndex();
+    void invalidateFieldIndex();
+    std::optional<int> indexOfField(const QString &key) const;
+
+    // positions of the fields by their key, only used while it is valid
+    QHash<QString, int> fieldIndexes;
+    bool fieldIndexValid = false;
 };
 
+// Indexes the fields, the first field with a key is found for duplicate keys.
+void QXmppDataFormPrivate::buildFieldIndex()
+{
+    fieldIndexes.clear();
+    fieldIndexes.reserve(fields.size());
+    for (int i = fields.size() - 1; i >= 0; i--) {
+        fieldIndexes.insert(fields.at(i).key(), i);
+    }
+    fieldIndexValid = true;
+}
+
+// Drops the index, the fields may be modified from outside.
+void QXmppDataFormPrivate::invalidateFieldIndex()
+{
+    if (fieldIndexValid) {
+        fieldIndexes.clear();
+        fieldIndexValid = false;
+    }
+}
+
+std::optional<int> QXmppDataFormPrivate::indexOfField(const QString &key) const
+{
+    if (fieldIndexValid) {
+        if (const auto itr = fieldIndexes.constFind(key); itr != fieldIndexes.constEnd()) {
+            return *itr;
+        }
+        return std::nullopt;
+    }
+
+    const auto itr = std::find_if(fields.cbegin(), fields.cend(), [&](const QXmppDataForm::Field &field) {
+        return field.key() == key;
+    });
+    if (itr != fields.cend()) {
+        return int(std::distance(fields.cbegin(), itr));
+    }
+    return std::nullopt;
+}
+
 ///
 /// \class QXmppDataForm
 ///
@@ -655,6 +670,7 @@ QXmppDataForm::QXmppDataForm(Type type,
     d->fields = fields;
     d->title = title;
     d->instructions = instructions;
+    d->buildFieldIndex();
 }
 
 ///
@@ -691,6 +707,7 @@ QList<QXmppDataForm::Field> QXmppDataForm::fields() const
 ///
 QList<QXmppDataForm::Field> &QXmppDataForm::fields()
 {
+    d->invalidateFieldIndex();
     return d->fields;
 }
 
@@ -702,6 +719,27 @@ QList<QXmppDataForm::Field> &QXmppDataForm::fields()
 void QXmppDataForm::setFields(const QList<QXmppDataForm::Field> &fields)
 {
     d->fields = fields;
+    d->buildFieldIndex();
+}
+
+///
+/// Returns the field with the given key (the 'var' attribute).
+///
+/// Forms that have been parsed or whose fields have been set with setFields()
+/// keep an index of their fields, so looking up a field does not need to
+/// compare the keys of all fields. If the fields have been modified using the
+/// non-const fields() accessor, the fields are searched.
+///
+/// \returns The first field with the key or std::nullopt if there is none.
+///
+/// \since QXmpp 1.6
+///
+std::optional<QXmppDataForm::Field> QXmppDataForm::field(const QString &key) const
+{
+    if (const auto index = d->indexOfField(key)) {
+        return d->fields.at(*index);
+    }
+    return std::nullopt;
 }
 
 ///
@@ -768,12 +806,23 @@ void QXmppDataForm::setType(QXmppDataForm::Type type)
 ///
 QString QXmppDataForm::formType() const
 {
-    const auto formTypeItr = std::find_if(d->fields.begin(), d->fields.end(), [](const QXmppDataForm::Field &field) {
+    const auto formTypeKey = QStringLiteral("FORM_TYPE");
+    const auto isFormType = [&](const QXmppDataForm::Field &field) {
         return field.type() == QXmppDataForm::Field::HiddenField &&
-            field.key() == QStringLiteral("FORM_TYPE");
-    });
+            field.key() == formTypeKey;
+    };
+
+    const auto index = d->indexOfField(formTypeKey);
+    if (!index) {
+        return {};
+    }
+    if (const auto &field = d->fields.at(*index); isFormType(field)) {
+        return field.value().toString();
+    }
 
-    if (formTypeItr != d->fields.end()) {
+    // the first field with the key is not hidden, another one may be
+    const auto formTypeItr = std::find_if(d->fields.cbegin(), d->fields.cend(), isFormType);
+    if (formTypeItr != d->fields.cend()) {
         return formTypeItr->value().toString();
     }
     return {};
@@ -880,6 +929,7 @@ void QXmppDataForm::parse(const QDomElement &element)
 
         d->fields.append(field);
     }
+    d->buildFieldIndex();
 }
 
 void QXmppDataForm::toXml(QXmlStreamWriter *writer) const
@@ -8,6 +8,8 @@
 
 #include "QXmppStanza.h"
 
+#include <optional>
+
 #if QXMPP_DEPRECATED_SINCE(1, 1)
 #include <QPair>
 #endif
@@ -191,6 +193,7 @@ public:
     QList<Field> fields() const;
     QList<Field> &fields();
     void setFields(const QList<QXmppDataForm::Field> &fields);
+    std::optional<Field> field(const QString &key) const;
 
     QString title() const;
     void setTitle(const QString &title);
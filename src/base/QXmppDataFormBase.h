@@ -25,7 +25,7 @@ protected:
     virtual void parseForm(const QXmppDataForm &) = 0;
     virtual void serializeForm(QXmppDataForm &) const = 0;
 
-    std::optional<quint32> parseUInt(const QVariant &variant)
+    static std::optional<quint32> parseUInt(const QVariant &variant)
     {
         bool ok;
         if (const auto result = variant.toString().toUInt(&ok); ok) {
@@ -34,7 +34,7 @@ protected:
         return std::nullopt;
     }
 
-    std::optional<quint64> parseULongLong(const QVariant &variant)
+    static std::optional<quint64> parseULongLong(const QVariant &variant)
     {
         bool ok;
         if (const auto result = variant.toString().toULongLong(&ok); ok) {
@@ -43,7 +43,7 @@ protected:
         return std::nullopt;
     }
 
-    std::optional<bool> parseBool(const QVariant &variant)
+    static std::optional<bool> parseBool(const QVariant &variant)
     {
         if (variant.type() == QVariant::Bool) {
             return variant.toBool();
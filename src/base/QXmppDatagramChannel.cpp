@@ -0,0 +1,439 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppDatagramChannel_p.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include <QTimer>
+#include <QtEndian>
+
+// The first byte of the packets is outside of the ranges used by STUN, TURN
+// channel data, DTLS and RTP (RFC 7983), so they can share a transport.
+constexpr uchar DATA_PACKET = 0xf0;
+constexpr uchar ACK_PACKET = 0xf1;
+
+// type, sequence number, timestamp
+constexpr int DATA_HEADER_SIZE = 9;
+// type, next expected sequence number, echoed timestamp, receive window,
+// followed by SACK blocks of start and end sequence numbers
+constexpr int ACK_HEADER_SIZE = 13;
+constexpr int SACK_BLOCK_SIZE = 8;
+constexpr int MAX_SACK_BLOCKS = 8;
+
+// in packets
+constexpr double INITIAL_WINDOW = 10;
+constexpr double MAX_WINDOW = 4096;
+constexpr quint32 RECEIVE_WINDOW = 4096;
+constexpr int DUPLICATE_THRESHOLD = 3;
+
+// in milliseconds
+constexpr qint64 INITIAL_RTO = 1000;
+constexpr qint64 MIN_RTO = 200;
+constexpr qint64 MAX_RTO = 60000;
+constexpr int MAX_TIMEOUTS = 8;
+
+static quint32 readUInt32(const QByteArray &data, int offset)
+{
+    return qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(data.constData() + offset));
+}
+
+static void writeUInt32(QByteArray &data, int offset, quint32 value)
+{
+    qToBigEndian<quint32>(value, reinterpret_cast<uchar *>(data.data() + offset));
+}
+
+///
+/// Constructs a channel that sends its packets using the given function.
+///
+/// Received datagrams need to be passed to handleDatagram().
+///
+QXmppDatagramChannel::QXmppDatagramChannel(SendFunction sendDatagram, QObject *parent)
+    : QXmppLoggable(parent),
+      m_sendDatagram(std::move(sendDatagram)),
+      m_congestionWindow(INITIAL_WINDOW),
+      m_slowStartThreshold(MAX_WINDOW),
+      m_peerWindow(RECEIVE_WINDOW),
+      m_rto(INITIAL_RTO),
+      m_retransmissionTimer(new QTimer(this))
+{
+    m_clock.start();
+    m_retransmissionTimer->setSingleShot(true);
+    connect(m_retransmissionTimer, &QTimer::timeout, this, &QXmppDatagramChannel::retransmissionTimedOut);
+}
+
+QXmppDatagramChannel::~QXmppDatagramChannel() = default;
+
+///
+/// Queues data for sending.
+///
+void QXmppDatagramChannel::write(const QByteArray &data)
+{
+    if (m_sendOffset > 0) {
+        m_sendBuffer.remove(0, m_sendOffset);
+        m_sendOffset = 0;
+    }
+    m_sendBuffer.append(data);
+    trySend();
+}
+
+///
+/// Returns the number of bytes that have not been acknowledged yet.
+///
+qint64 QXmppDatagramChannel::bytesToWrite() const
+{
+    return m_sendBuffer.size() - m_sendOffset + m_segmentBytes;
+}
+
+///
+/// Returns the congestion window in packets.
+///
+int QXmppDatagramChannel::congestionWindow() const
+{
+    return int(m_congestionWindow);
+}
+
+///
+/// Returns the smoothed round-trip time in milliseconds, or -1 if it has not
+/// been measured yet.
+///
+int QXmppDatagramChannel::smoothedRoundTripTime() const
+{
+    return int(m_smoothedRtt);
+}
+
+///
+/// Returns the current retransmission timeout in milliseconds.
+///
+int QXmppDatagramChannel::retransmissionTimeout() const
+{
+    return int(m_rto);
+}
+
+///
+/// Returns true if the datagram is a packet of a channel, so it can be told
+/// apart from other traffic on the same transport.
+///
+bool QXmppDatagramChannel::isDatagramChannelPacket(const QByteArray &datagram)
+{
+    return !datagram.isEmpty() &&
+        (uchar(datagram.at(0)) == DATA_PACKET || uchar(datagram.at(0)) == ACK_PACKET);
+}
+
+///
+/// Handles a datagram received from the peer.
+///
+void QXmppDatagramChannel::handleDatagram(const QByteArray &datagram)
+{
+    if (datagram.isEmpty()) {
+        return;
+    }
+
+    switch (uchar(datagram.at(0))) {
+    case DATA_PACKET:
+        handleData(datagram);
+        break;
+    case ACK_PACKET:
+        handleAck(datagram);
+        break;
+    default:
+        break;
+    }
+}
+
+void QXmppDatagramChannel::handleAck(const QByteArray &datagram)
+{
+    if (datagram.size() < ACK_HEADER_SIZE) {
+        return;
+    }
+
+    const auto cumulativeAck = readUInt32(datagram, 1);
+    const auto echoedTimestamp = readUInt32(datagram, 5);
+    m_peerWindow = std::max(readUInt32(datagram, 9), quint32(1));
+    if (cumulativeAck > m_nextSequence) {
+        warning(QStringLiteral("Received acknowledgement for unsent data"));
+        return;
+    }
+
+    if (echoedTimestamp) {
+        const auto sample = qint64(timestamp()) - qint64(echoedTimestamp);
+        if (sample >= 0) {
+            updateRoundTripTime(sample);
+        }
+    }
+
+    int newlyAcked = 0;
+    qint64 ackedBytes = 0;
+
+    // cumulative acknowledgement
+    auto itr = m_segments.begin();
+    while (itr != m_segments.end() && itr.key() < cumulativeAck) {
+        if (itr->sacked) {
+            m_sackedCount--;
+        } else {
+            newlyAcked++;
+        }
+        if (itr->lost) {
+            m_lostCount--;
+        }
+        ackedBytes += itr->payload.size();
+        itr = m_segments.erase(itr);
+    }
+    m_segmentBytes -= ackedBytes;
+
+    // selective acknowledgements
+    int newlySacked = 0;
+    for (int offset = ACK_HEADER_SIZE; offset + SACK_BLOCK_SIZE <= datagram.size(); offset += SACK_BLOCK_SIZE) {
+        const auto start = readUInt32(datagram, offset);
+        const auto end = readUInt32(datagram, offset + 4);
+        if (start >= end || end > m_nextSequence) {
+            continue;
+        }
+        for (auto segment = m_segments.lowerBound(start); segment != m_segments.end() && segment.key() < end; ++segment) {
+            if (!segment->sacked) {
+                segment->sacked = true;
+                m_sackedCount++;
+                newlySacked++;
+                if (segment->lost) {
+                    segment->lost = false;
+                    m_lostCount--;
+                }
+            }
+        }
+    }
+    newlyAcked += newlySacked;
+
+    // a packet is lost if enough packets sent after it have arrived (RFC 6675)
+    bool lossDetected = false;
+    if (newlySacked) {
+        int sackedAbove = 0;
+        for (auto segment = m_segments.end(); segment != m_segments.begin();) {
+            --segment;
+            if (segment->sacked) {
+                sackedAbove++;
+            } else if (sackedAbove >= DUPLICATE_THRESHOLD && !segment->lost && !segment->retransmitted) {
+                segment->lost = true;
+                m_lostCount++;
+                lossDetected = true;
+            }
+        }
+    }
+
+    // congestion control
+    if (m_inRecovery && cumulativeAck >= m_recoveryPoint) {
+        m_inRecovery = false;
+    }
+    if (lossDetected && !m_inRecovery) {
+        m_slowStartThreshold = std::max((m_segments.size() - m_sackedCount) / 2.0, 2.0);
+        m_congestionWindow = m_slowStartThreshold;
+        m_inRecovery = true;
+        m_recoveryPoint = m_nextSequence;
+    } else if (!m_inRecovery) {
+        for (int i = 0; i < newlyAcked; i++) {
+            if (m_congestionWindow < m_slowStartThreshold) {
+                m_congestionWindow += 1;
+            } else {
+                m_congestionWindow += 1 / m_congestionWindow;
+            }
+        }
+        m_congestionWindow = std::min(m_congestionWindow, MAX_WINDOW);
+    }
+
+    if (ackedBytes || newlyAcked) {
+        m_timeouts = 0;
+    }
+    if (m_segments.isEmpty()) {
+        m_retransmissionTimer->stop();
+    } else if (ackedBytes) {
+        m_retransmissionTimer->start(int(m_rto));
+    }
+
+    trySend();
+
+    if (ackedBytes) {
+        Q_EMIT bytesWritten(ackedBytes);
+    }
+}
+
+void QXmppDatagramChannel::handleData(const QByteArray &datagram)
+{
+    if (datagram.size() < DATA_HEADER_SIZE) {
+        return;
+    }
+
+    const auto sequence = readUInt32(datagram, 1);
+    const auto packetTimestamp = readUInt32(datagram, 5);
+
+    QByteArray data;
+    if (sequence - m_receiveNext < RECEIVE_WINDOW) {
+        if (sequence == m_receiveNext) {
+            data = datagram.mid(DATA_HEADER_SIZE);
+            m_receiveNext++;
+
+            // deliver the buffered packets that follow
+            auto itr = m_outOfOrder.begin();
+            while (itr != m_outOfOrder.end() && itr.key() == m_receiveNext) {
+                data.append(itr.value());
+                m_receiveNext++;
+                itr = m_outOfOrder.erase(itr);
+            }
+        } else if (!m_outOfOrder.contains(sequence)) {
+            m_outOfOrder.insert(sequence, datagram.mid(DATA_HEADER_SIZE));
+        }
+    }
+
+    // duplicates are acknowledged too, the previous acknowledgement may have
+    // been lost
+    sendAck(packetTimestamp, sequence);
+
+    if (!data.isEmpty()) {
+        Q_EMIT dataReceived(data);
+    }
+}
+
+void QXmppDatagramChannel::sendData(quint32 sequence, const QByteArray &payload)
+{
+    QByteArray packet(DATA_HEADER_SIZE, Qt::Uninitialized);
+    packet[0] = char(DATA_PACKET);
+    writeUInt32(packet, 1, sequence);
+    writeUInt32(packet, 5, timestamp());
+    packet.append(payload);
+    m_sendDatagram(packet);
+}
+
+void QXmppDatagramChannel::sendAck(quint32 packetTimestamp, quint32 sequence)
+{
+    // ranges of the packets received out of order
+    std::vector<std::pair<quint32, quint32>> ranges;
+    for (auto itr = m_outOfOrder.cbegin(); itr != m_outOfOrder.cend(); ++itr) {
+        if (!ranges.empty() && ranges.back().second == itr.key()) {
+            ranges.back().second++;
+        } else {
+            ranges.emplace_back(itr.key(), itr.key() + 1);
+        }
+    }
+
+    // the block of the received packet comes first, then the most recent
+    // ones (RFC 2018)
+    std::reverse(ranges.begin(), ranges.end());
+    auto current = std::find_if(ranges.begin(), ranges.end(), [sequence](const auto &range) {
+        return range.first <= sequence && sequence < range.second;
+    });
+    if (current != ranges.end()) {
+        std::rotate(ranges.begin(), current, current + 1);
+    }
+
+    const auto blockCount = std::min(int(ranges.size()), MAX_SACK_BLOCKS);
+    QByteArray packet(ACK_HEADER_SIZE + blockCount * SACK_BLOCK_SIZE, Qt::Uninitialized);
+    packet[0] = char(ACK_PACKET);
+    writeUInt32(packet, 1, m_receiveNext);
+    writeUInt32(packet, 5, packetTimestamp);
+    writeUInt32(packet, 9, RECEIVE_WINDOW);
+    for (int i = 0; i < blockCount; i++) {
+        writeUInt32(packet, ACK_HEADER_SIZE + i * SACK_BLOCK_SIZE, ranges[i].first);
+        writeUInt32(packet, ACK_HEADER_SIZE + i * SACK_BLOCK_SIZE + 4, ranges[i].second);
+    }
+    m_sendDatagram(packet);
+}
+
+void QXmppDatagramChannel::trySend()
+{
+    const auto window = std::max(int(m_congestionWindow), 1);
+
+    // retransmissions first
+    for (auto itr = m_segments.begin(); m_lostCount > 0 && itr != m_segments.end() && packetsInFlight() < window; ++itr) {
+        if (itr->lost) {
+            itr->lost = false;
+            itr->retransmitted = true;
+            m_lostCount--;
+            sendData(itr.key(), itr->payload);
+        }
+    }
+
+    // new data, within the window of the receiver
+    while (m_sendOffset < m_sendBuffer.size() && packetsInFlight() < window) {
+        const auto lowestUnacked = m_segments.isEmpty() ? m_nextSequence : m_segments.firstKey();
+        if (m_nextSequence - lowestUnacked >= m_peerWindow) {
+            break;
+        }
+
+        const auto size = std::min(m_sendBuffer.size() - m_sendOffset, qsizetype(MaximumPayloadSize));
+        Segment segment;
+        segment.payload = m_sendBuffer.mid(m_sendOffset, size);
+        m_sendOffset += size;
+        m_segmentBytes += size;
+
+        const auto sequence = m_nextSequence++;
+        sendData(sequence, segment.payload);
+        m_segments.insert(sequence, std::move(segment));
+    }
+    if (m_sendOffset == m_sendBuffer.size()) {
+        m_sendBuffer.clear();
+        m_sendOffset = 0;
+    }
+
+    if (!m_segments.isEmpty() && !m_retransmissionTimer->isActive()) {
+        m_retransmissionTimer->start(int(m_rto));
+    }
+}
+
+// RFC 6298: Computing TCP's Retransmission Timer
+void QXmppDatagramChannel::updateRoundTripTime(qint64 sample)
+{
+    if (m_smoothedRtt < 0) {
+        m_smoothedRtt = sample;
+        m_rttVariation = sample / 2;
+    } else {
+        m_rttVariation = (3 * m_rttVariation + std::abs(m_smoothedRtt - sample)) / 4;
+        m_smoothedRtt = (7 * m_smoothedRtt + sample) / 8;
+    }
+    m_rto = qBound(MIN_RTO, m_smoothedRtt + std::max(qint64(1), 4 * m_rttVariation), MAX_RTO);
+}
+
+void QXmppDatagramChannel::retransmissionTimedOut()
+{
+    if (m_segments.isEmpty()) {
+        return;
+    }
+
+    if (++m_timeouts > MAX_TIMEOUTS) {
+        warning(QStringLiteral("Datagram channel timed out"));
+        Q_EMIT timedOut();
+        return;
+    }
+
+    // all packets are sent again, starting with a window of one packet; the
+    // selective acknowledgements are discarded, the receiver may have dropped
+    // the packets (RFC 2018, section 8)
+    m_slowStartThreshold = std::max(packetsInFlight() / 2.0, 2.0);
+    m_congestionWindow = 1;
+    m_inRecovery = false;
+    for (auto &segment : m_segments) {
+        segment.lost = true;
+        segment.sacked = false;
+        segment.retransmitted = false;
+    }
+    m_lostCount = int(m_segments.size());
+    m_sackedCount = 0;
+
+    // back off (RFC 6298, section 5.5)
+    m_rto = std::min(m_rto * 2, MAX_RTO);
+    m_retransmissionTimer->start(int(m_rto));
+    trySend();
+}
+
+quint32 QXmppDatagramChannel::timestamp() const
+{
+    // zero means that no timestamp is echoed
+    return quint32(m_clock.elapsed()) + 1;
+}
+
+// Number of packets sent, but neither acknowledged nor considered lost.
+int QXmppDatagramChannel::packetsInFlight() const
+{
+    return int(m_segments.size()) - m_sackedCount - m_lostCount;
+}
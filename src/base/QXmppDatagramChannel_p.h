@@ -0,0 +1,128 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPDATAGRAMCHANNEL_P_H
+#define QXMPPDATAGRAMCHANNEL_P_H
+
+#include "QXmppLogger.h"
+
+#include <functional>
+
+#include <QElapsedTimer>
+#include <QMap>
+
+class QTimer;
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+///
+/// The QXmppDatagramChannel class transfers a reliable, ordered byte stream
+/// over an unreliable datagram transport, e.g. a QXmppIceComponent.
+///
+/// The data is split into numbered packets, which are acknowledged by the
+/// receiver with cumulative and selective acknowledgements. Lost packets are
+/// retransmitted. The number of packets in flight is limited by a congestion
+/// window like in TCP with SACK (RFC 5681, RFC 6675): it grows exponentially
+/// (slow start) and then linearly, and is halved on packet loss. The
+/// retransmission timeout follows RFC 6298, using the round-trip times
+/// measured with timestamps echoed by the receiver.
+///
+class QXMPP_EXPORT QXmppDatagramChannel : public QXmppLoggable
+{
+    Q_OBJECT
+
+public:
+    using SendFunction = std::function<void(const QByteArray &datagram)>;
+
+    // payload size that fits into the MTU of most paths, including TURN
+    static constexpr int MaximumPayloadSize = 1200;
+
+    QXmppDatagramChannel(SendFunction sendDatagram, QObject *parent = nullptr);
+    ~QXmppDatagramChannel() override;
+
+    void write(const QByteArray &data);
+    qint64 bytesToWrite() const;
+
+    int congestionWindow() const;
+    int smoothedRoundTripTime() const;
+    int retransmissionTimeout() const;
+
+    static bool isDatagramChannelPacket(const QByteArray &datagram);
+
+public Q_SLOTS:
+    void handleDatagram(const QByteArray &datagram);
+
+Q_SIGNALS:
+    /// This signal is emitted when data has been received in order.
+    void dataReceived(const QByteArray &data);
+
+    /// This signal is emitted when written data has been acknowledged by the
+    /// peer.
+    void bytesWritten(qint64 bytes);
+
+    /// This signal is emitted when the peer did not acknowledge any data for
+    /// too many retransmissions.
+    void timedOut();
+
+private:
+    struct Segment
+    {
+        QByteArray payload;
+        // set when a packet with a higher sequence number has been selectively
+        // acknowledged three times
+        bool lost = false;
+        bool retransmitted = false;
+        bool sacked = false;
+    };
+
+    void handleAck(const QByteArray &datagram);
+    void handleData(const QByteArray &datagram);
+    void sendData(quint32 sequence, const QByteArray &payload);
+    void sendAck(quint32 timestamp, quint32 sequence);
+    void trySend();
+    void updateRoundTripTime(qint64 sample);
+    void retransmissionTimedOut();
+    quint32 timestamp() const;
+    int packetsInFlight() const;
+
+    SendFunction m_sendDatagram;
+    QElapsedTimer m_clock;
+
+    // sending
+    QByteArray m_sendBuffer;
+    // start of the data in the send buffer that has not been sent yet
+    qsizetype m_sendOffset = 0;
+    QMap<quint32, Segment> m_segments;
+    qint64 m_segmentBytes = 0;
+    int m_sackedCount = 0;
+    int m_lostCount = 0;
+    quint32 m_nextSequence = 0;
+    double m_congestionWindow;
+    double m_slowStartThreshold;
+    // set during loss recovery, until everything sent before has been acknowledged
+    bool m_inRecovery = false;
+    quint32 m_recoveryPoint = 0;
+    quint32 m_peerWindow;
+    qint64 m_smoothedRtt = -1;
+    qint64 m_rttVariation = 0;
+    qint64 m_rto;
+    int m_timeouts = 0;
+    QTimer *m_retransmissionTimer;
+
+    // receiving
+    quint32 m_receiveNext = 0;
+    QMap<quint32, QByteArray> m_outOfOrder;
+};
+
+#endif  // QXMPPDATAGRAMCHANNEL_P_H
@@ -378,6 +378,17 @@ void QXmppDiscoveryIq::setQueryType(enum QXmppDiscoveryIq::QueryType type)
 /// Calculate the verification string for \xep{0115, Entity Capabilities}.
 ///
 QByteArray QXmppDiscoveryIq::verificationString() const
+{
+    return verificationString(QCryptographicHash::Sha1);
+}
+
+///
+/// Calculate the verification string for \xep{0115, Entity Capabilities}
+/// using the given hash algorithm.
+///
+/// \since QXmpp 1.6
+///
+QByteArray QXmppDiscoveryIq::verificationString(QCryptographicHash::Algorithm algorithm) const
 {
     QString S;
     QList<QXmppDiscoveryIq::Identity> sortedIdentities = d->identities;
@@ -422,7 +433,7 @@ QByteArray QXmppDiscoveryIq::verificationString() const
         }
     }
 
-    QCryptographicHash hasher(QCryptographicHash::Sha1);
+    QCryptographicHash hasher(algorithm);
     hasher.addData(S.toUtf8());
     return hasher.result();
 }
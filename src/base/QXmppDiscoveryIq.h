@@ -8,6 +8,7 @@
 #include "QXmppDataForm.h"
 #include "QXmppIq.h"
 
+#include <QCryptographicHash>
 #include <QSharedDataPointer>
 
 class QXmppDiscoveryIdentityPrivate;
@@ -100,6 +101,7 @@ public:
     void setQueryType(enum QueryType type);
 
     QByteArray verificationString() const;
+    QByteArray verificationString(QCryptographicHash::Algorithm algorithm) const;
 
     static bool isDiscoveryIq(const QDomElement &element);
     /// \cond
@@ -0,0 +1,198 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppDnsCache_p.h"
+
+#include "QXmppPromise.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+
+using namespace QXmpp::Private;
+using ServiceResult = DnsCache::ServiceResult;
+
+struct DnsCacheEntry
+{
+    ServiceResult result;
+    QDeadlineTimer expiry;
+    QDeadlineTimer refresh;
+    bool refreshing = false;
+};
+
+class QXmpp::Private::DnsCachePrivate
+{
+public:
+    void cache(const QString &name, const ServiceResult &result);
+
+    // the cache is shared by the streams of all threads
+    QMutex mutex;
+    DnsCache::ServiceResolver resolver;
+    QHash<QString, DnsCacheEntry> entries;
+
+    // requests waiting for a running lookup of the same name, per thread as
+    // tasks may only be used in the thread they have been created in
+    QHash<QThread *, QHash<QString, std::vector<QXmppPromise<ServiceResult>>>> pendingLookups;
+};
+
+void DnsCachePrivate::cache(const QString &name, const ServiceResult &result)
+{
+    quint32 timeToLive = DnsCache::NegativeTimeToLive;
+    if (result.error == QDnsLookup::NoError && !result.records.isEmpty()) {
+        // the cached response is only valid as long as its shortest-lived record
+        timeToLive = std::min_element(result.records.cbegin(), result.records.cend(), [](const auto &a, const auto &b) {
+                         return a.timeToLive < b.timeToLive;
+                     })->timeToLive;
+        timeToLive = std::min(timeToLive, DnsCache::MaximumTimeToLive);
+    } else if (result.error != QDnsLookup::NoError && result.error != QDnsLookup::NotFoundError) {
+        // temporary error, keep using the existing entry until it expires
+        if (const auto itr = entries.find(name); itr != entries.end()) {
+            itr->refreshing = false;
+        }
+        return;
+    }
+
+    const qint64 msecs = qint64(timeToLive) * 1000;
+    entries.insert(name, DnsCacheEntry { result, QDeadlineTimer(msecs), QDeadlineTimer(msecs / 4 * 3), false });
+}
+
+static QXmppTask<ServiceResult> lookupServiceRecords(const QString &name)
+{
+    QXmppPromise<ServiceResult> promise;
+    auto task = promise.task();
+
+    auto *dns = new QDnsLookup(QDnsLookup::SRV, name);
+    QObject::connect(dns, &QDnsLookup::finished, dns, [dns, promise]() mutable {
+        ServiceResult result;
+        result.error = dns->error();
+        result.errorString = dns->errorString();
+
+        const auto records = dns->serviceRecords();
+        result.records.reserve(records.size());
+        for (const auto &record : records) {
+            result.records.push_back({ record.target(), record.port(), record.priority(), record.weight(), record.timeToLive() });
+        }
+
+        promise.finish(std::move(result));
+        dns->deleteLater();
+    });
+    dns->lookup();
+
+    return task;
+}
+
+DnsCache::DnsCache()
+    : d(std::make_unique<DnsCachePrivate>())
+{
+}
+
+DnsCache::~DnsCache() = default;
+
+Q_GLOBAL_STATIC(DnsCache, dnsCache)
+
+//
+// Returns the cache shared by all streams.
+//
+DnsCache *DnsCache::instance()
+{
+    return dnsCache();
+}
+
+//
+// Looks up the SRV records of the given name, e.g. "_xmpp-client._tcp.example.org".
+//
+QXmppTask<ServiceResult> DnsCache::lookupService(const QString &name)
+{
+    const auto key = name.toLower();
+    auto *thread = QThread::currentThread();
+
+    QXmppPromise<ServiceResult> promise;
+    auto task = promise.task();
+
+    {
+        QMutexLocker locker(&d->mutex);
+        if (const auto itr = d->entries.find(key); itr != d->entries.end()) {
+            if (!itr->expiry.hasExpired()) {
+                promise.finish(ServiceResult(itr->result));
+
+                // refresh the entry before it expires
+                if (!itr->refresh.hasExpired() || itr->refreshing) {
+                    return task;
+                }
+                itr->refreshing = true;
+                locker.unlock();
+
+                startLookup(key);
+                return task;
+            }
+            d->entries.erase(itr);
+        }
+
+        auto &pending = d->pendingLookups[thread][key];
+        pending.push_back(std::move(promise));
+        if (pending.size() > 1) {
+            return task;
+        }
+    }
+
+    startLookup(key);
+    return task;
+}
+
+//
+// Sets the function that does the DNS queries. This allows to test the cache
+// and its users without a network.
+//
+// An empty function restores the default, which uses QDnsLookup.
+//
+void DnsCache::setServiceResolver(ServiceResolver resolver)
+{
+    QMutexLocker locker(&d->mutex);
+    d->resolver = std::move(resolver);
+}
+
+//
+// Removes all cached results.
+//
+void DnsCache::clear()
+{
+    QMutexLocker locker(&d->mutex);
+    d->entries.clear();
+}
+
+void DnsCache::startLookup(const QString &name)
+{
+    ServiceResolver resolver;
+    {
+        QMutexLocker locker(&d->mutex);
+        resolver = d->resolver;
+    }
+
+    auto *thread = QThread::currentThread();
+
+    // lives in the calling thread until the lookup has finished
+    auto *context = new QObject;
+    (resolver ? resolver(name) : lookupServiceRecords(name)).then(context, [this, name, thread, context](ServiceResult &&result) {
+        std::vector<QXmppPromise<ServiceResult>> promises;
+        {
+            QMutexLocker locker(&d->mutex);
+            d->cache(name, result);
+
+            auto &lookups = d->pendingLookups[thread];
+            promises = lookups.take(name);
+            if (lookups.isEmpty()) {
+                d->pendingLookups.remove(thread);
+            }
+        }
+
+        for (auto &promise : promises) {
+            promise.finish(ServiceResult(result));
+        }
+        context->deleteLater();
+    });
+}
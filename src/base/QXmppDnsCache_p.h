@@ -0,0 +1,96 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPDNSCACHE_P_H
+#define QXMPPDNSCACHE_P_H
+
+#include "QXmppGlobal.h"
+#include "QXmppTask.h"
+
+#include <functional>
+#include <memory>
+
+#include <QDnsLookup>
+#include <QVector>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API. It exists for the convenience
+// of QXmppOutgoingClient and QXmppOutgoingServer.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+namespace QXmpp::Private {
+
+class DnsCachePrivate;
+
+//
+// Process-wide cache of DNS SRV lookups.
+//
+// Results are cached as long as the TTL of their records allows. Entries are
+// refreshed in the background shortly before they expire, so following
+// lookups are answered from the cache. Names without SRV records are cached
+// for NegativeTimeToLive seconds, temporary errors are not cached.
+//
+// The cache is shared by the streams of all threads. Concurrent lookups of
+// the same name in one thread share a single DNS query.
+//
+// Host addresses are not cached here: they are resolved using QHostInfo,
+// which keeps a process-wide cache of its own.
+//
+class QXMPP_AUTOTEST_EXPORT DnsCache
+{
+public:
+    struct ServiceRecord
+    {
+        QString target;
+        quint16 port = 0;
+        quint16 priority = 0;
+        quint16 weight = 0;
+        // in seconds
+        quint32 timeToLive = 0;
+    };
+
+    struct ServiceResult
+    {
+        // sorted by priority and weight
+        QVector<ServiceRecord> records;
+        QDnsLookup::Error error = QDnsLookup::NoError;
+        QString errorString;
+    };
+
+    // Called in the thread requesting the lookup, the task must be finished
+    // in the same thread.
+    using ServiceResolver = std::function<QXmppTask<ServiceResult>(const QString &name)>;
+
+    // RFC 2308 recommends one to three hours, but servers are often moved
+    // to new hosts while they are being set up
+    static constexpr quint32 NegativeTimeToLive = 300;
+    static constexpr quint32 MaximumTimeToLive = 86400;
+
+    DnsCache();
+    ~DnsCache();
+
+    static DnsCache *instance();
+
+    QXmppTask<ServiceResult> lookupService(const QString &name);
+
+    void setServiceResolver(ServiceResolver resolver);
+    void clear();
+
+private:
+    void startLookup(const QString &name);
+
+    const std::unique_ptr<DnsCachePrivate> d;
+};
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPDNSCACHE_P_H
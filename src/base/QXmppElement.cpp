@@ -6,8 +6,11 @@
 
 #include "QXmppUtils.h"
 
+#include <algorithm>
+#include <optional>
+
 #include <QDomElement>
-#include <QTextStream>
+#include <QVarLengthArray>
 
 class QXmppElementPrivate
 {
@@ -16,6 +19,8 @@ public:
     QXmppElementPrivate(const QDomElement &element);
     ~QXmppElementPrivate();
 
+    void materialize();
+
     QAtomicInt counter = 1;
 
     QXmppElementPrivate *parent = nullptr;
@@ -24,7 +29,10 @@ public:
     QString name;
     QString value;
 
-    QByteArray serializedSource;
+    // The attributes, children and value are only read from the source
+    // element when they are accessed.
+    QDomElement source;
+    bool materialized = true;
 };
 
 QXmppElementPrivate::QXmppElementPrivate(const QDomElement &element)
@@ -34,18 +42,29 @@ QXmppElementPrivate::QXmppElementPrivate(const QDomElement &element)
     }
 
     name = element.tagName();
-    QString xmlns = element.namespaceURI();
-    QString parentns = element.parentNode().namespaceURI();
+    source = element;
+    materialized = false;
+}
+
+void QXmppElementPrivate::materialize()
+{
+    if (materialized) {
+        return;
+    }
+    materialized = true;
+
+    QString xmlns = source.namespaceURI();
+    QString parentns = source.parentNode().namespaceURI();
     if (!xmlns.isEmpty() && xmlns != parentns) {
         attributes.insert("xmlns", xmlns);
     }
-    QDomNamedNodeMap attrs = element.attributes();
+    QDomNamedNodeMap attrs = source.attributes();
     for (int i = 0; i < attrs.size(); i++) {
         QDomAttr attr = attrs.item(i).toAttr();
         attributes.insert(attr.name(), attr.value());
     }
 
-    for (auto childNode = element.firstChild();
+    for (auto childNode = source.firstChild();
          !childNode.isNull();
          childNode = childNode.nextSibling()) {
         if (childNode.isElement()) {
@@ -56,9 +75,54 @@ QXmppElementPrivate::QXmppElementPrivate(const QDomElement &element)
             value += childNode.toText().data();
         }
     }
+}
+
+// Writes the element like a materialized QXmppElement, without creating one.
+static void writeDomElement(QXmlStreamWriter *writer, const QDomElement &element)
+{
+    writer->writeStartElement(element.tagName());
+
+    std::optional<QString> xmlns;
+    if (const auto ns = element.namespaceURI(); !ns.isEmpty() && ns != element.parentNode().namespaceURI()) {
+        xmlns = ns;
+    }
+
+    // sorted by name like the attribute map
+    const auto attrs = element.attributes();
+    QVarLengthArray<QDomAttr, 8> sortedAttrs;
+    for (int i = 0; i < attrs.size(); i++) {
+        auto attr = attrs.item(i).toAttr();
+        if (attr.name() == u"xmlns") {
+            xmlns = attr.value();
+        } else {
+            sortedAttrs.append(attr);
+        }
+    }
+    std::sort(sortedAttrs.begin(), sortedAttrs.end(), [](const QDomAttr &a, const QDomAttr &b) {
+        return a.name() < b.name();
+    });
+
+    if (xmlns) {
+        writer->writeDefaultNamespace(*xmlns);
+    }
+    for (const auto &attr : std::as_const(sortedAttrs)) {
+        helperToXmlAddAttribute(writer, attr.name(), attr.value());
+    }
+
+    QString value;
+    for (auto childNode = element.firstChild(); !childNode.isNull(); childNode = childNode.nextSibling()) {
+        if (childNode.isText()) {
+            value += childNode.toText().data();
+        }
+    }
+    if (!value.isEmpty()) {
+        writer->writeCharacters(value);
+    }
 
-    QTextStream stream(&serializedSource);
-    element.save(stream, 0);
+    for (auto child = element.firstChildElement(); !child.isNull(); child = child.nextSiblingElement()) {
+        writeDomElement(writer, child);
+    }
+    writer->writeEndElement();
 }
 
 QXmppElementPrivate::~QXmppElementPrivate()
@@ -100,7 +164,11 @@ QXmppElement::QXmppElement(QXmppElementPrivate *other)
 }
 
 ///
-/// Copy-construct DOM element contents
+/// Constructs an element from DOM element contents.
+///
+/// The DOM element is referenced and only read when the attributes, children
+/// or the value are accessed, so unknown extensions that are only passed on
+/// are cheap.
 ///
 QXmppElement::QXmppElement(const QDomElement &element)
 {
@@ -133,22 +201,15 @@ QXmppElement &QXmppElement::operator=(const QXmppElement &other)
 ///
 /// Creates a DOM element from the source element
 ///
-/// The source DOM element is saved as XML and needs to be parsed again in this
-/// step.
+/// Returns a copy of the DOM element the element has been created from, changes
+/// to this element are not included.
 ///
 QDomElement QXmppElement::sourceDomElement() const
 {
-    if (d->serializedSource.isEmpty()) {
+    if (d->source.isNull()) {
         return QDomElement();
     }
-
-    QDomDocument doc;
-    if (!doc.setContent(d->serializedSource, true)) {
-        qWarning("[QXmpp] QXmppElement::sourceDomElement(): cannot parse source element");
-        return QDomElement();
-    }
-
-    return doc.documentElement();
+    return d->source.cloneNode(true).toElement();
 }
 
 ///
@@ -156,6 +217,7 @@ QDomElement QXmppElement::sourceDomElement() const
 ///
 QStringList QXmppElement::attributeNames() const
 {
+    d->materialize();
     return d->attributes.keys();
 }
 
@@ -164,6 +226,7 @@ QStringList QXmppElement::attributeNames() const
 ///
 QString QXmppElement::attribute(const QString &name) const
 {
+    d->materialize();
     return d->attributes.value(name);
 }
 
@@ -172,6 +235,7 @@ QString QXmppElement::attribute(const QString &name) const
 ///
 void QXmppElement::setAttribute(const QString &name, const QString &value)
 {
+    d->materialize();
     d->attributes.insert(name, value);
 }
 
@@ -180,6 +244,7 @@ void QXmppElement::setAttribute(const QString &name, const QString &value)
 ///
 void QXmppElement::appendChild(const QXmppElement &child)
 {
+    d->materialize();
     if (child.d->parent == d) {
         return;
     }
@@ -199,6 +264,7 @@ void QXmppElement::appendChild(const QXmppElement &child)
 ///
 QXmppElement QXmppElement::firstChildElement(const QString &name) const
 {
+    d->materialize();
     for (auto *child_d : std::as_const(d->children)) {
         if (name.isEmpty() || child_d->name == name) {
             return QXmppElement(child_d);
@@ -238,6 +304,7 @@ bool QXmppElement::isNull() const
 ///
 void QXmppElement::removeChild(const QXmppElement &child)
 {
+    d->materialize();
     if (child.d->parent != d) {
         return;
     }
@@ -260,6 +327,7 @@ QString QXmppElement::tagName() const
 ///
 void QXmppElement::setTagName(const QString &tagName)
 {
+    d->materialize();
     d->name = tagName;
 }
 
@@ -268,6 +336,7 @@ void QXmppElement::setTagName(const QString &tagName)
 ///
 QString QXmppElement::value() const
 {
+    d->materialize();
     return d->value;
 }
 
@@ -276,6 +345,7 @@ QString QXmppElement::value() const
 ///
 void QXmppElement::setValue(const QString &value)
 {
+    d->materialize();
     d->value = value;
 }
 
@@ -287,6 +357,10 @@ void QXmppElement::toXml(QXmlStreamWriter *writer) const
     if (isNull()) {
         return;
     }
+    if (!d->materialized) {
+        writeDomElement(writer, d->source);
+        return;
+    }
 
     writer->writeStartElement(d->name);
     if (d->attributes.contains("xmlns")) {
@@ -0,0 +1,121 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPENUMSTRINGS_P_H
+#define QXMPPENUMSTRINGS_P_H
+
+#include <array>
+#include <cstddef>
+#include <optional>
+
+#include <QString>
+#include <QStringView>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+namespace QXmpp::Private {
+
+//
+// Compile-time mapping between the values of an enum and their strings in XML.
+//
+// The values of the enum need to be consecutive and start at zero, the string
+// at index i belongs to the value i. An empty string can be used for a value
+// that isn't serialized.
+//
+// An index of the strings sorted by length and content is built at compile
+// time, so parsing is a binary search directly on the input. Neither parsing
+// nor serializing constructs any strings.
+//
+template<typename Enum, std::size_t N>
+class EnumStrings
+{
+public:
+    constexpr explicit EnumStrings(const std::array<QStringView, N> &strings)
+        : m_strings(strings)
+    {
+        // insertion sort, std::sort isn't constexpr in C++17
+        for (std::size_t i = 0; i < N; i++) {
+            m_sorted[i] = i;
+        }
+        for (std::size_t i = 1; i < N; i++) {
+            for (std::size_t j = i; j > 0 && compare(m_strings[m_sorted[j]], m_strings[m_sorted[j - 1]]) < 0; j--) {
+                const auto index = m_sorted[j];
+                m_sorted[j] = m_sorted[j - 1];
+                m_sorted[j - 1] = index;
+            }
+        }
+    }
+
+    constexpr QStringView toStringView(Enum value) const
+    {
+        const auto index = std::size_t(value);
+        return index < N ? m_strings[index] : QStringView();
+    }
+
+    // The returned string refers to the static data of the table.
+    QString toString(Enum value) const
+    {
+        const auto string = toStringView(value);
+        return QString::fromRawData(reinterpret_cast<const QChar *>(string.utf16()), int(string.size()));
+    }
+
+    std::optional<Enum> fromString(QStringView string) const
+    {
+        std::size_t low = 0;
+        std::size_t high = N;
+        while (low < high) {
+            const auto middle = low + (high - low) / 2;
+            const auto result = compare(m_strings[m_sorted[middle]], string);
+            if (result == 0) {
+                return Enum(m_sorted[middle]);
+            }
+            if (result < 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return {};
+    }
+
+private:
+    // orders by length first, which is cheaper than comparing the characters
+    static constexpr int compare(QStringView a, QStringView b)
+    {
+        if (a.size() != b.size()) {
+            return a.size() < b.size() ? -1 : 1;
+        }
+        for (qsizetype i = 0; i < a.size(); i++) {
+            if (a.utf16()[i] != b.utf16()[i]) {
+                return a.utf16()[i] < b.utf16()[i] ? -1 : 1;
+            }
+        }
+        return 0;
+    }
+
+    std::array<QStringView, N> m_strings;
+    std::array<std::size_t, N> m_sorted = {};
+};
+
+// Creates the table from string literals, e.g.
+// enumStrings<QXmppIq::Type>(u"error", u"get", u"set", u"result").
+template<typename Enum, std::size_t... Sizes>
+constexpr auto enumStrings(const char16_t (&...strings)[Sizes])
+{
+    return EnumStrings<Enum, sizeof...(Sizes)>({ QStringView(strings, qsizetype(Sizes - 1))... });
+}
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPENUMSTRINGS_P_H
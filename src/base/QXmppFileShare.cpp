@@ -8,6 +8,7 @@
 #include "QXmppEncryptedFileSource.h"
 #include "QXmppFileMetadata.h"
 #include "QXmppHttpFileSource.h"
+#include "QXmppUtils_p.h"
 
 #include <optional>
 
@@ -15,6 +16,8 @@
 #include <QUrl>
 #include <QXmlStreamWriter>
 
+using namespace QXmpp::Private;
+
 using Disposition = QXmppFileShare::Disposition;
 
 static std::optional<Disposition> dispositionFromString(const QString &str)
@@ -150,7 +153,7 @@ void QXmppFileShare::addSource(const std::any &source)
 
 bool QXmppFileShare::parse(const QDomElement &el)
 {
-    if (el.tagName() == "file-sharing" && el.namespaceURI() == ns_sfs) {
+    if (isElement(el, u"file-sharing", ns_sfs)) {
         // disposition
         d->disposition = dispositionFromString(el.attribute("disposition"))
                              .value_or(Disposition::Inline);
@@ -142,6 +142,7 @@ template<typename Result, typename Input, typename Converter>
 auto chain(QXmppTask<Input> &&source, QObject *context, Converter task) -> QXmppTask<Result>
 {
     QXmppPromise<Result> promise;
+    promise.forwardCancellation(source);
 
     source.then(context, [=](Input &&input) mutable {
         promise.finish(task(std::move(input)));
@@ -0,0 +1,274 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppHappyEyeballs_p.h"
+
+#include <algorithm>
+
+#include <QHostInfo>
+#include <QNetworkProxy>
+#include <QTcpSocket>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace QXmpp::Private;
+
+// RFC 8305, section 4: the first address family that is returned is tried
+// first, after that the address families alternate
+static QList<QHostAddress> interleaveAddressFamilies(const QList<QHostAddress> &addresses)
+{
+    if (addresses.isEmpty()) {
+        return {};
+    }
+
+    const auto firstFamily = addresses.first().protocol();
+    QList<QHostAddress> first, second;
+    for (const auto &address : addresses) {
+        (address.protocol() == firstFamily ? first : second).append(address);
+    }
+
+    QList<QHostAddress> result;
+    result.reserve(addresses.size());
+    for (qsizetype i = 0; i < std::max(first.size(), second.size()); i++) {
+        if (i < first.size()) {
+            result.append(first.at(i));
+        }
+        if (i < second.size()) {
+            result.append(second.at(i));
+        }
+    }
+    return result;
+}
+
+HappyEyeballs::HappyEyeballs(QObject *parent)
+    : QXmppLoggable(parent)
+{
+    m_attemptTimer.setSingleShot(true);
+    m_attemptTimer.setInterval(ConnectionAttemptDelay);
+    connect(&m_attemptTimer, &QTimer::timeout, this, &HappyEyeballs::startNextAttempt);
+}
+
+HappyEyeballs::~HappyEyeballs()
+{
+    abort();
+}
+
+//
+// Returns whether connections with the proxy are made directly to the host,
+// so the connections can be raced and transferred to another socket.
+//
+bool HappyEyeballs::canConnectDirectly(const QNetworkProxy &proxy)
+{
+    if (proxy.type() == QNetworkProxy::DefaultProxy) {
+        return QNetworkProxy::applicationProxy().type() == QNetworkProxy::NoProxy;
+    }
+    return proxy.type() == QNetworkProxy::NoProxy;
+}
+
+//
+// Connects to one of the targets, which are sorted by preference.
+//
+// Running attempts from a previous call are cancelled.
+//
+void HappyEyeballs::connectToHosts(const QVector<Target> &targets)
+{
+    abort();
+
+    m_targets = targets;
+    m_addresses.resize(targets.size());
+    m_errorString.clear();
+
+    if (targets.isEmpty()) {
+        Q_EMIT failed(QStringLiteral("No hosts to connect to"));
+        return;
+    }
+
+    for (int i = 0; i < targets.size(); i++) {
+        const auto &target = targets.at(i);
+        if (QHostAddress address(target.host); !address.isNull()) {
+            m_addresses[i] = { address };
+            continue;
+        }
+
+        m_pendingLookups++;
+        m_lookupIds.push_back(QHostInfo::lookupHost(target.host, this, [this, i](const QHostInfo &info) {
+            handleLookup(i, info);
+        }));
+    }
+
+    startNextAttempt();
+}
+
+//
+// Cancels all lookups and connection attempts.
+//
+void HappyEyeballs::abort()
+{
+    for (auto id : m_lookupIds) {
+        QHostInfo::abortHostLookup(id);
+    }
+    m_lookupIds.clear();
+    m_pendingLookups = 0;
+    m_attemptTimer.stop();
+    clearAttempts();
+    closeWinner();
+    m_targets.clear();
+    m_addresses.clear();
+}
+
+//
+// Returns true while lookups or connection attempts are running.
+//
+bool HappyEyeballs::isConnecting() const
+{
+    return m_pendingLookups > 0 || !m_attempts.empty();
+}
+
+//
+// Transfers the established connection to the given socket.
+//
+// Returns false if the connection cannot be transferred on this platform. The
+// socket then needs to connect to the address reported by connected() itself.
+//
+bool HappyEyeballs::moveConnectionTo(QAbstractSocket *socket)
+{
+    if (!m_winner) {
+        return false;
+    }
+
+    bool moved = false;
+#ifdef Q_OS_UNIX
+    // the duplicated descriptor keeps the connection open after the winner
+    // has been closed
+    if (const auto descriptor = ::fcntl(m_winner->socketDescriptor(), F_DUPFD_CLOEXEC, 0); descriptor >= 0) {
+        moved = socket->setSocketDescriptor(descriptor);
+        if (!moved) {
+            ::close(descriptor);
+        }
+    }
+#else
+    Q_UNUSED(socket);
+#endif
+
+    closeWinner();
+    return moved;
+}
+
+void HappyEyeballs::setConnectionAttemptDelay(int msecs)
+{
+    m_attemptTimer.setInterval(msecs);
+}
+
+void HappyEyeballs::handleLookup(int target, const QHostInfo &info)
+{
+    m_pendingLookups--;
+    m_lookupIds.erase(std::remove(m_lookupIds.begin(), m_lookupIds.end(), info.lookupId()), m_lookupIds.end());
+
+    if (info.error() != QHostInfo::NoError) {
+        warning(QStringLiteral("Lookup of %1 failed: %2").arg(info.hostName(), info.errorString()));
+        m_errorString = info.errorString();
+    } else {
+        m_addresses[target] = interleaveAddressFamilies(info.addresses());
+    }
+
+    // wait for the delay if another attempt has just been started
+    if (!m_attemptTimer.isActive()) {
+        startNextAttempt();
+    }
+}
+
+void HappyEyeballs::startNextAttempt()
+{
+    // the first target with known addresses is tried, so a slow lookup of
+    // a preferred host does not delay the connection
+    const auto next = std::find_if(m_addresses.begin(), m_addresses.end(), [](const auto &addresses) {
+        return !addresses.isEmpty();
+    });
+
+    if (next == m_addresses.end()) {
+        if (m_attempts.empty() && m_pendingLookups == 0 && !m_targets.isEmpty()) {
+            m_targets.clear();
+            m_addresses.clear();
+            Q_EMIT failed(m_errorString);
+        }
+        return;
+    }
+
+    const auto target = int(std::distance(m_addresses.begin(), next));
+    const auto address = next->takeFirst();
+    const auto port = m_targets.at(target).port;
+
+    info(QStringLiteral("Connecting to %1 (%2:%3)").arg(m_targets.at(target).host, address.toString(), QString::number(port)));
+
+    auto *socket = new QTcpSocket(this);
+    socket->setProxy(QNetworkProxy::NoProxy);
+    connect(socket, &QAbstractSocket::connected, this, [this, socket]() {
+        handleAttemptConnected(socket);
+    });
+    connect(socket, &QAbstractSocket::errorOccurred, this, [this, socket]() {
+        handleAttemptFailed(socket);
+    });
+    m_attempts.push_back({ socket, target, address, port });
+    socket->connectToHost(address, port);
+
+    m_attemptTimer.start();
+}
+
+void HappyEyeballs::handleAttemptConnected(QTcpSocket *socket)
+{
+    m_attempts.erase(std::remove_if(m_attempts.begin(), m_attempts.end(), [=](const auto &entry) {
+                         return entry.socket == socket;
+                     }),
+                     m_attempts.end());
+    socket->disconnect(this);
+
+    // cancel everything else
+    abort();
+
+    m_winner = socket;
+    Q_EMIT connected(socket->peerAddress(), socket->peerPort());
+}
+
+void HappyEyeballs::handleAttemptFailed(QTcpSocket *socket)
+{
+    const auto attempt = std::find_if(m_attempts.begin(), m_attempts.end(), [=](const auto &entry) {
+        return entry.socket == socket;
+    });
+    if (attempt == m_attempts.end()) {
+        return;
+    }
+
+    warning(QStringLiteral("Connection to %1 (%2:%3) failed: %4").arg(m_targets.at(attempt->target).host, attempt->address.toString(), QString::number(attempt->port), socket->errorString()));
+    m_errorString = socket->errorString();
+
+    m_attempts.erase(attempt);
+    socket->disconnect(this);
+    socket->deleteLater();
+
+    // RFC 8305, section 5: don't wait for the delay after a failure
+    m_attemptTimer.stop();
+    startNextAttempt();
+}
+
+void HappyEyeballs::clearAttempts()
+{
+    for (const auto &attempt : std::as_const(m_attempts)) {
+        attempt.socket->disconnect(this);
+        attempt.socket->abort();
+        attempt.socket->deleteLater();
+    }
+    m_attempts.clear();
+}
+
+void HappyEyeballs::closeWinner()
+{
+    if (m_winner) {
+        m_winner->abort();
+        m_winner->deleteLater();
+        m_winner = nullptr;
+    }
+}
@@ -0,0 +1,108 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPHAPPYEYEBALLS_P_H
+#define QXMPPHAPPYEYEBALLS_P_H
+
+#include "QXmppLogger.h"
+
+#include <vector>
+
+#include <QHostAddress>
+#include <QList>
+#include <QTimer>
+#include <QVector>
+
+class QAbstractSocket;
+class QHostInfo;
+class QNetworkProxy;
+class QTcpSocket;
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API. It exists for the convenience
+// of QXmppOutgoingClient and QXmppOutgoingServer.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+namespace QXmpp::Private {
+
+//
+// Connects to one of multiple hosts as described in RFC 8305 (Happy Eyeballs).
+//
+// The addresses of all hosts are resolved in parallel. TCP connections are
+// started one after another with a short delay, alternating the address
+// families. The first established connection wins, all other attempts are
+// cancelled.
+//
+class QXMPP_AUTOTEST_EXPORT HappyEyeballs : public QXmppLoggable
+{
+    Q_OBJECT
+
+public:
+    struct Target
+    {
+        QString host;
+        quint16 port = 0;
+    };
+
+    // maximum number of SRV targets that should be raced at once
+    static constexpr int MaxTargets = 2;
+    // RFC 8305, section 5: Connection Attempt Delay
+    static constexpr int ConnectionAttemptDelay = 250;
+
+    explicit HappyEyeballs(QObject *parent = nullptr);
+    ~HappyEyeballs() override;
+
+    static bool canConnectDirectly(const QNetworkProxy &proxy);
+
+    void connectToHosts(const QVector<Target> &targets);
+    void abort();
+    bool isConnecting() const;
+
+    bool moveConnectionTo(QAbstractSocket *socket);
+
+    void setConnectionAttemptDelay(int msecs);
+
+    // Emitted with the address of the first established connection.
+    Q_SIGNAL void connected(const QHostAddress &address, quint16 port);
+    // Emitted when no connection could be established.
+    Q_SIGNAL void failed(const QString &errorString);
+
+private:
+    struct Attempt
+    {
+        QTcpSocket *socket;
+        int target;
+        QHostAddress address;
+        quint16 port;
+    };
+
+    void handleLookup(int target, const QHostInfo &info);
+    void startNextAttempt();
+    void handleAttemptConnected(QTcpSocket *socket);
+    void handleAttemptFailed(QTcpSocket *socket);
+    void clearAttempts();
+    void closeWinner();
+
+    QVector<Target> m_targets;
+    // addresses of each target that have not been tried yet
+    std::vector<QList<QHostAddress>> m_addresses;
+    std::vector<int> m_lookupIds;
+    int m_pendingLookups = 0;
+    std::vector<Attempt> m_attempts;
+    QTcpSocket *m_winner = nullptr;
+    QTimer m_attemptTimer;
+    QString m_errorString;
+};
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPHAPPYEYEBALLS_P_H
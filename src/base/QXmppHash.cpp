@@ -5,11 +5,13 @@
 #include "QXmppHash.h"
 
 #include "QXmppConstants_p.h"
+#include "QXmppUtils_p.h"
 
 #include <QDomElement>
 #include <QXmlStreamWriter>
 
 using namespace QXmpp;
+using namespace QXmpp::Private;
 
 ///
 /// \enum QXmpp::HashAlgorithm
@@ -51,6 +53,8 @@ static QString algorithmToString(HashAlgorithm algorithm)
         return QStringLiteral("blake2b-256");
     case HashAlgorithm::Blake2b_512:
         return QStringLiteral("blake2b-512");
+    case HashAlgorithm::Blake3:
+        return QStringLiteral("blake3");
     }
     Q_UNREACHABLE();
 }
@@ -96,6 +100,9 @@ static HashAlgorithm hashAlgorithmFromString(const QString &str)
     if (str == "blake2b-512") {
         return HashAlgorithm::Blake2b_512;
     }
+    if (str == "blake3") {
+        return HashAlgorithm::Blake3;
+    }
     return HashAlgorithm::Unknown;
 }
 
@@ -112,7 +119,7 @@ QXmppHash::QXmppHash() = default;
 /// \cond
 bool QXmppHash::parse(const QDomElement &el)
 {
-    if (el.tagName() == "hash" && el.namespaceURI() == ns_hashes) {
+    if (isElement(el, u"hash", ns_hashes)) {
         m_algorithm = hashAlgorithmFromString(el.attribute("algo"));
         if (auto hashResult = QByteArray::fromBase64Encoding(el.text().toUtf8())) {
             m_hash = std::move(*hashResult);
@@ -155,7 +162,7 @@ QXmppHashUsed::QXmppHashUsed(QXmpp::HashAlgorithm algorithm)
 /// \cond
 bool QXmppHashUsed::parse(const QDomElement &el)
 {
-    if (el.tagName() == "hash-used" && el.namespaceURI() == ns_hashes) {
+    if (isElement(el, u"hash-used", ns_hashes)) {
         m_algorithm = hashAlgorithmFromString(el.attribute("algo"));
     }
     return false;
@@ -2,11 +2,13 @@
 //
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#include "QXmppBlake3_p.h"
 #include "QXmppFutureUtils_p.h"
 #include "QXmppHash.h"
 #include "QXmppHashing_p.h"
 
 #include <QCryptographicHash>
+#include <QFile>
 #include <QFuture>
 #include <QFutureInterface>
 #include <QIODevice>
@@ -18,57 +20,12 @@ using namespace QXmpp::Private;
 
 class HashGenerator;
 
-// 8 kB
+// 32 kB
 constexpr std::size_t PROCESS_SYNC_MAX_SIZE = 32 * 1024;
-// 512 kB (two buffers are used so 1 MB)
-constexpr std::size_t BUFFER_SIZE = 512 * 1024;
+// buffer size for reading synchronously processed data
+constexpr std::size_t SYNC_BUFFER_SIZE = 4 * 1024;
 
 /// \cond
-static HashAlgorithm toHashAlgorithm(QCryptographicHash::Algorithm algorithm)
-{
-    switch (algorithm) {
-    case QCryptographicHash::Md4:
-    case QCryptographicHash::Keccak_224:
-    case QCryptographicHash::Keccak_256:
-    case QCryptographicHash::Keccak_384:
-    case QCryptographicHash::Keccak_512:
-    case QCryptographicHash::Sha3_224:
-    case QCryptographicHash::Sha3_384:
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-    case QCryptographicHash::Blake2b_160:
-    case QCryptographicHash::Blake2b_384:
-    case QCryptographicHash::Blake2s_128:
-    case QCryptographicHash::Blake2s_160:
-    case QCryptographicHash::Blake2s_224:
-    case QCryptographicHash::Blake2s_256:
-#endif
-        return HashAlgorithm::Unknown;
-    case QCryptographicHash::Md5:
-        return HashAlgorithm::Md5;
-    case QCryptographicHash::Sha1:
-        return HashAlgorithm::Sha1;
-    case QCryptographicHash::Sha224:
-        return HashAlgorithm::Sha224;
-    case QCryptographicHash::Sha256:
-        return HashAlgorithm::Sha256;
-    case QCryptographicHash::Sha384:
-        return HashAlgorithm::Sha384;
-    case QCryptographicHash::Sha512:
-        return HashAlgorithm::Sha512;
-    case QCryptographicHash::Sha3_256:
-        return HashAlgorithm::Sha3_256;
-    case QCryptographicHash::Sha3_512:
-        return HashAlgorithm::Sha3_512;
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-    case QCryptographicHash::Blake2b_256:
-        return HashAlgorithm::Blake2b_256;
-    case QCryptographicHash::Blake2b_512:
-        return HashAlgorithm::Blake2b_512;
-#endif
-    }
-    return HashAlgorithm::Unknown;
-}
-
 static std::optional<QCryptographicHash::Algorithm> toCryptograhicHashAlgorithm(HashAlgorithm algorithm)
 {
     switch (algorithm) {
@@ -76,6 +33,7 @@ static std::optional<QCryptographicHash::Algorithm> toCryptograhicHashAlgorithm(
     case HashAlgorithm::Md2:
     case HashAlgorithm::Shake128:
     case HashAlgorithm::Shake256:
+    case HashAlgorithm::Blake3:
         return {};
     case HashAlgorithm::Md5:
         return QCryptographicHash::Md5;
@@ -125,11 +83,17 @@ bool QXmpp::Private::isHashingAlgorithmSecure(HashAlgorithm algorithm)
     case HashAlgorithm::Sha3_512:
     case HashAlgorithm::Blake2b_256:
     case HashAlgorithm::Blake2b_512:
+    case HashAlgorithm::Blake3:
         return true;
     }
     return false;
 }
 
+bool QXmpp::Private::isHashingAlgorithmSupported(HashAlgorithm algorithm)
+{
+    return algorithm == HashAlgorithm::Blake3 || toCryptograhicHashAlgorithm(algorithm).has_value();
+}
+
 uint16_t QXmpp::Private::hashPriority(HashAlgorithm algorithm)
 {
     switch (algorithm) {
@@ -163,10 +127,46 @@ uint16_t QXmpp::Private::hashPriority(HashAlgorithm algorithm)
         return 12;
     case HashAlgorithm::Blake2b_512:
         return 13;
+    // prefer BLAKE3 over everything else because it can be calculated in parallel
+    case HashAlgorithm::Blake3:
+        return 14;
     }
     return 0;
 }
 
+Hasher::Hasher(HashAlgorithm algorithm)
+    : m_algorithm(algorithm)
+{
+    if (algorithm == HashAlgorithm::Blake3) {
+        m_blake3 = std::make_unique<Blake3Hasher>();
+    } else {
+        auto converted = toCryptograhicHashAlgorithm(algorithm);
+        Q_ASSERT_X(converted.has_value(), "hasher", "Must only be called with supported algorithms");
+        m_hash = std::make_unique<QCryptographicHash>(*converted);
+    }
+}
+
+Hasher::Hasher(Hasher &&) noexcept = default;
+Hasher::~Hasher() = default;
+
+void Hasher::addData(const char *data, std::size_t size)
+{
+    if (m_blake3) {
+        m_blake3->addData(data, size);
+    } else {
+#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
+        m_hash->addData(QByteArrayView(data, qsizetype(size)));
+#else
+        m_hash->addData(data, int(size));
+#endif
+    }
+}
+
+QByteArray Hasher::result() const
+{
+    return m_blake3 ? m_blake3->result() : m_hash->result();
+}
+
 template<typename T, typename Converter>
 auto transform(std::vector<T> &input, Converter convert)
 {
@@ -197,19 +197,33 @@ auto deviceSize(QIODevice &device) -> std::optional<std::size_t>
     return std::nullopt;
 }
 
-HashingResult calculateHashesSync(std::unique_ptr<QIODevice> data, std::vector<QCryptographicHash::Algorithm> algorithms)
+HashingResult calculateHashesSync(std::unique_ptr<QIODevice> data, std::vector<HashAlgorithm> algorithms)
 {
-    std::vector<QXmppHash> results;
-    results.reserve(algorithms.size());
-    for (auto algorithm : algorithms) {
-        QCryptographicHash hasher(algorithm);
-        data->seek(0);
-        if (!hasher.addData(data.get())) {
+    auto hashers = transform(algorithms, [](auto algorithm) {
+        return Hasher(algorithm);
+    });
+
+    // read the data once and add each block to all hashes
+    data->seek(0);
+    char buffer[SYNC_BUFFER_SIZE];
+    while (!data->atEnd()) {
+        const auto readBytes = data->read(buffer, SYNC_BUFFER_SIZE);
+        if (readBytes < 0) {
             return { QXmppError::fromIoDevice(*data), std::move(data) };
         }
+        if (readBytes == 0) {
+            break;
+        }
+        for (auto &hasher : hashers) {
+            hasher.addData(buffer, std::size_t(readBytes));
+        }
+    }
 
+    std::vector<QXmppHash> results;
+    results.reserve(hashers.size());
+    for (const auto &hasher : hashers) {
         QXmppHash hash;
-        hash.setAlgorithm(toHashAlgorithm(algorithm));
+        hash.setAlgorithm(hasher.algorithm());
         hash.setHash(hasher.result());
         results.push_back(hash);
     }
@@ -232,17 +246,15 @@ struct BufferReader : public QRunnable
 
 struct HashProcessor : public QRunnable
 {
-    HashProcessor(HashGenerator *generator, QCryptographicHash::Algorithm algorithm)
+    HashProcessor(HashGenerator *generator, HashAlgorithm algorithm)
         : generator(generator),
-          hash(std::make_unique<QCryptographicHash>(algorithm)),
-          algorithm(algorithm)
+          hash(algorithm)
     {
         setAutoDelete(false);
     }
     HashProcessor(HashProcessor &&other) noexcept
         : generator(other.generator),
-          hash(std::move(other.hash)),
-          algorithm(other.algorithm)
+          hash(std::move(other.hash))
     {
     }
     ~HashProcessor() override = default;
@@ -250,8 +262,7 @@ struct HashProcessor : public QRunnable
     void run() override;
 
     HashGenerator *generator;
-    std::unique_ptr<QCryptographicHash> hash;
-    QCryptographicHash::Algorithm algorithm;
+    Hasher hash;
 };
 
 class HashGenerator : public QObject
@@ -261,15 +272,13 @@ class HashGenerator : public QObject
 public:
     static void calculateHashes(std::unique_ptr<QIODevice> data,
                                 std::vector<HashAlgorithm> algorithms,
+                                std::size_t bufferSize,
                                 std::function<void(HashingResult)> reportResult,
                                 std::function<bool()> isCancelled)
     {
-        // convert to QCryptographicHash::Algorithm for hashing
-        auto qtAlgorithms = transform(algorithms, [](auto algorithm) {
-            auto converted = toCryptograhicHashAlgorithm(algorithm);
-            Q_ASSERT_X(converted.has_value(), "calculate hashes", "Must only be called with algorithms supported by QCryptographicHash");
-            return *converted;
-        });
+        Q_ASSERT_X(std::all_of(algorithms.begin(), algorithms.end(), isHashingAlgorithmSupported),
+                   "calculate hashes",
+                   "Must only be called with supported algorithms");
 
         // check for readability
         if (!data->isOpen() || !data->isReadable()) {
@@ -287,20 +296,22 @@ public:
         // optimization for small data
         if (auto size = deviceSize(*data)) {
             if ((algorithms.size() * data->size()) <= PROCESS_SYNC_MAX_SIZE) {
-                reportResult(calculateHashesSync(std::move(data), std::move(qtAlgorithms)));
+                reportResult(calculateHashesSync(std::move(data), std::move(algorithms)));
                 return;
             }
         }
 
         // start normal hash calculation with hash generator
-        new HashGenerator(std::move(data), std::move(qtAlgorithms), std::move(reportResult), std::move(isCancelled));
+        new HashGenerator(std::move(data), std::move(algorithms), std::max<std::size_t>(bufferSize, 1), std::move(reportResult), std::move(isCancelled));
     }
 
     HashGenerator(std::unique_ptr<QIODevice> data,
-                  std::vector<QCryptographicHash::Algorithm> algorithms,
+                  std::vector<HashAlgorithm> algorithms,
+                  std::size_t bufferSize,
                   std::function<void(HashingResult)> reportResult,
                   std::function<bool()> isCancelled)
         : m_data(std::move(data)),
+          m_bufferSize(bufferSize),
           m_bufferReader(*this),
           m_reportResult(std::move(reportResult)),
           m_isCancelled(std::move(isCancelled))
@@ -310,14 +321,25 @@ public:
             return HashProcessor(this, algorithm);
         });
 
-        // create buffers
         auto size = deviceSize(*m_data);
-        if (size && *size <= 2 * BUFFER_SIZE) {
+
+        // local files are hashed directly from a memory mapping
+        if (auto *file = qobject_cast<QFile *>(m_data.get()); file && size && *size > std::size_t(file->pos())) {
+            m_mappedSize = *size - file->pos();
+            m_mappedData = file->map(file->pos(), m_mappedSize);
+            if (m_mappedData) {
+                startNextIteration();
+                return;
+            }
+        }
+
+        // create buffers
+        if (size && *size <= 2 * m_bufferSize) {
             // read everything in one go
             m_readBuffer.reserve(*size);
         } else {
-            m_readBuffer.reserve(BUFFER_SIZE);
-            m_processBuffer.reserve(BUFFER_SIZE);
+            m_readBuffer.reserve(m_bufferSize);
+            m_processBuffer.reserve(m_bufferSize);
         }
 
         // start reading buffer
@@ -343,19 +365,30 @@ public:
 
         // check for cancellation
         if (m_isCancelled()) {
+            unmap();
             m_reportResult({ Cancelled(), std::move(m_data) });
             deleteLater();
             return;
         }
 
-        m_readingFinished = m_data->atEnd();
+        if (m_mappedData) {
+            // process the next part of the mapping, nothing needs to be read
+            m_processData = reinterpret_cast<const char *>(m_mappedData) + m_mappedOffset;
+            m_processSize = std::min(m_bufferSize, m_mappedSize - m_mappedOffset);
+            m_mappedOffset += m_processSize;
+            m_readingFinished = m_mappedOffset >= m_mappedSize;
+        } else {
+            m_readingFinished = m_data->atEnd();
 
-        // swap buffers: read data is now processed, the buffer of the
-        // processed data is reused as new read buffer
-        m_processBuffer.swap(m_readBuffer);
+            // swap buffers: read data is now processed, the buffer of the
+            // processed data is reused as new read buffer
+            m_processBuffer.swap(m_readBuffer);
+            m_processData = m_processBuffer.data();
+            m_processSize = m_processBuffer.size();
+        }
 
         // reset counter
-        if (m_readingFinished) {
+        if (m_readingFinished || m_mappedData) {
             m_runningJobs = int(m_hashProcessors.size());
         } else {
             m_runningJobs = int(m_hashProcessors.size() + 1);
@@ -363,7 +396,7 @@ public:
 
         auto *pool = QThreadPool::globalInstance();
         // optimization: don't restart the buffer reader if we know no more bytes can be read
-        if (!m_readingFinished) {
+        if (!m_readingFinished && !m_mappedData) {
             pool->start(&m_bufferReader);
         }
         // start all hash processors
@@ -389,12 +422,21 @@ public:
         m_reportResult({ std::move(err), std::move(m_data) });
     }
 
+    void unmap()
+    {
+        if (m_mappedData) {
+            static_cast<QFile *>(m_data.get())->unmap(m_mappedData);
+            m_mappedData = nullptr;
+        }
+    }
+
     void finish()
     {
+        unmap();
         auto hashes = transform(m_hashProcessors, [](auto &processor) {
             QXmppHash hash;
-            hash.setAlgorithm(toHashAlgorithm(processor.algorithm));
-            hash.setHash(processor.hash->result());
+            hash.setAlgorithm(processor.hash.algorithm());
+            hash.setHash(processor.hash.result());
             return hash;
         });
         m_reportResult({ std::move(hashes), std::move(m_data) });
@@ -403,8 +445,16 @@ public:
     bool m_errorOccurred = false;
     bool m_readingFinished = false;
     std::unique_ptr<QIODevice> m_data;
+    std::size_t m_bufferSize;
     std::vector<char> m_readBuffer;
     std::vector<char> m_processBuffer;
+    // memory mapping of a local file
+    uchar *m_mappedData = nullptr;
+    std::size_t m_mappedSize = 0;
+    std::size_t m_mappedOffset = 0;
+    // data of the current iteration
+    const char *m_processData = nullptr;
+    std::size_t m_processSize = 0;
     QAtomicInt m_runningJobs = 0;
     std::vector<HashProcessor> m_hashProcessors;
     BufferReader m_bufferReader;
@@ -432,16 +482,121 @@ void BufferReader::run()
 
 void HashProcessor::run()
 {
-    auto &buffer = generator->m_processBuffer;
-#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
-    hash->addData(QByteArrayView(buffer.data(), buffer.size()));
-#else
-    hash->addData(buffer.data(), buffer.size());
-#endif
+    hash.addData(generator->m_processData, generator->m_processSize);
     generator->reportJobFinished();
 }
 
-QFuture<HashingResultPtr> QXmpp::Private::calculateHashes(std::unique_ptr<QIODevice> data, std::vector<HashAlgorithm> algorithms)
+HashingDeviceState::HashingDeviceState(std::vector<HashAlgorithm> algorithms, qint64 size)
+    : m_hashes(transform(algorithms, [](auto algorithm) { return Hasher(algorithm); })),
+      m_size(size)
+{
+}
+
+HashingDeviceState::~HashingDeviceState() = default;
+
+void HashingDeviceState::addData(qint64 position, const char *data, qint64 length)
+{
+    if (!m_valid) {
+        return;
+    }
+    if (position > m_hashedBytes) {
+        // data has been skipped
+        m_valid = false;
+        return;
+    }
+
+    // skip data that has been hashed already
+    const auto offset = m_hashedBytes - position;
+    if (offset >= length) {
+        return;
+    }
+    for (auto &hash : m_hashes) {
+        hash.addData(data + offset, std::size_t(length - offset));
+    }
+    m_hashedBytes += length - offset;
+}
+
+std::optional<std::vector<QXmppHash>> HashingDeviceState::result() const
+{
+    if (!m_valid || m_size < 0 || m_hashedBytes != m_size) {
+        return {};
+    }
+
+    std::vector<QXmppHash> hashes;
+    hashes.reserve(m_hashes.size());
+    for (const auto &hasher : m_hashes) {
+        QXmppHash hash;
+        hash.setAlgorithm(hasher.algorithm());
+        hash.setHash(hasher.result());
+        hashes.push_back(std::move(hash));
+    }
+    return hashes;
+}
+
+HashingDevice::HashingDevice(std::unique_ptr<QIODevice> input, std::vector<HashAlgorithm> algorithms)
+    : m_input(std::move(input)),
+      m_state(std::make_shared<HashingDeviceState>(std::move(algorithms), m_input->isSequential() ? -1 : m_input->size())),
+      m_inputPosition(m_input->isSequential() ? 0 : m_input->pos())
+{
+    // the input buffers already, data is passed through directly
+    if (m_input->isReadable()) {
+        setOpenMode(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    }
+}
+
+HashingDevice::~HashingDevice() = default;
+
+bool HashingDevice::open(OpenMode mode)
+{
+    return m_input->open(mode) && QIODevice::open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+}
+
+void HashingDevice::close()
+{
+    m_input->close();
+    QIODevice::close();
+}
+
+bool HashingDevice::isSequential() const
+{
+    return m_input->isSequential();
+}
+
+qint64 HashingDevice::size() const
+{
+    return m_input->size();
+}
+
+bool HashingDevice::seek(qint64 pos)
+{
+    if (QIODevice::seek(pos) && m_input->seek(pos)) {
+        m_inputPosition = pos;
+        return true;
+    }
+    return false;
+}
+
+bool HashingDevice::atEnd() const
+{
+    return QIODevice::atEnd() && m_input->atEnd();
+}
+
+qint64 HashingDevice::readData(char *data, qint64 maxlen)
+{
+    const auto read = m_input->read(data, maxlen);
+    if (read > 0) {
+        m_state->addData(m_inputPosition, data, read);
+        m_inputPosition += read;
+    }
+    return read;
+}
+
+qint64 HashingDevice::writeData(const char *, qint64)
+{
+    return -1;
+}
+
+QFuture<HashingResultPtr> QXmpp::Private::calculateHashes(std::unique_ptr<QIODevice> data, std::vector<HashAlgorithm> algorithms, std::size_t bufferSize)
 {
     QFutureInterface<HashingResultPtr> interface;
     auto finish = [interface](HashingResult &&result) mutable {
@@ -453,15 +608,16 @@ QFuture<HashingResultPtr> QXmpp::Private::calculateHashes(std::unique_ptr<QIODev
     };
 
     // object will delete itself using QObject::deleteLater()
-    HashGenerator::calculateHashes(std::move(data), std::move(algorithms), std::move(finish), std::move(isCancelled));
+    HashGenerator::calculateHashes(std::move(data), std::move(algorithms), bufferSize, std::move(finish), std::move(isCancelled));
     return interface.future();
 }
 
 QFuture<HashVerificationResultPtr> QXmpp::Private::verifyHashes(std::unique_ptr<QIODevice> data, std::vector<QXmppHash> hashes)
 {
-    // filter out invalid hashes and insecure
+    // filter out invalid hashes, insecure ones and those that can't be calculated
     auto isInvalid = [](const auto &hash) {
-        return hash.hash().isEmpty() || !isHashingAlgorithmSecure(hash.algorithm());
+        return hash.hash().isEmpty() || !isHashingAlgorithmSecure(hash.algorithm()) ||
+            !isHashingAlgorithmSupported(hash.algorithm());
     };
     hashes.erase(std::remove_if(hashes.begin(), hashes.end(), isInvalid), hashes.end());
 
@@ -499,7 +655,7 @@ QFuture<HashVerificationResultPtr> QXmpp::Private::verifyHashes(std::unique_ptr<
         return interface.isCanceled();
     };
 
-    HashGenerator::calculateHashes(std::move(data), { expected.algorithm() }, std::move(finish), std::move(isCancelled));
+    HashGenerator::calculateHashes(std::move(data), { expected.algorithm() }, HASHING_BUFFER_SIZE, std::move(finish), std::move(isCancelled));
     return interface.future();
 }
 /// \endcond
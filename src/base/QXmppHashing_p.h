@@ -10,10 +10,12 @@
 #include "QXmppHash.h"
 
 #include <memory>
+#include <optional>
 #include <variant>
 #include <vector>
 
 #include <QCryptographicHash>
+#include <QIODevice>
 
 template<typename T>
 class QFuture;
@@ -21,6 +23,8 @@ class QXmppHash;
 
 namespace QXmpp::Private {
 
+class Blake3Hasher;
+
 struct HashingResult
 {
     using Result = std::variant<std::vector<QXmppHash>, Cancelled, QXmppError>;
@@ -60,12 +64,95 @@ using HashingResultPtr = std::shared_ptr<HashingResult>;
 using HashVerificationResultPtr = std::shared_ptr<HashVerificationResult>;
 
 bool isHashingAlgorithmSecure(HashAlgorithm algorithm);
+bool isHashingAlgorithmSupported(HashAlgorithm algorithm);
 uint16_t hashPriority(HashAlgorithm algorithm);
 
+//
+// Incremental hash of one of the supported algorithms, calculated using
+// QCryptographicHash or the built-in BLAKE3.
+//
+class Hasher
+{
+public:
+    explicit Hasher(HashAlgorithm algorithm);
+    Hasher(Hasher &&) noexcept;
+    ~Hasher();
+
+    HashAlgorithm algorithm() const { return m_algorithm; }
+
+    void addData(const char *data, std::size_t size);
+    QByteArray result() const;
+
+private:
+    HashAlgorithm m_algorithm;
+    std::unique_ptr<QCryptographicHash> m_hash;
+    std::unique_ptr<Blake3Hasher> m_blake3;
+};
+
 // QXMPP_EXPORT for unit tests
-QXMPP_EXPORT QFuture<HashingResultPtr> calculateHashes(std::unique_ptr<QIODevice> data, std::vector<HashAlgorithm> hashes);
+// 512 kB (two buffers are used so 1 MB)
+constexpr std::size_t HASHING_BUFFER_SIZE = 512 * 1024;
+
+// Reads the data once and calculates all hashes in parallel. Local files are
+// memory mapped instead of being read into the buffers.
+QXMPP_EXPORT QFuture<HashingResultPtr> calculateHashes(std::unique_ptr<QIODevice> data, std::vector<HashAlgorithm> hashes, std::size_t bufferSize = HASHING_BUFFER_SIZE);
 QFuture<HashVerificationResultPtr> verifyHashes(std::unique_ptr<QIODevice> data, std::vector<QXmppHash> hashes);
 
+//
+// Hashing state of a HashingDevice. It stays valid after the device has been
+// destroyed.
+//
+class QXMPP_EXPORT HashingDeviceState
+{
+public:
+    HashingDeviceState(std::vector<HashAlgorithm> algorithms, qint64 size);
+    ~HashingDeviceState();
+
+    void addData(qint64 position, const char *data, qint64 length);
+    // returns the hashes if all data has been read exactly once in order
+    std::optional<std::vector<QXmppHash>> result() const;
+
+private:
+    std::vector<Hasher> m_hashes;
+    qint64 m_size;
+    qint64 m_hashedBytes = 0;
+    bool m_valid = true;
+};
+
+//
+// Passes the data of another device through and hashes it while it is read,
+// so data that is uploaded doesn't need to be read a second time for hashing.
+//
+// Data that is read again after seeking back is not hashed twice. If the
+// reader skips data, no result is available and the data needs to be hashed
+// separately.
+//
+class QXMPP_EXPORT HashingDevice : public QIODevice
+{
+public:
+    HashingDevice(std::unique_ptr<QIODevice> input, std::vector<HashAlgorithm> algorithms);
+    ~HashingDevice() override;
+
+    std::shared_ptr<HashingDeviceState> state() const { return m_state; }
+
+    bool open(QIODevice::OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override;
+    qint64 size() const override;
+    bool seek(qint64 pos) override;
+    bool atEnd() const override;
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override;
+    qint64 writeData(const char *data, qint64 len) override;
+
+private:
+    std::unique_ptr<QIODevice> m_input;
+    std::shared_ptr<HashingDeviceState> m_state;
+    // position of the input, also for sequential devices
+    qint64 m_inputPosition = 0;
+};
+
 }  // namespace QXmpp::Private
 
 #endif  // QXMPPHASHING_H
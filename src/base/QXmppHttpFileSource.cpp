@@ -5,10 +5,13 @@
 #include "QXmppHttpFileSource.h"
 
 #include "QXmppConstants_p.h"
+#include "QXmppUtils_p.h"
 
 #include <QDomElement>
 #include <QXmlStreamWriter>
 
+using namespace QXmpp::Private;
+
 ///
 /// \class QXmppHttpFileSource
 ///
@@ -47,7 +50,7 @@ void QXmppHttpFileSource::setUrl(QUrl url)
 /// \cond
 bool QXmppHttpFileSource::parse(const QDomElement &el)
 {
-    if (el.tagName() == "url-data" && el.namespaceURI() == ns_url_data) {
+    if (isElement(el, u"url-data", ns_url_data)) {
         m_url = QUrl(el.attribute("target"));
         return true;
     }
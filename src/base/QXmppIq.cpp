@@ -4,17 +4,19 @@
 
 #include "QXmppIq.h"
 
+#include "QXmppEnumStrings_p.h"
 #include "QXmppUtils.h"
 
 #include <QDomElement>
 #include <QXmlStreamWriter>
 
-static const char *iq_types[] = {
-    "error",
-    "get",
-    "set",
-    "result"
-};
+using namespace QXmpp::Private;
+
+constexpr auto IQ_TYPES = enumStrings<QXmppIq::Type>(
+    u"error",
+    u"get",
+    u"set",
+    u"result");
 
 class QXmppIqPrivate : public QSharedData
 {
@@ -79,12 +81,8 @@ void QXmppIq::parse(const QDomElement &element)
 {
     QXmppStanza::parse(element);
 
-    const QString type = element.attribute("type");
-    for (int i = Error; i <= Result; i++) {
-        if (type == iq_types[i]) {
-            d->type = static_cast<Type>(i);
-            break;
-        }
+    if (const auto type = IQ_TYPES.fromString(element.attribute(QStringLiteral("type")))) {
+        d->type = *type;
     }
 
     parseElementFromChild(element);
@@ -109,7 +107,7 @@ void QXmppIq::toXml(QXmlStreamWriter *xmlWriter) const
     helperToXmlAddAttribute(xmlWriter, "id", id());
     helperToXmlAddAttribute(xmlWriter, "to", to());
     helperToXmlAddAttribute(xmlWriter, "from", from());
-    helperToXmlAddAttribute(xmlWriter, "type", iq_types[d->type]);
+    helperToXmlAddAttribute(xmlWriter, "type", IQ_TYPES.toString(d->type));
     toXmlElementFromChild(xmlWriter);
     error().toXml(xmlWriter);
     xmlWriter->writeEndElement();
@@ -0,0 +1,101 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppJid.h"
+
+#include <algorithm>
+
+#include <QMutex>
+#include <QSet>
+
+namespace {
+
+// Strings of interned JIDs. Strings only referenced by the table are removed
+// whenever it has doubled in size since the last cleanup.
+struct InternTable
+{
+    QString intern(const QString &string);
+
+    QMutex mutex;
+    QSet<QString> strings;
+    int cleanupSize = 1024;
+};
+
+QString InternTable::intern(const QString &string)
+{
+    QMutexLocker locker(&mutex);
+    if (const auto itr = strings.constFind(string); itr != strings.constEnd()) {
+        return *itr;
+    }
+
+    if (strings.size() >= cleanupSize) {
+        // copies of the strings are only made with the mutex locked, so a
+        // detached string cannot be referenced by anyone else
+        for (auto itr = strings.begin(); itr != strings.end();) {
+            if (itr->isDetached()) {
+                itr = strings.erase(itr);
+            } else {
+                ++itr;
+            }
+        }
+        cleanupSize = std::max(1024, int(strings.size()) * 2);
+    }
+    return *strings.insert(string);
+}
+
+}  // namespace
+
+///
+/// Parses the JID.
+///
+/// The resource starts after the first '/', the local part ends at the first
+/// '@' before it, as defined by RFC 7622.
+///
+QXmppJid::QXmppJid(const QString &jid)
+    : m_jid(jid),
+      m_hash(qHash(jid))
+{
+    const auto slash = jid.indexOf(u'/');
+    m_bareEnd = slash < 0 ? int(jid.size()) : int(slash);
+
+    const auto at = QStringView(jid).left(m_bareEnd).indexOf(u'@');
+    m_domainStart = at < 0 ? 0 : int(at) + 1;
+}
+
+///
+/// Returns the JID without its resource.
+///
+/// The string is shared if the JID is already bare.
+///
+QXmppJid QXmppJid::toBare() const
+{
+    if (isBare()) {
+        return *this;
+    }
+
+    QXmppJid bareJid;
+    bareJid.m_jid = m_jid.left(m_bareEnd);
+    bareJid.m_domainStart = m_domainStart;
+    bareJid.m_bareEnd = m_bareEnd;
+    bareJid.m_hash = qHash(bareJid.m_jid);
+    return bareJid;
+}
+
+///
+/// Returns a copy of the JID that shares its string with all other interned
+/// copies of the same JID.
+///
+/// This saves memory for JIDs that are stored many times, e.g. the bare JIDs
+/// of contacts used as keys of several containers. Interning needs a
+/// process-wide lookup with a mutex, so it is not worth it for short-lived
+/// JIDs.
+///
+QXmppJid QXmppJid::interned() const
+{
+    static auto *table = new InternTable;
+
+    auto jid = *this;
+    jid.m_jid = table->intern(m_jid);
+    return jid;
+}
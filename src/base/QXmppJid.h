@@ -0,0 +1,89 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPJID_H
+#define QXMPPJID_H
+
+#include "QXmppGlobal.h"
+
+#include <QHashFunctions>
+#include <QString>
+#include <QStringView>
+
+///
+/// \brief The QXmppJid class is a parsed Jabber ID.
+///
+/// The JID is split into its parts once on construction. The parts are
+/// returned as views of the original string, so they can be compared without
+/// allocating new strings. The hash of the JID is precomputed, which makes
+/// QXmppJid a cheap key for QHash and QSet.
+///
+/// Long-lived JIDs, e.g. of roster items, can be interned() so all copies of
+/// the same JID share one string.
+///
+/// No normalization (stringprep or PRECIS) is applied, JIDs are compared as
+/// they have been received.
+///
+/// \since QXmpp 1.6
+///
+/// \ingroup Core
+///
+class QXMPP_EXPORT QXmppJid
+{
+public:
+    QXmppJid() = default;
+    explicit QXmppJid(const QString &jid);
+
+    /// Returns the full JID as a string.
+    const QString &toString() const { return m_jid; }
+    /// Returns true if the JID is empty.
+    bool isEmpty() const { return m_jid.isEmpty(); }
+    /// Returns true if the JID has no resource.
+    bool isBare() const { return m_bareEnd == m_jid.size(); }
+
+    /// Returns the local part of the JID, the user of a server.
+    QStringView node() const { return QStringView(m_jid).left(m_domainStart ? m_domainStart - 1 : 0); }
+    /// Returns the domain of the JID.
+    QStringView domain() const { return QStringView(m_jid).mid(m_domainStart, m_bareEnd - m_domainStart); }
+    /// Returns the resource of the JID, or an empty view if it has none.
+    QStringView resource() const { return isBare() ? QStringView() : QStringView(m_jid).mid(m_bareEnd + 1); }
+    /// Returns the JID without its resource.
+    QStringView bare() const { return QStringView(m_jid).left(m_bareEnd); }
+
+    QXmppJid toBare() const;
+    QXmppJid interned() const;
+
+    /// Returns the precomputed hash of the full JID.
+    size_t hash() const { return m_hash; }
+
+    /// Returns true if both JIDs are equal.
+    bool operator==(const QXmppJid &other) const { return m_hash == other.m_hash && m_jid == other.m_jid; }
+    /// Returns true if the JIDs are different.
+    bool operator!=(const QXmppJid &other) const { return !(*this == other); }
+
+private:
+    QString m_jid;
+    // start of the domain, after the '@'
+    int m_domainStart = 0;
+    // end of the bare JID, at the '/'
+    int m_bareEnd = 0;
+    size_t m_hash = 0;
+};
+
+/// Returns the precomputed hash of the JID, mixed with the given seed.
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+inline size_t qHash(const QXmppJid &jid, size_t seed = 0) noexcept
+{
+    return jid.hash() ^ seed;
+}
+#else
+inline uint qHash(const QXmppJid &jid, uint seed = 0) noexcept
+{
+    return uint(jid.hash()) ^ seed;
+}
+#endif
+
+Q_DECLARE_TYPEINFO(QXmppJid, Q_MOVABLE_TYPE);
+
+#endif  // QXMPPJID_H
@@ -6,12 +6,20 @@
 #include "QXmppJingleData.h"
 
 #include "QXmppConstants_p.h"
+#include "QXmppHash.h"
 #include "QXmppUtils.h"
+#include "QXmppUtils_p.h"
+
+#include <array>
+#include <utility>
 
 #include <QDate>
 #include <QDateTime>
 #include <QDomElement>
-#include <QRegularExpression>
+#include <QLocale>
+#include <QMimeType>
+
+using namespace QXmpp::Private;
 
 static const int RTP_COMPONENT = 1;
 
@@ -91,34 +99,78 @@ static QString addressToSdp(const QHostAddress &host)
     return QStringLiteral("IN %1 %2").arg(host.protocol() == QAbstractSocket::IPv6Protocol ? QStringLiteral("IP6") : QStringLiteral("IP4"), host.toString());
 }
 
-static bool candidateParseSdp(QXmppJingleCandidate *candidate, const QString &sdp)
+// Splits a string at a separator without copying it. Empty parts are kept,
+// like with QString::split().
+class SdpTokenizer
 {
-    if (!sdp.startsWith(QStringLiteral("candidate:"))) {
-        return false;
+public:
+    SdpTokenizer(QStringView string, QChar separator)
+        : m_string(string), m_separator(separator)
+    {
+    }
+
+    bool hasNext() const { return m_hasNext; }
+    QStringView next()
+    {
+        const auto index = m_string.indexOf(m_separator);
+        if (index < 0) {
+            m_hasNext = false;
+            return m_string;
+        }
+        const auto token = m_string.left(index);
+        m_string = m_string.mid(index + 1);
+        return token;
     }
 
-    const QStringList bits = sdp.mid(10).split(" ");
-    if (bits.size() < 6) {
+private:
+    QStringView m_string;
+    QChar m_separator;
+    bool m_hasNext = true;
+};
+
+static int sdpToInt(QStringView string, bool *ok = nullptr)
+{
+    return QLocale::c().toInt(string, ok);
+}
+
+static bool candidateParseSdp(QXmppJingleCandidate *candidate, QStringView sdp)
+{
+    if (!sdp.startsWith(u"candidate:")) {
         return false;
     }
 
-    candidate->setFoundation(bits[0]);
-    candidate->setComponent(bits[1].toInt());
-    candidate->setProtocol(bits[2].toLower());
-    candidate->setPriority(bits[3].toInt());
-    candidate->setHost(QHostAddress(bits[4]));
-    candidate->setPort(bits[5].toInt());
-    for (int i = 6; i < bits.size() - 1; i += 2) {
-        if (bits[i] == QStringLiteral("typ")) {
+    SdpTokenizer tokenizer(sdp.mid(10), u' ');
+    std::array<QStringView, 6> bits;
+    for (auto &bit : bits) {
+        if (!tokenizer.hasNext()) {
+            return false;
+        }
+        bit = tokenizer.next();
+    }
+
+    candidate->setFoundation(bits[0].toString());
+    candidate->setComponent(sdpToInt(bits[1]));
+    candidate->setProtocol(bits[2].toString().toLower());
+    candidate->setPriority(sdpToInt(bits[3]));
+    candidate->setHost(QHostAddress(bits[4].toString()));
+    candidate->setPort(sdpToInt(bits[5]));
+    while (tokenizer.hasNext()) {
+        const auto name = tokenizer.next();
+        if (!tokenizer.hasNext()) {
+            // attribute without value
+            break;
+        }
+        const auto value = tokenizer.next();
+        if (name == u"typ") {
             bool ok;
-            candidate->setType(QXmppJingleCandidate::typeFromString(bits[i + 1], &ok));
+            candidate->setType(QXmppJingleCandidate::typeFromString(value.toString(), &ok));
             if (!ok) {
                 return false;
             }
-        } else if (bits[i] == QStringLiteral("generation")) {
-            candidate->setGeneration(bits[i + 1].toInt());
+        } else if (name == u"generation") {
+            candidate->setGeneration(sdpToInt(value));
         } else {
-            qWarning() << "Candidate SDP contains unknown attribute" << bits[i];
+            qWarning() << "Candidate SDP contains unknown attribute" << name;
             return false;
         }
     }
@@ -194,7 +246,7 @@ static void parseJingleRtpHeaderExtensionsNegotiationElements(const QDomElement
             QXmppJingleRtpHeaderExtensionProperty property;
             property.parse(child);
             properties.append(property);
-        } else if (child.tagName() == QStringLiteral("extmap-allow-mixed") && child.namespaceURI() == ns_jingle_rtp_header_extensions_negotiation) {
+        } else if (isElement(child, u"extmap-allow-mixed", ns_jingle_rtp_header_extensions_negotiation)) {
             isRtpHeaderExtensionMixingAllowed = true;
         }
     }
@@ -214,6 +266,33 @@ static void jingleRtpHeaderExtensionsNegotiationElementsToXml(QXmlStreamWriter *
     }
 }
 
+// Writes the file element of XEP-0234: Jingle File Transfer, which uses the
+// namespace of the description, unlike the one of XEP-0446: File metadata
+// element.
+static void fileTransferFileToXml(QXmlStreamWriter *writer, const QXmppFileMetadata &file)
+{
+    writer->writeStartElement(QStringLiteral("file"));
+    if (file.lastModified()) {
+        writer->writeTextElement(QStringLiteral("date"), QXmppUtils::datetimeToString(*file.lastModified()));
+    }
+    if (file.description()) {
+        writer->writeTextElement(QStringLiteral("desc"), *file.description());
+    }
+    for (const auto &hash : file.hashes()) {
+        hash.toXml(writer);
+    }
+    if (file.mediaType()) {
+        writer->writeTextElement(QStringLiteral("media-type"), file.mediaType()->name());
+    }
+    if (file.filename()) {
+        writer->writeTextElement(QStringLiteral("name"), *file.filename());
+    }
+    if (file.size()) {
+        writer->writeTextElement(QStringLiteral("size"), QString::number(*file.size()));
+    }
+    writer->writeEndElement();
+}
+
 class QXmppJingleIqContentPrivate : public QSharedData
 {
 public:
@@ -227,6 +306,9 @@ public:
     QXmppJingleDescription description;
     bool isRtpMultiplexingSupported = false;
 
+    // XEP-0234: Jingle File Transfer
+    std::optional<QXmppFileMetadata> fileTransferFile;
+
     QString transportType;
     QString transportUser;
     QString transportPassword;
@@ -303,6 +385,15 @@ QXmppJingleIqContentPrivate::QXmppJingleIqContentPrivate()
 /// \since QXmpp 1.5
 ///
 
+///
+/// \struct QXmppJingleIq::ContentGroup
+///
+/// Group of contents as specified by \xep{0338, Jingle Grouping Framework}, e.g. the contents
+/// bundled on one transport
+///
+/// \since QXmpp 1.6
+///
+
 ///
 /// \typedef QXmppJingleIq::RtpSessionState
 ///
@@ -623,6 +714,34 @@ void QXmppJingleIq::Content::setRtpHeaderExtensionMixingAllowed(bool isRtpHeader
     d->isRtpHeaderExtensionMixingAllowed = isRtpHeaderExtensionMixingAllowed;
 }
 
+///
+/// Returns the file offered or requested by a file transfer content as
+/// defined in \xep{0234, Jingle File Transfer}.
+///
+/// If it is set, the description of the content is a file transfer
+/// description instead of an RTP description.
+///
+/// \since QXmpp 1.6
+///
+std::optional<QXmppFileMetadata> QXmppJingleIq::Content::fileTransferFile() const
+{
+    return d->fileTransferFile;
+}
+
+///
+/// Sets the file offered or requested by a file transfer content as defined
+/// in \xep{0234, Jingle File Transfer}.
+///
+/// Only the date, description, hashes, media type, name and size of the file
+/// are used.
+///
+/// \since QXmpp 1.6
+///
+void QXmppJingleIq::Content::setFileTransferFile(const std::optional<QXmppFileMetadata> &file)
+{
+    d->fileTransferFile = file;
+}
+
 ///
 /// Returns the fingerprint hash value for the transport key.
 ///
@@ -706,6 +825,15 @@ void QXmppJingleIq::Content::parse(const QDomElement &element)
     // description
     QDomElement descriptionElement = element.firstChildElement(QStringLiteral("description"));
     d->description.setType(descriptionElement.namespaceURI());
+
+    // XEP-0234: Jingle File Transfer
+    if (descriptionElement.namespaceURI() == ns_jingle_file_transfer) {
+        QXmppFileMetadata file;
+        if (file.parse(descriptionElement.firstChildElement(QStringLiteral("file")))) {
+            d->fileTransferFile = file;
+        }
+    }
+
     d->description.setMedia(descriptionElement.attribute(QStringLiteral("media")));
     d->description.setSsrc(descriptionElement.attribute(QStringLiteral("ssrc")).toULong());
     d->isRtpMultiplexingSupported = !descriptionElement.firstChildElement(QStringLiteral("rtcp-mux")).isNull();
@@ -767,7 +895,12 @@ void QXmppJingleIq::Content::toXml(QXmlStreamWriter *writer) const
     helperToXmlAddAttribute(writer, QStringLiteral("senders"), d->senders);
 
     // description
-    if (!d->description.type().isEmpty() || !d->description.payloadTypes().isEmpty()) {
+    if (d->fileTransferFile) {
+        writer->writeStartElement(QStringLiteral("description"));
+        writer->writeDefaultNamespace(ns_jingle_file_transfer);
+        fileTransferFileToXml(writer, *d->fileTransferFile);
+        writer->writeEndElement();
+    } else if (!d->description.type().isEmpty() || !d->description.payloadTypes().isEmpty()) {
         writer->writeStartElement(QStringLiteral("description"));
         writer->writeDefaultNamespace(d->description.type());
         helperToXmlAddAttribute(writer, QStringLiteral("media"), d->description.media());
@@ -822,105 +955,121 @@ void QXmppJingleIq::Content::toXml(QXmlStreamWriter *writer) const
 bool QXmppJingleIq::Content::parseSdp(const QString &sdp)
 {
     QList<QXmppJinglePayloadType> payloads;
-    for (auto &line : sdp.split(QChar(u'\n'))) {
-        if (line.endsWith('\r')) {
-            line.resize(line.size() - 1);
+    SdpTokenizer lines(sdp, u'\n');
+    while (lines.hasNext()) {
+        auto line = lines.next();
+        if (line.endsWith(u'\r')) {
+            line.chop(1);
         }
-        if (line.startsWith(QStringLiteral("a="))) {
-            int idx = line.indexOf(':');
-            const QString attrName = idx != -1 ? line.mid(2, idx - 2) : line.mid(2);
-            const QString attrValue = idx != -1 ? line.mid(idx + 1) : "";
+        if (line.startsWith(u"a=")) {
+            const auto idx = line.indexOf(u':');
+            const auto attrName = idx != -1 ? line.mid(2, idx - 2) : line.mid(2);
+            const auto attrValue = idx != -1 ? line.mid(idx + 1) : QStringView();
 
-            if (attrName == QStringLiteral("candidate")) {
+            if (attrName == u"candidate") {
                 QXmppJingleCandidate candidate;
                 if (!candidateParseSdp(&candidate, line.mid(2))) {
                     qWarning() << "Could not parse candidate" << line;
                     return false;
                 }
                 addTransportCandidate(candidate);
-            } else if (attrName == QStringLiteral("fingerprint")) {
-                const QStringList bits = attrValue.split(' ');
-                if (bits.size() > 1) {
-                    d->transportFingerprintHash = bits[0];
-                    d->transportFingerprint = parseFingerprint(bits[1]);
+            } else if (attrName == u"fingerprint") {
+                SdpTokenizer bits(attrValue, u' ');
+                const auto hash = bits.next();
+                if (bits.hasNext()) {
+                    d->transportFingerprintHash = hash.toString();
+                    d->transportFingerprint = parseFingerprint(bits.next().toString());
                 }
-            } else if (attrName == QStringLiteral("fmtp")) {
-                int spIdx = attrValue.indexOf(' ');
+            } else if (attrName == u"fmtp") {
+                const auto spIdx = attrValue.indexOf(u' ');
                 if (spIdx == -1) {
                     qWarning() << "Could not parse payload parameters" << line;
                     return false;
                 }
-                const int id = attrValue.left(spIdx).toInt();
-                const QString paramStr = attrValue.mid(spIdx + 1);
+                const int id = sdpToInt(attrValue.left(spIdx));
+                const auto paramStr = attrValue.mid(spIdx + 1);
                 for (auto &payload : payloads) {
                     if (payload.id() == id) {
                         QMap<QString, QString> params;
                         if (payload.name() == QStringLiteral("telephone-event")) {
-                            params.insert(QStringLiteral("events"), paramStr);
+                            params.insert(QStringLiteral("events"), paramStr.toString());
                         } else {
-                            thread_local static const auto regex = QRegularExpression(";\\s*");
-                            const auto paramParts = paramStr.split(regex);
-                            for (const auto &p : paramParts) {
-                                const QStringList bits = p.split('=');
-                                if (bits.size() == 2) {
-                                    params.insert(bits.at(0), bits.at(1));
+                            // parameters are separated by ';' and optional whitespace
+                            SdpTokenizer paramParts(paramStr, u';');
+                            bool first = true;
+                            while (paramParts.hasNext()) {
+                                auto p = paramParts.next();
+                                if (!std::exchange(first, false)) {
+                                    while (!p.isEmpty() && p.front().isSpace()) {
+                                        p = p.mid(1);
+                                    }
+                                }
+                                const auto eqIdx = p.indexOf(u'=');
+                                if (eqIdx != -1 && p.indexOf(u'=', eqIdx + 1) == -1) {
+                                    params.insert(p.left(eqIdx).toString(), p.mid(eqIdx + 1).toString());
                                 }
                             }
                         }
                         payload.setParameters(params);
                     }
                 }
-            } else if (attrName == QStringLiteral("rtpmap")) {
+            } else if (attrName == u"rtpmap") {
                 // payload type map
-                const QStringList bits = attrValue.split(' ');
-                if (bits.size() != 2) {
+                SdpTokenizer bits(attrValue, u' ');
+                const auto idString = bits.next();
+                if (!bits.hasNext()) {
+                    continue;
+                }
+                const auto mapping = bits.next();
+                if (bits.hasNext()) {
                     continue;
                 }
                 bool ok = false;
-                const int id = bits[0].toInt(&ok);
+                const int id = sdpToInt(idString, &ok);
                 if (!ok) {
                     continue;
                 }
 
-                const QStringList args = bits[1].split('/');
                 for (auto &payload : payloads) {
                     if (payload.id() == id) {
-                        payload.setName(args[0]);
-                        if (args.size() > 1) {
-                            payload.setClockrate(args[1].toInt());
+                        SdpTokenizer args(mapping, u'/');
+                        payload.setName(args.next().toString());
+                        if (args.hasNext()) {
+                            payload.setClockrate(sdpToInt(args.next()));
                         }
-                        if (args.size() > 2) {
-                            payload.setChannels(args[2].toInt());
+                        if (args.hasNext()) {
+                            payload.setChannels(sdpToInt(args.next()));
                         }
                     }
                 }
-            } else if (attrName == QStringLiteral("ice-ufrag")) {
-                d->transportUser = attrValue;
-            } else if (attrName == QStringLiteral("ice-pwd")) {
-                d->transportPassword = attrValue;
-            } else if (attrName == QStringLiteral("setup")) {
-                d->transportFingerprintSetup = attrValue;
-            } else if (attrName == QStringLiteral("ssrc")) {
-                const QStringList bits = attrValue.split(' ');
-                if (bits.isEmpty()) {
-                    qWarning() << "Could not parse ssrc" << line;
-                    return false;
-                }
-                d->description.setSsrc(bits[0].toULong());
+            } else if (attrName == u"ice-ufrag") {
+                d->transportUser = attrValue.toString();
+            } else if (attrName == u"ice-pwd") {
+                d->transportPassword = attrValue.toString();
+            } else if (attrName == u"setup") {
+                d->transportFingerprintSetup = attrValue.toString();
+            } else if (attrName == u"ssrc") {
+                SdpTokenizer bits(attrValue, u' ');
+                d->description.setSsrc(QLocale::c().toUInt(bits.next()));
             }
-        } else if (line.startsWith(QStringLiteral("m="))) {
+        } else if (line.startsWith(u"m=")) {
             // FIXME: what do we do with the profile (bits[2]) ?
-            QStringList bits = line.mid(2).split(' ');
-            if (bits.size() < 3) {
+            SdpTokenizer bits(line.mid(2), u' ');
+            const auto media = bits.next();
+            int count = 1;
+            for (; count < 3 && bits.hasNext(); count++) {
+                bits.next();
+            }
+            if (count < 3) {
                 qWarning() << "Could not parse media" << line;
                 return false;
             }
-            d->description.setMedia(bits[0]);
+            d->description.setMedia(media.toString());
 
             // parse payload types
-            for (int i = 3; i < bits.size(); ++i) {
+            while (bits.hasNext()) {
                 bool ok = false;
-                int id = bits[i].toInt(&ok);
+                int id = sdpToInt(bits.next(), &ok);
                 if (!ok) {
                     continue;
                 }
@@ -959,18 +1108,22 @@ QString QXmppJingleIq::Content::toSdp() const
         }
     }
 
-    QStringList sdp;
+    QString sdp;
+    const auto addLine = [&sdp](const QString &line) {
+        sdp += line;
+        sdp += QStringLiteral("\r\n");
+    };
 
     // media
     QString payloads;
-    QStringList attrs;
+    QString attrs;
     for (const QXmppJinglePayloadType &payload : d->description.payloadTypes()) {
-        payloads += " " + QString::number(payload.id());
-        QString rtpmap = QString::number(payload.id()) + " " + payload.name() + "/" + QString::number(payload.clockrate());
+        payloads += u' ' + QString::number(payload.id());
+        attrs += QStringLiteral("a=rtpmap:") + QString::number(payload.id()) + u' ' + payload.name() + u'/' + QString::number(payload.clockrate());
         if (payload.channels() > 1) {
-            rtpmap += "/" + QString::number(payload.channels());
+            attrs += u'/' + QString::number(payload.channels());
         }
-        attrs << "a=rtpmap:" + rtpmap;
+        attrs += QStringLiteral("\r\n");
 
         // payload parameters
         QStringList paramList;
@@ -980,37 +1133,36 @@ QString QXmppJingleIq::Content::toSdp() const
                 paramList << params.value(QStringLiteral("events"));
             }
         } else {
-            QMap<QString, QString>::const_iterator i;
-            for (i = params.begin(); i != params.end(); ++i) {
-                paramList << i.key() + QStringLiteral("=") + i.value();
+            for (auto i = params.cbegin(); i != params.cend(); ++i) {
+                paramList << i.key() + u'=' + i.value();
             }
         }
         if (!paramList.isEmpty()) {
-            attrs << QStringLiteral("a=fmtp:") + QByteArray::number(payload.id()) + QStringLiteral(" ") + paramList.join("; ");
+            attrs += QStringLiteral("a=fmtp:") + QString::number(payload.id()) + u' ' + paramList.join(QStringLiteral("; ")) + QStringLiteral("\r\n");
         }
     }
-    sdp << QStringLiteral("m=%1 %2 RTP/AVP%3").arg(d->description.media(), QString::number(localRtpPort), payloads);
-    sdp << QStringLiteral("c=%1").arg(addressToSdp(localRtpAddress));
+    addLine(QStringLiteral("m=%1 %2 RTP/AVP%3").arg(d->description.media(), QString::number(localRtpPort), payloads));
+    addLine(QStringLiteral("c=%1").arg(addressToSdp(localRtpAddress)));
     sdp += attrs;
 
     // transport
     for (const auto &candidate : d->transportCandidates) {
-        sdp << QStringLiteral("a=%1").arg(candidateToSdp(candidate));
+        addLine(QStringLiteral("a=") + candidateToSdp(candidate));
     }
     if (!d->transportUser.isEmpty()) {
-        sdp << QStringLiteral("a=ice-ufrag:%1").arg(d->transportUser);
+        addLine(QStringLiteral("a=ice-ufrag:") + d->transportUser);
     }
     if (!d->transportPassword.isEmpty()) {
-        sdp << QStringLiteral("a=ice-pwd:%1").arg(d->transportPassword);
+        addLine(QStringLiteral("a=ice-pwd:") + d->transportPassword);
     }
     if (!d->transportFingerprint.isEmpty() && !d->transportFingerprintHash.isEmpty()) {
-        sdp << QStringLiteral("a=fingerprint:%1 %2").arg(d->transportFingerprintHash, formatFingerprint(d->transportFingerprint));
+        addLine(QStringLiteral("a=fingerprint:%1 %2").arg(d->transportFingerprintHash, formatFingerprint(d->transportFingerprint)));
     }
     if (!d->transportFingerprintSetup.isEmpty()) {
-        sdp << QStringLiteral("a=setup:%1").arg(d->transportFingerprintSetup);
+        addLine(QStringLiteral("a=setup:") + d->transportFingerprintSetup);
     }
 
-    return sdp.join("\r\n") + "\r\n";
+    return sdp;
 }
 
 /// \endcond
@@ -1159,6 +1311,7 @@ public:
     QXmppJingleReason reason;
 
     std::optional<QXmppJingleIq::RtpSessionState> rtpSessionState;
+    QVector<QXmppJingleIq::ContentGroup> contentGroups;
 };
 
 QXmppJingleIqPrivate::QXmppJingleIqPrivate()
@@ -1378,6 +1531,30 @@ void QXmppJingleIq::setRtpSessionState(const std::optional<RtpSessionState> &rtp
     d->action = Action::SessionInfo;
 }
 
+///
+/// Returns the groups of contents as specified by \xep{0338, Jingle Grouping Framework}.
+///
+/// \return the content groups
+///
+/// \since QXmpp 1.6
+///
+QVector<QXmppJingleIq::ContentGroup> QXmppJingleIq::contentGroups() const
+{
+    return d->contentGroups;
+}
+
+///
+/// Sets the groups of contents as specified by \xep{0338, Jingle Grouping Framework}.
+///
+/// \param contentGroups content groups
+///
+/// \since QXmpp 1.6
+///
+void QXmppJingleIq::setContentGroups(const QVector<ContentGroup> &contentGroups)
+{
+    d->contentGroups = contentGroups;
+}
+
 /// \cond
 bool QXmppJingleIq::isJingleIq(const QDomElement &element)
 {
@@ -1418,6 +1595,23 @@ void QXmppJingleIq::parseElementFromChild(const QDomElement &element)
     QDomElement reasonElement = jingleElement.firstChildElement(QStringLiteral("reason"));
     d->reason.parse(reasonElement);
 
+    // XEP-0338: Jingle Grouping Framework
+    d->contentGroups.clear();
+    for (auto groupElement = jingleElement.firstChildElement(QStringLiteral("group"));
+         !groupElement.isNull();
+         groupElement = groupElement.nextSiblingElement(QStringLiteral("group"))) {
+        if (groupElement.namespaceURI() == ns_jingle_grouping) {
+            ContentGroup group;
+            group.semantics = groupElement.attribute(QStringLiteral("semantics"));
+            for (auto contentElement = groupElement.firstChildElement(QStringLiteral("content"));
+                 !contentElement.isNull();
+                 contentElement = contentElement.nextSiblingElement(QStringLiteral("content"))) {
+                group.contentNames.append(contentElement.attribute(QStringLiteral("name")));
+            }
+            d->contentGroups.append(group);
+        }
+    }
+
     for (auto childElement = jingleElement.firstChildElement();
          !childElement.isNull();
          childElement = childElement.nextSiblingElement()) {
@@ -1471,6 +1665,19 @@ void QXmppJingleIq::toXmlElementFromChild(QXmlStreamWriter *writer) const
         content.toXml(writer);
     }
 
+    // XEP-0338: Jingle Grouping Framework
+    for (const auto &group : d->contentGroups) {
+        writer->writeStartElement(QStringLiteral("group"));
+        writer->writeDefaultNamespace(ns_jingle_grouping);
+        helperToXmlAddAttribute(writer, QStringLiteral("semantics"), group.semantics);
+        for (const auto &name : group.contentNames) {
+            writer->writeStartElement(QStringLiteral("content"));
+            helperToXmlAddAttribute(writer, QStringLiteral("name"), name);
+            writer->writeEndElement();
+        }
+        writer->writeEndElement();
+    }
+
     d->reason.toXml(writer);
 
     const auto writeStartElementWithNamespace = [=](const QString &tagName) {
@@ -2911,7 +3118,7 @@ void QXmppJingleRtpHeaderExtensionProperty::setParameters(const QVector<QXmppSdp
 /// \cond
 void QXmppJingleRtpHeaderExtensionProperty::parse(const QDomElement &element)
 {
-    if (element.tagName() == QStringLiteral("rtp-hdrext") && element.namespaceURI() == ns_jingle_rtp_header_extensions_negotiation) {
+    if (isElement(element, u"rtp-hdrext", ns_jingle_rtp_header_extensions_negotiation)) {
         d->id = element.attribute(QStringLiteral("id")).toUInt();
         d->uri = element.attribute(QStringLiteral("uri"));
 
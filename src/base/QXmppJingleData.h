@@ -7,6 +7,7 @@
 #ifndef QXMPPJINGLEIQ_H
 #define QXMPPJINGLEIQ_H
 
+#include "QXmppFileMetadata.h"
 #include "QXmppIq.h"
 
 #include <variant>
@@ -463,6 +464,14 @@ public:
 
     using RtpSessionState = std::variant<RtpSessionStateActive, RtpSessionStateHold, RtpSessionStateUnhold, RtpSessionStateMuting, RtpSessionStateRinging>;
 
+    struct ContentGroup
+    {
+        /// Semantics of the group, e.g. "BUNDLE"
+        QString semantics;
+        /// Names of the grouped contents
+        QStringList contentNames;
+    };
+
     /// Alias to QXmppJingleReason for compatibility.
     using Reason = QXmppJingleReason;
 
@@ -535,6 +544,10 @@ public:
         bool isRtpHeaderExtensionMixingAllowed() const;
         void setRtpHeaderExtensionMixingAllowed(bool isRtpHeaderExtensionMixingAllowed);
 
+        // XEP-0234: Jingle File Transfer
+        std::optional<QXmppFileMetadata> fileTransferFile() const;
+        void setFileTransferFile(const std::optional<QXmppFileMetadata> &file);
+
         // XEP-0320: Use of DTLS-SRTP in Jingle Sessions
         QByteArray transportFingerprint() const;
         void setTransportFingerprint(const QByteArray &fingerprint);
@@ -597,6 +610,9 @@ public:
     std::optional<RtpSessionState> rtpSessionState() const;
     void setRtpSessionState(const std::optional<RtpSessionState> &rtpSessionState);
 
+    QVector<ContentGroup> contentGroups() const;
+    void setContentGroups(const QVector<ContentGroup> &contentGroups);
+
     /// \cond
     static bool isJingleIq(const QDomElement &element);
     /// \endcond
@@ -5,15 +5,29 @@
 
 #include "QXmppLogger.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <thread>
 
 #include <QChildEvent>
 #include <QDateTime>
+#include <QDeadlineTimer>
 #include <QFile>
+#include <QMetaMethod>
 #include <QMetaType>
-#include <QTextStream>
+#include <QMutex>
+#include <QSemaphore>
+#include <QThread>
 
 QXmppLogger *QXmppLogger::m_logger = nullptr;
+std::atomic<int> QXmppLogger::s_enabledMessageTypes = QXmppLogger::NoMessage;
+
+// number of loggers handling each message type, indexed by the bit of the type
+static QMutex enabledMessageTypesMutex;
+static int enabledMessageTypeCounts[5] = {};
 
 static const char *typeName(QXmppLogger::MessageType type)
 {
@@ -33,37 +47,249 @@ static const char *typeName(QXmppLogger::MessageType type)
     }
 }
 
-static QString formatted(QXmppLogger::MessageType type, const QString &text)
+static QString formatted(QXmppLogger::MessageType type, const QString &text, const QDateTime &time = QDateTime::currentDateTime())
 {
-    return QDateTime::currentDateTime().toString() + " " +
+    return time.toString() + " " +
         QString::fromLatin1(typeName(type)) + " " +
         text;
 }
 
-static void relaySignals(QXmppLoggable *from, QXmppLoggable *to)
+namespace {
+
+// Writes to the log file and rotates it.
+class LogFileWriter
 {
-    QObject::connect(from, &QXmppLoggable::logMessage,
-                     to, &QXmppLoggable::logMessage);
-    QObject::connect(from, &QXmppLoggable::setGauge,
-                     to, &QXmppLoggable::setGauge);
-    QObject::connect(from, &QXmppLoggable::updateCounter,
-                     to, &QXmppLoggable::updateCounter);
-}
+public:
+    LogFileWriter(const QString &path, qint64 maximumSize, int rotationInterval)
+        : m_path(path), m_maximumSize(maximumSize), m_rotationInterval(rotationInterval)
+    {
+    }
+
+    // Returns whether data of the given size can be written without rotating
+    // the file because of its size.
+    bool fits(qint64 size)
+    {
+        if (!m_file.isOpen()) {
+            open();
+        }
+        return m_maximumSize <= 0 || m_file.size() == 0 || m_file.size() + size <= m_maximumSize;
+    }
+
+    void write(const QByteArray &data)
+    {
+        if (!fits(data.size()) || m_rotationDeadline.hasExpired()) {
+            rotate();
+        }
+        m_file.write(data);
+    }
+
+    void flush()
+    {
+        m_file.flush();
+    }
+
+private:
+    void open()
+    {
+        m_file.setFileName(m_path);
+        m_file.open(QIODevice::WriteOnly | QIODevice::Append);
+        m_rotationDeadline = m_rotationInterval > 0 ? QDeadlineTimer(qint64(m_rotationInterval) * 1000) : QDeadlineTimer(QDeadlineTimer::Forever);
+    }
+
+    // Renames the current file to the path with a timestamp appended,
+    // e.g. 'QXmppClientLog.log.20240101-120000', and opens a new file.
+    void rotate()
+    {
+        m_file.close();
+
+        const auto base = m_path + QLatin1Char('.') + QDateTime::currentDateTime().toString(QStringLiteral("yyyyMMdd-hhmmss"));
+        auto rotatedPath = base;
+        for (int i = 1; QFile::exists(rotatedPath); i++) {
+            rotatedPath = base + QLatin1Char('-') + QString::number(i);
+        }
+        QFile::rename(m_path, rotatedPath);
+
+        open();
+    }
+
+    QFile m_file;
+    QString m_path;
+    qint64 m_maximumSize;
+    int m_rotationInterval;
+    QDeadlineTimer m_rotationDeadline;
+};
+
+// Lock-free unbounded multi-producer single-consumer queue (Dmitry Vyukov's
+// node-based algorithm). Producers only need one atomic exchange.
+template<typename T>
+class MpscQueue
+{
+public:
+    MpscQueue()
+        : m_head(new Node), m_tail(m_head.load())
+    {
+    }
+    ~MpscQueue()
+    {
+        while (m_tail) {
+            auto *next = m_tail->next.load();
+            delete m_tail;
+            m_tail = next;
+        }
+    }
+
+    // May be called from any thread.
+    void push(T &&value)
+    {
+        auto *node = new Node { {}, std::move(value) };
+        auto *previous = m_head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    // May only be called from the consumer thread. Values that are being
+    // pushed may not be visible yet.
+    std::optional<T> pop()
+    {
+        auto *next = m_tail->next.load(std::memory_order_acquire);
+        if (!next) {
+            return {};
+        }
+        auto value = std::move(next->value);
+        delete m_tail;
+        m_tail = next;
+        return value;
+    }
+
+private:
+    struct Node
+    {
+        std::atomic<Node *> next = nullptr;
+        T value;
+    };
+
+    std::atomic<Node *> m_head;
+    Node *m_tail;
+};
+
+// Formats and writes log messages on a writer thread.
+class AsyncLogWriter
+{
+public:
+    // maximum time before queued messages are written
+    static constexpr int FlushInterval = 100;
+    static constexpr int BatchSize = 64 * 1024;
+
+    AsyncLogWriter(std::unique_ptr<LogFileWriter> file, int maximumQueuedMessages)
+        : m_file(std::move(file)),
+          m_maximumQueuedMessages(maximumQueuedMessages),
+          m_thread([this]() { run(); })
+    {
+    }
+    ~AsyncLogWriter()
+    {
+        // the remaining messages are written before the thread exits
+        m_stopping.store(true, std::memory_order_release);
+        m_wakeUp.release();
+        m_thread.join();
+    }
+
+    void log(QXmppLogger::MessageType type, const QString &text)
+    {
+        const auto queued = m_queued.fetch_add(1, std::memory_order_relaxed);
+        if (queued >= m_maximumQueuedMessages) {
+            // the writer can't keep up, drop the newest messages
+            m_queued.fetch_sub(1, std::memory_order_relaxed);
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        m_queue.push({ QDateTime::currentMSecsSinceEpoch(), type, text });
+
+        // the writer only needs to be woken up if it has drained the queue
+        if (queued == 0) {
+            m_wakeUp.release();
+        }
+    }
+
+private:
+    struct Entry
+    {
+        qint64 time;
+        QXmppLogger::MessageType type;
+        QString text;
+    };
+
+    void run()
+    {
+        QByteArray buffer;
+        while (true) {
+            const auto stopping = m_stopping.load(std::memory_order_acquire);
+
+            while (auto entry = m_queue.pop()) {
+                m_queued.fetch_sub(1, std::memory_order_relaxed);
+                const auto line = formatted(entry->type, entry->text, QDateTime::fromMSecsSinceEpoch(entry->time)).toUtf8() + '\n';
+
+                // the file may only be rotated between two batches
+                if (!buffer.isEmpty() && (buffer.size() >= BatchSize || !m_file->fits(buffer.size() + line.size()))) {
+                    m_file->write(buffer);
+                    buffer.clear();
+                }
+                buffer += line;
+            }
+
+            if (const auto dropped = m_dropped.exchange(0, std::memory_order_relaxed)) {
+                buffer += formatted(QXmppLogger::WarningMessage, QStringLiteral("%1 log messages have been dropped").arg(dropped)).toUtf8();
+                buffer += '\n';
+            }
+
+            if (!buffer.isEmpty()) {
+                m_file->write(buffer);
+                m_file->flush();
+                buffer.clear();
+            }
+
+            if (stopping) {
+                break;
+            }
+            m_wakeUp.tryAcquire(1, FlushInterval);
+        }
+    }
+
+    std::unique_ptr<LogFileWriter> m_file;
+    const int m_maximumQueuedMessages;
+    MpscQueue<Entry> m_queue;
+    std::atomic<int> m_queued = 0;
+    std::atomic<quint64> m_dropped = 0;
+    std::atomic<bool> m_stopping = false;
+    QSemaphore m_wakeUp;
+    // started last, after all other members have been initialized
+    std::thread m_thread;
+};
+
+}  // namespace
 
 /// Constructs a new QXmppLoggable.
 ///
 /// \param parent
 
 QXmppLoggable::QXmppLoggable(QObject *parent)
-    : QObject(parent)
+    : QObject(parent),
+      m_logParent(qobject_cast<QXmppLoggable *>(parent))
 {
-    auto *logParent = qobject_cast<QXmppLoggable *>(parent);
-    if (logParent) {
-        relaySignals(this, logParent);
-    }
 }
 
 /// \cond
+QXmppLoggable::~QXmppLoggable()
+{
+    // the children are deleted by ~QObject(), when this object is not a
+    // loggable anymore
+    for (auto *child : children()) {
+        if (auto *loggable = qobject_cast<QXmppLoggable *>(child); loggable && loggable->m_logParent == this) {
+            loggable->m_logParent = nullptr;
+        }
+    }
+}
+
 void QXmppLoggable::childEvent(QChildEvent *event)
 {
     auto *child = qobject_cast<QXmppLoggable *>(event->child());
@@ -72,32 +298,115 @@ void QXmppLoggable::childEvent(QChildEvent *event)
     }
 
     if (event->added()) {
-        relaySignals(child, this);
-    } else if (event->removed()) {
-        disconnect(child, &QXmppLoggable::logMessage,
-                   this, &QXmppLoggable::logMessage);
-        disconnect(child, &QXmppLoggable::setGauge,
-                   this, &QXmppLoggable::setGauge);
-        disconnect(child, &QXmppLoggable::updateCounter,
-                   this, &QXmppLoggable::updateCounter);
+        child->m_logParent = this;
+    } else if (event->removed() && child->m_logParent == this) {
+        child->m_logParent = nullptr;
     }
 }
 /// \endcond
 
+///
+/// Sets the logger to which the messages of this object and its loggable
+/// children are passed directly.
+///
+/// Messages are still emitted as logMessage() for receivers connected to the
+/// signal of this object or one of its ancestors.
+///
+/// \since QXmpp 1.6
+///
+void QXmppLoggable::setLogSink(QXmppLogger *logger)
+{
+    m_logSink = logger;
+}
+
+bool QXmppLoggable::hasLogSink() const
+{
+    static const auto logSignal = QMetaMethod::fromSignal(&QXmppLoggable::logMessage);
+    for (auto *loggable = this; loggable; loggable = loggable->m_logParent) {
+        if (loggable->m_logSink || loggable->isSignalConnected(logSignal)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void QXmppLoggable::emitLog(QXmppLogger::MessageType type, const QString &text)
+{
+    static const auto logSignal = QMetaMethod::fromSignal(&QXmppLoggable::logMessage);
+    for (auto *loggable = this; loggable; loggable = loggable->m_logParent) {
+        // compatibility path for receivers of the signal
+        if (loggable->isSignalConnected(logSignal)) {
+            Q_EMIT loggable->logMessage(type, text);
+        }
+
+        if (auto *logger = loggable->m_logSink.data()) {
+            if (logger->thread() == QThread::currentThread()) {
+                logger->log(type, text);
+            } else {
+                QMetaObject::invokeMethod(
+                    logger, [logger, type, text] { logger->log(type, text); }, Qt::QueuedConnection);
+            }
+        }
+    }
+}
+
 class QXmppLoggerPrivate
 {
 public:
     QXmppLoggerPrivate();
 
+    std::unique_ptr<LogFileWriter> createFileWriter() const;
+    QXmppLogger::MessageTypes enabledMessageTypes() const;
+    static void updateEnabledMessageTypes(QXmppLogger::MessageTypes removed, QXmppLogger::MessageTypes added);
+
     QXmppLogger::LoggingType loggingType;
-    QFile *logFile;
+    std::unique_ptr<LogFileWriter> logFile;
+    std::unique_ptr<AsyncLogWriter> asyncLogFile;
     QString logFilePath;
     QXmppLogger::MessageTypes messageTypes;
+    bool asynchronousFileLogging;
+    int maximumQueuedMessages;
+    qint64 maximumLogFileSize;
+    int logFileRotationInterval;
 };
 
 QXmppLoggerPrivate::QXmppLoggerPrivate()
-    : loggingType(QXmppLogger::NoLogging), logFile(nullptr), logFilePath("QXmppClientLog.log"), messageTypes(QXmppLogger::AnyMessage)
+    : loggingType(QXmppLogger::NoLogging),
+      logFilePath("QXmppClientLog.log"),
+      messageTypes(QXmppLogger::AnyMessage),
+      asynchronousFileLogging(false),
+      maximumQueuedMessages(65536),
+      maximumLogFileSize(0),
+      logFileRotationInterval(0)
+{
+}
+
+std::unique_ptr<LogFileWriter> QXmppLoggerPrivate::createFileWriter() const
+{
+    return std::make_unique<LogFileWriter>(logFilePath, maximumLogFileSize, logFileRotationInterval);
+}
+
+QXmppLogger::MessageTypes QXmppLoggerPrivate::enabledMessageTypes() const
 {
+    return loggingType == QXmppLogger::NoLogging ? QXmppLogger::NoMessage : messageTypes;
+}
+
+void QXmppLoggerPrivate::updateEnabledMessageTypes(QXmppLogger::MessageTypes removed, QXmppLogger::MessageTypes added)
+{
+    if (removed == added) {
+        return;
+    }
+
+    QMutexLocker locker(&enabledMessageTypesMutex);
+    int types = QXmppLogger::NoMessage;
+    for (int i = 0; i < 5; i++) {
+        const auto type = QXmppLogger::MessageType(1 << i);
+        enabledMessageTypeCounts[i] += int(added.testFlag(type)) - int(removed.testFlag(type));
+        if (enabledMessageTypeCounts[i] > 0) {
+            types |= type;
+        }
+    }
+    QXmppLogger::s_enabledMessageTypes.store(types, std::memory_order_relaxed);
 }
 
 /// Constructs a new QXmppLogger.
@@ -113,6 +422,7 @@ QXmppLogger::QXmppLogger(QObject *parent)
 
 QXmppLogger::~QXmppLogger()
 {
+    QXmppLoggerPrivate::updateEnabledMessageTypes(d->enabledMessageTypes(), NoMessage);
     delete d;
 }
 
@@ -140,7 +450,9 @@ QXmppLogger::LoggingType QXmppLogger::loggingType()
 void QXmppLogger::setLoggingType(QXmppLogger::LoggingType type)
 {
     if (d->loggingType != type) {
+        const auto enabledTypes = d->enabledMessageTypes();
         d->loggingType = type;
+        QXmppLoggerPrivate::updateEnabledMessageTypes(enabledTypes, d->enabledMessageTypes());
         reopen();
     }
 }
@@ -156,7 +468,9 @@ QXmppLogger::MessageTypes QXmppLogger::messageTypes()
 
 void QXmppLogger::setMessageTypes(QXmppLogger::MessageTypes types)
 {
+    const auto enabledTypes = d->enabledMessageTypes();
     d->messageTypes = types;
+    QXmppLoggerPrivate::updateEnabledMessageTypes(enabledTypes, d->enabledMessageTypes());
 }
 
 /// Add a logging message.
@@ -173,11 +487,17 @@ void QXmppLogger::log(QXmppLogger::MessageType type, const QString &text)
 
     switch (d->loggingType) {
     case QXmppLogger::FileLogging:
-        if (!d->logFile) {
-            d->logFile = new QFile(d->logFilePath);
-            d->logFile->open(QIODevice::WriteOnly | QIODevice::Append);
+        if (d->asynchronousFileLogging) {
+            if (!d->asyncLogFile) {
+                d->asyncLogFile = std::make_unique<AsyncLogWriter>(d->createFileWriter(), d->maximumQueuedMessages);
+            }
+            d->asyncLogFile->log(type, text);
+        } else {
+            if (!d->logFile) {
+                d->logFile = d->createFileWriter();
+            }
+            d->logFile->write(formatted(type, text).toUtf8() + '\n');
         }
-        QTextStream(d->logFile) << formatted(type, text) << "\n";
         break;
     case QXmppLogger::StdoutLogging:
         std::cout << qPrintable(formatted(type, text)) << std::endl;
@@ -229,13 +549,133 @@ void QXmppLogger::setLogFilePath(const QString &path)
     }
 }
 
+///
+/// Returns whether messages are written to the log file by a separate thread.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppLogger::isAsynchronousFileLoggingEnabled() const
+{
+    return d->asynchronousFileLogging;
+}
+
+///
+/// Sets whether messages are written to the log file by a separate thread.
+///
+/// With asynchronous file logging, log() only queues the message. Formatting
+/// and writing is done by a writer thread that writes the queued messages in
+/// batches. The messages are written at the latest after 100 ms.
+///
+/// This is disabled by default.
+///
+/// \sa setMaximumQueuedMessages()
+///
+/// \since QXmpp 1.6
+///
+void QXmppLogger::setAsynchronousFileLoggingEnabled(bool enabled)
+{
+    if (d->asynchronousFileLogging != enabled) {
+        d->asynchronousFileLogging = enabled;
+        reopen();
+    }
+}
+
+///
+/// Returns the maximum number of messages waiting to be written with
+/// asynchronous file logging.
+///
+/// \since QXmpp 1.6
+///
+int QXmppLogger::maximumQueuedMessages() const
+{
+    return d->maximumQueuedMessages;
+}
+
+///
+/// Sets the maximum number of messages waiting to be written with
+/// asynchronous file logging.
+///
+/// When the queue is full, new messages are dropped. The number of dropped
+/// messages is written to the log file when there is space in the queue
+/// again.
+///
+/// The default is 65536.
+///
+/// \since QXmpp 1.6
+///
+void QXmppLogger::setMaximumQueuedMessages(int count)
+{
+    if (d->maximumQueuedMessages != count) {
+        d->maximumQueuedMessages = std::max(count, 1);
+        reopen();
+    }
+}
+
+///
+/// Returns the size in bytes at which the log file is rotated.
+///
+/// \since QXmpp 1.6
+///
+qint64 QXmppLogger::maximumLogFileSize() const
+{
+    return d->maximumLogFileSize;
+}
+
+///
+/// Sets the size in bytes at which the log file is rotated.
+///
+/// When writing a message would make the log file exceed this size, the file
+/// is renamed to the log file path with the current time appended, e.g.
+/// 'QXmppClientLog.log.20240101-120000', and a new file is started.
+///
+/// The default of 0 disables rotation by size.
+///
+/// \since QXmpp 1.6
+///
+void QXmppLogger::setMaximumLogFileSize(qint64 size)
+{
+    if (d->maximumLogFileSize != size) {
+        d->maximumLogFileSize = size;
+        reopen();
+    }
+}
+
+///
+/// Returns the interval in seconds after which the log file is rotated.
+///
+/// \since QXmpp 1.6
+///
+int QXmppLogger::logFileRotationInterval() const
+{
+    return d->logFileRotationInterval;
+}
+
+///
+/// Sets the interval in seconds after which the log file is rotated.
+///
+/// The interval starts when the file is opened. The file is rotated with the
+/// next message after the interval has passed, see setMaximumLogFileSize().
+///
+/// The default of 0 disables rotation by time.
+///
+/// \since QXmpp 1.6
+///
+void QXmppLogger::setLogFileRotationInterval(int seconds)
+{
+    if (d->logFileRotationInterval != seconds) {
+        d->logFileRotationInterval = seconds;
+        reopen();
+    }
+}
+
 /// If logging to a file, causes the file to be re-opened.
 ///
+/// With asynchronous file logging, all queued messages are written before.
+///
 
 void QXmppLogger::reopen()
 {
-    if (d->logFile) {
-        delete d->logFile;
-        d->logFile = nullptr;
-    }
+    d->logFile.reset();
+    // waits until all queued messages have been written
+    d->asyncLogFile.reset();
 }
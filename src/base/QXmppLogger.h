@@ -8,7 +8,10 @@
 
 #include "QXmppGlobal.h"
 
+#include <atomic>
+
 #include <QObject>
+#include <QPointer>
 
 #ifdef QXMPP_LOGGABLE_TRACE
 #define qxmpp_loggable_trace(x) QString("%1(0x%2) %3").arg(metaObject()->className(), QString::number(reinterpret_cast<qint64>(this), 16), x)
@@ -81,6 +84,18 @@ public:
     QXmppLogger::MessageTypes messageTypes();
     void setMessageTypes(QXmppLogger::MessageTypes types);
 
+    bool isAsynchronousFileLoggingEnabled() const;
+    void setAsynchronousFileLoggingEnabled(bool enabled);
+
+    int maximumQueuedMessages() const;
+    void setMaximumQueuedMessages(int count);
+
+    qint64 maximumLogFileSize() const;
+    void setMaximumLogFileSize(qint64 size);
+
+    int logFileRotationInterval() const;
+    void setLogFileRotationInterval(int seconds);
+
 public Q_SLOTS:
     virtual void setGauge(const QString &gauge, double value);
     virtual void updateCounter(const QString &counter, qint64 amount);
@@ -93,7 +108,11 @@ Q_SIGNALS:
     void message(QXmppLogger::MessageType type, const QString &text);
 
 private:
+    friend class QXmppLoggable;
+
     static QXmppLogger *m_logger;
+    // message types that are handled by any logger of the process
+    static std::atomic<int> s_enabledMessageTypes;
     QXmppLoggerPrivate *d;
 };
 
@@ -107,19 +126,37 @@ class QXMPP_EXPORT QXmppLoggable : public QObject
 
 public:
     QXmppLoggable(QObject *parent = nullptr);
+    ~QXmppLoggable() override;
 
 protected:
     /// \cond
     void childEvent(QChildEvent *event) override;
     /// \endcond
 
+    void setLogSink(QXmppLogger *logger);
+
+    ///
+    /// Returns whether messages of the given type would be logged.
+    ///
+    /// This is the case if this object is connected to a logger, e.g. through
+    /// its parent, and any QXmppLogger handles messages of the type. Use this
+    /// to skip building expensive messages that would be discarded.
+    ///
+    /// \since QXmpp 1.6
+    ///
+    bool isLoggingEnabled(QXmppLogger::MessageType type) const
+    {
+        return (QXmppLogger::s_enabledMessageTypes.load(std::memory_order_relaxed) & type) &&
+            hasLogSink();
+    }
+
     /// Logs a debugging message.
     ///
     /// \param message
 
     void debug(const QString &message)
     {
-        Q_EMIT logMessage(QXmppLogger::DebugMessage, qxmpp_loggable_trace(message));
+        emitLog(QXmppLogger::DebugMessage, qxmpp_loggable_trace(message));
     }
 
     /// Logs an informational message.
@@ -128,7 +165,7 @@ protected:
 
     void info(const QString &message)
     {
-        Q_EMIT logMessage(QXmppLogger::InformationMessage, qxmpp_loggable_trace(message));
+        emitLog(QXmppLogger::InformationMessage, qxmpp_loggable_trace(message));
     }
 
     /// Logs a warning message.
@@ -137,7 +174,7 @@ protected:
 
     void warning(const QString &message)
     {
-        Q_EMIT logMessage(QXmppLogger::WarningMessage, qxmpp_loggable_trace(message));
+        emitLog(QXmppLogger::WarningMessage, qxmpp_loggable_trace(message));
     }
 
     /// Logs a received packet.
@@ -146,7 +183,7 @@ protected:
 
     void logReceived(const QString &message)
     {
-        Q_EMIT logMessage(QXmppLogger::ReceivedMessage, qxmpp_loggable_trace(message));
+        emitLog(QXmppLogger::ReceivedMessage, qxmpp_loggable_trace(message));
     }
 
     /// Logs a sent packet.
@@ -155,7 +192,7 @@ protected:
 
     void logSent(const QString &message)
     {
-        Q_EMIT logMessage(QXmppLogger::SentMessage, qxmpp_loggable_trace(message));
+        emitLog(QXmppLogger::SentMessage, qxmpp_loggable_trace(message));
     }
 
 Q_SIGNALS:
@@ -167,6 +204,14 @@ Q_SIGNALS:
 
     /// Updates the given \a counter by \a amount.
     void updateCounter(const QString &counter, qint64 amount = 1);
+
+private:
+    bool hasLogSink() const;
+    void emitLog(QXmppLogger::MessageType type, const QString &text);
+
+    // nearest loggable ancestor, the object tree is not walked for each message
+    QXmppLoggable *m_logParent = nullptr;
+    QPointer<QXmppLogger> m_logSink;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(QXmppLogger::MessageTypes)
@@ -10,6 +10,7 @@
 
 #include "QXmppBitsOfBinaryDataList.h"
 #include "QXmppConstants_p.h"
+#include "QXmppEnumStrings_p.h"
 #include "QXmppFileShare.h"
 #include "QXmppGlobal_p.h"
 #include "QXmppJingleData.h"
@@ -23,45 +24,126 @@
 #include "QXmppTrustMessageElement.h"
 #include "QXmppUtils.h"
 
+#include <memory>
+
 #include <QDateTime>
 #include <QDomElement>
+#include <QHash>
+#include <QSet>
 #include <QTextStream>
 #include <QXmlStreamWriter>
 
-static const QStringList CHAT_STATES = {
-    QString(),
-    QStringLiteral("active"),
-    QStringLiteral("inactive"),
-    QStringLiteral("gone"),
-    QStringLiteral("composing"),
-    QStringLiteral("paused")
-};
+constexpr auto CHAT_STATES = enumStrings<QXmppMessage::State>(
+    u"",
+    u"active",
+    u"inactive",
+    u"gone",
+    u"composing",
+    u"paused");
+
+constexpr auto MESSAGE_TYPES = enumStrings<QXmppMessage::Type>(
+    u"error",
+    u"normal",
+    u"chat",
+    u"groupchat",
+    u"headline");
+
+constexpr auto MARKER_TYPES = enumStrings<QXmppMessage::Marker>(
+    u"",
+    u"received",
+    u"displayed",
+    u"acknowledged");
+
+// indexed by the bit of the hint
+constexpr auto HINT_TYPES = enumStrings<int>(
+    u"no-permanent-store",
+    u"no-store",
+    u"no-copy",
+    u"store");
+constexpr int HINT_COUNT = 4;
 
-static const QStringList MESSAGE_TYPES = {
-    QStringLiteral("error"),
-    QStringLiteral("normal"),
-    QStringLiteral("chat"),
-    QStringLiteral("groupchat"),
-    QStringLiteral("headline")
-};
+static bool checkElement(const QDomElement &element, const QString &tagName, const QString &xmlns)
+{
+    return element.tagName() == tagName && element.namespaceURI() == xmlns;
+}
 
-static const QStringList MARKER_TYPES = {
-    QString(),
-    QStringLiteral("received"),
-    QStringLiteral("displayed"),
-    QStringLiteral("acknowledged")
+// Extensions parsed by QXmppMessage, looked up by their namespace
+enum class MessageExtension {
+    Carbons,
+    Hints,
+    JingleMessageInitiation,
+    StanzaIds,
+    Mix,
+    ExplicitEncryption,
+    Omemo,
+    FallbackIndication,
+    CallInvites,
+    LegacyDelayedDelivery,
+    MucInvitations,
+    OutOfBandData,
+    XhtmlIm,
+    ChatStates,
+    Receipts,
+    DelayedDelivery,
+    Attention,
+    BitsOfBinary,
+    MessageCorrection,
+    ChatMarkers,
+    MessageAttaching,
+    Spoiler,
+    MixMisc,
+    TrustMessages,
+    Reactions,
+    StatelessFileSharing,
 };
 
-static const QStringList HINT_TYPES = {
-    QStringLiteral("no-permanent-store"),
-    QStringLiteral("no-store"),
-    QStringLiteral("no-copy"),
-    QStringLiteral("store")
+struct MessageNamespace
+{
+    MessageExtension extension;
+    // whether the element is parsed with QXmpp::ScePublic or QXmpp::SceSensitive
+    bool isPublic;
 };
 
-static bool checkElement(const QDomElement &element, const QString &tagName, const QString &xmlns)
-{
-    return element.tagName() == tagName && element.namespaceURI() == xmlns;
+static const QHash<QString, MessageNamespace> &messageNamespaces()
+{
+    static const QHash<QString, MessageNamespace> namespaces = {
+        { ns_carbons, { MessageExtension::Carbons, true } },
+        { ns_message_processing_hints, { MessageExtension::Hints, true } },
+        { ns_jingle_message_initiation, { MessageExtension::JingleMessageInitiation, true } },
+        { ns_sid, { MessageExtension::StanzaIds, true } },
+        { ns_mix, { MessageExtension::Mix, true } },
+        { ns_eme, { MessageExtension::ExplicitEncryption, true } },
+        { ns_omemo_2, { MessageExtension::Omemo, true } },
+        { ns_fallback_indication, { MessageExtension::FallbackIndication, true } },
+        { ns_call_invites, { MessageExtension::CallInvites, true } },
+        { ns_legacy_delayed_delivery, { MessageExtension::LegacyDelayedDelivery, false } },
+        { ns_conference, { MessageExtension::MucInvitations, false } },
+        { ns_oob, { MessageExtension::OutOfBandData, false } },
+        { ns_xhtml_im, { MessageExtension::XhtmlIm, false } },
+        { ns_chat_states, { MessageExtension::ChatStates, false } },
+        { ns_message_receipts, { MessageExtension::Receipts, false } },
+        { ns_delayed_delivery, { MessageExtension::DelayedDelivery, false } },
+        { ns_attention, { MessageExtension::Attention, false } },
+        { ns_bob, { MessageExtension::BitsOfBinary, false } },
+        { ns_message_correct, { MessageExtension::MessageCorrection, false } },
+        { ns_chat_markers, { MessageExtension::ChatMarkers, false } },
+        { ns_message_attaching, { MessageExtension::MessageAttaching, false } },
+        { ns_spoiler, { MessageExtension::Spoiler, false } },
+        { ns_mix_misc, { MessageExtension::MixMisc, false } },
+        { ns_tm, { MessageExtension::TrustMessages, false } },
+        { ns_reactions, { MessageExtension::Reactions, false } },
+        { ns_sfs, { MessageExtension::StatelessFileSharing, false } },
+    };
+    return namespaces;
+}
+
+// Returns whether an element is parsed with the given namespaces, elements of
+// XMPP-Core are always parsed.
+static bool isParsed(const QDomElement &element, const QSet<QString> &parsedNamespaces)
+{
+    const auto tagName = element.tagName();
+    return tagName == u"body" || tagName == u"subject" || tagName == u"thread" ||
+        parsedNamespaces.contains(element.namespaceURI());
 }
 
 enum StampType {
@@ -69,11 +151,88 @@ enum StampType {
     DelayedDelivery         // XEP-0203: Delayed Delivery
 };
 
+// Extensions that are rarely used, only allocated when one of them is present
+struct QXmppMessageExtras
+{
+    // XEP-0231: Bits of Binary
+    QXmppBitsOfBinaryDataList bitsOfBinaryData;
+
+    // XEP-0249: Direct MUC Invitations
+    QString mucInvitationJid;
+    QString mucInvitationPassword;
+    QString mucInvitationReason;
+
+    // XEP-0353: Jingle Message Initiation
+    std::optional<QXmppJingleMessageInitiationElement> jingleMessageInitiationElement;
+
+    // XEP-0369: Mediated Information eXchange (MIX)
+    QString mixUserJid;
+    QString mixUserNick;
+
+    // XEP-0380: Explicit Message Encryption
+    QString encryptionMethod;
+    QString encryptionName;
+
+    // XEP-0382: Spoiler messages
+    QString spoilerHint;
+#ifdef BUILD_OMEMO
+    // XEP-0384: OMEMO Encryption
+    std::optional<QXmppOmemoElement> omemoElement;
+#endif
+    // XEP-0407: Mediated Information eXchange (MIX): Miscellaneous Capabilities
+    std::optional<QXmppMixInvitation> mixInvitation;
+
+    // XEP-0434: Trust Messages (TM)
+    std::optional<QXmppTrustMessageElement> trustMessageElement;
+
+    // XEP-0444: Message Reactions
+    std::optional<QXmppMessageReaction> reaction;
+
+    // XEP-0482: Call Invites
+    std::optional<QXmppCallInviteElement> callInviteElement;
+};
+
+// Owns the extras of a message, copies are deep.
+class QXmppMessageExtrasPointer
+{
+public:
+    QXmppMessageExtrasPointer() = default;
+    QXmppMessageExtrasPointer(const QXmppMessageExtrasPointer &other)
+        : m_extras(other.m_extras ? std::make_unique<QXmppMessageExtras>(*other.m_extras) : nullptr)
+    {
+    }
+    QXmppMessageExtrasPointer &operator=(const QXmppMessageExtrasPointer &other)
+    {
+        m_extras = other.m_extras ? std::make_unique<QXmppMessageExtras>(*other.m_extras) : nullptr;
+        return *this;
+    }
+
+    const QXmppMessageExtras &get() const
+    {
+        static const QXmppMessageExtras empty;
+        return m_extras ? *m_extras : empty;
+    }
+    QXmppMessageExtras &get()
+    {
+        if (!m_extras) {
+            m_extras = std::make_unique<QXmppMessageExtras>();
+        }
+        return *m_extras;
+    }
+
+private:
+    std::unique_ptr<QXmppMessageExtras> m_extras;
+};
+
 class QXmppMessagePrivate : public QSharedData
 {
 public:
     QXmppMessagePrivate();
 
+    // Returns the rarely used extensions, allocates them if non-const.
+    const QXmppMessageExtras &extras() const { return m_extras.get(); }
+    QXmppMessageExtras &extras() { return m_extras.get(); }
+
     QString body;
     QString e2eeFallbackBody;
     QString subject;
@@ -101,14 +260,6 @@ public:
     // XEP-0224: Attention
     bool attentionRequested;
 
-    // XEP-0231: Bits of Binary
-    QXmppBitsOfBinaryDataList bitsOfBinaryData;
-
-    // XEP-0249: Direct MUC Invitations
-    QString mucInvitationJid;
-    QString mucInvitationPassword;
-    QString mucInvitationReason;
-
     // XEP-0280: Message Carbons
     bool privatemsg;
     bool isCarbonForwarded;
@@ -125,9 +276,6 @@ public:
     // XEP-0334: Message Processing Hints
     quint8 hints;
 
-    // XEP-0353: Jingle Message Initiation
-    std::optional<QXmppJingleMessageInitiationElement> jingleMessageInitiationElement;
-
     // XEP-0359: Unique and Stable Stanza IDs
     QString stanzaId;
     QString stanzaIdBy;
@@ -136,38 +284,20 @@ public:
     // XEP-0367: Message Attaching
     QString attachId;
 
-    // XEP-0369: Mediated Information eXchange (MIX)
-    QString mixUserJid;
-    QString mixUserNick;
-
-    // XEP-0380: Explicit Message Encryption
-    QString encryptionMethod;
-    QString encryptionName;
-
     // XEP-0382: Spoiler messages
     bool isSpoiler;
-    QString spoilerHint;
-#ifdef BUILD_OMEMO
-    // XEP-0384: OMEMO Encryption
-    std::optional<QXmppOmemoElement> omemoElement;
-#endif
-    // XEP-0407: Mediated Information eXchange (MIX): Miscellaneous Capabilities
-    std::optional<QXmppMixInvitation> mixInvitation;
 
     // XEP-0428: Fallback Indication
     bool isFallback;
 
-    // XEP-0434: Trust Messages (TM)
-    std::optional<QXmppTrustMessageElement> trustMessageElement;
-
-    // XEP-0444: Message Reactions
-    std::optional<QXmppMessageReaction> reaction;
-
     // XEP-0448: Encryption for stateless file sharing
     QVector<QXmppFileShare> sharedFiles;
 
-    // XEP-0482: Call Invites
-    std::optional<QXmppCallInviteElement> callInviteElement;
+    // only set while parsing, extensions with other namespaces are not parsed
+    const QSet<QString> *parsedNamespaces = nullptr;
+
+private:
+    QXmppMessageExtrasPointer m_extras;
 };
 
 QXmppMessagePrivate::QXmppMessagePrivate()
@@ -533,7 +663,7 @@ void QXmppMessage::setAttentionRequested(bool requested)
 ///
 QXmppBitsOfBinaryDataList QXmppMessage::bitsOfBinaryData() const
 {
-    return d->bitsOfBinaryData;
+    return d->extras().bitsOfBinaryData;
 }
 
 ///
@@ -545,7 +675,7 @@ QXmppBitsOfBinaryDataList QXmppMessage::bitsOfBinaryData() const
 ///
 QXmppBitsOfBinaryDataList &QXmppMessage::bitsOfBinaryData()
 {
-    return d->bitsOfBinaryData;
+    return d->extras().bitsOfBinaryData;
 }
 
 ///
@@ -555,7 +685,7 @@ QXmppBitsOfBinaryDataList &QXmppMessage::bitsOfBinaryData()
 ///
 void QXmppMessage::setBitsOfBinaryData(const QXmppBitsOfBinaryDataList &bitsOfBinaryData)
 {
-    d->bitsOfBinaryData = bitsOfBinaryData;
+    d->extras().bitsOfBinaryData = bitsOfBinaryData;
 }
 
 ///
@@ -627,7 +757,7 @@ QString QXmppMessage::slashMeCommandText() const
 ///
 QString QXmppMessage::mucInvitationJid() const
 {
-    return d->mucInvitationJid;
+    return d->extras().mucInvitationJid;
 }
 
 ///
@@ -638,7 +768,7 @@ QString QXmppMessage::mucInvitationJid() const
 ///
 void QXmppMessage::setMucInvitationJid(const QString &jid)
 {
-    d->mucInvitationJid = jid;
+    d->extras().mucInvitationJid = jid;
 }
 
 ///
@@ -649,7 +779,7 @@ void QXmppMessage::setMucInvitationJid(const QString &jid)
 ///
 QString QXmppMessage::mucInvitationPassword() const
 {
-    return d->mucInvitationPassword;
+    return d->extras().mucInvitationPassword;
 }
 
 ///
@@ -660,7 +790,7 @@ QString QXmppMessage::mucInvitationPassword() const
 ///
 void QXmppMessage::setMucInvitationPassword(const QString &password)
 {
-    d->mucInvitationPassword = password;
+    d->extras().mucInvitationPassword = password;
 }
 
 ///
@@ -671,7 +801,7 @@ void QXmppMessage::setMucInvitationPassword(const QString &password)
 ///
 QString QXmppMessage::mucInvitationReason() const
 {
-    return d->mucInvitationReason;
+    return d->extras().mucInvitationReason;
 }
 
 ///
@@ -682,7 +812,7 @@ QString QXmppMessage::mucInvitationReason() const
 ///
 void QXmppMessage::setMucInvitationReason(const QString &reason)
 {
-    d->mucInvitationReason = reason;
+    d->extras().mucInvitationReason = reason;
 }
 
 ///
@@ -885,7 +1015,7 @@ void QXmppMessage::removeAllHints()
 ///
 std::optional<QXmppJingleMessageInitiationElement> QXmppMessage::jingleMessageInitiationElement() const
 {
-    return d->jingleMessageInitiationElement;
+    return d->extras().jingleMessageInitiationElement;
 }
 
 ///
@@ -894,7 +1024,7 @@ std::optional<QXmppJingleMessageInitiationElement> QXmppMessage::jingleMessageIn
 ///
 void QXmppMessage::setJingleMessageInitiationElement(const std::optional<QXmppJingleMessageInitiationElement> &jingleMessageInitiationElement)
 {
-    d->jingleMessageInitiationElement = jingleMessageInitiationElement;
+    d->extras().jingleMessageInitiationElement = jingleMessageInitiationElement;
 }
 
 ///
@@ -995,7 +1125,7 @@ void QXmppMessage::setAttachId(const QString &attachId)
 ///
 QString QXmppMessage::mixUserJid() const
 {
-    return d->mixUserJid;
+    return d->extras().mixUserJid;
 }
 
 ///
@@ -1005,7 +1135,7 @@ QString QXmppMessage::mixUserJid() const
 ///
 void QXmppMessage::setMixUserJid(const QString &mixUserJid)
 {
-    d->mixUserJid = mixUserJid;
+    d->extras().mixUserJid = mixUserJid;
 }
 
 ///
@@ -1015,7 +1145,7 @@ void QXmppMessage::setMixUserJid(const QString &mixUserJid)
 ///
 QString QXmppMessage::mixUserNick() const
 {
-    return d->mixUserNick;
+    return d->extras().mixUserNick;
 }
 
 ///
@@ -1025,7 +1155,7 @@ QString QXmppMessage::mixUserNick() const
 ///
 void QXmppMessage::setMixUserNick(const QString &mixUserNick)
 {
-    d->mixUserNick = mixUserNick;
+    d->extras().mixUserNick = mixUserNick;
 }
 
 ///
@@ -1044,10 +1174,10 @@ void QXmppMessage::setMixUserNick(const QString &mixUserNick)
 ///
 QXmpp::EncryptionMethod QXmppMessage::encryptionMethod() const
 {
-    if (d->encryptionMethod.isEmpty()) {
+    if (d->extras().encryptionMethod.isEmpty()) {
         return QXmpp::NoEncryption;
     }
-    return QXmpp::Private::encryptionFromString(d->encryptionMethod).value_or(QXmpp::UnknownEncryption);
+    return QXmpp::Private::encryptionFromString(d->extras().encryptionMethod).value_or(QXmpp::UnknownEncryption);
 }
 
 ///
@@ -1058,7 +1188,7 @@ QXmpp::EncryptionMethod QXmppMessage::encryptionMethod() const
 ///
 void QXmppMessage::setEncryptionMethod(QXmpp::EncryptionMethod method)
 {
-    d->encryptionMethod = QXmpp::Private::encryptionToString(method);
+    d->extras().encryptionMethod = QXmpp::Private::encryptionToString(method);
 }
 
 ///
@@ -1069,7 +1199,7 @@ void QXmppMessage::setEncryptionMethod(QXmpp::EncryptionMethod method)
 ///
 QString QXmppMessage::encryptionMethodNs() const
 {
-    return d->encryptionMethod;
+    return d->extras().encryptionMethod;
 }
 
 ///
@@ -1080,7 +1210,7 @@ QString QXmppMessage::encryptionMethodNs() const
 ///
 void QXmppMessage::setEncryptionMethodNs(const QString &encryptionMethod)
 {
-    d->encryptionMethod = encryptionMethod;
+    d->extras().encryptionMethod = encryptionMethod;
 }
 
 ///
@@ -1092,8 +1222,8 @@ void QXmppMessage::setEncryptionMethodNs(const QString &encryptionMethod)
 ///
 QString QXmppMessage::encryptionName() const
 {
-    if (!d->encryptionName.isEmpty()) {
-        return d->encryptionName;
+    if (!d->extras().encryptionName.isEmpty()) {
+        return d->extras().encryptionName;
     }
     return QXmpp::Private::encryptionToName(encryptionMethod());
 }
@@ -1109,7 +1239,7 @@ QString QXmppMessage::encryptionName() const
 ///
 void QXmppMessage::setEncryptionName(const QString &encryptionName)
 {
-    d->encryptionName = encryptionName;
+    d->extras().encryptionName = encryptionName;
 }
 
 ///
@@ -1149,7 +1279,7 @@ void QXmppMessage::setIsSpoiler(bool isSpoiler)
 ///
 QString QXmppMessage::spoilerHint() const
 {
-    return d->spoilerHint;
+    return d->extras().spoilerHint;
 }
 
 ///
@@ -1165,7 +1295,7 @@ QString QXmppMessage::spoilerHint() const
 ///
 void QXmppMessage::setSpoilerHint(const QString &spoilerHint)
 {
-    d->spoilerHint = spoilerHint;
+    d->extras().spoilerHint = spoilerHint;
     if (!spoilerHint.isEmpty()) {
         d->isSpoiler = true;
     }
@@ -1180,7 +1310,7 @@ void QXmppMessage::setSpoilerHint(const QString &spoilerHint)
 ///
 std::optional<QXmppOmemoElement> QXmppMessage::omemoElement() const
 {
-    return d->omemoElement;
+    return d->extras().omemoElement;
 }
 
 ///
@@ -1190,7 +1320,7 @@ std::optional<QXmppOmemoElement> QXmppMessage::omemoElement() const
 ///
 void QXmppMessage::setOmemoElement(const std::optional<QXmppOmemoElement> &omemoElement)
 {
-    d->omemoElement = omemoElement;
+    d->extras().omemoElement = omemoElement;
 }
 /// \endcond
 #endif
@@ -1204,7 +1334,7 @@ void QXmppMessage::setOmemoElement(const std::optional<QXmppOmemoElement> &omemo
 ///
 std::optional<QXmppMixInvitation> QXmppMessage::mixInvitation() const
 {
-    return d->mixInvitation;
+    return d->extras().mixInvitation;
 }
 
 ///
@@ -1216,7 +1346,7 @@ std::optional<QXmppMixInvitation> QXmppMessage::mixInvitation() const
 ///
 void QXmppMessage::setMixInvitation(const std::optional<QXmppMixInvitation> &mixInvitation)
 {
-    d->mixInvitation = mixInvitation;
+    d->extras().mixInvitation = mixInvitation;
 }
 
 ///
@@ -1255,7 +1385,7 @@ void QXmppMessage::setIsFallback(bool isFallback)
 ///
 std::optional<QXmppTrustMessageElement> QXmppMessage::trustMessageElement() const
 {
-    return d->trustMessageElement;
+    return d->extras().trustMessageElement;
 }
 
 ///
@@ -1265,7 +1395,7 @@ std::optional<QXmppTrustMessageElement> QXmppMessage::trustMessageElement() cons
 ///
 void QXmppMessage::setTrustMessageElement(const std::optional<QXmppTrustMessageElement> &trustMessageElement)
 {
-    d->trustMessageElement = trustMessageElement;
+    d->extras().trustMessageElement = trustMessageElement;
 }
 
 ///
@@ -1275,7 +1405,7 @@ void QXmppMessage::setTrustMessageElement(const std::optional<QXmppTrustMessageE
 ///
 std::optional<QXmppMessageReaction> QXmppMessage::reaction() const
 {
-    return d->reaction;
+    return d->extras().reaction;
 }
 
 ///
@@ -1291,7 +1421,7 @@ std::optional<QXmppMessageReaction> QXmppMessage::reaction() const
 ///
 void QXmppMessage::setReaction(const std::optional<QXmppMessageReaction> &reaction)
 {
-    d->reaction = reaction;
+    d->extras().reaction = reaction;
 }
 
 ///
@@ -1319,7 +1449,7 @@ void QXmppMessage::setSharedFiles(const QVector<QXmppFileShare> &sharedFiles)
 ///
 std::optional<QXmppCallInviteElement> QXmppMessage::callInviteElement() const
 {
-    return d->callInviteElement;
+    return d->extras().callInviteElement;
 }
 
 ///
@@ -1327,7 +1457,7 @@ std::optional<QXmppCallInviteElement> QXmppMessage::callInviteElement() const
 ///
 void QXmppMessage::setCallInviteElement(std::optional<QXmppCallInviteElement> callInviteElement)
 {
-    d->callInviteElement = callInviteElement;
+    d->extras().callInviteElement = callInviteElement;
 }
 
 /// \cond
@@ -1341,12 +1471,7 @@ void QXmppMessage::parse(const QDomElement &element, QXmpp::SceMode sceMode)
     QXmppStanza::parse(element);
 
     // message type
-    int messageType = MESSAGE_TYPES.indexOf(element.attribute(QStringLiteral("type")));
-    if (messageType != -1) {
-        d->type = static_cast<Type>(messageType);
-    } else {
-        d->type = QXmppMessage::Normal;
-    }
+    d->type = MESSAGE_TYPES.fromString(element.attribute(QStringLiteral("type"))).value_or(QXmppMessage::Normal);
 
     parseExtensions(element, sceMode);
 }
@@ -1363,7 +1488,7 @@ void QXmppMessage::toXml(QXmlStreamWriter *writer, QXmpp::SceMode sceMode) const
     helperToXmlAddAttribute(writer, QStringLiteral("id"), id());
     helperToXmlAddAttribute(writer, QStringLiteral("to"), to());
     helperToXmlAddAttribute(writer, QStringLiteral("from"), from());
-    helperToXmlAddAttribute(writer, QStringLiteral("type"), MESSAGE_TYPES.at(d->type));
+    helperToXmlAddAttribute(writer, QStringLiteral("type"), MESSAGE_TYPES.toString(d->type));
     error().toXml(writer);
 
     // extensions
@@ -1376,6 +1501,27 @@ void QXmppMessage::toXml(QXmlStreamWriter *writer, QXmpp::SceMode sceMode) const
 }
 /// \endcond
 
+///
+/// Parses the message, but only the extensions with the given namespaces.
+///
+/// The body, subject and thread are always parsed. All other extensions are
+/// added to the unknown extensions (see QXmppStanza::extensions()) without
+/// being parsed, which is cheap for messages with many extensions of which
+/// only few are needed.
+///
+/// \param element message element
+/// \param sceMode mode to decide which child elements of the message to parse
+/// \param parsedNamespaces namespaces of the extensions to parse
+///
+/// \since QXmpp 1.6
+///
+void QXmppMessage::parse(const QDomElement &element, QXmpp::SceMode sceMode, const QSet<QString> &parsedNamespaces)
+{
+    d->parsedNamespaces = &parsedNamespaces;
+    parse(element, sceMode);
+    d->parsedNamespaces = nullptr;
+}
+
 ///
 /// Parses all child elements of a message stanza.
 ///
@@ -1391,8 +1537,10 @@ void QXmppMessage::parseExtensions(const QDomElement &element, const QXmpp::SceM
         if (!checkElement(childElement, QStringLiteral("addresses"), ns_extended_addressing) &&
             childElement.tagName() != QStringLiteral("error")) {
             // Try to parse the element and add it as an unknown extension if it
-            // fails.
-            if (!parseExtension(childElement, sceMode)) {
+            // fails or is not wanted.
+            if (d->parsedNamespaces && !isParsed(childElement, *d->parsedNamespaces)) {
+                unknownExtensions << QXmppElement(childElement);
+            } else if (!parseExtension(childElement, sceMode)) {
                 unknownExtensions << QXmppElement(childElement);
             }
         }
@@ -1416,121 +1564,154 @@ void QXmppMessage::parseExtensions(const QDomElement &element, const QXmpp::SceM
 ///
 bool QXmppMessage::parseExtension(const QDomElement &element, QXmpp::SceMode sceMode)
 {
-    if (sceMode & QXmpp::ScePublic) {
-        if (sceMode == QXmpp::ScePublic && element.tagName() == QStringLiteral("body")) {
-            d->e2eeFallbackBody = element.text();
+    const auto tagName = element.tagName();
+
+    // XMPP-Core, matched by the tag name only
+    if (sceMode == QXmpp::ScePublic && tagName == u"body") {
+        d->e2eeFallbackBody = element.text();
+        return true;
+    }
+    if (sceMode & QXmpp::SceSensitive) {
+        if (tagName == u"body") {
+            d->body = element.text();
             return true;
         }
+        if (tagName == u"subject") {
+            d->subject = element.text();
+            return true;
+        }
+        if (tagName == u"thread") {
+            d->thread = element.text();
+            d->parentThread = element.attribute(QStringLiteral("parent"));
+            return true;
+        }
+    }
 
-        // XEP-0280: Message Carbons
-        if (checkElement(element, QStringLiteral("private"), ns_carbons)) {
+    const auto &namespaces = messageNamespaces();
+    const auto itr = namespaces.constFind(element.namespaceURI());
+    if (itr == namespaces.constEnd()) {
+        return false;
+    }
+
+    if (itr->isPublic ? !(sceMode & QXmpp::ScePublic) : !(sceMode & QXmpp::SceSensitive)) {
+        return false;
+    }
+
+    switch (itr->extension) {
+    // XEP-0280: Message Carbons
+    case MessageExtension::Carbons:
+        if (tagName == u"private") {
             d->privatemsg = true;
             return true;
         }
-        // XEP-0334: Message Processing Hints
-        if (element.namespaceURI() == ns_message_processing_hints &&
-            HINT_TYPES.contains(element.tagName())) {
-            if (const auto index = HINT_TYPES.indexOf(element.tagName()); index >= 0) {
-                addHint(Hint(1 << index));
-            }
+        break;
+    // XEP-0334: Message Processing Hints
+    case MessageExtension::Hints:
+        if (const auto index = HINT_TYPES.fromString(tagName)) {
+            addHint(Hint(1 << *index));
             return true;
         }
-        // XEP-0353: Jingle Message Initiation
+        break;
+    // XEP-0353: Jingle Message Initiation
+    case MessageExtension::JingleMessageInitiation:
         if (QXmppJingleMessageInitiationElement::isJingleMessageInitiationElement(element)) {
             QXmppJingleMessageInitiationElement jingleMessageInitiationElement;
             jingleMessageInitiationElement.parse(element);
-            d->jingleMessageInitiationElement = jingleMessageInitiationElement;
+            d->extras().jingleMessageInitiationElement = jingleMessageInitiationElement;
             return true;
         }
-        // XEP-0359: Unique and Stable Stanza IDs
-        if (checkElement(element, QStringLiteral("stanza-id"), ns_sid)) {
+        break;
+    // XEP-0359: Unique and Stable Stanza IDs
+    case MessageExtension::StanzaIds:
+        if (tagName == u"stanza-id") {
             d->stanzaId = element.attribute(QStringLiteral("id"));
             d->stanzaIdBy = element.attribute(QStringLiteral("by"));
             return true;
         }
-        if (checkElement(element, QStringLiteral("origin-id"), ns_sid)) {
+        if (tagName == u"origin-id") {
             d->originId = element.attribute(QStringLiteral("id"));
             return true;
         }
-        // XEP-0369: Mediated Information eXchange (MIX)
-        if (checkElement(element, QStringLiteral("mix"), ns_mix)) {
-            d->mixUserJid = element.firstChildElement(QStringLiteral("jid")).text();
-            d->mixUserNick = element.firstChildElement(QStringLiteral("nick")).text();
+        break;
+    // XEP-0369: Mediated Information eXchange (MIX)
+    case MessageExtension::Mix:
+        if (tagName == u"mix") {
+            d->extras().mixUserJid = element.firstChildElement(QStringLiteral("jid")).text();
+            d->extras().mixUserNick = element.firstChildElement(QStringLiteral("nick")).text();
             return true;
         }
-        // XEP-0380: Explicit Message Encryption
-        if (checkElement(element, QStringLiteral("encryption"), ns_eme)) {
-            d->encryptionMethod = element.attribute(QStringLiteral("namespace"));
-            d->encryptionName = element.attribute(QStringLiteral("name"));
+        break;
+    // XEP-0380: Explicit Message Encryption
+    case MessageExtension::ExplicitEncryption:
+        if (tagName == u"encryption") {
+            d->extras().encryptionMethod = element.attribute(QStringLiteral("namespace"));
+            d->extras().encryptionName = element.attribute(QStringLiteral("name"));
             return true;
         }
+        break;
+    // XEP-0384: OMEMO Encryption
+    case MessageExtension::Omemo:
 #ifdef BUILD_OMEMO
-        // XEP-0384: OMEMO Encryption
         if (QXmppOmemoElement::isOmemoElement(element)) {
             QXmppOmemoElement omemoElement;
             omemoElement.parse(element);
-            d->omemoElement = omemoElement;
+            d->extras().omemoElement = omemoElement;
             return true;
         }
 #endif
-        // XEP-0428: Fallback Indication
-        if (checkElement(element, QStringLiteral("fallback"), ns_fallback_indication)) {
+        break;
+    // XEP-0428: Fallback Indication
+    case MessageExtension::FallbackIndication:
+        if (tagName == u"fallback") {
             d->isFallback = true;
             return true;
         }
-        // XEP-0482: Call Invites
+        break;
+    // XEP-0482: Call Invites
+    case MessageExtension::CallInvites:
         if (QXmppCallInviteElement::isCallInviteElement(element)) {
             QXmppCallInviteElement callInviteElement;
             callInviteElement.parse(element);
-            d->callInviteElement = callInviteElement;
+            d->extras().callInviteElement = callInviteElement;
             return true;
         }
-    }
-    if (sceMode & QXmpp::SceSensitive) {
-        if (element.tagName() == QStringLiteral("body")) {
-            d->body = element.text();
+        break;
+    // XEP-0091: Legacy Delayed Delivery
+    case MessageExtension::LegacyDelayedDelivery:
+        if (tagName == u"x") {
+            // if XEP-0203 exists, XEP-0091 has no need to parse because XEP-0091
+            // is no more standard protocol)
+            if (d->stamp.isNull()) {
+                d->stamp = QDateTime::fromString(
+                    element.attribute(QStringLiteral("stamp")),
+                    QStringLiteral("yyyyMMddThh:mm:ss"));
+                d->stamp.setTimeSpec(Qt::UTC);
+                d->stampType = LegacyDelayedDelivery;
+            }
             return true;
         }
-        if (element.tagName() == QStringLiteral("subject")) {
-            d->subject = element.text();
+        break;
+    // XEP-0249: Direct MUC Invitations
+    case MessageExtension::MucInvitations:
+        if (tagName == u"x") {
+            d->extras().mucInvitationJid = element.attribute(QStringLiteral("jid"));
+            d->extras().mucInvitationPassword = element.attribute(QStringLiteral("password"));
+            d->extras().mucInvitationReason = element.attribute(QStringLiteral("reason"));
             return true;
         }
-        if (element.tagName() == QStringLiteral("thread")) {
-            d->thread = element.text();
-            d->parentThread = element.attribute(QStringLiteral("parent"));
+        break;
+    // XEP-0066: Out of Band Data
+    case MessageExtension::OutOfBandData:
+        if (tagName == u"x") {
+            QXmppOutOfBandUrl data;
+            data.parse(element);
+            d->outOfBandUrls.push_back(std::move(data));
             return true;
         }
-        if (element.tagName() == QStringLiteral("x")) {
-            if (element.namespaceURI() == ns_legacy_delayed_delivery) {
-                // if XEP-0203 exists, XEP-0091 has no need to parse because XEP-0091
-                // is no more standard protocol)
-                if (d->stamp.isNull()) {
-                    // XEP-0091: Legacy Delayed Delivery
-                    d->stamp = QDateTime::fromString(
-                        element.attribute(QStringLiteral("stamp")),
-                        QStringLiteral("yyyyMMddThh:mm:ss"));
-                    d->stamp.setTimeSpec(Qt::UTC);
-                    d->stampType = LegacyDelayedDelivery;
-                }
-                return true;
-            }
-            // XEP-0249: Direct MUC Invitations
-            if (element.namespaceURI() == ns_conference) {
-                d->mucInvitationJid = element.attribute(QStringLiteral("jid"));
-                d->mucInvitationPassword = element.attribute(QStringLiteral("password"));
-                d->mucInvitationReason = element.attribute(QStringLiteral("reason"));
-                return true;
-            }
-            // XEP-0066: Out of Band Data
-            if (element.namespaceURI() == ns_oob) {
-                QXmppOutOfBandUrl data;
-                data.parse(element);
-                d->outOfBandUrls.push_back(std::move(data));
-                return true;
-            }
-        }
-        // XEP-0071: XHTML-IM
-        if (checkElement(element, QStringLiteral("html"), ns_xhtml_im)) {
+        break;
+    // XEP-0071: XHTML-IM
+    case MessageExtension::XhtmlIm:
+        if (tagName == u"html") {
             QDomElement bodyElement = element.firstChildElement(QStringLiteral("body"));
             if (!bodyElement.isNull() && bodyElement.namespaceURI() == ns_xhtml) {
                 QTextStream stream(&d->xhtml, QIODevice::WriteOnly);
@@ -1545,16 +1726,16 @@ bool QXmppMessage::parseExtension(const QDomElement &element, QXmpp::SceMode sce
             }
             return true;
         }
-        // XEP-0085: Chat State Notifications
-        if (element.namespaceURI() == ns_chat_states) {
-            int i = CHAT_STATES.indexOf(element.tagName());
-            if (i > 0) {
-                d->state = static_cast<QXmppMessage::State>(i);
-            }
-            return true;
+        break;
+    // XEP-0085: Chat State Notifications
+    case MessageExtension::ChatStates:
+        if (const auto state = CHAT_STATES.fromString(tagName); state && *state != QXmppMessage::None) {
+            d->state = *state;
         }
-        // XEP-0184: Message Delivery Receipts
-        if (checkElement(element, QStringLiteral("received"), ns_message_receipts)) {
+        return true;
+    // XEP-0184: Message Delivery Receipts
+    case MessageExtension::Receipts:
+        if (tagName == u"received") {
             d->receiptId = element.attribute(QStringLiteral("id"));
 
             // compatibility with old-style XEP
@@ -1563,88 +1744,105 @@ bool QXmppMessage::parseExtension(const QDomElement &element, QXmpp::SceMode sce
             }
             return true;
         }
-        if (checkElement(element, QStringLiteral("request"), ns_message_receipts)) {
+        if (tagName == u"request") {
             d->receiptRequested = true;
             return true;
         }
-        // XEP-0203: Delayed Delivery
-        if (checkElement(element, QStringLiteral("delay"), ns_delayed_delivery)) {
+        break;
+    // XEP-0203: Delayed Delivery
+    case MessageExtension::DelayedDelivery:
+        if (tagName == u"delay") {
             d->stamp = QXmppUtils::datetimeFromString(
                 element.attribute(QStringLiteral("stamp")));
             d->stampType = DelayedDelivery;
             return true;
         }
-        // XEP-0224: Attention
-        if (checkElement(element, QStringLiteral("attention"), ns_attention)) {
+        break;
+    // XEP-0224: Attention
+    case MessageExtension::Attention:
+        if (tagName == u"attention") {
             d->attentionRequested = true;
             return true;
         }
-        // XEP-0231: Bits of Binary
+        break;
+    // XEP-0231: Bits of Binary
+    case MessageExtension::BitsOfBinary:
         if (QXmppBitsOfBinaryData::isBitsOfBinaryData(element)) {
             QXmppBitsOfBinaryData data;
             data.parseElementFromChild(element);
-            d->bitsOfBinaryData << data;
+            d->extras().bitsOfBinaryData << data;
             return true;
         }
-        // XEP-0308: Last Message Correction
-        if (checkElement(element, QStringLiteral("replace"), ns_message_correct)) {
+        break;
+    // XEP-0308: Last Message Correction
+    case MessageExtension::MessageCorrection:
+        if (tagName == u"replace") {
             d->replaceId = element.attribute(QStringLiteral("id"));
             return true;
         }
-        // XEP-0333: Chat Markers
-        if (element.namespaceURI() == ns_chat_markers) {
-            if (element.tagName() == QStringLiteral("markable")) {
-                d->markable = true;
-            } else {
-                int marker = MARKER_TYPES.indexOf(element.tagName());
-                if (marker != -1) {
-                    d->marker = static_cast<QXmppMessage::Marker>(marker);
-                    d->markedId = element.attribute(QStringLiteral("id"));
-                    d->markedThread = element.attribute(QStringLiteral("thread"));
-                }
-            }
-            return true;
+        break;
+    // XEP-0333: Chat Markers
+    case MessageExtension::ChatMarkers:
+        if (tagName == u"markable") {
+            d->markable = true;
+        } else if (const auto marker = MARKER_TYPES.fromString(tagName)) {
+            d->marker = *marker;
+            d->markedId = element.attribute(QStringLiteral("id"));
+            d->markedThread = element.attribute(QStringLiteral("thread"));
         }
-        // XEP-0367: Message Attaching
-        if (checkElement(element, QStringLiteral("attach-to"), ns_message_attaching)) {
+        return true;
+    // XEP-0367: Message Attaching
+    case MessageExtension::MessageAttaching:
+        if (tagName == u"attach-to") {
             d->attachId = element.attribute(QStringLiteral("id"));
             return true;
         }
-        // XEP-0382: Spoiler messages
-        if (checkElement(element, QStringLiteral("spoiler"), ns_spoiler)) {
+        break;
+    // XEP-0382: Spoiler messages
+    case MessageExtension::Spoiler:
+        if (tagName == u"spoiler") {
             d->isSpoiler = true;
-            d->spoilerHint = element.text();
+            d->extras().spoilerHint = element.text();
             return true;
         }
-        // XEP-0407: Mediated Information eXchange (MIX): Miscellaneous Capabilities
-        if (checkElement(element, QStringLiteral("invitation"), ns_mix_misc)) {
+        break;
+    // XEP-0407: Mediated Information eXchange (MIX): Miscellaneous Capabilities
+    case MessageExtension::MixMisc:
+        if (tagName == u"invitation") {
             QXmppMixInvitation mixInvitation;
             mixInvitation.parse(element);
-            d->mixInvitation = mixInvitation;
+            d->extras().mixInvitation = mixInvitation;
             return true;
         }
-        // XEP-0434: Trust Messages (TM)
+        break;
+    // XEP-0434: Trust Messages (TM)
+    case MessageExtension::TrustMessages:
         if (QXmppTrustMessageElement::isTrustMessageElement(element)) {
             QXmppTrustMessageElement trustMessageElement;
             trustMessageElement.parse(element);
-            d->trustMessageElement = trustMessageElement;
+            d->extras().trustMessageElement = trustMessageElement;
             return true;
         }
-        // XEP-0444: Message Reactions
+        break;
+    // XEP-0444: Message Reactions
+    case MessageExtension::Reactions:
         if (QXmppMessageReaction::isMessageReaction(element)) {
             QXmppMessageReaction reaction;
             reaction.parse(element);
-            d->reaction = std::move(reaction);
+            d->extras().reaction = std::move(reaction);
             return true;
         }
-        // XEP-0448: Stateless file sharing
-        if (checkElement(element, QStringLiteral("file-sharing"), ns_sfs)) {
+        break;
+    // XEP-0448: Stateless file sharing
+    case MessageExtension::StatelessFileSharing:
+        if (tagName == u"file-sharing") {
             QXmppFileShare share;
             if (share.parse(element)) {
                 d->sharedFiles.push_back(std::move(share));
             }
             return true;
         }
+        break;
     }
     return false;
 }
@@ -1675,9 +1873,9 @@ void QXmppMessage::serializeExtensions(QXmlStreamWriter *writer, QXmpp::SceMode
         }
 
         // XEP-0334: Message Processing Hints
-        for (quint8 i = 0; i < HINT_TYPES.size(); i++) {
+        for (int i = 0; i < HINT_COUNT; i++) {
             if (hasHint(Hint(1 << i))) {
-                writer->writeStartElement(HINT_TYPES.at(i));
+                writer->writeStartElement(HINT_TYPES.toString(i));
                 writer->writeDefaultNamespace(ns_message_processing_hints);
                 writer->writeEndElement();
             }
@@ -1702,27 +1900,27 @@ void QXmppMessage::serializeExtensions(QXmlStreamWriter *writer, QXmpp::SceMode
         }
 
         // XEP-0369: Mediated Information eXchange (MIX)
-        if (!d->mixUserJid.isEmpty() || !d->mixUserNick.isEmpty()) {
+        if (!d->extras().mixUserJid.isEmpty() || !d->extras().mixUserNick.isEmpty()) {
             writer->writeStartElement(QStringLiteral("mix"));
             writer->writeDefaultNamespace(ns_mix);
-            helperToXmlAddTextElement(writer, QStringLiteral("jid"), d->mixUserJid);
-            helperToXmlAddTextElement(writer, QStringLiteral("nick"), d->mixUserNick);
+            helperToXmlAddTextElement(writer, QStringLiteral("jid"), d->extras().mixUserJid);
+            helperToXmlAddTextElement(writer, QStringLiteral("nick"), d->extras().mixUserNick);
             writer->writeEndElement();
         }
 
         // XEP-0380: Explicit Message Encryption
-        if (!d->encryptionMethod.isEmpty()) {
+        if (!d->extras().encryptionMethod.isEmpty()) {
             writer->writeStartElement(QStringLiteral("encryption"));
             writer->writeDefaultNamespace(ns_eme);
-            writer->writeAttribute(QStringLiteral("namespace"), d->encryptionMethod);
+            writer->writeAttribute(QStringLiteral("namespace"), d->extras().encryptionMethod);
             helperToXmlAddAttribute(writer, QStringLiteral("name"), encryptionName());
             writer->writeEndElement();
         }
 
 #ifdef BUILD_OMEMO
         // XEP-0384: OMEMO Encryption
-        if (d->omemoElement) {
-            d->omemoElement->toXml(writer);
+        if (d->extras().omemoElement) {
+            d->extras().omemoElement->toXml(writer);
         }
 #endif
 
@@ -1779,7 +1977,7 @@ void QXmppMessage::serializeExtensions(QXmlStreamWriter *writer, QXmpp::SceMode
 
         // XEP-0085: Chat State Notifications
         if (d->state > None && d->state <= Paused) {
-            writer->writeStartElement(CHAT_STATES.at(d->state));
+            writer->writeStartElement(CHAT_STATES.toString(d->state));
             writer->writeDefaultNamespace(ns_chat_states);
             writer->writeEndElement();
         }
@@ -1825,21 +2023,21 @@ void QXmppMessage::serializeExtensions(QXmlStreamWriter *writer, QXmpp::SceMode
         }
 
         // XEP-0249: Direct MUC Invitations
-        if (!d->mucInvitationJid.isEmpty()) {
+        if (!d->extras().mucInvitationJid.isEmpty()) {
             writer->writeStartElement(QStringLiteral("x"));
             writer->writeDefaultNamespace(ns_conference);
-            writer->writeAttribute(QStringLiteral("jid"), d->mucInvitationJid);
-            if (!d->mucInvitationPassword.isEmpty()) {
-                writer->writeAttribute(QStringLiteral("password"), d->mucInvitationPassword);
+            writer->writeAttribute(QStringLiteral("jid"), d->extras().mucInvitationJid);
+            if (!d->extras().mucInvitationPassword.isEmpty()) {
+                writer->writeAttribute(QStringLiteral("password"), d->extras().mucInvitationPassword);
             }
-            if (!d->mucInvitationReason.isEmpty()) {
-                writer->writeAttribute(QStringLiteral("reason"), d->mucInvitationReason);
+            if (!d->extras().mucInvitationReason.isEmpty()) {
+                writer->writeAttribute(QStringLiteral("reason"), d->extras().mucInvitationReason);
             }
             writer->writeEndElement();
         }
 
         // XEP-0231: Bits of Binary
-        for (const auto &data : std::as_const(d->bitsOfBinaryData)) {
+        for (const auto &data : std::as_const(d->extras().bitsOfBinaryData)) {
             data.toXmlElementFromChild(writer);
         }
 
@@ -1858,7 +2056,7 @@ void QXmppMessage::serializeExtensions(QXmlStreamWriter *writer, QXmpp::SceMode
             writer->writeEndElement();
         }
         if (d->marker != NoMarker) {
-            writer->writeStartElement(MARKER_TYPES.at(d->marker));
+            writer->writeStartElement(MARKER_TYPES.toString(d->marker));
             writer->writeDefaultNamespace(ns_chat_markers);
             writer->writeAttribute(QStringLiteral("id"), d->markedId);
             if (!d->markedThread.isNull() && !d->markedThread.isEmpty()) {
@@ -1868,8 +2066,8 @@ void QXmppMessage::serializeExtensions(QXmlStreamWriter *writer, QXmpp::SceMode
         }
 
         // XEP-0353: Jingle Message Initiation
-        if (d->jingleMessageInitiationElement) {
-            d->jingleMessageInitiationElement->toXml(writer);
+        if (d->extras().jingleMessageInitiationElement) {
+            d->extras().jingleMessageInitiationElement->toXml(writer);
         }
 
         // XEP-0367: Message Attaching
@@ -1884,23 +2082,23 @@ void QXmppMessage::serializeExtensions(QXmlStreamWriter *writer, QXmpp::SceMode
         if (d->isSpoiler) {
             writer->writeStartElement(QStringLiteral("spoiler"));
             writer->writeDefaultNamespace(ns_spoiler);
-            writer->writeCharacters(d->spoilerHint);
+            writer->writeCharacters(d->extras().spoilerHint);
             writer->writeEndElement();
         }
 
         // XEP-0407: Mediated Information eXchange (MIX): Miscellaneous Capabilities
-        if (d->mixInvitation) {
-            d->mixInvitation->toXml(writer);
+        if (d->extras().mixInvitation) {
+            d->extras().mixInvitation->toXml(writer);
         }
 
         // XEP-0434: Trust Messages (TM)
-        if (d->trustMessageElement) {
-            d->trustMessageElement->toXml(writer);
+        if (d->extras().trustMessageElement) {
+            d->extras().trustMessageElement->toXml(writer);
         }
 
         // XEP-0444: Message Reactions
-        if (d->reaction) {
-            d->reaction->toXml(writer);
+        if (d->extras().reaction) {
+            d->extras().reaction->toXml(writer);
         }
 
         // XEP-0448: Stateless file sharing
@@ -1909,8 +2107,8 @@ void QXmppMessage::serializeExtensions(QXmlStreamWriter *writer, QXmpp::SceMode
         }
 
         // XEP-0482: Call Invites
-        if (d->callInviteElement) {
-            d->callInviteElement->toXml(writer);
+        if (d->extras().callInviteElement) {
+            d->extras().callInviteElement->toXml(writer);
         }
     }
 }
@@ -16,6 +16,7 @@
 
 // Required for source compatibility
 #include <QDateTime>
+#include <QSet>
 
 class QXmppMessagePrivate;
 class QXmppBitsOfBinaryDataList;
@@ -286,6 +287,8 @@ public:
     virtual void toXml(QXmlStreamWriter *writer, QXmpp::SceMode) const;
     /// \endcond
 
+    void parse(const QDomElement &element, QXmpp::SceMode sceMode, const QSet<QString> &parsedNamespaces);
+
     void parseExtensions(const QDomElement &element, QXmpp::SceMode sceMode);
     virtual bool parseExtension(const QDomElement &element, QXmpp::SceMode);
     virtual void serializeExtensions(QXmlStreamWriter *writer, QXmpp::SceMode, const QString &baseNamespace = {}) const;
@@ -0,0 +1,487 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppMetrics.h"
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <QMutex>
+
+namespace {
+
+struct MetricInfo
+{
+    // metrics with the same name are exported as one family
+    const char *name;
+    const char *labels;
+    const char *help;
+};
+
+constexpr MetricInfo counterInfos[] = {
+    { "qxmpp_stanzas_received", "type=\"message\"", "Top-level elements received on XMPP streams." },
+    { "qxmpp_stanzas_received", "type=\"presence\"", nullptr },
+    { "qxmpp_stanzas_received", "type=\"iq\"", nullptr },
+    { "qxmpp_stanzas_received", "type=\"nonza\"", nullptr },
+    { "qxmpp_stanzas_sent", "type=\"message\"", "Top-level elements sent on XMPP streams." },
+    { "qxmpp_stanzas_sent", "type=\"presence\"", nullptr },
+    { "qxmpp_stanzas_sent", "type=\"iq\"", nullptr },
+    { "qxmpp_stanzas_sent", "type=\"nonza\"", nullptr },
+    { "qxmpp_stream_saved_writes", nullptr, "Socket writes saved by coalescing outgoing data." },
+    { "qxmpp_stream_coalesced_write_bytes", nullptr, "Bytes written in coalesced socket writes." },
+    { "qxmpp_stream_coalesced_iqs", nullptr, "IQ requests answered by an identical pending request." },
+    { "qxmpp_stream_throttled_reads", nullptr, "Times reading from a socket has been paused by rate limits." },
+    { "qxmpp_stream_throttled_read_milliseconds", nullptr, "Time reading from sockets has been paused by rate limits." },
+    { "qxmpp_server_routing_failures", nullptr, "Stanzas that could not be routed to their recipient." },
+    { "qxmpp_server_client_authentications", "result=\"success\"", "Client authentications by result." },
+    { "qxmpp_server_client_authentications", "result=\"not-authorized\"", nullptr },
+    { "qxmpp_server_client_authentications", "result=\"temporary-auth-failure\"", nullptr },
+    { "qxmpp_server_rejected_connections", nullptr, "Client connections rejected by the admission control." },
+    { "qxmpp_server_push_notifications", nullptr, "Push notifications sent to app servers." },
+    { "qxmpp_server_push_coalesced_messages", nullptr, "Messages merged into the push notifications of others." },
+    { "qxmpp_server_s2s_dropped_stanzas", nullptr, "Stanzas dropped from the queues of outgoing server-to-server streams." },
+    { "qxmpp_stream_management_replayed_stanzas", nullptr, "Unacknowledged stanzas resent on stream resumption." },
+    { "qxmpp_stream_management_replayed_bytes", nullptr, "Bytes of the unacknowledged stanzas resent on stream resumption." },
+};
+static_assert(std::size(counterInfos) == QXmppMetrics::CounterCount);
+
+constexpr MetricInfo gaugeInfos[] = {
+    { "qxmpp_server_streams", "type=\"incoming-client\"", "Open streams of servers." },
+    { "qxmpp_server_streams", "type=\"incoming-server\"", nullptr },
+    { "qxmpp_server_streams", "type=\"outgoing-server\"", nullptr },
+    { "qxmpp_stream_management_queued_stanzas", nullptr, "Stanzas waiting for stream management acknowledgements." },
+    { "qxmpp_stream_management_queued_bytes", nullptr, "Bytes waiting for stream management acknowledgements." },
+    { "qxmpp_server_admission_queue_length", nullptr, "Client connections waiting for admission." },
+    { "qxmpp_stream_pending_iqs", nullptr, "IQ requests waiting for a response." },
+    { "qxmpp_client_transfer_jobs", nullptr, "File transfer jobs of clients." },
+    { "qxmpp_server_muc_rooms", nullptr, "Rooms of multi-user chat services." },
+};
+static_assert(std::size(gaugeInfos) == QXmppMetrics::GaugeCount);
+
+constexpr int MaxBuckets = 16;
+
+struct HistogramInfo
+{
+    const char *name;
+    const char *help;
+    // name of the label of observations with a label, e.g. "namespace"
+    const char *labelName;
+    // upper bounds in nanoseconds, the +Inf bucket is implicit
+    std::array<qint64, MaxBuckets - 1> bounds;
+    int boundCount;
+};
+
+constexpr qint64 Microsecond = 1000;
+constexpr qint64 Millisecond = 1000 * Microsecond;
+constexpr qint64 Second = 1000 * Millisecond;
+
+constexpr HistogramInfo histogramInfos[] = {
+    { "qxmpp_stanza_parse_seconds",
+      "Time needed to parse top-level elements received on XMPP streams.",
+      nullptr,
+      { 1 * Microsecond, 5 * Microsecond, 10 * Microsecond, 50 * Microsecond, 100 * Microsecond, 500 * Microsecond, 1 * Millisecond, 5 * Millisecond, 10 * Millisecond },
+      9 },
+    { "qxmpp_iq_round_trip_seconds",
+      "Time between sending IQ requests and receiving their responses.",
+      "namespace",
+      { 1 * Millisecond, 5 * Millisecond, 10 * Millisecond, 25 * Millisecond, 50 * Millisecond, 100 * Millisecond, 250 * Millisecond, 500 * Millisecond, 1 * Second, 2500 * Millisecond, 5 * Second, 10 * Second, 30 * Second },
+      13 },
+    { "qxmpp_extension_handling_seconds",
+      "Time extensions needed to handle stanzas.",
+      "extension",
+      { 10 * Microsecond, 50 * Microsecond, 100 * Microsecond, 500 * Microsecond, 1 * Millisecond, 5 * Millisecond, 10 * Millisecond, 25 * Millisecond, 50 * Millisecond, 100 * Millisecond, 250 * Millisecond, 1 * Second },
+      12 },
+    { "qxmpp_stream_management_replay_seconds",
+      "Time needed to write the unacknowledged stanzas to resumed streams.",
+      nullptr,
+      { 10 * Microsecond, 50 * Microsecond, 100 * Microsecond, 500 * Microsecond, 1 * Millisecond, 5 * Millisecond, 10 * Millisecond, 50 * Millisecond, 100 * Millisecond },
+      9 },
+};
+static_assert(std::size(histogramInfos) == QXmppMetrics::HistogramCount);
+
+// Each shard is only written by the thread that owns it, so a relaxed load
+// and store is enough and avoids locked instructions.
+template<typename T>
+void add(std::atomic<T> &value, T amount)
+{
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+struct HistogramShard
+{
+    std::atomic<quint64> buckets[MaxBuckets] = {};
+    std::atomic<quint64> count { 0 };
+    std::atomic<qint64> sum { 0 };
+};
+
+struct Shard
+{
+    std::atomic<quint64> counters[QXmppMetrics::CounterCount] = {};
+    HistogramShard histograms[QXmppMetrics::HistogramCount];
+
+    // The owning thread inserts new labels, so the maps need to be locked.
+    // The mutex is only contended while the metrics are exported.
+    QMutex labelledMutex;
+    std::map<QString, HistogramShard> labelledHistograms[QXmppMetrics::HistogramCount];
+};
+
+struct Registry
+{
+    QMutex mutex;
+    // shards are never deleted, shards of finished threads are reused
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::vector<Shard *> unusedShards;
+    std::atomic<qint64> gauges[QXmppMetrics::GaugeCount] = {};
+};
+
+Registry &registry()
+{
+    // intentionally leaked, threads may still record metrics during shutdown
+    static auto *registry = new Registry;
+    return *registry;
+}
+
+struct ShardHandle
+{
+    ShardHandle()
+    {
+        auto &r = registry();
+        QMutexLocker locker(&r.mutex);
+        if (r.unusedShards.empty()) {
+            r.shards.push_back(std::make_unique<Shard>());
+            shard = r.shards.back().get();
+        } else {
+            shard = r.unusedShards.back();
+            r.unusedShards.pop_back();
+        }
+    }
+    ~ShardHandle()
+    {
+        auto &r = registry();
+        QMutexLocker locker(&r.mutex);
+        r.unusedShards.push_back(shard);
+    }
+
+    Shard *shard;
+};
+
+Shard &localShard()
+{
+    thread_local ShardHandle handle;
+    return *handle.shard;
+}
+
+void record(HistogramShard &h, const HistogramInfo &info, qint64 nsecs)
+{
+    int bucket = 0;
+    while (bucket < info.boundCount && nsecs > info.bounds[bucket]) {
+        bucket++;
+    }
+    add(h.buckets[bucket], quint64(1));
+    add(h.count, quint64(1));
+    add(h.sum, nsecs);
+}
+
+void clear(HistogramShard &h)
+{
+    for (auto &bucket : h.buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    h.count.store(0, std::memory_order_relaxed);
+    h.sum.store(0, std::memory_order_relaxed);
+}
+
+struct HistogramSnapshot
+{
+    void add(const HistogramShard &h)
+    {
+        for (int i = 0; i < MaxBuckets; i++) {
+            buckets[i] += h.buckets[i].load(std::memory_order_relaxed);
+        }
+        count += h.count.load(std::memory_order_relaxed);
+        sum += h.sum.load(std::memory_order_relaxed);
+    }
+
+    quint64 buckets[MaxBuckets] = {};
+    quint64 count = 0;
+    qint64 sum = 0;
+};
+
+struct HistogramSnapshots
+{
+    HistogramSnapshot unlabelled;
+    std::map<QString, HistogramSnapshot> labelled;
+};
+
+HistogramSnapshots histogramSnapshots(QXmppMetrics::Histogram histogram)
+{
+    HistogramSnapshots snapshots;
+    auto &r = registry();
+    QMutexLocker locker(&r.mutex);
+    for (const auto &shard : r.shards) {
+        snapshots.unlabelled.add(shard->histograms[histogram]);
+
+        QMutexLocker labelledLocker(&shard->labelledMutex);
+        for (const auto &[label, h] : shard->labelledHistograms[histogram]) {
+            snapshots.labelled[label].add(h);
+        }
+    }
+    return snapshots;
+}
+
+void appendFamilyHeader(QByteArray &output, const char *name, const char *type, const char *help)
+{
+    output += "# TYPE ";
+    output += name;
+    output += ' ';
+    output += type;
+    output += '\n';
+    if (help) {
+        output += "# HELP ";
+        output += name;
+        output += ' ';
+        output += help;
+        output += '\n';
+    }
+}
+
+void appendSample(QByteArray &output, const char *name, const char *suffix, const char *labels, const QByteArray &value)
+{
+    output += name;
+    output += suffix;
+    if (labels) {
+        output += '{';
+        output += labels;
+        output += '}';
+    }
+    output += ' ';
+    output += value;
+    output += '\n';
+}
+
+QByteArray seconds(qint64 nsecs)
+{
+    return QByteArray::number(double(nsecs) / double(Second), 'g', 12);
+}
+
+QByteArray labelValue(const QString &value)
+{
+    return value.toUtf8().replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+}
+
+// labels is empty or a list of labels without the bucket's "le" label
+void appendHistogram(QByteArray &output, const HistogramInfo &info, const QByteArray &labels, const HistogramSnapshot &snapshot)
+{
+    const auto prefix = labels.isEmpty() ? QByteArray() : labels + ',';
+
+    // buckets are cumulative in the exposition format
+    quint64 cumulative = 0;
+    for (int bucket = 0; bucket <= info.boundCount; bucket++) {
+        cumulative += snapshot.buckets[bucket];
+        const auto bound = bucket < info.boundCount ? seconds(info.bounds[bucket]) : QByteArrayLiteral("+Inf");
+        appendSample(output, info.name, "_bucket", QByteArray(prefix + "le=\"" + bound + '"').constData(), QByteArray::number(cumulative));
+    }
+
+    const auto *otherLabels = labels.isEmpty() ? nullptr : labels.constData();
+    appendSample(output, info.name, "_count", otherLabels, QByteArray::number(snapshot.count));
+    appendSample(output, info.name, "_sum", otherLabels, seconds(snapshot.sum));
+}
+
+}  // namespace
+
+///
+/// Increments \a counter by \a amount.
+///
+void QXmppMetrics::increment(Counter counter, quint64 amount)
+{
+    add(localShard().counters[counter], amount);
+}
+
+///
+/// Returns the current value of \a counter summed up over all threads.
+///
+quint64 QXmppMetrics::value(Counter counter)
+{
+    quint64 total = 0;
+    auto &r = registry();
+    QMutexLocker locker(&r.mutex);
+    for (const auto &shard : r.shards) {
+        total += shard->counters[counter].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+///
+/// Sets \a gauge to \a value.
+///
+/// Gauges that are updated by multiple objects (e.g. one per stream) should be
+/// changed using addToGauge() instead.
+///
+void QXmppMetrics::setGauge(Gauge gauge, qint64 value)
+{
+    registry().gauges[gauge].store(value, std::memory_order_relaxed);
+}
+
+///
+/// Adds \a delta to \a gauge. The delta may be negative.
+///
+void QXmppMetrics::addToGauge(Gauge gauge, qint64 delta)
+{
+    registry().gauges[gauge].fetch_add(delta, std::memory_order_relaxed);
+}
+
+///
+/// Returns the current value of \a gauge.
+///
+qint64 QXmppMetrics::value(Gauge gauge)
+{
+    return registry().gauges[gauge].load(std::memory_order_relaxed);
+}
+
+///
+/// Records a duration of \a nsecs nanoseconds in \a histogram.
+///
+void QXmppMetrics::observe(Histogram histogram, qint64 nsecs)
+{
+    record(localShard().histograms[histogram], histogramInfos[histogram], nsecs);
+}
+
+///
+/// Records a duration of \a nsecs nanoseconds in the series of \a histogram
+/// with the given \a label, e.g. the namespace of an IQ request.
+///
+/// Each label creates a new series, so labels should only have a small
+/// number of different values.
+///
+void QXmppMetrics::observe(Histogram histogram, const QString &label, qint64 nsecs)
+{
+    const auto &info = histogramInfos[histogram];
+    auto &shard = localShard();
+    if (!info.labelName) {
+        record(shard.histograms[histogram], info, nsecs);
+        return;
+    }
+
+    QMutexLocker locker(&shard.labelledMutex);
+    record(shard.labelledHistograms[histogram][label], info, nsecs);
+}
+
+///
+/// Returns the number of durations recorded in \a histogram, with and without
+/// labels.
+///
+quint64 QXmppMetrics::count(Histogram histogram)
+{
+    const auto snapshots = histogramSnapshots(histogram);
+    auto total = snapshots.unlabelled.count;
+    for (const auto &[label, snapshot] : snapshots.labelled) {
+        total += snapshot.count;
+    }
+    return total;
+}
+
+///
+/// Returns the number of durations recorded in \a histogram with \a label.
+///
+quint64 QXmppMetrics::count(Histogram histogram, const QString &label)
+{
+    const auto snapshots = histogramSnapshots(histogram);
+    const auto itr = snapshots.labelled.find(label);
+    return itr == snapshots.labelled.end() ? 0 : itr->second.count;
+}
+
+///
+/// Returns the sum of all durations recorded in \a histogram in nanoseconds,
+/// with and without labels.
+///
+qint64 QXmppMetrics::sum(Histogram histogram)
+{
+    const auto snapshots = histogramSnapshots(histogram);
+    auto total = snapshots.unlabelled.sum;
+    for (const auto &[label, snapshot] : snapshots.labelled) {
+        total += snapshot.sum;
+    }
+    return total;
+}
+
+///
+/// Returns all metrics in the OpenMetrics text exposition format, which can
+/// also be read by Prometheus.
+///
+/// Durations are exported in seconds.
+///
+QByteArray QXmppMetrics::toOpenMetrics()
+{
+    QByteArray output;
+    output.reserve(4096);
+
+    const char *family = nullptr;
+    for (int i = 0; i < CounterCount; i++) {
+        const auto &info = counterInfos[i];
+        if (!family || qstrcmp(family, info.name) != 0) {
+            family = info.name;
+            appendFamilyHeader(output, info.name, "counter", info.help);
+        }
+        appendSample(output, info.name, "_total", info.labels, QByteArray::number(value(Counter(i))));
+    }
+
+    family = nullptr;
+    for (int i = 0; i < GaugeCount; i++) {
+        const auto &info = gaugeInfos[i];
+        if (!family || qstrcmp(family, info.name) != 0) {
+            family = info.name;
+            appendFamilyHeader(output, info.name, "gauge", info.help);
+        }
+        appendSample(output, info.name, "", info.labels, QByteArray::number(value(Gauge(i))));
+    }
+
+    for (int i = 0; i < HistogramCount; i++) {
+        const auto &info = histogramInfos[i];
+        const auto snapshots = histogramSnapshots(Histogram(i));
+        appendFamilyHeader(output, info.name, "histogram", info.help);
+
+        // histograms with labels only export observations without a label
+        // if there are any
+        if (!info.labelName || snapshots.unlabelled.count > 0) {
+            appendHistogram(output, info, {}, snapshots.unlabelled);
+        }
+        for (const auto &[label, snapshot] : snapshots.labelled) {
+            appendHistogram(output, info, info.labelName + QByteArrayLiteral("=\"") + labelValue(label) + '"', snapshot);
+        }
+    }
+
+    output += "# EOF\n";
+    return output;
+}
+
+///
+/// Sets all metrics back to zero.
+///
+/// This is mainly useful for tests. Values recorded concurrently by other
+/// threads may get lost.
+///
+void QXmppMetrics::reset()
+{
+    auto &r = registry();
+    QMutexLocker locker(&r.mutex);
+    for (const auto &shard : r.shards) {
+        for (auto &counter : shard->counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (auto &histogram : shard->histograms) {
+            clear(histogram);
+        }
+
+        QMutexLocker labelledLocker(&shard->labelledMutex);
+        for (auto &histograms : shard->labelledHistograms) {
+            histograms.clear();
+        }
+    }
+    for (auto &gauge : r.gauges) {
+        gauge.store(0, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,104 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPMETRICS_H
+#define QXMPPMETRICS_H
+
+#include "QXmppGlobal.h"
+
+#include <QByteArray>
+#include <QString>
+
+///
+/// \brief The QXmppMetrics class collects process-wide metrics of all
+/// streams, clients and servers.
+///
+/// All metrics are known in advance, so recording a value does not need any
+/// string keys or allocations. Counters and histograms are recorded in
+/// per-thread shards which are only summed up when they are read, so streams
+/// in different threads do not contend for the same memory.
+///
+/// The metrics can be exported in the OpenMetrics (Prometheus) text format
+/// using toOpenMetrics(), e.g. to be served by an HTTP endpoint of the
+/// application.
+///
+/// \since QXmpp 1.6
+///
+/// \ingroup Core
+///
+class QXMPP_EXPORT QXmppMetrics
+{
+public:
+    /// Monotonically increasing counters.
+    enum Counter {
+        ReceivedMessages,              ///< Received message stanzas
+        ReceivedPresences,             ///< Received presence stanzas
+        ReceivedIqs,                   ///< Received IQ stanzas
+        ReceivedNonzas,                ///< Received top-level elements that are not stanzas
+        SentMessages,                  ///< Sent message stanzas
+        SentPresences,                 ///< Sent presence stanzas
+        SentIqs,                       ///< Sent IQ stanzas
+        SentNonzas,                    ///< Sent top-level elements that are not stanzas
+        SavedWrites,                   ///< Socket writes saved by coalescing outgoing data
+        CoalescedWriteBytes,           ///< Bytes written in coalesced socket writes
+        CoalescedIqs,                  ///< IQ requests answered by an identical pending request
+        ThrottledReads,                ///< Times reading from a socket has been paused by rate limits
+        ThrottledReadMilliseconds,     ///< Time reading from sockets has been paused by rate limits
+        RoutingFailures,               ///< Stanzas a server could not route to their recipient
+        ClientAuthSuccesses,           ///< Successful client authentications of a server
+        ClientAuthFailures,            ///< Client authentications rejected by a server
+        ClientAuthTemporaryFailures,   ///< Client authentications failed by temporary errors
+        RejectedClientConnections,     ///< Client connections rejected by the admission control of a server
+        PushNotifications,             ///< Push notifications sent to app servers by a server
+        CoalescedPushMessages,         ///< Messages merged into the push notifications of others
+        DroppedOutgoingServerStanzas,  ///< Stanzas dropped from the queues of outgoing server-to-server streams
+        ReplayedStanzas,               ///< Unacknowledged stanzas resent after stream management has been enabled or resumed
+        ReplayedBytes,                 ///< Bytes of the unacknowledged stanzas resent after stream management has been enabled or resumed
+        CounterCount                   ///< Number of counters, not a counter
+    };
+
+    /// Values that can go up and down.
+    enum Gauge {
+        IncomingClients,                 ///< Connected clients of a server
+        IncomingServers,                 ///< Incoming server-to-server streams
+        OutgoingServers,                 ///< Outgoing server-to-server streams
+        StreamManagementQueuedStanzas,   ///< Stanzas waiting for stream management acknowledgements
+        StreamManagementQueuedBytes,     ///< Bytes waiting for stream management acknowledgements
+        ClientAdmissionQueueLength,      ///< Client connections of a server waiting for admission
+        PendingIqs,                      ///< IQ requests of streams waiting for a response
+        TransferJobs,                    ///< File transfer jobs of clients
+        MucRooms,                        ///< Rooms of the multi-user chat services of servers
+        GaugeCount                       ///< Number of gauges, not a gauge
+    };
+
+    /// Distributions of durations.
+    enum Histogram {
+        StanzaParseTime,             ///< Time needed to parse a top-level element received on a stream
+        IqRoundTripTime,             ///< Time between sending an IQ request and receiving its response, labelled by the namespace of the request
+        ExtensionHandlingTime,       ///< Time an extension needed to handle a stanza, labelled by the extension, only recorded if slow handlers are reported
+        StreamResumptionReplayTime,  ///< Time needed to write the unacknowledged stanzas to a resumed stream
+        HistogramCount               ///< Number of histograms, not a histogram
+    };
+
+    static void increment(Counter counter, quint64 amount = 1);
+    static quint64 value(Counter counter);
+
+    static void setGauge(Gauge gauge, qint64 value);
+    static void addToGauge(Gauge gauge, qint64 delta);
+    static qint64 value(Gauge gauge);
+
+    static void observe(Histogram histogram, qint64 nsecs);
+    static void observe(Histogram histogram, const QString &label, qint64 nsecs);
+    static quint64 count(Histogram histogram);
+    static quint64 count(Histogram histogram, const QString &label);
+    static qint64 sum(Histogram histogram);
+
+    static QByteArray toOpenMetrics();
+    static void reset();
+
+private:
+    QXmppMetrics() = delete;
+};
+
+#endif  // QXMPPMETRICS_H
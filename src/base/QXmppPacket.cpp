@@ -7,11 +7,43 @@
 
 #include <QXmlStreamWriter>
 
-inline QByteArray serialize(const QXmppNonza &nonza)
+// Initial capacity of serialization buffers
+constexpr int InitialBufferCapacity = 4096;
+// Buffers that have grown larger are not kept between packets
+constexpr int MaximumBufferCapacity = 256 * 1024;
+
+// Serializes the nonza into the buffer. The buffer keeps its capacity, so it
+// is not regrown when it is reused for the next packet.
+void QXmpp::Private::serializeNonza(const QXmppNonza &nonza, QByteArray &buffer)
 {
-    QByteArray out;
-    QXmlStreamWriter xmlStream(&out);
+    if (buffer.capacity() < InitialBufferCapacity) {
+        buffer.reserve(InitialBufferCapacity);
+    }
+    // keeps the reserved capacity
+    buffer.resize(0);
+
+    QXmlStreamWriter xmlStream(&buffer);
     nonza.toXml(&xmlStream);
+}
+
+// Releases the buffer if it has grown too large to be kept around.
+void QXmpp::Private::trimSerializationBuffer(QByteArray &buffer)
+{
+    if (buffer.capacity() > MaximumBufferCapacity) {
+        buffer = QByteArray();
+    }
+}
+
+// Serializes the nonza into a buffer that is reused by all packets of the
+// thread. The result is copied into an array of the exact size, which is what
+// is queued for sending.
+static QByteArray serialize(const QXmppNonza &nonza)
+{
+    thread_local QByteArray buffer;
+    QXmpp::Private::serializeNonza(nonza, buffer);
+
+    QByteArray out(buffer.constData(), buffer.size());
+    QXmpp::Private::trimSerializationBuffer(buffer);
     return out;
 }
 
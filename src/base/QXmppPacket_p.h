@@ -34,4 +34,11 @@ private:
     bool m_isXmppStanza;
 };
 
+namespace QXmpp::Private {
+
+void serializeNonza(const QXmppNonza &nonza, QByteArray &buffer);
+void trimSerializationBuffer(QByteArray &buffer);
+
+}  // namespace QXmpp::Private
+
 #endif  // QXMPPPACKET_H
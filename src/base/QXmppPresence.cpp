@@ -6,60 +6,56 @@
 #include "QXmppPresence.h"
 
 #include "QXmppConstants_p.h"
+#include "QXmppEnumStrings_p.h"
 #include "QXmppJingleIq.h"
 #include "QXmppUtils.h"
+#include "QXmppUtils_p.h"
+
+#include <utility>
 
 #include <QDateTime>
 #include <QDomElement>
 
-static const QStringList PRESENCE_TYPES = {
-    QStringLiteral("error"),
-    QString(),
-    QStringLiteral("unavailable"),
-    QStringLiteral("subscribe"),
-    QStringLiteral("subscribed"),
-    QStringLiteral("unsubscribe"),
-    QStringLiteral("unsubscribed"),
-    QStringLiteral("probe")
-};
+using namespace QXmpp::Private;
 
-static const QStringList AVAILABLE_STATUS_TYPES = {
-    QString(),
-    QStringLiteral("away"),
-    QStringLiteral("xa"),
-    QStringLiteral("dnd"),
-    QStringLiteral("chat"),
-    QStringLiteral("invisible")
-};
+constexpr auto PRESENCE_TYPES = enumStrings<QXmppPresence::Type>(
+    u"error",
+    u"",
+    u"unavailable",
+    u"subscribe",
+    u"subscribed",
+    u"unsubscribe",
+    u"unsubscribed",
+    u"probe");
 
-class QXmppPresencePrivate : public QSharedData
-{
-public:
-    QXmppPresencePrivate();
+constexpr auto AVAILABLE_STATUS_TYPES = enumStrings<QXmppPresence::AvailableStatusType>(
+    u"",
+    u"away",
+    u"xa",
+    u"dnd",
+    u"chat",
+    u"invisible");
 
-    QXmppPresence::Type type;
-    QXmppPresence::AvailableStatusType availableStatusType;
-    QString statusText;
-    int priority;
+// Extensions that are only parsed when they are accessed, most presences are
+// only used for their type, status and capabilities.
+struct QXmppPresenceExtensions
+{
+    void parse(const QDomElement &element);
 
     // XEP-0045: Multi-User Chat
     QXmppMucItem mucItem;
     QString mucPassword;
     QList<int> mucStatusCodes;
-    bool mucSupported;
-
-    // XEP-0115: Entity Capabilities
-    QString capabilityHash;
-    QString capabilityNode;
-    QByteArray capabilityVer;
-    // Legacy XEP-0115: Entity Capabilities
-    QStringList capabilityExt;
+    bool mucSupported = false;
+    std::optional<int> mucHistoryMaxStanzas;
+    std::optional<int> mucHistorySeconds;
+    QDateTime mucHistorySince;
 
     // XEP-0153: vCard-Based Avatars
     // photoHash: the SHA1 hash of the avatar image data itself (not the base64-encoded version)
     // in accordance with RFC 3174
     QByteArray photoHash;
-    QXmppPresence::VCardUpdateType vCardUpdateType;
+    QXmppPresence::VCardUpdateType vCardUpdateType = QXmppPresence::VCardUpdateNone;
 
     // XEP-0272: Multiparty Jingle (Muji)
     bool isPreparingMujiSession = false;
@@ -73,15 +69,137 @@ public:
     QString mixUserNick;
 };
 
+class QXmppPresencePrivate : public QSharedData
+{
+public:
+    QXmppPresencePrivate();
+
+    const QXmppPresenceExtensions &extensions() const;
+    QXmppPresenceExtensions &extensions();
+
+    QXmppPresence::Type type;
+    QXmppPresence::AvailableStatusType availableStatusType;
+    QString statusText;
+    int priority;
+
+    // XEP-0115: Entity Capabilities
+    QString capabilityHash;
+    QString capabilityNode;
+    QByteArray capabilityVer;
+    // Legacy XEP-0115: Entity Capabilities
+    QStringList capabilityExt;
+
+    // Copies share the parsed extensions, they are parsed at most once.
+    mutable QVector<QDomElement> unparsedExtensions;
+    mutable QXmppPresenceExtensions parsedExtensions;
+};
+
 QXmppPresencePrivate::QXmppPresencePrivate()
     : type(QXmppPresence::Available),
       availableStatusType(QXmppPresence::Online),
-      priority(0),
-      mucSupported(false),
-      vCardUpdateType(QXmppPresence::VCardUpdateNone)
+      priority(0)
 {
 }
 
+const QXmppPresenceExtensions &QXmppPresencePrivate::extensions() const
+{
+    if (!unparsedExtensions.isEmpty()) {
+        for (const auto &element : std::as_const(unparsedExtensions)) {
+            parsedExtensions.parse(element);
+        }
+        // release the DOM
+        unparsedExtensions.clear();
+    }
+    return parsedExtensions;
+}
+
+QXmppPresenceExtensions &QXmppPresencePrivate::extensions()
+{
+    std::as_const(*this).extensions();
+    return parsedExtensions;
+}
+
+// Returns whether the element is parsed by QXmppPresenceExtensions.
+static bool isLazyExtension(const QDomElement &element)
+{
+    return isElement(element, u"x", ns_muc) ||
+        isElement(element, u"x", ns_muc_user) ||
+        element.namespaceURI() == ns_vcard_update ||
+        isElement(element, u"muji", ns_muji) ||
+        isElement(element, u"idle", ns_idle) ||
+        isElement(element, u"mix", ns_mix_presence);
+}
+
+void QXmppPresenceExtensions::parse(const QDomElement &element)
+{
+    // XEP-0045: Multi-User Chat
+    if (isElement(element, u"x", ns_muc)) {
+        mucSupported = true;
+        mucPassword = element.firstChildElement(QStringLiteral("password")).text();
+
+        const auto historyElement = element.firstChildElement(QStringLiteral("history"));
+        if (!historyElement.isNull()) {
+            bool ok = false;
+            if (const auto maxStanzas = historyElement.attribute(QStringLiteral("maxstanzas")).toInt(&ok); ok) {
+                mucHistoryMaxStanzas = maxStanzas;
+            }
+            if (const auto seconds = historyElement.attribute(QStringLiteral("seconds")).toInt(&ok); ok) {
+                mucHistorySeconds = seconds;
+            }
+            if (historyElement.hasAttribute(QStringLiteral("since"))) {
+                mucHistorySince = QXmppUtils::datetimeFromString(historyElement.attribute(QStringLiteral("since")));
+            }
+        }
+    } else if (isElement(element, u"x", ns_muc_user)) {
+        QDomElement itemElement = element.firstChildElement(QStringLiteral("item"));
+        mucItem.parse(itemElement);
+        QDomElement statusElement = element.firstChildElement(QStringLiteral("status"));
+        mucStatusCodes.clear();
+
+        while (!statusElement.isNull()) {
+            mucStatusCodes << statusElement.attribute(QStringLiteral("code")).toInt();
+            statusElement = statusElement.nextSiblingElement(QStringLiteral("status"));
+        }
+        // XEP-0153: vCard-Based Avatars
+    } else if (element.namespaceURI() == ns_vcard_update) {
+        QDomElement photoElement = element.firstChildElement(QStringLiteral("photo"));
+        if (photoElement.isNull()) {
+            photoHash = {};
+            vCardUpdateType = QXmppPresence::VCardUpdateNotReady;
+        } else {
+            photoHash = QByteArray::fromHex(photoElement.text().toLatin1());
+            if (photoHash.isEmpty()) {
+                vCardUpdateType = QXmppPresence::VCardUpdateNoPhoto;
+            } else {
+                vCardUpdateType = QXmppPresence::VCardUpdateValidPhoto;
+            }
+        }
+        // XEP-0272: Multiparty Jingle (Muji)
+    } else if (isElement(element, u"muji", ns_muji)) {
+        if (!element.firstChildElement(QStringLiteral("preparing")).isNull()) {
+            isPreparingMujiSession = true;
+        }
+
+        for (auto contentElement = element.firstChildElement(QStringLiteral("content"));
+             !contentElement.isNull();
+             contentElement = contentElement.nextSiblingElement(QStringLiteral("content"))) {
+            QXmppJingleIq::Content content;
+            content.parse(contentElement);
+            mujiContents.append(content);
+        }
+        // XEP-0319: Last User Interaction in Presence
+    } else if (isElement(element, u"idle", ns_idle)) {
+        if (element.hasAttribute(QStringLiteral("since"))) {
+            const QString since = element.attribute(QStringLiteral("since"));
+            lastUserInteraction = QXmppUtils::datetimeFromString(since);
+        }
+        // XEP-0405: Mediated Information eXchange (MIX): Participant Server Requirements
+    } else if (isElement(element, u"mix", ns_mix_presence)) {
+        mixUserJid = element.firstChildElement(QStringLiteral("jid")).text();
+        mixUserNick = element.firstChildElement(QStringLiteral("nick")).text();
+    }
+}
+
 ///
 /// Constructs a QXmppPresence.
 ///
@@ -187,7 +305,7 @@ void QXmppPresence::setType(QXmppPresence::Type type)
 
 QByteArray QXmppPresence::photoHash() const
 {
-    return d->photoHash;
+    return d->extensions().photoHash;
 }
 
 /// Sets the photo-hash of the VCardUpdate.
@@ -196,7 +314,7 @@ QByteArray QXmppPresence::photoHash() const
 
 void QXmppPresence::setPhotoHash(const QByteArray &photoHash)
 {
-    d->photoHash = photoHash;
+    d->extensions().photoHash = photoHash;
 }
 
 /// Returns the type of VCardUpdate
@@ -205,7 +323,7 @@ void QXmppPresence::setPhotoHash(const QByteArray &photoHash)
 
 QXmppPresence::VCardUpdateType QXmppPresence::vCardUpdateType() const
 {
-    return d->vCardUpdateType;
+    return d->extensions().vCardUpdateType;
 }
 
 /// Sets the type of VCardUpdate
@@ -214,7 +332,7 @@ QXmppPresence::VCardUpdateType QXmppPresence::vCardUpdateType() const
 
 void QXmppPresence::setVCardUpdateType(VCardUpdateType type)
 {
-    d->vCardUpdateType = type;
+    d->extensions().vCardUpdateType = type;
 }
 
 /// \xep{0115}: Entity Capabilities
@@ -268,7 +386,7 @@ QStringList QXmppPresence::capabilityExt() const
 ///
 bool QXmppPresence::isPreparingMujiSession() const
 {
-    return d->isPreparingMujiSession;
+    return d->extensions().isPreparingMujiSession;
 }
 
 ///
@@ -280,7 +398,7 @@ bool QXmppPresence::isPreparingMujiSession() const
 ///
 void QXmppPresence::setIsPreparingMujiSession(bool isPreparingMujiSession)
 {
-    d->isPreparingMujiSession = isPreparingMujiSession;
+    d->extensions().isPreparingMujiSession = isPreparingMujiSession;
 }
 
 ///
@@ -292,7 +410,7 @@ void QXmppPresence::setIsPreparingMujiSession(bool isPreparingMujiSession)
 ///
 QVector<QXmppJingleIq::Content> QXmppPresence::mujiContents() const
 {
-    return d->mujiContents;
+    return d->extensions().mujiContents;
 }
 
 ///
@@ -304,14 +422,14 @@ QVector<QXmppJingleIq::Content> QXmppPresence::mujiContents() const
 ///
 void QXmppPresence::setMujiContents(const QVector<QXmppJingleIq::Content> &mujiContents)
 {
-    d->mujiContents = mujiContents;
+    d->extensions().mujiContents = mujiContents;
 }
 
 /// Returns the MUC item.
 
 QXmppMucItem QXmppPresence::mucItem() const
 {
-    return d->mucItem;
+    return d->extensions().mucItem;
 }
 
 /// Sets the MUC item.
@@ -320,28 +438,28 @@ QXmppMucItem QXmppPresence::mucItem() const
 
 void QXmppPresence::setMucItem(const QXmppMucItem &item)
 {
-    d->mucItem = item;
+    d->extensions().mucItem = item;
 }
 
 /// Returns the password used to join a MUC room.
 
 QString QXmppPresence::mucPassword() const
 {
-    return d->mucPassword;
+    return d->extensions().mucPassword;
 }
 
 /// Sets the password used to join a MUC room.
 
 void QXmppPresence::setMucPassword(const QString &password)
 {
-    d->mucPassword = password;
+    d->extensions().mucPassword = password;
 }
 
 /// Returns the MUC status codes.
 
 QList<int> QXmppPresence::mucStatusCodes() const
 {
-    return d->mucStatusCodes;
+    return d->extensions().mucStatusCodes;
 }
 
 /// Sets the MUC status codes.
@@ -350,21 +468,90 @@ QList<int> QXmppPresence::mucStatusCodes() const
 
 void QXmppPresence::setMucStatusCodes(const QList<int> &codes)
 {
-    d->mucStatusCodes = codes;
+    d->extensions().mucStatusCodes = codes;
 }
 
 /// Returns true if the sender has indicated MUC support.
 
 bool QXmppPresence::isMucSupported() const
 {
-    return d->mucSupported;
+    return d->extensions().mucSupported;
 }
 
 /// Sets whether MUC is \a supported.
 
 void QXmppPresence::setMucSupported(bool supported)
 {
-    d->mucSupported = supported;
+    d->extensions().mucSupported = supported;
+}
+
+///
+/// Returns the maximum number of history messages requested when joining a
+/// MUC room.
+///
+/// \since QXmpp 1.6
+///
+std::optional<int> QXmppPresence::mucHistoryMaxStanzas() const
+{
+    return d->extensions().mucHistoryMaxStanzas;
+}
+
+///
+/// Sets the maximum number of history messages requested when joining a MUC
+/// room.
+///
+/// A value of 0 requests no history at all. The history is only sent, if MUC
+/// support is indicated using setMucSupported().
+///
+/// \since QXmpp 1.6
+///
+void QXmppPresence::setMucHistoryMaxStanzas(std::optional<int> maxStanzas)
+{
+    d->extensions().mucHistoryMaxStanzas = maxStanzas;
+}
+
+///
+/// Returns the age in seconds of the oldest history message requested when
+/// joining a MUC room.
+///
+/// \since QXmpp 1.6
+///
+std::optional<int> QXmppPresence::mucHistorySeconds() const
+{
+    return d->extensions().mucHistorySeconds;
+}
+
+///
+/// Sets the age in seconds of the oldest history message requested when
+/// joining a MUC room.
+///
+/// \since QXmpp 1.6
+///
+void QXmppPresence::setMucHistorySeconds(std::optional<int> seconds)
+{
+    d->extensions().mucHistorySeconds = seconds;
+}
+
+///
+/// Returns the date of the oldest history message requested when joining a MUC
+/// room.
+///
+/// \since QXmpp 1.6
+///
+QDateTime QXmppPresence::mucHistorySince() const
+{
+    return d->extensions().mucHistorySince;
+}
+
+///
+/// Sets the date of the oldest history message requested when joining a MUC
+/// room.
+///
+/// \since QXmpp 1.6
+///
+void QXmppPresence::setMucHistorySince(const QDateTime &since)
+{
+    d->extensions().mucHistorySince = since;
 }
 
 ///
@@ -375,7 +562,7 @@ void QXmppPresence::setMucSupported(bool supported)
 ///
 QDateTime QXmppPresence::lastUserInteraction() const
 {
-    return d->lastUserInteraction;
+    return d->extensions().lastUserInteraction;
 }
 
 ///
@@ -386,7 +573,7 @@ QDateTime QXmppPresence::lastUserInteraction() const
 ///
 void QXmppPresence::setLastUserInteraction(const QDateTime &lastUserInteraction)
 {
-    d->lastUserInteraction = lastUserInteraction;
+    d->extensions().lastUserInteraction = lastUserInteraction;
 }
 
 /// Returns the actual (full) JID of the MIX channel participant.
@@ -395,7 +582,7 @@ void QXmppPresence::setLastUserInteraction(const QDateTime &lastUserInteraction)
 
 QString QXmppPresence::mixUserJid() const
 {
-    return d->mixUserJid;
+    return d->extensions().mixUserJid;
 }
 
 /// Sets the actual (full) JID of the MIX channel participant.
@@ -404,7 +591,7 @@ QString QXmppPresence::mixUserJid() const
 
 void QXmppPresence::setMixUserJid(const QString &mixUserJid)
 {
-    d->mixUserJid = mixUserJid;
+    d->extensions().mixUserJid = mixUserJid;
 }
 
 /// Returns the MIX participant's nickname.
@@ -413,7 +600,7 @@ void QXmppPresence::setMixUserJid(const QString &mixUserJid)
 
 QString QXmppPresence::mixUserNick() const
 {
-    return d->mixUserNick;
+    return d->extensions().mixUserNick;
 }
 
 /// Sets the MIX participant's nickname.
@@ -422,7 +609,7 @@ QString QXmppPresence::mixUserNick() const
 
 void QXmppPresence::setMixUserNick(const QString &mixUserNick)
 {
-    d->mixUserNick = mixUserNick;
+    d->extensions().mixUserNick = mixUserNick;
 }
 
 /// \cond
@@ -431,9 +618,8 @@ void QXmppPresence::parse(const QDomElement &element)
     QXmppStanza::parse(element);
 
     // attributes
-    int type = PRESENCE_TYPES.indexOf(element.attribute(QStringLiteral("type")));
-    if (type > -1) {
-        d->type = Type(type);
+    if (const auto type = PRESENCE_TYPES.fromString(element.attribute(QStringLiteral("type")))) {
+        d->type = *type;
     }
 
     QXmppElementList unknownElements;
@@ -441,9 +627,8 @@ void QXmppPresence::parse(const QDomElement &element)
 
     while (!childElement.isNull()) {
         if (childElement.tagName() == QStringLiteral("show")) {
-            int availableStatusType = AVAILABLE_STATUS_TYPES.indexOf(childElement.text());
-            if (availableStatusType > -1) {
-                d->availableStatusType = AvailableStatusType(availableStatusType);
+            if (const auto availableStatusType = AVAILABLE_STATUS_TYPES.fromString(childElement.text())) {
+                d->availableStatusType = *availableStatusType;
             }
         } else if (childElement.tagName() == QStringLiteral("status")) {
             d->statusText = childElement.text();
@@ -451,7 +636,7 @@ void QXmppPresence::parse(const QDomElement &element)
             d->priority = childElement.text().toInt();
             // parse presence extensions
             // XEP-0033: Extended Stanza Addressing and errors are parsed by QXmppStanza
-        } else if (!(childElement.tagName() == QStringLiteral("addresses") && childElement.namespaceURI() == ns_extended_addressing) &&
+        } else if (!isElement(childElement, u"addresses", ns_extended_addressing) &&
                    childElement.tagName() != "error") {
             parseExtension(childElement, unknownElements);
         }
@@ -463,63 +648,14 @@ void QXmppPresence::parse(const QDomElement &element)
 
 void QXmppPresence::parseExtension(const QDomElement &element, QXmppElementList &unknownElements)
 {
-    // XEP-0045: Multi-User Chat
-    if (element.tagName() == QStringLiteral("x") && element.namespaceURI() == ns_muc) {
-        d->mucSupported = true;
-        d->mucPassword = element.firstChildElement(QStringLiteral("password")).text();
-    } else if (element.tagName() == QStringLiteral("x") && element.namespaceURI() == ns_muc_user) {
-        QDomElement itemElement = element.firstChildElement(QStringLiteral("item"));
-        d->mucItem.parse(itemElement);
-        QDomElement statusElement = element.firstChildElement(QStringLiteral("status"));
-        d->mucStatusCodes.clear();
-
-        while (!statusElement.isNull()) {
-            d->mucStatusCodes << statusElement.attribute(QStringLiteral("code")).toInt();
-            statusElement = statusElement.nextSiblingElement(QStringLiteral("status"));
-        }
-        // XEP-0115: Entity Capabilities
-    } else if (element.tagName() == QStringLiteral("c") && element.namespaceURI() == ns_capabilities) {
+    // XEP-0115: Entity Capabilities
+    if (isElement(element, u"c", ns_capabilities)) {
         d->capabilityNode = element.attribute(QStringLiteral("node"));
         d->capabilityVer = QByteArray::fromBase64(element.attribute(QStringLiteral("ver")).toLatin1());
         d->capabilityHash = element.attribute(QStringLiteral("hash"));
         d->capabilityExt = element.attribute(QStringLiteral("ext")).split(' ', Qt::SkipEmptyParts);
-        // XEP-0153: vCard-Based Avatars
-    } else if (element.namespaceURI() == ns_vcard_update) {
-        QDomElement photoElement = element.firstChildElement(QStringLiteral("photo"));
-        if (photoElement.isNull()) {
-            d->photoHash = {};
-            d->vCardUpdateType = VCardUpdateNotReady;
-        } else {
-            d->photoHash = QByteArray::fromHex(photoElement.text().toLatin1());
-            if (d->photoHash.isEmpty()) {
-                d->vCardUpdateType = VCardUpdateNoPhoto;
-            } else {
-                d->vCardUpdateType = VCardUpdateValidPhoto;
-            }
-        }
-        // XEP-0272: Multiparty Jingle (Muji)
-    } else if (element.tagName() == QStringLiteral("muji") && element.namespaceURI() == ns_muji) {
-        if (!element.firstChildElement(QStringLiteral("preparing")).isNull()) {
-            d->isPreparingMujiSession = true;
-        }
-
-        for (auto contentElement = element.firstChildElement(QStringLiteral("content"));
-             !contentElement.isNull();
-             contentElement = contentElement.nextSiblingElement(QStringLiteral("content"))) {
-            QXmppJingleIq::Content content;
-            content.parse(contentElement);
-            d->mujiContents.append(content);
-        }
-        // XEP-0319: Last User Interaction in Presence
-    } else if (element.tagName() == QStringLiteral("idle") && element.namespaceURI() == ns_idle) {
-        if (element.hasAttribute(QStringLiteral("since"))) {
-            const QString since = element.attribute(QStringLiteral("since"));
-            d->lastUserInteraction = QXmppUtils::datetimeFromString(since);
-        }
-        // XEP-0405: Mediated Information eXchange (MIX): Participant Server Requirements
-    } else if (element.tagName() == QStringLiteral("mix") && element.namespaceURI() == ns_mix_presence) {
-        d->mixUserJid = element.firstChildElement(QStringLiteral("jid")).text();
-        d->mixUserNick = element.firstChildElement(QStringLiteral("nick")).text();
+    } else if (isLazyExtension(element)) {
+        d->unparsedExtensions << element;
     } else {
         unknownElements << element;
     }
@@ -532,9 +668,9 @@ void QXmppPresence::toXml(QXmlStreamWriter *xmlWriter) const
     helperToXmlAddAttribute(xmlWriter, QStringLiteral("id"), id());
     helperToXmlAddAttribute(xmlWriter, QStringLiteral("to"), to());
     helperToXmlAddAttribute(xmlWriter, QStringLiteral("from"), from());
-    helperToXmlAddAttribute(xmlWriter, QStringLiteral("type"), PRESENCE_TYPES.at(d->type));
+    helperToXmlAddAttribute(xmlWriter, QStringLiteral("type"), PRESENCE_TYPES.toString(d->type));
 
-    const QString show = AVAILABLE_STATUS_TYPES.at(d->availableStatusType);
+    const QString show = AVAILABLE_STATUS_TYPES.toString(d->availableStatusType);
     if (!show.isEmpty()) {
         helperToXmlAddTextElement(xmlWriter, QStringLiteral("show"), show);
     }
@@ -547,23 +683,38 @@ void QXmppPresence::toXml(QXmlStreamWriter *xmlWriter) const
 
     error().toXml(xmlWriter);
 
+    const auto &ext = d->extensions();
+
     // XEP-0045: Multi-User Chat
-    if (d->mucSupported) {
+    if (ext.mucSupported) {
         xmlWriter->writeStartElement(QStringLiteral("x"));
         xmlWriter->writeDefaultNamespace(ns_muc);
-        if (!d->mucPassword.isEmpty()) {
-            xmlWriter->writeTextElement(QStringLiteral("password"), d->mucPassword);
+        if (!ext.mucPassword.isEmpty()) {
+            xmlWriter->writeTextElement(QStringLiteral("password"), ext.mucPassword);
+        }
+        if (ext.mucHistoryMaxStanzas || ext.mucHistorySeconds || ext.mucHistorySince.isValid()) {
+            xmlWriter->writeStartElement(QStringLiteral("history"));
+            if (ext.mucHistoryMaxStanzas) {
+                xmlWriter->writeAttribute(QStringLiteral("maxstanzas"), QString::number(*ext.mucHistoryMaxStanzas));
+            }
+            if (ext.mucHistorySeconds) {
+                xmlWriter->writeAttribute(QStringLiteral("seconds"), QString::number(*ext.mucHistorySeconds));
+            }
+            if (ext.mucHistorySince.isValid()) {
+                xmlWriter->writeAttribute(QStringLiteral("since"), QXmppUtils::datetimeToString(ext.mucHistorySince));
+            }
+            xmlWriter->writeEndElement();
         }
         xmlWriter->writeEndElement();
     }
 
-    if (!d->mucItem.isNull() || !d->mucStatusCodes.isEmpty()) {
+    if (!ext.mucItem.isNull() || !ext.mucStatusCodes.isEmpty()) {
         xmlWriter->writeStartElement(QStringLiteral("x"));
         xmlWriter->writeDefaultNamespace(ns_muc_user);
-        if (!d->mucItem.isNull()) {
-            d->mucItem.toXml(xmlWriter);
+        if (!ext.mucItem.isNull()) {
+            ext.mucItem.toXml(xmlWriter);
         }
-        for (const auto code : d->mucStatusCodes) {
+        for (const auto code : ext.mucStatusCodes) {
             xmlWriter->writeStartElement(QStringLiteral("status"));
             xmlWriter->writeAttribute(QStringLiteral("code"), QString::number(code));
             xmlWriter->writeEndElement();
@@ -584,15 +735,15 @@ void QXmppPresence::toXml(QXmlStreamWriter *xmlWriter) const
     }
 
     // XEP-0153: vCard-Based Avatars
-    if (d->vCardUpdateType != VCardUpdateNone) {
+    if (ext.vCardUpdateType != VCardUpdateNone) {
         xmlWriter->writeStartElement(QStringLiteral("x"));
         xmlWriter->writeDefaultNamespace(ns_vcard_update);
-        switch (d->vCardUpdateType) {
+        switch (ext.vCardUpdateType) {
         case VCardUpdateNoPhoto:
             xmlWriter->writeEmptyElement(QStringLiteral("photo"));
             break;
         case VCardUpdateValidPhoto:
-            helperToXmlAddTextElement(xmlWriter, QStringLiteral("photo"), d->photoHash.toHex());
+            helperToXmlAddTextElement(xmlWriter, QStringLiteral("photo"), ext.photoHash.toHex());
             break;
         default:
             break;
@@ -601,15 +752,15 @@ void QXmppPresence::toXml(QXmlStreamWriter *xmlWriter) const
     }
 
     // XEP-0272: Multiparty Jingle (Muji)
-    if (d->isPreparingMujiSession || !d->mujiContents.isEmpty()) {
+    if (ext.isPreparingMujiSession || !ext.mujiContents.isEmpty()) {
         xmlWriter->writeStartElement(QStringLiteral("muji"));
         xmlWriter->writeDefaultNamespace(ns_muji);
 
-        if (d->isPreparingMujiSession) {
+        if (ext.isPreparingMujiSession) {
             xmlWriter->writeEmptyElement(QStringLiteral("preparing"));
         }
 
-        for (const auto &mujiContent : d->mujiContents) {
+        for (const auto &mujiContent : ext.mujiContents) {
             mujiContent.toXml(xmlWriter);
         }
 
@@ -617,22 +768,22 @@ void QXmppPresence::toXml(QXmlStreamWriter *xmlWriter) const
     }
 
     // XEP-0319: Last User Interaction in Presence
-    if (!d->lastUserInteraction.isNull() && d->lastUserInteraction.isValid()) {
+    if (!ext.lastUserInteraction.isNull() && ext.lastUserInteraction.isValid()) {
         xmlWriter->writeStartElement(QStringLiteral("idle"));
         xmlWriter->writeDefaultNamespace(ns_idle);
-        helperToXmlAddAttribute(xmlWriter, QStringLiteral("since"), QXmppUtils::datetimeToString(d->lastUserInteraction));
+        helperToXmlAddAttribute(xmlWriter, QStringLiteral("since"), QXmppUtils::datetimeToString(ext.lastUserInteraction));
         xmlWriter->writeEndElement();
     }
 
     // XEP-0405: Mediated Information eXchange (MIX): Participant Server Requirements
-    if (!d->mixUserJid.isEmpty() || !d->mixUserNick.isEmpty()) {
+    if (!ext.mixUserJid.isEmpty() || !ext.mixUserNick.isEmpty()) {
         xmlWriter->writeStartElement(QStringLiteral("mix"));
         xmlWriter->writeDefaultNamespace(ns_mix_presence);
-        if (!d->mixUserJid.isEmpty()) {
-            helperToXmlAddTextElement(xmlWriter, QStringLiteral("jid"), d->mixUserJid);
+        if (!ext.mixUserJid.isEmpty()) {
+            helperToXmlAddTextElement(xmlWriter, QStringLiteral("jid"), ext.mixUserJid);
         }
-        if (!d->mixUserNick.isEmpty()) {
-            helperToXmlAddTextElement(xmlWriter, QStringLiteral("nick"), d->mixUserNick);
+        if (!ext.mixUserNick.isEmpty()) {
+            helperToXmlAddTextElement(xmlWriter, QStringLiteral("nick"), ext.mixUserNick);
         }
         xmlWriter->writeEndElement();
     }
@@ -10,6 +10,8 @@
 #include "QXmppMucIq.h"
 #include "QXmppStanza.h"
 
+#include <optional>
+
 class QXmppPresencePrivate;
 
 ///
@@ -89,6 +91,15 @@ public:
     bool isMucSupported() const;
     void setMucSupported(bool supported);
 
+    std::optional<int> mucHistoryMaxStanzas() const;
+    void setMucHistoryMaxStanzas(std::optional<int> maxStanzas);
+
+    std::optional<int> mucHistorySeconds() const;
+    void setMucHistorySeconds(std::optional<int> seconds);
+
+    QDateTime mucHistorySince() const;
+    void setMucHistorySince(const QDateTime &since);
+
     // XEP-0153: vCard-Based Avatars
     QByteArray photoHash() const;
     void setPhotoHash(const QByteArray &);
@@ -139,4 +150,6 @@ private:
     QSharedDataPointer<QXmppPresencePrivate> d;
 };
 
+Q_DECLARE_METATYPE(QXmppPresence)
+
 #endif  // QXMPPPRESENCE_H
@@ -8,6 +8,8 @@
 
 #include "QXmppTask.h"
 
+#include <exception>
+
 ///
 /// \brief Create and update QXmppTask objects to communicate results of asynchronous operations.
 ///
@@ -40,6 +42,8 @@ public:
     /// Report that the asynchronous operation has finished, and call the connected handler of the
     /// QXmppTask<T> belonging to this promise.
     ///
+    /// If the task has been cancelled, the value is discarded.
+    ///
     /// \param value The result of the asynchronous computation
     ///
 #ifdef QXMPP_DOC
@@ -49,9 +53,12 @@ public:
     void finish(U &&value)
 #endif
     {
+        if (d.isCancelled()) {
+            return;
+        }
         Q_ASSERT(!d.isFinished());
         d.setFinished(true);
-        if (d.continuation()) {
+        if (d.hasContinuation()) {
             if (d.isContextAlive()) {
                 d.invokeContinuation(&value);
             }
@@ -64,9 +71,12 @@ public:
     template<typename U, typename TT = T, std::enable_if_t<!std::is_void_v<TT> && std::is_constructible_v<TT, U> && !std::is_same_v<TT, U>> * = nullptr>
     void finish(U &&value)
     {
+        if (d.isCancelled()) {
+            return;
+        }
         Q_ASSERT(!d.isFinished());
         d.setFinished(true);
-        if (d.continuation()) {
+        if (d.hasContinuation()) {
             if (d.isContextAlive()) {
                 T convertedValue { std::move(value) };
                 d.invokeContinuation(&convertedValue);
@@ -79,9 +89,12 @@ public:
     template<typename U = T, std::enable_if_t<std::is_void_v<U>> * = nullptr>
     void finish()
     {
+        if (d.isCancelled()) {
+            return;
+        }
         Q_ASSERT(!d.isFinished());
         d.setFinished(true);
-        if (d.continuation()) {
+        if (d.hasContinuation()) {
             if (d.isContextAlive()) {
                 d.invokeContinuation(nullptr);
             }
@@ -89,6 +102,66 @@ public:
     }
     /// \endcond
 
+    ///
+    /// Returns whether the task of this promise has been cancelled.
+    ///
+    /// The operation can stop early then, its result is discarded anyway.
+    ///
+    /// \warning THIS API IS NOT FINALIZED YET!
+    ///
+    /// \since QXmpp 1.6
+    ///
+    bool isCancelled() const
+    {
+        return d.isCancelled();
+    }
+
+    ///
+    /// Registers a function that is called when the task of this promise is cancelled using
+    /// QXmppTask::cancel() before it has finished.
+    ///
+    /// This can be used to stop the operation and to release its resources. A previously
+    /// registered function (also by forwardCancellation()) is replaced. After the task has
+    /// finished, the function is destroyed without being called.
+    ///
+    /// \warning THIS API IS NOT FINALIZED YET!
+    ///
+    /// \since QXmpp 1.6
+    ///
+#ifndef QXMPP_DOC
+    template<typename Function>
+#endif
+    void onCancelled(Function handler)
+    {
+        static_assert(std::is_invocable_v<Function>, "Function needs to be invocable without arguments.");
+        using namespace QXmpp::Private;
+        d.setCancellationHandler(TaskContinuation([f = std::move(handler)](TaskPrivate &, void *) mutable {
+            f();
+        }));
+    }
+
+    ///
+    /// Cancels \a task when the task of this promise is cancelled.
+    ///
+    /// This is meant for promises whose result is produced from the result of \a task, so
+    /// cancelling the resulting task also cancels the operation it depends on. \a task is not
+    /// kept alive by this. A function registered using onCancelled() is replaced.
+    ///
+    /// \warning THIS API IS NOT FINALIZED YET!
+    ///
+    /// \since QXmpp 1.6
+    ///
+#ifndef QXMPP_DOC
+    template<typename U>
+#endif
+    void forwardCancellation(const QXmppTask<U> &task)
+    {
+        using namespace QXmpp::Private;
+        d.setCancellationHandler(TaskContinuation([source = TaskWeakRef(task.d)](TaskPrivate &, void *) mutable {
+            source.cancel();
+        }));
+    }
+
     ///
     /// Obtain a handle to this promise that allows to obtain the value that will be produced
     /// asynchronously.
@@ -102,4 +175,57 @@ private:
     QXmpp::Private::TaskPrivate d;
 };
 
+#ifdef QXMPP_COROUTINES
+namespace QXmpp::Private {
+
+//
+// Promise type of coroutines returning a QXmppTask.
+//
+// The coroutine starts immediately and its frame is destroyed as soon as it
+// has returned. Exceptions are not supported.
+//
+template<typename T>
+class TaskCoroutinePromiseBase
+{
+public:
+    QXmppTask<T> get_return_object() { return promise.task(); }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void unhandled_exception() { std::terminate(); }
+
+protected:
+    QXmppPromise<T> promise;
+};
+
+template<typename T>
+class TaskCoroutinePromise : public TaskCoroutinePromiseBase<T>
+{
+public:
+    template<typename U>
+    void return_value(U &&value)
+    {
+        this->promise.finish(T(std::forward<U>(value)));
+    }
+};
+
+template<>
+class TaskCoroutinePromise<void> : public TaskCoroutinePromiseBase<void>
+{
+public:
+    void return_void() { promise.finish(); }
+};
+
+}  // namespace QXmpp::Private
+
+namespace std {
+
+template<typename T, typename... Args>
+struct coroutine_traits<QXmppTask<T>, Args...>
+{
+    using promise_type = QXmpp::Private::TaskCoroutinePromise<T>;
+};
+
+}  // namespace std
+#endif
+
 #endif  // QXMPPPROMISE_H
@@ -0,0 +1,80 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPPUBSUBLAZYITEM_H
+#define QXMPPPUBSUBLAZYITEM_H
+
+#include "QXmppGlobal.h"
+
+#include <memory>
+#include <optional>
+
+#include <QDomElement>
+
+///
+/// \brief The QXmppPubSubLazyItem class is a PubSub item that is only parsed
+/// into its item type when it is accessed.
+///
+/// The ID and the publisher are read directly from the &lt;item/&gt; element,
+/// so items can be filtered without parsing their payloads. The element is
+/// part of the received stanza, no data is copied.
+///
+/// Copies share the parsed item, it is parsed at most once.
+///
+/// \since QXmpp 1.6
+///
+/// \ingroup Stanzas
+///
+template<typename T>
+class QXmppPubSubLazyItem
+{
+public:
+    /// Creates an empty item.
+    QXmppPubSubLazyItem()
+        : d(std::make_shared<State>())
+    {
+    }
+
+    /// Creates an item from an &lt;item/&gt; element.
+    explicit QXmppPubSubLazyItem(const QDomElement &element)
+        : d(std::make_shared<State>(State { element, {} }))
+    {
+    }
+
+    /// Returns the ID of the item.
+    QString id() const { return d->element.attribute(QStringLiteral("id")); }
+    /// Returns the JID of the publisher of the item, if the service provides it.
+    QString publisher() const { return d->element.attribute(QStringLiteral("publisher")); }
+    /// Returns true if the item has a payload.
+    bool hasPayload() const { return !d->element.firstChildElement().isNull(); }
+    /// Returns whether the item has already been parsed.
+    bool isParsed() const { return d->item.has_value(); }
+    /// Returns the &lt;item/&gt; element.
+    QDomElement element() const { return d->element; }
+
+    ///
+    /// Returns the parsed item.
+    ///
+    /// The item is parsed on first access.
+    ///
+    const T &item() const
+    {
+        if (!d->item) {
+            d->item.emplace();
+            d->item->parse(d->element);
+        }
+        return *d->item;
+    }
+
+private:
+    struct State
+    {
+        QDomElement element;
+        std::optional<T> item;
+    };
+
+    std::shared_ptr<State> d;
+};
+
+#endif  // QXMPPPUBSUBLAZYITEM_H
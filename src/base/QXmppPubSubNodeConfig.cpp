@@ -4,6 +4,8 @@
 
 #include "QXmppPubSubNodeConfig.h"
 
+#include <QHash>
+
 static const auto NODE_CONFIG_FORM_TYPE = QStringLiteral(u"http://jabber.org/protocol/pubsub#node_config");
 static const auto PUBLISH_OPTIONS_FORM_TYPE = QStringLiteral("http://jabber.org/protocol/pubsub#publish-options");
 
@@ -640,86 +642,59 @@ bool QXmppPubSubNodeConfig::parseField(const QXmppDataForm::Field &field)
         return false;
     }
 
-    const auto key = field.key();
-    const auto value = field.value();
-
-    if (key == ACCESS_MODEL) {
-        d->accessModel = accessModelFromString(field.value().toString());
-    } else if (key == BODY_XSLT) {
-        d->bodyXslt = value.toString();
-    } else if (key == CHILD_ASSOCIATION_POLICY) {
-        d->childAssociationPolicy = childAssociatationPolicyFromString(value.toString());
-    } else if (key == CHILD_ASSOCIATION_ALLOWLIST) {
-        d->childAssociationAllowlist = value.toStringList();
-    } else if (key == CHILD_NODES) {
-        d->childNodes = value.toStringList();
-    } else if (key == CHILD_NODES_MAX) {
-        d->childNodesMax = parseUInt(value);
-    } else if (key == COLLECTIONS) {
-        d->collections = value.toStringList();
-    } else if (key == CONTACT_JIDS) {
-        d->contactJids = value.toStringList();
-    } else if (key == DATA_FORM_XSLT) {
-        d->dataFormXslt = value.toString();
-    } else if (key == NOTIFICATIONS_ENABLED) {
-        d->notificationsEnabled = parseBool(value);
-    } else if (key == INCLUDE_PAYLOADS) {
-        d->includePayloads = parseBool(value);
-    } else if (key == DESCRIPTION) {
-        d->description = value.toString();
-    } else if (key == ITEM_EXPIRY) {
-        d->itemExpiry = parseUInt(value);
-    } else if (key == NOTIFICATION_ITEM_PUBLISHER) {
-        d->notificationItemPublisher = itemPublisherFromString(value.toString());
-    } else if (key == LANGUAGE) {
-        d->language = value.toString();
-    } else if (key == MAX_ITEMS) {
-        bool ok = false;
-        if (const auto maxItems = value.toULongLong(&ok); ok) {
-            d->maxItems = maxItems;
-        } else if (value.type() == QVariant::String && value.toString() == QStringLiteral("max")) {
-            d->maxItems = Max();
-        } else {
-            d->maxItems = Unset();
-        }
-    } else if (key == MAX_PAYLOAD_SIZE) {
-        d->maxPayloadSize = parseUInt(value);
-    } else if (key == NODE_TYPE) {
-        d->nodeType = nodeTypeFromString(value.toString());
-    } else if (key == NOTIFICATION_TYPE) {
-        d->notificationType = notificationTypeFromString(value.toString());
-    } else if (key == CONFIG_NOTIFICATIONS_ENABLED) {
-        d->configNotificationsEnabled = parseBool(value);
-    } else if (key == NODE_DELETE_NOTIFICATIONS_ENABLED) {
-        d->deleteNotificationsEnabled = parseBool(value);
-    } else if (key == RETRACT_NOTIFICATIONS_ENABLED) {
-        d->retractNotificationsEnabled = parseBool(value);
-    } else if (key == SUB_NOTIFICATIONS_ENABLED) {
-        d->subNotificationsEnabled = parseBool(value);
-    } else if (key == PERSIST_ITEMS) {
-        d->persistItems = parseBool(value);
-    } else if (key == PRESENCE_BASED_NOTIFICATIONS) {
-        d->presenceBasedNotifications = parseBool(value);
-    } else if (key == PUBLISH_MODEL) {
-        d->publishModel = publishModelFromString(value.toString());
-    } else if (key == PURGE_WHEN_OFFLINE) {
-        d->purgeWhenOffline = parseBool(value);
-    } else if (key == ALLOWED_ROSTER_GROUPS) {
-        d->allowedRosterGroups = value.toStringList();
-    } else if (key == SEND_LAST_ITEM) {
-        d->sendLastItem = sendLastItemTypeFromString(value.toString());
-    } else if (key == TEMPORARY_SUBSCRIPTIONS) {
-        d->temporarySubscriptions = parseBool(value);
-    } else if (key == ALLOW_SUBSCRIPTIONS) {
-        d->allowSubscriptions = parseBool(value);
-    } else if (key == TITLE) {
-        d->title = value.toString();
-    } else if (key == PAYLOAD_TYPE) {
-        d->payloadType = value.toString();
-    } else {
-        return false;
+    // parsers of the known fields, so each field is looked up only once
+    using Private = QXmppPubSubNodeConfigPrivate;
+    using FieldParser = void (*)(Private &, const QVariant &);
+    static const QHash<QString, FieldParser> parsers = {
+        { ACCESS_MODEL, [](Private &d, const QVariant &value) { d.accessModel = accessModelFromString(value.toString()); } },
+        { BODY_XSLT, [](Private &d, const QVariant &value) { d.bodyXslt = value.toString(); } },
+        { CHILD_ASSOCIATION_POLICY, [](Private &d, const QVariant &value) { d.childAssociationPolicy = childAssociatationPolicyFromString(value.toString()); } },
+        { CHILD_ASSOCIATION_ALLOWLIST, [](Private &d, const QVariant &value) { d.childAssociationAllowlist = value.toStringList(); } },
+        { CHILD_NODES, [](Private &d, const QVariant &value) { d.childNodes = value.toStringList(); } },
+        { CHILD_NODES_MAX, [](Private &d, const QVariant &value) { d.childNodesMax = parseUInt(value); } },
+        { COLLECTIONS, [](Private &d, const QVariant &value) { d.collections = value.toStringList(); } },
+        { CONTACT_JIDS, [](Private &d, const QVariant &value) { d.contactJids = value.toStringList(); } },
+        { DATA_FORM_XSLT, [](Private &d, const QVariant &value) { d.dataFormXslt = value.toString(); } },
+        { NOTIFICATIONS_ENABLED, [](Private &d, const QVariant &value) { d.notificationsEnabled = parseBool(value); } },
+        { INCLUDE_PAYLOADS, [](Private &d, const QVariant &value) { d.includePayloads = parseBool(value); } },
+        { DESCRIPTION, [](Private &d, const QVariant &value) { d.description = value.toString(); } },
+        { ITEM_EXPIRY, [](Private &d, const QVariant &value) { d.itemExpiry = parseUInt(value); } },
+        { NOTIFICATION_ITEM_PUBLISHER, [](Private &d, const QVariant &value) { d.notificationItemPublisher = itemPublisherFromString(value.toString()); } },
+        { LANGUAGE, [](Private &d, const QVariant &value) { d.language = value.toString(); } },
+        { MAX_ITEMS, [](Private &d, const QVariant &value) {
+             bool ok = false;
+             if (const auto maxItems = value.toULongLong(&ok); ok) {
+                 d.maxItems = maxItems;
+             } else if (value.type() == QVariant::String && value.toString() == QStringLiteral("max")) {
+                 d.maxItems = Max();
+             } else {
+                 d.maxItems = Unset();
+             }
+         } },
+        { MAX_PAYLOAD_SIZE, [](Private &d, const QVariant &value) { d.maxPayloadSize = parseUInt(value); } },
+        { NODE_TYPE, [](Private &d, const QVariant &value) { d.nodeType = nodeTypeFromString(value.toString()); } },
+        { NOTIFICATION_TYPE, [](Private &d, const QVariant &value) { d.notificationType = notificationTypeFromString(value.toString()); } },
+        { CONFIG_NOTIFICATIONS_ENABLED, [](Private &d, const QVariant &value) { d.configNotificationsEnabled = parseBool(value); } },
+        { NODE_DELETE_NOTIFICATIONS_ENABLED, [](Private &d, const QVariant &value) { d.deleteNotificationsEnabled = parseBool(value); } },
+        { RETRACT_NOTIFICATIONS_ENABLED, [](Private &d, const QVariant &value) { d.retractNotificationsEnabled = parseBool(value); } },
+        { SUB_NOTIFICATIONS_ENABLED, [](Private &d, const QVariant &value) { d.subNotificationsEnabled = parseBool(value); } },
+        { PERSIST_ITEMS, [](Private &d, const QVariant &value) { d.persistItems = parseBool(value); } },
+        { PRESENCE_BASED_NOTIFICATIONS, [](Private &d, const QVariant &value) { d.presenceBasedNotifications = parseBool(value); } },
+        { PUBLISH_MODEL, [](Private &d, const QVariant &value) { d.publishModel = publishModelFromString(value.toString()); } },
+        { PURGE_WHEN_OFFLINE, [](Private &d, const QVariant &value) { d.purgeWhenOffline = parseBool(value); } },
+        { ALLOWED_ROSTER_GROUPS, [](Private &d, const QVariant &value) { d.allowedRosterGroups = value.toStringList(); } },
+        { SEND_LAST_ITEM, [](Private &d, const QVariant &value) { d.sendLastItem = sendLastItemTypeFromString(value.toString()); } },
+        { TEMPORARY_SUBSCRIPTIONS, [](Private &d, const QVariant &value) { d.temporarySubscriptions = parseBool(value); } },
+        { ALLOW_SUBSCRIPTIONS, [](Private &d, const QVariant &value) { d.allowSubscriptions = parseBool(value); } },
+        { TITLE, [](Private &d, const QVariant &value) { d.title = value.toString(); } },
+        { PAYLOAD_TYPE, [](Private &d, const QVariant &value) { d.payloadType = value.toString(); } },
+    };
+
+    if (const auto parser = parsers.value(field.key())) {
+        parser(*d, field.value());
+        return true;
     }
-    return true;
+    return false;
 }
 
 void QXmppPubSubNodeConfig::serializeForm(QXmppDataForm &form) const
@@ -6,12 +6,15 @@
 #include "QXmppRosterIq.h"
 
 #include "QXmppConstants_p.h"
+#include "QXmppStringPool_p.h"
 #include "QXmppUtils.h"
 
 #include <QDomElement>
 #include <QSharedData>
 #include <QXmlStreamWriter>
 
+using namespace QXmpp::Private;
+
 class QXmppRosterIqPrivate : public QSharedData
 {
 public:
@@ -70,6 +73,9 @@ QString QXmppRosterIq::version() const
 ///
 /// Sets the roster version of IQ.
 ///
+/// A null version is not serialized. An empty version can be used to request
+/// the full roster from a server supporting \xep{0237, Roster Versioning}.
+///
 /// \param version as a QString
 ///
 /// \since QXmpp 1.0
@@ -129,7 +135,8 @@ void QXmppRosterIq::toXmlElementFromChild(QXmlStreamWriter *writer) const
     writer->writeDefaultNamespace(ns_roster);
 
     // XEP-0237 roster versioning - If the server does not advertise support for roster versioning, the client MUST NOT include the 'ver' attribute.
-    if (!version().isEmpty()) {
+    // An empty, but non-null version requests the full roster.
+    if (!version().isNull()) {
         writer->writeAttribute(QStringLiteral("ver"), version());
     }
 
@@ -399,7 +406,7 @@ void QXmppRosterIq::Item::setMixParticipantId(const QString &participantId)
 void QXmppRosterIq::Item::parse(const QDomElement &element)
 {
     d->name = element.attribute(QStringLiteral("name"));
-    d->bareJid = element.attribute(QStringLiteral("jid"));
+    d->bareJid = StringPool::instance()->intern(element.attribute(QStringLiteral("jid")));
     setSubscriptionTypeFromStr(element.attribute(QStringLiteral("subscription")));
     setSubscriptionStatus(element.attribute(QStringLiteral("ask")));
 
@@ -83,7 +83,12 @@ void QXmppRpcMarshaller::marshall(QXmlStreamWriter *writer, const QVariant &valu
 
 QVariant QXmppRpcMarshaller::demarshall(const QDomElement &elem, QStringList &errors)
 {
-    if (elem.tagName().toLower() != QStringLiteral("value")) {
+    // the tag names are compared without copying them to lower case
+    const auto hasTagName = [](const QDomElement &element, QLatin1String name) {
+        return element.tagName().compare(name, Qt::CaseInsensitive) == 0;
+    };
+
+    if (!hasTagName(elem, QLatin1String("value"))) {
         errors << "Bad param value";
         return QVariant();
     }
@@ -93,14 +98,16 @@ QVariant QXmppRpcMarshaller::demarshall(const QDomElement &elem, QStringList &er
     }
 
     const QDomElement typeData = elem.firstChild().toElement();
-    const QString typeName = typeData.tagName().toLower();
+    const auto isType = [&](QLatin1String name) {
+        return hasTagName(typeData, name);
+    };
 
-    if (typeName == QStringLiteral("nil")) {
+    if (isType(QLatin1String("nil"))) {
         return QVariant();
     }
-    if (typeName == QStringLiteral("string")) {
+    if (isType(QLatin1String("string"))) {
         return QVariant(typeData.text());
-    } else if (typeName == QStringLiteral("int") || typeName == QStringLiteral("i4")) {
+    } else if (isType(QLatin1String("int")) || isType(QLatin1String("i4"))) {
         bool ok = false;
         QVariant val(typeData.text().toInt(&ok));
         if (ok) {
@@ -108,18 +115,19 @@ QVariant QXmppRpcMarshaller::demarshall(const QDomElement &elem, QStringList &er
         }
         errors << "I was looking for an integer but data was courupt";
         return QVariant();
-    } else if (typeName == QStringLiteral("double")) {
+    } else if (isType(QLatin1String("double"))) {
         bool ok = false;
         QVariant val(typeData.text().toDouble(&ok));
         if (ok) {
             return val;
         }
         errors << "I was looking for an double but data was corrupt";
-    } else if (typeName == QStringLiteral("boolean")) {
-        return QVariant(typeData.text() == QStringLiteral("1") || typeData.text().toLower() == QStringLiteral("true"));
-    } else if (typeName == QStringLiteral("datetime") || typeName == QStringLiteral("datetime.iso8601")) {
+    } else if (isType(QLatin1String("boolean"))) {
+        const auto text = typeData.text();
+        return QVariant(text == QLatin1String("1") || text.compare(QLatin1String("true"), Qt::CaseInsensitive) == 0);
+    } else if (isType(QLatin1String("datetime")) || isType(QLatin1String("datetime.iso8601"))) {
         return QVariant(QDateTime::fromString(typeData.text(), Qt::ISODate));
-    } else if (typeName == QStringLiteral("array")) {
+    } else if (isType(QLatin1String("array"))) {
         QVariantList arr;
         QDomElement valueNode = typeData.firstChildElement(QStringLiteral("data")).firstChildElement();
         while (!valueNode.isNull() && errors.isEmpty()) {
@@ -127,22 +135,25 @@ QVariant QXmppRpcMarshaller::demarshall(const QDomElement &elem, QStringList &er
             valueNode = valueNode.nextSiblingElement();
         }
         return QVariant(arr);
-    } else if (typeName == QStringLiteral("struct")) {
+    } else if (isType(QLatin1String("struct"))) {
+        // the name and value are direct children of each member, there is no
+        // need to search the whole subtree of the member
         QMap<QString, QVariant> stct;
-        QDomNode valueNode = typeData.firstChild();
-        while (!valueNode.isNull() && errors.isEmpty()) {
-            const QDomElement memberNode = valueNode.toElement().elementsByTagName(QStringLiteral("name")).item(0).toElement();
-            const QDomElement dataNode = valueNode.toElement().elementsByTagName(QStringLiteral("value")).item(0).toElement();
-            stct[memberNode.text()] = demarshall(dataNode, errors);
-            valueNode = valueNode.nextSibling();
+        QDomElement memberNode = typeData.firstChildElement(QStringLiteral("member"));
+        while (!memberNode.isNull() && errors.isEmpty()) {
+            const QDomElement nameNode = memberNode.firstChildElement(QStringLiteral("name"));
+            const QDomElement dataNode = memberNode.firstChildElement(QStringLiteral("value"));
+            stct.insert(nameNode.text(), demarshall(dataNode, errors));
+            memberNode = memberNode.nextSiblingElement(QStringLiteral("member"));
         }
         return QVariant(stct);
-    } else if (typeName == QStringLiteral("base64")) {
-        QByteArray src = typeData.text().toLatin1();
-        return QVariant(QByteArray::fromBase64(src));
+    } else if (isType(QLatin1String("base64"))) {
+        // decoded in the buffer of the encoded data
+        auto result = QByteArray::fromBase64Encoding(typeData.text().toLatin1());
+        return QVariant(std::move(result.decoded));
     }
 
-    errors << QStringLiteral("Cannot handle type %1").arg(typeName);
+    errors << QStringLiteral("Cannot handle type %1").arg(typeData.tagName().toLower());
     return QVariant();
 }
 
@@ -3,6 +3,7 @@
 //
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#include "QXmppConstants_p.h"
 #include "QXmppSasl_p.h"
 #include "QXmppUtils.h"
 
@@ -27,6 +28,13 @@ static const QMap<QString, QCryptographicHash::Algorithm> SCRAM_ALGORITHMS = {
     { QStringLiteral("SCRAM-SHA3-512"), QCryptographicHash::RealSha3_512 },
 };
 
+// Hashed token mechanisms without channel binding, most preferred first.
+static const QList<QPair<QString, QCryptographicHash::Algorithm>> HT_ALGORITHMS = {
+    { QStringLiteral("HT-SHA3-512-NONE"), QCryptographicHash::RealSha3_512 },
+    { QStringLiteral("HT-SHA-512-NONE"), QCryptographicHash::Sha512 },
+    { QStringLiteral("HT-SHA-256-NONE"), QCryptographicHash::Sha256 },
+};
+
 // Calculate digest response for use with XMPP/SASL.
 
 static QByteArray calculateDigest(const QByteArray &method, const QByteArray &digestUri, const QByteArray &secret, const QByteArray &nonce, const QByteArray &cnonce, const QByteArray &nc)
@@ -243,6 +251,240 @@ void QXmppSaslSuccess::toXml(QXmlStreamWriter *writer) const
     writer->writeEndElement();
 }
 
+namespace QXmpp::Private::Sasl2 {
+
+void UserAgent::parse(const QDomElement &element)
+{
+    id = element.attribute(QStringLiteral("id"));
+    software = element.firstChildElement(QStringLiteral("software")).text();
+    device = element.firstChildElement(QStringLiteral("device")).text();
+}
+
+void UserAgent::toXml(QXmlStreamWriter *writer) const
+{
+    writer->writeStartElement(QStringLiteral("user-agent"));
+    if (!id.isEmpty()) {
+        writer->writeAttribute(QStringLiteral("id"), id);
+    }
+    if (!software.isEmpty()) {
+        writer->writeTextElement(QStringLiteral("software"), software);
+    }
+    if (!device.isEmpty()) {
+        writer->writeTextElement(QStringLiteral("device"), device);
+    }
+    writer->writeEndElement();
+}
+
+void BindRequest::parse(const QDomElement &element)
+{
+    tag = element.firstChildElement(QStringLiteral("tag")).text();
+    enableStreamManagement = false;
+    for (auto child = element.firstChildElement(); !child.isNull(); child = child.nextSiblingElement()) {
+        if (QXmppStreamManagementEnable::isStreamManagementEnable(child)) {
+            enableStreamManagement = true;
+        }
+    }
+}
+
+void BindRequest::toXml(QXmlStreamWriter *writer) const
+{
+    writer->writeStartElement(QStringLiteral("bind"));
+    writer->writeDefaultNamespace(ns_bind2);
+    if (!tag.isEmpty()) {
+        writer->writeTextElement(QStringLiteral("tag"), tag);
+    }
+    if (enableStreamManagement) {
+        QXmppStreamManagementEnable(true).toXml(writer);
+    }
+    writer->writeEndElement();
+}
+
+void Authenticate::parse(const QDomElement &element)
+{
+    mechanism = element.attribute(QStringLiteral("mechanism"));
+    for (auto child = element.firstChildElement(); !child.isNull(); child = child.nextSiblingElement()) {
+        const auto name = child.tagName();
+        const auto xmlns = child.namespaceURI();
+        if (xmlns == ns_sasl_2) {
+            if (name == QStringLiteral("initial-response")) {
+                initialResponse = QByteArray::fromBase64(child.text().toLatin1());
+            } else if (name == QStringLiteral("user-agent")) {
+                userAgent = UserAgent();
+                userAgent->parse(child);
+            }
+        } else if (xmlns == ns_bind2 && name == QStringLiteral("bind")) {
+            bindRequest = BindRequest();
+            bindRequest->parse(child);
+        } else if (QXmppStreamManagementResume::isStreamManagementResume(child)) {
+            resume = QXmppStreamManagementResume();
+            resume->parse(child);
+        } else if (xmlns == ns_fast) {
+            if (name == QStringLiteral("request-token")) {
+                tokenRequestMechanism = child.attribute(QStringLiteral("mechanism"));
+            } else if (name == QStringLiteral("fast")) {
+                fastCount = child.attribute(QStringLiteral("count")).toULongLong();
+            }
+        }
+    }
+}
+
+void Authenticate::toXml(QXmlStreamWriter *writer) const
+{
+    writer->writeStartElement(QStringLiteral("authenticate"));
+    writer->writeDefaultNamespace(ns_sasl_2);
+    writer->writeAttribute(QStringLiteral("mechanism"), mechanism);
+    if (!initialResponse.isEmpty()) {
+        writer->writeTextElement(QStringLiteral("initial-response"), initialResponse.toBase64());
+    }
+    if (userAgent) {
+        userAgent->toXml(writer);
+    }
+    if (bindRequest) {
+        bindRequest->toXml(writer);
+    }
+    if (resume) {
+        resume->toXml(writer);
+    }
+    if (!tokenRequestMechanism.isEmpty()) {
+        writer->writeStartElement(QStringLiteral("request-token"));
+        writer->writeDefaultNamespace(ns_fast);
+        writer->writeAttribute(QStringLiteral("mechanism"), tokenRequestMechanism);
+        writer->writeEndElement();
+    }
+    if (fastCount) {
+        writer->writeStartElement(QStringLiteral("fast"));
+        writer->writeDefaultNamespace(ns_fast);
+        writer->writeAttribute(QStringLiteral("count"), QString::number(*fastCount));
+        writer->writeEndElement();
+    }
+    writer->writeEndElement();
+}
+
+void Challenge::parse(const QDomElement &element)
+{
+    data = QByteArray::fromBase64(element.text().toLatin1());
+}
+
+void Challenge::toXml(QXmlStreamWriter *writer) const
+{
+    writer->writeStartElement(QStringLiteral("challenge"));
+    writer->writeDefaultNamespace(ns_sasl_2);
+    writer->writeCharacters(data.toBase64());
+    writer->writeEndElement();
+}
+
+void Response::parse(const QDomElement &element)
+{
+    data = QByteArray::fromBase64(element.text().toLatin1());
+}
+
+void Response::toXml(QXmlStreamWriter *writer) const
+{
+    writer->writeStartElement(QStringLiteral("response"));
+    writer->writeDefaultNamespace(ns_sasl_2);
+    writer->writeCharacters(data.toBase64());
+    writer->writeEndElement();
+}
+
+void Token::parse(const QDomElement &element)
+{
+    secret = element.attribute(QStringLiteral("token"));
+    expiry = QXmppUtils::datetimeFromString(element.attribute(QStringLiteral("expiry")));
+}
+
+void Token::toXml(QXmlStreamWriter *writer) const
+{
+    writer->writeStartElement(QStringLiteral("token"));
+    writer->writeDefaultNamespace(ns_fast);
+    if (expiry.isValid()) {
+        writer->writeAttribute(QStringLiteral("expiry"), QXmppUtils::datetimeToString(expiry));
+    }
+    writer->writeAttribute(QStringLiteral("token"), secret);
+    writer->writeEndElement();
+}
+
+void Success::parse(const QDomElement &element)
+{
+    for (auto child = element.firstChildElement(); !child.isNull(); child = child.nextSiblingElement()) {
+        const auto name = child.tagName();
+        const auto xmlns = child.namespaceURI();
+        if (xmlns == ns_sasl_2) {
+            if (name == QStringLiteral("additional-data")) {
+                additionalData = QByteArray::fromBase64(child.text().toLatin1());
+            } else if (name == QStringLiteral("authorization-identifier")) {
+                authorizationIdentifier = child.text();
+            }
+        } else if (xmlns == ns_bind2 && name == QStringLiteral("bound")) {
+            bound = true;
+            for (auto boundChild = child.firstChildElement(); !boundChild.isNull(); boundChild = boundChild.nextSiblingElement()) {
+                if (QXmppStreamManagementEnabled::isStreamManagementEnabled(boundChild)) {
+                    enabled = QXmppStreamManagementEnabled();
+                    enabled->parse(boundChild);
+                }
+            }
+        } else if (QXmppStreamManagementResumed::isStreamManagementResumed(child)) {
+            resumed = QXmppStreamManagementResumed();
+            resumed->parse(child);
+        } else if (xmlns == ns_fast && name == QStringLiteral("token")) {
+            token = Token();
+            token->parse(child);
+        }
+    }
+}
+
+void Success::toXml(QXmlStreamWriter *writer) const
+{
+    writer->writeStartElement(QStringLiteral("success"));
+    writer->writeDefaultNamespace(ns_sasl_2);
+    if (!additionalData.isEmpty()) {
+        writer->writeTextElement(QStringLiteral("additional-data"), additionalData.toBase64());
+    }
+    writer->writeTextElement(QStringLiteral("authorization-identifier"), authorizationIdentifier);
+    if (bound) {
+        writer->writeStartElement(QStringLiteral("bound"));
+        writer->writeDefaultNamespace(ns_bind2);
+        if (enabled) {
+            enabled->toXml(writer);
+        }
+        writer->writeEndElement();
+    }
+    if (resumed) {
+        resumed->toXml(writer);
+    }
+    if (token) {
+        token->toXml(writer);
+    }
+    writer->writeEndElement();
+}
+
+void Failure::parse(const QDomElement &element)
+{
+    for (auto child = element.firstChildElement(); !child.isNull(); child = child.nextSiblingElement()) {
+        if (child.namespaceURI() == ns_sasl) {
+            condition = child.tagName();
+        } else if (child.tagName() == QStringLiteral("text")) {
+            text = child.text();
+        }
+    }
+}
+
+void Failure::toXml(QXmlStreamWriter *writer) const
+{
+    writer->writeStartElement(QStringLiteral("failure"));
+    writer->writeDefaultNamespace(ns_sasl_2);
+    if (!condition.isEmpty()) {
+        writer->writeStartElement(condition);
+        writer->writeDefaultNamespace(ns_sasl);
+        writer->writeEndElement();
+    }
+    if (!text.isEmpty()) {
+        writer->writeTextElement(QStringLiteral("text"), text);
+    }
+    writer->writeEndElement();
+}
+
+}  // namespace QXmpp::Private::Sasl2
+
 class QXmppSaslClientPrivate
 {
 public:
@@ -294,6 +536,9 @@ QXmppSaslClient *QXmppSaslClient::create(const QString &mechanism, QObject *pare
         return new QXmppSaslClientAnonymous(parent);
     } else if (SCRAM_ALGORITHMS.contains(mechanism)) {
         return new QXmppSaslClientScram(SCRAM_ALGORITHMS.value(mechanism), parent);
+    } else if (const auto itr = std::find_if(HT_ALGORITHMS.cbegin(), HT_ALGORITHMS.cend(), [&](const auto &entry) { return entry.first == mechanism; });
+               itr != HT_ALGORITHMS.cend()) {
+        return new QXmppSaslClientHt(itr->second, parent);
     } else if (mechanism == QStringLiteral("X-FACEBOOK-PLATFORM")) {
         return new QXmppSaslClientFacebook(parent);
     } else if (mechanism == QStringLiteral("X-MESSENGER-OAUTH2")) {
@@ -530,6 +775,57 @@ bool QXmppSaslClientGoogle::respond(const QByteArray &challenge, QByteArray &res
     }
 }
 
+QXmppSaslClientHt::QXmppSaslClientHt(QCryptographicHash::Algorithm algorithm, QObject *parent)
+    : QXmppSaslClient(parent),
+      m_algorithm(algorithm),
+      m_step(0)
+{
+}
+
+QString QXmppSaslClientHt::mechanism() const
+{
+    for (const auto &[name, algorithm] : HT_ALGORITHMS) {
+        if (algorithm == m_algorithm) {
+            return name;
+        }
+    }
+    return {};
+}
+
+//
+// The password is the token and the server proves its knowledge of the token
+// in the additional data of the success.
+//
+bool QXmppSaslClientHt::respond(const QByteArray &challenge, QByteArray &response)
+{
+    const auto token = password().toUtf8();
+    if (m_step == 0) {
+        response = username().toUtf8() + '\0' +
+            QMessageAuthenticationCode::hash(QByteArrayLiteral("Initiator"), token, m_algorithm);
+        m_step++;
+        return true;
+    } else if (m_step == 1) {
+        response = QByteArray();
+        m_step++;
+        return challenge == QMessageAuthenticationCode::hash(QByteArrayLiteral("Responder"), token, m_algorithm);
+    } else {
+        warning(QStringLiteral("QXmppSaslClientHt : Invalid step"));
+        return false;
+    }
+}
+
+///
+/// Returns the supported hashed token mechanisms, most preferred first.
+///
+QStringList QXmppSaslClientHt::availableMechanisms()
+{
+    QStringList mechanisms;
+    for (const auto &entry : HT_ALGORITHMS) {
+        mechanisms << entry.first;
+    }
+    return mechanisms;
+}
+
 QXmppSaslClientPlain::QXmppSaslClientPlain(QObject *parent)
     : QXmppSaslClient(parent), m_step(0)
 {
@@ -590,19 +886,30 @@ bool QXmppSaslClientScram::respond(const QByteArray &challenge, QByteArray &resp
             return false;
         }
 
+        // the salted password is only needed if the keys are not known yet
+        if (m_keys.clientKey.isEmpty() || m_keys.salt != salt || m_keys.iterations != iterations) {
+            if (password().isEmpty()) {
+                warning(QStringLiteral("QXmppSaslClientScram : No password for the salt of the server"));
+                return false;
+            }
+            const QByteArray saltedPassword = deriveKeyPbkdf2(m_algorithm, password().toUtf8(), salt,
+                                                              iterations, m_dklen);
+            m_keys.salt = salt;
+            m_keys.iterations = iterations;
+            m_keys.clientKey = QMessageAuthenticationCode::hash(QByteArrayLiteral("Client Key"), saltedPassword, m_algorithm);
+            m_keys.serverKey = QMessageAuthenticationCode::hash(QByteArrayLiteral("Server Key"), saltedPassword, m_algorithm);
+        }
+
         // calculate proofs
         const QByteArray clientFinalMessageBare = QByteArrayLiteral("c=") + m_gs2Header.toBase64() + QByteArrayLiteral(",r=") + nonce;
-        const QByteArray saltedPassword = deriveKeyPbkdf2(m_algorithm, password().toUtf8(), salt,
-                                                          iterations, m_dklen);
-        const QByteArray clientKey = QMessageAuthenticationCode::hash(QByteArrayLiteral("Client Key"), saltedPassword, m_algorithm);
+        const QByteArray &clientKey = m_keys.clientKey;
         const QByteArray storedKey = QCryptographicHash::hash(clientKey, m_algorithm);
         const QByteArray authMessage = m_clientFirstMessageBare + QByteArrayLiteral(",") + challenge + QByteArrayLiteral(",") + clientFinalMessageBare;
         QByteArray clientProof = QMessageAuthenticationCode::hash(authMessage, storedKey, m_algorithm);
         std::transform(clientProof.cbegin(), clientProof.cend(), clientKey.cbegin(),
                        clientProof.begin(), std::bit_xor<char>());
 
-        const QByteArray serverKey = QMessageAuthenticationCode::hash(QByteArrayLiteral("Server Key"), saltedPassword, m_algorithm);
-        m_serverSignature = QMessageAuthenticationCode::hash(authMessage, serverKey, m_algorithm);
+        m_serverSignature = QMessageAuthenticationCode::hash(authMessage, m_keys.serverKey, m_algorithm);
 
         response = clientFinalMessageBare + QByteArrayLiteral(",p=") + clientProof.toBase64();
         m_step++;
@@ -671,6 +978,8 @@ QXmppSaslServer *QXmppSaslServer::create(const QString &mechanism, QObject *pare
         return new QXmppSaslServerDigestMd5(parent);
     } else if (mechanism == QStringLiteral("ANONYMOUS")) {
         return new QXmppSaslServerAnonymous(parent);
+    } else if (SCRAM_ALGORITHMS.contains(mechanism)) {
+        return new QXmppSaslServerScram(SCRAM_ALGORITHMS.value(mechanism), parent);
     } else {
         return nullptr;
     }
@@ -861,6 +1170,134 @@ QXmppSaslServer::Response QXmppSaslServerPlain::respond(const QByteArray &reques
     }
 }
 
+// Decodes the saslname of a SCRAM username, see RFC 5802 section 5.1.
+
+static QByteArray decodeSaslName(const QByteArray &name)
+{
+    QByteArray decoded = name;
+    decoded.replace("=2C", ",");
+    decoded.replace("=3D", "=");
+    return decoded;
+}
+
+QXmppSaslServerScram::QXmppSaslServerScram(QCryptographicHash::Algorithm algorithm, QObject *parent)
+    : QXmppSaslServer(parent),
+      m_algorithm(algorithm),
+      m_step(0),
+      m_iterations(0)
+{
+    const auto itr = std::find(SCRAM_ALGORITHMS.cbegin(), SCRAM_ALGORITHMS.cend(), algorithm);
+    Q_ASSERT(itr != SCRAM_ALGORITHMS.cend());
+}
+
+QString QXmppSaslServerScram::mechanism() const
+{
+    return SCRAM_ALGORITHMS.key(m_algorithm);
+}
+
+QCryptographicHash::Algorithm QXmppSaslServerScram::algorithm() const
+{
+    return m_algorithm;
+}
+
+void QXmppSaslServerScram::setCredentials(const QByteArray &salt, int iterations, const QByteArray &storedKey, const QByteArray &serverKey)
+{
+    m_salt = salt;
+    m_iterations = iterations;
+    m_storedKey = storedKey;
+    m_serverKey = serverKey;
+}
+
+// Derives the StoredKey and ServerKey from a password, see RFC 5802
+// section 3. This is expensive and should not be done in the network thread.
+
+void QXmppSaslServerScram::deriveKeys(QCryptographicHash::Algorithm algorithm, const QString &password, const QByteArray &salt, int iterations, QByteArray &storedKey, QByteArray &serverKey)
+{
+    const QByteArray saltedPassword = deriveKeyPbkdf2(algorithm, password.toUtf8(), salt,
+                                                      iterations, QCryptographicHash::hashLength(algorithm));
+    const QByteArray clientKey = QMessageAuthenticationCode::hash(QByteArrayLiteral("Client Key"), saltedPassword, algorithm);
+    storedKey = QCryptographicHash::hash(clientKey, algorithm);
+    serverKey = QMessageAuthenticationCode::hash(QByteArrayLiteral("Server Key"), saltedPassword, algorithm);
+}
+
+QXmppSaslServer::Response QXmppSaslServerScram::respond(const QByteArray &request, QByteArray &response)
+{
+    if (m_step == 0) {
+        // the client-first-message is passed again once the credentials are known
+        if (m_clientFirstMessageBare.isEmpty()) {
+            // channel binding is not supported
+            const int flagEnd = request.indexOf(',');
+            const int headerEnd = request.indexOf(',', flagEnd + 1);
+            const QByteArray flag = request.left(flagEnd);
+            if (flagEnd < 0 || headerEnd < 0 || (flag != QByteArrayLiteral("n") && flag != QByteArrayLiteral("y"))) {
+                warning(QStringLiteral("QXmppSaslServerScram : Invalid input"));
+                return Failed;
+            }
+
+            m_gs2Header = request.left(headerEnd + 1);
+            m_clientFirstMessageBare = request.mid(headerEnd + 1);
+
+            const QMap<char, QByteArray> input = parseGS2(m_clientFirstMessageBare);
+            const QByteArray username = decodeSaslName(input.value('n'));
+            const QByteArray clientNonce = input.value('r');
+            if (username.isEmpty() || clientNonce.isEmpty()) {
+                warning(QStringLiteral("QXmppSaslServerScram : Invalid input"));
+                return Failed;
+            }
+
+            setUsername(QString::fromUtf8(username));
+            m_nonce = clientNonce + generateNonce();
+        }
+
+        if (m_storedKey.isEmpty()) {
+            response = QByteArray();
+            return InputNeeded;
+        }
+
+        m_serverFirstMessage = QByteArrayLiteral("r=") + m_nonce +
+            QByteArrayLiteral(",s=") + m_salt.toBase64() +
+            QByteArrayLiteral(",i=") + QByteArray::number(m_iterations);
+
+        m_step++;
+        response = m_serverFirstMessage;
+        return Challenge;
+    } else if (m_step == 1) {
+        const int proofStart = request.lastIndexOf(",p=");
+        const QMap<char, QByteArray> input = parseGS2(request);
+        if (proofStart < 0 || input.value('c') != m_gs2Header.toBase64() || input.value('r') != m_nonce) {
+            warning(QStringLiteral("QXmppSaslServerScram : Invalid input"));
+            return Failed;
+        }
+
+        // recover the ClientKey from the proof and check it against the StoredKey
+        const QByteArray authMessage = m_clientFirstMessageBare + QByteArrayLiteral(",") + m_serverFirstMessage + QByteArrayLiteral(",") + request.left(proofStart);
+        const QByteArray clientProof = QByteArray::fromBase64(input.value('p'));
+        QByteArray clientKey = QMessageAuthenticationCode::hash(authMessage, m_storedKey, m_algorithm);
+        if (clientProof.size() != clientKey.size()) {
+            return Failed;
+        }
+        std::transform(clientKey.cbegin(), clientKey.cend(), clientProof.cbegin(),
+                       clientKey.begin(), std::bit_xor<char>());
+        if (QCryptographicHash::hash(clientKey, m_algorithm) != m_storedKey) {
+            return Failed;
+        }
+
+        // like DIGEST-MD5, send the server signature as challenge
+        const QByteArray serverSignature = QMessageAuthenticationCode::hash(authMessage, m_serverKey, m_algorithm);
+
+        m_step++;
+        response = QByteArrayLiteral("v=") + serverSignature.toBase64();
+        return Challenge;
+    } else if (m_step == 2) {
+        m_step++;
+        response = QByteArray();
+        return Succeeded;
+    } else {
+        warning(QStringLiteral("QXmppSaslServerScram : Invalid step"));
+        return Failed;
+    }
+}
+
 void QXmppSaslDigestMd5::setNonce(const QByteArray &nonce)
 {
     forcedNonce = nonce;
@@ -9,9 +9,13 @@
 #include "QXmppGlobal.h"
 #include "QXmppLogger.h"
 #include "QXmppStanza.h"
+#include "QXmppStreamManagement_p.h"
+
+#include <optional>
 
 #include <QByteArray>
 #include <QCryptographicHash>
+#include <QDateTime>
 #include <QMap>
 
 class QXmppSaslClientPrivate;
@@ -185,6 +189,97 @@ public:
     /// \endcond
 };
 
+namespace QXmpp::Private::Sasl2 {
+
+// XEP-0388: Extensible SASL Profile
+struct UserAgent
+{
+    QString id;
+    QString software;
+    QString device;
+
+    void parse(const QDomElement &element);
+    void toXml(QXmlStreamWriter *writer) const;
+};
+
+// XEP-0386: Bind 2
+struct BindRequest
+{
+    QString tag;
+    // XEP-0198: Stream Management enabled together with the binding
+    bool enableStreamManagement = false;
+
+    void parse(const QDomElement &element);
+    void toXml(QXmlStreamWriter *writer) const;
+};
+
+struct QXMPP_AUTOTEST_EXPORT Authenticate
+{
+    QString mechanism;
+    QByteArray initialResponse;
+    std::optional<UserAgent> userAgent;
+    std::optional<BindRequest> bindRequest;
+    std::optional<QXmppStreamManagementResume> resume;
+    // XEP-0484: Fast Authentication Streamlining Tokens
+    QString tokenRequestMechanism;
+    std::optional<quint64> fastCount;
+
+    void parse(const QDomElement &element);
+    void toXml(QXmlStreamWriter *writer) const;
+};
+
+struct QXMPP_AUTOTEST_EXPORT Challenge
+{
+    QByteArray data;
+
+    void parse(const QDomElement &element);
+    void toXml(QXmlStreamWriter *writer) const;
+};
+
+struct QXMPP_AUTOTEST_EXPORT Response
+{
+    QByteArray data;
+
+    void parse(const QDomElement &element);
+    void toXml(QXmlStreamWriter *writer) const;
+};
+
+// XEP-0484: Fast Authentication Streamlining Tokens
+struct Token
+{
+    QString secret;
+    QDateTime expiry;
+
+    void parse(const QDomElement &element);
+    void toXml(QXmlStreamWriter *writer) const;
+};
+
+struct QXMPP_AUTOTEST_EXPORT Success
+{
+    QByteArray additionalData;
+    QString authorizationIdentifier;
+    // XEP-0386: Bind 2
+    bool bound = false;
+    std::optional<QXmppStreamManagementEnabled> enabled;
+    // XEP-0198: Stream Management
+    std::optional<QXmppStreamManagementResumed> resumed;
+    std::optional<Token> token;
+
+    void parse(const QDomElement &element);
+    void toXml(QXmlStreamWriter *writer) const;
+};
+
+struct QXMPP_AUTOTEST_EXPORT Failure
+{
+    QString condition;
+    QString text;
+
+    void parse(const QDomElement &element);
+    void toXml(QXmlStreamWriter *writer) const;
+};
+
+}  // namespace QXmpp::Private::Sasl2
+
 class QXmppSaslClientAnonymous : public QXmppSaslClient
 {
 public:
@@ -233,6 +328,21 @@ private:
     int m_step;
 };
 
+// Hashed token mechanisms of XEP-0484: Fast Authentication Streamlining Tokens
+class QXMPP_AUTOTEST_EXPORT QXmppSaslClientHt : public QXmppSaslClient
+{
+public:
+    QXmppSaslClientHt(QCryptographicHash::Algorithm algorithm, QObject *parent = nullptr);
+    QString mechanism() const override;
+    bool respond(const QByteArray &challenge, QByteArray &response) override;
+
+    static QStringList availableMechanisms();
+
+private:
+    QCryptographicHash::Algorithm m_algorithm;
+    int m_step;
+};
+
 class QXmppSaslClientPlain : public QXmppSaslClient
 {
 public:
@@ -244,13 +354,27 @@ private:
     int m_step;
 };
 
-class QXmppSaslClientScram : public QXmppSaslClient
+class QXMPP_AUTOTEST_EXPORT QXmppSaslClientScram : public QXmppSaslClient
 {
 public:
+    // Keys derived from the password, they can be reused for the same salt and
+    // iteration count of the server without running PBKDF2 again.
+    struct Keys
+    {
+        QByteArray salt;
+        int iterations = 0;
+        QByteArray clientKey;
+        QByteArray serverKey;
+    };
+
     QXmppSaslClientScram(QCryptographicHash::Algorithm algorithm, QObject *parent = nullptr);
     QString mechanism() const override;
     bool respond(const QByteArray &challenge, QByteArray &response) override;
 
+    // the keys used by the last exchange
+    Keys keys() const { return m_keys; }
+    void setKeys(const Keys &keys) { m_keys = keys; }
+
 private:
     QCryptographicHash::Algorithm m_algorithm;
     int m_step;
@@ -259,6 +383,7 @@ private:
     QByteArray m_clientFirstMessageBare;
     QByteArray m_serverSignature;
     QByteArray m_nonce;
+    Keys m_keys;
 };
 
 class QXmppSaslClientWindowsLive : public QXmppSaslClient
@@ -324,4 +449,32 @@ private:
     int m_step;
 };
 
+class QXMPP_AUTOTEST_EXPORT QXmppSaslServerScram : public QXmppSaslServer
+{
+public:
+    QXmppSaslServerScram(QCryptographicHash::Algorithm algorithm, QObject *parent = nullptr);
+    QString mechanism() const override;
+    QCryptographicHash::Algorithm algorithm() const;
+
+    void setCredentials(const QByteArray &salt, int iterations, const QByteArray &storedKey, const QByteArray &serverKey);
+
+    Response respond(const QByteArray &challenge, QByteArray &response) override;
+
+    static void deriveKeys(QCryptographicHash::Algorithm algorithm, const QString &password, const QByteArray &salt, int iterations, QByteArray &storedKey, QByteArray &serverKey);
+
+private:
+    QCryptographicHash::Algorithm m_algorithm;
+    int m_step;
+    QByteArray m_gs2Header;
+    QByteArray m_clientFirstMessageBare;
+    QByteArray m_serverFirstMessage;
+    QByteArray m_nonce;
+
+    // credentials
+    QByteArray m_salt;
+    int m_iterations;
+    QByteArray m_storedKey;
+    QByteArray m_serverKey;
+};
+
 #endif
@@ -23,6 +23,9 @@ enum class SendError : uint8_t {
     Disconnected,
     /// The packet couldn't be sent because prior encryption failed.
     EncryptionError,
+    /// No response to an IQ request has been received within the timeout.
+    /// \since QXmpp 1.6
+    Timeout,
 };
 
 ///
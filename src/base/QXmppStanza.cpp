@@ -10,6 +10,8 @@
 
 #include "QXmppConstants_p.h"
 #include "QXmppE2eeMetadata.h"
+#include "QXmppEnumStrings_p.h"
+#include "QXmppStringPool_p.h"
 #include "QXmppStanza_p.h"
 #include "QXmppUtils.h"
 
@@ -21,154 +23,58 @@ using namespace QXmpp::Private;
 
 uint QXmppStanza::s_uniqeIdNo = 0;
 
+constexpr auto ERROR_CONDITIONS = enumStrings<QXmppStanza::Error::Condition>(
+    u"bad-request",
+    u"conflict",
+    u"feature-not-implemented",
+    u"forbidden",
+    u"gone",
+    u"internal-server-error",
+    u"item-not-found",
+    u"jid-malformed",
+    u"not-acceptable",
+    u"not-allowed",
+    u"not-authorized",
+    u"payment-required",
+    u"recipient-unavailable",
+    u"redirect",
+    u"registration-required",
+    u"remote-server-not-found",
+    u"remote-server-timeout",
+    u"resource-constraint",
+    u"service-unavailable",
+    u"subscription-required",
+    u"undefined-condition",
+    u"unexpected-request",
+    u"policy-violation");
+
+constexpr auto ERROR_TYPES = enumStrings<QXmppStanza::Error::Type>(
+    u"cancel",
+    u"continue",
+    u"modify",
+    u"auth",
+    u"wait");
+
 namespace QXmpp::Private {
 
 QString conditionToString(QXmppStanza::Error::Condition condition)
 {
-    switch (condition) {
-    case QXmppStanza::Error::NoCondition:
-        return {};
-    case QXmppStanza::Error::BadRequest:
-        return QStringLiteral("bad-request");
-    case QXmppStanza::Error::Conflict:
-        return QStringLiteral("conflict");
-    case QXmppStanza::Error::FeatureNotImplemented:
-        return QStringLiteral("feature-not-implemented");
-    case QXmppStanza::Error::Forbidden:
-        return QStringLiteral("forbidden");
-    case QXmppStanza::Error::Gone:
-        return QStringLiteral("gone");
-    case QXmppStanza::Error::InternalServerError:
-        return QStringLiteral("internal-server-error");
-    case QXmppStanza::Error::ItemNotFound:
-        return QStringLiteral("item-not-found");
-    case QXmppStanza::Error::JidMalformed:
-        return QStringLiteral("jid-malformed");
-    case QXmppStanza::Error::NotAcceptable:
-        return QStringLiteral("not-acceptable");
-    case QXmppStanza::Error::NotAllowed:
-        return QStringLiteral("not-allowed");
-    case QXmppStanza::Error::NotAuthorized:
-        return QStringLiteral("not-authorized");
-        QT_WARNING_PUSH
-        QT_WARNING_DISABLE_DEPRECATED
-    case QXmppStanza::Error::PaymentRequired:
-        QT_WARNING_POP
-        return QStringLiteral("payment-required");
-    case QXmppStanza::Error::PolicyViolation:
-        return QStringLiteral("policy-violation");
-    case QXmppStanza::Error::RecipientUnavailable:
-        return QStringLiteral("recipient-unavailable");
-    case QXmppStanza::Error::Redirect:
-        return QStringLiteral("redirect");
-    case QXmppStanza::Error::RegistrationRequired:
-        return QStringLiteral("registration-required");
-    case QXmppStanza::Error::RemoteServerNotFound:
-        return QStringLiteral("remote-server-not-found");
-    case QXmppStanza::Error::RemoteServerTimeout:
-        return QStringLiteral("remote-server-timeout");
-    case QXmppStanza::Error::ResourceConstraint:
-        return QStringLiteral("resource-constraint");
-    case QXmppStanza::Error::ServiceUnavailable:
-        return QStringLiteral("service-unavailable");
-    case QXmppStanza::Error::SubscriptionRequired:
-        return QStringLiteral("subscription-required");
-    case QXmppStanza::Error::UndefinedCondition:
-        return QStringLiteral("undefined-condition");
-    case QXmppStanza::Error::UnexpectedRequest:
-        return QStringLiteral("unexpected-request");
-    }
-    return {};
+    return ERROR_CONDITIONS.toString(condition);
 }
 
 std::optional<QXmppStanza::Error::Condition> conditionFromString(const QString &string)
 {
-    if (string == "bad-request") {
-        return QXmppStanza::Error::BadRequest;
-    } else if (string == "conflict") {
-        return QXmppStanza::Error::Conflict;
-    } else if (string == "feature-not-implemented") {
-        return QXmppStanza::Error::FeatureNotImplemented;
-    } else if (string == "forbidden") {
-        return QXmppStanza::Error::Forbidden;
-    } else if (string == "gone") {
-        return QXmppStanza::Error::Gone;
-    } else if (string == "internal-server-error") {
-        return QXmppStanza::Error::InternalServerError;
-    } else if (string == "item-not-found") {
-        return QXmppStanza::Error::ItemNotFound;
-    } else if (string == "jid-malformed") {
-        return QXmppStanza::Error::JidMalformed;
-    } else if (string == "not-acceptable") {
-        return QXmppStanza::Error::NotAcceptable;
-    } else if (string == "not-allowed") {
-        return QXmppStanza::Error::NotAllowed;
-    } else if (string == "not-authorized") {
-        return QXmppStanza::Error::NotAuthorized;
-    } else if (string == "payment-required") {
-        QT_WARNING_PUSH
-        QT_WARNING_DISABLE_DEPRECATED
-        return QXmppStanza::Error::PaymentRequired;
-        QT_WARNING_POP
-    } else if (string == "policy-violation") {
-        return QXmppStanza::Error::PolicyViolation;
-    } else if (string == "recipient-unavailable") {
-        return QXmppStanza::Error::RecipientUnavailable;
-    } else if (string == "redirect") {
-        return QXmppStanza::Error::Redirect;
-    } else if (string == "registration-required") {
-        return QXmppStanza::Error::RegistrationRequired;
-    } else if (string == "remote-server-not-found") {
-        return QXmppStanza::Error::RemoteServerNotFound;
-    } else if (string == "remote-server-timeout") {
-        return QXmppStanza::Error::RemoteServerTimeout;
-    } else if (string == "resource-constraint") {
-        return QXmppStanza::Error::ResourceConstraint;
-    } else if (string == "service-unavailable") {
-        return QXmppStanza::Error::ServiceUnavailable;
-    } else if (string == "subscription-required") {
-        return QXmppStanza::Error::SubscriptionRequired;
-    } else if (string == "undefined-condition") {
-        return QXmppStanza::Error::UndefinedCondition;
-    } else if (string == "unexpected-request") {
-        return QXmppStanza::Error::UnexpectedRequest;
-    }
-    return std::nullopt;
+    return ERROR_CONDITIONS.fromString(string);
 }
 
 QString typeToString(QXmppStanza::Error::Type type)
 {
-    switch (type) {
-    case QXmppStanza::Error::NoType:
-        return {};
-    case QXmppStanza::Error::Cancel:
-        return QStringLiteral("cancel");
-    case QXmppStanza::Error::Continue:
-        return QStringLiteral("continue");
-    case QXmppStanza::Error::Modify:
-        return QStringLiteral("modify");
-    case QXmppStanza::Error::Auth:
-        return QStringLiteral("auth");
-    case QXmppStanza::Error::Wait:
-        return QStringLiteral("wait");
-    }
-    return {};
+    return ERROR_TYPES.toString(type);
 }
 
 std::optional<QXmppStanza::Error::Type> typeFromString(const QString &string)
 {
-    if (string == QStringLiteral("cancel")) {
-        return QXmppStanza::Error::Cancel;
-    } else if (string == QStringLiteral("continue")) {
-        return QXmppStanza::Error::Continue;
-    } else if (string == QStringLiteral("modify")) {
-        return QXmppStanza::Error::Modify;
-    } else if (string == QStringLiteral("auth")) {
-        return QXmppStanza::Error::Auth;
-    } else if (string == QStringLiteral("wait")) {
-        return QXmppStanza::Error::Wait;
-    }
-    return std::nullopt;
+    return ERROR_TYPES.fromString(string);
 }
 
 }  // namespace QXmpp::Private
@@ -1020,8 +926,9 @@ void QXmppStanza::generateAndSetNextId()
 
 void QXmppStanza::parse(const QDomElement &element)
 {
-    d->from = element.attribute("from");
-    d->to = element.attribute("to");
+    // JIDs are repeated in many stanzas, share them
+    d->from = StringPool::instance()->intern(element.attribute(QStringLiteral("from")));
+    d->to = StringPool::instance()->intern(element.attribute(QStringLiteral("to")));
     d->id = element.attribute("id");
     d->lang = element.attribute("lang");
 
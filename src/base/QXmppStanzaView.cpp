@@ -0,0 +1,383 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppStanzaView.h"
+
+#include "QXmppStanzaView_p.h"
+#include "QXmppStringPool_p.h"
+
+#include <QDomElement>
+#include <QXmlStreamReader>
+
+using namespace QXmpp::Private;
+
+const QXmppStanzaViewData::Attribute *QXmppStanzaViewData::findAttribute(int node, QStringView name) const
+{
+    const auto &element = nodes[node];
+    for (int i = element.firstAttribute; i < element.firstAttribute + element.attributeCount; i++) {
+        // like QDomElement::attribute(), compare the local name
+        if (localName(attributes[i]) == name) {
+            return &attributes[i];
+        }
+    }
+    return nullptr;
+}
+
+int QXmppStanzaViewData::findElement(int node, QStringView name, QStringView xmlns) const
+{
+    for (; node >= 0; node = nodes[node].nextSibling) {
+        const auto &candidate = nodes[node];
+        if (candidate.type == Element &&
+            (name.isEmpty() || localName(candidate) == name) &&
+            (xmlns.isEmpty() || string(candidate.namespaceUri) == xmlns)) {
+            return node;
+        }
+    }
+    return -1;
+}
+
+void QXmppStanzaViewData::appendText(int node, QString &text) const
+{
+    for (int child = nodes[node].firstChild; child >= 0; child = nodes[child].nextSibling) {
+        switch (nodes[child].type) {
+        case Element:
+            appendText(child, text);
+            break;
+        case Text:
+        case CData: {
+            const auto content = string(nodes[child].name);
+            text.append(content.data(), content.size());
+            break;
+        }
+        case Comment:
+            break;
+        }
+    }
+}
+
+static QString toString(QStringView string)
+{
+    // empty namespaces are null strings in the DOM, too
+    return string.isEmpty() ? QString() : string.toString();
+}
+
+// attributes whose values are repeated in many stanzas, i.e. JIDs and types
+static bool isPooledAttribute(QStringView name)
+{
+    return name == u"from" || name == u"to" || name == u"jid" || name == u"type";
+}
+
+QDomElement QXmppStanzaViewData::domElement(int node) const
+{
+    if (domElements.empty()) {
+        domElements.resize(nodes.size());
+
+        // nodes are stored in document order, parents before their children
+        for (size_t i = 0; i < nodes.size(); i++) {
+            const auto &source = nodes[i];
+
+            QDomNode domNode;
+            switch (source.type) {
+            case Element: {
+                // names and namespaces share their data with the other stanzas
+                auto *pool = StringPool::instance();
+                auto element = document.createElementNS(pool->intern(string(source.namespaceUri)), pool->intern(string(source.name)));
+                for (int j = source.firstAttribute; j < source.firstAttribute + source.attributeCount; j++) {
+                    const auto &attribute = attributes[j];
+                    const auto value = string(attribute.value);
+                    element.setAttributeNS(pool->intern(string(attribute.namespaceUri)),
+                                           pool->intern(string(attribute.name)),
+                                           isPooledAttribute(localName(attribute)) ? pool->intern(value) : value.toString());
+                }
+                domElements[i] = element;
+                domNode = element;
+                break;
+            }
+            case Text:
+                domNode = document.createTextNode(string(source.name).toString());
+                break;
+            case CData:
+                domNode = document.createCDATASection(string(source.name).toString());
+                break;
+            case Comment:
+                domNode = document.createComment(string(source.name).toString());
+                break;
+            }
+
+            if (source.parent < 0) {
+                document.appendChild(domNode);
+            } else {
+                domElements[source.parent].appendChild(domNode);
+            }
+        }
+    }
+    return domElements[node];
+}
+
+///
+/// Constructs a null view.
+///
+QXmppStanzaView::QXmppStanzaView() = default;
+
+QXmppStanzaView::QXmppStanzaView(std::shared_ptr<const QXmppStanzaViewData> data, int node)
+    : d(std::move(data)),
+      m_node(node)
+{
+}
+
+///
+/// Returns true if the view does not point to an element.
+///
+bool QXmppStanzaView::isNull() const
+{
+    return !d || m_node < 0;
+}
+
+///
+/// Returns the local name of the element.
+///
+QStringView QXmppStanzaView::tagName() const
+{
+    if (isNull()) {
+        return {};
+    }
+    return d->localName(d->nodes[m_node]);
+}
+
+///
+/// Returns the namespace URI of the element.
+///
+QStringView QXmppStanzaView::namespaceUri() const
+{
+    if (isNull()) {
+        return {};
+    }
+    return d->string(d->nodes[m_node].namespaceUri);
+}
+
+///
+/// Returns whether the element has an attribute with the given local name.
+///
+bool QXmppStanzaView::hasAttribute(QStringView name) const
+{
+    return !isNull() && d->findAttribute(m_node, name);
+}
+
+///
+/// Returns the value of the attribute with the given local name or an empty
+/// string if there is no such attribute.
+///
+QStringView QXmppStanzaView::attribute(QStringView name) const
+{
+    if (isNull()) {
+        return {};
+    }
+    if (const auto *attribute = d->findAttribute(m_node, name)) {
+        return d->string(attribute->value);
+    }
+    return {};
+}
+
+///
+/// Returns the first child element with the given local name and namespace.
+///
+/// An empty name or namespace matches any name or namespace.
+///
+QXmppStanzaView QXmppStanzaView::firstChildElement(QStringView name, QStringView xmlns) const
+{
+    if (isNull()) {
+        return {};
+    }
+    if (const auto node = d->findElement(d->nodes[m_node].firstChild, name, xmlns); node >= 0) {
+        return QXmppStanzaView(d, node);
+    }
+    return {};
+}
+
+///
+/// Returns the next sibling element with the given local name and namespace.
+///
+/// An empty name or namespace matches any name or namespace.
+///
+QXmppStanzaView QXmppStanzaView::nextSiblingElement(QStringView name, QStringView xmlns) const
+{
+    if (isNull()) {
+        return {};
+    }
+    if (const auto node = d->findElement(d->nodes[m_node].nextSibling, name, xmlns); node >= 0) {
+        return QXmppStanzaView(d, node);
+    }
+    return {};
+}
+
+///
+/// Returns the concatenated text of the element and all of its descendants
+/// like QDomElement::text().
+///
+QString QXmppStanzaView::text() const
+{
+    QString text;
+    if (!isNull()) {
+        d->appendText(m_node, text);
+    }
+    return text;
+}
+
+///
+/// Returns the element as QDomElement.
+///
+/// The DOM of the whole stanza is created on the first call and is reused for
+/// all following calls on any view of the same stanza.
+///
+QDomElement QXmppStanzaView::toDomElement() const
+{
+    if (isNull()) {
+        return {};
+    }
+    return d->domElement(m_node);
+}
+
+/// \cond
+StanzaViewBuilder::StanzaViewBuilder() = default;
+
+void StanzaViewBuilder::startElement(const QXmlStreamReader &reader)
+{
+    m_pendingWhitespace.clear();
+    if (!d) {
+        d = std::make_shared<QXmppStanzaViewData>();
+    }
+
+    QXmppStanzaViewData::Node node;
+    node.type = QXmppStanzaViewData::Element;
+    node.name = append(reader.qualifiedName());
+    node.prefixSize = reader.prefix().isEmpty() ? 0 : reader.prefix().size() + 1;
+    node.parent = m_current;
+
+    // child elements mostly share the namespace of their parent
+    const QStringView namespaceUri = reader.namespaceUri();
+    if (m_current >= 0 && d->string(d->nodes[m_current].namespaceUri) == namespaceUri) {
+        node.namespaceUri = d->nodes[m_current].namespaceUri;
+    } else {
+        node.namespaceUri = append(namespaceUri);
+    }
+
+    const auto attributes = reader.attributes();
+    node.firstAttribute = int(d->attributes.size());
+    node.attributeCount = int(attributes.size());
+    for (const auto &attribute : attributes) {
+        QXmppStanzaViewData::Attribute entry;
+        entry.name = append(attribute.qualifiedName());
+        entry.prefixSize = attribute.prefix().isEmpty() ? 0 : attribute.prefix().size() + 1;
+        entry.namespaceUri = append(attribute.namespaceUri());
+        entry.value = append(attribute.value());
+        d->attributes.push_back(entry);
+    }
+
+    m_current = appendNode(std::move(node));
+}
+
+bool StanzaViewBuilder::endElement()
+{
+    m_pendingWhitespace.clear();
+    if (m_current < 0) {
+        return false;
+    }
+    m_current = d->nodes[m_current].parent;
+    return m_current < 0;
+}
+
+//
+// Like QDomDocument::setContent(), whitespace-only text nodes are dropped.
+// Text that the reader reports in multiple parts is merged into one node, so
+// whitespace is kept back until it is known whether more text follows.
+//
+void StanzaViewBuilder::characters(const QXmlStreamReader &reader)
+{
+    if (m_current < 0) {
+        return;
+    }
+
+    QXmppStanzaViewData::Node node;
+    node.parent = m_current;
+
+    if (reader.isCDATA()) {
+        m_pendingWhitespace.clear();
+        node.type = QXmppStanzaViewData::CData;
+        node.name = append(reader.text());
+        appendNode(std::move(node));
+        return;
+    }
+
+    // the last text node is always at the end of the string buffer
+    const auto lastChild = d->nodes[m_current].lastChild;
+    if (lastChild >= 0 && d->nodes[lastChild].type == QXmppStanzaViewData::Text) {
+        d->nodes[lastChild].name.size += append(reader.text()).size;
+    } else if (reader.isWhitespace()) {
+        m_pendingWhitespace.append(reader.text().toString());
+    } else {
+        node.type = QXmppStanzaViewData::Text;
+        node.name = append(m_pendingWhitespace);
+        node.name.size += append(reader.text()).size;
+        m_pendingWhitespace.clear();
+        appendNode(std::move(node));
+    }
+}
+
+void StanzaViewBuilder::comment(const QXmlStreamReader &reader)
+{
+    if (m_current < 0) {
+        return;
+    }
+
+    QXmppStanzaViewData::Node node;
+    node.type = QXmppStanzaViewData::Comment;
+    node.name = append(reader.text());
+    node.parent = m_current;
+    appendNode(std::move(node));
+}
+
+QXmppStanzaView StanzaViewBuilder::take()
+{
+    if (!d || d->nodes.empty()) {
+        clear();
+        return {};
+    }
+
+    QXmppStanzaView view(std::move(d), 0);
+    clear();
+    return view;
+}
+
+void StanzaViewBuilder::clear()
+{
+    d.reset();
+    m_current = -1;
+    m_pendingWhitespace.clear();
+}
+
+StanzaViewBuilder::Span StanzaViewBuilder::append(QStringView string)
+{
+    Span span { d->strings.size(), string.size() };
+    d->strings.append(string.data(), string.size());
+    return span;
+}
+
+int StanzaViewBuilder::appendNode(QXmppStanzaViewData::Node &&node)
+{
+    const auto index = int(d->nodes.size());
+    const auto parent = node.parent;
+    d->nodes.push_back(std::move(node));
+
+    if (parent >= 0) {
+        auto &parentNode = d->nodes[parent];
+        if (parentNode.lastChild >= 0) {
+            d->nodes[parentNode.lastChild].nextSibling = index;
+        } else {
+            parentNode.firstChild = index;
+        }
+        parentNode.lastChild = index;
+    }
+    return index;
+}
+/// \endcond
@@ -0,0 +1,73 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPSTANZAVIEW_H
+#define QXMPPSTANZAVIEW_H
+
+#include "QXmppGlobal.h"
+
+#include <memory>
+
+#include <QStringView>
+
+class QDomElement;
+class QXmppStanzaViewData;
+
+namespace QXmpp::Private {
+class StanzaViewBuilder;
+}
+
+///
+/// \brief The QXmppStanzaView class is a light-weight, read-only view of a
+/// received XML element.
+///
+/// All elements of a received stanza are stored in one compact, shared block
+/// of memory: names, namespaces, attribute values and texts are kept in a
+/// single string buffer, the element tree is stored as a flat list of nodes.
+/// Creating a view of a child element is therefore cheap and does not allocate.
+///
+/// Handlers that only need to look at the tag name, the namespace and a few
+/// attributes of a stanza can use the view directly. A full QDomElement is only
+/// created on request using toDomElement(). The conversion is done once per
+/// stanza and is shared by all views of the same stanza.
+///
+/// All returned QStringViews point into the shared buffer of the stanza and are
+/// valid as long as any view of the stanza exists.
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \ingroup Core
+///
+/// \since QXmpp 1.6
+///
+class QXMPP_EXPORT QXmppStanzaView
+{
+public:
+    QXmppStanzaView();
+
+    bool isNull() const;
+
+    QStringView tagName() const;
+    QStringView namespaceUri() const;
+
+    bool hasAttribute(QStringView name) const;
+    QStringView attribute(QStringView name) const;
+
+    QXmppStanzaView firstChildElement(QStringView name = {}, QStringView xmlns = {}) const;
+    QXmppStanzaView nextSiblingElement(QStringView name = {}, QStringView xmlns = {}) const;
+
+    QString text() const;
+
+    QDomElement toDomElement() const;
+
+private:
+    friend class QXmpp::Private::StanzaViewBuilder;
+
+    QXmppStanzaView(std::shared_ptr<const QXmppStanzaViewData> data, int node);
+
+    std::shared_ptr<const QXmppStanzaViewData> d;
+    int m_node = -1;
+};
+
+#endif  // QXMPPSTANZAVIEW_H
@@ -0,0 +1,131 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPSTANZAVIEW_P_H
+#define QXMPPSTANZAVIEW_P_H
+
+#include "QXmppStanzaView.h"
+
+#include <vector>
+
+#include <QDomDocument>
+#include <QString>
+
+class QXmlStreamReader;
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API. It exists for the convenience
+// of QXmppStream and QXmppStanzaView.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+class QXmppStanzaViewData
+{
+public:
+    // range in the string buffer
+    struct Span
+    {
+        qsizetype begin = 0;
+        qsizetype size = 0;
+    };
+
+    enum NodeType : quint8 {
+        Element,
+        Text,
+        CData,
+        Comment,
+    };
+
+    struct Node
+    {
+        NodeType type = Element;
+        // qualified name (elements) or content (other nodes)
+        Span name;
+        // size of the 'prefix:' part of the qualified name
+        qsizetype prefixSize = 0;
+        Span namespaceUri;
+        int firstAttribute = 0;
+        int attributeCount = 0;
+        int parent = -1;
+        int firstChild = -1;
+        int lastChild = -1;
+        int nextSibling = -1;
+    };
+
+    struct Attribute
+    {
+        Span name;
+        qsizetype prefixSize = 0;
+        Span namespaceUri;
+        Span value;
+    };
+
+    QStringView string(Span span) const
+    {
+        return QStringView(strings).mid(span.begin, span.size);
+    }
+    QStringView localName(const Node &node) const
+    {
+        return string(node.name).mid(node.prefixSize);
+    }
+    QStringView localName(const Attribute &attribute) const
+    {
+        return string(attribute.name).mid(attribute.prefixSize);
+    }
+
+    const Attribute *findAttribute(int node, QStringView name) const;
+    int findElement(int node, QStringView name, QStringView xmlns) const;
+    void appendText(int node, QString &text) const;
+    QDomElement domElement(int node) const;
+
+    QString strings;
+    std::vector<Node> nodes;
+    std::vector<Attribute> attributes;
+
+    // lazily created DOM
+    mutable QDomDocument document;
+    mutable std::vector<QDomElement> domElements;
+};
+
+namespace QXmpp::Private {
+
+//
+// Builds a QXmppStanzaView of one top-level element from the tokens of a
+// QXmlStreamReader.
+//
+class StanzaViewBuilder
+{
+    using Span = QXmppStanzaViewData::Span;
+
+public:
+    StanzaViewBuilder();
+
+    void startElement(const QXmlStreamReader &reader);
+    // Returns true, if the top-level element has been closed.
+    bool endElement();
+    void characters(const QXmlStreamReader &reader);
+    void comment(const QXmlStreamReader &reader);
+
+    QXmppStanzaView take();
+    void clear();
+
+private:
+    Span append(QStringView string);
+    int appendNode(QXmppStanzaViewData::Node &&node);
+
+    std::shared_ptr<QXmppStanzaViewData> d;
+    int m_current = -1;
+    QString m_pendingWhitespace;
+};
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPSTANZAVIEW_P_H
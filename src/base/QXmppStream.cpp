@@ -9,22 +9,44 @@
 #include "QXmppFutureUtils_p.h"
 #include "QXmppIq.h"
 #include "QXmppLogger.h"
+#include "QXmppMetrics.h"
 #include "QXmppPacket_p.h"
 #include "QXmppStanza.h"
+#include "QXmppStanzaView_p.h"
 #include "QXmppStreamManagement_p.h"
+#include "QXmppStringPool_p.h"
+#include "QXmppTokenBucket_p.h"
+#include "QXmppTracing_p.h"
 #include "QXmppUtils.h"
+#ifdef WITH_ZLIB
+#include "QXmppCompression_p.h"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
 
 #include <QBuffer>
+#include <QDateTime>
+#include <QDeadlineTimer>
 #include <QDomDocument>
+#include <QElapsedTimer>
 #include <QFuture>
 #include <QFutureInterface>
 #include <QFutureWatcher>
+#include <QHash>
 #include <QHostAddress>
 #include <QMap>
-#include <QRegularExpression>
 #include <QSslSocket>
 #include <QStringList>
+#include <QThread>
+#include <QTimer>
 #include <QTime>
+#include <QXmlStreamReader>
 #include <QXmlStreamWriter>
 
 using namespace QXmpp::Private;
@@ -33,32 +55,637 @@ struct IqState
 {
     QXmppPromise<QXmppStream::IqResult> interface;
     QString jid;
+    // identical requests sharing the response
+    std::vector<QXmppPromise<QXmppStream::IqResult>> coalescedRequests;
+    QByteArray coalescingKey;
+    // namespace of the request's payload, for the round-trip metrics
+    QString payloadNamespace;
+    QElapsedTimer sent;
+    QDeadlineTimer deadline;
 };
 
+static void finishIq(IqState &state, QXmppStream::IqResult &&result)
+{
+    for (auto &request : state.coalescedRequests) {
+        request.finish(QXmppStream::IqResult(result));
+    }
+    state.interface.finish(std::move(result));
+}
+
+// Traffic counters of a stream. They are only written in the thread of the
+// stream, but can be read from any thread, e.g. by QXmppServer.
+struct StreamCounters
+{
+    std::atomic<quint64> bytesReceived { 0 };
+    std::atomic<quint64> bytesSent { 0 };
+    std::atomic<quint64> receivedMessages { 0 };
+    std::atomic<quint64> receivedPresences { 0 };
+    std::atomic<quint64> receivedIqs { 0 };
+    std::atomic<quint64> receivedNonzas { 0 };
+    std::atomic<quint64> sentMessages { 0 };
+    std::atomic<quint64> sentPresences { 0 };
+    std::atomic<quint64> sentIqs { 0 };
+    std::atomic<quint64> sentNonzas { 0 };
+    std::atomic<quint64> parseTime { 0 };
+    std::atomic<qint64> lastActivity { 0 };
+    std::atomic<qint64> bufferedBytes { 0 };
+};
+
+// There is only one writer, so a relaxed load and store is enough and
+// cheaper than an atomic read-modify-write.
+static void add(std::atomic<quint64> &counter, quint64 amount = 1)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+static void countSentPacket(StreamCounters &counters, const QByteArray &data, bool isXmppStanza)
+{
+    if (!isXmppStanza) {
+        QXmppMetrics::increment(QXmppMetrics::SentNonzas);
+        add(counters.sentNonzas);
+    } else if (data.startsWith("<message")) {
+        QXmppMetrics::increment(QXmppMetrics::SentMessages);
+        add(counters.sentMessages);
+    } else if (data.startsWith("<presence")) {
+        QXmppMetrics::increment(QXmppMetrics::SentPresences);
+        add(counters.sentPresences);
+    } else {
+        QXmppMetrics::increment(QXmppMetrics::SentIqs);
+        add(counters.sentIqs);
+    }
+}
+
+static void countReceivedStanza(StreamCounters &counters, const QXmppStanzaView &stanza)
+{
+    const auto tagName = stanza.tagName();
+    if (tagName == u"message") {
+        QXmppMetrics::increment(QXmppMetrics::ReceivedMessages);
+        add(counters.receivedMessages);
+    } else if (tagName == u"presence") {
+        QXmppMetrics::increment(QXmppMetrics::ReceivedPresences);
+        add(counters.receivedPresences);
+    } else if (tagName == u"iq") {
+        QXmppMetrics::increment(QXmppMetrics::ReceivedIqs);
+        add(counters.receivedIqs);
+    } else {
+        QXmppMetrics::increment(QXmppMetrics::ReceivedNonzas);
+        add(counters.receivedNonzas);
+    }
+}
+
+// Returns the namespace of the payload of a serialized IQ, e.g.
+// "jabber:iq:roster". The payload is the first child element of the IQ.
+static QString iqPayloadNamespace(const QByteArray &data)
+{
+    // '>' is escaped in attribute values, so the first one ends the start tag
+    const auto iqEnd = data.indexOf('>');
+    if (iqEnd <= 0 || data.at(iqEnd - 1) == '/') {
+        return {};
+    }
+
+    const auto payloadStart = data.indexOf('<', iqEnd);
+    if (payloadStart < 0 || data.at(payloadStart + 1) == '/') {
+        return {};
+    }
+
+    const auto payloadEnd = data.indexOf('>', payloadStart);
+    const auto xmlns = data.indexOf("xmlns=", payloadStart);
+    if (xmlns < 0 || xmlns > payloadEnd || xmlns + 7 >= data.size()) {
+        return {};
+    }
+
+    const auto quote = data.at(xmlns + 6);
+    const auto valueStart = xmlns + 7;
+    const auto valueEnd = data.indexOf(quote, valueStart);
+    if (valueEnd < 0) {
+        return {};
+    }
+    return QString::fromUtf8(data.constData() + valueStart, valueEnd - valueStart);
+}
+
+// IQs from this size on are sent in the bulk lane, e.g. large publications
+constexpr qsizetype BULK_STANZA_SIZE = 16 * 1024;
+
+// Returns whether a serialized stanza belongs to a bulk transfer: in-band
+// bytestreams, archive queries and large IQs.
+static bool isBulkStanza(const QByteArray &data)
+{
+    if (!data.startsWith("<iq ")) {
+        return false;
+    }
+    if (data.size() >= BULK_STANZA_SIZE) {
+        return true;
+    }
+    const auto xmlns = iqPayloadNamespace(data);
+    return xmlns == ns_ibb || xmlns == ns_mam;
+}
+
+// Identifies a get request by its recipient and its payload without the ID.
+static QByteArray iqCoalescingKey(QByteArray data, const QString &id, const QString &to)
+{
+    data.replace(QByteArrayLiteral("id=\"") + id.toUtf8() + '"', QByteArray());
+    return to.toUtf8() + '\n' + data;
+}
+
+// Creates a DOM element (with its attributes) from the current start element
+// of the reader. Used for the stream element.
+static QDomElement createElement(QDomDocument &document, const QXmlStreamReader &reader)
+{
+    auto *pool = StringPool::instance();
+    auto element = document.createElementNS(pool->intern(reader.namespaceUri()), pool->intern(reader.qualifiedName()));
+    const auto attributes = reader.attributes();
+    for (const auto &attribute : attributes) {
+        element.setAttributeNS(pool->intern(attribute.namespaceUri()), pool->intern(attribute.qualifiedName()), attribute.value().toString());
+    }
+    return element;
+}
+
+namespace QXmpp::Private {
+
+// Event of the received XML stream, produced by the StreamParser.
+struct StreamEvent
+{
+    enum Type {
+        StreamStart,
+        StreamEnd,
+        Stanza,
+        WhitespacePing,
+        Error,
+    };
+
+    Type type;
+    QDomElement streamElement;
+    QXmppStanzaView stanza;
+    // nanoseconds spent parsing the stanza
+    qint64 parseTime = 0;
+    // condition and text of the stream error to be sent
+    QString condition;
+    QString text;
+};
+
+//
+// Incremental parser of the received XML stream.
+//
+// The data is parsed by a QXmlStreamReader: it keeps the tokenizer state
+// across reads, so every byte is only looked at once, regardless of how many
+// reads a large stanza is split into.
+//
+// The reader is fed with the raw UTF-8 data. Strings are only created for the
+// names, attribute values and texts of the parsed elements.
+//
+// A compact QXmppStanzaView of the current top-level element is built while
+// its tokens arrive and the element is handed off as soon as its closing tag
+// has been read. A DOM is only created if a handler asks for it.
+//
+// The data of an incomplete element is kept by the reader. With a maximum
+// stanza size, it is never buffered beyond the limit (plus one read).
+//
+class StreamParser
+{
+public:
+    // The handler is called with each event and may reset or stop the parser.
+    template<typename Handler>
+    void parse(const QByteArray &data, qint64 maximumStanzaSize, Handler &&handler);
+    void reset();
+    void stop();
+
+private:
+    template<typename Handler>
+    void fail(Handler &handler, const QString &condition, const QString &text);
+
+    QXmlStreamReader reader;
+    bool readerStarted = false;
+    // 0: no stream, 1: inside stream, > 1: inside stanza
+    int depth = 0;
+    // set when the stream has been closed because of invalid input
+    bool failed = false;
+    // bytes received since the last complete top-level element
+    qint64 pendingBytes = 0;
+    // character offset of the current stanza's start in the reader
+    qint64 stanzaStart = 0;
+    // nanoseconds spent parsing the current stanza in earlier reads
+    qint64 stanzaParseTime = 0;
+    StanzaViewBuilder stanzaBuilder;
+};
+
+template<typename Handler>
+void StreamParser::parse(const QByteArray &data, qint64 maximumStanzaSize, Handler &&handler)
+{
+    if (failed) {
+        return;
+    }
+
+    // Check for whitespace pings
+    if (depth <= 1 && data.trimmed().isEmpty()) {
+        // Whitespace in front of the XML declaration is invalid, so it is only
+        // passed to the reader once the stream has started.
+        if (readerStarted) {
+            reader.addData(data);
+        }
+        handler(StreamEvent { StreamEvent::WhitespacePing });
+        return;
+    }
+
+    if (maximumStanzaSize > 0) {
+        pendingBytes += data.size();
+        if (pendingBytes > maximumStanzaSize) {
+            fail(handler, QStringLiteral("policy-violation"), QStringLiteral("Stanza exceeds the maximum size."));
+            return;
+        }
+    }
+
+    reader.addData(data);
+    readerStarted = true;
+
+    // parse time of the current element, without the time of the handlers
+    // and of waiting for further data
+    QElapsedTimer parseTimer;
+    parseTimer.start();
+
+    // the handlers may stop the parser
+    while (!failed) {
+        switch (reader.readNext()) {
+        case QXmlStreamReader::Invalid:
+            // all available data has been processed
+            if (depth > 1) {
+                stanzaParseTime += parseTimer.nsecsElapsed();
+            }
+            if (reader.error() != QXmlStreamReader::PrematureEndOfDocumentError) {
+                fail(handler, QStringLiteral("not-well-formed"), QStringLiteral("Received malformed XML: %1").arg(reader.errorString()));
+            }
+            return;
+        case QXmlStreamReader::EndDocument:
+            return;
+        case QXmlStreamReader::DTD:
+        case QXmlStreamReader::EntityReference:
+        case QXmlStreamReader::ProcessingInstruction:
+            // forbidden by RFC 6120, section 11.1
+            fail(handler, QStringLiteral("restricted-xml"), QStringLiteral("Received restricted XML."));
+            return;
+        case QXmlStreamReader::StartElement:
+            if (depth == 0) {
+                // process stream start
+                QDomDocument document;
+                auto streamElement = createElement(document, reader);
+                document.appendChild(streamElement);
+
+                depth = 1;
+                pendingBytes = 0;
+                StreamEvent event { StreamEvent::StreamStart };
+                event.streamElement = std::move(streamElement);
+                handler(std::move(event));
+            } else {
+                // start of a stanza or one of its children
+                if (depth == 1) {
+                    stanzaStart = reader.characterOffset();
+                    stanzaParseTime = 0;
+                    parseTimer.restart();
+                }
+                stanzaBuilder.startElement(reader);
+                depth++;
+            }
+            break;
+        case QXmlStreamReader::EndElement:
+            if (depth == 1) {
+                // process stream end
+                depth = 0;
+                handler(StreamEvent { StreamEvent::StreamEnd });
+                return;
+            }
+
+            depth--;
+            if (stanzaBuilder.endElement()) {
+                // top-level element complete
+                pendingBytes = 0;
+                StreamEvent event { StreamEvent::Stanza };
+                event.stanza = stanzaBuilder.take();
+                event.parseTime = stanzaParseTime + parseTimer.nsecsElapsed();
+                handler(std::move(event));
+                parseTimer.restart();
+            }
+            break;
+        case QXmlStreamReader::Characters:
+            stanzaBuilder.characters(reader);
+            break;
+        case QXmlStreamReader::Comment:
+            stanzaBuilder.comment(reader);
+            break;
+        default:
+            break;
+        }
+
+        if (maximumStanzaSize > 0 && depth > 1 &&
+            reader.characterOffset() - stanzaStart > maximumStanzaSize) {
+            fail(handler, QStringLiteral("policy-violation"), QStringLiteral("Stanza exceeds the maximum size."));
+            return;
+        }
+    }
+}
+
+void StreamParser::reset()
+{
+    reader.clear();
+    readerStarted = false;
+    depth = 0;
+    failed = false;
+    pendingBytes = 0;
+    stanzaBuilder.clear();
+}
+
+void StreamParser::stop()
+{
+    failed = true;
+    stanzaBuilder.clear();
+}
+
+template<typename Handler>
+void StreamParser::fail(Handler &handler, const QString &condition, const QString &text)
+{
+    stop();
+    StreamEvent event { StreamEvent::Error };
+    event.condition = condition;
+    event.text = text;
+    handler(std::move(event));
+}
+
+//
+// Runs the StreamParser of a stream in a worker thread.
+//
+// The events of each read are handed back to the thread of the stream in one
+// batch. The DOM of the stanzas is created in the worker thread, too.
+//
+struct BackgroundParser
+{
+    BackgroundParser()
+    {
+        thread.setObjectName(QStringLiteral("QXmppStream parser"));
+        context->moveToThread(&thread);
+        thread.start();
+    }
+
+    ~BackgroundParser()
+    {
+        thread.quit();
+        thread.wait();
+        delete context;
+    }
+
+    QThread thread;
+    // receives the data in the worker thread
+    QObject *context = new QObject;
+    // only used in the worker thread
+    StreamParser parser;
+};
+
+}  // namespace QXmpp::Private
+
 class QXmppStreamPrivate
 {
 public:
     QXmppStreamPrivate(QXmppStream *stream);
 
-    QString dataBuffer;
     QSslSocket *socket;
 
     // incoming stream state
-    QString streamOpenElement;
+    StreamParser parser;
+    // 0: no stream, 1: inside stream
+    int depth = 0;
+    // set when the stream has been closed because of invalid input
+    bool receiveFailed = false;
+    // 0 means no limit
+    qint64 maximumStanzaSize = 0;
+
+    // parsing in a worker thread, applied when the stream starts
+    bool backgroundParsingEnabled = false;
+    std::unique_ptr<BackgroundParser> backgroundParser;
+    // incremented when the stream is restarted, to drop the events of the
+    // previous stream that are still underway
+    quint64 parserGeneration = 0;
 
     // stream management
     QXmppStreamManager streamManager;
 
+    void finishIq(QMap<QString, IqState>::iterator itr, QXmppStream::IqResult &&result);
+    void cancelIq(const QString &id);
+    void scheduleIqTimeout(const QString &id, qint64 msecs);
+    void handleIqTimeoutTick();
+
     // iq response handling
     QMap<QString, IqState> runningIqs;
+    bool iqCoalescingEnabled = false;
+    // coalescing keys mapped to the IDs of the running requests
+    QHash<QByteArray, QString> coalescedIqs;
+    // IDs of cancelled requests mapped to their recipients, their responses
+    // are dropped without being parsed
+    QHash<QString, QString> cancelledIqs;
+
+    // IQ timeouts, disabled if zero
+    int iqTimeout = 0;
+    // Timer wheel: the IDs of the running IQs are put into the slot of the
+    // tick in which they expire, so one timer is enough for all requests.
+    // IDs of answered requests are skipped when their slot is reached.
+    static constexpr int IqTimeoutSlots = 64;
+    std::array<std::vector<QString>, IqTimeoutSlots> iqTimeoutSlots;
+    int currentIqTimeoutSlot = 0;
+    qsizetype scheduledIqTimeouts = 0;
+    QTimer *iqTimeoutTimer = nullptr;
+
+    // write coalescing
+    int writeBatchSize = 0;
+    int writeBatchDelay = 0;
+    QByteArray writeBuffer;
+    int bufferedWrites = 0;
+    bool flushScheduled = false;
+
+    // Bulk lane: transfer stanzas are held back while more than the threshold
+    // is waiting to be written, so messages, presences and other IQs are
+    // written before them. Disabled if zero.
+    qint64 bulkWriteThreshold = 0;
+    std::deque<QXmppPacket> bulkPackets;
+    qint64 bulkBytes = 0;
+
+    // reused for serializing outgoing nonzas, empty while it is in use
+    QByteArray serializationBuffer;
+
+#ifdef WITH_ZLIB
+    // XEP-0138: Stream Compression, enabled if set
+    std::unique_ptr<ZlibCompressor> compressor;
+    std::unique_ptr<ZlibDecompressor> decompressor;
+#endif
+
+    // receive rate limiting
+    TokenBucket receivedStanzaBucket;
+    TokenBucket receivedByteBucket;
+    QElapsedTimer rateLimitClock;
+    QTimer *resumeReadingTimer = nullptr;
+    bool readingPaused = false;
+    quint64 receivedStanzas = 0;
+    // limit of the socket's read buffer, 0 means no limit
+    qint64 readBufferSize = 0;
+
+    StreamCounters counters;
+
+    bool write(const QByteArray &data);
+    qint64 pendingWriteBytes() const;
+    bool holdsBack(const QByteArray &data, bool isXmppStanza) const;
+    void resetCompression();
+    void applyReadBufferSize();
+    void updateBufferedBytes();
 };
 
+// Maximum size of the data decompressed at once, so small compressed input can
+// not expand into a huge buffer before the maximum stanza size is checked.
+constexpr qsizetype DECOMPRESSION_CHUNK_SIZE = 64 * 1024;
+
+// Size of the socket's read buffer with rate limiting. When it is full, the
+// socket stops reading and the peer is slowed down by TCP flow control.
+constexpr qint64 RATE_LIMITED_READ_BUFFER_SIZE = 64 * 1024;
+
 QXmppStreamPrivate::QXmppStreamPrivate(QXmppStream *stream)
     : socket(nullptr),
       streamManager(stream)
 {
 }
 
+// Writes data to the socket, compressed if stream compression is enabled.
+bool QXmppStreamPrivate::write(const QByteArray &data)
+{
+    QXMPP_TRACE_SPAN(span, "stream", "write");
+#ifdef WITH_ZLIB
+    if (compressor) {
+        const auto compressed = compressor->compress(data);
+        if (!compressor->isValid()) {
+            return false;
+        }
+        return socket->write(compressed) == compressed.size();
+    }
+#endif
+    return socket->write(data) == data.size();
+}
+
+// Returns the number of bytes that are waiting to be written to the network.
+qint64 QXmppStreamPrivate::pendingWriteBytes() const
+{
+    return writeBuffer.size() + socket->bytesToWrite() + socket->encryptedBytesToWrite();
+}
+
+// Returns whether a stanza needs to wait in the bulk lane.
+bool QXmppStreamPrivate::holdsBack(const QByteArray &data, bool isXmppStanza) const
+{
+    if (bulkWriteThreshold <= 0 || !isXmppStanza || !socket || socket->state() != QAbstractSocket::ConnectedState) {
+        return false;
+    }
+    // stanzas of the lane keep their order
+    return (!bulkPackets.empty() || pendingWriteBytes() >= bulkWriteThreshold) && isBulkStanza(data);
+}
+
+void QXmppStreamPrivate::resetCompression()
+{
+#ifdef WITH_ZLIB
+    compressor.reset();
+    decompressor.reset();
+#endif
+}
+
+void QXmppStreamPrivate::applyReadBufferSize()
+{
+    if (!socket) {
+        return;
+    }
+    auto size = readBufferSize;
+    if (receivedStanzaBucket.isEnabled() || receivedByteBucket.isEnabled()) {
+        size = size > 0 ? std::min(size, RATE_LIMITED_READ_BUFFER_SIZE) : RATE_LIMITED_READ_BUFFER_SIZE;
+    }
+    socket->setReadBufferSize(size);
+}
+
+// Stores the size of the buffers for statistics(), which may be called from
+// other threads.
+void QXmppStreamPrivate::updateBufferedBytes()
+{
+    qint64 bytes = writeBuffer.capacity() + serializationBuffer.capacity() + bulkBytes;
+    if (socket) {
+        bytes += socket->bytesAvailable() + socket->bytesToWrite();
+    }
+    counters.bufferedBytes.store(bytes, std::memory_order_relaxed);
+}
+
+void QXmppStreamPrivate::finishIq(QMap<QString, IqState>::iterator itr, QXmppStream::IqResult &&result)
+{
+    // remove the state first, the handlers may send new requests
+    auto state = std::move(itr.value());
+    runningIqs.erase(itr);
+    QXmppMetrics::addToGauge(QXmppMetrics::PendingIqs, -1);
+    if (!state.coalescingKey.isEmpty()) {
+        coalescedIqs.remove(state.coalescingKey);
+    }
+    ::finishIq(state, std::move(result));
+}
+
+// Stops waiting for the response once all tasks of the request are cancelled.
+void QXmppStreamPrivate::cancelIq(const QString &id)
+{
+    const auto itr = runningIqs.find(id);
+    if (itr == runningIqs.end() || !itr->interface.isCancelled()) {
+        return;
+    }
+    const auto &requests = itr->coalescedRequests;
+    if (!std::all_of(requests.begin(), requests.end(), [](const auto &request) { return request.isCancelled(); })) {
+        return;
+    }
+
+    if (!itr->coalescingKey.isEmpty()) {
+        coalescedIqs.remove(itr->coalescingKey);
+    }
+    cancelledIqs.insert(id, itr->jid);
+    runningIqs.erase(itr);
+    QXmppMetrics::addToGauge(QXmppMetrics::PendingIqs, -1);
+}
+
+void QXmppStreamPrivate::scheduleIqTimeout(const QString &id, qint64 msecs)
+{
+    // requests expiring after more than one round are checked again when
+    // their slot is reached
+    const qint64 interval = iqTimeoutTimer->interval();
+    const auto ticks = std::clamp<qint64>((msecs + interval - 1) / interval, 1, IqTimeoutSlots - 1);
+    iqTimeoutSlots[(currentIqTimeoutSlot + ticks) % IqTimeoutSlots].push_back(id);
+
+    if (scheduledIqTimeouts++ == 0) {
+        iqTimeoutTimer->start();
+    }
+}
+
+void QXmppStreamPrivate::handleIqTimeoutTick()
+{
+    currentIqTimeoutSlot = (currentIqTimeoutSlot + 1) % IqTimeoutSlots;
+    const auto ids = std::move(iqTimeoutSlots[currentIqTimeoutSlot]);
+    iqTimeoutSlots[currentIqTimeoutSlot].clear();
+    scheduledIqTimeouts -= qsizetype(ids.size());
+
+    for (const auto &id : ids) {
+        // looked up again each time, the handlers may send new requests
+        const auto itr = runningIqs.find(id);
+        if (itr == runningIqs.end()) {
+            // a late response to a cancelled request is handled like any
+            // other stanza
+            cancelledIqs.remove(id);
+            continue;
+        }
+        if (!itr->deadline.hasExpired()) {
+            scheduleIqTimeout(id, itr->deadline.remainingTime());
+            continue;
+        }
+
+        finishIq(itr, QXmppError {
+                          QStringLiteral("No response to the IQ request has been received in time."),
+                          QXmpp::SendError::Timeout });
+    }
+
+    if (scheduledIqTimeouts == 0) {
+        iqTimeoutTimer->stop();
+    }
+}
+
 ///
 /// \typedef QXmppStream::IqResult
 ///
@@ -87,6 +714,8 @@ QXmppStream::QXmppStream(QObject *parent)
 QXmppStream::~QXmppStream()
 {
     cancelOngoingIqs();
+    // no events are posted to the stream after this
+    d->backgroundParser.reset();
     delete d;
 }
 
@@ -95,11 +724,13 @@ QXmppStream::~QXmppStream()
 ///
 void QXmppStream::disconnectFromHost()
 {
+    releaseBulkPackets();
     d->streamManager.handleDisconnect();
 
     if (d->socket) {
         if (d->socket->state() == QAbstractSocket::ConnectedState) {
             sendData(QByteArrayLiteral("</stream:stream>"));
+            flushData();
             d->socket->flush();
         }
         // FIXME: according to RFC 6120 section 4.4, we should wait for
@@ -116,9 +747,36 @@ void QXmppStream::disconnectFromHost()
 ///
 void QXmppStream::handleStart()
 {
+    releaseBulkPackets();
     d->streamManager.handleStart();
-    d->dataBuffer.clear();
-    d->streamOpenElement.clear();
+    d->depth = 0;
+    d->receiveFailed = false;
+    d->parser.reset();
+
+    d->parserGeneration++;
+    if (d->backgroundParsingEnabled != bool(d->backgroundParser)) {
+        d->backgroundParser.reset(d->backgroundParsingEnabled ? new BackgroundParser : nullptr);
+    } else if (d->backgroundParser) {
+        QMetaObject::invokeMethod(
+            d->backgroundParser->context, [parser = d->backgroundParser.get()]() {
+                parser->parser.reset();
+            },
+            Qt::QueuedConnection);
+    }
+}
+
+///
+/// Handles an incoming XMPP stanza.
+///
+/// The default implementation converts the stanza to a QDomElement and calls
+/// handleStanza(const QDomElement &). Reimplement this method to handle
+/// stanzas without creating a DOM.
+///
+/// \since QXmpp 1.6
+///
+void QXmppStream::handleStanza(const QXmppStanzaView &stanza)
+{
+    handleStanza(stanza.toDomElement());
 }
 
 ///
@@ -133,15 +791,215 @@ bool QXmppStream::isConnected() const
 ///
 /// Sends raw data to the peer.
 ///
+/// If write batching is enabled, the data is buffered and written to the
+/// socket together with the data of following calls, see setWriteBatchSize().
+///
 /// \param data
 ///
 bool QXmppStream::sendData(const QByteArray &data)
 {
-    logSent(QString::fromUtf8(data));
+    // the data is only converted to UTF-16 if it is logged
+    if (isLoggingEnabled(QXmppLogger::SentMessage)) {
+        logSent(QString::fromUtf8(data));
+    }
     if (!d->socket || d->socket->state() != QAbstractSocket::ConnectedState) {
         return false;
     }
-    return d->socket->write(data) == data.size();
+    add(d->counters.bytesSent, quint64(data.size()));
+    d->counters.lastActivity.store(QDateTime::currentMSecsSinceEpoch(), std::memory_order_relaxed);
+    if (d->writeBatchSize <= 0) {
+        return d->write(data);
+    }
+
+    d->writeBuffer.append(data);
+    d->bufferedWrites++;
+    if (d->writeBuffer.size() >= d->writeBatchSize) {
+        flushData();
+    } else if (!d->flushScheduled) {
+        d->flushScheduled = true;
+        QTimer::singleShot(d->writeBatchDelay, this, &QXmppStream::flushData);
+    }
+    return true;
+}
+
+///
+/// Writes all data buffered by write batching to the socket.
+///
+/// This needs to be called before the socket changes its mode, e.g. before
+/// starting the TLS encryption.
+///
+/// \since QXmpp 1.6
+///
+void QXmppStream::flushData()
+{
+    d->flushScheduled = false;
+    if (d->writeBuffer.isEmpty()) {
+        return;
+    }
+
+    const auto writes = d->bufferedWrites;
+    if (d->socket && d->socket->state() == QAbstractSocket::ConnectedState) {
+        d->write(d->writeBuffer);
+        if (writes > 1) {
+            QXmppMetrics::increment(QXmppMetrics::SavedWrites, quint64(writes - 1));
+            QXmppMetrics::increment(QXmppMetrics::CoalescedWriteBytes, quint64(d->writeBuffer.size()));
+        }
+    }
+    d->writeBuffer.clear();
+    d->bufferedWrites = 0;
+    d->updateBufferedBytes();
+}
+
+///
+/// Returns the maximum number of bytes buffered by write batching.
+///
+/// \since QXmpp 1.6
+///
+int QXmppStream::writeBatchSize() const
+{
+    return d->writeBatchSize;
+}
+
+///
+/// Sets the maximum number of bytes buffered by write batching.
+///
+/// With write batching, data sent in the same event loop iteration (or within
+/// writeBatchDelay()) is written to the socket at once. This results in fewer
+/// system calls and TLS records, e.g. for bursts of presences or roster pushes.
+/// The buffer is written as soon as it reaches the given size.
+///
+/// The default value is 0, which disables write batching.
+///
+/// \since QXmpp 1.6
+///
+void QXmppStream::setWriteBatchSize(int bytes)
+{
+    d->writeBatchSize = bytes;
+    if (bytes <= 0) {
+        flushData();
+    }
+}
+
+///
+/// Returns the maximum time in milliseconds data is buffered by write batching.
+///
+/// \since QXmpp 1.6
+///
+int QXmppStream::writeBatchDelay() const
+{
+    return d->writeBatchDelay;
+}
+
+///
+/// Sets the maximum time in milliseconds data is buffered by write batching.
+///
+/// The default value is 0, so only data sent in the same event loop iteration
+/// is combined.
+///
+/// \since QXmpp 1.6
+///
+void QXmppStream::setWriteBatchDelay(int msecs)
+{
+    d->writeBatchDelay = qMax(0, msecs);
+}
+
+///
+/// Returns the number of bytes waiting to be written from which on bulk
+/// stanzas are held back.
+///
+/// \since QXmpp 1.6
+///
+qint64 QXmppStream::bulkWriteThreshold() const
+{
+    return d->bulkWriteThreshold;
+}
+
+///
+/// Sets the number of bytes waiting to be written from which on bulk stanzas
+/// are held back.
+///
+/// Outgoing stanzas are sent in two lanes. Messages, presences and most IQs
+/// are written to the socket immediately. Bulk stanzas, i.e. the IQs of
+/// in-band bytestreams and archive queries as well as IQs of 16 KiB or more,
+/// wait while the socket and the write batch buffer more than the given
+/// number of bytes. This way, a message is not queued behind a transfer, but
+/// behind at most this number of bytes and the data buffered by the system.
+/// Bulk stanzas keep their order among each other.
+///
+/// Held back stanzas are passed to stream management when the connection is
+/// lost, so they are resent when the stream is resumed.
+///
+/// The default value is 0, which disables the bulk lane.
+///
+/// \since QXmpp 1.6
+///
+void QXmppStream::setBulkWriteThreshold(qint64 bytes)
+{
+    d->bulkWriteThreshold = std::max(bytes, qint64(0));
+    writeBulkPackets();
+}
+
+///
+/// Returns whether the stream is compressed using \xep{0138, Stream
+/// Compression}.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppStream::isCompressionEnabled() const
+{
+#ifdef WITH_ZLIB
+    return d->compressor != nullptr;
+#else
+    return false;
+#endif
+}
+
+///
+/// Returns whether QXmpp has been built with support for \xep{0138, Stream
+/// Compression}.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppStream::isCompressionSupported()
+{
+#ifdef WITH_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+///
+/// Compresses all following data of the connection using zlib, as negotiated
+/// by \xep{0138, Stream Compression}.
+///
+/// Buffered data is written uncompressed before, so this must be called
+/// directly after sending or receiving the \c <compressed/> element. The data
+/// is sync-flushed after every write, i.e. once per write batch if write
+/// batching is enabled. Compression ends with the connection.
+///
+/// Returns false if QXmpp has been built without zlib or the compression
+/// could not be initialized.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppStream::enableCompression()
+{
+#ifdef WITH_ZLIB
+    flushData();
+
+    auto compressor = std::make_unique<ZlibCompressor>();
+    auto decompressor = std::make_unique<ZlibDecompressor>();
+    if (!compressor->isValid() || !decompressor->isValid()) {
+        warning(QStringLiteral("Could not initialize the stream compression"));
+        return false;
+    }
+    d->compressor = std::move(compressor);
+    d->decompressor = std::move(decompressor);
+    return true;
+#else
+    return false;
+#endif
 }
 
 ///
@@ -164,7 +1022,7 @@ bool QXmppStream::sendPacket(const QXmppNonza &nonza)
 QXmppTask<QXmpp::SendResult> QXmppStream::send(QXmppNonza &&nonza)
 {
     bool success;
-    return send(QXmppPacket(nonza), success);
+    return send(std::as_const(nonza), success);
 }
 
 ///
@@ -180,16 +1038,90 @@ QXmppTask<QXmpp::SendResult> QXmppStream::send(QXmppPacket &&packet)
 
 QXmppTask<QXmpp::SendResult> QXmppStream::send(QXmppPacket &&packet, bool &writtenToSocket)
 {
+    QXMPP_TRACE_SPAN(span, "stream", "send");
+
+    auto task = packet.task();
+    if (d->holdsBack(packet.data(), packet.isXmppStanza())) {
+        d->bulkBytes += packet.data().size();
+        d->bulkPackets.push_back(std::move(packet));
+        writtenToSocket = true;
+        return task;
+    }
+
     // the writtenToSocket parameter is just for backwards compat (see
     // QXmppStream::sendPacket())
-    writtenToSocket = sendData(packet.data());
+    writtenToSocket = writePacket(packet);
+    return task;
+}
+
+QXmppTask<QXmpp::SendResult> QXmppStream::send(const QXmppNonza &nonza, bool &writtenToSocket)
+{
+    QXMPP_TRACE_SPAN(span, "stream", "send");
+
+    // The nonza is serialized into the buffer of the stream, which is only
+    // copied if stream management needs to keep the packet for resending.
+    // The buffer is taken while in use, so nonzas sent from slots connected
+    // to the logger get their own.
+    auto data = std::move(d->serializationBuffer);
+    serializeNonza(nonza, data);
+
+    const auto isXmppStanza = nonza.isXmppStanza();
+    if (d->holdsBack(data, isXmppStanza)) {
+        QXmppPacket packet(QByteArray(data.constData(), data.size()), true);
+        auto task = packet.task();
+        d->bulkBytes += data.size();
+        d->bulkPackets.push_back(std::move(packet));
+        writtenToSocket = true;
+
+        trimSerializationBuffer(data);
+        d->serializationBuffer = std::move(data);
+        return task;
+    }
 
-    // handle stream management
+    countSentPacket(d->counters, data, isXmppStanza);
+    QXmppPacket packet(d->streamManager.enabled() && isXmppStanza ? QByteArray(data.constData(), data.size()) : QByteArray(),
+                       isXmppStanza);
+
+    writtenToSocket = sendData(data);
     d->streamManager.handlePacketSent(packet, writtenToSocket);
 
+    trimSerializationBuffer(data);
+    d->serializationBuffer = std::move(data);
     return packet.task();
 }
 
+// Writes a packet and passes it to stream management.
+bool QXmppStream::writePacket(QXmppPacket &packet)
+{
+    const auto written = sendData(packet.data());
+    countSentPacket(d->counters, packet.data(), packet.isXmppStanza());
+    d->streamManager.handlePacketSent(packet, written);
+    return written;
+}
+
+// Writes the stanzas of the bulk lane while the socket has room for them.
+void QXmppStream::writeBulkPackets()
+{
+    while (!d->bulkPackets.empty() && d->socket &&
+           (d->bulkWriteThreshold <= 0 || d->pendingWriteBytes() < d->bulkWriteThreshold)) {
+        auto packet = std::move(d->bulkPackets.front());
+        d->bulkPackets.pop_front();
+        d->bulkBytes -= packet.data().size();
+        writePacket(packet);
+    }
+}
+
+// Passes the stanzas of the bulk lane to stream management without writing
+// them, so they are resent when the stream is resumed.
+void QXmppStream::releaseBulkPackets()
+{
+    auto packets = std::exchange(d->bulkPackets, {});
+    d->bulkBytes = 0;
+    for (auto &packet : packets) {
+        d->streamManager.handlePacketSent(packet, false);
+    }
+}
+
 ///
 /// Sends an IQ packet and returns the response asynchronously.
 ///
@@ -203,16 +1135,38 @@ QXmppTask<QXmppStream::IqResult> QXmppStream::sendIq(QXmppIq &&iq, const QString
 
     if (iq.id().isEmpty()) {
         warning(QStringLiteral("QXmppStream::sendIq() error: ID is empty. Using random ID."));
-        iq.setId(QXmppUtils::generateStanzaUuid());
+        iq.setId(QXmppUtils::generateStanzaId());
     }
-    if (d->runningIqs.contains(iq.id())) {
+    if (d->runningIqs.contains(iq.id()) || d->cancelledIqs.contains(iq.id())) {
         warning(QStringLiteral("QXmppStream::sendIq() error:"
                                "The IQ's ID (\"%1\") is already in use. Using random ID.")
                     .arg(iq.id()));
-        iq.setId(QXmppUtils::generateStanzaUuid());
+        iq.setId(QXmppUtils::generateStanzaId());
+    }
+
+    if (!d->iqCoalescingEnabled || iq.type() != QXmppIq::Get || to.isEmpty()) {
+        return sendIq(QXmppPacket(iq), iq.id(), to);
     }
 
-    return sendIq(QXmppPacket(iq), iq.id(), to);
+    QXmppPacket packet(iq);
+    auto key = iqCoalescingKey(packet.data(), iq.id(), to);
+    if (const auto itr = d->runningIqs.find(d->coalescedIqs.value(key)); itr != d->runningIqs.end()) {
+        QXmppPromise<IqResult> promise;
+        promise.onCancelled([this, id = itr.key()]() {
+            d->cancelIq(id);
+        });
+        auto task = promise.task();
+        itr->coalescedRequests.push_back(std::move(promise));
+        QXmppMetrics::increment(QXmppMetrics::CoalescedIqs);
+        return task;
+    }
+
+    auto task = sendIq(std::move(packet), iq.id(), to);
+    if (const auto itr = d->runningIqs.find(iq.id()); itr != d->runningIqs.end()) {
+        itr->coalescingKey = key;
+        d->coalescedIqs.insert(key, iq.id());
+    }
+    return task;
 }
 
 ///
@@ -226,7 +1180,7 @@ QXmppTask<QXmppStream::IqResult> QXmppStream::sendIq(QXmppPacket &&packet, const
 {
     using namespace QXmpp;
 
-    if (id.isEmpty() || d->runningIqs.contains(id)) {
+    if (id.isEmpty() || d->runningIqs.contains(id) || d->cancelledIqs.contains(id)) {
         return makeReadyTask<IqResult>(QXmppError {
             QStringLiteral("Invalid IQ id: empty or in use."),
             SendError::Disconnected });
@@ -238,6 +1192,7 @@ QXmppTask<QXmppStream::IqResult> QXmppStream::sendIq(QXmppPacket &&packet, const
             SendError::Disconnected });
     }
 
+    auto payloadNamespace = iqPayloadNamespace(packet.data());
     auto sendFuture = send(std::move(packet));
     if (sendFuture.isFinished()) {
         if (std::holds_alternative<QXmppError>(sendFuture.result())) {
@@ -248,16 +1203,25 @@ QXmppTask<QXmppStream::IqResult> QXmppStream::sendIq(QXmppPacket &&packet, const
         sendFuture.then(this, [this, id](SendResult result) {
             if (std::holds_alternative<QXmppError>(result)) {
                 if (auto itr = d->runningIqs.find(id); itr != d->runningIqs.end()) {
-                    itr.value().interface.finish(std::get<QXmppError>(result));
-                    d->runningIqs.erase(itr);
+                    d->finishIq(itr, std::get<QXmppError>(std::move(result)));
                 }
             }
         });
     }
 
     IqState state { {}, to };
+    state.interface.onCancelled([this, id]() {
+        d->cancelIq(id);
+    });
+    state.payloadNamespace = std::move(payloadNamespace);
+    state.sent.start();
+    if (d->iqTimeout > 0) {
+        state.deadline = QDeadlineTimer(d->iqTimeout);
+        d->scheduleIqTimeout(id, d->iqTimeout);
+    }
     auto task = state.interface.task();
     d->runningIqs.insert(id, std::move(state));
+    QXmppMetrics::addToGauge(QXmppMetrics::PendingIqs, 1);
     return task;
 }
 
@@ -268,12 +1232,277 @@ QXmppTask<QXmppStream::IqResult> QXmppStream::sendIq(QXmppPacket &&packet, const
 ///
 void QXmppStream::cancelOngoingIqs()
 {
-    for (auto &state : d->runningIqs) {
-        state.interface.finish(QXmppError {
-            QStringLiteral("IQ has been cancelled."),
-            QXmpp::SendError::Disconnected });
-    }
+    auto runningIqs = std::move(d->runningIqs);
     d->runningIqs.clear();
+    QXmppMetrics::addToGauge(QXmppMetrics::PendingIqs, -qint64(runningIqs.size()));
+    d->coalescedIqs.clear();
+    d->cancelledIqs.clear();
+    for (auto &ids : d->iqTimeoutSlots) {
+        ids.clear();
+    }
+    d->scheduledIqTimeouts = 0;
+    if (d->iqTimeoutTimer) {
+        d->iqTimeoutTimer->stop();
+    }
+
+    for (auto &state : runningIqs) {
+        finishIq(state, QXmppError {
+                            QStringLiteral("IQ has been cancelled."),
+                            QXmpp::SendError::Disconnected });
+    }
+}
+
+///
+/// Returns the maximum number of stanzas per second read from the socket.
+///
+/// \since QXmpp 1.6
+///
+double QXmppStream::receiveStanzaRateLimit() const
+{
+    return d->receivedStanzaBucket.rate();
+}
+
+///
+/// Returns the maximum number of bytes per second read from the socket.
+///
+/// \since QXmpp 1.6
+///
+qint64 QXmppStream::receiveByteRateLimit() const
+{
+    return qint64(d->receivedByteBucket.rate());
+}
+
+///
+/// Limits the rate of incoming data.
+///
+/// The limits are enforced by token buckets that allow bursts of one second.
+/// When the budget is exhausted, the stream stops reading from the socket
+/// until it has been refilled. The data is not buffered without bounds: once
+/// the read buffer of the socket is full, the peer is slowed down by TCP flow
+/// control.
+///
+/// Every pause increments the counter "stream.read.throttled" and adds its
+/// duration to the counter "stream.read.throttled-msecs".
+///
+/// \param stanzasPerSecond maximum number of stanzas per second, 0 for no limit
+/// \param bytesPerSecond maximum number of bytes per second, 0 for no limit
+///
+/// \since QXmpp 1.6
+///
+void QXmppStream::setReceiveRateLimit(double stanzasPerSecond, qint64 bytesPerSecond)
+{
+    d->receivedStanzaBucket.setRate(stanzasPerSecond, std::max(stanzasPerSecond, 1.0));
+    d->receivedByteBucket.setRate(double(bytesPerSecond), double(bytesPerSecond));
+    d->rateLimitClock.start();
+
+    if (!d->resumeReadingTimer) {
+        d->resumeReadingTimer = new QTimer(this);
+        d->resumeReadingTimer->setSingleShot(true);
+        connect(d->resumeReadingTimer, &QTimer::timeout, this, [this]() {
+            d->readingPaused = false;
+            if (d->socket) {
+                _q_socketReadyRead();
+            }
+        });
+    }
+
+    const bool enabled = d->receivedStanzaBucket.isEnabled() || d->receivedByteBucket.isEnabled();
+    d->applyReadBufferSize();
+    if (!enabled && d->readingPaused) {
+        d->resumeReadingTimer->stop();
+        d->readingPaused = false;
+        if (d->socket) {
+            QMetaObject::invokeMethod(this, &QXmppStream::_q_socketReadyRead, Qt::QueuedConnection);
+        }
+    }
+}
+
+///
+/// Returns the maximum size of received stanzas in bytes.
+///
+/// \since QXmpp 1.6
+///
+qint64 QXmppStream::maximumStanzaSize() const
+{
+    return d->maximumStanzaSize;
+}
+
+///
+/// Sets the maximum size of received stanzas in bytes.
+///
+/// A stanza exceeding the limit closes the stream with a
+/// \c <policy-violation/> stream error as soon as the limit is reached. Data
+/// of incomplete stanzas is never buffered beyond the limit (plus the size of
+/// one read from the socket), so the memory used per stream is bounded.
+///
+/// Independent of this setting, malformed XML closes the stream with
+/// \c <not-well-formed/> and XML features forbidden by RFC 6120 (DTDs,
+/// entity references and processing instructions) close it with
+/// \c <restricted-xml/> immediately.
+///
+/// The default value is 0, which means no limit.
+///
+/// \since QXmpp 1.6
+///
+void QXmppStream::setMaximumStanzaSize(qint64 bytes)
+{
+    d->maximumStanzaSize = bytes;
+}
+
+///
+/// Returns the maximum number of bytes buffered by the socket.
+///
+/// \since QXmpp 1.6
+///
+qint64 QXmppStream::readBufferSize() const
+{
+    return d->readBufferSize;
+}
+
+///
+/// Limits the size of the socket's read buffer in bytes.
+///
+/// The received data is read from the socket completely in each read cycle,
+/// so the buffer only fills up while the stream is busy. When it is full, the
+/// data stays in the operating system's buffers and the peer is slowed down by
+/// TCP flow control instead of the buffer growing. With a receive rate limit,
+/// the buffer is limited to 64 KiB anyway.
+///
+/// The default value is 0, which means no limit.
+///
+/// \since QXmpp 1.6
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+void QXmppStream::setReadBufferSize(qint64 bytes)
+{
+    d->readBufferSize = std::max(bytes, qint64(0));
+    d->applyReadBufferSize();
+}
+
+///
+/// Releases the memory the stream keeps for reuse.
+///
+/// The buffers for serializing packets and the queue of unacknowledged
+/// stanzas (\xep{0198}) keep their capacity, so active streams don't need
+/// to allocate for every packet. For streams that are idle most of the time,
+/// e.g. on servers with many connections, this memory can be released.
+/// QXmppIncomingClient does so after 30 seconds without received data.
+///
+/// \since QXmpp 1.6
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+void QXmppStream::squeeze()
+{
+    // the buffer is empty while it is in use
+    d->serializationBuffer = QByteArray();
+    d->streamManager.squeeze();
+    d->updateBufferedBytes();
+}
+
+///
+/// Returns whether the received data is parsed in a worker thread.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppStream::isBackgroundParsingEnabled() const
+{
+    return d->backgroundParsingEnabled;
+}
+
+///
+/// Sets whether the received data is parsed in a worker thread.
+///
+/// With background parsing, the XML of the stream is parsed and the DOM of
+/// the received stanzas is created in a dedicated thread of the stream. The
+/// parsed stanzas of each read are handed back to the thread of the stream in
+/// one batch and handled there as usual. This keeps large results, e.g. pages
+/// of a message archive, from blocking the thread of the stream (usually the
+/// GUI thread) for long.
+///
+/// The socket, TLS and the decompression stay in the thread of the stream.
+/// The stanza rate limit (see setReceiveRateLimit()) is applied when the
+/// stanzas are handled, so it may lag behind by one read.
+///
+/// The setting takes effect when the stream is (re)started. It is disabled by
+/// default.
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+void QXmppStream::setBackgroundParsingEnabled(bool enabled)
+{
+    d->backgroundParsingEnabled = enabled;
+}
+
+///
+/// Returns whether identical IQ get requests share one request.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppStream::isIqCoalescingEnabled() const
+{
+    return d->iqCoalescingEnabled;
+}
+
+///
+/// Sets whether identical IQ get requests share one request.
+///
+/// If enabled, a get request sent by sendIq() while an identical request to
+/// the same recipient is still waiting for its response is not sent again.
+/// Both requests are finished with the same response. Requests are identical
+/// if they only differ in their IDs.
+///
+/// This is disabled by default.
+///
+/// \since QXmpp 1.6
+///
+void QXmppStream::setIqCoalescingEnabled(bool enabled)
+{
+    d->iqCoalescingEnabled = enabled;
+}
+
+///
+/// Returns the time in milliseconds after which IQ requests without a
+/// response fail.
+///
+/// \since QXmpp 1.6
+///
+int QXmppStream::iqTimeout() const
+{
+    return d->iqTimeout;
+}
+
+///
+/// Sets the time in milliseconds after which IQ requests sent by sendIq()
+/// without a response fail with QXmpp::SendError::Timeout.
+///
+/// All requests are expired by a single timer, so they may fail up to one
+/// second later than the timeout. The timeout only applies to requests sent
+/// after it has been set.
+///
+/// The default value is 0, which means requests wait for their response
+/// until the stream is closed.
+///
+/// \since QXmpp 1.6
+///
+void QXmppStream::setIqTimeout(int msecs)
+{
+    d->iqTimeout = std::max(msecs, 0);
+    if (d->iqTimeout == 0) {
+        return;
+    }
+
+    if (!d->iqTimeoutTimer) {
+        d->iqTimeoutTimer = new QTimer(this);
+        connect(d->iqTimeoutTimer, &QTimer::timeout, this, [this]() {
+            d->handleIqTimeoutTick();
+        });
+    }
+    // a finer resolution for short timeouts
+    d->iqTimeoutTimer->setInterval(std::clamp(d->iqTimeout / 8, 10, 1000));
 }
 
 ///
@@ -313,6 +1542,7 @@ QSslSocket *QXmppStream::socket() const
 void QXmppStream::setSocket(QSslSocket *socket)
 {
     d->socket = socket;
+    d->resetCompression();
     if (!d->socket) {
         return;
     }
@@ -322,10 +1552,23 @@ void QXmppStream::setSocket(QSslSocket *socket)
     connect(socket, &QSslSocket::encrypted, this, &QXmppStream::_q_socketEncrypted);
     connect(socket, &QSslSocket::errorOccurred, this, &QXmppStream::_q_socketError);
     connect(socket, &QIODevice::readyRead, this, &QXmppStream::_q_socketReadyRead);
+    connect(socket, &QIODevice::bytesWritten, this, &QXmppStream::writeBulkPackets);
+    connect(socket, &QSslSocket::encryptedBytesWritten, this, &QXmppStream::writeBulkPackets);
+
+    d->applyReadBufferSize();
 }
 
 void QXmppStream::_q_socketConnected()
 {
+    // drop data buffered for a previous connection
+    d->writeBuffer.clear();
+    d->bufferedWrites = 0;
+    d->readingPaused = false;
+    if (d->resumeReadingTimer) {
+        d->resumeReadingTimer->stop();
+    }
+    d->resetCompression();
+
     info(QStringLiteral("Socket connected to %1 %2").arg(d->socket->peerAddress().toString(), QString::number(d->socket->peerPort())));
     handleStart();
 }
@@ -344,129 +1587,203 @@ void QXmppStream::_q_socketError(QAbstractSocket::SocketError socketError)
 
 void QXmppStream::_q_socketReadyRead()
 {
-    processData(QString::fromUtf8(d->socket->readAll()));
-}
+    QXMPP_TRACE_SPAN(span, "stream", "read");
 
-void QXmppStream::processData(const QString &data)
-{
-    // As we may only have partial XML content, we need to cache the received
-    // data until it has been successfully parsed. In case it can't be parsed,
-    //
-    // There are only two small problems with the current strategy:
-    //  * When we receive a full stanza + a partial one, we can't parse the
-    //    first stanza until another stanza arrives that is complete.
-    //  * We don't know when we received invalid XML (would cause a growing
-    //    cache and a timeout after some time).
-    // However, both issues could only be solved using an XML stream reader
-    // which would cause many other problems since we don't actually use it for
-    // parsing the content.
-    d->dataBuffer.append(data);
+    if (!d->receivedStanzaBucket.isEnabled() && !d->receivedByteBucket.isEnabled()) {
+        processReceivedData(d->socket->readAll());
+        d->updateBufferedBytes();
+        return;
+    }
 
-    //
-    // Check for whitespace pings
-    //
-    if (d->dataBuffer.isEmpty() || d->dataBuffer.trimmed().isEmpty()) {
-        d->dataBuffer.clear();
+    if (d->readingPaused) {
+        // the data stays in the socket until the budget has been refilled
+        return;
+    }
 
-        logReceived({});
-        handleStanza({});
+    while (d->socket && d->socket->state() == QAbstractSocket::ConnectedState && d->socket->bytesAvailable() > 0) {
+        const auto elapsed = d->rateLimitClock.restart();
+        d->receivedStanzaBucket.refill(elapsed);
+        d->receivedByteBucket.refill(elapsed);
+
+        auto maxSize = d->socket->bytesAvailable();
+        if (d->receivedByteBucket.isEnabled()) {
+            maxSize = std::min(maxSize, std::max(qint64(d->receivedByteBucket.available()), qint64(1)));
+        }
+
+        const auto data = d->socket->read(maxSize);
+        const auto stanzaCount = d->receivedStanzas;
+        processReceivedData(data);
+        d->receivedByteBucket.consume(double(data.size()));
+        d->receivedStanzaBucket.consume(double(d->receivedStanzas - stanzaCount));
+
+        const auto delay = std::max(d->receivedStanzaBucket.msecsUntilAvailable(),
+                                    d->receivedByteBucket.msecsUntilAvailable());
+        if (delay > 0) {
+            d->readingPaused = true;
+            d->resumeReadingTimer->start(int(delay));
+            QXmppMetrics::increment(QXmppMetrics::ThrottledReads);
+            QXmppMetrics::increment(QXmppMetrics::ThrottledReadMilliseconds, quint64(delay));
+            break;
+        }
+    }
+    d->updateBufferedBytes();
+}
+
+// Decompresses the data received from the socket, if needed.
+void QXmppStream::processReceivedData(const QByteArray &data)
+{
+#ifdef WITH_ZLIB
+    if (d->decompressor) {
+        d->decompressor->addData(data);
+
+        // the handlers may reset the stream
+        while (d->decompressor && !d->receiveFailed) {
+            const auto output = d->decompressor->read(DECOMPRESSION_CHUNK_SIZE);
+            if (!output) {
+                closeWithStreamError(QStringLiteral("undefined-condition"), QStringLiteral("Received invalid compressed data."));
+                return;
+            }
+            if (output->isEmpty()) {
+                return;
+            }
+            processData(*output);
+        }
         return;
     }
+#endif
+    processData(data);
+}
 
-    //
-    // Check whether we received a stream open or closing tag
-    //
-    static const QRegularExpression streamStartRegex(R"(^(<\?xml.*\?>)?\s*<stream:stream[^>]*>)");
-    static const QRegularExpression streamEndRegex("</stream:stream>$");
-
-    QRegularExpressionMatch streamOpenMatch;
-    bool hasStreamOpen = d->streamOpenElement.isEmpty() &&
-        (streamOpenMatch = streamStartRegex.match(d->dataBuffer)).hasMatch();
-
-    bool hasStreamClose = streamEndRegex.match(d->dataBuffer).hasMatch();
-
-    //
-    // The stream start/end and stanza packets can't be parsed without any
-    // modifications with QDomDocument. This is because of multiple reasons:
-    //  * The <stream:stream> open element is not considered valid without the
-    //    closing tag.
-    //  * Only the closing tag is of course not valid too.
-    //  * Stanzas/Nonzas need to have the correct stream namespaces set:
-    //     * For being able to parse <stream:features/>
-    //     * For having the correct namespace (e.g. 'jabber:client') set to
-    //       stanzas and their child elements (e.g. <body/> of a message).
-    //
-    // The wrapping strategy looks like this:
-    //  * The stream open tag is cached once it arrives, for later access
-    //  * Incoming XML that has no <stream> open tag will be prepended by the
-    //    cached <stream> tag.
-    //  * Incoming XML that has no <stream> close tag will be appended by a
-    //    generic string "</stream:stream>"
-    //
-    // The result is parsed by QDomDocument and the child elements of the stream
-    // are processed. In case the received data contained a stream open tag,
-    // the stream is processed (before the stanzas are processed). In case we
-    // received a </stream> closing tag, the connection is closed.
-    //
-    auto wrappedStanzas = d->dataBuffer;
-    if (!hasStreamOpen) {
-        wrappedStanzas.prepend(d->streamOpenElement);
-    }
-    if (!hasStreamClose) {
-        wrappedStanzas.append(QStringLiteral("</stream:stream>"));
-    }
-
-    //
-    // Try to parse the wrapped XML
-    //
-    QDomDocument doc;
-    if (!doc.setContent(wrappedStanzas, true)) {
+void QXmppStream::processData(const QByteArray &data)
+{
+    if (d->receiveFailed) {
         return;
     }
 
-    //
-    // Success: We can clear the buffer and send a 'received' log message
-    //
-    logReceived(d->dataBuffer);
-    d->dataBuffer.clear();
+    add(d->counters.bytesReceived, quint64(data.size()));
+    d->counters.lastActivity.store(QDateTime::currentMSecsSinceEpoch(), std::memory_order_relaxed);
 
-    // process stream start
-    if (hasStreamOpen) {
-        d->streamOpenElement = streamOpenMatch.captured();
-        handleStream(doc.documentElement());
+    // the data is only converted to UTF-16 if it is logged, whitespace pings
+    // are logged when they are handled
+    if (isLoggingEnabled(QXmppLogger::ReceivedMessage) && !data.trimmed().isEmpty()) {
+        logReceived(QString::fromUtf8(data));
     }
 
-    // process stanzas
-    auto stanza = doc.documentElement().firstChildElement();
-    for (; !stanza.isNull(); stanza = stanza.nextSiblingElement()) {
-        // handle possible stream management packets first
-        if (d->streamManager.handleStanza(stanza) || handleIqResponse(stanza)) {
-            continue;
+    if (!d->backgroundParser) {
+        d->parser.parse(data, d->maximumStanzaSize, [this](StreamEvent &&event) {
+            handleStreamEvent(std::move(event));
+        });
+        return;
+    }
+
+    const auto parse = [this, parser = d->backgroundParser.get(), data, maximumStanzaSize = d->maximumStanzaSize, generation = d->parserGeneration]() {
+        // runs in the worker thread
+        std::vector<StreamEvent> events;
+        parser->parser.parse(data, maximumStanzaSize, [&events](StreamEvent &&event) {
+            if (event.type == StreamEvent::Stanza) {
+                const auto tagName = event.stanza.tagName();
+                if (tagName == u"message" || tagName == u"presence" || tagName == u"iq") {
+                    // cached by the view
+                    event.stanza.toDomElement();
+                }
+            }
+            events.push_back(std::move(event));
+        });
+        if (events.empty()) {
+            return;
         }
 
-        // process all other kinds of packets
-        handleStanza(stanza);
-    }
+        QMetaObject::invokeMethod(
+            this, [this, events = std::move(events), generation]() mutable {
+                for (auto &event : events) {
+                    // the handlers may restart or close the stream
+                    if (generation != d->parserGeneration || d->receiveFailed) {
+                        return;
+                    }
+                    handleStreamEvent(std::move(event));
+                }
+            },
+            Qt::QueuedConnection);
+    };
+    QMetaObject::invokeMethod(d->backgroundParser->context, parse, Qt::QueuedConnection);
+}
 
-    // process stream end
-    if (hasStreamClose) {
+void QXmppStream::handleStreamEvent(StreamEvent &&event)
+{
+    switch (event.type) {
+    case StreamEvent::StreamStart:
+        d->depth = 1;
+        handleStream(event.streamElement);
+        break;
+    case StreamEvent::StreamEnd:
+        d->depth = 0;
         disconnectFromHost();
+        break;
+    case StreamEvent::Stanza: {
+        d->receivedStanzas++;
+        QXmppMetrics::observe(QXmppMetrics::StanzaParseTime, event.parseTime);
+        add(d->counters.parseTime, quint64(event.parseTime));
+        countReceivedStanza(d->counters, event.stanza);
+
+        // the stanza has been parsed right before, possibly in the background parser
+        QXMPP_TRACE_RECORD("stream", "parse", event.parseTime, event.stanza.attribute(u"id").toString(), event.stanza.tagName().toString());
+        QXMPP_TRACE_SPAN(span, "stream", "dispatch");
+        QXMPP_TRACE_STANZA(span, event.stanza.attribute(u"id").toString(), event.stanza.tagName().toString());
+
+        // handle possible stream management packets first
+        if (!d->streamManager.handleStanza(event.stanza) && !handleIqResponse(event.stanza)) {
+            // process all other kinds of packets
+            handleStanza(event.stanza);
+        }
+        break;
+    }
+    case StreamEvent::WhitespacePing:
+        logReceived({});
+        handleStanza(QDomElement());
+        break;
+    case StreamEvent::Error:
+        closeWithStreamError(event.condition, event.text);
+        break;
+    }
+}
+
+void QXmppStream::closeWithStreamError(const QString &condition, const QString &text)
+{
+    warning(text);
+    d->receiveFailed = true;
+    d->parser.stop();
+
+    // stream errors can only be sent inside an open stream
+    if (d->depth > 0) {
+        sendData(QStringLiteral("<stream:error><%1 xmlns='%2'/><text xmlns='%2'>%3</text></stream:error>")
+                     .arg(condition, QStringLiteral("urn:ietf:params:xml:ns:xmpp-streams"), text.toHtmlEscaped())
+                     .toUtf8());
     }
+    disconnectFromHost();
 }
 
-bool QXmppStream::handleIqResponse(const QDomElement &stanza)
+bool QXmppStream::handleIqResponse(const QXmppStanzaView &stanza)
 {
-    if (stanza.tagName() != QStringLiteral("iq")) {
+    if (stanza.tagName() != u"iq") {
         return false;
     }
 
     // only accept "result" and "error" types
-    const auto iqType = stanza.attribute(QStringLiteral("type"));
-    if (iqType != QStringLiteral("result") && iqType != QStringLiteral("error")) {
+    const auto iqType = stanza.attribute(u"type");
+    if (iqType != u"result" && iqType != u"error") {
+        return false;
+    }
+
+    const auto id = stanza.attribute(u"id").toString();
+    if (auto itr = d->cancelledIqs.find(id); itr != d->cancelledIqs.end()) {
+        // nobody is waiting for the response anymore
+        if (const auto from = stanza.attribute(u"from"); from.isEmpty() || from == itr.value()) {
+            d->cancelledIqs.erase(itr);
+            return true;
+        }
         return false;
     }
 
-    const auto id = stanza.attribute(QStringLiteral("id"));
     if (auto itr = d->runningIqs.find(id);
         itr != d->runningIqs.end()) {
         const auto expectedFrom = itr.value().jid;
@@ -475,15 +1792,14 @@ bool QXmppStream::handleIqResponse(const QDomElement &stanza)
         // attribute or have it set to the user's bare JID.
         // If 'from' is empty, the IQ has been sent by the server. In this case we don't need to
         // do the check as we trust the server anyways.
-        if (const auto from = stanza.attribute("from"); !from.isEmpty() && from != expectedFrom) {
+        if (const auto from = stanza.attribute(u"from"); !from.isEmpty() && from != expectedFrom) {
             warning(QStringLiteral("Ignored received IQ response to request '%1' because of wrong sender '%2' instead of expected sender '%3'")
-                        .arg(id, from, expectedFrom));
+                        .arg(id, from.toString(), expectedFrom));
             return false;
         }
 
-        itr.value().interface.finish(stanza);
-
-        d->runningIqs.erase(itr);
+        QXmppMetrics::observe(QXmppMetrics::IqRoundTripTime, itr->payloadNamespace, itr->sent.nsecsElapsed());
+        d->finishIq(itr, stanza.toDomElement());
         return true;
     }
 
@@ -503,6 +1819,19 @@ void QXmppStream::enableStreamManagement(bool resetSequenceNumber)
     d->streamManager.enableStreamManagement(resetSequenceNumber);
 }
 
+///
+/// Returns whether Stream Management acks / reqs are enabled (\xep{0198}).
+///
+/// Stream management is disabled when the stream is closed or restarted, or
+/// when the queue limit is exceeded and the stream is disconnected.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppStream::isStreamManagementEnabled() const
+{
+    return d->streamManager.enabled();
+}
+
 ///
 /// Returns the sequence number of the last incoming stanza (\xep{0198}).
 ///
@@ -523,3 +1852,99 @@ void QXmppStream::setAcknowledgedSequenceNumber(unsigned int sequenceNumber)
 {
     d->streamManager.setAcknowledgedSequenceNumber(sequenceNumber);
 }
+
+///
+/// Writes the sequence numbers and the unacknowledged stanzas (\xep{0198}),
+/// so the stream can be resumed by another process.
+///
+/// \since QXmpp 1.6
+///
+void QXmppStream::saveStreamManagementState(QDataStream &stream) const
+{
+    d->streamManager.saveState(stream);
+}
+
+///
+/// Restores the state written by saveStreamManagementState() (\xep{0198}).
+///
+/// The restored stanzas are sent again if the stream can't be resumed.
+///
+/// \return false if the state could not be read, the current state is kept
+///
+/// \since QXmpp 1.6
+///
+bool QXmppStream::restoreStreamManagementState(QDataStream &stream)
+{
+    return d->streamManager.restoreState(stream);
+}
+
+///
+/// Limits the size of the stanzas waiting for an acknowledgement (\xep{0198}).
+///
+/// If the limit is exceeded, either the oldest stanzas are dropped from the
+/// queue or the stream is closed. A limit of 0 means no limit.
+///
+/// \since QXmpp 1.6
+///
+void QXmppStream::setStreamManagementQueueLimit(qint64 bytes, bool disconnectOnOverflow)
+{
+    d->streamManager.setQueueLimit(bytes, disconnectOnOverflow);
+}
+
+///
+/// Returns the traffic counters of the stream.
+///
+/// The counters are updated in the thread of the stream, but this function
+/// can be called from any thread. The values are read one by one, so they
+/// may not be consistent with each other while data is processed.
+///
+/// \since QXmpp 1.6
+///
+QXmppStreamStatistics QXmppStream::statistics() const
+{
+    const auto &counters = d->counters;
+    const auto load = [](const auto &counter) {
+        return counter.load(std::memory_order_relaxed);
+    };
+
+    QXmppStreamStatistics statistics;
+    statistics.bytesReceived = load(counters.bytesReceived);
+    statistics.bytesSent = load(counters.bytesSent);
+    statistics.receivedMessages = load(counters.receivedMessages);
+    statistics.receivedPresences = load(counters.receivedPresences);
+    statistics.receivedIqs = load(counters.receivedIqs);
+    statistics.receivedNonzas = load(counters.receivedNonzas);
+    statistics.sentMessages = load(counters.sentMessages);
+    statistics.sentPresences = load(counters.sentPresences);
+    statistics.sentIqs = load(counters.sentIqs);
+    statistics.sentNonzas = load(counters.sentNonzas);
+    statistics.parseTime = load(counters.parseTime);
+    statistics.streamManagementQueuedStanzas = d->streamManager.reportedStanzaCount();
+    statistics.streamManagementQueuedBytes = d->streamManager.reportedBytes();
+    statistics.lastActivity = load(counters.lastActivity);
+    statistics.bufferedBytes = load(counters.bufferedBytes);
+    return statistics;
+}
+
+///
+/// Returns the policy for requesting and sending acknowledgements
+/// (\xep{0198}).
+///
+/// \since QXmpp 1.6
+///
+QXmppStreamManagementPolicy QXmppStream::streamManagementPolicy() const
+{
+    return d->streamManager.policy();
+}
+
+///
+/// Sets the policy for requesting and sending acknowledgements (\xep{0198}).
+///
+/// The policy is used as soon as stream management is enabled on the stream.
+///
+/// \since QXmpp 1.6
+///
+void QXmppStream::setStreamManagementPolicy(const QXmppStreamManagementPolicy &policy)
+{
+    d->streamManager.setPolicy(policy);
+}
@@ -15,6 +15,7 @@
 #include <QAbstractSocket>
 #include <QObject>
 
+class QDataStream;
 class QDomElement;
 template<typename T>
 class QXmppTask;
@@ -27,9 +28,61 @@ class QXmppIq;
 class QXmppNonza;
 class QXmppPacket;
 class QXmppStanza;
+class QXmppStanzaView;
+class QXmppStreamManagementPolicy;
 class QXmppStreamPrivate;
 
+namespace QXmpp::Private {
+struct StreamEvent;
+}
+
+///
+///
+/// \brief The QXmppStreamStatistics struct contains the traffic counters of
+/// a stream.
 ///
+/// \since QXmpp 1.6
+///
+struct QXmppStreamStatistics
+{
+    /// Bytes received from the socket
+    quint64 bytesReceived = 0;
+    /// Bytes written to the socket
+    quint64 bytesSent = 0;
+    /// Received message stanzas
+    quint64 receivedMessages = 0;
+    /// Received presence stanzas
+    quint64 receivedPresences = 0;
+    /// Received IQ stanzas
+    quint64 receivedIqs = 0;
+    /// Received top-level elements that are not stanzas
+    quint64 receivedNonzas = 0;
+    /// Sent message stanzas
+    quint64 sentMessages = 0;
+    /// Sent presence stanzas
+    quint64 sentPresences = 0;
+    /// Sent IQ stanzas
+    quint64 sentIqs = 0;
+    /// Sent top-level elements that are not stanzas
+    quint64 sentNonzas = 0;
+    /// Time spent parsing received top-level elements in nanoseconds
+    quint64 parseTime = 0;
+    /// Stanzas waiting for a \xep{0198, Stream Management} acknowledgement
+    qint64 streamManagementQueuedStanzas = 0;
+    /// Bytes waiting for a \xep{0198, Stream Management} acknowledgement
+    qint64 streamManagementQueuedBytes = 0;
+    /// Time of the last data sent or received in milliseconds since the
+    /// epoch, 0 if there has been none
+    qint64 lastActivity = 0;
+    /// Bytes allocated by the buffers of the stream and the data buffered by
+    /// its socket, without the stanzas waiting for an acknowledgement, as of
+    /// the last read or write
+    qint64 bufferedBytes = 0;
+
+    /// Returns the number of bytes received and sent.
+    quint64 totalBytes() const { return bytesReceived + bytesSent; }
+};
+
 /// \brief The QXmppStream class is the base class for all XMPP streams.
 ///
 class QXMPP_EXPORT QXmppStream : public QXmppLoggable
@@ -54,6 +107,42 @@ public:
 
     void resetPacketCache();
 
+    double receiveStanzaRateLimit() const;
+    qint64 receiveByteRateLimit() const;
+    void setReceiveRateLimit(double stanzasPerSecond, qint64 bytesPerSecond);
+
+    qint64 maximumStanzaSize() const;
+    void setMaximumStanzaSize(qint64 bytes);
+
+    qint64 readBufferSize() const;
+    void setReadBufferSize(qint64 bytes);
+    void squeeze();
+
+    bool isBackgroundParsingEnabled() const;
+    void setBackgroundParsingEnabled(bool enabled);
+
+    bool isIqCoalescingEnabled() const;
+    void setIqCoalescingEnabled(bool enabled);
+
+    int iqTimeout() const;
+    void setIqTimeout(int msecs);
+
+    int writeBatchSize() const;
+    void setWriteBatchSize(int bytes);
+    int writeBatchDelay() const;
+    void setWriteBatchDelay(int msecs);
+
+    qint64 bulkWriteThreshold() const;
+    void setBulkWriteThreshold(qint64 bytes);
+
+    bool isCompressionEnabled() const;
+    static bool isCompressionSupported();
+
+    QXmppStreamManagementPolicy streamManagementPolicy() const;
+    void setStreamManagementPolicy(const QXmppStreamManagementPolicy &policy);
+
+    QXmppStreamStatistics statistics() const;
+
 Q_SIGNALS:
     /// This signal is emitted when the stream is connected.
     void connected();
@@ -73,6 +162,7 @@ protected:
     ///
     /// \param element
     virtual void handleStanza(const QDomElement &element) = 0;
+    virtual void handleStanza(const QXmppStanzaView &stanza);
 
     /// Handles an incoming XMPP stream start.
     ///
@@ -81,12 +171,20 @@ protected:
 
     // XEP-0198: Stream Management
     void enableStreamManagement(bool resetSequenceNumber);
+    bool isStreamManagementEnabled() const;
     unsigned int lastIncomingSequenceNumber() const;
     void setAcknowledgedSequenceNumber(unsigned int sequenceNumber);
+    void setStreamManagementQueueLimit(qint64 bytes, bool disconnectOnOverflow);
+    void saveStreamManagementState(QDataStream &stream) const;
+    bool restoreStreamManagementState(QDataStream &stream);
+
+    // XEP-0138: Stream Compression
+    bool enableCompression();
 
 public Q_SLOTS:
     virtual void disconnectFromHost();
     virtual bool sendData(const QByteArray &);
+    void flushData();
 
 private Q_SLOTS:
     void _q_socketConnected();
@@ -95,13 +193,22 @@ private Q_SLOTS:
     void _q_socketReadyRead();
 
 private:
+    void closeWithStreamError(const QString &condition, const QString &text);
+
     friend class QXmppStreamManager;
     friend class tst_QXmppStream;
+    friend class tst_Receive;
     friend class TestClient;
 
     QXmppTask<QXmpp::SendResult> send(QXmppPacket &&, bool &);
-    void processData(const QString &data);
-    bool handleIqResponse(const QDomElement &);
+    QXmppTask<QXmpp::SendResult> send(const QXmppNonza &, bool &);
+    bool writePacket(QXmppPacket &packet);
+    void writeBulkPackets();
+    void releaseBulkPackets();
+    void processReceivedData(const QByteArray &data);
+    void processData(const QByteArray &data);
+    void handleStreamEvent(QXmpp::Private::StreamEvent &&event);
+    bool handleIqResponse(const QXmppStanzaView &);
 
     QXmppStreamPrivate *const d;
 };
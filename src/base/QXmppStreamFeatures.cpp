@@ -24,6 +24,16 @@ public:
     bool rosterVersioningSupported;
     QStringList authMechanisms;
     QStringList compressionMethods;
+
+    // XEP-0388: Extensible SASL Profile and its inline features
+    QStringList sasl2Mechanisms;
+    bool sasl2StreamResumptionSupported = false;
+    bool bind2Supported = false;
+    QStringList bind2InlineFeatures;
+    QStringList fastMechanisms;
+
+    // XEP-0288: Bidirectional Server-to-Server Connections
+    bool bidirectionalStreamsSupported = false;
 };
 
 QXmppStreamFeaturesPrivate::QXmppStreamFeaturesPrivate()
@@ -257,6 +267,139 @@ void QXmppStreamFeatures::setRosterVersioningSupported(bool supported)
     d->rosterVersioningSupported = supported;
 }
 
+///
+/// Returns the mechanisms available for \xep{0388, Extensible SASL Profile}.
+///
+/// An empty list means that SASL 2 is not supported.
+///
+/// \since QXmpp 1.6
+///
+QStringList QXmppStreamFeatures::sasl2Mechanisms() const
+{
+    return d->sasl2Mechanisms;
+}
+
+///
+/// Sets the mechanisms available for \xep{0388, Extensible SASL Profile}.
+///
+/// \since QXmpp 1.6
+///
+void QXmppStreamFeatures::setSasl2Mechanisms(const QStringList &mechanisms)
+{
+    d->sasl2Mechanisms = mechanisms;
+}
+
+///
+/// Returns whether a \xep{0198, Stream Management} resumption can be
+/// requested together with the \xep{0388, Extensible SASL Profile}
+/// authentication.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppStreamFeatures::sasl2StreamResumptionSupported() const
+{
+    return d->sasl2StreamResumptionSupported;
+}
+
+///
+/// Sets whether a \xep{0198, Stream Management} resumption can be requested
+/// together with the \xep{0388, Extensible SASL Profile} authentication.
+///
+/// \since QXmpp 1.6
+///
+void QXmppStreamFeatures::setSasl2StreamResumptionSupported(bool supported)
+{
+    d->sasl2StreamResumptionSupported = supported;
+}
+
+///
+/// Returns whether a resource can be bound using \xep{0386, Bind 2} during
+/// the \xep{0388, Extensible SASL Profile} authentication.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppStreamFeatures::bind2Supported() const
+{
+    return d->bind2Supported;
+}
+
+///
+/// Sets whether a resource can be bound using \xep{0386, Bind 2} during the
+/// \xep{0388, Extensible SASL Profile} authentication.
+///
+/// \since QXmpp 1.6
+///
+void QXmppStreamFeatures::setBind2Supported(bool supported)
+{
+    d->bind2Supported = supported;
+}
+
+///
+/// Returns the namespaces of the features that can be enabled together with
+/// the \xep{0386, Bind 2} request, e.g. \xep{0198, Stream Management}.
+///
+/// \since QXmpp 1.6
+///
+QStringList QXmppStreamFeatures::bind2InlineFeatures() const
+{
+    return d->bind2InlineFeatures;
+}
+
+///
+/// Sets the namespaces of the features that can be enabled together with the
+/// \xep{0386, Bind 2} request.
+///
+/// \since QXmpp 1.6
+///
+void QXmppStreamFeatures::setBind2InlineFeatures(const QStringList &features)
+{
+    d->bind2InlineFeatures = features;
+}
+
+///
+/// Returns the token mechanisms available for \xep{0484, Fast Authentication
+/// Streamlining Tokens}.
+///
+/// \since QXmpp 1.6
+///
+QStringList QXmppStreamFeatures::fastMechanisms() const
+{
+    return d->fastMechanisms;
+}
+
+///
+/// Sets the token mechanisms available for \xep{0484, Fast Authentication
+/// Streamlining Tokens}.
+///
+/// \since QXmpp 1.6
+///
+void QXmppStreamFeatures::setFastMechanisms(const QStringList &mechanisms)
+{
+    d->fastMechanisms = mechanisms;
+}
+
+///
+/// Returns whether the stream can be used in both directions as defined in
+/// \xep{0288, Bidirectional Server-to-Server Connections}.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppStreamFeatures::bidirectionalStreamsSupported() const
+{
+    return d->bidirectionalStreamsSupported;
+}
+
+///
+/// Sets whether the stream can be used in both directions as defined in
+/// \xep{0288, Bidirectional Server-to-Server Connections}.
+///
+/// \since QXmpp 1.6
+///
+void QXmppStreamFeatures::setBidirectionalStreamsSupported(bool supported)
+{
+    d->bidirectionalStreamsSupported = supported;
+}
+
 /// \cond
 bool QXmppStreamFeatures::isStreamFeatures(const QDomElement &element)
 {
@@ -264,7 +407,7 @@ bool QXmppStreamFeatures::isStreamFeatures(const QDomElement &element)
         element.tagName() == QStringLiteral("features");
 }
 
-static QXmppStreamFeatures::Mode readFeature(const QDomElement &element, const char *tagName, const char *tagNs)
+static QXmppStreamFeatures::Mode readFeature(const QDomElement &element, const char *tagName, QLatin1String tagNs)
 {
     QXmppStreamFeatures::Mode mode = QXmppStreamFeatures::Disabled;
 
@@ -282,7 +425,7 @@ static QXmppStreamFeatures::Mode readFeature(const QDomElement &element, const c
     return mode;
 }
 
-static bool readBooleanFeature(const QDomElement &element, const QString &tagName, const QString &xmlns)
+static bool readBooleanFeature(const QDomElement &element, const QString &tagName, QLatin1String xmlns)
 {
     auto childElement = element.firstChildElement(tagName);
     while (!childElement.isNull()) {
@@ -305,6 +448,7 @@ void QXmppStreamFeatures::parse(const QDomElement &element)
     d->registerMode = readFeature(element, "register", ns_register_feature);
     d->preApprovedSubscriptionsSupported = readBooleanFeature(element, QStringLiteral("sub"), ns_pre_approval);
     d->rosterVersioningSupported = readBooleanFeature(element, QStringLiteral("ver"), ns_rosterver);
+    d->bidirectionalStreamsSupported = readBooleanFeature(element, QStringLiteral("bidi"), ns_bidi_feature);
 
     // parse advertised compression methods
     QDomElement compression = element.firstChildElement(QStringLiteral("compression"));
@@ -325,9 +469,41 @@ void QXmppStreamFeatures::parse(const QDomElement &element)
             d->authMechanisms << subElement.text();
         }
     }
+
+    // parse XEP-0388: Extensible SASL Profile with its inline features
+    const auto sasl2 = element.firstChildElement(QStringLiteral("authentication"));
+    if (sasl2.namespaceURI() == ns_sasl_2) {
+        for (auto subElement = sasl2.firstChildElement(QStringLiteral("mechanism"));
+             !subElement.isNull();
+             subElement = subElement.nextSiblingElement(QStringLiteral("mechanism"))) {
+            d->sasl2Mechanisms << subElement.text();
+        }
+
+        const auto inlineFeatures = sasl2.firstChildElement(QStringLiteral("inline"));
+        d->sasl2StreamResumptionSupported = readFeature(inlineFeatures, "sm", ns_stream_management) != Disabled;
+
+        const auto bind2 = inlineFeatures.firstChildElement(QStringLiteral("bind"));
+        if (bind2.namespaceURI() == ns_bind2) {
+            d->bind2Supported = true;
+            for (auto subElement = bind2.firstChildElement(QStringLiteral("inline")).firstChildElement(QStringLiteral("feature"));
+                 !subElement.isNull();
+                 subElement = subElement.nextSiblingElement(QStringLiteral("feature"))) {
+                d->bind2InlineFeatures << subElement.attribute(QStringLiteral("var"));
+            }
+        }
+
+        const auto fast = inlineFeatures.firstChildElement(QStringLiteral("fast"));
+        if (fast.namespaceURI() == ns_fast) {
+            for (auto subElement = fast.firstChildElement(QStringLiteral("mechanism"));
+                 !subElement.isNull();
+                 subElement = subElement.nextSiblingElement(QStringLiteral("mechanism"))) {
+                d->fastMechanisms << subElement.text();
+            }
+        }
+    }
 }
 
-static void writeFeature(QXmlStreamWriter *writer, const char *tagName, const char *tagNs, QXmppStreamFeatures::Mode mode)
+static void writeFeature(QXmlStreamWriter *writer, const char *tagName, QLatin1String tagNs, QXmppStreamFeatures::Mode mode)
 {
     if (mode != QXmppStreamFeatures::Disabled) {
         writer->writeStartElement(tagName);
@@ -339,7 +515,7 @@ static void writeFeature(QXmlStreamWriter *writer, const char *tagName, const ch
     }
 }
 
-static void writeBoolenFeature(QXmlStreamWriter *writer, const QString &tagName, const QString &xmlns, bool enabled)
+static void writeBoolenFeature(QXmlStreamWriter *writer, const QString &tagName, QLatin1String xmlns, bool enabled)
 {
     if (enabled) {
         writer->writeStartElement(tagName);
@@ -360,6 +536,7 @@ void QXmppStreamFeatures::toXml(QXmlStreamWriter *writer) const
     writeFeature(writer, "register", ns_register_feature, d->registerMode);
     writeBoolenFeature(writer, QStringLiteral("sub"), ns_pre_approval, d->preApprovedSubscriptionsSupported);
     writeBoolenFeature(writer, QStringLiteral("ver"), ns_rosterver, d->rosterVersioningSupported);
+    writeBoolenFeature(writer, QStringLiteral("bidi"), ns_bidi_feature, d->bidirectionalStreamsSupported);
 
     if (!d->compressionMethods.isEmpty()) {
         writer->writeStartElement(QStringLiteral("compression"));
@@ -377,6 +554,42 @@ void QXmppStreamFeatures::toXml(QXmlStreamWriter *writer) const
         }
         writer->writeEndElement();
     }
+
+    if (!d->sasl2Mechanisms.isEmpty()) {
+        writer->writeStartElement(QStringLiteral("authentication"));
+        writer->writeDefaultNamespace(ns_sasl_2);
+        for (const auto &mechanism : std::as_const(d->sasl2Mechanisms)) {
+            writer->writeTextElement(QStringLiteral("mechanism"), mechanism);
+        }
+        if (d->sasl2StreamResumptionSupported || d->bind2Supported || !d->fastMechanisms.isEmpty()) {
+            writer->writeStartElement(QStringLiteral("inline"));
+            if (d->bind2Supported) {
+                writer->writeStartElement(QStringLiteral("bind"));
+                writer->writeDefaultNamespace(ns_bind2);
+                if (!d->bind2InlineFeatures.isEmpty()) {
+                    writer->writeStartElement(QStringLiteral("inline"));
+                    for (const auto &feature : std::as_const(d->bind2InlineFeatures)) {
+                        writer->writeStartElement(QStringLiteral("feature"));
+                        writer->writeAttribute(QStringLiteral("var"), feature);
+                        writer->writeEndElement();
+                    }
+                    writer->writeEndElement();
+                }
+                writer->writeEndElement();
+            }
+            if (!d->fastMechanisms.isEmpty()) {
+                writer->writeStartElement(QStringLiteral("fast"));
+                writer->writeDefaultNamespace(ns_fast);
+                for (const auto &mechanism : std::as_const(d->fastMechanisms)) {
+                    writer->writeTextElement(QStringLiteral("mechanism"), mechanism);
+                }
+                writer->writeEndElement();
+            }
+            writeFeature(writer, "sm", ns_stream_management, d->sasl2StreamResumptionSupported ? Enabled : Disabled);
+            writer->writeEndElement();
+        }
+        writer->writeEndElement();
+    }
     writer->writeEndElement();
 }
 /// \endcond
@@ -66,6 +66,24 @@ public:
     bool rosterVersioningSupported() const;
     void setRosterVersioningSupported(bool);
 
+    QStringList sasl2Mechanisms() const;
+    void setSasl2Mechanisms(const QStringList &mechanisms);
+
+    bool sasl2StreamResumptionSupported() const;
+    void setSasl2StreamResumptionSupported(bool);
+
+    bool bind2Supported() const;
+    void setBind2Supported(bool);
+
+    QStringList bind2InlineFeatures() const;
+    void setBind2InlineFeatures(const QStringList &features);
+
+    QStringList fastMechanisms() const;
+    void setFastMechanisms(const QStringList &mechanisms);
+
+    bool bidirectionalStreamsSupported() const;
+    void setBidirectionalStreamsSupported(bool);
+
     /// \cond
     void parse(const QDomElement &element) override;
     void toXml(QXmlStreamWriter *writer) const override;
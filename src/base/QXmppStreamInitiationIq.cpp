@@ -5,9 +5,12 @@
 #include "QXmppConstants_p.h"
 #include "QXmppStreamInitiationIq_p.h"
 #include "QXmppUtils.h"
+#include "QXmppUtils_p.h"
 
 #include <QDomElement>
 
+using namespace QXmpp::Private;
+
 /// \cond
 QXmppDataForm QXmppStreamInitiationIq::featureForm() const
 {
@@ -78,9 +81,9 @@ void QXmppStreamInitiationIq::parseElementFromChild(const QDomElement &element)
 
     QDomElement itemElement = siElement.firstChildElement();
     while (!itemElement.isNull()) {
-        if (itemElement.tagName() == QStringLiteral("feature") && itemElement.namespaceURI() == ns_feature_negotiation) {
+        if (isElement(itemElement, u"feature", ns_feature_negotiation)) {
             m_featureForm.parse(itemElement.firstChildElement());
-        } else if (itemElement.tagName() == QStringLiteral("file") && itemElement.namespaceURI() == ns_stream_initiation_file_transfer) {
+        } else if (isElement(itemElement, u"file", ns_stream_initiation_file_transfer)) {
             m_fileInfo.parse(itemElement);
         }
         itemElement = itemElement.nextSiblingElement();
@@ -4,13 +4,22 @@
 
 #include "QXmppConstants_p.h"
 #include "QXmppGlobal.h"
+#include "QXmppMetrics.h"
 #include "QXmppPacket_p.h"
+#include "QXmppStanzaView.h"
 #include "QXmppStanza_p.h"
 #include "QXmppStream.h"
 #include "QXmppStreamManagement_p.h"
 
+#include <algorithm>
+
+#include <QElapsedTimer>
+
 using namespace QXmpp::Private;
 
+// maximum size of the writes when the unacknowledged stanzas are resent
+constexpr qint64 ReplayChunkSize = 64 * 1024;
+
 /// \cond
 QXmppStreamManagementEnable::QXmppStreamManagementEnable(const bool resume, const unsigned max)
     : m_resume(resume), m_max(max)
@@ -124,8 +133,11 @@ void QXmppStreamManagementEnabled::parse(const QDomElement &element)
 
 void QXmppStreamManagementEnabled::toXml(QXmlStreamWriter *writer) const
 {
-    writer->writeStartElement(QStringLiteral("enable"));
+    writer->writeStartElement(QStringLiteral("enabled"));
     writer->writeDefaultNamespace(ns_stream_management);
+    if (!m_id.isEmpty()) {
+        writer->writeAttribute(QStringLiteral("id"), m_id);
+    }
     if (m_resume) {
         writer->writeAttribute(QStringLiteral("resume"), QStringLiteral("true"));
     }
@@ -178,6 +190,7 @@ void QXmppStreamManagementResume::parse(const QDomElement &element)
 void QXmppStreamManagementResume::toXml(QXmlStreamWriter *writer) const
 {
     writer->writeStartElement(QStringLiteral("resume"));
+    writer->writeDefaultNamespace(ns_stream_management);
     writer->writeAttribute(QStringLiteral("h"), QString::number(m_h));
     writer->writeAttribute(QStringLiteral("previd"), m_previd);
     writer->writeEndElement();
@@ -223,6 +236,7 @@ void QXmppStreamManagementResumed::parse(const QDomElement &element)
 void QXmppStreamManagementResumed::toXml(QXmlStreamWriter *writer) const
 {
     writer->writeStartElement(QStringLiteral("resumed"));
+    writer->writeDefaultNamespace(ns_stream_management);
     writer->writeAttribute(QStringLiteral("h"), QString::number(m_h));
     writer->writeAttribute(QStringLiteral("previd"), m_previd);
     writer->writeEndElement();
@@ -317,8 +331,23 @@ void QXmppStreamManagementReq::toXml(QXmlStreamWriter *writer)
 }
 
 QXmppStreamManager::QXmppStreamManager(QXmppStream *stream)
-    : stream(stream)
+    : stream(stream),
+      m_requestTimer(new QTimer(stream)),
+      m_acknowledgementTimer(new QTimer(stream))
 {
+    m_requestTimer->setSingleShot(true);
+    QObject::connect(m_requestTimer, &QTimer::timeout, stream, [this]() {
+        if (m_unrequestedStanzas > 0) {
+            sendAcknowledgementRequest();
+        }
+    });
+
+    m_acknowledgementTimer->setSingleShot(true);
+    QObject::connect(m_acknowledgementTimer, &QTimer::timeout, stream, [this]() {
+        if (m_acknowledgementPending) {
+            sendAcknowledgement();
+        }
+    });
 }
 
 QXmppStreamManager::~QXmppStreamManager()
@@ -339,18 +368,39 @@ unsigned int QXmppStreamManager::lastIncomingSequenceNumber() const
 void QXmppStreamManager::handleDisconnect()
 {
     m_enabled = false;
+    stopTimers();
 }
 
 void QXmppStreamManager::handleStart()
 {
     m_enabled = false;
+    stopTimers();
 }
 
 void QXmppStreamManager::handlePacketSent(QXmppPacket &packet, bool sentData)
 {
     if (m_enabled && packet.isXmppStanza()) {
-        m_unacknowledgedStanzas.insert(++m_lastOutgoingSequenceNumber, packet);
-        sendAcknowledgementRequest();
+        ++m_lastOutgoingSequenceNumber;
+        m_unacknowledgedBytes += packet.data().size();
+        m_unacknowledgedStanzas.append(packet);
+
+        if (m_acknowledgementPending && m_policy.piggybackAcknowledgements()) {
+            sendAcknowledgement();
+        }
+
+        m_unrequestedStanzas++;
+        m_unrequestedBytes += packet.data().size();
+        const auto stanzaLimit = m_policy.requestStanzaCount();
+        const auto byteLimit = m_policy.requestByteCount();
+        if ((stanzaLimit > 0 && m_unrequestedStanzas >= stanzaLimit) ||
+            (byteLimit > 0 && m_unrequestedBytes >= byteLimit)) {
+            sendAcknowledgementRequest();
+        } else if (m_policy.requestInterval() > 0 && !m_requestTimer->isActive()) {
+            m_requestTimer->start(m_policy.requestInterval());
+        }
+
+        enforceQueueLimit();
+        updateQueueGauges();
     } else {
         if (sentData) {
             packet.reportFinished(QXmpp::SendSuccess { false });
@@ -362,20 +412,21 @@ void QXmppStreamManager::handlePacketSent(QXmppPacket &packet, bool sentData)
     }
 }
 
-bool QXmppStreamManager::handleStanza(const QDomElement &stanza)
+bool QXmppStreamManager::handleStanza(const QXmppStanzaView &stanza)
 {
-    if (QXmppStreamManagementAck::isStreamManagementAck(stanza)) {
-        handleAcknowledgement(stanza);
-        return true;
-    }
-    if (QXmppStreamManagementReq::isStreamManagementReq(stanza)) {
-        sendAcknowledgement();
-        return true;
+    const auto tagName = stanza.tagName();
+    if (stanza.namespaceUri() == ns_stream_management) {
+        if (tagName == u"a") {
+            handleAcknowledgement(stanza.toDomElement());
+            return true;
+        }
+        if (tagName == u"r") {
+            handleAcknowledgementRequest();
+            return true;
+        }
     }
 
-    if (stanza.tagName() == QLatin1String("message") ||
-        stanza.tagName() == QLatin1String("presence") ||
-        stanza.tagName() == QLatin1String("iq")) {
+    if (tagName == u"message" || tagName == u"presence" || tagName == u"iq") {
         m_lastIncomingSequenceNumber++;
     }
     return false;
@@ -386,45 +437,179 @@ void QXmppStreamManager::enableStreamManagement(bool resetSequenceNumber)
     m_enabled = true;
 
     if (resetSequenceNumber) {
-        m_lastOutgoingSequenceNumber = 0;
         m_lastIncomingSequenceNumber = 0;
 
-        // resend unacked stanzas
-        if (!m_unacknowledgedStanzas.isEmpty()) {
-            auto oldUnackedStanzas = m_unacknowledgedStanzas;
-            m_unacknowledgedStanzas.clear();
+        // the unacked stanzas get new sequence numbers when they are resent
+        m_lastOutgoingSequenceNumber = unsigned(m_unacknowledgedStanzas.size());
+    }
 
-            for (auto &packet : oldUnackedStanzas) {
-                m_unacknowledgedStanzas.insert(++m_lastOutgoingSequenceNumber, packet);
-                stream->sendData(packet.data());
-            }
+    // resend unacked stanzas
+    if (!m_unacknowledgedStanzas.isEmpty()) {
+        replayUnacknowledgedStanzas();
+        sendAcknowledgementRequest();
+    }
+}
 
-            sendAcknowledgementRequest();
-        }
-    } else {
-        // resend unacked stanzas
-        if (!m_unacknowledgedStanzas.isEmpty()) {
-            for (auto &packet : m_unacknowledgedStanzas) {
-                stream->sendData(packet.data());
-            }
+// Resends the stanzas that have not been acknowledged before the stream was
+// lost. The acknowledgement of <resumed/> has been applied before, so only
+// the stanzas the peer really is missing are left. They are written in large
+// chunks instead of one write per stanza, which matters after a long time
+// offline on a weak mobile link.
+void QXmppStreamManager::replayUnacknowledgedStanzas()
+{
+    QElapsedTimer timer;
+    timer.start();
 
-            sendAcknowledgementRequest();
+    QByteArray chunk;
+    chunk.reserve(int(std::min<qint64>(m_unacknowledgedBytes, ReplayChunkSize)));
+    for (qsizetype i = 0; i < m_unacknowledgedStanzas.size(); i++) {
+        const auto &data = m_unacknowledgedStanzas[i].data();
+        if (!chunk.isEmpty() && chunk.size() + data.size() > ReplayChunkSize) {
+            stream->sendData(chunk);
+            chunk.clear();
         }
+        chunk += data;
     }
+    stream->sendData(chunk);
+
+    QXmppMetrics::increment(QXmppMetrics::ReplayedStanzas, quint64(m_unacknowledgedStanzas.size()));
+    QXmppMetrics::increment(QXmppMetrics::ReplayedBytes, quint64(m_unacknowledgedBytes));
+    QXmppMetrics::observe(QXmppMetrics::StreamResumptionReplayTime, timer.nsecsElapsed());
 }
 
 void QXmppStreamManager::setAcknowledgedSequenceNumber(unsigned int sequenceNumber)
 {
-    for (auto it = m_unacknowledgedStanzas.begin(); it != m_unacknowledgedStanzas.end();) {
-        if (it.key() <= sequenceNumber) {
-            it->reportFinished(QXmpp::SendSuccess { true });
-            it = m_unacknowledgedStanzas.erase(it);
+    // The queue contains the stanzas up to the last outgoing sequence number
+    // without gaps. Unsigned arithmetic handles the wrap-around of the counter.
+    const auto firstUnacknowledged = m_lastOutgoingSequenceNumber - unsigned(m_unacknowledgedStanzas.size()) + 1;
+    const auto acknowledged = qsizetype(sequenceNumber - firstUnacknowledged + 1);
+    if (acknowledged > m_unacknowledgedStanzas.size()) {
+        // outdated or invalid acknowledgement
+        return;
+    }
+
+    for (qsizetype i = 0; i < acknowledged; i++) {
+        auto packet = m_unacknowledgedStanzas.takeFirst();
+        m_unacknowledgedBytes -= packet.data().size();
+        packet.reportFinished(QXmpp::SendSuccess { true });
+    }
+    updateQueueGauges();
+}
+
+void QXmppStreamManager::saveState(QDataStream &stream) const
+{
+    stream << quint32(m_lastIncomingSequenceNumber) << quint32(m_lastOutgoingSequenceNumber)
+           << quint32(m_unacknowledgedStanzas.size());
+    for (qsizetype i = 0; i < m_unacknowledgedStanzas.size(); i++) {
+        stream << m_unacknowledgedStanzas[i].data();
+    }
+}
+
+bool QXmppStreamManager::restoreState(QDataStream &stream)
+{
+    quint32 lastIncoming = 0;
+    quint32 lastOutgoing = 0;
+    quint32 count = 0;
+    stream >> lastIncoming >> lastOutgoing >> count;
+
+    std::vector<QByteArray> stanzas;
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; i++) {
+        QByteArray data;
+        stream >> data;
+        stanzas.push_back(std::move(data));
+    }
+    if (stream.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    resetCache();
+    m_lastIncomingSequenceNumber = lastIncoming;
+    m_lastOutgoingSequenceNumber = lastOutgoing;
+    // nobody is waiting for the results of the restored stanzas
+    for (const auto &data : stanzas) {
+        m_unacknowledgedBytes += data.size();
+        m_unacknowledgedStanzas.append(QXmppPacket(data, true));
+    }
+    updateQueueGauges();
+    return true;
+}
+
+qsizetype QXmppStreamManager::unacknowledgedStanzaCount() const
+{
+    return m_unacknowledgedStanzas.size();
+}
+
+qint64 QXmppStreamManager::unacknowledgedBytes() const
+{
+    return m_unacknowledgedBytes;
+}
+
+void QXmppStreamManager::squeeze()
+{
+    m_unacknowledgedStanzas.squeeze();
+}
+
+void QXmppStreamManager::setQueueLimit(qint64 bytes, bool disconnectOnOverflow)
+{
+    m_queueLimit = bytes;
+    m_disconnectOnOverflow = disconnectOnOverflow;
+}
+
+QXmppStreamManagementPolicy QXmppStreamManager::policy() const
+{
+    return m_policy;
+}
+
+void QXmppStreamManager::setPolicy(const QXmppStreamManagementPolicy &policy)
+{
+    m_policy = policy;
+
+    // apply the new limits to the stanzas sent since the last request
+    if (m_enabled && m_unrequestedStanzas > 0) {
+        const auto stanzaLimit = m_policy.requestStanzaCount();
+        const auto byteLimit = m_policy.requestByteCount();
+        if ((stanzaLimit > 0 && m_unrequestedStanzas >= stanzaLimit) ||
+            (byteLimit > 0 && m_unrequestedBytes >= byteLimit)) {
+            sendAcknowledgementRequest();
+        } else if (m_policy.requestInterval() > 0) {
+            m_requestTimer->start(m_policy.requestInterval());
         } else {
-            break;
+            m_requestTimer->stop();
         }
     }
 }
 
+void QXmppStreamManager::enforceQueueLimit()
+{
+    if (m_queueLimit <= 0 || m_unacknowledgedBytes <= m_queueLimit) {
+        return;
+    }
+
+    if (m_disconnectOnOverflow) {
+        stream->warning(QStringLiteral("Too many unacknowledged stanzas, closing the stream."));
+        stream->disconnectFromHost();
+        return;
+    }
+
+    // the newest stanza is always kept
+    while (m_unacknowledgedBytes > m_queueLimit && m_unacknowledgedStanzas.size() > 1) {
+        // the stanza has been sent, but it won't be resent on stream resumption
+        auto packet = m_unacknowledgedStanzas.takeFirst();
+        m_unacknowledgedBytes -= packet.data().size();
+        packet.reportFinished(QXmpp::SendSuccess { false });
+    }
+}
+
+void QXmppStreamManager::updateQueueGauges()
+{
+    // the gauges are shared by all streams, so only changes are reported
+    const qint64 stanzas = m_unacknowledgedStanzas.size();
+    QXmppMetrics::addToGauge(QXmppMetrics::StreamManagementQueuedStanzas, stanzas - reportedStanzaCount());
+    QXmppMetrics::addToGauge(QXmppMetrics::StreamManagementQueuedBytes, m_unacknowledgedBytes - reportedBytes());
+    m_reportedStanzas.store(stanzas, std::memory_order_relaxed);
+    m_reportedBytes.store(m_unacknowledgedBytes, std::memory_order_relaxed);
+}
+
 void QXmppStreamManager::handleAcknowledgement(const QDomElement &element)
 {
     if (!m_enabled) {
@@ -442,6 +627,9 @@ void QXmppStreamManager::sendAcknowledgement()
         return;
     }
 
+    m_acknowledgementPending = false;
+    m_acknowledgementTimer->stop();
+
     // prepare packet
     QByteArray data;
     QXmlStreamWriter xmlStream(&data);
@@ -458,6 +646,10 @@ void QXmppStreamManager::sendAcknowledgementRequest()
         return;
     }
 
+    m_unrequestedStanzas = 0;
+    m_unrequestedBytes = 0;
+    m_requestTimer->stop();
+
     // prepare packet
     QByteArray data;
     QXmlStreamWriter xmlStream(&data);
@@ -467,14 +659,37 @@ void QXmppStreamManager::sendAcknowledgementRequest()
     stream->sendData(data);
 }
 
+void QXmppStreamManager::handleAcknowledgementRequest()
+{
+    const auto delay = m_policy.acknowledgementDelay();
+    if (delay <= 0) {
+        sendAcknowledgement();
+    } else if (!m_acknowledgementPending) {
+        // answer within the delay or with the next outgoing stanza
+        m_acknowledgementPending = true;
+        m_acknowledgementTimer->start(delay);
+    }
+}
+
+void QXmppStreamManager::stopTimers()
+{
+    m_unrequestedStanzas = 0;
+    m_unrequestedBytes = 0;
+    m_acknowledgementPending = false;
+    m_requestTimer->stop();
+    m_acknowledgementTimer->stop();
+}
+
 void QXmppStreamManager::resetCache()
 {
-    for (auto &packet : m_unacknowledgedStanzas) {
-        packet.reportFinished(QXmppError {
+    for (qsizetype i = 0; i < m_unacknowledgedStanzas.size(); i++) {
+        m_unacknowledgedStanzas[i].reportFinished(QXmppError {
             QStringLiteral("Disconnected"),
             QXmpp::SendError::Disconnected });
     }
 
     m_unacknowledgedStanzas.clear();
+    m_unacknowledgedBytes = 0;
+    updateQueueGauges();
 }
 /// \endcond
@@ -0,0 +1,162 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppStreamManagementPolicy.h"
+
+class QXmppStreamManagementPolicyPrivate : public QSharedData
+{
+public:
+    int requestStanzaCount = 1;
+    qint64 requestByteCount = 0;
+    int requestInterval = 0;
+    int acknowledgementDelay = 0;
+    bool piggybackAcknowledgements = true;
+};
+
+///
+/// \class QXmppStreamManagementPolicy
+///
+/// \brief The QXmppStreamManagementPolicy class controls when acknowledgements
+/// are requested and sent on a stream with \xep{0198, Stream Management}.
+///
+/// By default an acknowledgement (\c <r/>) is requested after every sent
+/// stanza and every request of the peer is answered immediately. This doubles
+/// the number of packets for chatty workloads. A policy can instead request
+/// acknowledgements only after a number of stanzas or bytes or after a delay,
+/// and answer requests of the peer lazily.
+///
+/// \since QXmpp 1.6
+///
+
+///
+/// Constructs a policy that requests an acknowledgement for every stanza and
+/// answers requests immediately.
+///
+QXmppStreamManagementPolicy::QXmppStreamManagementPolicy()
+    : d(new QXmppStreamManagementPolicyPrivate)
+{
+}
+
+QXMPP_PRIVATE_DEFINE_RULE_OF_SIX(QXmppStreamManagementPolicy)
+
+///
+/// Returns the number of sent stanzas after which an acknowledgement is
+/// requested.
+///
+int QXmppStreamManagementPolicy::requestStanzaCount() const
+{
+    return d->requestStanzaCount;
+}
+
+///
+/// Sets the number of sent stanzas after which an acknowledgement is requested.
+///
+/// A value of 0 disables the limit. The default value is 1.
+///
+void QXmppStreamManagementPolicy::setRequestStanzaCount(int count)
+{
+    d->requestStanzaCount = count;
+}
+
+///
+/// Returns the number of sent bytes after which an acknowledgement is
+/// requested.
+///
+qint64 QXmppStreamManagementPolicy::requestByteCount() const
+{
+    return d->requestByteCount;
+}
+
+///
+/// Sets the number of sent bytes after which an acknowledgement is requested.
+///
+/// A value of 0 disables the limit. The default value is 0.
+///
+void QXmppStreamManagementPolicy::setRequestByteCount(qint64 bytes)
+{
+    d->requestByteCount = bytes;
+}
+
+///
+/// Returns the maximum time in milliseconds a sent stanza waits for an
+/// acknowledgement request.
+///
+int QXmppStreamManagementPolicy::requestInterval() const
+{
+    return d->requestInterval;
+}
+
+///
+/// Sets the maximum time in milliseconds a sent stanza waits for an
+/// acknowledgement request.
+///
+/// If neither the stanza count nor the byte count is reached in time, an
+/// acknowledgement is requested after this interval. A value of 0 disables the
+/// timer. The default value is 0.
+///
+/// \note If the timer is disabled, stanzas below the stanza and byte limits are
+/// only acknowledged after the next request.
+///
+void QXmppStreamManagementPolicy::setRequestInterval(int msecs)
+{
+    d->requestInterval = msecs;
+}
+
+///
+/// Returns the maximum time in milliseconds before a request of the peer is
+/// answered.
+///
+int QXmppStreamManagementPolicy::acknowledgementDelay() const
+{
+    return d->acknowledgementDelay;
+}
+
+///
+/// Sets the maximum time in milliseconds before a request of the peer is
+/// answered.
+///
+/// A value of 0 answers requests immediately, which is the default.
+///
+void QXmppStreamManagementPolicy::setAcknowledgementDelay(int msecs)
+{
+    d->acknowledgementDelay = msecs;
+}
+
+///
+/// Returns whether pending acknowledgements are sent together with the next
+/// outgoing stanza.
+///
+bool QXmppStreamManagementPolicy::piggybackAcknowledgements() const
+{
+    return d->piggybackAcknowledgements;
+}
+
+///
+/// Sets whether pending acknowledgements are sent together with the next
+/// outgoing stanza.
+///
+/// If enabled, a delayed answer to a request of the peer is sent as soon as a
+/// stanza is sent, instead of waiting for the acknowledgement delay. The
+/// default value is true.
+///
+void QXmppStreamManagementPolicy::setPiggybackAcknowledgements(bool enabled)
+{
+    d->piggybackAcknowledgements = enabled;
+}
+
+///
+/// Returns a policy suitable for mobile connections.
+///
+/// It requests an acknowledgement after 5 stanzas, 8 KiB or 1 second and
+/// answers requests within 1 second, or with the next outgoing stanza.
+///
+QXmppStreamManagementPolicy QXmppStreamManagementPolicy::batched()
+{
+    QXmppStreamManagementPolicy policy;
+    policy.setRequestStanzaCount(5);
+    policy.setRequestByteCount(8 * 1024);
+    policy.setRequestInterval(1000);
+    policy.setAcknowledgementDelay(1000);
+    return policy;
+}
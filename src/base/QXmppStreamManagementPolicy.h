@@ -0,0 +1,42 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPSTREAMMANAGEMENTPOLICY_H
+#define QXMPPSTREAMMANAGEMENTPOLICY_H
+
+#include "QXmppGlobal.h"
+
+#include <QSharedDataPointer>
+
+class QXmppStreamManagementPolicyPrivate;
+
+class QXMPP_EXPORT QXmppStreamManagementPolicy
+{
+public:
+    QXmppStreamManagementPolicy();
+
+    QXMPP_PRIVATE_DECLARE_RULE_OF_SIX(QXmppStreamManagementPolicy)
+
+    int requestStanzaCount() const;
+    void setRequestStanzaCount(int count);
+
+    qint64 requestByteCount() const;
+    void setRequestByteCount(qint64 bytes);
+
+    int requestInterval() const;
+    void setRequestInterval(int msecs);
+
+    int acknowledgementDelay() const;
+    void setAcknowledgementDelay(int msecs);
+
+    bool piggybackAcknowledgements() const;
+    void setPiggybackAcknowledgements(bool enabled);
+
+    static QXmppStreamManagementPolicy batched();
+
+private:
+    QSharedDataPointer<QXmppStreamManagementPolicyPrivate> d;
+};
+
+#endif  // QXMPPSTREAMMANAGEMENTPOLICY_H
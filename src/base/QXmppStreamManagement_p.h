@@ -6,13 +6,22 @@
 #define QXMPPSTREAMMANAGEMENT_P_H
 
 #include "QXmppGlobal.h"
+#include "QXmppPacket_p.h"
 #include "QXmppStanza.h"
+#include "QXmppStreamManagementPolicy.h"
 
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <vector>
+
+#include <QDataStream>
 #include <QDomDocument>
+#include <QTimer>
 #include <QXmlStreamWriter>
 
 class QXmppStream;
-class QXmppPacket;
+class QXmppStanzaView;
 
 //
 //  W A R N I N G
@@ -163,6 +172,89 @@ public:
     static void toXml(QXmlStreamWriter *writer);
 };
 
+namespace QXmpp::Private {
+
+//
+// First-in-first-out queue stored in one contiguous circular buffer. The
+// capacity is always a power of two and grows when the queue is full.
+//
+template<typename T>
+class RingBuffer
+{
+public:
+    bool isEmpty() const { return m_size == 0; }
+    qsizetype size() const { return m_size; }
+
+    T &operator[](qsizetype i) { return *m_items[index(i)]; }
+    const T &operator[](qsizetype i) const { return *m_items[index(i)]; }
+    T &first() { return *m_items[m_head]; }
+
+    void append(T value)
+    {
+        if (m_size == qsizetype(m_items.size())) {
+            grow();
+        }
+        m_items[index(m_size)] = std::move(value);
+        m_size++;
+    }
+
+    T takeFirst()
+    {
+        auto &item = m_items[m_head];
+        T value = std::move(*item);
+        item.reset();
+        m_head = (m_head + 1) & mask();
+        m_size--;
+        return value;
+    }
+
+    void clear()
+    {
+        m_items.clear();
+        m_head = 0;
+        m_size = 0;
+    }
+
+    // Releases the capacity that isn't needed for the current items.
+    void squeeze()
+    {
+        if (m_size == 0) {
+            clear();
+            m_items.shrink_to_fit();
+            return;
+        }
+        auto capacity = qsizetype(16);
+        while (capacity < m_size) {
+            capacity *= 2;
+        }
+        if (capacity < qsizetype(m_items.size())) {
+            resize(size_t(capacity));
+        }
+    }
+
+private:
+    qsizetype mask() const { return qsizetype(m_items.size()) - 1; }
+    qsizetype index(qsizetype i) const { return (m_head + i) & mask(); }
+
+    void grow() { resize(std::max<size_t>(16, m_items.size() * 2)); }
+
+    void resize(size_t capacity)
+    {
+        std::vector<std::optional<T>> items(capacity);
+        for (qsizetype i = 0; i < m_size; i++) {
+            items[i] = std::move(m_items[index(i)]);
+        }
+        m_items = std::move(items);
+        m_head = 0;
+    }
+
+    std::vector<std::optional<T>> m_items;
+    qsizetype m_head = 0;
+    qsizetype m_size = 0;
+};
+
+}  // namespace QXmpp::Private
+
 //
 // This manager is used in the QXmppStream. It contains the parts of stream
 // management that are shared between server and client connections.
@@ -179,24 +271,65 @@ public:
     void handleDisconnect();
     void handleStart();
     void handlePacketSent(QXmppPacket &packet, bool sentData);
-    bool handleStanza(const QDomElement &stanza);
+    bool handleStanza(const QXmppStanzaView &stanza);
 
     void resetCache();
     void enableStreamManagement(bool resetSequenceNumber);
     void setAcknowledgedSequenceNumber(unsigned int sequenceNumber);
 
+    // sequence numbers and unacknowledged stanzas, for resuming in another process
+    void saveState(QDataStream &stream) const;
+    bool restoreState(QDataStream &stream);
+
+    qsizetype unacknowledgedStanzaCount() const;
+    qint64 unacknowledgedBytes() const;
+    void setQueueLimit(qint64 bytes, bool disconnectOnOverflow);
+    // releases the unused capacity of the queue
+    void squeeze();
+
+    // queue size as last reported to the gauges, can be read from any thread
+    qint64 reportedStanzaCount() const { return m_reportedStanzas.load(std::memory_order_relaxed); }
+    qint64 reportedBytes() const { return m_reportedBytes.load(std::memory_order_relaxed); }
+
+    QXmppStreamManagementPolicy policy() const;
+    void setPolicy(const QXmppStreamManagementPolicy &policy);
+
 private:
     void handleAcknowledgement(const QDomElement &element);
 
     void sendAcknowledgement();
     void sendAcknowledgementRequest();
+    void handleAcknowledgementRequest();
+    void stopTimers();
+
+    void replayUnacknowledgedStanzas();
+    void enforceQueueLimit();
+    void updateQueueGauges();
 
     QXmppStream *stream;
 
     bool m_enabled = false;
-    QMap<unsigned int, QXmppPacket> m_unacknowledgedStanzas;
+    // stanzas with the sequence numbers up to m_lastOutgoingSequenceNumber
+    QXmpp::Private::RingBuffer<QXmppPacket> m_unacknowledgedStanzas;
+    qint64 m_unacknowledgedBytes = 0;
+    // maximum size of the unacknowledged stanzas, zero means unlimited
+    qint64 m_queueLimit = 0;
+    bool m_disconnectOnOverflow = false;
+    // queue size last added to the process-wide gauges
+    std::atomic<qint64> m_reportedStanzas { 0 };
+    std::atomic<qint64> m_reportedBytes { 0 };
     unsigned int m_lastOutgoingSequenceNumber = 0;
     unsigned int m_lastIncomingSequenceNumber = 0;
+
+    // acknowledgement batching
+    QXmppStreamManagementPolicy m_policy;
+    // stanzas sent since the last <r/>
+    int m_unrequestedStanzas = 0;
+    qint64 m_unrequestedBytes = 0;
+    // whether an <r/> of the peer has not been answered yet
+    bool m_acknowledgementPending = false;
+    QTimer *m_requestTimer;
+    QTimer *m_acknowledgementTimer;
 };
 /// \endcond
 
@@ -0,0 +1,105 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppStringPool_p.h"
+
+#include <QHash>
+#include <QMutex>
+
+using namespace QXmpp::Private;
+
+class QXmpp::Private::StringPoolShard
+{
+public:
+    QMutex mutex;
+    // the keys refer to the data of the values
+    QHash<QStringView, QString> strings;
+};
+
+Q_GLOBAL_STATIC(StringPool, stringPool)
+
+StringPool::StringPool()
+{
+    for (auto &shard : m_shards) {
+        shard = std::make_unique<StringPoolShard>();
+    }
+}
+
+StringPool::~StringPool() = default;
+
+//
+// Returns the pool shared by all streams.
+//
+StringPool *StringPool::instance()
+{
+    return stringPool();
+}
+
+//
+// Returns a string with the content of \a string that shares its data with
+// all other strings interned with the same content.
+//
+QString StringPool::intern(QStringView string)
+{
+    return internString(string, nullptr);
+}
+
+//
+// Like intern(QStringView), but \a string itself is pooled if there is no
+// string with its content yet, so its data doesn't need to be copied.
+//
+QString StringPool::intern(const QString &string)
+{
+    return internString(string, &string);
+}
+
+QString StringPool::internString(QStringView string, const QString *source)
+{
+    const auto toString = [&]() {
+        return source ? *source : string.toString();
+    };
+
+    if (string.isEmpty()) {
+        return {};
+    }
+    if (string.size() > MaximumLength) {
+        return toString();
+    }
+
+    auto &shard = *m_shards[qHash(string) % ShardCount];
+
+    QMutexLocker locker(&shard.mutex);
+    if (const auto itr = shard.strings.constFind(string); itr != shard.strings.constEnd()) {
+        return *itr;
+    }
+
+    if (shard.strings.size() >= MaximumSize / ShardCount) {
+        shard.strings.clear();
+    }
+
+    const auto pooled = toString();
+    shard.strings.insert(QStringView(pooled), pooled);
+    return pooled;
+}
+
+//
+// Returns the number of pooled strings.
+//
+int StringPool::size() const
+{
+    int size = 0;
+    for (const auto &shard : m_shards) {
+        QMutexLocker locker(&shard->mutex);
+        size += int(shard->strings.size());
+    }
+    return size;
+}
+
+void StringPool::clear()
+{
+    for (const auto &shard : m_shards) {
+        QMutexLocker locker(&shard->mutex);
+        shard->strings.clear();
+    }
+}
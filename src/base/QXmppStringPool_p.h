@@ -0,0 +1,72 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPSTRINGPOOL_P_H
+#define QXMPPSTRINGPOOL_P_H
+
+#include "QXmppGlobal.h"
+
+#include <array>
+#include <memory>
+
+#include <QString>
+#include <QStringView>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+namespace QXmpp::Private {
+
+class StringPoolShard;
+
+//
+// Process-wide pool of interned strings.
+//
+// Used for strings that are repeated in most parsed stanzas, i.e. tag names,
+// namespaces, attribute names and JIDs. Interning a string returns a copy of
+// the pooled string with the same content, so all parsed stanzas share one
+// implicitly shared buffer.
+//
+// The pool is split into shards with a mutex each, so streams in different
+// threads rarely block each other. Every shard holds at most
+// MaximumSize / ShardCount strings and is cleared when it is full; strings
+// that are still in use stay valid, they are only not shared with newly
+// parsed strings anymore. Long strings are never pooled.
+//
+class QXMPP_AUTOTEST_EXPORT StringPool
+{
+public:
+    static constexpr int ShardCount = 16;
+    static constexpr int MaximumSize = 16384;
+    static constexpr qsizetype MaximumLength = 256;
+
+    StringPool();
+    ~StringPool();
+
+    static StringPool *instance();
+
+    QString intern(QStringView string);
+    QString intern(const QString &string);
+
+    int size() const;
+    void clear();
+
+private:
+    QString internString(QStringView string, const QString *source);
+
+    std::array<std::unique_ptr<StringPoolShard>, ShardCount> m_shards;
+};
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPSTRINGPOOL_P_H
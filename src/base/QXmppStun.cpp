@@ -6,24 +6,126 @@
 
 #include "QXmppStun_p.h"
 #include "QXmppUtils.h"
+#include "QXmppUtils_p.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <type_traits>
+
+#ifdef Q_OS_LINUX
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
 
 #include <QCryptographicHash>
-#include <QDataStream>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QHostInfo>
+#include <QMutex>
 #include <QNetworkInterface>
+#include <QPointer>
 #include <QTimer>
 #include <QUdpSocket>
 #include <QVariant>
+#include <QtEndian>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 1, 0)
+#include <QNetworkInformation>
+#endif
 
 #define STUN_ID_SIZE 12
 #define STUN_RTO_INTERVAL 500
 #define STUN_RTO_MAX 7
 
+// default pace of ICE connectivity checks (Ta), see RFC 8445 section 14.2
+static const int ICE_CHECK_INTERVAL = 50;
+// time in seconds for which unused TURN allocations are kept
+static const int TURN_ALLOCATION_CACHE_TIMEOUT = 60;
+// time in milliseconds for which the discovered local addresses are cached
+static const int ICE_ADDRESS_CACHE_TIMEOUT = 10000;
+
 static const quint32 STUN_MAGIC = 0x2112A442;
 static const quint16 STUN_HEADER = 20;
 static const quint8 STUN_IPV4 = 0x01;
 static const quint8 STUN_IPV6 = 0x02;
 
+// datagrams received with one system call
+static constexpr int UDP_BATCH_SIZE = 16;
+// maximum size of a datagram received in a batch, ICE media is sent in
+// datagrams not exceeding the MTU
+static constexpr int UDP_BATCH_DATAGRAM_SIZE = 2048;
+
+//
+// Reads all pending datagrams of a UDP socket and passes them to a handler.
+//
+// On Linux, the datagrams are received in batches using recvmmsg() into the
+// preallocated batchBuffer.
+// The first datagram is always read through the socket because that re-enables
+// its read notifications.
+//
+template<typename Handler>
+static void readPendingDatagrams(QUdpSocket *socket, std::vector<char> &batchBuffer, Handler handler)
+{
+    QByteArray buffer;
+    QHostAddress remoteHost;
+    quint16 remotePort;
+
+    if (socket->hasPendingDatagrams()) {
+        buffer.resize(socket->pendingDatagramSize());
+        socket->readDatagram(buffer.data(), buffer.size(), &remoteHost, &remotePort);
+        handler(buffer, remoteHost, remotePort);
+    }
+
+#ifdef Q_OS_LINUX
+    if (const auto descriptor = socket->socketDescriptor(); descriptor >= 0) {
+        if (batchBuffer.empty()) {
+            batchBuffer.resize(UDP_BATCH_SIZE * UDP_BATCH_DATAGRAM_SIZE);
+        }
+
+        std::array<mmsghdr, UDP_BATCH_SIZE> messages;
+        std::array<iovec, UDP_BATCH_SIZE> vectors;
+        std::array<sockaddr_storage, UDP_BATCH_SIZE> addresses;
+
+        int count;
+        do {
+            std::memset(messages.data(), 0, sizeof(messages));
+            for (int i = 0; i < UDP_BATCH_SIZE; i++) {
+                vectors[i].iov_base = batchBuffer.data() + i * UDP_BATCH_DATAGRAM_SIZE;
+                vectors[i].iov_len = UDP_BATCH_DATAGRAM_SIZE;
+                messages[i].msg_hdr.msg_iov = &vectors[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+                messages[i].msg_hdr.msg_name = &addresses[i];
+                messages[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+            }
+
+            count = recvmmsg(int(descriptor), messages.data(), UDP_BATCH_SIZE, MSG_DONTWAIT, nullptr);
+            for (int i = 0; i < count; i++) {
+                // larger datagrams are not used for ICE and are dropped
+                if (messages[i].msg_hdr.msg_flags & MSG_TRUNC) {
+                    continue;
+                }
+
+                const auto *address = reinterpret_cast<const sockaddr *>(&addresses[i]);
+                remoteHost.setAddress(address);
+                remotePort = address->sa_family == AF_INET6
+                    ? ntohs(reinterpret_cast<const sockaddr_in6 *>(address)->sin6_port)
+                    : ntohs(reinterpret_cast<const sockaddr_in *>(address)->sin_port);
+
+                handler(QByteArray(static_cast<const char *>(vectors[i].iov_base), int(messages[i].msg_len)), remoteHost, remotePort);
+            }
+        } while (count == UDP_BATCH_SIZE);
+    }
+#else
+    Q_UNUSED(batchBuffer)
+#endif
+
+    while (socket->hasPendingDatagrams()) {
+        buffer.resize(socket->pendingDatagramSize());
+        socket->readDatagram(buffer.data(), buffer.size(), &remoteHost, &remotePort);
+        handler(buffer, remoteHost, remotePort);
+    }
+}
+
 static const char *gathering_states[] = {
     "new",
     "gathering",
@@ -118,7 +220,99 @@ static bool isCompatibleAddress(const QHostAddress &a1, const QHostAddress &a2)
         isIPv6LinkLocalAddress(a1) == isIPv6LinkLocalAddress(a2);
 }
 
-static bool decodeAddress(QDataStream &stream, quint16 a_length, QHostAddress &address, quint16 &port, const QByteArray &xorId = QByteArray())
+// maximum number of HMAC keys cached per thread
+static constexpr int STUN_HMAC_KEY_CACHE_SIZE = 16;
+
+using namespace QXmpp::Private;
+
+//
+// Reads big-endian fields directly from a STUN datagram.
+//
+// Reading past the end yields zeros, like QDataStream does.
+//
+class StunReader
+{
+public:
+    explicit StunReader(const QByteArray &buffer)
+        : m_data(buffer.constData()), m_size(buffer.size())
+    {
+    }
+
+    template<typename T>
+    StunReader &operator>>(T &value)
+    {
+        static_assert(std::is_unsigned_v<T>);
+        if (m_size - m_position >= qsizetype(sizeof(T))) {
+            value = qFromBigEndian<T>(m_data + m_position);
+            m_position += sizeof(T);
+        } else {
+            value = 0;
+            m_position = m_size;
+        }
+        return *this;
+    }
+
+    void readRawData(char *data, qsizetype size)
+    {
+        const auto available = std::min(size, m_size - m_position);
+        std::memcpy(data, m_data + m_position, available);
+        std::memset(data + available, 0, size - available);
+        m_position += available;
+    }
+
+    void skipRawData(qsizetype size)
+    {
+        m_position += std::min(size, m_size - m_position);
+    }
+
+private:
+    const char *m_data;
+    qsizetype m_size;
+    qsizetype m_position = 0;
+};
+
+//
+// Appends big-endian fields to a STUN datagram.
+//
+class StunWriter
+{
+public:
+    explicit StunWriter(QByteArray &buffer)
+        : m_buffer(buffer)
+    {
+    }
+
+    template<typename T>
+    StunWriter &operator<<(T value)
+    {
+        static_assert(std::is_unsigned_v<T>);
+        char data[sizeof(T)];
+        qToBigEndian<T>(value, data);
+        m_buffer.append(data, sizeof(T));
+        return *this;
+    }
+
+    void writeRawData(const char *data, qsizetype size)
+    {
+        m_buffer.append(data, size);
+    }
+
+private:
+    QByteArray &m_buffer;
+};
+
+// XORs an IPv6 address with the magic cookie and the transaction ID.
+static void xorAddress(Q_IPV6ADDR &addr, const QByteArray &xorId)
+{
+    for (int i = 0; i < 4; i++) {
+        addr[i] ^= quint8(STUN_MAGIC >> (24 - 8 * i));
+    }
+    for (int i = 4; i < 16; i++) {
+        addr[i] ^= quint8(xorId[i - 4]);
+    }
+}
+
+static bool decodeAddress(StunReader &stream, quint16 a_length, QHostAddress &address, quint16 &port, const QByteArray &xorId = QByteArray())
 {
     if (a_length < 4) {
         return false;
@@ -151,12 +345,7 @@ static bool decodeAddress(QDataStream &stream, quint16 a_length, QHostAddress &a
         Q_IPV6ADDR addr;
         stream.readRawData((char *)&addr, sizeof(addr));
         if (!xorId.isEmpty()) {
-            QByteArray xpad;
-            QDataStream(&xpad, QIODevice::WriteOnly) << STUN_MAGIC;
-            xpad += xorId;
-            for (int i = 0; i < 16; i++) {
-                addr[i] ^= xpad[i];
-            }
+            xorAddress(addr, xorId);
         }
         address = QHostAddress(addr);
     } else {
@@ -165,7 +354,7 @@ static bool decodeAddress(QDataStream &stream, quint16 a_length, QHostAddress &a
     return true;
 }
 
-static void encodeAddress(QDataStream &stream, quint16 type, const QHostAddress &address, quint16 port, const QByteArray &xorId = QByteArray())
+static void encodeAddress(StunWriter &stream, quint16 type, const QHostAddress &address, quint16 port, const QByteArray &xorId = QByteArray())
 {
     const quint8 reserved = 0;
     if (address.protocol() == QAbstractSocket::IPv4Protocol) {
@@ -188,12 +377,7 @@ static void encodeAddress(QDataStream &stream, quint16 type, const QHostAddress
         Q_IPV6ADDR addr = address.toIPv6Address();
         if (!xorId.isEmpty()) {
             port ^= (STUN_MAGIC >> 16);
-            QByteArray xpad;
-            QDataStream(&xpad, QIODevice::WriteOnly) << STUN_MAGIC;
-            xpad += xorId;
-            for (int i = 0; i < 16; i++) {
-                addr[i] ^= xpad[i];
-            }
+            xorAddress(addr, xorId);
         }
         stream << port;
         stream.writeRawData((char *)&addr, sizeof(addr));
@@ -202,7 +386,7 @@ static void encodeAddress(QDataStream &stream, quint16 type, const QHostAddress
     }
 }
 
-static void addAddress(QDataStream &stream, quint16 type, const QHostAddress &host, quint16 port, const QByteArray &xorId = QByteArray())
+static void addAddress(StunWriter &stream, quint16 type, const QHostAddress &host, quint16 port, const QByteArray &xorId = QByteArray())
 {
     if (port && !host.isNull() &&
         (host.protocol() == QAbstractSocket::IPv4Protocol ||
@@ -211,23 +395,48 @@ static void addAddress(QDataStream &stream, quint16 type, const QHostAddress &ho
     }
 }
 
-static void encodeString(QDataStream &stream, quint16 type, const QString &string)
+//
+// Writes a padding of zeros up to the next multiple of four bytes.
+//
+static void encodePadding(StunWriter &stream, qsizetype size)
+{
+    static const char padding[4] = {};
+    if (size % 4) {
+        stream.writeRawData(padding, 4 - (size % 4));
+    }
+}
+
+static void encodeString(StunWriter &stream, quint16 type, const QString &string)
 {
     const QByteArray utf8string = string.toUtf8();
     stream << type;
     stream << quint16(utf8string.size());
     stream.writeRawData(utf8string.data(), utf8string.size());
-    if (utf8string.size() % 4) {
-        const QByteArray padding(4 - (utf8string.size() % 4), 0);
-        stream.writeRawData(padding.data(), padding.size());
-    }
+    encodePadding(stream, utf8string.size());
 }
 
-static void setBodyLength(QByteArray &buffer, qint16 length)
+static void setBodyLength(char *header, quint16 length)
 {
-    QDataStream stream(&buffer, QIODevice::WriteOnly);
-    stream.device()->seek(2);
-    stream << length;
+    qToBigEndian<quint16>(length, header + 2);
+}
+
+//
+// Returns the HMAC key context for a STUN credential.
+//
+// ICE agents sign and check every connectivity check with the same few
+// passwords, so the derived keys are cached per thread.
+//
+static const HmacKey &stunHmacKey(const QByteArray &key)
+{
+    thread_local QHash<QByteArray, HmacKey> keys;
+    auto itr = keys.constFind(key);
+    if (itr == keys.constEnd()) {
+        if (keys.size() >= STUN_HMAC_KEY_CACHE_SIZE) {
+            keys.clear();
+        }
+        itr = keys.insert(key, HmacKey(QCryptographicHash::Sha1, key));
+    }
+    return *itr;
 }
 
 /// Constructs a new QXmppStunMessage.
@@ -531,7 +740,7 @@ bool QXmppStunMessage::decode(const QByteArray &buffer, const QByteArray &key, Q
     }
 
     // parse STUN header
-    QDataStream stream(buffer);
+    StunReader stream(buffer);
     quint16 length;
     stream >> m_type;
     stream >> length;
@@ -552,6 +761,11 @@ bool QXmppStunMessage::decode(const QByteArray &buffer, const QByteArray &key, Q
         stream >> a_length;
         const int pad_length = 4 * ((a_length + 3) / 4) - a_length;
 
+        if (4 + a_length > length - done) {
+            *errors << QLatin1String("Received a truncated STUN attribute");
+            return false;
+        }
+
         // only FINGERPRINT is allowed after MESSAGE-INTEGRITY
         if (after_integrity && a_type != Fingerprint) {
             *errors << QString("Skipping attribute %1 after MESSAGE-INTEGRITY").arg(QString::number(a_type));
@@ -745,9 +959,12 @@ bool QXmppStunMessage::decode(const QByteArray &buffer, const QByteArray &key, Q
 
             // check HMAC-SHA1
             if (!key.isEmpty()) {
-                QByteArray copy = buffer.left(STUN_HEADER + done);
-                setBodyLength(copy, done + 24);
-                if (integrity != QXmppUtils::generateHmacSha1(key, copy)) {
+                std::array<char, STUN_HEADER> header;
+                std::memcpy(header.data(), buffer.constData(), STUN_HEADER);
+                setBodyLength(header.data(), done + 24);
+                const auto hmac = stunHmacKey(key).sign({ QByteArray::fromRawData(header.data(), STUN_HEADER),
+                                                          QByteArray::fromRawData(buffer.constData() + STUN_HEADER, done) });
+                if (integrity != hmac) {
                     *errors << QLatin1String("Bad message integrity");
                     return false;
                 }
@@ -766,9 +983,11 @@ bool QXmppStunMessage::decode(const QByteArray &buffer, const QByteArray &key, Q
             stream >> fingerprint;
 
             // check CRC32
-            QByteArray copy = buffer.left(STUN_HEADER + done);
-            setBodyLength(copy, done + 8);
-            const quint32 expected = QXmppUtils::generateCrc32(copy) ^ 0x5354554eL;
+            std::array<char, STUN_HEADER> header;
+            std::memcpy(header.data(), buffer.constData(), STUN_HEADER);
+            setBodyLength(header.data(), done + 8);
+            const quint32 crc = crc32(crc32(0, header.data(), STUN_HEADER), buffer.constData() + STUN_HEADER, done);
+            const quint32 expected = crc ^ 0x5354554eL;
             if (fingerprint != expected) {
                 *errors << QLatin1String("Bad fingerprint");
                 return false;
@@ -817,7 +1036,8 @@ bool QXmppStunMessage::decode(const QByteArray &buffer, const QByteArray &key, Q
 QByteArray QXmppStunMessage::encode(const QByteArray &key, bool addFingerprint) const
 {
     QByteArray buffer;
-    QDataStream stream(&buffer, QIODevice::WriteOnly);
+    buffer.reserve(256);
+    StunWriter stream(buffer);
 
     // encode STUN header
     quint16 length = 0;
@@ -866,10 +1086,7 @@ QByteArray QXmppStunMessage::encode(const QByteArray &key, bool addFingerprint)
         stream << errorCodeHigh;
         stream << errorCodeLow;
         stream.writeRawData(phrase.data(), phrase.size());
-        if (phrase.size() % 4) {
-            const QByteArray padding(4 - (phrase.size() % 4), 0);
-            stream.writeRawData(padding.data(), padding.size());
-        }
+        encodePadding(stream, phrase.size());
     }
 
     // PRIORITY
@@ -898,10 +1115,7 @@ QByteArray QXmppStunMessage::encode(const QByteArray &key, bool addFingerprint)
         stream << quint16(DataAttr);
         stream << quint16(m_data.size());
         stream.writeRawData(m_data.data(), m_data.size());
-        if (m_data.size() % 4) {
-            const QByteArray padding(4 - (m_data.size() % 4), 0);
-            stream.writeRawData(padding.data(), padding.size());
-        }
+        encodePadding(stream, m_data.size());
     }
 
     // LIFETIME
@@ -916,10 +1130,7 @@ QByteArray QXmppStunMessage::encode(const QByteArray &key, bool addFingerprint)
         stream << quint16(Nonce);
         stream << quint16(m_nonce.size());
         stream.writeRawData(m_nonce.data(), m_nonce.size());
-        if (m_nonce.size() % 4) {
-            const QByteArray padding(4 - (m_nonce.size() % 4), 0);
-            stream.writeRawData(padding.data(), padding.size());
-        }
+        encodePadding(stream, m_nonce.size());
     }
 
     // REALM
@@ -965,12 +1176,12 @@ QByteArray QXmppStunMessage::encode(const QByteArray &key, bool addFingerprint)
     }
 
     // set body length
-    setBodyLength(buffer, buffer.size() - STUN_HEADER);
+    setBodyLength(buffer.data(), buffer.size() - STUN_HEADER);
 
     // MESSAGE-INTEGRITY
     if (!key.isEmpty()) {
-        setBodyLength(buffer, buffer.size() - STUN_HEADER + 24);
-        QByteArray integrity = QXmppUtils::generateHmacSha1(key, buffer);
+        setBodyLength(buffer.data(), buffer.size() - STUN_HEADER + 24);
+        const QByteArray integrity = stunHmacKey(key).sign({ buffer });
         stream << quint16(MessageIntegrity);
         stream << quint16(integrity.size());
         stream.writeRawData(integrity.data(), integrity.size());
@@ -978,8 +1189,8 @@ QByteArray QXmppStunMessage::encode(const QByteArray &key, bool addFingerprint)
 
     // FINGERPRINT
     if (addFingerprint) {
-        setBodyLength(buffer, buffer.size() - STUN_HEADER + 8);
-        quint32 fingerprint = QXmppUtils::generateCrc32(buffer) ^ 0x5354554eL;
+        setBodyLength(buffer.data(), buffer.size() - STUN_HEADER + 8);
+        const quint32 fingerprint = crc32(0, buffer.constData(), buffer.size()) ^ 0x5354554eL;
         stream << quint16(Fingerprint);
         stream << quint16(sizeof(fingerprint));
         stream << fingerprint;
@@ -1003,7 +1214,7 @@ quint16 QXmppStunMessage::peekType(const QByteArray &buffer, quint32 &cookie, QB
     }
 
     // parse STUN header
-    QDataStream stream(buffer);
+    StunReader stream(buffer);
     quint16 type;
     quint16 length;
     stream >> type;
@@ -1175,13 +1386,10 @@ QXmppStunTransaction::QXmppStunTransaction(const QXmppStunMessage &request, QObj
     Q_ASSERT(check);
 
     // RTO timer
-    m_retryTimer = new QTimer(this);
-    m_retryTimer->setSingleShot(true);
-    connect(m_retryTimer, &QTimer::timeout,
-            this, &QXmppStunTransaction::retry);
+    m_retryTimer.setCallback([this] { retry(); });
 
     // send packet immediately
-    m_retryTimer->start(0);
+    QMetaObject::invokeMethod(this, &QXmppStunTransaction::retry, Qt::QueuedConnection);
 }
 
 void QXmppStunTransaction::readStun(const QXmppStunMessage &response)
@@ -1189,7 +1397,7 @@ void QXmppStunTransaction::readStun(const QXmppStunMessage &response)
     if (response.messageClass() == QXmppStunMessage::Error ||
         response.messageClass() == QXmppStunMessage::Response) {
         m_response = response;
-        m_retryTimer->stop();
+        m_retryTimer.stop();
         Q_EMIT finished();
     }
 }
@@ -1221,7 +1429,7 @@ void QXmppStunTransaction::retry()
 
     // resend request
     Q_EMIT writeStun(m_request);
-    m_retryTimer->start(m_tries ? 2 * m_retryTimer->interval() : STUN_RTO_INTERVAL);
+    m_retryTimer.start(m_tries ? 2 * m_retryTimer.interval() : STUN_RTO_INTERVAL);
     m_tries++;
 }
 
@@ -1344,22 +1552,16 @@ QXmppJingleCandidate QXmppTurnAllocation::localCandidate(int component) const
 
 void QXmppTurnAllocation::readyRead()
 {
-    QByteArray buffer;
-    QHostAddress remoteHost;
-    quint16 remotePort;
-    while (socket->hasPendingDatagrams()) {
-        const qint64 size = socket->pendingDatagramSize();
-        buffer.resize(size);
-        socket->readDatagram(buffer.data(), buffer.size(), &remoteHost, &remotePort);
+    readPendingDatagrams(socket, m_batchBuffer, [this](const QByteArray &buffer, const QHostAddress &remoteHost, quint16 remotePort) {
         handleDatagram(buffer, remoteHost, remotePort);
-    }
+    });
 }
 
 void QXmppTurnAllocation::handleDatagram(const QByteArray &buffer, const QHostAddress &remoteHost, quint16 remotePort)
 {
     // demultiplex channel data
     if (buffer.size() >= 4 && (buffer[0] & 0xc0) == 0x40) {
-        QDataStream stream(buffer);
+        StunReader stream(buffer);
         quint16 channel, length;
         stream >> channel;
         stream >> length;
@@ -1445,6 +1647,14 @@ quint16 QXmppTurnAllocation::relayedPort() const
     return m_relayedPort;
 }
 
+///
+/// Returns the password used to authenticate with the TURN server.
+///
+QString QXmppTurnAllocation::password() const
+{
+    return m_password;
+}
+
 ///
 /// Sets the password used to authenticate with the TURN server.
 ///
@@ -1455,6 +1665,22 @@ void QXmppTurnAllocation::setPassword(const QString &password)
     m_password = password;
 }
 
+///
+/// Returns the address of the TURN server.
+///
+QHostAddress QXmppTurnAllocation::serverHost() const
+{
+    return m_turnHost;
+}
+
+///
+/// Returns the port of the TURN server.
+///
+quint16 QXmppTurnAllocation::serverPort() const
+{
+    return m_turnPort;
+}
+
 ///
 /// Sets the TURN server to use.
 ///
@@ -1467,6 +1693,14 @@ void QXmppTurnAllocation::setServer(const QHostAddress &host, quint16 port)
     m_turnPort = port;
 }
 
+///
+/// Returns the user used for authentication with the TURN server.
+///
+QString QXmppTurnAllocation::user() const
+{
+    return m_username;
+}
+
 ///
 /// Sets the \a user used for authentication with the TURN server.
 ///
@@ -1621,7 +1855,7 @@ qint64 QXmppTurnAllocation::writeDatagram(const QByteArray &data, const QHostAdd
     // send data
     QByteArray channelData;
     channelData.reserve(4 + data.size());
-    QDataStream stream(&channelData, QIODevice::WriteOnly);
+    StunWriter stream(channelData);
     stream << channel;
     stream << quint16(data.size());
     stream.writeRawData(data.data(), data.size());
@@ -1681,15 +1915,9 @@ QXmppJingleCandidate QXmppUdpTransport::localCandidate(int component) const
 
 void QXmppUdpTransport::readyRead()
 {
-    QByteArray buffer;
-    QHostAddress remoteHost;
-    quint16 remotePort;
-    while (m_socket->hasPendingDatagrams()) {
-        const qint64 size = m_socket->pendingDatagramSize();
-        buffer.resize(size);
-        m_socket->readDatagram(buffer.data(), buffer.size(), &remoteHost, &remotePort);
+    readPendingDatagrams(m_socket, m_batchBuffer, [this](const QByteArray &buffer, const QHostAddress &remoteHost, quint16 remotePort) {
         Q_EMIT datagramReceived(buffer, remoteHost, remotePort);
-    }
+    });
 }
 
 qint64 QXmppUdpTransport::writeDatagram(const QByteArray &data, const QHostAddress &host, quint16 port)
@@ -1700,6 +1928,272 @@ qint64 QXmppUdpTransport::writeDatagram(const QByteArray &data, const QHostAddre
     }
     return m_socket->writeDatagram(data, remoteHost, port);
 }
+
+///
+/// Constructs a new QXmppTurnAllocationCache.
+///
+/// \param parent
+///
+QXmppTurnAllocationCache::QXmppTurnAllocationCache(QObject *parent)
+    : QXmppLoggable(parent),
+      m_timeout(TURN_ALLOCATION_CACHE_TIMEOUT)
+{
+}
+
+///
+/// Destroys the cache and releases all cached allocations.
+///
+QXmppTurnAllocationCache::~QXmppTurnAllocationCache()
+{
+    clear();
+}
+
+///
+/// Returns the time in seconds for which an unused allocation is kept.
+///
+int QXmppTurnAllocationCache::timeout() const
+{
+    return m_timeout;
+}
+
+///
+/// Sets the time in seconds for which an unused allocation is kept.
+///
+/// A timeout of 0 disables the cache.
+///
+void QXmppTurnAllocationCache::setTimeout(int timeout)
+{
+    m_timeout = std::max(timeout, 0);
+    if (!m_timeout) {
+        clear();
+    }
+}
+
+///
+/// Takes a connected allocation on the given TURN server out of the cache.
+///
+/// The caller becomes the owner of the allocation. Returns nullptr if there is
+/// no matching allocation.
+///
+QXmppTurnAllocation *QXmppTurnAllocationCache::take(const QHostAddress &host, quint16 port, const QString &user, const QString &password)
+{
+    const auto itr = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry &entry) {
+        return entry.allocation->serverHost() == host &&
+            entry.allocation->serverPort() == port &&
+            entry.allocation->user() == user &&
+            entry.allocation->password() == password;
+    });
+    if (itr == m_entries.end()) {
+        return nullptr;
+    }
+
+    auto *allocation = itr->allocation;
+    delete itr->expiryTimer;
+    m_entries.erase(itr);
+
+    allocation->disconnect(this);
+    allocation->setParent(nullptr);
+    debug(QStringLiteral("Reusing TURN allocation %1 port %2").arg(allocation->relayedHost().toString(), QString::number(allocation->relayedPort())));
+    return allocation;
+}
+
+///
+/// Hands over an allocation which is not used anymore.
+///
+/// Connected allocations are kept and refreshed until they are taken or the
+/// timeout expires. Returns false if the allocation could not be cached, in
+/// which case the caller stays its owner.
+///
+bool QXmppTurnAllocationCache::release(QXmppTurnAllocation *allocation)
+{
+    if (!m_timeout || allocation->state() != QXmppTurnAllocation::ConnectedState) {
+        return false;
+    }
+
+    // detach the allocation from its previous owner
+    if (auto *owner = allocation->parent()) {
+        allocation->disconnect(owner);
+    }
+    allocation->setParent(this);
+    connect(allocation, &QXmppTurnAllocation::disconnected, this, [this, allocation]() {
+        remove(allocation);
+    });
+
+    auto *expiryTimer = new QTimer(this);
+    expiryTimer->setSingleShot(true);
+    connect(expiryTimer, &QTimer::timeout, this, [this, allocation]() {
+        allocation->disconnectFromHost();
+        remove(allocation);
+    });
+    expiryTimer->start(m_timeout * 1000);
+
+    m_entries.push_back({ allocation, expiryTimer });
+    return true;
+}
+
+///
+/// Releases all cached allocations.
+///
+void QXmppTurnAllocationCache::clear()
+{
+    const auto entries = std::move(m_entries);
+    m_entries.clear();
+    for (const auto &entry : entries) {
+        delete entry.expiryTimer;
+        // the destructor ends the allocation on the server
+        delete entry.allocation;
+    }
+}
+
+void QXmppTurnAllocationCache::remove(QXmppTurnAllocation *allocation)
+{
+    const auto itr = std::find_if(m_entries.begin(), m_entries.end(), [allocation](const Entry &entry) {
+        return entry.allocation == allocation;
+    });
+    if (itr != m_entries.end()) {
+        itr->expiryTimer->deleteLater();
+        m_entries.erase(itr);
+    }
+
+    // a closing allocation is removed again once the server confirmed it
+    if (allocation->state() != QXmppTurnAllocation::ClosingState) {
+        allocation->deleteLater();
+    }
+}
+
+///
+/// Constructs a new QXmppIcePortPool for ICE connections with the given number
+/// of components.
+///
+/// \param componentCount
+/// \param parent
+///
+QXmppIcePortPool::QXmppIcePortPool(int componentCount, QObject *parent)
+    : QXmppLoggable(parent),
+      m_componentCount(componentCount),
+      m_size(0),
+      m_fillScheduled(false)
+{
+}
+
+///
+/// Destroys the pool and closes all unused sockets.
+///
+QXmppIcePortPool::~QXmppIcePortPool()
+{
+    clear();
+}
+
+///
+/// Returns the number of socket sets which are kept bound.
+///
+int QXmppIcePortPool::size() const
+{
+    return m_size;
+}
+
+///
+/// Sets the number of socket sets which are kept bound.
+///
+/// The sockets are bound from the event loop. A size of 0 disables the pool.
+///
+void QXmppIcePortPool::setSize(int size)
+{
+    m_size = std::max(size, 0);
+    while (int(m_entries.size()) > m_size) {
+        qDeleteAll(m_entries.back());
+        m_entries.pop_back();
+    }
+    scheduleFill();
+}
+
+///
+/// Returns the number of socket sets which are currently available.
+///
+int QXmppIcePortPool::availableCount() const
+{
+    return int(m_entries.size());
+}
+
+///
+/// Sets the addresses on which the sockets are bound.
+///
+/// By default, the addresses returned by
+/// QXmppIceComponent::discoverAddresses() are used.
+///
+void QXmppIcePortPool::setAddresses(const QList<QHostAddress> &addresses)
+{
+    m_addresses = addresses;
+    clear();
+    scheduleFill();
+}
+
+///
+/// Takes the sockets of one ICE connection out of the pool.
+///
+/// The sockets are ordered like the result of
+/// QXmppIceComponent::reservePorts(). The caller becomes their owner. Returns
+/// an empty list if there are no sockets for the given addresses and
+/// component count.
+///
+QList<QUdpSocket *> QXmppIcePortPool::take(const QList<QHostAddress> &addresses, int componentCount)
+{
+    if (m_entries.empty() || componentCount != m_componentCount || addresses != m_boundAddresses) {
+        return {};
+    }
+
+    auto sockets = std::move(m_entries.front());
+    m_entries.erase(m_entries.begin());
+    for (auto *socket : std::as_const(sockets)) {
+        socket->setParent(nullptr);
+    }
+
+    scheduleFill();
+    return sockets;
+}
+
+///
+/// Closes all unused sockets.
+///
+void QXmppIcePortPool::clear()
+{
+    for (const auto &sockets : m_entries) {
+        qDeleteAll(sockets);
+    }
+    m_entries.clear();
+}
+
+void QXmppIcePortPool::scheduleFill()
+{
+    if (!m_fillScheduled && int(m_entries.size()) < m_size) {
+        m_fillScheduled = true;
+        QTimer::singleShot(0, this, &QXmppIcePortPool::fill);
+    }
+}
+
+void QXmppIcePortPool::fill()
+{
+    m_fillScheduled = false;
+
+    // sockets bound on outdated addresses are useless
+    const auto addresses = m_addresses.isEmpty() ? QXmppIceComponent::discoverAddresses() : m_addresses;
+    if (addresses != m_boundAddresses) {
+        clear();
+        m_boundAddresses = addresses;
+    }
+    if (addresses.isEmpty()) {
+        return;
+    }
+
+    while (int(m_entries.size()) < m_size) {
+        auto sockets = QXmppIceComponent::reservePorts(addresses, m_componentCount, this);
+        if (sockets.isEmpty()) {
+            warning(QStringLiteral("Could not reserve ports for the ICE port pool"));
+            return;
+        }
+        m_entries.push_back(std::move(sockets));
+    }
+}
 /// \endcond
 
 class CandidatePair : public QXmppLoggable
@@ -1789,10 +2283,14 @@ public:
     QString remotePassword;
     QList<QPair<QHostAddress, quint16>> stunServers;
     QByteArray tieBreaker;
+    int checkInterval;
+    QPointer<QXmppTurnAllocationCache> turnAllocationCache;
+    QPointer<QXmppIcePortPool> portPool;
 };
 
 QXmppIcePrivate::QXmppIcePrivate()
-    : iceControlling(false)
+    : iceControlling(false),
+      checkInterval(ICE_CHECK_INTERVAL)
 {
     localUser = QXmppUtils::generateStanzaHash(4);
     localPassword = QXmppUtils::generateStanzaHash(22);
@@ -1813,7 +2311,10 @@ public:
     bool addRemoteCandidate(const QXmppJingleCandidate &candidate);
     CandidatePair *findPair(QXmppStunTransaction *transaction);
     void performCheck(CandidatePair *pair, bool nominate);
+    void queueTriggeredCheck(CandidatePair *pair);
+    void releaseTurnAllocation();
     void setSockets(QList<QUdpSocket *> sockets);
+    void setTurnAllocation(QXmppTurnAllocation *allocation);
     void setTurnServer(const QHostAddress &host, quint16 port);
     void setTurnUser(const QString &user);
     void setTurnPassword(const QString &password);
@@ -1830,10 +2331,16 @@ public:
 
     quint32 peerReflexivePriority;
     QList<QXmppJingleCandidate> remoteCandidates;
+    // indexes of the remote candidates by their address and port
+    QHash<QPair<QHostAddress, quint16>, int> remoteCandidateIndexes;
 
     QList<CandidatePair *> pairs;
+    // pairs to be checked before all ordinary checks
+    QList<CandidatePair *> triggeredChecks;
     QList<QXmppIceTransport *> transports;
     QTimer *timer;
+    // time since the last connectivity check has been sent
+    QElapsedTimer lastCheckTimer;
 
     // STUN server
     QMap<QXmppStunTransaction *, QXmppIceTransportDetails> stunTransactions;
@@ -1863,11 +2370,11 @@ bool QXmppIceComponentPrivate::addRemoteCandidate(const QXmppJingleCandidate &ca
         return false;
     }
 
-    for (const auto &c : std::as_const(remoteCandidates)) {
-        if (c.host() == candidate.host() && c.port() == candidate.port()) {
-            return false;
-        }
+    const auto address = qMakePair(candidate.host(), candidate.port());
+    if (remoteCandidateIndexes.contains(address)) {
+        return false;
     }
+    remoteCandidateIndexes.insert(address, remoteCandidates.size());
     remoteCandidates << candidate;
 
     for (auto *transport : std::as_const(transports)) {
@@ -1918,6 +2425,63 @@ void QXmppIceComponentPrivate::performCheck(CandidatePair *pair, bool nominate)
     pair->nominating = nominate;
     pair->setState(CandidatePair::InProgressState);
     pair->transaction = new QXmppStunTransaction(message, q);
+    lastCheckTimer.start();
+}
+
+//
+// Queues a triggered check, e.g., after a check from the remote party has been
+// received on a pair.
+//
+// The check is sent immediately if no check has been sent during the last
+// check interval, otherwise it is sent on the next tick of the check timer
+// before any ordinary check.
+//
+void QXmppIceComponentPrivate::queueTriggeredCheck(CandidatePair *pair)
+{
+    if (!triggeredChecks.contains(pair)) {
+        triggeredChecks << pair;
+    }
+
+    if (!lastCheckTimer.isValid() || lastCheckTimer.elapsed() >= config->checkInterval) {
+        q->checkCandidates();
+    }
+}
+
+void QXmppIceComponentPrivate::releaseTurnAllocation()
+{
+    if (!config->turnAllocationCache || turnAllocation->state() != QXmppTurnAllocation::ConnectedState) {
+        return;
+    }
+
+    auto *allocation = turnAllocation;
+    auto *replacement = new QXmppTurnAllocation;
+    replacement->setServer(allocation->serverHost(), allocation->serverPort());
+    replacement->setUser(allocation->user());
+    replacement->setPassword(allocation->password());
+    if (!config->turnAllocationCache->release(allocation)) {
+        delete replacement;
+        return;
+    }
+
+    // forget about the pairs using the allocation
+    for (auto itr = pairs.begin(); itr != pairs.end();) {
+        auto *pair = *itr;
+        if (pair->transport == allocation) {
+            triggeredChecks.removeAll(pair);
+            if (fallbackPair == pair) {
+                fallbackPair = nullptr;
+            }
+            if (activePair == pair) {
+                activePair = nullptr;
+            }
+            delete pair;
+            itr = pairs.erase(itr);
+        } else {
+            ++itr;
+        }
+    }
+    transports.removeAll(allocation);
+    setTurnAllocation(replacement);
 }
 
 void QXmppIceComponentPrivate::setSockets(QList<QUdpSocket *> sockets)
@@ -1925,6 +2489,7 @@ void QXmppIceComponentPrivate::setSockets(QList<QUdpSocket *> sockets)
 
     // clear previous candidates and sockets
     localCandidates.clear();
+    triggeredChecks.clear();
     qDeleteAll(pairs);
     for (auto *transport : std::as_const(transports)) {
         if (transport != turnAllocation) {
@@ -1964,15 +2529,38 @@ void QXmppIceComponentPrivate::setSockets(QList<QUdpSocket *> sockets)
         }
     }
 
-    // connect to TURN server
+    // connect to TURN server, reusing a cached allocation if possible
     if (turnConfigured) {
+        if (config->turnAllocationCache && turnAllocation->state() == QXmppTurnAllocation::UnconnectedState) {
+            if (auto *allocation = config->turnAllocationCache->take(turnAllocation->serverHost(), turnAllocation->serverPort(), turnAllocation->user(), turnAllocation->password())) {
+                delete turnAllocation;
+                setTurnAllocation(allocation);
+            }
+        }
+
         transports << turnAllocation;
-        turnAllocation->connectToHost();
+        if (turnAllocation->state() == QXmppTurnAllocation::ConnectedState) {
+            localCandidates << turnAllocation->localCandidate(component);
+        } else {
+            turnAllocation->connectToHost();
+        }
     }
 
     q->updateGatheringState();
 }
 
+void QXmppIceComponentPrivate::setTurnAllocation(QXmppTurnAllocation *allocation)
+{
+    allocation->setParent(q);
+    QObject::connect(allocation, &QXmppTurnAllocation::connected,
+                     q, &QXmppIceComponent::turnConnected);
+    QObject::connect(allocation, &QXmppIceTransport::datagramReceived,
+                     q, &QXmppIceComponent::handleDatagram);
+    QObject::connect(allocation, &QXmppTurnAllocation::disconnected,
+                     q, &QXmppIceComponent::updateGatheringState);
+    turnAllocation = allocation;
+}
+
 void QXmppIceComponentPrivate::setTurnServer(const QHostAddress &host, quint16 port)
 {
     turnAllocation->setServer(host, port);
@@ -2009,17 +2597,11 @@ QXmppIceComponent::QXmppIceComponent(int component, QXmppIcePrivate *config, QOb
     d = new QXmppIceComponentPrivate(component, config, this);
 
     d->timer = new QTimer(this);
-    d->timer->setInterval(500);
+    d->timer->setInterval(config->checkInterval);
     connect(d->timer, &QTimer::timeout,
             this, &QXmppIceComponent::checkCandidates);
 
-    d->turnAllocation = new QXmppTurnAllocation(this);
-    connect(d->turnAllocation, &QXmppTurnAllocation::connected,
-            this, &QXmppIceComponent::turnConnected);
-    connect(d->turnAllocation, &QXmppIceTransport::datagramReceived,
-            this, &QXmppIceComponent::handleDatagram);
-    connect(d->turnAllocation, &QXmppTurnAllocation::disconnected,
-            this, &QXmppIceComponent::updateGatheringState);
+    d->setTurnAllocation(new QXmppTurnAllocation(this));
 
     // calculate peer-reflexive candidate priority
     // see RFC 5245 -  7.1.2.1. PRIORITY and USE-CANDIDATE
@@ -2056,6 +2638,16 @@ void QXmppIceComponent::checkCandidates()
     }
     debug(QStringLiteral("Checking remote candidates"));
 
+    // triggered checks are sent first, see RFC 8445 section 6.1.4.2
+    while (!d->triggeredChecks.isEmpty()) {
+        auto *pair = d->triggeredChecks.takeFirst();
+        if (pair->state() != CandidatePair::InProgressState && pair->state() != CandidatePair::SucceededState) {
+            d->performCheck(pair, pair->nominating);
+            return;
+        }
+    }
+
+    // pairs are sorted by priority
     for (auto *pair : std::as_const(d->pairs)) {
         if (pair->state() == CandidatePair::WaitingState) {
             d->performCheck(pair, d->config->iceControlling);
@@ -2069,6 +2661,9 @@ void QXmppIceComponent::checkCandidates()
 ///
 void QXmppIceComponent::close()
 {
+    // keep a connected TURN allocation for the next connection
+    d->releaseTurnAllocation();
+
     for (auto *transport : std::as_const(d->transports)) {
         transport->disconnectFromHost();
     }
@@ -2087,7 +2682,7 @@ void QXmppIceComponent::connectToHost()
     }
 
     checkCandidates();
-    d->timer->start();
+    d->timer->start(d->config->checkInterval);
 }
 
 ///
@@ -2195,15 +2790,10 @@ void QXmppIceComponent::handleDatagram(const QByteArray &buffer, const QHostAddr
 
         // find or create remote candidate
         QXmppJingleCandidate remoteCandidate;
-        bool remoteCandidateFound = false;
-        for (const auto &c : std::as_const(d->remoteCandidates)) {
-            if (c.host() == remoteHost && c.port() == remotePort) {
-                remoteCandidate = c;
-                remoteCandidateFound = true;
-                break;
-            }
-        }
-        if (!remoteCandidateFound) {
+        const auto address = qMakePair(remoteHost, remotePort);
+        if (const auto itr = d->remoteCandidateIndexes.constFind(address); itr != d->remoteCandidateIndexes.constEnd()) {
+            remoteCandidate = d->remoteCandidates.at(*itr);
+        } else {
             // 7.2.1.3. Learning Peer Reflexive Candidates
             remoteCandidate.setComponent(d->component);
             remoteCandidate.setHost(remoteHost);
@@ -2214,6 +2804,7 @@ void QXmppIceComponent::handleDatagram(const QByteArray &buffer, const QHostAddr
             remoteCandidate.setType(QXmppJingleCandidate::PeerReflexiveType);
             remoteCandidate.setFoundation(QXmppUtils::generateStanzaHash(32));
 
+            d->remoteCandidateIndexes.insert(address, d->remoteCandidates.size());
             d->remoteCandidates << remoteCandidate;
         }
 
@@ -2239,7 +2830,8 @@ void QXmppIceComponent::handleDatagram(const QByteArray &buffer, const QHostAddr
         case CandidatePair::FailedState:
             // send a triggered connectivity test
             if (!d->config->remoteUser.isEmpty()) {
-                d->performCheck(pair, pair->nominating || d->config->iceControlling || message.useCandidate);
+                pair->nominating = pair->nominating || d->config->iceControlling || message.useCandidate;
+                d->queueTriggeredCheck(pair);
             }
             break;
         case CandidatePair::InProgressState:
@@ -2404,10 +2996,32 @@ static QList<QUdpSocket *> reservePort(const QList<QHostAddress> &addresses, qui
     return sockets;
 }
 
-///
-/// Returns the list of local network addresses.
-///
-QList<QHostAddress> QXmppIceComponent::discoverAddresses()
+// Process-wide cache of the local addresses, see discoverAddresses().
+struct IceAddressCache
+{
+    QMutex mutex;
+    QList<QHostAddress> addresses;
+    // invalid if nothing is cached
+    QElapsedTimer age;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 1, 0)
+    QPointer<QNetworkInformation> networkInformation;
+#endif
+};
+
+static IceAddressCache &iceAddressCache()
+{
+    static IceAddressCache cache;
+    return cache;
+}
+
+static void clearIceAddressCache()
+{
+    auto &cache = iceAddressCache();
+    QMutexLocker locker(&cache.mutex);
+    cache.age.invalidate();
+}
+
+static QList<QHostAddress> enumerateAddresses()
 {
     QList<QHostAddress> addresses;
     const auto interfaces = QNetworkInterface::allInterfaces();
@@ -2444,6 +3058,36 @@ QList<QHostAddress> QXmppIceComponent::discoverAddresses()
     return addresses;
 }
 
+///
+/// Returns the list of local network addresses.
+///
+/// Enumerating the network interfaces is slow on some platforms, so the result
+/// is cached for a few seconds. If the application has loaded a
+/// QNetworkInformation backend, the cache is also cleared whenever the
+/// reachability of the network changes.
+///
+QList<QHostAddress> QXmppIceComponent::discoverAddresses()
+{
+    auto &cache = iceAddressCache();
+    QMutexLocker locker(&cache.mutex);
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 1, 0)
+    if (auto *info = QNetworkInformation::instance(); info && cache.networkInformation != info) {
+        cache.networkInformation = info;
+        QObject::connect(info, &QNetworkInformation::reachabilityChanged, info, [] {
+            clearIceAddressCache();
+        });
+        cache.age.invalidate();
+    }
+#endif
+
+    if (!cache.age.isValid() || cache.age.hasExpired(ICE_ADDRESS_CACHE_TIMEOUT)) {
+        cache.addresses = enumerateAddresses();
+        cache.age.start();
+    }
+    return cache.addresses;
+}
+
 ///
 /// Tries to bind \a count UDP sockets on each of the given \a addresses.
 ///
@@ -2636,6 +3280,34 @@ void QXmppIceConnection::addComponent(int component)
     d->components[component] = socket;
 }
 
+///
+/// Removes a component from this ICE connection and closes its sockets, for
+/// instance the RTCP component when RTCP is multiplexed with RTP.
+///
+/// \param component
+///
+/// \since QXmpp 1.6
+///
+void QXmppIceConnection::removeComponent(int component)
+{
+    auto *socket = d->components.take(component);
+    if (!socket) {
+        warning(QStringLiteral("Not removing unknown component %1").arg(QString::number(component)));
+        return;
+    }
+
+    socket->disconnect(this);
+    socket->close();
+    socket->deleteLater();
+
+    // the remaining components may be complete now
+    Q_EMIT localCandidatesChanged();
+    slotGatheringStateChanged();
+    if (d->connectTimer->isActive()) {
+        slotConnected();
+    }
+}
+
 ///
 /// Adds a candidate for one of the remote components.
 ///
@@ -2658,9 +3330,17 @@ void QXmppIceConnection::addRemoteCandidate(const QXmppJingleCandidate &candidat
 ///
 bool QXmppIceConnection::bind(const QList<QHostAddress> &addresses)
 {
-    // reserve ports
-    QList<QUdpSocket *> sockets = QXmppIceComponent::reservePorts(addresses, d->components.size());
+    // reserve ports, if possible using pre-bound sockets
+    QList<QUdpSocket *> sockets;
+    if (d->portPool) {
+        sockets = d->portPool->take(addresses, d->components.size());
+    }
+    if (sockets.isEmpty()) {
+        sockets = QXmppIceComponent::reservePorts(addresses, d->components.size());
+    }
     if (sockets.isEmpty() && !addresses.isEmpty()) {
+        // the addresses may be outdated
+        clearIceAddressCache();
         return false;
     }
 
@@ -2731,6 +3411,34 @@ void QXmppIceConnection::setIceControlling(bool controlling)
     d->iceControlling = controlling;
 }
 
+///
+/// Returns the interval in milliseconds in which connectivity checks are sent
+/// per component (Ta).
+///
+/// \since QXmpp 1.6
+///
+int QXmppIceConnection::checkInterval() const
+{
+    return d->checkInterval;
+}
+
+///
+/// Sets the interval in milliseconds in which connectivity checks are sent
+/// per component (Ta).
+///
+/// Checks triggered by checks of the remote party are sent immediately if no
+/// check has been sent during the last interval.
+/// The default is 50 ms as recommended by RFC 8445.
+///
+/// \a note This must be called before connecting.
+///
+/// \since QXmpp 1.6
+///
+void QXmppIceConnection::setCheckInterval(int interval)
+{
+    d->checkInterval = std::max(1, interval);
+}
+
 ///
 /// Returns the list of local HOST CANDIDATES candidates by iterating
 /// over the available network interfaces.
@@ -2857,6 +3565,29 @@ void QXmppIceConnection::setTurnPassword(const QString &password)
     }
 }
 
+/// \cond
+///
+/// Sets the cache from which TURN allocations are taken when binding and to
+/// which they are handed over when the connection is closed.
+///
+/// \note This may only be called prior to calling bind().
+///
+void QXmppIceConnection::setTurnAllocationCache(QXmppTurnAllocationCache *cache)
+{
+    d->turnAllocationCache = cache;
+}
+
+///
+/// Sets the pool from which pre-bound sockets are taken when binding.
+///
+/// \note This may only be called prior to calling bind().
+///
+void QXmppIceConnection::setPortPool(QXmppIcePortPool *pool)
+{
+    d->portPool = pool;
+}
+/// \endcond
+
 void QXmppIceConnection::slotConnected()
 {
     for (auto *socket : std::as_const(d->components)) {
@@ -16,7 +16,9 @@ class QUdpSocket;
 class QTimer;
 class QXmppIceComponentPrivate;
 class QXmppIceConnectionPrivate;
+class QXmppIcePortPool;
 class QXmppIcePrivate;
+class QXmppTurnAllocationCache;
 
 ///
 /// \internal
@@ -249,8 +251,12 @@ public:
 
     QXmppIceComponent *component(int component);
     void addComponent(int component);
+    void removeComponent(int component);
     void setIceControlling(bool controlling);
 
+    int checkInterval() const;
+    void setCheckInterval(int interval);
+
     QList<QXmppJingleCandidate> localCandidates() const;
     QString localUser() const;
     QString localPassword() const;
@@ -264,6 +270,10 @@ public:
     void setTurnServer(const QHostAddress &host, quint16 port = 3478);
     void setTurnUser(const QString &user);
     void setTurnPassword(const QString &password);
+    /// \cond
+    void setTurnAllocationCache(QXmppTurnAllocationCache *cache);
+    void setPortPool(QXmppIcePortPool *pool);
+    /// \endcond
 
     bool bind(const QList<QHostAddress> &addresses);
     bool isConnected() const;
@@ -6,6 +6,9 @@
 #define QXMPPSTUN_P_H
 
 #include "QXmppStun.h"
+#include "QXmppTimerWheel_p.h"
+
+#include <vector>
 
 class QUdpSocket;
 class QTimer;
@@ -47,7 +50,7 @@ private Q_SLOTS:
 private:
     QXmppStunMessage m_request;
     QXmppStunMessage m_response;
-    QTimer *m_retryTimer;
+    QXmpp::Private::WheelTimer m_retryTimer;
     int m_tries;
 };
 
@@ -93,8 +96,12 @@ public:
     quint16 relayedPort() const;
     AllocationState state() const;
 
+    QHostAddress serverHost() const;
+    quint16 serverPort() const;
     void setServer(const QHostAddress &host, quint16 port = 3478);
+    QString user() const;
     void setUser(const QString &user);
+    QString password() const;
     void setPassword(const QString &password);
 
     QXmppJingleCandidate localCandidate(int component) const override;
@@ -144,6 +151,9 @@ private:
     QByteArray m_nonce;
     AllocationState m_state;
     QList<QXmppStunTransaction *> m_transactions;
+
+    // buffer for receiving datagrams in batches
+    std::vector<char> m_batchBuffer;
 };
 
 ///
@@ -168,6 +178,75 @@ private Q_SLOTS:
 
 private:
     QUdpSocket *m_socket;
+
+    // buffer for receiving datagrams in batches
+    std::vector<char> m_batchBuffer;
+};
+
+///
+/// The QXmppTurnAllocationCache class keeps the TURN allocations of closed
+/// ICE components for a limited time, so they can be reused by the next ICE
+/// connection using the same TURN server.
+///
+class QXMPP_EXPORT QXmppTurnAllocationCache : public QXmppLoggable
+{
+    Q_OBJECT
+
+public:
+    QXmppTurnAllocationCache(QObject *parent = nullptr);
+    ~QXmppTurnAllocationCache() override;
+
+    int timeout() const;
+    void setTimeout(int timeout);
+
+    QXmppTurnAllocation *take(const QHostAddress &host, quint16 port, const QString &user, const QString &password);
+    bool release(QXmppTurnAllocation *allocation);
+    void clear();
+
+private:
+    void remove(QXmppTurnAllocation *allocation);
+
+    struct Entry
+    {
+        QXmppTurnAllocation *allocation;
+        QTimer *expiryTimer;
+    };
+
+    int m_timeout;
+    std::vector<Entry> m_entries;
+};
+
+///
+/// The QXmppIcePortPool class keeps UDP sockets bound in advance, so ICE
+/// connections can be bound without probing for free ports.
+///
+class QXMPP_EXPORT QXmppIcePortPool : public QXmppLoggable
+{
+    Q_OBJECT
+
+public:
+    QXmppIcePortPool(int componentCount, QObject *parent = nullptr);
+    ~QXmppIcePortPool() override;
+
+    int size() const;
+    void setSize(int size);
+    int availableCount() const;
+
+    void setAddresses(const QList<QHostAddress> &addresses);
+
+    QList<QUdpSocket *> take(const QList<QHostAddress> &addresses, int componentCount);
+    void clear();
+
+private:
+    void scheduleFill();
+    void fill();
+
+    const int m_componentCount;
+    int m_size;
+    bool m_fillScheduled;
+    QList<QHostAddress> m_addresses;
+    QList<QHostAddress> m_boundAddresses;
+    std::vector<QList<QUdpSocket *>> m_entries;
 };
 
 #endif
@@ -11,29 +11,95 @@ namespace QXmpp::Private {
 struct TaskData
 {
     QPointer<QObject> context;
-    std::function<void(TaskPrivate &, void *)> continuation;
+    // without a context the continuation is always called
+    bool hasContext = false;
+    TaskContinuation continuation;
+    // called if the task is cancelled before it has finished
+    TaskContinuation cancellationHandler;
     void *result = nullptr;
     void (*freeResult)(void *);
+    // shared by the promise and its tasks, all in the same thread
+    int refs = 1;
+    // TaskWeakRefs, they keep the allocation but not its contents alive
+    int weakRefs = 0;
     bool finished = false;
+    bool cancelled = false;
 
-    ~TaskData()
+    ~TaskData() { clear(); }
+
+    void clear()
     {
+        continuation.reset();
+        cancellationHandler.reset();
         if (freeResult) {
             freeResult(result);
         }
+        result = nullptr;
     }
 };
 
+static void release(TaskData *d)
+{
+    if (d && --d->refs == 0) {
+        if (d->weakRefs == 0) {
+            delete d;
+        } else {
+            // the continuations may hold weak references to the state itself
+            d->weakRefs++;
+            d->clear();
+            if (--d->weakRefs == 0) {
+                delete d;
+            }
+        }
+    }
+}
+
 }  // namespace QXmpp::Private
 
 QXmpp::Private::TaskPrivate::TaskPrivate(void (*freeResult)(void *))
-    : d(std::make_shared<QXmpp::Private::TaskData>())
+    : d(new QXmpp::Private::TaskData)
 {
     d->freeResult = freeResult;
 }
 
+QXmpp::Private::TaskPrivate::TaskPrivate(TaskData *data)
+    : d(data)
+{
+    d->refs++;
+}
+
+QXmpp::Private::TaskPrivate::TaskPrivate(const TaskPrivate &other)
+    : d(other.d)
+{
+    d->refs++;
+}
+
+QXmpp::Private::TaskPrivate::TaskPrivate(TaskPrivate &&other) noexcept
+    : d(std::exchange(other.d, nullptr))
+{
+}
+
 QXmpp::Private::TaskPrivate::~TaskPrivate()
 {
+    release(d);
+}
+
+QXmpp::Private::TaskPrivate &QXmpp::Private::TaskPrivate::operator=(const TaskPrivate &other)
+{
+    // in this order for self-assignment
+    other.d->refs++;
+    release(d);
+    d = other.d;
+    return *this;
+}
+
+QXmpp::Private::TaskPrivate &QXmpp::Private::TaskPrivate::operator=(TaskPrivate &&other) noexcept
+{
+    if (this != &other) {
+        release(d);
+        d = std::exchange(other.d, nullptr);
+    }
+    return *this;
 }
 
 bool QXmpp::Private::TaskPrivate::isFinished() const
@@ -44,16 +110,44 @@ bool QXmpp::Private::TaskPrivate::isFinished() const
 void QXmpp::Private::TaskPrivate::setFinished(bool finished)
 {
     d->finished = finished;
+    if (finished) {
+        // may capture other tasks, which shouldn't be kept alive
+        d->cancellationHandler.reset();
+    }
+}
+
+bool QXmpp::Private::TaskPrivate::isCancelled() const
+{
+    return d->cancelled;
+}
+
+void QXmpp::Private::TaskPrivate::cancel()
+{
+    if (d->finished || d->cancelled) {
+        return;
+    }
+    d->cancelled = true;
+    d->continuation.reset();
+
+    if (auto handler = std::move(d->cancellationHandler)) {
+        handler(*this, nullptr);
+    }
+}
+
+void QXmpp::Private::TaskPrivate::setCancellationHandler(TaskContinuation &&handler)
+{
+    d->cancellationHandler = std::move(handler);
 }
 
 bool QXmpp::Private::TaskPrivate::isContextAlive()
 {
-    return !d->context.isNull();
+    return !d->hasContext || !d->context.isNull();
 }
 
 void QXmpp::Private::TaskPrivate::setContext(QObject *obj)
 {
     d->context = obj;
+    d->hasContext = obj != nullptr;
 }
 
 void *QXmpp::Private::TaskPrivate::result() const
@@ -69,17 +163,55 @@ void QXmpp::Private::TaskPrivate::setResult(void *result)
     d->result = result;
 }
 
-const std::function<void(QXmpp::Private::TaskPrivate &, void *)> QXmpp::Private::TaskPrivate::continuation() const
+bool QXmpp::Private::TaskPrivate::hasContinuation() const
 {
-    return d->continuation;
+    return bool(d->continuation);
 }
 
-void QXmpp::Private::TaskPrivate::setContinuation(std::function<void(TaskPrivate &, void *)> &&continuation)
+void QXmpp::Private::TaskPrivate::setContinuation(TaskContinuation &&continuation)
 {
-    d->continuation = continuation;
+    d->continuation = std::move(continuation);
 }
 
 void QXmpp::Private::TaskPrivate::invokeContinuation(void *result)
 {
-    d->continuation(*this, result);
+    // The continuation is removed before it is called: it may capture the
+    // task (which would keep the state alive forever) or set a new
+    // continuation.
+    auto continuation = std::move(d->continuation);
+    continuation(*this, result);
+}
+
+QXmpp::Private::TaskWeakRef::TaskWeakRef(const TaskPrivate &task)
+    : d(task.d)
+{
+    d->weakRefs++;
+}
+
+QXmpp::Private::TaskWeakRef::TaskWeakRef(const TaskWeakRef &other)
+    : d(other.d)
+{
+    if (d) {
+        d->weakRefs++;
+    }
+}
+
+QXmpp::Private::TaskWeakRef::TaskWeakRef(TaskWeakRef &&other) noexcept
+    : d(std::exchange(other.d, nullptr))
+{
+}
+
+QXmpp::Private::TaskWeakRef::~TaskWeakRef()
+{
+    if (d && --d->weakRefs == 0 && d->refs == 0) {
+        delete d;
+    }
+}
+
+void QXmpp::Private::TaskWeakRef::cancel()
+{
+    if (d && d->refs > 0) {
+        // keeps the state alive while the cancellation handler runs
+        TaskPrivate(d).cancel();
+    }
 }
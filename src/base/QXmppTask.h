@@ -8,41 +8,287 @@
 
 #include "qxmpp_export.h"
 
+#include <cstddef>
 #include <functional>
 #include <memory>
+#include <new>
 #include <optional>
+#include <type_traits>
+#include <utility>
 
 #include <QFuture>
 #include <QPointer>
+#include <QThread>
+
+// C++20 coroutines, co_await on tasks and coroutines returning tasks
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define QXMPP_COROUTINES
+#endif
 
 template<typename T>
 class QXmppPromise;
+template<typename T>
+class QXmppTask;
 
 namespace QXmpp::Private {
 
 struct TaskData;
+class TaskPrivate;
+class TaskWeakRef;
+
+//
+// Type-erased continuation of a task.
+//
+// Unlike std::function this is move-only, so the continuation is never
+// copied. Functions that are small enough (e.g. lambdas capturing a few
+// pointers, a promise and a string) are stored inline without allocating.
+//
+class TaskContinuation
+{
+public:
+    TaskContinuation() = default;
+
+    template<typename F, std::enable_if_t<!std::is_same_v<std::decay_t<F>, TaskContinuation>> * = nullptr>
+    explicit TaskContinuation(F &&function)
+    {
+        using Function = std::decay_t<F>;
+        if constexpr (isStoredInline<Function>()) {
+            new (m_storage) Function(std::forward<F>(function));
+            m_operations = &inlineOperations<Function>;
+        } else {
+            *reinterpret_cast<Function **>(m_storage) = new Function(std::forward<F>(function));
+            m_operations = &heapOperations<Function>;
+        }
+    }
+
+    TaskContinuation(TaskContinuation &&other) noexcept
+    {
+        moveFrom(other);
+    }
+
+    TaskContinuation &operator=(TaskContinuation &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    ~TaskContinuation() { reset(); }
+
+    explicit operator bool() const { return m_operations != nullptr; }
+
+    void operator()(TaskPrivate &task, void *result)
+    {
+        m_operations->invoke(m_storage, task, result);
+    }
+
+    void reset()
+    {
+        if (m_operations) {
+            m_operations->destroy(m_storage);
+            m_operations = nullptr;
+        }
+    }
+
+private:
+    struct Operations
+    {
+        void (*invoke)(void *storage, TaskPrivate &task, void *result);
+        // move-constructs into an uninitialized storage and destroys the source
+        void (*move)(void *from, void *to);
+        void (*destroy)(void *storage);
+    };
+
+    static constexpr std::size_t InlineSize = 6 * sizeof(void *);
+
+    template<typename Function>
+    static constexpr bool isStoredInline()
+    {
+        return sizeof(Function) <= InlineSize &&
+            alignof(Function) <= alignof(std::max_align_t) &&
+            std::is_nothrow_move_constructible_v<Function>;
+    }
+
+    template<typename Function>
+    static constexpr Operations inlineOperations = {
+        [](void *storage, TaskPrivate &task, void *result) {
+            (*std::launder(reinterpret_cast<Function *>(storage)))(task, result);
+        },
+        [](void *from, void *to) {
+            auto *function = std::launder(reinterpret_cast<Function *>(from));
+            new (to) Function(std::move(*function));
+            function->~Function();
+        },
+        [](void *storage) {
+            std::launder(reinterpret_cast<Function *>(storage))->~Function();
+        },
+    };
+
+    template<typename Function>
+    static constexpr Operations heapOperations = {
+        [](void *storage, TaskPrivate &task, void *result) {
+            (**reinterpret_cast<Function **>(storage))(task, result);
+        },
+        [](void *from, void *to) {
+            *reinterpret_cast<Function **>(to) = *reinterpret_cast<Function **>(from);
+        },
+        [](void *storage) {
+            delete *reinterpret_cast<Function **>(storage);
+        },
+    };
+
+    void moveFrom(TaskContinuation &other) noexcept
+    {
+        if (other.m_operations) {
+            other.m_operations->move(other.m_storage, m_storage);
+            m_operations = std::exchange(other.m_operations, nullptr);
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char m_storage[InlineSize];
+    const Operations *m_operations = nullptr;
+};
 
+//
+// Shared state of a promise and its tasks.
+//
+// Tasks are not thread-safe, so the state is reference counted without
+// atomic operations.
+//
 class QXMPP_EXPORT TaskPrivate
 {
 public:
     TaskPrivate(void (*freeResult)(void *));
+    TaskPrivate(const TaskPrivate &);
+    TaskPrivate(TaskPrivate &&) noexcept;
     ~TaskPrivate();
 
+    TaskPrivate &operator=(const TaskPrivate &);
+    TaskPrivate &operator=(TaskPrivate &&) noexcept;
+
     bool isFinished() const;
     void setFinished(bool);
+    bool isCancelled() const;
+    void cancel();
+    void setCancellationHandler(TaskContinuation &&);
     bool isContextAlive();
     void setContext(QObject *);
     void *result() const;
     void setResult(void *);
     void resetResult() { setResult(nullptr); }
-    const std::function<void(TaskPrivate &, void *)> continuation() const;
-    void setContinuation(std::function<void(TaskPrivate &, void *)> &&);
+    bool hasContinuation() const;
+    void setContinuation(TaskContinuation &&);
     void invokeContinuation(void *result);
 
 private:
-    std::shared_ptr<TaskData> d;
+    friend class TaskWeakRef;
+    explicit TaskPrivate(TaskData *);
+
+    TaskData *d;
+};
+
+//
+// Reference to the shared state of a task that does not keep the result and
+// the continuations alive.
+//
+// Used to forward the cancellation of a task to the task it has been created
+// from, without a reference cycle between both states.
+//
+class QXMPP_EXPORT TaskWeakRef
+{
+public:
+    explicit TaskWeakRef(const TaskPrivate &);
+    TaskWeakRef(const TaskWeakRef &);
+    TaskWeakRef(TaskWeakRef &&) noexcept;
+    ~TaskWeakRef();
+
+    TaskWeakRef &operator=(const TaskWeakRef &) = delete;
+    TaskWeakRef &operator=(TaskWeakRef &&) = delete;
+
+    // cancels the task, unless all of its references are gone
+    void cancel();
+
+private:
+    TaskData *d;
 };
 
+#ifdef QXMPP_COROUTINES
+//
+// Awaiter of a task in a coroutine.
+//
+// With a context, the coroutine is resumed in the thread of the context. If
+// the context has been deleted when the task finishes, the coroutine is
+// destroyed without being resumed.
+//
+template<typename T>
+class TaskAwaiter
+{
+public:
+    TaskAwaiter(QXmppTask<T> task, QObject *context, bool hasContext)
+        : m_task(std::move(task)), m_context(context), m_hasContext(hasContext)
+    {
+    }
+
+    bool await_ready() const
+    {
+        return m_task.isFinished() && (!m_hasContext || isInContextThread());
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        if (m_task.isFinished()) {
+            resume(handle);
+        } else if constexpr (std::is_void_v<T>) {
+            m_task.then(nullptr, [this, handle]() {
+                resume(handle);
+            });
+        } else {
+            m_task.then(nullptr, [this, handle](T &&value) {
+                m_result.emplace(std::move(value));
+                resume(handle);
+            });
+        }
+    }
+
+    T await_resume()
+    {
+        if constexpr (!std::is_void_v<T>) {
+            if (m_result) {
+                return std::move(*m_result);
+            }
+            return m_task.takeResult();
+        }
+    }
+
+private:
+    bool isInContextThread() const
+    {
+        return m_context && m_context->thread() == QThread::currentThread();
+    }
+
+    void resume(std::coroutine_handle<> handle)
+    {
+        if (!m_hasContext || isInContextThread()) {
+            handle.resume();
+        } else if (m_context) {
+            // a posted resumption is dropped if the context is deleted before
+            QMetaObject::invokeMethod(
+                m_context, [handle]() { handle.resume(); }, Qt::QueuedConnection);
+        } else {
+            handle.destroy();
+        }
+    }
+
+    QXmppTask<T> m_task;
+    QPointer<QObject> m_context;
+    bool m_hasContext;
+    std::optional<std::conditional_t<std::is_void_v<T>, int, T>> m_result;
+};
+#endif
+
 }  // namespace QXmpp::Private
 
 ///
@@ -53,6 +299,16 @@ private:
 /// Unlike QFuture, this is not thread-safe. This avoids the need to do mutex locking at every
 /// access though.
 ///
+/// With C++20, tasks can also be awaited in coroutines using `co_await` and coroutines can
+/// return tasks (this needs QXmppPromise.h):
+/// ```
+/// QXmppTask<QString> Manager::requestName(const QString &jid)
+/// {
+///     auto result = co_await client()->sendIq(NameIq(jid)).withContext(this);
+///     co_return parseName(result);
+/// }
+/// ```
+///
 /// \ingroup Core classes
 ///
 /// \since QXmpp 1.5
@@ -73,6 +329,8 @@ public:
     /// If another function was previously registered using .then(), the old function will be
     /// replaced, and only the new one will be called.
     ///
+    /// If the task has been cancelled, the function is never called.
+    ///
     /// Example usage:
     /// ```
     /// QXmppTask<QString> generateSomething();
@@ -93,6 +351,7 @@ public:
     ///
     /// \param context QObject used for unregistering the handler function when the object is
     /// deleted. This way your lambda will never be executed after your object has been deleted.
+    /// If this is null, the function is always called.
     /// \param continuation A function accepting a result in the form of `T &&`.
     ///
 #ifndef QXMPP_DOC
@@ -107,6 +366,9 @@ public:
         }
         using namespace QXmpp::Private;
 
+        if (d.isCancelled()) {
+            return;
+        }
         if (d.isFinished()) {
             if constexpr (std::is_void_v<T>) {
                 continuation();
@@ -119,7 +381,7 @@ public:
             }
         } else {
             d.setContext(context);
-            d.setContinuation([f = std::forward<Continuation>(continuation)](TaskPrivate &d, void *result) mutable {
+            d.setContinuation(TaskContinuation([f = std::forward<Continuation>(continuation)](TaskPrivate &d, void *result) mutable {
                 if (d.isContextAlive()) {
                     if constexpr (std::is_void_v<T>) {
                         f();
@@ -127,10 +389,7 @@ public:
                         f(std::move(*reinterpret_cast<T *>(result)));
                     }
                 }
-
-                // clear continuation to avoid "deadlocks" in case the user captured this QXmppTask
-                d.setContinuation({});
-            });
+            }));
         }
     }
 
@@ -142,6 +401,33 @@ public:
     ///
     [[nodiscard]] bool isFinished() const { return d.isFinished(); }
 
+    ///
+    /// Cancels the asynchronous operation.
+    ///
+    /// The function registered using then() is not called anymore and a result reported
+    /// afterwards is discarded, so the task never finishes. The producer of the task is
+    /// notified (see QXmppPromise::onCancelled()) and can stop the operation. Tasks that QXmpp
+    /// creates from other tasks forward their cancellation, e.g. cancelling the task of a
+    /// request of a manager stops waiting for the response to its IQ.
+    ///
+    /// This has no effect if the task is already finished. A coroutine awaiting the task is not
+    /// resumed anymore.
+    ///
+    /// \warning THIS API IS NOT FINALIZED YET!
+    ///
+    /// \since QXmpp 1.6
+    ///
+    void cancel() { d.cancel(); }
+
+    ///
+    /// Returns whether the task has been cancelled using cancel().
+    ///
+    /// \warning THIS API IS NOT FINALIZED YET!
+    ///
+    /// \since QXmpp 1.6
+    ///
+    [[nodiscard]] bool isCancelled() const { return d.isCancelled(); }
+
     ///
     /// Returns whether the task is finished and the value has not been taken yet.
     ///
@@ -210,8 +496,34 @@ public:
         return interface.future();
     }
 
+#if defined(QXMPP_COROUTINES) || defined(QXMPP_DOC)
+    ///
+    /// Returns an awaitable that resumes the awaiting coroutine in the thread of \a context.
+    ///
+    /// If \a context is deleted before the task has finished, the coroutine is destroyed
+    /// without being resumed. This way the coroutine never continues after your object has
+    /// been deleted.
+    ///
+    /// Only available with C++20 coroutines.
+    ///
+    /// \since QXmpp 1.6
+    ///
+    auto withContext(QObject *context)
+    {
+        return QXmpp::Private::TaskAwaiter<T>(*this, context, true);
+    }
+
+    /// \cond
+    auto operator co_await()
+    {
+        return QXmpp::Private::TaskAwaiter<T>(*this, nullptr, false);
+    }
+    /// \endcond
+#endif
+
 private:
-    friend class QXmppPromise<T>;
+    template<typename>
+    friend class QXmppPromise;
 
     explicit QXmppTask(QXmpp::Private::TaskPrivate data)
         : d(std::move(data))
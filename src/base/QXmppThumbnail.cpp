@@ -5,6 +5,7 @@
 #include "QXmppThumbnail.h"
 
 #include "QXmppConstants_p.h"
+#include "QXmppUtils_p.h"
 
 #include <QDomElement>
 #include <QMimeDatabase>
@@ -12,6 +13,8 @@
 #include <QUrl>
 #include <QXmlStreamWriter>
 
+using namespace QXmpp::Private;
+
 class QXmppThumbnailPrivate : public QSharedData
 {
 public:
@@ -95,7 +98,7 @@ void QXmppThumbnail::setHeight(std::optional<uint32_t> newHeight)
 /// \cond
 bool QXmppThumbnail::parse(const QDomElement &el)
 {
-    if (el.tagName() == "thumbnail" && el.namespaceURI() == ns_thumbs) {
+    if (isElement(el, u"thumbnail", ns_thumbs)) {
         if (!el.hasAttribute("uri")) {
             return false;
         }
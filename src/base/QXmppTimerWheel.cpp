@@ -0,0 +1,315 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppTimerWheel_p.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+#include <QElapsedTimer>
+#include <QThread>
+#include <QTimer>
+#include <QtAlgorithms>
+
+namespace QXmpp::Private {
+
+//
+// Hierarchical timer wheel (Varghese and Lauck).
+//
+// Level 0 has a slot for each of 64 ticks, each upper level has a slot for
+// each of 64 slots of the level below. A timer is put into the lowest level
+// whose current slot of the level above contains its expiry. When the tick a
+// slot of an upper level starts at is reached, its timers are moved down;
+// when the tick of a slot of level 0 is reached, its timers fire. Timers
+// beyond the range of the top level (about 46 hours) wait in an overflow
+// list.
+//
+// The QTimer of the wheel is only started for the next tick with something to
+// do, so far timeouts don't wake up the thread regularly.
+//
+class TimerWheel : public std::enable_shared_from_this<TimerWheel>
+{
+public:
+    static constexpr qint64 TickMsecs = 10;
+
+    static std::shared_ptr<TimerWheel> forCurrentThread()
+    {
+        static thread_local std::weak_ptr<TimerWheel> current;
+        auto wheel = current.lock();
+        if (!wheel) {
+            wheel = std::make_shared<TimerWheel>();
+            current = wheel;
+        }
+        return wheel;
+    }
+
+    TimerWheel()
+        : m_thread(QThread::currentThread())
+    {
+        m_clock.start();
+        m_timer.setSingleShot(true);
+        QObject::connect(&m_timer, &QTimer::timeout, &m_timer, [this] { process(); });
+    }
+
+    QThread *thread() const { return m_thread; }
+    qint64 now() const { return m_clock.elapsed(); }
+
+    void schedule(WheelTimer *timer);
+    void remove(WheelTimer *timer);
+
+private:
+    static constexpr int Bits = 6;
+    static constexpr int Slots = 1 << Bits;
+    static constexpr int Levels = 4;
+    static constexpr int OverflowLevel = Levels;
+
+    static qint64 tickOf(qint64 msecs) { return (msecs + TickMsecs - 1) / TickMsecs; }
+
+    WheelTimer *&head(int level, int slot) { return level == OverflowLevel ? m_overflow : m_slots[level][slot]; }
+    void link(WheelTimer *timer, int level, int slot);
+    void unlink(WheelTimer *timer);
+    void insert(WheelTimer *timer, qint64 earliestTick);
+    void cascade(int level, int slot);
+    qint64 nextEventTick() const;
+    void process();
+    void scheduleWakeUp();
+
+    QThread *m_thread;
+    QElapsedTimer m_clock;
+    QTimer m_timer;
+    // tick up to which the timers have been processed
+    qint64 m_currentTick = 0;
+    // tick the QTimer has been started for, -1 if none
+    qint64 m_wakeUpTick = -1;
+    std::array<std::array<WheelTimer *, Slots>, Levels> m_slots = {};
+    // bit i is set if slot i of the level is not empty
+    std::array<quint64, Levels> m_occupied = {};
+    WheelTimer *m_overflow = nullptr;
+    qsizetype m_count = 0;
+};
+
+void TimerWheel::schedule(WheelTimer *timer)
+{
+    if (timer->isActive()) {
+        // postponed timers are moved when their slot is reached
+        if (tickOf(timer->m_deadline) >= timer->m_expiry) {
+            return;
+        }
+        unlink(timer);
+        m_count--;
+    }
+
+    // skip the ticks without timers, so the timer is put into the level that
+    // matches its timeout
+    const auto nowTick = now() / TickMsecs;
+    if (nowTick > m_currentTick) {
+        const auto next = nextEventTick();
+        if (next < 0 || next > nowTick) {
+            m_currentTick = nowTick;
+        }
+    }
+
+    insert(timer, m_currentTick + 1);
+    m_count++;
+    scheduleWakeUp();
+}
+
+void TimerWheel::remove(WheelTimer *timer)
+{
+    unlink(timer);
+    if (--m_count == 0) {
+        m_timer.stop();
+        m_wakeUpTick = -1;
+    }
+}
+
+void TimerWheel::link(WheelTimer *timer, int level, int slot)
+{
+    auto &first = head(level, slot);
+    timer->m_prev = nullptr;
+    timer->m_next = first;
+    if (first) {
+        first->m_prev = timer;
+    }
+    first = timer;
+    timer->m_level = level;
+    timer->m_slot = slot;
+    if (level < Levels) {
+        m_occupied[level] |= quint64(1) << slot;
+    }
+}
+
+void TimerWheel::unlink(WheelTimer *timer)
+{
+    auto &first = head(timer->m_level, timer->m_slot);
+    if (timer->m_prev) {
+        timer->m_prev->m_next = timer->m_next;
+    } else {
+        first = timer->m_next;
+    }
+    if (timer->m_next) {
+        timer->m_next->m_prev = timer->m_prev;
+    }
+    if (!first && timer->m_level < Levels) {
+        m_occupied[timer->m_level] &= ~(quint64(1) << timer->m_slot);
+    }
+    timer->m_prev = nullptr;
+    timer->m_next = nullptr;
+    timer->m_level = -1;
+}
+
+void TimerWheel::insert(WheelTimer *timer, qint64 earliestTick)
+{
+    const auto expiry = std::max(tickOf(timer->m_deadline), earliestTick);
+    timer->m_expiry = expiry;
+    for (int level = 0; level < Levels; level++) {
+        const int parentShift = Bits * (level + 1);
+        if ((expiry >> parentShift) == (m_currentTick >> parentShift)) {
+            link(timer, level, int((expiry >> (Bits * level)) & (Slots - 1)));
+            return;
+        }
+    }
+    link(timer, OverflowLevel, 0);
+}
+
+// Moves the timers of a slot that starts at the current tick down.
+void TimerWheel::cascade(int level, int slot)
+{
+    while (auto *timer = head(level, slot)) {
+        unlink(timer);
+        insert(timer, m_currentTick);
+    }
+}
+
+// Returns the next tick at which timers fire or move down, -1 if there are no
+// timers.
+qint64 TimerWheel::nextEventTick() const
+{
+    qint64 next = -1;
+    const auto consider = [&next](qint64 tick) {
+        if (next < 0 || tick < next) {
+            next = tick;
+        }
+    };
+
+    for (int level = 0; level < Levels; level++) {
+        // only slots after the current one are occupied
+        const int shift = Bits * level;
+        const auto index = int((m_currentTick >> shift) & (Slots - 1));
+        const auto slots = m_occupied[level] & ~((quint64(2) << index) - 1);
+        if (slots) {
+            const int parentShift = shift + Bits;
+            consider(((m_currentTick >> parentShift) << parentShift) + (qint64(qCountTrailingZeroBits(slots)) << shift));
+        }
+    }
+    if (m_overflow) {
+        const int topShift = Bits * Levels;
+        consider(((m_currentTick >> topShift) + 1) << topShift);
+    }
+    return next;
+}
+
+void TimerWheel::process()
+{
+    // the callbacks may delete the last timers of the thread
+    const auto self = shared_from_this();
+    m_wakeUpTick = -1;
+
+    const auto nowTick = now() / TickMsecs;
+    for (auto tick = nextEventTick(); tick >= 0 && tick <= nowTick; tick = nextEventTick()) {
+        m_currentTick = tick;
+
+        // move the timers of the slots starting now down, top to bottom
+        if (m_overflow && (tick & ((qint64(1) << (Bits * Levels)) - 1)) == 0) {
+            cascade(OverflowLevel, 0);
+        }
+        for (int level = Levels - 1; level > 0; level--) {
+            const int shift = Bits * level;
+            if ((tick & ((qint64(1) << shift) - 1)) == 0) {
+                cascade(level, int((tick >> shift) & (Slots - 1)));
+            }
+        }
+
+        // the callbacks may start and stop timers
+        const auto slot = int(tick & (Slots - 1));
+        while (auto *timer = m_slots[0][slot]) {
+            unlink(timer);
+            if (tickOf(timer->m_deadline) > tick) {
+                // touched since it has been inserted
+                insert(timer, tick + 1);
+                continue;
+            }
+            m_count--;
+            // copied, as the callback may delete the timer
+            if (const auto callback = timer->m_callback) {
+                callback();
+            }
+        }
+    }
+
+    // there is nothing to do up to now
+    m_currentTick = std::max(m_currentTick, nowTick);
+    scheduleWakeUp();
+}
+
+void TimerWheel::scheduleWakeUp()
+{
+    const auto next = nextEventTick();
+    if (next < 0) {
+        m_timer.stop();
+        m_wakeUpTick = -1;
+        return;
+    }
+    if (next == m_wakeUpTick && m_timer.isActive()) {
+        return;
+    }
+    m_wakeUpTick = next;
+    m_timer.start(int(std::clamp<qint64>(next * TickMsecs - now(), 0, std::numeric_limits<int>::max())));
+}
+
+WheelTimer::WheelTimer(std::function<void()> callback)
+    : m_callback(std::move(callback))
+{
+}
+
+WheelTimer::~WheelTimer()
+{
+    stop();
+}
+
+qint64 WheelTimer::remainingTime() const
+{
+    if (!isActive()) {
+        return -1;
+    }
+    return std::max(m_deadline - m_wheel->now(), qint64(0));
+}
+
+// Starts or restarts the timer with the given interval in milliseconds.
+void WheelTimer::start(int msecs)
+{
+    m_interval = std::max(msecs, 0);
+    touch();
+}
+
+void WheelTimer::touch()
+{
+    if (!m_wheel || m_wheel->thread() != QThread::currentThread()) {
+        // the timer has been moved to another thread while it was stopped
+        stop();
+        m_wheel = TimerWheel::forCurrentThread();
+    }
+    m_deadline = m_wheel->now() + m_interval;
+    m_wheel->schedule(this);
+}
+
+void WheelTimer::stop()
+{
+    if (isActive()) {
+        m_wheel->remove(this);
+    }
+}
+
+}  // namespace QXmpp::Private
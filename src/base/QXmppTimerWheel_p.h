@@ -0,0 +1,83 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPTIMERWHEEL_P_H
+#define QXMPPTIMERWHEEL_P_H
+
+#include "QXmppGlobal.h"
+
+#include <functional>
+#include <memory>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+namespace QXmpp::Private {
+
+class TimerWheel;
+
+//
+// Timeout driven by the timer wheel of its thread.
+//
+// Unlike QTimer, it is not registered with the event dispatcher: all timers of
+// a thread share one QTimer, so objects that exist in large numbers, e.g. the
+// connections of a server, can have timeouts cheaply. Starting, stopping and
+// touching a timer cost O(1) and don't allocate.
+//
+// The resolution is 10 ms. The timer is single-shot and needs to be used in
+// one thread only; it can be moved to another thread while it is stopped. The
+// callback may delete the timer.
+//
+class QXMPP_EXPORT WheelTimer
+{
+public:
+    explicit WheelTimer(std::function<void()> callback = {});
+    ~WheelTimer();
+
+    WheelTimer(const WheelTimer &) = delete;
+    WheelTimer &operator=(const WheelTimer &) = delete;
+
+    void setCallback(std::function<void()> callback) { m_callback = std::move(callback); }
+
+    bool isActive() const { return m_level >= 0; }
+    int interval() const { return m_interval; }
+    // -1 if the timer is not active
+    qint64 remainingTime() const;
+
+    void start(int msecs);
+    // Restarts the timer with its last interval. A timer that is postponed is
+    // only moved when its old deadline is reached.
+    void touch();
+    void stop();
+
+private:
+    friend class TimerWheel;
+
+    std::function<void()> m_callback;
+    std::shared_ptr<TimerWheel> m_wheel;
+    // neighbours in the slot of the wheel
+    WheelTimer *m_prev = nullptr;
+    WheelTimer *m_next = nullptr;
+    // in ms of the wheel's clock
+    qint64 m_deadline = 0;
+    // tick of the slot the timer is in, may be before the deadline
+    qint64 m_expiry = 0;
+    int m_interval = 0;
+    // -1 if the timer is not active
+    int m_level = -1;
+    int m_slot = 0;
+};
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPTIMERWHEEL_P_H
@@ -0,0 +1,75 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPTOKENBUCKET_P_H
+#define QXMPPTOKENBUCKET_P_H
+
+#include <algorithm>
+#include <cmath>
+
+#include <QtGlobal>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API. It exists for the convenience
+// of QXmppStream.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+namespace QXmpp::Private {
+
+//
+// Token bucket for rate limiting.
+//
+// Tokens are refilled at a constant rate up to the burst size. Consuming more
+// tokens than available is allowed and results in a debt that needs to be
+// refilled before tokens are available again.
+//
+class TokenBucket
+{
+public:
+    bool isEnabled() const { return m_rate > 0; }
+    double rate() const { return m_rate; }
+
+    // A rate of 0 disables the limit.
+    void setRate(double rate, double burst)
+    {
+        m_rate = rate;
+        m_burst = burst;
+        m_tokens = burst;
+    }
+
+    void refill(qint64 msecsElapsed)
+    {
+        m_tokens = std::min(m_burst, m_tokens + m_rate * double(msecsElapsed) / 1000.0);
+    }
+
+    void consume(double amount) { m_tokens -= amount; }
+
+    double available() const { return m_tokens; }
+
+    // Returns the time until at least one token is available again.
+    qint64 msecsUntilAvailable() const
+    {
+        if (!isEnabled() || m_tokens >= 1) {
+            return 0;
+        }
+        return qint64(std::ceil((1.0 - m_tokens) * 1000.0 / m_rate));
+    }
+
+private:
+    double m_rate = 0;
+    double m_burst = 0;
+    double m_tokens = 0;
+};
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPTOKENBUCKET_P_H
@@ -0,0 +1,297 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppTracing.h"
+
+#include "QXmppTracing_p.h"
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+
+namespace {
+
+struct TraceEvent
+{
+    const char *category;
+    const char *name;
+    // nanoseconds of the tracing clock
+    qint64 start;
+    qint64 duration;
+    quint32 threadId;
+    bool async;
+    QString id;
+    QString type;
+};
+
+struct Recorder
+{
+    Recorder() { clock.start(); }
+
+    qint64 now() const { return clock.nsecsElapsed(); }
+    void add(TraceEvent &&event);
+
+    QElapsedTimer clock;
+    std::atomic<bool> enabled { false };
+    std::atomic<quint32> nextThreadId { 1 };
+
+    QMutex mutex;
+    std::vector<TraceEvent> events;
+    int maximumEventCount = 100000;
+    quint64 droppedEvents = 0;
+};
+
+Recorder &recorder()
+{
+    static Recorder r;
+    return r;
+}
+
+void Recorder::add(TraceEvent &&event)
+{
+    QMutexLocker locker(&mutex);
+    if (events.size() >= size_t(maximumEventCount)) {
+        droppedEvents++;
+        return;
+    }
+    events.push_back(std::move(event));
+}
+
+QJsonObject toJson(const TraceEvent &event, const char *phase, qint64 timestamp, qint64 pid)
+{
+    QJsonObject object {
+        { QStringLiteral("name"), QString::fromLatin1(event.name) },
+        { QStringLiteral("cat"), QString::fromLatin1(event.category) },
+        { QStringLiteral("ph"), QString::fromLatin1(phase) },
+        // microseconds
+        { QStringLiteral("ts"), double(timestamp) / 1000.0 },
+        { QStringLiteral("pid"), pid },
+        { QStringLiteral("tid"), qint64(event.threadId) },
+    };
+    if (!event.id.isEmpty() || !event.type.isEmpty()) {
+        object.insert(QStringLiteral("args"), QJsonObject { { QStringLiteral("id"), event.id }, { QStringLiteral("type"), event.type } });
+    }
+    return object;
+}
+
+}  // namespace
+
+#ifdef WITH_TRACING
+
+// Small thread IDs, as shown by the trace viewers.
+static quint32 currentThreadId()
+{
+    thread_local const quint32 id = recorder().nextThreadId.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+namespace QXmpp::Private {
+
+TraceSpan::TraceSpan(const char *category, const char *name, bool async)
+{
+    auto &r = recorder();
+    if (!r.enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    m_category = category;
+    m_name = name;
+    m_async = async;
+    m_threadId = currentThreadId();
+    m_start = r.now();
+}
+
+TraceSpan::TraceSpan(TraceSpan &&other) noexcept
+    : m_category(other.m_category),
+      m_name(other.m_name),
+      m_start(std::exchange(other.m_start, -1)),
+      m_async(other.m_async),
+      m_threadId(other.m_threadId),
+      m_id(std::move(other.m_id)),
+      m_type(std::move(other.m_type))
+{
+}
+
+TraceSpan &TraceSpan::operator=(TraceSpan &&other) noexcept
+{
+    if (this != &other) {
+        end();
+        m_category = other.m_category;
+        m_name = other.m_name;
+        m_start = std::exchange(other.m_start, -1);
+        m_async = other.m_async;
+        m_threadId = other.m_threadId;
+        m_id = std::move(other.m_id);
+        m_type = std::move(other.m_type);
+    }
+    return *this;
+}
+
+TraceSpan::~TraceSpan()
+{
+    end();
+}
+
+void TraceSpan::setStanza(const QString &id, const QString &type)
+{
+    if (m_start >= 0) {
+        m_id = id;
+        m_type = type;
+    }
+}
+
+void TraceSpan::end()
+{
+    if (m_start < 0) {
+        return;
+    }
+    auto &r = recorder();
+    const auto start = std::exchange(m_start, -1);
+    r.add({ m_category, m_name, start, r.now() - start, m_threadId, m_async, std::move(m_id), std::move(m_type) });
+}
+
+void TraceSpan::record(const char *category, const char *name, qint64 durationNsecs, const QString &id, const QString &type)
+{
+    auto &r = recorder();
+    if (!r.enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    const auto now = r.now();
+    r.add({ category, name, now - durationNsecs, durationNsecs, currentThreadId(), false, id, type });
+}
+
+}  // namespace QXmpp::Private
+
+#endif
+
+///
+/// Returns whether QXmpp has been built with the tracing hooks.
+///
+bool QXmppTracing::isAvailable()
+{
+#ifdef WITH_TRACING
+    return true;
+#else
+    return false;
+#endif
+}
+
+///
+/// Returns whether spans are recorded.
+///
+bool QXmppTracing::isEnabled()
+{
+    return recorder().enabled.load(std::memory_order_relaxed);
+}
+
+///
+/// Sets whether spans are recorded.
+///
+/// This has no effect if QXmpp has been built without the tracing hooks.
+///
+/// Spans that have already been started when tracing is enabled are not
+/// recorded.
+///
+void QXmppTracing::setEnabled(bool enabled)
+{
+    recorder().enabled.store(enabled && isAvailable(), std::memory_order_relaxed);
+}
+
+///
+/// Returns the maximum number of recorded spans.
+///
+int QXmppTracing::maximumEventCount()
+{
+    auto &r = recorder();
+    QMutexLocker locker(&r.mutex);
+    return r.maximumEventCount;
+}
+
+///
+/// Sets the maximum number of recorded spans.
+///
+/// Further spans are dropped until the recorded spans are cleared or
+/// exported. The default is 100,000 spans.
+///
+void QXmppTracing::setMaximumEventCount(int count)
+{
+    auto &r = recorder();
+    QMutexLocker locker(&r.mutex);
+    r.maximumEventCount = std::max(count, 0);
+}
+
+///
+/// Returns the number of recorded spans.
+///
+int QXmppTracing::eventCount()
+{
+    auto &r = recorder();
+    QMutexLocker locker(&r.mutex);
+    return int(r.events.size());
+}
+
+///
+/// Returns the recorded spans in the Chrome trace event JSON format and clears
+/// them.
+///
+/// Spans are exported as complete events, spans of asynchronous operations as
+/// pairs of async begin and end events.
+///
+QByteArray QXmppTracing::toChromeTraceJson()
+{
+    auto &r = recorder();
+    std::vector<TraceEvent> events;
+    quint64 droppedEvents = 0;
+    {
+        QMutexLocker locker(&r.mutex);
+        events.swap(r.events);
+        droppedEvents = std::exchange(r.droppedEvents, 0);
+    }
+
+    const auto pid = QCoreApplication::applicationPid();
+    QJsonArray traceEvents;
+    qint64 asyncId = 0;
+    for (const auto &event : events) {
+        if (event.async) {
+            const auto id = QString::number(++asyncId);
+            auto begin = toJson(event, "b", event.start, pid);
+            begin.insert(QStringLiteral("id"), id);
+            traceEvents.append(begin);
+
+            auto end = toJson(event, "e", event.start + event.duration, pid);
+            end.insert(QStringLiteral("id"), id);
+            end.remove(QStringLiteral("args"));
+            traceEvents.append(end);
+        } else {
+            auto complete = toJson(event, "X", event.start, pid);
+            complete.insert(QStringLiteral("dur"), double(event.duration) / 1000.0);
+            traceEvents.append(complete);
+        }
+    }
+
+    const QJsonObject trace {
+        { QStringLiteral("traceEvents"), traceEvents },
+        { QStringLiteral("displayTimeUnit"), QStringLiteral("ms") },
+        { QStringLiteral("otherData"), QJsonObject { { QStringLiteral("droppedEvents"), qint64(droppedEvents) } } },
+    };
+    return QJsonDocument(trace).toJson(QJsonDocument::Compact);
+}
+
+///
+/// Removes the recorded spans.
+///
+void QXmppTracing::clear()
+{
+    auto &r = recorder();
+    QMutexLocker locker(&r.mutex);
+    r.events.clear();
+    r.droppedEvents = 0;
+}
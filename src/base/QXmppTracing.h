@@ -0,0 +1,53 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPTRACING_H
+#define QXMPPTRACING_H
+
+#include "QXmppGlobal.h"
+
+#include <QByteArray>
+
+///
+/// \brief The QXmppTracing class records the lifecycle of the stanzas of all
+/// streams, clients and servers of the process.
+///
+/// The spans cover reading from and writing to the sockets, parsing, the
+/// dispatching to the extensions, end-to-end encryption and decryption, and
+/// waiting for storages. They carry the ID and the type of the stanza, if
+/// known, so the time spent on slow stanzas can be attributed to a subsystem.
+///
+/// The tracing hooks are only compiled in if QXmpp has been built with the
+/// \c WITH_TRACING CMake option, see isAvailable(). Otherwise they don't cost
+/// anything. Recording still needs to be enabled at runtime using
+/// setEnabled().
+///
+/// The recorded spans can be exported in the Chrome trace event format using
+/// toChromeTraceJson(), which can be opened by Perfetto (ui.perfetto.dev) and
+/// chrome://tracing.
+///
+/// \since QXmpp 1.6
+///
+/// \ingroup Core
+///
+class QXMPP_EXPORT QXmppTracing
+{
+public:
+    static bool isAvailable();
+
+    static bool isEnabled();
+    static void setEnabled(bool enabled);
+
+    static int maximumEventCount();
+    static void setMaximumEventCount(int count);
+    static int eventCount();
+
+    static QByteArray toChromeTraceJson();
+    static void clear();
+
+private:
+    QXmppTracing() = delete;
+};
+
+#endif  // QXMPPTRACING_H
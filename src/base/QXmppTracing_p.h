@@ -0,0 +1,97 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPTRACING_P_H
+#define QXMPPTRACING_P_H
+
+#include "QXmppGlobal.h"
+
+#include <QString>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API. It exists for the convenience
+// of the QXmpp streams, clients and servers.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+//
+// Tracing of the stanza lifecycle, recorded by QXmppTracing.
+//
+// Spans are only compiled in with WITH_TRACING. Otherwise the macros expand to
+// empty objects and their arguments are not evaluated, so the hooks don't cost
+// anything.
+//
+// QXMPP_TRACE_SPAN(span, "stream", "dispatch");
+// QXMPP_TRACE_STANZA(span, id, type);
+//
+// A span ends when it is destroyed or when QXMPP_TRACE_END() is called. Async
+// spans (QXMPP_TRACE_ASYNC_SPAN) can be moved into continuations, so they
+// cover waits for encryption or storages, and may overlap other spans.
+//
+
+#ifdef WITH_TRACING
+
+namespace QXmpp::Private {
+
+class QXMPP_EXPORT TraceSpan
+{
+public:
+    TraceSpan() = default;
+    TraceSpan(const char *category, const char *name, bool async = false);
+    TraceSpan(TraceSpan &&other) noexcept;
+    TraceSpan &operator=(TraceSpan &&other) noexcept;
+    ~TraceSpan();
+
+    void setStanza(const QString &id, const QString &type);
+    void end();
+
+    // records a span that has already ended, e.g. measured in another thread
+    static void record(const char *category, const char *name, qint64 durationNsecs, const QString &id, const QString &type);
+
+private:
+    const char *m_category = nullptr;
+    const char *m_name = nullptr;
+    // start in nanoseconds of the tracing clock, -1 if not recorded
+    qint64 m_start = -1;
+    bool m_async = false;
+    quint32 m_threadId = 0;
+    QString m_id;
+    QString m_type;
+};
+
+}  // namespace QXmpp::Private
+
+#define QXMPP_TRACE_SPAN(span, category, name) QXmpp::Private::TraceSpan span(category, name)
+#define QXMPP_TRACE_ASYNC_SPAN(span, category, name) QXmpp::Private::TraceSpan span(category, name, true)
+#define QXMPP_TRACE_STANZA(span, id, type) span.setStanza(id, type)
+#define QXMPP_TRACE_END(span) span.end()
+#define QXMPP_TRACE_RECORD(category, name, durationNsecs, id, type) \
+    QXmpp::Private::TraceSpan::record(category, name, durationNsecs, id, type)
+
+#else
+
+namespace QXmpp::Private {
+
+struct TraceSpan
+{
+};
+
+}  // namespace QXmpp::Private
+
+#define QXMPP_TRACE_SPAN(span, category, name) [[maybe_unused]] QXmpp::Private::TraceSpan span
+#define QXMPP_TRACE_ASYNC_SPAN(span, category, name) [[maybe_unused]] QXmpp::Private::TraceSpan span
+#define QXMPP_TRACE_STANZA(span, id, type) static_cast<void>(0)
+#define QXMPP_TRACE_END(span) static_cast<void>(0)
+#define QXMPP_TRACE_RECORD(category, name, durationNsecs, id, type) static_cast<void>(0)
+
+#endif
+
+#endif  // QXMPPTRACING_P_H
@@ -8,6 +8,10 @@
 #include "QXmppLogger.h"
 #include "QXmppUtils_p.h"
 
+#include <algorithm>
+#include <array>
+#include <limits>
+
 #include <QBuffer>
 #include <QByteArray>
 #include <QCryptographicHash>
@@ -21,74 +25,31 @@
 #include <QUuid>
 #include <QXmlStreamWriter>
 
-// adapted from public domain source by Ross Williams and Eric Durbin
-// FIXME : is this valid for big-endian machines?
-static quint32 crctable[256] = {
-    0x00000000L, 0x77073096L, 0xEE0E612CL, 0x990951BAL,
-    0x076DC419L, 0x706AF48FL, 0xE963A535L, 0x9E6495A3L,
-    0x0EDB8832L, 0x79DCB8A4L, 0xE0D5E91EL, 0x97D2D988L,
-    0x09B64C2BL, 0x7EB17CBDL, 0xE7B82D07L, 0x90BF1D91L,
-    0x1DB71064L, 0x6AB020F2L, 0xF3B97148L, 0x84BE41DEL,
-    0x1ADAD47DL, 0x6DDDE4EBL, 0xF4D4B551L, 0x83D385C7L,
-    0x136C9856L, 0x646BA8C0L, 0xFD62F97AL, 0x8A65C9ECL,
-    0x14015C4FL, 0x63066CD9L, 0xFA0F3D63L, 0x8D080DF5L,
-    0x3B6E20C8L, 0x4C69105EL, 0xD56041E4L, 0xA2677172L,
-    0x3C03E4D1L, 0x4B04D447L, 0xD20D85FDL, 0xA50AB56BL,
-    0x35B5A8FAL, 0x42B2986CL, 0xDBBBC9D6L, 0xACBCF940L,
-    0x32D86CE3L, 0x45DF5C75L, 0xDCD60DCFL, 0xABD13D59L,
-    0x26D930ACL, 0x51DE003AL, 0xC8D75180L, 0xBFD06116L,
-    0x21B4F4B5L, 0x56B3C423L, 0xCFBA9599L, 0xB8BDA50FL,
-    0x2802B89EL, 0x5F058808L, 0xC60CD9B2L, 0xB10BE924L,
-    0x2F6F7C87L, 0x58684C11L, 0xC1611DABL, 0xB6662D3DL,
-    0x76DC4190L, 0x01DB7106L, 0x98D220BCL, 0xEFD5102AL,
-    0x71B18589L, 0x06B6B51FL, 0x9FBFE4A5L, 0xE8B8D433L,
-    0x7807C9A2L, 0x0F00F934L, 0x9609A88EL, 0xE10E9818L,
-    0x7F6A0DBBL, 0x086D3D2DL, 0x91646C97L, 0xE6635C01L,
-    0x6B6B51F4L, 0x1C6C6162L, 0x856530D8L, 0xF262004EL,
-    0x6C0695EDL, 0x1B01A57BL, 0x8208F4C1L, 0xF50FC457L,
-    0x65B0D9C6L, 0x12B7E950L, 0x8BBEB8EAL, 0xFCB9887CL,
-    0x62DD1DDFL, 0x15DA2D49L, 0x8CD37CF3L, 0xFBD44C65L,
-    0x4DB26158L, 0x3AB551CEL, 0xA3BC0074L, 0xD4BB30E2L,
-    0x4ADFA541L, 0x3DD895D7L, 0xA4D1C46DL, 0xD3D6F4FBL,
-    0x4369E96AL, 0x346ED9FCL, 0xAD678846L, 0xDA60B8D0L,
-    0x44042D73L, 0x33031DE5L, 0xAA0A4C5FL, 0xDD0D7CC9L,
-    0x5005713CL, 0x270241AAL, 0xBE0B1010L, 0xC90C2086L,
-    0x5768B525L, 0x206F85B3L, 0xB966D409L, 0xCE61E49FL,
-    0x5EDEF90EL, 0x29D9C998L, 0xB0D09822L, 0xC7D7A8B4L,
-    0x59B33D17L, 0x2EB40D81L, 0xB7BD5C3BL, 0xC0BA6CADL,
-    0xEDB88320L, 0x9ABFB3B6L, 0x03B6E20CL, 0x74B1D29AL,
-    0xEAD54739L, 0x9DD277AFL, 0x04DB2615L, 0x73DC1683L,
-    0xE3630B12L, 0x94643B84L, 0x0D6D6A3EL, 0x7A6A5AA8L,
-    0xE40ECF0BL, 0x9309FF9DL, 0x0A00AE27L, 0x7D079EB1L,
-    0xF00F9344L, 0x8708A3D2L, 0x1E01F268L, 0x6906C2FEL,
-    0xF762575DL, 0x806567CBL, 0x196C3671L, 0x6E6B06E7L,
-    0xFED41B76L, 0x89D32BE0L, 0x10DA7A5AL, 0x67DD4ACCL,
-    0xF9B9DF6FL, 0x8EBEEFF9L, 0x17B7BE43L, 0x60B08ED5L,
-    0xD6D6A3E8L, 0xA1D1937EL, 0x38D8C2C4L, 0x4FDFF252L,
-    0xD1BB67F1L, 0xA6BC5767L, 0x3FB506DDL, 0x48B2364BL,
-    0xD80D2BDAL, 0xAF0A1B4CL, 0x36034AF6L, 0x41047A60L,
-    0xDF60EFC3L, 0xA867DF55L, 0x316E8EEFL, 0x4669BE79L,
-    0xCB61B38CL, 0xBC66831AL, 0x256FD2A0L, 0x5268E236L,
-    0xCC0C7795L, 0xBB0B4703L, 0x220216B9L, 0x5505262FL,
-    0xC5BA3BBEL, 0xB2BD0B28L, 0x2BB45A92L, 0x5CB36A04L,
-    0xC2D7FFA7L, 0xB5D0CF31L, 0x2CD99E8BL, 0x5BDEAE1DL,
-    0x9B64C2B0L, 0xEC63F226L, 0x756AA39CL, 0x026D930AL,
-    0x9C0906A9L, 0xEB0E363FL, 0x72076785L, 0x05005713L,
-    0x95BF4A82L, 0xE2B87A14L, 0x7BB12BAEL, 0x0CB61B38L,
-    0x92D28E9BL, 0xE5D5BE0DL, 0x7CDCEFB7L, 0x0BDBDF21L,
-    0x86D3D2D4L, 0xF1D4E242L, 0x68DDB3F8L, 0x1FDA836EL,
-    0x81BE16CDL, 0xF6B9265BL, 0x6FB077E1L, 0x18B74777L,
-    0x88085AE6L, 0xFF0F6A70L, 0x66063BCAL, 0x11010B5CL,
-    0x8F659EFFL, 0xF862AE69L, 0x616BFFD3L, 0x166CCF45L,
-    0xA00AE278L, 0xD70DD2EEL, 0x4E048354L, 0x3903B3C2L,
-    0xA7672661L, 0xD06016F7L, 0x4969474DL, 0x3E6E77DBL,
-    0xAED16A4AL, 0xD9D65ADCL, 0x40DF0B66L, 0x37D83BF0L,
-    0xA9BCAE53L, 0xDEBB9EC5L, 0x47B2CF7FL, 0x30B5FFE9L,
-    0xBDBDF21CL, 0xCABAC28AL, 0x53B39330L, 0x24B4A3A6L,
-    0xBAD03605L, 0xCDD70693L, 0x54DE5729L, 0x23D967BFL,
-    0xB3667A2EL, 0xC4614AB8L, 0x5D681B02L, 0x2A6F2B94L,
-    0xB40BBE37L, 0xC30C8EA1L, 0x5A05DF1BL, 0x2D02EF8DL
-};
+// CRC-32 (IEEE 802.3) lookup tables for slicing-by-8: crcTables[0] is the
+// classic byte-wise table, crcTables[k][n] is the CRC of byte n followed by k
+// zero bytes.
+using CrcTables = std::array<std::array<quint32, 256>, 8>;
+
+static constexpr CrcTables generateCrcTables()
+{
+    CrcTables tables {};
+    for (quint32 n = 0; n < 256; n++) {
+        quint32 crc = n;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : (crc >> 1);
+        }
+        tables[0][n] = crc;
+    }
+    for (quint32 n = 0; n < 256; n++) {
+        for (size_t k = 1; k < tables.size(); k++) {
+            const quint32 previous = tables[k - 1][n];
+            tables[k][n] = (previous >> 8) ^ tables[0][previous & 0xff];
+        }
+    }
+    return tables;
+}
+
+static constexpr CrcTables crcTables = generateCrcTables();
 
 ///
 /// Parses a date-time from a string according to
@@ -158,7 +119,14 @@ QString QXmppUtils::timezoneOffsetToString(int secs)
 
 QString QXmppUtils::jidToDomain(const QString &jid)
 {
-    return jidToBareJid(jid).split(QStringLiteral("@")).last();
+    const int slash = jid.indexOf(QChar('/'));
+    const int bareEnd = slash < 0 ? jid.size() : slash;
+    if (bareEnd == 0) {
+        return QString();
+    }
+    // the domain starts after the last '@' of the bare JID
+    const int domainStart = jid.lastIndexOf(QChar('@'), bareEnd - 1) + 1;
+    return jid.mid(domainStart, bareEnd - domainStart);
 }
 
 /// Returns the resource for the given \a jid.
@@ -198,50 +166,21 @@ QString QXmppUtils::jidToBareJid(const QString &jid)
 
 quint32 QXmppUtils::generateCrc32(const QByteArray &in)
 {
-    quint32 result = 0xffffffff;
-    for (char n : in) {
-        result = (result >> 8) ^ (crctable[(result & 0xff) ^ (quint8)n]);
-    }
-    return result ^= 0xffffffff;
-}
-
-static QByteArray generateHmac(QCryptographicHash::Algorithm algorithm, const QByteArray &key, const QByteArray &text)
-{
-    QCryptographicHash hasher(algorithm);
-
-    const int B = 64;
-    QByteArray kpad = key + QByteArray(B - key.size(), 0);
-
-    QByteArray ba;
-    for (int i = 0; i < B; ++i) {
-        ba += kpad[i] ^ 0x5c;
-    }
-
-    QByteArray tmp;
-    for (int i = 0; i < B; ++i) {
-        tmp += kpad[i] ^ 0x36;
-    }
-    hasher.addData(tmp);
-    hasher.addData(text);
-    ba += hasher.result();
-
-    hasher.reset();
-    hasher.addData(ba);
-    return hasher.result();
+    return QXmpp::Private::crc32(0, in.constData(), in.size());
 }
 
 /// Generates the MD5 HMAC for the given \a key and \a text.
 
 QByteArray QXmppUtils::generateHmacMd5(const QByteArray &key, const QByteArray &text)
 {
-    return generateHmac(QCryptographicHash::Md5, key, text);
+    return QXmpp::Private::HmacKey(QCryptographicHash::Md5, key).sign({ text });
 }
 
 /// Generates the SHA1 HMAC for the given \a key and \a text.
 
 QByteArray QXmppUtils::generateHmacSha1(const QByteArray &key, const QByteArray &text)
 {
-    return generateHmac(QCryptographicHash::Sha1, key, text);
+    return QXmpp::Private::HmacKey(QCryptographicHash::Sha1, key).sign({ text });
 }
 
 /// Generates a random integer x between 0 and N-1.
@@ -280,6 +219,65 @@ QString QXmppUtils::generateStanzaUuid()
     return QUuid::createUuid().toString(QUuid::WithoutBraces);
 }
 
+namespace {
+
+constexpr char base64UrlAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+// 64 random bits, encoded with six bits per character
+constexpr int StanzaIdPrefixLength = 11;
+constexpr int MaximumCounterLength = 11;
+
+// Random prefix and counter, one per thread so no locking is needed.
+class StanzaIdGenerator
+{
+public:
+    StanzaIdGenerator()
+    {
+        auto random = QRandomGenerator::global()->generate64();
+        for (auto &character : m_buffer) {
+            character = QLatin1Char(base64UrlAlphabet[random & 0x3f]);
+            random >>= 6;
+        }
+    }
+
+    QString next()
+    {
+        auto value = ++m_counter;
+        int length = StanzaIdPrefixLength;
+        do {
+            m_buffer[length++] = QLatin1Char(base64UrlAlphabet[value & 0x3f]);
+            value >>= 6;
+        } while (value);
+        return QString(m_buffer.data(), length);
+    }
+
+private:
+    std::array<QChar, StanzaIdPrefixLength + MaximumCounterLength> m_buffer;
+    quint64 m_counter = 0;
+};
+
+}  // namespace
+
+///
+/// Creates a new stanza id quickly.
+///
+/// The id consists of a random prefix that is generated once per thread and
+/// a counter, both encoded in base64url. No system random numbers are needed
+/// per id, so this is suited for the ids of IQ requests and other stanzas a
+/// client sends in large numbers.
+///
+/// The ids are unique within the process and collisions with ids of other
+/// processes are very unlikely, but following ids of a thread are
+/// predictable. Use generateStanzaUuid() for ids that are stored permanently
+/// or need to be globally unique, e.g. message ids.
+///
+/// \since QXmpp 1.6
+///
+QString QXmppUtils::generateStanzaId()
+{
+    thread_local StanzaIdGenerator generator;
+    return generator.next();
+}
+
 ///
 /// Returns a random alphanumerical string of the specified size.
 ///
@@ -301,11 +299,24 @@ QString QXmppUtils::generateStanzaHash(int length)
         return QXmppUtils::generateStanzaUuid();
     }
 
-    const QString somechars = QStringLiteral("1234567890abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ");
-    const int N = somechars.size();
-    QString hashResult;
-    for (int idx = 0; idx < length; ++idx) {
-        hashResult += somechars[generateRandomInteger(N)];
+    constexpr char somechars[] = "1234567890abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    constexpr quint32 N = sizeof(somechars) - 1;
+    // values at and above this limit would prefer the first characters
+    constexpr quint32 limit = std::numeric_limits<quint32>::max() - std::numeric_limits<quint32>::max() % N;
+
+    QString hashResult(std::max(length, 0), Qt::Uninitialized);
+    std::array<quint32, 16> random;
+    std::size_t used = random.size();
+    for (auto &character : hashResult) {
+        quint32 value;
+        do {
+            if (used == random.size()) {
+                QRandomGenerator::global()->fillRange(random.data(), random.size());
+                used = 0;
+            }
+            value = random[used++];
+        } while (value >= limit);
+        character = QLatin1Char(somechars[value % N]);
     }
     return hashResult;
 }
@@ -375,6 +386,27 @@ void QXmpp::Private::generateRandomBytes(uint8_t *bytes, uint32_t byteCount)
     }
 }
 
+bool QXmpp::Private::ProgressThrottle::shouldReport(qint64 done, qint64 total)
+{
+    if (done == m_reportedDone) {
+        return false;
+    }
+
+    const bool always = m_reportedDone < 0 || done < m_reportedDone || (total > 0 && done >= total);
+    if (!always) {
+        if (m_granularity > 0 && total > 0 && float(done - m_reportedDone) / float(total) < m_granularity) {
+            return false;
+        }
+        if (m_interval > 0 && !m_lastReport.hasExpired(m_interval)) {
+            return false;
+        }
+    }
+
+    m_reportedDone = done;
+    m_lastReport.start();
+    return true;
+}
+
 float QXmpp::Private::calculateProgress(qint64 transferred, qint64 total)
 {
     if (total > 0) {
@@ -387,3 +419,58 @@ float QXmpp::Private::calculateProgress(qint64 transferred, qint64 total)
     return 0;
 }
 /// \endcond
+
+//
+// Continues the CRC-32 checksum \a crc (0 for the start) over the given data.
+//
+// The data is processed eight bytes at a time using the slicing-by-8 tables.
+//
+quint32 QXmpp::Private::crc32(quint32 crc, const char *data, qsizetype size)
+{
+    const auto &t = crcTables;
+    auto *bytes = reinterpret_cast<const uchar *>(data);
+    crc = ~crc;
+    for (; size >= 8; size -= 8, bytes += 8) {
+        const quint32 low = crc ^ (quint32(bytes[0]) | quint32(bytes[1]) << 8 | quint32(bytes[2]) << 16 | quint32(bytes[3]) << 24);
+        crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^
+            t[3][bytes[4]] ^ t[2][bytes[5]] ^ t[1][bytes[6]] ^ t[0][bytes[7]];
+    }
+    for (; size > 0; size--, bytes++) {
+        crc = (crc >> 8) ^ t[0][(crc & 0xff) ^ *bytes];
+    }
+    return ~crc;
+}
+
+//
+// Prepares the padded inner and outer keys of an HMAC, see RFC 2104.
+//
+QXmpp::Private::HmacKey::HmacKey(QCryptographicHash::Algorithm algorithm, const QByteArray &key)
+    : m_algorithm(algorithm)
+{
+    // keys longer than the block size are hashed first
+    const auto blockKey = key.size() > BlockSize ? QCryptographicHash::hash(key, algorithm) : key;
+    m_innerPad.fill(0x36);
+    m_outerPad.fill(0x5c);
+    for (int i = 0; i < blockKey.size(); i++) {
+        m_innerPad[i] ^= blockKey[i];
+        m_outerPad[i] ^= blockKey[i];
+    }
+}
+
+//
+// Calculates the HMAC of the concatenation of \a parts.
+//
+QByteArray QXmpp::Private::HmacKey::sign(std::initializer_list<QByteArray> parts) const
+{
+    QCryptographicHash hasher(m_algorithm);
+    hasher.addData(QByteArray::fromRawData(m_innerPad.data(), BlockSize));
+    for (const auto &part : parts) {
+        hasher.addData(part);
+    }
+    const auto innerHash = hasher.result();
+
+    hasher.reset();
+    hasher.addData(QByteArray::fromRawData(m_outerPad.data(), BlockSize));
+    hasher.addData(innerHash);
+    return hasher.result();
+}
@@ -40,6 +40,7 @@ public:
     static QByteArray generateHmacSha1(const QByteArray &key, const QByteArray &text);
     static int generateRandomInteger(int N);
     static QByteArray generateRandomBytes(int length);
+    static QString generateStanzaId();
     static QString generateStanzaUuid();
     static QString generateStanzaHash(int length = 36);
 };
@@ -8,9 +8,15 @@
 
 #include "QXmppGlobal.h"
 
+#include <algorithm>
+#include <array>
+#include <initializer_list>
 #include <stdint.h>
 
 #include <QByteArray>
+#include <QCryptographicHash>
+#include <QDomElement>
+#include <QElapsedTimer>
 
 namespace QXmpp::Private {
 
@@ -18,6 +24,59 @@ QXMPP_EXPORT QByteArray generateRandomBytes(uint32_t minimumByteCount, uint32_t
 QXMPP_EXPORT void generateRandomBytes(uint8_t *bytes, uint32_t byteCount);
 float calculateProgress(qint64 transferred, qint64 total);
 
+//
+// Limits how often the progress of a transfer is reported.
+//
+// Progress is reported if it advanced by at least the granularity (a fraction
+// of the total) and the minimum interval has passed since the last report.
+// The first progress, the completion and restarts are always reported.
+//
+class QXMPP_EXPORT ProgressThrottle
+{
+public:
+    float granularity() const { return m_granularity; }
+    void setGranularity(float granularity) { m_granularity = qBound(0.0f, granularity, 1.0f); }
+    int interval() const { return m_interval; }
+    void setInterval(int msecs) { m_interval = std::max(msecs, 0); }
+
+    bool shouldReport(qint64 done, qint64 total);
+
+private:
+    float m_granularity = 0;
+    int m_interval = 0;
+    qint64 m_reportedDone = -1;
+    QElapsedTimer m_lastReport;
+};
+
+QXMPP_EXPORT quint32 crc32(quint32 crc, const char *data, qsizetype size);
+
+// Returns whether the element has the given tag name and namespace. The
+// strings are compared in place, nothing is converted or allocated.
+inline bool isElement(const QDomElement &element, QStringView tagName, QLatin1String xmlns)
+{
+    return element.namespaceURI() == xmlns && element.tagName() == tagName;
+}
+
+//
+// Precomputed key of an HMAC with MD5 or SHA-1, so signing many messages with
+// the same key does not need to derive the padded keys again.
+//
+class QXMPP_EXPORT HmacKey
+{
+public:
+    HmacKey() = default;
+    HmacKey(QCryptographicHash::Algorithm algorithm, const QByteArray &key);
+
+    QByteArray sign(std::initializer_list<QByteArray> parts) const;
+
+private:
+    static constexpr int BlockSize = 64;
+
+    QCryptographicHash::Algorithm m_algorithm = QCryptographicHash::Sha1;
+    std::array<char, BlockSize> m_innerPad = {};
+    std::array<char, BlockSize> m_outerPad = {};
+};
+
 }  // namespace QXmpp::Private
 
 #endif  // QXMPPUTILS_P_H
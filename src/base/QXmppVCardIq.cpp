@@ -655,8 +655,8 @@ public:
     QString nickName;
     QString url;
 
-    // not as 64 base
-    QByteArray photo;
+    // decoded when it is accessed
+    QXmpp::Private::Base64Data photo;
     QString photoType;
 
     QList<QXmppVCardAddress> addresses;
@@ -895,10 +895,26 @@ void QXmppVCardIq::setUrl(const QString &url)
 /// QImageReader imageReader(&buffer);
 /// QImage myImage = imageReader.read();
 /// \endcode
+///
+/// Received photos are only decoded from base64 when they are accessed for
+/// the first time. Use photoAsync() to decode large photos without blocking.
 
 QByteArray QXmppVCardIq::photo() const
 {
-    return d->photo;
+    return d->photo.data();
+}
+
+///
+/// Returns the photo's binary contents, decoded in a thread pool if it has
+/// not been decoded yet.
+///
+/// The task is finished in the calling thread.
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QByteArray> QXmppVCardIq::photoAsync() const
+{
+    return d->photo.decodeAsync();
 }
 
 /// Sets the photo's binary contents.
@@ -1003,8 +1019,7 @@ void QXmppVCardIq::parseElementFromChild(const QDomElement &nodeRecv)
     d->middleName = nameElement.firstChildElement(QStringLiteral("MIDDLE")).text();
     d->url = cardElement.firstChildElement(QStringLiteral("URL")).text();
     QDomElement photoElement = cardElement.firstChildElement(QStringLiteral("PHOTO"));
-    QByteArray base64data = photoElement.firstChildElement(QStringLiteral("BINVAL")).text().toLatin1();
-    d->photo = QByteArray::fromBase64(base64data);
+    d->photo = QXmpp::Private::Base64Data::fromBase64(photoElement.firstChildElement(QStringLiteral("BINVAL")).text());
     d->photoType = photoElement.firstChildElement(QStringLiteral("TYPE")).text();
 
     QDomElement child = cardElement.firstChildElement();
@@ -1069,11 +1084,11 @@ void QXmppVCardIq::toXmlElementFromChild(QXmlStreamWriter *writer) const
     for (const QXmppVCardPhone &phone : d->phones) {
         phone.toXml(writer);
     }
-    if (!photo().isEmpty()) {
+    if (!d->photo.isEmpty()) {
         writer->writeStartElement(QStringLiteral("PHOTO"));
         QString photoType = d->photoType;
         if (photoType.isEmpty()) {
-            photoType = getImageType(d->photo);
+            photoType = getImageType(d->photo.data());
         }
         helperToXmlAddTextElement(writer, QStringLiteral("TYPE"), photoType);
         helperToXmlAddTextElement(writer, QStringLiteral("BINVAL"), d->photo.toBase64());
@@ -6,6 +6,7 @@
 #define QXMPPVCARDIQ_H
 
 #include "QXmppIq.h"
+#include "QXmppTask.h"
 
 #include <QDate>
 #include <QDomElement>
@@ -240,6 +241,7 @@ public:
     void setNickName(const QString &);
 
     QByteArray photo() const;
+    QXmppTask<QByteArray> photoAsync() const;
     void setPhoto(const QByteArray &);
 
     QString photoType() const;
@@ -281,37 +281,110 @@ QXmppTask<void> QXmppAtmManager::makeTrustDecisions(const QString &encryption, c
 }
 
 ///
-/// Handles incoming messages and uses included trust message elements for
+/// Handles an incoming message and uses an included trust message element for
 /// making automatic trust decisions.
 ///
 /// \param message message that can contain a trust message element
 ///
 QXmppTask<void> QXmppAtmManager::handleMessage(const QXmppMessage &message)
 {
+    return handleMessages({ message });
+}
+
+///
+/// Handles multiple messages at once, e.g., a page of archived messages, and
+/// uses included trust message elements for making automatic trust decisions.
+///
+/// The trust messages are processed in the order of \a messages as if each of
+/// them was handled on its own: A trust message is only used for trust
+/// decisions if its sender's key is authenticated, which may be done by an
+/// earlier trust message of the same batch.
+/// But the trust decisions for the same key are merged, so that only the last
+/// one is applied, and all of them are stored together, instead of updating the
+/// storage for each trust message.
+///
+/// Messages without a trust message element are ignored.
+///
+/// \param messages messages that can contain trust message elements
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<void> QXmppAtmManager::handleMessages(const QVector<QXmppMessage> &messages)
+{
+    // encryption protocol namespaces mapped to trust messages
+    QHash<QString, QVector<QXmppMessage>> trustMessages;
+
+    for (const auto &message : messages) {
+        // Skip messages in the following cases:
+        // 1. The message does not contain a trust message element.
+        // 2. The trust message is sent by this endpoint and reflected via
+        //    Message Carbons.
+        if (const auto trustMessageElement = message.trustMessageElement();
+            trustMessageElement &&
+            trustMessageElement->usage() == ns_atm &&
+            message.from() != client()->configuration().jid()) {
+            trustMessages[trustMessageElement->encryption()].append(message);
+        }
+    }
+
+    if (trustMessages.isEmpty()) {
+        return makeReadyTask();
+    }
+
     QXmppPromise<void> promise;
+    auto remainingEncryptions = std::make_shared<int>(trustMessages.size());
 
-    if (const auto trustMessageElement = message.trustMessageElement();
-        trustMessageElement &&
-        trustMessageElement->usage() == ns_atm &&
-        message.from() != client()->configuration().jid()) {
-        const auto senderJid = QXmppUtils::jidToBareJid(message.from());
+    for (auto itr = trustMessages.cbegin(); itr != trustMessages.cend(); ++itr) {
+        auto future = handleTrustMessages(itr.key(), itr.value());
+        future.then(this, [=]() mutable {
+            if (--(*remainingEncryptions) == 0) {
+                promise.finish();
+            }
+        });
+    }
+
+    return promise.task();
+}
+
+///
+/// Makes automatic trust decisions by trust messages of one encryption
+/// protocol.
+///
+/// \param encryption encryption protocol namespace
+/// \param messages messages containing trust message elements for
+///        \a encryption
+///
+QXmppTask<void> QXmppAtmManager::handleTrustMessages(const QString &encryption, const QVector<QXmppMessage> &messages)
+{
+    QXmppPromise<void> promise;
+
+    // The trust levels of all senders' keys are requested at once.
+    QMultiHash<QString, QByteArray> senderKeyIds;
+    for (const auto &message : messages) {
         const auto e2eeMetadata = message.e2eeMetadata();
-        const auto senderKey = e2eeMetadata ? e2eeMetadata->senderKey() : QByteArray();
-        const auto encryption = trustMessageElement->encryption();
+        senderKeyIds.insert(QXmppUtils::jidToBareJid(message.from()), e2eeMetadata ? e2eeMetadata->senderKey() : QByteArray());
+    }
 
-        auto future = trustLevel(encryption, senderJid, senderKey);
-        future.then(this, [=](const auto &&senderKeyTrustLevel) mutable {
-            const auto isSenderKeyAuthenticated = senderKeyTrustLevel == TrustLevel::Authenticated;
+    auto future = trustLevels(encryption, senderKeyIds);
+    future.then(this, [=](QHash<QString, QHash<QByteArray, TrustLevel>> &&keyTrustLevels) mutable {
+        const auto ownJid = client()->configuration().jidBare();
 
-            // key owner JIDs mapped to key IDs
-            QMultiHash<QString, QByteArray> keysBeingAuthenticated;
-            QMultiHash<QString, QByteArray> keysBeingDistrusted;
+        // key owner JIDs mapped to key IDs and whether they are authenticated
+        // (true) or distrusted (false)
+        QHash<QString, QHash<QByteArray, bool>> trustDecisions;
+
+        // sender key IDs mapped to the trust decisions postponed until the
+        // sender key is authenticated
+        QHash<QByteArray, QHash<QString, QHash<QByteArray, bool>>> postponedTrustDecisions;
 
-            QList<QXmppTrustMessageKeyOwner> keyOwnersForPostponedTrustDecisions;
+        for (const auto &message : messages) {
+            const auto senderJid = QXmppUtils::jidToBareJid(message.from());
+            const auto e2eeMetadata = message.e2eeMetadata();
+            const auto senderKey = e2eeMetadata ? e2eeMetadata->senderKey() : QByteArray();
 
-            const auto ownJid = client()->configuration().jidBare();
+            const auto isSenderKeyAuthenticated = keyTrustLevels.value(senderJid).value(senderKey, TrustLevel::Undecided) == TrustLevel::Authenticated;
             const auto isOwnTrustMessage = senderJid == ownJid;
-            const auto keyOwners = trustMessageElement->keyOwners();
+            const auto keyOwners = message.trustMessageElement()->keyOwners();
 
             for (const auto &keyOwner : keyOwners) {
                 const auto keyOwnerJid = keyOwner.jid();
@@ -323,43 +396,82 @@ QXmppTask<void> QXmppAtmManager::handleMessage(const QXmppMessage &message)
                 // only allowed to authenticate or distrust the keys of that
                 // contact's own endpoints.
                 const auto isSenderQualifiedForTrustDecisions = isOwnTrustMessage || senderJid == keyOwnerJid;
-                if (isSenderQualifiedForTrustDecisions) {
-                    // Make trust decisions if the key of the sender is
-                    // authenticated.
-                    // Othwerwise, store the keys of the trust message for
-                    // making the trust decisions as soon as the key of the
-                    // sender is authenticated.
-                    if (isSenderKeyAuthenticated) {
-                        const auto trustedKeys = keyOwner.trustedKeys();
-                        for (const auto &key : trustedKeys) {
-                            keysBeingAuthenticated.insert(keyOwnerJid, key);
-                        }
+                if (!isSenderQualifiedForTrustDecisions) {
+                    continue;
+                }
 
-                        const auto distrustedKeys = keyOwner.distrustedKeys();
-                        for (const auto &key : distrustedKeys) {
-                            keysBeingDistrusted.insert(keyOwnerJid, key);
+                // Make trust decisions if the key of the sender is
+                // authenticated.
+                // Othwerwise, store the keys of the trust message for making
+                // the trust decisions as soon as the key of the sender is
+                // authenticated.
+                auto &keyOwnerTrustDecisions = isSenderKeyAuthenticated ? trustDecisions[keyOwnerJid] : postponedTrustDecisions[senderKey][keyOwnerJid];
+                const auto decide = [&](const QList<QByteArray> &keyIds, bool trust) {
+                    for (const auto &keyId : keyIds) {
+                        keyOwnerTrustDecisions.insert(keyId, trust);
+
+                        // Later trust messages of the same batch are handled
+                        // as if this decision had already been stored.
+                        if (isSenderKeyAuthenticated) {
+                            keyTrustLevels[keyOwnerJid].insert(keyId, trust ? TrustLevel::Authenticated : TrustLevel::ManuallyDistrusted);
                         }
-                    } else {
-                        keyOwnersForPostponedTrustDecisions.append(keyOwner);
                     }
+                };
+                decide(keyOwner.trustedKeys(), true);
+                decide(keyOwner.distrustedKeys(), false);
+            }
+        }
+
+        // key owner JIDs mapped to key IDs
+        QMultiHash<QString, QByteArray> keysBeingAuthenticated;
+        QMultiHash<QString, QByteArray> keysBeingDistrusted;
+
+        for (auto itr = trustDecisions.cbegin(); itr != trustDecisions.cend(); ++itr) {
+            for (auto keyItr = itr->cbegin(); keyItr != itr->cend(); ++keyItr) {
+                (keyItr.value() ? keysBeingAuthenticated : keysBeingDistrusted).insert(itr.key(), keyItr.key());
+            }
+        }
+
+        auto makeDecisions = [=]() mutable {
+            auto future = makeTrustDecisions(encryption, keysBeingAuthenticated, keysBeingDistrusted);
+            future.then(this, [=]() mutable {
+                promise.finish();
+            });
+        };
+
+        if (postponedTrustDecisions.isEmpty()) {
+            makeDecisions();
+            return;
+        }
+
+        auto remainingSenderKeys = std::make_shared<int>(postponedTrustDecisions.size());
+
+        for (auto itr = postponedTrustDecisions.cbegin(); itr != postponedTrustDecisions.cend(); ++itr) {
+            QList<QXmppTrustMessageKeyOwner> keyOwners;
+
+            for (auto ownerItr = itr->cbegin(); ownerItr != itr->cend(); ++ownerItr) {
+                QList<QByteArray> trustedKeys;
+                QList<QByteArray> distrustedKeys;
+
+                for (auto keyItr = ownerItr->cbegin(); keyItr != ownerItr->cend(); ++keyItr) {
+                    (keyItr.value() ? trustedKeys : distrustedKeys).append(keyItr.key());
                 }
+
+                QXmppTrustMessageKeyOwner keyOwner;
+                keyOwner.setJid(ownerItr.key());
+                keyOwner.setTrustedKeys(trustedKeys);
+                keyOwner.setDistrustedKeys(distrustedKeys);
+                keyOwners.append(keyOwner);
             }
 
-            auto future = trustStorage()->addKeysForPostponedTrustDecisions(encryption, senderKey, keyOwnersForPostponedTrustDecisions);
+            auto future = trustStorage()->addKeysForPostponedTrustDecisions(encryption, itr.key(), keyOwners);
             future.then(this, [=]() mutable {
-                auto future = makeTrustDecisions(encryption, keysBeingAuthenticated, keysBeingDistrusted);
-                future.then(this, [=]() mutable {
-                    promise.finish();
-                });
+                if (--(*remainingSenderKeys) == 0) {
+                    makeDecisions();
+                }
             });
-        });
-    } else {
-        // Skip further processing in the following cases:
-        // 1. The message does not contain a trust message element.
-        // 2. The trust message is sent by this endpoint and reflected via
-        //    Message Carbons.
-        promise.finish();
-    }
+        }
+    });
 
     return promise.task();
 }
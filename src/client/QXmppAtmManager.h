@@ -22,6 +22,8 @@ public:
     QXmppAtmManager(QXmppAtmTrustStorage *trustStorage);
     QXmppTask<void> makeTrustDecisions(const QString &encryption, const QString &keyOwnerJid, const QList<QByteArray> &keyIdsForAuthentication, const QList<QByteArray> &keyIdsForDistrusting = {});
 
+    QXmppTask<void> handleMessages(const QVector<QXmppMessage> &messages);
+
 protected:
     /// \cond
     void setClient(QXmppClient *client) override;
@@ -32,6 +34,7 @@ private:
 
     QXmppTask<void> makeTrustDecisions(const QString &encryption, const QMultiHash<QString, QByteArray> &keyIdsForAuthentication, const QMultiHash<QString, QByteArray> &keyIdsForDistrusting);
     QXmppTask<void> handleMessage(const QXmppMessage &message);
+    QXmppTask<void> handleTrustMessages(const QString &encryption, const QVector<QXmppMessage> &messages);
 
     QXmppTask<void> authenticate(const QString &encryption, const QMultiHash<QString, QByteArray> &keyIds);
     QXmppTask<void> distrust(const QString &encryption, const QMultiHash<QString, QByteArray> &keyIds);
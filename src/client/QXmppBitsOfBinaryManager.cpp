@@ -0,0 +1,425 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppBitsOfBinaryManager.h"
+
+#include "QXmppBitsOfBinaryContentId.h"
+#include "QXmppBitsOfBinaryDataList.h"
+#include "QXmppBitsOfBinaryIq.h"
+#include "QXmppClient.h"
+#include "QXmppError.h"
+#include "QXmppFutureUtils_p.h"
+#include "QXmppMessage.h"
+#include "QXmppPromise.h"
+
+#include <list>
+#include <vector>
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QMimeDatabase>
+#include <QSaveFile>
+
+using namespace QXmpp::Private;
+
+// bytes of decoded data kept in memory by default
+constexpr qint64 DEFAULT_MEMORY_CACHE_SIZE = 8 * 1024 * 1024;
+// version of the files in the cache directory
+constexpr quint32 CACHE_FILE_VERSION = 1;
+
+struct CachedData
+{
+    QString contentId;
+    QXmppBitsOfBinaryData data;
+    // invalid if the data doesn't expire
+    QDateTime expiry;
+};
+
+class QXmppBitsOfBinaryManagerPrivate
+{
+public:
+    std::optional<QXmppBitsOfBinaryData> find(const QString &contentId);
+    void insert(const QXmppBitsOfBinaryData &data);
+    void insertInMemory(CachedData &&entry);
+    void evict();
+    void clearMemory();
+
+    std::optional<CachedData> readFile(const QString &contentId) const;
+    void writeFile(const CachedData &entry) const;
+    QString filePath(const QString &contentId) const;
+
+    void finishRequests(const QString &contentId, const QXmppBitsOfBinaryManager::DataResult &result);
+
+    qint64 memoryCacheSize = DEFAULT_MEMORY_CACHE_SIZE;
+    qint64 memoryUsage = 0;
+    QString cacheDirectory;
+
+    // the most recently used data first
+    std::list<CachedData> entries;
+    QHash<QString, std::list<CachedData>::iterator> index;
+
+    // promises of the requests waiting for the same data
+    QHash<QString, std::vector<QXmppPromise<QXmppBitsOfBinaryManager::DataResult>>> pendingRequests;
+};
+
+static bool isExpired(const QDateTime &expiry)
+{
+    return expiry.isValid() && expiry <= QDateTime::currentDateTimeUtc();
+}
+
+// Returns whether the data matches the hash of its content ID, so other data
+// can't be cached under the ID.
+static bool matchesContentId(const QXmppBitsOfBinaryContentId &cid, const QByteArray &data)
+{
+    return cid.isValid() && QCryptographicHash::hash(data, cid.algorithm()) == cid.hash();
+}
+
+std::optional<QXmppBitsOfBinaryData> QXmppBitsOfBinaryManagerPrivate::find(const QString &contentId)
+{
+    if (const auto itr = index.constFind(contentId); itr != index.constEnd()) {
+        const auto entry = *itr;
+        if (isExpired(entry->expiry)) {
+            memoryUsage -= entry->data.data().size();
+            entries.erase(entry);
+            index.erase(itr);
+            if (!cacheDirectory.isEmpty()) {
+                QFile::remove(filePath(contentId));
+            }
+            return {};
+        }
+        // move to the front
+        entries.splice(entries.begin(), entries, entry);
+        return entry->data;
+    }
+
+    if (auto entry = readFile(contentId)) {
+        auto data = entry->data;
+        insertInMemory(std::move(*entry));
+        return data;
+    }
+    return {};
+}
+
+void QXmppBitsOfBinaryManagerPrivate::insert(const QXmppBitsOfBinaryData &data)
+{
+    CachedData entry { data.cid().toContentId(), data, {} };
+    if (data.maxAge() > 0) {
+        entry.expiry = QDateTime::currentDateTimeUtc().addSecs(data.maxAge());
+    }
+    writeFile(entry);
+    insertInMemory(std::move(entry));
+}
+
+void QXmppBitsOfBinaryManagerPrivate::insertInMemory(CachedData &&entry)
+{
+    if (const auto itr = index.constFind(entry.contentId); itr != index.constEnd()) {
+        memoryUsage -= (*itr)->data.data().size();
+        entries.erase(*itr);
+        index.erase(itr);
+    }
+
+    const auto contentId = entry.contentId;
+    memoryUsage += entry.data.data().size();
+    entries.push_front(std::move(entry));
+    index.insert(contentId, entries.begin());
+    evict();
+}
+
+// Removes the least recently used data until the size limit is kept.
+void QXmppBitsOfBinaryManagerPrivate::evict()
+{
+    while (memoryUsage > memoryCacheSize && !entries.empty()) {
+        const auto &entry = entries.back();
+        memoryUsage -= entry.data.data().size();
+        index.remove(entry.contentId);
+        entries.pop_back();
+    }
+}
+
+void QXmppBitsOfBinaryManagerPrivate::clearMemory()
+{
+    entries.clear();
+    index.clear();
+    memoryUsage = 0;
+}
+
+std::optional<CachedData> QXmppBitsOfBinaryManagerPrivate::readFile(const QString &contentId) const
+{
+    if (cacheDirectory.isEmpty()) {
+        return {};
+    }
+
+    QFile file(filePath(contentId));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_15);
+    quint32 version = 0;
+    QString contentType;
+    QDateTime expiry;
+    int maxAge = -1;
+    QByteArray bytes;
+    stream >> version;
+    if (version != CACHE_FILE_VERSION) {
+        return {};
+    }
+    stream >> contentType >> maxAge >> expiry >> bytes;
+
+    const auto cid = QXmppBitsOfBinaryContentId::fromContentId(contentId);
+    if (stream.status() != QDataStream::Ok || isExpired(expiry) || !matchesContentId(cid, bytes)) {
+        file.remove();
+        return {};
+    }
+
+    QXmppBitsOfBinaryData data;
+    data.setCid(cid);
+    data.setContentType(QMimeDatabase().mimeTypeForName(contentType));
+    data.setMaxAge(maxAge);
+    data.setData(bytes);
+    return CachedData { contentId, std::move(data), expiry };
+}
+
+void QXmppBitsOfBinaryManagerPrivate::writeFile(const CachedData &entry) const
+{
+    if (cacheDirectory.isEmpty()) {
+        return;
+    }
+
+    QSaveFile file(filePath(entry.contentId));
+    if (!QDir().mkpath(cacheDirectory) || !file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << CACHE_FILE_VERSION << entry.data.contentType().name() << entry.data.maxAge()
+           << entry.expiry << entry.data.data();
+    file.commit();
+}
+
+QString QXmppBitsOfBinaryManagerPrivate::filePath(const QString &contentId) const
+{
+    // content IDs only consist of the algorithm, the hex hash and the domain
+    return QDir(cacheDirectory).filePath(contentId);
+}
+
+void QXmppBitsOfBinaryManagerPrivate::finishRequests(const QString &contentId, const QXmppBitsOfBinaryManager::DataResult &result)
+{
+    auto promises = pendingRequests.take(contentId);
+    for (auto &promise : promises) {
+        promise.finish(QXmppBitsOfBinaryManager::DataResult(result));
+    }
+}
+
+///
+/// \class QXmppBitsOfBinaryManager
+///
+/// \brief The QXmppBitsOfBinaryManager class requests and caches the data of
+/// \xep{0231, Bits of Binary} by its content ID.
+///
+/// Small images, e.g. custom emojis, stickers or CAPTCHA images in data forms,
+/// are referenced by \c cid: URLs and the same data is often referenced many
+/// times. The manager keeps the data in memory and, if a cache directory is
+/// set, on disk, so that it is requested only once. The data included in
+/// received messages is cached as well.
+///
+/// Data is cached as long as its \c max-age allows it. The data in memory is
+/// limited by memoryCacheSize() and the least recently used data is removed
+/// first. Data whose hash doesn't match its content ID isn't cached.
+///
+/// \ingroup Managers
+///
+/// \since QXmpp 1.6
+///
+
+///
+/// Constructs a Bits of Binary manager.
+///
+QXmppBitsOfBinaryManager::QXmppBitsOfBinaryManager()
+    : d(std::make_unique<QXmppBitsOfBinaryManagerPrivate>())
+{
+}
+
+QXmppBitsOfBinaryManager::~QXmppBitsOfBinaryManager() = default;
+
+///
+/// Returns the maximum number of bytes of data kept in memory.
+///
+qint64 QXmppBitsOfBinaryManager::memoryCacheSize() const
+{
+    return d->memoryCacheSize;
+}
+
+///
+/// Sets the maximum number of bytes of data kept in memory.
+///
+/// The default is 8 MiB.
+///
+void QXmppBitsOfBinaryManager::setMemoryCacheSize(qint64 size)
+{
+    d->memoryCacheSize = size;
+    d->evict();
+}
+
+///
+/// Returns the directory in which the data is cached on disk, or an empty
+/// string if it is only cached in memory.
+///
+QString QXmppBitsOfBinaryManager::cacheDirectory() const
+{
+    return d->cacheDirectory;
+}
+
+///
+/// Sets the directory in which the data is cached on disk.
+///
+/// The data in the directory is kept across sessions. Expired data is removed
+/// when it is looked up.
+///
+void QXmppBitsOfBinaryManager::setCacheDirectory(const QString &path)
+{
+    d->cacheDirectory = path;
+}
+
+///
+/// Returns the cached data with the content ID, or nothing if the data isn't
+/// cached or has expired.
+///
+std::optional<QXmppBitsOfBinaryData> QXmppBitsOfBinaryManager::cachedData(const QXmppBitsOfBinaryContentId &cid)
+{
+    if (!cid.isValid()) {
+        return {};
+    }
+    return d->find(cid.toContentId());
+}
+
+///
+/// Adds data to the cache, e.g. data received in a data form.
+///
+/// The data is decoded in a thread pool and cached afterwards. It isn't cached
+/// if its \c max-age is zero or its hash doesn't match its content ID.
+/// Requests for the data that are still waiting for a response are finished
+/// with it.
+///
+void QXmppBitsOfBinaryManager::addData(const QXmppBitsOfBinaryData &data)
+{
+    if (data.maxAge() == 0 || !data.cid().isValid()) {
+        return;
+    }
+
+    data.dataAsync().then(this, [this, data](QByteArray &&bytes) {
+        if (!matchesContentId(data.cid(), bytes)) {
+            warning(QStringLiteral("Not caching Bits of Binary data that doesn't match %1").arg(data.cid().toContentId()));
+            return;
+        }
+
+        auto decoded = data;
+        decoded.setData(bytes);
+        d->insert(decoded);
+        d->finishRequests(decoded.cid().toContentId(), decoded);
+    });
+}
+
+///
+/// Removes all data from the cache in memory and on disk.
+///
+void QXmppBitsOfBinaryManager::clearCache()
+{
+    d->clearMemory();
+    if (!d->cacheDirectory.isEmpty()) {
+        QDir(d->cacheDirectory).removeRecursively();
+    }
+}
+
+///
+/// Returns the data with the content ID from the cache or requests it from
+/// the entity.
+///
+/// Concurrent requests for the same data are sent only once.
+///
+/// \param jid JID of the entity that referenced the data
+/// \param cid content ID of the data
+///
+auto QXmppBitsOfBinaryManager::requestData(const QString &jid, const QXmppBitsOfBinaryContentId &cid) -> QXmppTask<DataResult>
+{
+    if (!cid.isValid()) {
+        return makeReadyTask<DataResult>(QXmppError { QStringLiteral("Invalid content ID."), {} });
+    }
+    if (auto data = cachedData(cid)) {
+        return makeReadyTask<DataResult>(std::move(*data));
+    }
+
+    const auto contentId = cid.toContentId();
+    auto &promises = d->pendingRequests[contentId];
+    const bool requested = !promises.empty();
+    promises.emplace_back();
+    auto task = promises.back().task();
+    if (requested) {
+        return task;
+    }
+
+    QXmppBitsOfBinaryIq iq;
+    iq.setType(QXmppIq::Get);
+    iq.setTo(jid);
+    iq.setCid(cid);
+
+    using IqResult = std::variant<QXmppBitsOfBinaryIq, QXmppError>;
+    chainIq<IqResult>(client()->sendIq(std::move(iq)), this).then(this, [this, contentId, cid](IqResult &&result) {
+        if (auto *error = std::get_if<QXmppError>(&result)) {
+            d->finishRequests(contentId, std::move(*error));
+            return;
+        }
+
+        const auto response = std::get<QXmppBitsOfBinaryIq>(std::move(result));
+        response.dataAsync().then(this, [this, contentId, cid, response](QByteArray &&bytes) {
+            if (!matchesContentId(cid, bytes)) {
+                d->finishRequests(contentId, QXmppError { QStringLiteral("The received data doesn't match the content ID."), {} });
+                return;
+            }
+
+            QXmppBitsOfBinaryData data;
+            data.setCid(cid);
+            data.setContentType(response.contentType());
+            data.setMaxAge(response.maxAge());
+            data.setData(bytes);
+            if (data.maxAge() != 0) {
+                d->insert(data);
+            }
+            d->finishRequests(contentId, data);
+        });
+    });
+    return task;
+}
+
+///
+/// Returns the data referenced by the \c cid: URL of a media element in a data
+/// form, e.g. a CAPTCHA image, from the cache or requests it from the entity.
+///
+/// \param jid JID of the entity that sent the data form
+/// \param source source of the media element
+///
+auto QXmppBitsOfBinaryManager::requestData(const QString &jid, const QXmppDataForm::MediaSource &source) -> QXmppTask<DataResult>
+{
+    return requestData(jid, QXmppBitsOfBinaryContentId::fromCidUrl(source.uri().toString()));
+}
+
+/// \cond
+bool QXmppBitsOfBinaryManager::handleMessage(const QXmppMessage &message)
+{
+    if (message.type() != QXmppMessage::Error) {
+        const auto dataList = message.bitsOfBinaryData();
+        for (const auto &data : dataList) {
+            addData(data);
+        }
+    }
+
+    // the message is also passed on to the other handlers
+    return false;
+}
+/// \endcond
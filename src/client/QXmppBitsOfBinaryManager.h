@@ -0,0 +1,55 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPBITSOFBINARYMANAGER_H
+#define QXMPPBITSOFBINARYMANAGER_H
+
+#include "QXmppBitsOfBinaryData.h"
+#include "QXmppClientExtension.h"
+#include "QXmppDataForm.h"
+#include "QXmppMessageHandler.h"
+
+#include <memory>
+#include <optional>
+#include <variant>
+
+template<class T>
+class QXmppTask;
+class QXmppBitsOfBinaryContentId;
+class QXmppBitsOfBinaryManagerPrivate;
+class QXmppMessage;
+struct QXmppError;
+
+class QXMPP_EXPORT QXmppBitsOfBinaryManager : public QXmppClientExtension, public QXmppMessageHandler
+{
+    Q_OBJECT
+public:
+    /// Contains the data or the error of the request.
+    using DataResult = std::variant<QXmppBitsOfBinaryData, QXmppError>;
+
+    QXmppBitsOfBinaryManager();
+    ~QXmppBitsOfBinaryManager() override;
+
+    qint64 memoryCacheSize() const;
+    void setMemoryCacheSize(qint64 size);
+
+    QString cacheDirectory() const;
+    void setCacheDirectory(const QString &path);
+
+    std::optional<QXmppBitsOfBinaryData> cachedData(const QXmppBitsOfBinaryContentId &cid);
+    void addData(const QXmppBitsOfBinaryData &data);
+    void clearCache();
+
+    QXmppTask<DataResult> requestData(const QString &jid, const QXmppBitsOfBinaryContentId &cid);
+    QXmppTask<DataResult> requestData(const QString &jid, const QXmppDataForm::MediaSource &source);
+
+    /// \cond
+    bool handleMessage(const QXmppMessage &) override;
+    /// \endcond
+
+private:
+    const std::unique_ptr<QXmppBitsOfBinaryManagerPrivate> d;
+};
+
+#endif  // QXMPPBITSOFBINARYMANAGER_H
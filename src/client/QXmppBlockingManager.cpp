@@ -8,6 +8,7 @@
 #include "QXmppUtils.h"
 
 #include <QDomElement>
+#include <QSet>
 #include <QStringBuilder>
 
 constexpr QStringView XMLNS_BLOCKING = u"urn:xmpp:blocking";
@@ -16,14 +17,6 @@ using namespace QXmpp;
 using namespace QXmpp::Private;
 using StanzaError = QXmppStanza::Error;
 
-// utility function
-template<typename T>
-static void makeUnique(T &vec)
-{
-    std::sort(vec.begin(), vec.end());
-    vec.erase(std::unique(vec.begin(), vec.end()), vec.end());
-}
-
 // IQ parsing helpers
 static QVector<QString> parseItems(const QDomElement &el)
 {
@@ -124,10 +117,80 @@ public:
     }
 };
 
+// Blocklist data
+class QXmppBlocklistPrivate : public QSharedData
+{
+public:
+    void insert(const QString &entry);
+    void remove(const QString &entry);
+
+    // entries in the order they were added
+    QVector<QString> entries;
+    QSet<QString> entrySet;
+
+    // indices for the entries that block a JID partially
+    // full JIDs by their bare JID
+    QHash<QString, QVector<QString>> fullJidsByBareJid;
+    // full and bare JIDs by their domain
+    QHash<QString, QVector<QString>> userJidsByDomain;
+    // domains with resource by their domain
+    QHash<QString, QVector<QString>> domainResourcesByDomain;
+};
+
+void QXmppBlocklistPrivate::insert(const QString &entry)
+{
+    if (entrySet.contains(entry)) {
+        return;
+    }
+    entries.append(entry);
+    entrySet.insert(entry);
+
+    const auto domain = QXmppUtils::jidToDomain(entry);
+    if (QXmppUtils::jidToUser(entry).isEmpty()) {
+        if (!QXmppUtils::jidToResource(entry).isEmpty()) {
+            domainResourcesByDomain[domain].append(entry);
+        }
+        return;
+    }
+
+    userJidsByDomain[domain].append(entry);
+    if (!QXmppUtils::jidToResource(entry).isEmpty()) {
+        fullJidsByBareJid[QXmppUtils::jidToBareJid(entry)].append(entry);
+    }
+}
+
+void QXmppBlocklistPrivate::remove(const QString &entry)
+{
+    if (!entrySet.remove(entry)) {
+        return;
+    }
+    entries.removeOne(entry);
+
+    auto removeFromIndex = [&entry](QHash<QString, QVector<QString>> &index, const QString &key) {
+        if (auto itr = index.find(key); itr != index.end()) {
+            itr->removeOne(entry);
+            if (itr->isEmpty()) {
+                index.erase(itr);
+            }
+        }
+    };
+
+    const auto domain = QXmppUtils::jidToDomain(entry);
+    if (QXmppUtils::jidToUser(entry).isEmpty()) {
+        removeFromIndex(domainResourcesByDomain, domain);
+        return;
+    }
+
+    removeFromIndex(userJidsByDomain, domain);
+    if (!QXmppUtils::jidToResource(entry).isEmpty()) {
+        removeFromIndex(fullJidsByBareJid, QXmppUtils::jidToBareJid(entry));
+    }
+}
+
 // Manager data
 struct QXmppBlockingManagerPrivate
 {
-    std::optional<QVector<QString>> blocklist;
+    std::optional<QXmppBlocklist> blocklist;
 };
 
 ///
@@ -267,18 +330,20 @@ QXmppTask<QXmppBlockingManager::BlocklistResult> QXmppBlockingManager::fetchBloc
 {
     // use cached blocklist if possible
     if (d->blocklist) {
-        return makeReadyTask<BlocklistResult>(QXmppBlocklist(d->blocklist.value()));
+        return makeReadyTask<BlocklistResult>(*d->blocklist);
     }
 
     // request blocklist from server
     return chainIq(client()->sendIq(BlocklistIq()), this, [this](BlocklistIq &&iq) -> BlocklistResult {
+        QXmppBlocklist blocklist(std::move(iq.jids));
+
         // initially store blocklist
         if (!d->blocklist) {
-            d->blocklist = iq.jids;
+            d->blocklist = blocklist;
             Q_EMIT subscribedChanged();
         }
 
-        return QXmppBlocklist(iq.jids);
+        return blocklist;
     });
 }
 
@@ -377,9 +442,7 @@ bool QXmppBlockingManager::handleStanza(const QDomElement &stanza, const std::op
         }
 
         // store new jids
-        d->blocklist->append(iq.jids);
-        // assure blocklist has no duplicates
-        makeUnique(*d->blocklist);
+        d->blocklist->addEntries(iq.jids);
 
         Q_EMIT blocked(iq.jids);
         return QXmppIq(QXmppIq::Result);
@@ -390,9 +453,7 @@ bool QXmppBlockingManager::handleStanza(const QDomElement &stanza, const std::op
         }
 
         // remove jids
-        for (const auto &jid : iq.jids) {
-            d->blocklist->removeOne(jid);
-        }
+        d->blocklist->removeEntries(iq.jids);
 
         Q_EMIT unblocked(iq.jids);
         return QXmppIq(QXmppIq::Result);
@@ -428,12 +489,24 @@ void QXmppBlockingManager::onConnected()
 /// blocked (NotBlocked).
 ///
 
-QXmppBlocklist::QXmppBlocklist() = default;
+QXmppBlocklist::QXmppBlocklist()
+    : d(new QXmppBlocklistPrivate)
+{
+}
 
+///
 /// Constructs with given entries.
+///
+/// Duplicate entries are only stored once.
+///
 QXmppBlocklist::QXmppBlocklist(QVector<QString> entries)
-    : m_blocklist(std::move(entries))
+    : d(new QXmppBlocklistPrivate)
 {
+    d->entries.reserve(entries.size());
+    d->entrySet.reserve(entries.size());
+    for (const auto &entry : std::as_const(entries)) {
+        d->insert(entry);
+    }
 }
 
 QXMPP_PRIVATE_DEFINE_RULE_OF_SIX(QXmppBlocklist)
@@ -446,7 +519,7 @@ QXMPP_PRIVATE_DEFINE_RULE_OF_SIX(QXmppBlocklist)
 ///
 QVector<QString> QXmppBlocklist::entries() const
 {
-    return m_blocklist;
+    return d->entries;
 }
 
 ///
@@ -458,10 +531,25 @@ QVector<QString> QXmppBlocklist::entries() const
 ///
 bool QXmppBlocklist::containsEntry(QStringView entry) const
 {
-    // Can be replaced with .contains() with Qt 6
-    return std::find(m_blocklist.begin(), m_blocklist.end(), entry) != m_blocklist.end();
+    return d->entrySet.contains(entry.toString());
+}
+
+/// \cond
+void QXmppBlocklist::addEntries(const QVector<QString> &entries)
+{
+    for (const auto &entry : entries) {
+        d->insert(entry);
+    }
 }
 
+void QXmppBlocklist::removeEntries(const QVector<QString> &entries)
+{
+    for (const auto &entry : entries) {
+        d->remove(entry);
+    }
+}
+/// \endcond
+
 ///
 /// Checks the blocking state of a JID.
 ///
@@ -505,12 +593,12 @@ QXmppBlocklist::BlockingState QXmppBlocklist::blockingState(const QString &jid)
     QVector<QString> partiallyBlockingJids;
 
     auto checkBlockingJid = [this, &blockingJids](const QString &jid) {
-        if (m_blocklist.contains(jid)) {
+        if (d->entrySet.contains(jid)) {
             blockingJids.append(jid);
         }
     };
     auto checkPartiallyBlockingJid = [this, &partiallyBlockingJids](const QString &jid) {
-        if (m_blocklist.contains(jid)) {
+        if (d->entrySet.contains(jid)) {
             partiallyBlockingJids.append(jid);
         }
     };
@@ -540,12 +628,7 @@ QXmppBlocklist::BlockingState QXmppBlocklist::blockingState(const QString &jid)
         checkBlockingJid(domain);
 
         // look for full jids blocking the bare jid partially
-        QString fullJidStart = jid + u'/';
-        for (const auto &blockedJid : m_blocklist) {
-            if (blockedJid.startsWith(fullJidStart)) {
-                partiallyBlockingJids.append(blockedJid);
-            }
-        }
+        partiallyBlockingJids.append(d->fullJidsByBareJid.value(jid));
 
         checkPartiallyBlockingJid(domain % u'/' % resource);
         break;
@@ -560,14 +643,8 @@ QXmppBlocklist::BlockingState QXmppBlocklist::blockingState(const QString &jid)
         checkBlockingJid(jid);
 
         // look for full/bare jids and domain+resource jids
-        QString userJidSubstring = u'@' % domain;
-        QString domainResourceSubstring = domain % u'/';
-
-        for (const auto &blockedJid : m_blocklist) {
-            if (blockedJid.contains(userJidSubstring) || blockedJid.contains(domainResourceSubstring)) {
-                partiallyBlockingJids.append(blockedJid);
-            }
-        }
+        partiallyBlockingJids.append(d->userJidsByDomain.value(domain));
+        partiallyBlockingJids.append(d->domainResourcesByDomain.value(domain));
 
         break;
     }
@@ -582,12 +659,7 @@ QXmppBlocklist::BlockingState QXmppBlocklist::blockingState(const QString &jid)
         checkBlockingJid(domain);
 
         // look for full/bare jids
-        QString userJidSubstring = u'@' % domain;
-        for (const auto &blockedJid : m_blocklist) {
-            if (blockedJid.contains(userJidSubstring)) {
-                partiallyBlockingJids.append(blockedJid);
-            }
-        }
+        partiallyBlockingJids.append(d->userJidsByDomain.value(domain));
         break;
     }
     }
@@ -8,10 +8,12 @@
 #include "QXmppError.h"
 #include "QXmppTask.h"
 
+#include <QSharedDataPointer>
 #include <QVector>
 
 #include <variant>
 
+class QXmppBlocklistPrivate;
 struct QXmppBlockingManagerPrivate;
 
 class QXMPP_EXPORT QXmppBlocklist
@@ -41,7 +43,12 @@ public:
     BlockingState blockingState(const QString &jid) const;
 
 private:
-    QVector<QString> m_blocklist;
+    void addEntries(const QVector<QString> &entries);
+    void removeEntries(const QVector<QString> &entries);
+
+    QSharedDataPointer<QXmppBlocklistPrivate> d;
+
+    friend class QXmppBlockingManager;
 };
 
 class QXMPP_EXPORT QXmppBlockingManager : public QXmppClientExtension
@@ -8,10 +8,19 @@
 #include "QXmppClient.h"
 #include "QXmppConstants_p.h"
 #include "QXmppIq.h"
+#include "QXmppPubSubEvent.h"
+#include "QXmppPubSubManager.h"
+#include "QXmppTask.h"
 #include "QXmppUtils.h"
+#include "QXmppUtils_p.h"
+
+#include <algorithm>
 
 #include <QDomElement>
 
+using namespace QXmpp;
+using namespace QXmpp::Private;
+
 // The QXmppPrivateStorageIq class represents an XML private storage IQ
 // as defined by XEP-0049: Private XML Storage.
 //
@@ -64,6 +73,113 @@ void QXmppPrivateStorageIq::toXmlElementFromChild(QXmlStreamWriter *writer) cons
     writer->writeEndElement();
 }
 
+// The QXmppPepBookmarkItem class represents a conference bookmark as PEP item
+// as defined by XEP-0402: PEP Native Bookmarks.
+//
+// The item ID is the JID of the conference room.
+
+class QXmppPepBookmarkItem : public QXmppPubSubBaseItem
+{
+public:
+    QXmppPepBookmarkItem(const QXmppBookmarkConference &conference = {})
+        : QXmppPubSubBaseItem(conference.jid()),
+          m_conference(conference)
+    {
+    }
+
+    QXmppBookmarkConference conference() const
+    {
+        auto conference = m_conference;
+        conference.setJid(id());
+        return conference;
+    }
+
+    static bool isItem(const QDomElement &element)
+    {
+        return QXmppPubSubBaseItem::isItem(element, [](const QDomElement &payload) {
+            return isElement(payload, u"conference", ns_bookmarks_1);
+        });
+    }
+
+protected:
+    void parsePayload(const QDomElement &payloadElement) override
+    {
+        const auto autoJoin = payloadElement.attribute("autojoin");
+        m_conference.setAutoJoin(autoJoin == u"true" || autoJoin == u"1");
+        m_conference.setName(payloadElement.attribute("name"));
+        m_conference.setNickName(payloadElement.firstChildElement("nick").text());
+    }
+
+    void serializePayload(QXmlStreamWriter *writer) const override
+    {
+        writer->writeStartElement("conference");
+        writer->writeDefaultNamespace(ns_bookmarks_1);
+        if (m_conference.autoJoin()) {
+            helperToXmlAddAttribute(writer, "autojoin", "true");
+        }
+        helperToXmlAddAttribute(writer, "name", m_conference.name());
+        if (!m_conference.nickName().isEmpty()) {
+            helperToXmlAddTextElement(writer, "nick", m_conference.nickName());
+        }
+        writer->writeEndElement();
+    }
+
+private:
+    QXmppBookmarkConference m_conference;
+};
+
+// Publish options of the bookmarks node as required by XEP-0402
+static QXmppPubSubPublishOptions pepBookmarksPublishOptions()
+{
+    QXmppPubSubPublishOptions publishOptions;
+    publishOptions.setPersistItems(true);
+    publishOptions.setMaxItems(QXmppPubSubNodeConfig::Max());
+    publishOptions.setSendLastItem(QXmppPubSubNodeConfig::Never);
+    publishOptions.setAccessModel(QXmppPubSubNodeConfig::Allowlist);
+    return publishOptions;
+}
+
+static bool isEqual(const QXmppBookmarkConference &a, const QXmppBookmarkConference &b)
+{
+    return a.jid() == b.jid() &&
+        a.name() == b.name() &&
+        a.nickName() == b.nickName() &&
+        a.autoJoin() == b.autoJoin();
+}
+
+// Adds or replaces the bookmark of a conference and returns whether the set has changed.
+static bool insertConference(QXmppBookmarkSet &bookmarks, const QXmppBookmarkConference &conference)
+{
+    auto conferences = bookmarks.conferences();
+    auto itr = std::find_if(conferences.begin(), conferences.end(), [&](const auto &other) {
+        return other.jid() == conference.jid();
+    });
+    if (itr == conferences.end()) {
+        conferences.append(conference);
+    } else if (!isEqual(*itr, conference)) {
+        *itr = conference;
+    } else {
+        return false;
+    }
+    bookmarks.setConferences(conferences);
+    return true;
+}
+
+// Removes the bookmark of a conference and returns whether the set has changed.
+static bool removeConference(QXmppBookmarkSet &bookmarks, const QString &jid)
+{
+    auto conferences = bookmarks.conferences();
+    auto itr = std::find_if(conferences.begin(), conferences.end(), [&](const auto &conference) {
+        return conference.jid() == jid;
+    });
+    if (itr == conferences.end()) {
+        return false;
+    }
+    conferences.erase(itr);
+    bookmarks.setConferences(conferences);
+    return true;
+}
+
 class QXmppBookmarkManagerPrivate
 {
 public:
@@ -71,6 +187,7 @@ public:
     QXmppBookmarkSet pendingBookmarks;
     QString pendingId;
     bool bookmarksReceived;
+    bool pepEnabled = false;
 };
 
 ///
@@ -84,6 +201,47 @@ QXmppBookmarkManager::QXmppBookmarkManager()
 
 QXmppBookmarkManager::~QXmppBookmarkManager() = default;
 
+///
+/// Returns whether the bookmarks of conference rooms are stored as PEP items
+/// as defined by \xep{0402, PEP Native Bookmarks}.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppBookmarkManager::isPepEnabled() const
+{
+    return d->pepEnabled;
+}
+
+///
+/// Sets whether the bookmarks of conference rooms are stored as PEP items as
+/// defined by \xep{0402, PEP Native Bookmarks} instead of the private XML
+/// storage.
+///
+/// Each bookmark is a single item, so adding, changing or removing a
+/// bookmark only transfers that bookmark instead of the whole set. Changes,
+/// also those of other clients, are received via PEP notifications. The
+/// bookmarks are kept between sessions and are only requested again if the
+/// stream could not be resumed.
+///
+/// This requires the QXmppPubSubManager and has to be set before connecting,
+/// because it changes the client's service discovery features. URL bookmarks
+/// are not supported by \xep{0402, PEP Native Bookmarks}.
+///
+/// The default is false.
+///
+/// \since QXmpp 1.6
+///
+void QXmppBookmarkManager::setPepEnabled(bool enabled)
+{
+    if (d->pepEnabled != enabled) {
+        d->pepEnabled = enabled;
+        d->bookmarks = QXmppBookmarkSet();
+        d->bookmarksReceived = false;
+        // the notify feature depends on the mode
+        invalidateDiscoveryInfo();
+    }
+}
+
 /// Returns true if the bookmarks have been received from the server,
 /// false otherwise.
 ///
@@ -105,10 +263,36 @@ QXmppBookmarkSet QXmppBookmarkManager::bookmarks() const
 
 /// Stores the bookmarks on the server.
 ///
+/// If PEP native bookmarks are enabled, only the bookmarks that differ from
+/// the current bookmarks() are published or retracted.
+///
 /// \param bookmarks
 
 bool QXmppBookmarkManager::setBookmarks(const QXmppBookmarkSet &bookmarks)
 {
+    if (d->pepEnabled) {
+        if (!client()->isConnected()) {
+            return false;
+        }
+
+        QHash<QString, QXmppBookmarkConference> currentConferences;
+        for (const auto &conference : d->bookmarks.conferences()) {
+            currentConferences.insert(conference.jid(), conference);
+        }
+
+        for (const auto &conference : bookmarks.conferences()) {
+            const auto current = currentConferences.constFind(conference.jid());
+            if (current == currentConferences.constEnd() || !isEqual(*current, conference)) {
+                addBookmark(conference);
+            }
+            currentConferences.remove(conference.jid());
+        }
+        for (const auto &conference : std::as_const(currentConferences)) {
+            removeBookmark(conference.jid());
+        }
+        return true;
+    }
+
     QXmppPrivateStorageIq iq;
     iq.setType(QXmppIq::Set);
     iq.setBookmarks(bookmarks);
@@ -121,7 +305,81 @@ bool QXmppBookmarkManager::setBookmarks(const QXmppBookmarkSet &bookmarks)
     return true;
 }
 
+///
+/// Adds a bookmark for a conference room or replaces the existing one for the
+/// same room.
+///
+/// With PEP native bookmarks, only this bookmark is published. Otherwise, the
+/// whole set is stored again, so the bookmarks need to be received first.
+///
+/// bookmarksReceived() is emitted once the bookmarks have changed.
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QXmppBookmarkManager::Result> QXmppBookmarkManager::addBookmark(const QXmppBookmarkConference &conference)
+{
+    if (!d->pepEnabled) {
+        auto bookmarks = d->bookmarks;
+        insertConference(bookmarks, conference);
+        return storePrivateBookmarks(bookmarks);
+    }
+
+    auto *pubSub = client()->findExtension<QXmppPubSubManager>();
+    if (!pubSub) {
+        return makeReadyTask<Result>(QXmppError { QStringLiteral("PEP native bookmarks require the QXmppPubSubManager."), {} });
+    }
+
+    return chain<Result>(pubSub->publishOwnPepItem(ns_bookmarks_1, QXmppPepBookmarkItem(conference), pepBookmarksPublishOptions()), this, [this, conference](QXmppPubSubManager::PublishItemResult &&result) -> Result {
+        if (auto *error = std::get_if<QXmppError>(&result)) {
+            return std::move(*error);
+        }
+        if (insertConference(d->bookmarks, conference) && d->bookmarksReceived) {
+            Q_EMIT bookmarksReceived(d->bookmarks);
+        }
+        return Success();
+    });
+}
+
+///
+/// Removes the bookmark for a conference room.
+///
+/// With PEP native bookmarks, only this bookmark is retracted. Otherwise, the
+/// whole set is stored again, so the bookmarks need to be received first.
+///
+/// bookmarksReceived() is emitted once the bookmarks have changed.
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QXmppBookmarkManager::Result> QXmppBookmarkManager::removeBookmark(const QString &jid)
+{
+    if (!d->pepEnabled) {
+        auto bookmarks = d->bookmarks;
+        removeConference(bookmarks, jid);
+        return storePrivateBookmarks(bookmarks);
+    }
+
+    auto *pubSub = client()->findExtension<QXmppPubSubManager>();
+    if (!pubSub) {
+        return makeReadyTask<Result>(QXmppError { QStringLiteral("PEP native bookmarks require the QXmppPubSubManager."), {} });
+    }
+
+    return chain<Result>(pubSub->retractOwnPepItem(ns_bookmarks_1, jid), this, [this, jid](QXmppPubSubManager::Result &&result) -> Result {
+        if (std::holds_alternative<Success>(result) && removeConference(d->bookmarks, jid) && d->bookmarksReceived) {
+            Q_EMIT bookmarksReceived(d->bookmarks);
+        }
+        return std::move(result);
+    });
+}
+
 /// \cond
+QStringList QXmppBookmarkManager::discoveryFeatures() const
+{
+    if (d->pepEnabled) {
+        return { ns_bookmarks_1_notify };
+    }
+    return {};
+}
+
 void QXmppBookmarkManager::setClient(QXmppClient *client)
 {
 
@@ -160,10 +418,109 @@ bool QXmppBookmarkManager::handleStanza(const QDomElement &stanza)
     }
     return false;
 }
+
+bool QXmppBookmarkManager::handlePubSubEvent(const QDomElement &element, const QString &pubSubService, const QString &nodeName)
+{
+    if (!d->pepEnabled || nodeName != ns_bookmarks_1 || pubSubService != client()->configuration().jidBare() ||
+        !QXmppPubSubEvent<QXmppPepBookmarkItem>::isPubSubEvent(element)) {
+        return false;
+    }
+
+    QXmppPubSubEvent<QXmppPepBookmarkItem> event;
+    event.parse(element);
+
+    bool changed = false;
+    switch (event.eventType()) {
+    case QXmppPubSubEventBase::Items: {
+        const auto items = event.items();
+        for (const auto &item : items) {
+            changed |= insertConference(d->bookmarks, item.conference());
+        }
+        break;
+    }
+    case QXmppPubSubEventBase::Retract: {
+        const auto retractIds = event.retractIds();
+        for (const auto &jid : retractIds) {
+            changed |= removeConference(d->bookmarks, jid);
+        }
+        break;
+    }
+    case QXmppPubSubEventBase::Delete:
+    case QXmppPubSubEventBase::Purge:
+        changed = !d->bookmarks.conferences().isEmpty();
+        d->bookmarks = QXmppBookmarkSet();
+        break;
+    default:
+        break;
+    }
+
+    if (changed && d->bookmarksReceived) {
+        Q_EMIT bookmarksReceived(d->bookmarks);
+    }
+    return true;
+}
 /// \endcond
 
+void QXmppBookmarkManager::requestPepBookmarks()
+{
+    auto *pubSub = client()->findExtension<QXmppPubSubManager>();
+    if (!pubSub) {
+        warning(QStringLiteral("PEP native bookmarks require the QXmppPubSubManager."));
+        return;
+    }
+
+    using Items = QXmppPubSubManager::Items<QXmppPepBookmarkItem>;
+    pubSub->requestItems<QXmppPepBookmarkItem>(client()->configuration().jidBare(), ns_bookmarks_1).then(this, [this](QXmppPubSubManager::ItemsResult<QXmppPepBookmarkItem> &&result) {
+        QList<QXmppBookmarkConference> conferences;
+        if (const auto *items = std::get_if<Items>(&result)) {
+            conferences.reserve(items->items.size());
+            for (const auto &item : items->items) {
+                conferences.append(item.conference());
+            }
+        } else {
+            // there is no bookmarks node if no bookmarks have been published yet
+            const auto error = std::get<QXmppError>(std::move(result));
+            const auto stanzaError = error.value<QXmppStanza::Error>();
+            if (!stanzaError || stanzaError->condition() != QXmppStanza::Error::ItemNotFound) {
+                warning(QStringLiteral("Could not request PEP native bookmarks: ") + error.description);
+                return;
+            }
+        }
+
+        d->bookmarks.setConferences(conferences);
+        d->bookmarksReceived = true;
+        Q_EMIT bookmarksReceived(d->bookmarks);
+    });
+}
+
+QXmppTask<QXmppBookmarkManager::Result> QXmppBookmarkManager::storePrivateBookmarks(const QXmppBookmarkSet &bookmarks)
+{
+    if (!d->bookmarksReceived) {
+        return makeReadyTask<Result>(QXmppError { QStringLiteral("The bookmarks have not been received yet."), {} });
+    }
+
+    QXmppPrivateStorageIq iq;
+    iq.setType(QXmppIq::Set);
+    iq.setBookmarks(bookmarks);
+    return chain<Result>(client()->sendGenericIq(std::move(iq)), this, [this, bookmarks](QXmppClient::EmptyResult &&result) -> Result {
+        if (std::holds_alternative<Success>(result)) {
+            d->bookmarks = bookmarks;
+            Q_EMIT bookmarksReceived(d->bookmarks);
+        }
+        return std::move(result);
+    });
+}
+
 void QXmppBookmarkManager::slotConnected()
 {
+    if (d->pepEnabled) {
+        // notifications keep the bookmarks up to date while the stream is resumed
+        if (!d->bookmarksReceived || client()->streamManagementState() != QXmppClient::ResumedStream) {
+            requestPepBookmarks();
+        }
+        return;
+    }
+
     QXmppPrivateStorageIq iq;
     iq.setType(QXmppIq::Get);
     client()->sendPacket(iq);
@@ -171,6 +528,11 @@ void QXmppBookmarkManager::slotConnected()
 
 void QXmppBookmarkManager::slotDisconnected()
 {
+    // PEP native bookmarks are kept for the next session
+    if (d->pepEnabled) {
+        return;
+    }
+
     d->bookmarks = QXmppBookmarkSet();
     d->bookmarksReceived = false;
 }
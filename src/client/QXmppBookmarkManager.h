@@ -6,30 +6,50 @@
 #define QXMPPBOOKMARKMANAGER_H
 
 #include "QXmppClientExtension.h"
+#include "QXmppError.h"
+#include "QXmppPubSubEventHandler.h"
+
+#include <variant>
 
 #include <QUrl>
 
+template<typename T>
+class QXmppTask;
+class QXmppBookmarkConference;
 class QXmppBookmarkManagerPrivate;
 class QXmppBookmarkSet;
 
 /// \brief The QXmppBookmarkManager class allows you to store and retrieve
 /// bookmarks as defined by \xep{0048}: Bookmarks.
 ///
+/// Optionally, the bookmarks of conference rooms can be stored as PEP items as
+/// defined by \xep{0402, PEP Native Bookmarks}, see setPepEnabled().
+///
 
-class QXMPP_EXPORT QXmppBookmarkManager : public QXmppClientExtension
+class QXMPP_EXPORT QXmppBookmarkManager : public QXmppClientExtension, public QXmppPubSubEventHandler
 {
     Q_OBJECT
 
 public:
+    using Result = std::variant<QXmpp::Success, QXmppError>;
+
     QXmppBookmarkManager();
     ~QXmppBookmarkManager() override;
 
+    bool isPepEnabled() const;
+    void setPepEnabled(bool enabled);
+
     bool areBookmarksReceived() const;
     QXmppBookmarkSet bookmarks() const;
     bool setBookmarks(const QXmppBookmarkSet &bookmarks);
 
+    QXmppTask<Result> addBookmark(const QXmppBookmarkConference &conference);
+    QXmppTask<Result> removeBookmark(const QString &jid);
+
     /// \cond
+    QStringList discoveryFeatures() const override;
     bool handleStanza(const QDomElement &stanza) override;
+    bool handlePubSubEvent(const QDomElement &element, const QString &pubSubService, const QString &nodeName) override;
     /// \endcond
 
 Q_SIGNALS:
@@ -46,6 +66,9 @@ private Q_SLOTS:
     void slotDisconnected();
 
 private:
+    void requestPepBookmarks();
+    QXmppTask<Result> storePrivateBookmarks(const QXmppBookmarkSet &bookmarks);
+
     const std::unique_ptr<QXmppBookmarkManagerPrivate> d;
 };
 
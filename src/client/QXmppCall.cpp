@@ -15,47 +15,46 @@
 #include "QXmppStun.h"
 #include "QXmppUtils.h"
 
+#include <algorithm>
+
 #include <gst/gst.h>
 
 #include <QDomElement>
 #include <QTimer>
 
+using namespace QXmpp::Private;
+
 /// \cond
-QXmppCallPrivate::QXmppCallPrivate(QXmppCall *qq)
+QXmppCallPrivate::QXmppCallPrivate(QXmppCall *qq, QXmppCallManager *manager_)
     : direction(QXmppCall::IncomingDirection),
-      manager(0),
+      manager(manager_),
       state(QXmppCall::ConnectingState),
+      sharedPipeline(manager->d->sharedPipelineEnabled),
       nextId(0),
       q(qq)
 {
     qRegisterMetaType<QXmppCall::State>();
 
-    filterGStreamerFormats(videoCodecs);
-    filterGStreamerFormats(audioCodecs);
+    filterGStreamerFormats(videoCodecs, manager->d->hardwareCodecsEnabled);
+    filterGStreamerFormats(audioCodecs, manager->d->hardwareCodecsEnabled);
 
-    pipeline = gst_pipeline_new(nullptr);
-    if (!pipeline) {
-        qFatal("Failed to create pipeline");
-        return;
-    }
-    rtpbin = gst_element_factory_make("rtpbin", nullptr);
-    if (!rtpbin) {
-        qFatal("Failed to create rtpbin");
+    if (sharedPipeline) {
+        // the signals of the rtpbin are dispatched by the manager
+        manager->d->createSharedPipeline();
+        pipeline = manager->d->pipeline;
+        rtpbin = manager->d->rtpbin;
         return;
     }
-    // We do not want to build up latency over time
-    g_object_set(rtpbin, "drop-on-latency", true, "async-handling", true, "latency", 25, nullptr);
-    if (!gst_bin_add(GST_BIN(pipeline), rtpbin)) {
-        qFatal("Could not add rtpbin to the pipeline");
-    }
+
+    createPipeline(pipeline, rtpbin);
     g_signal_connect_swapped(rtpbin, "pad-added",
                              G_CALLBACK(+[](QXmppCallPrivate *p, GstPad *pad) {
                                  p->padAdded(pad);
                              }),
                              this);
     g_signal_connect_swapped(rtpbin, "request-pt-map",
-                             G_CALLBACK(+[](QXmppCallPrivate *p, uint sessionId, uint pt) {
-                                 p->ptMap(sessionId, pt);
+                             G_CALLBACK(+[](QXmppCallPrivate *p, uint sessionId, uint pt) -> GstCaps * {
+                                 return p->ptMap(sessionId, pt);
                              }),
                              this);
     g_signal_connect_swapped(rtpbin, "on-ssrc-active",
@@ -63,6 +62,11 @@ QXmppCallPrivate::QXmppCallPrivate(QXmppCall *qq)
                                  p->ssrcActive(sessionId, ssrc);
                              }),
                              this);
+    g_signal_connect_swapped(rtpbin, "new-jitterbuffer",
+                             G_CALLBACK(+[](QXmppCallPrivate *p, GstElement *jitterBuffer, uint sessionId) {
+                                 p->jitterBufferAdded(sessionId, jitterBuffer);
+                             }),
+                             this);
 
     if (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
         qFatal("Unable to set the pipeline to the playing state");
@@ -72,6 +76,15 @@ QXmppCallPrivate::QXmppCallPrivate(QXmppCall *qq)
 
 QXmppCallPrivate::~QXmppCallPrivate()
 {
+    manager->d->removeCall(this);
+
+    if (sharedPipeline) {
+        // the streams remove their elements from the shared pipeline
+        manager->d->removeSessions(this);
+        qDeleteAll(streams);
+        return;
+    }
+
     if (gst_element_set_state(pipeline, GST_STATE_NULL) == GST_STATE_CHANGE_FAILURE) {
         qFatal("Unable to set the pipeline to the null state");
     }
@@ -79,12 +92,40 @@ QXmppCallPrivate::~QXmppCallPrivate()
     gst_object_unref(pipeline);
 }
 
+void QXmppCallPrivate::createPipeline(GstElement *&pipeline, GstElement *&rtpbin)
+{
+    pipeline = gst_pipeline_new(nullptr);
+    if (!pipeline) {
+        qFatal("Failed to create pipeline");
+        return;
+    }
+    rtpbin = gst_element_factory_make("rtpbin", nullptr);
+    if (!rtpbin) {
+        qFatal("Failed to create rtpbin");
+        return;
+    }
+    // We do not want to build up latency over time. The latency of the jitter
+    // buffers starts low and grows with the jitter of the streams, see
+    // QXmppCallStreamPrivate::updateRateControl(). Lost packets are signalled
+    // to the decoders, so they can conceal them.
+    g_object_set(rtpbin, "drop-on-latency", true, "async-handling", true, "latency", JitterBufferSizer::MinimumLatency, "do-lost", true, nullptr);
+    if (!gst_bin_add(GST_BIN(pipeline), rtpbin)) {
+        qFatal("Could not add rtpbin to the pipeline");
+    }
+}
+
 void QXmppCallPrivate::ssrcActive(uint sessionId, uint ssrc)
 {
+    // the bitrate is controlled by the streams from the RTCP statistics
+    Q_UNUSED(sessionId)
     Q_UNUSED(ssrc)
-    GstElement *rtpSession;
-    g_signal_emit_by_name(rtpbin, "get-session", static_cast<uint>(sessionId), &rtpSession);
-    // TODO: implement bitrate controller
+}
+
+void QXmppCallPrivate::jitterBufferAdded(uint sessionId, GstElement *jitterBuffer)
+{
+    if (auto *stream = findStreamById(int(sessionId))) {
+        stream->d->setJitterBuffer(jitterBuffer);
+    }
 }
 
 void QXmppCallPrivate::padAdded(GstPad *pad)
@@ -145,7 +186,7 @@ GstCaps *QXmppCallPrivate::ptMap(uint sessionId, uint pt)
     return nullptr;
 }
 
-bool QXmppCallPrivate::isFormatSupported(const QString &codecName) const
+bool QXmppCallPrivate::isFormatSupported(const QString &codecName)
 {
     GstElementFactory *factory;
     factory = gst_element_factory_find(codecName.toLatin1().data());
@@ -156,10 +197,29 @@ bool QXmppCallPrivate::isFormatSupported(const QString &codecName) const
     return true;
 }
 
-void QXmppCallPrivate::filterGStreamerFormats(QList<GstCodec> &formats)
+void QXmppCallPrivate::filterGStreamerFormats(QList<GstCodec> &formats, bool useHardware)
 {
     auto it = formats.begin();
     while (it != formats.end()) {
+        if (useHardware) {
+            // GStreamer only registers the hardware elements if a device supports them
+            for (const auto &encoder : std::as_const(it->hwEncs)) {
+                if (isFormatSupported(encoder.name)) {
+                    it->gstEnc = encoder.name;
+                    it->encProps = encoder.props;
+                    it->hwEncoding = true;
+                    break;
+                }
+            }
+            for (const auto &decoder : std::as_const(it->hwDecs)) {
+                if (isFormatSupported(decoder)) {
+                    it->gstDec = decoder;
+                    it->hwDecoding = true;
+                    break;
+                }
+            }
+        }
+
         bool supported = isFormatSupported(it->gstPay) &&
             isFormatSupported(it->gstDepay) &&
             isFormatSupported(it->gstEnc) &&
@@ -170,6 +230,12 @@ void QXmppCallPrivate::filterGStreamerFormats(QList<GstCodec> &formats)
             ++it;
         }
     }
+
+    // Offer the codecs with the most hardware support first, the order of the
+    // rest is kept.
+    std::stable_sort(formats.begin(), formats.end(), [](const GstCodec &a, const GstCodec &b) {
+        return int(a.hwEncoding) + int(a.hwDecoding) > int(b.hwEncoding) + int(b.hwDecoding);
+    });
 }
 
 QXmppCallStream *QXmppCallPrivate::findStreamByMedia(const QString &media)
@@ -235,7 +301,7 @@ bool QXmppCallPrivate::handleDescription(QXmppCallStream *stream, const QXmppJin
                     codec.clockrate == it->clockrate() &&
                     codec.channels == it->channels()) {
                     if (!foundCandidate) {
-                        stream->d->addEncoder(codec);
+                        stream->d->addEncoder(codec, *it);
                         foundCandidate = true;
                     }
                     supported = true;
@@ -247,7 +313,7 @@ bool QXmppCallPrivate::handleDescription(QXmppCallStream *stream, const QXmppJin
                     codec.clockrate == it->clockrate() &&
                     codec.channels == it->channels()) {
                     if (!foundCandidate) {
-                        stream->d->addEncoder(codec);
+                        stream->d->addEncoder(codec, *it);
                         foundCandidate = true;
                     }
                     supported = true;
@@ -269,11 +335,27 @@ bool QXmppCallPrivate::handleDescription(QXmppCallStream *stream, const QXmppJin
         return false;
     }
 
+    // RFC 5761: RTCP is multiplexed if both parties support it
+    stream->d->rtcpMuxSupported = content.isRtpMultiplexingSupported();
+    if (stream->d->rtcpMuxSupported && !stream->d->rtcpMux) {
+        stream->d->enableRtcpMux();
+    }
+
     return true;
 }
 
 bool QXmppCallPrivate::handleTransport(QXmppCallStream *stream, const QXmppJingleIq::Content &content)
 {
+    // the transport of a BUNDLE group is negotiated by its first stream
+    if (stream->d->bundled) {
+        const auto first = std::find_if(streams.cbegin(), streams.cend(), [=](auto *other) {
+            return other->d->connection == stream->d->connection;
+        });
+        if (first != streams.cend() && *first != stream) {
+            return true;
+        }
+    }
+
     stream->d->connection->setRemoteUser(content.transportUser());
     stream->d->connection->setRemotePassword(content.transportPassword());
     const auto candidates = content.transportCandidates();
@@ -312,6 +394,7 @@ void QXmppCallPrivate::handleRequest(const QXmppJingleIq &iq)
             terminate(QXmppJingleIq::Reason::FailedApplication);
             return;
         }
+        bundleSupported = !bundleGroup(iq, content.name()).isEmpty();
 
         // check for call establishment
         setState(QXmppCall::ActiveState);
@@ -356,8 +439,19 @@ void QXmppCallPrivate::handleRequest(const QXmppJingleIq &iq)
             return;
         }
 
+        // the stream may share the transport of an existing one
+        QXmppCallStream *bundledStream = nullptr;
+        if (bundleSupported) {
+            const auto names = bundleGroup(iq, content.name());
+            for (const auto &name : names) {
+                if ((bundledStream = findStreamByName(name))) {
+                    break;
+                }
+            }
+        }
+
         // create media stream
-        stream = createStream(content.descriptionMedia(), content.creator(), content.name());
+        stream = createStream(content.descriptionMedia(), content.creator(), content.name(), bundledStream);
         if (!stream) {
             return;
         }
@@ -386,6 +480,9 @@ void QXmppCallPrivate::handleRequest(const QXmppJingleIq &iq)
         iq.setAction(QXmppJingleIq::ContentAccept);
         iq.setSid(q->sid());
         iq.addContent(localContent(stream));
+        if (stream->d->bundled) {
+            addBundleGroup(iq, stream);
+        }
         sendRequest(iq);
 
     } else if (iq.action() == QXmppJingleIq::TransportInfo) {
@@ -403,7 +500,7 @@ void QXmppCallPrivate::handleRequest(const QXmppJingleIq &iq)
     }
 }
 
-QXmppCallStream *QXmppCallPrivate::createStream(const QString &media, const QString &creator, const QString &name)
+QXmppCallStream *QXmppCallPrivate::createStream(const QString &media, const QString &creator, const QString &name, QXmppCallStream *bundleWith)
 {
     Q_ASSERT(manager);
 
@@ -417,7 +514,12 @@ QXmppCallStream *QXmppCallPrivate::createStream(const QString &media, const QStr
         return nullptr;
     }
 
-    auto *stream = new QXmppCallStream(pipeline, rtpbin, media, creator, name, ++nextId);
+    // the IDs of the rtpbin sessions need to be unique in the shared pipeline
+    const int id = sharedPipeline ? ++manager->d->nextStreamId : ++nextId;
+    auto *stream = new QXmppCallStream(pipeline, rtpbin, media, creator, name, id);
+    if (sharedPipeline) {
+        manager->d->addSession(id, this);
+    }
 
     // Fill local payload payload types
     auto &codecs = media == AUDIO_MEDIA ? audioCodecs : videoCodecs;
@@ -427,23 +529,33 @@ QXmppCallStream *QXmppCallPrivate::createStream(const QString &media, const QStr
         payloadType.setName(codec.name);
         payloadType.setChannels(codec.channels);
         payloadType.setClockrate(codec.clockrate);
+        if (codec.gstDec == QLatin1String("opusdec")) {
+            // RFC 7587: ask the peer for in-band FEC and DTX, the decoder uses the FEC data
+            // to restore lost packets
+            payloadType.setParameters({ { QStringLiteral("useinbandfec"), QStringLiteral("1") },
+                                        { QStringLiteral("usedtx"), QStringLiteral("1") } });
+        }
         stream->d->payloadTypes.append(payloadType);
     }
 
-    // ICE connection
-    stream->d->connection->setIceControlling(direction == QXmppCall::OutgoingDirection);
-    stream->d->connection->setStunServers(manager->d->stunServers);
-    stream->d->connection->setTurnServer(manager->d->turnHost, manager->d->turnPort);
-    stream->d->connection->setTurnUser(manager->d->turnUser);
-    stream->d->connection->setTurnPassword(manager->d->turnPassword);
-    stream->d->connection->bind(QXmppIceComponent::discoverAddresses());
-
-    // connect signals
-    QObject::connect(stream->d->connection, &QXmppIceConnection::localCandidatesChanged,
-                     q, &QXmppCall::localCandidatesChanged);
-
-    QObject::connect(stream->d->connection, &QXmppIceConnection::disconnected,
-                     q, &QXmppCall::hangup);
+    if (bundleWith) {
+        // XEP-0338: share the ICE connection, which is kept by the call for
+        // all streams of the BUNDLE group
+        bundleWith->d->connection->setParent(q);
+        stream->d->bundleWith(bundleWith->d);
+    } else {
+        // ICE connection
+        stream->d->connection->setIceControlling(direction == QXmppCall::OutgoingDirection);
+        manager->d->configureConnection(stream->d->connection);
+        stream->d->connection->bind(QXmppIceComponent::discoverAddresses());
+
+        // connect signals
+        QObject::connect(stream->d->connection, &QXmppIceConnection::localCandidatesChanged,
+                         q, &QXmppCall::localCandidatesChanged);
+
+        QObject::connect(stream->d->connection, &QXmppIceConnection::disconnected,
+                         q, &QXmppCall::hangup);
+    }
 
     Q_EMIT q->streamCreated(stream);
 
@@ -461,6 +573,7 @@ QXmppJingleIq::Content QXmppCallPrivate::localContent(QXmppCallStream *stream) c
     content.setDescriptionMedia(stream->media());
     content.setDescriptionSsrc(stream->d->localSsrc);
     content.setPayloadTypes(stream->d->payloadTypes);
+    content.setRtpMultiplexingSupported(stream->d->rtcpMuxSupported);
 
     // transport
     content.setTransportUser(stream->d->connection->localUser());
@@ -470,6 +583,37 @@ QXmppJingleIq::Content QXmppCallPrivate::localContent(QXmppCallStream *stream) c
     return content;
 }
 
+///
+/// Adds the BUNDLE group of the stream, which lists the streams sharing its
+/// ICE connection.
+///
+void QXmppCallPrivate::addBundleGroup(QXmppJingleIq &iq, QXmppCallStream *stream) const
+{
+    QXmppJingleIq::ContentGroup group;
+    group.semantics = QStringLiteral("BUNDLE");
+    for (auto *other : streams) {
+        if (other->d->connection == stream->d->connection) {
+            group.contentNames << other->name();
+        }
+    }
+    iq.setContentGroups({ group });
+}
+
+///
+/// Returns the names of the contents in the BUNDLE group of the content, or an
+/// empty list if the content isn't bundled.
+///
+QStringList QXmppCallPrivate::bundleGroup(const QXmppJingleIq &iq, const QString &contentName)
+{
+    const auto groups = iq.contentGroups();
+    for (const auto &group : groups) {
+        if (group.semantics == QLatin1String("BUNDLE") && group.contentNames.contains(contentName)) {
+            return group.contentNames;
+        }
+    }
+    return {};
+}
+
 ///
 /// Sends an acknowledgement for a Jingle IQ.
 ///
@@ -495,6 +639,8 @@ bool QXmppCallPrivate::sendInvite()
     iq.setInitiator(ownJid);
     iq.setSid(sid);
     iq.addContent(localContent(stream));
+    // offer to bundle the streams which are added later
+    addBundleGroup(iq, stream);
     return sendRequest(iq);
 }
 
@@ -504,6 +650,7 @@ bool QXmppCallPrivate::sendInvite()
 bool QXmppCallPrivate::sendRequest(const QXmppJingleIq &iq)
 {
     requests << iq;
+    manager->d->callsByRequestId.insert(iq.id(), q);
     return manager->client()->sendPacket(iq);
 }
 
@@ -557,11 +704,10 @@ void QXmppCallPrivate::terminate(QXmppJingleIq::Reason::Type reasonType)
 QXmppCall::QXmppCall(const QString &jid, QXmppCall::Direction direction, QXmppCallManager *parent)
     : QXmppLoggable(parent)
 {
-    d = new QXmppCallPrivate(this);
+    d = new QXmppCallPrivate(this, parent);
     d->direction = direction;
     d->jid = jid;
     d->ownJid = parent->client()->configuration().jid();
-    d->manager = parent;
 }
 
 QXmppCall::~QXmppCall()
@@ -586,6 +732,9 @@ void QXmppCall::accept()
         iq.setResponder(d->ownJid);
         iq.setSid(d->sid);
         iq.addContent(d->localContent(stream));
+        if (d->bundleSupported) {
+            d->addBundleGroup(iq, stream);
+        }
         d->sendRequest(iq);
 
         // notify user
@@ -599,6 +748,9 @@ void QXmppCall::accept()
 ///
 /// Returns the GStreamer pipeline.
 ///
+/// If QXmppCallManager::sharedPipelineEnabled() was set when the call was
+/// created, this is the pipeline shared by all calls of the manager.
+///
 /// \since QXmpp 1.3
 ///
 GstElement *QXmppCall::pipeline() const
@@ -723,7 +875,8 @@ void QXmppCall::addVideo()
 
     // create video stream
     QLatin1String creator = (d->direction == QXmppCall::OutgoingDirection) ? QLatin1String("initiator") : QLatin1String("responder");
-    stream = d->createStream(VIDEO_MEDIA, creator, QLatin1String("webcam"));
+    stream = d->createStream(VIDEO_MEDIA, creator, QLatin1String("webcam"),
+                             d->bundleSupported ? d->findStreamByMedia(AUDIO_MEDIA) : nullptr);
     d->streams << stream;
 
     // build request
@@ -733,5 +886,8 @@ void QXmppCall::addVideo()
     iq.setAction(QXmppJingleIq::ContentAdd);
     iq.setSid(d->sid);
     iq.addContent(d->localContent(stream));
+    if (stream->d->bundled) {
+        d->addBundleGroup(iq, stream);
+    }
     d->sendRequest(iq);
 }
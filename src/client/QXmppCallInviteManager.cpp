@@ -4,29 +4,46 @@
 
 #include "QXmppCallInviteManager.h"
 
+#include "QXmppCallSessionRegistry_p.h"
 #include "QXmppClient.h"
 #include "QXmppConstants_p.h"
 #include "QXmppMessage.h"
 #include "QXmppPromise.h"
 #include "QXmppUtils.h"
 
+#include <QPointer>
 #include <QStringBuilder>
+#include <QTimer>
 #include <QUuid>
 
 using namespace QXmpp;
+using namespace QXmpp::Private;
 using CallInviteType = QXmppCallInviteElement::Type;
 
+class QXmppCallInviteManagerPrivate
+{
+public:
+    CallSessionRegistry<QXmppCallInvite> callInvites;
+    // 0 if the Call Invites don't expire
+    int expiryTimeout = 0;
+    QTimer expiryTimer;
+};
+
 class QXmppCallInvitePrivate
 {
 public:
-    QXmppCallInvitePrivate(QXmppCallInviteManager *manager)
-        : manager(manager)
+    QXmppCallInvitePrivate(QXmppCallInvite *q, QXmppCallInviteManager *manager)
+        : q(q),
+          manager(manager)
     {
     }
 
     QXmppTask<SendResult> request(QXmppCallInviteElement &&callInviteElement);
+    void setKey(const QString &newCallPartnerJid, const QString &newId);
 
-    QXmppCallInviteManager *manager;
+    QXmppCallInvite *q;
+    // null if the manager has been destroyed before the Call Invite
+    QPointer<QXmppCallInviteManager> manager;
     QString id;
     QString callPartnerJid;
     bool isAccepted { false };
@@ -39,9 +56,22 @@ public:
 QXmppTask<SendResult> QXmppCallInvitePrivate::request(QXmppCallInviteElement &&callInviteElement)
 {
     callInviteElement.setId(id);
+    manager->d->callInvites.touch(callPartnerJid, id);
     return manager->sendMessage(callInviteElement, callPartnerJid);
 }
 
+///
+/// Changes the ID or the call partner and updates the index of the manager.
+///
+void QXmppCallInvitePrivate::setKey(const QString &newCallPartnerJid, const QString &newId)
+{
+    const auto previousCallPartnerJid = std::exchange(callPartnerJid, newCallPartnerJid);
+    const auto previousId = std::exchange(id, newId);
+    if (manager) {
+        manager->d->callInvites.rekey(q, previousCallPartnerJid, previousId, callPartnerJid, id);
+    }
+}
+
 ///
 /// \class QXmppCallInvite
 ///
@@ -55,7 +85,7 @@ QXmppTask<SendResult> QXmppCallInvitePrivate::request(QXmppCallInviteElement &&c
 /// \brief Constructs a Call Invite object.
 ///
 QXmppCallInvite::QXmppCallInvite(QXmppCallInviteManager *manager)
-    : d(new QXmppCallInvitePrivate(manager))
+    : d(new QXmppCallInvitePrivate(this, manager))
 {
 }
 
@@ -141,7 +171,7 @@ QString QXmppCallInvite::id() const
 ///
 void QXmppCallInvite::setId(const QString &id)
 {
-    d->id = id;
+    d->setKey(d->callPartnerJid, id);
 }
 
 ///
@@ -155,7 +185,7 @@ void QXmppCallInvite::setId(const QString &id)
 ///
 void QXmppCallInvite::setCallPartnerJid(const QString &callPartnerJid)
 {
-    d->callPartnerJid = callPartnerJid;
+    d->setKey(callPartnerJid, d->id);
 }
 
 ///
@@ -198,12 +228,6 @@ void QXmppCallInvite::setIsAccepted(bool isAccepted)
 /// \param result close reason
 ///
 
-class QXmppCallInviteManagerPrivate
-{
-public:
-    QVector<std::shared_ptr<QXmppCallInvite>> callInvites;
-};
-
 ///
 /// \typedef QXmppCallInviteManager::ProposeResult
 ///
@@ -223,10 +247,43 @@ public:
 QXmppCallInviteManager::QXmppCallInviteManager()
     : d(std::make_unique<QXmppCallInviteManagerPrivate>())
 {
+    connect(&d->expiryTimer, &QTimer::timeout, this, &QXmppCallInviteManager::removeExpiredCallInvites);
 }
 
 QXmppCallInviteManager::~QXmppCallInviteManager() = default;
 
+///
+/// Returns the time in seconds after which Call Invites without activity are closed.
+///
+/// \since QXmpp 1.6
+///
+int QXmppCallInviteManager::expiryTimeout() const
+{
+    return d->expiryTimeout;
+}
+
+///
+/// Sets the time in seconds after which Call Invites without activity are closed.
+///
+/// Call Invites that haven't been accepted and haven't sent or received an
+/// element within the timeout are removed and closed with an error, so
+/// unanswered invitations don't accumulate. Accepted Call Invites never expire.
+///
+/// The default is 0, which disables the expiry.
+///
+/// \since QXmpp 1.6
+///
+void QXmppCallInviteManager::setExpiryTimeout(int secs)
+{
+    d->expiryTimeout = std::max(0, secs);
+    if (d->expiryTimeout > 0) {
+        // checking twice per timeout expires the Call Invites at most half a timeout late
+        d->expiryTimer.start(d->expiryTimeout * 500);
+    } else {
+        d->expiryTimer.stop();
+    }
+}
+
 /// \cond
 QStringList QXmppCallInviteManager::discoveryFeatures() const
 {
@@ -318,25 +375,17 @@ QXmppTask<SendResult> QXmppCallInviteManager::sendMessage(const QXmppCallInviteE
 }
 
 ///
-/// Removes a Call Invite object from the Call Invites vector.
+/// Removes a Call Invite object.
 ///
 /// \param callInvite Call Invite object to be removed
 ///
 void QXmppCallInviteManager::clear(const std::shared_ptr<QXmppCallInvite> &callInvite)
 {
-    d->callInvites.erase(
-        std::remove_if(
-            d->callInvites.begin(),
-            d->callInvites.end(),
-            [&callInvite](const auto &storedCallInvite) {
-                return callInvite->id() == storedCallInvite->id() &&
-                    callInvite->callPartnerJid() == storedCallInvite->callPartnerJid();
-            }),
-        d->callInvites.end());
+    d->callInvites.remove(callInvite->callPartnerJid(), callInvite->id());
 }
 
 ///
-/// Removes all Call Invite objects from the Call Invites vector.
+/// Removes all Call Invite objects.
 ///
 void QXmppCallInviteManager::clearAll()
 {
@@ -348,17 +397,11 @@ bool QXmppCallInviteManager::handleCallInviteElement(QXmppCallInviteElement &&ca
     auto callInviteElementId = callInviteElement.id();
     auto callPartnerJid = QXmppUtils::jidToBareJid(senderJid);
 
-    // Check if there's already a Call Invite object with callInviteElementId and callPartnerJid in Call Invites vector.
+    // Check if there's already a Call Invite object with callInviteElementId and callPartnerJid.
     // That means that a Call Invite has already been created with given (J)IDs.
-    auto itr = std::find_if(
-        d->callInvites.begin(),
-        d->callInvites.end(),
-        [&callInviteElementId, &callPartnerJid](const auto &callInvite) {
-            return callInvite->id() == callInviteElementId && callInvite->callPartnerJid() == callPartnerJid;
-        });
-
-    if (itr != d->callInvites.end()) {
-        return handleExistingCallInvite(*itr, callInviteElement, QXmppUtils::jidToResource(senderJid));
+    if (auto callInvite = d->callInvites.find(callPartnerJid, callInviteElementId)) {
+        d->callInvites.touch(callPartnerJid, callInviteElementId);
+        return handleExistingCallInvite(callInvite, callInviteElement, QXmppUtils::jidToResource(senderJid));
     }
 
     if (callInviteElement.type() == CallInviteType::Invite) {
@@ -409,7 +452,7 @@ bool QXmppCallInviteManager::handleInviteCallInviteElement(
 }
 
 ///
-/// Adds a Call Invite object to the Call Invites vector and sets the bare JID of the call partner in the Call Invite object.
+/// Adds a Call Invite object and sets the bare JID of the call partner in the Call Invite object.
 /// \param callPartnerJid bare JID of the call partner
 /// \return The newly created Call Invite
 ///
@@ -417,16 +460,30 @@ std::shared_ptr<QXmppCallInvite> QXmppCallInviteManager::addCallInvite(const QSt
 {
     auto callInvite { std::make_shared<QXmppCallInvite>(this) };
     callInvite->setCallPartnerJid(callPartnerJid);
-    d->callInvites.append(callInvite);
+    d->callInvites.insert(callPartnerJid, {}, callInvite);
     return callInvite;
 }
 
 ///
-/// Returns the Call Invites vector.
+/// Returns the Call Invites.
+///
+QVector<std::shared_ptr<QXmppCallInvite>> QXmppCallInviteManager::callInvites() const
+{
+    return d->callInvites.sessions();
+}
+
+///
+/// Removes and closes the Call Invites that have expired.
 ///
-const QVector<std::shared_ptr<QXmppCallInvite>> &QXmppCallInviteManager::callInvites() const
+void QXmppCallInviteManager::removeExpiredCallInvites()
 {
-    return d->callInvites;
+    const auto expiredCallInvites = d->callInvites.removeExpired(qint64(d->expiryTimeout) * 1000, [](const QXmppCallInvite &callInvite) {
+        return !callInvite.isAccepted();
+    });
+
+    for (const auto &callInvite : expiredCallInvites) {
+        Q_EMIT callInvite->closed(QXmppError { QStringLiteral("Call Invite expired"), {} });
+    }
 }
 
 ///
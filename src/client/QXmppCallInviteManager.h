@@ -73,6 +73,9 @@ public:
     QXmppCallInviteManager();
     ~QXmppCallInviteManager();
 
+    int expiryTimeout() const;
+    void setExpiryTimeout(int secs);
+
     /// \cond
     QStringList discoveryFeatures() const override;
     /// \endcond
@@ -110,7 +113,8 @@ private:
     bool handleInviteCallInviteElement(const QXmppCallInviteElement &callInviteElement, const QString &callPartnerJid);
 
     std::shared_ptr<QXmppCallInvite> addCallInvite(const QString &callPartnerJid);
-    const QVector<std::shared_ptr<QXmppCallInvite>> &callInvites() const;
+    QVector<std::shared_ptr<QXmppCallInvite>> callInvites() const;
+    void removeExpiredCallInvites();
 
 private:
     std::unique_ptr<QXmppCallInviteManagerPrivate> d;
@@ -9,42 +9,257 @@
 #include "QXmppCall_p.h"
 #include "QXmppClient.h"
 #include "QXmppConstants_p.h"
+#include "QXmppExternalServiceDiscoveryManager.h"
 #include "QXmppJingleIq.h"
-#include "QXmppStun.h"
+#include "QXmppStun_p.h"
 #include "QXmppUtils.h"
 
+#include <algorithm>
+#include <functional>
+
 #include <gst/gst.h>
 
 #include <QDomElement>
+#include <QHostInfo>
 #include <QTimer>
 
+// default port of STUN and TURN servers
+constexpr quint16 STUN_DEFAULT_PORT = 3478;
+
+// Calls the handler with the address of the host, an IP address is used as
+// it is.
+static void lookupHost(const QString &host, QObject *context, std::function<void(const QHostAddress &)> handler)
+{
+    if (QHostAddress address; address.setAddress(host)) {
+        handler(address);
+        return;
+    }
+    QHostInfo::lookupHost(host, context, [handler = std::move(handler)](const QHostInfo &info) {
+        if (const auto addresses = info.addresses(); !addresses.isEmpty()) {
+            handler(addresses.first());
+        }
+    });
+}
+
 /// \cond
 QXmppCallManagerPrivate::QXmppCallManagerPrivate(QXmppCallManager *qq)
     : turnPort(0),
+      turnAllocationCache(nullptr),
+      portPool(nullptr),
+      hardwareCodecsEnabled(true),
+      sharedPipelineEnabled(false),
+      pipeline(nullptr),
+      rtpbin(nullptr),
+      nextStreamId(0),
       q(qq)
 {
     // Initialize GStreamer
     gst_init(nullptr, nullptr);
 }
 
-QXmppCall *QXmppCallManagerPrivate::findCall(const QString &sid) const
+QXmppCallManagerPrivate::~QXmppCallManagerPrivate()
 {
-    for (auto *call : calls) {
-        if (call->sid() == sid) {
-            return call;
+    if (pipeline) {
+        g_signal_handlers_disconnect_by_data(rtpbin, this);
+        if (gst_element_set_state(pipeline, GST_STATE_NULL) == GST_STATE_CHANGE_FAILURE) {
+            qFatal("Unable to set the pipeline to the null state");
         }
+        gst_object_unref(pipeline);
     }
-    return nullptr;
+}
+
+QXmppCall *QXmppCallManagerPrivate::findCall(const QString &sid) const
+{
+    return callsBySid.value(sid);
 }
 
 QXmppCall *QXmppCallManagerPrivate::findCall(const QString &sid, QXmppCall::Direction direction) const
 {
-    for (auto *call : calls) {
-        if (call->sid() == sid && call->direction() == direction) {
-            return call;
+    auto *call = callsBySid.value(sid);
+    return call && call->direction() == direction ? call : nullptr;
+}
+
+void QXmppCallManagerPrivate::addCall(QXmppCall *call)
+{
+    calls << call;
+    callsBySid.insert(call->sid(), call);
+    QObject::connect(call, &QObject::destroyed,
+                     q, &QXmppCallManager::_q_callDestroyed);
+}
+
+// Called by the call when it is destroyed, while its ID is still available.
+void QXmppCallManagerPrivate::removeCall(QXmppCallPrivate *call)
+{
+    const auto itr = callsBySid.constFind(call->sid);
+    if (itr != callsBySid.cend() && itr.value() == call->q) {
+        callsBySid.erase(itr);
+    }
+    for (const auto &request : std::as_const(call->requests)) {
+        callsByRequestId.remove(request.id());
+    }
+}
+
+void QXmppCallManagerPrivate::createSharedPipeline()
+{
+    if (pipeline) {
+        return;
+    }
+
+    QXmppCallPrivate::createPipeline(pipeline, rtpbin);
+
+    // The names of the pads end with the session ID:
+    // send_rtp_src_<id> and recv_rtp_src_<id>_<ssrc>_<pt>
+    g_signal_connect_swapped(rtpbin, "pad-added",
+                             G_CALLBACK(+[](QXmppCallManagerPrivate *p, GstPad *pad) {
+                                 const auto nameParts = QString::fromUtf8(GST_PAD_NAME(pad)).split(u'_');
+                                 if (nameParts.size() < 4) {
+                                     return;
+                                 }
+                                 QMutexLocker locker(&p->sessionsMutex);
+                                 if (auto *call = p->sessions.value(nameParts[3].toInt())) {
+                                     call->padAdded(pad);
+                                 }
+                             }),
+                             this);
+    g_signal_connect_swapped(rtpbin, "request-pt-map",
+                             G_CALLBACK(+[](QXmppCallManagerPrivate *p, uint sessionId, uint pt) -> GstCaps * {
+                                 QMutexLocker locker(&p->sessionsMutex);
+                                 if (auto *call = p->sessions.value(int(sessionId))) {
+                                     return call->ptMap(sessionId, pt);
+                                 }
+                                 return nullptr;
+                             }),
+                             this);
+    g_signal_connect_swapped(rtpbin, "on-ssrc-active",
+                             G_CALLBACK(+[](QXmppCallManagerPrivate *p, uint sessionId, uint ssrc) {
+                                 QMutexLocker locker(&p->sessionsMutex);
+                                 if (auto *call = p->sessions.value(int(sessionId))) {
+                                     call->ssrcActive(sessionId, ssrc);
+                                 }
+                             }),
+                             this);
+    g_signal_connect_swapped(rtpbin, "new-jitterbuffer",
+                             G_CALLBACK(+[](QXmppCallManagerPrivate *p, GstElement *jitterBuffer, uint sessionId) {
+                                 QMutexLocker locker(&p->sessionsMutex);
+                                 if (auto *call = p->sessions.value(int(sessionId))) {
+                                     call->jitterBufferAdded(sessionId, jitterBuffer);
+                                 }
+                             }),
+                             this);
+
+    if (gst_element_set_state(pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+        qFatal("Unable to set the pipeline to the playing state");
+    }
+}
+
+// Fetches the services of the own server, the cached ones are used right
+// away.
+void QXmppCallManagerPrivate::requestExternalServices()
+{
+    if (!externalServiceDiscoveryEnabled || !q->client()) {
+        return;
+    }
+
+    auto *manager = q->client()->findExtension<QXmppExternalServiceDiscoveryManager>();
+    if (!manager) {
+        q->warning(QStringLiteral("External service discovery needs a QXmppExternalServiceDiscoveryManager"));
+        return;
+    }
+    if (externalServiceDiscovery != manager) {
+        externalServiceDiscovery = manager;
+        // also receives the refreshes of the cache
+        QObject::connect(manager, &QXmppExternalServiceDiscoveryManager::servicesReceived, q,
+                         [this](const QString &jid, const QString &node, const QVector<QXmppExternalService> &services) {
+                             if (externalServiceDiscoveryEnabled && node.isEmpty() && jid == q->client()->configuration().domain()) {
+                                 setExternalServices(services);
+                             }
+                         });
+    }
+
+    const auto domain = q->client()->configuration().domain();
+    if (const auto services = manager->cachedServices(domain)) {
+        setExternalServices(*services);
+    }
+    // marks cached services as used, so they are refreshed before they expire
+    manager->requestServices(domain);
+}
+
+// Uses the first TURN server and all STUN servers reachable via UDP.
+void QXmppCallManagerPrivate::setExternalServices(const QVector<QXmppExternalService> &services)
+{
+    const auto generation = ++externalServicesGeneration;
+    externalStunServers.clear();
+    externalTurnHost.clear();
+    externalTurnPort = 0;
+    externalTurnUser.clear();
+    externalTurnPassword.clear();
+    externalServicesExpire = {};
+
+    bool hasTurnServer = false;
+    for (const auto &service : services) {
+        if (const auto transport = service.transport(); transport && *transport != QXmppExternalService::Transport::Udp) {
+            continue;
+        }
+
+        const auto port = quint16(service.port().value_or(STUN_DEFAULT_PORT));
+        if (service.type() == u"stun") {
+            lookupHost(service.host(), q, [this, generation, port](const QHostAddress &address) {
+                if (generation == externalServicesGeneration) {
+                    externalStunServers.push_back(qMakePair(address, port));
+                }
+            });
+        } else if (service.type() == u"turn" && !hasTurnServer) {
+            hasTurnServer = true;
+            externalTurnUser = service.username().value_or(QString());
+            externalTurnPassword = service.password().value_or(QString());
+            if (const auto expires = service.expires(); expires && expires->isValid()) {
+                externalServicesExpire = expires->toUTC();
+            }
+            lookupHost(service.host(), q, [this, generation, port](const QHostAddress &address) {
+                if (generation == externalServicesGeneration) {
+                    externalTurnHost = address;
+                    externalTurnPort = port;
+                }
+            });
+        }
+    }
+}
+
+void QXmppCallManagerPrivate::configureConnection(QXmppIceConnection *connection) const
+{
+    connection->setStunServers(stunServers.isEmpty() ? externalStunServers : stunServers);
+
+    const bool useExternalTurnServer = turnHost.isNull() && !externalTurnHost.isNull() &&
+        (!externalServicesExpire.isValid() || externalServicesExpire > QDateTime::currentDateTimeUtc());
+    if (useExternalTurnServer) {
+        connection->setTurnServer(externalTurnHost, externalTurnPort);
+        connection->setTurnUser(externalTurnUser);
+        connection->setTurnPassword(externalTurnPassword);
+    } else {
+        connection->setTurnServer(turnHost, turnPort);
+        connection->setTurnUser(turnUser);
+        connection->setTurnPassword(turnPassword);
+    }
+    connection->setTurnAllocationCache(turnAllocationCache);
+    connection->setPortPool(portPool);
+}
+
+void QXmppCallManagerPrivate::addSession(int id, QXmppCallPrivate *call)
+{
+    QMutexLocker locker(&sessionsMutex);
+    sessions.insert(id, call);
+}
+
+void QXmppCallManagerPrivate::removeSessions(QXmppCallPrivate *call)
+{
+    QMutexLocker locker(&sessionsMutex);
+    for (auto it = sessions.begin(); it != sessions.end();) {
+        if (it.value() == call) {
+            it = sessions.erase(it);
+        } else {
+            ++it;
         }
     }
-    return nullptr;
 }
 /// \endcond
 
@@ -55,6 +270,9 @@ QXmppCall *QXmppCallManagerPrivate::findCall(const QString &sid, QXmppCall::Dire
 QXmppCallManager::QXmppCallManager()
 {
     d = new QXmppCallManagerPrivate(this);
+    d->turnAllocationCache = new QXmppTurnAllocationCache(this);
+    // each call stream has an RTP and an RTCP component
+    d->portPool = new QXmppIcePortPool(2, this);
 }
 
 ///
@@ -62,6 +280,11 @@ QXmppCallManager::QXmppCallManager()
 ///
 QXmppCallManager::~QXmppCallManager()
 {
+    // the calls need to leave the shared pipeline before it is destroyed
+    if (d->pipeline) {
+        const auto calls = d->calls;
+        qDeleteAll(calls);
+    }
     delete d;
 }
 
@@ -84,6 +307,18 @@ bool QXmppCallManager::handleStanza(const QDomElement &element)
         if (QXmppJingleIq::isJingleIq(element)) {
             QXmppJingleIq jingleIq;
             jingleIq.parse(element);
+
+            // sessions of other applications, e.g. file transfers, are left
+            // to other extensions
+            const bool isCall = jingleIq.action() == QXmppJingleIq::SessionInitiate
+                ? std::none_of(jingleIq.contents().cbegin(), jingleIq.contents().cend(), [](const auto &content) {
+                      return content.description().type() == ns_jingle_file_transfer;
+                  })
+                : d->findCall(jingleIq.sid()) != nullptr;
+            if (!isCall) {
+                return false;
+            }
+
             _q_jingleIqReceived(jingleIq);
             return true;
         }
@@ -99,6 +334,10 @@ void QXmppCallManager::setClient(QXmppClient *client)
     connect(client, &QXmppClient::disconnected,
             this, &QXmppCallManager::_q_disconnected);
 
+    connect(client, &QXmppClient::connected, this, [this] {
+        d->requestExternalServices();
+    });
+
     connect(client, &QXmppClient::iqReceived,
             this, &QXmppCallManager::_q_iqReceived);
 
@@ -130,9 +369,7 @@ QXmppCall *QXmppCallManager::call(const QString &jid)
     call->d->sid = QXmppUtils::generateStanzaHash();
 
     // register call
-    d->calls << call;
-    connect(call, &QObject::destroyed,
-            this, &QXmppCallManager::_q_callDestroyed);
+    d->addCall(call);
     Q_EMIT callStarted(call);
 
     call->d->sendInvite();
@@ -202,6 +439,150 @@ void QXmppCallManager::setTurnPassword(const QString &password)
     d->turnPassword = password;
 }
 
+///
+/// Returns the time in seconds for which the TURN allocation of a finished
+/// call is kept.
+///
+/// \since QXmpp 1.6
+///
+int QXmppCallManager::turnAllocationTimeout() const
+{
+    return d->turnAllocationCache->timeout();
+}
+
+///
+/// Sets the time in seconds for which the TURN allocation of a finished call
+/// is kept.
+///
+/// Until the timeout expires, the allocation is refreshed including its
+/// permissions and channel bindings. The next call using the same TURN server
+/// takes over the allocation and can offer its relayed candidate without
+/// allocating again. The default is 60 seconds, 0 disables reusing
+/// allocations.
+///
+/// \since QXmpp 1.6
+///
+void QXmppCallManager::setTurnAllocationTimeout(int timeout)
+{
+    d->turnAllocationCache->setTimeout(timeout);
+}
+
+///
+/// Returns the number of call streams for which UDP ports are kept bound in
+/// advance.
+///
+/// \since QXmpp 1.6
+///
+int QXmppCallManager::portPoolSize() const
+{
+    return d->portPool->size();
+}
+
+///
+/// Sets the number of call streams for which UDP ports are kept bound in
+/// advance.
+///
+/// Binding the ports for a new call stream needs to probe for free ports,
+/// which can be slow. With a pool, the sockets of a new stream are taken from
+/// the pool and the pool is refilled from the event loop. The default is 0,
+/// which disables the pool.
+///
+/// \since QXmpp 1.6
+///
+void QXmppCallManager::setPortPoolSize(int size)
+{
+    d->portPool->setSize(size);
+}
+
+///
+/// Returns whether hardware-accelerated encoders and decoders are preferred.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppCallManager::hardwareCodecsEnabled() const
+{
+    return d->hardwareCodecsEnabled;
+}
+
+///
+/// Sets whether hardware-accelerated encoders and decoders are preferred.
+///
+/// If enabled, the VA-API, NVENC/NVDEC and V4L2 elements of GStreamer are used
+/// instead of the software encoders and decoders where they are available.
+/// Codecs that can be encoded or decoded in hardware are also offered first.
+/// This is enabled by default.
+///
+/// \note This only affects calls created afterwards.
+///
+/// \since QXmpp 1.6
+///
+void QXmppCallManager::setHardwareCodecsEnabled(bool enabled)
+{
+    d->hardwareCodecsEnabled = enabled;
+}
+
+///
+/// Returns whether the calls share one GStreamer pipeline.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppCallManager::sharedPipelineEnabled() const
+{
+    return d->sharedPipelineEnabled;
+}
+
+///
+/// Sets whether the calls share one GStreamer pipeline.
+///
+/// By default, every call has its own pipeline with an rtpbin. With a shared
+/// pipeline, the streams of all calls are sessions of one rtpbin, which saves
+/// creating and starting a pipeline per call when handling many calls at
+/// once. QXmppCall::pipeline() returns the shared pipeline then, elements
+/// added to it by the application need to be removed again by the
+/// application when the call has finished.
+///
+/// \note This only affects calls created afterwards.
+///
+/// \since QXmpp 1.6
+///
+void QXmppCallManager::setSharedPipelineEnabled(bool enabled)
+{
+    d->sharedPipelineEnabled = enabled;
+}
+
+///
+/// Returns whether the STUN and TURN servers of the own server are discovered
+/// using \xep{0215, External Service Discovery}.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppCallManager::isExternalServiceDiscoveryEnabled() const
+{
+    return d->externalServiceDiscoveryEnabled;
+}
+
+///
+/// Sets whether the STUN and TURN servers of the own server are discovered
+/// using \xep{0215, External Service Discovery}.
+///
+/// The services are requested after connecting, using the
+/// QXmppExternalServiceDiscoveryManager of the client, which needs to be
+/// added. They are cached and refreshed before the TURN credentials expire,
+/// so the calls can start ICE right away. The discovered servers are only
+/// used if no STUN or TURN server has been set, respectively.
+///
+/// This is disabled by default.
+///
+/// \since QXmpp 1.6
+///
+void QXmppCallManager::setExternalServiceDiscoveryEnabled(bool enabled)
+{
+    d->externalServiceDiscoveryEnabled = enabled;
+    if (enabled && client() && client()->isConnected()) {
+        d->requestExternalServices();
+    }
+}
+
 ///
 /// Handles call destruction.
 ///
@@ -230,7 +611,7 @@ void QXmppCallManager::_q_iqReceived(const QXmppIq &ack)
     }
 
     // find request
-    for (auto *call : std::as_const(d->calls)) {
+    if (auto *call = d->callsByRequestId.take(ack.id())) {
         call->d->handleAck(ack);
     }
 }
@@ -258,6 +639,7 @@ void QXmppCallManager::_q_jingleIqReceived(const QXmppJingleIq &iq)
             return;
         }
         call->d->streams << stream;
+        call->d->bundleSupported = !QXmppCallPrivate::bundleGroup(iq, content.name()).isEmpty();
 
         // send ack
         call->d->sendAck(iq);
@@ -274,9 +656,7 @@ void QXmppCallManager::_q_jingleIqReceived(const QXmppJingleIq &iq)
         }
 
         // register call
-        d->calls << call;
-        connect(call, &QObject::destroyed,
-                this, &QXmppCallManager::_q_callDestroyed);
+        d->addCall(call);
 
         // send ringing indication
         QXmppJingleIq ringing;
@@ -55,6 +55,21 @@ public:
     void setTurnUser(const QString &user);
     void setTurnPassword(const QString &password);
 
+    int turnAllocationTimeout() const;
+    void setTurnAllocationTimeout(int timeout);
+
+    int portPoolSize() const;
+    void setPortPoolSize(int size);
+
+    bool hardwareCodecsEnabled() const;
+    void setHardwareCodecsEnabled(bool enabled);
+
+    bool sharedPipelineEnabled() const;
+    void setSharedPipelineEnabled(bool enabled);
+
+    bool isExternalServiceDiscoveryEnabled() const;
+    void setExternalServiceDiscoveryEnabled(bool enabled);
+
     /// \cond
     QStringList discoveryFeatures() const override;
     bool handleStanza(const QDomElement &element) override;
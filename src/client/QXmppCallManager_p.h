@@ -7,10 +7,21 @@
 
 #include "QXmppCall.h"
 
+#include <QDateTime>
+#include <QHash>
 #include <QHostAddress>
 #include <QList>
+#include <QMutex>
+#include <QPointer>
+#include <QVector>
 
 class QXmppCallManager;
+class QXmppCallPrivate;
+class QXmppExternalService;
+class QXmppExternalServiceDiscoveryManager;
+class QXmppIceConnection;
+class QXmppIcePortPool;
+class QXmppTurnAllocationCache;
 
 //  W A R N I N G
 //  -------------
@@ -26,15 +37,57 @@ class QXmppCallManagerPrivate
 {
 public:
     QXmppCallManagerPrivate(QXmppCallManager *qq);
+    ~QXmppCallManagerPrivate();
     QXmppCall *findCall(const QString &sid) const;
     QXmppCall *findCall(const QString &sid, QXmppCall::Direction direction) const;
+    void addCall(QXmppCall *call);
+    void removeCall(QXmppCallPrivate *call);
+
+    void createSharedPipeline();
+    void addSession(int id, QXmppCallPrivate *call);
+    void removeSessions(QXmppCallPrivate *call);
+
+    void requestExternalServices();
+    void setExternalServices(const QVector<QXmppExternalService> &services);
+    void configureConnection(QXmppIceConnection *connection) const;
 
     QList<QXmppCall *> calls;
+    // Calls by their session IDs and by the IDs of their outstanding requests,
+    // so incoming IQs don't have to be matched against every call
+    QHash<QString, QXmppCall *> callsBySid;
+    QHash<QString, QXmppCall *> callsByRequestId;
     QList<QPair<QHostAddress, quint16>> stunServers;
     QHostAddress turnHost;
     quint16 turnPort;
     QString turnUser;
     QString turnPassword;
+    QXmppTurnAllocationCache *turnAllocationCache;
+    QXmppIcePortPool *portPool;
+    bool hardwareCodecsEnabled;
+    bool sharedPipelineEnabled;
+
+    // XEP-0215: External Service Discovery
+    // Used instead of the configured STUN and TURN servers if there are none.
+    bool externalServiceDiscoveryEnabled = false;
+    QPointer<QXmppExternalServiceDiscoveryManager> externalServiceDiscovery;
+    QList<QPair<QHostAddress, quint16>> externalStunServers;
+    QHostAddress externalTurnHost;
+    quint16 externalTurnPort = 0;
+    QString externalTurnUser;
+    QString externalTurnPassword;
+    // invalid if the services don't expire
+    QDateTime externalServicesExpire;
+    // incremented for each set of services, so late host lookups are ignored
+    uint externalServicesGeneration = 0;
+
+    // Shared pipeline of the calls, created on first use
+    GstElement *pipeline;
+    GstElement *rtpbin;
+    int nextStreamId;
+    // Calls by the IDs of their rtpbin sessions. The signals of the rtpbin
+    // are emitted from the streaming threads, so this is guarded by a mutex.
+    mutable QMutex sessionsMutex;
+    QHash<int, QXmppCallPrivate *> sessions;
 
 private:
     QXmppCallManager *q;
@@ -0,0 +1,122 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPCALLRATECONTROL_P_H
+#define QXMPPCALLRATECONTROL_P_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API. It exists for the convenience
+// of QXmppCallStream.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+namespace QXmpp::Private {
+
+//
+// Sizes the jitter buffer from the interarrival jitter of the received
+// stream (RFC 3550, section 6.4.1).
+//
+// The latency grows at once when the jitter rises, so late packets aren't
+// dropped, and shrinks slowly when it falls, so the latency doesn't follow
+// every burst.
+//
+class JitterBufferSizer
+{
+public:
+    static constexpr int MinimumLatency = 25;
+    static constexpr int MaximumLatency = 400;
+
+    int latency() const { return m_latency; }
+
+    // Returns whether the latency has changed enough to be applied.
+    bool update(double jitterMsecs)
+    {
+        // the jitter is the mean deviation, most packets arrive within four times of it
+        const auto target = std::clamp(4.0 * jitterMsecs, double(MinimumLatency), double(MaximumLatency));
+        if (target > m_target) {
+            m_target = target;
+        } else {
+            m_target -= (m_target - target) / 8.0;
+        }
+
+        const auto latency = int(std::lround(m_target));
+        if (std::abs(latency - m_latency) < MinimumChange) {
+            return false;
+        }
+        m_latency = latency;
+        return true;
+    }
+
+private:
+    static constexpr int MinimumChange = 5;
+
+    double m_target = MinimumLatency;
+    int m_latency = MinimumLatency;
+};
+
+//
+// Loss-based congestion control of the encoder bitrate, driven by the RTCP
+// receiver reports of the peer (draft-ietf-rmcat-gcc, section 6).
+//
+// The bitrate is reduced when more than 10% of the packets are lost and
+// increased by 5% when less than 2% are lost. The round-trip time stands in
+// for the delay-based part: the bitrate isn't increased while it is well
+// above the lowest one seen, i.e. while packets are queued on the path.
+//
+class BitrateController
+{
+public:
+    BitrateController() = default;
+    BitrateController(int minimum, int start, int maximum)
+        : m_minimum(minimum),
+          m_maximum(std::max(minimum, maximum)),
+          m_bitrate(std::clamp(start, minimum, m_maximum))
+    {
+    }
+
+    int bitrate() const { return m_bitrate; }
+
+    // Returns whether the bitrate has changed.
+    bool update(double fractionLost, double roundTripMsecs)
+    {
+        if (roundTripMsecs > 0) {
+            m_minimumRoundTrip = std::min(m_minimumRoundTrip, roundTripMsecs);
+        }
+
+        auto bitrate = double(m_bitrate);
+        if (fractionLost > 0.1) {
+            bitrate *= 1.0 - 0.5 * fractionLost;
+        } else if (fractionLost < 0.02 && roundTripMsecs < m_minimumRoundTrip + QueueingDelay) {
+            // grow by at least 1 kbit/s, so low bitrates recover
+            bitrate = std::max(bitrate * 1.05, bitrate + 1000.0);
+        }
+
+        const auto previous = m_bitrate;
+        m_bitrate = std::clamp(int(bitrate), m_minimum, m_maximum);
+        return m_bitrate != previous;
+    }
+
+private:
+    static constexpr double QueueingDelay = 100.0;
+
+    int m_minimum = 0;
+    int m_maximum = 0;
+    int m_bitrate = 0;
+    double m_minimumRoundTrip = std::numeric_limits<double>::max();
+};
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPCALLRATECONTROL_P_H
@@ -0,0 +1,176 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPCALLSESSIONREGISTRY_P_H
+#define QXMPPCALLSESSIONREGISTRY_P_H
+
+#include <memory>
+#include <utility>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API. It exists for the convenience
+// of QXmppJingleMessageInitiationManager and QXmppCallInviteManager.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+namespace QXmpp::Private {
+
+//
+// Sessions of a call signalling protocol, indexed by the bare JID of the call
+// partner and the session ID, so incoming elements are matched in constant
+// time.
+//
+// If the call partner or the ID of a registered session changes, rekey() has
+// to be called.
+//
+// The time of the last activity is tracked per session, so sessions that
+// haven't been answered can be expired.
+//
+template<typename Session>
+class CallSessionRegistry
+{
+public:
+    using SessionPtr = std::shared_ptr<Session>;
+
+    CallSessionRegistry() { m_clock.start(); }
+
+    qsizetype size() const { return m_sessions.size(); }
+
+    QVector<SessionPtr> sessions() const
+    {
+        QVector<SessionPtr> sessions;
+        sessions.reserve(m_sessions.size());
+        for (const auto &entry : m_sessions) {
+            sessions.append(entry.session);
+        }
+        return sessions;
+    }
+
+    SessionPtr find(const QString &callPartnerJid, const QString &id) const
+    {
+        return m_sessions.value({ callPartnerJid, id }).session;
+    }
+
+    // Returns the oldest session with the call partner.
+    SessionPtr findByCallPartner(const QString &callPartnerJid) const
+    {
+        const auto ids = m_ids.value(callPartnerJid);
+        return ids.isEmpty() ? SessionPtr() : find(callPartnerJid, ids.constFirst());
+    }
+
+    // Replaces a session with the same key.
+    void insert(const QString &callPartnerJid, const QString &id, const SessionPtr &session)
+    {
+        const Key key { callPartnerJid, id };
+        if (!m_sessions.contains(key)) {
+            m_ids[callPartnerJid].append(id);
+        }
+        m_sessions.insert(key, { session, m_clock.elapsed() });
+    }
+
+    // Does nothing if the session isn't registered under the previous key.
+    void rekey(const Session *session,
+               const QString &previousCallPartnerJid,
+               const QString &previousId,
+               const QString &callPartnerJid,
+               const QString &id)
+    {
+        const Key previousKey { previousCallPartnerJid, previousId };
+        const auto itr = m_sessions.constFind(previousKey);
+        if (itr == m_sessions.cend() || itr->session.get() != session) {
+            return;
+        }
+
+        const auto registeredSession = itr->session;
+        removeKey(previousKey);
+        insert(callPartnerJid, id, registeredSession);
+    }
+
+    void remove(const QString &callPartnerJid, const QString &id)
+    {
+        removeKey({ callPartnerJid, id });
+    }
+
+    void clear()
+    {
+        m_sessions.clear();
+        m_ids.clear();
+    }
+
+    void touch(const QString &callPartnerJid, const QString &id)
+    {
+        const auto itr = m_sessions.find({ callPartnerJid, id });
+        if (itr != m_sessions.end()) {
+            itr->lastActivity = m_clock.elapsed();
+        }
+    }
+
+    // Removes the sessions without activity for maxIdleMsecs for which
+    // isExpirable returns true and returns them.
+    template<typename Predicate>
+    QVector<SessionPtr> removeExpired(qint64 maxIdleMsecs, Predicate isExpirable)
+    {
+        const auto now = m_clock.elapsed();
+
+        QVector<SessionPtr> expired;
+        for (auto itr = m_sessions.begin(); itr != m_sessions.end();) {
+            if (now - itr->lastActivity >= maxIdleMsecs && isExpirable(*itr->session)) {
+                expired.append(itr->session);
+                removeId(itr.key());
+                itr = m_sessions.erase(itr);
+            } else {
+                ++itr;
+            }
+        }
+        return expired;
+    }
+
+private:
+    using Key = std::pair<QString, QString>;
+
+    struct Entry {
+        SessionPtr session;
+        qint64 lastActivity = 0;
+    };
+
+    void removeKey(const Key &key)
+    {
+        if (m_sessions.remove(key)) {
+            removeId(key);
+        }
+    }
+
+    void removeId(const Key &key)
+    {
+        const auto itr = m_ids.find(key.first);
+        if (itr == m_ids.end()) {
+            return;
+        }
+        itr->removeOne(key.second);
+        if (itr->isEmpty()) {
+            m_ids.erase(itr);
+        }
+    }
+
+    QHash<Key, Entry> m_sessions;
+    // IDs of the sessions by call partner, in the order of their registration
+    QHash<QString, QVector<QString>> m_ids;
+    QElapsedTimer m_clock;
+};
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPCALLSESSIONREGISTRY_P_H
@@ -8,10 +8,78 @@
 #include "QXmppCall_p.h"
 #include "QXmppStun.h"
 
-#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <optional>
+
 #include <gst/gst.h>
 
 #include <QRandomGenerator>
+#include <QTimer>
+
+using namespace QXmpp::Private;
+
+// Interval in ms in which the jitter buffer and the bitrate are adapted to the
+// RTCP statistics
+constexpr int RATE_CONTROL_INTERVAL = 500;
+
+struct BitrateProperty
+{
+    const char *name;
+    // bit/s per unit of the property
+    int scale;
+};
+
+// Returns the property of an encoder for its target bitrate, which can be
+// changed while encoding.
+static std::optional<BitrateProperty> findBitrateProperty(GstElement *encoder, const QString &name, const QString &media)
+{
+    BitrateProperty property { "bitrate", 1 };
+    if (name == QLatin1String("vp8enc") || name == QLatin1String("vp9enc")) {
+        property.name = "target-bitrate";
+    } else if (media == VIDEO_MEDIA) {
+        // x264enc, x265enc and the VA-API and NVENC encoders use kbit/s
+        property.scale = 1000;
+    } else if (name != QLatin1String("opusenc") && name != QLatin1String("avenc_aac")) {
+        return {};
+    }
+
+    if (!g_object_class_find_property(G_OBJECT_GET_CLASS(encoder), property.name)) {
+        return {};
+    }
+    return property;
+}
+
+// Reads an integer property of any integer type.
+static qint64 integerProperty(GObject *object, const char *name)
+{
+    auto *spec = g_object_class_find_property(G_OBJECT_GET_CLASS(object), name);
+    GValue value = G_VALUE_INIT;
+    GValue converted = G_VALUE_INIT;
+    g_value_init(&value, spec->value_type);
+    g_value_init(&converted, G_TYPE_INT64);
+    g_object_get_property(object, name, &value);
+    const auto result = g_value_transform(&value, &converted) ? g_value_get_int64(&converted) : 0;
+    g_value_unset(&value);
+    g_value_unset(&converted);
+    return result;
+}
+
+// Writes an integer property of any integer type.
+static void setIntegerProperty(GObject *object, const char *name, qint64 value)
+{
+    auto *spec = g_object_class_find_property(G_OBJECT_GET_CLASS(object), name);
+    GValue input = G_VALUE_INIT;
+    GValue converted = G_VALUE_INIT;
+    g_value_init(&input, G_TYPE_INT64);
+    g_value_init(&converted, spec->value_type);
+    g_value_set_int64(&input, value);
+    if (g_value_transform(&input, &converted)) {
+        g_object_set_property(object, name, &converted);
+    }
+    g_value_unset(&input);
+    g_value_unset(&converted);
+}
 
 /// \cond
 QXmppCallStreamPrivate::QXmppCallStreamPrivate(QXmppCallStream *parent, GstElement *pipeline_,
@@ -77,10 +145,7 @@ QXmppCallStreamPrivate::QXmppCallStreamPrivate(QXmppCallStream *parent, GstEleme
     g_object_set(apprtpsrc, "is-live", true, "max-latency", 5000000, nullptr);
     g_object_set(apprtcpsrc, "is-live", true, nullptr);
 
-    connect(connection->component(RTP_COMPONENT), &QXmppIceComponent::datagramReceived,
-            [&](const QByteArray &datagram) { datagramReceived(datagram, apprtpsrc); });
-    connect(connection->component(RTCP_COMPONENT), &QXmppIceComponent::datagramReceived,
-            [&](const QByteArray &datagram) { datagramReceived(datagram, apprtcpsrc); });
+    connectComponents();
 
     if (!gst_bin_add(GST_BIN(iceReceiveBin), apprtpsrc) ||
         !gst_bin_add(GST_BIN(iceReceiveBin), apprtcpsrc)) {
@@ -99,11 +164,33 @@ QXmppCallStreamPrivate::QXmppCallStreamPrivate(QXmppCallStream *parent, GstEleme
 
     gst_element_sync_state_with_parent(iceReceiveBin);
     gst_element_sync_state_with_parent(iceSendBin);
+
+    rateControlTimer = new QTimer(this);
+    connect(rateControlTimer, &QTimer::timeout, this, &QXmppCallStreamPrivate::updateRateControl);
+    rateControlTimer->start(RATE_CONTROL_INTERVAL);
 }
 
 QXmppCallStreamPrivate::~QXmppCallStreamPrivate()
 {
-    connection->close();
+    // a bundled connection is closed by the call
+    if (connection->parent() == this) {
+        connection->close();
+    }
+
+    // The pipeline may be shared with other calls and still be playing
+    for (auto *bin : { encoderBin, decoderBin, iceSendBin, iceReceiveBin }) {
+        if (bin) {
+            gst_element_set_state(bin, GST_STATE_NULL);
+        }
+    }
+
+    // Release the pads of the rtpbin session, which frees the session
+    for (const auto *padName : { "send_rtp_sink_%1", "recv_rtp_sink_%1", "recv_rtcp_sink_%1", "send_rtcp_src_%1" }) {
+        if (auto *pad = gst_element_get_static_pad(rtpbin, QString::fromLatin1(padName).arg(id).toLatin1().constData())) {
+            gst_element_release_request_pad(rtpbin, pad);
+            gst_object_unref(pad);
+        }
+    }
 
     // Remove elements from pipeline
     if ((encoderBin && !gst_bin_remove(GST_BIN(pipeline), encoderBin)) ||
@@ -112,6 +199,10 @@ QXmppCallStreamPrivate::~QXmppCallStreamPrivate()
         !gst_bin_remove(GST_BIN(pipeline), iceReceiveBin)) {
         qFatal("Failed to remove bins from pipeline");
     }
+
+    if (jitterBuffer) {
+        gst_object_unref(jitterBuffer);
+    }
 }
 
 GstFlowReturn QXmppCallStreamPrivate::sendDatagram(GstElement *appsink, int component)
@@ -133,38 +224,113 @@ GstFlowReturn QXmppCallStreamPrivate::sendDatagram(GstElement *appsink, int comp
         qFatal("Could not map buffer");
         return GST_FLOW_ERROR;
     }
-    QByteArray datagram;
-    datagram.resize(mapInfo.size);
-    std::memcpy(datagram.data(), mapInfo.data, mapInfo.size);
+
+    // The datagram is written to the socket synchronously, so the mapped memory
+    // of the buffer can be sent without copying it.
+    const auto datagram = QByteArray::fromRawData(reinterpret_cast<const char *>(mapInfo.data), int(mapInfo.size));
+
+    auto result = GST_FLOW_OK;
+    {
+        QMutexLocker locker(&connectionMutex);
+        auto *socket = connection->component(rtcpMux ? RTP_COMPONENT : component);
+        if (socket && socket->isConnected() && socket->sendDatagram(datagram) != datagram.size()) {
+            result = GST_FLOW_ERROR;
+        }
+    }
+
     gst_buffer_unmap(buffer, &mapInfo);
     gst_sample_unref(sample);
+    return result;
+}
 
-    if (connection->component(component)->isConnected() &&
-        connection->component(component)->sendDatagram(datagram) != datagram.size()) {
-        return GST_FLOW_ERROR;
+void QXmppCallStreamPrivate::rtpDatagramReceived(const QByteArray &datagram)
+{
+    if (datagram.size() < 2) {
+        return;
+    }
+
+    // RFC 5761, section 4: the packet types of RTCP can't be mistaken for the
+    // marker bit and payload type of RTP
+    const auto secondByte = quint8(datagram.at(1));
+    if (rtcpMux && secondByte >= 192 && secondByte <= 223) {
+        datagramReceived(datagram, apprtcpsrc);
+        return;
     }
-    return GST_FLOW_OK;
+
+    // the packets of the other streams of the BUNDLE group are told apart by
+    // their payload types
+    if (bundled) {
+        const int payloadType = secondByte & 0x7f;
+        if (std::none_of(payloadTypes.cbegin(), payloadTypes.cend(), [=](const auto &type) { return type.id() == payloadType; })) {
+            return;
+        }
+    }
+    datagramReceived(datagram, apprtpsrc);
 }
 
 void QXmppCallStreamPrivate::datagramReceived(const QByteArray &datagram, GstElement *appsrc)
 {
-    GstBuffer *buffer = gst_buffer_new_and_alloc(datagram.size());
-    GstMapInfo mapInfo;
-    if (!gst_buffer_map(buffer, &mapInfo, GST_MAP_WRITE)) {
-        qFatal("Could not map buffer");
-        return;
-    }
-    std::memcpy(mapInfo.data, datagram.data(), mapInfo.size);
-    gst_buffer_unmap(buffer, &mapInfo);
+    // Wrap the memory of the datagram instead of copying it into a new buffer.
+    // The buffer keeps a shallow copy of the datagram alive and is read-only,
+    // so GStreamer copies it before writing.
+    auto *data = new QByteArray(datagram);
+    GstBuffer *buffer = gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY,
+                                                    const_cast<char *>(data->constData()),
+                                                    gsize(data->size()), 0, gsize(data->size()),
+                                                    data, +[](gpointer data) {
+                                                        delete static_cast<QByteArray *>(data);
+                                                    });
     GstFlowReturn ret;
     g_signal_emit_by_name(appsrc, "push-buffer", buffer, &ret);
     gst_buffer_unref(buffer);
 }
 
-void QXmppCallStreamPrivate::addEncoder(QXmppCallPrivate::GstCodec &codec)
+void QXmppCallStreamPrivate::connectComponents()
+{
+    if (auto *component = connection->component(RTP_COMPONENT)) {
+        connect(component, &QXmppIceComponent::datagramReceived,
+                this, &QXmppCallStreamPrivate::rtpDatagramReceived);
+    }
+    if (auto *component = connection->component(RTCP_COMPONENT)) {
+        connect(component, &QXmppIceComponent::datagramReceived,
+                this, [this](const QByteArray &datagram) { datagramReceived(datagram, apprtcpsrc); });
+    }
+}
+
+//
+// Sends and receives RTCP on the RTP component and frees the RTCP component.
+//
+void QXmppCallStreamPrivate::enableRtcpMux()
+{
+    QMutexLocker locker(&connectionMutex);
+    rtcpMux = true;
+    if (connection->component(RTCP_COMPONENT)) {
+        connection->removeComponent(RTCP_COMPONENT);
+    }
+}
+
+//
+// Shares the connection of the other stream instead of negotiating one for
+// this stream. The caller keeps the connection alive for both streams.
+//
+void QXmppCallStreamPrivate::bundleWith(QXmppCallStreamPrivate *other)
+{
+    {
+        QMutexLocker locker(&connectionMutex);
+        delete connection;
+        connection = other->connection;
+        rtcpMux = other->rtcpMux;
+    }
+    bundled = true;
+    other->bundled = true;
+    connectComponents();
+}
+
+void QXmppCallStreamPrivate::addEncoder(QXmppCallPrivate::GstCodec &codec, const QXmppJinglePayloadType &payloadType)
 {
     // Remove old encoder and payloader if they exist
     if (encoderBin) {
+        gst_element_set_state(encoderBin, GST_STATE_NULL);
         if (!gst_bin_remove(GST_BIN(pipeline), encoderBin)) {
             qFatal("Failed to remove existing encoder bin");
         }
@@ -201,6 +367,29 @@ void QXmppCallStreamPrivate::addEncoder(QXmppCallPrivate::GstCodec &codec)
         g_object_set(encoder, encProp.name.toLatin1().data(), encProp.value, nullptr);
     }
 
+    // RFC 7587: the peer asks for in-band FEC and DTX in its format parameters
+    inbandFec = false;
+    if (codec.gstEnc == QLatin1String("opusenc")) {
+        const auto parameters = payloadType.parameters();
+        inbandFec = parameters.value(QStringLiteral("useinbandfec")) == QLatin1String("1");
+        const bool dtx = parameters.value(QStringLiteral("usedtx")) == QLatin1String("1");
+        g_object_set(encoder, "inband-fec", gboolean(inbandFec), "dtx", gboolean(dtx), nullptr);
+    }
+
+    // the bitrate starts with the configured one
+    rateEncoder = nullptr;
+    lastReportSequence = 0;
+    if (const auto property = findBitrateProperty(encoder, codec.gstEnc, media)) {
+        const auto start = int(integerProperty(G_OBJECT(encoder), property->name) * property->scale);
+        if (start > 0) {
+            rateEncoder = encoder;
+            bitrateProperty = property->name;
+            bitrateScale = property->scale;
+            bitrateController = media == AUDIO_MEDIA ? BitrateController(start / 4, start, start)
+                                                     : BitrateController(start / 8, start, start * 4);
+        }
+    }
+
     gst_bin_add_many(GST_BIN(encoderBin), queue, encoder, pay, nullptr);
 
     if (!gst_element_link_pads(pay, "src", rtpbin, QStringLiteral("send_rtp_sink_%1").arg(id).toLatin1().data()) ||
@@ -231,6 +420,7 @@ void QXmppCallStreamPrivate::addDecoder(GstPad *pad, QXmppCallPrivate::GstCodec
 {
     // Remove old decoder and depayloader if they exist
     if (decoderBin) {
+        gst_element_set_state(decoderBin, GST_STATE_NULL);
         if (!gst_bin_remove(GST_BIN(pipeline), decoderBin)) {
             qFatal("Failed to remove existing decoder bin");
         }
@@ -258,6 +448,10 @@ void QXmppCallStreamPrivate::addDecoder(GstPad *pad, QXmppCallPrivate::GstCodec
         qFatal("Failed to create decoder");
         return;
     }
+    if (codec.gstDec == QLatin1String("opusdec")) {
+        // lost packets are concealed, using the FEC data of the next one if available
+        g_object_set(decoder, "plc", true, "use-inband-fec", true, nullptr);
+    }
 
     GstElement *queue = gst_element_factory_make("queue", nullptr);
     if (!queue) {
@@ -305,6 +499,82 @@ void QXmppCallStreamPrivate::addRtcpSender(GstPad *pad)
         qFatal("Failed to link rtcp pads");
     }
 }
+
+// Called from the streaming thread when the rtpbin creates the jitter buffer
+// for a source of the stream.
+void QXmppCallStreamPrivate::setJitterBuffer(GstElement *element)
+{
+    QMutexLocker locker(&jitterBufferMutex);
+    if (jitterBuffer) {
+        gst_object_unref(jitterBuffer);
+    }
+    jitterBuffer = GST_ELEMENT(gst_object_ref(element));
+    g_object_set(jitterBuffer, "latency", guint(jitterBufferSizer.latency()), nullptr);
+}
+
+// Adapts the jitter buffer to the jitter of the received stream and the
+// encoder's bitrate to the receiver reports of the peer.
+void QXmppCallStreamPrivate::updateRateControl()
+{
+    GstElement *rtpSession = nullptr;
+    g_signal_emit_by_name(rtpbin, "get-session", static_cast<uint>(id), &rtpSession);
+    if (!rtpSession) {
+        return;
+    }
+    GstStructure *stats = nullptr;
+    g_object_get(rtpSession, "stats", &stats, nullptr);
+    gst_object_unref(rtpSession);
+    if (!stats) {
+        return;
+    }
+
+    const auto *sourcesValue = gst_structure_get_value(stats, "source-stats");
+    const auto *sources = sourcesValue ? static_cast<const GValueArray *>(g_value_get_boxed(sourcesValue)) : nullptr;
+    for (guint i = 0; sources && i < sources->n_values; ++i) {
+        const auto *source = gst_value_get_structure(&sources->values[i]);
+        gboolean internal = false;
+        if (!gst_structure_get_boolean(source, "internal", &internal) || internal) {
+            continue;
+        }
+
+        // jitter of the received stream in units of its clock rate
+        int clockRate = 0;
+        uint jitter = 0;
+        if (gst_structure_get_int(source, "clock-rate", &clockRate) && clockRate > 0 &&
+            gst_structure_get_uint(source, "jitter", &jitter)) {
+            QMutexLocker locker(&jitterBufferMutex);
+            if (jitterBufferSizer.update(jitter * 1000.0 / clockRate) && jitterBuffer) {
+                g_object_set(jitterBuffer, "latency", guint(jitterBufferSizer.latency()), nullptr);
+            }
+        }
+
+        // receiver report of the peer about the sent stream
+        gboolean haveReport = false;
+        uint reportSsrc = 0;
+        uint sequence = 0;
+        if (!rateEncoder ||
+            !gst_structure_get_boolean(source, "have-rb", &haveReport) || !haveReport ||
+            !gst_structure_get_uint(source, "rb-ssrc", &reportSsrc) || reportSsrc != localSsrc ||
+            !gst_structure_get_uint(source, "rb-exthighestseq", &sequence) || sequence == lastReportSequence) {
+            continue;
+        }
+        lastReportSequence = sequence;
+
+        // the lost fraction is given in 1/256, the round-trip time in 1/65536 s
+        uint fractionLost = 0;
+        uint roundTrip = 0;
+        gst_structure_get_uint(source, "rb-fractionlost", &fractionLost);
+        gst_structure_get_uint(source, "rb-round-trip", &roundTrip);
+        const auto loss = fractionLost / 256.0;
+        if (bitrateController.update(loss, roundTrip * 1000.0 / 65536.0)) {
+            setIntegerProperty(G_OBJECT(rateEncoder), bitrateProperty.constData(), bitrateController.bitrate() / bitrateScale);
+        }
+        if (inbandFec) {
+            g_object_set(rateEncoder, "packet-loss-percentage", int(std::lround(loss * 100)), nullptr);
+        }
+    }
+    gst_structure_free(stats);
+}
 /// \endcond
 
 ///
@@ -5,16 +5,19 @@
 #ifndef QXMPPCALLSTREAM_P_H
 #define QXMPPCALLSTREAM_P_H
 
+#include "QXmppCallRateControl_p.h"
 #include "QXmppCall_p.h"
 #include "QXmppJingleIq.h"
 
 #include <gst/gst.h>
 
 #include <QList>
+#include <QMutex>
 #include <QObject>
 #include <QString>
 
 class QXmppIceConnection;
+class QTimer;
 
 //  W A R N I N G
 //  -------------
@@ -42,12 +45,18 @@ public:
     ~QXmppCallStreamPrivate();
 
     GstFlowReturn sendDatagram(GstElement *appsink, int component);
+    void rtpDatagramReceived(const QByteArray &datagram);
     void datagramReceived(const QByteArray &datagram, GstElement *appsrc);
+    void connectComponents();
+    void enableRtcpMux();
+    void bundleWith(QXmppCallStreamPrivate *other);
 
-    void addEncoder(QXmppCallPrivate::GstCodec &codec);
+    void addEncoder(QXmppCallPrivate::GstCodec &codec, const QXmppJinglePayloadType &payloadType);
     void addDecoder(GstPad *pad, QXmppCallPrivate::GstCodec &codec);
     void addRtpSender(GstPad *pad);
     void addRtcpSender(GstPad *pad);
+    void setJitterBuffer(GstElement *jitterBuffer);
+    void updateRateControl();
 
     QXmppCallStream *q;
 
@@ -73,12 +82,39 @@ public:
     std::function<void(GstPad *)> receivePadCB;
 
     QXmppIceConnection *connection;
+    // Guards the components of the connection, which are used from the streaming thread
+    QMutex connectionMutex;
+    // RFC 5761: whether RTCP is offered or negotiated to be sent on the RTP
+    // component, until the description of the remote party lacks it
+    bool rtcpMuxSupported = true;
+    bool rtcpMux = false;
+    // XEP-0338: whether the connection is shared with the other streams of the
+    // BUNDLE group, which is the case when it isn't owned by this stream
+    bool bundled = false;
     QString media;
     QString creator;
     QString name;
     int id;
 
     QList<QXmppJinglePayloadType> payloadTypes;
+
+    // Adaptive jitter buffer, set from the streaming thread
+    QMutex jitterBufferMutex;
+    GstElement *jitterBuffer = nullptr;
+    QXmpp::Private::JitterBufferSizer jitterBufferSizer;
+
+    // Bitrate control of the encoder, which is null if its bitrate can't be changed
+    GstElement *rateEncoder = nullptr;
+    QByteArray bitrateProperty;
+    // bit/s per unit of the property
+    int bitrateScale = 1;
+    QXmpp::Private::BitrateController bitrateController;
+    // whether the encoder sends Opus in-band FEC, which is tuned to the loss rate
+    bool inbandFec = false;
+    // extended highest sequence number of the last receiver report, to skip
+    // reports that have already been handled
+    uint lastReportSequence = 0;
+    QTimer *rateControlTimer;
 };
 
 #endif
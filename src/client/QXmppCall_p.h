@@ -11,6 +11,7 @@
 #include <gst/gst.h>
 
 #include <QList>
+#include <QStringList>
 
 //
 //  W A R N I N G
@@ -46,22 +47,37 @@ public:
         };
         // Use e.g. gst-inspect-1.0 x264enc to find good encoder settings for live streaming
         QList<Property> encProps;
+        struct Encoder
+        {
+            QString name;
+            QList<Property> props;
+        };
+        // Hardware-accelerated alternatives (VA-API, NVENC, V4L2), the first
+        // available one is used instead of gstEnc/gstDec
+        QList<Encoder> hwEncs;
+        QStringList hwDecs;
+        bool hwEncoding = false;
+        bool hwDecoding = false;
     };
 
-    QXmppCallPrivate(QXmppCall *qq);
+    QXmppCallPrivate(QXmppCall *qq, QXmppCallManager *manager_);
     ~QXmppCallPrivate();
 
     void ssrcActive(uint sessionId, uint ssrc);
+    void jitterBufferAdded(uint sessionId, GstElement *jitterBuffer);
     void padAdded(GstPad *pad);
     GstCaps *ptMap(uint sessionId, uint pt);
-    bool isFormatSupported(const QString &codecName) const;
-    void filterGStreamerFormats(QList<GstCodec> &formats);
+    static bool isFormatSupported(const QString &codecName);
+    static void filterGStreamerFormats(QList<GstCodec> &formats, bool useHardware);
+    static void createPipeline(GstElement *&pipeline, GstElement *&rtpbin);
 
-    QXmppCallStream *createStream(const QString &media, const QString &creator, const QString &name);
+    QXmppCallStream *createStream(const QString &media, const QString &creator, const QString &name, QXmppCallStream *bundleWith = nullptr);
     QXmppCallStream *findStreamByMedia(const QString &media);
     QXmppCallStream *findStreamByName(const QString &name);
     QXmppCallStream *findStreamById(const int id);
     QXmppJingleIq::Content localContent(QXmppCallStream *stream) const;
+    void addBundleGroup(QXmppJingleIq &iq, QXmppCallStream *stream) const;
+    static QStringList bundleGroup(const QXmppJingleIq &iq, const QString &contentName);
 
     void handleAck(const QXmppIq &iq);
     bool handleDescription(QXmppCallStream *stream, const QXmppJingleIq::Content &content);
@@ -83,18 +99,31 @@ public:
 
     GstElement *pipeline;
     GstElement *rtpbin;
+    // whether the pipeline and rtpbin are shared with the other calls of the manager
+    bool sharedPipeline;
 
     // Media streams
     QList<QXmppCallStream *> streams;
     int nextId;
+    // XEP-0338: whether the remote party bundles the streams of the call on one transport
+    bool bundleSupported = false;
 
     // Supported codecs
     QList<GstCodec> videoCodecs = {
-        { .pt = 100, .name = "H264", .channels = 1, .clockrate = 90000, .gstPay = "rtph264pay", .gstDepay = "rtph264depay", .gstEnc = "x264enc", .gstDec = "avdec_h264", .encProps = { { "tune", 4 }, { "speed-preset", 3 }, { "byte-stream", true }, { "bitrate", 512 } } },
-        { .pt = 99, .name = "VP8", .channels = 1, .clockrate = 90000, .gstPay = "rtpvp8pay", .gstDepay = "rtpvp8depay", .gstEnc = "vp8enc", .gstDec = "vp8dec", .encProps = { { "deadline", 20000 }, { "target-bitrate", 512000 } } },
+        { .pt = 100, .name = "H264", .channels = 1, .clockrate = 90000, .gstPay = "rtph264pay", .gstDepay = "rtph264depay", .gstEnc = "x264enc", .gstDec = "avdec_h264", .encProps = { { "tune", 4 }, { "speed-preset", 3 }, { "byte-stream", true }, { "bitrate", 512 } },
+          .hwEncs = { { "vah264enc", { { "target-usage", 7 }, { "bitrate", 512 } } }, { "vaapih264enc", { { "bitrate", 512 } } }, { "nvh264enc", { { "zerolatency", true }, { "bitrate", 512 } } }, { "v4l2h264enc", {} } },
+          .hwDecs = { "vah264dec", "vaapih264dec", "nvh264dec", "v4l2h264dec", "v4l2slh264dec" } },
+        { .pt = 99, .name = "VP8", .channels = 1, .clockrate = 90000, .gstPay = "rtpvp8pay", .gstDepay = "rtpvp8depay", .gstEnc = "vp8enc", .gstDec = "vp8dec", .encProps = { { "deadline", 20000 }, { "target-bitrate", 512000 } },
+          .hwEncs = { { "vaapivp8enc", { { "bitrate", 512 } } }, { "v4l2vp8enc", {} } },
+          .hwDecs = { "vavp8dec", "vaapivp8dec", "nvvp8dec", "v4l2vp8dec", "v4l2slvp8dec" } },
         // vp9enc and x265enc seem to be very slow. Give them a lower priority for now.
-        { .pt = 102, .name = "H265", .channels = 1, .clockrate = 90000, .gstPay = "rtph265pay", .gstDepay = "rtph265depay", .gstEnc = "x265enc", .gstDec = "avdec_h265", .encProps = { { "tune", 4 }, { "speed-preset", 3 }, { "bitrate", 512 } } },
-        { .pt = 101, .name = "VP9", .channels = 1, .clockrate = 90000, .gstPay = "rtpvp9pay", .gstDepay = "rtpvp9depay", .gstEnc = "vp9enc", .gstDec = "vp9dec", .encProps = { { "deadline", 20000 }, { "target-bitrate", 512000 } } }
+        // Codecs with hardware support are moved to the front by filterGStreamerFormats().
+        { .pt = 102, .name = "H265", .channels = 1, .clockrate = 90000, .gstPay = "rtph265pay", .gstDepay = "rtph265depay", .gstEnc = "x265enc", .gstDec = "avdec_h265", .encProps = { { "tune", 4 }, { "speed-preset", 3 }, { "bitrate", 512 } },
+          .hwEncs = { { "vah265enc", { { "target-usage", 7 }, { "bitrate", 512 } } }, { "vaapih265enc", { { "bitrate", 512 } } }, { "nvh265enc", { { "zerolatency", true }, { "bitrate", 512 } } }, { "v4l2h265enc", {} } },
+          .hwDecs = { "vah265dec", "vaapih265dec", "nvh265dec", "v4l2h265dec", "v4l2slh265dec" } },
+        { .pt = 101, .name = "VP9", .channels = 1, .clockrate = 90000, .gstPay = "rtpvp9pay", .gstDepay = "rtpvp9depay", .gstEnc = "vp9enc", .gstDec = "vp9dec", .encProps = { { "deadline", 20000 }, { "target-bitrate", 512000 } },
+          .hwEncs = { { "vavp9enc", { { "target-usage", 7 }, { "bitrate", 512 } } }, { "vaapivp9enc", { { "bitrate", 512 } } }, { "v4l2vp9enc", {} } },
+          .hwDecs = { "vavp9dec", "vaapivp9dec", "nvvp9dec", "v4l2vp9dec", "v4l2slvp9dec" } }
     };
 
     QList<GstCodec> audioCodecs = {
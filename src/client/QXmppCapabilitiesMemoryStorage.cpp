@@ -0,0 +1,78 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppCapabilitiesMemoryStorage.h"
+
+#include "QXmppDiscoveryIq.h"
+#include "QXmppFutureUtils_p.h"
+
+#include <QHash>
+#include <QMutex>
+
+using namespace QXmpp::Private;
+
+///
+/// \class QXmppCapabilitiesMemoryStorage
+///
+/// \brief The QXmppCapabilitiesMemoryStorage class stores service discovery
+/// information of \xep{0115, Entity Capabilities} in the memory.
+///
+/// This is the default storage of QXmppDiscoveryManager. Its entries are lost
+/// when the storage is destroyed.
+///
+/// The storage is thread-safe, so it can be shared by the discovery managers of
+/// clients in different threads, e.g. those of a QXmppClientPool.
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+
+static QString storageKey(const QString &node, const QByteArray &ver, const QString &hash)
+{
+    return hash + u' ' + QString::fromLatin1(ver.toBase64()) + u' ' + node;
+}
+
+class QXmppCapabilitiesMemoryStoragePrivate
+{
+public:
+    QMutex mutex;
+    QHash<QString, QXmppDiscoveryIq> infos;
+};
+
+///
+/// Constructs a capabilities memory storage.
+///
+QXmppCapabilitiesMemoryStorage::QXmppCapabilitiesMemoryStorage()
+    : d(new QXmppCapabilitiesMemoryStoragePrivate)
+{
+}
+
+QXmppCapabilitiesMemoryStorage::~QXmppCapabilitiesMemoryStorage() = default;
+
+/// \cond
+QXmppTask<std::optional<QXmppDiscoveryIq>> QXmppCapabilitiesMemoryStorage::info(const QString &node, const QByteArray &ver, const QString &hash)
+{
+    std::optional<QXmppDiscoveryIq> info;
+    QMutexLocker locker(&d->mutex);
+    if (const auto itr = d->infos.constFind(storageKey(node, ver, hash)); itr != d->infos.constEnd()) {
+        info = *itr;
+    }
+    return makeReadyTask(std::move(info));
+}
+
+QXmppTask<void> QXmppCapabilitiesMemoryStorage::addInfo(const QString &node, const QByteArray &ver, const QString &hash, const QXmppDiscoveryIq &info)
+{
+    QMutexLocker locker(&d->mutex);
+    d->infos.insert(storageKey(node, ver, hash), info);
+    return makeReadyTask();
+}
+
+QXmppTask<void> QXmppCapabilitiesMemoryStorage::removeAll()
+{
+    QMutexLocker locker(&d->mutex);
+    d->infos.clear();
+    return makeReadyTask();
+}
+/// \endcond
@@ -0,0 +1,30 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPCAPABILITIESMEMORYSTORAGE_H
+#define QXMPPCAPABILITIESMEMORYSTORAGE_H
+
+#include "QXmppCapabilitiesStorage.h"
+
+#include <memory>
+
+class QXmppCapabilitiesMemoryStoragePrivate;
+
+class QXMPP_EXPORT QXmppCapabilitiesMemoryStorage : public QXmppCapabilitiesStorage
+{
+public:
+    QXmppCapabilitiesMemoryStorage();
+    ~QXmppCapabilitiesMemoryStorage() override;
+
+    /// \cond
+    QXmppTask<std::optional<QXmppDiscoveryIq>> info(const QString &node, const QByteArray &ver, const QString &hash) override;
+    QXmppTask<void> addInfo(const QString &node, const QByteArray &ver, const QString &hash, const QXmppDiscoveryIq &info) override;
+    QXmppTask<void> removeAll() override;
+    /// \endcond
+
+private:
+    const std::unique_ptr<QXmppCapabilitiesMemoryStoragePrivate> d;
+};
+
+#endif  // QXMPPCAPABILITIESMEMORYSTORAGE_H
@@ -0,0 +1,52 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+///
+/// \class QXmppCapabilitiesStorage
+///
+/// \brief The QXmppCapabilitiesStorage class stores service discovery
+/// information of \xep{0115, Entity Capabilities}.
+///
+/// Entities advertise their capabilities with a hash in their presence. The
+/// information belonging to a hash never changes, so it can be kept across
+/// sessions. Implement this interface to store it in a database and pass it to
+/// QXmppDiscoveryManager::setCapabilitiesStorage().
+///
+/// All entries are identified by the capabilities node, the verification string
+/// and the name of the hash algorithm as found in the presence. Only verified
+/// information is passed to the storage.
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+
+///
+/// \fn QXmppCapabilitiesStorage::info(const QString &node, const QByteArray &ver, const QString &hash)
+///
+/// Returns the stored service discovery information.
+///
+/// \param node capabilities node of the entity
+/// \param ver verification string (not base64-encoded)
+/// \param hash name of the hash algorithm (e.g., "sha-1")
+///
+/// \return the stored information or nothing if there is no entry
+///
+
+///
+/// \fn QXmppCapabilitiesStorage::addInfo(const QString &node, const QByteArray &ver, const QString &hash, const QXmppDiscoveryIq &info)
+///
+/// Stores service discovery information.
+///
+/// \param node capabilities node of the entity
+/// \param ver verification string (not base64-encoded)
+/// \param hash name of the hash algorithm (e.g., "sha-1")
+/// \param info verified service discovery information
+///
+
+///
+/// \fn QXmppCapabilitiesStorage::removeAll()
+///
+/// Removes all stored information.
+///
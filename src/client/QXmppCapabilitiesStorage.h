@@ -0,0 +1,26 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPCAPABILITIESSTORAGE_H
+#define QXMPPCAPABILITIESSTORAGE_H
+
+#include "QXmppGlobal.h"
+
+#include <optional>
+
+template<typename T>
+class QXmppTask;
+class QXmppDiscoveryIq;
+
+class QXMPP_EXPORT QXmppCapabilitiesStorage
+{
+public:
+    virtual ~QXmppCapabilitiesStorage() = default;
+
+    virtual QXmppTask<std::optional<QXmppDiscoveryIq>> info(const QString &node, const QByteArray &ver, const QString &hash) = 0;
+    virtual QXmppTask<void> addInfo(const QString &node, const QByteArray &ver, const QString &hash, const QXmppDiscoveryIq &info) = 0;
+    virtual QXmppTask<void> removeAll() = 0;
+};
+
+#endif  // QXMPPCAPABILITIESSTORAGE_H
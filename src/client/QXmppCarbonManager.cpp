@@ -64,6 +64,13 @@ QStringList QXmppCarbonManager::discoveryFeatures() const
     return QStringList() << ns_carbons;
 }
 
+QVector<QXmppClientExtension::StanzaFilter> QXmppCarbonManager::stanzaFilters() const
+{
+    return {
+        { QStringLiteral("message"), ns_carbons },
+    };
+}
+
 bool QXmppCarbonManager::handleStanza(const QDomElement &element)
 {
     if (element.tagName() != "message") {
@@ -35,6 +35,7 @@ public:
 
     /// \cond
     QStringList discoveryFeatures() const override;
+    QVector<StanzaFilter> stanzaFilters() const override;
     bool handleStanza(const QDomElement &element) override;
     /// \endcond
 
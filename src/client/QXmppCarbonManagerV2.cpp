@@ -36,7 +36,7 @@ public:
     }
 };
 
-auto firstXmlnsElement(const QDomElement &el, const char *xmlns)
+auto firstXmlnsElement(const QDomElement &el, QLatin1String xmlns)
 {
     for (auto child = el.firstChildElement();
          !child.isNull();
@@ -48,7 +48,7 @@ auto firstXmlnsElement(const QDomElement &el, const char *xmlns)
     return QDomElement();
 }
 
-auto firstChildElement(const QDomElement &el, const char *tagName, const char *xmlns)
+auto firstChildElement(const QDomElement &el, const char *tagName, QLatin1String xmlns)
 {
     for (auto child = el.firstChild();
          !child.isNull();
@@ -114,6 +114,13 @@ auto parseIq(std::variant<QDomElement, QXmppError> &&sendResult) -> std::optiona
 QXmppCarbonManagerV2::QXmppCarbonManagerV2() = default;
 QXmppCarbonManagerV2::~QXmppCarbonManagerV2() = default;
 
+QVector<QXmppClientExtension::StanzaFilter> QXmppCarbonManagerV2::stanzaFilters() const
+{
+    return {
+        { QStringLiteral("message"), ns_carbons },
+    };
+}
+
 bool QXmppCarbonManagerV2::handleStanza(const QDomElement &element, const std::optional<QXmppE2eeMetadata> &)
 {
     if (element.tagName() != "message") {
@@ -14,6 +14,7 @@ public:
     QXmppCarbonManagerV2();
     ~QXmppCarbonManagerV2();
 
+    QVector<StanzaFilter> stanzaFilters() const override;
     bool handleStanza(const QDomElement &, const std::optional<QXmppE2eeMetadata> &) override;
 
 protected:
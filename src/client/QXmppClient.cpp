@@ -7,6 +7,7 @@
 #include "QXmppClientExtension.h"
 #include "QXmppClient_p.h"
 #include "QXmppConstants_p.h"
+#include "QXmppCredentialsStorage.h"
 #include "QXmppDiscoveryIq.h"
 #include "QXmppDiscoveryManager.h"
 #include "QXmppE2eeExtension.h"
@@ -16,18 +17,31 @@
 #include "QXmppLogger.h"
 #include "QXmppMessage.h"
 #include "QXmppMessageHandler.h"
+#include "QXmppMetrics.h"
 #include "QXmppOutgoingClient.h"
 #include "QXmppPacket_p.h"
 #include "QXmppPromise.h"
 #include "QXmppRosterManager.h"
+#include "QXmppStanzaView.h"
 #include "QXmppTask.h"
 #include "QXmppTlsManager_p.h"
+#include "QXmppTracing_p.h"
 #include "QXmppUtils.h"
 #include "QXmppVCardManager.h"
 #include "QXmppVersionManager.h"
 
+#include <algorithm>
+#include <utility>
+
 #include <QDomElement>
+#include <QElapsedTimer>
+#include <QMutex>
+#if QT_VERSION >= QT_VERSION_CHECK(6, 1, 0)
+#include <QNetworkInformation>
+#endif
+#include <QRandomGenerator>
 #include <QSslSocket>
+#include <QStringBuilder>
 #include <QTimer>
 
 using namespace QXmpp::Private;
@@ -61,21 +75,176 @@ void QXmppClientPrivate::addProperCapability(QXmppPresence &presence)
     if (ext) {
         presence.setCapabilityHash("sha-1");
         presence.setCapabilityNode(ext->clientCapabilitiesNode());
-        presence.setCapabilityVer(ext->capabilities().verificationString());
+        presence.setCapabilityVer(ext->capabilitiesVerificationString());
     }
 }
 
-int QXmppClientPrivate::getNextReconnectTime() const
+// Queues deferrable stanzas while the client is inactive.
+QXmppTask<QXmpp::SendResult> QXmppClientPrivate::sendOrDefer(QXmppStanza &stanza, const std::optional<QXmppSendStanzaParams> &params)
 {
-    if (reconnectionTries < 5) {
-        return 10 * 1000;
-    } else if (reconnectionTries < 10) {
-        return 20 * 1000;
-    } else if (reconnectionTries < 15) {
-        return 40 * 1000;
+    if (isActive || !params || !params->isDeferrable()) {
+        return stream->send(stanza);
+    }
+
+    QXmppPacket packet(stanza);
+    auto task = packet.task();
+    if (const auto *presence = dynamic_cast<const QXmppPresence *>(&stanza)) {
+        // an older presence to the same recipient is outdated
+        const auto to = presence->to();
+        for (auto itr = deferredPackets.begin(); itr != deferredPackets.end(); ++itr) {
+            if (itr->presenceTo == to) {
+                itr->packet.reportFinished(QXmpp::SendSuccess { false });
+                deferredPackets.erase(itr);
+                break;
+            }
+        }
+        deferredPackets.push_back({ std::move(packet), to });
     } else {
-        return 60 * 1000;
+        deferredPackets.push_back({ std::move(packet), {} });
+    }
+    return task;
+}
+
+QXmppTask<QXmpp::SendResult> QXmppClientPrivate::sendOrDefer(QXmppPacket &&packet, const std::optional<QXmppSendStanzaParams> &params)
+{
+    if (isActive || !params || !params->isDeferrable()) {
+        return stream->send(std::move(packet));
     }
+
+    auto task = packet.task();
+    deferredPackets.push_back({ std::move(packet), {} });
+    return task;
+}
+
+// Sends the queued stanzas at once, so the radio wakes up only once.
+void QXmppClientPrivate::sendDeferredPackets()
+{
+    for (auto &deferred : std::exchange(deferredPackets, {})) {
+        stream->send(std::move(deferred.packet));
+    }
+}
+
+// Whether the stanzas in the outbox wait for the connection. Without a
+// connection attempt they are passed to the stream right away like before,
+// which reports an error or queues them for stream management.
+bool QXmppClientPrivate::isOutboxHeld() const
+{
+    return !stream->isConnected() &&
+        (q->state() == QXmppClient::ConnectingState || reconnectionTimer->isActive());
+}
+
+QXmppTask<QXmpp::SendResult> QXmppClientPrivate::sendInOrder(QXmppStanza &stanza, const std::optional<QXmppSendStanzaParams> &params)
+{
+    QXMPP_TRACE_SPAN(span, "client", "send");
+    QXMPP_TRACE_STANZA(span, stanza.id(), QString());
+
+    if (outbox.empty() && !isOutboxHeld()) {
+        return sendOrDefer(stanza, params);
+    }
+
+    QXmppPacket packet(stanza);
+    auto task = packet.task();
+    outbox.push_back({ std::move(packet), params });
+    flushOutbox();
+    return task;
+}
+
+// Adds an entry for a stanza that is still being encrypted.
+quint64 QXmppClientPrivate::reserveOutboxEntry(const std::optional<QXmppSendStanzaParams> &params)
+{
+    outbox.push_back({ std::nullopt, params });
+    return outboxSequenceNumber + outbox.size() - 1;
+}
+
+void QXmppClientPrivate::setOutboxPacket(quint64 sequenceNumber, QXmppPacket &&packet)
+{
+    if (sequenceNumber < outboxSequenceNumber) {
+        // the outbox has been cleared in the meantime
+        packet.reportFinished(QXmppError { QStringLiteral("Disconnected"), QXmpp::SendError::Disconnected });
+        return;
+    }
+    outbox[sequenceNumber - outboxSequenceNumber].packet = std::move(packet);
+    flushOutbox();
+}
+
+void QXmppClientPrivate::discardOutboxEntry(quint64 sequenceNumber)
+{
+    if (sequenceNumber >= outboxSequenceNumber) {
+        outbox[sequenceNumber - outboxSequenceNumber].discarded = true;
+        flushOutbox();
+    }
+}
+
+// Writes the stanzas at the front of the outbox that are ready.
+void QXmppClientPrivate::flushOutbox()
+{
+    while (!outbox.empty() && (outbox.front().packet || outbox.front().discarded) && !isOutboxHeld()) {
+        auto entry = std::move(outbox.front());
+        outbox.pop_front();
+        outboxSequenceNumber++;
+        if (entry.packet) {
+            sendOrDefer(std::move(*entry.packet), entry.params);
+        }
+    }
+}
+
+// Drops the outbox, the stanzas being encrypted are dropped when they are ready.
+void QXmppClientPrivate::clearOutbox()
+{
+    for (auto &entry : outbox) {
+        if (entry.packet) {
+            entry.packet->reportFinished(QXmppError { QStringLiteral("Disconnected"), QXmpp::SendError::Disconnected });
+        }
+    }
+    outboxSequenceNumber += outbox.size();
+    outbox.clear();
+}
+
+// Exponential backoff with full jitter: the delay is random up to the base
+// delay doubled with each attempt, so clients that have lost their connection
+// at the same time don't reconnect at the same time.
+int QXmppClientPrivate::nextReconnectionDelay()
+{
+    const auto &config = stream->configuration();
+    const qint64 base = config.reconnectionBaseDelay();
+    const qint64 ceiling = std::min<qint64>(config.reconnectionMaximumDelay(), base << std::min(reconnectionTries, 20));
+    reconnectionTries++;
+    return int(QRandomGenerator::global()->bounded(ceiling + 1));
+}
+
+void QXmppClientPrivate::scheduleReconnection(int minimumDelay)
+{
+    reconnectionTimer->start(minimumDelay + nextReconnectionDelay());
+    watchNetworkReachability();
+}
+
+void QXmppClientPrivate::watchNetworkReachability()
+{
+#if QT_VERSION >= QT_VERSION_CHECK(6, 1, 0)
+    if (reachabilityConnection) {
+        return;
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(6, 3, 0)
+    QNetworkInformation::loadBackendByFeatures(QNetworkInformation::Feature::Reachability);
+#else
+    QNetworkInformation::load(QNetworkInformation::Feature::Reachability);
+#endif
+    if (auto *information = QNetworkInformation::instance()) {
+        reachabilityConnection = QObject::connect(information, &QNetworkInformation::reachabilityChanged, q, [this](QNetworkInformation::Reachability reachability) {
+            if (reachability == QNetworkInformation::Reachability::Online && reconnectionTimer->isActive()) {
+                reconnectionTimer->start(0);
+            }
+        });
+    }
+#endif
+}
+
+const ExtensionDispatchTable &QXmppClientPrivate::extensionDispatchTable()
+{
+    if (!dispatchTable.isValid()) {
+        dispatchTable.build(extensions);
+    }
+    return dispatchTable;
 }
 
 QStringList QXmppClientPrivate::discoveryFeatures()
@@ -117,19 +286,321 @@ QStringList QXmppClientPrivate::discoveryFeatures()
         ns_reactions,
     };
 }
+
+void ExtensionDispatchTable::build(const QList<QXmppClientExtension *> &extensions)
+{
+    clear();
+    m_extensions = extensions;
+
+    for (int i = 0; i < extensions.size(); i++) {
+        auto *extension = extensions.at(i);
+        const auto filters = extension->stanzaFilters();
+        if (filters.isEmpty()) {
+            m_wildcards.append(i);
+        }
+        for (const auto &filter : filters) {
+            auto &indices = filter.xmlns.isEmpty()
+                ? m_byTagName[filter.tagName]
+                : m_byNamespace[filter.tagName][filter.xmlns];
+            if (indices.isEmpty() || indices.constLast() != i) {
+                indices.append(i);
+            }
+        }
+
+        if (auto *messageHandler = dynamic_cast<QXmppMessageHandler *>(extension)) {
+            m_messageHandlers.append(messageHandler);
+        }
+    }
+    m_valid = true;
+}
+
+void ExtensionDispatchTable::clear()
+{
+    m_valid = false;
+    m_extensions.clear();
+    m_wildcards.clear();
+    m_byTagName.clear();
+    m_byNamespace.clear();
+    m_messageHandlers.clear();
+}
+
+static QString tagName(const QDomElement &element)
+{
+    return element.tagName();
+}
+
+static QString tagName(const QXmppStanzaView &element)
+{
+    return element.tagName().toString();
+}
+
+static QString namespaceUri(const QDomElement &element)
+{
+    return element.namespaceURI();
+}
+
+static QString namespaceUri(const QXmppStanzaView &element)
+{
+    return element.namespaceUri().toString();
+}
+
+template<typename Element>
+ExtensionDispatchTable::Extensions ExtensionDispatchTable::lookup(const Element &stanza) const
+{
+    QVarLengthArray<int, 32> indices;
+    const auto append = [&](const QVector<int> &values) {
+        for (const auto index : values) {
+            indices.append(index);
+        }
+    };
+
+    append(m_wildcards);
+    if (!m_byTagName.isEmpty() || !m_byNamespace.isEmpty()) {
+        const auto name = tagName(stanza);
+        append(m_byTagName.value(name));
+
+        const auto namespaces = m_byNamespace.constFind(name);
+        if (namespaces != m_byNamespace.constEnd()) {
+            for (auto child = stanza.firstChildElement(); !child.isNull(); child = child.nextSiblingElement()) {
+                append(namespaces->value(namespaceUri(child)));
+            }
+        }
+    }
+
+    // restore the registration order
+    if (indices.size() > m_wildcards.size()) {
+        std::sort(indices.begin(), indices.end());
+        indices.resize(std::unique(indices.begin(), indices.end()) - indices.begin());
+    }
+
+    Extensions extensions;
+    for (const auto index : std::as_const(indices)) {
+        extensions.append(m_extensions.at(index));
+    }
+    return extensions;
+}
+
+ExtensionDispatchTable::Extensions ExtensionDispatchTable::extensions(const QDomElement &stanza) const
+{
+    return lookup(stanza);
+}
+
+ExtensionDispatchTable::Extensions ExtensionDispatchTable::extensions(const QXmppStanzaView &stanza) const
+{
+    return lookup(stanza);
+}
+
+bool MessageDeduplicator::isDuplicate(const QXmppMessage &message, int capacity)
+{
+    if (capacity <= 0) {
+        if (!m_keys.empty()) {
+            m_keys.clear();
+            m_index.clear();
+        }
+        return false;
+    }
+
+    // Stanza IDs are only unique in the archive that assigned them, origin IDs only for the
+    // sender.
+    const auto stanzaId = message.stanzaId();
+    const auto originId = message.originId();
+    bool duplicate = false;
+    if (!stanzaId.isEmpty()) {
+        duplicate |= insert(u's' % message.stanzaIdBy() % u'\0' % stanzaId);
+    }
+    if (!originId.isEmpty()) {
+        duplicate |= insert(u'o' % message.from() % u'\0' % originId);
+    }
+
+    while (m_keys.size() > size_t(capacity)) {
+        m_index.remove(m_keys.back());
+        m_keys.pop_back();
+    }
+    return duplicate;
+}
+
+bool MessageDeduplicator::insert(const QString &key)
+{
+    if (const auto itr = m_index.constFind(key); itr != m_index.constEnd()) {
+        // mark as most recently seen
+        m_keys.splice(m_keys.begin(), m_keys, *itr);
+        return true;
+    }
+    m_keys.push_front(key);
+    m_index.insert(key, m_keys.begin());
+    return false;
+}
+
+// extension types of all clients of the process
+static QMutex &extensionTypesMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+static QHash<const QMetaObject *, std::shared_ptr<const ExtensionTypeInfo>> &extensionTypes()
+{
+    static QHash<const QMetaObject *, std::shared_ptr<const ExtensionTypeInfo>> types;
+    return types;
+}
+
+std::shared_ptr<const ExtensionTypeInfo> ExtensionTypeInfo::find(const QMetaObject *type)
+{
+    QMutexLocker locker(&extensionTypesMutex());
+    return extensionTypes().value(type);
+}
+
+std::shared_ptr<const ExtensionTypeInfo> ExtensionTypeInfo::store(const QMetaObject *type, const QXmppClientExtension *extension)
+{
+    auto info = std::make_shared<ExtensionTypeInfo>();
+    info->discoveryFeatures = extension->discoveryFeatures();
+    info->discoveryIdentities = extension->discoveryIdentities();
+    info->stanzaFilters = extension->stanzaFilters();
+    info->isMessageHandler = dynamic_cast<const QXmppMessageHandler *>(extension) != nullptr;
+
+    QMutexLocker locker(&extensionTypesMutex());
+    // another thread may have been faster
+    auto &stored = extensionTypes()[type];
+    if (!stored) {
+        stored = std::move(info);
+    }
+    return stored;
+}
+
+template<typename Element>
+static bool isNeededFor(const ExtensionTypeInfo &info, const Element &stanza, const QString &name)
+{
+    if (info.stanzaFilters.isEmpty() || (info.isMessageHandler && name == QLatin1String("message"))) {
+        return true;
+    }
+    for (const auto &filter : info.stanzaFilters) {
+        if (filter.tagName != name) {
+            continue;
+        }
+        if (filter.xmlns.isEmpty()) {
+            return true;
+        }
+        for (auto child = stanza.firstChildElement(); !child.isNull(); child = child.nextSiblingElement()) {
+            if (namespaceUri(child) == filter.xmlns) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+QXmppClientExtension *QXmppClientPrivate::createLazyExtension(size_t index)
+{
+    auto factory = std::move(lazyExtensions[index].factory);
+    lazyExtensions.erase(lazyExtensions.begin() + index);
+
+    auto *extension = factory();
+    q->addExtension(extension);
+    return extension;
+}
+
+// Creates the lazy extensions that need to see the stanza.
+template<typename Element>
+void QXmppClientPrivate::createLazyExtensions(const Element &stanza)
+{
+    if (lazyExtensions.empty()) {
+        return;
+    }
+    const auto name = tagName(stanza);
+    for (size_t i = 0; i < lazyExtensions.size();) {
+        if (isNeededFor(*lazyExtensions[i].info, stanza, name)) {
+            createLazyExtension(i);
+        } else {
+            i++;
+        }
+    }
+}
+
+void QXmppClientPrivate::createLazyMessageHandlers()
+{
+    for (size_t i = 0; i < lazyExtensions.size();) {
+        if (lazyExtensions[i].info->isMessageHandler) {
+            createLazyExtension(i);
+        } else {
+            i++;
+        }
+    }
+}
 /// \endcond
 
+namespace {
+
+// Calls a handler and times the call if slow handlers are reported, see
+// QXmppConfiguration::setSlowHandlerThreshold(). The stanza is only described
+// for the warning.
+template<typename Describe, typename Handle>
+bool callHandler(QXmppClient *client, int threshold, const QObject *handler, Describe &&describe, Handle &&handle)
+{
+    if (threshold <= 0) {
+        return handle();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const bool handled = handle();
+    const auto elapsed = timer.nsecsElapsed();
+
+    const auto name = handler ? QString::fromLatin1(handler->metaObject()->className()) : QStringLiteral("QXmppMessageHandler");
+    QXmppMetrics::observe(QXmppMetrics::ExtensionHandlingTime, name, elapsed);
+    if (elapsed > qint64(threshold) * 1'000'000) {
+        if (auto *logger = client->logger()) {
+            logger->log(QXmppLogger::WarningMessage,
+                        QStringLiteral("%1 took %2 ms to handle %3").arg(name, QString::number(elapsed / 1'000'000), describe()));
+        }
+    }
+    return handled;
+}
+
+template<typename Element>
+QString describeStanza(const Element &stanza)
+{
+    const auto payload = stanza.firstChildElement();
+    if (payload.isNull()) {
+        return tagName(stanza);
+    }
+    return tagName(stanza) + QStringLiteral(" (") + namespaceUri(payload) + QLatin1Char(')');
+}
+
+}  // namespace
+
 namespace QXmpp::Private::StanzaPipeline {
 
-bool process(const QList<QXmppClientExtension *> &extensions, const QDomElement &element, const std::optional<QXmppE2eeMetadata> &e2eeMetadata)
+bool process(QXmppClient *client, const ExtensionDispatchTable &table, const QDomElement &element, const std::optional<QXmppE2eeMetadata> &e2eeMetadata)
 {
     const bool unencrypted = !e2eeMetadata.has_value();
-    for (auto *extension : extensions) {
+    const auto threshold = client->configuration().slowHandlerThreshold();
+    for (auto *extension : table.extensions(element)) {
         // e2e encrypted stanzas are not passed to the old handleStanza() overload, because such
         // managers are likely not handling the encrypted contents correctly (e.g. sending
         // unencrypted replies and thereby leaking information).
-        if (extension->handleStanza(element, e2eeMetadata) ||
-            (unencrypted && extension->handleStanza(element))) {
+        const auto handled = callHandler(client, threshold, extension, [&] { return describeStanza(element); }, [&] {
+            return extension->handleStanza(element, e2eeMetadata) ||
+                (unencrypted && extension->handleStanza(element));
+        });
+        if (handled) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool process(QXmppClient *client, const ExtensionDispatchTable &table, const QXmppStanzaView &stanza)
+{
+    // Stanzas received from the stream are never end-to-end encrypted. The DOM
+    // is only created for the first extension that doesn't handle the view.
+    const auto threshold = client->configuration().slowHandlerThreshold();
+    for (auto *extension : table.extensions(stanza)) {
+        const auto handled = callHandler(client, threshold, extension, [&] { return describeStanza(stanza); }, [&] {
+            return extension->handleStanza(stanza) ||
+                extension->handleStanza(stanza.toDomElement(), std::nullopt) ||
+                extension->handleStanza(stanza.toDomElement());
+        });
+        if (handled) {
             return true;
         }
     }
@@ -140,30 +611,43 @@ bool process(const QList<QXmppClientExtension *> &extensions, const QDomElement
 
 namespace QXmpp::Private::MessagePipeline {
 
-bool process(QXmppClient *client, const QList<QXmppClientExtension *> &extensions, QXmppMessage &&message)
+bool process(QXmppClient *client, MessageDeduplicator &deduplicator, const QVector<QXmppMessageHandler *> &messageHandlers, QXmppMessage &&message)
 {
-    for (auto *extension : extensions) {
-        if (auto *messageHandler = dynamic_cast<QXmppMessageHandler *>(extension)) {
-            if (messageHandler->handleMessage(message)) {
-                return true;
-            }
+    // Decrypted messages are injected again, their IDs have been checked before decryption.
+    if (!message.e2eeMetadata() &&
+        deduplicator.isDuplicate(message, client->configuration().messageDeduplicationCacheSize())) {
+        return true;
+    }
+
+    const auto threshold = client->configuration().slowHandlerThreshold();
+    for (auto *messageHandler : messageHandlers) {
+        const auto handled = callHandler(client, threshold, dynamic_cast<const QObject *>(messageHandler), [] { return QStringLiteral("message"); }, [&] {
+            return messageHandler->handleMessage(message);
+        });
+        if (handled) {
+            return true;
         }
     }
     return false;
 }
 
-bool process(QXmppClient *client, const QList<QXmppClientExtension *> &extensions, QXmppE2eeExtension *e2eeExt, const QDomElement &element)
+bool process(QXmppClient *client, MessageDeduplicator &deduplicator, const QVector<QXmppMessageHandler *> &messageHandlers, QXmppE2eeExtension *e2eeExt, const QDomElement &element)
 {
     if (element.tagName() != "message") {
         return false;
     }
     QXmppMessage message;
+    auto sceMode = SceAll;
     if (e2eeExt) {
-        message.parse(element, e2eeExt->isEncrypted(element) ? ScePublic : SceSensitive);
+        sceMode = e2eeExt->isEncrypted(element) ? ScePublic : SceSensitive;
+    }
+
+    if (const auto namespaces = client->configuration().parsedMessageNamespaces(); !namespaces.isEmpty()) {
+        message.parse(element, sceMode, namespaces);
     } else {
-        message.parse(element);
+        message.parse(element, sceMode);
     }
-    return process(client, extensions, std::move(message));
+    return process(client, deduplicator, messageHandlers, std::move(message));
 }
 
 }  // namespace QXmpp::Private::MessagePipeline
@@ -201,10 +685,9 @@ QXmppClient::QXmppClient(InitialExtensions initialExtensions, QObject *parent)
       d(new QXmppClientPrivate(this))
 {
     d->stream = new QXmppOutgoingClient(this);
-    d->addProperCapability(d->clientPresence);
 
-    connect(d->stream, &QXmppOutgoingClient::elementReceived,
-            this, &QXmppClient::_q_elementReceived);
+    connect(d->stream, &QXmppOutgoingClient::stanzaReceived,
+            this, &QXmppClient::_q_stanzaReceived);
 
     connect(d->stream, &QXmppOutgoingClient::messageReceived,
             this, &QXmppClient::messageReceived);
@@ -247,9 +730,10 @@ QXmppClient::QXmppClient(InitialExtensions initialExtensions, QObject *parent)
         break;
     case BasicExtensions:
         addNewExtension<QXmppRosterManager>(this);
-        addNewExtension<QXmppVCardManager>();
-        addNewExtension<QXmppVersionManager>();
-        addNewExtension<QXmppEntityTimeManager>();
+        // only handle requests, so they are created when needed
+        addLazyExtension<QXmppVCardManager>();
+        addLazyExtension<QXmppVersionManager>();
+        addLazyExtension<QXmppEntityTimeManager>();
         addNewExtension<QXmppDiscoveryManager>();
         break;
     }
@@ -300,9 +784,34 @@ bool QXmppClient::insertExtension(int index, QXmppClientExtension *extension)
     extension->setParent(this);
     extension->setClient(this);
     d->extensions.insert(index, extension);
+    d->dispatchTable.clear();
+    d->extensionsGeneration++;
     return true;
 }
 
+void QXmppClient::registerLazyExtension(const QMetaObject *type, std::function<QXmppClientExtension *()> &&factory)
+{
+    if (auto info = ExtensionTypeInfo::find(type)) {
+        d->lazyExtensions.push_back({ type, std::move(factory), std::move(info) });
+        return;
+    }
+
+    // the first instance tells what the type needs
+    auto *extension = factory();
+    addExtension(extension);
+    ExtensionTypeInfo::store(type, extension);
+}
+
+QXmppClientExtension *QXmppClient::createLazyExtension(const QMetaObject *type)
+{
+    for (size_t i = 0; i < d->lazyExtensions.size(); i++) {
+        if (d->lazyExtensions[i].type->inherits(type)) {
+            return d->createLazyExtension(i);
+        }
+    }
+    return nullptr;
+}
+
 /// Unregisters the given extension from the client. If the extension
 /// is found, it will be destroyed.
 ///
@@ -312,6 +821,8 @@ bool QXmppClient::removeExtension(QXmppClientExtension *extension)
 {
     if (d->extensions.contains(extension)) {
         d->extensions.removeAll(extension);
+        d->dispatchTable.clear();
+        d->extensionsGeneration++;
         delete extension;
         return true;
     } else {
@@ -342,6 +853,9 @@ void QXmppClient::setEncryptionExtension(QXmppE2eeExtension *extension)
 
 /// Returns a list containing all the client's extensions.
 ///
+/// Extensions added with addLazyExtension() are only included once they have
+/// been created.
+///
 
 QList<QXmppClientExtension *> QXmppClient::extensions()
 {
@@ -356,6 +870,74 @@ QXmppConfiguration &QXmppClient::configuration()
     return d->stream->configuration();
 }
 
+///
+/// Returns the storage of the credentials used for \xep{0484, Fast
+/// Authentication Streamlining Tokens}.
+///
+/// \since QXmpp 1.6
+///
+QXmppCredentialsStorage *QXmppClient::credentialsStorage() const
+{
+    return d->stream->credentialsStorage();
+}
+
+///
+/// Sets the storage of the credentials used for \xep{0484, Fast
+/// Authentication Streamlining Tokens}.
+///
+/// By default, the credentials are kept in the memory, which speeds up
+/// reconnects. A persistent storage also speeds up the first login after the
+/// application has been restarted. The storage is not owned by the client.
+///
+/// \param storage storage to use, nullptr resets to the default memory storage
+///
+/// \since QXmpp 1.6
+///
+void QXmppClient::setCredentialsStorage(QXmppCredentialsStorage *storage)
+{
+    d->stream->setCredentialsStorage(storage);
+}
+
+///
+/// Returns the state needed to resume the current stream from another process
+/// using \xep{0198, Stream Management}.
+///
+/// Mobile applications are often terminated by the operating system while
+/// they are in the background. Save the state when the application is
+/// suspended and pass it to setStreamResumptionState() after it has been
+/// restarted. The next connectToServer() with the same account then resumes
+/// the stream instead of starting a new session: the stanzas that have not
+/// been acknowledged are delivered and the server doesn't send all presences
+/// again. Managers request data they don't have, e.g. the roster if it isn't
+/// kept in a persistent QXmppRosterStorage.
+///
+/// \return the serialized state or an empty byte array if the stream can't be
+/// resumed
+///
+/// \since QXmpp 1.6
+///
+QByteArray QXmppClient::streamResumptionState() const
+{
+    return d->stream->streamResumptionState();
+}
+
+///
+/// Restores the state returned by streamResumptionState() of a previous
+/// process.
+///
+/// This needs to be called before connectToServer(). If the server can't
+/// resume the stream anymore, a new session is started and the restored
+/// unacknowledged stanzas are sent again.
+///
+/// \return whether the state could be read
+///
+/// \since QXmpp 1.6
+///
+bool QXmppClient::setStreamResumptionState(const QByteArray &state)
+{
+    return d->stream->setStreamResumptionState(state);
+}
+
 ///
 /// Attempts to connect to the XMPP server. Server details and other configurations
 /// are specified using the config parameter. Use signals connected(), error(QXmppClient::Error)
@@ -369,12 +951,22 @@ QXmppConfiguration &QXmppClient::configuration()
 void QXmppClient::connectToServer(const QXmppConfiguration &config,
                                   const QXmppPresence &initialPresence)
 {
-    // reset package cache from last connection
+    // reset package cache and token from last connection
     if (d->stream->configuration().jidBare() != config.jidBare()) {
+        d->clearOutbox();
         d->stream->resetPacketCache();
+        d->stream->credentialsStorage()->removeFastToken();
     }
 
+    // keep the TLS session of the last connection to the same server
+    const auto tlsSessionTicket = d->stream->configuration().domain() == config.domain()
+        ? d->stream->configuration().tlsSessionTicket()
+        : QByteArray();
+
     d->stream->configuration() = config;
+    if (config.tlsSessionTicket().isEmpty()) {
+        d->stream->configuration().setTlsSessionTicket(tlsSessionTicket);
+    }
     d->clientPresence = initialPresence;
     d->addProperCapability(d->clientPresence);
 
@@ -401,7 +993,9 @@ void QXmppClient::connectToServer(const QString &jid, const QString &password)
 /// QXmppMessage, QXmppPresence, QXmppIq, QXmppBind, QXmppRosterIq, QXmppSession
 /// and QXmppVCard.
 ///
-/// This function does not end-to-end encrypt the packets.
+/// This function does not end-to-end encrypt the packets. The packet is
+/// written right away, also if stanzas sent with send() or sendSensitive()
+/// are still waiting. Use send() to keep the order.
 ///
 /// \return Returns true if the packet was sent, false otherwise.
 ///
@@ -428,6 +1022,12 @@ bool QXmppClient::sendPacket(const QXmppNonza &packet)
 /// If connection errors occur, the packet is resent if possible. If
 /// reconnecting is not possible, an error is reported.
 ///
+/// Stanzas sent with send() and sendSensitive() are written in the order of
+/// the calls. Stanzas are encrypted concurrently, but an encrypted stanza is
+/// only written after the stanzas sent before it. While the client is
+/// connecting or waiting to reconnect, the stanzas are queued and written at
+/// once when the connection has been established.
+///
 /// \warning THIS API IS NOT FINALIZED YET!
 ///
 /// \returns A QXmppTask that makes it possible to track the state of the packet.
@@ -436,21 +1036,25 @@ bool QXmppClient::sendPacket(const QXmppNonza &packet)
 ///
 QXmppTask<QXmpp::SendResult> QXmppClient::sendSensitive(QXmppStanza &&stanza, const std::optional<QXmppSendStanzaParams> &params)
 {
-    const auto sendEncrypted = [this](auto &&task) {
+    const auto sendEncrypted = [this, params](auto &&task, QXmpp::Private::TraceSpan &&span) {
         QXmppPromise<QXmpp::SendResult> interface;
-        task.then(this, [this, interface](auto &&result) mutable {
+        // the place in the outbox is taken before the encryption finishes
+        const auto sequenceNumber = d->reserveOutboxEntry(params);
+        task.then(this, [this, interface, sequenceNumber, span = std::move(span)](auto &&result) mutable {
+            QXMPP_TRACE_END(span);
             std::visit(overloaded {
                            [&](std::unique_ptr<QXmppMessage> &&message) {
                                QByteArray xml;
                                QXmlStreamWriter writer(&xml);
                                message->toXml(&writer, QXmpp::ScePublic);
 
-                               d->stream->send(QXmppPacket(xml, true, std::move(interface)));
+                               d->setOutboxPacket(sequenceNumber, QXmppPacket(xml, true, std::move(interface)));
                            },
                            [&](std::unique_ptr<QXmppIq> &&iq) {
-                               d->stream->send(QXmppPacket(*iq, std::move(interface)));
+                               d->setOutboxPacket(sequenceNumber, QXmppPacket(*iq, std::move(interface)));
                            },
                            [&](QXmppError &&error) {
+                               d->discardOutboxEntry(sequenceNumber);
                                interface.finish(std::move(error));
                            } },
                        std::move(result));
@@ -461,23 +1065,30 @@ QXmppTask<QXmpp::SendResult> QXmppClient::sendSensitive(QXmppStanza &&stanza, co
 
     if (d->encryptionExtension) {
         if (dynamic_cast<QXmppMessage *>(&stanza)) {
+            QXMPP_TRACE_ASYNC_SPAN(span, "client", "encrypt");
+            QXMPP_TRACE_STANZA(span, stanza.id(), QStringLiteral("message"));
             return sendEncrypted(
                 d->encryptionExtension->encryptMessage(
-                    std::move(dynamic_cast<QXmppMessage &&>(stanza)), params));
+                    std::move(dynamic_cast<QXmppMessage &&>(stanza)), params),
+                std::move(span));
         } else if (dynamic_cast<QXmppIq *>(&stanza)) {
+            QXMPP_TRACE_ASYNC_SPAN(span, "client", "encrypt");
+            QXMPP_TRACE_STANZA(span, stanza.id(), QStringLiteral("iq"));
             return sendEncrypted(
                 d->encryptionExtension->encryptIq(
-                    std::move(dynamic_cast<QXmppIq &&>(stanza)), params));
+                    std::move(dynamic_cast<QXmppIq &&>(stanza)), params),
+                std::move(span));
         }
     }
-    return d->stream->send(stanza);
+    return d->sendInOrder(stanza, params);
 }
 
 ///
 /// Sends a packet always without end-to-end-encryption.
 ///
-/// This does the same as send(), but does not do any end-to-end encryption on
-/// the stanza.
+/// This does the same as sendSensitive(), but does not do any end-to-end
+/// encryption on the stanza. The stanza keeps its place in the order of the
+/// stanzas sent with send() and sendSensitive().
 ///
 /// \warning THIS API IS NOT FINALIZED YET!
 ///
@@ -485,9 +1096,9 @@ QXmppTask<QXmpp::SendResult> QXmppClient::sendSensitive(QXmppStanza &&stanza, co
 ///
 /// \since QXmpp 1.5
 ///
-QXmppTask<QXmpp::SendResult> QXmppClient::send(QXmppStanza &&stanza, const std::optional<QXmppSendStanzaParams> &)
+QXmppTask<QXmpp::SendResult> QXmppClient::send(QXmppStanza &&stanza, const std::optional<QXmppSendStanzaParams> &params)
 {
-    return d->stream->send(stanza);
+    return d->sendInOrder(stanza, params);
 }
 
 ///
@@ -548,10 +1159,15 @@ QXmppTask<QXmppClient::IqResult> QXmppClient::sendSensitiveIq(QXmppIq &&iq, cons
         QXmppPromise<IqResult> p;
         auto task = p.task();
         d->encryptionExtension->encryptIq(std::move(iq), params).then(this, [this, p = std::move(p)](IqEncryptResult result) mutable {
+            if (p.isCancelled()) {
+                return;
+            }
             std::visit(overloaded {
                            [&](std::unique_ptr<QXmppIq> &&iq) {
                                // success (encrypted)
-                               d->stream->sendIq(std::move(*iq)).then(this, [this, p = std::move(p)](auto &&result) mutable {
+                               auto sendTask = d->stream->sendIq(std::move(*iq));
+                               p.forwardCancellation(sendTask);
+                               sendTask.then(this, [this, p = std::move(p)](auto &&result) mutable {
                                    // iq sent, response received
                                    std::visit(overloaded {
                                                   [&](QDomElement &&el) {
@@ -676,6 +1292,12 @@ bool QXmppClient::isActive() const
 ///
 /// Sets the client state as described in \xep{0352}: Client State Indication.
 ///
+/// While inactive, keep alive pings are sent with the
+/// QXmppConfiguration::inactiveKeepAliveInterval() and stream management
+/// acknowledgements are requested less often. Stanzas sent with
+/// QXmppSendStanzaParams::isDeferrable() are queued and sent together when
+/// the client becomes active again.
+///
 /// On connect this is always reset to true.
 ///
 /// \since QXmpp 1.0
@@ -684,8 +1306,13 @@ void QXmppClient::setActive(bool active)
 {
     if (active != d->isActive && isConnected() && d->stream->isClientStateIndicationEnabled()) {
         d->isActive = active;
+        d->stream->setClientActive(active);
         QString packet = "<%1 xmlns='%2'/>";
-        d->stream->sendData(packet.arg(active ? "active" : "inactive", ns_csi).toUtf8());
+        d->stream->sendData(packet.arg(active ? QStringLiteral("active") : QStringLiteral("inactive"), ns_csi).toUtf8());
+
+        if (active) {
+            d->sendDeferredPackets();
+        }
     }
 }
 
@@ -860,7 +1487,8 @@ void QXmppClient::injectIq(const QDomElement &element, const std::optional<QXmpp
     if (element.tagName() != "iq") {
         return;
     }
-    if (!StanzaPipeline::process(d->extensions, element, e2eeMetadata)) {
+    d->createLazyExtensions(element);
+    if (!StanzaPipeline::process(this, d->extensionDispatchTable(), element, e2eeMetadata)) {
         const auto iqType = element.attribute("type");
         if (iqType == "get" || iqType == "set") {
             // send error IQ
@@ -884,7 +1512,11 @@ void QXmppClient::injectIq(const QDomElement &element, const std::optional<QXmpp
 ///
 bool QXmppClient::injectMessage(QXmppMessage &&message)
 {
-    auto handled = MessagePipeline::process(this, d->extensions, std::move(message));
+    QXMPP_TRACE_SPAN(span, "client", "inject");
+    QXMPP_TRACE_STANZA(span, message.id(), QStringLiteral("message"));
+
+    d->createLazyMessageHandlers();
+    auto handled = MessagePipeline::process(this, d->messageDeduplicator, d->extensionDispatchTable().messageHandlers(), std::move(message));
     if (!handled) {
         // no extension handled the message
         Q_EMIT messageReceived(message);
@@ -895,12 +1527,17 @@ bool QXmppClient::injectMessage(QXmppMessage &&message)
 ///
 /// Give extensions a chance to handle incoming stanzas.
 ///
-void QXmppClient::_q_elementReceived(const QDomElement &element, bool &handled)
+void QXmppClient::_q_stanzaReceived(const QXmppStanzaView &stanza, bool &handled)
 {
     // The stanza comes directly from the XMPP stream, so it's not end-to-end
-    // encrypted and there's no e2ee metadata (std::nullopt).
-    handled = StanzaPipeline::process(d->extensions, element, std::nullopt) ||
-        MessagePipeline::process(this, d->extensions, d->encryptionExtension, element);
+    // encrypted and there's no e2ee metadata.
+    QXMPP_TRACE_SPAN(span, "client", "extensions");
+
+    d->createLazyExtensions(stanza);
+    const auto &table = d->extensionDispatchTable();
+    handled = StanzaPipeline::process(this, table, stanza) ||
+        (stanza.tagName() == u"message" &&
+         MessagePipeline::process(this, d->messageDeduplicator, table.messageHandlers(), d->encryptionExtension, stanza.toDomElement()));
 }
 
 void QXmppClient::_q_reconnect()
@@ -933,6 +1570,12 @@ void QXmppClient::_q_streamConnected()
     if (d->stream->isAuthenticated()) {
         sendPacket(d->clientPresence);
     }
+
+    // the new stream is active
+    d->sendDeferredPackets();
+
+    // stanzas sent while connecting
+    d->flushOutbox();
 }
 
 void QXmppClient::_q_streamDisconnected()
@@ -950,12 +1593,17 @@ void QXmppClient::_q_streamError(QXmppClient::Error err)
             if (d->stream->xmppStreamError() == QXmppStanza::Error::Conflict) {
                 d->receivedConflict = true;
             }
+            // the server is restarting or overloaded, it may have told how
+            // long to wait
+            if (const auto delay = d->stream->streamErrorRetryDelay(); delay >= 0 && !d->receivedConflict) {
+                d->scheduleReconnection(delay);
+            }
         } else if (err == QXmppClient::SocketError && !d->receivedConflict) {
             // schedule reconnect
-            d->reconnectionTimer->start(d->getNextReconnectTime());
+            d->scheduleReconnection(0);
         } else if (err == QXmppClient::KeepAliveError) {
-            // if we got a keepalive error, reconnect in one second
-            d->reconnectionTimer->start(1000);
+            // the server may have gone down for all clients
+            d->scheduleReconnection(0);
         }
     }
 
@@ -974,8 +1622,6 @@ void QXmppClient::setLogger(QXmppLogger *logger)
 {
     if (logger != d->logger) {
         if (d->logger) {
-            disconnect(this, &QXmppLoggable::logMessage,
-                       d->logger, &QXmppLogger::log);
             disconnect(this, &QXmppLoggable::setGauge,
                        d->logger, &QXmppLogger::setGauge);
             disconnect(this, &QXmppLoggable::updateCounter,
@@ -983,9 +1629,9 @@ void QXmppClient::setLogger(QXmppLogger *logger)
         }
 
         d->logger = logger;
+        // log messages are passed directly, also from the extensions
+        setLogSink(d->logger);
         if (d->logger) {
-            connect(this, &QXmppLoggable::logMessage,
-                    d->logger, &QXmppLogger::log);
             connect(this, &QXmppLoggable::setGauge,
                     d->logger, &QXmppLogger::setGauge);
             connect(this, &QXmppLoggable::updateCounter,
@@ -11,6 +11,7 @@
 #include "QXmppSendResult.h"
 #include "QXmppSendStanzaParams.h"
 
+#include <functional>
 #include <memory>
 #include <variant>
 
@@ -24,9 +25,11 @@ class QXmppTask;
 class QXmppE2eeExtension;
 class QXmppClientExtension;
 class QXmppClientPrivate;
+class QXmppCredentialsStorage;
 class QXmppPresence;
 class QXmppMessage;
 class QXmppIq;
+class QXmppStanzaView;
 class QXmppStream;
 class QXmppInternalClientExtension;
 
@@ -143,6 +146,30 @@ public:
         addExtension(ext);
         return ext;
     }
+    ///
+    /// Registers an extension that is only created when it is needed.
+    ///
+    /// The extension is created with the given arguments on the first call to
+    /// findExtension() for its type or when the first stanza matching its
+    /// QXmppClientExtension::stanzaFilters() is received. Until then,
+    /// QXmppDiscoveryManager advertises its features and it is not part of
+    /// extensions(). This saves time and memory for applications creating
+    /// many clients, e.g. bots.
+    ///
+    /// The features and stanza filters of an extension type are taken from
+    /// the first instance in the process, so the first client registering a
+    /// type creates it right away. Extensions that must react to signals of
+    /// the client, like QXmppRosterManager, should not be added lazily.
+    ///
+    /// \since QXmpp 1.6
+    ///
+    template<typename T, typename... Args>
+    void addLazyExtension(Args... args)
+    {
+        registerLazyExtension(&T::staticMetaObject, [=]() -> QXmppClientExtension * {
+            return new T(args...);
+        });
+    }
     bool insertExtension(int index, QXmppClientExtension *extension);
     bool removeExtension(QXmppClientExtension *extension);
     QXmppE2eeExtension *encryptionExtension() const;
@@ -173,12 +200,15 @@ public:
                 return extension;
             }
         }
-        return nullptr;
+        return qobject_cast<T *>(createLazyExtension(&T::staticMetaObject));
     }
 
     ///
     /// \brief Returns the index of an extension
     ///
+    /// Extensions added with addLazyExtension() have no index until they have
+    /// been created.
+    ///
     /// Usage example:
     /// \code
     /// int index = client->indexOfExtension<QXmppDiscoveryManager>();
@@ -216,6 +246,12 @@ public:
 
     QXmppConfiguration &configuration();
 
+    QXmppCredentialsStorage *credentialsStorage() const;
+    void setCredentialsStorage(QXmppCredentialsStorage *storage);
+
+    QByteArray streamResumptionState() const;
+    bool setStreamResumptionState(const QByteArray &state);
+
     // documentation needs to be here, see https://stackoverflow.com/questions/49192523/
     /// Returns the QXmppLogger associated with the current QXmppClient.
     QXmppLogger *logger() const;
@@ -326,7 +362,7 @@ private:
     bool injectMessage(QXmppMessage &&message);
 
 private Q_SLOTS:
-    void _q_elementReceived(const QDomElement &element, bool &handled);
+    void _q_stanzaReceived(const QXmppStanzaView &stanza, bool &handled);
     void _q_reconnect();
     void _q_socketStateChanged(QAbstractSocket::SocketState state);
     void _q_streamConnected();
@@ -334,9 +370,13 @@ private Q_SLOTS:
     void _q_streamError(QXmppClient::Error error);
 
 private:
+    void registerLazyExtension(const QMetaObject *type, std::function<QXmppClientExtension *()> &&factory);
+    QXmppClientExtension *createLazyExtension(const QMetaObject *type);
+
     const std::unique_ptr<QXmppClientPrivate> d;
 
     friend class QXmppClientExtension;
+    friend class QXmppDiscoveryManager;
     friend class QXmppInternalClientExtension;
     friend class TestClient;
 };
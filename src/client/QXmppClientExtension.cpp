@@ -5,6 +5,7 @@
 #include "QXmppClientExtension.h"
 
 #include "QXmppClient.h"
+#include "QXmppClient_p.h"
 
 ///
 /// Constructs a QXmppClient extension.
@@ -19,6 +20,9 @@ QXmppClientExtension::~QXmppClientExtension() = default;
 ///
 /// Returns the discovery features to add to the client.
 ///
+/// The features are cached by QXmppDiscoveryManager, so
+/// invalidateDiscoveryInfo() needs to be called when they change.
+///
 QStringList QXmppClientExtension::discoveryFeatures() const
 {
     return QStringList();
@@ -32,6 +36,28 @@ QList<QXmppDiscoveryIq::Identity> QXmppClientExtension::discoveryIdentities() co
     return QList<QXmppDiscoveryIq::Identity>();
 }
 
+///
+/// Returns the stanzas the extension handles.
+///
+/// The client only passes stanzas matching one of the filters to the
+/// handleStanza() methods of the extension. This allows the client to skip the
+/// extension for all other stanzas without any virtual calls. The order in
+/// which the extensions are asked to handle a stanza is not affected.
+///
+/// The default implementation returns an empty list, which means that the
+/// extension receives all stanzas.
+///
+/// \note The filters are only queried when the extension is added to the
+/// client or when another extension is added or removed, so they must not
+/// change afterwards.
+///
+/// \since QXmpp 1.6
+///
+QVector<QXmppClientExtension::StanzaFilter> QXmppClientExtension::stanzaFilters() const
+{
+    return {};
+}
+
 ///
 /// \brief You need to implement this method to process incoming XMPP
 /// stanzas.
@@ -72,6 +98,26 @@ bool QXmppClientExtension::handleStanza(const QDomElement &, const std::optional
     return false;
 }
 
+///
+/// Processes an incoming stanza without a DOM.
+///
+/// This overload is called before the QDomElement overloads for stanzas
+/// received directly from the stream (those are never end-to-end encrypted).
+/// Extensions that can decide cheaply whether a stanza is relevant for them,
+/// e.g. by looking at the tag name and namespaces only, can implement it to
+/// avoid the creation of a DOM for stanzas they don't handle.
+///
+/// \return You should return true if the stanza was handled and no further
+/// processing should occur, or false to let the QDomElement overloads and other
+/// extensions process the stanza.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppClientExtension::handleStanza(const QXmppStanzaView &)
+{
+    return false;
+}
+
 ///
 /// Returns the client which loaded this extension.
 ///
@@ -118,3 +164,16 @@ bool QXmppClientExtension::injectMessage(QXmppMessage &&message)
 {
     return client()->injectMessage(std::move(message));
 }
+
+///
+/// Tells the client that discoveryFeatures() or discoveryIdentities() of the
+/// extension have changed, so the cached capabilities are recomputed.
+///
+/// \since QXmpp 1.6
+///
+void QXmppClientExtension::invalidateDiscoveryInfo()
+{
+    if (m_client) {
+        m_client->d->extensionsGeneration++;
+    }
+}
@@ -11,11 +11,14 @@
 
 #include <memory>
 
+#include <QVector>
+
 class QDomElement;
 
 class QXmppClient;
 class QXmppClientExtensionPrivate;
 class QXmppMessage;
+class QXmppStanzaView;
 class QXmppStream;
 
 ///
@@ -34,14 +37,33 @@ class QXMPP_EXPORT QXmppClientExtension : public QXmppLoggable, public QXmppExte
     Q_OBJECT
 
 public:
+    ///
+    /// Describes the stanzas an extension is interested in.
+    ///
+    /// A stanza matches if its tag name equals \c tagName and one of its direct
+    /// child elements is in the namespace \c xmlns. An empty \c xmlns matches
+    /// all stanzas with the tag name.
+    ///
+    /// \since QXmpp 1.6
+    ///
+    struct StanzaFilter
+    {
+        /// Tag name of the stanza, e.g. "iq" or "message"
+        QString tagName;
+        /// Namespace of a direct child element of the stanza
+        QString xmlns;
+    };
+
     QXmppClientExtension();
     ~QXmppClientExtension() override;
 
     virtual QStringList discoveryFeatures() const;
     virtual QList<QXmppDiscoveryIq::Identity> discoveryIdentities() const;
+    virtual QVector<StanzaFilter> stanzaFilters() const;
 
     virtual bool handleStanza(const QDomElement &stanza);
     virtual bool handleStanza(const QDomElement &stanza, const std::optional<QXmppE2eeMetadata> &e2eeMetadata);
+    virtual bool handleStanza(const QXmppStanzaView &stanza);
 
 protected:
     QXmppClient *client();
@@ -50,6 +72,8 @@ protected:
     void injectIq(const QDomElement &element, const std::optional<QXmppE2eeMetadata> &e2eeMetadata);
     bool injectMessage(QXmppMessage &&message);
 
+    void invalidateDiscoveryInfo();
+
 private:
     // m_client can be replaced with a d-ptr if needed (same size)
     QXmppClient *m_client;
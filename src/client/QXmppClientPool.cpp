@@ -0,0 +1,236 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppClientPool.h"
+
+#include "QXmppCapabilitiesMemoryStorage.h"
+#include "QXmppClient.h"
+#include "QXmppConfiguration.h"
+#include "QXmppDiscoveryManager.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <QHash>
+#include <QMutex>
+#include <QNetworkAccessManager>
+#include <QThread>
+
+struct QXmppClientPoolWorker
+{
+    QThread thread;
+    // shared by the clients of the thread
+    QNetworkAccessManager *networkManager = nullptr;
+    int clientCount = 0;
+};
+
+class QXmppClientPoolPrivate
+{
+public:
+    std::vector<std::unique_ptr<QXmppClientPoolWorker>> workers;
+    QHash<QXmppClient *, QXmppClientPoolWorker *> clients;
+    QXmppCapabilitiesMemoryStorage capabilitiesStorage;
+
+    // TLS session tickets by server domain, stored from the worker threads
+    QMutex tlsSessionTicketsMutex;
+    QHash<QString, QByteArray> tlsSessionTickets;
+};
+
+///
+/// \class QXmppClientPool
+///
+/// \brief The QXmppClientPool class runs many clients on a fixed number of
+/// worker threads and lets them share resources.
+///
+/// This is meant for processes with many accounts, e.g. bots or load tests.
+/// The clients are distributed evenly over the threads and share:
+///  - the \xep{0115, Entity Capabilities} cache of their QXmppDiscoveryManager
+///  - one QNetworkAccessManager per thread, see networkAccessManager()
+///  - the TLS session tickets of each server, if TLS session resumption is
+///    enabled
+///
+/// DNS SRV lookups are cached process-wide in any case.
+///
+/// The clients should be created with QXmppClient::NoExtensions and only the
+/// extensions that are needed, so no memory is spent on unused managers.
+/// After addClient(), a client lives in a worker thread and must only be used
+/// from there, e.g. using QMetaObject::invokeMethod():
+/// \code
+/// QXmppClientPool pool;
+///
+/// auto *client = new QXmppClient(QXmppClient::NoExtensions);
+/// client->addNewExtension<QXmppDiscoveryManager>();
+/// pool.addClient(client);
+///
+/// QMetaObject::invokeMethod(client, [&pool, client] {
+///     client->addNewExtension<QXmppHttpUploadManager>(pool.networkAccessManager(client));
+/// });
+/// pool.connectToServer(client, config);
+/// \endcode
+///
+/// The functions of the pool itself must only be called from the thread it
+/// lives in.
+///
+/// \since QXmpp 1.6
+///
+/// \ingroup Core
+///
+
+///
+/// Constructs a client pool and starts its worker threads.
+///
+/// \param threadCount number of worker threads, QThread::idealThreadCount() if
+/// 0 or less
+/// \param parent
+///
+QXmppClientPool::QXmppClientPool(int threadCount, QObject *parent)
+    : QObject(parent),
+      d(std::make_unique<QXmppClientPoolPrivate>())
+{
+    if (threadCount <= 0) {
+        threadCount = std::max(1, QThread::idealThreadCount());
+    }
+
+    d->workers.reserve(threadCount);
+    for (int i = 0; i < threadCount; i++) {
+        auto worker = std::make_unique<QXmppClientPoolWorker>();
+        worker->thread.setObjectName(QStringLiteral("QXmppClientPool %1").arg(i));
+        worker->networkManager = new QNetworkAccessManager();
+        worker->networkManager->moveToThread(&worker->thread);
+        worker->thread.start();
+        d->workers.push_back(std::move(worker));
+    }
+}
+
+///
+/// Deletes all clients and stops the worker threads.
+///
+QXmppClientPool::~QXmppClientPool()
+{
+    // objects living in the worker threads are deleted when their thread has finished
+    for (auto itr = d->clients.cbegin(); itr != d->clients.cend(); ++itr) {
+        itr.key()->deleteLater();
+    }
+    for (const auto &worker : d->workers) {
+        worker->networkManager->deleteLater();
+        worker->thread.quit();
+    }
+    for (const auto &worker : d->workers) {
+        worker->thread.wait();
+    }
+}
+
+///
+/// Returns the number of worker threads.
+///
+int QXmppClientPool::threadCount() const
+{
+    return int(d->workers.size());
+}
+
+///
+/// Returns the number of clients in the pool.
+///
+int QXmppClientPool::clientCount() const
+{
+    return int(d->clients.size());
+}
+
+///
+/// Adds a client and moves it to the worker thread with the fewest clients.
+///
+/// The client must not have a parent and must live in the calling thread. The
+/// pool takes ownership of it. If the client has a QXmppDiscoveryManager, it
+/// is set up to use the shared capabilitiesStorage().
+///
+void QXmppClientPool::addClient(QXmppClient *client)
+{
+    Q_ASSERT(!client->parent());
+    if (d->clients.contains(client)) {
+        return;
+    }
+
+    auto *worker = std::min_element(d->workers.cbegin(), d->workers.cend(), [](const auto &a, const auto &b) {
+                       return a->clientCount < b->clientCount;
+                   })->get();
+    worker->clientCount++;
+    d->clients.insert(client, worker);
+
+    if (auto *discoveryManager = client->findExtension<QXmppDiscoveryManager>()) {
+        discoveryManager->setCapabilitiesStorage(&d->capabilitiesStorage);
+    }
+
+    // the tickets are received during connecting and may be renewed later
+    auto storeTicket = [this, client] {
+        const auto &config = client->configuration();
+        if (config.isTlsSessionResumptionEnabled() && !config.tlsSessionTicket().isEmpty()) {
+            storeTlsSessionTicket(config.domain(), config.tlsSessionTicket());
+        }
+    };
+    connect(client, &QXmppClient::connected, client, storeTicket);
+    connect(client, &QXmppClient::disconnected, client, storeTicket);
+
+    client->moveToThread(&worker->thread);
+}
+
+///
+/// Removes a client from the pool and deletes it.
+///
+void QXmppClientPool::removeClient(QXmppClient *client)
+{
+    if (auto *worker = d->clients.take(client)) {
+        worker->clientCount--;
+        client->deleteLater();
+    }
+}
+
+///
+/// Connects a client of the pool to its server.
+///
+/// If TLS session resumption is enabled and the configuration contains no
+/// session ticket, the last ticket of another client connected to the same
+/// server is used.
+///
+void QXmppClientPool::connectToServer(QXmppClient *client, const QXmppConfiguration &config)
+{
+    auto configuration = config;
+    if (configuration.isTlsSessionResumptionEnabled() && configuration.tlsSessionTicket().isEmpty()) {
+        QMutexLocker locker(&d->tlsSessionTicketsMutex);
+        configuration.setTlsSessionTicket(d->tlsSessionTickets.value(configuration.domain()));
+    }
+
+    QMetaObject::invokeMethod(client, [client, configuration] {
+        client->connectToServer(configuration);
+    });
+}
+
+///
+/// Returns the network access manager shared by the clients in the thread of
+/// the given client, or nullptr if the client is not part of the pool.
+///
+/// The network access manager must only be used in that thread, e.g. for a
+/// QXmppHttpUploadManager of the client.
+///
+QNetworkAccessManager *QXmppClientPool::networkAccessManager(const QXmppClient *client) const
+{
+    if (auto *worker = d->clients.value(const_cast<QXmppClient *>(client))) {
+        return worker->networkManager;
+    }
+    return nullptr;
+}
+
+///
+/// Returns the storage for \xep{0115, Entity Capabilities} shared by the
+/// clients of the pool.
+///
+QXmppCapabilitiesStorage *QXmppClientPool::capabilitiesStorage() const
+{
+    return &d->capabilitiesStorage;
+}
+
+void QXmppClientPool::storeTlsSessionTicket(const QString &domain, const QByteArray &ticket)
+{
+    QMutexLocker locker(&d->tlsSessionTicketsMutex);
+    d->tlsSessionTickets.insert(domain, ticket);
+}
@@ -0,0 +1,45 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPCLIENTPOOL_H
+#define QXMPPCLIENTPOOL_H
+
+#include "QXmppGlobal.h"
+
+#include <memory>
+
+#include <QObject>
+
+class QNetworkAccessManager;
+class QXmppCapabilitiesStorage;
+class QXmppClient;
+class QXmppClientPoolPrivate;
+class QXmppConfiguration;
+
+class QXMPP_EXPORT QXmppClientPool : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit QXmppClientPool(int threadCount = 0, QObject *parent = nullptr);
+    ~QXmppClientPool() override;
+
+    int threadCount() const;
+    int clientCount() const;
+
+    void addClient(QXmppClient *client);
+    void removeClient(QXmppClient *client);
+
+    void connectToServer(QXmppClient *client, const QXmppConfiguration &config);
+
+    QNetworkAccessManager *networkAccessManager(const QXmppClient *client) const;
+    QXmppCapabilitiesStorage *capabilitiesStorage() const;
+
+private:
+    void storeTlsSessionTicket(const QString &domain, const QByteArray &ticket);
+
+    const std::unique_ptr<QXmppClientPoolPrivate> d;
+};
+
+#endif  // QXMPPCLIENTPOOL_H
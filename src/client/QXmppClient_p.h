@@ -18,15 +18,112 @@
 #ifndef QXMPPCLIENT_P_H
 #define QXMPPCLIENT_P_H
 
+#include "QXmppClientExtension.h"
+#include "QXmppPacket_p.h"
 #include "QXmppPresence.h"
+#include "QXmppSendStanzaParams.h"
 
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <QHash>
+#include <QVarLengthArray>
+
+class QDomElement;
 class QXmppClient;
 class QXmppClientExtension;
 class QXmppE2eeExtension;
 class QXmppLogger;
+class QXmppMessage;
+class QXmppMessageHandler;
 class QXmppOutgoingClient;
+class QXmppStanzaView;
 class QTimer;
 
+namespace QXmpp::Private {
+
+//
+// Index of the client extensions by the stanza filters they declare.
+//
+// Lookups return the extensions in the order they were registered, so
+// filtering doesn't change which extension gets a stanza first.
+//
+class ExtensionDispatchTable
+{
+public:
+    using Extensions = QVarLengthArray<QXmppClientExtension *, 32>;
+
+    void build(const QList<QXmppClientExtension *> &extensions);
+    void clear();
+    bool isValid() const { return m_valid; }
+
+    Extensions extensions(const QDomElement &stanza) const;
+    Extensions extensions(const QXmppStanzaView &stanza) const;
+    const QVector<QXmppMessageHandler *> &messageHandlers() const { return m_messageHandlers; }
+
+private:
+    template<typename Element>
+    Extensions lookup(const Element &stanza) const;
+
+    bool m_valid = false;
+    QList<QXmppClientExtension *> m_extensions;
+    // indices of extensions receiving all stanzas
+    QVector<int> m_wildcards;
+    // tag name -> indices of extensions without namespace
+    QHash<QString, QVector<int>> m_byTagName;
+    // tag name -> child namespace -> indices of extensions
+    QHash<QString, QHash<QString, QVector<int>>> m_byNamespace;
+    QVector<QXmppMessageHandler *> m_messageHandlers;
+};
+
+//
+// Recently received message IDs (XEP-0359) to drop duplicate messages.
+//
+// The least recently seen IDs are discarded once the capacity is reached.
+//
+class MessageDeduplicator
+{
+public:
+    // Returns whether the message has been seen already and remembers its IDs.
+    bool isDuplicate(const QXmppMessage &message, int capacity);
+
+private:
+    bool insert(const QString &key);
+
+    // most recently seen IDs first
+    std::list<QString> m_keys;
+    QHash<QString, std::list<QString>::iterator> m_index;
+};
+
+//
+// What the client needs to know about an extension type without an instance.
+//
+// It is recorded once per process from the first instance of the type.
+//
+struct ExtensionTypeInfo
+{
+    QStringList discoveryFeatures;
+    QList<QXmppDiscoveryIq::Identity> discoveryIdentities;
+    QVector<QXmppClientExtension::StanzaFilter> stanzaFilters;
+    bool isMessageHandler = false;
+
+    static std::shared_ptr<const ExtensionTypeInfo> find(const QMetaObject *type);
+    static std::shared_ptr<const ExtensionTypeInfo> store(const QMetaObject *type, const QXmppClientExtension *extension);
+};
+
+struct LazyExtension
+{
+    const QMetaObject *type;
+    std::function<QXmppClientExtension *()> factory;
+    std::shared_ptr<const ExtensionTypeInfo> info;
+};
+
+}  // namespace QXmpp::Private
+
 class QXmppClientPrivate
 {
 public:
@@ -35,6 +132,13 @@ public:
     /// Current presence of the client
     QXmppPresence clientPresence;
     QList<QXmppClientExtension *> extensions;
+    /// Registered extensions that have not been created yet
+    std::vector<QXmpp::Private::LazyExtension> lazyExtensions;
+    /// Incremented whenever the extensions or their discovery info change
+    uint extensionsGeneration = 0;
+    /// Index of the extensions, rebuilt on demand after they have changed
+    QXmpp::Private::ExtensionDispatchTable dispatchTable;
+    QXmpp::Private::MessageDeduplicator messageDeduplicator;
     QXmppLogger *logger;
     /// Pointer to the XMPP stream
     QXmppOutgoingClient *stream;
@@ -45,12 +149,59 @@ public:
     bool receivedConflict;
     int reconnectionTries;
     QTimer *reconnectionTimer;
+    // retries right away when the network is reachable again
+    QMetaObject::Connection reachabilityConnection;
 
     // Client state indication
     bool isActive;
+    struct DeferredPacket
+    {
+        QXmppPacket packet;
+        // recipient of a presence, only the last one is sent
+        std::optional<QString> presenceTo;
+    };
+    // deferrable stanzas sent while inactive
+    std::vector<DeferredPacket> deferredPackets;
+
+    QXmppTask<QXmpp::SendResult> sendOrDefer(QXmppStanza &stanza, const std::optional<QXmppSendStanzaParams> &params);
+    QXmppTask<QXmpp::SendResult> sendOrDefer(QXmppPacket &&packet, const std::optional<QXmppSendStanzaParams> &params);
+    void sendDeferredPackets();
+
+    // Outbox: the stanzas sent with send() and sendSensitive() are numbered
+    // in the order they are submitted and written to the stream in that
+    // order. Stanzas are encrypted concurrently, an encrypted stanza waits
+    // for the stanzas before it. While the client is connecting or waiting
+    // to reconnect, all stanzas wait and are written once connected.
+    struct OutboxEntry
+    {
+        // empty while the stanza is encrypted
+        std::optional<QXmppPacket> packet;
+        std::optional<QXmppSendStanzaParams> params;
+        // encryption failed and the error has been reported
+        bool discarded = false;
+    };
+    std::deque<OutboxEntry> outbox;
+    // sequence number of the first entry in the outbox
+    quint64 outboxSequenceNumber = 0;
+
+    bool isOutboxHeld() const;
+    QXmppTask<QXmpp::SendResult> sendInOrder(QXmppStanza &stanza, const std::optional<QXmppSendStanzaParams> &params);
+    quint64 reserveOutboxEntry(const std::optional<QXmppSendStanzaParams> &params);
+    void setOutboxPacket(quint64 sequenceNumber, QXmppPacket &&packet);
+    void discardOutboxEntry(quint64 sequenceNumber);
+    void flushOutbox();
+    void clearOutbox();
+
+    const QXmpp::Private::ExtensionDispatchTable &extensionDispatchTable();
+    QXmppClientExtension *createLazyExtension(size_t index);
+    template<typename Element>
+    void createLazyExtensions(const Element &stanza);
+    void createLazyMessageHandlers();
 
     void addProperCapability(QXmppPresence &presence);
-    int getNextReconnectTime() const;
+    int nextReconnectionDelay();
+    void scheduleReconnection(int minimumDelay);
+    void watchNetworkReachability();
 
     static QStringList discoveryFeatures();
 
@@ -4,9 +4,13 @@
 
 #include "QXmppConfiguration.h"
 
+#include "QXmppStreamManagementPolicy.h"
 #include "QXmppUtils.h"
 
+#include <algorithm>
+
 #include <QNetworkProxy>
+#include <QSet>
 #include <QSslSocket>
 
 class QXmppConfigurationPrivate : public QSharedData
@@ -41,6 +45,9 @@ public:
     int keepAliveInterval;
     // interval in seconds, if zero won't timeout
     int keepAliveTimeout;
+    // interval in seconds while the client is inactive (XEP-0352)
+    int inactiveKeepAliveInterval = 300;
+    bool tcpKeepAliveEnabled = false;
     // will keep reconnecting if disconnected, default is true
     bool autoReconnectionEnabled;
     // which authentication systems to use (if any)
@@ -56,6 +63,41 @@ public:
     QNetworkProxy networkProxy;
 
     QList<QSslCertificate> caCertificates;
+
+    // write batching, disabled if zero
+    int writeBatchSize = 0;
+    int writeBatchDelay = 0;
+    // bulk lane, disabled if zero
+    qint64 bulkWriteThreshold = 16 * 1024;
+
+    // size of unacknowledged stanzas, unlimited if zero
+    qint64 streamManagementQueueLimit = 0;
+    QXmppConfiguration::StreamManagementQueuePolicy streamManagementQueuePolicy = QXmppConfiguration::DropOldestStanzas;
+    QXmppStreamManagementPolicy streamManagementPolicy;
+
+    // reconnection backoff
+    int reconnectionBaseDelay = 10000;
+    int reconnectionMaximumDelay = 60000;
+
+    bool iqCoalescingEnabled = false;
+    int iqTimeout = 60000;
+    qint64 maximumStanzaSize = 0;
+    bool backgroundParsingEnabled = false;
+    // namespaces of message extensions to parse, all if empty
+    QSet<QString> parsedMessageNamespaces;
+    // number of message IDs remembered to drop duplicates, disabled if 0
+    int messageDeduplicationCacheSize = 0;
+    // handling time in ms above which extensions are reported, disabled if 0
+    int slowHandlerThreshold = 0;
+    bool useSasl2Authentication = true;
+
+    // XEP-0368: SRV records for XMPP over TLS
+    bool directTlsEnabled = false;
+    bool tlsSessionResumptionEnabled = true;
+    QByteArray tlsSessionTicket;
+
+    // XEP-0138: Stream Compression
+    bool streamCompressionEnabled = false;
 };
 
 QXmppConfigurationPrivate::QXmppConfigurationPrivate()
@@ -388,6 +430,43 @@ void QXmppConfiguration::setAutoReconnectionEnabled(bool value)
     d->autoReconnectionEnabled = value;
 }
 
+///
+/// Returns the delay in milliseconds the reconnection backoff starts with.
+///
+/// \since QXmpp 1.6
+///
+int QXmppConfiguration::reconnectionBaseDelay() const
+{
+    return d->reconnectionBaseDelay;
+}
+
+///
+/// Returns the maximum delay in milliseconds between reconnection attempts.
+///
+/// \since QXmpp 1.6
+///
+int QXmppConfiguration::reconnectionMaximumDelay() const
+{
+    return d->reconnectionMaximumDelay;
+}
+
+///
+/// Sets the delays in milliseconds of the automatic reconnection.
+///
+/// The delay before each attempt is random between 0 and the base delay,
+/// doubled with each failed attempt up to the maximum delay. This spreads the
+/// reconnections of the clients of a server that has restarted.
+///
+/// The defaults are 10 and 60 seconds.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setReconnectionDelay(int baseMsecs, int maximumMsecs)
+{
+    d->reconnectionBaseDelay = std::max(baseMsecs, 1);
+    d->reconnectionMaximumDelay = std::max(maximumMsecs, d->reconnectionBaseDelay);
+}
+
 /// Returns whether SSL errors (such as certificate validation errors)
 /// are to be ignored when connecting to the XMPP server.
 
@@ -418,6 +497,35 @@ void QXmppConfiguration::setUseSASLAuthentication(bool useSASL)
     d->useSASLAuthentication = useSASL;
 }
 
+///
+/// Returns whether to make use of \xep{0388, Extensible SASL Profile}.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppConfiguration::useSasl2Authentication() const
+{
+    return d->useSasl2Authentication;
+}
+
+///
+/// Sets whether to make use of \xep{0388, Extensible SASL Profile}.
+///
+/// If the server supports it, SASL 2 is preferred over SASL. The resource is
+/// then bound using \xep{0386, Bind 2}, \xep{0198, Stream Management} is
+/// enabled or resumed together with the authentication and a token for
+/// \xep{0484, Fast Authentication Streamlining Tokens} is requested. This
+/// saves several round-trips when connecting. SASL authentication must be
+/// enabled as well.
+///
+/// The default value is true.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setUseSasl2Authentication(bool enabled)
+{
+    d->useSasl2Authentication = enabled;
+}
+
 /// Returns whether to make use of non-SASL authentication.
 
 bool QXmppConfiguration::useNonSASLAuthentication() const
@@ -432,6 +540,118 @@ void QXmppConfiguration::setUseNonSASLAuthentication(bool useNonSASL)
     d->useNonSASLAuthentication = useNonSASL;
 }
 
+///
+/// Returns whether hosts for direct TLS from \xep{0368, SRV records for XMPP
+/// over TLS} are preferred.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppConfiguration::isDirectTlsEnabled() const
+{
+    return d->directTlsEnabled;
+}
+
+///
+/// Sets whether hosts for direct TLS from \xep{0368, SRV records for XMPP
+/// over TLS} are preferred.
+///
+/// If enabled, the \c _xmpps-client SRV records of the domain are looked up
+/// first. TLS is then negotiated directly after connecting, which saves the
+/// STARTTLS round-trip and the stream restart. If the domain has no such
+/// records or none of the hosts is reachable, the \c _xmpp-client SRV
+/// records are used. This has no effect if an explicit host is set or if the
+/// stream security mode is TLSDisabled.
+///
+/// The default value is false.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setDirectTlsEnabled(bool enabled)
+{
+    d->directTlsEnabled = enabled;
+}
+
+///
+/// Returns whether TLS sessions are resumed when reconnecting.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppConfiguration::isTlsSessionResumptionEnabled() const
+{
+    return d->tlsSessionResumptionEnabled;
+}
+
+///
+/// Sets whether TLS sessions are resumed when reconnecting.
+///
+/// If enabled, the session ticket sent by the server is stored in
+/// tlsSessionTicket() and used for the next connection. The server can then
+/// skip the certificate exchange and the key agreement of a full handshake.
+///
+/// The default value is true.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setTlsSessionResumptionEnabled(bool enabled)
+{
+    d->tlsSessionResumptionEnabled = enabled;
+}
+
+///
+/// Returns the TLS session ticket of the last connection.
+///
+/// The ticket is updated by QXmppClient while connected. It can be stored and
+/// set again after restarting the application to resume the TLS session.
+///
+/// \since QXmpp 1.6
+///
+QByteArray QXmppConfiguration::tlsSessionTicket() const
+{
+    return d->tlsSessionTicket;
+}
+
+///
+/// Sets the TLS session ticket to use for the next connection.
+///
+/// \sa setTlsSessionResumptionEnabled()
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setTlsSessionTicket(const QByteArray &ticket)
+{
+    d->tlsSessionTicket = ticket;
+}
+
+///
+/// Returns whether the stream is compressed using \xep{0138, Stream
+/// Compression} if the server supports it.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppConfiguration::isStreamCompressionEnabled() const
+{
+    return d->streamCompressionEnabled;
+}
+
+///
+/// Sets whether the stream is compressed using \xep{0138, Stream
+/// Compression} if the server supports it.
+///
+/// The stream is compressed with zlib after the authentication. This usually
+/// reduces the size of the traffic a lot, e.g. on metered mobile connections,
+/// at the cost of some CPU time and memory on both sides. Compression is only
+/// available if QXmpp has been built with zlib, see
+/// QXmppStream::isCompressionSupported().
+///
+/// The default value is false.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setStreamCompressionEnabled(bool enabled)
+{
+    d->streamCompressionEnabled = enabled;
+}
+
 /// Returns the specified security mode for the stream. The default value is
 /// QXmppConfiguration::TLSEnabled.
 /// \return StreamSecurityMode
@@ -516,6 +736,10 @@ QNetworkProxy QXmppConfiguration::networkProxy() const
 ///
 /// If set to zero, no keep alive packets will be sent.
 ///
+/// No keep alive is sent if data has been received within the interval. With
+/// stream management enabled, an acknowledgement is requested instead of a
+/// ping. If keepAliveTimeout() is zero, only a whitespace is sent.
+///
 /// The default value is 60 seconds.
 
 void QXmppConfiguration::setKeepAliveInterval(int secs)
@@ -532,6 +756,65 @@ int QXmppConfiguration::keepAliveInterval() const
     return d->keepAliveInterval;
 }
 
+///
+/// Specifies the interval in seconds at which keep alive (ping) packets are
+/// sent while the client is inactive, see QXmppClient::setActive().
+///
+/// Applications typically set the client inactive when they are in the
+/// background. A longer interval lets the device's radio sleep longer. The
+/// interval is never shorter than keepAliveInterval() and no pings are sent
+/// if keepAliveInterval() is zero.
+///
+/// The default value is 300 seconds.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setInactiveKeepAliveInterval(int secs)
+{
+    d->inactiveKeepAliveInterval = secs;
+}
+
+///
+/// Returns the keep alive interval in seconds while the client is inactive.
+///
+/// The default value is 300 seconds.
+///
+/// \since QXmpp 1.6
+///
+int QXmppConfiguration::inactiveKeepAliveInterval() const
+{
+    return d->inactiveKeepAliveInterval;
+}
+
+///
+/// Returns whether the operating system's TCP keep alive is enabled on the
+/// socket.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppConfiguration::isTcpKeepAliveEnabled() const
+{
+    return d->tcpKeepAliveEnabled;
+}
+
+///
+/// Sets whether the operating system's TCP keep alive is enabled on the
+/// socket.
+///
+/// TCP keep alive probes are answered by the server's network stack and
+/// detect broken connections without any XMPP traffic. The probe interval is
+/// configured by the operating system and usually much longer than
+/// keepAliveInterval(), so it complements the XMPP keep alive.
+///
+/// The default is false.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setTcpKeepAliveEnabled(bool enabled)
+{
+    d->tcpKeepAliveEnabled = enabled;
+}
+
 /// Specifies the maximum time in seconds to wait for a keep alive response
 /// from the server before considering we are disconnected.
 ///
@@ -567,3 +850,363 @@ QList<QSslCertificate> QXmppConfiguration::caCertificates() const
 {
     return d->caCertificates;
 }
+
+///
+/// Returns the maximum number of bytes buffered before writing them to the
+/// socket.
+///
+/// \since QXmpp 1.6
+///
+int QXmppConfiguration::writeBatchSize() const
+{
+    return d->writeBatchSize;
+}
+
+///
+/// Sets the maximum number of bytes buffered before writing them to the socket.
+///
+/// With write batching, stanzas sent in the same event loop iteration (or
+/// within the writeBatchDelay()) are written to the socket at once, so fewer
+/// system calls and TLS records are needed.
+///
+/// The default value is 0, which disables write batching.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setWriteBatchSize(int bytes)
+{
+    d->writeBatchSize = bytes;
+}
+
+///
+/// Returns the maximum time in milliseconds outgoing data is buffered by write
+/// batching.
+///
+/// \since QXmpp 1.6
+///
+int QXmppConfiguration::writeBatchDelay() const
+{
+    return d->writeBatchDelay;
+}
+
+///
+/// Sets the maximum time in milliseconds outgoing data is buffered by write
+/// batching.
+///
+/// The default value is 0, so only stanzas sent in the same event loop
+/// iteration are combined.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setWriteBatchDelay(int msecs)
+{
+    d->writeBatchDelay = msecs;
+}
+
+///
+/// Returns the number of bytes waiting to be written from which on bulk
+/// stanzas are held back.
+///
+/// \since QXmpp 1.6
+///
+qint64 QXmppConfiguration::bulkWriteThreshold() const
+{
+    return d->bulkWriteThreshold;
+}
+
+///
+/// Sets the number of bytes waiting to be written from which on bulk stanzas
+/// are held back.
+///
+/// Bulk stanzas, e.g. the data of in-band bytestreams and archive queries,
+/// wait while more than this is buffered for the socket, so messages and
+/// presences sent during a transfer don't queue behind it. See
+/// QXmppStream::setBulkWriteThreshold().
+///
+/// The default value is 16 KiB. 0 sends all stanzas in order.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setBulkWriteThreshold(qint64 bytes)
+{
+    d->bulkWriteThreshold = bytes;
+}
+
+///
+/// Returns the maximum size in bytes of the stanzas that may wait for an
+/// acknowledgement by the server.
+///
+/// \since QXmpp 1.6
+///
+qint64 QXmppConfiguration::streamManagementQueueLimit() const
+{
+    return d->streamManagementQueueLimit;
+}
+
+///
+/// Sets the maximum size in bytes of the stanzas that may wait for an
+/// acknowledgement by the server (\xep{0198}: Stream Management).
+///
+/// Unacknowledged stanzas are kept to resend them on stream resumption. On
+/// unstable connections this queue can grow large. If the limit is exceeded,
+/// the streamManagementQueuePolicy() is applied.
+///
+/// The default value is 0, which means no limit.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setStreamManagementQueueLimit(qint64 bytes)
+{
+    d->streamManagementQueueLimit = bytes;
+}
+
+///
+/// Returns what happens when the stream management queue limit is exceeded.
+///
+/// \since QXmpp 1.6
+///
+QXmppConfiguration::StreamManagementQueuePolicy QXmppConfiguration::streamManagementQueuePolicy() const
+{
+    return d->streamManagementQueuePolicy;
+}
+
+///
+/// Sets what happens when the stream management queue limit is exceeded.
+///
+/// The default value is DropOldestStanzas.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setStreamManagementQueuePolicy(StreamManagementQueuePolicy policy)
+{
+    d->streamManagementQueuePolicy = policy;
+}
+
+///
+/// Returns the policy for requesting and sending acknowledgements (\xep{0198}:
+/// Stream Management).
+///
+/// \since QXmpp 1.6
+///
+QXmppStreamManagementPolicy QXmppConfiguration::streamManagementPolicy() const
+{
+    return d->streamManagementPolicy;
+}
+
+///
+/// Sets the policy for requesting and sending acknowledgements (\xep{0198}:
+/// Stream Management).
+///
+/// By default an acknowledgement is requested after every stanza. On mobile
+/// connections QXmppStreamManagementPolicy::batched() can reduce the traffic
+/// considerably.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setStreamManagementPolicy(const QXmppStreamManagementPolicy &policy)
+{
+    d->streamManagementPolicy = policy;
+}
+
+///
+/// Returns whether identical IQ get requests share one request.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppConfiguration::isIqCoalescingEnabled() const
+{
+    return d->iqCoalescingEnabled;
+}
+
+///
+/// Sets whether identical IQ get requests share one request.
+///
+/// If enabled, a get request sent while an identical request to the same
+/// recipient is still waiting for its response is not sent again. This avoids
+/// duplicate round-trips when several managers request the same information
+/// at the same time, e.g. after connecting.
+///
+/// The default value is false.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setIqCoalescingEnabled(bool enabled)
+{
+    d->iqCoalescingEnabled = enabled;
+}
+
+///
+/// Returns the time in milliseconds after which IQ requests without a
+/// response fail.
+///
+/// \since QXmpp 1.6
+///
+int QXmppConfiguration::iqTimeout() const
+{
+    return d->iqTimeout;
+}
+
+///
+/// Sets the time in milliseconds after which IQ requests without a response
+/// fail with QXmpp::SendError::Timeout. See QXmppStream::setIqTimeout().
+///
+/// The default value is 60 seconds. 0 disables the timeout.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setIqTimeout(int msecs)
+{
+    d->iqTimeout = msecs;
+}
+
+///
+/// Returns the maximum size of received stanzas in bytes.
+///
+/// \since QXmpp 1.6
+///
+qint64 QXmppConfiguration::maximumStanzaSize() const
+{
+    return d->maximumStanzaSize;
+}
+
+///
+/// Sets the maximum size of received stanzas in bytes.
+///
+/// The connection is closed with a \c <policy-violation/> stream error if the
+/// server sends a larger stanza. See QXmppStream::setMaximumStanzaSize().
+///
+/// The default value is 0, which means no limit.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setMaximumStanzaSize(qint64 bytes)
+{
+    d->maximumStanzaSize = bytes;
+}
+
+///
+/// Returns whether the data received from the server is parsed in a worker
+/// thread.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppConfiguration::isBackgroundParsingEnabled() const
+{
+    return d->backgroundParsingEnabled;
+}
+
+///
+/// Sets whether the data received from the server is parsed in a worker
+/// thread.
+///
+/// The stanzas are parsed in a thread of the connection and handed to the
+/// extensions in the thread of the client in batches. See
+/// QXmppStream::setBackgroundParsingEnabled().
+///
+/// This is disabled by default.
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setBackgroundParsingEnabled(bool enabled)
+{
+    d->backgroundParsingEnabled = enabled;
+}
+
+///
+/// Returns the namespaces of the message extensions that are parsed from
+/// received messages.
+///
+/// \since QXmpp 1.6
+///
+QSet<QString> QXmppConfiguration::parsedMessageNamespaces() const
+{
+    return d->parsedMessageNamespaces;
+}
+
+///
+/// Sets the namespaces of the message extensions that are parsed from
+/// received messages.
+///
+/// The body, subject and thread are always parsed. Other extensions are
+/// kept as unknown extensions of the message, so clients that are only
+/// interested in a few extensions, e.g. bots reading bodies, save the time
+/// to parse everything else.
+///
+/// Managers only see the parsed extensions, so the namespaces used by the
+/// registered managers need to be included (e.g. "urn:xmpp:receipts" for
+/// delivery receipts).
+///
+/// The default is an empty set, which parses all known extensions.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setParsedMessageNamespaces(const QSet<QString> &namespaces)
+{
+    d->parsedMessageNamespaces = namespaces;
+}
+
+///
+/// Returns the number of message IDs the client remembers to drop duplicate
+/// messages.
+///
+/// \since QXmpp 1.6
+///
+int QXmppConfiguration::messageDeduplicationCacheSize() const
+{
+    return d->messageDeduplicationCacheSize;
+}
+
+///
+/// Sets the number of message IDs the client remembers to drop duplicate
+/// messages.
+///
+/// The same message can be received multiple times, e.g. via live delivery
+/// and as a message carbon, or again after a stream could not be resumed.
+/// If enabled, the client remembers the \xep{0359, Unique and Stable Stanza
+/// IDs} (stanza-id and origin-id) of the last received messages and drops
+/// messages with known IDs before they are decrypted or passed to the message
+/// handlers and QXmppClient::messageReceived(). Messages without such IDs are
+/// never dropped.
+///
+/// The default value is 0, which disables the deduplication.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setMessageDeduplicationCacheSize(int size)
+{
+    d->messageDeduplicationCacheSize = size;
+}
+
+///
+/// Returns the time in milliseconds above which the handling of a stanza by
+/// an extension is reported.
+///
+/// \since QXmpp 1.6
+///
+int QXmppConfiguration::slowHandlerThreshold() const
+{
+    return d->slowHandlerThreshold;
+}
+
+///
+/// Sets the time in milliseconds above which the handling of a stanza by an
+/// extension is reported.
+///
+/// All extensions and message handlers of a client run in its thread, so one
+/// that blocks while handling a stanza delays everything else. If enabled,
+/// each call of QXmppClientExtension::handleStanza() and
+/// QXmppMessageHandler::handleMessage() is timed. The durations are recorded
+/// in the QXmppMetrics::ExtensionHandlingTime histogram labelled by the
+/// class of the extension, and calls taking longer than the threshold are
+/// logged as a warning with the extension and the kind of stanza.
+///
+/// The default value is 0, which disables the measurements.
+///
+/// \since QXmpp 1.6
+///
+void QXmppConfiguration::setSlowHandlerThreshold(int msecs)
+{
+    d->slowHandlerThreshold = std::max(msecs, 0);
+}
@@ -7,12 +7,14 @@
 
 #include "QXmppGlobal.h"
 
+#include <QSet>
 #include <QSharedDataPointer>
 #include <QString>
 
 class QNetworkProxy;
 class QSslCertificate;
 class QXmppConfigurationPrivate;
+class QXmppStreamManagementPolicy;
 
 /// \brief The QXmppConfiguration class holds configuration options.
 ///
@@ -47,6 +49,20 @@ public:
         NonSASLDigest      ///< Digest (default)
     };
 
+    ///
+    /// Describes what happens when the stanzas that haven't been acknowledged
+    /// by the server (\xep{0198}: Stream Management) exceed the queue limit.
+    ///
+    /// \since QXmpp 1.6
+    ///
+    enum StreamManagementQueuePolicy {
+        /// The oldest stanzas are removed from the queue. They are reported as
+        /// sent but not acknowledged and are not resent on stream resumption.
+        DropOldestStanzas,
+        /// The stream is closed and can't be resumed.
+        DisconnectStream,
+    };
+
     /// An enumeration for various SASL authentication mechanisms available.
     /// The server may or may not allow any particular mechanism. So depending
     /// upon the availability of mechanisms on the server the library will choose
@@ -97,10 +113,28 @@ public:
 
     bool autoReconnectionEnabled() const;
     void setAutoReconnectionEnabled(bool);
+    int reconnectionBaseDelay() const;
+    int reconnectionMaximumDelay() const;
+    void setReconnectionDelay(int baseMsecs, int maximumMsecs);
 
     bool useSASLAuthentication() const;
     void setUseSASLAuthentication(bool);
 
+    bool useSasl2Authentication() const;
+    void setUseSasl2Authentication(bool);
+
+    bool isDirectTlsEnabled() const;
+    void setDirectTlsEnabled(bool enabled);
+
+    bool isTlsSessionResumptionEnabled() const;
+    void setTlsSessionResumptionEnabled(bool enabled);
+
+    QByteArray tlsSessionTicket() const;
+    void setTlsSessionTicket(const QByteArray &ticket);
+
+    bool isStreamCompressionEnabled() const;
+    void setStreamCompressionEnabled(bool enabled);
+
     bool useNonSASLAuthentication() const;
     void setUseNonSASLAuthentication(bool);
 
@@ -125,9 +159,54 @@ public:
     int keepAliveTimeout() const;
     void setKeepAliveTimeout(int secs);
 
+    int inactiveKeepAliveInterval() const;
+    void setInactiveKeepAliveInterval(int secs);
+
+    bool isTcpKeepAliveEnabled() const;
+    void setTcpKeepAliveEnabled(bool enabled);
+
     QList<QSslCertificate> caCertificates() const;
     void setCaCertificates(const QList<QSslCertificate> &);
 
+    int writeBatchSize() const;
+    void setWriteBatchSize(int bytes);
+
+    int writeBatchDelay() const;
+    void setWriteBatchDelay(int msecs);
+
+    qint64 bulkWriteThreshold() const;
+    void setBulkWriteThreshold(qint64 bytes);
+
+    qint64 streamManagementQueueLimit() const;
+    void setStreamManagementQueueLimit(qint64 bytes);
+
+    StreamManagementQueuePolicy streamManagementQueuePolicy() const;
+    void setStreamManagementQueuePolicy(StreamManagementQueuePolicy policy);
+
+    QXmppStreamManagementPolicy streamManagementPolicy() const;
+    void setStreamManagementPolicy(const QXmppStreamManagementPolicy &policy);
+
+    bool isIqCoalescingEnabled() const;
+    void setIqCoalescingEnabled(bool enabled);
+
+    int iqTimeout() const;
+    void setIqTimeout(int msecs);
+
+    qint64 maximumStanzaSize() const;
+    void setMaximumStanzaSize(qint64 bytes);
+
+    bool isBackgroundParsingEnabled() const;
+    void setBackgroundParsingEnabled(bool enabled);
+
+    QSet<QString> parsedMessageNamespaces() const;
+    void setParsedMessageNamespaces(const QSet<QString> &namespaces);
+
+    int messageDeduplicationCacheSize() const;
+    void setMessageDeduplicationCacheSize(int size);
+
+    int slowHandlerThreshold() const;
+    void setSlowHandlerThreshold(int msecs);
+
 private:
     QSharedDataPointer<QXmppConfigurationPrivate> d;
 };
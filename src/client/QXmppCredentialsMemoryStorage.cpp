@@ -0,0 +1,88 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppCredentialsMemoryStorage.h"
+
+#include "QXmppFutureUtils_p.h"
+
+using namespace QXmpp::Private;
+
+///
+/// \class QXmppCredentialsMemoryStorage
+///
+/// \brief The QXmppCredentialsMemoryStorage class stores the credentials of
+/// an account in the memory.
+///
+/// This is the default storage of QXmppClient. It speeds up reconnects, but
+/// the credentials are lost when the storage is destroyed.
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+
+class QXmppCredentialsMemoryStoragePrivate
+{
+public:
+    QString userAgentId;
+    std::optional<QXmppCredentialsStorage::FastToken> fastToken;
+    std::optional<QXmppCredentialsStorage::ScramKeys> scramKeys;
+};
+
+///
+/// Constructs a credentials memory storage.
+///
+QXmppCredentialsMemoryStorage::QXmppCredentialsMemoryStorage()
+    : d(new QXmppCredentialsMemoryStoragePrivate)
+{
+}
+
+QXmppCredentialsMemoryStorage::~QXmppCredentialsMemoryStorage() = default;
+
+/// \cond
+QXmppTask<QString> QXmppCredentialsMemoryStorage::userAgentId()
+{
+    return makeReadyTask(QString(d->userAgentId));
+}
+
+QXmppTask<void> QXmppCredentialsMemoryStorage::setUserAgentId(const QString &id)
+{
+    d->userAgentId = id;
+    return makeReadyTask();
+}
+
+QXmppTask<std::optional<QXmppCredentialsStorage::FastToken>> QXmppCredentialsMemoryStorage::fastToken()
+{
+    return makeReadyTask(std::optional<FastToken>(d->fastToken));
+}
+
+QXmppTask<void> QXmppCredentialsMemoryStorage::setFastToken(const FastToken &token)
+{
+    d->fastToken = token;
+    return makeReadyTask();
+}
+
+QXmppTask<void> QXmppCredentialsMemoryStorage::removeFastToken()
+{
+    d->fastToken.reset();
+    return makeReadyTask();
+}
+
+QXmppTask<std::optional<QXmppCredentialsStorage::ScramKeys>> QXmppCredentialsMemoryStorage::scramKeys()
+{
+    return makeReadyTask(std::optional<ScramKeys>(d->scramKeys));
+}
+
+QXmppTask<void> QXmppCredentialsMemoryStorage::setScramKeys(const ScramKeys &keys)
+{
+    d->scramKeys = keys;
+    return makeReadyTask();
+}
+
+QXmppTask<void> QXmppCredentialsMemoryStorage::removeScramKeys()
+{
+    d->scramKeys.reset();
+    return makeReadyTask();
+}
+/// \endcond
@@ -0,0 +1,37 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPCREDENTIALSMEMORYSTORAGE_H
+#define QXMPPCREDENTIALSMEMORYSTORAGE_H
+
+#include "QXmppCredentialsStorage.h"
+
+#include <memory>
+
+class QXmppCredentialsMemoryStoragePrivate;
+
+class QXMPP_EXPORT QXmppCredentialsMemoryStorage : public QXmppCredentialsStorage
+{
+public:
+    QXmppCredentialsMemoryStorage();
+    ~QXmppCredentialsMemoryStorage() override;
+
+    /// \cond
+    QXmppTask<QString> userAgentId() override;
+    QXmppTask<void> setUserAgentId(const QString &id) override;
+
+    QXmppTask<std::optional<FastToken>> fastToken() override;
+    QXmppTask<void> setFastToken(const FastToken &token) override;
+    QXmppTask<void> removeFastToken() override;
+
+    QXmppTask<std::optional<ScramKeys>> scramKeys() override;
+    QXmppTask<void> setScramKeys(const ScramKeys &keys) override;
+    QXmppTask<void> removeScramKeys() override;
+    /// \endcond
+
+private:
+    const std::unique_ptr<QXmppCredentialsMemoryStoragePrivate> d;
+};
+
+#endif  // QXMPPCREDENTIALSMEMORYSTORAGE_H
@@ -0,0 +1,88 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+///
+/// \class QXmppCredentialsStorage
+///
+/// \brief The QXmppCredentialsStorage class stores the credentials that allow
+/// a client to log in faster than with its password.
+///
+/// If the server supports \xep{0484, Fast Authentication Streamlining Tokens},
+/// the client requests a token during the \xep{0388, Extensible SASL Profile}
+/// authentication. The next login uses the token instead of the password and
+/// completes in a single round-trip. The token is bound to the user agent ID
+/// sent to the server, so both need to be stored.
+///
+/// With SCRAM, the keys derived from the password are stored as well, so the
+/// key derivation with the many iterations the server asks for only runs
+/// again if the server changes the salt. Once the keys are stored, the
+/// password is not needed for logins anymore.
+///
+/// Implement this interface to keep the credentials across application
+/// restarts and pass it to QXmppClient::setCredentialsStorage(). The token
+/// and the SCRAM keys grant access to the account, they should be stored as
+/// securely as the password.
+///
+/// A storage belongs to one account.
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+
+///
+/// \fn QXmppCredentialsStorage::userAgentId()
+///
+/// Returns the stored user agent ID or a null string if there is none.
+///
+
+///
+/// \fn QXmppCredentialsStorage::setUserAgentId(const QString &id)
+///
+/// Stores the user agent ID.
+///
+/// The ID is generated once and must stay the same for all following logins.
+///
+
+///
+/// \fn QXmppCredentialsStorage::fastToken()
+///
+/// Returns the stored \xep{0484, Fast Authentication Streamlining Tokens}
+/// token, if any.
+///
+
+///
+/// \fn QXmppCredentialsStorage::setFastToken(const FastToken &token)
+///
+/// Replaces the stored token.
+///
+/// This is also called before each login with the token to store the increased
+/// FastToken::count.
+///
+
+///
+/// \fn QXmppCredentialsStorage::removeFastToken()
+///
+/// Removes the stored token, e.g. after the server has rejected it.
+///
+
+///
+/// \fn QXmppCredentialsStorage::scramKeys()
+///
+/// Returns the stored SCRAM keys, if any.
+///
+
+///
+/// \fn QXmppCredentialsStorage::setScramKeys(const ScramKeys &keys)
+///
+/// Replaces the stored SCRAM keys.
+///
+/// This is called after a successful SCRAM authentication with new keys.
+///
+
+///
+/// \fn QXmppCredentialsStorage::removeScramKeys()
+///
+/// Removes the stored SCRAM keys, e.g. after the server has rejected them.
+///
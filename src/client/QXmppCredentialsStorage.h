@@ -0,0 +1,74 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPCREDENTIALSSTORAGE_H
+#define QXMPPCREDENTIALSSTORAGE_H
+
+#include "QXmppGlobal.h"
+
+#include <optional>
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+
+template<typename T>
+class QXmppTask;
+
+class QXMPP_EXPORT QXmppCredentialsStorage
+{
+public:
+    ///
+    /// Token for \xep{0484, Fast Authentication Streamlining Tokens}
+    ///
+    struct FastToken
+    {
+        /// hashed token mechanism, e.g. "HT-SHA-256-NONE"
+        QString mechanism;
+        /// secret of the token
+        QString secret;
+        /// time after which the server does not accept the token anymore,
+        /// invalid if unknown
+        QDateTime expiry;
+        /// number of authentications with the token
+        quint64 count = 0;
+    };
+
+    ///
+    /// Keys derived from the password for SCRAM authentication
+    ///
+    /// With the keys, a SCRAM exchange only needs a few HMACs instead of the
+    /// expensive PBKDF2 derivation of the salted password.
+    ///
+    struct ScramKeys
+    {
+        /// SCRAM mechanism, e.g. "SCRAM-SHA-256"
+        QString mechanism;
+        /// username the keys have been derived for
+        QString username;
+        /// salt sent by the server
+        QByteArray salt;
+        /// iteration count sent by the server
+        int iterations = 0;
+        /// HMAC of the salted password with "Client Key"
+        QByteArray clientKey;
+        /// HMAC of the salted password with "Server Key"
+        QByteArray serverKey;
+    };
+
+    virtual ~QXmppCredentialsStorage() = default;
+
+    virtual QXmppTask<QString> userAgentId() = 0;
+    virtual QXmppTask<void> setUserAgentId(const QString &id) = 0;
+
+    virtual QXmppTask<std::optional<FastToken>> fastToken() = 0;
+    virtual QXmppTask<void> setFastToken(const FastToken &token) = 0;
+    virtual QXmppTask<void> removeFastToken() = 0;
+
+    virtual QXmppTask<std::optional<ScramKeys>> scramKeys() = 0;
+    virtual QXmppTask<void> setScramKeys(const ScramKeys &keys) = 0;
+    virtual QXmppTask<void> removeScramKeys() = 0;
+};
+
+#endif  // QXMPPCREDENTIALSSTORAGE_H
@@ -4,6 +4,7 @@
 
 #include "QXmppDiscoveryManager.h"
 
+#include "QXmppCapabilitiesMemoryStorage.h"
 #include "QXmppClient.h"
 #include "QXmppClient_p.h"
 #include "QXmppConstants_p.h"
@@ -11,13 +12,62 @@
 #include "QXmppDiscoveryIq.h"
 #include "QXmppFutureUtils_p.h"
 #include "QXmppIqHandling.h"
+#include "QXmppOutgoingClient.h"
+#include "QXmppPacket_p.h"
+#include "QXmppPresence.h"
 #include "QXmppStream.h"
 
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
 #include <QCoreApplication>
+#include <QDateTime>
 #include <QDomElement>
+#include <QSet>
 
 using namespace QXmpp::Private;
 
+// A request for capabilities that waits for the disco#info response.
+struct CapabilitiesRequest
+{
+    QString jid;
+    QXmppPromise<QXmppDiscoveryManager::InfoResult> promise;
+};
+
+// A walk through the disco#items of an entity.
+struct Crawl
+{
+    struct Request
+    {
+        bool items;
+        QString jid;
+        QString node;
+        int depth;
+        // index of the entity in infos
+        qsizetype index;
+    };
+
+    QString jid;
+    int maxDepth;
+    // entities by JID and node, so each one is only requested once
+    QSet<std::pair<QString, QString>> visited;
+    std::deque<Request> queue;
+    int runningRequests = 0;
+    // in the order of discovery, unset if the request failed
+    std::vector<std::optional<QXmppDiscoveryIq>> infos;
+    std::vector<QXmppPromise<QVector<QXmppDiscoveryIq>>> promises;
+};
+
+struct CachedCrawl
+{
+    QVector<QXmppDiscoveryIq> infos;
+    QDateTime expires;
+};
+
 class QXmppDiscoveryManagerPrivate
 {
 public:
@@ -26,8 +76,71 @@ public:
     QString clientType;
     QString clientName;
     QXmppDataForm clientInfoForm;
+
+    // Own capabilities, valid as long as the extensions of the client are
+    // unchanged. The serialized disco#info responses are cached by node.
+    std::optional<QXmppDiscoveryIq> capabilities;
+    QByteArray capabilitiesVer;
+    QHash<QString, QByteArray> infoResponses;
+    uint extensionsGeneration = 0;
+
+    void resetCapabilities()
+    {
+        capabilities.reset();
+        capabilitiesVer.clear();
+        infoResponses.clear();
+    }
+
+    // discovery of the server and the own account, once per stream
+    bool serverDiscoveryEnabled = false;
+    std::optional<QXmppDiscoveryManager::ServerDiscovery> serverDiscovery;
+    bool serverDiscoveryRunning = false;
+    // incremented for each discovery, so late responses are ignored
+    uint serverDiscoveryRun = 0;
+    int pendingServerDiscoveryRequests = 0;
+    QXmppDiscoveryManager::ServerDiscovery pendingServerDiscovery;
+    std::vector<QXmppPromise<QXmppDiscoveryManager::ServerDiscovery>> serverDiscoveryPromises;
+
+    // XEP-0115: Entity Capabilities
+    QXmppCapabilitiesMemoryStorage memoryStorage;
+    QXmppCapabilitiesStorage *capabilitiesStorage = &memoryStorage;
+    // requests waiting for the same capabilities
+    QHash<QString, std::vector<CapabilitiesRequest>> capabilitiesRequests;
+
+    // crawling of disco#items
+    int crawlDepth = 1;
+    int maxCrawlRequests = 10;
+    int crawlCacheLifetime = 3600;
+    QHash<QString, std::shared_ptr<Crawl>> crawls;
+    QHash<QString, CachedCrawl> crawlCache;
 };
 
+// Returns the hash algorithm for the name used in XEP-0115.
+static std::optional<QCryptographicHash::Algorithm> capabilitiesHashAlgorithm(const QString &hash)
+{
+    if (hash == u"sha-1") {
+        return QCryptographicHash::Sha1;
+    }
+    if (hash == u"sha-224") {
+        return QCryptographicHash::Sha224;
+    }
+    if (hash == u"sha-256") {
+        return QCryptographicHash::Sha256;
+    }
+    if (hash == u"sha-384") {
+        return QCryptographicHash::Sha384;
+    }
+    if (hash == u"sha-512") {
+        return QCryptographicHash::Sha512;
+    }
+    return {};
+}
+
+static QString capabilitiesQueryNode(const QString &node, const QByteArray &ver)
+{
+    return node + u'#' + QString::fromLatin1(ver.toBase64());
+}
+
 ///
 /// \typedef QXmppDiscoveryManager::InfoResult
 ///
@@ -155,10 +268,567 @@ QXmppTask<QXmppDiscoveryManager::ItemsResult> QXmppDiscoveryManager::requestDisc
     });
 }
 
+///
+/// Requests the capabilities an entity advertised in its presence as defined by
+/// \xep{0115, Entity Capabilities}.
+///
+/// The capabilities are identified by the node, the verification string and
+/// the hash algorithm. If they are already known, the information is taken from
+/// the capabilitiesStorage() without sending a request. Otherwise a disco#info
+/// request is sent and the response is stored if it matches the verification
+/// string. Concurrent requests for the same capabilities share one disco#info
+/// request.
+///
+/// Capabilities with an unsupported hash algorithm are requested every time
+/// and are never stored.
+///
+/// \param jid The entity's JID.
+/// \param node The capabilities node of the entity.
+/// \param ver The verification string (not base64-encoded).
+/// \param hash The name of the hash algorithm (e.g., "sha-1").
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QXmppDiscoveryManager::InfoResult> QXmppDiscoveryManager::requestCapabilities(const QString &jid, const QString &node, const QByteArray &ver, const QString &hash)
+{
+    if (ver.isEmpty() || !capabilitiesHashAlgorithm(hash)) {
+        return requestDiscoInfo(jid, ver.isEmpty() ? node : capabilitiesQueryNode(node, ver));
+    }
+
+    const auto key = hash + u' ' + QString::fromLatin1(ver.toBase64()) + u' ' + node;
+
+    QXmppPromise<InfoResult> promise;
+    auto task = promise.task();
+
+    auto &requests = d->capabilitiesRequests[key];
+    const bool alreadyRequested = !requests.empty();
+    requests.push_back({ jid, std::move(promise) });
+    if (alreadyRequested) {
+        return task;
+    }
+
+    d->capabilitiesStorage->info(node, ver, hash).then(this, [this, key, node, ver, hash](std::optional<QXmppDiscoveryIq> &&info) {
+        if (!info) {
+            const auto &requests = d->capabilitiesRequests[key];
+            fetchCapabilities(key, requests.front().jid, node, ver, hash);
+            return;
+        }
+
+        auto requests = d->capabilitiesRequests.take(key);
+        for (auto &request : requests) {
+            request.promise.finish(InfoResult(*info));
+        }
+    });
+    return task;
+}
+
+///
+/// Requests the capabilities advertised in the presence as defined by
+/// \xep{0115, Entity Capabilities}.
+///
+/// \sa requestCapabilities(const QString &, const QString &, const QByteArray &, const QString &)
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QXmppDiscoveryManager::InfoResult> QXmppDiscoveryManager::requestCapabilities(const QXmppPresence &presence)
+{
+    return requestCapabilities(presence.from(), presence.capabilityNode(), presence.capabilityVer(), presence.capabilityHash());
+}
+
+///
+/// Returns the storage for the information of \xep{0115, Entity Capabilities}.
+///
+/// By default the information is stored in the memory.
+///
+/// \since QXmpp 1.6
+///
+QXmppCapabilitiesStorage *QXmppDiscoveryManager::capabilitiesStorage() const
+{
+    return d->capabilitiesStorage;
+}
+
+///
+/// Sets the storage for the information of \xep{0115, Entity Capabilities}.
+///
+/// The storage is not owned by the manager and must outlive it. Passing
+/// nullptr restores the default memory storage.
+///
+/// \since QXmpp 1.6
+///
+void QXmppDiscoveryManager::setCapabilitiesStorage(QXmppCapabilitiesStorage *storage)
+{
+    d->capabilitiesStorage = storage ? storage : &d->memoryStorage;
+}
+
+void QXmppDiscoveryManager::fetchCapabilities(const QString &key, const QString &jid, const QString &node, const QByteArray &ver, const QString &hash)
+{
+    requestDiscoInfo(jid, capabilitiesQueryNode(node, ver)).then(this, [this, key, jid, node, ver, hash](InfoResult &&result) {
+        if (auto *info = std::get_if<QXmppDiscoveryIq>(&result)) {
+            if (info->verificationString(*capabilitiesHashAlgorithm(hash)) == ver) {
+                auto requests = d->capabilitiesRequests.take(key);
+
+                info->setId({});
+                info->setFrom({});
+                info->setTo({});
+                d->capabilitiesStorage->addInfo(node, ver, hash, *info);
+
+                for (auto &request : requests) {
+                    request.promise.finish(InfoResult(*info));
+                }
+                return;
+            }
+
+            result = QXmppError {
+                QStringLiteral("The service discovery information does not match the verification string."),
+                {}
+            };
+        }
+
+        // fail the requests for this entity and ask the next one
+        auto &requests = d->capabilitiesRequests[key];
+        std::vector<CapabilitiesRequest> failedRequests;
+        for (auto itr = requests.begin(); itr != requests.end();) {
+            if (itr->jid == jid) {
+                failedRequests.push_back(std::move(*itr));
+                itr = requests.erase(itr);
+            } else {
+                ++itr;
+            }
+        }
+
+        if (requests.empty()) {
+            d->capabilitiesRequests.remove(key);
+        } else {
+            fetchCapabilities(key, requests.front().jid, node, ver, hash);
+        }
+
+        for (auto &request : failedRequests) {
+            request.promise.finish(InfoResult(result));
+        }
+    });
+}
+
+///
+/// Returns whether the server and the own account are discovered
+/// automatically after connecting.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppDiscoveryManager::isServerDiscoveryEnabled() const
+{
+    return d->serverDiscoveryEnabled;
+}
+
+///
+/// Sets whether the server and the own account are discovered automatically
+/// after connecting.
+///
+/// If enabled, the disco#info of the server and of the own bare JID and the
+/// disco#items of the server are requested once per stream, and then the
+/// disco#info of all items in parallel. Other managers use this shared result
+/// instead of sending their own requests, e.g. QXmppUploadRequestManager for
+/// finding upload services and QXmppPubSubManager for the features of PEP.
+/// The result is kept when a stream is resumed.
+///
+/// Disabled by default.
+///
+/// \since QXmpp 1.6
+///
+void QXmppDiscoveryManager::setServerDiscoveryEnabled(bool enabled)
+{
+    d->serverDiscoveryEnabled = enabled;
+}
+
+///
+/// Returns the discovery of the server and the own account for the current
+/// stream, or nothing if it has not finished yet.
+///
+/// \since QXmpp 1.6
+///
+std::optional<QXmppDiscoveryManager::ServerDiscovery> QXmppDiscoveryManager::serverDiscovery() const
+{
+    return d->serverDiscovery;
+}
+
+///
+/// Returns the discovery of the server and the own account for the current
+/// stream once it has finished.
+///
+/// The discovery is started if it is not running yet, also if automatic
+/// discovery is disabled. When the client is not connected, it starts after
+/// connecting.
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QXmppDiscoveryManager::ServerDiscovery> QXmppDiscoveryManager::requestServerDiscovery()
+{
+    if (d->serverDiscovery) {
+        return makeReadyTask(ServerDiscovery(*d->serverDiscovery));
+    }
+
+    QXmppPromise<ServerDiscovery> promise;
+    auto task = promise.task();
+    d->serverDiscoveryPromises.push_back(std::move(promise));
+    // otherwise started after connecting
+    if (!d->serverDiscoveryRunning && client()->isAuthenticated()) {
+        startServerDiscovery();
+    }
+    return task;
+}
+
+void QXmppDiscoveryManager::onConnected()
+{
+    if (client()->streamManagementState() == QXmppClient::ResumedStream && d->serverDiscovery) {
+        return;
+    }
+
+    // the server may have changed
+    d->serverDiscovery.reset();
+    if (d->serverDiscoveryEnabled || !d->serverDiscoveryPromises.empty()) {
+        startServerDiscovery();
+    } else {
+        d->serverDiscoveryRunning = false;
+        d->serverDiscoveryRun++;
+    }
+}
+
+void QXmppDiscoveryManager::startServerDiscovery()
+{
+    const auto run = ++d->serverDiscoveryRun;
+    d->serverDiscoveryRunning = true;
+    d->pendingServerDiscovery = {};
+    d->pendingServerDiscoveryRequests = 3;
+
+    const auto domain = client()->configuration().domain();
+    const auto accountJid = client()->configuration().jidBare();
+
+    // the addresses of responses from the server or the account may be empty
+    requestDiscoInfo(domain).then(this, [this, run, domain](InfoResult &&result) {
+        if (run == d->serverDiscoveryRun) {
+            if (auto *iq = std::get_if<QXmppDiscoveryIq>(&result)) {
+                iq->setFrom(domain);
+                d->pendingServerDiscovery.serverInfo = std::move(*iq);
+            }
+            finishServerDiscoveryRequest();
+        }
+    });
+    requestDiscoInfo(accountJid).then(this, [this, run, accountJid](InfoResult &&result) {
+        if (run == d->serverDiscoveryRun) {
+            if (auto *iq = std::get_if<QXmppDiscoveryIq>(&result)) {
+                iq->setFrom(accountJid);
+                d->pendingServerDiscovery.accountInfo = std::move(*iq);
+            }
+            finishServerDiscoveryRequest();
+        }
+    });
+    requestDiscoItems(domain).then(this, [this, run](ItemsResult &&result) {
+        if (run != d->serverDiscoveryRun) {
+            return;
+        }
+        if (auto *items = std::get_if<QList<QXmppDiscoveryIq::Item>>(&result)) {
+            // crawl the items in parallel
+            d->pendingServerDiscoveryRequests += int(items->size());
+            for (const auto &item : std::as_const(*items)) {
+                requestDiscoInfo(item.jid(), item.node()).then(this, [this, run](InfoResult &&result) {
+                    if (run == d->serverDiscoveryRun) {
+                        if (auto *iq = std::get_if<QXmppDiscoveryIq>(&result)) {
+                            d->pendingServerDiscovery.itemsInfo.append(std::move(*iq));
+                        }
+                        finishServerDiscoveryRequest();
+                    }
+                });
+            }
+        }
+        finishServerDiscoveryRequest();
+    });
+}
+
+void QXmppDiscoveryManager::finishServerDiscoveryRequest()
+{
+    if (--d->pendingServerDiscoveryRequests > 0) {
+        return;
+    }
+
+    d->serverDiscoveryRunning = false;
+    d->serverDiscovery = std::exchange(d->pendingServerDiscovery, {});
+    for (auto &promise : std::exchange(d->serverDiscoveryPromises, {})) {
+        promise.finish(ServerDiscovery(*d->serverDiscovery));
+    }
+    Q_EMIT serverDiscoveryFinished();
+}
+
+///
+/// Returns how deep crawl() follows disco#items.
+///
+/// \since QXmpp 1.6
+///
+int QXmppDiscoveryManager::crawlDepth() const
+{
+    return d->crawlDepth;
+}
+
+///
+/// Sets how deep crawl() follows disco#items.
+///
+/// With a depth of 0 only the entity itself is queried, with 1 (the default)
+/// also its items, e.g. the components of a server, and so on.
+///
+/// \since QXmpp 1.6
+///
+void QXmppDiscoveryManager::setCrawlDepth(int depth)
+{
+    d->crawlDepth = std::max(0, depth);
+    d->crawlCache.clear();
+}
+
+///
+/// Returns the maximum number of requests a crawl sends in parallel.
+///
+/// \since QXmpp 1.6
+///
+int QXmppDiscoveryManager::maxCrawlRequests() const
+{
+    return d->maxCrawlRequests;
+}
+
+///
+/// Sets the maximum number of requests a crawl sends in parallel.
+///
+/// The default is 10.
+///
+/// \since QXmpp 1.6
+///
+void QXmppDiscoveryManager::setMaxCrawlRequests(int count)
+{
+    d->maxCrawlRequests = std::max(1, count);
+}
+
+///
+/// Returns the time in seconds the results of crawl() are cached.
+///
+/// \since QXmpp 1.6
+///
+int QXmppDiscoveryManager::crawlCacheLifetime() const
+{
+    return d->crawlCacheLifetime;
+}
+
+///
+/// Sets the time in seconds the results of crawl() are cached.
+///
+/// The results are cached per JID, so e.g. reconnecting to the same server
+/// doesn't crawl it again. 0 disables the cache. The default is one hour.
+///
+/// \since QXmpp 1.6
+///
+void QXmppDiscoveryManager::setCrawlCacheLifetime(int secs)
+{
+    d->crawlCacheLifetime = std::max(0, secs);
+    if (d->crawlCacheLifetime == 0) {
+        d->crawlCache.clear();
+    }
+}
+
+///
+/// Removes all cached results of crawl().
+///
+/// \since QXmpp 1.6
+///
+void QXmppDiscoveryManager::clearCrawlCache()
+{
+    d->crawlCache.clear();
+}
+
+static void continueCrawl(QXmppDiscoveryManager *manager, QXmppDiscoveryManagerPrivate *d, const std::shared_ptr<Crawl> &crawl);
+
+// Queues the requests for an entity that hasn't been visited yet.
+static void visit(Crawl &crawl, const QString &jid, const QString &node, int depth)
+{
+    if (jid.isEmpty() || crawl.visited.contains({ jid, node })) {
+        return;
+    }
+    crawl.visited.insert({ jid, node });
+
+    const auto index = qsizetype(crawl.infos.size());
+    crawl.infos.emplace_back();
+    crawl.queue.push_back({ false, jid, node, depth, index });
+    if (depth < crawl.maxDepth) {
+        crawl.queue.push_back({ true, jid, node, depth, index });
+    }
+}
+
+static void finishCrawlRequest(QXmppDiscoveryManager *manager, QXmppDiscoveryManagerPrivate *d, const std::shared_ptr<Crawl> &crawl)
+{
+    crawl->runningRequests--;
+    if (crawl->runningRequests > 0 || !crawl->queue.empty()) {
+        continueCrawl(manager, d, crawl);
+        return;
+    }
+
+    QVector<QXmppDiscoveryIq> infos;
+    infos.reserve(qsizetype(crawl->infos.size()));
+    for (auto &info : crawl->infos) {
+        if (info) {
+            infos.append(std::move(*info));
+        }
+    }
+
+    if (d->crawls.value(crawl->jid) == crawl) {
+        d->crawls.remove(crawl->jid);
+    }
+    if (d->crawlCacheLifetime > 0 && crawl->maxDepth == d->crawlDepth) {
+        d->crawlCache.insert(crawl->jid, { infos, QDateTime::currentDateTimeUtc().addSecs(d->crawlCacheLifetime) });
+    }
+    for (auto &promise : crawl->promises) {
+        promise.finish(QVector<QXmppDiscoveryIq>(infos));
+    }
+}
+
+static void continueCrawl(QXmppDiscoveryManager *manager, QXmppDiscoveryManagerPrivate *d, const std::shared_ptr<Crawl> &crawl)
+{
+    while (crawl->runningRequests < d->maxCrawlRequests && !crawl->queue.empty()) {
+        const auto request = crawl->queue.front();
+        crawl->queue.pop_front();
+        crawl->runningRequests++;
+
+        if (request.items) {
+            manager->requestDiscoItems(request.jid, request.node).then(manager, [=](QXmppDiscoveryManager::ItemsResult &&result) {
+                if (auto *items = std::get_if<QList<QXmppDiscoveryIq::Item>>(&result)) {
+                    for (const auto &item : std::as_const(*items)) {
+                        visit(*crawl, item.jid(), item.node(), request.depth + 1);
+                    }
+                }
+                finishCrawlRequest(manager, d, crawl);
+            });
+        } else {
+            manager->requestDiscoInfo(request.jid, request.node).then(manager, [=](QXmppDiscoveryManager::InfoResult &&result) {
+                if (auto *iq = std::get_if<QXmppDiscoveryIq>(&result)) {
+                    // the addresses of responses from the server may be empty
+                    iq->setFrom(request.jid);
+                    iq->setQueryNode(request.node);
+                    crawl->infos[request.index] = std::move(*iq);
+                }
+                finishCrawlRequest(manager, d, crawl);
+            });
+        }
+    }
+}
+
+///
+/// Requests the disco#info of an entity and of its disco#items.
+///
+/// The items are followed up to crawlDepth(), at most maxCrawlRequests() are
+/// requested in parallel and each entity, i.e. each pair of JID and node, is
+/// only requested once. Concurrent crawls of the same JID share their
+/// requests and the result is cached for crawlCacheLifetime().
+///
+/// This is useful to find the services of a server, e.g. the upload, MUC or
+/// PubSub services, in one go after connecting, see also requestServices().
+///
+/// \return the disco#info of the entity and of the found items, in the order
+/// of their discovery, without the ones that couldn't be requested
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QVector<QXmppDiscoveryIq>> QXmppDiscoveryManager::crawl(const QString &jid)
+{
+    if (const auto itr = d->crawlCache.constFind(jid); itr != d->crawlCache.cend()) {
+        if (itr->expires > QDateTime::currentDateTimeUtc()) {
+            return makeReadyTask(QVector<QXmppDiscoveryIq>(itr->infos));
+        }
+        d->crawlCache.erase(itr);
+    }
+
+    QXmppPromise<QVector<QXmppDiscoveryIq>> promise;
+    auto task = promise.task();
+
+    if (auto crawl = d->crawls.value(jid)) {
+        crawl->promises.push_back(std::move(promise));
+        return task;
+    }
+
+    auto crawl = std::make_shared<Crawl>();
+    crawl->jid = jid;
+    crawl->maxDepth = d->crawlDepth;
+    crawl->promises.push_back(std::move(promise));
+    d->crawls.insert(jid, crawl);
+
+    visit(*crawl, jid, {}, 0);
+    continueCrawl(this, d.get(), crawl);
+    return task;
+}
+
+///
+/// Crawls an entity and returns the entities with an identity of the given
+/// category and type, e.g. "conference" and "text" for MUC services or
+/// "pubsub" and "service" for PubSub services.
+///
+/// \param jid entity to crawl, e.g. the domain of the server
+/// \param category category of the identity
+/// \param type type of the identity, any type if empty
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QVector<QXmppDiscoveryIq>> QXmppDiscoveryManager::requestServices(const QString &jid, const QString &category, const QString &type)
+{
+    return chain<QVector<QXmppDiscoveryIq>>(crawl(jid), this, [category, type](QVector<QXmppDiscoveryIq> &&infos) {
+        QVector<QXmppDiscoveryIq> services;
+        for (auto &info : infos) {
+            const auto identities = info.identities();
+            if (std::any_of(identities.cbegin(), identities.cend(), [&](const QXmppDiscoveryIq::Identity &identity) {
+                    return identity.category() == category && (type.isEmpty() || identity.type() == type);
+                })) {
+                services.append(std::move(info));
+            }
+        }
+        return services;
+    });
+}
+
+///
+/// Crawls an entity and returns the entities with the given feature, e.g.
+/// "urn:xmpp:http:upload:0" for upload services.
+///
+/// \param jid entity to crawl, e.g. the domain of the server
+/// \param feature feature to look for
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QVector<QXmppDiscoveryIq>> QXmppDiscoveryManager::requestServicesByFeature(const QString &jid, const QString &feature)
+{
+    return chain<QVector<QXmppDiscoveryIq>>(crawl(jid), this, [feature](QVector<QXmppDiscoveryIq> &&infos) {
+        QVector<QXmppDiscoveryIq> services;
+        for (auto &info : infos) {
+            if (info.features().contains(feature)) {
+                services.append(std::move(info));
+            }
+        }
+        return services;
+    });
+}
+
 ///
 /// Returns the client's full capabilities.
 ///
+/// The capabilities are computed once and then reused until extensions are
+/// added to or removed from the client or the client identity is changed.
+///
 QXmppDiscoveryIq QXmppDiscoveryManager::capabilities()
+{
+    const auto generation = client()->d->extensionsGeneration;
+    if (!d->capabilities || d->extensionsGeneration != generation) {
+        d->resetCapabilities();
+        d->capabilities = buildCapabilities();
+        d->extensionsGeneration = generation;
+    }
+    return *d->capabilities;
+}
+
+QXmppDiscoveryIq QXmppDiscoveryManager::buildCapabilities()
 {
     QXmppDiscoveryIq iq;
     iq.setType(QXmppIq::Result);
@@ -176,6 +846,10 @@ QXmppDiscoveryIq QXmppDiscoveryManager::capabilities()
             features << extension->discoveryFeatures();
         }
     }
+    // and of those that have not been created yet
+    for (const auto &lazyExtension : client()->d->lazyExtensions) {
+        features << lazyExtension.info->discoveryFeatures;
+    }
 
     iq.setFeatures(features);
 
@@ -193,6 +867,9 @@ QXmppDiscoveryIq QXmppDiscoveryManager::capabilities()
             identities << extension->discoveryIdentities();
         }
     }
+    for (const auto &lazyExtension : client()->d->lazyExtensions) {
+        identities << lazyExtension.info->discoveryIdentities;
+    }
 
     iq.setIdentities(identities);
 
@@ -204,6 +881,57 @@ QXmppDiscoveryIq QXmppDiscoveryManager::capabilities()
     return iq;
 }
 
+// Returns the XEP-0115 verification string of the own capabilities.
+QByteArray QXmppDiscoveryManager::capabilitiesVerificationString()
+{
+    const auto iq = capabilities();
+    if (d->capabilitiesVer.isEmpty()) {
+        d->capabilitiesVer = iq.verificationString();
+    }
+    return d->capabilitiesVer;
+}
+
+// Answers disco#info queries for the client or its current capabilities
+// node with a cached response.
+bool QXmppDiscoveryManager::answerOwnInfoQuery(const QDomElement &element)
+{
+    if (element.tagName() != u"iq" || element.attribute(QStringLiteral("type")) != u"get") {
+        return false;
+    }
+    const auto query = element.firstChildElement(QStringLiteral("query"));
+    if (query.namespaceURI() != ns_disco_info || !query.nextSiblingElement().isNull()) {
+        return false;
+    }
+
+    const auto node = query.attribute(QStringLiteral("node"));
+    if (!node.isEmpty() && node != capabilitiesQueryNode(d->clientCapabilitiesNode, capabilitiesVerificationString())) {
+        return false;
+    }
+
+    // the response without id and address
+    auto &response = d->infoResponses[node];
+    if (response.isEmpty()) {
+        auto iq = capabilities();
+        iq.setQueryNode(node);
+        QXmlStreamWriter writer(&response);
+        iq.toXml(&writer);
+    }
+
+    const auto id = element.attribute(QStringLiteral("id"));
+    const auto from = element.attribute(QStringLiteral("from"));
+    QByteArray data = "<iq";
+    if (!id.isEmpty()) {
+        data += " id=\"" + id.toHtmlEscaped().toUtf8() + '"';
+    }
+    if (!from.isEmpty()) {
+        data += " to=\"" + from.toHtmlEscaped().toUtf8() + '"';
+    }
+    data.append(response.constData() + 3, response.size() - 3);
+
+    client()->d->stream->send(QXmppPacket(data, true));
+    return true;
+}
+
 /// Sets the capabilities node of the local XMPP client.
 ///
 /// \param node
@@ -211,6 +939,7 @@ QXmppDiscoveryIq QXmppDiscoveryManager::capabilities()
 void QXmppDiscoveryManager::setClientCapabilitiesNode(const QString &node)
 {
     d->clientCapabilitiesNode = node;
+    d->resetCapabilities();
 }
 
 /// Sets the category of the local XMPP client.
@@ -223,6 +952,7 @@ void QXmppDiscoveryManager::setClientCapabilitiesNode(const QString &node)
 void QXmppDiscoveryManager::setClientCategory(const QString &category)
 {
     d->clientCategory = category;
+    d->resetCapabilities();
 }
 
 /// Sets the type of the local XMPP client.
@@ -235,6 +965,7 @@ void QXmppDiscoveryManager::setClientCategory(const QString &category)
 void QXmppDiscoveryManager::setClientType(const QString &type)
 {
     d->clientType = type;
+    d->resetCapabilities();
 }
 
 /// Sets the name of the local XMPP client.
@@ -244,6 +975,7 @@ void QXmppDiscoveryManager::setClientType(const QString &type)
 void QXmppDiscoveryManager::setClientName(const QString &name)
 {
     d->clientName = name;
+    d->resetCapabilities();
 }
 
 /// Returns the capabilities node of the local XMPP client.
@@ -297,6 +1029,7 @@ QXmppDataForm QXmppDiscoveryManager::clientInfoForm() const
 void QXmppDiscoveryManager::setClientInfoForm(const QXmppDataForm &form)
 {
     d->clientInfoForm = form;
+    d->resetCapabilities();
 }
 
 /// \cond
@@ -305,8 +1038,19 @@ QStringList QXmppDiscoveryManager::discoveryFeatures() const
     return QStringList() << ns_disco_info;
 }
 
+QVector<QXmppClientExtension::StanzaFilter> QXmppDiscoveryManager::stanzaFilters() const
+{
+    return {
+        { QStringLiteral("iq"), ns_disco_info },
+        { QStringLiteral("iq"), ns_disco_items },
+    };
+}
+
 bool QXmppDiscoveryManager::handleStanza(const QDomElement &element)
 {
+    if (answerOwnInfoQuery(element)) {
+        return true;
+    }
     if (QXmpp::handleIqRequests<QXmppDiscoveryIq>(element, client(), this)) {
         return true;
     }
@@ -336,6 +1080,16 @@ bool QXmppDiscoveryManager::handleStanza(const QDomElement &element)
     return false;
 }
 
+void QXmppDiscoveryManager::setClient(QXmppClient *client)
+{
+    if (this->client()) {
+        disconnect(this->client(), &QXmppClient::connected, this, &QXmppDiscoveryManager::onConnected);
+    }
+
+    QXmppClientExtension::setClient(client);
+    connect(client, &QXmppClient::connected, this, &QXmppDiscoveryManager::onConnected);
+}
+
 std::variant<QXmppDiscoveryIq, QXmppStanza::Error> QXmppDiscoveryManager::handleIq(QXmppDiscoveryIq &&iq)
 {
     using Error = QXmppStanza::Error;
@@ -8,13 +8,16 @@
 
 #include "QXmppClientExtension.h"
 
+#include <optional>
 #include <variant>
 
 template<typename T>
 class QXmppTask;
+class QXmppCapabilitiesStorage;
 class QXmppDataForm;
 class QXmppDiscoveryIq;
 class QXmppDiscoveryManagerPrivate;
+class QXmppPresence;
 struct QXmppError;
 
 /// \brief The QXmppDiscoveryManager class makes it possible to discover information
@@ -40,6 +43,47 @@ public:
     QXmppTask<InfoResult> requestDiscoInfo(const QString &jid, const QString &node = {});
     QXmppTask<ItemsResult> requestDiscoItems(const QString &jid, const QString &node = {});
 
+    QXmppTask<InfoResult> requestCapabilities(const QString &jid, const QString &node, const QByteArray &ver, const QString &hash);
+    QXmppTask<InfoResult> requestCapabilities(const QXmppPresence &presence);
+
+    ///
+    /// Service discovery information of the server and the own account.
+    ///
+    /// Queries that failed are left default-constructed, i.e. their type is
+    /// not QXmppIq::Result.
+    ///
+    /// \since QXmpp 1.6
+    ///
+    struct ServerDiscovery
+    {
+        /// disco#info of the server domain
+        QXmppDiscoveryIq serverInfo;
+        /// disco#info of the own bare JID, e.g. for PEP
+        QXmppDiscoveryIq accountInfo;
+        /// disco#info of the disco#items of the server domain
+        QVector<QXmppDiscoveryIq> itemsInfo;
+    };
+
+    bool isServerDiscoveryEnabled() const;
+    void setServerDiscoveryEnabled(bool enabled);
+    std::optional<ServerDiscovery> serverDiscovery() const;
+    QXmppTask<ServerDiscovery> requestServerDiscovery();
+
+    int crawlDepth() const;
+    void setCrawlDepth(int depth);
+    int maxCrawlRequests() const;
+    void setMaxCrawlRequests(int count);
+    int crawlCacheLifetime() const;
+    void setCrawlCacheLifetime(int secs);
+    void clearCrawlCache();
+
+    QXmppTask<QVector<QXmppDiscoveryIq>> crawl(const QString &jid);
+    QXmppTask<QVector<QXmppDiscoveryIq>> requestServices(const QString &jid, const QString &category, const QString &type = {});
+    QXmppTask<QVector<QXmppDiscoveryIq>> requestServicesByFeature(const QString &jid, const QString &feature);
+
+    QXmppCapabilitiesStorage *capabilitiesStorage() const;
+    void setCapabilitiesStorage(QXmppCapabilitiesStorage *storage);
+
     QString clientCapabilitiesNode() const;
     void setClientCapabilitiesNode(const QString &);
 
@@ -58,6 +102,7 @@ public:
 
     /// \cond
     QStringList discoveryFeatures() const override;
+    QVector<StanzaFilter> stanzaFilters() const override;
     bool handleStanza(const QDomElement &element) override;
     std::variant<QXmppDiscoveryIq, QXmppStanza::Error> handleIq(QXmppDiscoveryIq &&iq);
     /// \endcond
@@ -69,8 +114,29 @@ Q_SIGNALS:
     /// This signal is emitted when an items response is received.
     void itemsReceived(const QXmppDiscoveryIq &);
 
+    /// Emitted when the discovery of the server and the own account for the
+    /// current stream has finished.
+    ///
+    /// \since QXmpp 1.6
+    void serverDiscoveryFinished();
+
+protected:
+    /// \cond
+    void setClient(QXmppClient *client) override;
+    /// \endcond
+
 private:
+    QXmppDiscoveryIq buildCapabilities();
+    QByteArray capabilitiesVerificationString();
+    bool answerOwnInfoQuery(const QDomElement &element);
+    void onConnected();
+    void startServerDiscovery();
+    void finishServerDiscoveryRequest();
+    void fetchCapabilities(const QString &key, const QString &jid, const QString &node, const QByteArray &ver, const QString &hash);
+
     const std::unique_ptr<QXmppDiscoveryManagerPrivate> d;
+
+    friend class QXmppClientPrivate;
 };
 
 #endif  // QXMPPDISCOVERYMANAGER_H
@@ -70,6 +70,13 @@ QStringList QXmppEntityTimeManager::discoveryFeatures() const
     return QStringList() << ns_entity_time;
 }
 
+QVector<QXmppClientExtension::StanzaFilter> QXmppEntityTimeManager::stanzaFilters() const
+{
+    return {
+        { QStringLiteral("iq"), ns_entity_time },
+    };
+}
+
 bool QXmppEntityTimeManager::handleStanza(const QDomElement &element)
 {
     if (QXmpp::handleIqRequests<QXmppEntityTimeIq>(element, client(), this)) {
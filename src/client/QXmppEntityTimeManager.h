@@ -33,6 +33,7 @@ public:
 
     /// \cond
     QStringList discoveryFeatures() const override;
+    QVector<StanzaFilter> stanzaFilters() const override;
     bool handleStanza(const QDomElement &element) override;
     std::variant<QXmppEntityTimeIq, QXmppStanza::Error> handleIq(QXmppEntityTimeIq iq);
     /// \endcond
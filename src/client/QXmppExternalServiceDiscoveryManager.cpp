@@ -7,10 +7,60 @@
 #include "QXmppClient.h"
 #include "QXmppConstants_p.h"
 #include "QXmppExternalServiceDiscoveryIq.h"
+#include "QXmppFutureUtils_p.h"
 #include "QXmppIqHandling.h"
+#include "QXmppPromise.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <QDateTime>
+#include <QHash>
+#include <QTimer>
 
 using namespace QXmpp::Private;
 
+// time in ms for which services without an expiry are cached
+constexpr qint64 DEFAULT_CACHE_TIME = 5 * 60 * 1000;
+// time in ms before the expiry at which used services are refreshed
+constexpr qint64 REFRESH_MARGIN = 60 * 1000;
+
+using ServicesResult = QXmppExternalServiceDiscoveryManager::ServicesResult;
+using CacheKey = QPair<QString, QString>;
+
+struct ExternalServicesCacheEntry
+{
+    QVector<QXmppExternalService> services;
+    // end of the validity of the services, invalid until they have been
+    // received
+    QDateTime expires;
+    // whether the services have been requested since they were received
+    bool used = false;
+    bool fetching = false;
+    std::vector<QXmppPromise<ServicesResult>> promises;
+    // refreshes the services or removes them when they expire
+    QTimer *timer = nullptr;
+};
+
+class QXmppExternalServiceDiscoveryManagerPrivate
+{
+public:
+    QHash<CacheKey, ExternalServicesCacheEntry> cache;
+};
+
+// Returns when the first of the services expires.
+static QDateTime servicesExpiry(const QVector<QXmppExternalService> &services)
+{
+    auto expires = QDateTime::currentDateTimeUtc().addMSecs(DEFAULT_CACHE_TIME);
+    for (const auto &service : services) {
+        if (const auto serviceExpires = service.expires(); serviceExpires && serviceExpires->isValid()) {
+            expires = std::min(expires, serviceExpires->toUTC());
+        }
+    }
+    return expires;
+}
+
 ///
 /// \brief The QXmppExternalServiceDiscoveryManager class makes it possible to
 /// discover information about external services from providers
@@ -23,11 +73,17 @@ using namespace QXmpp::Private;
 /// auto *manager = client->addNewExtension<QXmppExternalServiceDiscoveryManager>();
 /// \endcode
 ///
+/// The received services are cached until the first of them expires. Services
+/// that have been requested again are refreshed in the background shortly
+/// before they expire, so e.g. TURN credentials are available without a round
+/// trip when a call is started.
+///
 /// \ingroup Managers
 ///
 /// \since QXmpp 1.6
 ///
 QXmppExternalServiceDiscoveryManager::QXmppExternalServiceDiscoveryManager()
+    : d(std::make_unique<QXmppExternalServiceDiscoveryManagerPrivate>())
 {
 }
 
@@ -36,6 +92,10 @@ QXmppExternalServiceDiscoveryManager::~QXmppExternalServiceDiscoveryManager() =
 ///
 /// Requests external services from the specified XMPP entity.
 ///
+/// Services that have been received before and haven't expired yet are
+/// returned from the cache. Concurrent requests for the same entity share one
+/// IQ.
+///
 /// \param jid  The target entity's JID.
 /// \param node The target node (optional).
 ///
@@ -43,15 +103,145 @@ QXmppExternalServiceDiscoveryManager::~QXmppExternalServiceDiscoveryManager() =
 ///
 QXmppTask<QXmppExternalServiceDiscoveryManager::ServicesResult> QXmppExternalServiceDiscoveryManager::requestServices(const QString &jid, const QString &node)
 {
+    auto &entry = d->cache[qMakePair(jid, node)];
+    if (entry.expires.isValid() && entry.expires > QDateTime::currentDateTimeUtc()) {
+        entry.used = true;
+        return makeReadyTask(ServicesResult(entry.services));
+    }
+
+    QXmppPromise<ServicesResult> promise;
+    auto task = promise.task();
+    entry.promises.push_back(std::move(promise));
+    if (!entry.fetching) {
+        fetchServices(jid, node);
+    }
+    return task;
+}
+
+///
+/// Returns the cached services of an entity, if they haven't expired yet.
+///
+/// This doesn't count as a use of the services, i.e. they are not refreshed
+/// in the background because of it.
+///
+/// \param jid  The entity's JID.
+/// \param node The node (optional).
+///
+/// \since QXmpp 1.6
+///
+std::optional<QVector<QXmppExternalService>> QXmppExternalServiceDiscoveryManager::cachedServices(const QString &jid, const QString &node) const
+{
+    const auto itr = d->cache.constFind(qMakePair(jid, node));
+    if (itr == d->cache.cend() || !itr->expires.isValid() || itr->expires <= QDateTime::currentDateTimeUtc()) {
+        return {};
+    }
+    return itr->services;
+}
+
+///
+/// Removes all cached services and stops their refreshes.
+///
+/// Running requests are not affected.
+///
+/// \since QXmpp 1.6
+///
+void QXmppExternalServiceDiscoveryManager::clearCache()
+{
+    for (auto itr = d->cache.begin(); itr != d->cache.end();) {
+        delete itr->timer;
+        itr->timer = nullptr;
+        if (itr->fetching) {
+            itr->services.clear();
+            itr->expires = {};
+            itr->used = false;
+            ++itr;
+        } else {
+            itr = d->cache.erase(itr);
+        }
+    }
+}
+
+void QXmppExternalServiceDiscoveryManager::fetchServices(const QString &jid, const QString &node)
+{
+    d->cache[qMakePair(jid, node)].fetching = true;
+
     QXmppExternalServiceDiscoveryIq request;
     request.setType(QXmppIq::Get);
     request.setTo(jid);
 
-    return chainIq(client()->sendIq(std::move(request)), this, [](QXmppExternalServiceDiscoveryIq &&iq) -> ServicesResult {
+    chainIq(client()->sendIq(std::move(request)), this, [](QXmppExternalServiceDiscoveryIq &&iq) -> ServicesResult {
         return iq.externalServices();
+    }).then(this, [this, jid, node](ServicesResult &&result) {
+        const auto key = qMakePair(jid, node);
+        auto itr = d->cache.find(key);
+        if (itr == d->cache.end()) {
+            return;
+        }
+
+        itr->fetching = false;
+        auto promises = std::move(itr->promises);
+        itr->promises.clear();
+
+        const auto now = QDateTime::currentDateTimeUtc();
+        if (const auto *services = std::get_if<QVector<QXmppExternalService>>(&result)) {
+            itr->services = *services;
+            itr->expires = servicesExpiry(*services);
+            itr->used = !promises.empty();
+        }
+
+        if (itr->expires.isValid() && itr->expires > now) {
+            // refreshed shortly before the expiry, if the services are used
+            const auto lifetime = now.msecsTo(itr->expires);
+            if (!itr->timer) {
+                itr->timer = new QTimer(this);
+                itr->timer->setSingleShot(true);
+                connect(itr->timer, &QTimer::timeout, this, [this, jid, node] {
+                    handleCacheTimeout(jid, node);
+                });
+            }
+            itr->timer->start(int(std::min<qint64>(lifetime - std::min(REFRESH_MARGIN, lifetime / 5), std::numeric_limits<int>::max())));
+        } else {
+            // failed or already expired, the entry is removed
+            delete itr->timer;
+            d->cache.erase(itr);
+        }
+
+        if (const auto *services = std::get_if<QVector<QXmppExternalService>>(&result)) {
+            Q_EMIT servicesReceived(jid, node, *services);
+        }
+        for (auto &promise : promises) {
+            promise.finish(ServicesResult(result));
+        }
     });
 }
 
+void QXmppExternalServiceDiscoveryManager::handleCacheTimeout(const QString &jid, const QString &node)
+{
+    auto itr = d->cache.find(qMakePair(jid, node));
+    if (itr == d->cache.end()) {
+        return;
+    }
+
+    const auto now = QDateTime::currentDateTimeUtc();
+    if (!itr->expires.isValid() || itr->expires <= now) {
+        if (itr->fetching) {
+            // the refresh is still running
+            itr->used = false;
+            return;
+        }
+        delete itr->timer;
+        d->cache.erase(itr);
+        return;
+    }
+
+    if (itr->used && !itr->fetching && client()->isConnected()) {
+        itr->used = false;
+        fetchServices(jid, node);
+    }
+    // removed at the expiry, unless the refresh succeeds before
+    itr->timer->start(int(std::min<qint64>(now.msecsTo(itr->expires), std::numeric_limits<int>::max())));
+}
+
 /// \cond
 QStringList QXmppExternalServiceDiscoveryManager::discoveryFeatures() const
 {
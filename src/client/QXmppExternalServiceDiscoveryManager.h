@@ -10,10 +10,14 @@
 #include "QXmppExternalService.h"
 #include "QXmppTask.h"
 
+#include <memory>
+#include <optional>
 #include <variant>
 
 class QDateTime;
 class QXmppExternalServicePrivate;
+class QXmppExternalServiceDiscoveryManagerPrivate;
+
 class QXMPP_EXPORT QXmppExternalServiceDiscoveryManager : public QXmppClientExtension
 {
     Q_OBJECT
@@ -26,9 +30,26 @@ public:
 
     QXmppTask<ServicesResult> requestServices(const QString &jid, const QString &node = {});
 
+    std::optional<QVector<QXmppExternalService>> cachedServices(const QString &jid, const QString &node = {}) const;
+    void clearCache();
+
     /// \cond
     QStringList discoveryFeatures() const override;
     /// \endcond
+
+    ///
+    /// Emitted when services have been received from an entity, including
+    /// the refreshes of cached services before they expire.
+    ///
+    /// \since QXmpp 1.6
+    ///
+    Q_SIGNAL void servicesReceived(const QString &jid, const QString &node, const QVector<QXmppExternalService> &services);
+
+private:
+    void fetchServices(const QString &jid, const QString &node);
+    void handleCacheTimeout(const QString &jid, const QString &node);
+
+    const std::unique_ptr<QXmppExternalServiceDiscoveryManagerPrivate> d;
 };
 
 #endif  // QXMPPEXTERNALSERVICEDISCOVERYMANAGER_H
@@ -14,6 +14,8 @@ using namespace QCA;
 constexpr std::size_t AES128_BLOCK_SIZE = 128 / 8;
 constexpr std::size_t AES256_BLOCK_SIZE = 256 / 8;
 constexpr int GCM_IV_SIZE = 12;
+// encrypted data is collected and decrypted in blocks of this size
+constexpr qint64 DECRYPTION_BLOCK_SIZE = 256 * 1024;
 
 namespace QXmpp::Private::Encryption {
 
@@ -147,8 +149,6 @@ EncryptionDevice::EncryptionDevice(std::unique_ptr<QIODevice> input,
     // output must not be sequential
     Q_ASSERT(!m_input->isSequential());
 
-    Q_ASSERT(m_outputBuffer.empty());
-
     setOpenMode(m_input->openMode() & QIODevice::ReadOnly);
 
     Q_ASSERT(m_cipher->validKeyLength(int(key.length())));
@@ -188,51 +188,46 @@ qint64 EncryptionDevice::size() const
 
 qint64 EncryptionDevice::readData(char *data, qint64 len)
 {
-    auto requestedLen = len;
     qint64 read = 0;
 
-    {
-        // try to read from output buffer
-        qint64 outputBufferRead = std::min(qint64(m_outputBuffer.size()), len);
-        std::copy_n(m_outputBuffer.cbegin(), outputBufferRead, data);
-        m_outputBuffer.erase(m_outputBuffer.begin(), m_outputBuffer.begin() + outputBufferRead);
-        read += outputBufferRead;
-        len -= outputBufferRead;
-    }
-
-    if (len > 0) {
-        // read from input and encrypt new data
+    while (read < len) {
+        // copy already encrypted data
+        if (m_outputOffset < m_outputBuffer.size()) {
+            auto outputBufferRead = std::min(qint64(m_outputBuffer.size() - m_outputOffset), len - read);
+            std::copy_n(m_outputBuffer.constData() + m_outputOffset, outputBufferRead, data + read);
+            m_outputOffset += outputBufferRead;
+            read += outputBufferRead;
+            continue;
+        }
 
-        // output buffer is empty here
-        Q_ASSERT(m_outputBuffer.empty());
+        if (m_finalized) {
+            break;
+        }
 
-        // read unencrypted data (may read one block more than needed)
-        auto inputBufferSize = roundUpToBlockSize(len, blockSize(m_cipherConfig));
+        // read unencrypted data (may read one block more than needed), the
+        // input buffer is reused for all reads
+        auto inputBufferSize = roundUpToBlockSize(len - read, blockSize(m_cipherConfig));
         Q_ASSERT(inputBufferSize > 0);
-        QByteArray inputBuffer;
-        inputBuffer.resize(inputBufferSize);
-        inputBuffer.resize(m_input->read(inputBuffer.data(), inputBufferSize));
+        if (std::size_t(m_inputBuffer.size()) < inputBufferSize) {
+            m_inputBuffer.resize(qsizetype(inputBufferSize));
+        }
+        auto inputRead = m_input->read(m_inputBuffer.data(), inputBufferSize);
+        if (inputRead < 0) {
+            return read > 0 ? read : -1;
+        }
 
-        // process input buffer
-        auto processed = m_cipher->update(MemoryRegion(inputBuffer));
+        // process input buffer without copying it
+        m_outputBuffer = m_cipher->update(MemoryRegion(QByteArray::fromRawData(m_inputBuffer.constData(), qsizetype(inputRead)))).toByteArray();
+        m_outputOffset = 0;
         if (m_input->atEnd()) {
             m_finalized = true;
-            processed = processed + m_cipher->final();
+            m_outputBuffer.append(m_cipher->final().toByteArray());
+        } else if (inputRead == 0) {
+            // no data available
+            break;
         }
-
-        // split up into part for user and put rest into output buffer
-        auto processedReadBytes = std::min(qint64(processed.size()), len);
-        std::copy_n(processed.constData(), processedReadBytes, data + read);
-        read += processedReadBytes;
-        len -= processedReadBytes;
-
-        Q_ASSERT(processed.size() >= processedReadBytes);
-        auto restBytes = size_t(processed.size() - processedReadBytes);
-        m_outputBuffer.resize(restBytes);
-        std::copy_n(processed.constData() + processedReadBytes, restBytes, m_outputBuffer.data());
     }
 
-    Q_ASSERT((len + read) == requestedLen);
     return read;
 }
 
@@ -243,7 +238,7 @@ qint64 EncryptionDevice::writeData(const char *, qint64)
 
 bool EncryptionDevice::atEnd() const
 {
-    return m_finalized && m_outputBuffer.empty();
+    return m_finalized && m_outputOffset >= m_outputBuffer.size();
 }
 
 DecryptionDevice::DecryptionDevice(std::unique_ptr<QIODevice> input,
@@ -263,8 +258,6 @@ DecryptionDevice::DecryptionDevice(std::unique_ptr<QIODevice> input,
     // output must not be sequential
     Q_ASSERT(!m_output->isSequential());
 
-    Q_ASSERT(m_outputBuffer.empty());
-
     setOpenMode(m_output->openMode() & QIODevice::WriteOnly);
 
     Q_ASSERT(m_cipher->validKeyLength(int(key.length())));
@@ -301,13 +294,51 @@ qint64 DecryptionDevice::readData(char *, qint64)
 
 qint64 DecryptionDevice::writeData(const char *data, qint64 len)
 {
-    auto decrypted = m_cipher->update(QByteArray(data, len));
-    m_output->write(decrypted.constData(), decrypted.size());
+    if (m_finished) {
+        return -1;
+    }
+
+    // large writes are decrypted directly
+    if (m_inputBuffer.isEmpty() && len >= DECRYPTION_BLOCK_SIZE) {
+        const auto aligned = len - len % qint64(blockSize(m_cipherConfig));
+        if (!decrypt(data, aligned)) {
+            return -1;
+        }
+        m_inputBuffer.append(data + aligned, qsizetype(len - aligned));
+        return len;
+    }
+
+    // small writes are collected, so the cipher and the output get large blocks
+    m_inputBuffer.append(data, qsizetype(len));
+    if (m_inputBuffer.size() >= DECRYPTION_BLOCK_SIZE) {
+        const auto aligned = m_inputBuffer.size() - m_inputBuffer.size() % qsizetype(blockSize(m_cipherConfig));
+        if (!decrypt(m_inputBuffer.constData(), aligned)) {
+            return -1;
+        }
+        m_inputBuffer.remove(0, aligned);
+    }
     return len;
 }
 
+bool DecryptionDevice::decrypt(const char *data, qint64 len)
+{
+    // the cipher reads the data directly, it doesn't need to be copied
+    auto decrypted = m_cipher->update(MemoryRegion(QByteArray::fromRawData(data, qsizetype(len))));
+    return m_output->write(decrypted.constData(), decrypted.size()) == decrypted.size();
+}
+
 void DecryptionDevice::finish()
 {
+    if (m_finished) {
+        return;
+    }
+    m_finished = true;
+
+    if (!m_inputBuffer.isEmpty()) {
+        decrypt(m_inputBuffer.constData(), m_inputBuffer.size());
+        m_inputBuffer.clear();
+    }
+
     switch (m_cipherConfig) {
     case Aes128GcmNoPad:
     case Aes256GcmNoPad:
@@ -46,7 +46,11 @@ public:
 private:
     Cipher m_cipherConfig;
     bool m_finalized = false;
-    std::vector<char> m_outputBuffer;
+    // reused for reading the input
+    QByteArray m_inputBuffer;
+    // encrypted data that has not been read yet starts at m_outputOffset
+    QByteArray m_outputBuffer;
+    qint64 m_outputOffset = 0;
     std::unique_ptr<QIODevice> m_input;
     std::unique_ptr<QCA::Cipher> m_cipher;
 };
@@ -66,8 +70,12 @@ public:
     void finish();
 
 private:
+    bool decrypt(const char *data, qint64 len);
+
     Cipher m_cipherConfig;
-    std::vector<char> m_outputBuffer;
+    bool m_finished = false;
+    // encrypted data that is decrypted once a large block has been collected
+    QByteArray m_inputBuffer;
     std::unique_ptr<QIODevice> m_output;
     std::unique_ptr<QCA::Cipher> m_cipher;
 };
@@ -16,16 +16,21 @@
 #include "QXmppUploadRequestManager.h"
 #include "QXmppUtils_p.h"
 
+#include <algorithm>
 #include <any>
+#include <deque>
+#include <list>
 #include <unordered_map>
 #include <utility>
 
+#include <QDateTime>
 #include <QFile>
 #include <QFileInfo>
 #include <QFutureInterface>
 #include <QMimeDatabase>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
+#include <QThread>
 
 using namespace QXmpp;
 using namespace QXmpp::Private;
@@ -33,14 +38,11 @@ using namespace QXmpp::Private;
 using MetadataGenerator = QXmppFileSharingManager::MetadataGenerator;
 using MetadataGeneratorResult = QXmppFileSharingManager::MetadataGeneratorResult;
 
-// The manager generates a hash with each hash algorithm
+// The manager generates a hash with each hash algorithm. SHA-256 is supported
+// by every client, BLAKE3 is preferred by those that know it.
 static std::vector<HashAlgorithm> hashAlgorithms()
 {
-#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-    return { HashAlgorithm::Sha256, HashAlgorithm::Blake2b_256 };
-#else
-    return { HashAlgorithm::Sha256, HashAlgorithm::Sha3_256 };
-#endif
+    return { HashAlgorithm::Sha256, HashAlgorithm::Blake3 };
 }
 
 template<typename T, typename Converter>
@@ -65,6 +67,7 @@ public:
     std::any source;
     quint64 bytesSent = 0;
     quint64 bytesTotal = 0;
+    ProgressThrottle progressThrottle;
     bool finished = false;
     bool cancelled = false;
     bool success = false;
@@ -158,6 +161,53 @@ quint64 QXmppFileUpload::bytesTotal() const
     return d->bytesTotal;
 }
 
+///
+/// Returns the fraction of the total size by which the upload needs to
+/// advance before progressChanged() is emitted again.
+///
+/// \since QXmpp 1.6
+///
+float QXmppFileUpload::progressGranularity() const
+{
+    return d->progressThrottle.granularity();
+}
+
+///
+/// Sets the fraction of the total size by which the upload needs to advance
+/// before progressChanged() is emitted again, e.g. 0.01 for every percent.
+///
+/// The default is 0, which reports every change. The start and the end of
+/// the upload are always reported.
+///
+/// \since QXmpp 1.6
+///
+void QXmppFileUpload::setProgressGranularity(float granularity)
+{
+    d->progressThrottle.setGranularity(granularity);
+}
+
+///
+/// Returns the minimum time in milliseconds between two emissions of
+/// progressChanged().
+///
+/// \since QXmpp 1.6
+///
+int QXmppFileUpload::progressInterval() const
+{
+    return d->progressThrottle.interval();
+}
+
+///
+/// Sets the minimum time in milliseconds between two emissions of
+/// progressChanged(). The default is 0, which does not limit the rate.
+///
+/// \since QXmpp 1.6
+///
+void QXmppFileUpload::setProgressInterval(int msecs)
+{
+    d->progressThrottle.setInterval(msecs);
+}
+
 ///
 /// \brief Returns the result of the upload.
 ///
@@ -213,6 +263,7 @@ public:
     QXmppFileDownload::Result result;
     quint64 bytesReceived = 0;
     quint64 bytesTotal = 0;
+    ProgressThrottle progressThrottle;
     bool finished = false;
 };
 
@@ -300,6 +351,54 @@ quint64 QXmppFileDownload::bytesTotal() const
     return d->bytesTotal;
 }
 
+///
+/// Returns the fraction of the total size by which the download needs to
+/// advance before progressChanged() is emitted again.
+///
+/// \since QXmpp 1.6
+///
+float QXmppFileDownload::progressGranularity() const
+{
+    return d->progressThrottle.granularity();
+}
+
+///
+/// Sets the fraction of the total size by which the download needs to
+/// advance before progressChanged() is emitted again, e.g. 0.01 for every
+/// percent.
+///
+/// The default is 0, which reports every change. The start and the end of
+/// the download are always reported.
+///
+/// \since QXmpp 1.6
+///
+void QXmppFileDownload::setProgressGranularity(float granularity)
+{
+    d->progressThrottle.setGranularity(granularity);
+}
+
+///
+/// Returns the minimum time in milliseconds between two emissions of
+/// progressChanged().
+///
+/// \since QXmpp 1.6
+///
+int QXmppFileDownload::progressInterval() const
+{
+    return d->progressThrottle.interval();
+}
+
+///
+/// Sets the minimum time in milliseconds between two emissions of
+/// progressChanged(). The default is 0, which does not limit the rate.
+///
+/// \since QXmpp 1.6
+///
+void QXmppFileDownload::setProgressInterval(int msecs)
+{
+    d->progressThrottle.setInterval(msecs);
+}
+
 ///
 /// \brief Returns the result of the download.
 ///
@@ -326,7 +425,9 @@ void QXmppFileDownload::reportProgress(quint64 bytesReceived, quint64 bytesTotal
 {
     d->bytesReceived = bytesReceived;
     d->bytesTotal = bytesTotal;
-    Q_EMIT progressChanged();
+    if (d->progressThrottle.shouldReport(bytesReceived, bytesTotal)) {
+        Q_EMIT progressChanged();
+    }
 }
 
 void QXmppFileDownload::reportFinished(Result result)
@@ -336,15 +437,89 @@ void QXmppFileDownload::reportFinished(Result result)
     Q_EMIT finished();
 }
 
+// seconds for which uploaded files are reused by default
+constexpr int DEFAULT_UPLOAD_CACHE_LIFETIME = 24 * 60 * 60;
+
+// A file that has been uploaded and can be shared again without uploading it.
+struct CachedUpload
+{
+    std::weak_ptr<QXmppFileSharingProvider> provider;
+    QString filePath;
+    qint64 size;
+    QDateTime lastModified;
+    QDateTime expiry;
+    QXmppFileMetadata metadata;
+    QXmppBitsOfBinaryDataList dataBlobs;
+    std::any source;
+};
+
+using UploadCache = std::list<CachedUpload>;
+
+// Returns whether a strong hash of the cached file matches the hashes.
+static bool hashesMatch(const QVector<QXmppHash> &cached, const std::vector<QXmppHash> &hashes)
+{
+    return std::any_of(cached.begin(), cached.end(), [&](const QXmppHash &cachedHash) {
+        return isHashingAlgorithmSecure(cachedHash.algorithm()) &&
+            std::any_of(hashes.begin(), hashes.end(), [&](const QXmppHash &hash) {
+                   return hash.algorithm() == cachedHash.algorithm() && hash.hash() == cachedHash.hash();
+               });
+    });
+}
+
 class QXmppFileSharingManagerPrivate
 {
 public:
+    template<typename Predicate>
+    UploadCache::iterator findUpload(const std::shared_ptr<QXmppFileSharingProvider> &provider, Predicate matches);
+    void cacheUpload(CachedUpload &&upload);
+
     MetadataGenerator metadataGenerator = [](std::unique_ptr<QIODevice>) -> QFuture<std::shared_ptr<MetadataGeneratorResult>> {
         return makeReadyFuture(std::make_shared<MetadataGeneratorResult>());
     };
     std::unordered_map<std::type_index, std::shared_ptr<QXmppFileSharingProvider>> providers;
+
+    // uploads waiting for a metadata job
+    std::deque<std::function<void()>> queuedUploads;
+    int metadataJobs = 0;
+    int maxMetadataJobs = std::max(1, QThread::idealThreadCount());
+
+    // the most recently used upload last
+    UploadCache uploadCache;
+    int uploadCacheSize = 0;
+    int uploadCacheLifetime = DEFAULT_UPLOAD_CACHE_LIFETIME;
 };
 
+// Returns the cached upload of the provider that matches, or the end of the
+// cache. Expired uploads are removed.
+template<typename Predicate>
+UploadCache::iterator QXmppFileSharingManagerPrivate::findUpload(const std::shared_ptr<QXmppFileSharingProvider> &provider, Predicate matches)
+{
+    const auto now = QDateTime::currentDateTimeUtc();
+    for (auto itr = uploadCache.begin(); itr != uploadCache.end();) {
+        if (itr->expiry <= now || itr->provider.expired()) {
+            itr = uploadCache.erase(itr);
+        } else if (itr->provider.lock() == provider && matches(*itr)) {
+            // move to the back
+            uploadCache.splice(uploadCache.end(), uploadCache, itr);
+            return std::prev(uploadCache.end());
+        } else {
+            ++itr;
+        }
+    }
+    return uploadCache.end();
+}
+
+void QXmppFileSharingManagerPrivate::cacheUpload(CachedUpload &&upload)
+{
+    if (uploadCacheSize <= 0) {
+        return;
+    }
+    uploadCache.push_back(std::move(upload));
+    while (uploadCache.size() > std::size_t(uploadCacheSize)) {
+        uploadCache.pop_front();
+    }
+}
+
 ///
 /// \class QXmppFileSharingProvider
 ///
@@ -391,8 +566,110 @@ void QXmppFileSharingManager::setMetadataGenerator(MetadataGenerator &&generator
     d->metadataGenerator = std::move(generator);
 }
 
+///
+/// Returns the maximum number of files for which metadata is generated at the
+/// same time.
+///
+/// \since QXmpp 1.6
+///
+int QXmppFileSharingManager::maxMetadataJobs() const
+{
+    return d->maxMetadataJobs;
+}
+
+///
+/// Sets the maximum number of files for which metadata is generated at the
+/// same time.
+///
+/// Generating thumbnails needs to decode the files, which takes a lot of memory
+/// when many files are uploaded at once, e.g. an album of photos. Further
+/// uploads are queued and start, in order, once the metadata of a previous
+/// upload has been generated. This way, the files aren't opened or uploaded
+/// before their metadata can be generated.
+///
+/// The default is the number of CPU cores.
+///
+/// \since QXmpp 1.6
+///
+void QXmppFileSharingManager::setMaxMetadataJobs(int jobs)
+{
+    d->maxMetadataJobs = std::max(1, jobs);
+    startQueuedUploads();
+}
+
+///
+/// Returns the number of uploaded files that are remembered to be shared again
+/// without uploading them.
+///
+/// \since QXmpp 1.6
+///
+int QXmppFileSharingManager::uploadCacheSize() const
+{
+    return d->uploadCacheSize;
+}
+
+///
+/// Sets the number of uploaded files that are remembered to be shared again
+/// without uploading them, e.g. when the same file is sent to many chats.
+///
+/// When a file is uploaded with the same provider again, uploadFile() reuses
+/// the sources of the previous upload, including the encryption key of
+/// encrypted uploads. Files are recognized by their path, size and
+/// modification date. Files at other paths are hashed first if a file of the
+/// same size has been uploaded, and are reused if the hashes match.
+///
+/// The default is 0, which disables the cache.
+///
+/// \since QXmpp 1.6
+///
+void QXmppFileSharingManager::setUploadCacheSize(int size)
+{
+    d->uploadCacheSize = size;
+    while (d->uploadCache.size() > std::size_t(std::max(size, 0))) {
+        d->uploadCache.pop_front();
+    }
+}
+
+///
+/// Returns the number of seconds for which uploaded files are reused.
+///
+/// \since QXmpp 1.6
+///
+int QXmppFileSharingManager::uploadCacheLifetime() const
+{
+    return d->uploadCacheLifetime;
+}
+
+///
+/// Sets the number of seconds for which uploaded files are reused.
+///
+/// This should not exceed the time for which the upload service keeps the
+/// files. The default is one day.
+///
+/// \since QXmpp 1.6
+///
+void QXmppFileSharingManager::setUploadCacheLifetime(int secs)
+{
+    d->uploadCacheLifetime = secs;
+}
+
+///
+/// Forgets all uploaded files, so they are uploaded again when they are
+/// shared.
+///
+/// \since QXmpp 1.6
+///
+void QXmppFileSharingManager::clearUploadCache()
+{
+    d->uploadCache.clear();
+}
+
 ///
 /// \brief Upload a file in a way that it can be attached to a message.
+///
+/// If the upload cache is enabled and the file has already been uploaded with
+/// the provider, the previous upload is reused, see setUploadCacheSize().
+///
 /// \param provider The provider class decides how the file is uploaded
 /// \param filePath Path to a file that should be uploaded
 /// \param description Optional description of the file
@@ -410,6 +687,118 @@ std::shared_ptr<QXmppFileUpload> QXmppFileSharingManager::uploadFile(std::shared
     std::shared_ptr<QXmppFileUpload> upload(new QXmppFileUpload());
     upload->d->metadata = std::move(metadata);
 
+    if (d->uploadCacheSize <= 0) {
+        startUpload(upload, provider, fileInfo);
+        return upload;
+    }
+
+    // shares the file of a previous upload
+    auto reuseUpload = [this, upload](const CachedUpload &cached) {
+        auto &metadata = upload->d->metadata;
+        metadata.setHashes(cached.metadata.hashes());
+        metadata.setWidth(cached.metadata.width());
+        metadata.setHeight(cached.metadata.height());
+        metadata.setLength(cached.metadata.length());
+        metadata.setThumbnails(cached.metadata.thumbnails());
+        upload->d->dataBlobs = cached.dataBlobs;
+        upload->d->source = cached.source;
+        upload->d->bytesSent = cached.size;
+        upload->d->bytesTotal = cached.size;
+        upload->d->success = true;
+
+        // the caller can only connect to the signals after uploadFile() returned
+        QMetaObject::invokeMethod(
+            this, [upload] {
+                Q_EMIT upload->progressChanged();
+                upload->reportFinished();
+            },
+            Qt::QueuedConnection);
+    };
+
+    const auto absolutePath = fileInfo.absoluteFilePath();
+    const auto size = fileInfo.size();
+    const auto lastModified = fileInfo.lastModified();
+    auto cached = d->findUpload(provider, [&](const CachedUpload &entry) {
+        return entry.filePath == absolutePath && entry.size == size && entry.lastModified == lastModified;
+    });
+    if (cached != d->uploadCache.end()) {
+        reuseUpload(*cached);
+        return upload;
+    }
+
+    auto sameSize = d->findUpload(provider, [&](const CachedUpload &entry) {
+        return entry.size == size;
+    });
+    if (sameSize == d->uploadCache.end()) {
+        startUpload(upload, provider, fileInfo);
+        return upload;
+    }
+
+    // another file with the same size has been uploaded, it may have the same content
+    auto file = std::make_unique<QFile>(absolutePath);
+    if (!file->open(QIODevice::ReadOnly)) {
+        upload->d->error = QXmppError::fromIoDevice(*file);
+        upload->reportFinished();
+        return upload;
+    }
+    upload->d->hashesFuture = calculateHashes(std::move(file), hashAlgorithms());
+    await(upload->d->hashesFuture, this, [this, upload, provider, fileInfo, reuseUpload](HashingResultPtr hashResult) {
+        auto &hashValue = hashResult->result;
+        if (std::holds_alternative<Cancelled>(hashValue)) {
+            upload->d->cancelled = true;
+            upload->reportFinished();
+            return;
+        }
+        if (std::holds_alternative<std::vector<QXmppHash>>(hashValue)) {
+            const auto &hashes = std::get<std::vector<QXmppHash>>(hashValue);
+            auto cached = d->findUpload(provider, [&](const CachedUpload &entry) {
+                return entry.size == fileInfo.size() && hashesMatch(entry.metadata.hashes(), hashes);
+            });
+            if (cached != d->uploadCache.end()) {
+                // the file is recognized by its path from now on
+                auto entry = *cached;
+                entry.filePath = fileInfo.absoluteFilePath();
+                entry.lastModified = fileInfo.lastModified();
+                reuseUpload(entry);
+                d->cacheUpload(std::move(entry));
+                return;
+            }
+        }
+
+        // the file is hashed again when it is uploaded
+        upload->d->hashesFuture = {};
+        startUpload(upload, provider, fileInfo);
+    });
+    return upload;
+}
+
+void QXmppFileSharingManager::startUpload(const std::shared_ptr<QXmppFileUpload> &upload,
+                                          const std::shared_ptr<QXmppFileSharingProvider> &provider,
+                                          const QFileInfo &fileInfo)
+{
+    if (d->metadataJobs >= d->maxMetadataJobs) {
+        // cancelling the upload cancels this future, it is replaced when the upload starts
+        QFutureInterface<std::shared_ptr<MetadataGeneratorResult>> queued(QFutureInterfaceBase::Started);
+        upload->d->metadataFuture = queued.future();
+
+        auto *watcher = new QFutureWatcher<std::shared_ptr<MetadataGeneratorResult>>(this);
+        connect(watcher, &QFutureWatcherBase::canceled, this, [upload]() {
+            upload->d->cancelled = true;
+            upload->reportFinished();
+        });
+        connect(watcher, &QFutureWatcherBase::finished, watcher, &QObject::deleteLater);
+        watcher->setFuture(queued.future());
+
+        d->queuedUploads.push_back([this, upload, provider, fileInfo, queued]() mutable {
+            const auto cancelled = queued.isCanceled();
+            queued.reportFinished();
+            if (!cancelled) {
+                startUpload(upload, provider, fileInfo);
+            }
+        });
+        return;
+    }
+
     auto openFile = [=]() -> std::unique_ptr<QIODevice> {
         auto device = std::make_unique<QFile>(fileInfo.absoluteFilePath());
         if (!device->open(QIODevice::ReadOnly)) {
@@ -420,28 +809,53 @@ std::shared_ptr<QXmppFileUpload> QXmppFileSharingManager::uploadFile(std::shared
     };
 
     auto metadataIoDevice = openFile();
-    auto hashesIoDevice = openFile();
     auto uploadIoDevice = openFile();
 
     if (upload->d->finished) {
         // error occurred while opening file
-        return upload;
+        return;
     }
 
     upload->d->metadataFuture = d->metadataGenerator(std::move(metadataIoDevice));
-    upload->d->hashesFuture = calculateHashes(std::move(hashesIoDevice), hashAlgorithms());
+
+    // the next upload is started when the metadata job has finished
+    d->metadataJobs++;
+    auto *watcher = new QFutureWatcher<std::shared_ptr<MetadataGeneratorResult>>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher]() {
+        watcher->deleteLater();
+        d->metadataJobs--;
+        startQueuedUploads();
+    });
+    watcher->setFuture(upload->d->metadataFuture);
+
+    // the file is hashed while it is read for uploading
+    auto hashingDevice = std::make_unique<HashingDevice>(std::move(uploadIoDevice), hashAlgorithms());
+    auto hashingState = hashingDevice->state();
 
     auto onProgress = [upload](quint64 sent, quint64 total) {
         upload->d->bytesSent = sent;
         upload->d->bytesTotal = total;
-        Q_EMIT upload->progressChanged();
+        if (upload->d->progressThrottle.shouldReport(sent, total)) {
+            Q_EMIT upload->progressChanged();
+        }
     };
-    auto onFinished = [this, upload](QXmppFileSharingProvider::UploadResult uploadResult) {
+    auto onFinished = [this, upload, hashingState, fileInfo, weakProvider = std::weak_ptr(provider)](QXmppFileSharingProvider::UploadResult uploadResult) {
+        const auto filePath = fileInfo.absoluteFilePath();
         // free memory
         upload->d->providerUpload.reset();
         if (std::holds_alternative<std::any>(uploadResult)) {
             upload->d->source = std::get<std::any>(std::move(uploadResult));
-            await(upload->d->metadataFuture, this, [this, upload](auto &&result) mutable {
+
+            if (auto hashes = hashingState->result()) {
+                upload->d->hashesFuture = makeReadyFuture<HashingResultPtr>(std::make_shared<HashingResult>(std::move(*hashes), nullptr));
+            } else {
+                // the provider did not read the file exactly once in order
+                auto file = std::make_unique<QFile>(filePath);
+                file->open(QIODevice::ReadOnly);
+                upload->d->hashesFuture = calculateHashes(std::move(file), hashAlgorithms());
+            }
+
+            await(upload->d->metadataFuture, this, [this, upload, fileInfo, weakProvider](auto &&result) mutable {
                 if (result->dimensions) {
                     upload->d->metadata.setWidth(result->dimensions->width());
                     upload->d->metadata.setHeight(result->dimensions->height());
@@ -471,7 +885,7 @@ std::shared_ptr<QXmppFileUpload> QXmppFileSharingManager::uploadFile(std::shared
                     upload->d->metadata.setThumbnails(thumbnails);
                 }
 
-                await(upload->d->hashesFuture, this, [upload](auto hashResult) mutable {
+                await(upload->d->hashesFuture, this, [this, upload, fileInfo, weakProvider](auto hashResult) mutable {
                     auto &hashValue = hashResult->result;
                     if (std::holds_alternative<std::vector<QXmppHash>>(hashValue)) {
                         const auto &hashesVector = std::get<std::vector<QXmppHash>>(hashValue);
@@ -483,6 +897,17 @@ std::shared_ptr<QXmppFileUpload> QXmppFileSharingManager::uploadFile(std::shared
                                        });
                         upload->d->metadata.setHashes(hashes);
                         upload->d->success = true;
+
+                        d->cacheUpload(CachedUpload {
+                            std::move(weakProvider),
+                            fileInfo.absoluteFilePath(),
+                            fileInfo.size(),
+                            fileInfo.lastModified(),
+                            QDateTime::currentDateTimeUtc().addSecs(d->uploadCacheLifetime),
+                            upload->d->metadata,
+                            upload->d->dataBlobs,
+                            upload->d->source,
+                        });
                     } else if (std::holds_alternative<Cancelled>(hashValue)) {
                         upload->d->cancelled = true;
                     } else if (std::holds_alternative<QXmppError>(hashValue)) {
@@ -500,8 +925,7 @@ std::shared_ptr<QXmppFileUpload> QXmppFileSharingManager::uploadFile(std::shared
         }
     };
 
-    upload->d->providerUpload = provider->uploadFile(std::move(uploadIoDevice), upload->d->metadata, std::move(onProgress), std::move(onFinished));
-    return upload;
+    upload->d->providerUpload = provider->uploadFile(std::move(hashingDevice), upload->d->metadata, std::move(onProgress), std::move(onFinished));
 }
 
 ///
@@ -600,6 +1024,15 @@ std::shared_ptr<QXmppFileDownload> QXmppFileSharingManager::downloadFile(
     return download;
 }
 
+void QXmppFileSharingManager::startQueuedUploads()
+{
+    while (d->metadataJobs < d->maxMetadataJobs && !d->queuedUploads.empty()) {
+        auto start = std::move(d->queuedUploads.front());
+        d->queuedUploads.pop_front();
+        start();
+    }
+}
+
 void QXmppFileSharingManager::internalRegisterProvider(std::type_index index, std::shared_ptr<QXmppFileSharingProvider> provider)
 {
     d->providers.insert_or_assign(index, provider);
@@ -21,6 +21,7 @@
 #include <QMimeType>
 #include <QSize>
 
+class QFileInfo;
 class QIODevice;
 class QXmppFileDownloadPrivate;
 class QXmppFileMetadata;
@@ -53,6 +54,11 @@ public:
     quint64 bytesTotal() const;
     Result result() const;
 
+    float progressGranularity() const;
+    void setProgressGranularity(float granularity);
+    int progressInterval() const;
+    void setProgressInterval(int msecs);
+
     Q_SIGNAL void finished();
 
 private:
@@ -103,6 +109,11 @@ public:
     quint64 bytesTotal() const;
     Result result() const;
 
+    float progressGranularity() const;
+    void setProgressGranularity(float granularity);
+    int progressInterval() const;
+    void setProgressInterval(int msecs);
+
     Q_SIGNAL void finished();
 
 private:
@@ -142,6 +153,14 @@ public:
     ~QXmppFileSharingManager();
 
     void setMetadataGenerator(MetadataGenerator &&generator);
+    int maxMetadataJobs() const;
+    void setMaxMetadataJobs(int jobs);
+
+    int uploadCacheSize() const;
+    void setUploadCacheSize(int size);
+    int uploadCacheLifetime() const;
+    void setUploadCacheLifetime(int secs);
+    void clearUploadCache();
 
     ///
     /// \brief Register a provider for automatic downloads
@@ -165,6 +184,11 @@ public:
 private:
     friend class QXmppEncryptedFileSharingProvider;
 
+    void startUpload(const std::shared_ptr<QXmppFileUpload> &upload,
+                     const std::shared_ptr<QXmppFileSharingProvider> &provider,
+                     const QFileInfo &fileInfo);
+    void startQueuedUploads();
+
     void internalRegisterProvider(std::type_index, std::shared_ptr<QXmppFileSharingProvider> provider);
     std::shared_ptr<QXmppFileSharingProvider> providerForSource(const std::any &source) const;
 
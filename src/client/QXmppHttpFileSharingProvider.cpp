@@ -10,9 +10,18 @@
 #include "QXmppHttpUploadManager.h"
 #include "QXmppUtils.h"
 
+#include <algorithm>
+#include <utility>
+
+#include <QFileDevice>
 #include <QMimeDatabase>
+#include <QNetworkAccessManager>
 #include <QNetworkReply>
 
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
 using namespace QXmpp;
 using namespace QXmpp::Private;
 
@@ -24,13 +33,37 @@ using namespace QXmpp::Private;
 /// \since QXmpp 1.5
 ///
 
+// received data is collected and written in chunks of this size
+constexpr qint64 DefaultWriteBufferSize = 256 * 1024;
+
 class QXmppHttpFileSharingProviderPrivate
 {
 public:
     QXmppHttpUploadManager *manager;
     QNetworkAccessManager *netManager;
+    int downloadSegments = 1;
+    qint64 writeBufferSize = DefaultWriteBufferSize;
 };
 
+// segments are not made smaller than this, so small files use one request
+constexpr qint64 MinimumSegmentSize = 1024 * 1024;
+
+// Reserves the space for the complete file, so it isn't fragmented by
+// writing it in many small pieces.
+static bool reserveFileSpace(QFileDevice &file, qint64 size)
+{
+    if (file.size() >= size) {
+        return false;
+    }
+    file.flush();
+#ifdef Q_OS_LINUX
+    if (posix_fallocate(file.handle(), 0, size) == 0) {
+        return true;
+    }
+#endif
+    return file.resize(size);
+}
+
 ///
 /// \brief Create a QXmppHttpFileSharingProvider
 /// \param manager
@@ -43,22 +76,126 @@ QXmppHttpFileSharingProvider::QXmppHttpFileSharingProvider(QXmppHttpUploadManage
     d->netManager = netManager;
 }
 
+///
+/// Creates a QXmppHttpFileSharingProvider that downloads with the network
+/// access manager of the upload manager.
+///
+/// Uploads and downloads then share the connections to the hosts, e.g. the
+/// files just sent are downloaded again via the open connection to the
+/// upload service.
+///
+/// \param manager upload manager, needs to have at least the lifetime of
+/// this provider
+///
+/// \since QXmpp 1.6
+///
+QXmppHttpFileSharingProvider::QXmppHttpFileSharingProvider(QXmppHttpUploadManager *manager)
+    : QXmppHttpFileSharingProvider(manager, manager->networkAccessManager())
+{
+}
+
 QXmppHttpFileSharingProvider::~QXmppHttpFileSharingProvider() = default;
 
+///
+/// Returns the number of parallel range requests used to download a file.
+///
+/// \since QXmpp 1.6
+///
+int QXmppHttpFileSharingProvider::downloadSegments() const
+{
+    return d->downloadSegments;
+}
+
+///
+/// Sets the number of parallel range requests used to download a file.
+///
+/// Downloads into a QFile are split into the given number of segments if the
+/// server supports range requests. Each segment is at least 1 MiB, so smaller
+/// files are downloaded with fewer requests.
+///
+/// The default is 1, files are downloaded with a single request.
+///
+/// \since QXmpp 1.6
+///
+void QXmppHttpFileSharingProvider::setDownloadSegments(int segments)
+{
+    d->downloadSegments = std::max(1, segments);
+}
+
+///
+/// Returns the number of bytes received by a download that are collected
+/// before they are written to the target.
+///
+/// \since QXmpp 1.6
+///
+qint64 QXmppHttpFileSharingProvider::writeBufferSize() const
+{
+    return d->writeBufferSize;
+}
+
+///
+/// Sets the number of bytes received by a download that are collected before
+/// they are written to the target.
+///
+/// Writing large chunks instead of every chunk received from the network
+/// reduces the number of writes on slow storage. The default is 256 KiB, 0
+/// writes the data as soon as it is received.
+///
+/// \since QXmpp 1.6
+///
+void QXmppHttpFileSharingProvider::setWriteBufferSize(qint64 size)
+{
+    d->writeBufferSize = std::max<qint64>(0, size);
+}
+
+///
+/// Downloads the file into \a target.
+///
+/// If the target is not sequential and its position is not at the start, e.g.
+/// a partially downloaded file that has been opened with QIODevice::Append,
+/// only the remaining bytes are requested. If the server does not support
+/// range requests, the file is downloaded completely again.
+///
+/// Downloads into a QFile reserve the space for the complete file when its size
+/// is known. If a download fails, the file is truncated to the data received
+/// without gaps, so it can be resumed later.
+///
 auto QXmppHttpFileSharingProvider::downloadFile(const std::any &source,
                                                 std::unique_ptr<QIODevice> target,
                                                 std::function<void(quint64, quint64)> reportProgress,
                                                 std::function<void(DownloadResult)> reportFinished)
     -> std::shared_ptr<Download>
 {
+    struct Segment
+    {
+        QNetworkReply *reply = nullptr;
+        qint64 start = 0;
+        // last byte of the segment or -1 for up to the end of the file
+        qint64 end = -1;
+        qint64 written = 0;
+        // received data that has not been written yet
+        QByteArray buffer;
+        bool started = false;
+
+        bool isComplete() const { return end >= 0 && written == end - start + 1; }
+    };
+
     struct State : Download
     {
         ~State() override = default;
 
+        QNetworkAccessManager *netManager;
+        QNetworkRequest request;
         std::unique_ptr<QIODevice> output;
+        std::function<void(quint64, quint64)> reportProgress;
         std::function<void(DownloadResult)> reportFinished;
-        std::optional<QXmppError> error;
-        QNetworkReply *reply = nullptr;
+        QNetworkReply *headReply = nullptr;
+        std::vector<Segment> segments;
+        // position at which the download has been resumed
+        qint64 offset = 0;
+        qint64 total = 0;
+        qint64 writeBufferSize = 0;
+        bool preallocated = false;
         bool finished = false;
         bool cancelled = false;
 
@@ -66,17 +203,93 @@ auto QXmppHttpFileSharingProvider::downloadFile(const std::any &source,
         {
             if (!cancelled && !finished) {
                 cancelled = true;
-                reply->abort();
+                if (headReply) {
+                    headReply->abort();
+                }
+                for (auto &segment : segments) {
+                    segment.reply->abort();
+                }
             }
         }
         void finish(DownloadResult &&result)
         {
+            finished = true;
+            for (auto &segment : segments) {
+                if (segment.reply->isRunning()) {
+                    segment.reply->abort();
+                }
+                // keep the received data, so it doesn't need to be downloaded again
+                writeBuffer(segment);
+            }
+            // the reserved space may be larger than the received data
+            if (preallocated || (segments.size() > 1 && !std::holds_alternative<Success>(result))) {
+                truncateToReceived();
+            }
             if (output && output->isOpen()) {
                 output->close();
             }
             reportFinished(std::move(result));
-            finished = true;
-            reply->deleteLater();
+            if (headReply) {
+                headReply->deleteLater();
+            }
+            for (auto &segment : segments) {
+                segment.reply->deleteLater();
+            }
+        }
+        void progress()
+        {
+            auto received = offset;
+            for (const auto &segment : segments) {
+                received += segment.written + segment.buffer.size();
+            }
+            reportProgress(received, total);
+        }
+        bool writeBuffer(Segment &segment)
+        {
+            if (segment.buffer.isEmpty()) {
+                return true;
+            }
+            if (!output->isSequential()) {
+                output->seek(segment.start + segment.written);
+            }
+            const auto buffer = std::exchange(segment.buffer, {});
+            if (output->write(buffer) != buffer.size()) {
+                return false;
+            }
+            segment.written += buffer.size();
+            return true;
+        }
+        // Writes the buffered data, finishes the download if that fails.
+        bool flush(Segment &segment)
+        {
+            if (!writeBuffer(segment)) {
+                finish(QXmppError::fromIoDevice(*output));
+                return false;
+            }
+            return true;
+        }
+        void preallocate()
+        {
+            if (auto *file = dynamic_cast<QFileDevice *>(output.get()); file && total > 0) {
+                preallocated = reserveFileSpace(*file, total);
+            }
+        }
+        // Removes everything after the first gap, so the download can be resumed.
+        void truncateToReceived()
+        {
+            auto *file = dynamic_cast<QFileDevice *>(output.get());
+            if (!file) {
+                return;
+            }
+            auto received = offset;
+            for (const auto &segment : segments) {
+                received = segment.start + segment.written;
+                if (!segment.isComplete()) {
+                    break;
+                }
+            }
+            file->flush();
+            file->resize(received);
         }
     };
 
@@ -88,43 +301,159 @@ auto QXmppHttpFileSharingProvider::downloadFile(const std::any &source,
     }
 
     auto state = std::make_shared<State>();
+    state->netManager = d->netManager;
+    state->request = QNetworkRequest(httpSource.url());
+    // the segments of a file are multiplexed on one connection
+    state->request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
     state->output = std::move(target);
+    state->reportProgress = std::move(reportProgress);
     state->reportFinished = std::move(reportFinished);
-    state->reply = d->netManager->get(QNetworkRequest(httpSource.url()));
+    state->offset = state->output->isSequential() ? 0 : state->output->pos();
+    state->writeBufferSize = d->writeBufferSize;
+
+    auto handleReadyRead = [](State &state, Segment &segment) {
+        Q_ASSERT(state.output);
+
+        if (!segment.started) {
+            segment.started = true;
 
-    QObject::connect(state->reply, &QNetworkReply::finished, [state]() mutable {
-        if (!state->finished) {
-            if (state->error) {
-                state->finish(std::move(*state->error));
-            } else if (state->cancelled) {
-                state->finish(Cancelled());
-            } else {
-                state->finish(Success());
+            const auto status = segment.reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            const bool isRanged = segment.start > 0 || segment.end >= 0;
+            if (isRanged && status != 206) {
+                if (state.segments.size() > 1) {
+                    state.finish(QXmppError { QStringLiteral("Server does not support range requests."), {} });
+                    return;
+                }
+                // the complete file is sent, start from scratch
+                segment.start = 0;
+                state.offset = 0;
+                if (auto *file = dynamic_cast<QFileDevice *>(state.output.get())) {
+                    file->resize(0);
+                }
+            }
+            if (state.segments.size() == 1) {
+                const auto length = segment.reply->header(QNetworkRequest::ContentLengthHeader);
+                state.total = length.isValid() ? segment.start + length.toLongLong() : 0;
+                state.preallocate();
             }
         }
-    });
 
-    QObject::connect(state->reply, &QNetworkReply::readyRead, [state]() {
-        Q_ASSERT(state->output);
+        segment.buffer += segment.reply->readAll();
+        if (segment.buffer.size() >= state.writeBufferSize && !state.flush(segment)) {
+            return;
+        }
+        state.progress();
+    };
+
+    auto startSegments = [handleReadyRead](const std::shared_ptr<State> &state, std::vector<Segment> segments) {
+        state->segments = std::move(segments);
+
+        for (std::size_t i = 0; i < state->segments.size(); i++) {
+            auto &segment = state->segments[i];
+            auto request = state->request;
+            if (segment.start > 0 || segment.end >= 0) {
+                auto range = QByteArrayLiteral("bytes=") + QByteArray::number(segment.start) + '-';
+                if (segment.end >= 0) {
+                    range += QByteArray::number(segment.end);
+                }
+                request.setRawHeader(QByteArrayLiteral("Range"), range);
+            }
+            segment.reply = state->netManager->get(request);
+
+            QObject::connect(segment.reply, &QNetworkReply::readyRead, [state, i, handleReadyRead]() {
+                if (!state->finished) {
+                    handleReadyRead(*state, state->segments[i]);
+                }
+            });
+
+            QObject::connect(segment.reply, &QNetworkReply::finished, [state, i, handleReadyRead]() {
+                auto &segment = state->segments[i];
+                if (state->finished || segment.reply->error() != QNetworkReply::NoError) {
+                    return;
+                }
+                if (segment.reply->bytesAvailable() > 0) {
+                    handleReadyRead(*state, segment);
+                }
+                if (state->finished || !state->flush(segment)) {
+                    return;
+                }
+                if (segment.end >= 0 && !segment.isComplete()) {
+                    state->finish(QXmppError { QStringLiteral("Server sent an incomplete segment."), {} });
+                    return;
+                }
+                const auto allFinished = std::all_of(state->segments.cbegin(), state->segments.cend(), [](const auto &segment) {
+                    return segment.reply->isFinished() && segment.reply->error() == QNetworkReply::NoError;
+                });
+                if (allFinished) {
+                    state->finish(Success());
+                }
+            });
 
-        auto data = state->reply->readAll();
-        if (state->output->write(data) != data.size()) {
-            state->error = QXmppError::fromIoDevice(*state->output);
+            QObject::connect(segment.reply, &QNetworkReply::errorOccurred,
+                             [state, i](QNetworkReply::NetworkError) {
+                                 // Qt doc: the finished() signal will "probably" follow
+                                 // => we can't be sure that finished() is going to be called
+                                 if (state->finished) {
+                                     return;
+                                 }
+                                 const auto &reply = *state->segments[i].reply;
+                                 const auto status = reply.attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+                                 if (state->cancelled) {
+                                     state->finish(Cancelled());
+                                 } else if (status == 416 && state->segments.size() == 1 && state->offset > 0) {
+                                     // nothing left to download
+                                     state->finish(Success());
+                                 } else {
+                                     state->finish(QXmppError::fromNetworkReply(reply));
+                                 }
+                             });
         }
-    });
+    };
+
+    auto *file = dynamic_cast<QFileDevice *>(state->output.get());
+    if (d->downloadSegments == 1 || !file) {
+        startSegments(state, { Segment { nullptr, state->offset, -1 } });
+        return std::dynamic_pointer_cast<QXmppFileSharingProvider::Download>(state);
+    }
 
-    QObject::connect(state->reply, &QNetworkReply::downloadProgress, [state, reportProgress = std::move(reportProgress)](qint64 bytesReceived, qint64 bytesTotal) {
-        if (!state->finished) {
-            reportProgress(bytesReceived, bytesTotal);
+    // the size is needed to split the file into segments
+    state->headReply = d->netManager->head(state->request);
+    QObject::connect(state->headReply, &QNetworkReply::finished, [state, startSegments, maxSegments = d->downloadSegments]() {
+        if (state->finished) {
+            return;
+        }
+        if (state->cancelled) {
+            state->finish(Cancelled());
+            return;
         }
-    });
 
-    QObject::connect(state->reply, &QNetworkReply::errorOccurred,
-                     [state](QNetworkReply::NetworkError) {
-                         // Qt doc: the finished() signal will "probably" follow
-                         // => we can't be sure that finished() is going to be called
-                         state->finish(QXmppError::fromNetworkReply(*state->reply));
-                     });
+        const auto &reply = *state->headReply;
+        const auto length = reply.header(QNetworkRequest::ContentLengthHeader);
+        const auto supportsRanges = reply.error() == QNetworkReply::NoError &&
+            reply.rawHeader(QByteArrayLiteral("Accept-Ranges")) == "bytes" && length.isValid();
+        if (!supportsRanges) {
+            startSegments(state, { Segment { nullptr, state->offset, -1 } });
+            return;
+        }
+
+        state->total = length.toLongLong();
+        const auto remaining = state->total - state->offset;
+        if (remaining <= 0) {
+            state->finish(Success());
+            return;
+        }
+        state->preallocate();
+
+        const auto count = std::clamp<qint64>(remaining / MinimumSegmentSize, 1, maxSegments);
+        const auto segmentSize = remaining / count;
+        std::vector<Segment> segments;
+        for (qint64 i = 0; i < count; i++) {
+            const auto start = state->offset + i * segmentSize;
+            const auto end = i == count - 1 ? state->total - 1 : start + segmentSize - 1;
+            segments.push_back(Segment { nullptr, start, end });
+        }
+        startSegments(state, std::move(segments));
+    });
 
     return std::dynamic_pointer_cast<QXmppFileSharingProvider::Download>(state);
 }
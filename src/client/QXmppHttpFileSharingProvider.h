@@ -21,9 +21,15 @@ public:
     using SourceType = QXmppHttpFileSource;
     /// \endcond
 
+    explicit QXmppHttpFileSharingProvider(QXmppHttpUploadManager *manager);
     QXmppHttpFileSharingProvider(QXmppHttpUploadManager *manager, QNetworkAccessManager *netManager);
     ~QXmppHttpFileSharingProvider() override;
 
+    int downloadSegments() const;
+    void setDownloadSegments(int segments);
+    qint64 writeBufferSize() const;
+    void setWriteBufferSize(qint64 size);
+
     auto downloadFile(const std::any &source,
                       std::unique_ptr<QIODevice> target,
                       std::function<void(quint64, quint64)> reportProgress,
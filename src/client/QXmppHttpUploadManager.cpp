@@ -10,12 +10,16 @@
 #include "QXmppUploadRequestManager.h"
 #include "QXmppUtils_p.h"
 
+#include <algorithm>
+
 #include <QFile>
 #include <QFileInfo>
 #include <QMimeDatabase>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QPointer>
+#include <QSslConfiguration>
+#include <QTimer>
 
 using namespace QXmpp;
 using namespace QXmpp::Private;
@@ -28,7 +32,11 @@ struct QXmppHttpUploadPrivate
     std::optional<QXmppError> error;
     quint64 bytesSent = 0;
     quint64 bytesTotal = 0;
+    ProgressThrottle progressThrottle;
     QPointer<QNetworkReply> reply;
+    // kept for retries, deleted when the upload has finished
+    std::unique_ptr<QIODevice> data;
+    int attempts = 0;
     bool finished = false;
     bool cancelled = false;
 
@@ -47,6 +55,10 @@ struct QXmppHttpUploadPrivate
     {
         if (!finished) {
             finished = true;
+            if (data) {
+                // the reply may still be using it
+                data.release()->deleteLater();
+            }
             Q_EMIT q->finished(result());
         }
     }
@@ -61,7 +73,9 @@ struct QXmppHttpUploadPrivate
         if (bytesSent != sent || bytesTotal != total) {
             bytesSent = sent;
             bytesTotal = total;
-            Q_EMIT q->progressChanged();
+            if (progressThrottle.shouldReport(sent, total)) {
+                Q_EMIT q->progressChanged();
+            }
         }
     }
     [[nodiscard]] QXmppHttpUpload::Result result() const
@@ -134,6 +148,11 @@ QXmppHttpUpload::~QXmppHttpUpload() = default;
 /// auto *uploadManager = client.addNewExtension<QXmppHttpUploadManager>();
 /// \endcode
 ///
+/// The uploads are sent with HTTP/2 if the upload service supports it, so
+/// several uploads to the same host share one TLS connection. Pass the
+/// networkAccessManager() to QXmppHttpFileSharingProvider to use the same
+/// connections for downloads.
+///
 /// \since QXmpp 1.5
 ///
 
@@ -169,6 +188,56 @@ quint64 QXmppHttpUpload::bytesTotal() const
     return d->bytesTotal;
 }
 
+///
+/// Returns the fraction of the total size by which the upload needs to
+/// advance before progressChanged() is emitted again.
+///
+/// \since QXmpp 1.6
+///
+float QXmppHttpUpload::progressGranularity() const
+{
+    return d->progressThrottle.granularity();
+}
+
+///
+/// Sets the fraction of the total size by which the upload needs to advance
+/// before progressChanged() is emitted again, e.g. 0.01 for every percent.
+///
+/// The default is 0, which reports every change. The start and the end of
+/// the upload are always reported.
+///
+/// \since QXmpp 1.6
+///
+void QXmppHttpUpload::setProgressGranularity(float granularity)
+{
+    d->progressThrottle.setGranularity(granularity);
+}
+
+///
+/// Returns the minimum time in milliseconds between two emissions of
+/// progressChanged().
+///
+/// \since QXmpp 1.6
+///
+int QXmppHttpUpload::progressInterval() const
+{
+    return d->progressThrottle.interval();
+}
+
+///
+/// Sets the minimum time in milliseconds between two emissions of
+/// progressChanged().
+///
+/// The default is 0, which does not limit the rate. The properties bytesSent
+/// and bytesTotal are always up to date, regardless of the signal.
+///
+/// \since QXmpp 1.6
+///
+void QXmppHttpUpload::setProgressInterval(int msecs)
+{
+    d->progressThrottle.setInterval(msecs);
+}
+
 ///
 /// Cancels the upload.
 ///
@@ -213,8 +282,32 @@ struct QXmppHttpUploadManagerPrivate
     }
 
     QNetworkAccessManager *netManager;
+    int maximumRetries = 0;
+    // scheme, host and port of the last upload slot, connected to in advance
+    QUrl lastUploadHost;
 };
 
+// delay before the first retry, doubled for each further retry
+constexpr int RetryDelay = 1000;
+
+// Errors of flaky connections after which the same slot can be used again.
+static bool isTransientError(QNetworkReply::NetworkError error)
+{
+    switch (error) {
+    case QNetworkReply::RemoteHostClosedError:
+    case QNetworkReply::TimeoutError:
+    case QNetworkReply::TemporaryNetworkFailureError:
+    case QNetworkReply::NetworkSessionFailedError:
+    case QNetworkReply::UnknownNetworkError:
+    case QNetworkReply::ProxyConnectionClosedError:
+    case QNetworkReply::ProxyTimeoutError:
+    case QNetworkReply::ServiceUnavailableError:
+        return true;
+    default:
+        return false;
+    }
+}
+
 ///
 /// Constructor
 ///
@@ -238,6 +331,51 @@ QXmppHttpUploadManager::QXmppHttpUploadManager(QNetworkAccessManager *netManager
 
 QXmppHttpUploadManager::~QXmppHttpUploadManager() = default;
 
+///
+/// Returns the network access manager used for the uploads.
+///
+/// Other components downloading or uploading files, e.g.
+/// QXmppHttpFileSharingProvider, should use the same manager, so they share
+/// its connections to the hosts.
+///
+/// \since QXmpp 1.6
+///
+QNetworkAccessManager *QXmppHttpUploadManager::networkAccessManager() const
+{
+    return d->netManager;
+}
+
+///
+/// Returns how often an upload is restarted after the connection failed.
+///
+/// \since QXmpp 1.6
+///
+int QXmppHttpUploadManager::maximumRetries() const
+{
+    return d->maximumRetries;
+}
+
+///
+/// Sets how often an upload is restarted after the connection failed.
+///
+/// Uploads of non-sequential devices (e.g. files) that fail because of a
+/// closed connection, a timeout or a temporarily unavailable service are sent
+/// again to the same upload slot after a short delay, which is doubled for
+/// each retry. The progress starts from zero again.
+///
+/// \xep{0363, HTTP File Upload} only allows to upload a file at once with a
+/// single request, so uploads cannot be resumed from where they failed or be
+/// split into parts.
+///
+/// The default is 0, failed uploads are not retried.
+///
+/// \since QXmpp 1.6
+///
+void QXmppHttpUploadManager::setMaximumRetries(int retries)
+{
+    d->maximumRetries = std::max(0, retries);
+}
+
 ///
 /// Uploads the data from a QIODevice.
 ///
@@ -298,15 +436,27 @@ std::shared_ptr<QXmppHttpUpload> QXmppHttpUploadManager::uploadFile(std::unique_
         }
     }
 
+    // The slot is most likely on the host of the last upload. Connecting while
+    // the slot is requested saves the TLS handshake if the connection has been
+    // closed in the meantime, otherwise the open connection is used.
+    if (!d->lastUploadHost.isEmpty()) {
+        auto sslConfiguration = QSslConfiguration::defaultConfiguration();
+        sslConfiguration.setAllowedNextProtocols({ QSslConfiguration::ALPNProtocolHTTP2, QSslConfiguration::NextProtocolHttp1_1 });
+        d->netManager->connectToHostEncrypted(d->lastUploadHost.host(), quint16(d->lastUploadHost.port(443)), sslConfiguration);
+    }
+
     auto future = client()->findExtension<QXmppUploadRequestManager>()->requestSlot(filename, fileSize, mimeType, uploadServiceJid);
     // TODO: rawSourceDevice: could this lead to a memory leak if the "then lambda" is never executed?
     future.then(this, [this, upload, rawSourceDevice = data.release()](SlotResult result) mutable {
         // first check whether upload was cancelled in the meantime
         if (upload->d->cancelled) {
+            delete rawSourceDevice;
             upload->d->reportFinished();
             return;
         }
 
+        upload->d->data.reset(rawSourceDevice);
+
         if (std::holds_alternative<QXmppError>(result)) {
             upload->d->reportError(std::get<QXmppError>(std::move(result)));
             upload->d->reportFinished();
@@ -322,39 +472,67 @@ std::shared_ptr<QXmppHttpUpload> QXmppHttpUploadManager::uploadFile(std::unique_
 
             upload->d->getUrl = slot.getUrl();
 
+            d->lastUploadHost = slot.putUrl().adjusted(QUrl::RemoveUserInfo | QUrl::RemovePath | QUrl::RemoveQuery | QUrl::RemoveFragment);
+
             QNetworkRequest request(slot.putUrl());
+            // uploads to the same host are multiplexed on one connection
+            request.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
             auto headers = slot.putHeaders();
             for (auto itr = headers.cbegin(); itr != headers.cend(); ++itr) {
                 request.setRawHeader(itr.key().toUtf8(), itr.value().toUtf8());
             }
 
-            auto *reply = d->netManager->put(request, rawSourceDevice);
-            rawSourceDevice->setParent(reply);
-            upload->d->reply = reply;
+            putData(upload, request);
+        }
+    });
 
-            connect(reply, &QNetworkReply::finished, this, [reply, upload]() {
-                if (reply->error() == QNetworkReply::NoError) {
-                    upload->d->reportFinished();
-                }
+    return upload;
+}
+
+// Sends the data to the upload slot and retries it on transient errors.
+void QXmppHttpUploadManager::putData(const std::shared_ptr<QXmppHttpUpload> &upload, const QNetworkRequest &request)
+{
+    auto *reply = d->netManager->put(request, upload->d->data.get());
+    upload->d->reply = reply;
+    upload->d->attempts++;
+
+    connect(reply, &QNetworkReply::finished, this, [reply, upload]() {
+        if (reply->error() == QNetworkReply::NoError) {
+            upload->d->reportFinished();
+        }
+        reply->deleteLater();
+    });
+
+    connect(reply, &QNetworkReply::errorOccurred, this,
+            [this, upload, request, reply](QNetworkReply::NetworkError error) {
                 reply->deleteLater();
-            });
 
-            connect(reply, &QNetworkReply::errorOccurred, this,
-                    [upload, reply](QNetworkReply::NetworkError error) {
-                        upload->d->reportError({ reply->errorString(), error });
-                        upload->d->reportFinished();
-                        reply->deleteLater();
+                const auto retries = upload->d->attempts - 1;
+                if (!upload->d->cancelled && isTransientError(error) && retries < d->maximumRetries &&
+                    !upload->d->data->isSequential() && upload->d->data->seek(0)) {
+                    warning(QStringLiteral("Upload failed, retrying: ") + reply->errorString());
+                    upload->d->reply = nullptr;
+                    upload->d->reportProgress(0, upload->d->bytesTotal);
+
+                    QTimer::singleShot(RetryDelay << retries, this, [this, upload, request]() {
+                        if (upload->d->cancelled) {
+                            upload->d->reportFinished();
+                        } else {
+                            putData(upload, request);
+                        }
                     });
+                    return;
+                }
 
-            connect(reply, &QNetworkReply::uploadProgress, this, [upload](qint64 sent, qint64 total) {
-                quint64 sentBytes = sent < 0 ? 0 : quint64(sent);
-                quint64 totalBytes = total < 0 ? 0 : quint64(total);
-                upload->d->reportProgress(sentBytes, totalBytes);
+                upload->d->reportError({ reply->errorString(), error });
+                upload->d->reportFinished();
             });
-        }
-    });
 
-    return upload;
+    connect(reply, &QNetworkReply::uploadProgress, this, [upload](qint64 sent, qint64 total) {
+        quint64 sentBytes = sent < 0 ? 0 : quint64(sent);
+        quint64 totalBytes = total < 0 ? 0 : quint64(total);
+        upload->d->reportProgress(sentBytes, totalBytes);
+    });
 }
 
 ///
@@ -14,6 +14,7 @@
 
 class QFileInfo;
 class QNetworkAccessManager;
+class QNetworkRequest;
 struct QXmppHttpUploadPrivate;
 struct QXmppHttpUploadManagerPrivate;
 
@@ -33,6 +34,11 @@ public:
     quint64 bytesSent() const;
     quint64 bytesTotal() const;
 
+    float progressGranularity() const;
+    void setProgressGranularity(float granularity);
+    int progressInterval() const;
+    void setProgressInterval(int msecs);
+
     void cancel();
     bool isFinished() const;
     std::optional<Result> result() const;
@@ -58,10 +64,17 @@ public:
     explicit QXmppHttpUploadManager(QNetworkAccessManager *netManager);
     ~QXmppHttpUploadManager();
 
+    QNetworkAccessManager *networkAccessManager() const;
+
+    int maximumRetries() const;
+    void setMaximumRetries(int retries);
+
     std::shared_ptr<QXmppHttpUpload> uploadFile(std::unique_ptr<QIODevice> data, const QString &filename, const QMimeType &mimeType, qint64 fileSize = -1, const QString &uploadServiceJid = {});
     std::shared_ptr<QXmppHttpUpload> uploadFile(const QFileInfo &fileInfo, const QString &filename = {}, const QString &uploadServiceJid = {});
 
 private:
+    void putData(const std::shared_ptr<QXmppHttpUpload> &upload, const QNetworkRequest &request);
+
     std::unique_ptr<QXmppHttpUploadManagerPrivate> d;
 };
 
@@ -4,6 +4,8 @@
 
 #include "QXmppInvokable.h"
 
+#include <array>
+
 #include <QMetaMethod>
 #include <QStringList>
 #include <QVariant>
@@ -28,47 +30,39 @@ QVariant QXmppInvokable::dispatch(const QByteArray &method, const QList<QVariant
 {
     buildMethodHash();
 
-    if (!m_methodHash.contains(method)) {
+    const auto itr = m_methodHash.constFind(method);
+    if (itr == m_methodHash.constEnd()) {
         return QVariant();
     }
 
-    int idx = m_methodHash[method];
-    if (paramTypes(args) != metaObject()->method(idx).parameterTypes()) {
+    if (args.size() != itr->parameterTypes.size()) {
         return QVariant();
     }
-
-    const char *typeName = metaObject()->method(idx).typeName();
-    int resultType = QMetaType::type(typeName);
-
-    void *result = QMetaType::create(resultType, nullptr);
-
-    QGenericReturnArgument ret(typeName, result);
-    QList<QGenericArgument> genericArgs;
-    QList<QVariant>::ConstIterator iter = args.begin();
-    while (iter != args.end()) {
-        const void *data = iter->data();
-        const char *name = iter->typeName();
-        genericArgs << QGenericArgument(name, data);
-        ++iter;
+    for (int i = 0; i < args.size(); i++) {
+        if (args.at(i).userType() != itr->parameterTypes.at(i)) {
+            return QVariant();
+        }
     }
 
-    if (QMetaObject::invokeMethod(this, method.constData(), ret,
-                                  genericArgs.value(0, QGenericArgument()),
-                                  genericArgs.value(1, QGenericArgument()),
-                                  genericArgs.value(2, QGenericArgument()),
-                                  genericArgs.value(3, QGenericArgument()),
-                                  genericArgs.value(4, QGenericArgument()),
-                                  genericArgs.value(5, QGenericArgument()),
-                                  genericArgs.value(6, QGenericArgument()),
-                                  genericArgs.value(7, QGenericArgument()),
-                                  genericArgs.value(8, QGenericArgument()),
-                                  genericArgs.value(9, QGenericArgument()))) {
+    // the result is written directly into the returned variant
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-        QVariant returnValue(QMetaType(resultType), result);
+    QVariant returnValue(QMetaType(itr->returnType), nullptr);
 #else
-        QVariant returnValue(resultType, result);
+    QVariant returnValue(itr->returnType, nullptr);
 #endif
-        QMetaType::destroy(resultType, result);
+    QGenericReturnArgument ret;
+    if (itr->returnType != QMetaType::Void) {
+        ret = QGenericReturnArgument(itr->method.typeName(), returnValue.data());
+    }
+
+    std::array<QGenericArgument, 10> genericArgs;
+    for (int i = 0; i < args.size() && i < int(genericArgs.size()); i++) {
+        genericArgs[i] = QGenericArgument(args.at(i).typeName(), args.at(i).constData());
+    }
+
+    if (itr->method.invoke(this, Qt::DirectConnection, ret,
+                           genericArgs[0], genericArgs[1], genericArgs[2], genericArgs[3], genericArgs[4],
+                           genericArgs[5], genericArgs[6], genericArgs[7], genericArgs[8], genericArgs[9])) {
         return returnValue;
     } else {
         qDebug("No such method '%s'", method.constData());
@@ -92,11 +86,19 @@ void QXmppInvokable::buildMethodHash()
         return;
     }
 
+    // the types are resolved once, so dispatching does not need to look
+    // them up by name
     int methodCount = metaObject()->methodCount();
     for (int idx = 0; idx < methodCount; ++idx) {
-        QByteArray signature = metaObject()->method(idx).methodSignature();
-        m_methodHash[signature.left(signature.indexOf('('))] = idx;
-        //         qDebug() << metaObject()->method(idx).parameterTypes();
+        const auto metaMethod = metaObject()->method(idx);
+        const auto signature = metaMethod.methodSignature();
+
+        Method method { metaMethod, metaMethod.returnType(), {} };
+        method.parameterTypes.reserve(metaMethod.parameterCount());
+        for (int i = 0; i < metaMethod.parameterCount(); i++) {
+            method.parameterTypes << metaMethod.parameterType(i);
+        }
+        m_methodHash[signature.left(signature.indexOf('('))] = method;
     }
 }
 
@@ -8,9 +8,11 @@
 #include "QXmppGlobal.h"
 
 #include <QHash>
+#include <QMetaMethod>
 #include <QObject>
 #include <QStringList>
 #include <QVariant>
+#include <QVector>
 #include <QWriteLocker>
 
 /**
@@ -51,8 +53,16 @@ public Q_SLOTS:
     QStringList interfaces() const;
 
 private:
+    // method with the types of its return value and parameters resolved
+    struct Method
+    {
+        QMetaMethod method;
+        int returnType;
+        QVector<int> parameterTypes;
+    };
+
     void buildMethodHash();
-    QHash<QByteArray, int> m_methodHash;
+    QHash<QByteArray, Method> m_methodHash;
     QReadWriteLock m_lock;
 };
 
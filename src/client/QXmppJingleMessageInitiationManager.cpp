@@ -5,32 +5,49 @@
 
 #include "QXmppJingleMessageInitiationManager.h"
 
+#include "QXmppCallSessionRegistry_p.h"
 #include "QXmppClient.h"
 #include "QXmppConstants_p.h"
 #include "QXmppMessage.h"
 #include "QXmppPromise.h"
 #include "QXmppUtils.h"
 
+#include <QPointer>
 #include <QStringBuilder>
+#include <QTimer>
 #include <QUuid>
 
 using namespace QXmpp;
+using namespace QXmpp::Private;
 using Jmi = QXmppJingleMessageInitiation;
 using JmiManager = QXmppJingleMessageInitiationManager;
 using JmiElement = QXmppJingleMessageInitiationElement;
 using JmiType = JmiElement::Type;
 
+class QXmppJingleMessageInitiationManagerPrivate
+{
+public:
+    CallSessionRegistry<Jmi> jmis;
+    // 0 if the JMIs don't expire
+    int expiryTimeout = 0;
+    QTimer expiryTimer;
+};
+
 class QXmppJingleMessageInitiationPrivate
 {
 public:
-    QXmppJingleMessageInitiationPrivate(JmiManager *manager)
-        : manager(manager)
+    QXmppJingleMessageInitiationPrivate(Jmi *q, JmiManager *manager)
+        : q(q),
+          manager(manager)
     {
     }
 
     QXmppTask<SendResult> request(JmiElement &&jmiElement);
+    void setKey(const QString &newCallPartnerJid, const QString &newId);
 
-    QXmppJingleMessageInitiationManager *manager;
+    Jmi *q;
+    // null if the manager has been destroyed before the JMI
+    QPointer<QXmppJingleMessageInitiationManager> manager;
     QString id;
     QString callPartnerJid;
     bool isProceeded { false };
@@ -43,9 +60,22 @@ public:
 QXmppTask<SendResult> QXmppJingleMessageInitiationPrivate::request(JmiElement &&jmiElement)
 {
     jmiElement.setId(id);
+    manager->d->jmis.touch(callPartnerJid, id);
     return manager->sendMessage(jmiElement, callPartnerJid);
 }
 
+///
+/// Changes the ID or the call partner and updates the index of the manager.
+///
+void QXmppJingleMessageInitiationPrivate::setKey(const QString &newCallPartnerJid, const QString &newId)
+{
+    const auto previousCallPartnerJid = std::exchange(callPartnerJid, newCallPartnerJid);
+    const auto previousId = std::exchange(id, newId);
+    if (manager) {
+        manager->d->jmis.rekey(q, previousCallPartnerJid, previousId, callPartnerJid, id);
+    }
+}
+
 ///
 /// \class QXmppJingleMessageInitiation
 ///
@@ -59,7 +89,7 @@ QXmppTask<SendResult> QXmppJingleMessageInitiationPrivate::request(JmiElement &&
 /// \brief Constructs a Jingle Message Initiation object.
 ///
 QXmppJingleMessageInitiation::QXmppJingleMessageInitiation(QXmppJingleMessageInitiationManager *manager)
-    : d(new QXmppJingleMessageInitiationPrivate(manager))
+    : d(new QXmppJingleMessageInitiationPrivate(this, manager))
 {
 }
 
@@ -172,7 +202,7 @@ QString QXmppJingleMessageInitiation::id() const
 ///
 void QXmppJingleMessageInitiation::setId(const QString &id)
 {
-    d->id = id;
+    d->setKey(d->callPartnerJid, id);
 }
 
 ///
@@ -186,7 +216,7 @@ void QXmppJingleMessageInitiation::setId(const QString &id)
 ///
 void QXmppJingleMessageInitiation::setCallPartnerJid(const QString &callPartnerJid)
 {
-    d->callPartnerJid = callPartnerJid;
+    d->setKey(callPartnerJid, d->id);
 }
 
 ///
@@ -240,12 +270,6 @@ void QXmppJingleMessageInitiation::setIsProceeded(bool isProceeded)
 /// \param result close reason
 ///
 
-class QXmppJingleMessageInitiationManagerPrivate
-{
-public:
-    QVector<std::shared_ptr<Jmi>> jmis;
-};
-
 ///
 /// \typedef QXmppJingleMessageInitiationManager::ProposeResult
 ///
@@ -263,10 +287,43 @@ public:
 QXmppJingleMessageInitiationManager::QXmppJingleMessageInitiationManager()
     : d(std::make_unique<QXmppJingleMessageInitiationManagerPrivate>())
 {
+    connect(&d->expiryTimer, &QTimer::timeout, this, &JmiManager::removeExpiredJmis);
 }
 
 QXmppJingleMessageInitiationManager::~QXmppJingleMessageInitiationManager() = default;
 
+///
+/// Returns the time in seconds after which JMIs without activity are closed.
+///
+/// \since QXmpp 1.6
+///
+int QXmppJingleMessageInitiationManager::expiryTimeout() const
+{
+    return d->expiryTimeout;
+}
+
+///
+/// Sets the time in seconds after which JMIs without activity are closed.
+///
+/// JMIs that haven't been proceeded and haven't sent or received an element
+/// within the timeout are removed and closed with an error, so unanswered
+/// proposals don't accumulate. Proceeded JMIs never expire.
+///
+/// The default is 0, which disables the expiry.
+///
+/// \since QXmpp 1.6
+///
+void QXmppJingleMessageInitiationManager::setExpiryTimeout(int secs)
+{
+    d->expiryTimeout = std::max(0, secs);
+    if (d->expiryTimeout > 0) {
+        // checking twice per timeout expires the JMIs at most half a timeout late
+        d->expiryTimer.start(d->expiryTimeout * 500);
+    } else {
+        d->expiryTimer.stop();
+    }
+}
+
 /// \cond
 QStringList QXmppJingleMessageInitiationManager::discoveryFeatures() const
 {
@@ -337,24 +394,17 @@ QXmppTask<SendResult> QXmppJingleMessageInitiationManager::sendMessage(const QXm
 }
 
 ///
-/// Removes a JMI object from the JMIs vector.
+/// Removes a JMI object.
 ///
 /// \param jmi object to be removed
 ///
 void QXmppJingleMessageInitiationManager::clear(const std::shared_ptr<QXmppJingleMessageInitiation> &jmi)
 {
-    d->jmis.erase(
-        std::remove_if(
-            d->jmis.begin(),
-            d->jmis.end(),
-            [&jmi](const auto &storedJmi) {
-                return jmi->id() == storedJmi->id() && jmi->callPartnerJid() == storedJmi->callPartnerJid();
-            }),
-        d->jmis.end());
+    d->jmis.remove(jmi->callPartnerJid(), jmi->id());
 }
 
 ///
-/// Removes all JMI objects from the JMI vector.
+/// Removes all JMI objects.
 ///
 void QXmppJingleMessageInitiationManager::clearAll()
 {
@@ -366,14 +416,11 @@ bool QXmppJingleMessageInitiationManager::handleJmiElement(QXmppJingleMessageIni
     auto jmiElementId = jmiElement.id();
     auto callPartnerJid = QXmppUtils::jidToBareJid(senderJid);
 
-    // Check if there's already a JMI object with jmiElementId and callPartnerJid in JMIs vector.
+    // Check if there's already a JMI object with jmiElementId and callPartnerJid.
     // That means that a JMI has already been created with given (J)IDs.
-    auto itr = std::find_if(d->jmis.begin(), d->jmis.end(), [&jmiElementId, &callPartnerJid](const auto &jmi) {
-        return jmi->id() == jmiElementId && jmi->callPartnerJid() == callPartnerJid;
-    });
-
-    if (itr != d->jmis.end()) {
-        return handleExistingJmi(*itr, jmiElement, QXmppUtils::jidToResource(senderJid));
+    if (auto jmi = d->jmis.find(callPartnerJid, jmiElementId)) {
+        d->jmis.touch(callPartnerJid, jmiElementId);
+        return handleExistingJmi(jmi, jmiElement, QXmppUtils::jidToResource(senderJid));
     }
 
     if (jmiElement.type() == JmiType::Propose) {
@@ -384,7 +431,7 @@ bool QXmppJingleMessageInitiationManager::handleJmiElement(QXmppJingleMessageIni
 }
 
 ///
-/// Handles a JMI object which already exists in the JMIs vector.
+/// Handles a JMI object which already exists.
 ///
 /// \param existingJmi JMI object to be handled
 /// \param jmiElement JMI element to be processed with the JMI object
@@ -428,18 +475,11 @@ bool QXmppJingleMessageInitiationManager::handleExistingJmi(const std::shared_pt
 ///
 bool QXmppJingleMessageInitiationManager::handleProposeJmiElement(const QXmppJingleMessageInitiationElement &jmiElement, const QString &callPartnerJid)
 {
-    // Check if there's already a JMI object with provided callPartnerJid in JMIs vector.
+    // Check if there's already a JMI object with provided callPartnerJid.
     // That means that a propose has already been sent.
-    auto itr = std::find_if(
-        d->jmis.cbegin(),
-        d->jmis.cend(),
-        [&callPartnerJid](const auto &jmi) {
-            return jmi->callPartnerJid() == callPartnerJid;
-        });
-
     // Tie break case or usual JMI proposal?
-    if (itr != d->jmis.end()) {
-        return handleTieBreak(*itr, jmiElement, callPartnerJid);
+    if (auto jmi = d->jmis.findByCallPartner(callPartnerJid)) {
+        return handleTieBreak(jmi, jmiElement, callPartnerJid);
     }
 
     Q_EMIT proposed(addJmi(callPartnerJid), jmiElement.id(), jmiElement.description());
@@ -553,7 +593,7 @@ bool QXmppJingleMessageInitiationManager::handleNonExistingSession(const std::sh
 }
 
 ///
-/// Adds a JMI object to the JMIs vector and sets the bare JID of the call partner in the JMI object.
+/// Adds a JMI object and sets the bare JID of the call partner in the JMI object.
 /// \param callPartnerJid bare JID of the call partner
 /// \return The newly created JMI
 ///
@@ -561,16 +601,30 @@ std::shared_ptr<QXmppJingleMessageInitiation> QXmppJingleMessageInitiationManage
 {
     auto jmi { std::make_shared<QXmppJingleMessageInitiation>(this) };
     jmi->setCallPartnerJid(callPartnerJid);
-    d->jmis.append(jmi);
+    d->jmis.insert(callPartnerJid, {}, jmi);
     return jmi;
 }
 
 ///
-/// Returns the JMIs vector.
+/// Returns the JMIs.
 ///
-const QVector<std::shared_ptr<QXmppJingleMessageInitiation>> &QXmppJingleMessageInitiationManager::jmis() const
+QVector<std::shared_ptr<QXmppJingleMessageInitiation>> QXmppJingleMessageInitiationManager::jmis() const
 {
-    return d->jmis;
+    return d->jmis.sessions();
+}
+
+///
+/// Removes and closes the JMIs that have expired.
+///
+void QXmppJingleMessageInitiationManager::removeExpiredJmis()
+{
+    const auto expiredJmis = d->jmis.removeExpired(qint64(d->expiryTimeout) * 1000, [](const Jmi &jmi) {
+        return !jmi.isProceeded();
+    });
+
+    for (const auto &jmi : expiredJmis) {
+        Q_EMIT jmi->closed(QXmppError { QStringLiteral("Jingle Message Initiation expired"), {} });
+    }
 }
 
 ///
@@ -78,6 +78,9 @@ public:
     QXmppJingleMessageInitiationManager();
     ~QXmppJingleMessageInitiationManager();
 
+    int expiryTimeout() const;
+    void setExpiryTimeout(int secs);
+
     /// \cond
     QStringList discoveryFeatures() const override;
     /// \endcond
@@ -112,7 +115,8 @@ private:
     bool handleExistingSession(const std::shared_ptr<QXmppJingleMessageInitiation> &existingJmi, const QString &jmiElementId);
     bool handleNonExistingSession(const std::shared_ptr<QXmppJingleMessageInitiation> &existingJmi, const QString &jmiElementId, const QString &callPartnerResource);
     std::shared_ptr<QXmppJingleMessageInitiation> addJmi(const QString &callPartnerJid);
-    const QVector<std::shared_ptr<QXmppJingleMessageInitiation>> &jmis() const;
+    QVector<std::shared_ptr<QXmppJingleMessageInitiation>> jmis() const;
+    void removeExpiredJmis();
 
 private:
     std::unique_ptr<QXmppJingleMessageInitiationManagerPrivate> d;
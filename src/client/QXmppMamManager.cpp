@@ -9,11 +9,14 @@
 #include "QXmppConstants_p.h"
 #include "QXmppDataForm.h"
 #include "QXmppE2eeExtension.h"
+#include "QXmppFutureUtils_p.h"
 #include "QXmppMamIq.h"
 #include "QXmppMessage.h"
+#include "QXmppMessageArchiveStorage.h"
 #include "QXmppPromise.h"
 #include "QXmppUtils.h"
 
+#include <deque>
 #include <unordered_map>
 
 #include <QDomElement>
@@ -41,6 +44,8 @@ struct MamMessage
 {
     QDomElement element;
     std::optional<QDateTime> delay;
+    // ID of the message in the archive
+    QString id;
 };
 
 enum EncryptedType { Unencrypted,
@@ -53,6 +58,10 @@ QXmppMessage parseMamMessage(const MamMessage &mamMessage, EncryptedType encrypt
     if (mamMessage.delay) {
         m.setStamp(*mamMessage.delay);
     }
+    // the archive ID is the stanza ID assigned by the archive (XEP-0313)
+    if (m.stanzaId().isEmpty()) {
+        m.setStanzaId(mamMessage.id);
+    }
     return m;
 }
 
@@ -83,7 +92,7 @@ std::optional<std::tuple<MamMessage, QString>> parseMamMessageResult(const QDomE
         return {};
     };
 
-    return { { MamMessage { messageElement, parseDelay(forwardedElement) }, queryId } };
+    return { { MamMessage { messageElement, parseDelay(forwardedElement), resultElement.attribute("id") }, queryId } };
 }
 
 struct RetrieveRequestState
@@ -104,13 +113,86 @@ struct RetrieveRequestState
     }
 };
 
+struct StreamRequestState
+{
+    QXmppPromise<QXmppMamManager::StreamResult> promise;
+    QXmppMamManager::MessageHandler handler;
+
+    // query
+    QString to;
+    QString node;
+    QString jid;
+    QDateTime start;
+    QDateTime end;
+    int pageSize = 0;
+
+    // messages in archive order, empty while they are decrypted
+    std::deque<std::optional<QXmppMessage>> pendingMessages;
+    // number of messages that have been removed from the front of pendingMessages
+    qsizetype deliveredCount = 0;
+
+    QXmppResultSetReply lastReply;
+    bool complete = false;
+    bool finished = false;
+
+    void deliverMessages()
+    {
+        while (!pendingMessages.empty() && pendingMessages.front()) {
+            auto message = std::move(*pendingMessages.front());
+            pendingMessages.pop_front();
+            deliveredCount++;
+            handler(std::move(message));
+        }
+    }
+
+    void tryFinish()
+    {
+        if (complete && !finished && pendingMessages.empty()) {
+            finished = true;
+            promise.finish(std::move(lastReply));
+        }
+    }
+
+    void fail(QXmppError &&error)
+    {
+        if (!finished) {
+            finished = true;
+            promise.finish(std::move(error));
+        }
+    }
+};
+
+// state of synchronizeArchive()
+struct SynchronizeState
+{
+    QXmppPromise<QXmppMamManager::ArchiveResult> promise;
+    QString to;
+    QString jid;
+    int pageSize = 0;
+    QVector<QXmppMessage> messages;
+};
+
 class QXmppMamManagerPrivate
 {
 public:
+    void requestStreamPage(QXmppMamManager *q, QXmppClient *client, const std::shared_ptr<StreamRequestState> &state, const QString &after);
+    void addStreamMessage(QXmppMamManager *q, QXmppClient *client, const std::shared_ptr<StreamRequestState> &state, const MamMessage &message);
+    void synchronizePage(QXmppMamManager *q, const std::shared_ptr<SynchronizeState> &state, const QXmppResultSetQuery &resultSetQuery);
+
     // std::string because older Qt 5 versions don't add std::hash support for QString
     std::unordered_map<std::string, RetrieveRequestState> ongoingRequests;
+    // query ID of the current page -> streaming request
+    std::unordered_map<std::string, std::shared_ptr<StreamRequestState>> ongoingStreams;
+
+    QXmppMessageArchiveStorage *archiveStorage = nullptr;
 };
 
+// key of a conversation in the archive storage
+static QString conversationKey(const QString &jid, const QString &to)
+{
+    return QXmppUtils::jidToBareJid(jid.isEmpty() ? to : jid);
+}
+
 ///
 /// \struct QXmppMamManager::RetrievedMessages
 ///
@@ -161,8 +243,13 @@ bool QXmppMamManager::handleStanza(const QDomElement &element)
 
             auto itr = d->ongoingRequests.find(queryId.toStdString());
             if (itr != d->ongoingRequests.end()) {
-                // future-based API
-                itr->second.messages.append(std::move(message));
+                // future-based API, nobody is interested in the results of cancelled requests
+                if (!itr->second.promise.isCancelled()) {
+                    itr->second.messages.append(std::move(message));
+                }
+            } else if (auto stream = d->ongoingStreams.find(queryId.toStdString()); stream != d->ongoingStreams.end()) {
+                // streaming API
+                d->addStreamMessage(this, client(), stream->second, message);
             } else {
                 // signal-based API
                 Q_EMIT archivedMessageReceived(queryId, parseMamMessage(message, Unencrypted));
@@ -284,6 +371,9 @@ QString QXmppMamManager::retrieveArchivedMessages(const QString &to,
 /// \return query id of the request. This can be used to associate the
 ///         corresponding resultsRecieved signal.
 ///
+/// If the returned task is cancelled, the messages of the query are dropped
+/// when they are received.
+///
 /// \since QXmpp 1.5
 ///
 QXmppTask<QXmppMamManager::RetrieveResult> QXmppMamManager::retrieveMessages(const QString &to, const QString &node, const QString &jid, const QDateTime &start, const QDateTime &end, const QXmppResultSetQuery &resultSetQuery)
@@ -305,6 +395,12 @@ QXmppTask<QXmppMamManager::RetrieveResult> QXmppMamManager::retrieveMessages(con
         }
         auto &state = itr->second;
 
+        // the result IQ ends the query, the request is only removed then
+        if (state.promise.isCancelled()) {
+            d->ongoingRequests.erase(itr);
+            return;
+        }
+
         // handle IQ sending errors
         if (std::holds_alternative<QXmppError>(result)) {
             state.promise.finish(std::get<QXmppError>(result));
@@ -384,3 +480,283 @@ QXmppTask<QXmppMamManager::RetrieveResult> QXmppMamManager::retrieveMessages(con
 
     return task;
 }
+
+///
+/// Retrieves archived messages page by page and delivers each message as soon
+/// as it has been received.
+///
+/// In contrast to retrieveMessages(), the messages of a page are not collected
+/// before they are reported, and the Result Set Management pages are requested
+/// automatically until the whole archive (or the requested time range) has been
+/// received. The next page is requested as soon as the server has finished the
+/// current one, even if messages of that page are still being decrypted.
+///
+/// The handler is called in archive order. Encrypted messages are decrypted
+/// first; the following messages are held back until that is done.
+///
+/// The archive can be fetched faster by running multiple requests for disjoint
+/// time ranges in parallel. Each request delivers its messages independently.
+///
+/// \param handler function called for each message, must stay valid until the
+///                returned task has finished
+/// \param to Optional entity that should be queried. Leave this empty to query
+///           the local archive.
+/// \param node Optional node that should be queried. This is used when querying
+///             a pubsub node.
+/// \param jid Optional JID to filter the results.
+/// \param start Optional start time to filter the results.
+/// \param end Optional end time to filter the results.
+/// \param pageSize Maximum number of messages requested per page.
+/// \return the result set of the last page or an error
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QXmppMamManager::StreamResult> QXmppMamManager::streamMessages(MessageHandler handler, const QString &to, const QString &node, const QString &jid, const QDateTime &start, const QDateTime &end, int pageSize)
+{
+    auto state = std::make_shared<StreamRequestState>();
+    state->handler = std::move(handler);
+    state->to = to;
+    state->node = node;
+    state->jid = jid;
+    state->start = start;
+    state->end = end;
+    state->pageSize = pageSize;
+
+    // create task here; promise could finish immediately
+    auto task = state->promise.task();
+    d->requestStreamPage(this, client(), state, {});
+    return task;
+}
+
+void QXmppMamManagerPrivate::requestStreamPage(QXmppMamManager *q, QXmppClient *client, const std::shared_ptr<StreamRequestState> &state, const QString &after)
+{
+    QXmppResultSetQuery resultSetQuery;
+    resultSetQuery.setMax(state->pageSize);
+    resultSetQuery.setAfter(after);
+
+    auto queryIq = buildRequest(state->to, state->node, state->jid, state->start, state->end, resultSetQuery);
+    const auto queryId = queryIq.queryId().toStdString();
+    ongoingStreams.insert({ queryId, state });
+
+    client->sendIq(std::move(queryIq)).then(q, [this, q, client, state, queryId](QXmppClient::IqResult &&result) {
+        ongoingStreams.erase(queryId);
+
+        if (auto *error = std::get_if<QXmppError>(&result)) {
+            state->fail(std::move(*error));
+            return;
+        }
+
+        QXmppMamResultIq iq;
+        iq.parse(std::get<QDomElement>(result));
+        if (iq.type() == QXmppIq::Error) {
+            state->fail(QXmppError { iq.error().text(), iq.error() });
+            return;
+        }
+
+        state->lastReply = iq.resultSetReply();
+        const auto last = state->lastReply.last();
+        if (!iq.complete() && !last.isEmpty() && !state->finished) {
+            // pipeline the next page, the current one may still be decrypted
+            requestStreamPage(q, client, state, last);
+        } else {
+            state->complete = true;
+            state->tryFinish();
+        }
+    });
+}
+
+void QXmppMamManagerPrivate::addStreamMessage(QXmppMamManager *q, QXmppClient *client, const std::shared_ptr<StreamRequestState> &state, const MamMessage &message)
+{
+    auto *e2eeExt = client->encryptionExtension();
+    if (!e2eeExt || !e2eeExt->isEncrypted(message.element)) {
+        state->pendingMessages.push_back(parseMamMessage(message, Unencrypted));
+        state->deliverMessages();
+        return;
+    }
+
+    const auto index = state->deliveredCount + qsizetype(state->pendingMessages.size());
+    state->pendingMessages.emplace_back();
+
+    e2eeExt->decryptMessage(parseMamMessage(message, Encrypted)).then(q, [state, index, message](auto result) {
+        // store decrypted message, fallback to encrypted message
+        auto &slot = state->pendingMessages[index - state->deliveredCount];
+        if (std::holds_alternative<QXmppMessage>(result)) {
+            slot = std::get<QXmppMessage>(std::move(result));
+        } else {
+            slot = parseMamMessage(message, Unencrypted);
+        }
+
+        state->deliverMessages();
+        state->tryFinish();
+    });
+}
+
+///
+/// Returns the storage of the local message archive.
+///
+/// There is no storage by default.
+///
+/// \since QXmpp 1.6
+///
+QXmppMessageArchiveStorage *QXmppMamManager::archiveStorage() const
+{
+    return d->archiveStorage;
+}
+
+///
+/// Sets the storage of the local message archive.
+///
+/// With a storage, synchronizeArchive() and loadArchivedMessages() keep a
+/// local copy of the server's archive, so the history can be shown and
+/// searched without querying the server. The storage is not owned by the
+/// manager.
+///
+/// \param storage storage to use, nullptr disables the local archive
+///
+/// \since QXmpp 1.6
+///
+void QXmppMamManager::setArchiveStorage(QXmppMessageArchiveStorage *storage)
+{
+    d->archiveStorage = storage;
+}
+
+///
+/// Fetches the messages of a conversation that are newer than the newest
+/// message in the archiveStorage() and adds them to the storage.
+///
+/// All messages since the stored one are fetched page by page using
+/// \xep{0059, Result Set Management}, so the stored history has no gaps. If
+/// no message of the conversation has been stored yet, only the latest page
+/// is fetched; older messages are loaded by loadArchivedMessages().
+///
+/// Call this after connecting to fill the gap since the last session.
+///
+/// \param jid JID of the conversation partner, used to filter the archive.
+///            Leave this empty to synchronize the archive of \a to, e.g. of a
+///            MUC room.
+/// \param to Optional entity whose archive is queried. Leave this empty to
+///           query the user's archive.
+/// \param pageSize Maximum number of messages requested per page.
+/// \return the newly fetched messages in chronological order or an error
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QXmppMamManager::ArchiveResult> QXmppMamManager::synchronizeArchive(const QString &jid, const QString &to, int pageSize)
+{
+    if (!d->archiveStorage) {
+        return makeReadyTask<ArchiveResult>(QXmppError { QStringLiteral("No archive storage has been set."), {} });
+    }
+
+    auto state = std::make_shared<SynchronizeState>();
+    state->to = to;
+    state->jid = jid;
+    state->pageSize = pageSize;
+
+    auto task = state->promise.task();
+    d->archiveStorage->lastMessage(conversationKey(jid, to)).then(this, [this, state](std::optional<QXmppMessage> &&last) {
+        QXmppResultSetQuery resultSetQuery;
+        resultSetQuery.setMax(state->pageSize);
+        if (last) {
+            resultSetQuery.setAfter(last->stanzaId());
+        } else {
+            // empty, but not null: the last page
+            resultSetQuery.setBefore(QStringLiteral(""));
+        }
+        d->synchronizePage(this, state, resultSetQuery);
+    });
+    return task;
+}
+
+void QXmppMamManagerPrivate::synchronizePage(QXmppMamManager *q, const std::shared_ptr<SynchronizeState> &state, const QXmppResultSetQuery &resultSetQuery)
+{
+    q->retrieveMessages(state->to, {}, state->jid, {}, {}, resultSetQuery).then(q, [this, q, state, resultSetQuery](QXmppMamManager::RetrieveResult &&result) {
+        if (auto *error = std::get_if<QXmppError>(&result)) {
+            state->promise.finish(std::move(*error));
+            return;
+        }
+
+        auto retrieved = std::get<QXmppMamManager::RetrievedMessages>(std::move(result));
+        if (!archiveStorage) {
+            state->promise.finish(QXmppError { QStringLiteral("The archive storage has been removed."), {} });
+            return;
+        }
+
+        archiveStorage->addMessages(conversationKey(state->jid, state->to), retrieved.messages).then(q, [this, q, state, resultSetQuery, retrieved]() {
+            state->messages += retrieved.messages;
+
+            // only newer messages are fetched page by page
+            const auto last = retrieved.result.resultSetReply().last();
+            if (resultSetQuery.before().isNull() && !retrieved.result.complete() && !last.isEmpty() && !retrieved.messages.isEmpty()) {
+                QXmppResultSetQuery next;
+                next.setMax(state->pageSize);
+                next.setAfter(last);
+                synchronizePage(q, state, next);
+            } else {
+                state->promise.finish(std::move(state->messages));
+            }
+        });
+    });
+}
+
+///
+/// Returns messages of a conversation before the message with the stanza ID
+/// \a before, for scrolling back in the history.
+///
+/// The messages are taken from the archiveStorage(). If it doesn't contain
+/// enough older messages, the missing ones are fetched from the server and
+/// added to the storage, so the next time they are available locally.
+///
+/// \param jid JID of the conversation partner, used to filter the archive.
+///            Leave this empty to load messages from the archive of \a to,
+///            e.g. of a MUC room.
+/// \param before Stanza ID of the oldest message that is already known. Leave
+///               this empty to load the latest messages.
+/// \param max Maximum number of returned messages.
+/// \param to Optional entity whose archive is queried. Leave this empty to
+///           query the user's archive.
+/// \return up to \a max messages in chronological order or an error
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QXmppMamManager::ArchiveResult> QXmppMamManager::loadArchivedMessages(const QString &jid, const QString &before, int max, const QString &to)
+{
+    if (!d->archiveStorage) {
+        return makeReadyTask<ArchiveResult>(QXmppError { QStringLiteral("No archive storage has been set."), {} });
+    }
+
+    const auto conversation = conversationKey(jid, to);
+
+    QXmppMessageArchiveStorage::Query query;
+    query.resultSetQuery.setMax(max);
+    // empty, but not null: the last page
+    query.resultSetQuery.setBefore(before.isEmpty() ? QStringLiteral("") : before);
+
+    QXmppPromise<ArchiveResult> promise;
+    auto task = promise.task();
+    d->archiveStorage->messages(conversation, query).then(this, [this, promise, jid, to, before, max, conversation](QVector<QXmppMessage> &&stored) mutable {
+        if (stored.size() >= max) {
+            promise.finish(std::move(stored));
+            return;
+        }
+
+        // fetch the messages before the oldest known one from the server
+        QXmppResultSetQuery resultSetQuery;
+        resultSetQuery.setMax(max - int(stored.size()));
+        resultSetQuery.setBefore(stored.isEmpty() ? (before.isEmpty() ? QStringLiteral("") : before) : stored.constFirst().stanzaId());
+
+        retrieveMessages(to, {}, jid, {}, {}, resultSetQuery).then(this, [this, promise, stored = std::move(stored), conversation](RetrieveResult &&result) mutable {
+            if (auto *error = std::get_if<QXmppError>(&result)) {
+                promise.finish(std::move(*error));
+                return;
+            }
+
+            auto messages = std::get<RetrievedMessages>(std::move(result)).messages;
+            if (d->archiveStorage) {
+                d->archiveStorage->addMessages(conversation, messages);
+            }
+            messages += stored;
+            promise.finish(std::move(messages));
+        });
+    });
+    return task;
+}
@@ -10,6 +10,7 @@
 #include "QXmppMamIq.h"
 #include "QXmppResultSet.h"
 
+#include <functional>
 #include <variant>
 
 #include <QDateTime>
@@ -17,6 +18,7 @@
 template<typename T>
 class QXmppTask;
 class QXmppMessage;
+class QXmppMessageArchiveStorage;
 class QXmppMamManagerPrivate;
 
 ///
@@ -47,6 +49,9 @@ public:
     };
 
     using RetrieveResult = std::variant<RetrievedMessages, QXmppError>;
+    using MessageHandler = std::function<void(QXmppMessage &&)>;
+    using StreamResult = std::variant<QXmppResultSetReply, QXmppError>;
+    using ArchiveResult = std::variant<QVector<QXmppMessage>, QXmppError>;
 
     QXmppMamManager();
     ~QXmppMamManager();
@@ -63,6 +68,24 @@ public:
                                                const QDateTime &start = QDateTime(),
                                                const QDateTime &end = QDateTime(),
                                                const QXmppResultSetQuery &resultSetQuery = QXmppResultSetQuery());
+    QXmppTask<StreamResult> streamMessages(MessageHandler handler,
+                                           const QString &to = QString(),
+                                           const QString &node = QString(),
+                                           const QString &jid = QString(),
+                                           const QDateTime &start = QDateTime(),
+                                           const QDateTime &end = QDateTime(),
+                                           int pageSize = 100);
+
+    QXmppMessageArchiveStorage *archiveStorage() const;
+    void setArchiveStorage(QXmppMessageArchiveStorage *storage);
+
+    QXmppTask<ArchiveResult> synchronizeArchive(const QString &jid,
+                                                const QString &to = QString(),
+                                                int pageSize = 100);
+    QXmppTask<ArchiveResult> loadArchivedMessages(const QString &jid,
+                                                  const QString &before = QString(),
+                                                  int max = 50,
+                                                  const QString &to = QString());
 
     /// \cond
     QStringList discoveryFeatures() const override;
@@ -0,0 +1,279 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppMessageArchiveMemoryStorage.h"
+
+#include "QXmppFutureUtils_p.h"
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+
+#include <QHash>
+#include <QSet>
+
+using namespace QXmpp::Private;
+
+///
+/// \class QXmppMessageArchiveMemoryStorage
+///
+/// \brief The QXmppMessageArchiveMemoryStorage class stores archived messages
+/// in the memory.
+///
+/// The messages of a conversation are kept in a time index, so querying a time
+/// range or a page next to a known message is a binary search. Searching for
+/// text scans the messages of the conversation, unless the full-text index has
+/// been enabled.
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+
+// splits a text into case-folded words
+static QSet<QString> textWords(const QString &text)
+{
+    QSet<QString> words;
+    qsizetype start = -1;
+    for (qsizetype i = 0; i <= text.size(); i++) {
+        const bool isWordCharacter = i < text.size() && text.at(i).isLetterOrNumber();
+        if (isWordCharacter && start < 0) {
+            start = i;
+        } else if (!isWordCharacter && start >= 0) {
+            words.insert(text.mid(start, i - start).toCaseFolded());
+            start = -1;
+        }
+    }
+    return words;
+}
+
+static bool isBefore(const QXmppMessage &message, const QDateTime &stamp)
+{
+    return message.stamp() < stamp;
+}
+
+static bool isAfter(const QDateTime &stamp, const QXmppMessage &message)
+{
+    return stamp < message.stamp();
+}
+
+struct ArchivedConversation
+{
+    using Iterator = std::deque<QXmppMessage>::const_iterator;
+
+    std::optional<Iterator> find(const QString &stanzaId) const;
+    bool matches(const QXmppMessage &message, const QSet<QString> &words, bool fullTextIndexEnabled) const;
+    void index(const QXmppMessage &message);
+
+    // ordered by stamp, messages with the same stamp in the order they were added
+    std::deque<QXmppMessage> messages;
+    // stanza ID -> stamp, to find a message in the time index
+    QHash<QString, QDateTime> stamps;
+    // full-text index: word -> stanza IDs
+    QHash<QString, QSet<QString>> words;
+};
+
+std::optional<ArchivedConversation::Iterator> ArchivedConversation::find(const QString &stanzaId) const
+{
+    const auto stamp = stamps.constFind(stanzaId);
+    if (stamp == stamps.constEnd()) {
+        return {};
+    }
+
+    const auto begin = std::lower_bound(messages.cbegin(), messages.cend(), *stamp, isBefore);
+    const auto end = std::upper_bound(begin, messages.cend(), *stamp, isAfter);
+    const auto itr = std::find_if(begin, end, [&](const auto &message) {
+        return message.stanzaId() == stanzaId;
+    });
+    if (itr == end) {
+        return {};
+    }
+    return itr;
+}
+
+bool ArchivedConversation::matches(const QXmppMessage &message, const QSet<QString> &queryWords, bool fullTextIndexEnabled) const
+{
+    if (fullTextIndexEnabled) {
+        return std::all_of(queryWords.cbegin(), queryWords.cend(), [&](const auto &word) {
+            return words.value(word).contains(message.stanzaId());
+        });
+    }
+
+    const auto messageWords = textWords(message.body());
+    return std::all_of(queryWords.cbegin(), queryWords.cend(), [&](const auto &word) {
+        return messageWords.contains(word);
+    });
+}
+
+void ArchivedConversation::index(const QXmppMessage &message)
+{
+    const auto messageWords = textWords(message.body());
+    for (const auto &word : messageWords) {
+        words[word].insert(message.stanzaId());
+    }
+}
+
+class QXmppMessageArchiveMemoryStoragePrivate
+{
+public:
+    QHash<QString, ArchivedConversation> conversations;
+    bool fullTextIndexEnabled = false;
+};
+
+///
+/// Constructs a message archive memory storage.
+///
+QXmppMessageArchiveMemoryStorage::QXmppMessageArchiveMemoryStorage()
+    : d(new QXmppMessageArchiveMemoryStoragePrivate)
+{
+}
+
+QXmppMessageArchiveMemoryStorage::~QXmppMessageArchiveMemoryStorage() = default;
+
+///
+/// Returns whether the words of the stored messages are indexed.
+///
+bool QXmppMessageArchiveMemoryStorage::isFullTextIndexEnabled() const
+{
+    return d->fullTextIndexEnabled;
+}
+
+///
+/// Sets whether the words of the stored messages are indexed.
+///
+/// The index speeds up searching for text at the cost of memory. It is
+/// disabled by default.
+///
+void QXmppMessageArchiveMemoryStorage::setFullTextIndexEnabled(bool enabled)
+{
+    if (d->fullTextIndexEnabled == enabled) {
+        return;
+    }
+    d->fullTextIndexEnabled = enabled;
+
+    for (auto &conversation : d->conversations) {
+        conversation.words.clear();
+        if (enabled) {
+            for (const auto &message : conversation.messages) {
+                conversation.index(message);
+            }
+        }
+    }
+}
+
+/// \cond
+QXmppTask<void> QXmppMessageArchiveMemoryStorage::addMessages(const QString &conversationJid, const QVector<QXmppMessage> &messages)
+{
+    auto &conversation = d->conversations[conversationJid];
+    for (const auto &message : messages) {
+        const auto stanzaId = message.stanzaId();
+        if (stanzaId.isEmpty() || conversation.stamps.contains(stanzaId)) {
+            continue;
+        }
+
+        // usually at one of the ends: new messages or older history
+        const auto position = std::upper_bound(conversation.messages.cbegin(), conversation.messages.cend(), message.stamp(), isAfter);
+        conversation.messages.insert(position, message);
+        conversation.stamps.insert(stanzaId, message.stamp());
+        if (d->fullTextIndexEnabled) {
+            conversation.index(message);
+        }
+    }
+    return makeReadyTask();
+}
+
+QXmppTask<QVector<QXmppMessage>> QXmppMessageArchiveMemoryStorage::messages(const QString &conversationJid, const Query &query)
+{
+    const auto itr = d->conversations.constFind(conversationJid);
+    if (itr == d->conversations.constEnd()) {
+        return makeReadyTask(QVector<QXmppMessage>());
+    }
+    const auto &conversation = *itr;
+
+    // time range
+    auto begin = conversation.messages.cbegin();
+    auto end = conversation.messages.cend();
+    if (query.start.isValid()) {
+        begin = std::lower_bound(begin, end, query.start, isBefore);
+    }
+    if (query.end.isValid()) {
+        end = std::upper_bound(begin, end, query.end, isAfter);
+    }
+
+    // page
+    const auto &resultSetQuery = query.resultSetQuery;
+    if (!resultSetQuery.after().isEmpty()) {
+        const auto after = conversation.find(resultSetQuery.after());
+        if (!after) {
+            return makeReadyTask(QVector<QXmppMessage>());
+        }
+        begin = std::max(begin, std::next(*after));
+    }
+    if (!resultSetQuery.before().isEmpty()) {
+        const auto before = conversation.find(resultSetQuery.before());
+        if (!before) {
+            return makeReadyTask(QVector<QXmppMessage>());
+        }
+        end = std::min(end, *before);
+    }
+    if (begin >= end) {
+        return makeReadyTask(QVector<QXmppMessage>());
+    }
+
+    const auto words = textWords(query.text);
+    const auto max = resultSetQuery.max() < 0 ? std::numeric_limits<int>::max() : resultSetQuery.max();
+    const auto matches = [&](const QXmppMessage &message) {
+        return words.isEmpty() || conversation.matches(message, words, d->fullTextIndexEnabled);
+    };
+
+    QVector<QXmppMessage> result;
+    if (!resultSetQuery.before().isNull()) {
+        // the last messages of the range
+        for (auto message = end; message != begin && result.size() < max;) {
+            --message;
+            if (matches(*message)) {
+                result.append(*message);
+            }
+        }
+        std::reverse(result.begin(), result.end());
+    } else {
+        for (auto message = begin; message != end && result.size() < max; ++message) {
+            if (matches(*message)) {
+                result.append(*message);
+            }
+        }
+    }
+    return makeReadyTask(std::move(result));
+}
+
+QXmppTask<std::optional<QXmppMessage>> QXmppMessageArchiveMemoryStorage::firstMessage(const QString &conversationJid)
+{
+    const auto itr = d->conversations.constFind(conversationJid);
+    if (itr == d->conversations.constEnd() || itr->messages.empty()) {
+        return makeReadyTask(std::optional<QXmppMessage>());
+    }
+    return makeReadyTask(std::optional(itr->messages.front()));
+}
+
+QXmppTask<std::optional<QXmppMessage>> QXmppMessageArchiveMemoryStorage::lastMessage(const QString &conversationJid)
+{
+    const auto itr = d->conversations.constFind(conversationJid);
+    if (itr == d->conversations.constEnd() || itr->messages.empty()) {
+        return makeReadyTask(std::optional<QXmppMessage>());
+    }
+    return makeReadyTask(std::optional(itr->messages.back()));
+}
+
+QXmppTask<void> QXmppMessageArchiveMemoryStorage::removeConversation(const QString &conversationJid)
+{
+    d->conversations.remove(conversationJid);
+    return makeReadyTask();
+}
+
+QXmppTask<void> QXmppMessageArchiveMemoryStorage::removeAll()
+{
+    d->conversations.clear();
+    return makeReadyTask();
+}
+/// \endcond
@@ -0,0 +1,36 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPMESSAGEARCHIVEMEMORYSTORAGE_H
+#define QXMPPMESSAGEARCHIVEMEMORYSTORAGE_H
+
+#include "QXmppMessageArchiveStorage.h"
+
+#include <memory>
+
+class QXmppMessageArchiveMemoryStoragePrivate;
+
+class QXMPP_EXPORT QXmppMessageArchiveMemoryStorage : public QXmppMessageArchiveStorage
+{
+public:
+    QXmppMessageArchiveMemoryStorage();
+    ~QXmppMessageArchiveMemoryStorage() override;
+
+    bool isFullTextIndexEnabled() const;
+    void setFullTextIndexEnabled(bool enabled);
+
+    /// \cond
+    QXmppTask<void> addMessages(const QString &conversation, const QVector<QXmppMessage> &messages) override;
+    QXmppTask<QVector<QXmppMessage>> messages(const QString &conversation, const Query &query) override;
+    QXmppTask<std::optional<QXmppMessage>> firstMessage(const QString &conversation) override;
+    QXmppTask<std::optional<QXmppMessage>> lastMessage(const QString &conversation) override;
+    QXmppTask<void> removeConversation(const QString &conversation) override;
+    QXmppTask<void> removeAll() override;
+    /// \endcond
+
+private:
+    const std::unique_ptr<QXmppMessageArchiveMemoryStoragePrivate> d;
+};
+
+#endif  // QXMPPMESSAGEARCHIVEMEMORYSTORAGE_H
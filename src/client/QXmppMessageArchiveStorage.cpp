@@ -0,0 +1,87 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+///
+/// \class QXmppMessageArchiveStorage
+///
+/// \brief The QXmppMessageArchiveStorage class stores messages retrieved from
+/// a \xep{0313, Message Archive Management} archive locally.
+///
+/// QXmppMamManager adds the messages it fetches with
+/// QXmppMamManager::synchronizeArchive() and
+/// QXmppMamManager::loadArchivedMessages() to the storage. Encrypted messages
+/// are stored after they have been decrypted, so scrolling back and searching
+/// the history doesn't need any network round-trips or decryption.
+/// Implement this interface to keep the messages in a database across sessions
+/// and pass it to QXmppMamManager::setArchiveStorage().
+///
+/// The messages of a conversation are identified by their stanza ID, i.e. the
+/// ID assigned by the archive. Messages are ordered by their stamp, messages
+/// with the same stamp in the order they have been added.
+///
+/// A storage belongs to one account. Call removeAll() before using it with
+/// another account.
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+
+///
+/// \fn QXmppMessageArchiveStorage::addMessages(const QString &conversation, const QVector<QXmppMessage> &messages)
+///
+/// Adds messages to a conversation.
+///
+/// Messages whose stanza ID is already stored must be ignored, messages
+/// without a stanza ID must not be stored.
+///
+/// \param conversation bare JID of the conversation
+/// \param messages messages in archive order
+///
+
+///
+/// \fn QXmppMessageArchiveStorage::messages(const QString &conversation, const Query &query)
+///
+/// Returns the stored messages of a conversation matching \a query in
+/// chronological order.
+///
+/// The result set query is applied after the other filters like by a
+/// \xep{0059, Result Set Management} server: if \c before is set, the last
+/// \c max messages before the message with that stanza ID are returned
+/// (before the end if it is empty), otherwise the first \c max messages after
+/// the message with the stanza ID of \c after.
+///
+/// \param conversation bare JID of the conversation
+/// \param query filter and page of the messages
+///
+
+///
+/// \fn QXmppMessageArchiveStorage::firstMessage(const QString &conversation)
+///
+/// Returns the oldest stored message of a conversation.
+///
+/// \param conversation bare JID of the conversation
+///
+
+///
+/// \fn QXmppMessageArchiveStorage::lastMessage(const QString &conversation)
+///
+/// Returns the newest stored message of a conversation.
+///
+/// \param conversation bare JID of the conversation
+///
+
+///
+/// \fn QXmppMessageArchiveStorage::removeConversation(const QString &conversation)
+///
+/// Removes all stored messages of a conversation.
+///
+/// \param conversation bare JID of the conversation
+///
+
+///
+/// \fn QXmppMessageArchiveStorage::removeAll()
+///
+/// Removes all stored messages.
+///
@@ -0,0 +1,47 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPMESSAGEARCHIVESTORAGE_H
+#define QXMPPMESSAGEARCHIVESTORAGE_H
+
+#include "QXmppMessage.h"
+#include "QXmppResultSet.h"
+
+#include <optional>
+
+#include <QDateTime>
+#include <QVector>
+
+template<typename T>
+class QXmppTask;
+
+class QXMPP_EXPORT QXmppMessageArchiveStorage
+{
+public:
+    ///
+    /// Filter for the stored messages of a conversation
+    ///
+    struct Query
+    {
+        /// only messages sent at or after this time, if valid
+        QDateTime start;
+        /// only messages sent at or before this time, if valid
+        QDateTime end;
+        /// only messages whose body contains all words of the text, if not empty
+        QString text;
+        /// page of the results, the before and after elements are stanza IDs
+        QXmppResultSetQuery resultSetQuery;
+    };
+
+    virtual ~QXmppMessageArchiveStorage() = default;
+
+    virtual QXmppTask<void> addMessages(const QString &conversation, const QVector<QXmppMessage> &messages) = 0;
+    virtual QXmppTask<QVector<QXmppMessage>> messages(const QString &conversation, const Query &query) = 0;
+    virtual QXmppTask<std::optional<QXmppMessage>> firstMessage(const QString &conversation) = 0;
+    virtual QXmppTask<std::optional<QXmppMessage>> lastMessage(const QString &conversation) = 0;
+    virtual QXmppTask<void> removeConversation(const QString &conversation) = 0;
+    virtual QXmppTask<void> removeAll() = 0;
+};
+
+#endif  // QXMPPMESSAGEARCHIVESTORAGE_H
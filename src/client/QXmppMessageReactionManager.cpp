@@ -0,0 +1,230 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppMessageReactionManager.h"
+
+#include "QXmppClient.h"
+#include "QXmppMessage.h"
+#include "QXmppMessageReaction.h"
+#include "QXmppUtils.h"
+
+struct MessageReactions
+{
+    // number of senders per emoji
+    QHash<QString, int> counts;
+    // emojis per sender
+    QHash<QString, QVector<QString>> senders;
+};
+
+class QXmppMessageReactionManagerPrivate
+{
+public:
+    const MessageReactions *find(const QString &conversation, const QString &messageId) const;
+
+    // reactions per message ID per conversation
+    QHash<QString, QHash<QString, MessageReactions>> conversations;
+};
+
+const MessageReactions *QXmppMessageReactionManagerPrivate::find(const QString &conversation, const QString &messageId) const
+{
+    const auto messages = conversations.constFind(conversation);
+    if (messages == conversations.constEnd()) {
+        return nullptr;
+    }
+    const auto reactions = messages->constFind(messageId);
+    return reactions == messages->constEnd() ? nullptr : &*reactions;
+}
+
+///
+/// \class QXmppMessageReactionManager
+///
+/// \brief The QXmppMessageReactionManager class keeps the \xep{0444, Message
+/// Reactions} to the messages of the conversations.
+///
+/// Every reaction message replaces the reactions of its sender to a message.
+/// The manager keeps the reactions of each sender and the number of senders
+/// per emoji, and updates them with each received reaction, so that the
+/// reactions to a message don't need to be counted again. The changes are
+/// reported by reactionsChanged().
+///
+/// Messages loaded from an archive can be added with addReaction().
+///
+/// The messages are identified by the ID used by the reactions: the stanza ID
+/// assigned by the room in group chats, and the message ID otherwise.
+///
+/// \ingroup Managers
+///
+/// \since QXmpp 1.6
+///
+
+///
+/// \fn QXmppMessageReactionManager::reactionsChanged(const QString &conversation, const QString &messageId, const QString &sender, const QVector<QString> &added, const QVector<QString> &removed)
+///
+/// Emitted when a sender has changed their reactions to a message.
+///
+/// \param conversation bare JID of the chat partner or the MUC room
+/// \param messageId ID of the message the reactions refer to
+/// \param sender bare JID of the sender, or the occupant JID in a MUC room
+/// \param added emojis the sender has added
+/// \param removed emojis the sender has removed
+///
+
+///
+/// Constructs a message reaction manager.
+///
+QXmppMessageReactionManager::QXmppMessageReactionManager()
+    : d(std::make_unique<QXmppMessageReactionManagerPrivate>())
+{
+}
+
+QXmppMessageReactionManager::~QXmppMessageReactionManager() = default;
+
+///
+/// Returns the number of senders per emoji that reacted to a message.
+///
+/// \param conversation bare JID of the chat partner or the MUC room
+/// \param messageId
+///
+QHash<QString, int> QXmppMessageReactionManager::reactionCounts(const QString &conversation, const QString &messageId) const
+{
+    const auto *reactions = d->find(conversation, messageId);
+    return reactions ? reactions->counts : QHash<QString, int>();
+}
+
+///
+/// Returns the emojis a sender reacted to a message with.
+///
+/// \param conversation bare JID of the chat partner or the MUC room
+/// \param messageId
+/// \param sender bare JID of the sender, or the occupant JID in a MUC room
+///
+QVector<QString> QXmppMessageReactionManager::reactions(const QString &conversation, const QString &messageId, const QString &sender) const
+{
+    const auto *reactions = d->find(conversation, messageId);
+    return reactions ? reactions->senders.value(sender) : QVector<QString>();
+}
+
+///
+/// Returns the senders that reacted to a message with an emoji.
+///
+/// \param conversation bare JID of the chat partner or the MUC room
+/// \param messageId
+/// \param emoji
+///
+QVector<QString> QXmppMessageReactionManager::senders(const QString &conversation, const QString &messageId, const QString &emoji) const
+{
+    QVector<QString> senders;
+    if (const auto *reactions = d->find(conversation, messageId); reactions && reactions->counts.contains(emoji)) {
+        for (auto itr = reactions->senders.cbegin(); itr != reactions->senders.cend(); ++itr) {
+            if (itr->contains(emoji)) {
+                senders << itr.key();
+            }
+        }
+    }
+    return senders;
+}
+
+///
+/// Replaces the reactions of a sender to a message.
+///
+/// This is called for each received reaction. Reactions from other sources,
+/// e.g. \xep{0313, Message Archive Management}, can be added with this.
+///
+/// \param conversation bare JID of the chat partner or the MUC room
+/// \param sender bare JID of the sender, or the occupant JID in a MUC room
+/// \param reaction
+///
+void QXmppMessageReactionManager::addReaction(const QString &conversation, const QString &sender, const QXmppMessageReaction &reaction)
+{
+    const auto messageId = reaction.messageId();
+    if (conversation.isEmpty() || sender.isEmpty() || messageId.isEmpty()) {
+        return;
+    }
+
+    // each emoji counts only once
+    QVector<QString> emojis;
+    const auto reactionEmojis = reaction.emojis();
+    for (const auto &emoji : reactionEmojis) {
+        if (!emoji.isEmpty() && !emojis.contains(emoji)) {
+            emojis << emoji;
+        }
+    }
+
+    auto &messages = d->conversations[conversation];
+    auto &reactions = messages[messageId];
+    const auto previous = reactions.senders.value(sender);
+
+    QVector<QString> added;
+    QVector<QString> removed;
+    for (const auto &emoji : std::as_const(emojis)) {
+        if (!previous.contains(emoji)) {
+            added << emoji;
+            reactions.counts[emoji]++;
+        }
+    }
+    for (const auto &emoji : previous) {
+        if (!emojis.contains(emoji)) {
+            removed << emoji;
+            const auto count = reactions.counts.find(emoji);
+            if (--*count == 0) {
+                reactions.counts.erase(count);
+            }
+        }
+    }
+
+    if (emojis.isEmpty()) {
+        reactions.senders.remove(sender);
+        if (reactions.senders.isEmpty()) {
+            messages.remove(messageId);
+            if (messages.isEmpty()) {
+                d->conversations.remove(conversation);
+            }
+        }
+    } else {
+        reactions.senders.insert(sender, emojis);
+    }
+
+    if (!added.isEmpty() || !removed.isEmpty()) {
+        Q_EMIT reactionsChanged(conversation, messageId, sender, added, removed);
+    }
+}
+
+///
+/// Removes the reactions to the messages of a conversation.
+///
+void QXmppMessageReactionManager::clear(const QString &conversation)
+{
+    d->conversations.remove(conversation);
+}
+
+///
+/// Removes all reactions.
+///
+void QXmppMessageReactionManager::clear()
+{
+    d->conversations.clear();
+}
+
+/// \cond
+bool QXmppMessageReactionManager::handleMessage(const QXmppMessage &message)
+{
+    const auto reaction = message.reaction();
+    if (!reaction || message.type() == QXmppMessage::Error) {
+        return false;
+    }
+
+    const auto from = QXmppUtils::jidToBareJid(message.from());
+    if (message.type() == QXmppMessage::GroupChat) {
+        addReaction(from, message.from(), *reaction);
+    } else if (client() && from == client()->configuration().jidBare()) {
+        // sent from another device of the account
+        addReaction(QXmppUtils::jidToBareJid(message.to()), from, *reaction);
+    } else {
+        addReaction(from, from, *reaction);
+    }
+
+    // the message is also passed on to the other handlers
+    return false;
+}
+/// \endcond
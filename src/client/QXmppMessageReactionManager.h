@@ -0,0 +1,46 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPMESSAGEREACTIONMANAGER_H
+#define QXMPPMESSAGEREACTIONMANAGER_H
+
+#include "QXmppClientExtension.h"
+#include "QXmppMessageHandler.h"
+
+#include <memory>
+
+#include <QHash>
+#include <QVector>
+
+class QXmppMessage;
+class QXmppMessageReaction;
+class QXmppMessageReactionManagerPrivate;
+
+class QXMPP_EXPORT QXmppMessageReactionManager : public QXmppClientExtension, public QXmppMessageHandler
+{
+    Q_OBJECT
+public:
+    QXmppMessageReactionManager();
+    ~QXmppMessageReactionManager() override;
+
+    QHash<QString, int> reactionCounts(const QString &conversation, const QString &messageId) const;
+    QVector<QString> reactions(const QString &conversation, const QString &messageId, const QString &sender) const;
+    QVector<QString> senders(const QString &conversation, const QString &messageId, const QString &emoji) const;
+
+    void addReaction(const QString &conversation, const QString &sender, const QXmppMessageReaction &reaction);
+    void clear(const QString &conversation);
+    void clear();
+
+    Q_SIGNAL void reactionsChanged(const QString &conversation, const QString &messageId, const QString &sender,
+                                   const QVector<QString> &added, const QVector<QString> &removed);
+
+    /// \cond
+    bool handleMessage(const QXmppMessage &) override;
+    /// \endcond
+
+private:
+    const std::unique_ptr<QXmppMessageReactionManagerPrivate> d;
+};
+
+#endif  // QXMPPMESSAGEREACTIONMANAGER_H
@@ -12,20 +12,139 @@
 #include "QXmppTask.h"
 #include "QXmppUtils.h"
 
+#include <utility>
+
 #include <QDomElement>
+#include <QTimer>
+
+struct PendingMarker
+{
+    QString to;
+    QString id;
+    QXmppMessage::Type type;
+    std::optional<QXmppE2eeMetadata> e2eeMetadata;
+};
+
+struct PendingReceipt
+{
+    QXmppMessage receipt;
+    std::optional<QXmppE2eeMetadata> e2eeMetadata;
+};
+
+class QXmppMessageReceiptManagerPrivate
+{
+public:
+    void addMarker(QHash<QString, PendingMarker> &markers, const QXmppMessage &message);
+
+    int aggregationDelay = 0;
+    QTimer *aggregationTimer = nullptr;
+    // latest message to acknowledge per conversation (bare JID)
+    QHash<QString, PendingMarker> receivedMarkers;
+    QHash<QString, PendingMarker> displayedMarkers;
+    // receipts for messages that can't be acknowledged by a chat marker
+    std::vector<PendingReceipt> receipts;
+};
+
+void QXmppMessageReceiptManagerPrivate::addMarker(QHash<QString, PendingMarker> &markers, const QXmppMessage &message)
+{
+    // Markers in group chats reference the stanza ID assigned by the room.
+    const bool isGroupChat = message.type() == QXmppMessage::GroupChat;
+    const auto conversation = QXmppUtils::jidToBareJid(message.from());
+
+    markers.insert(conversation, PendingMarker {
+                                     isGroupChat ? conversation : message.from(),
+                                     isGroupChat ? message.stanzaId() : message.id(),
+                                     isGroupChat ? QXmppMessage::GroupChat : QXmppMessage::Chat,
+                                     message.e2eeMetadata(),
+                                 });
+    if (!aggregationTimer->isActive()) {
+        aggregationTimer->start(aggregationDelay);
+    }
+}
 
 /// Constructs a QXmppMessageReceiptManager to handle incoming and outgoing
 /// message delivery receipts.
 
 QXmppMessageReceiptManager::QXmppMessageReceiptManager()
-    : QXmppClientExtension()
+    : QXmppClientExtension(),
+      d(std::make_unique<QXmppMessageReceiptManagerPrivate>())
+{
+    d->aggregationTimer = new QTimer(this);
+    d->aggregationTimer->setSingleShot(true);
+    connect(d->aggregationTimer, &QTimer::timeout, this, &QXmppMessageReceiptManager::sendPendingReceipts);
+}
+
+QXmppMessageReceiptManager::~QXmppMessageReceiptManager() = default;
+
+///
+/// Returns the time in milliseconds for which outgoing receipts are collected
+/// before they are sent.
+///
+/// \since QXmpp 1.6
+///
+int QXmppMessageReceiptManager::aggregationDelay() const
+{
+    return d->aggregationDelay;
+}
+
+///
+/// Sets the time in milliseconds for which outgoing receipts are collected
+/// before they are sent.
+///
+/// If enabled, all messages of a conversation that request a receipt and are
+/// markable (\xep{0333, Chat Markers}) are acknowledged by a single
+/// \c <received/> chat marker (and delivery receipt) for the latest message,
+/// which implicitly acknowledges the previous ones. This avoids sending one
+/// receipt for every message, e.g. after catching up with the messages received
+/// while being offline. Receipts for other messages are still sent
+/// individually, but together with the markers.
+///
+/// While the client is inactive (\xep{0352, Client State Indication}), the
+/// receipts are collected until it becomes active again.
+///
+/// The default value is 0, which sends every receipt immediately.
+///
+/// \since QXmpp 1.6
+///
+void QXmppMessageReceiptManager::setAggregationDelay(int msecs)
+{
+    d->aggregationDelay = msecs;
+    if (msecs <= 0 && d->aggregationTimer->isActive()) {
+        d->aggregationTimer->stop();
+        sendPendingReceipts();
+    }
+}
+
+///
+/// Sends a \c <displayed/> chat marker (\xep{0333, Chat Markers}) for a
+/// received message.
+///
+/// The marker implicitly acknowledges all previous messages of the
+/// conversation. If an aggregationDelay() is set, only one marker for the
+/// latest displayed message of each conversation is sent.
+///
+/// Nothing is sent if the message is not markable.
+///
+/// \since QXmpp 1.6
+///
+void QXmppMessageReceiptManager::markAsDisplayed(const QXmppMessage &message)
 {
+    const auto id = message.type() == QXmppMessage::GroupChat ? message.stanzaId() : message.id();
+    if (!message.isMarkable() || message.from().isEmpty() || id.isEmpty()) {
+        return;
+    }
+
+    d->addMarker(d->displayedMarkers, message);
+    if (d->aggregationDelay <= 0) {
+        d->aggregationTimer->stop();
+        sendPendingReceipts();
+    }
 }
 
 /// \cond
 QStringList QXmppMessageReceiptManager::discoveryFeatures() const
 {
-    return QStringList(ns_message_receipts);
+    return { ns_message_receipts };
 }
 
 bool QXmppMessageReceiptManager::handleMessage(const QXmppMessage &message)
@@ -45,13 +164,71 @@ bool QXmppMessageReceiptManager::handleMessage(const QXmppMessage &message)
 
     // If requested, send a receipt.
     if (message.isReceiptRequested() && !message.from().isEmpty() && !message.id().isEmpty()) {
+        if (d->aggregationDelay > 0 && message.isMarkable() && message.type() != QXmppMessage::GroupChat) {
+            d->addMarker(d->receivedMarkers, message);
+            return false;
+        }
+
         QXmppMessage receipt;
         receipt.setTo(message.from());
         receipt.setReceiptId(message.id());
-        client()->reply(std::move(receipt), message.e2eeMetadata());
+
+        if (d->aggregationDelay > 0) {
+            d->receipts.push_back({ std::move(receipt), message.e2eeMetadata() });
+            if (!d->aggregationTimer->isActive()) {
+                d->aggregationTimer->start(d->aggregationDelay);
+            }
+        } else {
+            client()->reply(std::move(receipt), message.e2eeMetadata());
+        }
     }
 
     // Continue processing.
     return false;
 }
 /// \endcond
+
+void QXmppMessageReceiptManager::sendPendingReceipts()
+{
+    // keep collecting while inactive, so that the radio isn't woken up
+    if (d->aggregationDelay > 0 && client() && !client()->isActive()) {
+        d->aggregationTimer->start(d->aggregationDelay);
+        return;
+    }
+
+    auto receivedMarkers = std::exchange(d->receivedMarkers, {});
+    auto displayedMarkers = std::exchange(d->displayedMarkers, {});
+    auto receipts = std::exchange(d->receipts, {});
+    if (!client()) {
+        return;
+    }
+
+    auto sendMarker = [this](PendingMarker &&pending, QXmppMessage::Marker marker, bool withReceipt) {
+        QXmppMessage message;
+        message.setTo(pending.to);
+        message.setType(pending.type);
+        message.setMarker(marker);
+        message.setMarkerId(pending.id);
+        if (withReceipt) {
+            message.setReceiptId(pending.id);
+        }
+        client()->reply(std::move(message), pending.e2eeMetadata);
+    };
+
+    for (auto itr = receivedMarkers.begin(); itr != receivedMarkers.end(); ++itr) {
+        // the displayed marker for the same message makes the received marker redundant
+        const auto displayed = displayedMarkers.constFind(itr.key());
+        if (displayed == displayedMarkers.constEnd() || displayed->id != itr->id) {
+            sendMarker(std::move(*itr), QXmppMessage::Received, true);
+        }
+    }
+    for (auto itr = displayedMarkers.begin(); itr != displayedMarkers.end(); ++itr) {
+        // include the receipt of a skipped received marker
+        const auto received = receivedMarkers.constFind(itr.key());
+        const bool withReceipt = received != receivedMarkers.constEnd() && received->id == itr->id;
+        sendMarker(std::move(*itr), QXmppMessage::Displayed, withReceipt);
+    }
+    for (auto &pending : receipts) {
+        client()->reply(std::move(pending.receipt), pending.e2eeMetadata);
+    }
+}
@@ -9,6 +9,11 @@
 #include "QXmppClientExtension.h"
 #include "QXmppMessageHandler.h"
 
+#include <memory>
+
+class QXmppMessage;
+class QXmppMessageReceiptManagerPrivate;
+
 ///
 /// \brief The QXmppMessageReceiptManager class makes it possible to
 /// send and receive message delivery receipts as defined in
@@ -21,6 +26,12 @@ class QXMPP_EXPORT QXmppMessageReceiptManager : public QXmppClientExtension, pub
     Q_OBJECT
 public:
     QXmppMessageReceiptManager();
+    ~QXmppMessageReceiptManager() override;
+
+    int aggregationDelay() const;
+    void setAggregationDelay(int msecs);
+
+    void markAsDisplayed(const QXmppMessage &message);
 
     /// \cond
     QStringList discoveryFeatures() const override;
@@ -32,6 +43,11 @@ Q_SIGNALS:
     /// given id is received. The id could be previously obtained by
     /// calling QXmppMessage::id().
     void messageDelivered(const QString &jid, const QString &id);
+
+private:
+    void sendPendingReceipts();
+
+    const std::unique_ptr<QXmppMessageReceiptManagerPrivate> d;
 };
 
 #endif  // QXMPPMESSAGERECEIPTMANAGER_H
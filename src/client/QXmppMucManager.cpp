@@ -7,17 +7,22 @@
 #include "QXmppClient.h"
 #include "QXmppConstants_p.h"
 #include "QXmppDiscoveryManager.h"
+#include "QXmppMamManager.h"
 #include "QXmppMessage.h"
 #include "QXmppMucIq.h"
+#include "QXmppTask.h"
 #include "QXmppUtils.h"
 
+#include <utility>
+
 #include <QDomElement>
-#include <QMap>
+#include <QHash>
 
 class QXmppMucManagerPrivate
 {
 public:
-    QMap<QString, QXmppMucRoom *> rooms;
+    // rooms by their bare JID, the stanzas from a room are only passed to it
+    QHash<QString, QXmppMucRoom *> rooms;
 };
 
 class QXmppMucRoomPrivate
@@ -29,14 +34,101 @@ public:
     QXmppMucRoom::Actions allowedActions;
     QString jid;
     QString name;
-    QMap<QString, QXmppPresence> participants;
+    QHash<QString, QXmppPresence> participants;
     QString password;
-    QMap<QString, QXmppMucItem> permissions;
+    QHash<QString, QXmppMucItem> permissions;
     QSet<QString> permissionsQueue;
     QString nickName;
     QString subject;
+
+    // initial occupants collected while joining
+    bool joinBatchingEnabled = false;
+    bool joining = false;
+    QStringList joinBatch;
+
+    bool fullPresenceStorageEnabled = true;
+
+    // history requested when joining
+    std::optional<int> historyMaxStanzas;
+    std::optional<int> historySeconds;
+    QDateTime historySince;
+
+    // XEP-0313: Message Archive Management catch-up
+    bool mamCatchUpEnabled = false;
+    bool catchUpPending = false;
+    QString lastStanzaId;
+
+    QXmppPresence participantPresence(const QXmppPresence &presence) const;
+    void clearParticipants(QXmppMucRoom *room);
+    void retrieveMissedMessages(QXmppMucRoom *room, const QString &after);
 };
 
+// number of messages requested per MAM page when catching up
+constexpr int MAM_CATCH_UP_PAGE_SIZE = 100;
+
+QXmppPresence QXmppMucRoomPrivate::participantPresence(const QXmppPresence &presence) const
+{
+    if (fullPresenceStorageEnabled) {
+        return presence;
+    }
+
+    // only keep what is needed to display the occupant
+    QXmppPresence stored(presence.type());
+    stored.setFrom(presence.from());
+    stored.setAvailableStatusType(presence.availableStatusType());
+    stored.setStatusText(presence.statusText());
+    stored.setMucItem(presence.mucItem());
+    return stored;
+}
+
+void QXmppMucRoomPrivate::retrieveMissedMessages(QXmppMucRoom *room, const QString &after)
+{
+    auto *mamManager = client->findExtension<QXmppMamManager>();
+    if (!mamManager) {
+        return;
+    }
+
+    QXmppResultSetQuery query;
+    query.setAfter(after);
+    query.setMax(MAM_CATCH_UP_PAGE_SIZE);
+
+    mamManager->retrieveMessages(jid, {}, {}, {}, {}, query).then(room, [this, room, after](QXmppMamManager::RetrieveResult &&result) {
+        const auto *retrieved = std::get_if<QXmppMamManager::RetrievedMessages>(&result);
+        if (!retrieved) {
+            return;
+        }
+
+        for (const auto &message : retrieved->messages) {
+            Q_EMIT room->messageReceived(message);
+        }
+
+        // the archive IDs are the stanza IDs assigned by the room
+        if (const auto last = retrieved->result.resultSetReply().last(); !last.isEmpty()) {
+            // live messages received in the meantime are newer
+            if (lastStanzaId == after) {
+                lastStanzaId = last;
+            }
+            if (!retrieved->result.complete()) {
+                retrieveMissedMessages(room, last);
+            }
+        }
+    });
+}
+
+void QXmppMucRoomPrivate::clearParticipants(QXmppMucRoom *room)
+{
+    joining = false;
+    joinBatch.clear();
+    catchUpPending = false;
+
+    const QStringList removed = participants.keys();
+    participants.clear();
+    for (const auto &jid : removed) {
+        Q_EMIT room->participantRemoved(jid);
+    }
+    Q_EMIT room->participantsChanged();
+}
+
 ///
 /// Constructs a new QXmppMucManager.
 ///
@@ -124,11 +216,18 @@ void QXmppMucManager::setClient(QXmppClient *client)
 
     connect(client, &QXmppClient::messageReceived,
             this, &QXmppMucManager::_q_messageReceived);
+
+    connect(client, &QXmppClient::presenceReceived,
+            this, &QXmppMucManager::_q_presenceReceived);
 }
 /// \endcond
 
 void QXmppMucManager::_q_messageReceived(const QXmppMessage &msg)
 {
+    if (auto *room = d->rooms.value(QXmppUtils::jidToBareJid(msg.from()))) {
+        room->_q_messageReceived(msg);
+    }
+
     if (msg.type() != QXmppMessage::Normal) {
         return;
     }
@@ -140,6 +239,22 @@ void QXmppMucManager::_q_messageReceived(const QXmppMessage &msg)
     }
 }
 
+void QXmppMucManager::_q_presenceReceived(const QXmppPresence &presence)
+{
+    // our own presence is reflected in all joined rooms
+    if (presence.from() == client()->configuration().jid()) {
+        const auto rooms = d->rooms.values();
+        for (auto *room : rooms) {
+            room->_q_presenceReceived(presence);
+        }
+        return;
+    }
+
+    if (auto *room = d->rooms.value(QXmppUtils::jidToBareJid(presence.from()))) {
+        room->_q_presenceReceived(presence);
+    }
+}
+
 void QXmppMucManager::_q_roomDestroyed(QObject *object)
 {
     const QString key = d->rooms.key(static_cast<QXmppMucRoom *>(object));
@@ -162,11 +277,7 @@ QXmppMucRoom::QXmppMucRoom(QXmppClient *client, const QString &jid, QObject *par
     connect(d->client, &QXmppClient::disconnected,
             this, &QXmppMucRoom::_q_disconnected);
 
-    connect(d->client, &QXmppClient::messageReceived,
-            this, &QXmppMucRoom::_q_messageReceived);
-
-    connect(d->client, &QXmppClient::presenceReceived,
-            this, &QXmppMucRoom::_q_presenceReceived);
+    // messages and presences are passed in by the manager
 
     if (d->discoManager) {
         connect(d->discoManager, &QXmppDiscoveryManager::infoReceived,
@@ -232,12 +343,27 @@ bool QXmppMucRoom::join()
         return false;
     }
 
+    // the occupants are sent before our own presence
+    d->joining = true;
+    d->joinBatch.clear();
+
     // reflect our current presence in the chat room
     QXmppPresence packet = d->client->clientPresence();
     packet.setTo(d->ownJid());
     packet.setType(QXmppPresence::Available);
     packet.setMucPassword(d->password);
     packet.setMucSupported(true);
+
+    d->catchUpPending = d->mamCatchUpEnabled && !d->lastStanzaId.isEmpty() &&
+        d->client->findExtension<QXmppMamManager>();
+    if (d->catchUpPending) {
+        // the missed messages are fetched from the archive instead
+        packet.setMucHistoryMaxStanzas(0);
+    } else {
+        packet.setMucHistoryMaxStanzas(d->historyMaxStanzas);
+        packet.setMucHistorySeconds(d->historySeconds);
+        packet.setMucHistorySince(d->historySince);
+    }
     return d->client->sendPacket(packet);
 }
 
@@ -380,6 +506,178 @@ QStringList QXmppMucRoom::participants() const
     return d->participants.keys();
 }
 
+///
+/// Returns whether the presences of the initial occupants are reported at once
+/// when joining the room.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppMucRoom::isJoinBatchingEnabled() const
+{
+    return d->joinBatchingEnabled;
+}
+
+///
+/// Sets whether the presences of the initial occupants are reported at once
+/// when joining the room.
+///
+/// When joining, the room sends the presences of all occupants before our own
+/// presence. With batching enabled, no participantAdded() and
+/// participantChanged() signals are emitted for them. Instead, all occupants
+/// including ourselves are reported by one participantsAdded() signal right
+/// before joined() is emitted.
+///
+/// This is disabled by default.
+///
+/// \since QXmpp 1.6
+///
+void QXmppMucRoom::setJoinBatchingEnabled(bool enabled)
+{
+    d->joinBatchingEnabled = enabled;
+}
+
+///
+/// Returns whether the complete presences of the participants are stored.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppMucRoom::isFullPresenceStorageEnabled() const
+{
+    return d->fullPresenceStorageEnabled;
+}
+
+///
+/// Sets whether the complete presences of the participants are stored.
+///
+/// If disabled, participantPresence() only contains the type, the status and
+/// the MUC item of the participant. All other elements and extensions of the
+/// presence are dropped, which saves memory in large rooms.
+///
+/// This is enabled by default and only affects presences received afterwards.
+///
+/// \since QXmpp 1.6
+///
+void QXmppMucRoom::setFullPresenceStorageEnabled(bool enabled)
+{
+    d->fullPresenceStorageEnabled = enabled;
+}
+
+///
+/// Returns the maximum number of history messages requested when joining.
+///
+/// \since QXmpp 1.6
+///
+std::optional<int> QXmppMucRoom::historyMaxStanzas() const
+{
+    return d->historyMaxStanzas;
+}
+
+///
+/// Sets the maximum number of history messages requested when joining.
+///
+/// By default, the room decides how much history is sent. A value of 0
+/// requests no history at all.
+///
+/// \since QXmpp 1.6
+///
+void QXmppMucRoom::setHistoryMaxStanzas(std::optional<int> maxStanzas)
+{
+    d->historyMaxStanzas = maxStanzas;
+}
+
+///
+/// Returns the age in seconds of the oldest history message requested when
+/// joining.
+///
+/// \since QXmpp 1.6
+///
+std::optional<int> QXmppMucRoom::historySeconds() const
+{
+    return d->historySeconds;
+}
+
+///
+/// Sets the age in seconds of the oldest history message requested when
+/// joining.
+///
+/// \since QXmpp 1.6
+///
+void QXmppMucRoom::setHistorySeconds(std::optional<int> seconds)
+{
+    d->historySeconds = seconds;
+}
+
+///
+/// Returns the date of the oldest history message requested when joining.
+///
+/// \since QXmpp 1.6
+///
+QDateTime QXmppMucRoom::historySince() const
+{
+    return d->historySince;
+}
+
+///
+/// Sets the date of the oldest history message requested when joining.
+///
+/// \since QXmpp 1.6
+///
+void QXmppMucRoom::setHistorySince(const QDateTime &since)
+{
+    d->historySince = since;
+}
+
+///
+/// Returns whether missed messages are retrieved from the room's archive.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppMucRoom::isMamCatchUpEnabled() const
+{
+    return d->mamCatchUpEnabled;
+}
+
+///
+/// Sets whether missed messages are retrieved from the room's archive.
+///
+/// If enabled and the lastStanzaId() is known, joining the room requests no
+/// history. Instead, all messages after the last seen message are retrieved
+/// using \xep{0313, Message Archive Management} once the room has been joined
+/// and are emitted via messageReceived(). This requires a QXmppMamManager to be
+/// added to the client; otherwise the history options are used.
+///
+/// This is disabled by default.
+///
+/// \since QXmpp 1.6
+///
+void QXmppMucRoom::setMamCatchUpEnabled(bool enabled)
+{
+    d->mamCatchUpEnabled = enabled;
+}
+
+///
+/// Returns the stanza ID assigned by the room to the last received message.
+///
+/// \since QXmpp 1.6
+///
+QString QXmppMucRoom::lastStanzaId() const
+{
+    return d->lastStanzaId;
+}
+
+///
+/// Sets the stanza ID of the last seen message.
+///
+/// This allows to catch up on missed messages after restarting the
+/// application, see setMamCatchUpEnabled().
+///
+/// \since QXmpp 1.6
+///
+void QXmppMucRoom::setLastStanzaId(const QString &stanzaId)
+{
+    d->lastStanzaId = stanzaId;
+}
+
 QString QXmppMucRoom::password() const
 {
     return d->password;
@@ -517,12 +815,7 @@ void QXmppMucRoom::_q_disconnected()
     const bool wasJoined = isJoined();
 
     // clear chat room participants
-    const QStringList removed = d->participants.keys();
-    d->participants.clear();
-    for (const auto &jid : removed) {
-        Q_EMIT participantRemoved(jid);
-    }
-    Q_EMIT participantsChanged();
+    d->clearParticipants(this);
 
     // update available actions
     if (d->allowedActions != NoAction) {
@@ -561,6 +854,11 @@ void QXmppMucRoom::_q_messageReceived(const QXmppMessage &message)
         return;
     }
 
+    // XEP-0359: Unique and Stable Stanza IDs
+    if (!message.stanzaId().isEmpty() && message.stanzaIdBy() == d->jid) {
+        d->lastStanzaId = message.stanzaId();
+    }
+
     // handle message subject
     const QString subject = message.subject();
     if (!subject.isEmpty()) {
@@ -588,10 +886,11 @@ void QXmppMucRoom::_q_presenceReceived(const QXmppPresence &presence)
 
     if (presence.type() == QXmppPresence::Available) {
         const bool added = !d->participants.contains(jid);
-        d->participants.insert(jid, presence);
+        d->participants.insert(jid, d->participantPresence(presence));
 
         // refresh allowed actions
-        if (jid == d->ownJid()) {
+        const bool isOwnPresence = jid == d->ownJid();
+        if (isOwnPresence) {
 
             QXmppMucItem mucItem = presence.mucItem();
             Actions newActions = NoAction;
@@ -614,23 +913,44 @@ void QXmppMucRoom::_q_presenceReceived(const QXmppPresence &presence)
             }
         }
 
-        if (added) {
+        const bool batching = d->joining && d->joinBatchingEnabled;
+        if (batching) {
+            if (added) {
+                d->joinBatch.append(jid);
+            }
+            if (isOwnPresence) {
+                // the initial presences are complete
+                d->joining = false;
+                Q_EMIT participantsAdded(std::exchange(d->joinBatch, {}));
+                Q_EMIT participantsChanged();
+            }
+        } else if (added) {
             Q_EMIT participantAdded(jid);
             Q_EMIT participantsChanged();
-            if (jid == d->ownJid()) {
-                // request room information
-                if (d->discoManager) {
-                    d->discoManager->requestInfo(d->jid);
-                }
-
-                Q_EMIT joined();
-            }
         } else {
             Q_EMIT participantChanged(jid);
         }
+
+        if (added && isOwnPresence) {
+            d->joining = false;
+
+            // request room information
+            if (d->discoManager) {
+                d->discoManager->requestInfo(d->jid);
+            }
+
+            Q_EMIT joined();
+
+            if (std::exchange(d->catchUpPending, false)) {
+                d->retrieveMissedMessages(this, d->lastStanzaId);
+            }
+        }
     } else if (presence.type() == QXmppPresence::Unavailable) {
-        if (d->participants.contains(jid)) {
-            d->participants.insert(jid, presence);
+        if (d->joining && d->joinBatch.removeOne(jid)) {
+            // the occupant left before it has been reported
+            d->participants.remove(jid);
+        } else if (d->participants.contains(jid)) {
+            d->participants.insert(jid, d->participantPresence(presence));
 
             Q_EMIT participantRemoved(jid);
             d->participants.remove(jid);
@@ -653,12 +973,7 @@ void QXmppMucRoom::_q_presenceReceived(const QXmppPresence &presence)
                 }
 
                 // clear chat room participants
-                const QStringList removed = d->participants.keys();
-                d->participants.clear();
-                for (const auto &jid : removed) {
-                    Q_EMIT participantRemoved(jid);
-                }
-                Q_EMIT participantsChanged();
+                d->clearParticipants(this);
 
                 // update available actions
                 if (d->allowedActions != NoAction) {
@@ -672,6 +987,9 @@ void QXmppMucRoom::_q_presenceReceived(const QXmppPresence &presence)
         }
     } else if (presence.type() == QXmppPresence::Error) {
         if (presence.isMucSupported()) {
+            d->joining = false;
+            d->joinBatch.clear();
+
             // emit error
             Q_EMIT error(presence.error());
 
@@ -72,6 +72,7 @@ protected:
 
 private Q_SLOTS:
     void _q_messageReceived(const QXmppMessage &message);
+    void _q_presenceReceived(const QXmppPresence &presence);
     void _q_roomDestroyed(QObject *object);
 
 private:
@@ -146,6 +147,27 @@ public:
     Q_INVOKABLE QString participantFullJid(const QString &jid) const;
     QXmppPresence participantPresence(const QString &jid) const;
 
+    bool isJoinBatchingEnabled() const;
+    void setJoinBatchingEnabled(bool enabled);
+
+    bool isFullPresenceStorageEnabled() const;
+    void setFullPresenceStorageEnabled(bool enabled);
+
+    std::optional<int> historyMaxStanzas() const;
+    void setHistoryMaxStanzas(std::optional<int> maxStanzas);
+
+    std::optional<int> historySeconds() const;
+    void setHistorySeconds(std::optional<int> seconds);
+
+    QDateTime historySince() const;
+    void setHistorySince(const QDateTime &since);
+
+    bool isMamCatchUpEnabled() const;
+    void setMamCatchUpEnabled(bool enabled);
+
+    QString lastStanzaId() const;
+    void setLastStanzaId(const QString &stanzaId);
+
     // documentation needs to be here, see https://stackoverflow.com/questions/49192523/
     ///
     /// Returns the list of participant JIDs.
@@ -209,6 +231,8 @@ Q_SIGNALS:
     void participantsChanged();
     /// \endcond
 
+    void participantsAdded(const QStringList &jids);
+
     /// This signal is emitted when the room's permissions are received.
     void permissionsReceived(const QList<QXmppMucItem> &permissions);
 
@@ -7,24 +7,33 @@
 
 #include "QXmppConfiguration.h"
 #include "QXmppConstants_p.h"
+#include "QXmppCredentialsMemoryStorage.h"
+#include "QXmppDnsCache_p.h"
+#include "QXmppHappyEyeballs_p.h"
 #include "QXmppIq.h"
 #include "QXmppLogger.h"
 #include "QXmppMessage.h"
 #include "QXmppNonSASLAuth.h"
 #include "QXmppPresence.h"
 #include "QXmppSasl_p.h"
+#include "QXmppStanzaView.h"
 #include "QXmppStreamFeatures.h"
 #include "QXmppStreamManagement_p.h"
 #include "QXmppTask.h"
+#include "QXmppTimerWheel_p.h"
 #include "QXmppUtils.h"
 
+#include <algorithm>
+
 #include <QCryptographicHash>
-#include <QDnsLookup>
+#include <QDataStream>
 #include <QFuture>
 #include <QNetworkProxy>
 #include <QSslConfiguration>
 #include <QSslSocket>
+#include <QSysInfo>
 #include <QUrl>
+#include <QUuid>
 
 // IQ types
 #include "QXmppBindIq.h"
@@ -37,15 +46,34 @@
 #include <QHostAddress>
 #include <QRegularExpression>
 #include <QStringList>
-#include <QTimer>
 #include <QXmlStreamWriter>
 
+using namespace QXmpp::Private;
+
 class QXmppOutgoingClientPrivate
 {
 public:
     QXmppOutgoingClientPrivate(QXmppOutgoingClient *q);
-    void connectToHost(const QString &host, quint16 port);
+    void connectToHost(const QString &host, quint16 port, bool directTls = false);
+    void connectToHosts(const QVector<HappyEyeballs::Target> &targets, bool directTls);
+    void connectSocket(const QString &host, quint16 port);
+    void handleHostConnected(const QHostAddress &address, quint16 port);
     void connectToNextDNSHost();
+    bool connectToFallbackHost();
+    void lookupHosts(bool directTls);
+    void handleServiceLookup(const QString &name, const DnsCache::ServiceResult &result);
+    void storeTlsSessionTicket();
+
+    QXmppSaslClient *createSaslClient(const QStringList &serverMechanisms);
+    void startSasl2(const QXmppStreamFeatures &features);
+    void sendSasl2Authenticate(std::optional<QXmppCredentialsStorage::FastToken> token);
+    void storeScramKeys();
+    void removeScramKeys();
+    void handleSasl2Success(const Sasl2::Success &success);
+    void handleSasl2Failure(const Sasl2::Failure &failure);
+    void setBoundJid(const QString &jid);
+    void setStreamManagementEnabled(const QXmppStreamManagementEnabled &enabled);
+    void setStreamResumed(const QXmppStreamManagementResumed &resumed);
 
     void sendNonSASLAuth(bool plaintext);
     void sendNonSASLAuthQuery();
@@ -57,10 +85,18 @@ public:
     // required for connecting to the XMPP server.
     QXmppConfiguration config;
     QXmppStanza::Error::Condition xmppStreamError;
+    // delay in ms the server has asked to wait after the last stream error,
+    // 0 for temporary errors without a hint, -1 if reconnecting won't help
+    int streamErrorRetryDelay = -1;
 
     // DNS
-    QDnsLookup dns;
+    QVector<DnsCache::ServiceRecord> serviceRecords;
+    int serviceLookupId;
     int nextSrvRecordIdx;
+    HappyEyeballs *hostConnector;
+    bool connectingDirectTls;
+    // XEP-0368: SRV records for XMPP over TLS
+    bool dnsDirectTls;
 
     // Stream
     QString streamId;
@@ -83,9 +119,26 @@ public:
     QString nonSASLAuthId;
     QXmppSaslClient *saslClient;
 
+    // XEP-0388: Extensible SASL Profile
+    bool isSasl2;
+    QXmppStreamFeatures sasl2Features;
+    QString userAgentId;
+    // XEP-0386: Bind 2, the server appends a suffix to the tag
+    QString bind2Tag;
+    QString bind2Resource;
+    // XEP-0484: Fast Authentication Streamlining Tokens
+    QXmppCredentialsMemoryStorage credentialsMemoryStorage;
+    QXmppCredentialsStorage *credentialsStorage;
+    bool usingFastToken;
+    QString requestedTokenMechanism;
+    // loaded when connecting, the SASL clients need them synchronously
+    std::optional<QXmppCredentialsStorage::ScramKeys> scramKeys;
+
     // Stream Management
     bool streamManagementAvailable;
     QString smId;
+    // bound JID of a stream restored from another process
+    QString restoredJid;
     bool canResume;
     bool isResuming;
     QString resumeHost;
@@ -95,10 +148,11 @@ public:
 
     // Client State Indication
     bool clientStateIndicationEnabled;
+    bool clientActive = true;
 
-    // Timers
-    QTimer *pingTimer;
-    QTimer *timeoutTimer;
+    // Timers, the ping timer is touched by received data
+    QXmpp::Private::WheelTimer pingTimer;
+    QXmpp::Private::WheelTimer timeoutTimer;
 
 private:
     QXmppOutgoingClient *q;
@@ -106,12 +160,19 @@ private:
 
 QXmppOutgoingClientPrivate::QXmppOutgoingClientPrivate(QXmppOutgoingClient *qq)
     : nextSrvRecordIdx(0),
+      serviceLookupId(0),
+      hostConnector(nullptr),
+      connectingDirectTls(false),
+      dnsDirectTls(false),
       redirectPort(0),
       bindModeAvailable(false),
       sessionAvailable(false),
       sessionStarted(false),
       isAuthenticated(false),
       saslClient(nullptr),
+      isSasl2(false),
+      credentialsStorage(&credentialsMemoryStorage),
+      usingFastToken(false),
       streamManagementAvailable(false),
       canResume(false),
       isResuming(false),
@@ -119,16 +180,17 @@ QXmppOutgoingClientPrivate::QXmppOutgoingClientPrivate(QXmppOutgoingClient *qq)
       streamManagementEnabled(false),
       streamResumed(false),
       clientStateIndicationEnabled(false),
-      pingTimer(nullptr),
-      timeoutTimer(nullptr),
       q(qq)
 {
 }
 
-void QXmppOutgoingClientPrivate::connectToHost(const QString &host, quint16 port)
+void QXmppOutgoingClientPrivate::connectToHost(const QString &host, quint16 port, bool directTls)
 {
-    q->info(QString("Connecting to %1:%2").arg(host, QString::number(port)));
+    connectToHosts({ { host, port } }, directTls);
+}
 
+void QXmppOutgoingClientPrivate::connectToHosts(const QVector<HappyEyeballs::Target> &targets, bool directTls)
+{
     // override CA certificates if requested
     if (!config.caCertificates().isEmpty()) {
         QSslConfiguration newSslConfig;
@@ -136,31 +198,145 @@ void QXmppOutgoingClientPrivate::connectToHost(const QString &host, quint16 port
         q->socket()->setSslConfiguration(newSslConfig);
     }
 
+    // resume the TLS session of the last connection
+    auto sslConfig = q->socket()->sslConfiguration();
+    const bool resumeSession = config.isTlsSessionResumptionEnabled();
+    sslConfig.setSslOption(QSsl::SslOptionDisableSessionPersistence, !resumeSession);
+    sslConfig.setSessionTicket(resumeSession ? config.tlsSessionTicket() : QByteArray());
+    // XEP-0368: SRV records for XMPP over TLS
+    sslConfig.setAllowedNextProtocols(directTls ? QList<QByteArray> { QByteArrayLiteral("xmpp-client") } : QList<QByteArray>());
+    q->socket()->setSslConfiguration(sslConfig);
+
     // respect proxy
     q->socket()->setProxy(config.networkProxy());
 
     // set the name the SSL certificate should match
     q->socket()->setPeerVerifyName(config.domain());
 
-    // connect to host
-    const QXmppConfiguration::StreamSecurityMode localSecurity = q->configuration().streamSecurityMode();
-    if (localSecurity == QXmppConfiguration::LegacySSL) {
+    connectingDirectTls = directTls;
+    if (config.streamSecurityMode() == QXmppConfiguration::LegacySSL || directTls) {
         if (!q->socket()->supportsSsl()) {
             q->warning("Not connecting as legacy SSL was requested, but SSL support is not available");
             return;
         }
+    }
+
+    // connections through a proxy can't be raced
+    if (!HappyEyeballs::canConnectDirectly(config.networkProxy())) {
+        connectSocket(targets.first().host, targets.first().port);
+        return;
+    }
+
+    hostConnector->connectToHosts(targets);
+}
+
+void QXmppOutgoingClientPrivate::connectSocket(const QString &host, quint16 port)
+{
+    q->info(QString("Connecting to %1:%2").arg(host, QString::number(port)));
+
+    if (config.streamSecurityMode() == QXmppConfiguration::LegacySSL || connectingDirectTls) {
         q->socket()->connectToHostEncrypted(host, port);
     } else {
         q->socket()->connectToHost(host, port);
     }
 }
 
+void QXmppOutgoingClientPrivate::handleHostConnected(const QHostAddress &address, quint16 port)
+{
+    if (!hostConnector->moveConnectionTo(q->socket())) {
+        // connect again to the address that has been reachable
+        connectSocket(address.toString(), port);
+        return;
+    }
+
+    if (config.streamSecurityMode() == QXmppConfiguration::LegacySSL || connectingDirectTls) {
+        q->socket()->startClientEncryption();
+    }
+
+    // sockets that take over a connection don't emit connected() themselves,
+    // but the stream is started from it
+    Q_EMIT q->socket()->connected();
+}
+
 void QXmppOutgoingClientPrivate::connectToNextDNSHost()
 {
-    auto curIdx = nextSrvRecordIdx++;
-    connectToHost(
-        dns.serviceRecords().at(curIdx).target(),
-        dns.serviceRecords().at(curIdx).port());
+    // the records are sorted by priority and weight, the connections to the
+    // first ones are raced
+    const auto &records = serviceRecords;
+    const int maxTargets = HappyEyeballs::canConnectDirectly(config.networkProxy()) ? HappyEyeballs::MaxTargets : 1;
+
+    QVector<HappyEyeballs::Target> targets;
+    for (; nextSrvRecordIdx < records.size() && targets.size() < maxTargets; nextSrvRecordIdx++) {
+        targets.push_back({ records.at(nextSrvRecordIdx).target(), records.at(nextSrvRecordIdx).port() });
+    }
+    connectToHosts(targets, dnsDirectTls);
+}
+
+//
+// Tries the next hosts after the connection to a host failed during startup.
+// Returns false if there are no other hosts.
+//
+bool QXmppOutgoingClientPrivate::connectToFallbackHost()
+{
+    if (sessionStarted) {
+        return false;
+    }
+
+    if (serviceRecords.size() > nextSrvRecordIdx) {
+        // try next available SRV record servers
+        connectToNextDNSHost();
+        return true;
+    }
+    if (dnsDirectTls) {
+        // none of the hosts for direct TLS is reachable, use STARTTLS
+        lookupHosts(false);
+        return true;
+    }
+    return false;
+}
+
+void QXmppOutgoingClientPrivate::lookupHosts(bool directTls)
+{
+    const QString domain = config.domain();
+    q->debug(QString("Looking up %1 server for domain %2").arg(directTls ? QStringLiteral("direct TLS") : QStringLiteral("STARTTLS"), domain));
+    dnsDirectTls = directTls;
+    serviceRecords.clear();
+    nextSrvRecordIdx = 0;
+
+    // results of outdated lookups are ignored
+    const auto lookupId = ++serviceLookupId;
+    const auto name = (directTls ? QStringLiteral("_xmpps-client._tcp.") : QStringLiteral("_xmpp-client._tcp.")) + domain;
+    DnsCache::instance()->lookupService(name).then(q, [this, lookupId, name](DnsCache::ServiceResult &&result) {
+        if (lookupId == serviceLookupId) {
+            handleServiceLookup(name, result);
+        }
+    });
+}
+
+void QXmppOutgoingClientPrivate::handleServiceLookup(const QString &name, const DnsCache::ServiceResult &result)
+{
+    if (result.error == QDnsLookup::NoError && !result.records.isEmpty()) {
+        // take the first returned records
+        serviceRecords = result.records;
+        connectToNextDNSHost();
+    } else if (dnsDirectTls) {
+        // no hosts for direct TLS, use STARTTLS
+        lookupHosts(false);
+    } else {
+        // as a fallback, use domain as the host name
+        q->warning(QString("Lookup for domain %1 failed: %2")
+                       .arg(name, result.errorString));
+        connectToHost(config.domain(), config.port());
+    }
+}
+
+void QXmppOutgoingClientPrivate::storeTlsSessionTicket()
+{
+    if (config.isTlsSessionResumptionEnabled()) {
+        if (const auto ticket = q->socket()->sslConfiguration().sessionTicket(); !ticket.isEmpty()) {
+            config.setTlsSessionTicket(ticket);
+        }
+    }
 }
 
 ///
@@ -177,17 +353,40 @@ QXmppOutgoingClient::QXmppOutgoingClient(QObject *parent)
     connect(socket, &QAbstractSocket::disconnected, this, &QXmppOutgoingClient::_q_socketDisconnected);
     connect(socket, QOverload<const QList<QSslError> &>::of(&QSslSocket::sslErrors), this, &QXmppOutgoingClient::socketSslErrors);
     connect(socket, &QSslSocket::errorOccurred, this, &QXmppOutgoingClient::socketError);
+    connect(socket, &QSslSocket::encrypted, this, [this]() {
+        d->storeTlsSessionTicket();
+    });
+    connect(socket, &QSslSocket::newSessionTicketReceived, this, [this]() {
+        d->storeTlsSessionTicket();
+    });
+    connect(socket, &QAbstractSocket::connected, this, [this, socket]() {
+        if (d->config.isTcpKeepAliveEnabled()) {
+            socket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+        }
+    });
+    connect(socket, &QIODevice::readyRead, this, [this]() {
+        // if we receive any kind of data, the connection is alive
+        if (d->pingTimer.isActive()) {
+            d->pingTimer.touch();
+        }
+        d->timeoutTimer.stop();
+    });
 
-    // DNS lookups
-    connect(&d->dns, &QDnsLookup::finished, this, &QXmppOutgoingClient::_q_dnsLookupFinished);
+    // RFC 8305: Happy Eyeballs
+    d->hostConnector = new HappyEyeballs(this);
+    connect(d->hostConnector, &HappyEyeballs::connected, this, [this](const QHostAddress &address, quint16 port) {
+        d->handleHostConnected(address, port);
+    });
+    connect(d->hostConnector, &HappyEyeballs::failed, this, [this](const QString &errorString) {
+        warning(QStringLiteral("Could not connect to the server: ") + errorString);
+        if (!d->connectToFallbackHost()) {
+            Q_EMIT error(QXmppClient::SocketError);
+        }
+    });
 
     // XEP-0199: XMPP Ping
-    d->pingTimer = new QTimer(this);
-    connect(d->pingTimer, &QTimer::timeout, this, &QXmppOutgoingClient::pingSend);
-
-    d->timeoutTimer = new QTimer(this);
-    d->timeoutTimer->setSingleShot(true);
-    connect(d->timeoutTimer, &QTimer::timeout, this, &QXmppOutgoingClient::pingTimeout);
+    d->pingTimer.setCallback([this] { pingSend(); });
+    d->timeoutTimer.setCallback([this] { pingTimeout(); });
 
     connect(this, &QXmppStream::connected, this, &QXmppOutgoingClient::pingStart);
     connect(this, &QXmppStream::disconnected, this, &QXmppOutgoingClient::pingStop);
@@ -216,10 +415,128 @@ QXmppConfiguration &QXmppOutgoingClient::configuration()
     return d->config;
 }
 
+///
+/// Returns the storage of the credentials used for \xep{0484, Fast
+/// Authentication Streamlining Tokens}.
+///
+/// \since QXmpp 1.6
+///
+QXmppCredentialsStorage *QXmppOutgoingClient::credentialsStorage() const
+{
+    return d->credentialsStorage;
+}
+
+///
+/// Sets the storage of the credentials used for \xep{0484, Fast
+/// Authentication Streamlining Tokens}.
+///
+/// The storage is not owned by the stream.
+///
+/// \param storage storage to use, nullptr resets to the default memory storage
+///
+/// \since QXmpp 1.6
+///
+void QXmppOutgoingClient::setCredentialsStorage(QXmppCredentialsStorage *storage)
+{
+    d->credentialsStorage = storage ? storage : &d->credentialsMemoryStorage;
+}
+
+// version of the format written by streamResumptionState()
+constexpr quint32 RESUMPTION_STATE_VERSION = 1;
+
+///
+/// Returns the state of \xep{0198, Stream Management} needed to resume the
+/// stream from another process.
+///
+/// The state contains the ID and the location of the stream, the sequence
+/// numbers and the stanzas that have not been acknowledged by the server. It
+/// changes with every stanza, so it should be saved shortly before the process
+/// is terminated, e.g. when the application is suspended.
+///
+/// \return the serialized state or an empty byte array if the stream can't be
+/// resumed
+///
+/// \since QXmpp 1.6
+///
+QByteArray QXmppOutgoingClient::streamResumptionState() const
+{
+    if (!d->canResume) {
+        return {};
+    }
+
+    QByteArray state;
+    QDataStream stream(&state, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_15);
+    stream << RESUMPTION_STATE_VERSION << d->config.jid() << d->smId << d->resumeHost << d->resumePort;
+    saveStreamManagementState(stream);
+    return state;
+}
+
+///
+/// Restores the \xep{0198, Stream Management} state of a stream of another
+/// process returned by streamResumptionState().
+///
+/// This needs to be called before connecting. The next connection then tries
+/// to resume the stream. If the server can't resume it anymore, a new session
+/// is started and the restored unacknowledged stanzas are sent again.
+///
+/// \return whether the state could be read
+///
+/// \since QXmpp 1.6
+///
+bool QXmppOutgoingClient::setStreamResumptionState(const QByteArray &state)
+{
+    QDataStream stream(state);
+    stream.setVersion(QDataStream::Qt_5_15);
+
+    quint32 version = 0;
+    QString jid;
+    QString smId;
+    QString resumeHost;
+    quint16 resumePort = 0;
+    stream >> version;
+    if (version != RESUMPTION_STATE_VERSION) {
+        return false;
+    }
+    stream >> jid >> smId >> resumeHost >> resumePort;
+    if (stream.status() != QDataStream::Ok || smId.isEmpty() || !restoreStreamManagementState(stream)) {
+        return false;
+    }
+
+    // the stream belongs to this account, the resource is set when it is resumed
+    d->config.setJid(QXmppUtils::jidToBareJid(jid));
+    d->restoredJid = jid;
+    d->smId = smId;
+    d->resumeHost = resumeHost;
+    d->resumePort = resumePort;
+    d->canResume = true;
+    return true;
+}
+
 /// Attempts to connect to the XMPP server.
 
 void QXmppOutgoingClient::connectToHost()
 {
+    setWriteBatchSize(d->config.writeBatchSize());
+    setWriteBatchDelay(d->config.writeBatchDelay());
+    setBulkWriteThreshold(d->config.bulkWriteThreshold());
+    setStreamManagementQueueLimit(d->config.streamManagementQueueLimit(),
+                                  d->config.streamManagementQueuePolicy() == QXmppConfiguration::DisconnectStream);
+    setStreamManagementPolicy(d->config.streamManagementPolicy());
+    setIqCoalescingEnabled(d->config.isIqCoalescingEnabled());
+    setIqTimeout(d->config.iqTimeout());
+    setMaximumStanzaSize(d->config.maximumStanzaSize());
+    setBackgroundParsingEnabled(d->config.isBackgroundParsingEnabled());
+    d->dnsDirectTls = false;
+    d->serviceRecords.clear();
+    d->nextSrvRecordIdx = 0;
+    d->serviceLookupId++;
+    d->hostConnector->abort();
+
+    d->credentialsStorage->scramKeys().then(this, [this](std::optional<QXmppCredentialsStorage::ScramKeys> &&keys) {
+        d->scramKeys = std::move(keys);
+    });
+
     // if a host for resumption is available, connect to it
     if (d->canResume && !d->resumeHost.isEmpty() && d->resumePort) {
         d->connectToHost(d->resumeHost, d->resumePort);
@@ -233,12 +550,9 @@ void QXmppOutgoingClient::connectToHost()
     }
 
     // otherwise, lookup server
-    const QString domain = configuration().domain();
-    debug(QString("Looking up server for domain %1").arg(domain));
-    d->dns.setName("_xmpp-client._tcp." + domain);
-    d->dns.setType(QDnsLookup::SRV);
-    d->dns.lookup();
-    d->nextSrvRecordIdx = 0;
+    d->lookupHosts(d->config.isDirectTlsEnabled() &&
+                   d->config.streamSecurityMode() != QXmppConfiguration::TLSDisabled &&
+                   QSslSocket::supportsSsl());
 }
 
 ///
@@ -249,23 +563,12 @@ void QXmppOutgoingClient::connectToHost()
 void QXmppOutgoingClient::disconnectFromHost()
 {
     d->canResume = false;
+    d->restoredJid.clear();
+    d->serviceLookupId++;
+    d->hostConnector->abort();
     QXmppStream::disconnectFromHost();
 }
 
-void QXmppOutgoingClient::_q_dnsLookupFinished()
-{
-    if (d->dns.error() == QDnsLookup::NoError &&
-        !d->dns.serviceRecords().isEmpty()) {
-        // take the first returned record
-        d->connectToNextDNSHost();
-    } else {
-        // as a fallback, use domain as the host name
-        warning(QString("Lookup for domain %1 failed: %2")
-                    .arg(d->dns.name(), d->dns.errorString()));
-        d->connectToHost(d->config.domain(), d->config.port());
-    }
-}
-
 /// Returns true if authentication has succeeded.
 
 bool QXmppOutgoingClient::isAuthenticated() const
@@ -290,6 +593,39 @@ bool QXmppOutgoingClient::isClientStateIndicationEnabled() const
     return d->clientStateIndicationEnabled;
 }
 
+///
+/// Adapts the keep alive interval and the stream management requests to the
+/// client state (\xep{0352}).
+///
+/// While inactive, pings are sent with the inactive keep alive interval and
+/// acknowledgements are only requested with the keep alive interval, so the
+/// connection stays idle. The normal stream management policy is restored
+/// when the client becomes active again.
+///
+/// \since QXmpp 1.6
+///
+void QXmppOutgoingClient::setClientActive(bool active)
+{
+    if (d->clientActive == active) {
+        return;
+    }
+    d->clientActive = active;
+
+    if (active) {
+        setStreamManagementPolicy(d->config.streamManagementPolicy());
+    } else {
+        auto policy = d->config.streamManagementPolicy();
+        policy.setRequestStanzaCount(0);
+        policy.setRequestByteCount(0);
+        policy.setRequestInterval(std::max(0, d->config.inactiveKeepAliveInterval()) * 1000);
+        setStreamManagementPolicy(policy);
+    }
+
+    if (d->pingTimer.isActive()) {
+        pingStart();
+    }
+}
+
 ///
 /// Returns whether Stream Management is currently enabled.
 ///
@@ -362,11 +698,8 @@ void QXmppOutgoingClient::socketSslErrors(const QList<QSslError> &errors)
 void QXmppOutgoingClient::socketError(QAbstractSocket::SocketError socketError)
 {
     Q_UNUSED(socketError);
-    if (!d->sessionStarted &&
-        (d->dns.serviceRecords().count() > d->nextSrvRecordIdx)) {
-        // some network error occurred during startup -> try next available SRV record server
-        d->connectToNextDNSHost();
-    } else {
+    // some network error occurred during startup -> try the next hosts
+    if (!d->connectToFallbackHost()) {
         Q_EMIT error(QXmppClient::SocketError);
     }
 }
@@ -386,6 +719,9 @@ void QXmppOutgoingClient::handleStart()
         delete d->saslClient;
         d->saslClient = nullptr;
     }
+    d->isSasl2 = false;
+    d->usingFastToken = false;
+    d->requestedTokenMechanism.clear();
 
     // reset session information
     d->bindId.clear();
@@ -397,6 +733,9 @@ void QXmppOutgoingClient::handleStart()
     d->streamResumed = false;
     d->streamManagementEnabled = false;
 
+    // a new stream is always active
+    setClientActive(true);
+
     // start stream
     QByteArray data = "<?xml version='1.0'?><stream:stream to='";
     data.append(configuration().domain().toUtf8());
@@ -423,10 +762,24 @@ void QXmppOutgoingClient::handleStream(const QDomElement &streamElement)
     }
 }
 
+void QXmppOutgoingClient::handleStanza(const QXmppStanzaView &stanza)
+{
+    // give client opportunity to handle stanza without creating a DOM
+    bool handled = false;
+    Q_EMIT stanzaReceived(stanza, handled);
+    if (handled) {
+        // if we receive any kind of data, stop the timeout timer
+        d->timeoutTimer.stop();
+        return;
+    }
+
+    handleStanza(stanza.toDomElement());
+}
+
 void QXmppOutgoingClient::handleStanza(const QDomElement &nodeRecv)
 {
     // if we receive any kind of data, stop the timeout timer
-    d->timeoutTimer->stop();
+    d->timeoutTimer.stop();
 
     const QString ns = nodeRecv.namespaceURI();
 
@@ -448,61 +801,16 @@ void QXmppOutgoingClient::handleStanza(const QDomElement &nodeRecv)
         // handle authentication
         const bool nonSaslAvailable = features.nonSaslAuthMode() != QXmppStreamFeatures::Disabled;
         const bool saslAvailable = !features.authMechanisms().isEmpty();
-        if (saslAvailable && configuration().useSASLAuthentication()) {
-            // supported and preferred SASL auth mechanisms
-            const QString preferredMechanism = configuration().saslAuthMechanism();
-            QStringList supportedMechanisms = QXmppSaslClient::availableMechanisms();
-            if (supportedMechanisms.contains(preferredMechanism)) {
-                supportedMechanisms.removeAll(preferredMechanism);
-                supportedMechanisms.prepend(preferredMechanism);
-            }
-            if (configuration().facebookAppId().isEmpty() || configuration().facebookAccessToken().isEmpty()) {
-                supportedMechanisms.removeAll("X-FACEBOOK-PLATFORM");
-            }
-            if (configuration().windowsLiveAccessToken().isEmpty()) {
-                supportedMechanisms.removeAll("X-MESSENGER-OAUTH2");
-            }
-            if (configuration().googleAccessToken().isEmpty()) {
-                supportedMechanisms.removeAll("X-OAUTH2");
-            }
-
-            // determine SASL Authentication mechanism to use
-            QStringList commonMechanisms;
-            QString usedMechanism;
-            for (const auto &mechanism : std::as_const(supportedMechanisms)) {
-                if (features.authMechanisms().contains(mechanism)) {
-                    commonMechanisms << mechanism;
-                }
-            }
-            if (commonMechanisms.isEmpty()) {
-                warning("No supported SASL Authentication mechanism available");
-                disconnectFromHost();
-                return;
-            } else {
-                usedMechanism = commonMechanisms.first();
-            }
-
-            d->saslClient = QXmppSaslClient::create(usedMechanism, this);
+        if (!d->isAuthenticated && !features.sasl2Mechanisms().isEmpty() &&
+            configuration().useSASLAuthentication() && configuration().useSasl2Authentication()) {
+            d->startSasl2(features);
+            return;
+        } else if (saslAvailable && configuration().useSASLAuthentication()) {
+            d->saslClient = d->createSaslClient(features.authMechanisms());
             if (!d->saslClient) {
-                warning("SASL mechanism negotiation failed");
                 disconnectFromHost();
                 return;
             }
-            info(QString("SASL mechanism '%1' selected").arg(d->saslClient->mechanism()));
-            d->saslClient->setHost(d->config.domain());
-            d->saslClient->setServiceType("xmpp");
-            if (d->saslClient->mechanism() == "X-FACEBOOK-PLATFORM") {
-                d->saslClient->setUsername(configuration().facebookAppId());
-                d->saslClient->setPassword(configuration().facebookAccessToken());
-            } else if (d->saslClient->mechanism() == "X-MESSENGER-OAUTH2") {
-                d->saslClient->setPassword(configuration().windowsLiveAccessToken());
-            } else if (d->saslClient->mechanism() == "X-OAUTH2") {
-                d->saslClient->setUsername(configuration().user());
-                d->saslClient->setPassword(configuration().googleAccessToken());
-            } else {
-                d->saslClient->setUsername(configuration().user());
-                d->saslClient->setPassword(configuration().password());
-            }
 
             // send SASL auth request
             QByteArray response;
@@ -523,32 +831,27 @@ void QXmppOutgoingClient::handleStanza(const QDomElement &nodeRecv)
         d->bindModeAvailable = (features.bindMode() != QXmppStreamFeatures::Disabled);
         d->streamManagementAvailable = (features.streamManagementMode() != QXmppStreamFeatures::Disabled);
 
-        // check whether the stream can be resumed
-        if (d->streamManagementAvailable && d->canResume) {
-            d->isResuming = true;
-            QXmppStreamManagementResume streamManagementResume(lastIncomingSequenceNumber(), d->smId);
-            QByteArray data;
-            QXmlStreamWriter xmlStream(&data);
-            streamManagementResume.toXml(&xmlStream);
-            sendData(data);
-            return;
-        }
-
-        // check whether bind is available
-        if (d->bindModeAvailable) {
-            d->sendBind();
+        // XEP-0138: Stream Compression, the stream is restarted afterwards
+        if (d->isAuthenticated && configuration().isStreamCompressionEnabled() && isCompressionSupported() &&
+            !isCompressionEnabled() && features.compressionMethods().contains(QStringLiteral("zlib"))) {
+            sendData(QByteArrayLiteral("<compress xmlns='http://jabber.org/protocol/compress'><method>zlib</method></compress>"));
             return;
         }
 
-        // check whether session is available
-        if (d->sessionAvailable) {
-            d->sendSessionStart();
-            return;
+        startSession();
+    } else if (ns == ns_compress) {
+        if (nodeRecv.tagName() == QLatin1String("compressed")) {
+            if (!enableCompression()) {
+                disconnectFromHost();
+                return;
+            }
+            debug(QStringLiteral("Stream compression enabled"));
+            handleStart();
+        } else if (nodeRecv.tagName() == QLatin1String("failure")) {
+            // the stream can be used uncompressed
+            warning(QStringLiteral("Stream compression failed: ") + nodeRecv.firstChildElement().tagName());
+            startSession();
         }
-
-        // otherwise we are done
-        d->sessionStarted = true;
-        Q_EMIT connected();
     } else if (ns == ns_stream && nodeRecv.tagName() == "error") {
         // handle redirects
         const auto otherHost = nodeRecv.firstChildElement("see-other-host");
@@ -564,6 +867,21 @@ void QXmppOutgoingClient::handleStanza(const QDomElement &nodeRecv)
         } else {
             d->xmppStreamError = QXmppStanza::Error::UndefinedCondition;
         }
+
+        // the server is restarting or overloaded, it may tell how long to wait
+        d->streamErrorRetryDelay = -1;
+        if (!nodeRecv.firstChildElement(QStringLiteral("system-shutdown")).isNull() ||
+            !nodeRecv.firstChildElement(QStringLiteral("resource-constraint")).isNull()) {
+            d->streamErrorRetryDelay = 0;
+        }
+        for (auto hint = nodeRecv.firstChildElement(QStringLiteral("retry-after")); !hint.isNull(); hint = hint.nextSiblingElement(QStringLiteral("retry-after"))) {
+            bool ok = false;
+            const auto seconds = hint.attribute(QStringLiteral("seconds")).toInt(&ok);
+            if (hint.namespaceURI() == ns_qxmpp_retry_after && ok && seconds >= 0) {
+                d->streamErrorRetryDelay = int(std::min(seconds, 24 * 3600) * 1000);
+                break;
+            }
+        }
         Q_EMIT error(QXmppClient::XmppStreamError);
     } else if (ns == ns_sasl) {
         if (!d->saslClient) {
@@ -573,6 +891,7 @@ void QXmppOutgoingClient::handleStanza(const QDomElement &nodeRecv)
         if (nodeRecv.tagName() == "success") {
             debug("Authenticated");
             d->isAuthenticated = true;
+            d->storeScramKeys();
             handleStart();
         } else if (nodeRecv.tagName() == "challenge") {
             QXmppSaslChallenge challenge;
@@ -600,6 +919,38 @@ void QXmppOutgoingClient::handleStanza(const QDomElement &nodeRecv)
             Q_EMIT error(QXmppClient::XmppStreamError);
 
             warning("Authentication failure");
+            d->removeScramKeys();
+            disconnectFromHost();
+        }
+    } else if (ns == ns_sasl_2) {
+        if (!d->saslClient || !d->isSasl2) {
+            warning("SASL 2 stanza received, but no mechanism selected");
+            return;
+        }
+        if (nodeRecv.tagName() == "success") {
+            Sasl2::Success success;
+            success.parse(nodeRecv);
+            d->handleSasl2Success(success);
+        } else if (nodeRecv.tagName() == "challenge") {
+            Sasl2::Challenge challenge;
+            challenge.parse(nodeRecv);
+
+            Sasl2::Response response;
+            if (d->saslClient->respond(challenge.data, response.data)) {
+                QByteArray data;
+                QXmlStreamWriter xmlStream(&data);
+                response.toXml(&xmlStream);
+                sendData(data);
+            } else {
+                warning("Could not respond to SASL challenge");
+                disconnectFromHost();
+            }
+        } else if (nodeRecv.tagName() == "failure") {
+            Sasl2::Failure failure;
+            failure.parse(nodeRecv);
+            d->handleSasl2Failure(failure);
+        } else if (nodeRecv.tagName() == "continue") {
+            warning("SASL 2 tasks are not supported");
             disconnectFromHost();
         }
     } else if (ns == ns_client) {
@@ -630,15 +981,7 @@ void QXmppOutgoingClient::handleStanza(const QDomElement &nodeRecv)
                 // bind result
                 if (bind.type() == QXmppIq::Result) {
                     if (!bind.jid().isEmpty()) {
-                        static const QRegularExpression jidRegex("^([^@/]+)@([^@/]+)/(.+)$");
-
-                        if (const auto match = jidRegex.match(bind.jid()); match.hasMatch()) {
-                            configuration().setUser(match.captured(1));
-                            configuration().setDomain(match.captured(2));
-                            configuration().setResource(match.captured(3));
-                        } else {
-                            warning("Bind IQ received with invalid JID: " + bind.jid());
-                        }
+                        d->setBoundJid(bind.jid());
                     }
 
                     if (d->sessionAvailable) {
@@ -731,7 +1074,11 @@ void QXmppOutgoingClient::handleStanza(const QDomElement &nodeRecv)
             Q_EMIT presenceReceived(presence);
         } else if (nodeRecv.tagName() == "message") {
             QXmppMessage message;
-            message.parse(nodeRecv);
+            if (const auto namespaces = configuration().parsedMessageNamespaces(); !namespaces.isEmpty()) {
+                message.parse(nodeRecv, QXmpp::SceAll, namespaces);
+            } else {
+                message.parse(nodeRecv);
+            }
 
             // emit message
             Q_EMIT messageReceived(message);
@@ -739,25 +1086,13 @@ void QXmppOutgoingClient::handleStanza(const QDomElement &nodeRecv)
     } else if (QXmppStreamManagementEnabled::isStreamManagementEnabled(nodeRecv)) {
         QXmppStreamManagementEnabled streamManagementEnabled;
         streamManagementEnabled.parse(nodeRecv);
-        d->smId = streamManagementEnabled.id();
-        d->canResume = streamManagementEnabled.resume();
-        if (streamManagementEnabled.resume() && !streamManagementEnabled.location().isEmpty()) {
-            setResumeAddress(streamManagementEnabled.location());
-        }
-
-        d->streamManagementEnabled = true;
-        enableStreamManagement(true);
+        d->setStreamManagementEnabled(streamManagementEnabled);
         // we are connected now
         Q_EMIT connected();
     } else if (QXmppStreamManagementResumed::isStreamManagementResumed(nodeRecv)) {
         QXmppStreamManagementResumed streamManagementResumed;
         streamManagementResumed.parse(nodeRecv);
-        setAcknowledgedSequenceNumber(streamManagementResumed.h());
-        d->isResuming = false;
-        d->streamResumed = true;
-
-        d->streamManagementEnabled = true;
-        enableStreamManagement(false);
+        d->setStreamResumed(streamManagementResumed);
         // we are connected now
         // TODO: The stream was resumed. Therefore, we should not send presence information or request the roster.
         Q_EMIT connected();
@@ -787,38 +1122,86 @@ void QXmppOutgoingClient::handleStanza(const QDomElement &nodeRecv)
         }
     }
 }
+
+// Resumes the stream or starts a new session after the authentication.
+void QXmppOutgoingClient::startSession()
+{
+    // check whether the stream can be resumed
+    if (d->streamManagementAvailable && d->canResume) {
+        d->isResuming = true;
+        QXmppStreamManagementResume streamManagementResume(lastIncomingSequenceNumber(), d->smId);
+        QByteArray data;
+        QXmlStreamWriter xmlStream(&data);
+        streamManagementResume.toXml(&xmlStream);
+        sendData(data);
+        return;
+    }
+
+    // check whether bind is available
+    if (d->bindModeAvailable) {
+        d->sendBind();
+        return;
+    }
+
+    // check whether session is available
+    if (d->sessionAvailable) {
+        d->sendSessionStart();
+        return;
+    }
+
+    // otherwise we are done
+    d->sessionStarted = true;
+    Q_EMIT connected();
+}
 /// \endcond
 
 void QXmppOutgoingClient::pingStart()
 {
-    const int interval = configuration().keepAliveInterval();
+    auto interval = configuration().keepAliveInterval();
+    if (!d->clientActive && interval > 0) {
+        interval = std::max(interval, configuration().inactiveKeepAliveInterval());
+    }
     // start ping timer
     if (interval > 0) {
-        d->pingTimer->setInterval(interval * 1000);
-        d->pingTimer->start();
+        d->pingTimer.start(interval * 1000);
     }
 }
 
 void QXmppOutgoingClient::pingStop()
 {
     // stop all timers
-    d->pingTimer->stop();
-    d->timeoutTimer->stop();
+    d->pingTimer.stop();
+    d->timeoutTimer.stop();
 }
 
 void QXmppOutgoingClient::pingSend()
 {
-    // send ping packet
-    QXmppPingIq ping;
-    ping.setTo(configuration().domain());
-    sendPacket(ping);
+    // the timer is only reached if nothing has been received within the
+    // interval
+    d->pingTimer.touch();
 
-    // start timeout timer
     const int timeout = configuration().keepAliveTimeout();
-    if (timeout > 0) {
-        d->timeoutTimer->setInterval(timeout * 1000);
-        d->timeoutTimer->start();
+    if (timeout <= 0) {
+        // nothing is waited for, a whitespace keeps the connection open
+        sendData(QByteArrayLiteral(" "));
+        return;
+    }
+
+    if (d->streamManagementEnabled) {
+        // the acknowledgement is cheaper to answer than a ping
+        QByteArray data;
+        QXmlStreamWriter writer(&data);
+        QXmppStreamManagementReq::toXml(&writer);
+        sendData(data);
+    } else {
+        // send ping packet
+        QXmppPingIq ping;
+        ping.setTo(configuration().domain());
+        sendPacket(ping);
     }
+
+    // start timeout timer
+    d->timeoutTimer.start(timeout * 1000);
 }
 
 void QXmppOutgoingClient::pingTimeout()
@@ -856,6 +1239,339 @@ std::pair<QString, int> QXmppOutgoingClient::parseHostAddress(const QString &add
     return { {}, -1 };
 }
 
+QXmppSaslClient *QXmppOutgoingClientPrivate::createSaslClient(const QStringList &serverMechanisms)
+{
+    // supported and preferred SASL auth mechanisms
+    const QString preferredMechanism = config.saslAuthMechanism();
+    QStringList supportedMechanisms = QXmppSaslClient::availableMechanisms();
+    if (supportedMechanisms.contains(preferredMechanism)) {
+        supportedMechanisms.removeAll(preferredMechanism);
+        supportedMechanisms.prepend(preferredMechanism);
+    }
+    if (config.facebookAppId().isEmpty() || config.facebookAccessToken().isEmpty()) {
+        supportedMechanisms.removeAll("X-FACEBOOK-PLATFORM");
+    }
+    if (config.windowsLiveAccessToken().isEmpty()) {
+        supportedMechanisms.removeAll("X-MESSENGER-OAUTH2");
+    }
+    if (config.googleAccessToken().isEmpty()) {
+        supportedMechanisms.removeAll("X-OAUTH2");
+    }
+
+    // determine SASL Authentication mechanism to use
+    QString usedMechanism;
+    for (const auto &mechanism : std::as_const(supportedMechanisms)) {
+        if (serverMechanisms.contains(mechanism)) {
+            usedMechanism = mechanism;
+            break;
+        }
+    }
+    if (usedMechanism.isEmpty()) {
+        q->warning("No supported SASL Authentication mechanism available");
+        return nullptr;
+    }
+
+    auto *client = QXmppSaslClient::create(usedMechanism, q);
+    if (!client) {
+        q->warning("SASL mechanism negotiation failed");
+        return nullptr;
+    }
+    q->info(QString("SASL mechanism '%1' selected").arg(client->mechanism()));
+    client->setHost(config.domain());
+    client->setServiceType("xmpp");
+    if (client->mechanism() == "X-FACEBOOK-PLATFORM") {
+        client->setUsername(config.facebookAppId());
+        client->setPassword(config.facebookAccessToken());
+    } else if (client->mechanism() == "X-MESSENGER-OAUTH2") {
+        client->setPassword(config.windowsLiveAccessToken());
+    } else if (client->mechanism() == "X-OAUTH2") {
+        client->setUsername(config.user());
+        client->setPassword(config.googleAccessToken());
+    } else {
+        client->setUsername(config.user());
+        client->setPassword(config.password());
+
+        // skip the key derivation if the salt of the server is the same
+        if (scramKeys && scramKeys->mechanism == client->mechanism() && scramKeys->username == config.user() &&
+            client->mechanism().startsWith(QStringLiteral("SCRAM-"))) {
+            static_cast<QXmppSaslClientScram *>(client)->setKeys({ scramKeys->salt, scramKeys->iterations, scramKeys->clientKey, scramKeys->serverKey });
+        }
+    }
+    return client;
+}
+
+void QXmppOutgoingClientPrivate::startSasl2(const QXmppStreamFeatures &features)
+{
+    isSasl2 = true;
+    sasl2Features = features;
+
+    // the token is bound to the user agent, so the ID needs to be stable
+    credentialsStorage->userAgentId().then(q, [this](QString &&id) {
+        if (id.isEmpty()) {
+            id = QUuid::createUuid().toString(QUuid::WithoutBraces);
+            credentialsStorage->setUserAgentId(id);
+        }
+        userAgentId = id;
+
+        if (sasl2Features.fastMechanisms().isEmpty()) {
+            sendSasl2Authenticate({});
+            return;
+        }
+        credentialsStorage->fastToken().then(q, [this](std::optional<QXmppCredentialsStorage::FastToken> &&token) {
+            sendSasl2Authenticate(std::move(token));
+        });
+    });
+}
+
+void QXmppOutgoingClientPrivate::sendSasl2Authenticate(std::optional<QXmppCredentialsStorage::FastToken> token)
+{
+    // the stream may have been closed while loading the credentials
+    if (!isSasl2 || q->socket()->state() != QAbstractSocket::ConnectedState) {
+        return;
+    }
+
+    delete saslClient;
+    saslClient = nullptr;
+
+    Sasl2::Authenticate authenticate;
+
+    const auto fastMechanisms = sasl2Features.fastMechanisms();
+    usingFastToken = token && fastMechanisms.contains(token->mechanism) &&
+        (!token->expiry.isValid() || token->expiry > QDateTime::currentDateTimeUtc());
+    if (usingFastToken) {
+        saslClient = QXmppSaslClient::create(token->mechanism, q);
+    }
+
+    if (saslClient) {
+        q->info(QString("SASL 2 token mechanism '%1' selected").arg(saslClient->mechanism()));
+        saslClient->setUsername(config.user());
+        saslClient->setPassword(token->secret);
+
+        // the count protects against replaying the token
+        token->count++;
+        credentialsStorage->setFastToken(*token);
+        authenticate.fastCount = token->count;
+    } else {
+        usingFastToken = false;
+        saslClient = createSaslClient(sasl2Features.sasl2Mechanisms());
+        if (!saslClient) {
+            q->disconnectFromHost();
+            return;
+        }
+
+        // request a token to skip the full authentication on the next login
+        if (saslClient->mechanism() != "ANONYMOUS") {
+            const auto tokenMechanisms = QXmppSaslClientHt::availableMechanisms();
+            for (const auto &mechanism : tokenMechanisms) {
+                if (fastMechanisms.contains(mechanism)) {
+                    requestedTokenMechanism = mechanism;
+                    authenticate.tokenRequestMechanism = mechanism;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (!saslClient->respond(QByteArray(), authenticate.initialResponse)) {
+        q->warning("SASL initial response failed");
+        q->disconnectFromHost();
+        return;
+    }
+    authenticate.mechanism = saslClient->mechanism();
+
+    const auto applicationName = QCoreApplication::applicationName();
+    authenticate.userAgent = Sasl2::UserAgent {
+        userAgentId,
+        applicationName.isEmpty() ? QStringLiteral("QXmpp") : applicationName,
+        QSysInfo::machineHostName(),
+    };
+
+    // XEP-0198: Stream Management, resume the previous stream directly
+    if (canResume && sasl2Features.sasl2StreamResumptionSupported()) {
+        isResuming = true;
+        authenticate.resume = QXmppStreamManagementResume(q->lastIncomingSequenceNumber(), smId);
+    }
+
+    // XEP-0386: Bind 2, used as fallback if the resumption fails
+    if (sasl2Features.bind2Supported()) {
+        if (bind2Resource.isEmpty() || config.resource() != bind2Resource) {
+            bind2Tag = config.resource();
+        }
+        authenticate.bindRequest = Sasl2::BindRequest {
+            bind2Tag,
+            sasl2Features.bind2InlineFeatures().contains(ns_stream_management),
+        };
+    }
+
+    QByteArray data;
+    QXmlStreamWriter xmlStream(&data);
+    authenticate.toXml(&xmlStream);
+    q->sendData(data);
+}
+
+// Stores the keys of a successful SCRAM authentication, so the next
+// authentication doesn't need to derive them again.
+void QXmppOutgoingClientPrivate::storeScramKeys()
+{
+    if (!saslClient || !saslClient->mechanism().startsWith(QStringLiteral("SCRAM-"))) {
+        return;
+    }
+    const auto keys = static_cast<QXmppSaslClientScram *>(saslClient)->keys();
+    if (keys.clientKey.isEmpty() ||
+        (scramKeys && scramKeys->mechanism == saslClient->mechanism() && scramKeys->username == config.user() &&
+         scramKeys->salt == keys.salt && scramKeys->iterations == keys.iterations)) {
+        return;
+    }
+
+    scramKeys = QXmppCredentialsStorage::ScramKeys {
+        saslClient->mechanism(),
+        config.user(),
+        keys.salt,
+        keys.iterations,
+        keys.clientKey,
+        keys.serverKey,
+    };
+    credentialsStorage->setScramKeys(*scramKeys);
+}
+
+// Removes the SCRAM keys after a failed authentication, e.g. because the
+// password has been changed.
+void QXmppOutgoingClientPrivate::removeScramKeys()
+{
+    if (scramKeys) {
+        scramKeys.reset();
+        credentialsStorage->removeScramKeys();
+    }
+}
+
+void QXmppOutgoingClientPrivate::handleSasl2Success(const Sasl2::Success &success)
+{
+    // verify the server, e.g. the signature of SCRAM or the hashed token
+    if (!success.additionalData.isEmpty() || usingFastToken) {
+        QByteArray response;
+        if (!saslClient->respond(success.additionalData, response)) {
+            q->warning("Could not verify SASL 2 success");
+            q->disconnectFromHost();
+            return;
+        }
+    }
+
+    q->debug("Authenticated (SASL 2)");
+    isAuthenticated = true;
+    storeScramKeys();
+
+    // the authorization identifier is the full JID, if a resource was bound
+    if (success.bound && !success.authorizationIdentifier.isEmpty()) {
+        setBoundJid(success.authorizationIdentifier);
+    }
+
+    // XEP-0484: Fast Authentication Streamlining Tokens
+    if (success.token) {
+        QXmppCredentialsStorage::FastToken token;
+        token.mechanism = usingFastToken ? saslClient->mechanism() : requestedTokenMechanism;
+        token.secret = success.token->secret;
+        token.expiry = success.token->expiry;
+        if (!token.mechanism.isEmpty()) {
+            credentialsStorage->setFastToken(token);
+        }
+    }
+
+    if (isResuming && !success.resumed) {
+        // the server has discarded the previous stream
+        isResuming = false;
+        canResume = false;
+    }
+
+    if (success.resumed) {
+        setStreamResumed(*success.resumed);
+        sessionStarted = true;
+        Q_EMIT q->connected();
+    } else if (success.bound) {
+        bind2Resource = config.resource();
+        sessionStarted = true;
+        if (success.enabled) {
+            setStreamManagementEnabled(*success.enabled);
+        } else {
+            // a new stream without stream management
+            streamManagementEnabled = false;
+        }
+        Q_EMIT q->connected();
+    }
+    // otherwise the server sends the stream features for binding a resource
+}
+
+void QXmppOutgoingClientPrivate::handleSasl2Failure(const Sasl2::Failure &failure)
+{
+    if (usingFastToken) {
+        // the token is invalid, retry using the password
+        q->warning("Authentication with token failed, retrying with password");
+        credentialsStorage->removeFastToken();
+        sendSasl2Authenticate({});
+        return;
+    }
+
+    removeScramKeys();
+
+    // RFC3920 defines the error condition as "not-authorized", but
+    // some broken servers use "bad-auth" instead. We tolerate this
+    // by remapping the error to "not-authorized".
+    if (failure.condition == "not-authorized" || failure.condition == "bad-auth") {
+        xmppStreamError = QXmppStanza::Error::NotAuthorized;
+    } else {
+        xmppStreamError = QXmppStanza::Error::UndefinedCondition;
+    }
+    Q_EMIT q->error(QXmppClient::XmppStreamError);
+
+    if (failure.text.isEmpty()) {
+        q->warning("Authentication failure");
+    } else {
+        q->warning("Authentication failure: " + failure.text);
+    }
+    q->disconnectFromHost();
+}
+
+void QXmppOutgoingClientPrivate::setBoundJid(const QString &jid)
+{
+    static const QRegularExpression jidRegex("^([^@/]+)@([^@/]+)/(.+)$");
+
+    if (const auto match = jidRegex.match(jid); match.hasMatch()) {
+        config.setUser(match.captured(1));
+        config.setDomain(match.captured(2));
+        config.setResource(match.captured(3));
+    } else {
+        q->warning("Invalid bound JID received: " + jid);
+    }
+}
+
+void QXmppOutgoingClientPrivate::setStreamManagementEnabled(const QXmppStreamManagementEnabled &enabled)
+{
+    smId = enabled.id();
+    restoredJid.clear();
+    canResume = enabled.resume();
+    if (enabled.resume() && !enabled.location().isEmpty()) {
+        q->setResumeAddress(enabled.location());
+    }
+
+    streamManagementEnabled = true;
+    q->enableStreamManagement(true);
+}
+
+void QXmppOutgoingClientPrivate::setStreamResumed(const QXmppStreamManagementResumed &resumed)
+{
+    q->setAcknowledgedSequenceNumber(resumed.h());
+    isResuming = false;
+    streamResumed = true;
+
+    // the configuration may have been replaced since the state was restored
+    if (!restoredJid.isEmpty()) {
+        setBoundJid(restoredJid);
+        restoredJid.clear();
+    }
+
+    streamManagementEnabled = true;
+    q->enableStreamManagement(false);
+}
+
 void QXmppOutgoingClientPrivate::sendNonSASLAuth(bool plainText)
 {
     QXmppNonSASLAuthIq authQuery;
@@ -915,3 +1631,19 @@ QXmppStanza::Error::Condition QXmppOutgoingClient::xmppStreamError()
 {
     return d->xmppStreamError;
 }
+
+///
+/// Returns how long to wait before reconnecting after the last XMPP stream
+/// error, in milliseconds.
+///
+/// This is 0 if the server is shutting down or overloaded without telling
+/// how long to wait, and -1 if reconnecting is not expected to help. Servers
+/// can add a \c{<retry-after xmlns='urn:qxmpp:retry-after:0' seconds='30'/>}
+/// element to the stream error to spread out the reconnections.
+///
+/// \since QXmpp 1.6
+///
+int QXmppOutgoingClient::streamErrorRetryDelay() const
+{
+    return d->streamErrorRetryDelay;
+}
@@ -14,9 +14,11 @@ class QDomElement;
 class QSslError;
 
 class QXmppConfiguration;
+class QXmppCredentialsStorage;
 class QXmppPresence;
 class QXmppIq;
 class QXmppMessage;
+class QXmppStanzaView;
 
 class QXmppOutgoingClientPrivate;
 
@@ -36,6 +38,7 @@ public:
     bool isAuthenticated() const;
     bool isConnected() const override;
     bool isClientStateIndicationEnabled() const;
+    void setClientActive(bool active);
     bool isStreamManagementEnabled() const;
     bool isStreamResumed() const;
     QXmppTask<IqResult> sendIq(QXmppIq &&);
@@ -43,9 +46,16 @@ public:
     /// Returns the used socket
     QSslSocket *socket() const { return QXmppStream::socket(); };
     QXmppStanza::Error::Condition xmppStreamError();
+    int streamErrorRetryDelay() const;
 
     QXmppConfiguration &configuration();
 
+    QXmppCredentialsStorage *credentialsStorage() const;
+    void setCredentialsStorage(QXmppCredentialsStorage *storage);
+
+    QByteArray streamResumptionState() const;
+    bool setStreamResumptionState(const QByteArray &state);
+
 Q_SIGNALS:
     /// This signal is emitted when an error is encountered.
     void error(QXmppClient::Error);
@@ -53,6 +63,12 @@ Q_SIGNALS:
     /// This signal is emitted when an element is received.
     void elementReceived(const QDomElement &element, bool &handled);
 
+    /// This signal is emitted when a stanza is received, before
+    /// elementReceived() is emitted.
+    ///
+    /// \since QXmpp 1.6
+    void stanzaReceived(const QXmppStanzaView &stanza, bool &handled);
+
     /// This signal is emitted when a presence is received.
     void presenceReceived(const QXmppPresence &);
 
@@ -71,6 +87,7 @@ protected:
     // Overridable methods
     void handleStart() override;
     void handleStanza(const QDomElement &element) override;
+    void handleStanza(const QXmppStanzaView &stanza) override;
     void handleStream(const QDomElement &element) override;
     /// \endcond
 
@@ -78,7 +95,6 @@ public Q_SLOTS:
     void disconnectFromHost() override;
 
 private Q_SLOTS:
-    void _q_dnsLookupFinished();
     void _q_socketDisconnected();
     void socketError(QAbstractSocket::SocketError);
     void socketSslErrors(const QList<QSslError> &);
@@ -89,6 +105,7 @@ private Q_SLOTS:
     void pingTimeout();
 
 private:
+    void startSession();
     bool setResumeAddress(const QString &address);
     static std::pair<QString, int> parseHostAddress(const QString &address);
 
@@ -30,7 +30,7 @@ inline QXmppTask<GetResult<ItemT>> request(QXmppPubSubManager *pubSub, const QSt
 }
 
 // NodeName is a template parameter, so the right qstring comparison overload is used
-// (if we used 'const QString &' as type, a 'const char *' string would be converted)
+// (if we used 'const QString &' as type, the namespace constant would be converted)
 template<typename ItemT, typename NodeName, typename Manager, typename ReceivedSignal>
 inline bool handlePubSubEvent(const QDomElement &element, const QString &pubSubService, const QString &eventNode, NodeName nodeName, Manager *manager, ReceivedSignal itemReceived)
 {
@@ -8,6 +8,7 @@
 
 #include "QXmppClient.h"
 #include "QXmppConstants_p.h"
+#include "QXmppDiscoveryManager.h"
 #include "QXmppPubSubAffiliation.h"
 #include "QXmppPubSubBaseItem.h"
 #include "QXmppPubSubEventHandler.h"
@@ -16,10 +17,245 @@
 #include "QXmppStanza.h"
 #include "QXmppUtils.h"
 
+#include <algorithm>
+#include <deque>
+
+#include <QDomDocument>
 #include <QDomElement>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+#include <QTextStream>
+#include <QTimer>
 
 using namespace QXmpp::Private;
 
+// Serialized item of the item cache. Items are stale after the client has
+// reconnected without resuming its stream, because notifications may have
+// been missed.
+struct CachedPubSubItem
+{
+    QByteArray data;
+    bool fresh = true;
+};
+
+struct CachedPubSubNode
+{
+    // item IDs in the order of the service
+    QVector<QString> ids;
+    QHash<QString, CachedPubSubItem> items;
+    // whether all items of the node are known
+    bool complete = false;
+    qint64 size = 0;
+    quint64 lastUse = 0;
+};
+
+struct QueuedPubSubItemsRequest
+{
+    QString service;
+    QString node;
+    QXmppPromise<QXmppPubSubManager::ItemsResult<QDomElement>> promise;
+};
+
+// PEP node that is published to at most once per interval
+struct DebouncedPepNode
+{
+    int interval = 0;
+    // invalid if nothing has been published yet
+    QElapsedTimer lastPublished;
+    // publishes the latest item, it replaces the ones published before
+    std::function<QXmppTask<QXmppPubSubManager::PublishItemResult>()> pending;
+    // of all items replaced by the pending one
+    std::vector<QXmppPromise<QXmppPubSubManager::PublishItemResult>> promises;
+    QTimer *timer = nullptr;
+};
+
+class QXmppPubSubManagerPrivate
+{
+public:
+    using Key = std::pair<QString, QString>;
+
+    CachedPubSubNode *find(const QString &service, const QString &node);
+    QHash<QString, CachedPubSubItem>::iterator eraseItem(CachedPubSubNode &node, QHash<QString, CachedPubSubItem>::iterator item);
+    bool insertItem(const QString &service, const QString &node, const QDomElement &item);
+    void removeItem(const QString &service, const QString &node, const QString &id);
+    void removeNode(const QString &service, const QString &node);
+    void handleEvent(const QString &service, const QDomElement &event);
+    void shrink(qint64 maximumSize);
+
+    qint64 limit = 0;
+    qint64 size = 0;
+    quint64 useCounter = 0;
+    QHash<Key, CachedPubSubNode> nodes;
+
+    // batched requests
+    int maximumConcurrentRequests = 10;
+    int runningRequests = 0;
+    std::deque<QueuedPubSubItemsRequest> requestQueue;
+
+    QHash<QString, DebouncedPepNode> debouncedPepNodes;
+};
+
+// retries of throttled batch requests, the delay is doubled each time
+constexpr int MaximumRequestAttempts = 4;
+constexpr int RetryDelay = 1000;
+
+static bool isThrottlingError(const QXmppError &error)
+{
+    if (const auto stanzaError = error.value<QXmppStanza::Error>()) {
+        return stanzaError->type() == QXmppStanza::Error::Wait ||
+            stanzaError->condition() == QXmppStanza::Error::ResourceConstraint;
+    }
+    return false;
+}
+
+static QByteArray serializeItem(const QDomElement &item)
+{
+    QByteArray data;
+    QTextStream stream(&data);
+    item.save(stream, 0);
+    stream.flush();
+    return data;
+}
+
+// Item type for PubSubIq that keeps the whole element, so it can be cached
+// independently of the type the items are requested with.
+struct PubSubElementItem
+{
+    void parse(const QDomElement &item) { element = item; }
+    void toXml(QXmlStreamWriter *) const { }
+    static bool isItem(const QDomElement &) { return true; }
+
+    QDomElement element;
+};
+
+static QDomElement parseItem(const QByteArray &data)
+{
+    QDomDocument document;
+    document.setContent(data, true);
+    return document.documentElement();
+}
+
+// Returns the cached node and marks it as used.
+CachedPubSubNode *QXmppPubSubManagerPrivate::find(const QString &service, const QString &node)
+{
+    const auto itr = nodes.find({ service, node });
+    if (itr == nodes.end()) {
+        return nullptr;
+    }
+    itr->lastUse = ++useCounter;
+    return &itr.value();
+}
+
+QHash<QString, CachedPubSubItem>::iterator QXmppPubSubManagerPrivate::eraseItem(CachedPubSubNode &node, QHash<QString, CachedPubSubItem>::iterator item)
+{
+    node.size -= item->data.size();
+    size -= item->data.size();
+    node.ids.removeOne(item.key());
+    return node.items.erase(item);
+}
+
+// Adds or replaces an item, returns false if it is too large to be cached.
+bool QXmppPubSubManagerPrivate::insertItem(const QString &service, const QString &node, const QDomElement &item)
+{
+    const auto id = item.attribute(QStringLiteral("id"));
+    auto data = serializeItem(item);
+    if (data.size() > limit) {
+        removeItem(service, node, id);
+        return false;
+    }
+
+    auto &cachedNode = nodes[{ service, node }];
+    cachedNode.lastUse = ++useCounter;
+
+    auto &cachedItem = cachedNode.items[id];
+    if (cachedItem.data.isNull()) {
+        // inserted by the lookup
+        cachedNode.ids << id;
+    }
+    const auto delta = qint64(data.size()) - cachedItem.data.size();
+    cachedItem.data = std::move(data);
+    cachedItem.fresh = true;
+    cachedNode.size += delta;
+    size += delta;
+
+    shrink(limit);
+    return nodes.contains({ service, node });
+}
+
+// Forgets an item. The node is not complete anymore, because the service may
+// still have the item.
+void QXmppPubSubManagerPrivate::removeItem(const QString &service, const QString &node, const QString &id)
+{
+    if (auto itr = nodes.find({ service, node }); itr != nodes.end()) {
+        if (const auto item = itr->items.find(id); item != itr->items.end()) {
+            eraseItem(*itr, item);
+        }
+        itr->complete = false;
+    }
+}
+
+void QXmppPubSubManagerPrivate::removeNode(const QString &service, const QString &node)
+{
+    if (const auto itr = nodes.find({ service, node }); itr != nodes.end()) {
+        size -= itr->size;
+        nodes.erase(itr);
+    }
+}
+
+// Applies a notification to the cache.
+void QXmppPubSubManagerPrivate::handleEvent(const QString &service, const QDomElement &event)
+{
+    const auto child = event.firstChildElement();
+    const auto node = child.attribute(QStringLiteral("node"));
+
+    if (child.tagName() == u"items") {
+        for (auto element = child.firstChildElement(); !element.isNull(); element = element.nextSiblingElement()) {
+            const auto id = element.attribute(QStringLiteral("id"));
+            if (element.tagName() == u"retract") {
+                if (auto *cachedNode = find(service, node)) {
+                    if (const auto item = cachedNode->items.find(id); item != cachedNode->items.end()) {
+                        eraseItem(*cachedNode, item);
+                    }
+                }
+            } else if (element.tagName() == u"item") {
+                const auto *cachedNode = find(service, node);
+                // new items may have replaced older ones, e.g. on nodes with a
+                // limited number of items
+                const bool known = cachedNode && cachedNode->items.contains(id);
+                if (element.firstChildElement().isNull()) {
+                    // notification without payload
+                    removeItem(service, node, id);
+                } else if (insertItem(service, node, element) && !known) {
+                    nodes[{ service, node }].complete = false;
+                }
+            }
+        }
+    } else if (child.tagName() == u"purge") {
+        if (auto *cachedNode = find(service, node)) {
+            size -= cachedNode->size;
+            *cachedNode = CachedPubSubNode { {}, {}, true, 0, cachedNode->lastUse };
+        }
+    } else if (child.tagName() == u"delete") {
+        removeNode(service, node);
+    }
+}
+
+// Removes the least recently used nodes until the cache fits into the size.
+void QXmppPubSubManagerPrivate::shrink(qint64 maximumSize)
+{
+    while (size > maximumSize && !nodes.isEmpty()) {
+        auto oldest = nodes.begin();
+        for (auto itr = nodes.begin(); itr != nodes.end(); ++itr) {
+            if (itr->lastUse < oldest->lastUse) {
+                oldest = itr;
+            }
+        }
+        size -= oldest->size;
+        nodes.erase(oldest);
+    }
+}
+
 ///
 /// \class QXmppPubSubEventHandler
 ///
@@ -185,14 +421,133 @@ using namespace QXmpp::Private;
 /// Default constructor.
 ///
 QXmppPubSubManager::QXmppPubSubManager()
+    : d(std::make_unique<QXmppPubSubManagerPrivate>())
 {
 }
 
 ///
 /// Default destructor.
 ///
-QXmppPubSubManager::~QXmppPubSubManager()
+QXmppPubSubManager::~QXmppPubSubManager() = default;
+
+///
+/// Returns the maximum size of the item cache in bytes.
+///
+/// \since QXmpp 1.6
+///
+qint64 QXmppPubSubManager::itemCacheLimit() const
+{
+    return d->limit;
+}
+
+///
+/// Sets the maximum size of the item cache in bytes.
+///
+/// With a positive limit, items requested with requestItem() and
+/// requestItems() (without item IDs) are cached per service and node. The
+/// cache is updated by event notifications, so nodes the client is subscribed
+/// to are answered from the cache without any requests.
+///
+/// After a reconnection without stream resumption, notifications may have
+/// been missed, and cached nodes are only reused after requesting the item
+/// IDs of the node: only items with unknown IDs are requested and items that
+/// have been removed are dropped. Items that have been republished with the
+/// same ID while the client was offline are not requested again, they are
+/// only updated by their next notification.
+///
+/// The least recently used nodes are removed when the cache exceeds the
+/// limit. A limit of zero (the default) disables the cache.
+///
+/// \param bytes
+///
+/// \since QXmpp 1.6
+///
+void QXmppPubSubManager::setItemCacheLimit(qint64 bytes)
+{
+    d->limit = std::max(bytes, qint64(0));
+    d->shrink(d->limit);
+}
+
+///
+/// Returns the maximum count of requests that are sent at the same time by
+/// requestItemsBatch().
+///
+/// \since QXmpp 1.6
+///
+int QXmppPubSubManager::maximumConcurrentRequests() const
 {
+    return d->maximumConcurrentRequests;
+}
+
+///
+/// Sets the maximum count of requests that are sent at the same time by
+/// requestItemsBatch().
+///
+/// The default is 10.
+///
+/// \param maximum maximum count of concurrent requests (at least 1)
+///
+/// \since QXmpp 1.6
+///
+void QXmppPubSubManager::setMaximumConcurrentRequests(int maximum)
+{
+    d->maximumConcurrentRequests = std::max(1, maximum);
+    processItemsRequestQueue();
+}
+
+///
+/// Returns the minimum time in milliseconds between two publications of
+/// publishOwnPepItem() to a PEP node.
+///
+/// \since QXmpp 1.6
+///
+int QXmppPubSubManager::pepPublishInterval(const QString &nodeName) const
+{
+    const auto itr = d->debouncedPepNodes.constFind(nodeName);
+    return itr == d->debouncedPepNodes.constEnd() ? 0 : itr->interval;
+}
+
+///
+/// Sets the minimum time in milliseconds between two publications of
+/// publishOwnPepItem() to a PEP node.
+///
+/// This is meant for nodes that are updated often, e.g. \xep{0080, User
+/// Location} or \xep{0118, User Tune}, as each publication is sent to all
+/// contacts. An item is published right away if the interval has passed since
+/// the last publication. Otherwise, it is published when the interval has
+/// passed, unless it has been replaced by a newer item until then. The tasks
+/// of replaced items finish with the result of the item that has been
+/// published.
+///
+/// The default is 0, which publishes every item right away.
+///
+/// \param nodeName
+/// \param msecs
+///
+/// \since QXmpp 1.6
+///
+void QXmppPubSubManager::setPepPublishInterval(const QString &nodeName, int msecs)
+{
+    if (msecs <= 0) {
+        // a pending item is published right away
+        publishPendingPepItem(nodeName);
+        const auto itr = d->debouncedPepNodes.find(nodeName);
+        if (itr != d->debouncedPepNodes.end()) {
+            delete itr->timer;
+            d->debouncedPepNodes.erase(itr);
+        }
+        return;
+    }
+
+    auto &node = d->debouncedPepNodes[nodeName];
+    node.interval = msecs;
+    if (!node.timer) {
+        node.timer = new QTimer(this);
+        node.timer->setSingleShot(true);
+        connect(node.timer, &QTimer::timeout, this, [this, nodeName] {
+            publishPendingPepItem(nodeName);
+        });
+    }
 }
 
 /// \cond
@@ -211,6 +566,29 @@ QXmppPubSubManager::~QXmppPubSubManager()
 /// \param serviceType type of service to retrieve features for
 ///
 QXmppTask<QXmppPubSubManager::FeaturesResult> QXmppPubSubManager::requestFeatures(const QString &serviceJid, ServiceType serviceType)
+{
+    // use the shared discovery of the server and the own account if possible
+    auto *discoveryManager = client()->findExtension<QXmppDiscoveryManager>();
+    const auto &config = client()->configuration();
+    if (discoveryManager && discoveryManager->isServerDiscoveryEnabled() &&
+        (serviceJid == config.jidBare() || serviceJid == config.domain())) {
+        QXmppPromise<FeaturesResult> promise;
+        discoveryManager->requestServerDiscovery().then(this, [this, promise, serviceJid, serviceType](QXmppDiscoveryManager::ServerDiscovery &&discovery) mutable {
+            const auto &info = serviceJid == client()->configuration().domain() ? discovery.serverInfo : discovery.accountInfo;
+            if (info.type() == QXmppIq::Result) {
+                promise.finish(parseFeatures(info, serviceType));
+                return;
+            }
+            requestFeaturesIq(serviceJid, serviceType).then(this, [promise](FeaturesResult &&result) mutable {
+                promise.finish(std::move(result));
+            });
+        });
+        return promise.task();
+    }
+    return requestFeaturesIq(serviceJid, serviceType);
+}
+
+QXmppTask<QXmppPubSubManager::FeaturesResult> QXmppPubSubManager::requestFeaturesIq(const QString &serviceJid, ServiceType serviceType)
 {
     QXmppDiscoveryIq request;
     request.setType(QXmppIq::Get);
@@ -218,34 +596,39 @@ QXmppTask<QXmppPubSubManager::FeaturesResult> QXmppPubSubManager::requestFeature
     request.setTo(serviceJid);
 
     return chainIq(client()->sendIq(std::move(request)), this, [=](QXmppDiscoveryIq &&iq) -> FeaturesResult {
-        const auto identities = iq.identities();
-
-        const auto isPubSubServiceFound = std::any_of(identities.cbegin(), identities.cend(), [=](const QXmppDiscoveryIq::Identity &identity) {
-            if (identity.category() == QStringLiteral("pubsub")) {
-                const auto identityType = identity.type();
-
-                switch (serviceType) {
-                case PubSubOrPep:
-                    return identityType == QStringLiteral("service") || identityType == QStringLiteral("pep");
-                case PubSub:
-                    return identityType == QStringLiteral("service");
-                case Pep:
-                    return identityType == QStringLiteral("pep");
-                }
+        return parseFeatures(iq, serviceType);
+    });
+}
+
+QXmppPubSubManager::FeaturesResult QXmppPubSubManager::parseFeatures(const QXmppDiscoveryIq &iq, ServiceType serviceType)
+{
+    const auto identities = iq.identities();
+
+    const auto isPubSubServiceFound = std::any_of(identities.cbegin(), identities.cend(), [=](const QXmppDiscoveryIq::Identity &identity) {
+        if (identity.category() == QStringLiteral("pubsub")) {
+            const auto identityType = identity.type();
+
+            switch (serviceType) {
+            case PubSubOrPep:
+                return identityType == QStringLiteral("service") || identityType == QStringLiteral("pep");
+            case PubSub:
+                return identityType == QStringLiteral("service");
+            case Pep:
+                return identityType == QStringLiteral("pep");
             }
-            return false;
-        });
+        }
+        return false;
+    });
 
-        if (isPubSubServiceFound) {
+    if (isPubSubServiceFound) {
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
-            return iq.features();
+        return iq.features();
 #else
-            return iq.features().toVector();
+        return iq.features().toVector();
 #endif
-        }
+    }
 
-        return InvalidServiceType();
-    });
+    return InvalidServiceType();
 }
 /// \endcond
 
@@ -388,6 +771,7 @@ auto QXmppPubSubManager::deleteNode(const QString &jid, const QString &nodeName)
     request.setQueryNode(nodeName);
     request.setTo(jid);
 
+    d->removeNode(jid, nodeName);
     return client()->sendGenericIq(std::move(request));
 }
 
@@ -438,6 +822,7 @@ auto QXmppPubSubManager::retractItem(const QString &jid, const QString &nodeName
     request.setItems({ QXmppPubSubBaseItem(itemId) });
     request.setTo(jid);
 
+    d->removeNode(jid, nodeName);
     return client()->sendGenericIq(std::move(request));
 }
 
@@ -469,6 +854,7 @@ auto QXmppPubSubManager::purgeItems(const QString &jid, const QString &nodeName)
     request.setQueryNode(nodeName);
     request.setTo(jid);
 
+    d->removeNode(jid, nodeName);
     return client()->sendGenericIq(std::move(request));
 }
 
@@ -972,6 +1358,13 @@ QStringList QXmppPubSubManager::discoveryFeatures() const
     };
 }
 
+QVector<QXmppClientExtension::StanzaFilter> QXmppPubSubManager::stanzaFilters() const
+{
+    return {
+        { QStringLiteral("message"), ns_pubsub_event },
+    };
+}
+
 bool QXmppPubSubManager::handleStanza(const QDomElement &element)
 {
     if (element.tagName() != "message") {
@@ -984,6 +1377,10 @@ bool QXmppPubSubManager::handleStanza(const QDomElement &element)
             const auto service = element.attribute("from");
             const auto node = event.firstChildElement().attribute("node");
 
+            if (d->limit > 0) {
+                d->handleEvent(service, event);
+            }
+
             const auto extensions = client()->extensions();
             for (auto *extension : extensions) {
                 if (auto *eventHandler = dynamic_cast<QXmppPubSubEventHandler *>(extension)) {
@@ -997,6 +1394,17 @@ bool QXmppPubSubManager::handleStanza(const QDomElement &element)
     return false;
 }
 
+void QXmppPubSubManager::setClient(QXmppClient *client)
+{
+    if (this->client()) {
+        disconnect(this->client(), &QXmppClient::connected, this, &QXmppPubSubManager::onConnected);
+    }
+
+    QXmppClientExtension::setClient(client);
+
+    connect(client, &QXmppClient::connected, this, &QXmppPubSubManager::onConnected);
+}
+
 PubSubIq<> QXmppPubSubManager::requestItemsIq(const QString &jid, const QString &nodeName, const QStringList &itemIds)
 {
     PubSubIq request;
@@ -1021,6 +1429,9 @@ auto QXmppPubSubManager::publishItem(PubSubIqBase &&request) -> QXmppTask<Publis
     request.setType(QXmppIq::Set);
     request.setQueryType(PubSubIqBase::Publish);
 
+    // the service may have changed the items, so they are requested again
+    d->removeNode(request.to(), request.queryNode());
+
     return chainIq(client()->sendIq(std::move(request)), this,
                    [](const PubSubIq<> &iq) -> PublishItemResult {
                        if (!iq.items().isEmpty()) {
@@ -1036,6 +1447,9 @@ auto QXmppPubSubManager::publishItems(PubSubIqBase &&request) -> QXmppTask<Publi
     request.setType(QXmppIq::Set);
     request.setQueryType(PubSubIqBase::Publish);
 
+    // the service may have changed the items, so they are requested again
+    d->removeNode(request.to(), request.queryNode());
+
     return chainIq(client()->sendIq(std::move(request)), this,
                    [](const PubSubIq<> &iq) -> PublishItemsResult {
                        const auto itemToId = [](const QXmppPubSubBaseItem &item) {
@@ -1048,4 +1462,284 @@ auto QXmppPubSubManager::publishItems(PubSubIqBase &&request) -> QXmppTask<Publi
                        return ids;
                    });
 }
+
+auto QXmppPubSubManager::debouncePepPublish(const QString &nodeName, std::function<QXmppTask<PublishItemResult>()> publish) -> QXmppTask<PublishItemResult>
+{
+    const auto itr = d->debouncedPepNodes.find(nodeName);
+    if (itr == d->debouncedPepNodes.end()) {
+        return publish();
+    }
+
+    auto &node = *itr;
+    if (!node.pending && (!node.lastPublished.isValid() || node.lastPublished.elapsed() >= node.interval)) {
+        node.lastPublished.start();
+        return publish();
+    }
+
+    // only the latest item is published once the interval has passed
+    node.pending = std::move(publish);
+    QXmppPromise<PublishItemResult> promise;
+    auto task = promise.task();
+    node.promises.push_back(std::move(promise));
+    if (!node.timer->isActive()) {
+        node.timer->start(int(std::max<qint64>(node.interval - node.lastPublished.elapsed(), 0)));
+    }
+    return task;
+}
+
+void QXmppPubSubManager::publishPendingPepItem(const QString &nodeName)
+{
+    const auto itr = d->debouncedPepNodes.find(nodeName);
+    if (itr == d->debouncedPepNodes.end() || !itr->pending) {
+        return;
+    }
+
+    itr->timer->stop();
+    itr->lastPublished.start();
+    const auto publish = std::exchange(itr->pending, {});
+    auto promises = std::exchange(itr->promises, {});
+    publish().then(this, [promises = std::move(promises)](PublishItemResult &&result) mutable {
+        for (auto &promise : promises) {
+            promise.finish(PublishItemResult(result));
+        }
+    });
+}
+
+// Returns the item from the cache or requests it.
+auto QXmppPubSubManager::requestCachedItem(const QString &jid, const QString &nodeName, const QString &itemId) -> QXmppTask<ItemResult<QDomElement>>
+{
+    if (const auto *node = d->find(jid, nodeName)) {
+        if (const auto item = node->items.constFind(itemId); item != node->items.constEnd() && item->fresh) {
+            return makeReadyTask<ItemResult<QDomElement>>(parseItem(item->data));
+        }
+    }
+
+    return chain<ItemResult<QDomElement>>(fetchItemsToCache(jid, nodeName, { itemId }), this, [](ItemsResult<QDomElement> &&result) -> ItemResult<QDomElement> {
+        if (auto *error = std::get_if<QXmppError>(&result)) {
+            return std::move(*error);
+        }
+        const auto &items = std::get<Items<QDomElement>>(result).items;
+        if (!items.isEmpty()) {
+            return items.constFirst();
+        }
+        return QXmppError { QStringLiteral("No such item has been found."), {} };
+    });
+}
+
+// Returns all items of the node from the cache, requests the changed items
+// of a known node or requests the whole node.
+auto QXmppPubSubManager::requestCachedItems(const QString &jid, const QString &nodeName) -> QXmppTask<ItemsResult<QDomElement>>
+{
+    const auto *node = d->find(jid, nodeName);
+    if (!node) {
+        return fetchItemsToCache(jid, nodeName, {});
+    }
+
+    if (node->complete && std::all_of(node->items.cbegin(), node->items.cend(), [](const auto &item) { return item.fresh; })) {
+        Items<QDomElement> items;
+        items.items.reserve(node->ids.size());
+        for (const auto &id : node->ids) {
+            items.items.push_back(parseItem(node->items.value(id).data));
+        }
+        return makeReadyTask<ItemsResult<QDomElement>>(std::move(items));
+    }
+
+    // compare the item IDs of the service with the cached ones
+    QXmppPromise<ItemsResult<QDomElement>> promise;
+    auto task = promise.task();
+    requestItemIds(jid, nodeName).then(this, [this, promise, jid, nodeName](ItemIdsResult &&result) mutable {
+        if (auto *error = std::get_if<QXmppError>(&result)) {
+            promise.finish(std::move(*error));
+            return;
+        }
+        const auto ids = std::get<QVector<QString>>(std::move(result));
+        const auto listedIds = QSet<QString>(ids.cbegin(), ids.cend());
+
+        QStringList missingIds;
+        if (auto *node = d->find(jid, nodeName)) {
+            for (auto itr = node->items.begin(); itr != node->items.end();) {
+                if (listedIds.contains(itr.key())) {
+                    itr->fresh = true;
+                    ++itr;
+                } else {
+                    itr = d->eraseItem(*node, itr);
+                }
+            }
+            for (const auto &id : ids) {
+                if (!node->items.contains(id)) {
+                    missingIds << id;
+                }
+            }
+        } else {
+            missingIds = QStringList(ids.cbegin(), ids.cend());
+        }
+
+        // collects the items in the order of the service
+        auto finish = [this, jid, nodeName, ids](QHash<QString, QDomElement> &&fetched) -> Items<QDomElement> {
+            Items<QDomElement> items;
+            items.items.reserve(ids.size());
+            auto *node = d->find(jid, nodeName);
+            bool complete = node != nullptr;
+            for (const auto &id : ids) {
+                const auto cached = node ? node->items.constFind(id) : QHash<QString, CachedPubSubItem>::const_iterator();
+                const bool isCached = node && cached != node->items.constEnd();
+                if (const auto item = fetched.constFind(id); item != fetched.constEnd()) {
+                    items.items.push_back(*item);
+                } else if (isCached) {
+                    items.items.push_back(parseItem(cached->data));
+                }
+                complete = complete && isCached;
+            }
+            if (complete) {
+                node->ids = ids;
+                node->complete = true;
+            }
+            return items;
+        };
+
+        if (missingIds.isEmpty()) {
+            promise.finish(finish({}));
+            return;
+        }
+
+        fetchItemsToCache(jid, nodeName, missingIds).then(this, [promise, finish = std::move(finish)](ItemsResult<QDomElement> &&result) mutable {
+            if (auto *error = std::get_if<QXmppError>(&result)) {
+                promise.finish(std::move(*error));
+                return;
+            }
+            QHash<QString, QDomElement> fetched;
+            for (const auto &item : std::as_const(std::get<Items<QDomElement>>(result).items)) {
+                fetched.insert(item.attribute(QStringLiteral("id")), item);
+            }
+            promise.finish(finish(std::move(fetched)));
+        });
+    });
+    return task;
+}
+
+// Requests the items and adds them to the cache. Without item IDs all items
+// are requested and the node is complete, unless the service has limited the
+// number of returned items.
+auto QXmppPubSubManager::fetchItemsToCache(const QString &jid, const QString &nodeName, const QStringList &itemIds) -> QXmppTask<ItemsResult<QDomElement>>
+{
+    return chainIq(client()->sendIq(requestItemsIq(jid, nodeName, itemIds)), this, [this, jid, nodeName, itemIds](PubSubIq<PubSubElementItem> &&iq) -> ItemsResult<QDomElement> {
+        Items<QDomElement> items;
+        items.continuation = iq.itemsContinuation();
+
+        const auto elements = iq.items();
+        items.items.reserve(elements.size());
+        bool cached = true;
+        for (const auto &item : elements) {
+            items.items.push_back(item.element);
+            cached = d->insertItem(jid, nodeName, item.element) && cached;
+        }
+
+        if (itemIds.isEmpty() && cached && !items.continuation) {
+            auto &node = d->nodes[{ jid, nodeName }];
+            node.ids.clear();
+            for (const auto &item : std::as_const(items.items)) {
+                if (const auto id = item.attribute(QStringLiteral("id")); node.items.contains(id)) {
+                    node.ids << id;
+                }
+            }
+            // items could have been evicted again if the cache is full
+            node.complete = node.ids.size() == items.items.size() && node.items.size() == node.ids.size();
+            node.lastUse = ++d->useCounter;
+        }
+        return items;
+    });
+}
+
+// Requests all items of a node, from the cache if it is enabled.
+auto QXmppPubSubManager::requestElementItems(const QString &jid, const QString &nodeName) -> QXmppTask<ItemsResult<QDomElement>>
+{
+    if (d->limit > 0) {
+        return requestCachedItems(jid, nodeName);
+    }
+    return chainIq(client()->sendIq(requestItemsIq(jid, nodeName, {})), this, [](PubSubIq<PubSubElementItem> &&iq) -> ItemsResult<QDomElement> {
+        Items<QDomElement> items;
+        const auto elements = iq.items();
+        items.items.reserve(elements.size());
+        for (const auto &item : elements) {
+            items.items.push_back(item.element);
+        }
+        items.continuation = iq.itemsContinuation();
+        return items;
+    });
+}
+
+auto QXmppPubSubManager::requestElementItemsBatch(const QVector<std::pair<QString, QString>> &nodes) -> QXmppTask<QVector<ItemsResult<QDomElement>>>
+{
+    if (nodes.isEmpty()) {
+        return makeReadyTask(QVector<ItemsResult<QDomElement>>());
+    }
+
+    struct State
+    {
+        QXmppPromise<QVector<ItemsResult<QDomElement>>> promise;
+        QVector<ItemsResult<QDomElement>> results;
+        int pendingCount = 0;
+    };
+
+    auto state = std::make_shared<State>();
+    state->results.resize(nodes.size());
+    state->pendingCount = int(nodes.size());
+
+    for (int i = 0; i < nodes.size(); i++) {
+        QXmppPromise<ItemsResult<QDomElement>> promise;
+        promise.task().then(this, [state, i](ItemsResult<QDomElement> &&result) {
+            state->results[i] = std::move(result);
+            if (--state->pendingCount == 0) {
+                state->promise.finish(std::move(state->results));
+            }
+        });
+        d->requestQueue.push_back({ nodes.at(i).first, nodes.at(i).second, std::move(promise) });
+    }
+    processItemsRequestQueue();
+
+    return state->promise.task();
+}
+
+// Starts queued requests until the maximum of concurrent requests is reached.
+void QXmppPubSubManager::processItemsRequestQueue()
+{
+    while (d->runningRequests < d->maximumConcurrentRequests && !d->requestQueue.empty()) {
+        auto request = std::move(d->requestQueue.front());
+        d->requestQueue.pop_front();
+
+        d->runningRequests++;
+        runItemsRequest(request.service, request.node, std::move(request.promise), 1);
+    }
+}
+
+// Sends the request, the slot of the request is kept while waiting for a
+// retry, which slows down the whole queue while the server is throttling.
+void QXmppPubSubManager::runItemsRequest(const QString &jid, const QString &nodeName, QXmppPromise<ItemsResult<QDomElement>> promise, int attempt)
+{
+    requestElementItems(jid, nodeName).then(this, [this, jid, nodeName, promise = std::move(promise), attempt](ItemsResult<QDomElement> &&result) mutable {
+        if (const auto *error = std::get_if<QXmppError>(&result);
+            error && isThrottlingError(*error) && attempt < MaximumRequestAttempts) {
+            QTimer::singleShot(RetryDelay << (attempt - 1), this, [this, jid, nodeName, promise = std::move(promise), attempt]() mutable {
+                runItemsRequest(jid, nodeName, std::move(promise), attempt + 1);
+            });
+            return;
+        }
+
+        d->runningRequests--;
+        promise.finish(std::move(result));
+        processItemsRequestQueue();
+    });
+}
+
+void QXmppPubSubManager::onConnected()
+{
+    // notifications may have been missed
+    if (client()->streamManagementState() != QXmppClient::ResumedStream) {
+        for (auto &node : d->nodes) {
+            for (auto &item : node.items) {
+                item.fresh = false;
+            }
+        }
+    }
+}
 /// \endcond
@@ -11,9 +11,15 @@
 #include "QXmppFutureUtils_p.h"
 #include "QXmppMessage.h"
 #include "QXmppPubSubIq_p.h"
+#include "QXmppPubSubLazyItem.h"
 #include "QXmppPubSubPublishOptions.h"
 #include "QXmppResultSet.h"
 
+#include <functional>
+
+#include <QDomElement>
+
+class QXmppPubSubManagerPrivate;
 class QXmppPubSubPublishOptions;
 class QXmppPubSubSubscribeOptions;
 
@@ -71,6 +77,15 @@ public:
     QXmppPubSubManager();
     ~QXmppPubSubManager();
 
+    qint64 itemCacheLimit() const;
+    void setItemCacheLimit(qint64 bytes);
+
+    int maximumConcurrentRequests() const;
+    void setMaximumConcurrentRequests(int maximum);
+
+    int pepPublishInterval(const QString &nodeName) const;
+    void setPepPublishInterval(const QString &nodeName, int msecs);
+
     // Generic PubSub (the PubSub service is the given entity)
     QXmppTask<NodesResult> requestNodes(const QString &jid);
     QXmppTask<Result> createNode(const QString &jid, const QString &nodeName);
@@ -87,6 +102,10 @@ public:
     QXmppTask<ItemsResult<T>> requestItems(const QString &jid, const QString &nodeName);
     template<typename T = QXmppPubSubBaseItem>
     QXmppTask<ItemsResult<T>> requestItems(const QString &jid, const QString &nodeName, const QStringList &itemIds);
+    template<typename T = QXmppPubSubBaseItem>
+    QXmppTask<QVector<ItemsResult<T>>> requestItemsBatch(const QVector<std::pair<QString, QString>> &nodes);
+    template<typename T = QXmppPubSubBaseItem>
+    QXmppTask<ItemsResult<QXmppPubSubLazyItem<T>>> requestLazyItems(const QString &jid, const QString &nodeName);
     template<typename T>
     QXmppTask<PublishItemResult> publishItem(const QString &jid, const QString &nodeName, const T &item);
     template<typename T>
@@ -144,7 +163,11 @@ public:
 
     /// \cond
     QStringList discoveryFeatures() const override;
+    QVector<StanzaFilter> stanzaFilters() const override;
     bool handleStanza(const QDomElement &element) override;
+
+protected:
+    void setClient(QXmppClient *client) override;
     /// \endcond
 
 private:
@@ -154,12 +177,56 @@ private:
 
     QXmppTask<FeaturesResult> requestFeatures(const QString &serviceJid, ServiceType serviceType = PubSubOrPep);
     QXmppTask<FeaturesResult> requestOwnPepFeatures() { return requestFeatures(client()->configuration().jidBare(), Pep); };
+    QXmppTask<FeaturesResult> requestFeaturesIq(const QString &serviceJid, ServiceType serviceType);
+    static FeaturesResult parseFeatures(const QXmppDiscoveryIq &iq, ServiceType serviceType);
 
     QXmppTask<PublishItemResult> publishItem(QXmpp::Private::PubSubIqBase &&iq);
     QXmppTask<PublishItemsResult> publishItems(QXmpp::Private::PubSubIqBase &&iq);
     static QXmpp::Private::PubSubIq<> requestItemsIq(const QString &jid, const QString &nodeName, const QStringList &itemIds);
+
+    // item cache
+    QXmppTask<ItemResult<QDomElement>> requestCachedItem(const QString &jid, const QString &nodeName, const QString &itemId);
+    QXmppTask<ItemsResult<QDomElement>> requestCachedItems(const QString &jid, const QString &nodeName);
+    QXmppTask<ItemsResult<QDomElement>> fetchItemsToCache(const QString &jid, const QString &nodeName, const QStringList &itemIds);
+    void onConnected();
+
+    // batched requests
+    QXmppTask<ItemsResult<QDomElement>> requestElementItems(const QString &jid, const QString &nodeName);
+    QXmppTask<QVector<ItemsResult<QDomElement>>> requestElementItemsBatch(const QVector<std::pair<QString, QString>> &nodes);
+    void processItemsRequestQueue();
+    void runItemsRequest(const QString &jid, const QString &nodeName, QXmppPromise<ItemsResult<QDomElement>> promise, int attempt);
+
+    // debounced PEP publications
+    QXmppTask<PublishItemResult> debouncePepPublish(const QString &nodeName, std::function<QXmppTask<PublishItemResult>()> publish);
+    void publishPendingPepItem(const QString &nodeName);
+
+    std::unique_ptr<QXmppPubSubManagerPrivate> d;
 };
 
+namespace QXmpp::Private {
+
+template<typename T>
+T parsePubSubItem(const QDomElement &element)
+{
+    T item;
+    item.parse(element);
+    return item;
+}
+
+template<typename T>
+QXmppPubSubManager::Items<T> parsePubSubItems(QXmppPubSubManager::Items<QDomElement> &&elements)
+{
+    QXmppPubSubManager::Items<T> items;
+    items.items.reserve(elements.items.size());
+    for (const auto &element : std::as_const(elements.items)) {
+        items.items.push_back(parsePubSubItem<T>(element));
+    }
+    items.continuation = std::move(elements.continuation);
+    return items;
+}
+
+}  // namespace QXmpp::Private
+
 ///
 /// Requests a specific item of an entity's node.
 ///
@@ -175,6 +242,11 @@ QXmppTask<QXmppPubSubManager::ItemResult<T>> QXmppPubSubManager::requestItem(con
                                                                              const QString &itemId)
 {
     using namespace QXmpp::Private;
+    if (itemCacheLimit() > 0) {
+        return chain<ItemResult<T>>(requestCachedItem(jid, nodeName, itemId), this, [](ItemResult<QDomElement> &&result) {
+            return mapSuccess(std::move(result), parsePubSubItem<T>);
+        });
+    }
     return chainIq(client()->sendIq(requestItemsIq(jid, nodeName, { itemId })), this,
                    [](PubSubIq<T> &&iq) -> ItemResult<T> {
                        if (!iq.items().isEmpty()) {
@@ -232,6 +304,11 @@ QXmppTask<QXmppPubSubManager::ItemsResult<T>> QXmppPubSubManager::requestItems(c
                                                                                const QStringList &itemIds)
 {
     using namespace QXmpp::Private;
+    if (itemIds.isEmpty() && itemCacheLimit() > 0) {
+        return chain<ItemsResult<T>>(requestCachedItems(jid, nodeName), this, [](ItemsResult<QDomElement> &&result) {
+            return mapSuccess(std::move(result), parsePubSubItems<T>);
+        });
+    }
     return chainIq(client()->sendIq(requestItemsIq(jid, nodeName, itemIds)), this,
                    [](PubSubIq<T> &&iq) -> ItemsResult<T> {
                        return Items<T> {
@@ -241,6 +318,66 @@ QXmppTask<QXmppPubSubManager::ItemsResult<T>> QXmppPubSubManager::requestItems(c
                    });
 }
 
+///
+/// Requests all items of an entity's node without parsing them.
+///
+/// The items are only parsed into \a T when QXmppPubSubLazyItem::item() is
+/// called, so callers that only need some of the items, e.g. the first one
+/// or those with certain IDs, do not pay for parsing all payloads.
+///
+/// \param jid Jabber ID of the entity hosting the pubsub service. For PEP this
+/// should be an account's bare JID
+/// \param nodeName the name of the node to query
+/// \return
+///
+/// \since QXmpp 1.6
+///
+template<typename T>
+QXmppTask<QXmppPubSubManager::ItemsResult<QXmppPubSubLazyItem<T>>> QXmppPubSubManager::requestLazyItems(const QString &jid, const QString &nodeName)
+{
+    using namespace QXmpp::Private;
+    return chain<ItemsResult<QXmppPubSubLazyItem<T>>>(requestElementItems(jid, nodeName), this, [](ItemsResult<QDomElement> &&result) {
+        return mapSuccess(std::move(result), [](Items<QDomElement> &&elements) {
+            Items<QXmppPubSubLazyItem<T>> items;
+            items.items.reserve(elements.items.size());
+            for (const auto &element : std::as_const(elements.items)) {
+                items.items.push_back(QXmppPubSubLazyItem<T>(element));
+            }
+            items.continuation = std::move(elements.continuation);
+            return items;
+        });
+    });
+}
+
+///
+/// Requests all items of several nodes.
+///
+/// The requests are queued and sent with at most maximumConcurrentRequests()
+/// requests at the same time, shared with all other batches, so many nodes
+/// (e.g. of all contacts) can be requested without flooding the server.
+/// Requests that are rejected with a \c wait or \c resource-constraint
+/// error are repeated a few times with an increasing delay.
+///
+/// \param nodes pairs of the JID of the entity hosting the pubsub service and
+/// the name of the node
+/// \return the results for each node in the order of \a nodes
+///
+/// \since QXmpp 1.6
+///
+template<typename T>
+QXmppTask<QVector<QXmppPubSubManager::ItemsResult<T>>> QXmppPubSubManager::requestItemsBatch(const QVector<std::pair<QString, QString>> &nodes)
+{
+    using namespace QXmpp::Private;
+    return chain<QVector<ItemsResult<T>>>(requestElementItemsBatch(nodes), this, [](QVector<ItemsResult<QDomElement>> &&elementResults) {
+        QVector<ItemsResult<T>> results;
+        results.reserve(elementResults.size());
+        for (auto &result : elementResults) {
+            results.push_back(mapSuccess(std::move(result), parsePubSubItems<T>));
+        }
+        return results;
+    });
+}
+
 ///
 /// Publishs one item to a pubsub node.
 ///
@@ -341,10 +478,15 @@ QXmppTask<QXmppPubSubManager::PublishItemsResult> QXmppPubSubManager::publishIte
 /// \param publishOptions publish-options for fine tuning
 /// \return
 ///
+/// If a publish interval is set for the node, the item may be published later
+/// (see setPepPublishInterval()).
+///
 template<typename T>
 QXmppTask<QXmppPubSubManager::PublishItemResult> QXmppPubSubManager::publishOwnPepItem(const QString &nodeName, const T &item, const QXmppPubSubPublishOptions &publishOptions)
 {
-    return publishItem(client()->configuration().jidBare(), nodeName, item, publishOptions);
+    return debouncePepPublish(nodeName, [this, nodeName, item, publishOptions] {
+        return publishItem(client()->configuration().jidBare(), nodeName, item, publishOptions);
+    });
 }
 
 ///
@@ -354,10 +496,15 @@ QXmppTask<QXmppPubSubManager::PublishItemResult> QXmppPubSubManager::publishOwnP
 /// \param item the item to publish
 /// \return
 ///
+/// If a publish interval is set for the node, the item may be published later
+/// (see setPepPublishInterval()).
+///
 template<typename T>
 QXmppTask<QXmppPubSubManager::PublishItemResult> QXmppPubSubManager::publishOwnPepItem(const QString &nodeName, const T &item)
 {
-    return publishItem(client()->configuration().jidBare(), nodeName, item);
+    return debouncePepPublish(nodeName, [this, nodeName, item] {
+        return publishItem(client()->configuration().jidBare(), nodeName, item);
+    });
 }
 
 ///
@@ -7,12 +7,23 @@
 #include "QXmppRosterManager.h"
 
 #include "QXmppClient.h"
+#include "QXmppConstants_p.h"
 #include "QXmppFutureUtils_p.h"
+#include "QXmppJid.h"
 #include "QXmppPresence.h"
 #include "QXmppRosterIq.h"
+#include "QXmppRosterMemoryStorage.h"
+#include "QXmppStreamFeatures.h"
+#include "QXmppTask.h"
 #include "QXmppUtils.h"
 
+#include <utility>
+
 #include <QDomElement>
+#include <QHash>
+#include <QMetaMethod>
+#include <QSet>
+#include <QTimer>
 
 using namespace QXmpp::Private;
 
@@ -33,6 +44,23 @@ using namespace QXmpp::Private;
 /// \since QXmpp 1.5
 ///
 
+///
+/// \fn QXmppRosterManager::presencesChanged
+///
+/// This signal is emitted once per event loop iteration with all presences
+/// that have changed since the last emission.
+///
+/// The same changes are reported by presenceChanged() one by one. Connecting
+/// to this signal instead allows to update user interfaces only once while a
+/// large number of presences is received, e.g. after logging in.
+///
+/// Changes are only collected while the signal is connected.
+///
+/// \param changes pairs of bare JID and resource, each one only listed once
+///
+/// \since QXmpp 1.6
+///
+
 class QXmppRosterManagerPrivate
 {
 public:
@@ -41,16 +69,26 @@ public:
     void clear();
 
     // map of bareJid and its rosterEntry
-    QMap<QString, QXmppRosterIq::Item> entries;
+    QHash<QString, QXmppRosterIq::Item> entries;
 
     // map of resources of the jid and map of resources and presences
-    QMap<QString, QMap<QString, QXmppPresence>> presences;
+    QHash<QString, QMap<QString, QXmppPresence>> presences;
+
+    // presence changes that have not been reported by presencesChanged() yet
+    QVector<std::pair<QString, QString>> pendingPresenceChanges;
+    QSet<std::pair<QString, QString>> pendingPresenceChangesSet;
+    QTimer *presenceChangesTimer = nullptr;
 
     // flag to store that the roster has been populated
     bool isRosterReceived;
 
     // id of the initial roster request
     QString rosterReqId;
+
+    // XEP-0237: Roster Versioning
+    QXmppRosterMemoryStorage memoryStorage;
+    QXmppRosterStorage *storage = &memoryStorage;
+    bool rosterVersioningSupported = false;
 };
 
 QXmppRosterManagerPrivate::QXmppRosterManagerPrivate()
@@ -62,6 +100,8 @@ void QXmppRosterManagerPrivate::clear()
 {
     entries.clear();
     presences.clear();
+    pendingPresenceChanges.clear();
+    pendingPresenceChangesSet.clear();
     rosterReqId.clear();
     isRosterReceived = false;
 }
@@ -72,6 +112,16 @@ void QXmppRosterManagerPrivate::clear()
 QXmppRosterManager::QXmppRosterManager(QXmppClient *client)
     : d(std::make_unique<QXmppRosterManagerPrivate>())
 {
+    d->presenceChangesTimer = new QTimer(this);
+    d->presenceChangesTimer->setSingleShot(true);
+    d->presenceChangesTimer->setInterval(0);
+    connect(d->presenceChangesTimer, &QTimer::timeout, this, [this]() {
+        d->pendingPresenceChangesSet.clear();
+        if (!d->pendingPresenceChanges.isEmpty()) {
+            Q_EMIT presencesChanged(std::exchange(d->pendingPresenceChanges, {}));
+        }
+    });
+
     connect(client, &QXmppClient::connected,
             this, &QXmppRosterManager::_q_connected);
 
@@ -124,6 +174,46 @@ void QXmppRosterManager::_q_connected()
         // TODO: Request MIX annotations only when the server supports MIX-PAM.
         roster.setMixAnnotate(true);
 
+        if (d->rosterVersioningSupported) {
+            // only request the changes since the stored version
+            d->storage->roster().then(this, [this, roster](QXmppRosterStorage::Roster &&stored) mutable {
+                // an empty version requests the full roster
+                roster.setVersion(stored.version.isNull() ? QStringLiteral("") : stored.version);
+
+                client()->sendIq(std::move(roster)).then(this, [this, storedItems = std::move(stored.items)](QXmppClient::IqResult &&result) {
+                    if (const auto *error = std::get_if<QXmppError>(&result)) {
+                        warning(QStringLiteral("Could not request the roster: ") + error->description);
+                        return;
+                    }
+
+                    const auto element = std::get<QDomElement>(std::move(result));
+                    QXmppRosterIq rosterIq;
+                    rosterIq.parse(element);
+
+                    if (rosterIq.type() == QXmppIq::Error) {
+                        warning(QStringLiteral("Could not request the roster: ") + rosterIq.error().text());
+                        return;
+                    }
+
+                    // an empty result means that the stored roster is up to
+                    // date, changes follow as roster pushes
+                    auto items = storedItems;
+                    if (QXmppRosterIq::isRosterIq(element)) {
+                        items = rosterIq.items();
+                        d->storage->replaceRoster(rosterIq.version(), items);
+                    }
+
+                    d->entries.reserve(items.size());
+                    for (const auto &item : std::as_const(items)) {
+                        d->entries.insert(item.bareJid(), item);
+                    }
+                    d->isRosterReceived = true;
+                    Q_EMIT rosterReceived();
+                });
+            });
+            return;
+        }
+
         d->rosterReqId = roster.id();
         if (client()->isAuthenticated()) {
             client()->sendPacket(roster);
@@ -133,6 +223,9 @@ void QXmppRosterManager::_q_connected()
 
 void QXmppRosterManager::_q_disconnected()
 {
+    // the stream features of the next stream are not known yet
+    d->rosterVersioningSupported = false;
+
     // clear cache if stream cannot be resumed
     if (client()->streamManagementState() == QXmppClient::NoStreamManagement) {
         d->clear();
@@ -140,8 +233,26 @@ void QXmppRosterManager::_q_disconnected()
 }
 
 /// \cond
+QVector<QXmppClientExtension::StanzaFilter> QXmppRosterManager::stanzaFilters() const
+{
+    return {
+        { QStringLiteral("iq"), ns_roster },
+        { QStringLiteral("features"), ns_rosterver },
+    };
+}
+
 bool QXmppRosterManager::handleStanza(const QDomElement &element)
 {
+    if (QXmppStreamFeatures::isStreamFeatures(element)) {
+        QXmppStreamFeatures features;
+        features.parse(element);
+        if (features.rosterVersioningSupported()) {
+            d->rosterVersioningSupported = true;
+        }
+        // the stream still needs to process the features
+        return false;
+    }
+
     if (element.tagName() != "iq" || !QXmppRosterIq::isRosterIq(element)) {
         return false;
     }
@@ -170,6 +281,10 @@ bool QXmppRosterManager::handleStanza(const QDomElement &element)
 
         // store updated entries and notify changes
         const auto items = rosterIq.items();
+        if (d->rosterVersioningSupported) {
+            d->storage->updateItems(rosterIq.version(), items);
+        }
+
         for (const auto &item : items) {
             const QString bareJid = item.bareJid();
             if (item.subscriptionType() == QXmppRosterIq::Item::Remove) {
@@ -192,6 +307,7 @@ bool QXmppRosterManager::handleStanza(const QDomElement &element)
     } break;
     case QXmppIq::Result: {
         const auto items = rosterIq.items();
+        d->entries.reserve(d->entries.size() + items.size());
         for (const auto &item : items) {
             const auto bareJid = item.bareJid();
             d->entries.insert(bareJid, item);
@@ -212,22 +328,37 @@ bool QXmppRosterManager::handleStanza(const QDomElement &element)
 
 void QXmppRosterManager::_q_presenceReceived(const QXmppPresence &presence)
 {
-    const auto jid = presence.from();
-    const auto bareJid = QXmppUtils::jidToBareJid(jid);
-    const auto resource = QXmppUtils::jidToResource(jid);
+    const QXmppJid jid(presence.from());
+    const auto bareJid = jid.toBare().toString();
+    const auto resource = jid.resource().toString();
 
     if (bareJid.isEmpty()) {
         return;
     }
 
+    const auto notifyChange = [this, &bareJid, &resource]() {
+        Q_EMIT presenceChanged(bareJid, resource);
+
+        if (isSignalConnected(QMetaMethod::fromSignal(&QXmppRosterManager::presencesChanged))) {
+            auto change = std::pair { bareJid, resource };
+            if (!d->pendingPresenceChangesSet.contains(change)) {
+                d->pendingPresenceChangesSet.insert(change);
+                d->pendingPresenceChanges.append(std::move(change));
+            }
+            if (!d->presenceChangesTimer->isActive()) {
+                d->presenceChangesTimer->start();
+            }
+        }
+    };
+
     switch (presence.type()) {
     case QXmppPresence::Available:
         d->presences[bareJid][resource] = presence;
-        Q_EMIT presenceChanged(bareJid, resource);
+        notifyChange();
         break;
     case QXmppPresence::Unavailable:
         d->presences[bareJid].remove(resource);
-        Q_EMIT presenceChanged(bareJid, resource);
+        notifyChange();
         break;
     case QXmppPresence::Subscribe:
         if (client()->configuration().autoAcceptSubscriptions()) {
@@ -481,6 +612,8 @@ bool QXmppRosterManager::unsubscribe(const QString &bareJid, const QString &reas
 ///
 /// Function to get all the bareJids present in the roster.
 ///
+/// The JIDs are returned in no particular order.
+///
 /// \return QStringList list of all the bareJids
 ///
 QStringList QXmppRosterManager::getRosterBareJids() const
@@ -498,10 +631,7 @@ QXmppRosterIq::Item QXmppRosterManager::getRosterEntry(
     const QString &bareJid) const
 {
     // will return blank entry if bareJid doesn't exist
-    if (d->entries.contains(bareJid)) {
-        return d->entries.value(bareJid);
-    }
-    return {};
+    return d->entries.value(bareJid);
 }
 
 ///
@@ -512,8 +642,8 @@ QXmppRosterIq::Item QXmppRosterManager::getRosterEntry(
 ///
 QStringList QXmppRosterManager::getResources(const QString &bareJid) const
 {
-    if (d->presences.contains(bareJid)) {
-        return d->presences[bareJid].keys();
+    if (const auto itr = d->presences.constFind(bareJid); itr != d->presences.constEnd()) {
+        return itr->keys();
     }
     return {};
 }
@@ -529,10 +659,7 @@ QStringList QXmppRosterManager::getResources(const QString &bareJid) const
 QMap<QString, QXmppPresence> QXmppRosterManager::getAllPresencesForBareJid(
     const QString &bareJid) const
 {
-    if (d->presences.contains(bareJid)) {
-        return d->presences.value(bareJid);
-    }
-    return {};
+    return d->presences.value(bareJid);
 }
 
 ///
@@ -545,8 +672,10 @@ QMap<QString, QXmppPresence> QXmppRosterManager::getAllPresencesForBareJid(
 QXmppPresence QXmppRosterManager::getPresence(const QString &bareJid,
                                               const QString &resource) const
 {
-    if (d->presences.contains(bareJid) && d->presences[bareJid].contains(resource)) {
-        return d->presences[bareJid][resource];
+    if (const auto itr = d->presences.constFind(bareJid); itr != d->presences.constEnd()) {
+        if (const auto presence = itr->constFind(resource); presence != itr->constEnd()) {
+            return *presence;
+        }
     }
 
     QXmppPresence presence;
@@ -554,6 +683,34 @@ QXmppPresence QXmppRosterManager::getPresence(const QString &bareJid,
     return presence;
 }
 
+///
+/// Returns the storage used for \xep{0237, Roster Versioning}.
+///
+/// By default the roster is stored in the memory, so only reconnects of the
+/// same client can profit from roster versioning.
+///
+/// \since QXmpp 1.6
+///
+QXmppRosterStorage *QXmppRosterManager::rosterStorage() const
+{
+    return d->storage;
+}
+
+///
+/// Sets the storage used for \xep{0237, Roster Versioning}.
+///
+/// A persistent storage allows to receive only the changes of the roster
+/// since the last session. The storage is not owned by the manager.
+///
+/// \param storage storage to use, nullptr resets to the default memory storage
+///
+/// \since QXmpp 1.6
+///
+void QXmppRosterManager::setRosterStorage(QXmppRosterStorage *storage)
+{
+    d->storage = storage ? storage : &d->memoryStorage;
+}
+
 ///
 /// Function to check whether the roster has been received or not.
 ///
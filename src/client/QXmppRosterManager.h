@@ -17,10 +17,12 @@
 #include <QMap>
 #include <QObject>
 #include <QStringList>
+#include <QVector>
 
 template<typename T>
 class QXmppTask;
 class QXmppRosterManagerPrivate;
+class QXmppRosterStorage;
 
 ///
 /// \brief The QXmppRosterManager class provides access to a connected client's
@@ -50,6 +52,10 @@ class QXmppRosterManagerPrivate;
 /// The \c presenceChanged() signal is emitted whenever the presence for a
 /// roster item changes.
 ///
+/// If the server supports \xep{0237, Roster Versioning}, the roster is kept in
+/// the rosterStorage() and on reconnects only the changes since the last
+/// session are transferred.
+///
 /// \ingroup Managers
 ///
 class QXMPP_EXPORT QXmppRosterManager : public QXmppClientExtension
@@ -79,7 +85,11 @@ public:
     QXmppTask<QXmpp::SendResult> subscribeTo(const QString &bareJid, const QString &reason = {});
     QXmppTask<QXmpp::SendResult> unsubscribeFrom(const QString &bareJid, const QString &reason = {});
 
+    QXmppRosterStorage *rosterStorage() const;
+    void setRosterStorage(QXmppRosterStorage *storage);
+
     /// \cond
+    QVector<StanzaFilter> stanzaFilters() const override;
     bool handleStanza(const QDomElement &element) override;
     /// \endcond
 
@@ -106,6 +116,8 @@ Q_SIGNALS:
     /// This signal is emitted when the presence of a particular bareJid and resource changes.
     void presenceChanged(const QString &bareJid, const QString &resource);
 
+    void presencesChanged(const QVector<std::pair<QString, QString>> &changes);
+
     /// This signal is emitted when a contact asks to subscribe to your presence.
     ///
     /// You can either accept the request by calling acceptSubscription() or refuse it
@@ -136,6 +148,8 @@ private Q_SLOTS:
 
 private:
     const std::unique_ptr<QXmppRosterManagerPrivate> d;
+
+    friend class QXmppRosterModel;
 };
 
 #endif  // QXMPPROSTER_H
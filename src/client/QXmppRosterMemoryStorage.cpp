@@ -0,0 +1,81 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppRosterMemoryStorage.h"
+
+#include "QXmppFutureUtils_p.h"
+
+#include <QMap>
+
+using namespace QXmpp::Private;
+
+///
+/// \class QXmppRosterMemoryStorage
+///
+/// \brief The QXmppRosterMemoryStorage class stores the roster of an account
+/// in the memory.
+///
+/// This is the default storage of QXmppRosterManager. The roster survives
+/// reconnects, but is lost when the storage is destroyed.
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+
+class QXmppRosterMemoryStoragePrivate
+{
+public:
+    QString version;
+    QMap<QString, QXmppRosterIq::Item> items;
+};
+
+///
+/// Constructs a roster memory storage.
+///
+QXmppRosterMemoryStorage::QXmppRosterMemoryStorage()
+    : d(new QXmppRosterMemoryStoragePrivate)
+{
+}
+
+QXmppRosterMemoryStorage::~QXmppRosterMemoryStorage() = default;
+
+/// \cond
+QXmppTask<QXmppRosterStorage::Roster> QXmppRosterMemoryStorage::roster()
+{
+    Roster roster;
+    roster.version = d->version;
+    roster.items.reserve(d->items.size());
+    for (const auto &item : std::as_const(d->items)) {
+        roster.items.append(item);
+    }
+    return makeReadyTask(std::move(roster));
+}
+
+QXmppTask<void> QXmppRosterMemoryStorage::replaceRoster(const QString &version, const QList<QXmppRosterIq::Item> &items)
+{
+    d->items.clear();
+    return updateItems(version, items);
+}
+
+QXmppTask<void> QXmppRosterMemoryStorage::updateItems(const QString &version, const QList<QXmppRosterIq::Item> &items)
+{
+    d->version = version;
+    for (const auto &item : items) {
+        if (item.subscriptionType() == QXmppRosterIq::Item::Remove) {
+            d->items.remove(item.bareJid());
+        } else {
+            d->items.insert(item.bareJid(), item);
+        }
+    }
+    return makeReadyTask();
+}
+
+QXmppTask<void> QXmppRosterMemoryStorage::removeAll()
+{
+    d->version.clear();
+    d->items.clear();
+    return makeReadyTask();
+}
+/// \endcond
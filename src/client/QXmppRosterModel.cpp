@@ -0,0 +1,382 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppRosterModel.h"
+
+#include "QXmppClient.h"
+#include "QXmppPresence.h"
+#include "QXmppRosterIq.h"
+#include "QXmppRosterManager.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <QPointer>
+
+namespace {
+
+struct Contact {
+    QString bareJid;
+    QString name;
+    QStringList groups;
+    QXmppRosterIq::Item::SubscriptionType subscriptionType = QXmppRosterIq::Item::NotSet;
+    QXmppPresence presence = QXmppPresence(QXmppPresence::Unavailable);
+    int resourceCount = 0;
+};
+
+// Higher values are more available.
+int availability(QXmppPresence::AvailableStatusType type)
+{
+    switch (type) {
+    case QXmppPresence::Chat:
+        return 5;
+    case QXmppPresence::Online:
+        return 4;
+    case QXmppPresence::Away:
+        return 3;
+    case QXmppPresence::XA:
+        return 2;
+    case QXmppPresence::DND:
+        return 1;
+    case QXmppPresence::Invisible:
+        break;
+    }
+    return 0;
+}
+
+bool isMoreAvailable(const QXmppPresence &presence, const QXmppPresence &other)
+{
+    if (presence.priority() != other.priority()) {
+        return presence.priority() > other.priority();
+    }
+    return availability(presence.availableStatusType()) > availability(other.availableStatusType());
+}
+
+bool isLess(const Contact &contact, const QString &bareJid)
+{
+    return contact.bareJid < bareJid;
+}
+
+}  // namespace
+
+class QXmppRosterModelPrivate
+{
+public:
+    QXmppRosterModelPrivate(QXmppRosterModel *q, QXmppRosterManager *manager)
+        : q(q),
+          manager(manager)
+    {
+    }
+
+    std::vector<Contact>::iterator find(const QString &bareJid);
+    void updateItem(Contact &contact) const;
+    // Returns whether the aggregated presence has changed.
+    bool updatePresence(Contact &contact) const;
+
+    void reset();
+    void addItem(const QString &bareJid);
+    void changeItem(const QString &bareJid);
+    void removeItem(const QString &bareJid);
+    void changePresences(const QVector<std::pair<QString, QString>> &changes);
+
+    QXmppRosterModel *q;
+    QPointer<QXmppRosterManager> manager;
+    // sorted by bare JID
+    std::vector<Contact> contacts;
+};
+
+std::vector<Contact>::iterator QXmppRosterModelPrivate::find(const QString &bareJid)
+{
+    auto itr = std::lower_bound(contacts.begin(), contacts.end(), bareJid, isLess);
+    return itr != contacts.end() && itr->bareJid == bareJid ? itr : contacts.end();
+}
+
+void QXmppRosterModelPrivate::updateItem(Contact &contact) const
+{
+    const auto item = manager->getRosterEntry(contact.bareJid);
+    contact.name = item.name();
+    contact.groups = item.groups().values();
+    contact.groups.sort();
+    contact.subscriptionType = item.subscriptionType();
+}
+
+bool QXmppRosterModelPrivate::updatePresence(Contact &contact) const
+{
+    // the presences are implicitly shared, this doesn't copy them
+    const auto presences = manager->getAllPresencesForBareJid(contact.bareJid);
+
+    auto best = QXmppPresence(QXmppPresence::Unavailable);
+    int resourceCount = 0;
+    for (const auto &presence : presences) {
+        if (presence.type() != QXmppPresence::Available) {
+            continue;
+        }
+        if (resourceCount == 0 || isMoreAvailable(presence, best)) {
+            best = presence;
+        }
+        resourceCount++;
+    }
+
+    const bool changed = resourceCount != contact.resourceCount ||
+        best.type() != contact.presence.type() ||
+        best.availableStatusType() != contact.presence.availableStatusType() ||
+        best.statusText() != contact.presence.statusText() ||
+        best.from() != contact.presence.from() ||
+        best.priority() != contact.presence.priority();
+
+    contact.presence = std::move(best);
+    contact.resourceCount = resourceCount;
+    return changed;
+}
+
+void QXmppRosterModelPrivate::reset()
+{
+    q->beginResetModel();
+
+    contacts.clear();
+    if (manager && manager->isRosterReceived()) {
+        const auto bareJids = manager->getRosterBareJids();
+        contacts.reserve(bareJids.size());
+        for (const auto &bareJid : bareJids) {
+            Contact contact;
+            contact.bareJid = bareJid;
+            updateItem(contact);
+            updatePresence(contact);
+            contacts.push_back(std::move(contact));
+        }
+        std::sort(contacts.begin(), contacts.end(), [](const Contact &a, const Contact &b) {
+            return a.bareJid < b.bareJid;
+        });
+    }
+
+    q->endResetModel();
+}
+
+void QXmppRosterModelPrivate::addItem(const QString &bareJid)
+{
+    const auto itr = std::lower_bound(contacts.begin(), contacts.end(), bareJid, isLess);
+    if (itr != contacts.end() && itr->bareJid == bareJid) {
+        changeItem(bareJid);
+        return;
+    }
+
+    Contact contact;
+    contact.bareJid = bareJid;
+    updateItem(contact);
+    updatePresence(contact);
+
+    const auto row = int(std::distance(contacts.begin(), itr));
+    q->beginInsertRows({}, row, row);
+    contacts.insert(itr, std::move(contact));
+    q->endInsertRows();
+}
+
+void QXmppRosterModelPrivate::changeItem(const QString &bareJid)
+{
+    const auto itr = find(bareJid);
+    if (itr == contacts.end()) {
+        addItem(bareJid);
+        return;
+    }
+
+    updateItem(*itr);
+    const auto index = q->index(int(std::distance(contacts.begin(), itr)));
+    Q_EMIT q->dataChanged(index, index, { Qt::DisplayRole,
+                                          QXmppRosterModel::NameRole,
+                                          QXmppRosterModel::GroupsRole,
+                                          QXmppRosterModel::SubscriptionTypeRole });
+}
+
+void QXmppRosterModelPrivate::removeItem(const QString &bareJid)
+{
+    const auto itr = find(bareJid);
+    if (itr == contacts.end()) {
+        return;
+    }
+
+    const auto row = int(std::distance(contacts.begin(), itr));
+    q->beginRemoveRows({}, row, row);
+    contacts.erase(itr);
+    q->endRemoveRows();
+}
+
+void QXmppRosterModelPrivate::changePresences(const QVector<std::pair<QString, QString>> &changes)
+{
+    // the changes are listed per resource
+    std::vector<int> rows;
+    rows.reserve(changes.size());
+    for (const auto &change : changes) {
+        const auto itr = find(change.first);
+        if (itr != contacts.end()) {
+            rows.push_back(int(std::distance(contacts.begin(), itr)));
+        }
+    }
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    // report adjacent changed rows at once
+    static const QVector<int> roles {
+        QXmppRosterModel::PresenceRole,
+        QXmppRosterModel::AvailableRole,
+        QXmppRosterModel::AvailableStatusTypeRole,
+        QXmppRosterModel::StatusTextRole,
+        QXmppRosterModel::ResourceCountRole,
+    };
+    int first = -1;
+    int last = -1;
+    const auto reportRange = [&]() {
+        if (first >= 0) {
+            Q_EMIT q->dataChanged(q->index(first), q->index(last), roles);
+        }
+    };
+
+    for (const auto row : rows) {
+        if (!updatePresence(contacts[row])) {
+            continue;
+        }
+        if (first >= 0 && row == last + 1) {
+            last = row;
+        } else {
+            reportRange();
+            first = last = row;
+        }
+    }
+    reportRange();
+}
+
+///
+/// \class QXmppRosterModel
+///
+/// \brief The QXmppRosterModel class provides the contacts of the roster with
+/// their presence as a list model.
+///
+/// The contacts are sorted by their bare JID, a QSortFilterProxyModel can be
+/// used to sort them differently. The presence of each contact is the one of
+/// its most available resource, i.e. the one with the highest priority.
+///
+/// The model is updated incrementally: roster pushes insert, change or remove
+/// single rows and presence changes are reported once per event loop iteration
+/// as ranges of changed rows. A row is found by a binary search, so large
+/// rosters don't need to be searched or copied on every change.
+///
+/// \since QXmpp 1.6
+///
+
+///
+/// Constructs a roster model of the given roster manager.
+///
+QXmppRosterModel::QXmppRosterModel(QXmppRosterManager *manager, QObject *parent)
+    : QAbstractListModel(parent),
+      d(std::make_unique<QXmppRosterModelPrivate>(this, manager))
+{
+    Q_ASSERT(manager);
+
+    connect(manager, &QXmppRosterManager::rosterReceived, this, [this] {
+        d->reset();
+    });
+    connect(manager, &QXmppRosterManager::itemAdded, this, [this](const QString &bareJid) {
+        d->addItem(bareJid);
+    });
+    connect(manager, &QXmppRosterManager::itemChanged, this, [this](const QString &bareJid) {
+        d->changeItem(bareJid);
+    });
+    connect(manager, &QXmppRosterManager::itemRemoved, this, [this](const QString &bareJid) {
+        d->removeItem(bareJid);
+    });
+    connect(manager, &QXmppRosterManager::presencesChanged, this, [this](const QVector<std::pair<QString, QString>> &changes) {
+        d->changePresences(changes);
+    });
+
+    // the manager clears the roster without notifications if the stream
+    // can't be resumed
+    const auto resetIfCleared = [this] {
+        if (d->manager && !d->manager->isRosterReceived() && !d->contacts.empty()) {
+            d->reset();
+        }
+    };
+    if (auto *client = manager->client()) {
+        connect(client, &QXmppClient::connected, this, resetIfCleared);
+        connect(client, &QXmppClient::disconnected, this, resetIfCleared);
+    }
+
+    d->reset();
+}
+
+QXmppRosterModel::~QXmppRosterModel() = default;
+
+///
+/// Returns the roster manager of the model.
+///
+QXmppRosterManager *QXmppRosterModel::rosterManager() const
+{
+    return d->manager;
+}
+
+///
+/// Returns the row of the contact with the given bare JID or -1 if the contact
+/// isn't in the roster.
+///
+int QXmppRosterModel::rowOf(const QString &bareJid) const
+{
+    const auto itr = std::lower_bound(d->contacts.cbegin(), d->contacts.cend(), bareJid, isLess);
+    if (itr == d->contacts.cend() || itr->bareJid != bareJid) {
+        return -1;
+    }
+    return int(std::distance(d->contacts.cbegin(), itr));
+}
+
+/// \cond
+int QXmppRosterModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : int(d->contacts.size());
+}
+
+QVariant QXmppRosterModel::data(const QModelIndex &index, int role) const
+{
+    if (!hasIndex(index.row(), index.column(), index.parent())) {
+        return {};
+    }
+
+    const auto &contact = d->contacts[index.row()];
+    switch (role) {
+    case Qt::DisplayRole:
+        return contact.name.isEmpty() ? contact.bareJid : contact.name;
+    case BareJidRole:
+        return contact.bareJid;
+    case NameRole:
+        return contact.name;
+    case GroupsRole:
+        return contact.groups;
+    case SubscriptionTypeRole:
+        return int(contact.subscriptionType);
+    case PresenceRole:
+        return QVariant::fromValue(contact.presence);
+    case AvailableRole:
+        return contact.resourceCount > 0;
+    case AvailableStatusTypeRole:
+        return int(contact.presence.availableStatusType());
+    case StatusTextRole:
+        return contact.presence.statusText();
+    case ResourceCountRole:
+        return contact.resourceCount;
+    default:
+        return {};
+    }
+}
+
+QHash<int, QByteArray> QXmppRosterModel::roleNames() const
+{
+    auto roles = QAbstractListModel::roleNames();
+    roles.insert(BareJidRole, QByteArrayLiteral("bareJid"));
+    roles.insert(NameRole, QByteArrayLiteral("name"));
+    roles.insert(GroupsRole, QByteArrayLiteral("groups"));
+    roles.insert(SubscriptionTypeRole, QByteArrayLiteral("subscriptionType"));
+    roles.insert(PresenceRole, QByteArrayLiteral("presence"));
+    roles.insert(AvailableRole, QByteArrayLiteral("available"));
+    roles.insert(AvailableStatusTypeRole, QByteArrayLiteral("availableStatusType"));
+    roles.insert(StatusTextRole, QByteArrayLiteral("statusText"));
+    roles.insert(ResourceCountRole, QByteArrayLiteral("resourceCount"));
+    return roles;
+}
+/// \endcond
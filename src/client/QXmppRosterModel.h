@@ -0,0 +1,55 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPROSTERMODEL_H
+#define QXMPPROSTERMODEL_H
+
+#include "QXmppGlobal.h"
+
+#include <memory>
+
+#include <QAbstractListModel>
+
+class QXmppRosterManager;
+class QXmppRosterModelPrivate;
+
+class QXMPP_EXPORT QXmppRosterModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    /// Roles of the data of a contact
+    enum Role {
+        BareJidRole = Qt::UserRole + 1,  ///< bare JID as QString
+        NameRole,  ///< name from the roster as QString
+        GroupsRole,  ///< groups from the roster as QStringList, sorted
+        SubscriptionTypeRole,  ///< QXmppRosterIq::Item::SubscriptionType as int
+        PresenceRole,  ///< presence of the most available resource as QXmppPresence
+        AvailableRole,  ///< whether any resource is available as bool
+        AvailableStatusTypeRole,  ///< QXmppPresence::AvailableStatusType of the most available resource as int
+        StatusTextRole,  ///< status text of the most available resource as QString
+        ResourceCountRole,  ///< number of available resources as int
+    };
+    Q_ENUM(Role)
+
+    explicit QXmppRosterModel(QXmppRosterManager *manager, QObject *parent = nullptr);
+    ~QXmppRosterModel() override;
+
+    QXmppRosterManager *rosterManager() const;
+
+    int rowOf(const QString &bareJid) const;
+
+    /// \cond
+    int rowCount(const QModelIndex &parent = {}) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+    /// \endcond
+
+private:
+    const std::unique_ptr<QXmppRosterModelPrivate> d;
+
+    friend class QXmppRosterModelPrivate;
+};
+
+#endif  // QXMPPROSTERMODEL_H
@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+///
+/// \class QXmppRosterStorage
+///
+/// \brief The QXmppRosterStorage class stores the roster of an account for
+/// \xep{0237, Roster Versioning}.
+///
+/// If the server supports roster versioning, QXmppRosterManager sends the
+/// version of the stored roster when requesting it. The server then only sends
+/// the changes since that version as roster pushes instead of the full roster.
+/// Implement this interface to keep the roster in a database across sessions
+/// and pass it to QXmppRosterManager::setRosterStorage().
+///
+/// A storage belongs to one account. Call removeAll() before using it with
+/// another account.
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+
+///
+/// \fn QXmppRosterStorage::roster()
+///
+/// Returns the stored roster and its version.
+///
+/// If no roster has been stored yet, the returned version must be null.
+///
+
+///
+/// \fn QXmppRosterStorage::replaceRoster(const QString &version, const QList<QXmppRosterIq::Item> &items)
+///
+/// Replaces the stored roster with a full roster received from the server.
+///
+/// \param version new roster version
+/// \param items all items of the roster
+///
+
+///
+/// \fn QXmppRosterStorage::updateItems(const QString &version, const QList<QXmppRosterIq::Item> &items)
+///
+/// Applies a roster push to the stored roster.
+///
+/// Items with the subscription type QXmppRosterIq::Item::Remove must be
+/// removed, all other items are added or replace the stored item with the same
+/// bare JID.
+///
+/// \param version new roster version
+/// \param items changed items
+///
+
+///
+/// \fn QXmppRosterStorage::removeAll()
+///
+/// Removes the stored roster and its version.
+///
@@ -0,0 +1,37 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPROSTERSTORAGE_H
+#define QXMPPROSTERSTORAGE_H
+
+#include "QXmppRosterIq.h"
+
+#include <QList>
+
+template<typename T>
+class QXmppTask;
+
+class QXMPP_EXPORT QXmppRosterStorage
+{
+public:
+    ///
+    /// Stored roster with its version
+    ///
+    struct Roster
+    {
+        /// \xep{0237, Roster Versioning} version, null if there is no stored roster
+        QString version;
+        /// roster items
+        QList<QXmppRosterIq::Item> items;
+    };
+
+    virtual ~QXmppRosterStorage() = default;
+
+    virtual QXmppTask<Roster> roster() = 0;
+    virtual QXmppTask<void> replaceRoster(const QString &version, const QList<QXmppRosterIq::Item> &items) = 0;
+    virtual QXmppTask<void> updateItems(const QString &version, const QList<QXmppRosterIq::Item> &items) = 0;
+    virtual QXmppTask<void> removeAll() = 0;
+};
+
+#endif  // QXMPPROSTERSTORAGE_H
@@ -19,6 +19,8 @@
 
 #include "QXmppUtils.h"
 
+#include <optional>
+
 #include <QDateTime>
 #include <QDomElement>
 
@@ -26,32 +28,68 @@ class QXmppSceEnvelopeReader
 {
 public:
     QXmppSceEnvelopeReader(QDomElement &&element)
-        : element(std::move(element))
     {
+        // the affix elements are looked up in one pass over the children
+        for (auto child = element.firstChildElement(); !child.isNull(); child = child.nextSiblingElement()) {
+            const auto tagName = child.tagName();
+            if (tagName == QLatin1String("content")) {
+                setFirst(m_content, child);
+            } else if (tagName == QLatin1String("from")) {
+                setFirst(m_from, child);
+            } else if (tagName == QLatin1String("to")) {
+                setFirst(m_to, child);
+            } else if (tagName == QLatin1String("time")) {
+                setFirst(m_time, child);
+            }
+        }
+    }
+
+    // Parses a serialized envelope, e.g. a decrypted payload. Returns nothing
+    // if it isn't an SCE envelope.
+    static std::optional<QXmppSceEnvelopeReader> fromXml(const QByteArray &xml)
+    {
+        QDomDocument document;
+        if (!document.setContent(xml, true)) {
+            return {};
+        }
+        auto element = document.documentElement();
+        if (element.tagName() != QLatin1String("envelope") || element.namespaceURI() != QLatin1String("urn:xmpp:sce:1")) {
+            return {};
+        }
+        return QXmppSceEnvelopeReader(std::move(element));
     }
 
-    inline QDomElement contentElement()
+    inline QDomElement contentElement() const
     {
-        return element.firstChildElement(QStringLiteral("content"));
+        return m_content;
     }
-    inline QString from()
+    inline QString from() const
     {
-        return element.firstChildElement(QStringLiteral("from")).attribute(QStringLiteral("jid"));
+        return m_from.attribute(QStringLiteral("jid"));
     }
-    inline QString to()
+    inline QString to() const
     {
-        return element.firstChildElement(QStringLiteral("to")).attribute(QStringLiteral("jid"));
+        return m_to.attribute(QStringLiteral("jid"));
     }
-    inline QDateTime timestamp()
+    inline QDateTime timestamp() const
     {
-        return QXmppUtils::datetimeFromString(
-            element.firstChildElement(QStringLiteral("time")).attribute(QStringLiteral("stamp")));
+        return QXmppUtils::datetimeFromString(m_time.attribute(QStringLiteral("stamp")));
     }
 
     // rpad is usually not needed (but can be parsed manually if really needed)
 
 private:
-    QDomElement element;
+    static void setFirst(QDomElement &affix, const QDomElement &element)
+    {
+        if (affix.isNull()) {
+            affix = element;
+        }
+    }
+
+    QDomElement m_content;
+    QDomElement m_from;
+    QDomElement m_to;
+    QDomElement m_time;
 };
 
 class QXmppSceEnvelopeWriter
@@ -21,6 +21,7 @@ class QXmppSendStanzaParamsPrivate : public QSharedData
 public:
     TrustLevels acceptedTrustLevels;
     QVector<QString> encryptionJids;
+    bool deferrable = false;
 };
 
 QXmppSendStanzaParams::QXmppSendStanzaParams()
@@ -86,3 +87,32 @@ void QXmppSendStanzaParams::setAcceptedTrustLevels(std::optional<TrustLevels> tr
 {
     d->acceptedTrustLevels = trustLevels.value_or(QXmpp::TrustLevels());
 }
+
+///
+/// Returns whether the stanza may be sent later while the client is inactive.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppSendStanzaParams::isDeferrable() const
+{
+    return d->deferrable;
+}
+
+///
+/// Sets whether the stanza may be sent later while the client is inactive.
+///
+/// Deferrable stanzas sent while the client is inactive (\xep{0352, Client
+/// State Indication}) are queued and sent together when the client becomes
+/// active again. Of several queued presences to the same recipient only the
+/// last one is sent. This is meant for stanzas that are not urgent, e.g. chat
+/// states or presence updates, so the device's radio does not need to wake up
+/// for them.
+///
+/// The default is false.
+///
+/// \since QXmpp 1.6
+///
+void QXmppSendStanzaParams::setDeferrable(bool deferrable)
+{
+    d->deferrable = deferrable;
+}
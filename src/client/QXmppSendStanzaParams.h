@@ -30,6 +30,9 @@ public:
     std::optional<QXmpp::TrustLevels> acceptedTrustLevels() const;
     void setAcceptedTrustLevels(std::optional<QXmpp::TrustLevels> trustLevels);
 
+    bool isDeferrable() const;
+    void setDeferrable(bool deferrable);
+
 private:
     QSharedDataPointer<QXmppSendStanzaParamsPrivate> d;
 };
@@ -50,6 +50,7 @@ bool QXmppTlsManager::handleStanza(const QDomElement &stanza)
 
     if (QXmppStartTlsPacket::isStartTlsPacket(stanza, QXmppStartTlsPacket::Proceed)) {
         debug("Starting encryption");
+        clientStream()->flushData();
         clientStream()->socket()->startClientEncryption();
         return true;
     }
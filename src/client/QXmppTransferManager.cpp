@@ -7,12 +7,20 @@
 #include "QXmppByteStreamIq.h"
 #include "QXmppClient.h"
 #include "QXmppConstants_p.h"
+#include "QXmppDatagramChannel_p.h"
+#include "QXmppFileMetadata.h"
+#include "QXmppHash.h"
 #include "QXmppIbbIq.h"
+#include "QXmppMetrics.h"
 #include "QXmppSocks.h"
 #include "QXmppStreamInitiationIq_p.h"
 #include "QXmppStun.h"
 #include "QXmppTransferManager_p.h"
 #include "QXmppUtils.h"
+#include "QXmppUtils_p.h"
+
+#include <algorithm>
+#include <utility>
 
 #include <QCryptographicHash>
 #include <QDomElement>
@@ -23,12 +31,27 @@
 #include <QHostAddress>
 #include <QMetaMethod>
 #include <QNetworkInterface>
+#include <QSet>
 #include <QTime>
 #include <QTimer>
 #include <QUrl>
 
 // time to try to connect to a SOCKS host (7 seconds)
 const int socksTimeout = 7000;
+// number of SOCKS hosts connected to at the same time
+const int socksRaceCount = 3;
+// time a ready proxy waits for direct connections still in progress
+const int socksDirectGracePeriod = 250;
+// IBB block size recommended by XEP-0047
+const int defaultIbbBlockSize = 4096;
+// maximum IBB block size allowed by XEP-0047
+const int maximumIbbBlockSize = 65535;
+// ICE component carrying the data of Jingle file transfers
+const int jingleComponent = 1;
+// number of bytes queued in the datagram channel while sending via Jingle
+const qint64 jingleWriteBufferSize = 1024 * 1024;
+// time the sender waits for the receiver to end a Jingle session (5 seconds)
+const int jingleTerminateTimeout = 5000;
 
 static QString streamHash(const QString &sid, const QString &initiatorJid, const QString &targetJid)
 {
@@ -206,6 +229,8 @@ public:
 
     int blockSize;
     QXmppClient *client;
+    // set while the job is registered with a manager
+    QXmppTransferManagerPrivate *manager;
     QXmppTransferJob::Direction direction;
     qint64 done;
     QXmppTransferJob::Error error;
@@ -220,22 +245,75 @@ public:
     QString requestId;
     QXmppTransferJob::State state;
     QElapsedTimer transferStart;
+    QXmpp::Private::ProgressThrottle progressThrottle;
     bool deviceIsOwn;
 
     // file meta-data
     QXmppTransferFileInfo fileInfo;
 
     // for in-band bytestreams
-    int ibbSequence;
+    quint16 ibbSequence;
+    // IDs of the data IQs that have not been acknowledged yet
+    QSet<QString> ibbPendingIds;
 
     // for socks5 bytestreams
     QTcpSocket *socksSocket;
     QXmppByteStreamIq::StreamHost socksProxy;
+    // number of bytes kept in the socket's write buffer while sending
+    qint64 socksWriteBufferSize;
+    // reused for reading blocks from the device
+    QByteArray sendBuffer;
+    // memory mapping of a local file being sent
+    QFile *mappedFile;
+    uchar *mappedData;
+};
+
+class QXmppTransferManagerPrivate
+{
+public:
+    QXmppTransferManagerPrivate();
+
+    QXmppTransferIncomingJob *getIncomingJobByRequestId(const QString &jid, const QString &id);
+    QXmppTransferIncomingJob *getIncomingJobBySid(const QString &jid, const QString &sid);
+    QXmppTransferOutgoingJob *getOutgoingJobByRequestId(const QString &jid, const QString &id);
+    QXmppTransferJob *getJobByRequestId(const QString &id) const;
+
+    void addJob(QXmppTransferJob *job);
+    void removeJob(QXmppTransferJob *job);
+    void setupIceConnection(QXmppTransferJingleJob *job, bool controlling);
+    void setRequestId(QXmppTransferJob *job, const QString &id);
+
+    int ibbBlockSize;
+    int ibbWindowSize;
+    QList<QXmppTransferJob *> jobs;
+    // indexes for looking up the jobs of received IQs, e.g. for each IBB block
+    QHash<QPair<QString, QString>, QXmppTransferIncomingJob *> incomingJobsBySid;
+    QHash<QPair<QString, QString>, QXmppTransferJingleJob *> jingleJobsBySid;
+    QHash<QString, QXmppTransferJob *> jobsByRequestId;
+    QString proxy;
+    bool proxyOnly;
+    QXmppSocksServer *socksServer;
+    qint64 socksWriteBufferSize;
+    // smoothed time in milliseconds it took to connect to SOCKS hosts, by
+    // host and port
+    QHash<QString, qint64> socksConnectTimes;
+    QXmppTransferJob::Methods supportedMethods;
+
+    // ICE settings for Jingle file transfers
+    QList<QPair<QHostAddress, quint16>> stunServers;
+    QHostAddress turnHost;
+    quint16 turnPort;
+    QString turnUser;
+    QString turnPassword;
+
+private:
+    QXmppTransferJob *getJobByRequestId(QXmppTransferJob::Direction direction, const QString &jid, const QString &id);
 };
 
 QXmppTransferJobPrivate::QXmppTransferJobPrivate()
     : blockSize(16384),
       client(nullptr),
+      manager(nullptr),
       direction(QXmppTransferJob::IncomingDirection),
       done(0),
       error(QXmppTransferJob::NoError),
@@ -245,7 +323,10 @@ QXmppTransferJobPrivate::QXmppTransferJobPrivate()
       state(QXmppTransferJob::OfferState),
       deviceIsOwn(false),
       ibbSequence(0),
-      socksSocket(nullptr)
+      socksSocket(nullptr),
+      socksWriteBufferSize(65536),
+      mappedFile(nullptr),
+      mappedData(nullptr)
 {
 }
 
@@ -400,6 +481,60 @@ qint64 QXmppTransferJob::speed() const
     return (d->done * 1000.0) / elapsed;
 }
 
+///
+/// Returns the fraction of the file size by which the transfer needs to
+/// advance before progress() is emitted again.
+///
+/// \since QXmpp 1.6
+///
+float QXmppTransferJob::progressGranularity() const
+{
+    return d->progressThrottle.granularity();
+}
+
+///
+/// Sets the fraction of the file size by which the transfer needs to advance
+/// before progress() is emitted again, e.g. 0.01 for every percent.
+///
+/// The default is 0, which reports every block. The first block and the end
+/// of the transfer are always reported.
+///
+/// \since QXmpp 1.6
+///
+void QXmppTransferJob::setProgressGranularity(float granularity)
+{
+    d->progressThrottle.setGranularity(granularity);
+}
+
+///
+/// Returns the minimum time in milliseconds between two emissions of
+/// progress().
+///
+/// \since QXmpp 1.6
+///
+int QXmppTransferJob::progressInterval() const
+{
+    return d->progressThrottle.interval();
+}
+
+///
+/// Sets the minimum time in milliseconds between two emissions of
+/// progress(). The default is 0, which does not limit the rate.
+///
+/// \since QXmpp 1.6
+///
+void QXmppTransferJob::setProgressInterval(int msecs)
+{
+    d->progressThrottle.setInterval(msecs);
+}
+
+void QXmppTransferJob::reportProgress()
+{
+    if (d->progressThrottle.shouldReport(d->done, d->fileInfo.size())) {
+        Q_EMIT progress(d->done, d->fileInfo.size());
+    }
+}
+
 QXmppTransferJob::State QXmppTransferJob::state() const
 {
     return d->state;
@@ -435,6 +570,13 @@ void QXmppTransferJob::terminate(QXmppTransferJob::Error cause)
     d->error = cause;
     d->state = FinishedState;
 
+    // release memory mapping
+    if (d->mappedData) {
+        d->mappedFile->unmap(d->mappedData);
+        d->mappedFile = nullptr;
+        d->mappedData = nullptr;
+    }
+
     // close IO device
     if (d->iodevice && d->deviceIsOwn) {
         d->iodevice->close();
@@ -450,15 +592,9 @@ void QXmppTransferJob::terminate(QXmppTransferJob::Error cause)
     QMetaObject::invokeMethod(this, "_q_terminated", Qt::QueuedConnection);
 }
 
-/// \cond
-QXmppTransferIncomingJob::QXmppTransferIncomingJob(const QString &jid, QXmppClient *client, QObject *parent)
-    : QXmppTransferJob(jid, IncomingDirection, client, parent),
-      m_candidateClient(nullptr),
-      m_candidateTimer(nullptr)
-{
-}
-
-void QXmppTransferIncomingJob::checkData()
+// Terminates an incoming job after checking the size and hash of the received
+// data.
+void QXmppTransferJob::checkData()
 {
     if ((d->fileInfo.size() && d->done != d->fileInfo.size()) ||
         (!d->fileInfo.hash().isEmpty() && d->hash.result() != d->fileInfo.hash())) {
@@ -468,9 +604,59 @@ void QXmppTransferIncomingJob::checkData()
     }
 }
 
-void QXmppTransferIncomingJob::connectToNextHost()
+/// \cond
+QXmppTransferIncomingJob::QXmppTransferIncomingJob(const QString &jid, QXmppClient *client, QObject *parent)
+    : QXmppTransferJob(jid, IncomingDirection, client, parent),
+      m_graceTimer(nullptr)
+{
+}
+
+static QString socksHostKey(const QXmppByteStreamIq::StreamHost &host)
 {
-    if (m_streamCandidates.isEmpty()) {
+    return host.host() + u':' + QString::number(host.port());
+}
+
+void QXmppTransferIncomingJob::connectToNextHosts()
+{
+    const QString hostName = streamHash(d->sid,
+                                        d->jid,
+                                        d->client->configuration().jid());
+
+    // race connections to the best stream hosts
+    while (m_candidates.size() < socksRaceCount && !m_streamCandidates.isEmpty()) {
+        Candidate candidate;
+        candidate.host = m_streamCandidates.takeFirst();
+        candidate.direct = candidate.host.jid() == d->jid;
+        candidate.client = new QXmppSocksClient(candidate.host.host(), candidate.host.port(), this);
+        candidate.connectTime.start();
+        info(QString("Connecting to streamhost: %1 (%2 %3)").arg(candidate.host.jid(), candidate.host.host(), QString::number(candidate.host.port())));
+
+        auto *client = candidate.client;
+        connect(client, &QAbstractSocket::disconnected, this, [this, client] {
+            candidateFailed(client);
+        });
+        connect(client, &QXmppSocksClient::ready, this, [this, client] {
+            candidateReady(client);
+        });
+        QTimer::singleShot(socksTimeout, client, [this, client] {
+            // a ready proxy is only waiting for the grace period
+            if (m_readyCandidate.client != client) {
+                candidateFailed(client);
+            }
+        });
+
+        m_candidates << candidate;
+        client->connectToHost(hostName, 0);
+    }
+
+    // use a ready proxy once no direct connection is in progress
+    if (m_readyCandidate.client &&
+        std::none_of(m_candidates.cbegin(), m_candidates.cend(), [](const Candidate &candidate) { return candidate.direct; })) {
+        useCandidate(std::exchange(m_readyCandidate, {}));
+        return;
+    }
+
+    if (m_candidates.isEmpty() && !m_readyCandidate.client) {
         // could not connect to any stream host
         QXmppByteStreamIq response;
         response.setId(m_streamOfferId);
@@ -482,31 +668,7 @@ void QXmppTransferIncomingJob::connectToNextHost()
         d->client->sendPacket(response);
 
         terminate(QXmppTransferJob::ProtocolError);
-        return;
     }
-
-    // try next host
-    m_candidateHost = m_streamCandidates.takeFirst();
-    info(QString("Connecting to streamhost: %1 (%2 %3)").arg(m_candidateHost.jid(), m_candidateHost.host(), QString::number(m_candidateHost.port())));
-
-    const QString hostName = streamHash(d->sid,
-                                        d->jid,
-                                        d->client->configuration().jid());
-
-    // try to connect to stream host
-    m_candidateClient = new QXmppSocksClient(m_candidateHost.host(), m_candidateHost.port(), this);
-    m_candidateTimer = new QTimer(this);
-
-    connect(m_candidateClient, &QAbstractSocket::disconnected,
-            this, &QXmppTransferIncomingJob::_q_candidateDisconnected);
-    connect(m_candidateClient, &QXmppSocksClient::ready,
-            this, &QXmppTransferIncomingJob::_q_candidateReady);
-    connect(m_candidateTimer, &QTimer::timeout,
-            this, &QXmppTransferIncomingJob::_q_candidateDisconnected);
-
-    m_candidateTimer->setSingleShot(true);
-    m_candidateTimer->start(socksTimeout);
-    m_candidateClient->connectToHost(hostName, 0);
 }
 
 void QXmppTransferIncomingJob::connectToHosts(const QXmppByteStreamIq &iq)
@@ -515,7 +677,20 @@ void QXmppTransferIncomingJob::connectToHosts(const QXmppByteStreamIq &iq)
     m_streamOfferId = iq.id();
     m_streamOfferFrom = iq.from();
 
-    connectToNextHost();
+    // Rank the hosts by the time it took to connect to them before. Direct
+    // connections are preferred, proxies are penalized by the time direct
+    // connections are waited for.
+    QHash<QString, qint64> ranks;
+    for (const auto &host : std::as_const(m_streamCandidates)) {
+        const bool direct = host.jid() == d->jid;
+        const auto connectTime = d->manager ? d->manager->socksConnectTimes.value(socksHostKey(host), -1) : -1;
+        ranks.insert(socksHostKey(host), (connectTime < 0 ? (direct ? 0 : socksDirectGracePeriod) : connectTime) + (direct ? 0 : socksDirectGracePeriod));
+    }
+    std::stable_sort(m_streamCandidates.begin(), m_streamCandidates.end(), [&](const auto &a, const auto &b) {
+        return ranks.value(socksHostKey(a)) < ranks.value(socksHostKey(b));
+    });
+
+    connectToNextHosts();
 }
 
 bool QXmppTransferIncomingJob::writeData(const QByteArray &data)
@@ -528,23 +703,102 @@ bool QXmppTransferIncomingJob::writeData(const QByteArray &data)
     if (!d->fileInfo.hash().isEmpty()) {
         d->hash.addData(data);
     }
-    Q_EMIT progress(d->done, d->fileInfo.size());
+    reportProgress();
     return true;
 }
 
-void QXmppTransferIncomingJob::_q_candidateReady()
+void QXmppTransferIncomingJob::candidateReady(QXmppSocksClient *client)
 {
-    if (!m_candidateClient) {
+    const auto itr = std::find_if(m_candidates.begin(), m_candidates.end(), [client](const Candidate &candidate) {
+        return candidate.client == client;
+    });
+    if (itr == m_candidates.end()) {
+        return;
+    }
+    const Candidate candidate = *itr;
+    m_candidates.erase(itr);
+
+    info(QString("Connected to streamhost: %1 (%2 %3)").arg(candidate.host.jid(), candidate.host.host(), QString::number(candidate.host.port())));
+    recordConnectTime(candidate.host, candidate.connectTime.elapsed());
+
+    if (candidate.direct) {
+        useCandidate(candidate);
         return;
     }
 
-    info(QString("Connected to streamhost: %1 (%2 %3)").arg(m_candidateHost.jid(), m_candidateHost.host(), QString::number(m_candidateHost.port())));
+    if (m_readyCandidate.client) {
+        // another proxy has been faster
+        client->disconnect(this);
+        client->abort();
+        client->deleteLater();
+        return;
+    }
+
+    m_readyCandidate = candidate;
+    if (!m_graceTimer) {
+        m_graceTimer = new QTimer(this);
+        m_graceTimer->setSingleShot(true);
+        connect(m_graceTimer, &QTimer::timeout, this, [this] {
+            if (m_readyCandidate.client) {
+                useCandidate(std::exchange(m_readyCandidate, {}));
+            }
+        });
+    }
+    m_graceTimer->start(socksDirectGracePeriod);
+    connectToNextHosts();
+}
+
+void QXmppTransferIncomingJob::candidateFailed(QXmppSocksClient *client)
+{
+    Candidate candidate;
+    if (m_readyCandidate.client == client) {
+        candidate = std::exchange(m_readyCandidate, {});
+    } else {
+        const auto itr = std::find_if(m_candidates.begin(), m_candidates.end(), [client](const Candidate &candidate) {
+            return candidate.client == client;
+        });
+        if (itr == m_candidates.end()) {
+            return;
+        }
+        candidate = *itr;
+        m_candidates.erase(itr);
+
+        // failed hosts are tried last next time
+        recordConnectTime(candidate.host, socksTimeout);
+    }
+
+    warning(QString("Failed to connect to streamhost: %1 (%2 %3)").arg(candidate.host.jid(), candidate.host.host(), QString::number(candidate.host.port())));
+
+    client->disconnect(this);
+    client->deleteLater();
+
+    // try next host
+    connectToNextHosts();
+}
+
+void QXmppTransferIncomingJob::useCandidate(Candidate candidate)
+{
+    // stop the other connections
+    for (const auto &other : std::as_const(m_candidates)) {
+        other.client->disconnect(this);
+        other.client->abort();
+        other.client->deleteLater();
+    }
+    m_candidates.clear();
+    m_streamCandidates.clear();
+    if (m_readyCandidate.client) {
+        m_readyCandidate.client->disconnect(this);
+        m_readyCandidate.client->abort();
+        m_readyCandidate.client->deleteLater();
+        m_readyCandidate = {};
+    }
+    if (m_graceTimer) {
+        m_graceTimer->stop();
+    }
 
     setState(QXmppTransferJob::TransferState);
-    d->socksSocket = m_candidateClient;
-    m_candidateClient = nullptr;
-    m_candidateTimer->deleteLater();
-    m_candidateTimer = nullptr;
+    candidate.client->disconnect(this);
+    d->socksSocket = candidate.client;
 
     connect(d->socksSocket, &QIODevice::readyRead, this, &QXmppTransferIncomingJob::_q_receiveData);
     connect(d->socksSocket, &QAbstractSocket::disconnected, this, &QXmppTransferIncomingJob::_q_disconnected);
@@ -554,25 +808,17 @@ void QXmppTransferIncomingJob::_q_candidateReady()
     ackIq.setTo(m_streamOfferFrom);
     ackIq.setType(QXmppIq::Result);
     ackIq.setSid(d->sid);
-    ackIq.setStreamHostUsed(m_candidateHost.jid());
+    ackIq.setStreamHostUsed(candidate.host.jid());
     d->client->sendPacket(ackIq);
 }
 
-void QXmppTransferIncomingJob::_q_candidateDisconnected()
+void QXmppTransferIncomingJob::recordConnectTime(const QXmppByteStreamIq::StreamHost &host, qint64 msecs)
 {
-    if (!m_candidateClient) {
+    if (!d->manager) {
         return;
     }
-
-    warning(QString("Failed to connect to streamhost: %1 (%2 %3)").arg(m_candidateHost.jid(), m_candidateHost.host(), QString::number(m_candidateHost.port())));
-
-    m_candidateClient->deleteLater();
-    m_candidateClient = nullptr;
-    m_candidateTimer->deleteLater();
-    m_candidateTimer = nullptr;
-
-    // try next host
-    connectToNextHost();
+    auto &connectTime = d->manager->socksConnectTimes[socksHostKey(host)];
+    connectTime = connectTime ? (3 * connectTime + msecs) / 4 : std::max<qint64>(msecs, 1);
 }
 
 void QXmppTransferIncomingJob::_q_disconnected()
@@ -627,6 +873,15 @@ void QXmppTransferOutgoingJob::startSending()
 {
     setState(QXmppTransferJob::TransferState);
 
+    // local files are written to the socket straight from a memory mapping
+    auto *file = qobject_cast<QFile *>(d->iodevice);
+    if (file && d->fileInfo.size() > 0 && file->size() - file->pos() >= d->fileInfo.size()) {
+        d->mappedData = file->map(file->pos(), d->fileInfo.size());
+        if (d->mappedData) {
+            d->mappedFile = file;
+        }
+    }
+
     connect(d->socksSocket, &QIODevice::bytesWritten, this, &QXmppTransferOutgoingJob::_q_sendData);
     connect(d->iodevice, &QIODevice::readyRead, this, &QXmppTransferOutgoingJob::_q_sendData);
 
@@ -655,7 +910,9 @@ void QXmppTransferOutgoingJob::_q_proxyReady()
     streamIq.setTo(d->socksProxy.jid());
     streamIq.setSid(d->sid);
     streamIq.setActivate(d->jid);
-    d->requestId = streamIq.id();
+    if (d->manager) {
+        d->manager->setRequestId(this, streamIq.id());
+    }
     d->client->sendPacket(streamIq);
 }
 
@@ -665,74 +922,440 @@ void QXmppTransferOutgoingJob::_q_sendData()
         return;
     }
 
-    // don't saturate the outgoing socket
-    if (d->socksSocket->bytesToWrite() > 2 * d->blockSize) {
-        return;
+    // fill the socket's write buffer up to the high-water mark, but don't
+    // saturate it
+    while (d->socksSocket->bytesToWrite() < d->socksWriteBufferSize) {
+        // check whether we have written the whole file
+        if (d->fileInfo.size() && d->done >= d->fileInfo.size()) {
+            if (!d->socksSocket->bytesToWrite()) {
+                terminate(QXmppTransferJob::NoError);
+            }
+            return;
+        }
+
+        qint64 length;
+        if (d->mappedData) {
+            length = qMin<qint64>(d->blockSize, d->fileInfo.size() - d->done);
+            d->socksSocket->write(reinterpret_cast<const char *>(d->mappedData + d->done), length);
+        } else {
+            d->sendBuffer.resize(d->blockSize);
+            length = d->iodevice->read(d->sendBuffer.data(), d->blockSize);
+            if (length < 0) {
+                terminate(QXmppTransferJob::FileAccessError);
+                return;
+            } else if (length == 0) {
+                // wait for more data
+                return;
+            }
+            d->socksSocket->write(d->sendBuffer.constData(), length);
+        }
+
+        d->done += length;
+        reportProgress();
     }
+}
 
-    // check whether we have written the whole file
-    if (d->fileInfo.size() && d->done >= d->fileInfo.size()) {
-        if (!d->socksSocket->bytesToWrite()) {
+static QXmppFileMetadata fileInfoToMetadata(const QXmppTransferFileInfo &fileInfo)
+{
+    QXmppFileMetadata file;
+    if (fileInfo.date().isValid()) {
+        file.setLastModified(fileInfo.date());
+    }
+    if (!fileInfo.description().isEmpty()) {
+        file.setDescription(fileInfo.description());
+    }
+    if (!fileInfo.hash().isEmpty()) {
+        // the hash of QXmppTransferFileInfo is always MD5, like for SI
+        QXmppHash hash;
+        hash.setAlgorithm(QXmpp::HashAlgorithm::Md5);
+        hash.setHash(fileInfo.hash());
+        file.setHashes({ hash });
+    }
+    if (!fileInfo.name().isEmpty()) {
+        file.setFilename(fileInfo.name());
+    }
+    if (fileInfo.size() > 0) {
+        file.setSize(uint64_t(fileInfo.size()));
+    }
+    return file;
+}
+
+static QXmppTransferFileInfo fileInfoFromMetadata(const QXmppFileMetadata &file)
+{
+    QXmppTransferFileInfo fileInfo;
+    if (file.lastModified()) {
+        fileInfo.setDate(*file.lastModified());
+    }
+    fileInfo.setDescription(file.description().value_or(QString()));
+    fileInfo.setName(file.filename().value_or(QString()));
+    fileInfo.setSize(qint64(file.size().value_or(0)));
+
+    // other hash algorithms are not checked
+    const auto &hashes = file.hashes();
+    for (const auto &hash : hashes) {
+        if (hash.algorithm() == QXmpp::HashAlgorithm::Md5) {
+            fileInfo.setHash(hash.hash());
+            break;
+        }
+    }
+    return fileInfo;
+}
+
+QXmppTransferJingleJob::QXmppTransferJingleJob(const QString &jid, QXmppTransferJob::Direction direction, QXmppClient *client, QObject *parent)
+    : QXmppTransferJob(jid, direction, client, parent),
+      m_connection(new QXmppIceConnection(this)),
+      m_channel(nullptr)
+{
+    d->method = QXmppTransferJob::JingleMethod;
+
+    m_connection->addComponent(jingleComponent);
+    auto *component = m_connection->component(jingleComponent);
+    m_channel = new QXmppDatagramChannel([component](const QByteArray &datagram) { component->sendDatagram(datagram); }, this);
+
+    // the component also receives other packets, e.g. late STUN responses
+    connect(component, &QXmppIceComponent::datagramReceived, m_channel, [this](const QByteArray &datagram) {
+        if (QXmppDatagramChannel::isDatagramChannelPacket(datagram)) {
+            m_channel->handleDatagram(datagram);
+        }
+    });
+    connect(m_channel, &QXmppDatagramChannel::dataReceived, this, &QXmppTransferJingleJob::receiveData);
+    connect(m_channel, &QXmppDatagramChannel::bytesWritten, this, &QXmppTransferJingleJob::sendData);
+    connect(m_channel, &QXmppDatagramChannel::timedOut, this, [this] {
+        terminate(QXmppTransferJob::ProtocolError);
+    });
+
+    connect(m_connection, &QXmppIceConnection::connected, this, [this] {
+        if (d->state == QXmppTransferJob::StartState) {
+            setState(QXmppTransferJob::TransferState);
+        }
+    });
+    connect(m_connection, &QXmppIceConnection::disconnected, this, [this] {
+        terminate(QXmppTransferJob::ProtocolError);
+    });
+    connect(m_connection, &QXmppIceConnection::localCandidatesChanged, this, &QXmppTransferJingleJob::sendTransportInfo);
+
+    connect(this, &QXmppTransferJob::stateChanged, this, &QXmppTransferJingleJob::handleStateChanged);
+    connect(this, &QXmppTransferJob::finished, this, &QXmppTransferJingleJob::handleFinished);
+}
+
+QXmppIceConnection *QXmppTransferJingleJob::connection() const
+{
+    return m_connection;
+}
+
+void QXmppTransferJingleJob::sendInitiate()
+{
+    m_contentCreator = QStringLiteral("initiator");
+    m_contentName = QStringLiteral("file");
+
+    QXmppJingleIq iq;
+    iq.setTo(d->jid);
+    iq.setType(QXmppIq::Set);
+    iq.setAction(QXmppJingleIq::SessionInitiate);
+    iq.setInitiator(d->client->configuration().jid());
+    iq.setSid(d->sid);
+    iq.addContent(localContent());
+    sendRequest(iq);
+    m_localContentSent = true;
+}
+
+void QXmppTransferJingleJob::handleRequest(const QXmppJingleIq &iq)
+{
+    const auto content = iq.contents().isEmpty() ? QXmppJingleIq::Content() : iq.contents().constFirst();
+
+    // all requests are acknowledged, the outcome is signalled with further
+    // requests
+    sendAck(iq);
+
+    if (iq.action() == QXmppJingleIq::SessionInitiate) {
+        if (d->direction != QXmppTransferJob::IncomingDirection || d->state != QXmppTransferJob::OfferState) {
+            return;
+        }
+        m_contentCreator = content.creator();
+        m_contentName = content.name();
+        handleTransport(content);
+    } else if (iq.action() == QXmppJingleIq::SessionAccept) {
+        if (d->direction != QXmppTransferJob::OutgoingDirection || d->state != QXmppTransferJob::OfferState) {
+            warning(QStringLiteral("Ignoring session-accept for Jingle session %1").arg(d->sid));
+            return;
+        }
+        setState(QXmppTransferJob::StartState);
+        handleTransport(content);
+    } else if (iq.action() == QXmppJingleIq::TransportInfo) {
+        handleTransport(content);
+    } else if (iq.action() == QXmppJingleIq::SessionTerminate) {
+        info(QStringLiteral("Remote party %1 terminated Jingle session %2").arg(iq.from(), iq.sid()));
+        m_sessionTerminated = true;
+        handleTerminate(iq.reason());
+    }
+}
+
+bool QXmppTransferJingleJob::handleResponse(const QXmppIq &iq)
+{
+    if (iq.from() != d->jid || !m_requests.contains(iq.id())) {
+        return false;
+    }
+
+    const auto action = m_requests.take(iq.id());
+    if (iq.type() == QXmppIq::Error &&
+        (action == QXmppJingleIq::SessionInitiate || action == QXmppJingleIq::SessionAccept)) {
+        // the remote party does not know the session, so it is not
+        // terminated explicitly
+        m_sessionTerminated = true;
+        terminate(action == QXmppJingleIq::SessionInitiate ? QXmppTransferJob::AbortError : QXmppTransferJob::ProtocolError);
+    }
+    return true;
+}
+
+QXmppJingleIq::Content QXmppTransferJingleJob::localContent() const
+{
+    QXmppJingleIq::Content content;
+    content.setCreator(m_contentCreator);
+    content.setName(m_contentName);
+    content.setSenders(QStringLiteral("initiator"));
+    content.setFileTransferFile(fileInfoToMetadata(d->fileInfo));
+
+    content.setTransportUser(m_connection->localUser());
+    content.setTransportPassword(m_connection->localPassword());
+    content.setTransportCandidates(m_connection->localCandidates());
+    return content;
+}
+
+void QXmppTransferJingleJob::handleTransport(const QXmppJingleIq::Content &content)
+{
+    if (!content.transportUser().isEmpty()) {
+        m_connection->setRemoteUser(content.transportUser());
+        m_connection->setRemotePassword(content.transportPassword());
+    }
+    const auto candidates = content.transportCandidates();
+    for (const auto &candidate : candidates) {
+        m_connection->addRemoteCandidate(candidate);
+    }
+
+    // the receiver connects once the offer has been accepted
+    if (!candidates.isEmpty() && d->state != QXmppTransferJob::OfferState) {
+        m_connection->connectToHost();
+    }
+}
+
+void QXmppTransferJingleJob::handleTerminate(const QXmppJingleIq::Reason &reason)
+{
+    switch (reason.type()) {
+    case QXmppJingleIq::Reason::Success:
+        // the receiver only ends the session successfully once it has
+        // received everything, even if some acknowledgements are missing
+        if (d->direction == QXmppTransferJob::IncomingDirection) {
+            checkData();
+        } else if (!d->fileInfo.size() || d->done >= d->fileInfo.size()) {
             terminate(QXmppTransferJob::NoError);
+        } else {
+            terminate(QXmppTransferJob::ProtocolError);
+        }
+        break;
+    case QXmppJingleIq::Reason::Busy:
+    case QXmppJingleIq::Reason::Cancel:
+    case QXmppJingleIq::Reason::Decline:
+    case QXmppJingleIq::Reason::Gone:
+        terminate(QXmppTransferJob::AbortError);
+        break;
+    case QXmppJingleIq::Reason::MediaError:
+        terminate(QXmppTransferJob::FileCorruptError);
+        break;
+    default:
+        terminate(QXmppTransferJob::ProtocolError);
+        break;
+    }
+}
+
+void QXmppTransferJingleJob::handleStateChanged(QXmppTransferJob::State state)
+{
+    if (state == QXmppTransferJob::StartState && d->direction == QXmppTransferJob::IncomingDirection) {
+        // the job was accepted by the local party
+        if (!d->iodevice || !d->iodevice->isWritable()) {
+            terminate(QXmppTransferJob::FileAccessError);
+            return;
         }
+
+        QXmppJingleIq iq;
+        iq.setTo(d->jid);
+        iq.setType(QXmppIq::Set);
+        iq.setAction(QXmppJingleIq::SessionAccept);
+        iq.setResponder(d->client->configuration().jid());
+        iq.setSid(d->sid);
+        iq.addContent(localContent());
+        sendRequest(iq);
+        m_localContentSent = true;
+
+        m_connection->connectToHost();
+    } else if (state == QXmppTransferJob::TransferState && d->direction == QXmppTransferJob::OutgoingDirection) {
+        connect(d->iodevice, &QIODevice::readyRead, this, &QXmppTransferJingleJob::sendData);
+        sendData();
+    }
+}
+
+void QXmppTransferJingleJob::handleFinished()
+{
+    // an outgoing session only exists once it has been initiated
+    if (!m_sessionTerminated && (m_localContentSent || d->direction == QXmppTransferJob::IncomingDirection)) {
+        m_sessionTerminated = true;
+
+        QXmppJingleIq::Reason::Type reason;
+        switch (d->error) {
+        case QXmppTransferJob::NoError:
+            reason = QXmppJingleIq::Reason::Success;
+            break;
+        case QXmppTransferJob::AbortError:
+            // an offer that has not been accepted is declined
+            reason = m_localContentSent ? QXmppJingleIq::Reason::Cancel : QXmppJingleIq::Reason::Decline;
+            break;
+        case QXmppTransferJob::FileCorruptError:
+            reason = QXmppJingleIq::Reason::MediaError;
+            break;
+        case QXmppTransferJob::ProtocolError:
+            reason = QXmppJingleIq::Reason::FailedTransport;
+            break;
+        default:
+            reason = QXmppJingleIq::Reason::FailedApplication;
+            break;
+        }
+
+        QXmppJingleIq iq;
+        iq.setTo(d->jid);
+        iq.setType(QXmppIq::Set);
+        iq.setAction(QXmppJingleIq::SessionTerminate);
+        iq.setSid(d->sid);
+        iq.reason().setType(reason);
+        sendRequest(iq);
+    }
+
+    m_connection->close();
+}
+
+void QXmppTransferJingleJob::sendAck(const QXmppJingleIq &iq)
+{
+    QXmppIq ack;
+    ack.setId(iq.id());
+    ack.setTo(iq.from());
+    ack.setType(QXmppIq::Result);
+    d->client->sendPacket(ack);
+}
+
+void QXmppTransferJingleJob::sendRequest(const QXmppJingleIq &iq)
+{
+    m_requests.insert(iq.id(), iq.action());
+    d->client->sendPacket(iq);
+}
+
+void QXmppTransferJingleJob::sendTransportInfo()
+{
+    if (!m_localContentSent || d->state == QXmppTransferJob::FinishedState) {
         return;
     }
 
-    char *buffer = new char[d->blockSize];
-    qint64 length = d->iodevice->read(buffer, d->blockSize);
-    if (length < 0) {
-        delete[] buffer;
-        terminate(QXmppTransferJob::FileAccessError);
+    QXmppJingleIq iq;
+    iq.setTo(d->jid);
+    iq.setType(QXmppIq::Set);
+    iq.setAction(QXmppJingleIq::TransportInfo);
+    iq.setSid(d->sid);
+    iq.addContent(localContent());
+    sendRequest(iq);
+}
+
+void QXmppTransferJingleJob::sendData()
+{
+    if (d->direction != QXmppTransferJob::OutgoingDirection || d->state != QXmppTransferJob::TransferState) {
         return;
-    } else {
-        d->socksSocket->write(buffer, length);
-        delete[] buffer;
+    }
+
+    // keep the channel busy, the data is only removed from its buffer once
+    // it has been acknowledged
+    const auto size = d->fileInfo.size();
+    while (m_channel->bytesToWrite() < jingleWriteBufferSize && (!size || d->done < size)) {
+        const auto maxLength = size ? qMin<qint64>(d->blockSize, size - d->done) : d->blockSize;
+        d->sendBuffer.resize(maxLength);
+        const auto length = d->iodevice->read(d->sendBuffer.data(), maxLength);
+        if (length < 0) {
+            terminate(QXmppTransferJob::FileAccessError);
+            return;
+        } else if (length == 0) {
+            // wait for more data
+            break;
+        }
+        m_channel->write(QByteArray(d->sendBuffer.constData(), int(length)));
+
         d->done += length;
-        Q_EMIT progress(d->done, fileSize());
+        reportProgress();
+    }
+
+    // the receiver ends the session once it has checked the file, but does
+    // not need to
+    const bool complete = size ? d->done >= size : !d->iodevice->isSequential() && d->iodevice->atEnd();
+    if (complete && !m_channel->bytesToWrite() && !m_waitingForTerminate) {
+        m_waitingForTerminate = true;
+        QTimer::singleShot(jingleTerminateTimeout, this, [this] {
+            terminate(QXmppTransferJob::NoError);
+        });
     }
 }
-/// \endcond
 
-class QXmppTransferManagerPrivate
+void QXmppTransferJingleJob::receiveData(const QByteArray &data)
 {
-public:
-    QXmppTransferManagerPrivate();
+    if (d->direction != QXmppTransferJob::IncomingDirection) {
+        return;
+    }
 
-    QXmppTransferIncomingJob *getIncomingJobByRequestId(const QString &jid, const QString &id);
-    QXmppTransferIncomingJob *getIncomingJobBySid(const QString &jid, const QString &sid);
-    QXmppTransferOutgoingJob *getOutgoingJobByRequestId(const QString &jid, const QString &id);
+    // the sender may have completed the connectivity checks first
+    if (d->state == QXmppTransferJob::StartState) {
+        setState(QXmppTransferJob::TransferState);
+    }
+    if (d->state != QXmppTransferJob::TransferState) {
+        return;
+    }
 
-    int ibbBlockSize;
-    QList<QXmppTransferJob *> jobs;
-    QString proxy;
-    bool proxyOnly;
-    QXmppSocksServer *socksServer;
-    QXmppTransferJob::Methods supportedMethods;
+    if (d->iodevice->write(data) < 0) {
+        terminate(QXmppTransferJob::FileAccessError);
+        return;
+    }
+    d->done += data.size();
+    if (!d->fileInfo.hash().isEmpty()) {
+        d->hash.addData(data);
+    }
+    reportProgress();
 
-private:
-    QXmppTransferJob *getJobByRequestId(QXmppTransferJob::Direction direction, const QString &jid, const QString &id);
-};
+    if (d->fileInfo.size() && d->done >= d->fileInfo.size()) {
+        checkData();
+    }
+}
+/// \endcond
 
 QXmppTransferManagerPrivate::QXmppTransferManagerPrivate()
-    : ibbBlockSize(4096),
+    : ibbBlockSize(defaultIbbBlockSize),
+      ibbWindowSize(1),
       proxyOnly(false),
       socksServer(nullptr),
-      supportedMethods(QXmppTransferJob::AnyMethod)
+      socksWriteBufferSize(65536),
+      supportedMethods(QXmppTransferJob::AnyMethod),
+      turnPort(0)
 {
 }
 
 QXmppTransferJob *QXmppTransferManagerPrivate::getJobByRequestId(QXmppTransferJob::Direction direction, const QString &jid, const QString &id)
 {
-    for (auto *job : std::as_const(jobs)) {
-        if (job->d->direction == direction &&
-            job->d->jid == jid &&
-            job->d->requestId == id) {
-            return job;
-        }
+    auto *job = getJobByRequestId(id);
+    if (job &&
+        job->d->direction == direction &&
+        job->d->jid == jid) {
+        return job;
     }
     return nullptr;
 }
 
+QXmppTransferJob *QXmppTransferManagerPrivate::getJobByRequestId(const QString &id) const
+{
+    // request IDs are unique, the sender has to be checked by the caller
+    return id.isEmpty() ? nullptr : jobsByRequestId.value(id);
+}
+
 QXmppTransferIncomingJob *QXmppTransferManagerPrivate::getIncomingJobByRequestId(const QString &jid, const QString &id)
 {
     return static_cast<QXmppTransferIncomingJob *>(getJobByRequestId(QXmppTransferJob::IncomingDirection, jid, id));
@@ -740,14 +1363,7 @@ QXmppTransferIncomingJob *QXmppTransferManagerPrivate::getIncomingJobByRequestId
 
 QXmppTransferIncomingJob *QXmppTransferManagerPrivate::getIncomingJobBySid(const QString &jid, const QString &sid)
 {
-    for (auto *job : std::as_const(jobs)) {
-        if (job->d->direction == QXmppTransferJob::IncomingDirection &&
-            job->d->jid == jid &&
-            job->d->sid == sid) {
-            return static_cast<QXmppTransferIncomingJob *>(job);
-        }
-    }
-    return nullptr;
+    return incomingJobsBySid.value(qMakePair(jid, sid));
 }
 
 QXmppTransferOutgoingJob *QXmppTransferManagerPrivate::getOutgoingJobByRequestId(const QString &jid, const QString &id)
@@ -755,6 +1371,98 @@ QXmppTransferOutgoingJob *QXmppTransferManagerPrivate::getOutgoingJobByRequestId
     return static_cast<QXmppTransferOutgoingJob *>(getJobByRequestId(QXmppTransferJob::OutgoingDirection, jid, id));
 }
 
+void QXmppTransferManagerPrivate::addJob(QXmppTransferJob *job)
+{
+    jobs.append(job);
+    job->d->manager = this;
+    QXmppMetrics::addToGauge(QXmppMetrics::TransferJobs, 1);
+
+    // if a stream ID is offered twice, the oldest job is used
+    if (auto *jingleJob = qobject_cast<QXmppTransferJingleJob *>(job)) {
+        const auto key = qMakePair(job->d->jid, job->d->sid);
+        if (!jingleJobsBySid.contains(key)) {
+            jingleJobsBySid.insert(key, jingleJob);
+        }
+    } else if (job->d->direction == QXmppTransferJob::IncomingDirection) {
+        const auto key = qMakePair(job->d->jid, job->d->sid);
+        if (!incomingJobsBySid.contains(key)) {
+            incomingJobsBySid.insert(key, static_cast<QXmppTransferIncomingJob *>(job));
+        }
+    }
+    if (!job->d->requestId.isEmpty()) {
+        jobsByRequestId.insert(job->d->requestId, job);
+    }
+}
+
+// Called when the job is destroyed, so only its address may be used.
+void QXmppTransferManagerPrivate::removeJob(QXmppTransferJob *job)
+{
+    if (jobs.removeAll(job)) {
+        QXmppMetrics::addToGauge(QXmppMetrics::TransferJobs, -1);
+    }
+
+    for (auto itr = jobsByRequestId.begin(); itr != jobsByRequestId.end();) {
+        if (itr.value() == job) {
+            itr = jobsByRequestId.erase(itr);
+        } else {
+            ++itr;
+        }
+    }
+
+    for (auto itr = jingleJobsBySid.begin(); itr != jingleJobsBySid.end();) {
+        if (itr.value() == job) {
+            itr = jingleJobsBySid.erase(itr);
+        } else {
+            ++itr;
+        }
+    }
+
+    QList<QPair<QString, QString>> removedKeys;
+    for (auto itr = incomingJobsBySid.begin(); itr != incomingJobsBySid.end();) {
+        if (itr.value() == job) {
+            removedKeys.append(itr.key());
+            itr = incomingJobsBySid.erase(itr);
+        } else {
+            ++itr;
+        }
+    }
+
+    // another job may have been offered with the same stream ID
+    for (const auto &key : std::as_const(removedKeys)) {
+        for (auto *other : std::as_const(jobs)) {
+            if (other->d->direction == QXmppTransferJob::IncomingDirection &&
+                other->d->method != QXmppTransferJob::JingleMethod &&
+                other->d->jid == key.first &&
+                other->d->sid == key.second) {
+                incomingJobsBySid.insert(key, static_cast<QXmppTransferIncomingJob *>(other));
+                break;
+            }
+        }
+    }
+}
+
+void QXmppTransferManagerPrivate::setupIceConnection(QXmppTransferJingleJob *job, bool controlling)
+{
+    auto *connection = job->connection();
+    connection->setIceControlling(controlling);
+    connection->setStunServers(stunServers);
+    connection->setTurnServer(turnHost, turnPort);
+    connection->setTurnUser(turnUser);
+    connection->setTurnPassword(turnPassword);
+    connection->bind(QXmppIceComponent::discoverAddresses());
+}
+
+void QXmppTransferManagerPrivate::setRequestId(QXmppTransferJob *job, const QString &id)
+{
+    if (!job->d->requestId.isEmpty()) {
+        jobsByRequestId.remove(job->d->requestId);
+    }
+    job->d->requestId = id;
+    if (!id.isEmpty()) {
+        jobsByRequestId.insert(id, job);
+    }
+}
+
 ///
 /// \class QXmppTransferManager
 ///
@@ -766,6 +1474,15 @@ QXmppTransferOutgoingJob *QXmppTransferManagerPrivate::getOutgoingJobByRequestId
 /// using either \xep{0065, SOCKS5 Bytestreams} or \xep{0047, In-Band
 /// Bytestreams}.
 ///
+/// Files can also be sent using \xep{0234, Jingle File Transfer} with
+/// sendJingleFile(). The file is then transferred directly between the
+/// parties over ICE-UDP (RFC 5245), which also works if both of them are
+/// behind a NAT, using the STUN and TURN servers set with setStunServers() and
+/// setTurnServer(). Lost packets are retransmitted and the sending rate is
+/// adapted to the capacity of the path. Incoming Jingle file transfers are
+/// only accepted if QXmppTransferJob::JingleMethod is added to the
+/// supportedMethods().
+///
 /// To make use of this manager, you need to instantiate it and load it into the
 /// QXmppClient instance as follows:
 ///
@@ -793,18 +1510,24 @@ QXmppTransferManager::QXmppTransferManager()
     }
 }
 
-QXmppTransferManager::~QXmppTransferManager() = default;
+QXmppTransferManager::~QXmppTransferManager()
+{
+    // the jobs are children of the manager and outlive its private data
+    for (auto *job : std::as_const(d->jobs)) {
+        job->d->manager = nullptr;
+    }
+    QXmppMetrics::addToGauge(QXmppMetrics::TransferJobs, -qint64(d->jobs.size()));
+}
 
 void QXmppTransferManager::byteStreamIqReceived(const QXmppByteStreamIq &iq)
 {
     // handle IQ from proxy
-    for (auto *job : std::as_const(d->jobs)) {
-        if (job->d->socksProxy.jid() == iq.from() && job->d->requestId == iq.id()) {
-            if (iq.type() == QXmppIq::Result && iq.streamHosts().size() > 0) {
-                job->d->socksProxy = iq.streamHosts().constFirst();
-                socksServerSendOffer(job);
-                return;
-            }
+    if (auto *job = d->getJobByRequestId(iq.id());
+        job && job->d->socksProxy.jid() == iq.from()) {
+        if (iq.type() == QXmppIq::Result && iq.streamHosts().size() > 0) {
+            job->d->socksProxy = iq.streamHosts().constFirst();
+            socksServerSendOffer(job);
+            return;
         }
     }
 
@@ -892,12 +1615,18 @@ void QXmppTransferManager::byteStreamSetReceived(const QXmppByteStreamIq &iq)
 /// \cond
 QStringList QXmppTransferManager::discoveryFeatures() const
 {
-    return {
+    QStringList features = {
         ns_ibb,                              // XEP-0047: In-Band Bytestreams
         ns_bytestreams,                      // XEP-0065: SOCKS5 Bytestreams
         ns_stream_initiation,                // XEP-0095: Stream Initiation
         ns_stream_initiation_file_transfer,  // XEP-0096: SI File Transfer
     };
+    if (d->supportedMethods & QXmppTransferJob::JingleMethod) {
+        features << ns_jingle                 // XEP-0166: Jingle
+                 << ns_jingle_ice_udp         // XEP-0176: Jingle ICE-UDP Transport Method
+                 << ns_jingle_file_transfer;  // XEP-0234: Jingle File Transfer
+    }
+    return features;
 }
 
 bool QXmppTransferManager::handleStanza(const QDomElement &element)
@@ -937,6 +1666,13 @@ bool QXmppTransferManager::handleStanza(const QDomElement &element)
         streamInitiationIqReceived(siIq);
         return true;
     }
+    // XEP-0234: Jingle File Transfer
+    else if (QXmppJingleIq::isJingleIq(element) &&
+             (d->supportedMethods & QXmppTransferJob::JingleMethod)) {
+        QXmppJingleIq jingleIq;
+        jingleIq.parse(element);
+        return jingleIqReceived(jingleIq);
+    }
 
     return false;
 }
@@ -1059,37 +1795,66 @@ void QXmppTransferManager::ibbResponseReceived(const QXmppIq &iq)
         return;
     }
 
+    // acknowledgement of a data block
+    if (job->d->ibbPendingIds.remove(iq.id())) {
+        d->jobsByRequestId.remove(iq.id());
+    }
+
     if (iq.type() == QXmppIq::Result) {
-        const QByteArray buffer = job->d->iodevice->read(job->d->blockSize);
         job->setState(QXmppTransferJob::TransferState);
-        if (buffer.size()) {
+
+        // keep up to ibbWindowSize() data blocks unacknowledged
+        while (job->d->ibbPendingIds.size() < d->ibbWindowSize) {
+            const QByteArray buffer = job->d->iodevice->read(job->d->blockSize);
+            if (buffer.isEmpty()) {
+                break;
+            }
+
             // send next data block
             QXmppIbbDataIq dataIq;
             dataIq.setTo(job->d->jid);
             dataIq.setSid(job->d->sid);
             dataIq.setSequence(job->d->ibbSequence++);
             dataIq.setPayload(buffer);
-            job->d->requestId = dataIq.id();
+            job->d->ibbPendingIds.insert(dataIq.id());
+            d->jobsByRequestId.insert(dataIq.id(), job);
             client()->sendPacket(dataIq);
 
             job->d->done += buffer.size();
-            Q_EMIT job->progress(job->d->done, job->fileSize());
-        } else {
+            job->reportProgress();
+        }
+
+        if (job->d->ibbPendingIds.isEmpty()) {
             // close the bytestream
             QXmppIbbCloseIq closeIq;
             closeIq.setTo(job->d->jid);
             closeIq.setSid(job->d->sid);
-            job->d->requestId = closeIq.id();
+            d->setRequestId(job, closeIq.id());
             client()->sendPacket(closeIq);
 
             job->terminate(QXmppTransferJob::NoError);
         }
     } else if (iq.type() == QXmppIq::Error) {
+        // the receiver prefers a smaller block size, retry with the default
+        if (job->state() == QXmppTransferJob::StartState &&
+            iq.error().condition() == QXmppStanza::Error::ResourceConstraint &&
+            job->d->blockSize > defaultIbbBlockSize) {
+            job->d->blockSize = defaultIbbBlockSize;
+
+            QXmppIbbOpenIq openIq;
+            openIq.setTo(job->d->jid);
+            openIq.setSid(job->d->sid);
+            openIq.setBlockSize(job->d->blockSize);
+            d->setRequestId(job, openIq.id());
+            client()->sendPacket(openIq);
+            return;
+        }
+
         // close the bytestream
         QXmppIbbCloseIq closeIq;
         closeIq.setTo(job->d->jid);
         closeIq.setSid(job->d->sid);
-        job->d->requestId = closeIq.id();
+        d->setRequestId(job, closeIq.id());
         client()->sendPacket(closeIq);
 
         job->terminate(QXmppTransferJob::ProtocolError);
@@ -1098,9 +1863,17 @@ void QXmppTransferManager::ibbResponseReceived(const QXmppIq &iq)
 
 void QXmppTransferManager::_q_iqReceived(const QXmppIq &iq)
 {
-    for (auto *ptr : std::as_const(d->jobs)) {
+    // XEP-0234: Jingle File Transfer
+    for (auto *job : std::as_const(d->jingleJobsBySid)) {
+        if (job->handleResponse(iq)) {
+            return;
+        }
+    }
+
+    auto *ptr = d->getJobByRequestId(iq.id());
+    if (ptr) {
         // handle IQ from proxy
-        if (ptr->direction() == QXmppTransferJob::OutgoingDirection && ptr->d->socksProxy.jid() == iq.from() && ptr->d->requestId == iq.id()) {
+        if (ptr->direction() == QXmppTransferJob::OutgoingDirection && ptr->d->socksProxy.jid() == iq.from()) {
             auto *job = static_cast<QXmppTransferOutgoingJob *>(ptr);
             if (job->d->socksSocket) {
                 // proxy connection activation result
@@ -1122,7 +1895,7 @@ void QXmppTransferManager::_q_iqReceived(const QXmppIq &iq)
         }
 
         // handle IQ from peer
-        else if (ptr->d->jid == iq.from() && ptr->d->requestId == iq.id()) {
+        else if (ptr->d->jid == iq.from()) {
             auto *job = ptr;
             if (job->direction() == QXmppTransferJob::OutgoingDirection &&
                 job->method() == QXmppTransferJob::InBandMethod) {
@@ -1144,7 +1917,7 @@ void QXmppTransferManager::_q_iqReceived(const QXmppIq &iq)
 
 void QXmppTransferManager::_q_jobDestroyed(QObject *object)
 {
-    d->jobs.removeAll(static_cast<QXmppTransferJob *>(object));
+    d->removeJob(static_cast<QXmppTransferJob *>(object));
 }
 
 void QXmppTransferManager::_q_jobError(QXmppTransferJob::Error error)
@@ -1161,7 +1934,7 @@ void QXmppTransferManager::_q_jobError(QXmppTransferJob::Error error)
         QXmppIbbCloseIq closeIq;
         closeIq.setTo(job->d->jid);
         closeIq.setSid(job->d->sid);
-        job->d->requestId = closeIq.id();
+        d->setRequestId(job, closeIq.id());
         client()->sendPacket(closeIq);
     }
 }
@@ -1191,6 +1964,14 @@ void QXmppTransferManager::_q_jobStateChanged(QXmppTransferJob::State state)
     disconnect(job, &QXmppTransferJob::stateChanged,
                this, &QXmppTransferManager::_q_jobStateChanged);
 
+    // Jingle jobs accept or decline the session themselves
+    if (job->method() == QXmppTransferJob::JingleMethod) {
+        if (state == QXmppTransferJob::StartState) {
+            Q_EMIT jobStarted(job);
+        }
+        return;
+    }
+
     // the job was refused by the local party
     if (state != QXmppTransferJob::StartState || !job->d->iodevice || !job->d->iodevice->isWritable()) {
         QXmppStanza::Error error(QXmppStanza::Error::Cancel, QXmppStanza::Error::Forbidden);
@@ -1247,6 +2028,11 @@ void QXmppTransferManager::_q_jobStateChanged(QXmppTransferJob::State state)
 /// instance "user@host/resource".
 ///
 QXmppTransferJob *QXmppTransferManager::sendFile(const QString &jid, const QString &filePath, const QString &description)
+{
+    return sendLocalFile(jid, filePath, description, QXmppTransferJob::AnyMethod);
+}
+
+QXmppTransferJob *QXmppTransferManager::sendLocalFile(const QString &jid, const QString &filePath, const QString &description, QXmppTransferJob::Method method)
 {
     if (QXmppUtils::jidToResource(jid).isEmpty()) {
         warning("The file recipient's JID must be a full JID");
@@ -1282,7 +2068,9 @@ QXmppTransferJob *QXmppTransferManager::sendFile(const QString &jid, const QStri
     }
 
     // create job
-    QXmppTransferJob *job = sendFile(jid, device, fileInfo);
+    QXmppTransferJob *job = method == QXmppTransferJob::JingleMethod
+        ? sendJingleFile(jid, device, fileInfo)
+        : sendFile(jid, device, fileInfo);
     job->setLocalFileUrl(QUrl::fromLocalFile(filePath));
     job->d->deviceIsOwn = true;
     return job;
@@ -1308,6 +2096,7 @@ QXmppTransferJob *QXmppTransferManager::sendFile(const QString &jid, QIODevice *
 
     auto *job = new QXmppTransferOutgoingJob(jid, client(), this);
     job->d->sid = sid.isEmpty() ? QXmppUtils::generateStanzaHash() : sid;
+    job->d->socksWriteBufferSize = d->socksWriteBufferSize;
     job->d->fileInfo = fileInfo;
     job->d->iodevice = device;
 
@@ -1330,15 +2119,15 @@ QXmppTransferJob *QXmppTransferManager::sendFile(const QString &jid, QIODevice *
     QXmppDataForm::Field methodField(QXmppDataForm::Field::ListSingleField);
     methodField.setKey("stream-method");
     if (d->supportedMethods & QXmppTransferJob::InBandMethod) {
-        methodField.setOptions(methodField.options() << qMakePair(QString(), QString::fromLatin1(ns_ibb)));
+        methodField.setOptions(methodField.options() << qMakePair(QString(), QString(ns_ibb)));
     }
     if (d->supportedMethods & QXmppTransferJob::SocksMethod) {
-        methodField.setOptions(methodField.options() << qMakePair(QString(), QString::fromLatin1(ns_bytestreams)));
+        methodField.setOptions(methodField.options() << qMakePair(QString(), QString(ns_bytestreams)));
     }
     form.setFields(QList<QXmppDataForm::Field>() << methodField);
 
     // start job
-    d->jobs.append(job);
+    d->addJob(job);
 
     connect(job, &QObject::destroyed, this, &QXmppTransferManager::_q_jobDestroyed);
     connect(job, QOverload<QXmppTransferJob::Error>::of(&QXmppTransferJob::error), this, &QXmppTransferManager::_q_jobError);
@@ -1351,7 +2140,7 @@ QXmppTransferJob *QXmppTransferManager::sendFile(const QString &jid, QIODevice *
     request.setFileInfo(job->d->fileInfo);
     request.setFeatureForm(form);
     request.setSiId(job->d->sid);
-    job->d->requestId = request.id();
+    d->setRequestId(job, request.id());
     client()->sendPacket(request);
 
     // notify user
@@ -1360,6 +2149,74 @@ QXmppTransferJob *QXmppTransferManager::sendFile(const QString &jid, QIODevice *
     return job;
 }
 
+///
+/// Sends the file at \a filePath to a remote party using \xep{0234, Jingle
+/// File Transfer}.
+///
+/// The remote party will be given the choice to accept or refuse the transfer.
+///
+/// Returns 0 if the \a jid is not valid or if the file at \a filePath cannot be
+/// read.
+///
+/// \note The recipient's \a jid must be a full JID with a resource, for
+/// instance "user@host/resource".
+///
+/// \since QXmpp 1.6
+///
+QXmppTransferJob *QXmppTransferManager::sendJingleFile(const QString &jid, const QString &filePath, const QString &description)
+{
+    return sendLocalFile(jid, filePath, description, QXmppTransferJob::JingleMethod);
+}
+
+///
+/// Sends the file in \a device to a remote party using \xep{0234, Jingle File
+/// Transfer}.
+///
+/// The file is transferred directly over ICE-UDP. The remote party needs to
+/// support Jingle File Transfer and the ICE-UDP transport, which can be
+/// checked using service discovery.
+///
+/// Returns 0 if the \a jid is not valid.
+///
+/// \note The recipient's \a jid must be a full JID with a resource, for
+/// instance "user@host/resource".
+/// \note The ownership of the \a device should be managed by the caller.
+///
+/// \since QXmpp 1.6
+///
+QXmppTransferJob *QXmppTransferManager::sendJingleFile(const QString &jid, QIODevice *device, const QXmppTransferFileInfo &fileInfo, const QString &sid)
+{
+    if (QXmppUtils::jidToResource(jid).isEmpty()) {
+        warning("The file recipient's JID must be a full JID");
+        return nullptr;
+    }
+
+    auto *job = new QXmppTransferJingleJob(jid, QXmppTransferJob::OutgoingDirection, client(), this);
+    job->d->sid = sid.isEmpty() ? QXmppUtils::generateStanzaHash() : sid;
+    job->d->fileInfo = fileInfo;
+    job->d->iodevice = device;
+
+    // check file is open
+    if (!device || !device->isReadable()) {
+        job->terminate(QXmppTransferJob::FileAccessError);
+        return job;
+    }
+
+    // start job
+    d->setupIceConnection(job, true);
+    d->addJob(job);
+
+    connect(job, &QObject::destroyed, this, &QXmppTransferManager::_q_jobDestroyed);
+    connect(job, &QXmppTransferJob::finished, this, &QXmppTransferManager::_q_jobFinished);
+
+    job->sendInitiate();
+
+    // notify user
+    Q_EMIT jobStarted(job);
+
+    return job;
+}
+
 void QXmppTransferManager::_q_socksServerConnected(QTcpSocket *socket, const QString &hostName, quint16 port)
 {
     const QString ownJid = client()->configuration().jid();
@@ -1408,7 +2265,7 @@ void QXmppTransferManager::socksServerSendOffer(QXmppTransferJob *job)
     streamIq.setTo(job->d->jid);
     streamIq.setSid(job->d->sid);
     streamIq.setStreamHosts(streamHosts);
-    job->d->requestId = streamIq.id();
+    d->setRequestId(job, streamIq.id());
     client()->sendPacket(streamIq);
 }
 
@@ -1455,7 +2312,7 @@ void QXmppTransferManager::streamInitiationResultReceived(const QXmppStreamIniti
         openIq.setTo(job->d->jid);
         openIq.setSid(job->d->sid);
         openIq.setBlockSize(job->d->blockSize);
-        job->d->requestId = openIq.id();
+        d->setRequestId(job, openIq.id());
         client()->sendPacket(openIq);
     } else if (job->method() == QXmppTransferJob::SocksMethod) {
         if (!d->proxy.isEmpty()) {
@@ -1466,7 +2323,7 @@ void QXmppTransferManager::streamInitiationResultReceived(const QXmppStreamIniti
             streamIq.setType(QXmppIq::Get);
             streamIq.setTo(job->d->socksProxy.jid());
             streamIq.setSid(job->d->sid);
-            job->d->requestId = streamIq.id();
+            d->setRequestId(job, streamIq.id());
             client()->sendPacket(streamIq);
         } else {
             socksServerSendOffer(job);
@@ -1552,12 +2409,82 @@ void QXmppTransferManager::streamInitiationSetReceived(const QXmppStreamInitiati
     }
 
     // register job
-    d->jobs.append(job);
+    d->addJob(job);
+
+    connect(job, &QObject::destroyed, this, &QXmppTransferManager::_q_jobDestroyed);
+    connect(job, &QXmppTransferJob::finished, this, &QXmppTransferManager::_q_jobFinished);
+    connect(job, &QXmppTransferJob::stateChanged, this, &QXmppTransferManager::_q_jobStateChanged);
+
+    // allow user to accept or decline the job
+    Q_EMIT fileReceived(job);
+}
+
+bool QXmppTransferManager::jingleIqReceived(const QXmppJingleIq &iq)
+{
+    if (iq.type() != QXmppIq::Set) {
+        return false;
+    }
+
+    if (iq.action() == QXmppJingleIq::SessionInitiate) {
+        // other applications, e.g. calls, are handled by other extensions
+        const auto contents = iq.contents();
+        if (std::none_of(contents.cbegin(), contents.cend(), [](const auto &content) { return bool(content.fileTransferFile()); })) {
+            return false;
+        }
+        jingleSessionInitiateReceived(iq);
+        return true;
+    }
+
+    // for all other requests, require a known session
+    auto *job = d->jingleJobsBySid.value(qMakePair(iq.from(), iq.sid()));
+    if (!job) {
+        return false;
+    }
+    job->handleRequest(iq);
+    return true;
+}
+
+// The remote party offers a file using XEP-0234: Jingle File Transfer.
+void QXmppTransferManager::jingleSessionInitiateReceived(const QXmppJingleIq &iq)
+{
+    // check there is a receiver connected to the fileReceived() signal
+    if (!isSignalConnected(QMetaMethod::fromSignal(&QXmppTransferManager::fileReceived))) {
+        QXmppIq response;
+        response.setTo(iq.from());
+        response.setId(iq.id());
+        response.setType(QXmppIq::Error);
+        response.setError(QXmppStanza::Error(QXmppStanza::Error::Cancel, QXmppStanza::Error::Forbidden));
+        client()->sendPacket(response);
+        return;
+    }
+
+    const auto contents = iq.contents();
+    const auto content = *std::find_if(contents.cbegin(), contents.cend(), [](const auto &content) {
+        return bool(content.fileTransferFile());
+    });
+
+    auto *job = new QXmppTransferJingleJob(iq.from(), QXmppTransferJob::IncomingDirection, client(), this);
+    job->d->offerId = iq.id();
+    job->d->sid = iq.sid();
+    job->d->fileInfo = fileInfoFromMetadata(*content.fileTransferFile());
+    d->setupIceConnection(job, false);
+
+    // register job
+    d->addJob(job);
 
     connect(job, &QObject::destroyed, this, &QXmppTransferManager::_q_jobDestroyed);
     connect(job, &QXmppTransferJob::finished, this, &QXmppTransferManager::_q_jobFinished);
     connect(job, &QXmppTransferJob::stateChanged, this, &QXmppTransferManager::_q_jobStateChanged);
 
+    job->handleRequest(iq);
+
+    // only ICE-UDP is supported as transport
+    if (content.transportUser().isEmpty()) {
+        warning(QStringLiteral("Remote party %1 offered a file without an ICE-UDP transport").arg(iq.from()));
+        job->terminate(QXmppTransferJob::ProtocolError);
+        return;
+    }
+
     // allow user to accept or decline the job
     Q_EMIT fileReceived(job);
 }
@@ -1613,3 +2540,151 @@ void QXmppTransferManager::setSupportedMethods(QXmppTransferJob::Methods methods
 {
     d->supportedMethods = methods;
 }
+
+///
+/// Returns the block size used for in-band bytestreams.
+///
+/// \since QXmpp 1.6
+///
+int QXmppTransferManager::ibbBlockSize() const
+{
+    return d->ibbBlockSize;
+}
+
+///
+/// Sets the block size used for in-band bytestreams (\xep{0047, In-Band
+/// Bytestreams}).
+///
+/// The block size is proposed for outgoing transfers and is the largest block
+/// size accepted for incoming transfers. If the receiver of an outgoing
+/// transfer rejects the block size, the transfer is retried with the default
+/// block size of 4096 bytes.
+///
+/// The value is limited to the range of 1 to 65535 bytes as allowed by
+/// XEP-0047. The default value is 4096 bytes.
+///
+/// \since QXmpp 1.6
+///
+void QXmppTransferManager::setIbbBlockSize(int bytes)
+{
+    d->ibbBlockSize = std::clamp(bytes, 1, maximumIbbBlockSize);
+}
+
+///
+/// Returns the number of in-band bytestream data blocks that may be sent
+/// without waiting for their acknowledgement.
+///
+/// \since QXmpp 1.6
+///
+int QXmppTransferManager::ibbWindowSize() const
+{
+    return d->ibbWindowSize;
+}
+
+///
+/// Sets the number of in-band bytestream data blocks that may be sent without
+/// waiting for their acknowledgement.
+///
+/// With a window of one block, the throughput is limited to one block per
+/// round-trip time. A larger window keeps high-latency connections busy. The
+/// blocks are numbered and the receiver checks that they arrive in order.
+///
+/// The default value is 1.
+///
+/// \since QXmpp 1.6
+///
+void QXmppTransferManager::setIbbWindowSize(int blocks)
+{
+    d->ibbWindowSize = std::max(blocks, 1);
+}
+
+///
+/// Returns the number of bytes kept in the socket's write buffer while sending
+/// a file via SOCKS5 bytestreams.
+///
+/// \since QXmpp 1.6
+///
+qint64 QXmppTransferManager::socksWriteBufferSize() const
+{
+    return d->socksWriteBufferSize;
+}
+
+///
+/// Sets the number of bytes kept in the socket's write buffer while sending a
+/// file via SOCKS5 bytestreams.
+///
+/// New blocks are read from the file as long as less than this number of bytes
+/// is waiting to be written. A larger value keeps fast connections (e.g. LAN
+/// transfers) busy, a smaller value reduces the memory used per transfer.
+///
+/// The default value is 64 KiB. The setting applies to new transfers.
+///
+/// \since QXmpp 1.6
+///
+void QXmppTransferManager::setSocksWriteBufferSize(qint64 bytes)
+{
+    d->socksWriteBufferSize = bytes;
+}
+
+///
+/// Sets multiple STUN servers to use to determine server-reflexive addresses
+/// and ports for Jingle file transfers.
+///
+/// \param servers List of the STUN servers.
+///
+/// \since QXmpp 1.6
+///
+void QXmppTransferManager::setStunServers(const QList<QPair<QHostAddress, quint16>> &servers)
+{
+    d->stunServers = servers;
+}
+
+///
+/// Sets a single STUN server to use to determine server-reflexive addresses
+/// and ports for Jingle file transfers.
+///
+/// \param host The address of the STUN server.
+/// \param port The port of the STUN server.
+///
+/// \since QXmpp 1.6
+///
+void QXmppTransferManager::setStunServer(const QHostAddress &host, quint16 port)
+{
+    d->stunServers.clear();
+    d->stunServers.push_back(qMakePair(host, port));
+}
+
+///
+/// Sets the TURN server to use to relay Jingle file transfers in double-NAT
+/// configurations.
+///
+/// \param host The address of the TURN server.
+/// \param port The port of the TURN server.
+///
+/// \since QXmpp 1.6
+///
+void QXmppTransferManager::setTurnServer(const QHostAddress &host, quint16 port)
+{
+    d->turnHost = host;
+    d->turnPort = port;
+}
+
+///
+/// Sets the \a user used for authentication with the TURN server.
+///
+/// \since QXmpp 1.6
+///
+void QXmppTransferManager::setTurnUser(const QString &user)
+{
+    d->turnUser = user;
+}
+
+///
+/// Sets the \a password used for authentication with the TURN server.
+///
+/// \since QXmpp 1.6
+///
+void QXmppTransferManager::setTurnPassword(const QString &password)
+{
+    d->turnPassword = password;
+}
@@ -12,12 +12,14 @@
 #include <QUrl>
 #include <QVariant>
 
+class QHostAddress;
 class QTcpSocket;
 class QXmppByteStreamIq;
 class QXmppIbbCloseIq;
 class QXmppIbbDataIq;
 class QXmppIbbOpenIq;
 class QXmppIq;
+class QXmppJingleIq;
 class QXmppStreamInitiationIq;
 class QXmppTransferFileInfoPrivate;
 class QXmppTransferJobPrivate;
@@ -102,7 +104,8 @@ public:
         NoMethod = 0,      ///< No transfer method.
         InBandMethod = 1,  ///< \xep{0047}: In-Band Bytestreams
         SocksMethod = 2,   ///< \xep{0065}: SOCKS5 Bytestreams
-        AnyMethod = 3      ///< Any supported transfer method.
+        AnyMethod = 3,     ///< Any stream initiation method, i.e. In-Band or SOCKS5 Bytestreams.
+        JingleMethod = 4,  ///< \xep{0234}: Jingle File Transfer over ICE-UDP (\since QXmpp 1.6)
     };
     Q_ENUM(Method)
     Q_DECLARE_FLAGS(Methods, Method)
@@ -132,6 +135,11 @@ public:
     QString sid() const;
     qint64 speed() const;
 
+    float progressGranularity() const;
+    void setProgressGranularity(float granularity);
+    int progressInterval() const;
+    void setProgressInterval(int msecs);
+
     // XEP-0096 : File transfer
     QXmppTransferFileInfo fileInfo() const;
     // documentation needs to be here, see https://stackoverflow.com/questions/49192523/
@@ -181,11 +189,14 @@ private:
     QXmppTransferJob(const QString &jid, QXmppTransferJob::Direction direction, QXmppClient *client, QObject *parent);
     void setState(QXmppTransferJob::State state);
     void terminate(QXmppTransferJob::Error error);
+    void checkData();
+    void reportProgress();
 
     const std::unique_ptr<QXmppTransferJobPrivate> d;
     friend class QXmppTransferManager;
     friend class QXmppTransferManagerPrivate;
     friend class QXmppTransferIncomingJob;
+    friend class QXmppTransferJingleJob;
     friend class QXmppTransferOutgoingJob;
 };
 
@@ -222,6 +233,20 @@ public:
     QXmppTransferJob::Methods supportedMethods() const;
     void setSupportedMethods(QXmppTransferJob::Methods methods);
 
+    int ibbBlockSize() const;
+    void setIbbBlockSize(int bytes);
+    int ibbWindowSize() const;
+    void setIbbWindowSize(int blocks);
+
+    qint64 socksWriteBufferSize() const;
+    void setSocksWriteBufferSize(qint64 bytes);
+
+    void setStunServers(const QList<QPair<QHostAddress, quint16>> &servers);
+    void setStunServer(const QHostAddress &host, quint16 port = 3478);
+    void setTurnServer(const QHostAddress &host, quint16 port = 3478);
+    void setTurnUser(const QString &user);
+    void setTurnPassword(const QString &password);
+
     /// \cond
     QStringList discoveryFeatures() const override;
     bool handleStanza(const QDomElement &element) override;
@@ -245,6 +270,8 @@ Q_SIGNALS:
 public Q_SLOTS:
     QXmppTransferJob *sendFile(const QString &jid, const QString &filePath, const QString &description = QString());
     QXmppTransferJob *sendFile(const QString &jid, QIODevice *device, const QXmppTransferFileInfo &fileInfo, const QString &sid = QString());
+    QXmppTransferJob *sendJingleFile(const QString &jid, const QString &filePath, const QString &description = QString());
+    QXmppTransferJob *sendJingleFile(const QString &jid, QIODevice *device, const QXmppTransferFileInfo &fileInfo, const QString &sid = QString());
 
 protected:
     /// \cond
@@ -270,6 +297,9 @@ private:
     void ibbDataIqReceived(const QXmppIbbDataIq &);
     void ibbOpenIqReceived(const QXmppIbbOpenIq &);
     void ibbResponseReceived(const QXmppIq &);
+    bool jingleIqReceived(const QXmppJingleIq &);
+    void jingleSessionInitiateReceived(const QXmppJingleIq &);
+    QXmppTransferJob *sendLocalFile(const QString &jid, const QString &filePath, const QString &description, QXmppTransferJob::Method method);
     void streamInitiationIqReceived(const QXmppStreamInitiationIq &);
     void streamInitiationResultReceived(const QXmppStreamInitiationIq &);
     void streamInitiationSetReceived(const QXmppStreamInitiationIq &);
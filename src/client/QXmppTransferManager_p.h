@@ -6,8 +6,13 @@
 #define QXMPPTRANSFERMANAGER_P_H
 
 #include "QXmppByteStreamIq.h"
+#include "QXmppJingleIq.h"
 #include "QXmppTransferManager.h"
 
+#include <QElapsedTimer>
+#include <QHash>
+#include <QVector>
+
 //
 //  W A R N I N G
 //  -------------
@@ -20,6 +25,8 @@
 //
 
 class QTimer;
+class QXmppDatagramChannel;
+class QXmppIceConnection;
 class QXmppSocksClient;
 
 class QXmppTransferIncomingJob : public QXmppTransferJob
@@ -28,22 +35,36 @@ class QXmppTransferIncomingJob : public QXmppTransferJob
 
 public:
     QXmppTransferIncomingJob(const QString &jid, QXmppClient *client, QObject *parent);
-    void checkData();
     void connectToHosts(const QXmppByteStreamIq &iq);
     bool writeData(const QByteArray &data);
 
 private Q_SLOTS:
-    void _q_candidateDisconnected();
-    void _q_candidateReady();
     void _q_disconnected();
     void _q_receiveData();
 
 private:
-    void connectToNextHost();
+    // stream host being connected to
+    struct Candidate
+    {
+        QXmppByteStreamIq::StreamHost host;
+        QXmppSocksClient *client = nullptr;
+        QElapsedTimer connectTime;
+        // offered by the sender itself instead of a proxy
+        bool direct = false;
+    };
+
+    void connectToNextHosts();
+    void candidateReady(QXmppSocksClient *client);
+    void candidateFailed(QXmppSocksClient *client);
+    void useCandidate(Candidate candidate);
+    void recordConnectTime(const QXmppByteStreamIq::StreamHost &host, qint64 msecs);
 
-    QXmppByteStreamIq::StreamHost m_candidateHost;
-    QXmppSocksClient *m_candidateClient;
-    QTimer *m_candidateTimer;
+    // connections racing each other
+    QVector<Candidate> m_candidates;
+    // proxy that is ready, but direct connections are given some more time
+    Candidate m_readyCandidate;
+    QTimer *m_graceTimer;
+    // stream hosts not tried yet, the most promising first
     QList<QXmppByteStreamIq::StreamHost> m_streamCandidates;
     QString m_streamOfferId;
     QString m_streamOfferFrom;
@@ -66,4 +87,47 @@ private Q_SLOTS:
     void _q_sendData();
 };
 
+//
+// A file transfer using XEP-0234: Jingle File Transfer.
+//
+// The file is sent over a single ICE-UDP component, using a
+// QXmppDatagramChannel for reliable and congestion-controlled delivery.
+//
+class QXmppTransferJingleJob : public QXmppTransferJob
+{
+    Q_OBJECT
+
+public:
+    QXmppTransferJingleJob(const QString &jid, QXmppTransferJob::Direction direction, QXmppClient *client, QObject *parent);
+
+    QXmppIceConnection *connection() const;
+    void sendInitiate();
+    void handleRequest(const QXmppJingleIq &iq);
+    bool handleResponse(const QXmppIq &iq);
+
+private:
+    QXmppJingleIq::Content localContent() const;
+    void handleTransport(const QXmppJingleIq::Content &content);
+    void handleTerminate(const QXmppJingleIq::Reason &reason);
+    void handleStateChanged(QXmppTransferJob::State state);
+    void handleFinished();
+    void sendAck(const QXmppJingleIq &iq);
+    void sendRequest(const QXmppJingleIq &iq);
+    void sendTransportInfo();
+    void sendData();
+    void receiveData(const QByteArray &data);
+
+    QXmppIceConnection *m_connection;
+    QXmppDatagramChannel *m_channel;
+    QString m_contentCreator;
+    QString m_contentName;
+    // actions of the requests that have not been answered yet, by ID
+    QHash<QString, QXmppJingleIq::Action> m_requests;
+    // set once the local transport has been sent with session-initiate or
+    // session-accept
+    bool m_localContentSent = false;
+    bool m_sessionTerminated = false;
+    bool m_waitingForTerminate = false;
+};
+
 #endif
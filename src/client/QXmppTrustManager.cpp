@@ -12,6 +12,39 @@
 using namespace QXmpp;
 using namespace QXmpp::Private;
 
+// Write-through cache of the trust levels by encryption protocol.
+//
+// Every modification increments the generation of the encryption protocol,
+// results of reads started before are not cached, they may be outdated.
+class QXmppTrustManagerPrivate
+{
+public:
+    struct Cache
+    {
+        QHash<QString, QHash<QByteArray, TrustLevel>> trustLevels;
+        quint64 generation = 0;
+    };
+
+    Cache &modifiedCache(const QString &encryption)
+    {
+        auto &cache = caches[encryption];
+        cache.generation++;
+        return cache;
+    }
+
+    void removeKeys(Cache &cache, const QList<QByteArray> &keyIds)
+    {
+        for (auto itr = cache.trustLevels.begin(); itr != cache.trustLevels.end();) {
+            for (const auto &keyId : keyIds) {
+                itr->remove(keyId);
+            }
+            itr = itr->isEmpty() ? cache.trustLevels.erase(itr) : std::next(itr);
+        }
+    }
+
+    QHash<QString, Cache> caches;
+};
+
 ///
 /// \class QXmppTrustManager
 ///
@@ -30,7 +63,8 @@ using namespace QXmpp::Private;
 /// \param trustStorage trust storage implementation
 ///
 QXmppTrustManager::QXmppTrustManager(QXmppTrustStorage *trustStorage)
-    : m_trustStorage(trustStorage)
+    : m_trustStorage(trustStorage),
+      d(std::make_unique<QXmppTrustManagerPrivate>())
 {
 }
 
@@ -115,6 +149,13 @@ QXmppTask<QByteArray> QXmppTrustManager::ownKey(const QString &encryption)
 ///
 QXmppTask<void> QXmppTrustManager::addKeys(const QString &encryption, const QString &keyOwnerJid, const QList<QByteArray> &keyIds, TrustLevel trustLevel)
 {
+    // keys are stored with their trust levels
+    auto &cache = d->modifiedCache(encryption);
+    auto &trustLevels = cache.trustLevels[keyOwnerJid];
+    for (const auto &keyId : keyIds) {
+        trustLevels.insert(keyId, trustLevel);
+    }
+
     return m_trustStorage->addKeys(encryption, keyOwnerJid, keyIds, trustLevel);
 }
 
@@ -126,6 +167,7 @@ QXmppTask<void> QXmppTrustManager::addKeys(const QString &encryption, const QStr
 ///
 QXmppTask<void> QXmppTrustManager::removeKeys(const QString &encryption, const QList<QByteArray> &keyIds)
 {
+    d->removeKeys(d->modifiedCache(encryption), keyIds);
     return m_trustStorage->removeKeys(encryption, keyIds);
 }
 
@@ -137,6 +179,7 @@ QXmppTask<void> QXmppTrustManager::removeKeys(const QString &encryption, const Q
 ///
 QXmppTask<void> QXmppTrustManager::removeKeys(const QString &encryption, const QString &keyOwnerJid)
 {
+    d->modifiedCache(encryption).trustLevels.remove(keyOwnerJid);
     return m_trustStorage->removeKeys(encryption, keyOwnerJid);
 }
 
@@ -147,6 +190,7 @@ QXmppTask<void> QXmppTrustManager::removeKeys(const QString &encryption, const Q
 ///
 QXmppTask<void> QXmppTrustManager::removeKeys(const QString &encryption)
 {
+    d->modifiedCache(encryption).trustLevels.clear();
     return m_trustStorage->removeKeys(encryption);
 }
 
@@ -181,7 +225,20 @@ QXmppTask<QHash<QXmpp::TrustLevel, QMultiHash<QString, QByteArray>>> QXmppTrustM
 ///
 QXmppTask<QHash<QString, QHash<QByteArray, QXmpp::TrustLevel>>> QXmppTrustManager::keys(const QString &encryption, const QList<QString> &keyOwnerJids, QXmpp::TrustLevels trustLevels)
 {
-    return m_trustStorage->keys(encryption, keyOwnerJids, trustLevels);
+    if (trustLevels) {
+        return m_trustStorage->keys(encryption, keyOwnerJids, trustLevels);
+    }
+
+    // all keys of the owners are returned, cache their trust levels
+    const auto generation = d->caches[encryption].generation;
+    return chain<QHash<QString, QHash<QByteArray, TrustLevel>>>(m_trustStorage->keys(encryption, keyOwnerJids), this, [this, encryption, generation](QHash<QString, QHash<QByteArray, TrustLevel>> &&keys) {
+        if (auto &cache = d->caches[encryption]; cache.generation == generation) {
+            for (auto itr = keys.cbegin(); itr != keys.cend(); ++itr) {
+                cache.trustLevels[itr.key()].insert(itr.value());
+            }
+        }
+        return keys;
+    });
 }
 
 ///
@@ -210,6 +267,12 @@ QXmppTask<bool> QXmppTrustManager::hasKey(const QString &encryption, const QStri
 ///
 QXmppTask<void> QXmppTrustManager::setTrustLevel(const QString &encryption, const QMultiHash<QString, QByteArray> &keyIds, TrustLevel trustLevel)
 {
+    // keys that are not stored yet are added with the trust level
+    auto &cache = d->modifiedCache(encryption);
+    for (auto itr = keyIds.cbegin(); itr != keyIds.cend(); ++itr) {
+        cache.trustLevels[itr.key()].insert(itr.value(), trustLevel);
+    }
+
     QXmppPromise<void> promise;
 
     auto future = m_trustStorage->setTrustLevel(encryption, keyIds, trustLevel);
@@ -231,6 +294,12 @@ QXmppTask<void> QXmppTrustManager::setTrustLevel(const QString &encryption, cons
 ///
 QXmppTask<void> QXmppTrustManager::setTrustLevel(const QString &encryption, const QList<QString> &keyOwnerJids, TrustLevel oldTrustLevel, TrustLevel newTrustLevel)
 {
+    // only the storage knows which keys have the old trust level
+    auto &cache = d->modifiedCache(encryption);
+    for (const auto &keyOwnerJid : keyOwnerJids) {
+        cache.trustLevels.remove(keyOwnerJid);
+    }
+
     QXmppPromise<void> promise;
     m_trustStorage->setTrustLevel(encryption, keyOwnerJids, oldTrustLevel, newTrustLevel)
         .then(this, [=](QHash<QString, QMultiHash<QString, QByteArray>> modifiedKeys) mutable {
@@ -254,7 +323,73 @@ QXmppTask<void> QXmppTrustManager::setTrustLevel(const QString &encryption, cons
 ///
 QXmppTask<TrustLevel> QXmppTrustManager::trustLevel(const QString &encryption, const QString &keyOwnerJid, const QByteArray &keyId)
 {
-    return m_trustStorage->trustLevel(encryption, keyOwnerJid, keyId);
+    auto &cache = d->caches[encryption];
+    if (const auto owner = cache.trustLevels.constFind(keyOwnerJid); owner != cache.trustLevels.constEnd()) {
+        if (const auto trustLevel = owner->constFind(keyId); trustLevel != owner->constEnd()) {
+            return makeReadyTask(TrustLevel(*trustLevel));
+        }
+    }
+
+    const auto generation = cache.generation;
+    return chain<TrustLevel>(m_trustStorage->trustLevel(encryption, keyOwnerJid, keyId), this, [this, encryption, keyOwnerJid, keyId, generation](TrustLevel &&trustLevel) {
+        if (auto &cache = d->caches[encryption]; cache.generation == generation) {
+            cache.trustLevels[keyOwnerJid].insert(keyId, trustLevel);
+        }
+        return trustLevel;
+    });
+}
+
+///
+/// Returns the trust levels of several keys at once.
+///
+/// The trust levels are cached, only the keys whose trust levels are not
+/// known yet are requested from the storage, all of them with one request.
+/// That way, e.g. encrypting for many devices does not cause a storage
+/// request per device.
+///
+/// Keys that are not stored have the trust level undecided.
+///
+/// \param encryption encryption protocol namespace
+/// \param keyIds key owners' bare JIDs mapped to the IDs of their keys
+///
+/// \return the key owners' bare JIDs mapped to the IDs of their keys and
+/// their trust levels
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QHash<QString, QHash<QByteArray, TrustLevel>>> QXmppTrustManager::trustLevels(const QString &encryption, const QMultiHash<QString, QByteArray> &keyIds)
+{
+    auto &cache = d->caches[encryption];
+
+    QHash<QString, QHash<QByteArray, TrustLevel>> trustLevels;
+    QMultiHash<QString, QByteArray> missingKeyIds;
+    for (auto itr = keyIds.cbegin(); itr != keyIds.cend(); ++itr) {
+        const auto owner = cache.trustLevels.constFind(itr.key());
+        if (owner != cache.trustLevels.constEnd()) {
+            if (const auto trustLevel = owner->constFind(itr.value()); trustLevel != owner->constEnd()) {
+                trustLevels[itr.key()].insert(itr.value(), *trustLevel);
+                continue;
+            }
+        }
+        missingKeyIds.insert(itr.key(), itr.value());
+    }
+
+    if (missingKeyIds.isEmpty()) {
+        return makeReadyTask(std::move(trustLevels));
+    }
+
+    const auto generation = cache.generation;
+    return chain<QHash<QString, QHash<QByteArray, TrustLevel>>>(m_trustStorage->trustLevels(encryption, missingKeyIds), this, [this, encryption, generation, trustLevels = std::move(trustLevels)](QHash<QString, QHash<QByteArray, TrustLevel>> &&storedTrustLevels) mutable {
+        auto &cache = d->caches[encryption];
+        const bool isCurrent = cache.generation == generation;
+        for (auto itr = storedTrustLevels.cbegin(); itr != storedTrustLevels.cend(); ++itr) {
+            trustLevels[itr.key()].insert(itr.value());
+            if (isCurrent) {
+                cache.trustLevels[itr.key()].insert(itr.value());
+            }
+        }
+        return trustLevels;
+    });
 }
 
 ///
@@ -264,6 +399,7 @@ QXmppTask<TrustLevel> QXmppTrustManager::trustLevel(const QString &encryption, c
 ///
 QXmppTask<void> QXmppTrustManager::resetAll(const QString &encryption)
 {
+    d->modifiedCache(encryption).trustLevels.clear();
     return m_trustStorage->resetAll(encryption);
 }
 
@@ -9,9 +9,12 @@
 #include "QXmppTrustLevel.h"
 #include "QXmppTrustSecurityPolicy.h"
 
+#include <memory>
+
 template<typename T>
 class QXmppTask;
 
+class QXmppTrustManagerPrivate;
 class QXmppTrustStorage;
 
 class QXMPP_EXPORT QXmppTrustManager : public QXmppClientExtension
@@ -41,6 +44,7 @@ public:
     QXmppTask<void> setTrustLevel(const QString &encryption, const QMultiHash<QString, QByteArray> &keyIds, QXmpp::TrustLevel trustLevel);
     QXmppTask<void> setTrustLevel(const QString &encryption, const QList<QString> &keyOwnerJids, QXmpp::TrustLevel oldTrustLevel, QXmpp::TrustLevel newTrustLevel);
     QXmppTask<QXmpp::TrustLevel> trustLevel(const QString &encryption, const QString &keyOwnerJid, const QByteArray &keyId);
+    QXmppTask<QHash<QString, QHash<QByteArray, QXmpp::TrustLevel>>> trustLevels(const QString &encryption, const QMultiHash<QString, QByteArray> &keyIds);
 
     QXmppTask<void> resetAll(const QString &encryption);
 
@@ -56,6 +60,7 @@ protected:
 
 private:
     QXmppTrustStorage *m_trustStorage;
+    const std::unique_ptr<QXmppTrustManagerPrivate> d;
 };
 
 #endif  // QXMPPTRUSTMANAGER_H
@@ -6,7 +6,10 @@
 
 #include "QXmppFutureUtils_p.h"
 
+#include <optional>
+
 #include <QMultiHash>
+#include <QSet>
 
 using namespace QXmpp;
 using namespace QXmpp::Private;
@@ -22,11 +25,83 @@ using namespace QXmpp::Private;
 /// \since QXmpp 1.5
 ///
 
-struct Key
+// keys of one encryption protocol, indexed by every attribute they are looked up by
+struct Keys
 {
-    QByteArray id;
-    QString ownerJid;
-    TrustLevel trustLevel;
+    std::optional<TrustLevel> trustLevel(const QString &ownerJid, const QByteArray &id) const
+    {
+        if (const auto owner = byOwnerJid.constFind(ownerJid); owner != byOwnerJid.constEnd()) {
+            if (const auto itr = owner->constFind(id); itr != owner->constEnd()) {
+                return *itr;
+            }
+        }
+        return {};
+    }
+
+    void insert(const QString &ownerJid, const QByteArray &id, TrustLevel trustLevel)
+    {
+        auto &ownerKeys = byOwnerJid[ownerJid];
+        if (const auto itr = ownerKeys.find(id); itr != ownerKeys.end()) {
+            if (*itr == trustLevel) {
+                return;
+            }
+            removeFromTrustLevel(ownerJid, id, *itr);
+            *itr = trustLevel;
+        } else {
+            ownerKeys.insert(id, trustLevel);
+            ownerJidsById[id].insert(ownerJid);
+        }
+        byTrustLevel[trustLevel][ownerJid].insert(id);
+    }
+
+    void remove(const QString &ownerJid, const QByteArray &id)
+    {
+        const auto owner = byOwnerJid.find(ownerJid);
+        if (owner == byOwnerJid.end()) {
+            return;
+        }
+        const auto key = owner->find(id);
+        if (key == owner->end()) {
+            return;
+        }
+
+        removeFromTrustLevel(ownerJid, id, *key);
+        owner->erase(key);
+        if (owner->isEmpty()) {
+            byOwnerJid.erase(owner);
+        }
+
+        if (const auto ownerJids = ownerJidsById.find(id); ownerJids != ownerJidsById.end()) {
+            ownerJids->remove(ownerJid);
+            if (ownerJids->isEmpty()) {
+                ownerJidsById.erase(ownerJids);
+            }
+        }
+    }
+
+    void removeFromTrustLevel(const QString &ownerJid, const QByteArray &id, TrustLevel trustLevel)
+    {
+        const auto level = byTrustLevel.find(trustLevel);
+        if (level == byTrustLevel.end()) {
+            return;
+        }
+        if (const auto owner = level->find(ownerJid); owner != level->end()) {
+            owner->remove(id);
+            if (owner->isEmpty()) {
+                level->erase(owner);
+            }
+        }
+        if (level->isEmpty()) {
+            byTrustLevel.erase(level);
+        }
+    }
+
+    // key owners' bare JIDs mapped to the IDs of their keys and their trust levels
+    QHash<QString, QHash<QByteArray, TrustLevel>> byOwnerJid;
+    // key IDs mapped to the bare JIDs of their owners
+    QHash<QByteArray, QSet<QString>> ownerJidsById;
+    // trust levels mapped to key owners' bare JIDs and the IDs of their keys
+    QHash<TrustLevel, QHash<QString, QSet<QByteArray>>> byTrustLevel;
 };
 
 class QXmppTrustMemoryStoragePrivate
@@ -39,7 +114,7 @@ public:
     QMap<QString, QByteArray> ownKeys;
 
     // encryption protocols mapped to keys with specified trust levels
-    QMultiHash<QString, Key> keys;
+    QHash<QString, Keys> keys;
 };
 
 ///
@@ -90,12 +165,9 @@ QXmppTask<QByteArray> QXmppTrustMemoryStorage::ownKey(const QString &encryption)
 
 QXmppTask<void> QXmppTrustMemoryStorage::addKeys(const QString &encryption, const QString &keyOwnerJid, const QList<QByteArray> &keyIds, TrustLevel trustLevel)
 {
+    auto &keys = d->keys[encryption];
     for (const auto &keyId : keyIds) {
-        Key key;
-        key.id = keyId;
-        key.ownerJid = keyOwnerJid;
-        key.trustLevel = trustLevel;
-        d->keys.insert(encryption, key);
+        keys.insert(keyOwnerJid, keyId, trustLevel);
     }
 
     return makeReadyTask();
@@ -103,12 +175,12 @@ QXmppTask<void> QXmppTrustMemoryStorage::addKeys(const QString &encryption, cons
 
 QXmppTask<void> QXmppTrustMemoryStorage::removeKeys(const QString &encryption, const QList<QByteArray> &keyIds)
 {
-    for (auto itr = d->keys.find(encryption);
-         itr != d->keys.end() && itr.key() == encryption;) {
-        if (keyIds.contains(itr.value().id)) {
-            itr = d->keys.erase(itr);
-        } else {
-            ++itr;
+    if (const auto keys = d->keys.find(encryption); keys != d->keys.end()) {
+        for (const auto &keyId : keyIds) {
+            const auto keyOwnerJids = keys->ownerJidsById.value(keyId);
+            for (const auto &keyOwnerJid : keyOwnerJids) {
+                keys->remove(keyOwnerJid, keyId);
+            }
         }
     }
 
@@ -117,12 +189,10 @@ QXmppTask<void> QXmppTrustMemoryStorage::removeKeys(const QString &encryption, c
 
 QXmppTask<void> QXmppTrustMemoryStorage::removeKeys(const QString &encryption, const QString &keyOwnerJid)
 {
-    for (auto itr = d->keys.find(encryption);
-         itr != d->keys.end() && itr.key() == encryption;) {
-        if (itr.value().ownerJid == keyOwnerJid) {
-            itr = d->keys.erase(itr);
-        } else {
-            ++itr;
+    if (const auto keys = d->keys.find(encryption); keys != d->keys.end()) {
+        const auto keyIds = keys->byOwnerJid.value(keyOwnerJid).keys();
+        for (const auto &keyId : keyIds) {
+            keys->remove(keyOwnerJid, keyId);
         }
     }
 
@@ -139,11 +209,16 @@ QXmppTask<QHash<TrustLevel, QMultiHash<QString, QByteArray>>> QXmppTrustMemorySt
 {
     QHash<TrustLevel, QMultiHash<QString, QByteArray>> keys;
 
-    const auto storedKeys = d->keys.values(encryption);
-    for (const auto &key : storedKeys) {
-        const auto trustLevel = key.trustLevel;
-        if (trustLevels.testFlag(trustLevel) || !trustLevels) {
-            keys[trustLevel].insert(key.ownerJid, key.id);
+    if (const auto storedKeys = d->keys.constFind(encryption); storedKeys != d->keys.constEnd()) {
+        for (auto level = storedKeys->byTrustLevel.cbegin(); level != storedKeys->byTrustLevel.cend(); ++level) {
+            if (trustLevels.testFlag(level.key()) || !trustLevels) {
+                auto &levelKeys = keys[level.key()];
+                for (auto owner = level->cbegin(); owner != level->cend(); ++owner) {
+                    for (const auto &keyId : owner.value()) {
+                        levelKeys.insert(owner.key(), keyId);
+                    }
+                }
+            }
         }
     }
 
@@ -154,12 +229,23 @@ QXmppTask<QHash<QString, QHash<QByteArray, TrustLevel>>> QXmppTrustMemoryStorage
 {
     QHash<QString, QHash<QByteArray, TrustLevel>> keys;
 
-    const auto storedKeys = d->keys.values(encryption);
-    for (const auto &key : storedKeys) {
-        const auto keyOwnerJid = key.ownerJid;
-        const auto trustLevel = key.trustLevel;
-        if (keyOwnerJids.contains(keyOwnerJid) && (trustLevels.testFlag(trustLevel) || !trustLevels)) {
-            keys[keyOwnerJid].insert(key.id, trustLevel);
+    if (const auto storedKeys = d->keys.constFind(encryption); storedKeys != d->keys.constEnd()) {
+        for (const auto &keyOwnerJid : keyOwnerJids) {
+            const auto owner = storedKeys->byOwnerJid.constFind(keyOwnerJid);
+            if (owner == storedKeys->byOwnerJid.constEnd()) {
+                continue;
+            }
+
+            if (!trustLevels) {
+                keys.insert(keyOwnerJid, *owner);
+                continue;
+            }
+
+            for (auto itr = owner->cbegin(); itr != owner->cend(); ++itr) {
+                if (trustLevels.testFlag(itr.value())) {
+                    keys[keyOwnerJid].insert(itr.key(), itr.value());
+                }
+            }
         }
     }
 
@@ -168,10 +254,11 @@ QXmppTask<QHash<QString, QHash<QByteArray, TrustLevel>>> QXmppTrustMemoryStorage
 
 QXmppTask<bool> QXmppTrustMemoryStorage::hasKey(const QString &encryption, const QString &keyOwnerJid, TrustLevels trustLevels)
 {
-    const auto storedKeys = d->keys.values(encryption);
-    for (const auto &key : storedKeys) {
-        if (key.ownerJid == keyOwnerJid && trustLevels.testFlag(key.trustLevel)) {
-            return makeReadyTask(std::move(true));
+    if (const auto storedKeys = d->keys.constFind(encryption); storedKeys != d->keys.constEnd()) {
+        for (auto level = storedKeys->byTrustLevel.cbegin(); level != storedKeys->byTrustLevel.cend(); ++level) {
+            if (trustLevels.testFlag(level.key()) && level->contains(keyOwnerJid)) {
+                return makeReadyTask(std::move(true));
+            }
         }
     }
 
@@ -182,35 +269,15 @@ QXmppTask<QHash<QString, QMultiHash<QString, QByteArray>>> QXmppTrustMemoryStora
 {
     QHash<QString, QMultiHash<QString, QByteArray>> modifiedKeys;
 
+    auto &keys = d->keys[encryption];
     for (auto itr = keyIds.constBegin(); itr != keyIds.constEnd(); ++itr) {
-        const auto keyOwnerJid = itr.key();
-        const auto keyId = itr.value();
-
-        auto isKeyFound = false;
-
-        for (auto itrKeys = d->keys.find(encryption);
-             itrKeys != d->keys.end() && itrKeys.key() == encryption;
-             ++itrKeys) {
-            auto &key = itrKeys.value();
-            if (key.id == keyId && key.ownerJid == keyOwnerJid) {
-                // Update the stored trust level if it differs from the new one.
-                if (key.trustLevel != trustLevel) {
-                    key.trustLevel = trustLevel;
-                    modifiedKeys[encryption].insert(keyOwnerJid, keyId);
-                }
-
-                isKeyFound = true;
-                break;
-            }
-        }
+        const auto &keyOwnerJid = itr.key();
+        const auto &keyId = itr.value();
 
-        // Create a new entry and store it if there is no such entry yet.
-        if (!isKeyFound) {
-            Key key;
-            key.id = keyId;
-            key.ownerJid = keyOwnerJid;
-            key.trustLevel = trustLevel;
-            d->keys.insert(encryption, key);
+        // Update the stored trust level if it differs from the new one or
+        // create a new entry if there is no such entry yet.
+        if (keys.trustLevel(keyOwnerJid, keyId) != trustLevel) {
+            keys.insert(keyOwnerJid, keyId, trustLevel);
             modifiedKeys[encryption].insert(keyOwnerJid, keyId);
         }
     }
@@ -222,12 +289,17 @@ QXmppTask<QHash<QString, QMultiHash<QString, QByteArray>>> QXmppTrustMemoryStora
 {
     QHash<QString, QMultiHash<QString, QByteArray>> modifiedKeys;
 
-    for (auto itr = d->keys.find(encryption); itr != d->keys.end() && itr.key() == encryption; ++itr) {
-        auto &key = itr.value();
-        auto keyOwnerJid = key.ownerJid;
-        if (keyOwnerJids.contains(keyOwnerJid) && key.trustLevel == oldTrustLevel) {
-            key.trustLevel = newTrustLevel;
-            modifiedKeys[encryption].insert(keyOwnerJid, key.id);
+    const auto keys = d->keys.find(encryption);
+    if (keys == d->keys.end() || oldTrustLevel == newTrustLevel) {
+        return makeReadyTask(std::move(modifiedKeys));
+    }
+
+    for (const auto &keyOwnerJid : keyOwnerJids) {
+        // copied since the keys are moved to another trust level while iterating
+        const auto keyIds = keys->byTrustLevel.value(oldTrustLevel).value(keyOwnerJid);
+        for (const auto &keyId : keyIds) {
+            keys->insert(keyOwnerJid, keyId, newTrustLevel);
+            modifiedKeys[encryption].insert(keyOwnerJid, keyId);
         }
     }
 
@@ -236,16 +308,31 @@ QXmppTask<QHash<QString, QMultiHash<QString, QByteArray>>> QXmppTrustMemoryStora
 
 QXmppTask<TrustLevel> QXmppTrustMemoryStorage::trustLevel(const QString &encryption, const QString &keyOwnerJid, const QByteArray &keyId)
 {
-    const auto keys = d->keys.values(encryption);
-    for (const auto &key : keys) {
-        if (key.id == keyId && key.ownerJid == keyOwnerJid) {
-            return makeReadyTask(std::move(TrustLevel(key.trustLevel)));
+    if (const auto keys = d->keys.constFind(encryption); keys != d->keys.constEnd()) {
+        if (const auto trustLevel = keys->trustLevel(keyOwnerJid, keyId)) {
+            return makeReadyTask(TrustLevel(*trustLevel));
         }
     }
 
     return makeReadyTask(std::move(TrustLevel::Undecided));
 }
 
+QXmppTask<QHash<QString, QHash<QByteArray, TrustLevel>>> QXmppTrustMemoryStorage::trustLevels(const QString &encryption, const QMultiHash<QString, QByteArray> &keyIds)
+{
+    QHash<QString, QHash<QByteArray, TrustLevel>> trustLevels;
+
+    const auto keys = d->keys.constFind(encryption);
+    for (auto itr = keyIds.constBegin(); itr != keyIds.constEnd(); ++itr) {
+        std::optional<TrustLevel> trustLevel;
+        if (keys != d->keys.constEnd()) {
+            trustLevel = keys->trustLevel(itr.key(), itr.value());
+        }
+        trustLevels[itr.key()].insert(itr.value(), trustLevel.value_or(TrustLevel::Undecided));
+    }
+
+    return makeReadyTask(std::move(trustLevels));
+}
+
 QXmppTask<void> QXmppTrustMemoryStorage::resetAll(const QString &encryption)
 {
     d->securityPolicies.remove(encryption);
@@ -37,6 +37,7 @@ public:
     QXmppTask<QHash<QString, QMultiHash<QString, QByteArray>>> setTrustLevel(const QString &encryption, const QMultiHash<QString, QByteArray> &keyIds, QXmpp::TrustLevel trustLevel) override;
     QXmppTask<QHash<QString, QMultiHash<QString, QByteArray>>> setTrustLevel(const QString &encryption, const QList<QString> &keyOwnerJids, QXmpp::TrustLevel oldTrustLevel, QXmpp::TrustLevel newTrustLevel) override;
     QXmppTask<QXmpp::TrustLevel> trustLevel(const QString &encryption, const QString &keyOwnerJid, const QByteArray &keyId) override;
+    QXmppTask<QHash<QString, QHash<QByteArray, QXmpp::TrustLevel>>> trustLevels(const QString &encryption, const QMultiHash<QString, QByteArray> &keyIds) override;
 
     QXmppTask<void> resetAll(const QString &encryption) override;
     /// \endcond
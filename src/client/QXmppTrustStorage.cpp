@@ -2,6 +2,13 @@
 //
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#include "QXmppTrustStorage.h"
+
+#include "QXmppPromise.h"
+#include "QXmppTask.h"
+
+using namespace QXmpp;
+
 ///
 /// \class QXmppTrustStorage
 ///
@@ -194,6 +201,37 @@
 /// \return the key's trust level
 ///
 
+///
+/// Returns the trust levels of several keys at once.
+///
+/// Keys that are not stored have the trust level undecided, like for
+/// trustLevel().
+///
+/// The default implementation requests all keys of the key owners with one
+/// call of keys(). Storages that can look up the keys directly, e.g. with a
+/// single database query, should override it.
+///
+/// \param encryption encryption protocol namespace
+/// \param keyIds key owners' bare JIDs mapped to the IDs of their keys
+///
+/// \return the key owners' bare JIDs mapped to the IDs of their keys and
+/// their trust levels
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QHash<QString, QHash<QByteArray, TrustLevel>>> QXmppTrustStorage::trustLevels(const QString &encryption, const QMultiHash<QString, QByteArray> &keyIds)
+{
+    QXmppPromise<QHash<QString, QHash<QByteArray, TrustLevel>>> promise;
+    keys(encryption, keyIds.uniqueKeys()).then(nullptr, [promise, keyIds](QHash<QString, QHash<QByteArray, TrustLevel>> &&storedKeys) mutable {
+        QHash<QString, QHash<QByteArray, TrustLevel>> trustLevels;
+        for (auto itr = keyIds.constBegin(); itr != keyIds.constEnd(); ++itr) {
+            trustLevels[itr.key()].insert(itr.value(), storedKeys.value(itr.key()).value(itr.value(), TrustLevel::Undecided));
+        }
+        promise.finish(std::move(trustLevels));
+    });
+    return promise.task();
+}
+
 ///
 /// \fn QXmppTrustStorage::resetAll(const QString &encryption)
 ///
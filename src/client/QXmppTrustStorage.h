@@ -36,6 +36,7 @@ public:
     virtual QXmppTask<QHash<QString, QMultiHash<QString, QByteArray>>> setTrustLevel(const QString &encryption, const QMultiHash<QString, QByteArray> &keyIds, QXmpp::TrustLevel trustLevel) = 0;
     virtual QXmppTask<QHash<QString, QMultiHash<QString, QByteArray>>> setTrustLevel(const QString &encryption, const QList<QString> &keyOwnerJids, QXmpp::TrustLevel oldTrustLevel, QXmpp::TrustLevel newTrustLevel) = 0;
     virtual QXmppTask<QXmpp::TrustLevel> trustLevel(const QString &encryption, const QString &keyOwnerJid, const QByteArray &keyId) = 0;
+    virtual QXmppTask<QHash<QString, QHash<QByteArray, QXmpp::TrustLevel>>> trustLevels(const QString &encryption, const QMultiHash<QString, QByteArray> &keyIds);
 
     virtual QXmppTask<void> resetAll(const QString &encryption) = 0;
 };
@@ -5,16 +5,22 @@
 #include "QXmppUploadRequestManager.h"
 
 #include "QXmppClient.h"
+#include "QXmppConfiguration.h"
 #include "QXmppConstants_p.h"
 #include "QXmppDataForm.h"
 #include "QXmppDiscoveryIq.h"
 #include "QXmppDiscoveryManager.h"
 #include "QXmppFutureUtils_p.h"
 #include "QXmppHttpUploadIq.h"
+#include "QXmppPromise.h"
+
+#include <algorithm>
+#include <optional>
 
 #include <QDomElement>
 #include <QFileInfo>
 #include <QMimeDatabase>
+#include <QTimer>
 
 using namespace QXmpp::Private;
 
@@ -72,12 +78,52 @@ void QXmppUploadService::setSizeLimit(qint64 sizeLimit)
     d->sizeLimit = sizeLimit;
 }
 
+// unused prefetched slots are dropped, services only accept uploads for a limited time
+constexpr int PrefetchedSlotTimeout = 60 * 1000;
+
+struct PrefetchedSlot
+{
+    quint64 id;
+    QString service;
+    QString fileName;
+    qint64 fileSize;
+    QString mimeType;
+    std::optional<QXmppUploadRequestManager::SlotResult> result;
+    // set when the slot has been requested before the response arrived
+    std::optional<QXmppPromise<QXmppUploadRequestManager::SlotResult>> promise;
+};
+
 class QXmppUploadRequestManagerPrivate : public QSharedData
 {
 public:
+    QString selectService(qint64 fileSize) const;
+    std::vector<PrefetchedSlot>::iterator findPrefetchedSlot(quint64 id);
+
     QVector<QXmppUploadService> uploadServices;
+    // domain of the account the services have been discovered for
+    QString servicesDomain;
+    std::vector<PrefetchedSlot> prefetchedSlots;
+    quint64 prefetchCounter = 0;
 };
 
+// Returns the first service that accepts the size or the first service if none does.
+QString QXmppUploadRequestManagerPrivate::selectService(qint64 fileSize) const
+{
+    for (const auto &service : uploadServices) {
+        if (service.sizeLimit() < 0 || service.sizeLimit() >= fileSize) {
+            return service.jid();
+        }
+    }
+    return uploadServices.first().jid();
+}
+
+std::vector<PrefetchedSlot>::iterator QXmppUploadRequestManagerPrivate::findPrefetchedSlot(quint64 id)
+{
+    return std::find_if(prefetchedSlots.begin(), prefetchedSlots.end(), [id](const auto &slot) {
+        return slot.id == id;
+    });
+}
+
 ///
 /// \typedef QXmppUploadRequestManager::SlotResult
 ///
@@ -156,11 +202,7 @@ QString QXmppUploadRequestManager::requestUploadSlot(const QString &fileName,
     }
 
     QXmppHttpUploadRequestIq iq;
-    if (uploadService.isEmpty()) {
-        iq.setTo(d->uploadServices.first().jid());
-    } else {
-        iq.setTo(uploadService);
-    }
+    iq.setTo(uploadService.isEmpty() ? d->selectService(fileSize) : uploadService);
     iq.setType(QXmppIq::Get);
     iq.setFileName(fileName);
     iq.setSize(fileSize);
@@ -224,7 +266,10 @@ auto QXmppUploadRequestManager::requestSlot(const QFileInfo &file,
 ///                 server to set the HTTP MIME-type of the URL.
 /// \param uploadService The HTTP File Upload service that is used to request
 ///                      the upload slot. If this is empty, the first
-///                      discovered one is used.
+///                      discovered one that accepts the file size is used.
+///
+/// If a slot for the same file has been prefetched, it is returned without
+/// sending a new request.
 ///
 /// \warning THIS API IS NOT FINALIZED YET!
 ///
@@ -240,12 +285,24 @@ auto QXmppUploadRequestManager::requestSlot(const QString &fileName,
             QStringLiteral("Couldn't request upload slot: No service found."), {} }));
     }
 
-    QXmppHttpUploadRequestIq iq;
-    if (uploadService.isEmpty()) {
-        iq.setTo(d->uploadServices.first().jid());
-    } else {
-        iq.setTo(uploadService);
+    const auto service = uploadService.isEmpty() ? d->selectService(fileSize) : uploadService;
+
+    auto prefetched = std::find_if(d->prefetchedSlots.begin(), d->prefetchedSlots.end(), [&](const auto &slot) {
+        return slot.service == service && slot.fileName == fileName && slot.fileSize == fileSize &&
+            slot.mimeType == mimeType.name() && !slot.promise;
+    });
+    if (prefetched != d->prefetchedSlots.end()) {
+        if (prefetched->result) {
+            auto result = std::move(*prefetched->result);
+            d->prefetchedSlots.erase(prefetched);
+            return makeReadyTask(std::move(result));
+        }
+        // the response is handed over when it arrives
+        return prefetched->promise.emplace().task();
     }
+
+    QXmppHttpUploadRequestIq iq;
+    iq.setTo(service);
     iq.setType(QXmppIq::Get);
     iq.setFileName(fileName);
     iq.setSize(fileSize);
@@ -254,6 +311,71 @@ auto QXmppUploadRequestManager::requestSlot(const QString &fileName,
     return chainIq<SlotResult>(client()->sendIq(std::move(iq)), this);
 }
 
+///
+/// Requests an upload slot in advance, so a later requestSlot() for the same
+/// file does not need to wait for the service.
+///
+/// This is useful if the file is known before the upload is started, e.g.
+/// while the user is writing a message for an attached image. The slot is
+/// bound to the file name, size and content-type, so requestSlot() must be
+/// called with the same values to use it.
+///
+/// The slot is dropped if it has not been used within one minute, because
+/// services only accept uploads to a slot for a limited time. Failed requests
+/// are not kept.
+///
+/// \param fileName The name of the file to be uploaded.
+/// \param fileSize The size of the file to be uploaded.
+/// \param mimeType The content-type of the file.
+/// \param uploadService The HTTP File Upload service that is used to request
+///                      the upload slot. If this is empty, the first
+///                      discovered one that accepts the file size is used.
+///
+/// \since QXmpp 1.6
+///
+void QXmppUploadRequestManager::prefetchSlot(const QString &fileName,
+                                             qint64 fileSize,
+                                             const QMimeType &mimeType,
+                                             const QString &uploadService)
+{
+    if (!serviceFound() && uploadService.isEmpty()) {
+        return;
+    }
+
+    const auto id = d->prefetchCounter++;
+    const auto service = uploadService.isEmpty() ? d->selectService(fileSize) : uploadService;
+    d->prefetchedSlots.push_back(PrefetchedSlot { id, service, fileName, fileSize, mimeType.name(), {}, {} });
+
+    QXmppHttpUploadRequestIq iq;
+    iq.setTo(service);
+    iq.setType(QXmppIq::Get);
+    iq.setFileName(fileName);
+    iq.setSize(fileSize);
+    iq.setContentType(mimeType);
+
+    chainIq<SlotResult>(client()->sendIq(std::move(iq)), this).then(this, [this, id](SlotResult &&result) {
+        auto slot = d->findPrefetchedSlot(id);
+        if (slot == d->prefetchedSlots.end()) {
+            return;
+        }
+
+        if (slot->promise) {
+            auto promise = std::move(*slot->promise);
+            d->prefetchedSlots.erase(slot);
+            promise.finish(std::move(result));
+        } else if (std::holds_alternative<QXmppError>(result)) {
+            d->prefetchedSlots.erase(slot);
+        } else {
+            slot->result = std::move(result);
+            QTimer::singleShot(PrefetchedSlotTimeout, this, [this, id]() {
+                if (auto slot = d->findPrefetchedSlot(id); slot != d->prefetchedSlots.end() && !slot->promise) {
+                    d->prefetchedSlots.erase(slot);
+                }
+            });
+        }
+    });
+}
+
 /// Returns true if an HTTP File Upload service has been discovered.
 
 bool QXmppUploadRequestManager::serviceFound() const
@@ -310,7 +432,17 @@ void QXmppUploadRequestManager::handleDiscoInfo(const QXmppDiscoveryIq &iq)
                 }
             }
 
+            auto existing = std::find_if(d->uploadServices.begin(), d->uploadServices.end(), [&](const auto &other) {
+                return other.jid() == service.jid();
+            });
+            if (existing != d->uploadServices.end()) {
+                // rediscovered after reconnecting
+                existing->setSizeLimit(service.sizeLimit());
+                continue;
+            }
+
             d->uploadServices.append(service);
+            d->servicesDomain = client()->configuration().domain();
             Q_EMIT serviceFoundChanged();
         }
     }
@@ -326,11 +458,23 @@ void QXmppUploadRequestManager::setClient(QXmppClient *client)
         // scan info of all entities for upload services
         connect(disco, &QXmppDiscoveryManager::infoReceived,
                 this, &QXmppUploadRequestManager::handleDiscoInfo);
+        // and the shared discovery of the server, if enabled
+        connect(disco, &QXmppDiscoveryManager::serverDiscoveryFinished, this, [this, disco]() {
+            if (const auto discovery = disco->serverDiscovery()) {
+                handleDiscoInfo(discovery->serverInfo);
+                for (const auto &info : discovery->itemsInfo) {
+                    handleDiscoInfo(info);
+                }
+            }
+        });
 
-        // on client disconnect remove all upload services
-        connect(client, &QXmppClient::disconnected, this, [this]() {
-            d->uploadServices.clear();
-            Q_EMIT serviceFoundChanged();
+        // the services are kept across reconnects, so uploads don't need to
+        // wait for the discovery, unless the client connects to another server
+        connect(client, &QXmppClient::connected, this, [this, client]() {
+            if (!d->uploadServices.isEmpty() && d->servicesDomain != client->configuration().domain()) {
+                d->uploadServices.clear();
+                Q_EMIT serviceFoundChanged();
+            }
         });
     }
 }
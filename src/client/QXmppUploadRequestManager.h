@@ -110,6 +110,11 @@ public:
                                       const QMimeType &mimeType,
                                       const QString &uploadService = {});
 
+    void prefetchSlot(const QString &fileName,
+                      qint64 fileSize,
+                      const QMimeType &mimeType,
+                      const QString &uploadService = {});
+
     bool serviceFound() const;
 
     QVector<QXmppUploadService> uploadServices() const;
@@ -85,6 +85,9 @@ auto QXmppUserLocationManager::request(const QString &jid)
 ///
 /// Publishes User Location information on the user's account.
 ///
+/// Frequent updates can be limited with
+/// QXmppPubSubManager::setPepPublishInterval().
+///
 /// \param item The User Location item to be published.
 ///
 auto QXmppUserLocationManager::publish(const QXmppGeolocItem &item)
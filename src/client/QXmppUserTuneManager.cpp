@@ -86,6 +86,9 @@ auto QXmppUserTuneManager::request(const QString &jid)
 ///
 /// Publishes User Tune information on the user's account.
 ///
+/// Frequent updates can be limited with
+/// QXmppPubSubManager::setPepPublishInterval().
+///
 /// \param item The User Tune item to be published.
 ///
 auto QXmppUserTuneManager::publish(const QXmppTuneItem &item)
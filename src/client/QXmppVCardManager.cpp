@@ -6,16 +6,52 @@
 
 #include "QXmppClient.h"
 #include "QXmppConstants_p.h"
+#include "QXmppFutureUtils_p.h"
+#include "QXmppPresence.h"
 #include "QXmppUtils.h"
 #include "QXmppVCardIq.h"
 
+#include <QCryptographicHash>
+#include <QHash>
+
+using namespace QXmpp::Private;
+
+struct CachedVCard
+{
+    QXmppVCardIq vCard;
+    // SHA-1 of the photo or empty if there is no photo, as in XEP-0153
+    QByteArray photoHash;
+};
+
 class QXmppVCardManagerPrivate
 {
 public:
+    void cache(const QString &bareJid, const QXmppVCardIq &vCard);
+    bool isCurrent(const QString &bareJid, const CachedVCard &cached) const;
+
     QXmppVCardIq clientVCard;
     bool isClientVCardReceived;
+
+    QHash<QString, CachedVCard> vCards;
+    // last photo hashes advertised via presence
+    QHash<QString, QByteArray> photoHashes;
+    QHash<QString, QVector<QXmppPromise<QXmppVCardManager::VCardResult>>> pendingRequests;
 };
 
+void QXmppVCardManagerPrivate::cache(const QString &bareJid, const QXmppVCardIq &vCard)
+{
+    const auto photo = vCard.photo();
+    vCards.insert(bareJid, { vCard, photo.isEmpty() ? QByteArray() : QCryptographicHash::hash(photo, QCryptographicHash::Sha1) });
+}
+
+// A cached vCard is outdated if the contact has advertised another photo
+// since it has been received.
+bool QXmppVCardManagerPrivate::isCurrent(const QString &bareJid, const CachedVCard &cached) const
+{
+    const auto hash = photoHashes.constFind(bareJid);
+    return hash == photoHashes.constEnd() || *hash == cached.photoHash;
+}
+
 QXmppVCardManager::QXmppVCardManager()
     : d(std::make_unique<QXmppVCardManagerPrivate>())
 {
@@ -39,6 +75,62 @@ QString QXmppVCardManager::requestVCard(const QString &jid)
     }
 }
 
+///
+/// Returns the vCard of the given bare JID.
+///
+/// The vCard is only requested if it is not cached yet or if the contact has
+/// advertised another photo via \xep{0153, vCard-Based Avatars} in its
+/// presence since it has been cached. Concurrent requests for the same JID
+/// share one request.
+///
+/// The cached vCards share their photo data with the returned ones.
+///
+/// In contrast to requestVCard(), vCardReceived() is not emitted.
+///
+/// \param bareJid JID of the contact, the own bare JID for the own vCard
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QXmppVCardManager::VCardResult> QXmppVCardManager::fetchVCard(const QString &bareJid)
+{
+    if (const auto itr = d->vCards.constFind(bareJid); itr != d->vCards.constEnd() && d->isCurrent(bareJid, *itr)) {
+        return makeReadyTask<VCardResult>(itr->vCard);
+    }
+
+    QXmppPromise<VCardResult> promise;
+    auto task = promise.task();
+
+    auto &waiting = d->pendingRequests[bareJid];
+    waiting.push_back(std::move(promise));
+    if (waiting.size() > 1) {
+        return task;
+    }
+
+    client()->sendIq(QXmppVCardIq(bareJid)).then(this, [this, bareJid](QXmppClient::IqResult &&result) {
+        const auto vCardResult = parseIq<QXmppVCardIq, VCardResult>(std::move(result));
+        if (const auto *vCard = std::get_if<QXmppVCardIq>(&vCardResult)) {
+            d->cache(bareJid, *vCard);
+        }
+
+        const auto promises = d->pendingRequests.take(bareJid);
+        for (auto promise : promises) {
+            promise.finish(VCardResult(vCardResult));
+        }
+    });
+    return task;
+}
+
+///
+/// Removes all cached vCards.
+///
+/// \since QXmpp 1.6
+///
+void QXmppVCardManager::clearVCardCache()
+{
+    d->vCards.clear();
+    d->photoHashes.clear();
+}
+
 /// Returns the vCard of the connected client.
 ///
 /// \return QXmppVCard
@@ -59,6 +151,8 @@ void QXmppVCardManager::setClientVCard(const QXmppVCardIq &clientVCard)
     d->clientVCard.setFrom("");
     d->clientVCard.setType(QXmppIq::Set);
     client()->sendPacket(d->clientVCard);
+
+    d->cache(client()->configuration().jidBare(), d->clientVCard);
 }
 
 /// This function requests the server for vCard of the connected user itself.
@@ -86,6 +180,13 @@ QStringList QXmppVCardManager::discoveryFeatures() const
     return QStringList() << ns_vcard;
 }
 
+QVector<QXmppClientExtension::StanzaFilter> QXmppVCardManager::stanzaFilters() const
+{
+    return {
+        { QStringLiteral("iq"), ns_vcard },
+    };
+}
+
 bool QXmppVCardManager::handleStanza(const QDomElement &element)
 {
     if (element.tagName() == "iq" && QXmppVCardIq::isVCard(element)) {
@@ -98,6 +199,10 @@ bool QXmppVCardManager::handleStanza(const QDomElement &element)
             Q_EMIT clientVCardReceived();
         }
 
+        if (vCardIq.type() == QXmppIq::Result) {
+            d->cache(vCardIq.from().isEmpty() ? client()->configuration().jidBare() : QXmppUtils::jidToBareJid(vCardIq.from()), vCardIq);
+        }
+
         Q_EMIT vCardReceived(vCardIq);
 
         return true;
@@ -105,4 +210,35 @@ bool QXmppVCardManager::handleStanza(const QDomElement &element)
 
     return false;
 }
+
+void QXmppVCardManager::setClient(QXmppClient *client)
+{
+    if (this->client()) {
+        disconnect(this->client(), &QXmppClient::presenceReceived, this, &QXmppVCardManager::onPresenceReceived);
+    }
+
+    QXmppClientExtension::setClient(client);
+
+    connect(client, &QXmppClient::presenceReceived, this, &QXmppVCardManager::onPresenceReceived);
+}
 /// \endcond
+
+void QXmppVCardManager::onPresenceReceived(const QXmppPresence &presence)
+{
+    switch (presence.vCardUpdateType()) {
+    case QXmppPresence::VCardUpdateNone:
+    case QXmppPresence::VCardUpdateNotReady:
+        return;
+    case QXmppPresence::VCardUpdateNoPhoto:
+    case QXmppPresence::VCardUpdateValidPhoto:
+        break;
+    }
+
+    const auto bareJid = QXmppUtils::jidToBareJid(presence.from());
+    const auto hash = presence.vCardUpdateType() == QXmppPresence::VCardUpdateValidPhoto ? presence.photoHash() : QByteArray();
+    d->photoHashes.insert(bareJid, hash);
+
+    if (const auto itr = d->vCards.find(bareJid); itr != d->vCards.end() && itr->photoHash != hash) {
+        d->vCards.erase(itr);
+    }
+}
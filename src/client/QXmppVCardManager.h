@@ -6,8 +6,13 @@
 #define QXMPPVCARDMANAGER_H
 
 #include "QXmppClientExtension.h"
+#include "QXmppError.h"
+#include "QXmppTask.h"
+#include "QXmppVCardIq.h"
 
-class QXmppVCardIq;
+#include <variant>
+
+class QXmppPresence;
 class QXmppVCardManagerPrivate;
 
 ///
@@ -23,6 +28,10 @@ class QXmppVCardManagerPrivate;
 /// client has to request for a particular vCard using requestVCard(). And connect to
 /// the signal vCardReceived() to get the requested vCard.
 ///
+/// Since QXmpp 1.6, fetchVCard() can be used instead. It returns a task and
+/// caches the vCards of contacts until their \xep{0153, vCard-Based Avatars}
+/// photo hash in their presence changes.
+///
 /// <B>Getting vCard of the connected client:</B><BR>
 /// For getting the vCard of the connected user itself. Client can call requestClientVCard()
 /// and on the signal clientVCardReceived() it can get its vCard using clientVCard().
@@ -39,10 +48,15 @@ class QXMPP_EXPORT QXmppVCardManager : public QXmppClientExtension
     Q_OBJECT
 
 public:
+    /// Contains the vCard or an error.
+    using VCardResult = std::variant<QXmppVCardIq, QXmppError>;
+
     QXmppVCardManager();
     ~QXmppVCardManager() override;
 
     QString requestVCard(const QString &bareJid = QString());
+    QXmppTask<VCardResult> fetchVCard(const QString &bareJid);
+    void clearVCardCache();
 
     const QXmppVCardIq &clientVCard() const;
     void setClientVCard(const QXmppVCardIq &);
@@ -52,7 +66,11 @@ public:
 
     /// \cond
     QStringList discoveryFeatures() const override;
+    QVector<StanzaFilter> stanzaFilters() const override;
     bool handleStanza(const QDomElement &element) override;
+
+protected:
+    void setClient(QXmppClient *client) override;
     /// \endcond
 
 Q_SIGNALS:
@@ -65,6 +83,8 @@ Q_SIGNALS:
     void clientVCardReceived();
 
 private:
+    void onPresenceReceived(const QXmppPresence &presence);
+
     const std::unique_ptr<QXmppVCardManagerPrivate> d;
 };
 
@@ -120,6 +120,13 @@ QStringList QXmppVersionManager::discoveryFeatures() const
     return QStringList() << ns_version;
 }
 
+QVector<QXmppClientExtension::StanzaFilter> QXmppVersionManager::stanzaFilters() const
+{
+    return {
+        { QStringLiteral("iq"), ns_version },
+    };
+}
+
 bool QXmppVersionManager::handleStanza(const QDomElement &element)
 {
     if (QXmpp::handleIqRequests<QXmppVersionIq>(element, client(), this)) {
@@ -40,6 +40,7 @@ public:
 
     /// \cond
     QStringList discoveryFeatures() const override;
+    QVector<StanzaFilter> stanzaFilters() const override;
     bool handleStanza(const QDomElement &element) override;
     QXmppVersionIq handleIq(QXmppVersionIq &&iq);
     /// \endcond
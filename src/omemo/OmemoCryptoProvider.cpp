@@ -18,6 +18,12 @@ inline QXmppOmemoManagerPrivate *managerPrivate(void *ptr)
     return reinterpret_cast<QXmppOmemoManagerPrivate *>(ptr);
 }
 
+// Wraps a buffer of the OMEMO library without copying it.
+inline QCA::MemoryRegion memoryRegion(const uint8_t *data, size_t len)
+{
+    return QCA::MemoryRegion(QByteArray::fromRawData(reinterpret_cast<const char *>(data), qsizetype(len)));
+}
+
 static int random_func(uint8_t *data, size_t len, void *)
 {
     generateRandomBytes(data, len);
@@ -28,12 +34,14 @@ int hmac_sha256_init_func(void **hmac_context, const uint8_t *key, size_t key_le
 {
     auto *d = managerPrivate(user_data);
 
-    if (!QCA::MessageAuthenticationCode::supportedTypes().contains(PAYLOAD_MESSAGE_AUTHENTICATION_CODE_TYPE)) {
+    // The supported types do not change at runtime.
+    static const bool isSupported = QCA::MessageAuthenticationCode::supportedTypes().contains(PAYLOAD_MESSAGE_AUTHENTICATION_CODE_TYPE);
+    if (!isSupported) {
         d->warning("Message authentication code type '" % QString(PAYLOAD_MESSAGE_AUTHENTICATION_CODE_TYPE) % "' is not supported by this system");
         return -1;
     }
 
-    QCA::SymmetricKey authenticationKey(QByteArray(reinterpret_cast<const char *>(key), key_len));
+    QCA::SymmetricKey authenticationKey(memoryRegion(key, key_len));
     *hmac_context = new QCA::MessageAuthenticationCode(PAYLOAD_MESSAGE_AUTHENTICATION_CODE_TYPE, authenticationKey);
     return 0;
 }
@@ -41,7 +49,7 @@ int hmac_sha256_init_func(void **hmac_context, const uint8_t *key, size_t key_le
 int hmac_sha256_update_func(void *hmac_context, const uint8_t *data, size_t data_len, void *)
 {
     auto *messageAuthenticationCodeGenerator = reinterpret_cast<QCA::MessageAuthenticationCode *>(hmac_context);
-    messageAuthenticationCodeGenerator->update(QCA::MemoryRegion(QByteArray(reinterpret_cast<const char *>(data), data_len)));
+    messageAuthenticationCodeGenerator->update(memoryRegion(data, data_len));
     return 0;
 }
 
@@ -98,12 +106,19 @@ void sha512_digest_cleanup_func(void *digest_context, void *)
     delete hashGenerator;
 }
 
-int encrypt_func(signal_buffer **output,
-                 int cipher,
-                 const uint8_t *key, size_t key_len,
-                 const uint8_t *iv, size_t iv_len,
-                 const uint8_t *plaintext, size_t plaintext_len,
-                 void *user_data)
+//
+// Encrypts or decrypts data with AES for the OMEMO library.
+//
+// The key, initialization vector and input are read from the library's
+// buffers without copying them into intermediate byte arrays.
+//
+static int processAes(signal_buffer **output,
+                      QCA::Direction direction,
+                      int cipher,
+                      const uint8_t *key, size_t key_len,
+                      const uint8_t *iv, size_t iv_len,
+                      const uint8_t *input, size_t input_len,
+                      void *user_data)
 {
     auto *d = managerPrivate(user_data);
 
@@ -139,24 +154,34 @@ int encrypt_func(signal_buffer **output,
         return -2;
     }
 
-    const auto encryptionKey = QCA::SymmetricKey(QByteArray(reinterpret_cast<const char *>(key), key_len));
-    const auto initializationVector = QCA::InitializationVector(QByteArray(reinterpret_cast<const char *>(iv), iv_len));
-    QCA::Cipher encryptionCipher(cipherName, mode, padding, QCA::Encode, encryptionKey, initializationVector);
+    const auto symmetricKey = QCA::SymmetricKey(memoryRegion(key, key_len));
+    const auto initializationVector = QCA::InitializationVector(memoryRegion(iv, iv_len));
+    QCA::Cipher aesCipher(cipherName, mode, padding, direction, symmetricKey, initializationVector);
 
-    auto encryptedData = encryptionCipher.process(QCA::MemoryRegion(QByteArray(reinterpret_cast<const char *>(plaintext), plaintext_len)));
+    const auto processedData = aesCipher.process(memoryRegion(input, input_len));
 
-    if (encryptedData.isEmpty()) {
+    if (processedData.isEmpty()) {
         return -3;
     }
 
-    if (!(*output = signal_buffer_create(reinterpret_cast<const uint8_t *>(encryptedData.constData()), encryptedData.size()))) {
-        d->warning("Encrypted data could not be loaded");
+    if (!(*output = signal_buffer_create(reinterpret_cast<const uint8_t *>(processedData.constData()), processedData.size()))) {
+        d->warning(direction == QCA::Encode ? QStringLiteral("Encrypted data could not be loaded") : QStringLiteral("Decrypted data could not be loaded"));
         return -4;
     }
 
     return 0;
 }
 
+int encrypt_func(signal_buffer **output,
+                 int cipher,
+                 const uint8_t *key, size_t key_len,
+                 const uint8_t *iv, size_t iv_len,
+                 const uint8_t *plaintext, size_t plaintext_len,
+                 void *user_data)
+{
+    return processAes(output, QCA::Encode, cipher, key, key_len, iv, iv_len, plaintext, plaintext_len, user_data);
+}
+
 int decrypt_func(signal_buffer **output,
                  int cipher,
                  const uint8_t *key, size_t key_len,
@@ -164,56 +189,7 @@ int decrypt_func(signal_buffer **output,
                  const uint8_t *ciphertext, size_t ciphertext_len,
                  void *user_data)
 {
-    auto *d = managerPrivate(user_data);
-
-    QString cipherName;
-
-    switch (key_len) {
-    case 128 / 8:
-        cipherName = QStringLiteral("aes128");
-        break;
-    case 192 / 8:
-        cipherName = QStringLiteral("aes192");
-        break;
-    case 256 / 8:
-        cipherName = QStringLiteral("aes256");
-        break;
-    default:
-        return -1;
-    }
-
-    QCA::Cipher::Mode mode;
-    QCA::Cipher::Padding padding;
-
-    switch (cipher) {
-    case SG_CIPHER_AES_CTR_NOPADDING:
-        mode = QCA::Cipher::CTR;
-        padding = QCA::Cipher::NoPadding;
-        break;
-    case SG_CIPHER_AES_CBC_PKCS5:
-        mode = QCA::Cipher::CBC;
-        padding = QCA::Cipher::PKCS7;
-        break;
-    default:
-        return -2;
-    }
-
-    const auto encryptionKey = QCA::SymmetricKey(QByteArray(reinterpret_cast<const char *>(key), key_len));
-    const auto initializationVector = QCA::InitializationVector(QByteArray(reinterpret_cast<const char *>(iv), iv_len));
-    QCA::Cipher decryptionCipher(cipherName, mode, padding, QCA::Decode, encryptionKey, initializationVector);
-
-    auto decryptedData = decryptionCipher.process(QCA::MemoryRegion(QByteArray(reinterpret_cast<const char *>(ciphertext), ciphertext_len)));
-
-    if (decryptedData.isEmpty()) {
-        return -3;
-    }
-
-    if (!(*output = signal_buffer_create(reinterpret_cast<const uint8_t *>(decryptedData.constData()), decryptedData.size()))) {
-        d->warning("Decrypted data could not be loaded");
-        return -4;
-    }
-
-    return 0;
+    return processAes(output, QCA::Decode, cipher, key, key_len, iv, iv_len, ciphertext, ciphertext_len, user_data);
 }
 
 namespace QXmpp::Omemo::Private {
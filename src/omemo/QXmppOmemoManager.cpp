@@ -9,6 +9,7 @@
 #include "QXmppOmemoItems_p.h"
 #include "QXmppOmemoManager_p.h"
 #include "QXmppPubSubEvent.h"
+#include "QXmppTracing_p.h"
 #include "QXmppTrustManager.h"
 #include "QXmppUtils.h"
 
@@ -333,7 +334,10 @@ QXmppOmemoManager::QXmppOmemoManager(QXmppOmemoStorage *omemoStorage)
     d->schedulePeriodicTasks();
 }
 
-QXmppOmemoManager::~QXmppOmemoManager() = default;
+QXmppOmemoManager::~QXmppOmemoManager()
+{
+    d->storeUnstoredDevices();
+}
 
 ///
 /// Loads all locally stored OMEMO data.
@@ -383,10 +387,14 @@ QXmppTask<bool> Manager::load()
         }
 
         d->devices = omemoData.devices;
-        d->removeDevicesRemovedFromServer();
 
-        d->isStarted = true;
-        interface.finish(true);
+        // The own devices are needed for every encryption.
+        d->loadDevices({ d->ownBareJid() }).then(this, [this, interface]() mutable {
+            d->removeDevicesRemovedFromServer();
+
+            d->isStarted = true;
+            interface.finish(true);
+        });
     });
 
     return interface.task();
@@ -557,6 +565,10 @@ void Manager::setMaximumDevicesPerStanza(int maximum)
 ///
 /// Requests device lists from contacts and stores them locally.
 ///
+/// The device lists are requested with at most
+/// \c QXmppPubSubManager::maximumConcurrentRequests() requests at the same
+/// time.
+///
 /// The user must be logged in while calling this.
 /// The JID of the current user must not be passed.
 ///
@@ -566,34 +578,24 @@ void Manager::setMaximumDevicesPerStanza(int maximum)
 ///
 QXmppTask<QVector<Manager::DevicesResult>> Manager::requestDeviceLists(const QList<QString> &jids)
 {
-    if (const auto jidsCount = jids.size()) {
-        struct State
-        {
-            int processed = 0;
-            int jidsCount = 0;
-            QXmppPromise<QVector<Manager::DevicesResult>> interface;
-            QVector<Manager::DevicesResult> devicesResults;
-        };
-
-        auto state = std::make_shared<State>();
-        state->jidsCount = jids.count();
-
+    if (!jids.isEmpty()) {
         for (const auto &jid : jids) {
             Q_ASSERT_X(jid != d->ownBareJid(), "Requesting contact's device list", "Own JID passed");
+        }
 
-            auto future = d->requestDeviceList(jid);
-            future.then(this, [jid, state](auto result) mutable {
-                state->devicesResults << DevicesResult {
-                    jid,
-                    mapSuccess(std::move(result), [](QXmppOmemoDeviceListItem) { return Success(); })
+        QXmppPromise<QVector<Manager::DevicesResult>> interface;
+        d->requestDeviceLists(jids).then(this, [jids, interface](auto &&results) mutable {
+            QVector<Manager::DevicesResult> devicesResults;
+            devicesResults.reserve(results.size());
+            for (int i = 0; i < results.size(); i++) {
+                devicesResults << DevicesResult {
+                    jids.at(i),
+                    mapSuccess(std::move(results[i]), [](QXmppOmemoDeviceListItem) { return Success(); })
                 };
-
-                if (++(state->processed) == state->jidsCount) {
-                    state->interface.finish(std::move(state->devicesResults));
-                }
-            });
-        }
-        return state->interface.task();
+            }
+            interface.finish(std::move(devicesResults));
+        });
+        return interface.task();
     }
     return makeReadyTask(QVector<Manager::DevicesResult>());
 }
@@ -606,6 +608,11 @@ QXmppTask<QVector<Manager::DevicesResult>> Manager::requestDeviceLists(const QLi
 /// subscribed.
 /// The user must be logged in while calling this.
 ///
+/// Device lists that are already delivered via PEP notifications (i.e., the
+/// own one and those of contacts with presence subscription) and device lists
+/// that are already subscribed are not subscribed again. Only their current
+/// items are requested.
+///
 /// Call \c QXmppOmemoManager::unsubscribeFromDeviceLists() before logout.
 ///
 /// \param jids JIDs of the contacts whose device lists are being subscribed
@@ -683,6 +690,11 @@ QXmppOmemoOwnDevice Manager::ownDevice()
 ///
 /// You must build sessions before you can get devices with corresponding keys.
 ///
+/// If the storage loads devices on demand (see
+/// \c QXmppOmemoStorage::isLazyDeviceLoadingSupported()), only the devices
+/// loaded so far are returned.
+/// Use \c QXmppOmemoManager::devices(const QList<QString> &) for specific JIDs.
+///
 /// /\return all devices except the own device
 ///
 QXmppTask<QVector<QXmppOmemoDevice>> Manager::devices()
@@ -707,6 +719,12 @@ QXmppTask<QVector<QXmppOmemoDevice>> Manager::devices()
 ///
 QXmppTask<QVector<QXmppOmemoDevice>> Manager::devices(const QList<QString> &jids)
 {
+    if (!d->areDevicesLoaded(jids)) {
+        return d->withLoadedDevices<QVector<QXmppOmemoDevice>>(jids, [this, jids]() {
+            return devices(jids);
+        });
+    }
+
     QXmppPromise<QVector<QXmppOmemoDevice>> interface;
 
     auto future = keys(jids);
@@ -849,57 +867,119 @@ bool Manager::isNewDeviceAutoSessionBuildingEnabled()
 /// Additionally, the keys are automatically retrieved from the server which is helpful in order to
 /// get them when calling \c QXmppOmemoManager::devices().
 ///
+/// If no devices are stored for a JID (e.g., for a participant of a group chat
+/// whose device list has not been subscribed), its device list is requested
+/// first.
+///
+/// The device bundles are requested in the background with at most
+/// \c QXmppOmemoManager::maximumConcurrentSessionBuilds() requests at the same
+/// time.
+/// The progress is reported via
+/// \c QXmppOmemoManager::sessionBuildingProgressChanged().
+///
 /// The user must be logged in while calling this.
 ///
 /// \param jids JIDs of the device owners for whom the sessions are built
 ///
 QXmppTask<void> Manager::buildMissingSessions(const QList<QString> &jids)
 {
-    QXmppPromise<void> interface;
+    if (!d->areDevicesLoaded(jids)) {
+        return d->withLoadedDevices<void>(jids, [this, jids]() {
+            return buildMissingSessions(jids);
+        });
+    }
 
-    auto &devices = d->devices;
-    auto devicesCount = 0;
+    struct State
+    {
+        QXmppPromise<void> interface;
+        // one additional count is held until all devices are enqueued
+        int pendingCount = 1;
 
-    for (const auto &jid : jids) {
-        // Do not exceed the maximum of manageable devices.
-        if (devicesCount > d->maximumDevicesPerStanza - devicesCount) {
-            warning("Sessions could not be built for all JIDs because their devices are "
-                    "altogether more than the maximum of manageable devices " %
-                    QString::number(d->maximumDevicesPerStanza) %
-                    u" - Use QXmppOmemoManager::setMaximumDevicesPerStanza() to increase the maximum");
-            break;
-        } else {
-            devicesCount += devices.value(jid).size();
+        void finishOne()
+        {
+            if (--pendingCount == 0) {
+                interface.finish();
+            }
         }
-    }
+    };
+
+    auto state = std::make_shared<State>();
+    auto task = state->interface.task();
 
-    if (devicesCount) {
-        auto processedDevicesCount = std::make_shared<int>(0);
+    auto enqueueDevices = [this, jids, state]() {
+        auto devicesCount = 0;
 
         for (const auto &jid : jids) {
-            auto &processedDevices = devices[jid];
-
-            for (auto itr = processedDevices.begin(); itr != processedDevices.end(); ++itr) {
-                const auto &deviceId = itr.key();
-                auto &device = itr.value();
-
-                if (device.session.isEmpty()) {
-                    auto future = d->buildSessionWithDeviceBundle(jid, deviceId, device);
-                    future.then(this, [=](auto) mutable {
-                        if (++(*processedDevicesCount) == devicesCount) {
-                            interface.finish();
-                        }
+            const auto jidDevices = d->devices.value(jid);
+
+            // Do not exceed the maximum of manageable devices.
+            if (devicesCount + jidDevices.size() > d->maximumDevicesPerStanza) {
+                warning("Sessions could not be built for all JIDs because their devices are "
+                        "altogether more than the maximum of manageable devices " %
+                        QString::number(d->maximumDevicesPerStanza) %
+                        u" - Use QXmppOmemoManager::setMaximumDevicesPerStanza() to increase the maximum");
+                break;
+            }
+            devicesCount += jidDevices.size();
+
+            for (auto itr = jidDevices.cbegin(); itr != jidDevices.cend(); ++itr) {
+                if (itr.value().session.isEmpty()) {
+                    state->pendingCount++;
+                    d->enqueueSessionBuilding(jid, itr.key(), [state]() {
+                        state->finishOne();
                     });
-                } else if (++(*processedDevicesCount) == devicesCount) {
-                    interface.finish();
                 }
             }
         }
+
+        state->finishOne();
+    };
+
+    QList<QString> jidsWithoutDevices;
+    for (const auto &jid : jids) {
+        if (d->devices.value(jid).isEmpty()) {
+            jidsWithoutDevices.append(jid);
+        }
+    }
+
+    if (jidsWithoutDevices.isEmpty()) {
+        enqueueDevices();
     } else {
-        interface.finish();
+        d->requestDeviceLists(jidsWithoutDevices).then(this, [=](auto &&) mutable {
+            enqueueDevices();
+        });
     }
 
-    return interface.task();
+    return task;
+}
+
+///
+/// Returns the maximum count of device bundles that are requested at the same
+/// time when sessions are built by \c QXmppOmemoManager::buildMissingSessions().
+///
+/// \return the maximum count of concurrent session builds
+///
+/// \since QXmpp 1.6
+///
+int Manager::maximumConcurrentSessionBuilds() const
+{
+    return d->maximumConcurrentSessionBuilds;
+}
+
+///
+/// Sets the maximum count of device bundles that are requested at the same
+/// time when sessions are built by \c QXmppOmemoManager::buildMissingSessions().
+///
+/// The default is 10.
+///
+/// \param maximum maximum count of concurrent session builds (at least 1)
+///
+/// \since QXmpp 1.6
+///
+void Manager::setMaximumConcurrentSessionBuilds(int maximum)
+{
+    d->maximumConcurrentSessionBuilds = std::max(1, maximum);
+    d->processSessionBuildingQueue();
 }
 
 ///
@@ -993,6 +1073,54 @@ QXmppTask<QXmpp::TrustLevel> Manager::trustLevel(const QString &keyOwnerJid, con
     return d->trustManager->trustLevel(ns_omemo_2, keyOwnerJid, keyId);
 }
 
+///
+/// Decrypts multiple messages at once, e.g., a page of archived messages.
+///
+/// The sessions are processed one after another, but the decryption of the
+/// message payloads runs in parallel on the global thread pool.
+///
+/// \param messages messages to be decrypted
+///
+/// \return the results of the decryption in the order of the given messages
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QVector<QXmppE2eeExtension::MessageDecryptResult>> Manager::decryptMessages(QVector<QXmppMessage> &&messages)
+{
+    struct State
+    {
+        QXmppPromise<QVector<MessageDecryptResult>> promise;
+        QVector<std::optional<MessageDecryptResult>> results;
+        qsizetype remaining = 0;
+    };
+
+    if (messages.isEmpty()) {
+        return makeReadyTask(QVector<MessageDecryptResult>());
+    }
+
+    auto state = std::make_shared<State>();
+    state->results.resize(messages.size());
+    state->remaining = messages.size();
+    auto task = state->promise.task();
+
+    for (qsizetype i = 0; i < messages.size(); i++) {
+        decryptMessage(std::move(messages[i])).then(this, [state, i](MessageDecryptResult &&result) {
+            state->results[i] = std::move(result);
+
+            if (--state->remaining == 0) {
+                QVector<MessageDecryptResult> results;
+                results.reserve(state->results.size());
+                for (auto &result : state->results) {
+                    results.append(std::move(*result));
+                }
+                state->promise.finish(std::move(results));
+            }
+        });
+    }
+
+    return task;
+}
+
 /// \cond
 QXmppTask<QXmppE2eeExtension::MessageEncryptResult> Manager::encryptMessage(QXmppMessage &&message, const std::optional<QXmppSendStanzaParams> &params)
 {
@@ -1149,7 +1277,11 @@ bool Manager::handleStanza(const QDomElement &stanza)
         return false;
     }
 
-    d->decryptIq(stanza).then(this, [=](auto result) {
+    QXMPP_TRACE_ASYNC_SPAN(span, "omemo", "decrypt");
+    QXMPP_TRACE_STANZA(span, stanza.attribute(QStringLiteral("id")), QStringLiteral("iq"));
+
+    d->decryptIq(stanza).then(this, [=, span = std::move(span)](auto result) mutable {
+        QXMPP_TRACE_END(span);
         if (result) {
             injectIq(result->iq, result->e2eeMetadata);
         } else {
@@ -1162,8 +1294,12 @@ bool Manager::handleStanza(const QDomElement &stanza)
 bool Manager::handleMessage(const QXmppMessage &message)
 {
     if (d->isStarted && message.omemoElement()) {
+        QXMPP_TRACE_ASYNC_SPAN(span, "omemo", "decrypt");
+        QXMPP_TRACE_STANZA(span, message.id(), QStringLiteral("message"));
+
         auto future = d->decryptMessage(message);
-        future.then(this, [=](std::optional<QXmppMessage> optionalDecryptedMessage) mutable {
+        future.then(this, [=, span = std::move(span)](std::optional<QXmppMessage> optionalDecryptedMessage) mutable {
+            QXMPP_TRACE_END(span);
             if (optionalDecryptedMessage) {
                 injectMessage(std::move(*optionalDecryptedMessage));
             }
@@ -1225,6 +1361,21 @@ bool Manager::handleMessage(const QXmppMessage &message)
 /// Emitted when all devices are removed.
 ///
 
+///
+/// \fn QXmppOmemoManager::sessionBuildingProgressChanged(int processedCount, int totalCount)
+///
+/// Emitted when a session building started by
+/// \c QXmppOmemoManager::buildMissingSessions() has been processed.
+///
+/// The counts include all session builds since the last time no session was
+/// being built.
+///
+/// \param processedCount count of processed session builds
+/// \param totalCount count of all requested session builds
+///
+/// \since QXmpp 1.6
+///
+
 /// \cond
 void Manager::setClient(QXmppClient *client)
 {
@@ -1273,6 +1424,14 @@ void Manager::setClient(QXmppClient *client)
 bool Manager::handlePubSubEvent(const QDomElement &element, const QString &pubSubService, const QString &nodeName)
 {
     if (nodeName == ns_omemo_2_devices && QXmppPubSubEvent<QXmppOmemoDeviceListItem>::isPubSubEvent(element)) {
+        // The stored devices are needed to process the changes.
+        if (!d->areDevicesLoaded({ pubSubService })) {
+            d->loadDevices({ pubSubService }).then(this, [this, element, pubSubService, nodeName]() {
+                handlePubSubEvent(element, pubSubService, nodeName);
+            });
+            return true;
+        }
+
         QXmppPubSubEvent<QXmppOmemoDeviceListItem> event;
         event.parse(element);
 
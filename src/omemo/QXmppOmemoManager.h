@@ -113,6 +113,9 @@ public:
 
     QXmppTask<void> buildMissingSessions(const QList<QString> &jids);
 
+    int maximumConcurrentSessionBuilds() const;
+    void setMaximumConcurrentSessionBuilds(int maximum);
+
     QXmppTask<bool> resetOwnDevice();
     QXmppTask<bool> resetAll();
 
@@ -122,6 +125,8 @@ public:
     QXmppTask<void> setTrustLevel(const QMultiHash<QString, QByteArray> &keyIds, QXmpp::TrustLevel trustLevel);
     QXmppTask<QXmpp::TrustLevel> trustLevel(const QString &keyOwnerJid, const QByteArray &keyId);
 
+    QXmppTask<QVector<MessageDecryptResult>> decryptMessages(QVector<QXmppMessage> &&messages);
+
     /// \cond
     QXmppTask<MessageEncryptResult> encryptMessage(QXmppMessage &&message, const std::optional<QXmppSendStanzaParams> &params) override;
     QXmppTask<MessageDecryptResult> decryptMessage(QXmppMessage &&message) override;
@@ -145,6 +150,8 @@ public:
     Q_SIGNAL void devicesRemoved(const QString &jid);
     Q_SIGNAL void allDevicesRemoved();
 
+    Q_SIGNAL void sessionBuildingProgressChanged(int processedCount, int totalCount);
+
 protected:
     /// \cond
     void setClient(QXmppClient *client) override;
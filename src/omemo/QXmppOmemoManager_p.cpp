@@ -7,12 +7,15 @@
 
 #include "QXmppOmemoManager_p.h"
 
+#include "QXmppAsync_p.h"
+#include "QXmppFutureUtils_p.h"
 #include "QXmppOmemoDeviceElement_p.h"
 #include "QXmppOmemoElement_p.h"
 #include "QXmppOmemoEnvelope_p.h"
 #include "QXmppOmemoIq_p.h"
 #include "QXmppOmemoItems_p.h"
 #include "QXmppPubSubBaseItem.h"
+#include "QXmppRosterManager.h"
 #include "QXmppSceEnvelope_p.h"
 #include "QXmppTrustManager.h"
 #include "QXmppUtils.h"
@@ -21,8 +24,10 @@
 #include <protocol.h>
 
 #include "OmemoCryptoProvider.h"
+#include <QElapsedTimer>
 #include <QRandomGenerator>
 #include <QStringBuilder>
+#include <QThreadPool>
 
 #undef max
 #undef interface
@@ -195,6 +200,49 @@ static void replaceChildElements(QDomElement &oldElement, const QDomElement &new
     }
 }
 
+//
+// Generates pre key pairs.
+//
+// It does not use the manager and can be run in another thread.
+//
+// \param globalContext OMEMO library's global context
+// \param firstPreKeyId ID of the first generated pre key pair
+// \param count number of pre key pairs to generate
+//
+// \return the generated pre key pairs or std::nullopt on failure
+//
+static std::optional<GeneratedPreKeyPairs> generatePreKeyPairs(signal_context *globalContext, uint32_t firstPreKeyId, uint32_t count)
+{
+    KeyListNodePtr newPreKeyPairs;
+
+    if (signal_protocol_key_helper_generate_pre_keys(newPreKeyPairs.ptrRef(), firstPreKeyId, count, globalContext) < 0) {
+        return std::nullopt;
+    }
+
+    GeneratedPreKeyPairs generatedPreKeyPairs;
+
+    for (auto *node = newPreKeyPairs.get();
+         node != nullptr;
+         node = signal_protocol_key_helper_key_list_next(node)) {
+        BufferSecurePtr preKeyPairBuffer;
+
+        auto preKeyPair = signal_protocol_key_helper_key_list_element(node);
+
+        if (session_pre_key_serialize(preKeyPairBuffer.ptrRef(), preKeyPair) < 0) {
+            return std::nullopt;
+        }
+
+        const auto preKeyId = session_pre_key_get_id(preKeyPair);
+
+        generatedPreKeyPairs.preKeyPairs.insert(preKeyId, preKeyPairBuffer.toByteArray());
+
+        BufferPtr publicPreKeyBuffer(ec_public_key_get_mont(ec_key_pair_get_public(session_pre_key_get_key_pair(preKeyPair))));
+        generatedPreKeyPairs.publicPreKeys.insert(preKeyId, publicPreKeyBuffer.toByteArray());
+    }
+
+    return generatedPreKeyPairs;
+}
+
 template<typename T, typename Err>
 auto mapToSuccess(std::variant<T, Err> var)
 {
@@ -205,8 +253,37 @@ QXmppOmemoManagerPrivate::QXmppOmemoManagerPrivate(Manager *parent, QXmppOmemoSt
     : q(parent),
       omemoStorage(omemoStorage),
       signedPreKeyPairsRenewalTimer(parent),
-      deviceRemovalTimer(parent)
+      deviceRemovalTimer(parent),
+      deviceStorageTimer(parent),
+      preKeyMaintenanceTimer(parent),
+      emptyMessageTimer(parent)
 {
+    // Sessions are modified for each encrypted or decrypted stanza.
+    // Storing them once per event loop iteration avoids storing the same
+    // session multiple times, e.g., while decrypting multiple messages from
+    // one device.
+    deviceStorageTimer.setSingleShot(true);
+    deviceStorageTimer.setInterval(0);
+    QObject::connect(&deviceStorageTimer, &QTimer::timeout, parent, [this]() {
+        storeUnstoredDevices();
+    });
+
+    // Used pre keys are replaced and the device bundle is published after a
+    // delay instead of during the decryption of each message with a used pre
+    // key.
+    preKeyMaintenanceTimer.setSingleShot(true);
+    preKeyMaintenanceTimer.setInterval(PRE_KEY_MAINTENANCE_DELAY);
+    QObject::connect(&preKeyMaintenanceTimer, &QTimer::timeout, parent, [this]() {
+        maintainPreKeyPairs();
+    });
+
+    preKeyGenerationPool.setMaxThreadCount(1);
+
+    emptyMessageTimer.setSingleShot(true);
+    emptyMessageTimer.setInterval(EMPTY_MESSAGE_SENDING_DELAY);
+    QObject::connect(&emptyMessageTimer, &QTimer::timeout, parent, [this]() {
+        sendPendingEmptyMessages();
+    });
 }
 
 //
@@ -470,11 +547,7 @@ signal_protocol_pre_key_store ManagerPrivate::createPreKeyStore() const
     store.remove_pre_key = [](uint32_t pre_key_id, void *user_data) {
         auto *manager = reinterpret_cast<Manager *>(user_data);
         auto *d = manager->d.get();
-
-        if (!d->renewPreKeyPairs(pre_key_id)) {
-            return -1;
-        }
-
+        d->removePreKeyPair(pre_key_id);
         return 0;
     };
 
@@ -502,11 +575,15 @@ signal_protocol_session_store ManagerPrivate::createSessionStore() const
         const auto *d = manager->d.get();
         const auto jid = extractJid(*address);
 
-        const auto &session = d->devices.value(jid).value(uint32_t(address->device_id)).session;
-
-        if (session.isEmpty()) {
+        const auto devicesItr = d->devices.constFind(jid);
+        if (devicesItr == d->devices.cend()) {
+            return 0;
+        }
+        const auto deviceItr = devicesItr->constFind(uint32_t(address->device_id));
+        if (deviceItr == devicesItr->cend() || deviceItr->session.isEmpty()) {
             return 0;
         }
+        const auto &session = deviceItr->session;
 
         if (!(*record = signal_buffer_create(reinterpret_cast<const uint8_t *>(session.constData()), size_t(session.size())))) {
             manager->warning("Session could not be loaded");
@@ -552,9 +629,8 @@ signal_protocol_session_store ManagerPrivate::createSessionStore() const
         const auto jid = extractJid(*address);
         const auto deviceId = int(address->device_id);
 
-        auto &device = d->devices[jid][deviceId];
-        device.session = session;
-        d->omemoStorage->addDevice(jid, deviceId, device);
+        d->devices[jid][deviceId].session = session;
+        d->storeDevice(jid, deviceId);
         return 0;
     };
 
@@ -573,7 +649,7 @@ signal_protocol_session_store ManagerPrivate::createSessionStore() const
         auto &device = d->devices[jid][deviceId];
         if (!device.session.isEmpty()) {
             device.session.clear();
-            d->omemoStorage->addDevice(jid, deviceId, device);
+            d->storeDevice(jid, deviceId);
         }
         return 1;
     };
@@ -589,7 +665,7 @@ signal_protocol_session_store ManagerPrivate::createSessionStore() const
             auto &device = itr.value();
             if (!device.session.isEmpty()) {
                 device.session.clear();
-                d->omemoStorage->addDevice(jid, deviceId, device);
+                d->storeDevice(jid, deviceId);
                 ++deletedSessionsCount;
             }
         }
@@ -833,36 +909,84 @@ bool ManagerPrivate::updateSignedPreKeyPair(ratchet_identity_key_pair *identityK
 }
 
 //
-// Deletes a pre key pair and creates a new one.
+// Deletes a used pre key pair.
 //
-// \param keyPairBeingRenewed key pair being replaced by a new one
+// New pre key pairs are generated and the device bundle is published
+// afterwards by maintainPreKeyPairs() once for all pre key pairs used
+// meanwhile.
 //
-// \return whether it succeeded
+// \param preKeyId ID of the pre key pair being deleted
 //
-bool ManagerPrivate::renewPreKeyPairs(uint32_t keyPairBeingRenewed)
+void ManagerPrivate::removePreKeyPair(uint32_t preKeyId)
 {
-    preKeyPairs.remove(keyPairBeingRenewed);
-    omemoStorage->removePreKeyPair(keyPairBeingRenewed);
-    deviceBundle.removePublicPreKey(keyPairBeingRenewed);
+    preKeyPairs.remove(preKeyId);
+    omemoStorage->removePreKeyPair(preKeyId);
+    deviceBundle.removePublicPreKey(preKeyId);
 
-    if (!updatePreKeyPairs()) {
-        return false;
+    if (!preKeyMaintenanceTimer.isActive()) {
+        preKeyMaintenanceTimer.start();
+    }
+}
+
+//
+// Generates new pre key pairs in the background if there are less than
+// PRE_KEY_LOW_WATER_MARK and publishes the device bundle without the used
+// pre keys.
+//
+void ManagerPrivate::maintainPreKeyPairs()
+{
+    // The device bundle is published as soon as the running generation is
+    // finished.
+    // Nothing is done if the own device is being reset.
+    if (isPreKeyGenerationRunning || !isStarted) {
+        return;
     }
 
-    // Store the own device containing the new pre key ID.
+    const auto publishPreKeys = [this]() {
+        publishDeviceBundleItem([=](bool isPublished) {
+            if (!isPublished) {
+                warning("Own device bundle item could not be published during renewal of pre key pairs");
+            }
+        });
+    };
+
+    if (preKeyPairs.size() >= PRE_KEY_LOW_WATER_MARK) {
+        publishPreKeys();
+        return;
+    }
+
+    const auto count = PRE_KEY_INITIAL_CREATION_COUNT - uint32_t(preKeyPairs.size());
+    const auto firstPreKeyId = reservePreKeyIds(count);
+    const auto ownDeviceId = ownDevice.id;
+
+    // Store the own device containing the reserved pre key IDs.
     omemoStorage->setOwnDevice(ownDevice);
 
-    publishDeviceBundleItem([=](bool isPublished) {
-        if (!isPublished) {
-            warning("Own device bundle item could not be published during renewal of pre key pairs");
-        }
+    isPreKeyGenerationRunning = true;
+
+    auto future = runAsync(&preKeyGenerationPool, [globalContext = globalContext.get(), firstPreKeyId, count]() {
+        return generatePreKeyPairs(globalContext, firstPreKeyId, count);
     });
+    future.then(q, [this, ownDeviceId, publishPreKeys](std::optional<GeneratedPreKeyPairs> &&generatedPreKeyPairs) {
+        isPreKeyGenerationRunning = false;
 
-    return true;
+        // Skip the pre key pairs if the own device has been reset meanwhile.
+        if (!isStarted || ownDevice.id != ownDeviceId) {
+            return;
+        }
+
+        if (generatedPreKeyPairs) {
+            addPreKeyPairs(*generatedPreKeyPairs);
+        } else {
+            warning("Pre key pairs could not be generated");
+        }
+
+        publishPreKeys();
+    });
 }
 
 //
-// Updates the pre key pairs locally.
+// Reserves the IDs of new pre key pairs.
 //
 // Make sure that
 // \code
@@ -875,13 +999,12 @@ bool ManagerPrivate::renewPreKeyPairs(uint32_t keyPairBeingRenewed)
 // \endcode
 // .
 //
-// \param count number of pre key pairs to update
+// \param count number of pre key pairs
 //
-// \return whether it succeeded
+// \return the ID of the first pre key pair
 //
-bool ManagerPrivate::updatePreKeyPairs(uint32_t count)
+uint32_t ManagerPrivate::reservePreKeyIds(uint32_t count)
 {
-    KeyListNodePtr newPreKeyPairs;
     auto latestPreKeyId = ownDevice.latestPreKeyId;
 
     // Ensure that no pre key ID exceeds PRE_KEY_ID_MAX.
@@ -892,37 +1015,56 @@ bool ManagerPrivate::updatePreKeyPairs(uint32_t count)
         ++latestPreKeyId;
     }
 
-    if (signal_protocol_key_helper_generate_pre_keys(newPreKeyPairs.ptrRef(), latestPreKeyId, count, globalContext.get()) < 0) {
-        warning("Pre key pairs could not be generated");
-        return false;
-    }
-
-    QHash<uint32_t, QByteArray> serializedPreKeyPairs;
-
-    for (auto *node = newPreKeyPairs.get();
-         node != nullptr;
-         node = signal_protocol_key_helper_key_list_next(node)) {
-        BufferSecurePtr preKeyPairBuffer;
+    ownDevice.latestPreKeyId = latestPreKeyId - 1 + count;
 
-        auto preKeyPair = signal_protocol_key_helper_key_list_element(node);
+    return latestPreKeyId;
+}
 
-        if (session_pre_key_serialize(preKeyPairBuffer.ptrRef(), preKeyPair) < 0) {
-            warning("Pre key pair could not be serialized");
-            return false;
-        }
+//
+// Adds generated pre key pairs locally and to the storage.
+//
+// \param generatedPreKeyPairs pre key pairs being added
+//
+void ManagerPrivate::addPreKeyPairs(const GeneratedPreKeyPairs &generatedPreKeyPairs)
+{
+    for (auto itr = generatedPreKeyPairs.publicPreKeys.cbegin(); itr != generatedPreKeyPairs.publicPreKeys.cend(); ++itr) {
+        deviceBundle.addPublicPreKey(itr.key(), itr.value());
+    }
 
-        const auto preKeyId = session_pre_key_get_id(preKeyPair);
+    preKeyPairs.insert(generatedPreKeyPairs.preKeyPairs);
+    omemoStorage->addPreKeyPairs(generatedPreKeyPairs.preKeyPairs);
+}
 
-        serializedPreKeyPairs.insert(preKeyId, preKeyPairBuffer.toByteArray());
+//
+// Updates the pre key pairs locally.
+//
+// Make sure that
+// \code
+// d->omemoStorage->setOwnDevice(d->ownDevice)
+// \endcode
+// is called
+// afterwards to store the change of
+// \code
+// d->ownDevice.latestPreKeyId()
+// \endcode
+// .
+//
+// \param count number of pre key pairs to update
+//
+// \return whether it succeeded
+//
+bool ManagerPrivate::updatePreKeyPairs(uint32_t count)
+{
+    const auto latestPreKeyId = ownDevice.latestPreKeyId;
+    const auto generatedPreKeyPairs = generatePreKeyPairs(globalContext.get(), reservePreKeyIds(count), count);
 
-        BufferPtr publicPreKeyBuffer(ec_public_key_get_mont(ec_key_pair_get_public(session_pre_key_get_key_pair(preKeyPair))));
-        const auto serializedPublicPreKey = publicPreKeyBuffer.toByteArray();
-        deviceBundle.addPublicPreKey(preKeyId, serializedPublicPreKey);
+    if (!generatedPreKeyPairs) {
+        ownDevice.latestPreKeyId = latestPreKeyId;
+        warning("Pre key pairs could not be generated");
+        return false;
     }
 
-    preKeyPairs.insert(serializedPreKeyPairs);
-    omemoStorage->addPreKeyPairs(serializedPreKeyPairs);
-    ownDevice.latestPreKeyId = latestPreKeyId - 1 + count;
+    addPreKeyPairs(*generatedPreKeyPairs);
 
     return true;
 }
@@ -931,32 +1073,66 @@ bool ManagerPrivate::updatePreKeyPairs(uint32_t count)
 // Removes locally stored devices after a specific time if they are removed from their owners'
 // device lists on their servers.
 //
+// The devices are checked in slices of DEVICE_REMOVAL_SLICE_DURATION, one slice per event loop
+// iteration, so that many stored devices do not block the event loop.
+//
 void ManagerPrivate::removeDevicesRemovedFromServer()
+{
+    // A check that is still running continues with the remaining JIDs.
+    const auto isCheckRunning = !jidsPendingDeviceRemovalCheck.isEmpty();
+    jidsPendingDeviceRemovalCheck = devices.keys();
+
+    if (!isCheckRunning) {
+        removeDevicesRemovedFromServerSlice();
+    }
+}
+
+//
+// Removes devices removed from their servers for the next JIDs pending the check.
+//
+void ManagerPrivate::removeDevicesRemovedFromServerSlice()
 {
     const auto currentDate = QDateTime::currentDateTimeUtc().toSecsSinceEpoch() * 1s;
 
-    for (auto itr = devices.begin(); itr != devices.end(); ++itr) {
-        const auto &jid = itr.key();
+    QElapsedTimer elapsedTimer;
+    elapsedTimer.start();
+
+    while (!jidsPendingDeviceRemovalCheck.isEmpty() && elapsedTimer.elapsed() < DEVICE_REMOVAL_SLICE_DURATION.count()) {
+        const auto jid = jidsPendingDeviceRemovalCheck.takeLast();
+
+        const auto itr = devices.find(jid);
+        if (itr == devices.end()) {
+            continue;
+        }
+
         auto &userDevices = itr.value();
 
         for (auto devicesItr = userDevices.begin(); devicesItr != userDevices.end();) {
-            const auto &deviceId = devicesItr.key();
-            const auto &device = devicesItr.value();
+            const auto deviceId = devicesItr.key();
+            const auto keyId = devicesItr->keyId;
 
             // Remove data for devices removed from their servers after
             // DEVICE_REMOVAL_INTERVAL.
-            const auto &removalDate = device.removalFromDeviceListDate;
+            const auto &removalDate = devicesItr->removalFromDeviceListDate;
             if (!removalDate.isNull() &&
                 currentDate - removalDate.toSecsSinceEpoch() * 1s > DEVICE_REMOVAL_INTERVAL) {
                 devicesItr = userDevices.erase(devicesItr);
                 omemoStorage->removeDevice(jid, deviceId);
-                trustManager->removeKeys(ns_omemo_2, QList { device.keyId });
+                trustManager->removeKeys(ns_omemo_2, QList { keyId });
                 Q_EMIT q->deviceRemoved(jid, deviceId);
             } else {
                 ++devicesItr;
             }
         }
     }
+
+    if (!jidsPendingDeviceRemovalCheck.isEmpty()) {
+        QMetaObject::invokeMethod(
+            q, [this]() {
+                removeDevicesRemovedFromServerSlice();
+            },
+            Qt::QueuedConnection);
+    }
 }
 
 //
@@ -1033,15 +1209,47 @@ QXmppTask<QXmppE2eeExtension::MessageEncryptResult> ManagerPrivate::encryptMessa
 // \param recipientJids JIDs of the devices for whom the stanza is encrypted
 // \param acceptedTrustLevels trust levels the keys of the recipients' devices must have to
 //        encrypt for them
+// \param areTrustLevelsCached whether the trust levels of the recipients' keys have already
+//        been loaded into the trust manager's cache
 //
 // \return the OMEMO element containing the stanza's encrypted content if the encryption is
 //         successful, otherwise none
 //
 template<typename T>
-QXmppTask<std::optional<QXmppOmemoElement>> ManagerPrivate::encryptStanza(const T &stanza, const QVector<QString> &recipientJids, TrustLevels acceptedTrustLevels)
+QXmppTask<std::optional<QXmppOmemoElement>> ManagerPrivate::encryptStanza(const T &stanza, const QVector<QString> &recipientJids, TrustLevels acceptedTrustLevels, bool areTrustLevelsCached)
 {
     Q_ASSERT_X(!recipientJids.isEmpty(), "Creating OMEMO envelope", "OMEMO element could not be created because no recipient JIDs are passed");
 
+    if (const auto jids = recipientJids.toList(); !areDevicesLoaded(jids)) {
+        return withLoadedDevices<std::optional<QXmppOmemoElement>>(jids, [=]() {
+            return encryptStanza(stanza, recipientJids, acceptedTrustLevels);
+        });
+    }
+
+    // Load the trust levels of all recipient devices with one storage request
+    // so that the trust levels requested per device are already cached.
+    if (!areTrustLevelsCached) {
+        QMultiHash<QString, QByteArray> keyIds;
+        for (const auto &jid : recipientJids) {
+            const auto recipientDevices = devices.value(jid);
+            for (const auto &device : recipientDevices) {
+                if (!device.keyId.isEmpty()) {
+                    keyIds.insert(jid, device.keyId);
+                }
+            }
+        }
+
+        if (!keyIds.isEmpty()) {
+            QXmppPromise<std::optional<QXmppOmemoElement>> interface;
+            trustManager->trustLevels(ns_omemo_2, keyIds).then(q, [=](QHash<QString, QHash<QByteArray, TrustLevel>> &&) mutable {
+                encryptStanza(stanza, recipientJids, acceptedTrustLevels, true).then(q, [=](std::optional<QXmppOmemoElement> &&omemoElement) mutable {
+                    interface.finish(std::move(omemoElement));
+                });
+            });
+            return interface.task();
+        }
+    }
+
     QXmppPromise<std::optional<QXmppOmemoElement>> interface;
 
     if (const auto optionalPayloadEncryptionResult = encryptPayload(createSceEnvelope(stanza))) {
@@ -1065,6 +1273,7 @@ QXmppTask<std::optional<QXmppOmemoElement>> ManagerPrivate::encryptStanza(const
             auto processedDevicesCount = std::make_shared<int>(0);
             auto successfullyProcessedDevicesCount = std::make_shared<int>(0);
             auto skippedDevicesCount = std::make_shared<int>(0);
+            auto modifiedDevices = std::make_shared<QHash<QString, QSet<uint32_t>>>();
 
             // Add envelopes for all devices of the recipients.
             for (const auto &jid : recipientJids) {
@@ -1091,6 +1300,8 @@ QXmppTask<std::optional<QXmppOmemoElement>> ManagerPrivate::encryptStanza(const
                         }
 
                         if (++(*processedDevicesCount) == devicesCount) {
+                            storeDevices(*modifiedDevices);
+
                             if (*successfullyProcessedDevicesCount == 0) {
                                 warning("OMEMO element could not be created because no recipient "
                                         "devices with keys having accepted trust levels could be found");
@@ -1106,10 +1317,16 @@ QXmppTask<std::optional<QXmppOmemoElement>> ManagerPrivate::encryptStanza(const
                     const auto address = Address(jid, deviceId);
 
                     auto addOmemoEnvelope = [=](bool isKeyExchange = false) mutable {
+                        // The session is modified by the encryption and stored together with
+                        // all other devices modified for this stanza.
+                        devicesPendingStorage = modifiedDevices.get();
+                        const auto data = createOmemoEnvelopeData(address.data(), payloadEncryptionResult.decryptionData);
+                        devicesPendingStorage = nullptr;
+
                         // Create and add an OMEMO envelope only if its data could be created
                         // and the corresponding device has not been removed by another method
                         // in the meantime.
-                        if (const auto data = createOmemoEnvelopeData(address.data(), payloadEncryptionResult.decryptionData); data.isEmpty()) {
+                        if (data.isEmpty()) {
                             warning("OMEMO envelope for recipient JID '" % jid %
                                     "' and device ID '" % QString::number(deviceId) %
                                     "' could not be created because its data could not be encrypted");
@@ -1118,7 +1335,7 @@ QXmppTask<std::optional<QXmppOmemoElement>> ManagerPrivate::encryptStanza(const
                             auto &deviceBeingModified = devices[jid][deviceId];
                             deviceBeingModified.unrespondedReceivedStanzasCount = 0;
                             ++deviceBeingModified.unrespondedSentStanzasCount;
-                            omemoStorage->addDevice(jid, deviceId, deviceBeingModified);
+                            (*modifiedDevices)[jid].insert(deviceId);
 
                             QXmppOmemoEnvelope omemoEnvelope;
                             omemoEnvelope.setRecipientDeviceId(deviceId);
@@ -1231,8 +1448,8 @@ QXmppTask<std::optional<QXmppOmemoElement>> ManagerPrivate::encryptStanza(const
     return interface.task();
 }
 
-template QXmppTask<std::optional<QXmppOmemoElement>> ManagerPrivate::encryptStanza<QXmppIq>(const QXmppIq &, const QVector<QString> &, TrustLevels);
-template QXmppTask<std::optional<QXmppOmemoElement>> ManagerPrivate::encryptStanza<QXmppMessage>(const QXmppMessage &, const QVector<QString> &, TrustLevels);
+template QXmppTask<std::optional<QXmppOmemoElement>> ManagerPrivate::encryptStanza<QXmppIq>(const QXmppIq &, const QVector<QString> &, TrustLevels, bool);
+template QXmppTask<std::optional<QXmppOmemoElement>> ManagerPrivate::encryptStanza<QXmppMessage>(const QXmppMessage &, const QVector<QString> &, TrustLevels, bool);
 
 //
 // Encrypts a payload symmetrically.
@@ -1379,6 +1596,12 @@ QByteArray ManagerPrivate::createOmemoEnvelopeData(const signal_protocol_address
 //
 QXmppTask<std::optional<QXmppMessage>> ManagerPrivate::decryptMessage(QXmppMessage stanza)
 {
+    if (const auto senderJid = QXmppUtils::jidToBareJid(stanza.from()); !areDevicesLoaded({ senderJid })) {
+        return withLoadedDevices<std::optional<QXmppMessage>>({ senderJid }, [this, stanza]() {
+            return decryptMessage(stanza);
+        });
+    }
+
     // At this point, the stanza has always an OMEMO element.
     const auto omemoElement = *stanza.omemoElement();
 
@@ -1445,6 +1668,12 @@ QXmppTask<std::optional<IqDecryptionResult>> ManagerPrivate::decryptIq(const QDo
 {
     using Result = std::optional<IqDecryptionResult>;
 
+    if (const auto senderJid = QXmppUtils::jidToBareJid(iqElement.attribute(QStringLiteral("from"))); !areDevicesLoaded({ senderJid })) {
+        return withLoadedDevices<Result>({ senderJid }, [this, iqElement]() {
+            return decryptIq(iqElement);
+        });
+    }
+
     QXmppOmemoIq iq;
     iq.parse(iqElement);
     auto omemoElement = iq.omemoElement();
@@ -1493,13 +1722,16 @@ QXmppTask<std::optional<DecryptionResult>> ManagerPrivate::decryptStanza(T stanz
 
     auto future = extractSceEnvelope(senderJid, senderDeviceId, omemoEnvelope, omemoPayload, isMessageStanza);
     future.then(q, [=](QByteArray serializedSceEnvelope) mutable {
-        if (serializedSceEnvelope.isEmpty()) {
+        std::optional<QXmppSceEnvelopeReader> optionalSceEnvelopeReader;
+        if (!serializedSceEnvelope.isEmpty()) {
+            optionalSceEnvelopeReader = QXmppSceEnvelopeReader::fromXml(serializedSceEnvelope);
+        }
+
+        if (!optionalSceEnvelopeReader) {
             warning("SCE envelope could not be extracted");
             interface.finish(std::nullopt);
         } else {
-            QDomDocument document;
-            document.setContent(serializedSceEnvelope, true);
-            QXmppSceEnvelopeReader sceEnvelopeReader(document.documentElement());
+            const auto &sceEnvelopeReader = *optionalSceEnvelopeReader;
 
             if (sceEnvelopeReader.from() != senderJid) {
                 q->info("Sender '" % senderJid % "' of stanza does not match SCE 'from' affix element '" % sceEnvelopeReader.from() % "'");
@@ -1565,7 +1797,9 @@ QXmppTask<QByteArray> ManagerPrivate::extractSceEnvelope(const QString &senderJi
             warning("Data for decrypting OMEMO payload could not be extracted");
             interface.finish(QByteArray());
         } else {
-            interface.finish(decryptPayload(*payloadDecryptionData, omemoPayload));
+            decryptPayload(*payloadDecryptionData, omemoPayload).then(q, [interface](QByteArray &&payload) mutable {
+                interface.finish(std::move(payload));
+            });
         }
     });
 
@@ -1743,12 +1977,14 @@ QXmppTask<std::optional<QCA::SecureArray>> ManagerPrivate::extractPayloadDecrypt
 //
 // Decrypts the OMEMO payload.
 //
+// This only uses the given data and can be run on any thread.
+//
 // \param payloadDecryptionData data needed to decrypt the payload
 // \param payload payload to be decrypted
 //
-// \return the decrypted payload or a default-constructed byte array on failure
+// \return the decrypted payload or an error message on failure
 //
-QByteArray ManagerPrivate::decryptPayload(const QCA::SecureArray &payloadDecryptionData, const QByteArray &payload) const
+static std::variant<QByteArray, QString> decryptPayloadData(const QCA::SecureArray &payloadDecryptionData, const QByteArray &payload)
 {
     auto hkdfKey = QCA::SecureArray(payloadDecryptionData);
     hkdfKey.resize(HKDF_KEY_SIZE);
@@ -1771,8 +2007,7 @@ QByteArray ManagerPrivate::decryptPayload(const QCA::SecureArray &payloadDecrypt
     std::copy(initializationVectorOffset, initializationVectorOffset + PAYLOAD_INITIALIZATION_VECTOR_SIZE, initializationVector.data());
 
     if (!QCA::MessageAuthenticationCode::supportedTypes().contains(PAYLOAD_MESSAGE_AUTHENTICATION_CODE_TYPE)) {
-        warning("Message authentication code type '" % QString(PAYLOAD_MESSAGE_AUTHENTICATION_CODE_TYPE) % "' is not supported by this system");
-        return {};
+        return QString("Message authentication code type '" % QString(PAYLOAD_MESSAGE_AUTHENTICATION_CODE_TYPE) % "' is not supported by this system");
     }
 
     auto messageAuthenticationCodeGenerator = QCA::MessageAuthenticationCode(PAYLOAD_MESSAGE_AUTHENTICATION_CODE_TYPE, authenticationKey);
@@ -1782,21 +2017,48 @@ QByteArray ManagerPrivate::decryptPayload(const QCA::SecureArray &payloadDecrypt
     auto expectedMessageAuthenticationCode = QCA::SecureArray(payloadDecryptionData.toByteArray().right(PAYLOAD_MESSAGE_AUTHENTICATION_CODE_SIZE));
 
     if (messageAuthenticationCode != expectedMessageAuthenticationCode) {
-        warning("Message authentication code does not match expected one");
-        return {};
+        return QStringLiteral("Message authentication code does not match expected one");
     }
 
     QCA::Cipher cipher(PAYLOAD_CIPHER_TYPE, PAYLOAD_CIPHER_MODE, PAYLOAD_CIPHER_PADDING, QCA::Decode, encryptionKey, initializationVector);
     auto decryptedPayload = cipher.process(QCA::MemoryRegion(payload));
 
     if (decryptedPayload.isEmpty()) {
-        warning("Following payload could not be decrypted: " % QString(payload));
-        return {};
+        return QString("Following payload could not be decrypted: " % QString(payload));
     }
 
     return decryptedPayload.toByteArray();
 }
 
+//
+// Decrypts the OMEMO payload on the global thread pool.
+//
+// The session has already been advanced on the manager's thread when the
+// payload decryption data has been extracted. Therefore, the symmetric
+// decryption of independent payloads (e.g., of a MAM page) can run in
+// parallel.
+//
+// \param payloadDecryptionData data needed to decrypt the payload
+// \param payload payload to be decrypted
+//
+// \return the decrypted payload or a default-constructed byte array on failure
+//
+QXmppTask<QByteArray> ManagerPrivate::decryptPayload(const QCA::SecureArray &payloadDecryptionData, const QByteArray &payload)
+{
+    using Result = std::variant<QByteArray, QString>;
+
+    auto decryption = runAsync(QThreadPool::globalInstance(), [payloadDecryptionData, payload]() {
+        return decryptPayloadData(payloadDecryptionData, payload);
+    });
+    return chain<QByteArray>(std::move(decryption), q, [this](Result &&result) {
+        if (auto *error = std::get_if<QString>(&result)) {
+            warning(*error);
+            return QByteArray();
+        }
+        return std::get<QByteArray>(std::move(result));
+    });
+}
+
 //
 // Publishes the OMEMO data for this device.
 //
@@ -2236,6 +2498,7 @@ QXmppTask<std::optional<QXmppOmemoDeviceBundle>> ManagerPrivate::requestDeviceBu
     QXmppPromise<std::optional<QXmppOmemoDeviceBundle>> interface;
 
     auto future = pubSubManager->requestItem<QXmppOmemoDeviceBundleItem>(deviceOwnerJid, ns_omemo_2_bundles, QString::number(deviceId));
+    interface.forwardCancellation(future);
     future.then(q, [=](QXmppPubSubManager::ItemResult<QXmppOmemoDeviceBundleItem> result) mutable {
         if (const auto error = std::get_if<QXmppError>(&result)) {
             warning("Device bundle for JID '" % deviceOwnerJid % "' and device ID '" %
@@ -2652,7 +2915,7 @@ void ManagerPrivate::updateDevices(const QString &deviceOwnerJid, const QXmppOme
     }
 
     if (isOwnDeviceListNode) {
-        QList<uint32_t> deviceIds;
+        QSet<uint32_t> deviceIds;
 
         // Search for inconsistencies in the device list to keep it
         // correct.
@@ -2668,7 +2931,7 @@ void ManagerPrivate::updateDevices(const QString &deviceOwnerJid, const QXmppOme
                 isOwnDeviceListIncorrect = true;
                 itr = deviceList.erase(itr);
             } else {
-                deviceIds.append(deviceElementId);
+                deviceIds.insert(deviceElementId);
 
                 if (itr->id() == ownDevice.id) {
                     if (itr->label() != ownDevice.label) {
@@ -2683,85 +2946,69 @@ void ManagerPrivate::updateDevices(const QString &deviceOwnerJid, const QXmppOme
         }
     }
 
-    // Set a timestamp for locally stored devices that are removed later if
-    // they are not included in the device list (i.e., they were removed
-    // by their owner).
+    // device IDs mapped to the elements of the device list
+    QHash<uint32_t, const QXmppOmemoDeviceElement *> deviceElements;
+    deviceElements.reserve(deviceList.size());
+    for (const auto &deviceElement : std::as_const(deviceList)) {
+        deviceElements.insert(deviceElement.id(), &deviceElement);
+    }
+
+    // Only the differences between the locally stored devices and the device
+    // list are stored.
     auto &ownerDevices = devices[deviceOwnerJid];
     for (auto itr = ownerDevices.begin(); itr != ownerDevices.end(); ++itr) {
         const auto &deviceId = itr.key();
         auto &device = itr.value();
-        auto isDeviceFound = false;
 
-        for (const auto &deviceElement : std::as_const(deviceList)) {
-            if (deviceId == deviceElement.id()) {
-                isDeviceFound = true;
-                break;
-            }
-        }
-
-        if (!isDeviceFound) {
-            device.removalFromDeviceListDate = QDateTime::currentDateTimeUtc();
-            omemoStorage->addDevice(deviceOwnerJid, deviceId, device);
-        }
-    }
+        if (const auto *deviceElement = deviceElements.take(deviceId)) {
+            auto isDeviceModified = false;
+            auto isDeviceLabelModified = false;
 
-    // Update locally stored devices if they are modified in the device
-    // list or store devices locally if they are new in the device list.
-    for (const auto &deviceElement : std::as_const(deviceList)) {
-        auto isDeviceFound = false;
-
-        for (auto itr = ownerDevices.begin(); itr != ownerDevices.end(); ++itr) {
-            const auto &deviceId = itr.key();
-            auto &device = itr.value();
-
-            if (deviceId == deviceElement.id()) {
-                auto isDeviceModified = false;
-                auto isDeviceLabelModified = false;
-
-                // Reset the date of removal from server, if it has been
-                // removed before.
-                if (!device.removalFromDeviceListDate.isNull()) {
-                    device.removalFromDeviceListDate = {};
-                    isDeviceModified = true;
-                }
+            // Reset the date of removal from server, if it has been removed
+            // before.
+            if (!device.removalFromDeviceListDate.isNull()) {
+                device.removalFromDeviceListDate = {};
+                isDeviceModified = true;
+            }
 
-                // Update the stored label if it differs from the new
-                // one.
-                if (device.label != deviceElement.label()) {
-                    device.label = deviceElement.label();
-                    isDeviceModified = true;
-                    isDeviceLabelModified = true;
-                }
+            // Update the stored label if it differs from the new one.
+            if (device.label != deviceElement->label()) {
+                device.label = deviceElement->label();
+                isDeviceModified = true;
+                isDeviceLabelModified = true;
+            }
 
-                // Store the modifications.
-                if (isDeviceModified) {
-                    omemoStorage->addDevice(deviceOwnerJid, deviceId, device);
+            // Store the modifications.
+            if (isDeviceModified) {
+                omemoStorage->addDevice(deviceOwnerJid, deviceId, device);
 
-                    if (isDeviceLabelModified) {
-                        Q_EMIT q->deviceChanged(deviceOwnerJid, deviceId);
-                    }
+                if (isDeviceLabelModified) {
+                    Q_EMIT q->deviceChanged(deviceOwnerJid, deviceId);
                 }
-
-                isDeviceFound = true;
-                break;
             }
-        }
-
-        // Create a new entry and store it if there is no such entry
-        // yet.
-        if (!isDeviceFound) {
-            const auto deviceId = deviceElement.id();
-            auto &device = ownerDevices[deviceId];
-            device.label = deviceElement.label();
+        } else if (device.removalFromDeviceListDate.isNull()) {
+            // Set a timestamp for locally stored devices that are removed
+            // later if they are not included in the device list (i.e., they
+            // were removed by their owner).
+            device.removalFromDeviceListDate = QDateTime::currentDateTimeUtc();
             omemoStorage->addDevice(deviceOwnerJid, deviceId, device);
-
-            auto future = buildSessionForNewDevice(deviceOwnerJid, deviceId, device);
-            future.then(q, [=](auto) {
-                Q_EMIT q->deviceAdded(deviceOwnerJid, deviceId);
-            });
         }
     }
 
+    // Create new entries for the remaining devices that are new in the device
+    // list and store them.
+    for (const auto *deviceElement : std::as_const(deviceElements)) {
+        const auto deviceId = deviceElement->id();
+        auto &device = ownerDevices[deviceId];
+        device.label = deviceElement->label();
+        omemoStorage->addDevice(deviceOwnerJid, deviceId, device);
+
+        auto future = buildSessionForNewDevice(deviceOwnerJid, deviceId, device);
+        future.then(q, [=](auto) {
+            Q_EMIT q->deviceAdded(deviceOwnerJid, deviceId);
+        });
+    }
+
     // Publish an own correct device list if the PEP service's one is incorrect
     // and the devices are already set up locally.
     if (isOwnDeviceListIncorrect) {
@@ -2832,14 +3079,17 @@ void ManagerPrivate::handleIrregularDeviceListChanges(const QString &deviceOwner
         // Set a timestamp for locally stored contact devices being removed
         // later if their device list item is removed, if their device list node
         // is removed or if all the node's items are removed.
+        // Devices that already have such a timestamp keep it.
         for (auto itr = ownerDevices.begin(); itr != ownerDevices.end(); ++itr) {
             const auto &deviceId = itr.key();
             auto &device = itr.value();
 
-            device.removalFromDeviceListDate = QDateTime::currentDateTimeUtc();
+            if (device.removalFromDeviceListDate.isNull()) {
+                device.removalFromDeviceListDate = QDateTime::currentDateTimeUtc();
 
-            // Store the modification.
-            omemoStorage->addDevice(deviceOwnerJid, deviceId, device);
+                // Store the modification.
+                omemoStorage->addDevice(deviceOwnerJid, deviceId, device);
+            }
         }
     }
 }
@@ -3037,6 +3287,12 @@ QXmppTask<bool> ManagerPrivate::changeDeviceLabel(const QString &deviceLabel)
 //
 QXmppTask<QXmppPubSubManager::ItemResult<QXmppOmemoDeviceListItem>> ManagerPrivate::requestDeviceList(const QString &jid)
 {
+    if (!areDevicesLoaded({ jid })) {
+        return withLoadedDevices<QXmppPubSubManager::ItemResult<QXmppOmemoDeviceListItem>>({ jid }, [this, jid]() {
+            return requestDeviceList(jid);
+        });
+    }
+
     QXmppPromise<QXmppPubSubManager::ItemResult<QXmppOmemoDeviceListItem>> interface;
 
     // Since the usage of the item ID \c QXmppPubSubManager::Current is only RECOMMENDED by
@@ -3044,22 +3300,73 @@ QXmppTask<QXmppPubSubManager::ItemResult<QXmppOmemoDeviceListItem>> ManagerPriva
     // the node should contain only one item.
     auto future = pubSubManager->requestItems<QXmppOmemoDeviceListItem>(jid, ns_omemo_2_devices);
     future.then(q, [this, interface, jid](QXmppPubSubManager::ItemsResult<QXmppOmemoDeviceListItem> result) mutable {
-        if (const auto error = std::get_if<QXmppError>(&result)) {
-            warning("Device list for JID '" % jid % "' could not be retrieved: " % errorToString(*error));
-            interface.finish(*error);
-        } else if (const auto &items = std::get<QXmppPubSubManager::Items<QXmppOmemoDeviceListItem>>(result).items; items.isEmpty()) {
-            const auto errorMessage = "Device list for JID '" % jid % "' could not be retrieved because the node does not contain any item";
-            warning(errorMessage);
-            interface.finish(QXmppError { errorMessage });
-        } else if (const auto item = updateContactDevices(jid, items); item) {
-            interface.finish(*item);
-        } else {
-            interface.finish(QXmppError { "Device list for JID '" % jid % "' could not be retrieved because the node does not contain an appropriate item" });
+        interface.finish(handleRequestedDeviceList(jid, std::move(result)));
+    });
+    return interface.task();
+}
+
+//
+// Requests the device lists of multiple contacts manually and stores them
+// locally.
+//
+// The requests are batched by the PubSub manager, so only a limited number of
+// them is sent at the same time.
+//
+// \param jids JIDs of the contacts whose device lists are being requested
+//
+// \return the results of the requests in the order of the JIDs
+//
+QXmppTask<QVector<QXmppPubSubManager::ItemResult<QXmppOmemoDeviceListItem>>> ManagerPrivate::requestDeviceLists(const QList<QString> &jids)
+{
+    using Results = QVector<QXmppPubSubManager::ItemResult<QXmppOmemoDeviceListItem>>;
+
+    if (!areDevicesLoaded(jids)) {
+        return withLoadedDevices<Results>(jids, [this, jids]() {
+            return requestDeviceLists(jids);
+        });
+    }
+
+    QVector<std::pair<QString, QString>> nodes;
+    nodes.reserve(jids.size());
+    for (const auto &jid : jids) {
+        nodes.push_back({ jid, QString::fromLatin1(ns_omemo_2_devices) });
+    }
+
+    QXmppPromise<Results> interface;
+    pubSubManager->requestItemsBatch<QXmppOmemoDeviceListItem>(nodes).then(q, [this, interface, jids](QVector<QXmppPubSubManager::ItemsResult<QXmppOmemoDeviceListItem>> &&itemsResults) mutable {
+        Results results;
+        results.reserve(itemsResults.size());
+        for (int i = 0; i < itemsResults.size(); i++) {
+            results.push_back(handleRequestedDeviceList(jids.at(i), std::move(itemsResults[i])));
         }
+        interface.finish(std::move(results));
     });
     return interface.task();
 }
 
+//
+// Stores the devices of a requested device list.
+//
+// \param jid JID of the contact whose device list has been requested
+// \param result result of the request
+//
+// \return the stored device list item or an error
+//
+QXmppPubSubManager::ItemResult<QXmppOmemoDeviceListItem> ManagerPrivate::handleRequestedDeviceList(const QString &jid, QXmppPubSubManager::ItemsResult<QXmppOmemoDeviceListItem> &&result)
+{
+    if (const auto error = std::get_if<QXmppError>(&result)) {
+        warning("Device list for JID '" % jid % "' could not be retrieved: " % errorToString(*error));
+        return std::move(*error);
+    } else if (const auto &items = std::get<QXmppPubSubManager::Items<QXmppOmemoDeviceListItem>>(result).items; items.isEmpty()) {
+        const auto errorMessage = "Device list for JID '" % jid % "' could not be retrieved because the node does not contain any item";
+        warning(errorMessage);
+        return QXmppError { errorMessage };
+    } else if (const auto item = updateContactDevices(jid, items); item) {
+        return *item;
+    }
+    return QXmppError { "Device list for JID '" % jid % "' could not be retrieved because the node does not contain an appropriate item" };
+}
+
 //
 // Subscribes to the device list of a contact if the contact's device is not stored yet.
 //
@@ -3068,11 +3375,41 @@ QXmppTask<QXmppPubSubManager::ItemResult<QXmppOmemoDeviceListItem>> ManagerPriva
 //
 void ManagerPrivate::subscribeToNewDeviceLists(const QString &jid, uint32_t deviceId)
 {
-    if (!devices.value(jid).contains(deviceId)) {
-        subscribeToDeviceList(jid);
+    // Multiple stanzas from a new device result in only one request.
+    if (!devices.value(jid).contains(deviceId) && !jidsOfPendingDeviceListSubscriptions.contains(jid)) {
+        jidsOfPendingDeviceListSubscriptions.insert(jid);
+        subscribeToDeviceList(jid).then(q, [this, jid](auto) {
+            jidsOfPendingDeviceListSubscriptions.remove(jid);
+        });
     }
 }
 
+//
+// Returns whether changes of a device list are delivered without a manual subscription.
+//
+// The device lists of the own account and of contacts with a presence
+// subscription are delivered via \xep{0163, Personal Eventing Protocol}
+// notifications because of the "+notify" feature announced by
+// QXmppOmemoManager::discoveryFeatures().
+//
+// \param jid JID of the device list's owner
+//
+// \return whether the device list is delivered via notifications
+//
+bool ManagerPrivate::isDeviceListNotified(const QString &jid) const
+{
+    if (jid == ownBareJid()) {
+        return true;
+    }
+
+    if (const auto *rosterManager = q->client()->findExtension<QXmppRosterManager>()) {
+        const auto subscriptionType = rosterManager->getRosterEntry(jid).subscriptionType();
+        return subscriptionType == QXmppRosterIq::Item::To || subscriptionType == QXmppRosterIq::Item::Both;
+    }
+
+    return false;
+}
+
 //
 // Subscribes the current user's resource to a device list manually.
 //
@@ -3080,6 +3417,10 @@ void ManagerPrivate::subscribeToNewDeviceLists(const QString &jid, uint32_t devi
 // To ensure that the subscribed device list can be stored locally in any case,
 // the current PubSub item containing the device list is requested manually.
 //
+// No subscription is made if the device list is already delivered via
+// notifications or it is already subscribed. Then, only the current device list
+// is requested.
+//
 // \param jid JID of the contact whose device list is being subscribed
 //
 // \return the result of the subscription and manual request
@@ -3088,6 +3429,18 @@ QXmppTask<QXmppPubSubManager::Result> ManagerPrivate::subscribeToDeviceList(cons
 {
     QXmppPromise<QXmppPubSubManager::Result> interface;
 
+    const auto requestCurrentDeviceList = [=]() mutable {
+        auto future = requestDeviceList(jid);
+        future.then(q, [=](auto result) mutable {
+            interface.finish(mapToSuccess(std::move(result)));
+        });
+    };
+
+    if (isDeviceListNotified(jid) || jidsOfManuallySubscribedDevices.contains(jid)) {
+        requestCurrentDeviceList();
+        return interface.task();
+    }
+
     auto future = pubSubManager->subscribeToNode(jid, ns_omemo_2_devices, ownFullJid());
     future.then(q, [=](QXmppPubSubManager::Result result) mutable {
         if (const auto error = std::get_if<QXmppError>(&result)) {
@@ -3095,11 +3448,7 @@ QXmppTask<QXmppPubSubManager::Result> ManagerPrivate::subscribeToDeviceList(cons
             interface.finish(std::move(*error));
         } else {
             jidsOfManuallySubscribedDevices.append(jid);
-
-            auto future = requestDeviceList(jid);
-            future.then(q, [=](auto result) mutable {
-                interface.finish(mapToSuccess(std::move(result)));
-            });
+            requestCurrentDeviceList();
         }
     });
 
@@ -3268,6 +3617,231 @@ QXmppTask<bool> ManagerPrivate::buildSessionForNewDevice(const QString &jid, uin
     }
 }
 
+//
+// Returns whether the devices of the passed JIDs are available in memory.
+//
+// That is always the case if the storage does not load devices on demand.
+//
+// \param jids JIDs of the device owners
+//
+// \return whether all devices are loaded
+//
+bool ManagerPrivate::areDevicesLoaded(const QList<QString> &jids) const
+{
+    if (!omemoStorage->isLazyDeviceLoadingSupported()) {
+        return true;
+    }
+
+    return std::all_of(jids.cbegin(), jids.cend(), [this](const QString &jid) {
+        return jidsWithLoadedDevices.contains(jid);
+    });
+}
+
+//
+// Loads the devices of the passed JIDs from a storage loading devices on
+// demand.
+//
+// Devices that are already in memory are newer than the stored ones and kept.
+//
+// \param jids JIDs of the device owners
+//
+// \return the task finished after all devices are loaded
+//
+QXmppTask<void> ManagerPrivate::loadDevices(const QList<QString> &jids)
+{
+    if (areDevicesLoaded(jids)) {
+        return makeReadyTask();
+    }
+
+    struct State
+    {
+        QXmppPromise<void> interface;
+        // one additional count is held until all loads are started
+        int pendingCount = 1;
+
+        void finishOne()
+        {
+            if (--pendingCount == 0) {
+                interface.finish();
+            }
+        }
+    };
+
+    auto state = std::make_shared<State>();
+    auto task = state->interface.task();
+
+    for (const auto &jid : jids) {
+        if (jidsWithLoadedDevices.contains(jid)) {
+            continue;
+        }
+
+        state->pendingCount++;
+
+        auto &waitingFunctions = pendingDeviceLoads[jid];
+        const auto isLoadRunning = !waitingFunctions.isEmpty();
+        waitingFunctions.append([state]() {
+            state->finishOne();
+        });
+
+        if (!isLoadRunning) {
+            omemoStorage->devices(jid).then(q, [this, jid](QHash<uint32_t, QXmppOmemoStorage::Device> &&storedDevices) {
+                if (!storedDevices.isEmpty()) {
+                    auto &jidDevices = devices[jid];
+                    for (auto itr = storedDevices.cbegin(); itr != storedDevices.cend(); ++itr) {
+                        if (!jidDevices.contains(itr.key())) {
+                            jidDevices.insert(itr.key(), itr.value());
+                        }
+                    }
+                }
+
+                jidsWithLoadedDevices.insert(jid);
+
+                const auto waitingFunctions = pendingDeviceLoads.take(jid);
+                for (const auto &function : waitingFunctions) {
+                    function();
+                }
+            });
+        }
+    }
+
+    state->finishOne();
+    return task;
+}
+
+//
+// Marks a device for being stored.
+//
+// If a stanza is being encrypted, the device is stored together with all
+// devices modified during the encryption of that stanza.
+// Otherwise, it is stored together with all devices modified during the
+// current event loop iteration.
+//
+// \param jid JID of the device's owner
+// \param deviceId ID of the device
+//
+void ManagerPrivate::storeDevice(const QString &jid, uint32_t deviceId)
+{
+    if (devicesPendingStorage) {
+        (*devicesPendingStorage)[jid].insert(deviceId);
+    } else {
+        unstoredDevices[jid].insert(deviceId);
+        if (!deviceStorageTimer.isActive()) {
+            deviceStorageTimer.start();
+        }
+    }
+}
+
+//
+// Stores multiple devices at once.
+//
+// Devices which have been removed in the meantime are skipped.
+//
+// \param deviceIds JIDs of the device owners mapped to the IDs of the devices
+//        being stored
+//
+void ManagerPrivate::storeDevices(const QHash<QString, QSet<uint32_t>> &deviceIds)
+{
+    QHash<QString, QHash<uint32_t, QXmppOmemoStorage::Device>> modifiedDevices;
+
+    for (auto itr = deviceIds.cbegin(); itr != deviceIds.cend(); ++itr) {
+        const auto devicesItr = devices.constFind(itr.key());
+        if (devicesItr == devices.cend()) {
+            continue;
+        }
+
+        auto &jidDevices = modifiedDevices[itr.key()];
+        for (const auto deviceId : *itr) {
+            if (const auto deviceItr = devicesItr->constFind(deviceId); deviceItr != devicesItr->cend()) {
+                jidDevices.insert(deviceId, *deviceItr);
+            }
+        }
+    }
+
+    if (!modifiedDevices.isEmpty()) {
+        omemoStorage->addDevices(modifiedDevices);
+    }
+}
+
+//
+// Stores all devices marked by storeDevice() that are not stored yet.
+//
+void ManagerPrivate::storeUnstoredDevices()
+{
+    deviceStorageTimer.stop();
+    if (!unstoredDevices.isEmpty()) {
+        storeDevices(std::exchange(unstoredDevices, {}));
+    }
+}
+
+//
+// Enqueues building a session with a device.
+//
+// The session is built as soon as less than the maximum of concurrent session
+// builds are running.
+//
+// \param jid JID of the device's owner
+// \param deviceId ID of the device
+// \param finished function called after the session building is processed
+//
+void ManagerPrivate::enqueueSessionBuilding(const QString &jid, uint32_t deviceId, std::function<void()> finished)
+{
+    sessionBuildingQueue.push_back({ jid, deviceId, std::move(finished) });
+    totalSessionBuildsCount++;
+    processSessionBuildingQueue();
+}
+
+//
+// Starts enqueued session builds until the maximum of concurrent session
+// builds is reached.
+//
+void ManagerPrivate::processSessionBuildingQueue()
+{
+    while (runningSessionBuildsCount < maximumConcurrentSessionBuilds && !sessionBuildingQueue.empty()) {
+        auto sessionBuilding = std::move(sessionBuildingQueue.front());
+        sessionBuildingQueue.pop_front();
+
+        // The device may have been removed or a session may have been built by
+        // another method in the meantime.
+        auto devicesItr = devices.find(sessionBuilding.jid);
+        if (devicesItr == devices.end()) {
+            finishSessionBuilding(sessionBuilding);
+            continue;
+        }
+        auto deviceItr = devicesItr->find(sessionBuilding.deviceId);
+        if (deviceItr == devicesItr->end() || !deviceItr->session.isEmpty()) {
+            finishSessionBuilding(sessionBuilding);
+            continue;
+        }
+
+        runningSessionBuildsCount++;
+        auto future = buildSessionWithDeviceBundle(sessionBuilding.jid, sessionBuilding.deviceId, *deviceItr);
+        future.then(q, [this, sessionBuilding = std::move(sessionBuilding)](bool) {
+            runningSessionBuildsCount--;
+            finishSessionBuilding(sessionBuilding);
+            processSessionBuildingQueue();
+        });
+    }
+}
+
+//
+// Reports the progress of a processed session building.
+//
+// \param sessionBuilding processed session building
+//
+void ManagerPrivate::finishSessionBuilding(const SessionBuilding &sessionBuilding)
+{
+    const auto processedCount = ++processedSessionBuildsCount;
+    const auto totalCount = totalSessionBuildsCount;
+
+    if (sessionBuildingQueue.empty() && runningSessionBuildsCount == 0) {
+        processedSessionBuildsCount = 0;
+        totalSessionBuildsCount = 0;
+    }
+
+    Q_EMIT q->sessionBuildingProgressChanged(processedCount, totalCount);
+    sessionBuilding.finished();
+}
+
 //
 // Requests a device bundle and builds a new session with it.
 //
@@ -3578,52 +4152,91 @@ bool ManagerPrivate::deserializePublicPreKey(ec_public_key **publicPreKey, const
 // It is used to trigger the completion, rebuilding or refreshing of OMEMO
 // sessions.
 //
+// The envelopes for all devices of a JID requested within
+// EMPTY_MESSAGE_SENDING_DELAY are sent together in one message, e.g., after
+// building sessions for several new devices of a contact.
+//
 // \param recipientJid JID of the message's recipient
 // \param recipientDeviceId ID of the recipient's device
 // \param isKeyExchange whether the message is used to build a new session
 //
 // \return the result of the sending
 //
-QXmppTask<QXmpp::SendResult> ManagerPrivate::sendEmptyMessage(const QString &recipientJid, uint32_t recipientDeviceId, bool isKeyExchange) const
+QXmppTask<QXmpp::SendResult> ManagerPrivate::sendEmptyMessage(const QString &recipientJid, uint32_t recipientDeviceId, bool isKeyExchange)
 {
     QXmppPromise<QXmpp::SendResult> interface;
 
-    const auto address = Address(recipientJid, recipientDeviceId);
-    const auto decryptionData = QCA::SecureArray(EMPTY_MESSAGE_DECRYPTION_DATA_SIZE);
+    auto &envelope = pendingEmptyMessages[recipientJid][recipientDeviceId];
+    envelope.isKeyExchange = envelope.isKeyExchange || isKeyExchange;
+    envelope.promises.append(interface);
 
-    if (const auto data = createOmemoEnvelopeData(address.data(), decryptionData); data.isEmpty()) {
-        warning("OMEMO envelope for recipient JID '" % recipientJid % "' and device ID '" %
-                QString::number(recipientDeviceId) %
-                "' could not be created because its data could not be encrypted");
-        QXmppError error {
-            QStringLiteral("OMEMO envelope could not be created"),
-            SendError::EncryptionError
-        };
-        interface.finish(error);
-    } else {
-        QXmppOmemoEnvelope omemoEnvelope;
-        omemoEnvelope.setRecipientDeviceId(recipientDeviceId);
-        if (isKeyExchange) {
-            omemoEnvelope.setIsUsedForKeyExchange(true);
-        }
-        omemoEnvelope.setData(data);
+    if (!emptyMessageTimer.isActive()) {
+        emptyMessageTimer.start();
+    }
+
+    return interface.task();
+}
+
+//
+// Sends one empty OMEMO message per JID for all devices of that JID collected by
+// sendEmptyMessage().
+//
+void ManagerPrivate::sendPendingEmptyMessages()
+{
+    const auto pendingMessages = std::exchange(pendingEmptyMessages, {});
+
+    for (auto itr = pendingMessages.cbegin(); itr != pendingMessages.cend(); ++itr) {
+        const auto &recipientJid = itr.key();
 
         QXmppOmemoElement omemoElement;
-        omemoElement.addEnvelope(recipientJid, omemoEnvelope);
         omemoElement.setSenderDeviceId(ownDevice.id);
 
+        // promises of the devices whose envelopes are included in the message
+        QVector<QXmppPromise<QXmpp::SendResult>> promises;
+
+        for (auto envelopeItr = itr->cbegin(); envelopeItr != itr->cend(); ++envelopeItr) {
+            const auto recipientDeviceId = envelopeItr.key();
+            const auto address = Address(recipientJid, recipientDeviceId);
+            const auto decryptionData = QCA::SecureArray(EMPTY_MESSAGE_DECRYPTION_DATA_SIZE);
+
+            if (const auto data = createOmemoEnvelopeData(address.data(), decryptionData); data.isEmpty()) {
+                warning("OMEMO envelope for recipient JID '" % recipientJid % "' and device ID '" %
+                        QString::number(recipientDeviceId) %
+                        "' could not be created because its data could not be encrypted");
+                for (auto promise : envelopeItr->promises) {
+                    promise.finish(QXmppError {
+                        QStringLiteral("OMEMO envelope could not be created"),
+                        SendError::EncryptionError });
+                }
+            } else {
+                QXmppOmemoEnvelope omemoEnvelope;
+                omemoEnvelope.setRecipientDeviceId(recipientDeviceId);
+                if (envelopeItr->isKeyExchange) {
+                    omemoEnvelope.setIsUsedForKeyExchange(true);
+                }
+                omemoEnvelope.setData(data);
+
+                omemoElement.addEnvelope(recipientJid, omemoEnvelope);
+                promises.append(envelopeItr->promises);
+            }
+        }
+
+        if (promises.isEmpty()) {
+            continue;
+        }
+
         QXmppMessage message;
         message.setTo(recipientJid);
         message.addHint(QXmppMessage::Store);
         message.setOmemoElement(omemoElement);
 
         auto future = q->client()->send(std::move(message));
-        future.then(q, [=](QXmpp::SendResult result) mutable {
-            interface.finish(std::move(result));
+        future.then(q, [promises](QXmpp::SendResult result) mutable {
+            for (auto &promise : promises) {
+                promise.finish(QXmpp::SendResult(result));
+            }
         });
     }
-
-    return interface.task();
 }
 
 //
@@ -14,7 +14,12 @@
 
 #include "OmemoLibWrappers.h"
 #include "QcaInitializer_p.h"
+#include <deque>
+#include <functional>
+
 #include <QDomElement>
+#include <QSet>
+#include <QThreadPool>
 #include <QTimer>
 #include <QtCrypto>
 
@@ -54,6 +59,9 @@ constexpr int UNRESPONDED_STANZAS_UNTIL_HEARTBEAT_MESSAGE_IS_SENT = 53;
 // size of empty OMEMO message's decryption data
 constexpr int EMPTY_MESSAGE_DECRYPTION_DATA_SIZE = 32;
 
+// delay for collecting the devices of a JID for whom one empty OMEMO message is sent
+constexpr auto EMPTY_MESSAGE_SENDING_DELAY = 100ms;
+
 // workaround for PubSub nodes that are not configurable to store 'max' as the value for
 // 'pubsub#max_items'
 constexpr uint64_t PUBSUB_NODE_MAX_ITEMS_1 = 1000;
@@ -66,12 +74,22 @@ constexpr uint32_t PRE_KEY_ID_MAX = std::numeric_limits<int32_t>::max();
 constexpr uint32_t SIGNED_PRE_KEY_ID_MAX = std::numeric_limits<int32_t>::max();
 constexpr uint32_t PRE_KEY_INITIAL_CREATION_COUNT = 100;
 
+// count of pre key pairs below which new ones are generated
+constexpr int PRE_KEY_LOW_WATER_MARK = 90;
+
+// delay for generating pre key pairs and publishing the device bundle after a
+// pre key has been used, so that multiple used pre keys are handled at once
+constexpr auto PRE_KEY_MAINTENANCE_DELAY = 5s;
+
 // maximum count of devices stored per JID
 constexpr int DEVICES_PER_JID_MAX = 200;
 
 // maximum count of devices for whom a stanza is encrypted
 constexpr int DEVICES_PER_STANZA_MAX = 1000;
 
+// default count of device bundles requested at the same time to build sessions
+constexpr int CONCURRENT_SESSION_BUILDS_MAX = 10;
+
 // interval to remove old signed pre keys and create new ones
 constexpr auto SIGNED_PRE_KEY_RENEWAL_INTERVAL = 24h * 7 * 4;
 
@@ -84,6 +102,9 @@ constexpr auto DEVICE_REMOVAL_INTERVAL = 24h * 7 * 12;
 // interval to check for devices removed from their servers
 constexpr auto DEVICE_REMOVAL_CHECK_INTERVAL = 24h;
 
+// maximum duration of checking for devices removed from their servers per event loop iteration
+constexpr auto DEVICE_REMOVAL_SLICE_DURATION = 5ms;
+
 constexpr auto PAYLOAD_CIPHER_TYPE = "aes256";
 constexpr QCA::Cipher::Mode PAYLOAD_CIPHER_MODE = QCA::Cipher::CBC;
 constexpr QCA::Cipher::Padding PAYLOAD_CIPHER_PADDING = QCA::Cipher::PKCS7;
@@ -122,6 +143,14 @@ struct IqDecryptionResult
     QXmppE2eeMetadata e2eeMetadata;
 };
 
+struct GeneratedPreKeyPairs
+{
+    // pre key IDs mapped to serialized pre key pairs
+    QHash<uint32_t, QByteArray> preKeyPairs;
+    // pre key IDs mapped to serialized public pre keys
+    QHash<uint32_t, QByteArray> publicPreKeys;
+};
+
 }  // namespace QXmpp::Omemo::Private
 
 using namespace QXmpp::Private;
@@ -144,21 +173,66 @@ public:
     QcaInitializer cryptoLibInitializer;
     QTimer signedPreKeyPairsRenewalTimer;
     QTimer deviceRemovalTimer;
+    QTimer deviceStorageTimer;
+    QTimer preKeyMaintenanceTimer;
+    QTimer emptyMessageTimer;
 
     TrustLevels acceptedSessionBuildingTrustLevels = ACCEPTED_TRUST_LEVELS;
 
     QXmppOmemoStorage::OwnDevice ownDevice;
     QHash<uint32_t, QByteArray> preKeyPairs;
+    bool isPreKeyGenerationRunning = false;
     QHash<uint32_t, QXmppOmemoStorage::SignedPreKeyPair> signedPreKeyPairs;
     QXmppOmemoDeviceBundle deviceBundle;
 
     int maximumDevicesPerJid = DEVICES_PER_JID_MAX;
     int maximumDevicesPerStanza = DEVICES_PER_STANZA_MAX;
 
+    struct SessionBuilding
+    {
+        QString jid;
+        uint32_t deviceId;
+        std::function<void()> finished;
+    };
+
+    // session builds waiting for a free slot
+    std::deque<SessionBuilding> sessionBuildingQueue;
+    int maximumConcurrentSessionBuilds = CONCURRENT_SESSION_BUILDS_MAX;
+    int runningSessionBuildsCount = 0;
+    int processedSessionBuildsCount = 0;
+    int totalSessionBuildsCount = 0;
+
     // recipient JID mapped to device ID mapped to device
     QHash<QString, QHash<uint32_t, QXmppOmemoStorage::Device>> devices;
 
+    // JIDs whose devices have been loaded from a storage loading devices on demand
+    QSet<QString> jidsWithLoadedDevices;
+    // JIDs whose devices are being loaded mapped to functions called afterwards
+    QHash<QString, QVector<std::function<void()>>> pendingDeviceLoads;
+
+    // devices modified while encrypting a stanza which are stored together
+    // once the stanza is encrypted, null if no stanza is being encrypted
+    QHash<QString, QSet<uint32_t>> *devicesPendingStorage = nullptr;
+    // devices modified since the last run of deviceStorageTimer
+    QHash<QString, QSet<uint32_t>> unstoredDevices;
+
     QList<QString> jidsOfManuallySubscribedDevices;
+    // JIDs whose device lists are being subscribed by subscribeToNewDeviceLists()
+    QSet<QString> jidsOfPendingDeviceListSubscriptions;
+
+    struct PendingEmptyMessageEnvelope
+    {
+        bool isKeyExchange = false;
+        QVector<QXmppPromise<QXmpp::SendResult>> promises;
+    };
+
+    // recipient JIDs mapped to device IDs mapped to the envelopes of empty
+    // messages waiting for emptyMessageTimer
+    QHash<QString, QMap<uint32_t, PendingEmptyMessageEnvelope>> pendingEmptyMessages;
+
+    // JIDs whose devices are not checked yet by the running check for devices
+    // removed from their servers
+    QList<QString> jidsPendingDeviceRemovalCheck;
 
     OmemoContextPtr globalContext;
     StoreContextPtr storeContext;
@@ -170,6 +244,10 @@ public:
     signal_protocol_signed_pre_key_store signedPreKeyStore;
     signal_protocol_session_store sessionStore;
 
+    // Pre key pairs are generated by a worker of this pool. It is destroyed
+    // first and waits for the worker, which uses globalContext.
+    QThreadPool preKeyGenerationPool;
+
     QXmppOmemoManagerPrivate(QXmppOmemoManager *parent, QXmppOmemoStorage *omemoStorage);
 
     void init();
@@ -191,15 +269,19 @@ public:
     void schedulePeriodicTasks();
     void renewSignedPreKeyPairs();
     bool updateSignedPreKeyPair(ratchet_identity_key_pair *identityKeyPair);
-    bool renewPreKeyPairs(uint32_t keyPairBeingRenewed);
+    void removePreKeyPair(uint32_t preKeyId);
+    void maintainPreKeyPairs();
+    uint32_t reservePreKeyIds(uint32_t count);
+    void addPreKeyPairs(const GeneratedPreKeyPairs &generatedPreKeyPairs);
     bool updatePreKeyPairs(uint32_t count = 1);
     void removeDevicesRemovedFromServer();
+    void removeDevicesRemovedFromServerSlice();
 
     QXmppTask<QXmppE2eeExtension::MessageEncryptResult> encryptMessageForRecipients(QXmppMessage &&message,
                                                                                     QVector<QString> recipientJids,
                                                                                     TrustLevels acceptedTrustLevels);
     template<typename T>
-    QXmppTask<std::optional<QXmppOmemoElement>> encryptStanza(const T &stanza, const QVector<QString> &recipientJids, TrustLevels acceptedTrustLevels);
+    QXmppTask<std::optional<QXmppOmemoElement>> encryptStanza(const T &stanza, const QVector<QString> &recipientJids, TrustLevels acceptedTrustLevels, bool areTrustLevelsCached = false);
     std::optional<PayloadEncryptionResult> encryptPayload(const QByteArray &payload) const;
     template<typename T>
     QByteArray createSceEnvelope(const T &stanza);
@@ -223,7 +305,7 @@ public:
                                                                             uint32_t senderDeviceId,
                                                                             const QXmppOmemoEnvelope &omemoEnvelope,
                                                                             bool isMessageStanza = true);
-    QByteArray decryptPayload(const QCA::SecureArray &payloadDecryptionData, const QByteArray &payload) const;
+    QXmppTask<QByteArray> decryptPayload(const QCA::SecureArray &payloadDecryptionData, const QByteArray &payload);
 
     QXmppTask<bool> publishOmemoData();
 
@@ -317,7 +399,10 @@ public:
     QXmppTask<bool> changeDeviceLabel(const QString &deviceLabel);
 
     QXmppTask<QXmppPubSubManager::ItemResult<QXmppOmemoDeviceListItem>> requestDeviceList(const QString &jid);
+    QXmppTask<QVector<QXmppPubSubManager::ItemResult<QXmppOmemoDeviceListItem>>> requestDeviceLists(const QList<QString> &jids);
+    QXmppPubSubManager::ItemResult<QXmppOmemoDeviceListItem> handleRequestedDeviceList(const QString &jid, QXmppPubSubManager::ItemsResult<QXmppOmemoDeviceListItem> &&result);
     void subscribeToNewDeviceLists(const QString &jid, uint32_t deviceId);
+    bool isDeviceListNotified(const QString &jid) const;
     QXmppTask<Result> subscribeToDeviceList(const QString &jid);
     QXmppTask<QVector<QXmppOmemoManager::DevicesResult>> unsubscribeFromDeviceLists(const QList<QString> &jids);
     QXmppTask<Result> unsubscribeFromDeviceList(const QString &jid);
@@ -325,6 +410,18 @@ public:
     QXmppTask<bool> resetOwnDevice();
     QXmppTask<bool> resetAll();
 
+    bool areDevicesLoaded(const QList<QString> &jids) const;
+    QXmppTask<void> loadDevices(const QList<QString> &jids);
+    template<typename T, typename Function>
+    QXmppTask<T> withLoadedDevices(const QList<QString> &jids, Function function);
+
+    void storeDevice(const QString &jid, uint32_t deviceId);
+    void storeDevices(const QHash<QString, QSet<uint32_t>> &deviceIds);
+    void storeUnstoredDevices();
+
+    void enqueueSessionBuilding(const QString &jid, uint32_t deviceId, std::function<void()> finished);
+    void processSessionBuildingQueue();
+    void finishSessionBuilding(const SessionBuilding &sessionBuilding);
     QXmppTask<bool> buildSessionForNewDevice(const QString &jid, uint32_t deviceId, QXmppOmemoStorage::Device &device);
     QXmppTask<bool> buildSessionWithDeviceBundle(const QString &jid, uint32_t deviceId, QXmppOmemoStorage::Device &device);
     bool buildSession(signal_protocol_address address, const QXmppOmemoDeviceBundle &deviceBundle);
@@ -342,7 +439,8 @@ public:
     bool deserializeSignedPublicPreKey(ec_public_key **signedPublicPreKey, const QByteArray &serializedSignedPublicPreKey) const;
     bool deserializePublicPreKey(ec_public_key **publicPreKey, const QByteArray &serializedPublicPreKey) const;
 
-    QXmppTask<QXmpp::SendResult> sendEmptyMessage(const QString &recipientJid, uint32_t recipientDeviceId, bool isKeyExchange = false) const;
+    QXmppTask<QXmpp::SendResult> sendEmptyMessage(const QString &recipientJid, uint32_t recipientDeviceId, bool isKeyExchange = false);
+    void sendPendingEmptyMessages();
     QXmppTask<void> storeOwnKey() const;
     QXmppTask<TrustLevel> storeKeyDependingOnSecurityPolicy(const QString &keyOwnerJid, const QByteArray &key);
     QXmppTask<TrustLevel> storeKey(const QString &keyOwnerJid, const QByteArray &key, TrustLevel trustLevel = TrustLevel::AutomaticallyDistrusted) const;
@@ -353,4 +451,38 @@ public:
     void warning(const QString &msg) const;
 };
 
+//
+// Calls a function returning a task as soon as the devices of the passed JIDs
+// are loaded.
+//
+// \param jids JIDs whose devices are needed by the function
+// \param function function being called
+//
+// \return the task of the function
+//
+template<typename T, typename Function>
+QXmppTask<T> QXmppOmemoManagerPrivate::withLoadedDevices(const QList<QString> &jids, Function function)
+{
+    if (areDevicesLoaded(jids)) {
+        return function();
+    }
+
+    QXmppPromise<T> interface;
+    auto task = interface.task();
+
+    loadDevices(jids).then(q, [this, interface, function = std::move(function)]() mutable {
+        if constexpr (std::is_void_v<T>) {
+            function().then(q, [interface]() mutable {
+                interface.finish();
+            });
+        } else {
+            function().then(q, [interface](T &&result) mutable {
+                interface.finish(std::move(result));
+            });
+        }
+    });
+
+    return task;
+}
+
 #endif  // QXMPPOMEMOMANAGER_P_H
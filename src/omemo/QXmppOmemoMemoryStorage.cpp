@@ -85,12 +85,28 @@ QXmppTask<void> QXmppOmemoMemoryStorage::removePreKeyPair(const uint32_t keyId)
     return makeReadyTask();
 }
 
+QXmppTask<QHash<uint32_t, QXmppOmemoStorage::Device>> QXmppOmemoMemoryStorage::devices(const QString &jid)
+{
+    return makeReadyTask(d->devices.value(jid));
+}
+
 QXmppTask<void> QXmppOmemoMemoryStorage::addDevice(const QString &jid, const uint32_t deviceId, const QXmppOmemoStorage::Device &device)
 {
     d->devices[jid].insert(deviceId, device);
     return makeReadyTask();
 }
 
+QXmppTask<void> QXmppOmemoMemoryStorage::addDevices(const QHash<QString, QHash<uint32_t, QXmppOmemoStorage::Device>> &devices)
+{
+    for (auto itr = devices.cbegin(); itr != devices.cend(); ++itr) {
+        auto &storedDevices = d->devices[itr.key()];
+        for (auto deviceItr = itr->cbegin(); deviceItr != itr->cend(); ++deviceItr) {
+            storedDevices.insert(deviceItr.key(), deviceItr.value());
+        }
+    }
+    return makeReadyTask();
+}
+
 QXmppTask<void> QXmppOmemoMemoryStorage::removeDevice(const QString &jid, const uint32_t deviceId)
 {
     auto &devices = d->devices[jid];
@@ -30,7 +30,9 @@ public:
     QXmppTask<void> addPreKeyPairs(const QHash<uint32_t, QByteArray> &keyPairs) override;
     QXmppTask<void> removePreKeyPair(uint32_t keyId) override;
 
+    QXmppTask<QHash<uint32_t, Device>> devices(const QString &jid) override;
     QXmppTask<void> addDevice(const QString &jid, uint32_t deviceId, const Device &device) override;
+    QXmppTask<void> addDevices(const QHash<QString, QHash<uint32_t, Device>> &devices) override;
     QXmppTask<void> removeDevice(const QString &jid, uint32_t deviceId) override;
     QXmppTask<void> removeDevices(const QString &jid) override;
 
@@ -2,6 +2,12 @@
 //
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#include "QXmppOmemoStorage.h"
+
+#include "QXmppFutureUtils_p.h"
+
+using namespace QXmpp::Private;
+
 ///
 /// \class QXmppOmemoStorage
 ///
@@ -21,6 +27,46 @@
 /// \return the OMEMO data
 ///
 
+///
+/// Returns whether the devices of other JIDs are loaded on demand via
+/// devices() instead of being returned by allData().
+///
+/// Storages with many known devices (e.g., backed by a database for a
+/// long-lived account) can return true in order to reduce the startup time and
+/// the memory usage.
+/// In that case, allData() may return only a subset of the devices (e.g., none
+/// at all) and the manager requests the devices of a JID before it is needed
+/// for the first time.
+///
+/// The default implementation returns false.
+///
+/// \return whether the devices are loaded on demand
+///
+/// \since QXmpp 1.6
+///
+bool QXmppOmemoStorage::isLazyDeviceLoadingSupported() const
+{
+    return false;
+}
+
+///
+/// Returns the devices of a JID.
+///
+/// This is only called if isLazyDeviceLoadingSupported() returns true and must
+/// then be reimplemented.
+/// The default implementation returns no devices.
+///
+/// \param jid JID of the device owner
+///
+/// \return device IDs mapped to the devices of the JID
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<QHash<uint32_t, QXmppOmemoStorage::Device>> QXmppOmemoStorage::devices(const QString &)
+{
+    return makeReadyTask(QHash<uint32_t, Device>());
+}
+
 ///
 /// \fn QXmppOmemoStorage::setOwnDevice(const std::optional<OwnDevice> &device)
 ///
@@ -72,6 +118,31 @@
 /// \param device device being added
 ///
 
+///
+/// Adds multiple other devices at once (i.e., all devices but the own one).
+///
+/// This is called once per encrypted stanza with all devices whose data
+/// changed by the encryption.
+/// Storages should override it to store all devices in one transaction.
+/// The default implementation calls addDevice() for each device.
+///
+/// \param devices JIDs of the device owners mapped to device IDs mapped to the
+///        devices being added
+///
+/// \since QXmpp 1.6
+///
+QXmppTask<void> QXmppOmemoStorage::addDevices(const QHash<QString, QHash<uint32_t, Device>> &devices)
+{
+    // The manager does not wait for devices to be stored, so the tasks of the
+    // single additions are not combined.
+    for (auto itr = devices.cbegin(); itr != devices.cend(); ++itr) {
+        for (auto deviceItr = itr->cbegin(); deviceItr != itr->cend(); ++deviceItr) {
+            addDevice(itr.key(), deviceItr.key(), deviceItr.value());
+        }
+    }
+    return makeReadyTask();
+}
+
 ///
 /// \fn QXmppOmemoStorage::removeDevice(const QString &jid, uint32_t deviceId)
 ///
@@ -157,6 +157,9 @@ public:
 
     virtual QXmppTask<OmemoData> allData() = 0;
 
+    virtual bool isLazyDeviceLoadingSupported() const;
+    virtual QXmppTask<QHash<uint32_t, Device>> devices(const QString &jid);
+
     virtual QXmppTask<void> setOwnDevice(const std::optional<OwnDevice> &device) = 0;
 
     virtual QXmppTask<void> addSignedPreKeyPair(uint32_t keyId, const SignedPreKeyPair &keyPair) = 0;
@@ -166,6 +169,7 @@ public:
     virtual QXmppTask<void> removePreKeyPair(uint32_t keyId) = 0;
 
     virtual QXmppTask<void> addDevice(const QString &jid, uint32_t deviceId, const Device &device) = 0;
+    virtual QXmppTask<void> addDevices(const QHash<QString, QHash<uint32_t, Device>> &devices);
     virtual QXmppTask<void> removeDevice(const QString &jid, uint32_t deviceId) = 0;
     virtual QXmppTask<void> removeDevices(const QString &jid) = 0;
 
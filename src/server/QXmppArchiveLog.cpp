@@ -0,0 +1,372 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppArchiveLog_p.h"
+
+#include "QXmppUtils_p.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QtEndian>
+
+using namespace QXmpp::Private;
+
+// size of the record after the size field, without the JID and the payload
+constexpr qint64 RecordHeaderSize = 4 + 8 + 8 + 2;
+
+static QString segmentFileName(quint64 firstId)
+{
+    return QStringLiteral("%1.seg").arg(firstId, 16, 16, QLatin1Char('0'));
+}
+
+// Returns whether the JID of the record is the given JID, or one of its full
+// JIDs if it is a bare JID.
+static bool matchesWith(const char *with, int withSize, const QByteArray &jid, bool bare)
+{
+    if (jid.isEmpty()) {
+        return true;
+    }
+    if (withSize < jid.size() || memcmp(with, jid.constData(), size_t(jid.size())) != 0) {
+        return false;
+    }
+    return withSize == jid.size() || (bare && with[jid.size()] == '/');
+}
+
+ArchiveLog::ArchiveLog(const QString &directory, qint64 segmentSize)
+    : m_directory(directory), m_segmentSize(segmentSize)
+{
+}
+
+ArchiveLog::~ArchiveLog()
+{
+    commit();
+}
+
+//
+// Opens the log and indexes its records.
+//
+// Only a torn record at the end of the last segment is dropped, other damaged
+// records fail the opening, as the following records would otherwise lose
+// their IDs.
+//
+bool ArchiveLog::open()
+{
+    if (m_open) {
+        return true;
+    }
+
+    QDir dir(m_directory);
+    if (!dir.mkpath(QStringLiteral("."))) {
+        return false;
+    }
+
+    const auto fileNames = dir.entryList({ QStringLiteral("*.seg") }, QDir::Files, QDir::Name);
+    for (int i = 0; i < fileNames.size(); ++i) {
+        if (!openSegment(dir.filePath(fileNames[i]), i == fileNames.size() - 1)) {
+            m_segments.clear();
+            m_index.clear();
+            m_lastId = 0;
+            return false;
+        }
+    }
+    m_committedId = m_lastId;
+    m_open = true;
+    return true;
+}
+
+bool ArchiveLog::openSegment(const QString &path, bool last)
+{
+    bool ok = false;
+    const auto firstId = QFileInfo(path).baseName().toULongLong(&ok, 16);
+    if (!ok || firstId != m_lastId + 1) {
+        return false;
+    }
+
+    Segment segment;
+    segment.firstId = firstId;
+    segment.file = std::make_unique<QFile>(path);
+    if (!segment.file->open(last ? QIODevice::ReadWrite : QIODevice::ReadOnly)) {
+        return false;
+    }
+    segment.size = segment.file->size();
+    m_segments.push_back(std::move(segment));
+
+    auto &current = m_segments.back();
+    const auto index = int(m_segments.size() - 1);
+    const auto *data = mapped(current);
+    if (current.size > 0 && !data) {
+        return false;
+    }
+
+    qint64 offset = 0;
+    RecordView view;
+    while (offset < current.size) {
+        if (!parseRecord(data + offset, current.size - offset, view) || view.id != m_lastId + 1) {
+            if (!last) {
+                return false;
+            }
+            // torn by a crash while writing
+            current.file->unmap(current.map);
+            current.map = nullptr;
+            current.mappedSize = 0;
+            if (!current.file->resize(offset)) {
+                return false;
+            }
+            current.size = offset;
+            break;
+        }
+        if (offset == 0 || (view.id - 1) % IndexInterval == 0) {
+            m_index.push_back({ view.id, view.timestamp, index, offset });
+        }
+        m_lastId = view.id;
+        m_lastTimestamp = view.timestamp;
+        offset += view.size;
+    }
+    return true;
+}
+
+bool ArchiveLog::startSegment(quint64 firstId)
+{
+    Segment segment;
+    segment.firstId = firstId;
+    segment.file = std::make_unique<QFile>(QDir(m_directory).filePath(segmentFileName(firstId)));
+    if (!segment.file->open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+        return false;
+    }
+    m_segments.push_back(std::move(segment));
+    return true;
+}
+
+const uchar *ArchiveLog::mapped(Segment &segment)
+{
+    if (segment.size == 0) {
+        return nullptr;
+    }
+    // the last segment grows with each commit
+    if (segment.mappedSize != segment.size) {
+        if (segment.map) {
+            segment.file->unmap(segment.map);
+        }
+        segment.map = segment.file->map(0, segment.size);
+        segment.mappedSize = segment.map ? segment.size : 0;
+    }
+    return segment.map;
+}
+
+bool ArchiveLog::parseRecord(const uchar *data, qint64 available, RecordView &view)
+{
+    if (available < 4 + RecordHeaderSize) {
+        return false;
+    }
+    const qint64 size = qFromLittleEndian<quint32>(data);
+    if (size < RecordHeaderSize || 4 + size > available) {
+        return false;
+    }
+    const auto *rest = data + 4;
+    if (qFromLittleEndian<quint32>(rest) != crc32(0, reinterpret_cast<const char *>(rest + 4), size - 4)) {
+        return false;
+    }
+    const int withSize = qFromLittleEndian<quint16>(rest + 20);
+    if (RecordHeaderSize + withSize > size) {
+        return false;
+    }
+
+    view.id = qFromLittleEndian<quint64>(rest + 4);
+    view.timestamp = qFromLittleEndian<qint64>(rest + 12);
+    view.with = reinterpret_cast<const char *>(rest + RecordHeaderSize);
+    view.withSize = withSize;
+    view.payload = view.with + withSize;
+    view.payloadSize = int(size - RecordHeaderSize - withSize);
+    view.size = 4 + size;
+    return true;
+}
+
+//
+// Appends a record, returns its ID or 0 if the log can't be written.
+//
+// The record is only written by the next commit(). Timestamps before the one
+// of the last record are raised to it.
+//
+quint64 ArchiveLog::append(qint64 timestamp, const QString &with, const QByteArray &payload)
+{
+    if (!m_open) {
+        return 0;
+    }
+
+    timestamp = std::max(timestamp, m_lastTimestamp);
+    auto withUtf8 = with.toUtf8();
+    withUtf8.truncate(std::numeric_limits<quint16>::max());
+    const qint64 size = RecordHeaderSize + withUtf8.size() + payload.size();
+
+    auto offset = m_segments.empty() ? 0 : m_segments.back().size + m_pending.size();
+    if (m_segments.empty() || (offset > 0 && offset + 4 + size > m_segmentSize)) {
+        if (!commit() || !startSegment(m_lastId + 1)) {
+            return 0;
+        }
+        offset = 0;
+    }
+
+    const auto id = ++m_lastId;
+    if (offset == 0 || (id - 1) % IndexInterval == 0) {
+        m_index.push_back({ id, timestamp, int(m_segments.size() - 1), offset });
+    }
+    m_lastTimestamp = timestamp;
+
+    const auto start = m_pending.size();
+    m_pending.resize(start + 4 + size);
+    auto *data = reinterpret_cast<uchar *>(m_pending.data() + start);
+    qToLittleEndian<quint32>(quint32(size), data);
+    qToLittleEndian<quint64>(id, data + 8);
+    qToLittleEndian<qint64>(timestamp, data + 16);
+    qToLittleEndian<quint16>(quint16(withUtf8.size()), data + 24);
+    memcpy(data + 4 + RecordHeaderSize, withUtf8.constData(), size_t(withUtf8.size()));
+    memcpy(data + 4 + RecordHeaderSize + withUtf8.size(), payload.constData(), size_t(payload.size()));
+    qToLittleEndian<quint32>(crc32(0, reinterpret_cast<const char *>(data + 8), size - 4), data + 4);
+    return id;
+}
+
+//
+// Writes the appended records to the last segment at once.
+//
+// If the write fails, the records since the last commit are dropped.
+//
+bool ArchiveLog::commit()
+{
+    if (m_pending.isEmpty()) {
+        return true;
+    }
+
+    auto &segment = m_segments.back();
+    const bool written = segment.file->seek(segment.size) &&
+        segment.file->write(m_pending) == m_pending.size() &&
+        segment.file->flush();
+    if (!written) {
+        segment.file->resize(segment.size);
+        m_lastId = m_committedId;
+        m_index.erase(std::remove_if(m_index.begin(), m_index.end(), [this](const auto &entry) {
+                          return entry.id > m_committedId;
+                      }),
+                      m_index.end());
+        m_pending.clear();
+        return false;
+    }
+
+    segment.size += m_pending.size();
+    m_committedId = m_lastId;
+    m_pending.clear();
+    return true;
+}
+
+// Reads the record at the position and advances it, returns false at the end
+// of the log.
+bool ArchiveLog::read(Position &position, RecordView &view)
+{
+    while (position.segment < int(m_segments.size())) {
+        auto &segment = m_segments[position.segment];
+        if (position.offset >= segment.size) {
+            position.segment++;
+            position.offset = 0;
+            continue;
+        }
+        const auto *data = mapped(segment);
+        if (!data || !parseRecord(data + position.offset, segment.size - position.offset, view)) {
+            return false;
+        }
+        position.offset += view.size;
+        return true;
+    }
+    return false;
+}
+
+ArchiveLog::Record ArchiveLog::toRecord(const RecordView &view)
+{
+    return { view.id, view.timestamp, QString::fromUtf8(view.with, view.withSize), QByteArray(view.payload, view.payloadSize) };
+}
+
+//
+// Returns a page of the records matching the query.
+//
+// Forward pages start at the index entry before the first possible record,
+// backward pages read the blocks between the index entries from the last one
+// backwards until the page is full.
+//
+ArchiveLog::Page ArchiveLog::query(const Query &query)
+{
+    commit();
+
+    Page page;
+    if (m_index.empty()) {
+        return page;
+    }
+
+    const auto with = query.with.toUtf8();
+    const bool bare = !query.with.contains(QLatin1Char('/'));
+    const auto max = std::max(query.max, 0);
+    const auto matches = [&](const RecordView &view) {
+        return view.id > query.after && view.timestamp >= query.start && view.timestamp <= query.end &&
+            matchesWith(view.with, view.withSize, with, bare);
+    };
+    RecordView view;
+
+    if (!query.before) {
+        // the records before an entry have smaller IDs and aren't newer, so
+        // they can be skipped if either is out of the range
+        const auto count = std::partition_point(m_index.cbegin(), m_index.cend(), [&](const auto &entry) {
+                               return entry.id <= query.after + 1 || entry.timestamp < query.start;
+                           }) -
+            m_index.cbegin();
+        const auto &entry = m_index[std::max<qsizetype>(count, 1) - 1];
+
+        Position position { entry.segment, entry.offset };
+        while (read(position, view) && view.timestamp <= query.end) {
+            if (!matches(view)) {
+                continue;
+            }
+            if (page.records.size() == max) {
+                page.complete = false;
+                break;
+            }
+            page.records << toRecord(view);
+        }
+        return page;
+    }
+
+    const auto before = std::min(*query.before, m_lastId + 1);
+    const auto count = std::partition_point(m_index.cbegin(), m_index.cend(), [&](const auto &entry) {
+                           return entry.id < before && entry.timestamp <= query.end;
+                       }) -
+        m_index.cbegin();
+
+    QVector<Record> records;
+    for (auto i = qsizetype(count) - 1; i >= 0; --i) {
+        const auto &entry = m_index[i];
+        const auto end = std::min(i + 1 < qsizetype(m_index.size()) ? m_index[i + 1].id : m_lastId + 1, before);
+
+        QVector<Record> block;
+        Position position { entry.segment, entry.offset };
+        while (read(position, view) && view.id < end) {
+            if (matches(view)) {
+                block << toRecord(view);
+            }
+        }
+        block << std::move(records);
+        records = std::move(block);
+
+        // older blocks can't match anymore
+        if (records.size() > max || entry.timestamp < query.start || entry.id <= query.after) {
+            break;
+        }
+    }
+
+    if (records.size() > max) {
+        records.remove(0, records.size() - max);
+        page.complete = false;
+    }
+    page.records = std::move(records);
+    return page;
+}
@@ -0,0 +1,169 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPARCHIVELOG_P_H
+#define QXMPPARCHIVELOG_P_H
+
+#include "QXmppGlobal.h"
+
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+class QFile;
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API. It exists for the convenience
+// of QXmppMamExtension.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+namespace QXmpp::Private {
+
+//
+// Append-only log of the archived messages of one user.
+//
+// The records are written to segment files in a directory, a new segment is
+// started once the current one exceeds the segment size. Segments are memory
+// mapped for reading. Records are numbered from 1 without gaps, the number is
+// the archive ID of the message, and their timestamps never decrease.
+//
+// A sparse index keeps the position of every IndexInterval-th record and of
+// the first record of each segment, so queries only search the index and
+// read the records sequentially from there.
+//
+// Appended records are buffered until commit(), so many records are written
+// with one write. A record torn by a crash is dropped when the log is opened.
+//
+// Record layout (little endian):
+//     quint32 size of the rest of the record
+//     quint32 CRC-32 of the rest of the record
+//     quint64 ID
+//     qint64  timestamp in milliseconds since the epoch
+//     quint16 size of the JID of the other party
+//     JID of the other party (UTF-8)
+//     payload
+//
+class QXMPP_EXPORT ArchiveLog
+{
+public:
+    static constexpr int IndexInterval = 32;
+
+    struct Record
+    {
+        quint64 id = 0;
+        qint64 timestamp = 0;
+        QString with;
+        QByteArray payload;
+    };
+
+    struct Query
+    {
+        qint64 start = std::numeric_limits<qint64>::min();
+        qint64 end = std::numeric_limits<qint64>::max();
+        // bare JIDs also match the full JIDs of the party
+        QString with;
+        // only records with a greater ID
+        quint64 after = 0;
+        // the last page before the ID instead of the first page
+        std::optional<quint64> before;
+        int max = 100;
+    };
+
+    struct Page
+    {
+        QVector<Record> records;
+        // whether there are no further matching records in the direction of
+        // the query
+        bool complete = true;
+    };
+
+    ArchiveLog(const QString &directory, qint64 segmentSize);
+    ~ArchiveLog();
+
+    bool open();
+    bool isOpen() const { return m_open; }
+
+    quint64 append(qint64 timestamp, const QString &with, const QByteArray &payload);
+    bool commit();
+    bool hasPendingWrites() const { return !m_pending.isEmpty(); }
+
+    quint64 lastId() const { return m_lastId; }
+    int segmentCount() const { return int(m_segments.size()); }
+
+    Page query(const Query &query);
+
+private:
+    struct Segment
+    {
+        quint64 firstId = 0;
+        // committed bytes
+        qint64 size = 0;
+        std::unique_ptr<QFile> file;
+        uchar *map = nullptr;
+        qint64 mappedSize = 0;
+    };
+
+    struct IndexEntry
+    {
+        quint64 id;
+        qint64 timestamp;
+        int segment;
+        qint64 offset;
+    };
+
+    struct Position
+    {
+        int segment;
+        qint64 offset;
+    };
+
+    // a record in the mapped memory of a segment
+    struct RecordView
+    {
+        quint64 id;
+        qint64 timestamp;
+        const char *with;
+        int withSize;
+        const char *payload;
+        int payloadSize;
+        qint64 size;
+    };
+
+    bool openSegment(const QString &fileName, bool last);
+    bool startSegment(quint64 firstId);
+    const uchar *mapped(Segment &segment);
+    static bool parseRecord(const uchar *data, qint64 available, RecordView &view);
+    bool read(Position &position, RecordView &view);
+    static Record toRecord(const RecordView &view);
+
+    QString m_directory;
+    qint64 m_segmentSize;
+    bool m_open = false;
+
+    std::vector<Segment> m_segments;
+    std::vector<IndexEntry> m_index;
+    quint64 m_lastId = 0;
+    quint64 m_committedId = 0;
+    qint64 m_lastTimestamp = std::numeric_limits<qint64>::min();
+
+    // records not written to the last segment yet
+    QByteArray m_pending;
+};
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPARCHIVELOG_P_H
@@ -0,0 +1,183 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppClusterLink_p.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include <QTcpSocket>
+#include <QtEndian>
+
+using namespace QXmpp::Private;
+
+// data buffered by a link before stanzas are dropped
+constexpr qint64 CLUSTER_LINK_BUFFER_SIZE = 8 * 1024 * 1024;
+// maximum size of the frames after the size field
+constexpr quint32 CLUSTER_HELLO_SIZE = 4096;
+constexpr quint32 CLUSTER_FRAME_SIZE = 16 * 1024 * 1024;
+// delays in ms before reconnecting to a peer, doubled with each failure
+constexpr int CLUSTER_RECONNECT_DELAY = 500;
+constexpr int CLUSTER_MAX_RECONNECT_DELAY = 30000;
+
+// Compares the secrets in constant time.
+static bool secretsEqual(const QByteArray &a, const QByteArray &b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+    char difference = 0;
+    for (int i = 0; i < a.size(); ++i) {
+        difference |= a[i] ^ b[i];
+    }
+    return difference == 0;
+}
+
+QByteArray QXmpp::Private::clusterFrame(const QString &to, const QByteArray &data)
+{
+    auto toUtf8 = to.toUtf8();
+    toUtf8.truncate(std::numeric_limits<quint16>::max());
+
+    QByteArray frame(6 + toUtf8.size() + data.size(), Qt::Uninitialized);
+    auto *bytes = reinterpret_cast<uchar *>(frame.data());
+    qToBigEndian<quint32>(quint32(2 + toUtf8.size() + data.size()), bytes);
+    qToBigEndian<quint16>(quint16(toUtf8.size()), bytes + 4);
+    memcpy(bytes + 6, toUtf8.constData(), size_t(toUtf8.size()));
+    memcpy(bytes + 6 + toUtf8.size(), data.constData(), size_t(data.size()));
+    return frame;
+}
+
+ClusterLink::ClusterLink(const QString &localNode, const QByteArray &secret, const QString &host, quint16 port, QObject *parent)
+    : QXmppLoggable(parent),
+      m_localNode(localNode),
+      m_secret(secret),
+      m_host(host),
+      m_port(port),
+      m_socket(new QTcpSocket(this)),
+      m_reconnectTimer(this)
+{
+    m_reconnectTimer.setSingleShot(true);
+    connect(&m_reconnectTimer, &QTimer::timeout, this, [this] { connectToPeer(); });
+    connect(m_socket, &QTcpSocket::connected, this, [this] { handleConnected(); });
+    connect(m_socket, &QTcpSocket::disconnected, this, [this] { handleDisconnected(); });
+    connect(m_socket, &QAbstractSocket::errorOccurred, this, [this] {
+        // failed connection attempts aren't reported as disconnections
+        if (!m_connected && m_socket->state() == QAbstractSocket::UnconnectedState) {
+            handleDisconnected();
+        }
+    });
+}
+
+ClusterLink::~ClusterLink()
+{
+    m_socket->disconnect(this);
+}
+
+//
+// Sends a stanza for a session on the peer, returns false if it has been
+// dropped because the peer doesn't keep up.
+//
+bool ClusterLink::send(const QString &to, const QByteArray &data)
+{
+    auto frame = clusterFrame(to, data);
+    const auto buffered = m_connected ? m_socket->bytesToWrite() : qint64(m_queue.size());
+    if (buffered + frame.size() > CLUSTER_LINK_BUFFER_SIZE) {
+        warning(QStringLiteral("Dropping stanza for %1, the link to %2:%3 is congested").arg(to, m_host, QString::number(m_port)));
+        return false;
+    }
+
+    if (m_connected) {
+        m_socket->write(frame);
+        return true;
+    }
+    m_queue += frame;
+    if (m_socket->state() == QAbstractSocket::UnconnectedState && !m_reconnectTimer.isActive()) {
+        connectToPeer();
+    }
+    return true;
+}
+
+void ClusterLink::connectToPeer()
+{
+    debug(QStringLiteral("Connecting to cluster peer %1:%2").arg(m_host, QString::number(m_port)));
+    m_socket->connectToHost(m_host, m_port);
+}
+
+void ClusterLink::handleConnected()
+{
+    info(QStringLiteral("Connected to cluster peer %1:%2").arg(m_host, QString::number(m_port)));
+    m_connected = true;
+    m_reconnectDelay = 0;
+    m_socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    m_socket->write(clusterFrame(m_localNode, m_secret) + std::exchange(m_queue, {}));
+}
+
+void ClusterLink::handleDisconnected()
+{
+    if (m_connected) {
+        warning(QStringLiteral("Lost connection to cluster peer %1:%2").arg(m_host, QString::number(m_port)));
+        m_connected = false;
+    }
+
+    // the link is opened again once there is something to send
+    if (!m_queue.isEmpty()) {
+        m_reconnectDelay = std::min(std::max(m_reconnectDelay * 2, CLUSTER_RECONNECT_DELAY), CLUSTER_MAX_RECONNECT_DELAY);
+        m_reconnectTimer.start(m_reconnectDelay);
+    }
+}
+
+ClusterConnection::ClusterConnection(QTcpSocket *socket, const QByteArray &secret, Handler handler, QObject *parent)
+    : QXmppLoggable(parent),
+      m_socket(socket),
+      m_secret(secret),
+      m_handler(std::move(handler))
+{
+    m_socket->setParent(this);
+    connect(m_socket, &QTcpSocket::readyRead, this, [this] { readFrames(); });
+    connect(m_socket, &QTcpSocket::disconnected, this, &QObject::deleteLater);
+    readFrames();
+}
+
+void ClusterConnection::readFrames()
+{
+    m_buffer += m_socket->readAll();
+
+    qsizetype offset = 0;
+    while (m_buffer.size() - offset >= 6) {
+        const auto *bytes = reinterpret_cast<const uchar *>(m_buffer.constData() + offset);
+        const auto size = qFromBigEndian<quint32>(bytes);
+        const auto toSize = qFromBigEndian<quint16>(bytes + 4);
+        if (size < 2u + toSize || size > (m_peerNode.isEmpty() ? CLUSTER_HELLO_SIZE : CLUSTER_FRAME_SIZE)) {
+            return abort(QStringLiteral("Invalid frame"));
+        }
+        if (m_buffer.size() - offset < 4 + qsizetype(size)) {
+            break;
+        }
+
+        const auto to = QString::fromUtf8(m_buffer.constData() + offset + 6, toSize);
+        const auto data = m_buffer.mid(offset + 6 + toSize, size - 2 - toSize);
+        offset += 4 + size;
+
+        if (m_peerNode.isEmpty()) {
+            if (to.isEmpty() || !secretsEqual(data, m_secret)) {
+                return abort(QStringLiteral("Invalid hello"));
+            }
+            m_peerNode = to;
+            info(QStringLiteral("Cluster peer %1 connected").arg(m_peerNode));
+            continue;
+        }
+        m_handler(to, data);
+    }
+    m_buffer.remove(0, offset);
+}
+
+void ClusterConnection::abort(const QString &reason)
+{
+    warning(QStringLiteral("Closing cluster connection from %1: %2").arg(m_socket->peerAddress().toString(), reason));
+    m_buffer.clear();
+    m_socket->abort();
+    deleteLater();
+}
@@ -0,0 +1,101 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPCLUSTERLINK_P_H
+#define QXMPPCLUSTERLINK_P_H
+
+#include "QXmppLogger.h"
+
+#include <functional>
+
+#include <QByteArray>
+#include <QString>
+#include <QTimer>
+
+class QTcpSocket;
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API. It exists for the convenience
+// of QXmppServer.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+namespace QXmpp::Private {
+
+//
+// Links between the nodes of a cluster serving the same domain.
+//
+// A link is a plain TCP connection carrying the stanzas for all sessions on
+// the peer node. Each frame is a 32-bit big-endian size, followed by the
+// 16-bit size of the recipient, the UTF-8 recipient and the serialized
+// stanza. The first frame of a connection is the hello of the connecting
+// node, with its name as the recipient and the cluster secret as the data.
+//
+// Links are unidirectional: each node sends on the links it has opened and
+// receives on the ones it has accepted.
+//
+
+// Sends the stanzas for sessions on a peer node, reconnecting when the
+// connection is lost and stanzas are waiting.
+class ClusterLink : public QXmppLoggable
+{
+public:
+    ClusterLink(const QString &localNode, const QByteArray &secret, const QString &host, quint16 port, QObject *parent);
+    ~ClusterLink() override;
+
+    bool send(const QString &to, const QByteArray &data);
+
+private:
+    void connectToPeer();
+    void handleConnected();
+    void handleDisconnected();
+
+    QString m_localNode;
+    QByteArray m_secret;
+    QString m_host;
+    quint16 m_port;
+
+    QTcpSocket *m_socket;
+    bool m_connected = false;
+    // frames written while the link is connecting
+    QByteArray m_queue;
+    QTimer m_reconnectTimer;
+    int m_reconnectDelay = 0;
+};
+
+// Receives the frames of a link opened by a peer node. The connection
+// deletes itself when the socket is disconnected.
+class ClusterConnection : public QXmppLoggable
+{
+public:
+    using Handler = std::function<void(const QString &to, const QByteArray &data)>;
+
+    ClusterConnection(QTcpSocket *socket, const QByteArray &secret, Handler handler, QObject *parent);
+
+    QString peerNode() const { return m_peerNode; }
+
+private:
+    void readFrames();
+    void abort(const QString &reason);
+
+    QTcpSocket *m_socket;
+    QByteArray m_secret;
+    Handler m_handler;
+    // name of the peer, set by the hello frame
+    QString m_peerNode;
+    QByteArray m_buffer;
+};
+
+QByteArray clusterFrame(const QString &to, const QByteArray &data);
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPCLUSTERLINK_P_H
@@ -7,6 +7,8 @@
 
 #include "QXmppStanza.h"
 
+#include <QMetaType>
+
 /// \brief The QXmppDialback class represents a stanza used for the Server
 /// Dialback protocol as specified by \xep{0220}: Server Dialback.
 ///
@@ -47,4 +49,6 @@ private:
     QString m_type;
 };
 
+Q_DECLARE_METATYPE(QXmppDialback)
+
 #endif
@@ -0,0 +1,81 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPDIALBACKCACHE_P_H
+#define QXMPPDIALBACKCACHE_P_H
+
+#include <algorithm>
+
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QString>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API. It exists for the convenience
+// of QXmppServer and QXmppIncomingServer.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+namespace QXmpp::Private {
+
+//
+// Cache of successful dialback verifications by remote domain and key.
+//
+// A remote server that presents a key that has already been verified with
+// its authoritative server is accepted without another verify round-trip.
+// The cache is shared by the incoming streams of all worker threads.
+//
+class DialbackCache
+{
+public:
+    explicit DialbackCache(int timeToLive)
+        : m_timeToLive(timeToLive)
+    {
+    }
+
+    int timeToLive() const { return m_timeToLive; }
+
+    bool contains(const QString &domain, const QString &key)
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto itr = m_entries.constFind({ domain, key });
+        return itr != m_entries.constEnd() && !itr->hasExpired();
+    }
+
+    void insert(const QString &domain, const QString &key)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_entries.size() >= m_cleanupSize) {
+            for (auto itr = m_entries.begin(); itr != m_entries.end();) {
+                if (itr->hasExpired()) {
+                    itr = m_entries.erase(itr);
+                } else {
+                    ++itr;
+                }
+            }
+            m_cleanupSize = std::max(1024, int(m_entries.size()) * 2);
+        }
+        m_entries.insert({ domain, key }, QDeadlineTimer(m_timeToLive));
+    }
+
+private:
+    QMutex m_mutex;
+    QHash<QPair<QString, QString>, QDeadlineTimer> m_entries;
+    // expired entries are removed whenever the cache has doubled in size
+    int m_cleanupSize = 1024;
+    int m_timeToLive;
+};
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPDIALBACKCACHE_P_H
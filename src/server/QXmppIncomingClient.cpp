@@ -7,32 +7,83 @@
 #include "QXmppBindIq.h"
 #include "QXmppConstants_p.h"
 #include "QXmppMessage.h"
+#include "QXmppMetrics.h"
 #include "QXmppPasswordChecker.h"
 #include "QXmppSasl_p.h"
 #include "QXmppSessionIq.h"
 #include "QXmppStartTlsPacket.h"
 #include "QXmppStreamFeatures.h"
+#include "QXmppStreamManagement_p.h"
+#include "QXmppTimerWheel_p.h"
 #include "QXmppUtils.h"
 
+#include <algorithm>
+#include <limits>
+
+#include <QDataStream>
 #include <QDomElement>
 #include <QHostAddress>
 #include <QSslKey>
 #include <QSslSocket>
 #include <QTimer>
 
+// default maximum size of the stanzas kept for stream resumption
+constexpr qint64 DEFAULT_STREAM_MANAGEMENT_QUEUE_LIMIT = 1024 * 1024;
+// default limit of the socket's read buffer
+constexpr qint64 DEFAULT_READ_BUFFER_SIZE = 64 * 1024;
+// time in ms without received data after which the buffers are squeezed
+constexpr int IDLE_SQUEEZE_DELAY = 30000;
+
+using namespace QXmpp::Private;
+
+template<typename Packet>
+static QByteArray serializeStreamManagementPacket(const Packet &packet)
+{
+    QByteArray data;
+    QXmlStreamWriter writer(&data);
+    packet.toXml(&writer);
+    return data;
+}
+
 class QXmppIncomingClientPrivate
 {
 public:
     QXmppIncomingClientPrivate(QXmppIncomingClient *qq);
-    QTimer *idleTimer;
+
+    // touched by received data, so they don't need to be restarted
+    WheelTimer inactivityTimer;
+    WheelTimer squeezeTimer;
+    bool activityChecksStopped = false;
 
     QString domain;
     QString jid;
     QString resource;
     QXmppPasswordChecker *passwordChecker;
     QXmppSaslServer *saslServer;
+    bool rosterVersioningSupported = false;
+
+    // XEP-0198: Stream Management
+    // The id is assigned on construction, or taken over from the resumed
+    // session, and stays the same for the lifetime of the stream.
+    QString streamManagementId;
+    int streamResumptionTimeout = 0;
+    // whether the client has enabled stream management with resumption
+    bool resumable = false;
+    // whether a <resume/> of the client waits for the session
+    bool resumePending = false;
+    QString resumeId;
+    unsigned int resumeSequenceNumber = 0;
+    // running while the session is kept after the socket has been lost,
+    // created when it is needed
+    QTimer *hibernationTimer = nullptr;
+
+    void recordActivity();
+    void stopActivityChecks();
+    void startHibernation();
+    QByteArray takeState();
 
     void checkCredentials(const QByteArray &response);
+    void handleScramCredentials(const QByteArray &response, QXmppPasswordChecker::ScramResult &&result);
     QString origin() const;
 
 private:
@@ -40,8 +91,70 @@ private:
 };
 
 QXmppIncomingClientPrivate::QXmppIncomingClientPrivate(QXmppIncomingClient *qq)
-    : idleTimer(nullptr), passwordChecker(nullptr), saslServer(nullptr), q(qq)
+    : passwordChecker(nullptr), saslServer(nullptr), q(qq)
 {
+    inactivityTimer.setCallback([this] {
+        stopActivityChecks();
+        q->onTimeout();
+    });
+    squeezeTimer.setCallback([this] { q->squeeze(); });
+}
+
+void QXmppIncomingClientPrivate::recordActivity()
+{
+    if (activityChecksStopped) {
+        return;
+    }
+    if (inactivityTimer.isActive()) {
+        inactivityTimer.touch();
+    }
+    squeezeTimer.touch();
+}
+
+void QXmppIncomingClientPrivate::stopActivityChecks()
+{
+    activityChecksStopped = true;
+    inactivityTimer.stop();
+    squeezeTimer.stop();
+}
+
+void QXmppIncomingClientPrivate::startHibernation()
+{
+    q->info(QString("Keeping the session of '%1' for %2 seconds").arg(jid, QString::number(streamResumptionTimeout)));
+    stopActivityChecks();
+    q->squeeze();
+
+    // the session is given up when the client doesn't resume it in time
+    if (!hibernationTimer) {
+        hibernationTimer = new QTimer(q);
+        hibernationTimer->setSingleShot(true);
+        QObject::connect(hibernationTimer, &QTimer::timeout, q, [this] {
+            q->info(QString("Stream resumption timeout for '%1'").arg(jid));
+            Q_EMIT q->disconnected();
+        });
+    }
+    hibernationTimer->start(streamResumptionTimeout * 1000);
+}
+
+// Serializes the session and detaches it from the stream, which doesn't
+// report a disconnection afterwards.
+QByteArray QXmppIncomingClientPrivate::takeState()
+{
+    QByteArray state;
+    QDataStream stream(&state, QIODevice::WriteOnly);
+    stream << jid;
+    q->saveStreamManagementState(stream);
+
+    q->info(QString("Handing over the session of '%1'").arg(jid));
+    resumable = false;
+    if (hibernationTimer) {
+        hibernationTimer->stop();
+    }
+    stopActivityChecks();
+    if (auto *socket = q->socket()) {
+        socket->disconnect(q);
+    }
+    return state;
 }
 
 void QXmppIncomingClientPrivate::checkCredentials(const QByteArray &response)
@@ -64,7 +177,41 @@ void QXmppIncomingClientPrivate::checkCredentials(const QByteArray &response)
         reply->setProperty("__sasl_raw", response);
         QObject::connect(reply, &QXmppPasswordReply::finished,
                          q, &QXmppIncomingClient::onDigestReply);
+    } else if (saslServer->mechanism().startsWith(QStringLiteral("SCRAM-"))) {
+        const auto algorithm = static_cast<QXmppSaslServerScram *>(saslServer)->algorithm();
+        passwordChecker->scramCredentials(request, algorithm).then(saslServer, [this, response](QXmppPasswordChecker::ScramResult &&result) {
+            handleScramCredentials(response, std::move(result));
+        });
+    }
+}
+
+void QXmppIncomingClientPrivate::handleScramCredentials(const QByteArray &response, QXmppPasswordChecker::ScramResult &&result)
+{
+    if (const auto *error = std::get_if<QXmppPasswordReply::Error>(&result)) {
+        if (*error == QXmppPasswordReply::TemporaryError) {
+            q->warning(QString("Temporary authentication failure for '%1' from %2").arg(saslServer->username(), origin()));
+            QXmppMetrics::increment(QXmppMetrics::ClientAuthTemporaryFailures);
+            q->sendPacket(QXmppSaslFailure("temporary-auth-failure"));
+        } else {
+            q->warning(QString("Authentication failed for '%1' from %2").arg(saslServer->username(), origin()));
+            QXmppMetrics::increment(QXmppMetrics::ClientAuthFailures);
+            q->sendPacket(QXmppSaslFailure("not-authorized"));
+        }
+        q->disconnectFromHost();
+        return;
     }
+
+    const auto &credentials = std::get<QXmppScramCredentials>(result);
+    static_cast<QXmppSaslServerScram *>(saslServer)->setCredentials(credentials.salt, credentials.iterations, credentials.storedKey, credentials.serverKey);
+
+    QByteArray challenge;
+    if (saslServer->respond(response, challenge) != QXmppSaslServer::Challenge) {
+        // FIXME: what condition?
+        q->sendPacket(QXmppSaslFailure());
+        q->disconnectFromHost();
+        return;
+    }
+    q->sendPacket(QXmppSaslChallenge(challenge));
 }
 
 QString QXmppIncomingClientPrivate::origin() const
@@ -90,6 +237,9 @@ QXmppIncomingClient::QXmppIncomingClient(QSslSocket *socket, const QString &doma
 
     d = new QXmppIncomingClientPrivate(this);
     d->domain = domain;
+    d->streamManagementId = QXmppUtils::generateStanzaHash(32);
+    QXmppStream::setStreamManagementQueueLimit(DEFAULT_STREAM_MANAGEMENT_QUEUE_LIMIT, true);
+    setReadBufferSize(DEFAULT_READ_BUFFER_SIZE);
 
     if (socket) {
         connect(socket, &QAbstractSocket::disconnected,
@@ -99,12 +249,7 @@ QXmppIncomingClient::QXmppIncomingClient(QSslSocket *socket, const QString &doma
     }
 
     info(QString("Incoming client connection from %1").arg(d->origin()));
-
-    // create inactivity timer
-    d->idleTimer = new QTimer(this);
-    d->idleTimer->setSingleShot(true);
-    connect(d->idleTimer, &QTimer::timeout,
-            this, &QXmppIncomingClient::onTimeout);
+    d->squeezeTimer.start(IDLE_SQUEEZE_DELAY);
 }
 
 /// Destroys the current stream.
@@ -112,6 +257,7 @@ QXmppIncomingClient::QXmppIncomingClient(QSslSocket *socket, const QString &doma
 
 QXmppIncomingClient::~QXmppIncomingClient()
 {
+    d->stopActivityChecks();
     delete d;
 }
 
@@ -139,10 +285,9 @@ QString QXmppIncomingClient::jid() const
 
 void QXmppIncomingClient::setInactivityTimeout(int secs)
 {
-    d->idleTimer->stop();
-    d->idleTimer->setInterval(secs * 1000);
-    if (d->idleTimer->interval()) {
-        d->idleTimer->start();
+    d->inactivityTimer.stop();
+    if (secs > 0 && !d->activityChecksStopped) {
+        d->inactivityTimer.start(int(std::min<qint64>(qint64(secs) * 1000, std::numeric_limits<int>::max())));
     }
 }
 
@@ -156,12 +301,241 @@ void QXmppIncomingClient::setPasswordChecker(QXmppPasswordChecker *checker)
     d->passwordChecker = checker;
 }
 
+///
+/// Returns the number of seconds a stream management session is kept after
+/// the connection to the client has been lost (\xep{0198}).
+///
+/// \since QXmpp 1.6
+///
+int QXmppIncomingClient::streamResumptionTimeout() const
+{
+    return d->streamResumptionTimeout;
+}
+
+///
+/// Sets the number of seconds a stream management session is kept after the
+/// connection to the client has been lost (\xep{0198}).
+///
+/// While the session is kept, stanzas for the client are queued and the
+/// client stays available. If it resumes the session on a new connection in
+/// time, the queued stanzas are delivered, otherwise disconnected() is
+/// emitted when the timeout expires.
+///
+/// The default value is 0, which disables stream resumption. Stream
+/// management without resumption is offered anyway.
+///
+/// \since QXmpp 1.6
+///
+void QXmppIncomingClient::setStreamResumptionTimeout(int secs)
+{
+    d->streamResumptionTimeout = std::max(secs, 0);
+}
+
+///
+/// Sets the maximum size in bytes of the stanzas that may wait for an
+/// acknowledgement by the client (\xep{0198}).
+///
+/// The stanzas are kept to resend them on stream resumption. If the limit is
+/// exceeded, the stream is closed and the session can't be resumed, so the
+/// memory used by clients that never acknowledge stanzas is bounded.
+///
+/// The default value is 1 MiB, 0 disables the limit.
+///
+/// \since QXmpp 1.6
+///
+void QXmppIncomingClient::setStreamManagementQueueLimit(qint64 bytes)
+{
+    QXmppStream::setStreamManagementQueueLimit(bytes, true);
+}
+
+///
+/// Sets whether roster versioning is announced in the stream features
+/// (\xep{0237}).
+///
+/// \since QXmpp 1.6
+///
+void QXmppIncomingClient::setRosterVersioningSupported(bool supported)
+{
+    d->rosterVersioningSupported = supported;
+}
+
+///
+/// Returns the id of the stream management session, which the client uses
+/// to resume it (\xep{0198}).
+///
+/// \since QXmpp 1.6
+///
+QString QXmppIncomingClient::streamManagementId() const
+{
+    return d->streamManagementId;
+}
+
+///
+/// Sends a serialized stanza routed to the client.
+///
+/// Unlike sendData(), the stanza is counted by stream management and kept
+/// until the client has acknowledged it (\xep{0198}). While the session is
+/// kept for resumption, the stanza is queued. The data must contain exactly
+/// one stanza.
+///
+/// Returns whether the stanza has been written or queued.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppIncomingClient::sendStanzaData(const QByteArray &data)
+{
+    if (!isStreamManagementEnabled()) {
+        return sendData(data);
+    }
+
+    send(QXmppPacket(data, true));
+    return true;
+}
+
+///
+/// Takes the stream management session with the given \a id from this
+/// stream, so it can be resumed on another stream using resumeStream().
+///
+/// Returns an empty state if the session doesn't exist or can't be resumed.
+/// Otherwise this stream is closed and deleted without emitting
+/// disconnected().
+///
+/// \since QXmpp 1.6
+///
+QByteArray QXmppIncomingClient::takeStreamResumptionState(const QString &id)
+{
+    if (id != d->streamManagementId || !d->resumable || !isStreamManagementEnabled()) {
+        return {};
+    }
+
+    const auto state = d->takeState();
+    disconnectFromHost();
+    deleteLater();
+    return state;
+}
+
+///
+/// Takes the stream management session of this stream, so it can be resumed
+/// by another process using restoreStreamResumptionState() (\xep{0198}).
+///
+/// Unlike takeStreamResumptionState(), the connection is aborted without
+/// closing the stream, so the client keeps its session and resumes it when it
+/// reconnects. The id of the session is the streamManagementId().
+///
+/// Returns an empty state if the session can't be resumed. Otherwise this
+/// stream is deleted without emitting disconnected().
+///
+/// \since QXmpp 1.6
+///
+QByteArray QXmppIncomingClient::detachStreamResumptionState()
+{
+    if (!d->resumable || !isStreamManagementEnabled()) {
+        return {};
+    }
+
+    const auto state = d->takeState();
+    if (auto *socket = this->socket()) {
+        socket->abort();
+    }
+    deleteLater();
+    return state;
+}
+
+///
+/// Restores a stream management session detached by another process using
+/// detachStreamResumptionState() on this stream, which has no socket
+/// (\xep{0198}).
+///
+/// The session is kept for the streamResumptionTimeout(), so the client can
+/// resume it on a new connection as if its previous connection had been lost.
+/// Stanzas sent in the meantime are queued.
+///
+/// Returns false if the state could not be read or stream resumption is
+/// disabled.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppIncomingClient::restoreStreamResumptionState(const QString &id, const QByteArray &state)
+{
+    if (socket() || id.isEmpty() || d->streamResumptionTimeout <= 0) {
+        return false;
+    }
+
+    QString jid;
+    QDataStream stream(state);
+    stream >> jid;
+    if (stream.status() != QDataStream::Ok || QXmppUtils::jidToResource(jid).isEmpty()) {
+        return false;
+    }
+
+    // enabled before the stanzas are restored, so they aren't resent now
+    enableStreamManagement(true);
+    if (!restoreStreamManagementState(stream)) {
+        return false;
+    }
+
+    d->jid = jid;
+    d->resource = QXmppUtils::jidToResource(jid);
+    d->streamManagementId = id;
+    d->resumable = true;
+    d->startHibernation();
+    return true;
+}
+
+///
+/// Resumes the stream management session of a previous stream, after the
+/// client has requested it with streamResumptionRequested() (\xep{0198}).
+///
+/// The \a state is the one returned by takeStreamResumptionState(). The
+/// stanzas the client hasn't acknowledged are resent and connected() is
+/// emitted. If the state is empty, the client is told that the session
+/// can't be resumed, so it can bind a new resource.
+///
+/// \since QXmpp 1.6
+///
+void QXmppIncomingClient::resumeStream(const QByteArray &state)
+{
+    if (!d->resumePending) {
+        return;
+    }
+    d->resumePending = false;
+
+    QString jid;
+    QDataStream stream(state);
+    stream >> jid;
+    if (state.isEmpty() || stream.status() != QDataStream::Ok || !restoreStreamManagementState(stream)) {
+        sendData(serializeStreamManagementPacket(QXmppStreamManagementFailed(QXmppStanza::Error::ItemNotFound)));
+        return;
+    }
+
+    d->jid = jid;
+    d->resource = QXmppUtils::jidToResource(jid);
+    d->streamManagementId = d->resumeId;
+    info(QString("Resumed the session of '%1' from %2").arg(d->jid, d->origin()));
+
+    setAcknowledgedSequenceNumber(d->resumeSequenceNumber);
+    sendData(serializeStreamManagementPacket(QXmppStreamManagementResumed(lastIncomingSequenceNumber(), d->streamManagementId)));
+    d->resumable = d->streamResumptionTimeout > 0;
+    enableStreamManagement(false);
+
+    Q_EMIT connected();
+}
+
 /// \cond
-void QXmppIncomingClient::handleStream(const QDomElement &streamElement)
+void QXmppIncomingClient::disconnectFromHost()
 {
-    if (d->idleTimer->interval()) {
-        d->idleTimer->start();
+    QXmppStream::disconnectFromHost();
+
+    // a kept session is given up, e.g. when its queue limit is exceeded
+    if (d->hibernationTimer && d->hibernationTimer->isActive()) {
+        d->hibernationTimer->stop();
+        Q_EMIT disconnected();
     }
+}
+
+void QXmppIncomingClient::handleStream(const QDomElement &streamElement)
+{
+    d->recordActivity();
     if (d->saslServer != nullptr) {
         delete d->saslServer;
         d->saslServer = nullptr;
@@ -201,8 +575,18 @@ void QXmppIncomingClient::handleStream(const QDomElement &streamElement)
     if (!d->jid.isEmpty()) {
         features.setBindMode(QXmppStreamFeatures::Required);
         features.setSessionMode(QXmppStreamFeatures::Enabled);
+        features.setStreamManagementMode(QXmppStreamFeatures::Enabled);
+        features.setRosterVersioningSupported(d->rosterVersioningSupported);
+        if (isCompressionSupported() && !isCompressionEnabled()) {
+            features.setCompressionMethods({ QStringLiteral("zlib") });
+        }
     } else if (d->passwordChecker) {
         QStringList mechanisms;
+        if (d->passwordChecker->hasGetPassword()) {
+            mechanisms << "SCRAM-SHA-512"
+                       << "SCRAM-SHA-256"
+                       << "SCRAM-SHA-1";
+        }
         mechanisms << "PLAIN";
         if (d->passwordChecker->hasGetPassword()) {
             mechanisms << "DIGEST-MD5";
@@ -216,15 +600,29 @@ void QXmppIncomingClient::handleStanza(const QDomElement &nodeRecv)
 {
     const QString ns = nodeRecv.namespaceURI();
 
-    if (d->idleTimer->interval()) {
-        d->idleTimer->start();
-    }
+    d->recordActivity();
 
     if (QXmppStartTlsPacket::isStartTlsPacket(nodeRecv, QXmppStartTlsPacket::StartTls)) {
         sendPacket(QXmppStartTlsPacket(QXmppStartTlsPacket::Proceed));
+        flushData();
         socket()->flush();
         socket()->startServerEncryption();
         return;
+    } else if (ns == ns_compress && nodeRecv.tagName() == QLatin1String("compress")) {
+        // XEP-0138: Stream Compression
+        if (d->jid.isEmpty() || isCompressionEnabled()) {
+            sendData(QByteArrayLiteral("<failure xmlns='http://jabber.org/protocol/compress'><setup-failed/></failure>"));
+        } else if (nodeRecv.firstChildElement(QStringLiteral("method")).text() != QLatin1String("zlib") || !isCompressionSupported()) {
+            sendData(QByteArrayLiteral("<failure xmlns='http://jabber.org/protocol/compress'><unsupported-method/></failure>"));
+        } else {
+            sendData(QByteArrayLiteral("<compressed xmlns='http://jabber.org/protocol/compress'/>"));
+            if (!enableCompression()) {
+                disconnectFromHost();
+                return;
+            }
+            handleStart();
+        }
+        return;
     } else if (ns == ns_sasl) {
         if (!d->passwordChecker) {
             warning("Cannot perform authentication, no password checker");
@@ -276,11 +674,13 @@ void QXmppIncomingClient::handleStanza(const QDomElement &nodeRecv)
             if (result == QXmppSaslServer::InputNeeded) {
                 // check credentials
                 d->checkCredentials(response.value());
+            } else if (result == QXmppSaslServer::Challenge) {
+                sendPacket(QXmppSaslChallenge(challenge));
             } else if (result == QXmppSaslServer::Succeeded) {
                 // authentication succeeded
                 d->jid = QString("%1@%2").arg(d->saslServer->username(), d->domain);
                 info(QString("Authentication succeeded for '%1' from %2").arg(d->jid, d->origin()));
-                Q_EMIT updateCounter("incoming-client.auth.success");
+                QXmppMetrics::increment(QXmppMetrics::ClientAuthSuccesses);
                 sendPacket(QXmppSaslSuccess());
                 handleStart();
             } else {
@@ -289,6 +689,40 @@ void QXmppIncomingClient::handleStanza(const QDomElement &nodeRecv)
                 disconnectFromHost();
             }
         }
+    } else if (ns == ns_stream_management) {
+        // XEP-0198: Stream Management
+        if (QXmppStreamManagementEnable::isStreamManagementEnable(nodeRecv)) {
+            if (d->resource.isEmpty() || isStreamManagementEnabled()) {
+                sendData(serializeStreamManagementPacket(QXmppStreamManagementFailed(QXmppStanza::Error::UnexpectedRequest)));
+                return;
+            }
+
+            QXmppStreamManagementEnable enable;
+            enable.parse(nodeRecv);
+            d->resumable = enable.resume() && d->streamResumptionTimeout > 0;
+
+            QXmppStreamManagementEnabled enabled;
+            if (d->resumable) {
+                enabled.setResume(true);
+                enabled.setId(d->streamManagementId);
+                enabled.setMax(unsigned(d->streamResumptionTimeout));
+            }
+            sendData(serializeStreamManagementPacket(enabled));
+            enableStreamManagement(true);
+        } else if (QXmppStreamManagementResume::isStreamManagementResume(nodeRecv)) {
+            // the session can only be resumed instead of binding a resource
+            if (d->jid.isEmpty() || !d->resource.isEmpty() || d->resumePending) {
+                sendData(serializeStreamManagementPacket(QXmppStreamManagementFailed(QXmppStanza::Error::UnexpectedRequest)));
+                return;
+            }
+
+            QXmppStreamManagementResume resume;
+            resume.parse(nodeRecv);
+            d->resumePending = true;
+            d->resumeId = resume.prevId();
+            d->resumeSequenceNumber = resume.h();
+            Q_EMIT streamResumptionRequested(d->resumeId);
+        }
     } else if (ns == ns_client) {
         if (nodeRecv.tagName() == QLatin1String("iq")) {
             const QString type = nodeRecv.attribute("type");
@@ -369,7 +803,7 @@ void QXmppIncomingClient::onDigestReply()
 
     if (reply->error() == QXmppPasswordReply::TemporaryError) {
         warning(QString("Temporary authentication failure for '%1' from %2").arg(d->saslServer->username(), d->origin()));
-        Q_EMIT updateCounter("incoming-client.auth.temporary-auth-failure");
+        QXmppMetrics::increment(QXmppMetrics::ClientAuthTemporaryFailures);
         sendPacket(QXmppSaslFailure("temporary-auth-failure"));
         disconnectFromHost();
         return;
@@ -381,7 +815,7 @@ void QXmppIncomingClient::onDigestReply()
     QXmppSaslServer::Response result = d->saslServer->respond(reply->property("__sasl_raw").toByteArray(), challenge);
     if (result != QXmppSaslServer::Challenge) {
         warning(QString("Authentication failed for '%1' from %2").arg(d->saslServer->username(), d->origin()));
-        Q_EMIT updateCounter("incoming-client.auth.not-authorized");
+        QXmppMetrics::increment(QXmppMetrics::ClientAuthFailures);
         sendPacket(QXmppSaslFailure("not-authorized"));
         disconnectFromHost();
         return;
@@ -404,19 +838,19 @@ void QXmppIncomingClient::onPasswordReply()
     case QXmppPasswordReply::NoError:
         d->jid = jid;
         info(QString("Authentication succeeded for '%1' from %2").arg(d->jid, d->origin()));
-        Q_EMIT updateCounter("incoming-client.auth.success");
+        QXmppMetrics::increment(QXmppMetrics::ClientAuthSuccesses);
         sendPacket(QXmppSaslSuccess());
         handleStart();
         break;
     case QXmppPasswordReply::AuthorizationError:
         warning(QString("Authentication failed for '%1' from %2").arg(jid, d->origin()));
-        Q_EMIT updateCounter("incoming-client.auth.not-authorized");
+        QXmppMetrics::increment(QXmppMetrics::ClientAuthFailures);
         sendPacket(QXmppSaslFailure("not-authorized"));
         disconnectFromHost();
         break;
     case QXmppPasswordReply::TemporaryError:
         warning(QString("Temporary authentication failure for '%1' from %2").arg(jid, d->origin()));
-        Q_EMIT updateCounter("incoming-client.auth.temporary-auth-failure");
+        QXmppMetrics::increment(QXmppMetrics::ClientAuthTemporaryFailures);
         sendPacket(QXmppSaslFailure("temporary-auth-failure"));
         disconnectFromHost();
         break;
@@ -426,12 +860,20 @@ void QXmppIncomingClient::onPasswordReply()
 void QXmppIncomingClient::onSocketDisconnected()
 {
     info(QString("Socket disconnected for '%1' from %2").arg(d->jid, d->origin()));
+
+    // keep the session if the connection has been lost without closing the
+    // stream, stream management is disabled when the stream is closed
+    if (d->resumable && isStreamManagementEnabled()) {
+        d->startHibernation();
+        return;
+    }
     Q_EMIT disconnected();
 }
 
 void QXmppIncomingClient::onTimeout()
 {
     warning(QString("Idle timeout for '%1' from %2").arg(d->jid, d->origin()));
+    d->resumable = false;
     disconnectFromHost();
 
     // make sure disconnected() gets emitted no matter what
@@ -31,10 +31,36 @@ public:
     void setInactivityTimeout(int secs);
     void setPasswordChecker(QXmppPasswordChecker *checker);
 
+    int streamResumptionTimeout() const;
+    void setStreamResumptionTimeout(int secs);
+    void setStreamManagementQueueLimit(qint64 bytes);
+    QString streamManagementId() const;
+    void setRosterVersioningSupported(bool supported);
+
+    bool sendStanzaData(const QByteArray &data);
+    QByteArray takeStreamResumptionState(const QString &id);
+    void resumeStream(const QByteArray &state);
+    QByteArray detachStreamResumptionState();
+    bool restoreStreamResumptionState(const QString &id, const QByteArray &state);
+
 Q_SIGNALS:
     /// This signal is emitted when an element is received.
     void elementReceived(const QDomElement &element);
 
+    /// This signal is emitted when the client asks to resume the stream
+    /// management session with the given \a id (\xep{0198}).
+    ///
+    /// The session needs to be taken from its stream using
+    /// takeStreamResumptionState() and passed to resumeStream().
+    ///
+    /// \since QXmpp 1.6
+    void streamResumptionRequested(const QString &id);
+
+public Q_SLOTS:
+    /// \cond
+    void disconnectFromHost() override;
+    /// \endcond
+
 protected:
     /// \cond
     void handleStream(const QDomElement &element) override;
@@ -6,25 +6,65 @@
 
 #include "QXmppConstants_p.h"
 #include "QXmppDialback.h"
+#include "QXmppDialbackCache_p.h"
 #include "QXmppOutgoingServer.h"
 #include "QXmppStartTlsPacket.h"
 #include "QXmppStreamFeatures.h"
 #include "QXmppUtils.h"
 
 #include <QDomElement>
+#include <QHash>
 #include <QHostAddress>
 #include <QSslKey>
 #include <QSslSocket>
 
+using namespace QXmpp::Private;
+
+namespace {
+
+// Outgoing streams verifying dialback keys with an authoritative server. The
+// incoming streams of a thread share one stream per remote domain, so their
+// verify requests are pipelined over a single connection.
+struct DialbackVerifier
+{
+    QXmppOutgoingServer *stream = nullptr;
+    int pending = 0;
+};
+
+// by local and remote domain
+using DialbackVerifiers = QHash<QPair<QString, QString>, DialbackVerifier>;
+
+DialbackVerifiers &dialbackVerifiers()
+{
+    thread_local DialbackVerifiers verifiers;
+    return verifiers;
+}
+
+}  // namespace
+
 class QXmppIncomingServerPrivate
 {
 public:
+    struct Verification
+    {
+        QString key;
+        QXmppOutgoingServer *stream = nullptr;
+    };
+
     QXmppIncomingServerPrivate(QXmppIncomingServer *qq);
     QString origin() const;
+    QXmppOutgoingServer *acquireVerifier(const QString &remoteDomain);
+    void releaseVerifier(const QString &remoteDomain, QXmppOutgoingServer *stream);
+    void finishVerification(const QString &remoteDomain, const QString &type);
 
     QSet<QString> authenticated;
+    // domains waiting for the response of their authoritative server
+    QHash<QString, Verification> pendingVerifications;
+    std::shared_ptr<DialbackCache> dialbackCache;
     QString domain;
     QString localStreamId;
+    // XEP-0288: Bidirectional Server-to-Server Connections
+    bool bidirectional = false;
 
 private:
     QXmppIncomingServer *q;
@@ -45,6 +85,69 @@ QString QXmppIncomingServerPrivate::origin() const
     }
 }
 
+QXmppOutgoingServer *QXmppIncomingServerPrivate::acquireVerifier(const QString &remoteDomain)
+{
+    const auto key = qMakePair(domain, remoteDomain);
+    auto &verifier = dialbackVerifiers()[key];
+    if (!verifier.stream) {
+        auto *stream = new QXmppOutgoingServer(domain, nullptr);
+        QObject::connect(stream, &QXmppLoggable::logMessage,
+                         q, &QXmppLoggable::logMessage);
+        QObject::connect(stream, &QXmppStream::disconnected, stream, [key, stream] {
+            auto &verifiers = dialbackVerifiers();
+            if (const auto itr = verifiers.find(key); itr != verifiers.end() && itr->stream == stream) {
+                verifiers.erase(itr);
+            }
+            stream->deleteLater();
+        });
+        stream->connectToHost(remoteDomain);
+        verifier.stream = stream;
+    }
+    verifier.pending++;
+    return verifier.stream;
+}
+
+void QXmppIncomingServerPrivate::releaseVerifier(const QString &remoteDomain, QXmppOutgoingServer *stream)
+{
+    auto &verifiers = dialbackVerifiers();
+    const auto itr = verifiers.find({ domain, remoteDomain });
+    if (itr == verifiers.end() || itr->stream != stream || --itr->pending > 0) {
+        return;
+    }
+
+    // no more verify requests, disconnect
+    verifiers.erase(itr);
+    stream->disconnectFromHost();
+    stream->deleteLater();
+}
+
+void QXmppIncomingServerPrivate::finishVerification(const QString &remoteDomain, const QString &type)
+{
+    // relay verify response
+    QXmppDialback response;
+    response.setCommand(QXmppDialback::Result);
+    response.setTo(remoteDomain);
+    response.setFrom(domain);
+    response.setType(type);
+    q->sendPacket(response);
+
+    // check for success
+    if (type == QLatin1String("valid")) {
+        q->info(QString("Verified incoming domain '%1' on %2").arg(remoteDomain, origin()));
+        const bool wasConnected = !authenticated.isEmpty();
+        authenticated.insert(remoteDomain);
+        if (!wasConnected) {
+            Q_EMIT q->connected();
+        }
+        if (bidirectional) {
+            Q_EMIT q->bidirectionalDomainVerified(remoteDomain);
+        }
+    } else {
+        q->warning(QString("Failed to verify incoming domain '%1' on %2").arg(remoteDomain, origin()));
+        q->disconnectFromHost();
+    }
+}
+
 /// Constructs a new incoming server stream.
 ///
 /// \param socket The socket for the XMPP stream.
@@ -73,6 +176,9 @@ QXmppIncomingServer::QXmppIncomingServer(QSslSocket *socket, const QString &doma
 
 QXmppIncomingServer::~QXmppIncomingServer()
 {
+    for (auto itr = d->pendingVerifications.cbegin(); itr != d->pendingVerifications.cend(); ++itr) {
+        d->releaseVerifier(itr.key(), itr->stream);
+    }
     delete d;
 }
 
@@ -85,6 +191,11 @@ QString QXmppIncomingServer::localStreamId() const
 }
 
 /// \cond
+void QXmppIncomingServer::setDialbackCache(std::shared_ptr<DialbackCache> cache)
+{
+    d->dialbackCache = std::move(cache);
+}
+
 void QXmppIncomingServer::handleStream(const QDomElement &streamElement)
 {
     const QString from = streamElement.attribute("from");
@@ -109,6 +220,7 @@ void QXmppIncomingServer::handleStream(const QDomElement &streamElement)
     if (!socket()->isEncrypted() && !socket()->localCertificate().isNull() && !socket()->privateKey().isNull()) {
         features.setTlsMode(QXmppStreamFeatures::Enabled);
     }
+    features.setBidirectionalStreamsSupported(true);
     sendPacket(features);
 }
 
@@ -116,9 +228,17 @@ void QXmppIncomingServer::handleStanza(const QDomElement &stanza)
 {
     if (QXmppStartTlsPacket::isStartTlsPacket(stanza, QXmppStartTlsPacket::StartTls)) {
         sendPacket(QXmppStartTlsPacket(QXmppStartTlsPacket::Proceed));
+        flushData();
         socket()->flush();
         socket()->startServerEncryption();
         return;
+    } else if (stanza.tagName() == QLatin1String("bidi") && stanza.namespaceURI() == ns_bidi) {
+        // XEP-0288: the remote server accepts stanzas over this stream
+        debug(QString("Bidirectional stream enabled on %1").arg(d->origin()));
+        d->bidirectional = true;
+        for (const auto &domain : std::as_const(d->authenticated)) {
+            Q_EMIT bidirectionalDomainVerified(domain);
+        }
     } else if (QXmppDialback::isDialback(stanza)) {
         QXmppDialback request;
         request.parse(stanza);
@@ -135,12 +255,17 @@ void QXmppIncomingServer::handleStanza(const QDomElement &stanza)
         if (request.command() == QXmppDialback::Result) {
             debug(QString("Received a dialback result from '%1' on %2").arg(domain, d->origin()));
 
-            // establish dialback connection
-            auto *stream = new QXmppOutgoingServer(d->domain, this);
-            connect(stream, &QXmppOutgoingServer::dialbackResponseReceived,
-                    this, &QXmppIncomingServer::slotDialbackResponseReceived);
-            stream->setVerify(d->localStreamId, request.key());
-            stream->connectToHost(domain);
+            if (d->dialbackCache && d->dialbackCache->contains(domain, request.key())) {
+                debug(QString("Dialback key of '%1' has already been verified").arg(domain));
+                d->finishVerification(domain, QStringLiteral("valid"));
+            } else if (!d->pendingVerifications.contains(domain)) {
+                // verify the key with the authoritative server
+                auto *stream = d->acquireVerifier(domain);
+                connect(stream, &QXmppOutgoingServer::dialbackResponseReceived,
+                        this, &QXmppIncomingServer::slotDialbackResponseReceived, Qt::UniqueConnection);
+                d->pendingVerifications.insert(domain, { request.key(), stream });
+                stream->addVerify(d->localStreamId, request.key());
+            }
         } else if (request.command() == QXmppDialback::Verify) {
             debug(QString("Received a dialback verify from '%1' on %2").arg(domain, d->origin()));
             Q_EMIT dialbackRequestReceived(request);
@@ -175,35 +300,28 @@ void QXmppIncomingServer::slotDialbackResponseReceived(const QXmppDialback &dial
     auto *stream = qobject_cast<QXmppOutgoingServer *>(sender());
     if (!stream ||
         dialback.command() != QXmppDialback::Verify ||
-        dialback.id() != d->localStreamId ||
-        dialback.from() != stream->remoteDomain()) {
+        dialback.id() != d->localStreamId) {
         return;
     }
 
-    // relay verify response
-    QXmppDialback response;
-    response.setCommand(QXmppDialback::Result);
-    response.setTo(dialback.from());
-    response.setFrom(d->domain);
-    response.setType(dialback.type());
-    sendPacket(response);
+    // the stream is shared, check the response is for this stream
+    const auto itr = d->pendingVerifications.find(dialback.from());
+    if (itr == d->pendingVerifications.end() || itr->stream != stream) {
+        return;
+    }
+    const auto key = itr->key;
+    d->pendingVerifications.erase(itr);
 
-    // check for success
-    if (response.type() == QLatin1String("valid")) {
-        info(QString("Verified incoming domain '%1' on %2").arg(dialback.from(), d->origin()));
-        const bool wasConnected = !d->authenticated.isEmpty();
-        d->authenticated.insert(dialback.from());
-        if (!wasConnected) {
-            Q_EMIT connected();
-        }
-    } else {
-        warning(QString("Failed to verify incoming domain '%1' on %2").arg(dialback.from(), d->origin()));
-        disconnectFromHost();
+    if (dialback.type() == QLatin1String("valid") && d->dialbackCache) {
+        d->dialbackCache->insert(dialback.from(), key);
     }
 
     // disconnect dialback
-    stream->disconnectFromHost();
-    stream->deleteLater();
+    disconnect(stream, &QXmppOutgoingServer::dialbackResponseReceived,
+               this, &QXmppIncomingServer::slotDialbackResponseReceived);
+    d->releaseVerifier(dialback.from(), stream);
+
+    d->finishVerification(dialback.from(), dialback.type());
 }
 
 void QXmppIncomingServer::slotSocketDisconnected()
@@ -7,10 +7,16 @@
 
 #include "QXmppStream.h"
 
+#include <memory>
+
 class QXmppDialback;
 class QXmppIncomingServerPrivate;
 class QXmppOutgoingServer;
 
+namespace QXmpp::Private {
+class DialbackCache;
+}
+
 /// \brief The QXmppIncomingServer class represents an incoming XMPP stream
 /// from an XMPP server.
 ///
@@ -26,6 +32,10 @@ public:
     bool isConnected() const override;
     QString localStreamId() const;
 
+    /// \cond
+    void setDialbackCache(std::shared_ptr<QXmpp::Private::DialbackCache> cache);
+    /// \endcond
+
 Q_SIGNALS:
     /// This signal is emitted when a dialback verify request is received.
     void dialbackRequestReceived(const QXmppDialback &result);
@@ -33,6 +43,17 @@ Q_SIGNALS:
     /// This signal is emitted when an element is received.
     void elementReceived(const QDomElement &element);
 
+    ///
+    /// This signal is emitted when a remote domain has been verified on a
+    /// stream the remote server has enabled \xep{0288, Bidirectional
+    /// Server-to-Server Connections} on.
+    ///
+    /// Stanzas to the domain can then be sent over this stream.
+    ///
+    /// \since QXmpp 1.6
+    ///
+    void bidirectionalDomainVerified(const QString &domain);
+
 protected:
     /// \cond
     void handleStanza(const QDomElement &stanzaElement) override;
@@ -0,0 +1,485 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppMamExtension.h"
+
+#include "QXmppArchiveLog_p.h"
+#include "QXmppConstants_p.h"
+#include "QXmppMamIq.h"
+#include "QXmppServer.h"
+#include "QXmppUtils.h"
+#include "QXmppUtils_p.h"
+
+#include <unordered_map>
+
+#include <QDateTime>
+#include <QDir>
+#include <QDomElement>
+#include <QSet>
+#include <QTimer>
+#include <QUrl>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+using namespace QXmpp::Private;
+
+namespace {
+
+// XEP-0313: an archived message sent to the querying user
+class ArchivedMessage : public QXmppStanza
+{
+public:
+    QString queryId;
+    ArchiveLog::Record record;
+
+    void toXml(QXmlStreamWriter *writer) const override
+    {
+        writer->writeStartElement(QStringLiteral("message"));
+        helperToXmlAddAttribute(writer, QStringLiteral("to"), to());
+        helperToXmlAddAttribute(writer, QStringLiteral("from"), from());
+        writer->writeStartElement(QStringLiteral("result"));
+        writer->writeDefaultNamespace(ns_mam);
+        helperToXmlAddAttribute(writer, QStringLiteral("queryid"), queryId);
+        writer->writeAttribute(QStringLiteral("id"), QString::number(record.id));
+        writer->writeStartElement(QStringLiteral("forwarded"));
+        writer->writeDefaultNamespace(ns_forwarding);
+        writer->writeStartElement(QStringLiteral("delay"));
+        writer->writeDefaultNamespace(ns_delayed_delivery);
+        writer->writeAttribute(QStringLiteral("stamp"), QXmppUtils::datetimeToString(QDateTime::fromMSecsSinceEpoch(record.timestamp)));
+        writer->writeEndElement();
+
+        // the stored message is copied token by token, without building a
+        // DOM for it
+        QXmlStreamReader reader(record.payload);
+        while (!reader.atEnd()) {
+            reader.readNext();
+            if (reader.isStartElement() || reader.isEndElement() || reader.isCharacters()) {
+                writer->writeCurrentToken(reader);
+            }
+        }
+
+        writer->writeEndElement();
+        writer->writeEndElement();
+        writer->writeEndElement();
+    }
+};
+
+}  // namespace
+
+// Serializes an element; the stanza itself is written in the jabber:client
+// namespace, so archived messages of server streams look the same.
+static void writeElement(QXmlStreamWriter *writer, const QDomElement &element, const QString &parentNamespace)
+{
+    writer->writeStartElement(element.tagName());
+    auto xmlns = element.namespaceURI();
+    if (parentNamespace.isNull() || xmlns == ns_server) {
+        xmlns = ns_client;
+    }
+    if (xmlns != parentNamespace) {
+        writer->writeDefaultNamespace(xmlns);
+    }
+    const auto attributes = element.attributes();
+    for (int i = 0; i < attributes.size(); ++i) {
+        const auto attribute = attributes.item(i).toAttr();
+        writer->writeAttribute(attribute.name(), attribute.value());
+    }
+    for (auto child = element.firstChild(); !child.isNull(); child = child.nextSibling()) {
+        if (child.isElement()) {
+            writeElement(writer, child.toElement(), xmlns);
+        } else if (child.isText()) {
+            writer->writeCharacters(child.toText().data());
+        }
+    }
+    writer->writeEndElement();
+}
+
+class QXmppMamExtensionPrivate
+{
+public:
+    explicit QXmppMamExtensionPrivate(QXmppMamExtension *qq);
+
+    bool isLocal(const QString &bareJid) const;
+    ArchiveLog *log(const QString &bareJid);
+    void archive(const QDomElement &message);
+    void append(const QString &bareJid, const QString &with, const QByteArray &payload, qint64 timestamp);
+    void commit();
+    bool handleQuery(const QDomElement &element);
+
+    QXmppMamExtension *q;
+
+    QString directory;
+    qint64 segmentSize = 16 * 1024 * 1024;
+    int maximumPageSize = 100;
+
+    // archives by bare JID, opened on first use
+    std::unordered_map<QString, std::unique_ptr<ArchiveLog>> logs;
+    // archives with appended records, written together when the timer expires
+    QSet<ArchiveLog *> pendingLogs;
+    QTimer commitTimer;
+};
+
+QXmppMamExtensionPrivate::QXmppMamExtensionPrivate(QXmppMamExtension *qq)
+    : q(qq)
+{
+    commitTimer.setSingleShot(true);
+    commitTimer.setInterval(10);
+    QObject::connect(&commitTimer, &QTimer::timeout, q, [this] { commit(); });
+}
+
+bool QXmppMamExtensionPrivate::isLocal(const QString &bareJid) const
+{
+    return !QXmppUtils::jidToUser(bareJid).isEmpty() && QXmppUtils::jidToDomain(bareJid) == q->server()->domain();
+}
+
+// Returns the archive of a local user, nullptr if no directory is set.
+ArchiveLog *QXmppMamExtensionPrivate::log(const QString &bareJid)
+{
+    if (directory.isEmpty()) {
+        return nullptr;
+    }
+
+    auto itr = logs.find(bareJid);
+    if (itr == logs.end()) {
+        const auto path = QDir(directory).filePath(QString::fromLatin1(QUrl::toPercentEncoding(bareJid)));
+        auto log = std::make_unique<ArchiveLog>(path, segmentSize);
+        // archives that can't be opened are kept, so they are only reported
+        // once
+        if (!log->open()) {
+            q->warning(QStringLiteral("Could not open the message archive %1").arg(path));
+        }
+        itr = logs.emplace(bareJid, std::move(log)).first;
+    }
+    return itr->second->isOpen() ? itr->second.get() : nullptr;
+}
+
+void QXmppMamExtensionPrivate::archive(const QDomElement &message)
+{
+    const auto type = message.attribute(QStringLiteral("type"));
+    if (type == QLatin1String("error") || type == QLatin1String("groupchat") || type == QLatin1String("headline") ||
+        message.firstChildElement(QStringLiteral("body")).isNull()) {
+        return;
+    }
+    for (auto child = message.firstChildElement(); !child.isNull(); child = child.nextSiblingElement()) {
+        if (child.namespaceURI() == ns_message_processing_hints &&
+            (child.tagName() == QLatin1String("no-store") || child.tagName() == QLatin1String("no-permanent-store"))) {
+            return;
+        }
+    }
+
+    const auto from = message.attribute(QStringLiteral("from"));
+    const auto to = message.attribute(QStringLiteral("to"));
+    const auto fromBare = QXmppUtils::jidToBareJid(from);
+    const auto toBare = QXmppUtils::jidToBareJid(to);
+    const bool archiveSent = isLocal(fromBare);
+    const bool archiveReceived = toBare != fromBare && isLocal(toBare);
+    if (!archiveSent && !archiveReceived) {
+        return;
+    }
+
+    QByteArray payload;
+    QXmlStreamWriter writer(&payload);
+    writeElement(&writer, message, QString());
+
+    const auto timestamp = QDateTime::currentMSecsSinceEpoch();
+    if (archiveSent) {
+        append(fromBare, to, payload, timestamp);
+    }
+    if (archiveReceived) {
+        append(toBare, from, payload, timestamp);
+    }
+}
+
+void QXmppMamExtensionPrivate::append(const QString &bareJid, const QString &with, const QByteArray &payload, qint64 timestamp)
+{
+    auto *archive = log(bareJid);
+    if (!archive) {
+        return;
+    }
+    if (!archive->append(timestamp, with, payload)) {
+        q->warning(QStringLiteral("Could not archive a message of %1").arg(bareJid));
+        return;
+    }
+    pendingLogs.insert(archive);
+    if (!commitTimer.isActive()) {
+        commitTimer.start();
+    }
+}
+
+void QXmppMamExtensionPrivate::commit()
+{
+    for (auto *archive : std::as_const(pendingLogs)) {
+        if (!archive->commit()) {
+            q->warning(QStringLiteral("Could not write to a message archive, messages have been lost"));
+        }
+    }
+    pendingLogs.clear();
+    commitTimer.stop();
+}
+
+// Answers a query of a local user for their own archive.
+bool QXmppMamExtensionPrivate::handleQuery(const QDomElement &element)
+{
+    QXmppMamQueryIq request;
+    request.parse(element);
+    const auto bareJid = QXmppUtils::jidToBareJid(request.from());
+    if (request.type() != QXmppIq::Set || !isLocal(bareJid) ||
+        (!request.to().isEmpty() && request.to() != bareJid && request.to() != q->server()->domain())) {
+        return false;
+    }
+    auto *archive = log(bareJid);
+    if (!archive) {
+        return false;
+    }
+
+    // the query is addressed to the account of the user, even if the stream
+    // has added the domain
+    QXmppIq error;
+    error.setType(QXmppIq::Error);
+    error.setId(request.id());
+    error.setFrom(bareJid);
+    error.setTo(request.from());
+    const auto sendError = [&](QXmppStanza::Error::Type type, QXmppStanza::Error::Condition condition) {
+        error.setError(QXmppStanza::Error(type, condition));
+        q->server()->sendPacket(error);
+        return true;
+    };
+
+    if (!request.node().isEmpty()) {
+        return sendError(QXmppStanza::Error::Cancel, QXmppStanza::Error::FeatureNotImplemented);
+    }
+
+    ArchiveLog::Query query;
+    const auto fields = request.form().fields();
+    for (const auto &field : fields) {
+        const auto value = field.value().toString();
+        if (field.key() == QLatin1String("with")) {
+            query.with = value;
+        } else if (field.key() == QLatin1String("start") || field.key() == QLatin1String("end")) {
+            const auto stamp = QXmppUtils::datetimeFromString(value);
+            if (!stamp.isValid()) {
+                return sendError(QXmppStanza::Error::Modify, QXmppStanza::Error::BadRequest);
+            }
+            (field.key() == QLatin1String("start") ? query.start : query.end) = stamp.toMSecsSinceEpoch();
+        }
+    }
+
+    // an archive ID of the query, which needs to exist
+    const auto parseId = [archive](const QString &text, quint64 &id) {
+        bool ok = false;
+        id = text.toULongLong(&ok);
+        return ok && id > 0 && id <= archive->lastId();
+    };
+    const auto resultSet = request.resultSetQuery();
+    query.max = resultSet.max() < 0 ? maximumPageSize : std::min(resultSet.max(), maximumPageSize);
+    if (!resultSet.after().isEmpty() && !parseId(resultSet.after(), query.after)) {
+        return sendError(QXmppStanza::Error::Cancel, QXmppStanza::Error::ItemNotFound);
+    }
+    // an empty 'before' element requests the last page
+    const auto before = element.firstChildElement(QStringLiteral("query")).firstChildElement(QStringLiteral("set")).firstChildElement(QStringLiteral("before"));
+    if (!before.isNull() && before.parentNode().namespaceURI() == ns_rsm) {
+        quint64 id = archive->lastId() + 1;
+        if (!before.text().isEmpty() && !parseId(before.text(), id)) {
+            return sendError(QXmppStanza::Error::Cancel, QXmppStanza::Error::ItemNotFound);
+        }
+        query.before = id;
+    }
+
+    const auto page = archive->query(query);
+
+    // the results are written to the stream of the user before the response
+    ArchivedMessage message;
+    message.setTo(request.from());
+    message.setFrom(bareJid);
+    message.queryId = request.queryId();
+    for (const auto &record : page.records) {
+        message.record = record;
+        q->server()->sendPacket(message);
+    }
+
+    QXmppResultSetReply resultSet;
+    if (!page.records.isEmpty()) {
+        resultSet.setFirst(QString::number(page.records.first().id));
+        resultSet.setLast(QString::number(page.records.last().id));
+    }
+
+    QXmppMamResultIq response;
+    response.setType(QXmppIq::Result);
+    response.setId(request.id());
+    response.setFrom(bareJid);
+    response.setTo(request.from());
+    response.setResultSetReply(resultSet);
+    response.setComplete(page.complete);
+    q->server()->sendPacket(response);
+    return true;
+}
+
+///
+/// \class QXmppMamExtension
+///
+/// \brief The QXmppMamExtension class archives the messages of the users of
+/// QXmppServer and answers their \xep{0313, Message Archive Management}
+/// queries.
+///
+/// Messages with a body sent or received by a local user are added to the
+/// archive of the user, except for group chat messages, headlines, errors and
+/// messages with a \xep{0334, Message Processing Hints} hint not to store
+/// them. Queries can be filtered by the other party and by time, and are paged
+/// using \xep{0059, Result Set Management}.
+///
+/// Each user has an archive directory with append-only segment files. The
+/// messages of one event loop iteration, or of the commit interval, are
+/// written at once, so archiving only adds a memory copy to the routing.
+/// Queries look up the position of the first message in a sparse index kept
+/// in memory and read the memory mapped segments sequentially from there. The
+/// archive IDs are numbers that increase with every message of a user.
+///
+/// An archive directory needs to be set with setArchiveDirectory() before the
+/// server is started.
+///
+/// \since QXmpp 1.6
+///
+/// \ingroup Core
+///
+
+///
+/// Constructs a message archive extension.
+///
+QXmppMamExtension::QXmppMamExtension()
+    : d(std::make_unique<QXmppMamExtensionPrivate>(this))
+{
+}
+
+QXmppMamExtension::~QXmppMamExtension() = default;
+
+///
+/// Returns the directory containing the archives of the users.
+///
+QString QXmppMamExtension::archiveDirectory() const
+{
+    return d->directory;
+}
+
+///
+/// Sets the directory containing the archives of the users.
+///
+/// Each user gets a subdirectory with their percent-encoded bare JID as the
+/// name.
+///
+void QXmppMamExtension::setArchiveDirectory(const QString &path)
+{
+    d->commit();
+    d->logs.clear();
+    d->directory = path;
+}
+
+///
+/// Returns the size in bytes after which a new segment file is started.
+///
+qint64 QXmppMamExtension::segmentSize() const
+{
+    return d->segmentSize;
+}
+
+///
+/// Sets the size in bytes after which a new segment file is started.
+///
+/// The default is 16 MiB. Only archives opened afterwards are affected.
+///
+void QXmppMamExtension::setSegmentSize(qint64 bytes)
+{
+    d->segmentSize = std::max<qint64>(bytes, 4096);
+}
+
+///
+/// Returns the time in milliseconds archived messages are collected before
+/// they are written.
+///
+int QXmppMamExtension::commitInterval() const
+{
+    return d->commitTimer.interval();
+}
+
+///
+/// Sets the time in milliseconds archived messages are collected before they
+/// are written.
+///
+/// The default is 10 ms. With 0, the messages of one event loop iteration are
+/// written together. Messages are always written before a query of the user
+/// is answered.
+///
+void QXmppMamExtension::setCommitInterval(int msecs)
+{
+    d->commitTimer.setInterval(std::max(msecs, 0));
+}
+
+///
+/// Returns the maximum number of messages returned for one query.
+///
+int QXmppMamExtension::maximumPageSize() const
+{
+    return d->maximumPageSize;
+}
+
+///
+/// Sets the maximum number of messages returned for one query.
+///
+/// Clients requesting more messages get this number of messages and need to
+/// request the next page. The default is 100.
+///
+void QXmppMamExtension::setMaximumPageSize(int messages)
+{
+    d->maximumPageSize = std::max(messages, 1);
+}
+
+///
+/// Returns the number of messages in the archive of a local user.
+///
+quint64 QXmppMamExtension::messageCount(const QString &bareJid)
+{
+    const auto *archive = d->log(bareJid);
+    return archive ? archive->lastId() : 0;
+}
+
+/// \cond
+QStringList QXmppMamExtension::discoveryFeatures() const
+{
+    return { ns_mam };
+}
+
+QVector<QXmppServerExtension::StanzaFilter> QXmppMamExtension::stanzaFilters() const
+{
+    return {
+        { QStringLiteral("message"), {}, {} },
+        { QStringLiteral("iq"), ns_mam, {} },
+    };
+}
+
+bool QXmppMamExtension::handleStanza(const QDomElement &element)
+{
+    if (element.tagName() == QLatin1String("message")) {
+        // messages are routed as usual
+        d->archive(element);
+        return false;
+    }
+    if (QXmppMamQueryIq::isMamQueryIq(element)) {
+        return d->handleQuery(element);
+    }
+    return false;
+}
+
+bool QXmppMamExtension::start()
+{
+    if (d->directory.isEmpty()) {
+        warning(QStringLiteral("No archive directory set, messages are not archived"));
+        return false;
+    }
+    return true;
+}
+
+void QXmppMamExtension::stop()
+{
+    d->commit();
+    d->logs.clear();
+}
+/// \endcond
@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPMAMEXTENSION_H
+#define QXMPPMAMEXTENSION_H
+
+#include "QXmppServerExtension.h"
+
+#include <memory>
+
+class QXmppMamExtensionPrivate;
+
+class QXMPP_EXPORT QXmppMamExtension : public QXmppServerExtension
+{
+    Q_OBJECT
+    Q_CLASSINFO("ExtensionName", "mam")
+
+public:
+    QXmppMamExtension();
+    ~QXmppMamExtension() override;
+
+    QString archiveDirectory() const;
+    void setArchiveDirectory(const QString &path);
+
+    qint64 segmentSize() const;
+    void setSegmentSize(qint64 bytes);
+
+    int commitInterval() const;
+    void setCommitInterval(int msecs);
+
+    int maximumPageSize() const;
+    void setMaximumPageSize(int messages);
+
+    quint64 messageCount(const QString &bareJid);
+
+    /// \cond
+    QStringList discoveryFeatures() const override;
+    QVector<StanzaFilter> stanzaFilters() const override;
+    bool handleStanza(const QDomElement &stanza) override;
+    bool start() override;
+    void stop() override;
+    /// \endcond
+
+private:
+    const std::unique_ptr<QXmppMamExtensionPrivate> d;
+
+    friend class QXmppMamExtensionPrivate;
+};
+
+#endif  // QXMPPMAMEXTENSION_H
@@ -0,0 +1,1032 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppMucExtension.h"
+
+#include "QXmppArchiveLog_p.h"
+#include "QXmppConstants_p.h"
+#include "QXmppDiscoveryIq.h"
+#include "QXmppMessage.h"
+#include "QXmppMetrics.h"
+#include "QXmppMucIq.h"
+#include "QXmppPresence.h"
+#include "QXmppServer.h"
+#include "QXmppUtils.h"
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <QDateTime>
+#include <QDir>
+#include <QDomElement>
+#include <QHash>
+#include <QSet>
+#include <QThread>
+#include <QTimer>
+#include <QUrl>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+using namespace QXmpp::Private;
+
+namespace {
+
+// Serializes an element, the stanzas of server streams are written in the
+// jabber:client namespace like the ones of clients.
+void writeElement(QXmlStreamWriter *writer, const QDomElement &element, const QString &parentNamespace)
+{
+    writer->writeStartElement(element.tagName());
+    auto xmlns = element.namespaceURI();
+    if (xmlns == ns_server) {
+        xmlns = ns_client;
+    }
+    if (xmlns != parentNamespace) {
+        writer->writeDefaultNamespace(xmlns);
+    }
+    const auto attributes = element.attributes();
+    for (int i = 0; i < attributes.size(); ++i) {
+        const auto attribute = attributes.item(i).toAttr();
+        writer->writeAttribute(attribute.name(), attribute.value());
+    }
+    for (auto child = element.firstChild(); !child.isNull(); child = child.nextSibling()) {
+        if (child.isElement()) {
+            writeElement(writer, child.toElement(), xmlns);
+        } else if (child.isText()) {
+            writer->writeCharacters(child.toText().data());
+        }
+    }
+    writer->writeEndElement();
+}
+
+// Serializes the children of a presence without the MUC elements, wrapped in
+// a presence element.
+QByteArray storePresence(const QDomElement &presence)
+{
+    QByteArray data;
+    QXmlStreamWriter writer(&data);
+    writer.writeStartElement(QStringLiteral("presence"));
+    writer.writeDefaultNamespace(ns_client);
+    for (auto child = presence.firstChildElement(); !child.isNull(); child = child.nextSiblingElement()) {
+        if (child.namespaceURI() != ns_muc && child.namespaceURI() != ns_muc_user) {
+            writeElement(&writer, child, ns_client);
+        }
+    }
+    writer.writeEndElement();
+    return data;
+}
+
+// Copies the children of an element stored by storePresence() token by token.
+void writeStoredChildren(QXmlStreamWriter *writer, const QByteArray &data)
+{
+    QXmlStreamReader reader(data);
+    int depth = 0;
+    while (!reader.atEnd()) {
+        reader.readNext();
+        if (reader.isStartElement()) {
+            if (depth++ > 0) {
+                writer->writeCurrentToken(reader);
+            }
+        } else if (reader.isEndElement()) {
+            if (--depth > 0) {
+                writer->writeCurrentToken(reader);
+            }
+        } else if (reader.isCharacters() && depth > 1) {
+            writer->writeCurrentToken(reader);
+        }
+    }
+}
+
+// XEP-0045: the presence of an occupant as seen by the other occupants
+class OccupantPresence : public QXmppStanza
+{
+public:
+    bool available = true;
+    QByteArray children;
+    QXmppMucItem::Affiliation affiliation = QXmppMucItem::NoAffiliation;
+    QXmppMucItem::Role role = QXmppMucItem::ParticipantRole;
+    QString newNick;
+    QVector<int> statusCodes;
+
+    void parse(const QDomElement &) override { }
+    void toXml(QXmlStreamWriter *writer) const override
+    {
+        writer->writeStartElement(QStringLiteral("presence"));
+        helperToXmlAddAttribute(writer, QStringLiteral("to"), to());
+        helperToXmlAddAttribute(writer, QStringLiteral("from"), from());
+        if (!available) {
+            writer->writeAttribute(QStringLiteral("type"), QStringLiteral("unavailable"));
+        }
+        writeStoredChildren(writer, children);
+        writer->writeStartElement(QStringLiteral("x"));
+        writer->writeDefaultNamespace(ns_muc_user);
+        writer->writeStartElement(QStringLiteral("item"));
+        writer->writeAttribute(QStringLiteral("affiliation"), QXmppMucItem::affiliationToString(affiliation));
+        helperToXmlAddAttribute(writer, QStringLiteral("nick"), newNick);
+        writer->writeAttribute(QStringLiteral("role"), available ? QXmppMucItem::roleToString(role) : QStringLiteral("none"));
+        writer->writeEndElement();
+        for (const auto code : statusCodes) {
+            writer->writeStartElement(QStringLiteral("status"));
+            writer->writeAttribute(QStringLiteral("code"), QString::number(code));
+            writer->writeEndElement();
+        }
+        writer->writeEndElement();
+        writer->writeEndElement();
+    }
+};
+
+// A message of an occupant, with the payload of the message it has sent
+class OccupantMessage : public QXmppStanza
+{
+public:
+    QDomElement message;
+    // archived messages are stored with their namespace
+    bool withNamespace = false;
+
+    void parse(const QDomElement &) override { }
+    void toXml(QXmlStreamWriter *writer) const override
+    {
+        writer->writeStartElement(QStringLiteral("message"));
+        if (withNamespace) {
+            writer->writeDefaultNamespace(ns_client);
+        }
+        helperToXmlAddAttribute(writer, QStringLiteral("to"), to());
+        helperToXmlAddAttribute(writer, QStringLiteral("from"), from());
+        const auto attributes = message.attributes();
+        for (int i = 0; i < attributes.size(); ++i) {
+            const auto attribute = attributes.item(i).toAttr();
+            if (attribute.name() != QLatin1String("to") && attribute.name() != QLatin1String("from")) {
+                writer->writeAttribute(attribute.name(), attribute.value());
+            }
+        }
+        for (auto child = message.firstChildElement(); !child.isNull(); child = child.nextSiblingElement()) {
+            writeElement(writer, child, ns_client);
+        }
+        writer->writeEndElement();
+    }
+};
+
+// A message of the room history, with the time it has been sent
+class HistoryMessage : public QXmppStanza
+{
+public:
+    QString roomJid;
+    ArchiveLog::Record record;
+
+    void parse(const QDomElement &) override { }
+    void toXml(QXmlStreamWriter *writer) const override
+    {
+        QXmlStreamReader reader(record.payload);
+        int depth = 0;
+        while (!reader.atEnd()) {
+            reader.readNext();
+            if (reader.isStartElement()) {
+                writer->writeCurrentToken(reader);
+                if (depth++ == 0) {
+                    helperToXmlAddAttribute(writer, QStringLiteral("to"), to());
+                    writer->writeStartElement(QStringLiteral("delay"));
+                    writer->writeDefaultNamespace(ns_delayed_delivery);
+                    writer->writeAttribute(QStringLiteral("from"), roomJid);
+                    writer->writeAttribute(QStringLiteral("stamp"), QXmppUtils::datetimeToString(QDateTime::fromMSecsSinceEpoch(record.timestamp)));
+                    writer->writeEndElement();
+                }
+            } else if (reader.isEndElement()) {
+                depth--;
+                writer->writeCurrentToken(reader);
+            } else if (reader.isCharacters()) {
+                writer->writeCurrentToken(reader);
+            }
+        }
+    }
+};
+
+// The subject of a room, which is sent even if it is empty
+class SubjectMessage : public QXmppStanza
+{
+public:
+    QString subject;
+
+    void parse(const QDomElement &) override { }
+    void toXml(QXmlStreamWriter *writer) const override
+    {
+        writer->writeStartElement(QStringLiteral("message"));
+        helperToXmlAddAttribute(writer, QStringLiteral("to"), to());
+        helperToXmlAddAttribute(writer, QStringLiteral("from"), from());
+        writer->writeAttribute(QStringLiteral("type"), QStringLiteral("groupchat"));
+        writer->writeTextElement(QStringLiteral("subject"), subject);
+        writer->writeEndElement();
+    }
+};
+
+struct Room
+{
+    QString jid;
+    // bare JID of the user who has created the room
+    QString owner;
+    QString subject;
+    QString subjectFrom;
+
+    // The occupants are kept in parallel arrays, a leaving occupant is
+    // replaced by the last one. The real JIDs are the recipients of the
+    // broadcasts, so they are passed on without building a list.
+    QStringList nicks;
+    QStringList occupantJids;
+    QVector<QByteArray> presences;
+    QHash<QString, int> indexByJid;
+    QHash<QString, int> indexByNick;
+
+    std::unique_ptr<ArchiveLog> archive;
+};
+
+// Owns the rooms whose JIDs hash to it. Each shard handles its stanzas in its
+// own thread, so the rooms need no locking.
+class MucShard : public QObject
+{
+public:
+    explicit MucShard(QXmppMucExtensionPrivate *d);
+
+    void handleStanza(const QDomElement &stanza);
+    void removeOccupant(const QString &jid);
+    void close();
+
+private:
+    void handlePresence(const QDomElement &presence, const QString &roomJid, const QString &nick);
+    void handleMessage(const QDomElement &message, const QString &roomJid, const QString &nick);
+    void handleIq(const QDomElement &iq, const QString &roomJid, const QString &nick);
+
+    Room &createRoom(const QString &roomJid, const QString &owner);
+    void join(Room &room, const QString &jid, const QString &nick, const QDomElement &presence, bool created);
+    void leave(Room &room, int index);
+    void changeNick(Room &room, int index, const QString &nick, const QDomElement &presence);
+    void sendHistory(Room &room, const QString &jid, const QDomElement &presence);
+    void archive(Room &room, OccupantMessage &message);
+    void commit();
+
+    OccupantPresence occupantPresence(const Room &room, int index) const;
+    void broadcastPresence(const Room &room, int index, OccupantPresence &presence);
+    void sendError(const QDomElement &stanza, QXmppStanza::Error::Type type, QXmppStanza::Error::Condition condition);
+
+    QXmppMucExtensionPrivate *d;
+    std::unordered_map<QString, Room> m_rooms;
+    // rooms by the real JIDs of their occupants
+    QHash<QString, QStringList> m_roomsByOccupant;
+    // archives with appended messages, written together when the timer
+    // expires
+    QSet<ArchiveLog *> m_pendingLogs;
+    QTimer m_commitTimer;
+};
+
+}  // namespace
+
+class QXmppMucExtensionPrivate
+{
+public:
+    explicit QXmppMucExtensionPrivate(QXmppMucExtension *qq);
+
+    MucShard *shardFor(const QString &roomJid) const;
+    void dispatch(const QDomElement &element, const QString &roomJid);
+    void handleServiceStanza(const QDomElement &element);
+    void warning(const QString &message);
+
+    QXmppMucExtension *q;
+    QXmppServer *server = nullptr;
+
+    // the settings are only changed while the shards are stopped
+    QString jid;
+    int shardCount = 0;
+    QString archiveDirectory;
+    qint64 segmentSize = 16 * 1024 * 1024;
+    int historySize = 20;
+
+    std::vector<std::unique_ptr<MucShard>> shards;
+    std::vector<std::unique_ptr<QThread>> threads;
+};
+
+MucShard::MucShard(QXmppMucExtensionPrivate *d)
+    : d(d), m_commitTimer(this)
+{
+    m_commitTimer.setSingleShot(true);
+    m_commitTimer.setInterval(0);
+    connect(&m_commitTimer, &QTimer::timeout, this, [this] { commit(); });
+}
+
+void MucShard::handleStanza(const QDomElement &stanza)
+{
+    const auto to = stanza.attribute(QStringLiteral("to"));
+    const auto roomJid = QXmppUtils::jidToBareJid(to);
+    const auto nick = QXmppUtils::jidToResource(to);
+
+    const auto tagName = stanza.tagName();
+    if (tagName == QLatin1String("presence")) {
+        handlePresence(stanza, roomJid, nick);
+    } else if (tagName == QLatin1String("message")) {
+        handleMessage(stanza, roomJid, nick);
+    } else if (tagName == QLatin1String("iq")) {
+        handleIq(stanza, roomJid, nick);
+    }
+}
+
+// Removes a user who has disconnected from all rooms.
+void MucShard::removeOccupant(const QString &jid)
+{
+    const auto roomJids = m_roomsByOccupant.value(jid);
+    for (const auto &roomJid : roomJids) {
+        const auto room = m_rooms.find(roomJid);
+        if (room != m_rooms.end()) {
+            leave(room->second, room->second.indexByJid.value(jid, -1));
+        }
+    }
+}
+
+void MucShard::close()
+{
+    commit();
+    QXmppMetrics::addToGauge(QXmppMetrics::MucRooms, -qint64(m_rooms.size()));
+    m_rooms.clear();
+    m_roomsByOccupant.clear();
+}
+
+void MucShard::handlePresence(const QDomElement &presence, const QString &roomJid, const QString &nick)
+{
+    const auto from = presence.attribute(QStringLiteral("from"));
+    const auto type = presence.attribute(QStringLiteral("type"));
+    auto roomItr = m_rooms.find(roomJid);
+    const int index = roomItr == m_rooms.end() ? -1 : roomItr->second.indexByJid.value(from, -1);
+
+    if (type == QLatin1String("unavailable")) {
+        if (index >= 0) {
+            leave(roomItr->second, index);
+        }
+        return;
+    }
+    if (!type.isEmpty()) {
+        return;
+    }
+    if (nick.isEmpty()) {
+        return sendError(presence, QXmppStanza::Error::Modify, QXmppStanza::Error::JidMalformed);
+    }
+
+    if (index >= 0) {
+        auto &room = roomItr->second;
+        if (room.nicks[index] != nick) {
+            changeNick(room, index, nick, presence);
+            return;
+        }
+        // a changed presence of the occupant
+        room.presences[index] = storePresence(presence);
+        auto update = occupantPresence(room, index);
+        broadcastPresence(room, index, update);
+        return;
+    }
+
+    const bool created = roomItr == m_rooms.end();
+    auto &room = created ? createRoom(roomJid, QXmppUtils::jidToBareJid(from)) : roomItr->second;
+    if (room.indexByNick.contains(nick)) {
+        return sendError(presence, QXmppStanza::Error::Cancel, QXmppStanza::Error::Conflict);
+    }
+    join(room, from, nick, presence, created);
+}
+
+void MucShard::handleMessage(const QDomElement &message, const QString &roomJid, const QString &nick)
+{
+    const auto type = message.attribute(QStringLiteral("type"));
+    if (type == QLatin1String("error")) {
+        return;
+    }
+
+    const auto roomItr = m_rooms.find(roomJid);
+    const int index = roomItr == m_rooms.end() ? -1 : roomItr->second.indexByJid.value(message.attribute(QStringLiteral("from")), -1);
+    if (index < 0) {
+        return sendError(message, QXmppStanza::Error::Modify, QXmppStanza::Error::NotAcceptable);
+    }
+    auto &room = roomItr->second;
+    const auto occupantJid = room.jid + QLatin1Char('/') + room.nicks[index];
+
+    // a private message to another occupant
+    if (!nick.isEmpty()) {
+        const int recipient = room.indexByNick.value(nick, -1);
+        if (recipient < 0) {
+            return sendError(message, QXmppStanza::Error::Cancel, QXmppStanza::Error::ItemNotFound);
+        }
+        OccupantMessage forwarded;
+        forwarded.message = message;
+        forwarded.setFrom(occupantJid);
+        forwarded.setTo(room.occupantJids[recipient]);
+        d->server->sendPacket(forwarded);
+        return;
+    }
+
+    if (type != QLatin1String("groupchat")) {
+        return sendError(message, QXmppStanza::Error::Modify, QXmppStanza::Error::BadRequest);
+    }
+
+    // a new subject
+    const auto subject = message.firstChildElement(QStringLiteral("subject"));
+    if (!subject.isNull() && message.firstChildElement(QStringLiteral("body")).isNull()) {
+        room.subject = subject.text();
+        room.subjectFrom = occupantJid;
+
+        SubjectMessage update;
+        update.setFrom(occupantJid);
+        update.subject = room.subject;
+        d->server->broadcastPacket(update, room.occupantJids);
+        return;
+    }
+
+    OccupantMessage broadcast;
+    broadcast.message = message;
+    broadcast.setFrom(occupantJid);
+    archive(room, broadcast);
+    // serialized once for all occupants
+    d->server->broadcastPacket(broadcast, room.occupantJids);
+}
+
+void MucShard::handleIq(const QDomElement &iq, const QString &roomJid, const QString &nick)
+{
+    const auto type = iq.attribute(QStringLiteral("type"));
+    if (type != QLatin1String("get") && type != QLatin1String("set")) {
+        return;
+    }
+
+    const auto roomItr = m_rooms.find(roomJid);
+    if (roomItr == m_rooms.end()) {
+        return sendError(iq, QXmppStanza::Error::Cancel, QXmppStanza::Error::ItemNotFound);
+    }
+    if (!nick.isEmpty() || !QXmppDiscoveryIq::isDiscoveryIq(iq)) {
+        return sendError(iq, QXmppStanza::Error::Cancel, QXmppStanza::Error::FeatureNotImplemented);
+    }
+
+    QXmppDiscoveryIq request;
+    request.parse(iq);
+    if (request.type() != QXmppIq::Get || request.queryType() != QXmppDiscoveryIq::InfoQuery || !request.queryNode().isEmpty()) {
+        return sendError(iq, QXmppStanza::Error::Cancel, QXmppStanza::Error::FeatureNotImplemented);
+    }
+
+    QXmppDiscoveryIq::Identity identity;
+    identity.setCategory(QStringLiteral("conference"));
+    identity.setType(QStringLiteral("text"));
+    identity.setName(QXmppUtils::jidToUser(roomJid));
+
+    QXmppDiscoveryIq response;
+    response.setType(QXmppIq::Result);
+    response.setId(request.id());
+    response.setFrom(roomJid);
+    response.setTo(request.from());
+    response.setQueryType(QXmppDiscoveryIq::InfoQuery);
+    response.setIdentities({ identity });
+    response.setFeatures({
+        ns_disco_info,
+        ns_muc,
+        QStringLiteral("muc_open"),
+        QStringLiteral("muc_public"),
+        QStringLiteral("muc_temporary"),
+        QStringLiteral("muc_unmoderated"),
+        QStringLiteral("muc_unsecured"),
+    });
+    d->server->sendPacket(response);
+}
+
+Room &MucShard::createRoom(const QString &roomJid, const QString &owner)
+{
+    auto &room = m_rooms[roomJid];
+    room.jid = roomJid;
+    QXmppMetrics::addToGauge(QXmppMetrics::MucRooms, 1);
+    room.owner = owner;
+
+    // the history of a room outlives its occupants
+    if (!d->archiveDirectory.isEmpty()) {
+        const auto path = QDir(d->archiveDirectory).filePath(QString::fromLatin1(QUrl::toPercentEncoding(roomJid)));
+        room.archive = std::make_unique<ArchiveLog>(path, d->segmentSize);
+        if (!room.archive->open()) {
+            d->warning(QStringLiteral("Could not open the room archive %1").arg(path));
+            room.archive.reset();
+        }
+    }
+    return room;
+}
+
+void MucShard::join(Room &room, const QString &jid, const QString &nick, const QDomElement &presence, bool created)
+{
+    const int index = room.nicks.size();
+    room.nicks << nick;
+    room.occupantJids << jid;
+    room.presences << storePresence(presence);
+    room.indexByJid.insert(jid, index);
+    room.indexByNick.insert(nick, index);
+    m_roomsByOccupant[jid] << room.jid;
+
+    // the presences of the other occupants
+    for (int i = 0; i < index; ++i) {
+        auto existing = occupantPresence(room, i);
+        existing.setTo(jid);
+        d->server->sendPacket(existing);
+    }
+
+    auto joined = occupantPresence(room, index);
+    if (created) {
+        joined.statusCodes << 201;
+    }
+    broadcastPresence(room, index, joined);
+
+    sendHistory(room, jid, presence);
+
+    SubjectMessage subject;
+    subject.setFrom(room.subjectFrom.isEmpty() ? room.jid : room.subjectFrom);
+    subject.setTo(jid);
+    subject.subject = room.subject;
+    d->server->sendPacket(subject);
+}
+
+void MucShard::leave(Room &room, int index)
+{
+    if (index < 0) {
+        return;
+    }
+
+    auto left = occupantPresence(room, index);
+    left.available = false;
+    left.children.clear();
+    broadcastPresence(room, index, left);
+
+    const auto jid = room.occupantJids[index];
+    const auto last = room.nicks.size() - 1;
+    room.indexByJid.remove(jid);
+    room.indexByNick.remove(room.nicks[index]);
+    if (index != last) {
+        room.nicks[index] = room.nicks[last];
+        room.occupantJids[index] = room.occupantJids[last];
+        room.presences[index] = room.presences[last];
+        room.indexByJid[room.occupantJids[index]] = index;
+        room.indexByNick[room.nicks[index]] = index;
+    }
+    room.nicks.removeLast();
+    room.occupantJids.removeLast();
+    room.presences.removeLast();
+
+    auto rooms = m_roomsByOccupant.find(jid);
+    if (rooms != m_roomsByOccupant.end()) {
+        rooms->removeOne(room.jid);
+        if (rooms->isEmpty()) {
+            m_roomsByOccupant.erase(rooms);
+        }
+    }
+
+    // empty rooms are destroyed
+    if (room.nicks.isEmpty()) {
+        if (room.archive) {
+            m_pendingLogs.remove(room.archive.get());
+            room.archive->commit();
+        }
+        const auto roomJid = room.jid;
+        m_rooms.erase(roomJid);
+        QXmppMetrics::addToGauge(QXmppMetrics::MucRooms, -1);
+    }
+}
+
+void MucShard::changeNick(Room &room, int index, const QString &nick, const QDomElement &presence)
+{
+    if (room.indexByNick.contains(nick)) {
+        return sendError(presence, QXmppStanza::Error::Cancel, QXmppStanza::Error::Conflict);
+    }
+
+    auto left = occupantPresence(room, index);
+    left.available = false;
+    left.children.clear();
+    left.newNick = nick;
+    left.statusCodes << 303;
+    broadcastPresence(room, index, left);
+
+    room.indexByNick.remove(room.nicks[index]);
+    room.indexByNick.insert(nick, index);
+    room.nicks[index] = nick;
+    room.presences[index] = storePresence(presence);
+
+    auto joined = occupantPresence(room, index);
+    broadcastPresence(room, index, joined);
+}
+
+// Sends the last messages of the room to a new occupant, as limited by the
+// history element of the join presence.
+void MucShard::sendHistory(Room &room, const QString &jid, const QDomElement &presence)
+{
+    if (!room.archive || room.archive->lastId() == 0) {
+        return;
+    }
+
+    ArchiveLog::Query query;
+    query.before = room.archive->lastId() + 1;
+    query.max = d->historySize;
+
+    auto x = presence.firstChildElement(QStringLiteral("x"));
+    while (!x.isNull() && x.namespaceURI() != ns_muc) {
+        x = x.nextSiblingElement(QStringLiteral("x"));
+    }
+    const auto history = x.firstChildElement(QStringLiteral("history"));
+    if (!history.isNull()) {
+        bool ok = false;
+        if (const auto max = history.attribute(QStringLiteral("maxstanzas")).toInt(&ok); ok) {
+            query.max = std::min(query.max, max);
+        }
+        if (history.attribute(QStringLiteral("maxchars")) == QLatin1String("0")) {
+            query.max = 0;
+        }
+        if (const auto seconds = history.attribute(QStringLiteral("seconds")).toLongLong(&ok); ok) {
+            query.start = QDateTime::currentMSecsSinceEpoch() - seconds * 1000;
+        }
+        if (const auto since = QXmppUtils::datetimeFromString(history.attribute(QStringLiteral("since"))); since.isValid()) {
+            query.start = std::max(query.start, since.toMSecsSinceEpoch());
+        }
+    }
+    if (query.max <= 0) {
+        return;
+    }
+
+    HistoryMessage message;
+    message.setTo(jid);
+    message.roomJid = room.jid;
+    const auto page = room.archive->query(query);
+    for (const auto &record : page.records) {
+        message.record = record;
+        d->server->sendPacket(message);
+    }
+}
+
+void MucShard::archive(Room &room, OccupantMessage &message)
+{
+    if (!room.archive || message.message.firstChildElement(QStringLiteral("body")).isNull()) {
+        return;
+    }
+
+    QByteArray payload;
+    QXmlStreamWriter writer(&payload);
+    message.withNamespace = true;
+    message.toXml(&writer);
+    message.withNamespace = false;
+
+    if (!room.archive->append(QDateTime::currentMSecsSinceEpoch(), message.from(), payload)) {
+        d->warning(QStringLiteral("Could not archive a message of %1").arg(room.jid));
+        return;
+    }
+    m_pendingLogs.insert(room.archive.get());
+    if (!m_commitTimer.isActive()) {
+        m_commitTimer.start();
+    }
+}
+
+void MucShard::commit()
+{
+    for (auto *archive : std::as_const(m_pendingLogs)) {
+        if (!archive->commit()) {
+            d->warning(QStringLiteral("Could not write to a room archive, messages have been lost"));
+        }
+    }
+    m_pendingLogs.clear();
+    m_commitTimer.stop();
+}
+
+OccupantPresence MucShard::occupantPresence(const Room &room, int index) const
+{
+    OccupantPresence presence;
+    presence.setFrom(room.jid + QLatin1Char('/') + room.nicks[index]);
+    presence.children = room.presences[index];
+    if (QXmppUtils::jidToBareJid(room.occupantJids[index]) == room.owner) {
+        presence.affiliation = QXmppMucItem::OwnerAffiliation;
+        presence.role = QXmppMucItem::ModeratorRole;
+    }
+    return presence;
+}
+
+// Sends the presence of an occupant to the others and, with the status code
+// for self-presences, to the occupant.
+void MucShard::broadcastPresence(const Room &room, int index, OccupantPresence &presence)
+{
+    if (room.nicks.size() > 1) {
+        auto recipients = room.occupantJids;
+        recipients.removeAt(index);
+        d->server->broadcastPacket(presence, recipients);
+    }
+    presence.statusCodes.prepend(110);
+    presence.setTo(room.occupantJids[index]);
+    d->server->sendPacket(presence);
+}
+
+// Errors are sent from the room or occupant address the stanza was sent to.
+void MucShard::sendError(const QDomElement &stanza, QXmppStanza::Error::Type type, QXmppStanza::Error::Condition condition)
+{
+    const QXmppStanza::Error error(type, condition);
+    const auto id = stanza.attribute(QStringLiteral("id"));
+    const auto from = stanza.attribute(QStringLiteral("to"));
+    const auto to = stanza.attribute(QStringLiteral("from"));
+
+    if (stanza.tagName() == QLatin1String("presence")) {
+        QXmppPresence response(QXmppPresence::Error);
+        response.setId(id);
+        response.setFrom(from);
+        response.setTo(to);
+        response.setError(error);
+        // the failed join is identified by the MUC element
+        response.setMucSupported(true);
+        d->server->sendPacket(response);
+    } else if (stanza.tagName() == QLatin1String("message")) {
+        QXmppMessage response;
+        response.setType(QXmppMessage::Error);
+        response.setId(id);
+        response.setFrom(from);
+        response.setTo(to);
+        response.setError(error);
+        d->server->sendPacket(response);
+    } else {
+        QXmppIq response(QXmppIq::Error);
+        response.setId(id);
+        response.setFrom(from);
+        response.setTo(to);
+        response.setError(error);
+        d->server->sendPacket(response);
+    }
+}
+
+QXmppMucExtensionPrivate::QXmppMucExtensionPrivate(QXmppMucExtension *qq)
+    : q(qq)
+{
+}
+
+MucShard *QXmppMucExtensionPrivate::shardFor(const QString &roomJid) const
+{
+    return shards[qHash(roomJid) % shards.size()].get();
+}
+
+// Passes a stanza to the shard of its room. Shards in other threads get a
+// copy, which doesn't share any nodes with the document of the stream.
+void QXmppMucExtensionPrivate::dispatch(const QDomElement &element, const QString &roomJid)
+{
+    auto *shard = shardFor(roomJid);
+    if (threads.empty()) {
+        shard->handleStanza(element);
+        return;
+    }
+
+    QDomDocument document;
+    document.appendChild(document.importNode(element, true));
+    QMetaObject::invokeMethod(shard, [shard, document] {
+        shard->handleStanza(document.documentElement());
+    });
+}
+
+// Answers the stanzas addressed to the service itself.
+void QXmppMucExtensionPrivate::handleServiceStanza(const QDomElement &element)
+{
+    if (element.tagName() != QLatin1String("iq")) {
+        return;
+    }
+    QXmppDiscoveryIq request;
+    if (QXmppDiscoveryIq::isDiscoveryIq(element)) {
+        request.parse(element);
+    } else {
+        request.QXmppIq::parse(element);
+    }
+    if (request.type() != QXmppIq::Get && request.type() != QXmppIq::Set) {
+        return;
+    }
+
+    if (!QXmppDiscoveryIq::isDiscoveryIq(element) || request.type() != QXmppIq::Get ||
+        request.queryType() != QXmppDiscoveryIq::InfoQuery || !request.queryNode().isEmpty()) {
+        QXmppIq response(QXmppIq::Error);
+        response.setId(request.id());
+        response.setFrom(jid);
+        response.setTo(request.from());
+        response.setError(QXmppStanza::Error(QXmppStanza::Error::Cancel, QXmppStanza::Error::FeatureNotImplemented));
+        server->sendPacket(response);
+        return;
+    }
+
+    QXmppDiscoveryIq::Identity identity;
+    identity.setCategory(QStringLiteral("conference"));
+    identity.setType(QStringLiteral("text"));
+    identity.setName(QStringLiteral("Chatrooms"));
+
+    QXmppDiscoveryIq response;
+    response.setType(QXmppIq::Result);
+    response.setId(request.id());
+    response.setFrom(jid);
+    response.setTo(request.from());
+    response.setQueryType(QXmppDiscoveryIq::InfoQuery);
+    response.setIdentities({ identity });
+    response.setFeatures({ ns_disco_info, ns_muc });
+    server->sendPacket(response);
+}
+
+void QXmppMucExtensionPrivate::warning(const QString &message)
+{
+    q->warning(message);
+}
+
+///
+/// \class QXmppMucExtension
+///
+/// \brief The QXmppMucExtension class provides a \xep{0045, Multi-User Chat}
+/// service for QXmppServer.
+///
+/// Rooms are created when the first user joins them and destroyed when the
+/// last occupant leaves. The user creating a room becomes its owner. The rooms
+/// are open and the real JIDs of the occupants are not disclosed. Occupants can
+/// send messages to the room, change the subject, send private messages to
+/// other occupants and change their nickname.
+///
+/// The rooms are distributed over shards by the hash of their JID. With
+/// setShardCount(), each shard runs in its own thread and owns its rooms, so
+/// busy rooms are handled in parallel without locking. The occupants of a room
+/// are kept in arrays, their real JIDs are used as the list of recipients
+/// directly, and each message is serialized once for all occupants with
+/// QXmppServer::broadcastPacket().
+///
+/// If an archive directory is set, the messages of each room are archived in
+/// append-only segment files like the ones of QXmppMamExtension, and new
+/// occupants receive the last messages as the history of the room.
+///
+/// \since QXmpp 1.6
+///
+/// \ingroup Core
+///
+
+///
+/// Constructs a multi-user chat extension.
+///
+QXmppMucExtension::QXmppMucExtension()
+    : d(std::make_unique<QXmppMucExtensionPrivate>(this))
+{
+}
+
+QXmppMucExtension::~QXmppMucExtension()
+{
+    stop();
+}
+
+///
+/// Returns the JID of the service, e.g. "conference.example.com".
+///
+QString QXmppMucExtension::jid() const
+{
+    return d->jid;
+}
+
+///
+/// Sets the JID of the service.
+///
+/// The stanzas of the service are selected by this domain when it is set
+/// before the extension is added to the server. Otherwise the extension
+/// checks every stanza. The default is "conference." followed by the domain
+/// of the server.
+///
+void QXmppMucExtension::setJid(const QString &jid)
+{
+    d->jid = jid;
+}
+
+///
+/// Returns the number of threads the rooms are distributed over.
+///
+int QXmppMucExtension::shardCount() const
+{
+    return d->shardCount;
+}
+
+///
+/// Sets the number of threads the rooms are distributed over.
+///
+/// By default, the count is 0 and all rooms are handled by the thread of the
+/// server. This needs to be set before the server is started.
+///
+void QXmppMucExtension::setShardCount(int shards)
+{
+    d->shardCount = std::max(shards, 0);
+}
+
+///
+/// Returns the directory containing the archives of the rooms.
+///
+QString QXmppMucExtension::archiveDirectory() const
+{
+    return d->archiveDirectory;
+}
+
+///
+/// Sets the directory containing the archives of the rooms.
+///
+/// Each room gets a subdirectory with its percent-encoded JID as the name.
+/// Without a directory, messages are not archived and no history is sent.
+/// This needs to be set before the server is started.
+///
+void QXmppMucExtension::setArchiveDirectory(const QString &path)
+{
+    d->archiveDirectory = path;
+}
+
+///
+/// Returns the maximum number of messages sent as the history of a room.
+///
+int QXmppMucExtension::historySize() const
+{
+    return d->historySize;
+}
+
+///
+/// Sets the maximum number of messages sent as the history of a room.
+///
+/// Occupants can request fewer messages when joining. The default is 20.
+///
+void QXmppMucExtension::setHistorySize(int messages)
+{
+    d->historySize = std::max(messages, 0);
+}
+
+/// \cond
+QStringList QXmppMucExtension::discoveryItems() const
+{
+    return { d->jid };
+}
+
+QVector<QXmppServerExtension::StanzaFilter> QXmppMucExtension::stanzaFilters() const
+{
+    if (d->jid.isEmpty()) {
+        return {};
+    }
+    return { { {}, {}, d->jid } };
+}
+
+bool QXmppMucExtension::handleStanza(const QDomElement &element)
+{
+    if (d->shards.empty() || QXmppUtils::jidToDomain(element.attribute(QStringLiteral("to"))) != d->jid) {
+        return false;
+    }
+
+    const auto roomJid = QXmppUtils::jidToBareJid(element.attribute(QStringLiteral("to")));
+    if (roomJid == d->jid) {
+        d->handleServiceStanza(element);
+    } else {
+        d->dispatch(element, roomJid);
+    }
+    return true;
+}
+
+bool QXmppMucExtension::start()
+{
+    if (!d->shards.empty()) {
+        return true;
+    }
+
+    d->server = server();
+    if (d->jid.isEmpty()) {
+        d->jid = QStringLiteral("conference.") + server()->domain();
+    }
+
+    const int count = std::max(d->shardCount, 1);
+    for (int i = 0; i < count; ++i) {
+        auto shard = std::make_unique<MucShard>(d.get());
+        if (d->shardCount > 0) {
+            auto thread = std::make_unique<QThread>();
+            thread->setObjectName(QStringLiteral("QXmppMucShard%1").arg(i));
+            shard->moveToThread(thread.get());
+            thread->start();
+            d->threads.push_back(std::move(thread));
+        }
+        d->shards.push_back(std::move(shard));
+    }
+
+    // users disconnecting without leaving their rooms
+    connect(server(), &QXmppServer::clientDisconnected, this, [this](const QString &jid) {
+        for (const auto &shard : d->shards) {
+            auto *target = shard.get();
+            if (d->threads.empty()) {
+                target->removeOccupant(jid);
+            } else {
+                QMetaObject::invokeMethod(target, [target, jid] { target->removeOccupant(jid); });
+            }
+        }
+    });
+    return true;
+}
+
+void QXmppMucExtension::stop()
+{
+    if (d->shards.empty()) {
+        return;
+    }
+    disconnect(d->server, &QXmppServer::clientDisconnected, this, nullptr);
+
+    for (const auto &shard : d->shards) {
+        auto *target = shard.get();
+        if (d->threads.empty()) {
+            target->close();
+        } else {
+            QMetaObject::invokeMethod(target, [target] { target->close(); }, Qt::BlockingQueuedConnection);
+        }
+    }
+    for (const auto &thread : d->threads) {
+        thread->quit();
+        thread->wait();
+    }
+    d->shards.clear();
+    d->threads.clear();
+}
+/// \endcond
@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPMUCEXTENSION_H
+#define QXMPPMUCEXTENSION_H
+
+#include "QXmppServerExtension.h"
+
+#include <memory>
+
+class QXmppMucExtensionPrivate;
+
+class QXMPP_EXPORT QXmppMucExtension : public QXmppServerExtension
+{
+    Q_OBJECT
+    Q_CLASSINFO("ExtensionName", "muc")
+
+public:
+    QXmppMucExtension();
+    ~QXmppMucExtension() override;
+
+    QString jid() const;
+    void setJid(const QString &jid);
+
+    int shardCount() const;
+    void setShardCount(int shards);
+
+    QString archiveDirectory() const;
+    void setArchiveDirectory(const QString &path);
+
+    int historySize() const;
+    void setHistorySize(int messages);
+
+    /// \cond
+    QStringList discoveryItems() const override;
+    QVector<StanzaFilter> stanzaFilters() const override;
+    bool handleStanza(const QDomElement &stanza) override;
+    bool start() override;
+    void stop() override;
+    /// \endcond
+
+private:
+    const std::unique_ptr<QXmppMucExtensionPrivate> d;
+
+    friend class QXmppMucExtensionPrivate;
+};
+
+#endif  // QXMPPMUCEXTENSION_H
@@ -0,0 +1,61 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppOfflineMessageMemoryStorage.h"
+
+#include "QXmppFutureUtils_p.h"
+
+#include <QHash>
+
+using namespace QXmpp::Private;
+
+///
+/// \class QXmppOfflineMessageMemoryStorage
+///
+/// \brief The QXmppOfflineMessageMemoryStorage class stores messages for
+/// offline users in the memory.
+///
+/// The messages are lost when the storage is destroyed.
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+
+class QXmppOfflineMessageMemoryStoragePrivate
+{
+public:
+    QHash<QString, QVector<QByteArray>> messages;
+};
+
+///
+/// Constructs an offline message memory storage.
+///
+QXmppOfflineMessageMemoryStorage::QXmppOfflineMessageMemoryStorage()
+    : d(new QXmppOfflineMessageMemoryStoragePrivate)
+{
+}
+
+QXmppOfflineMessageMemoryStorage::~QXmppOfflineMessageMemoryStorage() = default;
+
+/// \cond
+QXmppTask<int> QXmppOfflineMessageMemoryStorage::addMessages(const QVector<Message> &messages, int maximumPerUser)
+{
+    int dropped = 0;
+    for (const auto &message : messages) {
+        auto &stored = d->messages[message.bareJid];
+        if (maximumPerUser > 0 && stored.size() >= maximumPerUser) {
+            dropped++;
+        } else {
+            stored.append(message.data);
+        }
+    }
+    return makeReadyTask(std::move(dropped));
+}
+
+QXmppTask<QVector<QByteArray>> QXmppOfflineMessageMemoryStorage::takeMessages(const QString &bareJid)
+{
+    return makeReadyTask(d->messages.take(bareJid));
+}
+/// \endcond
@@ -0,0 +1,29 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPOFFLINEMESSAGEMEMORYSTORAGE_H
+#define QXMPPOFFLINEMESSAGEMEMORYSTORAGE_H
+
+#include "QXmppOfflineMessageStorage.h"
+
+#include <memory>
+
+class QXmppOfflineMessageMemoryStoragePrivate;
+
+class QXMPP_EXPORT QXmppOfflineMessageMemoryStorage : public QXmppOfflineMessageStorage
+{
+public:
+    QXmppOfflineMessageMemoryStorage();
+    ~QXmppOfflineMessageMemoryStorage() override;
+
+    /// \cond
+    QXmppTask<int> addMessages(const QVector<Message> &messages, int maximumPerUser) override;
+    QXmppTask<QVector<QByteArray>> takeMessages(const QString &bareJid) override;
+    /// \endcond
+
+private:
+    const std::unique_ptr<QXmppOfflineMessageMemoryStoragePrivate> d;
+};
+
+#endif  // QXMPPOFFLINEMESSAGEMEMORYSTORAGE_H
@@ -0,0 +1,48 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+///
+/// \class QXmppOfflineMessageStorage
+///
+/// \brief The QXmppOfflineMessageStorage class stores messages for users of a
+/// QXmppServer that are not online.
+///
+/// QXmppServer collects the messages for offline users and adds them to the
+/// storage in batches, so a database implementation can write each batch in
+/// one transaction. When a user comes online, the stored messages are taken at
+/// once and sent in a single write. Implement this interface to keep the
+/// messages in a database and pass it to
+/// QXmppServer::setOfflineMessageStorage().
+///
+/// The operations must be applied in the order they are called: messages
+/// added before a takeMessages() call need to be part of its result.
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+
+///
+/// \fn QXmppOfflineMessageStorage::addMessages(const QVector<Message> &messages, int maximumPerUser)
+///
+/// Stores a batch of messages.
+///
+/// Messages for a user who already has \a maximumPerUser messages stored
+/// must be dropped. A limit of 0 means that there is no limit.
+///
+/// \param messages messages in the order they have been received
+/// \param maximumPerUser maximum number of stored messages per user
+///
+/// \return the number of messages that have been dropped
+///
+
+///
+/// \fn QXmppOfflineMessageStorage::takeMessages(const QString &bareJid)
+///
+/// Returns the stored messages of a user and removes them from the storage.
+///
+/// \param bareJid bare JID of the user
+///
+/// \return the messages in the order they have been added
+///
@@ -0,0 +1,37 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPOFFLINEMESSAGESTORAGE_H
+#define QXMPPOFFLINEMESSAGESTORAGE_H
+
+#include "QXmppGlobal.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+template<typename T>
+class QXmppTask;
+
+class QXMPP_EXPORT QXmppOfflineMessageStorage
+{
+public:
+    ///
+    /// Message waiting for its recipient to come online
+    ///
+    struct Message
+    {
+        /// bare JID of the recipient
+        QString bareJid;
+        /// serialized message stanza
+        QByteArray data;
+    };
+
+    virtual ~QXmppOfflineMessageStorage() = default;
+
+    virtual QXmppTask<int> addMessages(const QVector<Message> &messages, int maximumPerUser) = 0;
+    virtual QXmppTask<QVector<QByteArray>> takeMessages(const QString &bareJid) = 0;
+};
+
+#endif  // QXMPPOFFLINEMESSAGESTORAGE_H
@@ -6,32 +6,161 @@
 
 #include "QXmppConstants_p.h"
 #include "QXmppDialback.h"
+#include "QXmppDnsCache_p.h"
+#include "QXmppHappyEyeballs_p.h"
+#include "QXmppMetrics.h"
 #include "QXmppStartTlsPacket.h"
 #include "QXmppStreamFeatures.h"
 #include "QXmppUtils.h"
 
-#include <QDnsLookup>
+#include <algorithm>
+#include <deque>
+
 #include <QDomElement>
+#include <QElapsedTimer>
 #include <QList>
+#include <QNetworkProxy>
 #include <QSslError>
 #include <QSslKey>
 #include <QSslSocket>
 #include <QTimer>
+#include <QVector>
+
+using namespace QXmpp::Private;
+
+// Stanzas queued until the stream is ready are dropped in this order when the
+// queue is full.
+enum class QueuePriority {
+    Presence,
+    Normal,
+    IqResponse,
+};
+
+static QueuePriority queuePriority(const QByteArray &data)
+{
+    // only the start tag is looked at
+    const auto end = data.indexOf('>');
+    const auto startTag = QByteArray::fromRawData(data.constData(), end < 0 ? data.size() : end);
+    if (startTag.startsWith("<presence")) {
+        return QueuePriority::Presence;
+    }
+    if (startTag.startsWith("<iq") &&
+        (startTag.contains("type=\"result\"") || startTag.contains("type='result'") ||
+         startTag.contains("type=\"error\"") || startTag.contains("type='error'"))) {
+        return QueuePriority::IqResponse;
+    }
+    return QueuePriority::Normal;
+}
+
+struct QueuedData
+{
+    QByteArray data;
+    // milliseconds of the queue clock
+    qint64 queuedAt;
+    QueuePriority priority;
+};
 
 class QXmppOutgoingServerPrivate
 {
 public:
-    QList<QByteArray> dataQueue;
-    QDnsLookup dns;
+    void enqueue(QXmppOutgoingServer *q, const QByteArray &data);
+    void drop(QXmppOutgoingServer *q, std::deque<QueuedData>::iterator itr);
+    void dropExpired(QXmppOutgoingServer *q);
+    void scheduleExpiry();
+
+    // stanzas waiting for the dialback to succeed
+    std::deque<QueuedData> dataQueue;
+    qint64 queuedBytes = 0;
+    qint64 queueSize = 0;
+    int queueTimeout = 0;
+    QXmppOutgoingServer::QueueOverflowPolicy queueOverflowPolicy = QXmppOutgoingServer::DropOldest;
+    QElapsedTimer queueClock;
+    QTimer *queueTimer;
+
+    HappyEyeballs *hostConnector;
     QString localDomain;
     QString localStreamKey;
     QString remoteDomain;
-    QString verifyId;
-    QString verifyKey;
+    // pending dialback verify requests as (stream id, key)
+    QVector<QPair<QString, QString>> verifies;
     QTimer *dialbackTimer;
     bool ready;
+    bool dialbackSent = false;
 };
 
+void QXmppOutgoingServerPrivate::enqueue(QXmppOutgoingServer *q, const QByteArray &data)
+{
+    dropExpired(q);
+
+    const auto priority = queuePriority(data);
+    if (queueSize > 0 && queuedBytes + data.size() > queueSize) {
+        const auto fits = [&] { return queuedBytes + data.size() <= queueSize; };
+
+        // make room by dropping stanzas of lower priority first, oldest first
+        for (auto level = QueuePriority::Presence; level < priority && !fits(); level = QueuePriority(int(level) + 1)) {
+            for (auto itr = dataQueue.begin(); itr != dataQueue.end() && !fits();) {
+                if (itr->priority == level) {
+                    drop(q, itr);
+                    itr = dataQueue.erase(itr);
+                } else {
+                    ++itr;
+                }
+            }
+        }
+        if (queueOverflowPolicy == QXmppOutgoingServer::DropOldest) {
+            for (auto itr = dataQueue.begin(); itr != dataQueue.end() && !fits();) {
+                if (itr->priority <= priority) {
+                    drop(q, itr);
+                    itr = dataQueue.erase(itr);
+                } else {
+                    ++itr;
+                }
+            }
+        }
+        if (!fits()) {
+            QXmppMetrics::increment(QXmppMetrics::DroppedOutgoingServerStanzas);
+            Q_EMIT q->queuedDataDropped(data, queueOverflowPolicy == QXmppOutgoingServer::Bounce);
+            return;
+        }
+    }
+
+    dataQueue.push_back({ data, queueClock.elapsed(), priority });
+    queuedBytes += data.size();
+    scheduleExpiry();
+}
+
+// Reports a queued stanza as dropped, it is still to be removed from the queue.
+void QXmppOutgoingServerPrivate::drop(QXmppOutgoingServer *q, std::deque<QueuedData>::iterator itr)
+{
+    queuedBytes -= itr->data.size();
+    QXmppMetrics::increment(QXmppMetrics::DroppedOutgoingServerStanzas);
+    Q_EMIT q->queuedDataDropped(itr->data, queueOverflowPolicy == QXmppOutgoingServer::Bounce);
+}
+
+void QXmppOutgoingServerPrivate::dropExpired(QXmppOutgoingServer *q)
+{
+    if (queueTimeout <= 0 || dataQueue.empty()) {
+        return;
+    }
+    // the queue is in the order of the queueing times
+    const auto deadline = queueClock.elapsed() - queueTimeout;
+    while (!dataQueue.empty() && dataQueue.front().queuedAt <= deadline) {
+        drop(q, dataQueue.begin());
+        dataQueue.pop_front();
+    }
+    scheduleExpiry();
+}
+
+void QXmppOutgoingServerPrivate::scheduleExpiry()
+{
+    if (queueTimeout <= 0 || dataQueue.empty()) {
+        queueTimer->stop();
+        return;
+    }
+    const auto remaining = dataQueue.front().queuedAt + queueTimeout - queueClock.elapsed();
+    queueTimer->start(int(std::max(remaining, qint64(0))));
+}
+
 /// Constructs a new outgoing server-to-server stream.
 ///
 /// \param domain the local domain
@@ -49,14 +178,34 @@ QXmppOutgoingServer::QXmppOutgoingServer(const QString &domain, QObject *parent)
     connect(socket, &QAbstractSocket::disconnected, this, &QXmppOutgoingServer::_q_socketDisconnected);
     connect(socket, &QSslSocket::errorOccurred, this, &QXmppOutgoingServer::socketError);
 
-    // DNS lookups
-    connect(&d->dns, &QDnsLookup::finished, this, &QXmppOutgoingServer::_q_dnsLookupFinished);
+    // RFC 8305: Happy Eyeballs
+    d->hostConnector = new HappyEyeballs(this);
+    connect(d->hostConnector, &HappyEyeballs::connected, this, [this](const QHostAddress &address, quint16 port) {
+        if (!d->hostConnector->moveConnectionTo(socket())) {
+            // connect again to the address that has been reachable
+            socket()->connectToHost(address.toString(), port);
+            return;
+        }
+
+        // sockets that take over a connection don't emit connected() themselves,
+        // but the stream is started from it
+        Q_EMIT socket()->connected();
+    });
+    connect(d->hostConnector, &HappyEyeballs::failed, this, [this](const QString &errorString) {
+        warning(QStringLiteral("Could not connect to %1: %2").arg(d->remoteDomain, errorString));
+        Q_EMIT disconnected();
+    });
 
     d->dialbackTimer = new QTimer(this);
     d->dialbackTimer->setInterval(5000);
     d->dialbackTimer->setSingleShot(true);
     connect(d->dialbackTimer, &QTimer::timeout, this, &QXmppOutgoingServer::sendDialback);
 
+    d->queueClock.start();
+    d->queueTimer = new QTimer(this);
+    d->queueTimer->setSingleShot(true);
+    connect(d->queueTimer, &QTimer::timeout, this, [this] { d->dropExpired(this); });
+
     d->localDomain = domain;
     d->ready = false;
 
@@ -81,35 +230,39 @@ void QXmppOutgoingServer::connectToHost(const QString &domain)
 
     // lookup server for domain
     debug(QString("Looking up server for domain %1").arg(domain));
-    d->dns.setName("_xmpp-server._tcp." + domain);
-    d->dns.setType(QDnsLookup::SRV);
-    d->dns.lookup();
-}
+    const auto name = QStringLiteral("_xmpp-server._tcp.") + domain;
+    DnsCache::instance()->lookupService(name).then(this, [this, name](DnsCache::ServiceResult &&result) {
+        QVector<HappyEyeballs::Target> targets;
+
+        if (result.error == QDnsLookup::NoError &&
+            !result.records.isEmpty()) {
+            // race the connections to the first returned records
+            for (const auto &record : std::as_const(result.records)) {
+                if (targets.size() == HappyEyeballs::MaxTargets) {
+                    break;
+                }
+                targets.push_back({ record.target, record.port });
+            }
+        } else {
+            // as a fallback, use domain as the host name
+            warning(QString("Lookup for domain %1 failed: %2")
+                        .arg(name, result.errorString));
+            targets.push_back({ d->remoteDomain, 5269 });
+        }
 
-void QXmppOutgoingServer::_q_dnsLookupFinished()
-{
-    QString host;
-    quint16 port;
-
-    if (d->dns.error() == QDnsLookup::NoError &&
-        !d->dns.serviceRecords().isEmpty()) {
-        // take the first returned record
-        host = d->dns.serviceRecords().first().target();
-        port = d->dns.serviceRecords().first().port();
-    } else {
-        // as a fallback, use domain as the host name
-        warning(QString("Lookup for domain %1 failed: %2")
-                    .arg(d->dns.name(), d->dns.errorString()));
-        host = d->remoteDomain;
-        port = 5269;
-    }
+        // set the name the SSL certificate should match
+        socket()->setPeerVerifyName(d->remoteDomain);
 
-    // set the name the SSL certificate should match
-    socket()->setPeerVerifyName(d->remoteDomain);
+        // connections through a proxy can't be raced
+        if (!HappyEyeballs::canConnectDirectly(socket()->proxy())) {
+            const auto &target = targets.first();
+            info(QString("Connecting to %1:%2").arg(target.host, QString::number(target.port)));
+            socket()->connectToHost(target.host, target.port);
+            return;
+        }
 
-    // connect to server
-    info(QString("Connecting to %1:%2").arg(host, QString::number(port)));
-    socket()->connectToHost(host, port);
+        d->hostConnector->connectToHosts(targets);
+    });
 }
 
 void QXmppOutgoingServer::_q_socketDisconnected()
@@ -173,6 +326,7 @@ void QXmppOutgoingServer::handleStanza(const QDomElement &stanza)
         sendDialback();
     } else if (QXmppStartTlsPacket::isStartTlsPacket(stanza, QXmppStartTlsPacket::Proceed)) {
         debug("Starting encryption");
+        flushData();
         socket()->startClientEncryption();
         return;
     } else if (QXmppDialback::isDialback(stanza)) {
@@ -191,11 +345,19 @@ void QXmppOutgoingServer::handleStanza(const QDomElement &stanza)
                 info(QString("Outgoing server stream to %1 is ready").arg(response.from()));
                 d->ready = true;
 
-                // send queued data
-                for (const auto &data : std::as_const(d->dataQueue)) {
+                // send queued data in one write
+                d->dropExpired(this);
+                if (!d->dataQueue.empty()) {
+                    QByteArray data;
+                    data.reserve(d->queuedBytes);
+                    for (const auto &queued : d->dataQueue) {
+                        data += queued.data;
+                    }
+                    d->dataQueue.clear();
+                    d->queuedBytes = 0;
+                    d->queueTimer->stop();
                     sendData(data);
                 }
-                d->dataQueue.clear();
 
                 // emit signal
                 Q_EMIT connected();
@@ -238,8 +400,25 @@ void QXmppOutgoingServer::setLocalStreamKey(const QString &key)
 
 void QXmppOutgoingServer::setVerify(const QString &id, const QString &key)
 {
-    d->verifyId = id;
-    d->verifyKey = key;
+    d->verifies = { { id, key } };
+}
+
+///
+/// Adds a dialback verify request for the given stream ID and key.
+///
+/// Requests added after the stream has been negotiated are sent right away,
+/// so the verifications of several incoming streams can be pipelined over
+/// one connection to the authoritative server. The responses are reported
+/// using dialbackResponseReceived() and can be told apart by their ID.
+///
+/// \since QXmpp 1.6
+///
+void QXmppOutgoingServer::addVerify(const QString &id, const QString &key)
+{
+    d->verifies.append({ id, key });
+    if (d->dialbackSent && QXmppStream::isConnected()) {
+        sendDialback();
+    }
 }
 
 /// Sends or queues data until connected.
@@ -251,10 +430,87 @@ void QXmppOutgoingServer::queueData(const QByteArray &data)
     if (isConnected()) {
         sendData(data);
     } else {
-        d->dataQueue.append(data);
+        d->enqueue(this, data);
     }
 }
 
+///
+/// Returns the maximum number of bytes queued until the stream is ready.
+///
+/// \since QXmpp 1.6
+///
+qint64 QXmppOutgoingServer::queueSize() const
+{
+    return d->queueSize;
+}
+
+///
+/// Returns the maximum time in milliseconds stanzas are queued until the
+/// stream is ready.
+///
+/// \since QXmpp 1.6
+///
+int QXmppOutgoingServer::queueTimeout() const
+{
+    return d->queueTimeout;
+}
+
+///
+/// Sets the limits of the queue of stanzas waiting for the dialback to
+/// succeed.
+///
+/// Stanzas that don't fit into the queue are handled according to
+/// queueOverflowPolicy(). Presences are dropped before other stanzas, IQ
+/// responses are only dropped if there is nothing else to drop. Stanzas that
+/// have been queued for longer than the timeout are dropped as well.
+/// Dropped stanzas are reported using queuedDataDropped().
+///
+/// The default values are 0, which means no limit.
+///
+/// \param bytes maximum number of queued bytes
+/// \param msecs maximum time in milliseconds a stanza is queued
+///
+/// \since QXmpp 1.6
+///
+void QXmppOutgoingServer::setQueueLimit(qint64 bytes, int msecs)
+{
+    d->queueSize = std::max(bytes, qint64(0));
+    d->queueTimeout = std::max(msecs, 0);
+    d->dropExpired(this);
+}
+
+///
+/// Returns what happens to stanzas that don't fit into the queue.
+///
+/// \since QXmpp 1.6
+///
+QXmppOutgoingServer::QueueOverflowPolicy QXmppOutgoingServer::queueOverflowPolicy() const
+{
+    return d->queueOverflowPolicy;
+}
+
+///
+/// Sets what happens to stanzas that don't fit into the queue.
+///
+/// The default is DropOldest.
+///
+/// \since QXmpp 1.6
+///
+void QXmppOutgoingServer::setQueueOverflowPolicy(QueueOverflowPolicy policy)
+{
+    d->queueOverflowPolicy = policy;
+}
+
+///
+/// Returns the number of bytes queued until the stream is ready.
+///
+/// \since QXmpp 1.6
+///
+qint64 QXmppOutgoingServer::queuedBytes() const
+{
+    return d->queuedBytes;
+}
+
 /// Returns the remote server's domain.
 
 QString QXmppOutgoingServer::remoteDomain() const
@@ -264,6 +520,7 @@ QString QXmppOutgoingServer::remoteDomain() const
 
 void QXmppOutgoingServer::sendDialback()
 {
+    d->dialbackSent = true;
     if (!d->localStreamKey.isEmpty()) {
         // send dialback key
         debug(QString("Sending dialback result to %1").arg(d->remoteDomain));
@@ -273,16 +530,22 @@ void QXmppOutgoingServer::sendDialback()
         dialback.setTo(d->remoteDomain);
         dialback.setKey(d->localStreamKey);
         sendPacket(dialback);
-    } else if (!d->verifyId.isEmpty() && !d->verifyKey.isEmpty()) {
-        // send dialback verify
-        debug(QString("Sending dialback verify to %1").arg(d->remoteDomain));
-        QXmppDialback verify;
-        verify.setCommand(QXmppDialback::Verify);
-        verify.setId(d->verifyId);
-        verify.setFrom(d->localDomain);
-        verify.setTo(d->remoteDomain);
-        verify.setKey(d->verifyKey);
-        sendPacket(verify);
+    } else {
+        // send dialback verifies, later ones are sent as they are added
+        for (const auto &[id, key] : std::as_const(d->verifies)) {
+            if (id.isEmpty() || key.isEmpty()) {
+                continue;
+            }
+            debug(QString("Sending dialback verify to %1").arg(d->remoteDomain));
+            QXmppDialback verify;
+            verify.setCommand(QXmppDialback::Verify);
+            verify.setId(id);
+            verify.setFrom(d->localDomain);
+            verify.setTo(d->remoteDomain);
+            verify.setKey(key);
+            sendPacket(verify);
+        }
+        d->verifies.clear();
     }
 }
 
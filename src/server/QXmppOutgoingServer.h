@@ -23,6 +23,16 @@ class QXMPP_EXPORT QXmppOutgoingServer : public QXmppStream
     Q_OBJECT
 
 public:
+    /// What happens to stanzas that don't fit into the queue of a stream
+    /// that is not ready yet.
+    ///
+    /// \since QXmpp 1.6
+    enum QueueOverflowPolicy {
+        DropOldest,  ///< The oldest queued stanzas are dropped to make room.
+        Bounce,      ///< The new stanza is dropped and bounced with an error.
+    };
+    Q_ENUM(QueueOverflowPolicy)
+
     QXmppOutgoingServer(const QString &domain, QObject *parent);
     ~QXmppOutgoingServer() override;
 
@@ -31,13 +41,30 @@ public:
     QString localStreamKey() const;
     void setLocalStreamKey(const QString &key);
     void setVerify(const QString &id, const QString &key);
+    void addVerify(const QString &id, const QString &key);
 
     QString remoteDomain() const;
 
+    qint64 queueSize() const;
+    int queueTimeout() const;
+    void setQueueLimit(qint64 bytes, int msecs);
+    QueueOverflowPolicy queueOverflowPolicy() const;
+    void setQueueOverflowPolicy(QueueOverflowPolicy policy);
+    qint64 queuedBytes() const;
+
 Q_SIGNALS:
     /// This signal is emitted when a dialback verify response is received.
     void dialbackResponseReceived(const QXmppDialback &response);
 
+    /// This signal is emitted when queued data is dropped, because it doesn't
+    /// fit into the queue or has been queued for too long.
+    ///
+    /// \param data the serialized stanza
+    /// \param bounce whether the sender should get an error, see queueOverflowPolicy()
+    ///
+    /// \since QXmpp 1.6
+    void queuedDataDropped(const QByteArray &data, bool bounce);
+
 protected:
     /// \cond
     void handleStart() override;
@@ -50,7 +77,6 @@ public Q_SLOTS:
     void queueData(const QByteArray &data);
 
 private Q_SLOTS:
-    void _q_dnsLookupFinished();
     void _q_socketDisconnected();
     void sendDialback();
     void slotSslErrors(const QList<QSslError> &errors);
@@ -4,10 +4,102 @@
 
 #include "QXmppPasswordChecker.h"
 
+#include "QXmppAsync_p.h"
+#include "QXmppFutureUtils_p.h"
+#include "QXmppSasl_p.h"
+#include "QXmppUtils.h"
+
+#include <vector>
+
 #include <QCryptographicHash>
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QMutex>
 #include <QString>
+#include <QThread>
+#include <QThreadPool>
 #include <QTimer>
 
+using namespace QXmpp::Private;
+
+using PasswordResult = QXmppPasswordChecker::PasswordResult;
+using ScramResult = QXmppPasswordChecker::ScramResult;
+
+// maximum number of cached credentials
+constexpr int PASSWORD_CACHE_SIZE_MAX = 10000;
+// minimum iteration count recommended by RFC 7677
+constexpr int SCRAM_ITERATIONS = 4096;
+constexpr int SCRAM_SALT_SIZE = 16;
+
+class QXmppPasswordCheckerPrivate
+{
+public:
+    struct CacheEntry
+    {
+        PasswordResult result;
+        QDeadlineTimer expiry;
+    };
+
+    struct ScramCacheEntry
+    {
+        // password the keys have been derived from
+        QString password;
+        QXmppScramCredentials credentials;
+    };
+
+    void cache(const QString &key, const PasswordResult &result);
+    void cacheScramCredentials(const QString &key, const QString &password, const QXmppScramCredentials &credentials);
+
+    int maximumThreadCount = 0;
+    int cacheTimeout = 0;
+    int scramIterations = SCRAM_ITERATIONS;
+    QThreadPool threadPool;
+
+    // the checker is shared by the streams of all server threads
+    QMutex mutex;
+    QHash<QString, CacheEntry> cachedPasswords;
+    QHash<QString, ScramCacheEntry> cachedScramCredentials;
+    // requests waiting for a running lookup of the same user, per thread as
+    // tasks may only be used in the thread they have been created in
+    QHash<QThread *, QHash<QString, std::vector<QXmppPromise<PasswordResult>>>> pendingLookups;
+};
+
+// Called with the mutex locked.
+void QXmppPasswordCheckerPrivate::cache(const QString &key, const PasswordResult &result)
+{
+    // temporary errors should be retried on the next attempt
+    if (!cacheTimeout) {
+        return;
+    }
+    if (const auto *error = std::get_if<QXmppPasswordReply::Error>(&result); error && *error == QXmppPasswordReply::TemporaryError) {
+        return;
+    }
+
+    if (cachedPasswords.size() >= PASSWORD_CACHE_SIZE_MAX) {
+        for (auto itr = cachedPasswords.begin(); itr != cachedPasswords.end();) {
+            if (itr->expiry.hasExpired()) {
+                itr = cachedPasswords.erase(itr);
+            } else {
+                ++itr;
+            }
+        }
+        if (cachedPasswords.size() >= PASSWORD_CACHE_SIZE_MAX) {
+            return;
+        }
+    }
+
+    cachedPasswords.insert(key, { result, QDeadlineTimer(std::chrono::seconds(cacheTimeout)) });
+}
+
+// Called with the mutex locked.
+void QXmppPasswordCheckerPrivate::cacheScramCredentials(const QString &key, const QString &password, const QXmppScramCredentials &credentials)
+{
+    if (cachedScramCredentials.size() >= PASSWORD_CACHE_SIZE_MAX && !cachedScramCredentials.contains(key)) {
+        cachedScramCredentials.clear();
+    }
+    cachedScramCredentials.insert(key, { password, credentials });
+}
+
 /// Returns the requested domain.
 
 QString QXmppPasswordRequest::domain() const
@@ -135,9 +227,29 @@ void QXmppPasswordReply::setPassword(const QString &password)
     m_password = password;
 }
 
+/// Constructs a new password checker.
+///
+/// By default, getPassword() is called synchronously and results are not
+/// cached.
+
+QXmppPasswordChecker::QXmppPasswordChecker()
+    : d(std::make_unique<QXmppPasswordCheckerPrivate>())
+{
+}
+
+/// Destroys the password checker.
+///
+/// Lookups still running in worker threads are awaited.
+
+QXmppPasswordChecker::~QXmppPasswordChecker()
+{
+    d->threadPool.waitForDone();
+}
+
 /// Checks that the given credentials are valid.
 ///
-/// The base implementation requires that you reimplement getPassword().
+/// The base implementation requires that you reimplement getPassword() or
+/// requestPassword().
 ///
 /// \param request
 
@@ -145,18 +257,18 @@ QXmppPasswordReply *QXmppPasswordChecker::checkPassword(const QXmppPasswordReque
 {
     auto *reply = new QXmppPasswordReply;
 
-    QString secret;
-    QXmppPasswordReply::Error error = getPassword(request, secret);
-    if (error == QXmppPasswordReply::NoError) {
-        if (request.password() != secret) {
-            reply->setError(QXmppPasswordReply::AuthorizationError);
+    lookupPassword(request).then(reply, [reply, password = request.password()](PasswordResult &&result) {
+        if (const auto *secret = std::get_if<QString>(&result)) {
+            if (password != *secret) {
+                reply->setError(QXmppPasswordReply::AuthorizationError);
+            }
+        } else {
+            reply->setError(std::get<QXmppPasswordReply::Error>(result));
         }
-    } else {
-        reply->setError(error);
-    }
 
-    // reply is finished
-    reply->finishLater();
+        // reply is finished
+        reply->finishLater();
+    });
     return reply;
 }
 
@@ -171,18 +283,18 @@ QXmppPasswordReply *QXmppPasswordChecker::getDigest(const QXmppPasswordRequest &
 {
     auto *reply = new QXmppPasswordReply;
 
-    QString secret;
-    QXmppPasswordReply::Error error = getPassword(request, secret);
-    if (error == QXmppPasswordReply::NoError) {
-        reply->setDigest(QCryptographicHash::hash(
-            (request.username() + ":" + request.domain() + ":" + secret).toUtf8(),
-            QCryptographicHash::Md5));
-    } else {
-        reply->setError(error);
-    }
+    lookupPassword(request).then(reply, [reply, request](PasswordResult &&result) {
+        if (const auto *secret = std::get_if<QString>(&result)) {
+            reply->setDigest(QCryptographicHash::hash(
+                (request.username() + ":" + request.domain() + ":" + *secret).toUtf8(),
+                QCryptographicHash::Md5));
+        } else {
+            reply->setError(std::get<QXmppPasswordReply::Error>(result));
+        }
 
-    // reply is finished
-    reply->finishLater();
+        // reply is finished
+        reply->finishLater();
+    });
     return reply;
 }
 
@@ -207,3 +319,242 @@ bool QXmppPasswordChecker::hasGetPassword() const
 {
     return false;
 }
+
+/// Retrieves the password for the given username asynchronously.
+///
+/// The base implementation calls getPassword(), either directly or in a
+/// worker thread if maximumThreadCount() is greater than zero. Reimplement
+/// this method if your backend provides an asynchronous API. Reimplement
+/// hasGetPassword() as well to enable DIGEST-MD5.
+///
+/// This method is called in the thread of the requesting stream, which may be
+/// one of the worker threads of the server. The returned task must be
+/// finished in the same thread.
+///
+/// \param request
+///
+/// \since QXmpp 1.6
+
+QXmppTask<PasswordResult> QXmppPasswordChecker::requestPassword(const QXmppPasswordRequest &request)
+{
+    if (d->maximumThreadCount <= 0) {
+        QString password;
+        if (const auto error = getPassword(request, password); error != QXmppPasswordReply::NoError) {
+            return makeReadyTask<PasswordResult>(error);
+        }
+        return makeReadyTask<PasswordResult>(std::move(password));
+    }
+
+    // the result is received in the calling thread
+    return runAsync(&d->threadPool, [this, request]() {
+        QString password;
+        if (const auto error = getPassword(request, password); error != QXmppPasswordReply::NoError) {
+            return PasswordResult(error);
+        }
+        return PasswordResult(std::move(password));
+    });
+}
+
+/// Returns the maximum number of worker threads used to call getPassword().
+///
+/// \since QXmpp 1.6
+
+int QXmppPasswordChecker::maximumThreadCount() const
+{
+    return d->maximumThreadCount;
+}
+
+/// Sets the maximum number of worker threads used to call getPassword().
+///
+/// With a count of zero (the default), getPassword() is called directly in the
+/// thread of the server, blocking all other connections while it runs. With a
+/// positive count, your reimplementation of getPassword() needs to be
+/// thread-safe.
+///
+/// \param count
+///
+/// \since QXmpp 1.6
+
+void QXmppPasswordChecker::setMaximumThreadCount(int count)
+{
+    d->maximumThreadCount = std::max(count, 0);
+    if (d->maximumThreadCount) {
+        d->threadPool.setMaxThreadCount(d->maximumThreadCount);
+    }
+}
+
+/// Returns the time in seconds for which retrieved passwords are cached.
+///
+/// \since QXmpp 1.6
+
+int QXmppPasswordChecker::cacheTimeout() const
+{
+    return d->cacheTimeout;
+}
+
+/// Sets the time in seconds for which retrieved passwords are cached.
+///
+/// Both found passwords and unknown users are cached, temporary errors are
+/// not. Keys derived for SCRAM are kept independently of this setting, as
+/// long as the password they have been derived from does not change. Concurrent requests for the same user share one lookup, regardless of
+/// this setting. A timeout of zero (the default) disables the cache.
+///
+/// \param timeout
+///
+/// \since QXmpp 1.6
+
+void QXmppPasswordChecker::setCacheTimeout(int timeout)
+{
+    QMutexLocker locker(&d->mutex);
+    d->cacheTimeout = std::max(timeout, 0);
+    if (!d->cacheTimeout) {
+        d->cachedPasswords.clear();
+    }
+}
+
+/// Removes all cached passwords.
+///
+/// Call this after a password has been changed or a user has been created.
+///
+/// \since QXmpp 1.6
+
+void QXmppPasswordChecker::clearCache()
+{
+    QMutexLocker locker(&d->mutex);
+    d->cachedPasswords.clear();
+    d->cachedScramCredentials.clear();
+}
+
+/// Retrieves the SCRAM credentials for the given username.
+///
+/// The base implementation retrieves the password using requestPassword() and
+/// derives the keys in a worker thread. The keys are cached per user and are
+/// only derived again if the password changes. Reimplement this method if your
+/// backend stores SCRAM credentials instead of passwords.
+///
+/// SCRAM mechanisms are offered if hasGetPassword() returns true.
+///
+/// \param request
+/// \param algorithm The hash algorithm of the SCRAM mechanism.
+///
+/// \since QXmpp 1.6
+
+QXmppTask<ScramResult> QXmppPasswordChecker::scramCredentials(const QXmppPasswordRequest &request, QCryptographicHash::Algorithm algorithm)
+{
+    const auto key = request.username() + QLatin1Char('@') + request.domain() + QLatin1Char(' ') + QString::number(int(algorithm));
+
+    QXmppPromise<ScramResult> promise;
+    auto task = promise.task();
+
+    // lives in the calling thread until the keys are available
+    auto *context = new QObject;
+    lookupPassword(request).then(context, [this, promise, context, key, algorithm](PasswordResult &&result) mutable {
+        if (const auto *error = std::get_if<QXmppPasswordReply::Error>(&result)) {
+            promise.finish(ScramResult(*error));
+            context->deleteLater();
+            return;
+        }
+
+        const auto password = std::get<QString>(std::move(result));
+        int iterations;
+        {
+            QMutexLocker locker(&d->mutex);
+            iterations = d->scramIterations;
+            if (const auto itr = d->cachedScramCredentials.constFind(key);
+                itr != d->cachedScramCredentials.constEnd() && itr->password == password && itr->credentials.iterations == iterations) {
+                promise.finish(ScramResult(itr->credentials));
+                context->deleteLater();
+                return;
+            }
+        }
+
+        // PBKDF2 is slow on purpose, keep it away from the network thread
+        QXmppScramCredentials credentials;
+        credentials.salt = QXmppUtils::generateRandomBytes(SCRAM_SALT_SIZE);
+        credentials.iterations = iterations;
+        runAsync(&d->threadPool, [credentials, algorithm, password]() mutable {
+            QXmppSaslServerScram::deriveKeys(algorithm, password, credentials.salt, credentials.iterations, credentials.storedKey, credentials.serverKey);
+            return credentials;
+        }).then(context, [this, promise, context, key, password](QXmppScramCredentials &&credentials) mutable {
+            {
+                QMutexLocker locker(&d->mutex);
+                d->cacheScramCredentials(key, password, credentials);
+            }
+            promise.finish(ScramResult(std::move(credentials)));
+            context->deleteLater();
+        });
+    });
+    return task;
+}
+
+/// Returns the number of PBKDF2 iterations used to derive SCRAM keys.
+///
+/// \since QXmpp 1.6
+
+int QXmppPasswordChecker::scramIterations() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->scramIterations;
+}
+
+/// Sets the number of PBKDF2 iterations used to derive SCRAM keys.
+///
+/// The default is 4096, the minimum recommended by RFC 7677.
+///
+/// \param iterations
+///
+/// \since QXmpp 1.6
+
+void QXmppPasswordChecker::setScramIterations(int iterations)
+{
+    QMutexLocker locker(&d->mutex);
+    d->scramIterations = std::max(iterations, 1);
+}
+
+QXmppTask<PasswordResult> QXmppPasswordChecker::lookupPassword(const QXmppPasswordRequest &request)
+{
+    const auto key = request.username() + QLatin1Char('@') + request.domain();
+    auto *thread = QThread::currentThread();
+
+    QXmppPromise<PasswordResult> promise;
+    auto task = promise.task();
+
+    {
+        QMutexLocker locker(&d->mutex);
+        if (const auto itr = d->cachedPasswords.constFind(key); itr != d->cachedPasswords.constEnd()) {
+            if (!itr->expiry.hasExpired()) {
+                promise.finish(PasswordResult(itr->result));
+                return task;
+            }
+            d->cachedPasswords.erase(itr);
+        }
+
+        auto &pending = d->pendingLookups[thread][key];
+        pending.push_back(std::move(promise));
+        if (pending.size() > 1) {
+            return task;
+        }
+    }
+
+    // lives in the calling thread until the lookup has finished
+    auto *context = new QObject;
+    requestPassword(request).then(context, [this, key, thread, context](PasswordResult &&result) {
+        std::vector<QXmppPromise<PasswordResult>> promises;
+        {
+            QMutexLocker locker(&d->mutex);
+            d->cache(key, result);
+
+            auto &lookups = d->pendingLookups[thread];
+            promises = lookups.take(key);
+            if (lookups.isEmpty()) {
+                d->pendingLookups.remove(thread);
+            }
+        }
+
+        for (auto &promise : promises) {
+            promise.finish(PasswordResult(result));
+        }
+        context->deleteLater();
+    });
+    return task;
+}
@@ -6,9 +6,16 @@
 #define QXMPPPASSWORDCHECKER_H
 
 #include "QXmppGlobal.h"
+#include "QXmppTask.h"
 
+#include <memory>
+#include <variant>
+
+#include <QCryptographicHash>
 #include <QObject>
 
+class QXmppPasswordCheckerPrivate;
+
 /// \brief The QXmppPasswordRequest class represents a password request.
 ///
 class QXMPP_EXPORT QXmppPasswordRequest
@@ -76,18 +83,65 @@ private:
     bool m_isFinished;
 };
 
+/// \brief The QXmppScramCredentials struct contains the salted credentials of
+/// a user as used by the SCRAM mechanisms (RFC 5802).
+///
+/// \since QXmpp 1.6
+///
+struct QXmppScramCredentials
+{
+    /// Salt used to derive the keys
+    QByteArray salt;
+    /// Number of PBKDF2 iterations used to derive the keys
+    int iterations = 0;
+    /// Hash of the ClientKey
+    QByteArray storedKey;
+    /// Key used to sign the final server message
+    QByteArray serverKey;
+};
+
 /// \brief The QXmppPasswordChecker class represents an abstract password checker.
 ///
 
 class QXMPP_EXPORT QXmppPasswordChecker
 {
 public:
+    /// The password of the user or the error that occurred while retrieving it.
+    ///
+    /// \since QXmpp 1.6
+    using PasswordResult = std::variant<QString, QXmppPasswordReply::Error>;
+    /// The SCRAM credentials of the user or the error that occurred while
+    /// retrieving them.
+    ///
+    /// \since QXmpp 1.6
+    using ScramResult = std::variant<QXmppScramCredentials, QXmppPasswordReply::Error>;
+
+    QXmppPasswordChecker();
+    virtual ~QXmppPasswordChecker();
+
     virtual QXmppPasswordReply *checkPassword(const QXmppPasswordRequest &request);
     virtual QXmppPasswordReply *getDigest(const QXmppPasswordRequest &request);
     virtual bool hasGetPassword() const;
+    virtual QXmppTask<ScramResult> scramCredentials(const QXmppPasswordRequest &request, QCryptographicHash::Algorithm algorithm);
+
+    int scramIterations() const;
+    void setScramIterations(int iterations);
+
+    int maximumThreadCount() const;
+    void setMaximumThreadCount(int count);
+
+    int cacheTimeout() const;
+    void setCacheTimeout(int timeout);
+    void clearCache();
 
 protected:
     virtual QXmppPasswordReply::Error getPassword(const QXmppPasswordRequest &request, QString &password);
+    virtual QXmppTask<PasswordResult> requestPassword(const QXmppPasswordRequest &request);
+
+private:
+    QXmppTask<PasswordResult> lookupPassword(const QXmppPasswordRequest &request);
+
+    const std::unique_ptr<QXmppPasswordCheckerPrivate> d;
 };
 
 #endif
@@ -0,0 +1,927 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppPepExtension.h"
+
+#include "QXmppConstants_p.h"
+#include "QXmppDataForm.h"
+#include "QXmppDiscoveryIq.h"
+#include "QXmppElement.h"
+#include "QXmppPepStorage.h"
+#include "QXmppServer.h"
+#include "QXmppTask.h"
+#include "QXmppUtils.h"
+
+#include <algorithm>
+#include <utility>
+
+#include <QDateTime>
+#include <QDomElement>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+using namespace QXmpp::Private;
+
+// time in milliseconds after which an unanswered capabilities query is sent
+// again
+constexpr qint64 CapabilitiesQueryTimeout = 60 * 1000;
+
+namespace {
+
+struct PepNode
+{
+    QString accessModel = QStringLiteral("presence");
+    int maximumItems = 1;
+    // in the order they have been published, the last one is sent to
+    // resources coming online
+    QVector<QXmppPepStorage::Item> items;
+};
+
+// Writes an item with its stored payload, which is copied token by token
+// without building a DOM for it.
+void writeItem(QXmlStreamWriter *writer, const QXmppPepStorage::Item &item, bool withPayload)
+{
+    writer->writeStartElement(QStringLiteral("item"));
+    helperToXmlAddAttribute(writer, QStringLiteral("id"), item.id);
+    if (withPayload) {
+        QXmlStreamReader reader(item.payload);
+        while (!reader.atEnd()) {
+            reader.readNext();
+            if (reader.isStartElement() || reader.isEndElement() || reader.isCharacters()) {
+                writer->writeCurrentToken(reader);
+            }
+        }
+    }
+    writer->writeEndElement();
+}
+
+// XEP-0163: a notification about a node of a user
+class PepEventMessage : public QXmppStanza
+{
+public:
+    QString node;
+    QVector<QXmppPepStorage::Item> items;
+    QStringList retractedIds;
+    bool deleted = false;
+
+    void toXml(QXmlStreamWriter *writer) const override
+    {
+        writer->writeStartElement(QStringLiteral("message"));
+        helperToXmlAddAttribute(writer, QStringLiteral("to"), to());
+        helperToXmlAddAttribute(writer, QStringLiteral("from"), from());
+        writer->writeAttribute(QStringLiteral("type"), QStringLiteral("headline"));
+        writer->writeStartElement(QStringLiteral("event"));
+        writer->writeDefaultNamespace(ns_pubsub_event);
+        writer->writeStartElement(deleted ? QStringLiteral("delete") : QStringLiteral("items"));
+        writer->writeAttribute(QStringLiteral("node"), node);
+        for (const auto &item : items) {
+            writeItem(writer, item, true);
+        }
+        for (const auto &id : retractedIds) {
+            writer->writeStartElement(QStringLiteral("retract"));
+            writer->writeAttribute(QStringLiteral("id"), id);
+            writer->writeEndElement();
+        }
+        writer->writeEndElement();
+        writer->writeEndElement();
+        writer->writeEndElement();
+    }
+};
+
+// Result of a publish or items request
+class PubSubResultIq : public QXmppIq
+{
+public:
+    QString action;
+    QString node;
+    QVector<QXmppPepStorage::Item> items;
+    bool withPayloads = true;
+
+protected:
+    void toXmlElementFromChild(QXmlStreamWriter *writer) const override
+    {
+        writer->writeStartElement(QStringLiteral("pubsub"));
+        writer->writeDefaultNamespace(ns_pubsub);
+        writer->writeStartElement(action);
+        writer->writeAttribute(QStringLiteral("node"), node);
+        for (const auto &item : items) {
+            writeItem(writer, item, withPayloads);
+        }
+        writer->writeEndElement();
+        writer->writeEndElement();
+    }
+};
+
+}  // namespace
+
+class QXmppPepExtensionPrivate
+{
+public:
+    struct CapabilitiesQuery
+    {
+        QString id;
+        qint64 sent = 0;
+        QString hash;
+        QString ver;
+        // resources waiting for the last items
+        QStringList jids;
+    };
+
+    explicit QXmppPepExtensionPrivate(QXmppPepExtension *qq);
+
+    bool isLocal(const QString &bareJid) const;
+    QString ownerOf(const QDomElement &iq) const;
+    bool canAccess(const QString &owner, const PepNode &node, const QString &bareJid) const;
+
+    bool handlePubSubIq(const QDomElement &iq);
+    void handleRequest(const QDomElement &iq, const QString &owner);
+    void publish(const QDomElement &iq, const QString &owner, const QDomElement &publish);
+    void requestItems(const QDomElement &iq, const QString &owner, const QDomElement &items);
+    void retract(const QDomElement &iq, const QString &owner, const QDomElement &retract);
+    void deleteNode(const QDomElement &iq, const QString &owner, const QString &name);
+    void sendResult(const QDomElement &iq, const QString &owner);
+    void sendError(const QDomElement &iq, const QString &owner, QXmppStanza::Error::Type type, QXmppStanza::Error::Condition condition);
+
+    QStringList notificationRecipients(const QString &owner, const QString &name, const PepNode &node) const;
+    void notify(const QString &owner, const QString &name, const PepNode &node, PepEventMessage &event);
+    void sendLastItems(const QString &jid, const QSet<QString> &notifyNodes);
+
+    void handlePresence(const QDomElement &presence);
+    void removeResource(const QString &jid);
+    void queryCapabilities(const QString &jid, const QString &capabilities, const QDomElement &c);
+    bool handleDiscoveryIq(const QDomElement &iq);
+
+    void load(QVector<QXmppPepStorage::Node> &&storedNodes);
+    void markDirty(const QString &owner, const QString &name);
+    void flush();
+
+    QXmppPepExtension *q;
+    QXmppPepStorage *storage = nullptr;
+
+    // nodes by owner and name
+    QHash<QString, QHash<QString, PepNode>> nodes;
+    // whether the nodes have been loaded from the storage
+    bool loaded = true;
+    // requests received while loading
+    QVector<QDomElement> pendingRequests;
+
+    // changed nodes by owner, written by the timer
+    QHash<QString, QSet<QString>> dirtyNodes;
+    QTimer writeTimer;
+
+    // available resources by bare JID, with their capabilities node
+    QHash<QString, QHash<QString, QString>> resources;
+    // nodes the resources want notifications for, by capabilities node
+    QHash<QString, QSet<QString>> notifyNodes;
+    QHash<QString, CapabilitiesQuery> capabilitiesQueries;
+};
+
+QXmppPepExtensionPrivate::QXmppPepExtensionPrivate(QXmppPepExtension *qq)
+    : q(qq)
+{
+    writeTimer.setSingleShot(true);
+    writeTimer.setInterval(1000);
+    QObject::connect(&writeTimer, &QTimer::timeout, q, [this] { flush(); });
+}
+
+bool QXmppPepExtensionPrivate::isLocal(const QString &bareJid) const
+{
+    return !QXmppUtils::jidToUser(bareJid).isEmpty() && QXmppUtils::jidToDomain(bareJid) == q->server()->domain();
+}
+
+// Returns the local user whose nodes an IQ is addressed to, or an empty
+// string. Requests without an address are added the domain by the stream and
+// are addressed to the account of the sender.
+QString QXmppPepExtensionPrivate::ownerOf(const QDomElement &iq) const
+{
+    const auto to = iq.attribute(QStringLiteral("to"));
+    if (to.isEmpty() || to == q->server()->domain()) {
+        const auto from = QXmppUtils::jidToBareJid(iq.attribute(QStringLiteral("from")));
+        return isLocal(from) ? from : QString();
+    }
+    return QXmppUtils::jidToResource(to).isEmpty() && isLocal(to) ? to : QString();
+}
+
+bool QXmppPepExtensionPrivate::canAccess(const QString &owner, const PepNode &node, const QString &bareJid) const
+{
+    if (bareJid == owner || node.accessModel == QLatin1String("open")) {
+        return true;
+    }
+    return node.accessModel == QLatin1String("presence") && q->server()->presenceSubscribers(owner).contains(bareJid);
+}
+
+bool QXmppPepExtensionPrivate::handlePubSubIq(const QDomElement &iq)
+{
+    const auto type = iq.attribute(QStringLiteral("type"));
+    if (type != QLatin1String("get") && type != QLatin1String("set")) {
+        return false;
+    }
+    const auto owner = ownerOf(iq);
+    if (owner.isEmpty()) {
+        return false;
+    }
+    if (!loaded) {
+        pendingRequests << iq;
+        return true;
+    }
+    handleRequest(iq, owner);
+    return true;
+}
+
+void QXmppPepExtensionPrivate::handleRequest(const QDomElement &iq, const QString &owner)
+{
+    const auto pubsub = iq.firstChildElement();
+    const auto action = pubsub.firstChildElement();
+    const auto actionName = action.tagName();
+    const bool isSet = iq.attribute(QStringLiteral("type")) == QLatin1String("set");
+
+    if (isSet && QXmppUtils::jidToBareJid(iq.attribute(QStringLiteral("from"))) != owner) {
+        sendError(iq, owner, QXmppStanza::Error::Auth, QXmppStanza::Error::Forbidden);
+    } else if (pubsub.namespaceURI() == ns_pubsub_owner) {
+        if (isSet && actionName == QLatin1String("delete")) {
+            deleteNode(iq, owner, action.attribute(QStringLiteral("node")));
+        } else {
+            sendError(iq, owner, QXmppStanza::Error::Cancel, QXmppStanza::Error::FeatureNotImplemented);
+        }
+    } else if (isSet && actionName == QLatin1String("publish")) {
+        publish(iq, owner, action);
+    } else if (isSet && actionName == QLatin1String("retract")) {
+        retract(iq, owner, action);
+    } else if (!isSet && actionName == QLatin1String("items")) {
+        requestItems(iq, owner, action);
+    } else {
+        sendError(iq, owner, QXmppStanza::Error::Cancel, QXmppStanza::Error::FeatureNotImplemented);
+    }
+}
+
+// Publishes items, the node is created by the first publication. Publish
+// options are used as the configuration of a new node and need to match the
+// configuration of an existing one.
+void QXmppPepExtensionPrivate::publish(const QDomElement &iq, const QString &owner, const QDomElement &publish)
+{
+    const auto name = publish.attribute(QStringLiteral("node"));
+    if (name.isEmpty()) {
+        return sendError(iq, owner, QXmppStanza::Error::Modify, QXmppStanza::Error::BadRequest);
+    }
+
+    QString accessModel;
+    int maximumItems = -1;
+    QXmppDataForm options;
+    options.parse(publish.nextSiblingElement(QStringLiteral("publish-options")).firstChildElement(QStringLiteral("x")));
+    const auto fields = options.fields();
+    for (const auto &field : fields) {
+        const auto value = field.value().toString();
+        if (field.key() == QLatin1String("pubsub#access_model")) {
+            if (value != QLatin1String("presence") && value != QLatin1String("open") && value != QLatin1String("whitelist")) {
+                return sendError(iq, owner, QXmppStanza::Error::Modify, QXmppStanza::Error::NotAcceptable);
+            }
+            accessModel = value;
+        } else if (field.key() == QLatin1String("pubsub#max_items")) {
+            bool ok = value == QLatin1String("max");
+            maximumItems = ok ? 0 : value.toInt(&ok);
+            if (!ok || maximumItems < 0) {
+                return sendError(iq, owner, QXmppStanza::Error::Modify, QXmppStanza::Error::NotAcceptable);
+            }
+        }
+    }
+
+    QVector<QXmppPepStorage::Item> published;
+    for (auto item = publish.firstChildElement(QStringLiteral("item")); !item.isNull(); item = item.nextSiblingElement(QStringLiteral("item"))) {
+        const auto payload = item.firstChildElement();
+        if (payload.isNull()) {
+            return sendError(iq, owner, QXmppStanza::Error::Modify, QXmppStanza::Error::BadRequest);
+        }
+        QXmppPepStorage::Item stored;
+        stored.id = item.attribute(QStringLiteral("id"));
+        if (stored.id.isEmpty()) {
+            stored.id = QXmppUtils::generateStanzaUuid();
+        }
+        QXmlStreamWriter writer(&stored.payload);
+        QXmppElement(payload).toXml(&writer);
+        published << std::move(stored);
+    }
+    if (published.isEmpty()) {
+        return sendError(iq, owner, QXmppStanza::Error::Modify, QXmppStanza::Error::BadRequest);
+    }
+
+    auto &ownerNodes = nodes[owner];
+    auto node = ownerNodes.find(name);
+    if (node == ownerNodes.end()) {
+        node = ownerNodes.insert(name, {});
+        if (!accessModel.isNull()) {
+            node->accessModel = accessModel;
+        }
+        if (maximumItems >= 0) {
+            node->maximumItems = maximumItems;
+        }
+    } else if ((!accessModel.isNull() && accessModel != node->accessModel) ||
+               (maximumItems >= 0 && maximumItems != node->maximumItems)) {
+        // precondition not met
+        return sendError(iq, owner, QXmppStanza::Error::Cancel, QXmppStanza::Error::Conflict);
+    }
+
+    // items with the same ID are replaced and become the latest ones
+    for (const auto &item : std::as_const(published)) {
+        node->items.erase(std::remove_if(node->items.begin(), node->items.end(), [&](const auto &existing) {
+                              return existing.id == item.id;
+                          }),
+                          node->items.end());
+        node->items << item;
+    }
+    if (node->maximumItems > 0 && node->items.size() > node->maximumItems) {
+        node->items.remove(0, node->items.size() - node->maximumItems);
+    }
+    markDirty(owner, name);
+
+    PubSubResultIq response;
+    response.setType(QXmppIq::Result);
+    response.setId(iq.attribute(QStringLiteral("id")));
+    response.setFrom(owner);
+    response.setTo(iq.attribute(QStringLiteral("from")));
+    response.action = QStringLiteral("publish");
+    response.node = name;
+    response.items = published;
+    response.withPayloads = false;
+    q->server()->sendPacket(response);
+
+    PepEventMessage event;
+    event.items = std::move(published);
+    notify(owner, name, *node, event);
+}
+
+void QXmppPepExtensionPrivate::requestItems(const QDomElement &iq, const QString &owner, const QDomElement &items)
+{
+    const auto name = items.attribute(QStringLiteral("node"));
+    const auto ownerNodes = nodes.constFind(owner);
+    if (ownerNodes == nodes.constEnd() || !ownerNodes->contains(name)) {
+        return sendError(iq, owner, QXmppStanza::Error::Cancel, QXmppStanza::Error::ItemNotFound);
+    }
+    const auto node = ownerNodes->constFind(name);
+    if (!canAccess(owner, *node, QXmppUtils::jidToBareJid(iq.attribute(QStringLiteral("from"))))) {
+        if (node->accessModel == QLatin1String("presence")) {
+            return sendError(iq, owner, QXmppStanza::Error::Auth, QXmppStanza::Error::NotAuthorized);
+        }
+        return sendError(iq, owner, QXmppStanza::Error::Cancel, QXmppStanza::Error::NotAllowed);
+    }
+
+    PubSubResultIq response;
+    response.setType(QXmppIq::Result);
+    response.setId(iq.attribute(QStringLiteral("id")));
+    response.setFrom(owner);
+    response.setTo(iq.attribute(QStringLiteral("from")));
+    response.action = QStringLiteral("items");
+    response.node = name;
+
+    QSet<QString> ids;
+    for (auto item = items.firstChildElement(QStringLiteral("item")); !item.isNull(); item = item.nextSiblingElement(QStringLiteral("item"))) {
+        ids.insert(item.attribute(QStringLiteral("id")));
+    }
+    if (!ids.isEmpty()) {
+        for (const auto &item : node->items) {
+            if (ids.contains(item.id)) {
+                response.items << item;
+            }
+        }
+    } else {
+        bool ok = false;
+        const auto max = items.attribute(QStringLiteral("max_items")).toInt(&ok);
+        response.items = ok && max >= 0 && max < node->items.size() ? node->items.mid(node->items.size() - max) : node->items;
+    }
+    q->server()->sendPacket(response);
+}
+
+void QXmppPepExtensionPrivate::retract(const QDomElement &iq, const QString &owner, const QDomElement &retract)
+{
+    const auto name = retract.attribute(QStringLiteral("node"));
+    auto ownerNodes = nodes.find(owner);
+    if (ownerNodes == nodes.end() || !ownerNodes->contains(name)) {
+        return sendError(iq, owner, QXmppStanza::Error::Cancel, QXmppStanza::Error::ItemNotFound);
+    }
+    auto &node = (*ownerNodes)[name];
+
+    QStringList retracted;
+    for (auto item = retract.firstChildElement(QStringLiteral("item")); !item.isNull(); item = item.nextSiblingElement(QStringLiteral("item"))) {
+        const auto id = item.attribute(QStringLiteral("id"));
+        const auto itr = std::find_if(node.items.begin(), node.items.end(), [&](const auto &existing) {
+            return existing.id == id;
+        });
+        if (itr != node.items.end()) {
+            node.items.erase(itr);
+            retracted << id;
+        }
+    }
+    if (retracted.isEmpty()) {
+        return sendError(iq, owner, QXmppStanza::Error::Cancel, QXmppStanza::Error::ItemNotFound);
+    }
+    markDirty(owner, name);
+    sendResult(iq, owner);
+
+    const auto notifyAttribute = retract.attribute(QStringLiteral("notify"));
+    if (notifyAttribute == QLatin1String("true") || notifyAttribute == QLatin1String("1")) {
+        PepEventMessage event;
+        event.retractedIds = std::move(retracted);
+        notify(owner, name, node, event);
+    }
+}
+
+void QXmppPepExtensionPrivate::deleteNode(const QDomElement &iq, const QString &owner, const QString &name)
+{
+    auto ownerNodes = nodes.find(owner);
+    if (ownerNodes == nodes.end() || !ownerNodes->contains(name)) {
+        return sendError(iq, owner, QXmppStanza::Error::Cancel, QXmppStanza::Error::ItemNotFound);
+    }
+    const auto node = ownerNodes->find(name);
+
+    PepEventMessage event;
+    event.deleted = true;
+    notify(owner, name, *node, event);
+
+    ownerNodes->erase(node);
+    if (ownerNodes->isEmpty()) {
+        nodes.erase(ownerNodes);
+    }
+    markDirty(owner, name);
+    sendResult(iq, owner);
+}
+
+// The responses are sent from the account of the owner, even if the stream
+// has added the domain to the request.
+void QXmppPepExtensionPrivate::sendResult(const QDomElement &iq, const QString &owner)
+{
+    QXmppIq response(QXmppIq::Result);
+    response.setId(iq.attribute(QStringLiteral("id")));
+    response.setFrom(owner);
+    response.setTo(iq.attribute(QStringLiteral("from")));
+    q->server()->sendPacket(response);
+}
+
+void QXmppPepExtensionPrivate::sendError(const QDomElement &iq, const QString &owner, QXmppStanza::Error::Type type, QXmppStanza::Error::Condition condition)
+{
+    QXmppIq response(QXmppIq::Error);
+    response.setId(iq.attribute(QStringLiteral("id")));
+    response.setFrom(owner);
+    response.setTo(iq.attribute(QStringLiteral("from")));
+    response.setError(QXmppStanza::Error(type, condition));
+    q->server()->sendPacket(response);
+}
+
+// Returns the available resources of the owner and of the users with a
+// presence subscription that want notifications for the node.
+QStringList QXmppPepExtensionPrivate::notificationRecipients(const QString &owner, const QString &name, const PepNode &node) const
+{
+    QStringList recipients;
+    const auto addResources = [&](const QString &bareJid) {
+        const auto user = resources.constFind(bareJid);
+        if (user == resources.constEnd()) {
+            return;
+        }
+        for (auto resource = user->cbegin(); resource != user->cend(); ++resource) {
+            const auto notifications = notifyNodes.constFind(resource.value());
+            if (notifications != notifyNodes.constEnd() && notifications->contains(name)) {
+                recipients << resource.key();
+            }
+        }
+    };
+
+    addResources(owner);
+    if (node.accessModel != QLatin1String("whitelist")) {
+        const auto subscribers = q->server()->presenceSubscribers(owner);
+        for (const auto &subscriber : subscribers) {
+            addResources(subscriber);
+        }
+    }
+    return recipients;
+}
+
+void QXmppPepExtensionPrivate::notify(const QString &owner, const QString &name, const PepNode &node, PepEventMessage &event)
+{
+    const auto recipients = notificationRecipients(owner, name, node);
+    if (recipients.isEmpty()) {
+        return;
+    }
+    // serialized once for all recipients
+    event.setFrom(owner);
+    event.node = name;
+    q->server()->broadcastPacket(event, recipients);
+}
+
+// Sends the last items of the nodes of the user and of their contacts to a
+// resource that has come online or changed its capabilities.
+void QXmppPepExtensionPrivate::sendLastItems(const QString &jid, const QSet<QString> &notifications)
+{
+    if (!loaded || notifications.isEmpty()) {
+        return;
+    }
+
+    const auto bareJid = QXmppUtils::jidToBareJid(jid);
+    const auto sendNodesOf = [&](const QString &owner) {
+        const auto ownerNodes = nodes.constFind(owner);
+        if (ownerNodes == nodes.constEnd()) {
+            return;
+        }
+        for (auto node = ownerNodes->cbegin(); node != ownerNodes->cend(); ++node) {
+            // the contacts of the user all have a presence subscription
+            if (node->items.isEmpty() || !notifications.contains(node.key()) ||
+                (owner != bareJid && node->accessModel == QLatin1String("whitelist"))) {
+                continue;
+            }
+            PepEventMessage event;
+            event.setFrom(owner);
+            event.setTo(jid);
+            event.node = node.key();
+            event.items = { node->items.constLast() };
+            q->server()->sendPacket(event);
+        }
+    };
+
+    sendNodesOf(bareJid);
+    const auto contacts = q->server()->presenceSubscriptions(bareJid);
+    for (const auto &contact : contacts) {
+        sendNodesOf(contact);
+    }
+}
+
+// Keeps track of the available resources and their capabilities, from the
+// broadcast presences of local users, which the streams address to the
+// domain, and the presences remote users send to local users.
+void QXmppPepExtensionPrivate::handlePresence(const QDomElement &presence)
+{
+    const auto from = presence.attribute(QStringLiteral("from"));
+    const auto to = presence.attribute(QStringLiteral("to"));
+    const auto bareJid = QXmppUtils::jidToBareJid(from);
+    if (from == bareJid) {
+        return;
+    }
+    const bool broadcast = to.isEmpty() || to == q->server()->domain();
+    if (broadcast ? !isLocal(bareJid) : (isLocal(bareJid) || !isLocal(QXmppUtils::jidToBareJid(to)))) {
+        return;
+    }
+
+    const auto type = presence.attribute(QStringLiteral("type"));
+    if (type == QLatin1String("unavailable")) {
+        removeResource(from);
+        return;
+    }
+    if (!type.isEmpty()) {
+        return;
+    }
+
+    QString capabilities;
+    auto c = presence.firstChildElement(QStringLiteral("c"));
+    while (!c.isNull() && c.namespaceURI() != ns_capabilities) {
+        c = c.nextSiblingElement(QStringLiteral("c"));
+    }
+    if (!c.isNull()) {
+        capabilities = c.attribute(QStringLiteral("node")) + QLatin1Char('#') + c.attribute(QStringLiteral("ver"));
+    }
+
+    auto &userResources = resources[bareJid];
+    const auto resource = userResources.constFind(from);
+    if (resource != userResources.constEnd() && resource.value() == capabilities) {
+        return;
+    }
+    userResources.insert(from, capabilities);
+    if (capabilities.isEmpty()) {
+        return;
+    }
+
+    const auto notifications = notifyNodes.constFind(capabilities);
+    if (notifications != notifyNodes.constEnd()) {
+        sendLastItems(from, *notifications);
+    } else {
+        queryCapabilities(from, capabilities, c);
+    }
+}
+
+void QXmppPepExtensionPrivate::removeResource(const QString &jid)
+{
+    const auto user = resources.find(QXmppUtils::jidToBareJid(jid));
+    if (user != resources.end()) {
+        user->remove(jid);
+        if (user->isEmpty()) {
+            resources.erase(user);
+        }
+    }
+}
+
+// Asks a resource for the features of its capabilities node, all resources
+// with the same node share the result.
+void QXmppPepExtensionPrivate::queryCapabilities(const QString &jid, const QString &capabilities, const QDomElement &c)
+{
+    auto &query = capabilitiesQueries[capabilities];
+    if (!query.jids.contains(jid)) {
+        query.jids << jid;
+    }
+    const auto now = QDateTime::currentMSecsSinceEpoch();
+    if (!query.id.isEmpty() && now - query.sent < CapabilitiesQueryTimeout) {
+        return;
+    }
+
+    QXmppDiscoveryIq request;
+    request.setType(QXmppIq::Get);
+    request.setQueryType(QXmppDiscoveryIq::InfoQuery);
+    request.setQueryNode(capabilities);
+    request.setFrom(q->server()->domain());
+    request.setTo(jid);
+    query.id = request.id();
+    query.sent = now;
+    query.hash = c.attribute(QStringLiteral("hash"));
+    query.ver = c.attribute(QStringLiteral("ver"));
+    q->server()->sendPacket(request);
+}
+
+bool QXmppPepExtensionPrivate::handleDiscoveryIq(const QDomElement &iq)
+{
+    const auto type = iq.attribute(QStringLiteral("type"));
+    const auto to = iq.attribute(QStringLiteral("to"));
+
+    // the features of a capabilities node
+    if (type == QLatin1String("result")) {
+        if (to != q->server()->domain()) {
+            return false;
+        }
+        QXmppDiscoveryIq response;
+        response.parse(iq);
+        const auto query = capabilitiesQueries.constFind(response.queryNode());
+        if (query == capabilitiesQueries.constEnd() || query->id != response.id()) {
+            return false;
+        }
+        const auto pending = capabilitiesQueries.take(response.queryNode());
+
+        // the features are shared by all resources announcing the node, so
+        // they are only cached if they match the hash
+        if (pending.hash == QLatin1String("sha-1") && QString::fromLatin1(response.verificationString().toBase64()) != pending.ver) {
+            q->warning(QStringLiteral("Capabilities of %1 do not match their hash").arg(response.from()));
+            return true;
+        }
+
+        QSet<QString> notifications;
+        const auto features = response.features();
+        for (const auto &feature : features) {
+            if (feature.endsWith(QLatin1String("+notify"))) {
+                notifications.insert(feature.chopped(7));
+            }
+        }
+        notifyNodes.insert(response.queryNode(), notifications);
+
+        for (const auto &jid : pending.jids) {
+            const auto user = resources.constFind(QXmppUtils::jidToBareJid(jid));
+            if (user != resources.constEnd() && user->value(jid) == response.queryNode()) {
+                sendLastItems(jid, notifications);
+            }
+        }
+        return true;
+    }
+
+    // the identity of the accounts
+    if (type != QLatin1String("get") || !QXmppUtils::jidToResource(to).isEmpty() || !isLocal(to)) {
+        return false;
+    }
+    QXmppDiscoveryIq request;
+    request.parse(iq);
+    if (request.queryType() != QXmppDiscoveryIq::InfoQuery || !request.queryNode().isEmpty()) {
+        return false;
+    }
+
+    QXmppDiscoveryIq::Identity account;
+    account.setCategory(QStringLiteral("account"));
+    account.setType(QStringLiteral("registered"));
+    QXmppDiscoveryIq::Identity pep;
+    pep.setCategory(QStringLiteral("pubsub"));
+    pep.setType(QStringLiteral("pep"));
+
+    QXmppDiscoveryIq response;
+    response.setType(QXmppIq::Result);
+    response.setId(request.id());
+    response.setFrom(to);
+    response.setTo(request.from());
+    response.setQueryType(QXmppDiscoveryIq::InfoQuery);
+    response.setIdentities({ account, pep });
+    response.setFeatures({
+        ns_disco_info,
+        ns_pubsub,
+        ns_pubsub_auto_create,
+        ns_pubsub_publish,
+        ns_pubsub_publish_options,
+        QString(ns_pubsub) + QStringLiteral("#access-presence"),
+        QString(ns_pubsub) + QStringLiteral("#delete-nodes"),
+        QString(ns_pubsub) + QStringLiteral("#last-published"),
+        QString(ns_pubsub) + QStringLiteral("#retract-items"),
+        QString(ns_pubsub) + QStringLiteral("#retrieve-items"),
+    });
+    q->server()->sendPacket(response);
+    return true;
+}
+
+void QXmppPepExtensionPrivate::load(QVector<QXmppPepStorage::Node> &&storedNodes)
+{
+    nodes.clear();
+    for (auto &stored : storedNodes) {
+        auto &node = nodes[stored.owner][stored.name];
+        if (!stored.accessModel.isEmpty()) {
+            node.accessModel = stored.accessModel;
+        }
+        node.maximumItems = stored.maximumItems;
+        node.items = std::move(stored.items);
+    }
+    loaded = true;
+
+    const auto requests = std::exchange(pendingRequests, {});
+    for (const auto &request : requests) {
+        handleRequest(request, ownerOf(request));
+    }
+
+    // the resources that have come online in the meantime
+    for (auto user = resources.cbegin(); user != resources.cend(); ++user) {
+        for (auto resource = user->cbegin(); resource != user->cend(); ++resource) {
+            sendLastItems(resource.key(), notifyNodes.value(resource.value()));
+        }
+    }
+}
+
+void QXmppPepExtensionPrivate::markDirty(const QString &owner, const QString &name)
+{
+    if (!storage) {
+        return;
+    }
+    dirtyNodes[owner].insert(name);
+    if (!writeTimer.isActive()) {
+        writeTimer.start();
+    }
+}
+
+// Writes the nodes changed since the last write to the storage in one batch.
+void QXmppPepExtensionPrivate::flush()
+{
+    writeTimer.stop();
+    if (!storage || dirtyNodes.isEmpty()) {
+        return;
+    }
+
+    QVector<QXmppPepStorage::Node> changed;
+    QVector<QXmppPepStorage::NodeKey> removed;
+    for (auto owner = dirtyNodes.cbegin(); owner != dirtyNodes.cend(); ++owner) {
+        const auto ownerNodes = nodes.constFind(owner.key());
+        for (const auto &name : owner.value()) {
+            if (ownerNodes == nodes.constEnd() || !ownerNodes->contains(name)) {
+                removed.push_back({ owner.key(), name });
+                continue;
+            }
+            const auto &node = ownerNodes->value(name);
+            changed.push_back({ owner.key(), name, node.accessModel, node.maximumItems, node.items });
+        }
+    }
+    dirtyNodes.clear();
+    storage->storeNodes(changed, removed);
+}
+
+///
+/// \class QXmppPepExtension
+///
+/// \brief The QXmppPepExtension class provides \xep{0163, Personal Eventing
+/// Protocol} nodes for the users of QXmppServer.
+///
+/// Users can publish items to nodes of their account, retract them and
+/// delete the nodes. Nodes are created by the first publication, with the
+/// \xep{0060, Publish-Subscribe} publish options as their configuration. The
+/// access models "presence", "open" and "whitelist" are supported.
+///
+/// Notifications are sent to the resources of the owner and of their
+/// presence subscribers that announce interest in the node with a "+notify"
+/// feature of their \xep{0115, Entity Capabilities}. The features are queried
+/// once per capabilities node. When a resource comes online, the last item of
+/// each node of the user and of their contacts is sent to it.
+///
+/// All nodes are kept in memory, so requests such as fetching the device list
+/// of a contact are answered without any storage access. A QXmppPepStorage
+/// set with setStorage() is read once when the server is started, changes are
+/// written behind in batches.
+///
+/// The presence subscriptions are looked up with
+/// QXmppServer::presenceSubscribers() and
+/// QXmppServer::presenceSubscriptions().
+///
+/// \since QXmpp 1.6
+///
+/// \ingroup Core
+///
+
+///
+/// Constructs a personal eventing extension.
+///
+QXmppPepExtension::QXmppPepExtension()
+    : d(std::make_unique<QXmppPepExtensionPrivate>(this))
+{
+}
+
+QXmppPepExtension::~QXmppPepExtension() = default;
+
+///
+/// Returns the storage the nodes are persisted in.
+///
+QXmppPepStorage *QXmppPepExtension::storage() const
+{
+    return d->storage;
+}
+
+///
+/// Sets the storage the nodes are persisted in.
+///
+/// The storage needs to be set before the server is started and must outlive
+/// the extension. Without a storage, the nodes are lost when the server is
+/// stopped.
+///
+void QXmppPepExtension::setStorage(QXmppPepStorage *storage)
+{
+    d->storage = storage;
+}
+
+///
+/// Returns the time in milliseconds changed nodes are collected before they
+/// are written to the storage.
+///
+int QXmppPepExtension::writeBehindDelay() const
+{
+    return d->writeTimer.interval();
+}
+
+///
+/// Sets the time in milliseconds changed nodes are collected before they are
+/// written to the storage.
+///
+/// A node published to repeatedly is only written once per interval. The
+/// default is 1000 ms. The changes are also written when the extension is
+/// stopped.
+///
+void QXmppPepExtension::setWriteBehindDelay(int msecs)
+{
+    d->writeTimer.setInterval(std::max(msecs, 0));
+}
+
+///
+/// Returns the number of nodes of a user.
+///
+int QXmppPepExtension::nodeCount(const QString &bareJid) const
+{
+    return d->nodes.value(bareJid).size();
+}
+
+/// \cond
+QVector<QXmppServerExtension::StanzaFilter> QXmppPepExtension::stanzaFilters() const
+{
+    return {
+        { QStringLiteral("iq"), ns_pubsub, {} },
+        { QStringLiteral("iq"), ns_pubsub_owner, {} },
+        { QStringLiteral("iq"), ns_disco_info, {} },
+        { QStringLiteral("presence"), {}, {} },
+    };
+}
+
+bool QXmppPepExtension::handleStanza(const QDomElement &element)
+{
+    if (element.tagName() == QLatin1String("presence")) {
+        // presences are routed as usual
+        d->handlePresence(element);
+        return false;
+    }
+    if (element.tagName() != QLatin1String("iq")) {
+        return false;
+    }
+    const auto xmlns = element.firstChildElement().namespaceURI();
+    if (xmlns == ns_disco_info) {
+        return d->handleDiscoveryIq(element);
+    }
+    if (xmlns == ns_pubsub || xmlns == ns_pubsub_owner) {
+        return d->handlePubSubIq(element);
+    }
+    return false;
+}
+
+bool QXmppPepExtension::start()
+{
+    // users disconnecting without an unavailable presence
+    connect(server(), &QXmppServer::clientDisconnected, this, [this](const QString &jid) {
+        d->removeResource(jid);
+    });
+
+    if (d->storage) {
+        d->loaded = false;
+        d->storage->loadNodes().then(this, [this](QVector<QXmppPepStorage::Node> &&nodes) {
+            d->load(std::move(nodes));
+        });
+    }
+    return true;
+}
+
+void QXmppPepExtension::stop()
+{
+    disconnect(server(), &QXmppServer::clientDisconnected, this, nullptr);
+    d->flush();
+    d->resources.clear();
+    d->capabilitiesQueries.clear();
+}
+/// \endcond
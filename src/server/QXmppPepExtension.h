@@ -0,0 +1,45 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPPEPEXTENSION_H
+#define QXMPPPEPEXTENSION_H
+
+#include "QXmppServerExtension.h"
+
+#include <memory>
+
+class QXmppPepExtensionPrivate;
+class QXmppPepStorage;
+
+class QXMPP_EXPORT QXmppPepExtension : public QXmppServerExtension
+{
+    Q_OBJECT
+    Q_CLASSINFO("ExtensionName", "pep")
+
+public:
+    QXmppPepExtension();
+    ~QXmppPepExtension() override;
+
+    QXmppPepStorage *storage() const;
+    void setStorage(QXmppPepStorage *storage);
+
+    int writeBehindDelay() const;
+    void setWriteBehindDelay(int msecs);
+
+    int nodeCount(const QString &bareJid) const;
+
+    /// \cond
+    QVector<StanzaFilter> stanzaFilters() const override;
+    bool handleStanza(const QDomElement &stanza) override;
+    bool start() override;
+    void stop() override;
+    /// \endcond
+
+private:
+    const std::unique_ptr<QXmppPepExtensionPrivate> d;
+
+    friend class QXmppPepExtensionPrivate;
+};
+
+#endif  // QXMPPPEPEXTENSION_H
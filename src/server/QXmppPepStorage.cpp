@@ -0,0 +1,44 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+///
+/// \class QXmppPepStorage
+///
+/// \brief The QXmppPepStorage class persists the personal eventing nodes of
+/// the users of a QXmppServer.
+///
+/// QXmppPepExtension keeps all nodes in memory and answers every request from
+/// there. The storage is only read once when the extension is started, and
+/// changed nodes are written behind in batches, so a database implementation
+/// can write each batch in one transaction. Implement this interface and pass
+/// it to QXmppPepExtension::setStorage().
+///
+/// The batches must be applied in the order they are passed.
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+
+///
+/// \typedef QXmppPepStorage::NodeKey
+///
+/// Bare JID of the owner and name of a node.
+///
+
+///
+/// \fn QXmppPepStorage::loadNodes()
+///
+/// Returns all stored nodes.
+///
+
+///
+/// \fn QXmppPepStorage::storeNodes(const QVector<Node> &nodes, const QVector<NodeKey> &removedNodes)
+///
+/// Stores a batch of changes.
+///
+/// \param nodes nodes that have been created or changed, each replacing the
+/// stored node with the same owner and name including all of its items
+/// \param removedNodes nodes that have been deleted
+///
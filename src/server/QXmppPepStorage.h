@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPPEPSTORAGE_H
+#define QXMPPPEPSTORAGE_H
+
+#include "QXmppGlobal.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include <utility>
+
+template<typename T>
+class QXmppTask;
+
+class QXMPP_EXPORT QXmppPepStorage
+{
+public:
+    ///
+    /// Published item of a node
+    ///
+    struct Item
+    {
+        /// ID of the item
+        QString id;
+        /// serialized payload element
+        QByteArray payload;
+    };
+
+    ///
+    /// Personal eventing node of a user
+    ///
+    struct Node
+    {
+        /// bare JID of the owner
+        QString owner;
+        /// name of the node, e.g. "urn:xmpp:avatar:metadata"
+        QString name;
+        /// "presence", "open" or "whitelist"
+        QString accessModel;
+        /// maximum number of items, 0 for no limit
+        int maximumItems = 1;
+        /// items in the order they have been published
+        QVector<Item> items;
+    };
+
+    /// Bare JID of the owner and name of a node
+    using NodeKey = std::pair<QString, QString>;
+
+    virtual ~QXmppPepStorage() = default;
+
+    virtual QXmppTask<QVector<Node>> loadNodes() = 0;
+    virtual QXmppTask<void> storeNodes(const QVector<Node> &nodes, const QVector<NodeKey> &removedNodes) = 0;
+};
+
+#endif  // QXMPPPEPSTORAGE_H
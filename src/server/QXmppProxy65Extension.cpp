@@ -0,0 +1,740 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppProxy65Extension.h"
+
+#include "QXmppByteStreamIq.h"
+#include "QXmppConstants_p.h"
+#include "QXmppDiscoveryIq.h"
+#include "QXmppServer.h"
+#include "QXmppSocks.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include <QCryptographicHash>
+#include <QDomElement>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QPointer>
+#include <QSocketNotifier>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <csignal>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// bytes moved at once, the size of the copy buffers
+constexpr qint64 CHUNK_SIZE = 64 * 1024;
+// chunks forwarded in one direction before other relays get their turn
+constexpr int CHUNKS_PER_WAKEUP = 16;
+// sockets that are not activated within this time are closed
+constexpr int ACTIVATION_TIMEOUT = 60 * 1000;
+
+// Token bucket for the bandwidth limit of a pair, shared by both directions.
+class RateLimiter
+{
+public:
+    explicit RateLimiter(qint64 bytesPerSecond)
+        : m_rate(bytesPerSecond),
+          m_tokens(double(bytesPerSecond))
+    {
+        m_clock.start();
+    }
+
+    // Returns the number of bytes that may be transferred now.
+    qint64 available()
+    {
+        if (m_rate <= 0) {
+            return CHUNK_SIZE;
+        }
+        const auto elapsed = std::min<qint64>(m_clock.nsecsElapsed(), 1000000000);
+        m_clock.restart();
+        m_tokens = std::min(double(m_rate), m_tokens + double(m_rate) * double(elapsed) / 1e9);
+        return std::min(qint64(m_tokens), CHUNK_SIZE);
+    }
+
+    void consume(qint64 bytes)
+    {
+        if (m_rate > 0) {
+            m_tokens -= double(bytes);
+        }
+    }
+
+    // Returns the time in milliseconds until a tenth of a second worth of
+    // data may be transferred again.
+    int delay() const
+    {
+        const auto wanted = std::min(double(m_rate) / 10, double(CHUNK_SIZE));
+        return std::max(1, int((wanted - m_tokens) * 1000 / double(m_rate)));
+    }
+
+private:
+    qint64 m_rate;
+    double m_tokens;
+    QElapsedTimer m_clock;
+};
+
+// A pair of sockets forwarding data to each other. Relays live in the worker
+// threads and delete themselves once both sides have been closed.
+class Relay : public QObject
+{
+public:
+    Relay(qint64 bandwidthLimit, std::atomic<int> *count, QObject *parent)
+        : QObject(parent),
+          m_limiter(bandwidthLimit),
+          m_count(count)
+    {
+        m_throttle.setSingleShot(true);
+    }
+
+    ~Relay() override
+    {
+        (*m_count)--;
+    }
+
+protected:
+    // Returns the bytes that may be forwarded now, or 0 and schedules a retry.
+    qint64 allowance()
+    {
+        const auto allowed = m_limiter.available();
+        if (allowed <= 0 && !m_throttle.isActive()) {
+            m_throttle.start(m_limiter.delay());
+        }
+        return std::max<qint64>(allowed, 0);
+    }
+
+    RateLimiter m_limiter;
+    QTimer m_throttle;
+
+private:
+    std::atomic<int> *m_count;
+};
+
+// Portable relay copying the data through a buffer of the thread.
+class CopyRelay : public Relay
+{
+public:
+    CopyRelay(QTcpSocket *first, QTcpSocket *second, qint64 bandwidthLimit, std::atomic<int> *count, QObject *parent)
+        : Relay(bandwidthLimit, count, parent),
+          m_first(first),
+          m_second(second)
+    {
+        for (auto *socket : { first, second }) {
+            socket->setParent(this);
+            // stop reading from the network while the other side is busy
+            socket->setReadBufferSize(CHUNK_SIZE);
+            connect(socket, &QIODevice::readyRead, this, &CopyRelay::pump);
+            connect(socket, &QIODevice::bytesWritten, this, &CopyRelay::pump);
+            connect(socket, &QAbstractSocket::disconnected, this, &CopyRelay::pump);
+        }
+        connect(&m_throttle, &QTimer::timeout, this, &CopyRelay::pump);
+        pump();
+    }
+
+private:
+    void pump()
+    {
+        forward(m_first, m_second);
+        forward(m_second, m_first);
+
+        if (m_first->state() == QAbstractSocket::UnconnectedState &&
+            m_second->state() == QAbstractSocket::UnconnectedState) {
+            deleteLater();
+        }
+    }
+
+    void forward(QTcpSocket *from, QTcpSocket *to)
+    {
+        thread_local QByteArray buffer(CHUNK_SIZE, Qt::Uninitialized);
+
+        for (int i = 0; i < CHUNKS_PER_WAKEUP && from->bytesAvailable() > 0 && to->bytesToWrite() < CHUNK_SIZE; i++) {
+            const auto allowed = allowance();
+            if (!allowed) {
+                return;
+            }
+            const auto size = from->read(buffer.data(), allowed);
+            if (size <= 0) {
+                break;
+            }
+            to->write(buffer.constData(), size);
+            m_limiter.consume(size);
+        }
+
+        // everything has been forwarded, the other side is closed once its
+        // data has been written
+        if (from->state() == QAbstractSocket::UnconnectedState && from->bytesAvailable() == 0 &&
+            to->state() == QAbstractSocket::ConnectedState) {
+            to->disconnectFromHost();
+        }
+    }
+
+    QTcpSocket *m_first;
+    QTcpSocket *m_second;
+};
+
+#ifdef Q_OS_LINUX
+// Relay moving the data with splice() through a pipe, without copying it to
+// user space.
+class SpliceRelay : public Relay
+{
+public:
+    SpliceRelay(int first, int second, qint64 bandwidthLimit, std::atomic<int> *count, QObject *parent)
+        : Relay(bandwidthLimit, count, parent)
+    {
+        m_directions[0].from = first;
+        m_directions[0].to = second;
+        m_directions[1].from = second;
+        m_directions[1].to = first;
+
+        for (auto &direction : m_directions) {
+            if (pipe2(direction.pipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+                m_failed = true;
+            }
+            direction.readable = new QSocketNotifier(direction.from, QSocketNotifier::Read, this);
+            direction.writable = new QSocketNotifier(direction.to, QSocketNotifier::Write, this);
+            direction.writable->setEnabled(false);
+            connect(direction.readable, &QSocketNotifier::activated, this, [this, &direction] { pump(direction); });
+            connect(direction.writable, &QSocketNotifier::activated, this, [this, &direction] { pump(direction); });
+        }
+        connect(&m_throttle, &QTimer::timeout, this, [this] {
+            for (auto &direction : m_directions) {
+                pump(direction);
+            }
+        });
+
+        if (m_failed) {
+            finish();
+        }
+    }
+
+    ~SpliceRelay() override
+    {
+        // the notifiers need to be removed before the descriptors are closed
+        for (auto &direction : m_directions) {
+            delete direction.readable;
+            delete direction.writable;
+            for (const int fd : direction.pipe) {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+            }
+        }
+        ::close(m_directions[0].from);
+        ::close(m_directions[1].from);
+    }
+
+private:
+    struct Direction
+    {
+        int from = -1;
+        int to = -1;
+        int pipe[2] = { -1, -1 };
+        // bytes in the pipe
+        qint64 piped = 0;
+        bool finished = false;
+        QSocketNotifier *readable = nullptr;
+        QSocketNotifier *writable = nullptr;
+    };
+
+    void pump(Direction &direction)
+    {
+        if (m_failed) {
+            return;
+        }
+
+        for (int i = 0; i < CHUNKS_PER_WAKEUP; i++) {
+            if (direction.piped == 0) {
+                if (direction.finished) {
+                    break;
+                }
+                const auto allowed = allowance();
+                if (!allowed) {
+                    break;
+                }
+                const auto size = splice(direction.from, nullptr, direction.pipe[1], nullptr, size_t(allowed), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+                if (size == 0) {
+                    // half-close the other side
+                    direction.finished = true;
+                    ::shutdown(direction.to, SHUT_WR);
+                    break;
+                } else if (size < 0) {
+                    if (errno == EAGAIN) {
+                        break;
+                    }
+                    finish();
+                    return;
+                }
+                direction.piped = size;
+                m_limiter.consume(size);
+            }
+
+            const auto size = splice(direction.pipe[0], nullptr, direction.to, nullptr, size_t(direction.piped), SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (size < 0) {
+                if (errno == EAGAIN) {
+                    break;
+                }
+                finish();
+                return;
+            }
+            direction.piped -= size;
+        }
+
+        // wait for the destination to drain, or for new data
+        direction.writable->setEnabled(direction.piped > 0);
+        direction.readable->setEnabled(direction.piped == 0 && !direction.finished && !m_throttle.isActive());
+
+        if (std::all_of(std::begin(m_directions), std::end(m_directions), [](const Direction &d) { return d.finished && d.piped == 0; })) {
+            finish();
+        }
+    }
+
+    void finish()
+    {
+        m_failed = true;
+        for (auto &direction : m_directions) {
+            direction.readable->setEnabled(false);
+            direction.writable->setEnabled(false);
+        }
+        deleteLater();
+    }
+
+    Direction m_directions[2];
+    bool m_failed = false;
+};
+#endif
+
+}  // namespace
+
+class QXmppProxy65ExtensionPrivate
+{
+public:
+    explicit QXmppProxy65ExtensionPrivate(QXmppProxy65Extension *qq)
+        : q(qq)
+    {
+    }
+
+    void handleConnection(QTcpSocket *socket, const QString &hostName);
+    void removePending(QTcpSocket *socket);
+    bool activate(const QString &hostName);
+    void startRelay(QTcpSocket *first, QTcpSocket *second);
+
+    QString jid;
+    QString host;
+    quint16 port = 7777;
+    qint64 bandwidthLimit = 0;
+    int threadCount = 1;
+
+    QXmppSocksServer *socksServer = nullptr;
+    // connected sockets by the hash of the session, waiting for activation
+    QHash<QString, QVector<QTcpSocket *>> pendingSockets;
+
+    // Event loop threads for the relays, so relayed data doesn't delay the
+    // stanzas routed by the server.
+    struct Worker
+    {
+        QThread *thread = nullptr;
+        QObject *context = nullptr;
+    };
+    QVector<Worker> workers;
+    int nextWorker = 0;
+    std::atomic<int> activeRelays { 0 };
+
+private:
+    QXmppProxy65Extension *q;
+};
+
+void QXmppProxy65ExtensionPrivate::handleConnection(QTcpSocket *socket, const QString &hostName)
+{
+    auto &sockets = pendingSockets[hostName];
+    if (sockets.size() >= 2) {
+        q->warning(QStringLiteral("Refusing third connection for bytestream %1").arg(hostName));
+        socket->close();
+        socket->deleteLater();
+        return;
+    }
+    sockets << socket;
+
+    QObject::connect(socket, &QAbstractSocket::disconnected, q, [this, socket] {
+        removePending(socket);
+    });
+    QTimer::singleShot(ACTIVATION_TIMEOUT, q, [this, socket = QPointer<QTcpSocket>(socket)] {
+        // activated sockets may have been moved to a relay thread, they are
+        // not pending anymore
+        if (socket) {
+            removePending(socket);
+        }
+    });
+}
+
+void QXmppProxy65ExtensionPrivate::removePending(QTcpSocket *socket)
+{
+    for (auto itr = pendingSockets.begin(); itr != pendingSockets.end(); ++itr) {
+        if (itr->removeOne(socket)) {
+            if (itr->isEmpty()) {
+                pendingSockets.erase(itr);
+            }
+            socket->disconnect(q);
+            socket->abort();
+            socket->deleteLater();
+            return;
+        }
+    }
+}
+
+bool QXmppProxy65ExtensionPrivate::activate(const QString &hostName)
+{
+    const auto itr = pendingSockets.find(hostName);
+    if (itr == pendingSockets.end() || itr->size() != 2) {
+        return false;
+    }
+    const auto sockets = *itr;
+    pendingSockets.erase(itr);
+
+    for (auto *socket : sockets) {
+        socket->disconnect(q);
+    }
+    startRelay(sockets.at(0), sockets.at(1));
+    return true;
+}
+
+void QXmppProxy65ExtensionPrivate::startRelay(QTcpSocket *first, QTcpSocket *second)
+{
+    const auto worker = workers.at(nextWorker);
+    nextWorker = (nextWorker + 1) % workers.size();
+    activeRelays++;
+
+    auto *context = worker.context;
+    auto *count = &activeRelays;
+    const auto limit = bandwidthLimit;
+
+#ifdef Q_OS_LINUX
+    // the sockets are handed over to splice() when no data is buffered in
+    // them, which is the case unless a peer has sent data before activation
+    first->flush();
+    second->flush();
+    if (!first->bytesAvailable() && !first->bytesToWrite() &&
+        !second->bytesAvailable() && !second->bytesToWrite()) {
+        const int firstFd = fcntl(int(first->socketDescriptor()), F_DUPFD_CLOEXEC, 0);
+        const int secondFd = fcntl(int(second->socketDescriptor()), F_DUPFD_CLOEXEC, 0);
+        if (firstFd >= 0 && secondFd >= 0) {
+            // closing the original descriptors keeps the connections open
+            for (auto *socket : { first, second }) {
+                socket->abort();
+                socket->deleteLater();
+            }
+            QMetaObject::invokeMethod(context, [=] {
+                new SpliceRelay(firstFd, secondFd, limit, count, context);
+            });
+            return;
+        }
+        for (const int fd : { firstFd, secondFd }) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        }
+    }
+#endif
+
+    for (auto *socket : { first, second }) {
+        socket->setParent(nullptr);
+        socket->moveToThread(worker.thread);
+    }
+    QMetaObject::invokeMethod(context, [=] {
+        new CopyRelay(first, second, limit, count, context);
+    });
+}
+
+///
+/// \class QXmppProxy65Extension
+///
+/// \brief The QXmppProxy65Extension class is a XEP-0065: SOCKS5 Bytestreams
+/// proxy for QXmppServer.
+///
+/// The proxy is announced as a streamhost to clients asking for it. Once the
+/// initiator and the target of a transfer have connected to the proxy, the
+/// initiator activates the bytestream and the proxy forwards the data between
+/// them.
+///
+/// The data is relayed in dedicated threads, so large transfers don't delay
+/// the stanzas routed by the server. On Linux, the data is moved between the
+/// sockets with splice() without copying it to user space. Otherwise, and if
+/// a peer has sent data before the activation, the data is copied through a
+/// buffer per thread.
+///
+/// \since QXmpp 1.6
+///
+/// \ingroup Core
+///
+
+///
+/// Constructs a SOCKS5 bytestreams proxy extension.
+///
+QXmppProxy65Extension::QXmppProxy65Extension()
+    : d(std::make_unique<QXmppProxy65ExtensionPrivate>(this))
+{
+}
+
+QXmppProxy65Extension::~QXmppProxy65Extension()
+{
+    stop();
+}
+
+///
+/// Returns the JID of the proxy.
+///
+QString QXmppProxy65Extension::jid() const
+{
+    return d->jid;
+}
+
+///
+/// Sets the JID of the proxy.
+///
+/// The default is "proxy." followed by the domain of the server.
+///
+void QXmppProxy65Extension::setJid(const QString &jid)
+{
+    d->jid = jid;
+}
+
+///
+/// Returns the host name clients connect to.
+///
+QString QXmppProxy65Extension::host() const
+{
+    return d->host;
+}
+
+///
+/// Sets the host name clients connect to.
+///
+/// The default is the domain of the server.
+///
+void QXmppProxy65Extension::setHost(const QString &host)
+{
+    d->host = host;
+}
+
+///
+/// Returns the port the proxy listens on.
+///
+quint16 QXmppProxy65Extension::port() const
+{
+    return d->port;
+}
+
+///
+/// Sets the port the proxy listens on, 7777 by default.
+///
+void QXmppProxy65Extension::setPort(quint16 port)
+{
+    d->port = port;
+}
+
+///
+/// Returns the bandwidth limit of each bytestream in bytes per second.
+///
+qint64 QXmppProxy65Extension::bandwidthLimit() const
+{
+    return d->bandwidthLimit;
+}
+
+///
+/// Sets the bandwidth limit of each bytestream in bytes per second.
+///
+/// The limit is shared by both directions. It applies to bytestreams
+/// activated afterwards. The default value is 0, which disables the limit.
+///
+void QXmppProxy65Extension::setBandwidthLimit(qint64 bytesPerSecond)
+{
+    d->bandwidthLimit = std::max<qint64>(bytesPerSecond, 0);
+}
+
+///
+/// Returns the number of threads relaying the data.
+///
+int QXmppProxy65Extension::threadCount() const
+{
+    return d->threadCount;
+}
+
+///
+/// Sets the number of threads relaying the data, 1 by default.
+///
+/// The setting applies when the extension is started.
+///
+void QXmppProxy65Extension::setThreadCount(int count)
+{
+    d->threadCount = std::max(count, 1);
+}
+
+///
+/// Returns the number of bytestreams currently relayed.
+///
+int QXmppProxy65Extension::activeRelayCount() const
+{
+    return d->activeRelays;
+}
+
+/// \cond
+QStringList QXmppProxy65Extension::discoveryItems() const
+{
+    return { d->jid };
+}
+
+QVector<QXmppServerExtension::StanzaFilter> QXmppProxy65Extension::stanzaFilters() const
+{
+    return {
+        { QStringLiteral("iq"), ns_bytestreams, {} },
+        { QStringLiteral("iq"), ns_disco_info, {} },
+    };
+}
+
+bool QXmppProxy65Extension::handleStanza(const QDomElement &element)
+{
+    if (d->jid.isEmpty() || element.attribute(QStringLiteral("to")) != d->jid) {
+        return false;
+    }
+
+    if (QXmppDiscoveryIq::isDiscoveryIq(element)) {
+        QXmppDiscoveryIq request;
+        request.parse(element);
+        if (request.type() != QXmppIq::Get || request.queryType() != QXmppDiscoveryIq::InfoQuery) {
+            return false;
+        }
+
+        QXmppDiscoveryIq::Identity identity;
+        identity.setCategory(QStringLiteral("proxy"));
+        identity.setType(QStringLiteral("bytestreams"));
+        identity.setName(QStringLiteral("SOCKS5 Bytestreams"));
+
+        QXmppDiscoveryIq response;
+        response.setType(QXmppIq::Result);
+        response.setId(request.id());
+        response.setFrom(d->jid);
+        response.setTo(request.from());
+        response.setQueryType(QXmppDiscoveryIq::InfoQuery);
+        response.setIdentities({ identity });
+        response.setFeatures({ ns_disco_info, ns_bytestreams });
+        server()->sendPacket(response);
+        return true;
+    }
+
+    if (QXmppByteStreamIq::isByteStreamIq(element)) {
+        QXmppByteStreamIq request;
+        request.parse(element);
+
+        QXmppByteStreamIq response;
+        response.setId(request.id());
+        response.setFrom(d->jid);
+        response.setTo(request.from());
+
+        if (request.type() == QXmppIq::Get) {
+            QXmppByteStreamIq::StreamHost streamHost;
+            streamHost.setJid(d->jid);
+            streamHost.setHost(d->host.isEmpty() ? server()->domain() : d->host);
+            streamHost.setPort(d->port);
+
+            response.setType(QXmppIq::Result);
+            response.setStreamHosts({ streamHost });
+        } else if (request.type() == QXmppIq::Set) {
+            // the sockets are identified by SHA1(SID + initiator + target)
+            const auto hostName = QCryptographicHash::hash((request.sid() + request.from() + request.activate()).toUtf8(), QCryptographicHash::Sha1).toHex();
+            if (d->activate(QString::fromLatin1(hostName))) {
+                response.setType(QXmppIq::Result);
+            } else {
+                response.setType(QXmppIq::Error);
+                response.setError(QXmppStanza::Error(QXmppStanza::Error::Cancel, QXmppStanza::Error::ItemNotFound));
+            }
+        } else {
+            return true;
+        }
+        server()->sendPacket(response);
+        return true;
+    }
+    return false;
+}
+
+bool QXmppProxy65Extension::start()
+{
+    if (d->socksServer) {
+        return true;
+    }
+    if (d->jid.isEmpty()) {
+        d->jid = QStringLiteral("proxy.") + server()->domain();
+    }
+
+    d->socksServer = new QXmppSocksServer(this);
+    connect(d->socksServer, &QXmppSocksServer::newConnection, this, [this](QTcpSocket *socket, const QString &hostName, quint16) {
+        d->handleConnection(socket, hostName);
+    });
+    if (!d->socksServer->listen(d->port)) {
+        warning(QStringLiteral("Could not start listening for SOCKS5 on port %1").arg(QString::number(d->port)));
+        delete d->socksServer;
+        d->socksServer = nullptr;
+        return false;
+    }
+
+    for (int i = 0; i < d->threadCount; ++i) {
+        QXmppProxy65ExtensionPrivate::Worker worker;
+        worker.thread = new QThread;
+        worker.thread->setObjectName(QStringLiteral("QXmppProxy65Extension relay %1").arg(i));
+        worker.context = new QObject;
+        worker.context->moveToThread(worker.thread);
+        worker.thread->start();
+#ifdef Q_OS_LINUX
+        // writing to a closed socket with splice() raises SIGPIPE, which
+        // would terminate the process
+        QMetaObject::invokeMethod(worker.context, [] {
+            sigset_t signals;
+            sigemptyset(&signals);
+            sigaddset(&signals, SIGPIPE);
+            pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        });
+#endif
+        d->workers << worker;
+    }
+    return true;
+}
+
+void QXmppProxy65Extension::stop()
+{
+    if (!d->socksServer) {
+        return;
+    }
+
+    // pending sockets are owned by the SOCKS server
+    for (const auto &sockets : std::as_const(d->pendingSockets)) {
+        for (auto *socket : sockets) {
+            socket->disconnect(this);
+        }
+    }
+    d->pendingSockets.clear();
+    d->socksServer->close();
+    delete d->socksServer;
+    d->socksServer = nullptr;
+
+    // the relays are deleted in their threads, after the ones still being
+    // started
+    for (const auto &worker : std::as_const(d->workers)) {
+        auto *context = worker.context;
+        QMetaObject::invokeMethod(context, [context] { delete context; }, Qt::BlockingQueuedConnection);
+        worker.thread->quit();
+        worker.thread->wait();
+        delete worker.thread;
+    }
+    d->workers.clear();
+}
+/// \endcond
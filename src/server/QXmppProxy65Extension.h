@@ -0,0 +1,52 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPPROXY65EXTENSION_H
+#define QXMPPPROXY65EXTENSION_H
+
+#include "QXmppServerExtension.h"
+
+#include <memory>
+
+class QXmppProxy65ExtensionPrivate;
+
+class QXMPP_EXPORT QXmppProxy65Extension : public QXmppServerExtension
+{
+    Q_OBJECT
+    Q_CLASSINFO("ExtensionName", "proxy65")
+
+public:
+    QXmppProxy65Extension();
+    ~QXmppProxy65Extension() override;
+
+    QString jid() const;
+    void setJid(const QString &jid);
+
+    QString host() const;
+    void setHost(const QString &host);
+
+    quint16 port() const;
+    void setPort(quint16 port);
+
+    qint64 bandwidthLimit() const;
+    void setBandwidthLimit(qint64 bytesPerSecond);
+
+    int threadCount() const;
+    void setThreadCount(int count);
+
+    int activeRelayCount() const;
+
+    /// \cond
+    QStringList discoveryItems() const override;
+    QVector<StanzaFilter> stanzaFilters() const override;
+    bool handleStanza(const QDomElement &stanza) override;
+    bool start() override;
+    void stop() override;
+    /// \endcond
+
+private:
+    const std::unique_ptr<QXmppProxy65ExtensionPrivate> d;
+};
+
+#endif  // QXMPPPROXY65EXTENSION_H
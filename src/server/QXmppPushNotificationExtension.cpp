@@ -0,0 +1,431 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppPushNotificationExtension.h"
+
+#include "QXmppConstants_p.h"
+#include "QXmppDataForm.h"
+#include "QXmppMetrics.h"
+#include "QXmppPushEnableIq.h"
+#include "QXmppServer.h"
+#include "QXmppTimerWheel_p.h"
+#include "QXmppTokenBucket_p.h"
+#include "QXmppUtils.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include <QDomElement>
+#include <QElapsedTimer>
+#include <QXmlStreamWriter>
+
+using namespace QXmpp::Private;
+
+namespace {
+
+// XEP-0357: the publish request sent to an app server
+class PushNotificationIq : public QXmppIq
+{
+public:
+    QString node;
+    QXmppDataForm summary;
+    QXmppDataForm publishOptions;
+
+    void toXmlElementFromChild(QXmlStreamWriter *writer) const override
+    {
+        writer->writeStartElement(QStringLiteral("pubsub"));
+        writer->writeDefaultNamespace(ns_pubsub);
+        writer->writeStartElement(QStringLiteral("publish"));
+        writer->writeAttribute(QStringLiteral("node"), node);
+        writer->writeStartElement(QStringLiteral("item"));
+        writer->writeStartElement(QStringLiteral("notification"));
+        writer->writeDefaultNamespace(ns_push);
+        summary.toXml(writer);
+        writer->writeEndElement();
+        writer->writeEndElement();
+        writer->writeEndElement();
+        if (!publishOptions.isNull()) {
+            writer->writeStartElement(QStringLiteral("publish-options"));
+            publishOptions.toXml(writer);
+            writer->writeEndElement();
+        }
+        writer->writeEndElement();
+    }
+};
+
+}  // namespace
+
+struct PushDevice
+{
+    QString jid;
+    QString node;
+    QXmppDataForm publishOptions;
+
+    TokenBucket rateLimit;
+    // time of the last refill of the bucket, in ms of the extension's clock
+    qint64 lastRefill = 0;
+    // started by the first message after a notification, the notification is
+    // sent when it expires
+    WheelTimer timer;
+};
+
+struct PushAccount
+{
+    // messages stored since the user has been online
+    int pendingMessages = 0;
+    QString lastSender;
+    QString lastBody;
+    std::vector<std::unique_ptr<PushDevice>> devices;
+};
+
+class QXmppPushNotificationExtensionPrivate
+{
+public:
+    explicit QXmppPushNotificationExtensionPrivate(QXmppPushNotificationExtension *qq)
+        : q(qq)
+    {
+        clock.start();
+    }
+
+    bool handleEnable(QXmppPushEnableIq &request);
+    void addDevice(const QString &bareJid, std::unique_ptr<PushDevice> device);
+    void messageStored(const QString &bareJid, const QDomElement &message);
+    void userConnected(const QString &jid);
+    void flush(const QString &bareJid, PushDevice *device);
+
+    QXmppPushNotificationExtension *q;
+
+    int coalescingWindow = 2000;
+    double rate = 0.1;
+    int burst = 3;
+    bool messageBodyIncluded = false;
+
+    QElapsedTimer clock;
+    std::unordered_map<QString, PushAccount> accounts;
+    QMetaObject::Connection storedConnection;
+    QMetaObject::Connection connectedConnection;
+};
+
+// Registers or unregisters an app server for the sending user, returns false
+// for a bad request.
+bool QXmppPushNotificationExtensionPrivate::handleEnable(QXmppPushEnableIq &request)
+{
+    const auto bareJid = QXmppUtils::jidToBareJid(request.from());
+    if (request.jid().isEmpty()) {
+        return false;
+    }
+
+    if (request.mode() == QXmppPushEnableIq::Enable) {
+        if (request.node().isEmpty()) {
+            return false;
+        }
+        auto device = std::make_unique<PushDevice>();
+        device->jid = request.jid();
+        device->node = request.node();
+        device->publishOptions = request.dataForm();
+        addDevice(bareJid, std::move(device));
+        return true;
+    }
+
+    // without a node, all registrations with the app server are removed
+    auto itr = accounts.find(bareJid);
+    if (itr != accounts.end()) {
+        auto &devices = itr->second.devices;
+        devices.erase(std::remove_if(devices.begin(), devices.end(), [&](const auto &device) {
+                          return device->jid == request.jid() && (request.node().isEmpty() || device->node == request.node());
+                      }),
+                      devices.end());
+        if (devices.empty()) {
+            accounts.erase(itr);
+        }
+    }
+    return true;
+}
+
+void QXmppPushNotificationExtensionPrivate::addDevice(const QString &bareJid, std::unique_ptr<PushDevice> device)
+{
+    device->rateLimit.setRate(rate, burst);
+    device->lastRefill = clock.elapsed();
+    device->timer.setCallback([this, bareJid, device = device.get()] {
+        flush(bareJid, device);
+    });
+
+    auto &devices = accounts[bareJid].devices;
+    const auto itr = std::find_if(devices.begin(), devices.end(), [&](const auto &other) {
+        return other->jid == device->jid && other->node == device->node;
+    });
+    if (itr != devices.end()) {
+        *itr = std::move(device);
+    } else {
+        devices.push_back(std::move(device));
+    }
+}
+
+void QXmppPushNotificationExtensionPrivate::messageStored(const QString &bareJid, const QDomElement &message)
+{
+    auto itr = accounts.find(bareJid);
+    if (itr == accounts.end()) {
+        return;
+    }
+
+    auto &account = itr->second;
+    account.pendingMessages++;
+    account.lastSender = QXmppUtils::jidToBareJid(message.attribute(QStringLiteral("from")));
+    account.lastBody = message.firstChildElement(QStringLiteral("body")).text();
+
+    for (const auto &device : account.devices) {
+        if (device->timer.isActive()) {
+            // sent with the notification that is already scheduled
+            QXmppMetrics::increment(QXmppMetrics::CoalescedPushMessages);
+        } else {
+            device->timer.start(coalescingWindow);
+        }
+    }
+}
+
+void QXmppPushNotificationExtensionPrivate::userConnected(const QString &jid)
+{
+    // the user fetches the messages, there is nothing to notify anymore
+    auto itr = accounts.find(QXmppUtils::jidToBareJid(jid));
+    if (itr == accounts.end()) {
+        return;
+    }
+    auto &account = itr->second;
+    account.pendingMessages = 0;
+    account.lastSender.clear();
+    account.lastBody.clear();
+    for (const auto &device : account.devices) {
+        device->timer.stop();
+    }
+}
+
+void QXmppPushNotificationExtensionPrivate::flush(const QString &bareJid, PushDevice *device)
+{
+    const auto itr = accounts.find(bareJid);
+    if (itr == accounts.end() || itr->second.pendingMessages == 0) {
+        return;
+    }
+    const auto &account = itr->second;
+
+    if (device->rateLimit.isEnabled()) {
+        const auto now = clock.elapsed();
+        device->rateLimit.refill(now - device->lastRefill);
+        device->lastRefill = now;
+        if (device->rateLimit.available() < 1) {
+            // the messages arriving meanwhile are added to this notification
+            device->timer.start(int(device->rateLimit.msecsUntilAvailable()));
+            return;
+        }
+        device->rateLimit.consume(1);
+    }
+
+    QList<QXmppDataForm::Field> fields = {
+        { QXmppDataForm::Field::HiddenField, QStringLiteral("FORM_TYPE"), QString(ns_push_summary) },
+        { QXmppDataForm::Field::TextSingleField, QStringLiteral("message-count"), QString::number(account.pendingMessages) },
+    };
+    if (!account.lastSender.isEmpty()) {
+        fields.append({ QXmppDataForm::Field::JidSingleField, QStringLiteral("last-message-sender"), account.lastSender });
+    }
+    if (messageBodyIncluded && !account.lastBody.isEmpty()) {
+        fields.append({ QXmppDataForm::Field::TextSingleField, QStringLiteral("last-message-body"), account.lastBody });
+    }
+
+    PushNotificationIq iq;
+    iq.setType(QXmppIq::Set);
+    iq.setFrom(bareJid);
+    iq.setTo(device->jid);
+    iq.node = device->node;
+    iq.summary.setType(QXmppDataForm::Submit);
+    iq.summary.setFields(fields);
+    iq.publishOptions = device->publishOptions;
+
+    // notifications for the same app server are written to its stream
+    // together
+    q->server()->sendPacket(iq);
+    QXmppMetrics::increment(QXmppMetrics::PushNotifications);
+}
+
+///
+/// \class QXmppPushNotificationExtension
+///
+/// \brief The QXmppPushNotificationExtension class sends XEP-0357: Push
+/// Notifications to the app servers registered by the users of QXmppServer.
+///
+/// A notification is sent when a message is stored for a user without online
+/// resources. The messages arriving within the coalescing window after the
+/// first one are summarized in one notification per device, and the
+/// notifications of a device are rate limited, so bursts of messages don't
+/// wake up the device for each of them. The notification carries the number
+/// of messages received since the user has been online and the sender of the
+/// last one.
+///
+/// The extension needs an offline message storage to be set on the server.
+/// The registrations are kept in memory.
+///
+/// \since QXmpp 1.6
+///
+/// \ingroup Core
+///
+
+///
+/// Constructs a push notification extension.
+///
+QXmppPushNotificationExtension::QXmppPushNotificationExtension()
+    : d(std::make_unique<QXmppPushNotificationExtensionPrivate>(this))
+{
+}
+
+QXmppPushNotificationExtension::~QXmppPushNotificationExtension() = default;
+
+///
+/// Returns the time in milliseconds messages are collected before a
+/// notification is sent.
+///
+int QXmppPushNotificationExtension::coalescingWindow() const
+{
+    return d->coalescingWindow;
+}
+
+///
+/// Sets the time in milliseconds messages are collected before a
+/// notification is sent.
+///
+/// The default is 2 seconds.
+///
+void QXmppPushNotificationExtension::setCoalescingWindow(int msecs)
+{
+    d->coalescingWindow = std::max(msecs, 0);
+}
+
+///
+/// Returns the number of notifications per second a device receives at most
+/// on average, 0 if unlimited.
+///
+double QXmppPushNotificationExtension::deviceRateLimit() const
+{
+    return d->rate;
+}
+
+///
+/// Returns the number of notifications a device may receive at once.
+///
+int QXmppPushNotificationExtension::deviceBurst() const
+{
+    return d->burst;
+}
+
+///
+/// Sets the rate limit of the notifications per device.
+///
+/// The default is a notification every 10 seconds, with bursts of 3. A rate
+/// of 0 disables the limit. Only devices registered afterwards are affected.
+///
+/// \param pushesPerSecond
+/// \param burst
+///
+void QXmppPushNotificationExtension::setDeviceRateLimit(double pushesPerSecond, int burst)
+{
+    d->rate = std::max(pushesPerSecond, 0.0);
+    d->burst = std::max(burst, 1);
+}
+
+///
+/// Returns whether the body of the last message is included in the
+/// notifications.
+///
+bool QXmppPushNotificationExtension::isMessageBodyIncluded() const
+{
+    return d->messageBodyIncluded;
+}
+
+///
+/// Sets whether the body of the last message is included in the
+/// notifications.
+///
+/// The default is false, as the app servers and the push services of the
+/// platforms can read the notifications.
+///
+void QXmppPushNotificationExtension::setMessageBodyIncluded(bool included)
+{
+    d->messageBodyIncluded = included;
+}
+
+///
+/// Returns the number of devices the user has registered for notifications.
+///
+int QXmppPushNotificationExtension::deviceCount(const QString &bareJid) const
+{
+    const auto itr = d->accounts.find(bareJid);
+    return itr == d->accounts.end() ? 0 : int(itr->second.devices.size());
+}
+
+/// \cond
+QStringList QXmppPushNotificationExtension::discoveryFeatures() const
+{
+    return { ns_push };
+}
+
+QVector<QXmppServerExtension::StanzaFilter> QXmppPushNotificationExtension::stanzaFilters() const
+{
+    return {
+        { QStringLiteral("iq"), ns_push, {} },
+    };
+}
+
+bool QXmppPushNotificationExtension::handleStanza(const QDomElement &element)
+{
+    if (!QXmppPushEnableIq::isPushEnableIq(element) || element.attribute(QStringLiteral("type")) != QLatin1String("set")) {
+        return false;
+    }
+
+    // only the users of the server can register, for their own account
+    QXmppPushEnableIq request;
+    request.parse(element);
+    const auto bareJid = QXmppUtils::jidToBareJid(request.from());
+    if (QXmppUtils::jidToDomain(bareJid) != server()->domain() || QXmppUtils::jidToUser(bareJid).isEmpty() ||
+        (!request.to().isEmpty() && request.to() != bareJid)) {
+        return false;
+    }
+
+    QXmppIq response;
+    response.setId(request.id());
+    response.setFrom(request.to());
+    response.setTo(request.from());
+    if (d->handleEnable(request)) {
+        response.setType(QXmppIq::Result);
+    } else {
+        response.setType(QXmppIq::Error);
+        response.setError(QXmppStanza::Error(QXmppStanza::Error::Modify, QXmppStanza::Error::BadRequest));
+    }
+    server()->sendPacket(response);
+    return true;
+}
+
+bool QXmppPushNotificationExtension::start()
+{
+    if (!d->storedConnection) {
+        d->storedConnection = connect(server(), &QXmppServer::offlineMessageStored, this, [this](const QString &bareJid, const QDomElement &message) {
+            d->messageStored(bareJid, message);
+        });
+        d->connectedConnection = connect(server(), &QXmppServer::clientConnected, this, [this](const QString &jid) {
+            d->userConnected(jid);
+        });
+    }
+    return true;
+}
+
+void QXmppPushNotificationExtension::stop()
+{
+    disconnect(d->storedConnection);
+    disconnect(d->connectedConnection);
+    d->storedConnection = {};
+    d->connectedConnection = {};
+    for (const auto &[bareJid, account] : d->accounts) {
+        for (const auto &device : account.devices) {
+            device->timer.stop();
+        }
+    }
+}
+/// \endcond
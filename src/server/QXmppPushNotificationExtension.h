@@ -0,0 +1,47 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPPUSHNOTIFICATIONEXTENSION_H
+#define QXMPPPUSHNOTIFICATIONEXTENSION_H
+
+#include "QXmppServerExtension.h"
+
+#include <memory>
+
+class QXmppPushNotificationExtensionPrivate;
+
+class QXMPP_EXPORT QXmppPushNotificationExtension : public QXmppServerExtension
+{
+    Q_OBJECT
+    Q_CLASSINFO("ExtensionName", "push")
+
+public:
+    QXmppPushNotificationExtension();
+    ~QXmppPushNotificationExtension() override;
+
+    int coalescingWindow() const;
+    void setCoalescingWindow(int msecs);
+
+    double deviceRateLimit() const;
+    int deviceBurst() const;
+    void setDeviceRateLimit(double pushesPerSecond, int burst);
+
+    bool isMessageBodyIncluded() const;
+    void setMessageBodyIncluded(bool included);
+
+    int deviceCount(const QString &bareJid) const;
+
+    /// \cond
+    QStringList discoveryFeatures() const override;
+    QVector<StanzaFilter> stanzaFilters() const override;
+    bool handleStanza(const QDomElement &stanza) override;
+    bool start() override;
+    void stop() override;
+    /// \endcond
+
+private:
+    const std::unique_ptr<QXmppPushNotificationExtensionPrivate> d;
+};
+
+#endif  // QXMPPPUSHNOTIFICATIONEXTENSION_H
@@ -0,0 +1,736 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppRosterExtension.h"
+
+#include "QXmppConstants_p.h"
+#include "QXmppPresence.h"
+#include "QXmppServer.h"
+#include "QXmppServerRosterStorage.h"
+#include "QXmppTask.h"
+#include "QXmppUtils.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <QDomElement>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+
+using namespace QXmpp::Private;
+
+// number of removed contacts kept per roster for the deltas, older removals
+// are forgotten and require sending the full roster
+constexpr int MaximumRemovedContacts = 64;
+
+namespace {
+
+using SubscriptionType = QXmppRosterIq::Item::SubscriptionType;
+
+struct RosterEntry
+{
+    QString jid;
+    QString name;
+    QStringList groups;
+    // version of the roster the entry has last been changed in
+    quint64 version = 0;
+    SubscriptionType subscriptionType = QXmppRosterIq::Item::None;
+    bool subscriptionPending = false;
+    // removed entries are kept, so their removal can be sent as a delta
+    bool removed = false;
+};
+
+struct UserRoster
+{
+    quint64 version = 0;
+    // Changes after this version are known. Clients with an older version
+    // get the full roster.
+    quint64 knownSince = 0;
+    int removedCount = 0;
+    // sorted by JID
+    std::vector<RosterEntry> entries;
+
+    std::vector<RosterEntry>::iterator find(const QString &jid)
+    {
+        auto itr = std::lower_bound(entries.begin(), entries.end(), jid, [](const RosterEntry &entry, const QString &jid) {
+            return entry.jid < jid;
+        });
+        return itr != entries.end() && itr->jid == jid ? itr : entries.end();
+    }
+
+    RosterEntry &insert(const QString &jid)
+    {
+        auto itr = std::lower_bound(entries.begin(), entries.end(), jid, [](const RosterEntry &entry, const QString &jid) {
+            return entry.jid < jid;
+        });
+        if (itr != entries.end() && itr->jid == jid) {
+            return *itr;
+        }
+        RosterEntry entry;
+        entry.jid = jid;
+        return *entries.insert(itr, std::move(entry));
+    }
+};
+
+QXmppRosterIq::Item toItem(const RosterEntry &entry)
+{
+    QXmppRosterIq::Item item;
+    item.setBareJid(entry.jid);
+    if (entry.removed) {
+        item.setSubscriptionType(QXmppRosterIq::Item::Remove);
+        return item;
+    }
+    item.setName(entry.name);
+    item.setGroups(QSet<QString>(entry.groups.cbegin(), entry.groups.cend()));
+    item.setSubscriptionType(entry.subscriptionType);
+    if (entry.subscriptionPending) {
+        item.setSubscriptionStatus(QStringLiteral("subscribe"));
+    }
+    return item;
+}
+
+bool hasFrom(SubscriptionType type)
+{
+    return type == QXmppRosterIq::Item::From || type == QXmppRosterIq::Item::Both;
+}
+
+bool hasTo(SubscriptionType type)
+{
+    return type == QXmppRosterIq::Item::To || type == QXmppRosterIq::Item::Both;
+}
+
+SubscriptionType subscriptionType(bool from, bool to)
+{
+    if (from) {
+        return to ? QXmppRosterIq::Item::Both : QXmppRosterIq::Item::From;
+    }
+    return to ? QXmppRosterIq::Item::To : QXmppRosterIq::Item::None;
+}
+
+}  // namespace
+
+class QXmppRosterExtensionPrivate
+{
+public:
+    explicit QXmppRosterExtensionPrivate(QXmppRosterExtension *qq);
+
+    bool isLocal(const QString &bareJid) const;
+
+    bool handleRosterIq(const QDomElement &iq);
+    void handleRequest(const QDomElement &iq);
+    void sendRoster(const QDomElement &iq, const QString &owner);
+    void setItem(const QDomElement &iq, const QString &owner);
+    void sendError(const QDomElement &iq, const QString &owner, QXmppStanza::Error::Type type, QXmppStanza::Error::Condition condition);
+
+    bool handlePresence(const QDomElement &presence);
+    bool handleOutboundSubscription(const QString &owner, const QString &contact, QXmppPresence::Type type);
+    bool handleInboundSubscription(const QString &owner, const QString &contact, QXmppPresence::Type type);
+
+    void commit(const QString &owner, UserRoster &roster, RosterEntry &entry);
+    void push(const QString &owner, const RosterEntry &entry, const QString &to);
+
+    void load(QVector<QXmppServerRosterStorage::Roster> &&storedRosters);
+    void markDirty(const QString &owner);
+    void flush();
+
+    QXmppRosterExtension *q;
+    QXmppServerRosterStorage *storage = nullptr;
+
+    QHash<QString, UserRoster> rosters;
+    // whether the rosters have been loaded from the storage
+    bool loaded = true;
+    // requests received while loading
+    QVector<QDomElement> pendingRequests;
+
+    // changed rosters, written by the timer
+    QSet<QString> dirtyRosters;
+    QTimer writeTimer;
+
+    // resources that have requested the roster and get roster pushes, by
+    // bare JID
+    QHash<QString, QSet<QString>> interestedResources;
+};
+
+QXmppRosterExtensionPrivate::QXmppRosterExtensionPrivate(QXmppRosterExtension *qq)
+    : q(qq)
+{
+    writeTimer.setSingleShot(true);
+    writeTimer.setInterval(1000);
+    QObject::connect(&writeTimer, &QTimer::timeout, q, [this] { flush(); });
+}
+
+bool QXmppRosterExtensionPrivate::isLocal(const QString &bareJid) const
+{
+    return !QXmppUtils::jidToUser(bareJid).isEmpty() && QXmppUtils::jidToDomain(bareJid) == q->server()->domain();
+}
+
+bool QXmppRosterExtensionPrivate::handleRosterIq(const QDomElement &iq)
+{
+    const auto type = iq.attribute(QStringLiteral("type"));
+    if (type != QLatin1String("get") && type != QLatin1String("set")) {
+        return false;
+    }
+
+    // requests without an address are added the domain by the stream
+    const auto owner = QXmppUtils::jidToBareJid(iq.attribute(QStringLiteral("from")));
+    const auto to = iq.attribute(QStringLiteral("to"));
+    if (!isLocal(owner) || (!to.isEmpty() && to != q->server()->domain() && to != owner)) {
+        return false;
+    }
+
+    if (!loaded) {
+        pendingRequests << iq;
+        return true;
+    }
+    handleRequest(iq);
+    return true;
+}
+
+void QXmppRosterExtensionPrivate::handleRequest(const QDomElement &iq)
+{
+    const auto owner = QXmppUtils::jidToBareJid(iq.attribute(QStringLiteral("from")));
+    if (iq.attribute(QStringLiteral("type")) == QLatin1String("get")) {
+        sendRoster(iq, owner);
+    } else {
+        setItem(iq, owner);
+    }
+}
+
+// Sends the roster, or only the changes since the version the client has
+// (XEP-0237). The changes are sent as roster pushes after an empty result.
+void QXmppRosterExtensionPrivate::sendRoster(const QDomElement &iq, const QString &owner)
+{
+    const auto from = iq.attribute(QStringLiteral("from"));
+    interestedResources[owner].insert(from);
+
+    const auto query = iq.firstChildElement(QStringLiteral("query"));
+    const bool versioned = query.hasAttribute(QStringLiteral("ver"));
+    bool ok = false;
+    const auto clientVersion = query.attribute(QStringLiteral("ver")).toULongLong(&ok);
+
+    const auto &roster = rosters[owner];
+    if (versioned && ok && clientVersion >= roster.knownSince && clientVersion <= roster.version) {
+        QXmppIq response(QXmppIq::Result);
+        response.setId(iq.attribute(QStringLiteral("id")));
+        response.setTo(from);
+        q->server()->sendPacket(response);
+
+        // in the order of the changes, so the last push has the current
+        // version
+        std::vector<const RosterEntry *> changes;
+        for (const auto &entry : roster.entries) {
+            if (entry.version > clientVersion) {
+                changes.push_back(&entry);
+            }
+        }
+        std::sort(changes.begin(), changes.end(), [](const RosterEntry *a, const RosterEntry *b) {
+            return a->version < b->version;
+        });
+        for (const auto *entry : changes) {
+            push(owner, *entry, from);
+        }
+        return;
+    }
+
+    QXmppRosterIq response;
+    response.setType(QXmppIq::Result);
+    response.setId(iq.attribute(QStringLiteral("id")));
+    response.setTo(from);
+    if (versioned) {
+        response.setVersion(QString::number(roster.version));
+    }
+    for (const auto &entry : roster.entries) {
+        if (!entry.removed) {
+            response.addItem(toItem(entry));
+        }
+    }
+    q->server()->sendPacket(response);
+}
+
+// Adds, changes or removes a contact (RFC 6121, section 2.3 and 2.5).
+void QXmppRosterExtensionPrivate::setItem(const QDomElement &iq, const QString &owner)
+{
+    const auto query = iq.firstChildElement(QStringLiteral("query"));
+    const auto itemElement = query.firstChildElement(QStringLiteral("item"));
+    if (itemElement.isNull() || !itemElement.nextSiblingElement(QStringLiteral("item")).isNull()) {
+        return sendError(iq, owner, QXmppStanza::Error::Modify, QXmppStanza::Error::BadRequest);
+    }
+
+    QXmppRosterIq::Item item;
+    item.parse(itemElement);
+    const auto jid = QXmppUtils::jidToBareJid(item.bareJid());
+    if (jid.isEmpty() || jid == owner) {
+        return sendError(iq, owner, QXmppStanza::Error::Modify, QXmppStanza::Error::BadRequest);
+    }
+
+    auto &roster = rosters[owner];
+    if (item.subscriptionType() == QXmppRosterIq::Item::Remove) {
+        const auto entry = roster.find(jid);
+        if (entry == roster.entries.end() || entry->removed) {
+            return sendError(iq, owner, QXmppStanza::Error::Cancel, QXmppStanza::Error::ItemNotFound);
+        }
+
+        // the subscriptions end with the contact
+        const auto sendSubscription = [&](QXmppPresence::Type type) {
+            QXmppPresence presence(type);
+            presence.setFrom(owner);
+            presence.setTo(jid);
+            if (isLocal(jid)) {
+                handleInboundSubscription(jid, owner, type);
+            }
+            q->server()->sendPacket(presence);
+        };
+        if (hasTo(entry->subscriptionType) || entry->subscriptionPending) {
+            sendSubscription(QXmppPresence::Unsubscribe);
+        }
+        if (hasFrom(entry->subscriptionType)) {
+            sendSubscription(QXmppPresence::Unsubscribed);
+            q->server()->removePresenceSubscriber(owner, jid);
+        }
+
+        entry->removed = true;
+        entry->name.clear();
+        entry->groups.clear();
+        entry->subscriptionType = QXmppRosterIq::Item::None;
+        entry->subscriptionPending = false;
+        roster.removedCount++;
+        commit(owner, roster, *entry);
+    } else {
+        auto &entry = roster.insert(jid);
+        if (entry.removed) {
+            entry.removed = false;
+            roster.removedCount--;
+        }
+        entry.name = item.name();
+        entry.groups = item.groups().values();
+        entry.groups.sort();
+        commit(owner, roster, entry);
+    }
+
+    QXmppIq response(QXmppIq::Result);
+    response.setId(iq.attribute(QStringLiteral("id")));
+    response.setTo(iq.attribute(QStringLiteral("from")));
+    q->server()->sendPacket(response);
+}
+
+void QXmppRosterExtensionPrivate::sendError(const QDomElement &iq, const QString &owner, QXmppStanza::Error::Type type, QXmppStanza::Error::Condition condition)
+{
+    QXmppIq response(QXmppIq::Error);
+    response.setId(iq.attribute(QStringLiteral("id")));
+    response.setFrom(owner);
+    response.setTo(iq.attribute(QStringLiteral("from")));
+    response.setError(QXmppStanza::Error(type, condition));
+    q->server()->sendPacket(response);
+}
+
+// Updates the subscription states from the subscription presences between a
+// local user and a contact (RFC 6121, section 3). Returns whether the presence
+// has been handled and must not be routed.
+bool QXmppRosterExtensionPrivate::handlePresence(const QDomElement &element)
+{
+    QXmppPresence::Type type;
+    const auto typeName = element.attribute(QStringLiteral("type"));
+    if (typeName == QLatin1String("subscribe")) {
+        type = QXmppPresence::Subscribe;
+    } else if (typeName == QLatin1String("subscribed")) {
+        type = QXmppPresence::Subscribed;
+    } else if (typeName == QLatin1String("unsubscribe")) {
+        type = QXmppPresence::Unsubscribe;
+    } else if (typeName == QLatin1String("unsubscribed")) {
+        type = QXmppPresence::Unsubscribed;
+    } else {
+        return false;
+    }
+
+    const auto from = QXmppUtils::jidToBareJid(element.attribute(QStringLiteral("from")));
+    const auto to = QXmppUtils::jidToBareJid(element.attribute(QStringLiteral("to")));
+    if (!loaded || from.isEmpty() || to.isEmpty() || from == to) {
+        return false;
+    }
+
+    if (isLocal(from)) {
+        handleOutboundSubscription(from, to, type);
+    }
+    if (isLocal(to)) {
+        return handleInboundSubscription(to, from, type);
+    }
+    return false;
+}
+
+bool QXmppRosterExtensionPrivate::handleOutboundSubscription(const QString &owner, const QString &contact, QXmppPresence::Type type)
+{
+    auto &roster = rosters[owner];
+    auto existing = roster.find(contact);
+    if (type != QXmppPresence::Subscribe && type != QXmppPresence::Subscribed &&
+        (existing == roster.entries.end() || existing->removed)) {
+        return false;
+    }
+
+    auto &entry = roster.insert(contact);
+    if (entry.removed) {
+        entry.removed = false;
+        roster.removedCount--;
+    }
+
+    const auto previousType = entry.subscriptionType;
+    const auto previousPending = entry.subscriptionPending;
+    bool from = hasFrom(entry.subscriptionType);
+    bool to = hasTo(entry.subscriptionType);
+    switch (type) {
+    case QXmppPresence::Subscribe:
+        entry.subscriptionPending = !to;
+        break;
+    case QXmppPresence::Subscribed:
+        from = true;
+        q->server()->addPresenceSubscriber(owner, contact);
+        break;
+    case QXmppPresence::Unsubscribe:
+        to = false;
+        entry.subscriptionPending = false;
+        break;
+    case QXmppPresence::Unsubscribed:
+        from = false;
+        q->server()->removePresenceSubscriber(owner, contact);
+        break;
+    default:
+        break;
+    }
+    entry.subscriptionType = subscriptionType(from, to);
+
+    if (existing == roster.entries.end() || entry.subscriptionType != previousType || entry.subscriptionPending != previousPending) {
+        commit(owner, roster, entry);
+    }
+    return true;
+}
+
+bool QXmppRosterExtensionPrivate::handleInboundSubscription(const QString &owner, const QString &contact, QXmppPresence::Type type)
+{
+    // may be called while the roster of the contact is changed, so no roster
+    // is inserted
+    const auto itr = rosters.find(owner);
+    if (itr == rosters.end()) {
+        return false;
+    }
+    auto &roster = *itr;
+    const auto entry = roster.find(contact);
+    const bool known = entry != roster.entries.end() && !entry->removed;
+
+    if (type == QXmppPresence::Subscribe) {
+        // already approved, the contact is answered without asking the user
+        if (known && hasFrom(entry->subscriptionType)) {
+            QXmppPresence subscribed(QXmppPresence::Subscribed);
+            subscribed.setFrom(owner);
+            subscribed.setTo(contact);
+            if (isLocal(contact)) {
+                handleInboundSubscription(contact, owner, QXmppPresence::Subscribed);
+            }
+            q->server()->sendPacket(subscribed);
+            return true;
+        }
+        return false;
+    }
+    if (!known) {
+        return false;
+    }
+
+    const auto previousType = entry->subscriptionType;
+    const auto previousPending = entry->subscriptionPending;
+    bool from = hasFrom(entry->subscriptionType);
+    bool to = hasTo(entry->subscriptionType);
+    switch (type) {
+    case QXmppPresence::Subscribed:
+        // only answers to a request of the user are accepted
+        if (entry->subscriptionPending) {
+            to = true;
+            entry->subscriptionPending = false;
+        }
+        break;
+    case QXmppPresence::Unsubscribe:
+        from = false;
+        q->server()->removePresenceSubscriber(owner, contact);
+        break;
+    case QXmppPresence::Unsubscribed:
+        to = false;
+        entry->subscriptionPending = false;
+        break;
+    default:
+        break;
+    }
+    entry->subscriptionType = subscriptionType(from, to);
+
+    if (entry->subscriptionType != previousType || entry->subscriptionPending != previousPending) {
+        commit(owner, roster, *entry);
+    }
+    return false;
+}
+
+// Gives the changed entry a new version and pushes it to the resources.
+void QXmppRosterExtensionPrivate::commit(const QString &owner, UserRoster &roster, RosterEntry &entry)
+{
+    entry.version = ++roster.version;
+
+    const auto resources = interestedResources.value(owner);
+    for (const auto &resource : resources) {
+        push(owner, entry, resource);
+    }
+
+    // the removed entries are forgotten at once, so the full roster is only
+    // sent to clients that haven't seen the last change
+    if (roster.removedCount > MaximumRemovedContacts) {
+        roster.entries.erase(std::remove_if(roster.entries.begin(), roster.entries.end(), [](const RosterEntry &entry) {
+                                 return entry.removed;
+                             }),
+                             roster.entries.end());
+        roster.removedCount = 0;
+        roster.knownSince = roster.version;
+    }
+    markDirty(owner);
+}
+
+void QXmppRosterExtensionPrivate::push(const QString &owner, const RosterEntry &entry, const QString &to)
+{
+    QXmppRosterIq iq;
+    iq.setType(QXmppIq::Set);
+    iq.setFrom(owner);
+    iq.setTo(to);
+    iq.setVersion(QString::number(entry.version));
+    iq.addItem(toItem(entry));
+    q->server()->sendPacket(iq);
+}
+
+void QXmppRosterExtensionPrivate::load(QVector<QXmppServerRosterStorage::Roster> &&storedRosters)
+{
+    rosters.clear();
+    for (auto &stored : storedRosters) {
+        auto &roster = rosters[stored.owner];
+        roster.version = stored.version;
+        // the removals before aren't known
+        roster.knownSince = stored.version;
+
+        QStringList subscribers;
+        roster.entries.reserve(stored.contacts.size());
+        for (auto &contact : stored.contacts) {
+            RosterEntry entry;
+            entry.jid = std::move(contact.jid);
+            entry.name = std::move(contact.name);
+            entry.groups = std::move(contact.groups);
+            entry.subscriptionType = contact.subscriptionType;
+            entry.subscriptionPending = contact.subscriptionPending;
+            entry.version = stored.version;
+            if (hasFrom(entry.subscriptionType)) {
+                subscribers << entry.jid;
+            }
+            roster.entries.push_back(std::move(entry));
+        }
+        std::sort(roster.entries.begin(), roster.entries.end(), [](const RosterEntry &a, const RosterEntry &b) {
+            return a.jid < b.jid;
+        });
+        q->server()->setPresenceSubscribers(stored.owner, subscribers);
+    }
+    loaded = true;
+
+    const auto requests = std::exchange(pendingRequests, {});
+    for (const auto &request : requests) {
+        handleRequest(request);
+    }
+}
+
+void QXmppRosterExtensionPrivate::markDirty(const QString &owner)
+{
+    if (!storage) {
+        return;
+    }
+    dirtyRosters.insert(owner);
+    if (!writeTimer.isActive()) {
+        writeTimer.start();
+    }
+}
+
+// Writes the rosters changed since the last write to the storage in one
+// batch.
+void QXmppRosterExtensionPrivate::flush()
+{
+    writeTimer.stop();
+    if (!storage || dirtyRosters.isEmpty()) {
+        return;
+    }
+
+    QVector<QXmppServerRosterStorage::Roster> changed;
+    changed.reserve(dirtyRosters.size());
+    for (const auto &owner : std::as_const(dirtyRosters)) {
+        const auto &roster = rosters[owner];
+        QXmppServerRosterStorage::Roster stored;
+        stored.owner = owner;
+        stored.version = roster.version;
+        stored.contacts.reserve(int(roster.entries.size()) - roster.removedCount);
+        for (const auto &entry : roster.entries) {
+            if (!entry.removed) {
+                stored.contacts.push_back({ entry.jid, entry.name, entry.groups, entry.subscriptionType, entry.subscriptionPending });
+            }
+        }
+        changed.push_back(std::move(stored));
+    }
+    dirtyRosters.clear();
+    storage->storeRosters(changed);
+}
+
+///
+/// \class QXmppRosterExtension
+///
+/// \brief The QXmppRosterExtension class provides the rosters of the users of
+/// QXmppServer (RFC 6121).
+///
+/// Users can request their roster and add, change or remove contacts. Changes
+/// are pushed to all resources that have requested the roster. The
+/// subscription states are updated by the subscription presences the users
+/// exchange with their contacts, and the resulting presence subscribers are
+/// kept in the index of the server, see QXmppServer::presenceSubscribers().
+///
+/// \xep{0237, Roster Versioning} is supported: every change increases the
+/// version of the roster, and clients that already have a version only get
+/// the changes since then as roster pushes. The contacts of a user are kept in
+/// an array sorted by their JID together with the version of their last
+/// change, removed contacts are kept for a while for the deltas. Logging in
+/// with an up-to-date roster therefore doesn't cost anything, regardless of
+/// the size of the roster.
+///
+/// All rosters are kept in memory. A QXmppServerRosterStorage set with
+/// setStorage() is read once when the server is started, changes are written
+/// behind in batches.
+///
+/// \since QXmpp 1.6
+///
+/// \ingroup Core
+///
+
+///
+/// Constructs a roster extension.
+///
+QXmppRosterExtension::QXmppRosterExtension()
+    : d(std::make_unique<QXmppRosterExtensionPrivate>(this))
+{
+}
+
+QXmppRosterExtension::~QXmppRosterExtension() = default;
+
+///
+/// Returns the storage the rosters are persisted in.
+///
+QXmppServerRosterStorage *QXmppRosterExtension::storage() const
+{
+    return d->storage;
+}
+
+///
+/// Sets the storage the rosters are persisted in.
+///
+/// The storage needs to be set before the server is started and must outlive
+/// the extension. Without a storage, the rosters are lost when the server is
+/// stopped.
+///
+void QXmppRosterExtension::setStorage(QXmppServerRosterStorage *storage)
+{
+    d->storage = storage;
+}
+
+///
+/// Returns the time in milliseconds changed rosters are collected before they
+/// are written to the storage.
+///
+int QXmppRosterExtension::writeBehindDelay() const
+{
+    return d->writeTimer.interval();
+}
+
+///
+/// Sets the time in milliseconds changed rosters are collected before they
+/// are written to the storage.
+///
+/// The default is 1000 ms. The changes are also written when the extension is
+/// stopped.
+///
+void QXmppRosterExtension::setWriteBehindDelay(int msecs)
+{
+    d->writeTimer.setInterval(std::max(msecs, 0));
+}
+
+///
+/// Returns the current version of the roster of a user (\xep{0237}).
+///
+QString QXmppRosterExtension::rosterVersion(const QString &bareJid) const
+{
+    return QString::number(d->rosters.value(bareJid).version);
+}
+
+///
+/// Returns the contacts in the roster of a user, sorted by their JID.
+///
+QList<QXmppRosterIq::Item> QXmppRosterExtension::rosterItems(const QString &bareJid) const
+{
+    QList<QXmppRosterIq::Item> items;
+    const auto roster = d->rosters.constFind(bareJid);
+    if (roster != d->rosters.constEnd()) {
+        for (const auto &entry : roster->entries) {
+            if (!entry.removed) {
+                items << toItem(entry);
+            }
+        }
+    }
+    return items;
+}
+
+/// \cond
+QVector<QXmppServerExtension::StanzaFilter> QXmppRosterExtension::stanzaFilters() const
+{
+    return {
+        { QStringLiteral("iq"), ns_roster, {} },
+        { QStringLiteral("presence"), {}, {} },
+    };
+}
+
+bool QXmppRosterExtension::handleStanza(const QDomElement &element)
+{
+    if (element.tagName() == QLatin1String("presence")) {
+        return d->handlePresence(element);
+    }
+    if (element.tagName() == QLatin1String("iq") && element.firstChildElement().namespaceURI() == ns_roster) {
+        return d->handleRosterIq(element);
+    }
+    return false;
+}
+
+bool QXmppRosterExtension::start()
+{
+    server()->setRosterVersioningSupported(true);
+
+    connect(server(), &QXmppServer::clientDisconnected, this, [this](const QString &jid) {
+        const auto bareJid = QXmppUtils::jidToBareJid(jid);
+        const auto itr = d->interestedResources.find(bareJid);
+        if (itr != d->interestedResources.end()) {
+            itr->remove(jid);
+            if (itr->isEmpty()) {
+                d->interestedResources.erase(itr);
+            }
+        }
+    });
+
+    if (d->storage) {
+        d->loaded = false;
+        d->storage->loadRosters().then(this, [this](QVector<QXmppServerRosterStorage::Roster> &&rosters) {
+            d->load(std::move(rosters));
+        });
+    }
+    return true;
+}
+
+void QXmppRosterExtension::stop()
+{
+    server()->setRosterVersioningSupported(false);
+    disconnect(server(), &QXmppServer::clientDisconnected, this, nullptr);
+    d->flush();
+    d->interestedResources.clear();
+}
+/// \endcond
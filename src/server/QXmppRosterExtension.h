@@ -0,0 +1,47 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPROSTEREXTENSION_H
+#define QXMPPROSTEREXTENSION_H
+
+#include "QXmppRosterIq.h"
+#include "QXmppServerExtension.h"
+
+#include <memory>
+
+class QXmppRosterExtensionPrivate;
+class QXmppServerRosterStorage;
+
+class QXMPP_EXPORT QXmppRosterExtension : public QXmppServerExtension
+{
+    Q_OBJECT
+    Q_CLASSINFO("ExtensionName", "roster")
+
+public:
+    QXmppRosterExtension();
+    ~QXmppRosterExtension() override;
+
+    QXmppServerRosterStorage *storage() const;
+    void setStorage(QXmppServerRosterStorage *storage);
+
+    int writeBehindDelay() const;
+    void setWriteBehindDelay(int msecs);
+
+    QString rosterVersion(const QString &bareJid) const;
+    QList<QXmppRosterIq::Item> rosterItems(const QString &bareJid) const;
+
+    /// \cond
+    QVector<StanzaFilter> stanzaFilters() const override;
+    bool handleStanza(const QDomElement &stanza) override;
+    bool start() override;
+    void stop() override;
+    /// \endcond
+
+private:
+    const std::unique_ptr<QXmppRosterExtensionPrivate> d;
+
+    friend class QXmppRosterExtensionPrivate;
+};
+
+#endif  // QXMPPROSTEREXTENSION_H
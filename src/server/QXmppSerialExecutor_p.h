@@ -0,0 +1,104 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPSERIALEXECUTOR_P_H
+#define QXMPPSERIALEXECUTOR_P_H
+
+#include <deque>
+#include <functional>
+#include <utility>
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API. It exists for the convenience
+// of QXmppServer.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+namespace QXmpp::Private {
+
+//
+// Runs jobs in a thread pool, jobs with the same key one after another in the
+// order they have been added.
+//
+// Each key with pending jobs has a queue. Only the first job of a queue starts
+// a task in the pool, the task then runs the jobs of the queue until it is
+// empty, so jobs of different keys run in parallel and a busy key only
+// occupies one thread.
+//
+class KeyedSerialExecutor
+{
+public:
+    using Job = std::function<void()>;
+
+    ~KeyedSerialExecutor() { waitForDone(); }
+
+    int maxThreadCount() const { return m_pool.maxThreadCount(); }
+    void setMaxThreadCount(int count) { m_pool.setMaxThreadCount(count); }
+
+    void run(const QString &key, Job job)
+    {
+        bool start = false;
+        {
+            QMutexLocker locker(&m_mutex);
+            auto &queue = m_queues[key];
+            start = queue.empty();
+            queue.push_back(std::move(job));
+        }
+        if (start) {
+            m_pool.start([this, key] { drain(key); });
+        }
+    }
+
+    // Returns the number of keys with pending or running jobs.
+    int activeKeyCount() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_queues.size();
+    }
+
+    void waitForDone() { m_pool.waitForDone(); }
+
+private:
+    void drain(const QString &key)
+    {
+        QMutexLocker locker(&m_mutex);
+        for (;;) {
+            // the queue is only removed by this task, the front stays in place
+            auto &queue = m_queues[key];
+            auto job = std::move(queue.front());
+            locker.unlock();
+
+            job();
+            job = {};
+
+            locker.relock();
+            auto &current = m_queues[key];
+            current.pop_front();
+            if (current.empty()) {
+                m_queues.remove(key);
+                return;
+            }
+        }
+    }
+
+    mutable QMutex m_mutex;
+    QHash<QString, std::deque<Job>> m_queues;
+    QThreadPool m_pool;
+};
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPSERIALEXECUTOR_P_H
@@ -4,25 +4,53 @@
 
 #include "QXmppServer.h"
 
+#include "QXmppClusterLink_p.h"
 #include "QXmppConstants_p.h"
 #include "QXmppDialback.h"
+#include "QXmppDialbackCache_p.h"
 #include "QXmppIncomingClient.h"
 #include "QXmppIncomingServer.h"
 #include "QXmppIq.h"
+#include "QXmppJid.h"
+#include "QXmppMessage.h"
+#include "QXmppMetrics.h"
+#include "QXmppOfflineMessageStorage.h"
 #include "QXmppOutgoingServer.h"
 #include "QXmppPresence.h"
+#include "QXmppSerialExecutor_p.h"
 #include "QXmppServerExtension.h"
 #include "QXmppServerPlugin.h"
+#include "QXmppSessionRegistry.h"
+#include "QXmppSubscriberIndex_p.h"
+#include "QXmppTask.h"
+#include "QXmppTokenBucket_p.h"
+#include "QXmppTracing_p.h"
 #include "QXmppUtils.h"
 
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <utility>
+
 #include <QCoreApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDeadlineTimer>
+#include <QDomDocument>
 #include <QDomElement>
+#include <QElapsedTimer>
 #include <QFileInfo>
 #include <QPluginLoader>
 #include <QSslCertificate>
 #include <QSslConfiguration>
 #include <QSslKey>
 #include <QSslSocket>
+#include <QTcpServer>
+#include <QThread>
+#include <QTimer>
+#include <QVarLengthArray>
 
 static void helperToXmlAddDomElement(QXmlStreamWriter *stream, const QDomElement &element, const QStringList &omitNamespaces)
 {
@@ -52,20 +80,141 @@ static void helperToXmlAddDomElement(QXmlStreamWriter *stream, const QDomElement
     stream->writeEndElement();
 }
 
+// Splits a serialized stanza after its element name and drops its 'to'
+// attribute, so it can be sent to several recipients with a new address.
+static std::pair<QByteArray, QByteArray> splitStanza(QByteArray data)
+{
+    // attribute values are escaped so this can't match inside of another value
+    const auto tagEnd = data.indexOf('>');
+    if (const auto toStart = data.indexOf(" to=\""); toStart >= 0 && toStart < tagEnd) {
+        const auto toEnd = data.indexOf('"', toStart + 5) + 1;
+        data.remove(toStart, toEnd - toStart);
+    }
+
+    int nameEnd = 1;
+    while (nameEnd < data.size() && data[nameEnd] != ' ' && data[nameEnd] != '>' && data[nameEnd] != '/') {
+        nameEnd++;
+    }
+    return { data.left(nameEnd), data.mid(nameEnd) };
+}
+
+// Connections in worker threads have no parent, so their log messages are
+// relayed explicitly.
+static void relayLogging(QXmppLoggable *from, QXmppLoggable *to)
+{
+    QObject::connect(from, &QXmppLoggable::logMessage,
+                     to, &QXmppLoggable::logMessage);
+    QObject::connect(from, &QXmppLoggable::setGauge,
+                     to, &QXmppLoggable::setGauge);
+    QObject::connect(from, &QXmppLoggable::updateCounter,
+                     to, &QXmppLoggable::updateCounter);
+}
+
 class QXmppServerPrivate
 {
 public:
+    // resolved destination of a 'to' address
+    struct Route
+    {
+        QVector<QXmppIncomingClient *> clients;
+        QXmppOutgoingServer *server = nullptr;
+        // XEP-0288: incoming stream the remote server accepts stanzas on
+        QXmppIncomingServer *incomingServer = nullptr;
+        // links to the other nodes of the cluster with sessions of the
+        // recipient
+        QVector<QXmpp::Private::ClusterLink *> links;
+    };
+
     QXmppServerPrivate(QXmppServer *qq);
     void loadExtensions(QXmppServer *server);
+    Route resolveRoute(const QString &to);
     bool routeData(const QString &to, const QByteArray &data);
+    bool routeData(const QString &to, const QByteArray &head, const QByteArray &body);
+    bool routeFromAnyThread(const QString &to, QByteArray &&data);
+    QXmppOutgoingServer *connectToServer(const QString &remoteDomain);
+    void removeOutgoingServer(QXmppOutgoingServer *stream);
+    void closeIdleOutgoingServers();
+    void setupIncomingClient(QXmppIncomingClient *stream);
+    bool unregisterIncomingClient(QXmppIncomingClient *stream);
+    void setupIncomingServer(QXmppIncomingServer *stream);
+
+    // admission control of client connections
+    bool canAdmitClient();
+    void startIncomingClient(QSslSocket *socket);
+    void processAdmissionQueue();
+    void rejectConnection(QSslSocket *socket, bool shutdown);
+    void rejectQueuedConnections();
+
+    // listening sockets
+    QXmppSslServer *createSslServer(bool forClients, bool directTls);
+    bool listen(bool forClients, bool directTls, const QHostAddress &address, quint16 port);
+    bool adoptListener(bool forClients, bool directTls, qintptr socketDescriptor);
+    QVector<qintptr> listenerDescriptors(bool forClients, bool directTls) const;
+    void startServing();
+
+    // worker threads
+    void startWorkers();
+    void stopWorkers();
+    int acquireWorker();
+    void releaseWorker(QObject *stream);
+    template<typename Function>
+    void runInWorker(int worker, Function function);
+    template<typename Function>
+    void runInThreadOf(QObject *stream, Function function);
     void startExtensions();
     void stopExtensions();
+    void recordHandlingTime(QXmppServerExtension *extension, const QDomElement &stanza, qint64 nsecs);
+    void buildExtensionIndex();
+    bool handleByExtensions(const QDomElement &element, int firstExtension = 0);
+    void offloadStanza(QXmppServerExtension *extension, const QDomElement &element);
+    void handleStanza(const QDomElement &element);
+    void bounceStanza(const QByteArray &data);
+
+    // offline messages
+    bool storeOfflineMessage(const QDomElement &element);
+    void flushOfflineMessages();
+    void replayOfflineMessages(QXmppIncomingClient *stream);
+
+    // presence broadcasts
+    int broadcastPresence(const QString &from, QByteArray data, bool available);
+
+    // clustering
+    void addRemoteSession(const QString &jid, const QString &node);
+    void removeRemoteSession(const QString &jid, const QString &node);
+    void deliverFromPeer(const QString &to, const QByteArray &data);
 
     void info(const QString &message);
     void warning(const QString &message);
 
     QString domain;
+    // sorted by priority
     QList<QXmppServerExtension *> extensions;
+
+    // Extensions by the tag name and payload namespace of the stanzas they
+    // handle, empty keys match any value. Rebuilt when extensions are added.
+    struct ExtensionFilter
+    {
+        // index in extensions
+        int extension;
+        QString to;
+    };
+    QHash<QPair<QString, QString>, QVector<ExtensionFilter>> extensionIndex;
+    QHash<QXmppServerExtension *, QVector<QXmppServerExtension::StanzaFilter>> extensionFilters;
+    bool extensionIndexValid = false;
+    // offloadable extensions and the pool running their stanzas, serialized
+    // by the sender JID
+    QSet<QXmppServerExtension *> offloadableExtensions;
+    KeyedSerialExecutor extensionExecutor;
+
+    struct ExtensionCounters
+    {
+        quint64 stanzas = 0;
+        // in nanoseconds
+        qint64 handlingTime = 0;
+    };
+    QHash<QXmppServerExtension *, ExtensionCounters> extensionCounters;
+    // handling time in ms above which extensions are reported, disabled if 0
+    int slowHandlerThreshold = 0;
     QXmppLogger *logger;
     QXmppPasswordChecker *passwordChecker;
 
@@ -73,13 +222,110 @@ public:
     QSet<QXmppIncomingClient *> incomingClients;
     QHash<QString, QXmppIncomingClient *> incomingClientsByJid;
     QHash<QString, QSet<QXmppIncomingClient *>> incomingClientsByBareJid;
+
+    // XEP-0198: Stream Management sessions by id, they stay registered while
+    // they are kept for resumption. Resumed streams take over the routes of
+    // the previous stream before they report to be connected.
+    QHash<QString, QXmppIncomingClient *> incomingClientsByStreamManagementId;
+    QSet<QXmppIncomingClient *> resumedClients;
+    int streamResumptionTimeout = 300;
+    qint64 streamManagementQueueLimit = 1024 * 1024;
+    // XEP-0237: Roster Versioning, enabled by the roster extension
+    bool rosterVersioningSupported = false;
     QSet<QXmppSslServer *> serversForClients;
 
+    // Admission control: client connections that have not bound a resource yet
+    // are limited, as is the rate new connections are started at. Connections
+    // exceeding the limits wait in a queue until their deadline, connections
+    // that don't fit into the queue are rejected right away.
+    struct QueuedConnection
+    {
+        QSslSocket *socket;
+        QDeadlineTimer deadline;
+    };
+    QSet<QXmppIncomingClient *> pendingClients;
+    int maximumPendingClients = 0;
+    QXmpp::Private::TokenBucket acceptBucket;
+    QElapsedTimer acceptClock;
+    std::deque<QueuedConnection> admissionQueue;
+    int admissionQueueSize = 1000;
+    int admissionQueueTimeout = 10000;
+    QString overloadRedirectHost;
+    QTimer *admissionTimer = nullptr;
+
     // server-to-server
     QSet<QXmppIncomingServer *> incomingServers;
     QSet<QXmppOutgoingServer *> outgoingServers;
+    QHash<QString, QXmppOutgoingServer *> outgoingServersByDomain;
+    QHash<QString, QXmppIncomingServer *> bidirectionalServersByDomain;
     QSet<QXmppSslServer *> serversForServers;
 
+    // Time the outgoing streams have last been used at. Idle streams are
+    // closed, traffic may have moved to a bidirectional incoming stream.
+    QHash<QXmppOutgoingServer *, qint64> outgoingServerLastUsed;
+    QElapsedTimer clock;
+    QTimer *idleTimer = nullptr;
+    int outgoingServerIdleTimeout = 0;
+    // limits of the queues of outgoing streams waiting for the dialback
+    qint64 outgoingServerQueueSize = 1024 * 1024;
+    int outgoingServerQueueTimeout = 60000;
+    QXmppOutgoingServer::QueueOverflowPolicy outgoingServerQueueOverflowPolicy = QXmppOutgoingServer::Bounce;
+
+    // successful dialback verifications, shared with the incoming streams
+    std::shared_ptr<QXmpp::Private::DialbackCache> dialbackCache;
+
+    // Messages for local users without online resources. They are collected
+    // and added to the storage in batches, one transaction per batch.
+    QXmppOfflineMessageStorage *offlineMessageStorage = nullptr;
+    int offlineMessageQuota = 100;
+    QVector<QXmppOfflineMessageStorage::Message> offlineQueue;
+    qint64 offlineQueueBytes = 0;
+    QTimer *offlineFlushTimer = nullptr;
+
+    // Users receiving the presences of a contact, and the last presence
+    // broadcast for each full JID without its 'to' address. Presences that
+    // have not changed are not broadcast again.
+    QXmpp::Private::SubscriberIndex subscriberIndex;
+    QHash<QString, QByteArray> lastPresences;
+
+    // Routes by 'to' address, cleared whenever a connection is added or
+    // removed, so the cached pointers are always valid.
+    QHash<QString, Route> routeCache;
+
+    // Clustering: the nodes serving the domain share a registry of the client
+    // sessions. The sessions of the other nodes are mirrored here, so routing
+    // never waits for the registry, and stanzas for them are forwarded on the
+    // links to the nodes.
+    QString clusterNode;
+    QByteArray clusterSecret;
+    QXmppSessionRegistry *sessionRegistry = nullptr;
+    // nodes by full JID, and the number of sessions on each node by bare JID
+    QHash<QString, QString> remoteSessions;
+    QHash<QString, QHash<QString, int>> remoteNodesByBareJid;
+    QHash<QString, QXmpp::Private::ClusterLink *> clusterLinks;
+    QSet<QTcpServer *> serversForPeers;
+    QSet<QXmpp::Private::ClusterConnection *> clusterConnections;
+
+    // Event loop threads for the connections. Routing tables are only used
+    // from the server's thread, connections report changes with queued signals.
+    struct Worker
+    {
+        QThread *thread = nullptr;
+        // object living in the worker thread to run functions in it
+        QObject *context = nullptr;
+        int connections = 0;
+    };
+    int workerThreadCount = 0;
+    // write batching of the streams
+    int writeBatchSize = 0;
+    int writeBatchDelay = 0;
+    // rate limits of the incoming client streams
+    double clientStanzaRateLimit = 0;
+    qint64 clientByteRateLimit = 0;
+    qint64 maximumStanzaSize = 0;
+    QVector<Worker> workers;
+    QHash<QObject *, int> workerByStream;
+
     // ssl
     QList<QSslCertificate> caCertificates;
     QSslCertificate localCertificate;
@@ -98,323 +344,2203 @@ QXmppServerPrivate::QXmppServerPrivate(QXmppServer *qq)
       started(false),
       q(qq)
 {
+    clock.start();
 }
 
-/// Routes XMPP data to the given recipient.
+/// Runs the function in the given worker thread and waits for it to finish.
+///
+/// \param worker
+/// \param function
+
+template<typename Function>
+void QXmppServerPrivate::runInWorker(int worker, Function function)
+{
+    QMetaObject::invokeMethod(workers[worker].context, function, Qt::BlockingQueuedConnection);
+}
+
+/// Runs a function in the thread of a stream and waits for it.
+///
+/// Data routed to the stream before is handled by the stream first.
+///
+/// \param stream
+/// \param function
+
+template<typename Function>
+void QXmppServerPrivate::runInThreadOf(QObject *stream, Function function)
+{
+    if (stream->thread() == QThread::currentThread()) {
+        QCoreApplication::sendPostedEvents(stream, QEvent::MetaCall);
+        function();
+    } else {
+        QMetaObject::invokeMethod(stream, function, Qt::BlockingQueuedConnection);
+    }
+}
+
+// maximum number of cached routes, the cache is reset when it is reached
+constexpr int MAX_CACHED_ROUTES = 4096;
+// time in ms after which rejected connections are aborted if the stream error
+// could not be written
+constexpr int REJECTED_CONNECTION_TIMEOUT = 5000;
+// version of the format of the sessions passed by handOver()
+constexpr quint32 HAND_OVER_FORMAT_VERSION = 1;
+
+/// Looks up the connections for the given recipient.
 ///
 /// \param to
-/// \param data
 ///
 
-bool QXmppServerPrivate::routeData(const QString &to, const QByteArray &data)
+QXmppServerPrivate::Route QXmppServerPrivate::resolveRoute(const QString &to)
 {
+    Route route;
+
     // refuse to route packets to empty destination, own domain or sub-domains
-    const QString toDomain = QXmppUtils::jidToDomain(to);
-    if (to.isEmpty() || to == domain || toDomain.endsWith("." + domain)) {
-        return false;
+    const QXmppJid toJid(to);
+    const auto toDomain = toJid.domain();
+    if (to.isEmpty() || to == domain || toDomain.endsWith(QLatin1Char('.') + domain)) {
+        return route;
     }
 
     if (toDomain == domain) {
         // look for a client connection
-        QList<QXmppIncomingClient *> found;
-        if (QXmppUtils::jidToResource(to).isEmpty()) {
+        if (toJid.isBare()) {
             const auto &connections = incomingClientsByBareJid.value(to);
+            route.clients.reserve(connections.size());
             for (auto *conn : connections) {
-                found << conn;
-            }
-        } else {
-            QXmppIncomingClient *conn = incomingClientsByJid.value(to);
-            if (conn) {
-                found << conn;
+                route.clients << conn;
             }
+        } else if (auto *conn = incomingClientsByJid.value(to)) {
+            route.clients << conn;
         }
 
-        // send data
-        for (auto *conn : std::as_const(found)) {
-            QMetaObject::invokeMethod(conn, "sendData", Q_ARG(QByteArray, data));
+        // look for sessions on other nodes of the cluster
+        if (toJid.isBare()) {
+            const auto nodes = remoteNodesByBareJid.constFind(to);
+            if (nodes != remoteNodesByBareJid.constEnd()) {
+                for (auto node = nodes->keyBegin(); node != nodes->keyEnd(); ++node) {
+                    if (auto *link = clusterLinks.value(*node)) {
+                        route.links << link;
+                    }
+                }
+            }
+        } else if (route.clients.isEmpty()) {
+            if (auto *link = clusterLinks.value(remoteSessions.value(to))) {
+                route.links << link;
+            }
         }
-        return !found.isEmpty();
-
     } else if (!serversForServers.isEmpty()) {
-
-        // look for an outgoing S2S connection
-        for (auto *conn : std::as_const(outgoingServers)) {
-            if (conn->remoteDomain() == toDomain) {
-                // send or queue data
-                QMetaObject::invokeMethod(conn, "queueData", Q_ARG(QByteArray, data));
-                return true;
+        // prefer a bidirectional incoming stream, then look for an outgoing
+        // S2S connection, if there is none we need to establish it
+        const auto remoteDomain = toDomain.toString();
+        route.incomingServer = bidirectionalServersByDomain.value(remoteDomain);
+        if (!route.incomingServer) {
+            route.server = outgoingServersByDomain.value(remoteDomain);
+            if (!route.server) {
+                route.server = connectToServer(remoteDomain);
             }
         }
+    }
 
-        // if we did not find an outgoing server,
-        // we need to establish the S2S connection
-        auto *conn = new QXmppOutgoingServer(domain, nullptr);
-        conn->setLocalStreamKey(QXmppUtils::generateStanzaHash().toLatin1());
-        conn->moveToThread(q->thread());
-        conn->setParent(q);
+    // an empty route means the data can't be delivered, e.g. because S2S is disabled
+    return route;
+}
 
-        QObject::connect(conn, &QXmppStream::disconnected,
-                         q, &QXmppServer::_q_outgoingServerDisconnected);
+/// Routes XMPP data to the given recipient.
+///
+/// \param to
+/// \param data
+///
+
+bool QXmppServerPrivate::routeData(const QString &to, const QByteArray &data)
+{
+    return routeData(to, QByteArray(), data);
+}
+
+/// Routes XMPP data from any thread. Data from other threads is routed in the
+/// thread of the server, true is returned then.
+///
+/// \param to
+/// \param data
+///
+
+bool QXmppServerPrivate::routeFromAnyThread(const QString &to, QByteArray &&data)
+{
+    if (QThread::currentThread() == q->thread()) {
+        return routeData(to, data);
+    }
+    QMetaObject::invokeMethod(q, [this, to, data = std::move(data)] { routeData(to, data); });
+    return true;
+}
+
+/// Routes XMPP data made of a per-recipient head and a shared body to the
+/// given recipient.
+///
+/// The parts are only joined in the thread of the connection, so the body
+/// can be shared by all recipients of a broadcast.
+///
+/// \param to
+/// \param head
+/// \param body
+///
+
+bool QXmppServerPrivate::routeData(const QString &to, const QByteArray &head, const QByteArray &body)
+{
+    auto itr = routeCache.constFind(to);
+    if (itr == routeCache.constEnd()) {
+        auto route = resolveRoute(to);
+        if (routeCache.size() >= MAX_CACHED_ROUTES) {
+            routeCache.clear();
+        }
+        itr = routeCache.insert(to, std::move(route));
+    }
 
-        // add stream
-        outgoingServers.insert(conn);
-        Q_EMIT q->setGauge("outgoing-server.count", outgoingServers.size());
+    // copy the route, sending data may close connections and reset the cache
+    const Route route = *itr;
 
-        // queue data and connect to remote server
-        QMetaObject::invokeMethod(conn, "queueData", Q_ARG(QByteArray, data));
-        QMetaObject::invokeMethod(conn, "connectToHost", Q_ARG(QString, toDomain));
+    if (route.incomingServer) {
+        // the stream is verified, the data can be sent right away
+        auto *conn = route.incomingServer;
+        QMetaObject::invokeMethod(conn, [conn, head, body] { conn->sendData(head.isEmpty() ? body : head + body); });
         return true;
+    }
 
-    } else {
+    if (route.server) {
+        // send or queue data
+        auto *conn = route.server;
+        outgoingServerLastUsed[conn] = clock.elapsed();
+        QMetaObject::invokeMethod(conn, [conn, head, body] { conn->queueData(head.isEmpty() ? body : head + body); });
+        return true;
+    }
 
-        // S2S is disabled, failed to route data
+    // send data
+    for (auto *conn : route.clients) {
+        QMetaObject::invokeMethod(conn, [conn, head, body] { conn->sendStanzaData(head.isEmpty() ? body : head + body); });
+    }
+    // the links write in the thread of the server
+    for (auto *link : route.links) {
+        link->send(to, head.isEmpty() ? body : head + body);
+    }
+    if (route.clients.isEmpty() && route.links.isEmpty()) {
+        QXmppMetrics::increment(QXmppMetrics::RoutingFailures);
         return false;
     }
+    return true;
 }
 
-/// Handles an incoming XML element.
+/// Creates a new S2S connection to the given domain.
+///
+/// \param remoteDomain
+///
+
+QXmppOutgoingServer *QXmppServerPrivate::connectToServer(const QString &remoteDomain)
+{
+    QXmppOutgoingServer *conn = nullptr;
+    const auto create = [&] {
+        conn = new QXmppOutgoingServer(domain, nullptr);
+        conn->setLocalStreamKey(QXmppUtils::generateStanzaHash().toLatin1());
+        conn->setWriteBatchSize(writeBatchSize);
+        conn->setWriteBatchDelay(writeBatchDelay);
+        conn->setMaximumStanzaSize(maximumStanzaSize);
+        conn->setQueueLimit(outgoingServerQueueSize, outgoingServerQueueTimeout);
+        conn->setQueueOverflowPolicy(outgoingServerQueueOverflowPolicy);
+
+        QObject::connect(conn, &QXmppStream::disconnected,
+                         q, &QXmppServer::_q_outgoingServerDisconnected);
+        QObject::connect(conn, &QXmppOutgoingServer::queuedDataDropped, q, [this](const QByteArray &data, bool bounce) {
+            if (bounce) {
+                bounceStanza(data);
+            }
+        });
+    };
+
+    const int worker = acquireWorker();
+    if (worker < 0) {
+        create();
+        conn->moveToThread(q->thread());
+        conn->setParent(q);
+    } else {
+        // create the stream in the worker, so all of its members live there
+        runInWorker(worker, [&] {
+            create();
+            relayLogging(conn, q);
+        });
+        workerByStream.insert(conn, worker);
+    }
+
+    // add stream
+    outgoingServers.insert(conn);
+    outgoingServersByDomain.insert(remoteDomain, conn);
+    outgoingServerLastUsed.insert(conn, clock.elapsed());
+    routeCache.clear();
+    QXmppMetrics::setGauge(QXmppMetrics::OutgoingServers, outgoingServers.size());
+
+    // connect to remote server, data is queued until the connection is established
+    QMetaObject::invokeMethod(conn, [conn, remoteDomain] { conn->connectToHost(remoteDomain); });
+    return conn;
+}
+
+/// Removes an outgoing S2S connection from the routing tables and destroys it.
 ///
-/// \param server
 /// \param stream
-/// \param element
 
-static void handleStanza(QXmppServer *server, const QDomElement &element)
+void QXmppServerPrivate::removeOutgoingServer(QXmppOutgoingServer *stream)
 {
-    // try extensions
-    const auto &extensions = server->extensions();
-    for (auto *extension : extensions) {
-        if (extension->handleStanza(element)) {
-            return;
+    if (!outgoingServers.remove(stream)) {
+        return;
+    }
+
+    for (auto itr = outgoingServersByDomain.begin(); itr != outgoingServersByDomain.end();) {
+        if (itr.value() == stream) {
+            itr = outgoingServersByDomain.erase(itr);
+        } else {
+            ++itr;
         }
     }
+    outgoingServerLastUsed.remove(stream);
+    routeCache.clear();
+    releaseWorker(stream);
+    stream->deleteLater();
+    QXmppMetrics::setGauge(QXmppMetrics::OutgoingServers, outgoingServers.size());
+}
 
-    // default handlers
-    const QString domain = server->domain();
-    const QString to = element.attribute("to");
-    if (to == domain) {
-        if (element.tagName() == QLatin1String("iq")) {
-            // we do not support the given IQ
-            QXmppIq request;
-            request.parse(element);
+/// Closes the outgoing S2S connections that have not been used for the idle
+/// timeout.
 
-            if (request.type() != QXmppIq::Error && request.type() != QXmppIq::Result) {
-                QXmppIq response(QXmppIq::Error);
-                response.setId(request.id());
-                response.setFrom(domain);
-                response.setTo(request.from());
-                QXmppStanza::Error error(QXmppStanza::Error::Cancel,
-                                         QXmppStanza::Error::FeatureNotImplemented);
-                response.setError(error);
-                server->sendPacket(response);
+void QXmppServerPrivate::closeIdleOutgoingServers()
+{
+    const auto now = clock.elapsed();
+
+    QVector<QXmppOutgoingServer *> idleStreams;
+    for (auto itr = outgoingServerLastUsed.cbegin(); itr != outgoingServerLastUsed.cend(); ++itr) {
+        if (now - itr.value() >= outgoingServerIdleTimeout) {
+            idleStreams << itr.key();
+        }
+    }
+
+    for (auto *stream : std::as_const(idleStreams)) {
+        info(QStringLiteral("Closing idle outgoing server stream to %1").arg(outgoingServersByDomain.key(stream)));
+
+        // the stream may still be looking up the host and never report a
+        // disconnection, so it is removed right away
+        QObject::disconnect(stream, &QXmppStream::disconnected,
+                            q, &QXmppServer::_q_outgoingServerDisconnected);
+        QMetaObject::invokeMethod(stream, [stream] { stream->disconnectFromHost(); });
+        removeOutgoingServer(stream);
+    }
+}
+
+/// Prepares an incoming client stream for use by the server.
+///
+/// \param stream
+
+void QXmppServerPrivate::setupIncomingClient(QXmppIncomingClient *stream)
+{
+    stream->setPasswordChecker(passwordChecker);
+    stream->setWriteBatchSize(writeBatchSize);
+    stream->setWriteBatchDelay(writeBatchDelay);
+    stream->setReceiveRateLimit(clientStanzaRateLimit, clientByteRateLimit);
+    stream->setMaximumStanzaSize(maximumStanzaSize);
+    stream->setStreamResumptionTimeout(streamResumptionTimeout);
+    stream->setStreamManagementQueueLimit(streamManagementQueueLimit);
+    stream->setRosterVersioningSupported(rosterVersioningSupported);
+
+    QObject::connect(stream, &QXmppStream::connected,
+                     q, &QXmppServer::_q_clientConnected);
+
+    QObject::connect(stream, &QXmppStream::disconnected,
+                     q, &QXmppServer::_q_clientDisconnected);
+
+    QObject::connect(stream, &QXmppIncomingClient::streamResumptionRequested,
+                     q, &QXmppServer::_q_clientStreamResumptionRequested);
+
+    QObject::connect(stream, &QXmppIncomingClient::elementReceived,
+                     q, &QXmppServer::handleElement);
+}
+
+/// Removes an incoming client stream from the routing tables.
+///
+/// \param stream
+///
+/// \return whether the client was available
+
+bool QXmppServerPrivate::unregisterIncomingClient(QXmppIncomingClient *stream)
+{
+    const auto smId = incomingClientsByStreamManagementId.constFind(stream->streamManagementId());
+    if (smId != incomingClientsByStreamManagementId.constEnd() && smId.value() == stream) {
+        incomingClientsByStreamManagementId.erase(smId);
+    }
+    resumedClients.remove(stream);
+
+    const QString jid = stream->jid();
+    bool wasAvailable = false;
+    if (!jid.isEmpty()) {
+        if (incomingClientsByJid.value(jid) == stream) {
+            incomingClientsByJid.remove(jid);
+            wasAvailable = lastPresences.contains(jid);
+            if (sessionRegistry) {
+                sessionRegistry->removeSession(jid, clusterNode);
+            }
+        }
+        const QString bareJid = QXmppUtils::jidToBareJid(jid);
+        if (incomingClientsByBareJid.contains(bareJid)) {
+            incomingClientsByBareJid[bareJid].remove(stream);
+            if (incomingClientsByBareJid[bareJid].isEmpty()) {
+                incomingClientsByBareJid.remove(bareJid);
             }
         }
+        routeCache.clear();
+    }
+    return wasAvailable;
+}
 
-    } else {
+/// Returns whether a new client connection can be started now, i.e. neither
+/// the limit of pending clients nor the accept rate is exceeded.
 
-        // route element or reply on behalf of missing peer
-        if (!server->sendElement(element) && element.tagName() == QLatin1String("iq")) {
-            QXmppIq request;
-            request.parse(element);
+bool QXmppServerPrivate::canAdmitClient()
+{
+    if (maximumPendingClients > 0 && pendingClients.size() >= maximumPendingClients) {
+        return false;
+    }
+    if (acceptBucket.isEnabled()) {
+        acceptBucket.refill(acceptClock.restart());
+        return acceptBucket.available() >= 1;
+    }
+    return true;
+}
 
-            QXmppIq response(QXmppIq::Error);
-            response.setId(request.id());
-            response.setFrom(request.to());
-            response.setTo(request.from());
-            QXmppStanza::Error error(QXmppStanza::Error::Cancel,
-                                     QXmppStanza::Error::ServiceUnavailable);
-            response.setError(error);
-            server->sendPacket(response);
+/// Creates the stream for an admitted client connection.
+///
+/// \param socket
+
+void QXmppServerPrivate::startIncomingClient(QSslSocket *socket)
+{
+    if (acceptBucket.isEnabled()) {
+        acceptBucket.consume(1);
+    }
+
+    // the stream only reads on new data, so data received while the
+    // connection was queued needs to be announced again
+    const auto readBufferedData = [socket] {
+        if (socket->bytesAvailable() > 0) {
+            QMetaObject::invokeMethod(socket, [socket] { Q_EMIT socket->readyRead(); }, Qt::QueuedConnection);
+        }
+    };
+
+    // queued sockets are owned by the server
+    socket->setParent(nullptr);
+
+    const int worker = acquireWorker();
+    if (worker < 0) {
+        auto *stream = new QXmppIncomingClient(socket, domain, q);
+        stream->setInactivityTimeout(120);
+        socket->setParent(stream);
+        q->addIncomingClient(stream);
+        readBufferedData();
+        return;
+    }
+
+    // create the stream in the worker, so all of its members live there
+    QXmppIncomingClient *stream = nullptr;
+    socket->moveToThread(workers[worker].thread);
+    runInWorker(worker, [&] {
+        stream = new QXmppIncomingClient(socket, domain, nullptr);
+        stream->setInactivityTimeout(120);
+        socket->setParent(stream);
+        relayLogging(stream, q);
+        setupIncomingClient(stream);
+        readBufferedData();
+    });
+    workerByStream.insert(stream, worker);
+
+    // add stream
+    incomingClients.insert(stream);
+    pendingClients.insert(stream);
+    QXmppMetrics::setGauge(QXmppMetrics::IncomingClients, incomingClients.size());
+}
+
+/// Starts the queued client connections the limits allow, rejects those that
+/// have waited for too long and schedules the next run.
+
+void QXmppServerPrivate::processAdmissionQueue()
+{
+    while (!admissionQueue.empty()) {
+        auto *socket = admissionQueue.front().socket;
+        if (socket->state() != QAbstractSocket::ConnectedState) {
+            admissionQueue.pop_front();
+            QObject::disconnect(socket, nullptr, q, nullptr);
+            socket->deleteLater();
+        } else if (admissionQueue.front().deadline.hasExpired()) {
+            admissionQueue.pop_front();
+            rejectConnection(socket, false);
+        } else if (canAdmitClient()) {
+            admissionQueue.pop_front();
+            QObject::disconnect(socket, nullptr, q, nullptr);
+            startIncomingClient(socket);
+        } else {
+            break;
+        }
+    }
+    QXmppMetrics::setGauge(QXmppMetrics::ClientAdmissionQueueLength, qint64(admissionQueue.size()));
+
+    if (admissionQueue.empty()) {
+        if (admissionTimer) {
+            admissionTimer->stop();
+        }
+        return;
+    }
+
+    // Connections waiting for a token are started by the timer, those waiting
+    // for a pending client to bind a resource or to disconnect are started then.
+    // Deadlines are in queue order, they may also be infinite.
+    qint64 delay = admissionQueue.front().deadline.remainingTime();
+    if (const auto tokenDelay = acceptBucket.msecsUntilAvailable(); tokenDelay > 0) {
+        delay = delay < 0 ? tokenDelay : std::min(delay, tokenDelay);
+    }
+    if (delay < 0) {
+        if (admissionTimer) {
+            admissionTimer->stop();
         }
+        return;
+    }
+    if (!admissionTimer) {
+        admissionTimer = new QTimer(q);
+        admissionTimer->setSingleShot(true);
+        QObject::connect(admissionTimer, &QTimer::timeout, q, [this] {
+            processAdmissionQueue();
+        });
+    }
+    admissionTimer->start(int(std::clamp<qint64>(delay, 0, std::numeric_limits<int>::max())));
+}
+
+/// Closes a client connection that has not been admitted with a stream error.
+///
+/// \param socket
+/// \param shutdown whether the server is closed, otherwise it is overloaded
+
+void QXmppServerPrivate::rejectConnection(QSslSocket *socket, bool shutdown)
+{
+    QObject::disconnect(socket, nullptr, q, nullptr);
+    QXmppMetrics::increment(QXmppMetrics::RejectedClientConnections);
+
+    if (socket->state() != QAbstractSocket::ConnectedState) {
+        socket->deleteLater();
+        return;
+    }
+
+    QString condition;
+    if (shutdown) {
+        condition = QStringLiteral("<system-shutdown xmlns='urn:ietf:params:xml:ns:xmpp-streams'/>");
+    } else if (!overloadRedirectHost.isEmpty()) {
+        condition = QStringLiteral("<see-other-host xmlns='urn:ietf:params:xml:ns:xmpp-streams'>%1</see-other-host>")
+                        .arg(overloadRedirectHost.toHtmlEscaped());
+    } else {
+        // the queue is emptied within its timeout, clients retrying later
+        // spread out their reconnections
+        condition = QStringLiteral("<resource-constraint xmlns='urn:ietf:params:xml:ns:xmpp-streams'/>"
+                                   "<retry-after xmlns='urn:qxmpp:retry-after:0' seconds='%1'/>")
+                        .arg(std::max(admissionQueueTimeout / 1000, 1));
+    }
+
+    // RFC 6120: the stream is opened before the error even if the client
+    // hasn't sent its stream header yet
+    socket->write(QStringLiteral("<?xml version='1.0'?>"
+                                 "<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams' from='%1' version='1.0'>"
+                                 "<stream:error>%2</stream:error></stream:stream>")
+                      .arg(domain.toHtmlEscaped(), condition)
+                      .toUtf8());
+
+    QObject::connect(socket, &QAbstractSocket::disconnected, socket, &QObject::deleteLater);
+    // don't wait for clients that don't read
+    QTimer::singleShot(REJECTED_CONNECTION_TIMEOUT, socket, [socket] { socket->abort(); });
+    socket->disconnectFromHost();
+}
+
+/// Closes all queued client connections with a \c <system-shutdown/> error.
+
+void QXmppServerPrivate::rejectQueuedConnections()
+{
+    while (!admissionQueue.empty()) {
+        auto *socket = admissionQueue.front().socket;
+        admissionQueue.pop_front();
+        rejectConnection(socket, true);
+    }
+    if (admissionTimer) {
+        admissionTimer->stop();
+    }
+    QXmppMetrics::setGauge(QXmppMetrics::ClientAdmissionQueueLength, 0);
+}
+
+/// Prepares an incoming server stream for use by the server.
+///
+/// \param stream
+
+void QXmppServerPrivate::setupIncomingServer(QXmppIncomingServer *stream)
+{
+    stream->setWriteBatchSize(writeBatchSize);
+    stream->setWriteBatchDelay(writeBatchDelay);
+    stream->setMaximumStanzaSize(maximumStanzaSize);
+    stream->setDialbackCache(dialbackCache);
+
+    QObject::connect(stream, &QXmppStream::disconnected,
+                     q, &QXmppServer::_q_serverDisconnected);
+
+    QObject::connect(stream, &QXmppIncomingServer::dialbackRequestReceived,
+                     q, &QXmppServer::_q_dialbackRequestReceived);
+
+    QObject::connect(stream, &QXmppIncomingServer::bidirectionalDomainVerified,
+                     q, &QXmppServer::_q_bidirectionalDomainVerified);
+
+    QObject::connect(stream, &QXmppIncomingServer::elementReceived,
+                     q, &QXmppServer::handleElement);
+}
+
+/// Creates a listening socket for client or server connections.
+///
+/// \param forClients
+/// \param directTls whether TLS is started on accept (\xep{0368})
+
+QXmppSslServer *QXmppServerPrivate::createSslServer(bool forClients, bool directTls)
+{
+    auto *server = new QXmppSslServer(q);
+    server->addCaCertificates(caCertificates);
+    server->setLocalCertificate(localCertificate);
+    server->setPrivateKey(privateKey);
+    if (directTls) {
+        server->setDirectTls(true);
+        server->setAlpnProtocols({ forClients ? QByteArrayLiteral("xmpp-client") : QByteArrayLiteral("xmpp-server") });
+    }
+
+    if (forClients) {
+        QObject::connect(server, &QXmppSslServer::newConnection,
+                         q, &QXmppServer::_q_clientConnection);
+    } else {
+        QObject::connect(server, &QXmppSslServer::newConnection,
+                         q, &QXmppServer::_q_serverConnection);
+    }
+    return server;
+}
+
+/// Starts listening for client or server connections.
+///
+/// \param forClients
+/// \param directTls
+/// \param address
+/// \param port
+
+bool QXmppServerPrivate::listen(bool forClients, bool directTls, const QHostAddress &address, quint16 port)
+{
+    if (domain.isEmpty()) {
+        warning("No domain was specified!");
+        return false;
+    }
+    if (directTls && (localCertificate.isNull() || privateKey.isNull())) {
+        warning(QStringLiteral("Direct TLS needs a local certificate and a private key!"));
+        return false;
+    }
+
+    auto *server = createSslServer(forClients, directTls);
+    if (!server->listen(address, port)) {
+        warning(QString("Could not start listening for %1 on %2 %3").arg(forClients ? QStringLiteral("C2S") : QStringLiteral("S2S"), address.toString(), QString::number(port)));
+        delete server;
+        return false;
+    }
+    (forClients ? serversForClients : serversForServers).insert(server);
+    routeCache.clear();
+    startServing();
+    return true;
+}
+
+/// Accepts client or server connections on a listening socket of another
+/// process.
+///
+/// \param forClients
+/// \param directTls
+/// \param socketDescriptor
+
+bool QXmppServerPrivate::adoptListener(bool forClients, bool directTls, qintptr socketDescriptor)
+{
+    if (domain.isEmpty()) {
+        warning("No domain was specified!");
+        return false;
     }
+
+    auto *server = createSslServer(forClients, directTls);
+    if (!server->setSocketDescriptor(socketDescriptor)) {
+        warning(QString("Could not adopt the %1 listening socket %2").arg(forClients ? QStringLiteral("C2S") : QStringLiteral("S2S"), QString::number(socketDescriptor)));
+        delete server;
+        return false;
+    }
+    (forClients ? serversForClients : serversForServers).insert(server);
+    routeCache.clear();
+    startServing();
+    return true;
+}
+
+/// Returns the descriptors of the listening sockets of one kind.
+///
+/// \param forClients
+/// \param directTls
+
+QVector<qintptr> QXmppServerPrivate::listenerDescriptors(bool forClients, bool directTls) const
+{
+    QVector<qintptr> descriptors;
+    for (auto *server : std::as_const(forClients ? serversForClients : serversForServers)) {
+        if (server->isDirectTls() == directTls) {
+            descriptors.append(server->socketDescriptor());
+        }
+    }
+    return descriptors;
+}
+
+/// Starts the workers and the extensions once the server listens.
+
+void QXmppServerPrivate::startServing()
+{
+    startWorkers();
+    loadExtensions(q);
+    startExtensions();
+}
+
+/// Starts the worker threads.
+
+void QXmppServerPrivate::startWorkers()
+{
+    if (!workers.isEmpty()) {
+        return;
+    }
+
+    for (int i = 0; i < workerThreadCount; ++i) {
+        Worker worker;
+        worker.thread = new QThread;
+        worker.thread->setObjectName(QStringLiteral("QXmppServer worker %1").arg(i));
+        worker.context = new QObject;
+        worker.context->moveToThread(worker.thread);
+        QObject::connect(worker.thread, &QThread::finished,
+                         worker.context, &QObject::deleteLater);
+        worker.thread->start();
+        workers << worker;
+    }
+}
+
+/// Stops the worker threads and destroys the connections living in them.
+
+void QXmppServerPrivate::stopWorkers()
+{
+    if (workers.isEmpty()) {
+        return;
+    }
+
+    // deferred deletions are processed when the threads finish
+    for (auto itr = workerByStream.cbegin(); itr != workerByStream.cend(); ++itr) {
+        itr.key()->deleteLater();
+    }
+    workerByStream.clear();
+    incomingClients.clear();
+    pendingClients.clear();
+    incomingClientsByJid.clear();
+    incomingClientsByBareJid.clear();
+    incomingServers.clear();
+    outgoingServers.clear();
+    outgoingServersByDomain.clear();
+    routeCache.clear();
+
+    for (const auto &worker : std::as_const(workers)) {
+        worker.thread->quit();
+        worker.thread->wait();
+        delete worker.thread;
+    }
+    workers.clear();
+}
+
+/// Returns the index of the least loaded worker for a new connection or -1 if
+/// connections are handled on the server's thread.
+
+int QXmppServerPrivate::acquireWorker()
+{
+    if (workers.isEmpty()) {
+        return -1;
+    }
+
+    int index = 0;
+    for (int i = 1; i < workers.size(); ++i) {
+        if (workers[i].connections < workers[index].connections) {
+            index = i;
+        }
+    }
+    workers[index].connections++;
+    return index;
+}
+
+/// Releases the worker of a connection that has been closed.
+///
+/// \param stream
+
+void QXmppServerPrivate::releaseWorker(QObject *stream)
+{
+    const auto itr = workerByStream.constFind(stream);
+    if (itr != workerByStream.constEnd()) {
+        workers[itr.value()].connections--;
+        workerByStream.erase(itr);
+    }
+}
+
+/// Handles an incoming XML element.
+///
+/// \param element
+
+void QXmppServerPrivate::handleStanza(const QDomElement &element)
+{
+    // default handlers
+    const QString to = element.attribute("to");
+    const bool isPresence = element.tagName() == QLatin1String("presence");
+    if (to == domain && !isPresence) {
+        if (element.tagName() == QLatin1String("iq")) {
+            // we do not support the given IQ
+            QXmppIq request;
+            request.parse(element);
+
+            if (request.type() != QXmppIq::Error && request.type() != QXmppIq::Result) {
+                QXmppIq response(QXmppIq::Error);
+                response.setId(request.id());
+                response.setFrom(domain);
+                response.setTo(request.from());
+                QXmppStanza::Error error(QXmppStanza::Error::Cancel,
+                                         QXmppStanza::Error::FeatureNotImplemented);
+                response.setError(error);
+                q->sendPacket(response);
+            }
+        }
+
+    } else if ((to.isEmpty() || to == domain) && isPresence) {
+
+        // send broadcast presence to the subscribers of the user, client
+        // streams address it to the domain
+        const QString type = element.attribute(QStringLiteral("type"));
+        if (type.isEmpty() || type == QLatin1String("unavailable")) {
+            QByteArray data;
+            QXmlStreamWriter xmlStream(&data);
+            helperToXmlAddDomElement(&xmlStream, element, QStringList() << ns_client << ns_server);
+            broadcastPresence(element.attribute(QStringLiteral("from")), std::move(data), type.isEmpty());
+        }
+
+    } else {
+
+        // route element, store it for an offline user or reply on behalf of
+        // missing peer
+        if (q->sendElement(element) || storeOfflineMessage(element)) {
+            return;
+        }
+        if (element.tagName() == QLatin1String("iq")) {
+            QXmppIq request;
+            request.parse(element);
+
+            QXmppIq response(QXmppIq::Error);
+            response.setId(request.id());
+            response.setFrom(request.to());
+            response.setTo(request.from());
+            QXmppStanza::Error error(QXmppStanza::Error::Cancel,
+                                     QXmppStanza::Error::ServiceUnavailable);
+            response.setError(error);
+            q->sendPacket(response);
+        }
+    }
+}
+
+/// Replies with an error to a stanza that could not be delivered to a remote
+/// server.
+///
+/// \param data
+
+void QXmppServerPrivate::bounceStanza(const QByteArray &data)
+{
+    QDomDocument document;
+    if (!document.setContent(data, true)) {
+        return;
+    }
+    const auto element = document.documentElement();
+    const auto type = element.attribute(QStringLiteral("type"));
+    const QXmppStanza::Error error(QXmppStanza::Error::Wait, QXmppStanza::Error::RemoteServerTimeout);
+
+    // errors are never answered, neither are IQ responses and presences
+    if (element.tagName() == u"iq" && (type == u"get" || type == u"set")) {
+        QXmppIq response(QXmppIq::Error);
+        response.setId(element.attribute(QStringLiteral("id")));
+        response.setFrom(element.attribute(QStringLiteral("to")));
+        response.setTo(element.attribute(QStringLiteral("from")));
+        response.setError(error);
+        q->sendPacket(response);
+    } else if (element.tagName() == u"message" && type != u"error") {
+        QXmppMessage response;
+        response.setType(QXmppMessage::Error);
+        response.setId(element.attribute(QStringLiteral("id")));
+        response.setFrom(element.attribute(QStringLiteral("to")));
+        response.setTo(element.attribute(QStringLiteral("from")));
+        response.setError(error);
+        q->sendPacket(response);
+    }
+}
+
+// queued messages are flushed after this time or once they reach this size
+constexpr int OFFLINE_FLUSH_DELAY = 50;
+constexpr qint64 OFFLINE_FLUSH_SIZE = 256 * 1024;
+
+/// Queues a message for a local user without online resources.
+///
+/// \param element
+///
+/// \return true if the message has been queued
+
+bool QXmppServerPrivate::storeOfflineMessage(const QDomElement &element)
+{
+    if (!offlineMessageStorage || element.tagName() != QLatin1String("message")) {
+        return false;
+    }
+
+    // RFC 6121, 8.5.2: only normal and chat messages are stored
+    const QString type = element.attribute(QStringLiteral("type"));
+    if (type == QLatin1String("groupchat") || type == QLatin1String("headline") || type == QLatin1String("error")) {
+        return false;
+    }
+
+    const QXmppJid to(element.attribute(QStringLiteral("to")));
+    if (to.node().isEmpty() || to.domain() != domain) {
+        return false;
+    }
+    const QString bareJid = to.bare().toString();
+    if (incomingClientsByBareJid.contains(bareJid) || remoteNodesByBareJid.contains(bareJid)) {
+        // the addressed resource is not online, but others are
+        return false;
+    }
+
+    // XEP-0203: mark the message as delayed
+    auto message = element.cloneNode().toElement();
+    auto delay = message.ownerDocument().createElementNS(ns_delayed_delivery, QStringLiteral("delay"));
+    delay.setAttribute(QStringLiteral("from"), domain);
+    delay.setAttribute(QStringLiteral("stamp"), QXmppUtils::datetimeToString(QDateTime::currentDateTimeUtc()));
+    message.appendChild(delay);
+
+    QByteArray data;
+    QXmlStreamWriter xmlStream(&data);
+    helperToXmlAddDomElement(&xmlStream, message, QStringList() << ns_client << ns_server);
+
+    offlineQueueBytes += data.size();
+    offlineQueue.append({ bareJid, std::move(data) });
+    Q_EMIT q->offlineMessageStored(bareJid, element);
+
+    if (offlineQueueBytes >= OFFLINE_FLUSH_SIZE) {
+        flushOfflineMessages();
+    } else {
+        if (!offlineFlushTimer) {
+            offlineFlushTimer = new QTimer(q);
+            offlineFlushTimer->setSingleShot(true);
+            QObject::connect(offlineFlushTimer, &QTimer::timeout, q, [this] {
+                flushOfflineMessages();
+            });
+        }
+        if (!offlineFlushTimer->isActive()) {
+            offlineFlushTimer->start(OFFLINE_FLUSH_DELAY);
+        }
+    }
+    return true;
+}
+
+/// Adds the queued offline messages to the storage.
+
+void QXmppServerPrivate::flushOfflineMessages()
+{
+    if (offlineFlushTimer) {
+        offlineFlushTimer->stop();
+    }
+    if (offlineQueue.isEmpty() || !offlineMessageStorage) {
+        return;
+    }
+
+    const auto count = offlineQueue.size();
+    QXMPP_TRACE_ASYNC_SPAN(span, "server", "offline-storage");
+    offlineMessageStorage->addMessages(offlineQueue, offlineMessageQuota).then(q, [this, count, span = std::move(span)](int dropped) mutable {
+        QXMPP_TRACE_END(span);
+        if (dropped > 0) {
+            warning(QStringLiteral("Dropped %1 of %2 offline messages exceeding the quota").arg(QString::number(dropped), QString::number(count)));
+        }
+    });
+    offlineQueue.clear();
+    offlineQueueBytes = 0;
+}
+
+/// Sends the stored offline messages to a user that has come online.
+///
+/// All messages are sent in one write to the stream.
+///
+/// \param stream
+
+void QXmppServerPrivate::replayOfflineMessages(QXmppIncomingClient *stream)
+{
+    if (!offlineMessageStorage) {
+        return;
+    }
+
+    const QString bareJid = QXmppUtils::jidToBareJid(stream->jid());
+
+    // the storage applies operations in order, so the batch including the
+    // latest messages is added before they are taken
+    if (std::any_of(offlineQueue.cbegin(), offlineQueue.cend(), [&](const auto &message) { return message.bareJid == bareJid; })) {
+        flushOfflineMessages();
+    }
+
+    QXMPP_TRACE_ASYNC_SPAN(span, "server", "offline-storage");
+    offlineMessageStorage->takeMessages(bareJid).then(q, [this, stream, bareJid, span = std::move(span)](QVector<QByteArray> &&messages) mutable {
+        QXMPP_TRACE_END(span);
+        if (messages.isEmpty()) {
+            return;
+        }
+
+        if (!incomingClients.contains(stream)) {
+            // the user has gone offline again
+            for (auto &data : messages) {
+                offlineQueueBytes += data.size();
+                offlineQueue.append({ bareJid, std::move(data) });
+            }
+            flushOfflineMessages();
+            return;
+        }
+
+        qsizetype size = 0;
+        for (const auto &message : std::as_const(messages)) {
+            size += message.size();
+        }
+        QByteArray data;
+        data.reserve(size);
+        for (const auto &message : std::as_const(messages)) {
+            data += message;
+        }
+        QMetaObject::invokeMethod(stream, [stream, data] { stream->sendData(data); });
+    });
+}
+
+/// Sends a serialized presence to the subscribers of its sender.
+///
+/// \param from full JID of the sender
+/// \param data
+/// \param available whether the presence is available
+///
+/// \return the number of subscribers the presence could be routed to
+
+int QXmppServerPrivate::broadcastPresence(const QString &from, QByteArray data, bool available)
+{
+    const auto parts = splitStanza(std::move(data));
+    const auto &name = parts.first;
+    const auto &body = parts.second;
+
+    // skip unchanged presences
+    const auto last = lastPresences.find(from);
+    if (last != lastPresences.end() && *last == body) {
+        return 0;
+    }
+    if (available) {
+        lastPresences.insert(from, body);
+    } else if (last != lastPresences.end()) {
+        lastPresences.erase(last);
+    }
+
+    const auto *subscribers = subscriberIndex.subscribers(QXmppUtils::jidToBareJid(from));
+    if (!subscribers) {
+        return 0;
+    }
+
+    int routed = 0;
+    for (const auto id : *subscribers) {
+        const auto &subscriber = subscriberIndex.node(id);
+        if (subscriber.jid.domain() != domain) {
+            if (routeData(subscriber.jid.toString(), name + subscriber.toAttribute, body)) {
+                routed++;
+            }
+            continue;
+        }
+
+        // local subscribers without online resources are skipped, looking up
+        // their connections directly keeps them out of the route cache
+        const auto subscriberJid = subscriber.jid.toString();
+        const auto clients = incomingClientsByBareJid.constFind(subscriberJid);
+        const auto nodes = remoteNodesByBareJid.constFind(subscriberJid);
+        if (clients == incomingClientsByBareJid.constEnd() && nodes == remoteNodesByBareJid.constEnd()) {
+            continue;
+        }
+        const auto head = name + subscriber.toAttribute;
+        if (clients != incomingClientsByBareJid.constEnd()) {
+            for (auto *conn : *clients) {
+                QMetaObject::invokeMethod(conn, [conn, head, body] { conn->sendStanzaData(head + body); });
+            }
+        }
+        if (nodes != remoteNodesByBareJid.constEnd()) {
+            for (auto node = nodes->keyBegin(); node != nodes->keyEnd(); ++node) {
+                if (auto *link = clusterLinks.value(*node)) {
+                    link->send(subscriberJid, head + body);
+                }
+            }
+        }
+        routed++;
+    }
+    return routed;
+}
+
+/// Mirrors a session of another node of the cluster.
+///
+/// \param jid
+/// \param node
+
+void QXmppServerPrivate::addRemoteSession(const QString &jid, const QString &node)
+{
+    if (node == clusterNode) {
+        return;
+    }
+    const auto previous = remoteSessions.value(jid);
+    if (previous == node) {
+        return;
+    }
+    if (!previous.isEmpty()) {
+        removeRemoteSession(jid, previous);
+    }
+    remoteSessions.insert(jid, node);
+    remoteNodesByBareJid[QXmppUtils::jidToBareJid(jid)][node]++;
+    routeCache.clear();
+}
+
+/// Removes the mirrored session of another node of the cluster.
+///
+/// \param jid
+/// \param node
+
+void QXmppServerPrivate::removeRemoteSession(const QString &jid, const QString &node)
+{
+    const auto session = remoteSessions.find(jid);
+    if (session == remoteSessions.end() || session.value() != node) {
+        return;
+    }
+    remoteSessions.erase(session);
+
+    const auto bareJid = QXmppUtils::jidToBareJid(jid);
+    auto &nodes = remoteNodesByBareJid[bareJid];
+    if (--nodes[node] <= 0) {
+        nodes.remove(node);
+    }
+    if (nodes.isEmpty()) {
+        remoteNodesByBareJid.remove(bareJid);
+    }
+    routeCache.clear();
+}
+
+/// Delivers a stanza forwarded by another node of the cluster to the local
+/// sessions of the recipient.
+///
+/// The stanza is never forwarded again, so nodes with outdated sessions can't
+/// make it loop.
+///
+/// \param to
+/// \param data
+
+void QXmppServerPrivate::deliverFromPeer(const QString &to, const QByteArray &data)
+{
+    QVector<QXmppIncomingClient *> clients;
+    if (QXmppUtils::jidToResource(to).isEmpty()) {
+        const auto connections = incomingClientsByBareJid.constFind(to);
+        if (connections != incomingClientsByBareJid.constEnd()) {
+            clients.reserve(connections->size());
+            for (auto *conn : *connections) {
+                clients << conn;
+            }
+        }
+    } else if (auto *conn = incomingClientsByJid.value(to)) {
+        clients << conn;
+    }
+
+    if (clients.isEmpty()) {
+        QXmppMetrics::increment(QXmppMetrics::RoutingFailures);
+        return;
+    }
+    for (auto *conn : clients) {
+        QMetaObject::invokeMethod(conn, [conn, data] { conn->sendStanzaData(data); });
+    }
+}
+
+void QXmppServerPrivate::info(const QString &message)
+{
+    if (logger) {
+        logger->log(QXmppLogger::InformationMessage, message);
+    }
+}
+
+void QXmppServerPrivate::warning(const QString &message)
+{
+    if (logger) {
+        logger->log(QXmppLogger::WarningMessage, message);
+    }
+}
+
+/// Load the server's extensions.
+///
+/// \param server
+
+void QXmppServerPrivate::loadExtensions(QXmppServer *server)
+{
+    if (!loaded) {
+        const auto pluginLoaders = QPluginLoader::staticInstances();
+        for (auto *object : pluginLoaders) {
+            auto *plugin = qobject_cast<QXmppServerPlugin *>(object);
+            if (!plugin) {
+                continue;
+            }
+
+            const auto &keys = plugin->keys();
+            for (const auto &key : keys) {
+                server->addExtension(plugin->create(key));
+            }
+        }
+        loaded = true;
+    }
+}
+
+/// Builds the index of the extensions by the stanzas they handle.
+
+void QXmppServerPrivate::buildExtensionIndex()
+{
+    extensionIndex.clear();
+    for (int i = 0; i < extensions.size(); ++i) {
+        const auto filters = extensionFilters.value(extensions[i]);
+        if (filters.isEmpty()) {
+            // the extension handles any stanza
+            extensionIndex[{}].push_back({ i, {} });
+        }
+        for (const auto &filter : filters) {
+            extensionIndex[{ filter.tagName, filter.payloadNamespace }].push_back({ i, filter.to });
+        }
+    }
+    extensionIndexValid = true;
+}
+
+/// Passes the stanza to the extensions that handle it, in the order of their
+/// priority.
+///
+/// Returns true if an extension has handled the stanza. Stanzas passed to an
+/// offloadable extension count as handled, they are passed on from
+/// offloadStanza() if the extension doesn't handle them.
+///
+/// \param element
+/// \param firstExtension index of the first extension to call
+
+bool QXmppServerPrivate::handleByExtensions(const QDomElement &element, int firstExtension)
+{
+    if (!extensionIndexValid) {
+        buildExtensionIndex();
+    }
+
+    const auto tagName = element.tagName();
+    const auto payloadNamespace = element.firstChildElement().namespaceURI();
+    const auto toDomain = QXmppUtils::jidToDomain(element.attribute(QStringLiteral("to")));
+
+    QVarLengthArray<int, 8> matches;
+    const auto addMatches = [&](const QString &tagName, const QString &payloadNamespace) {
+        const auto itr = extensionIndex.constFind({ tagName, payloadNamespace });
+        if (itr == extensionIndex.constEnd()) {
+            return;
+        }
+        for (const auto &filter : *itr) {
+            if (filter.to.isEmpty() || filter.to == toDomain) {
+                matches.push_back(filter.extension);
+            }
+        }
+    };
+    addMatches(tagName, payloadNamespace);
+    addMatches({}, {});
+    if (!payloadNamespace.isEmpty()) {
+        addMatches(tagName, {});
+        addMatches({}, payloadNamespace);
+    }
+    // extensions with several matching filters are only called once
+    std::sort(matches.begin(), matches.end());
+    const auto end = std::unique(matches.begin(), matches.end());
+
+    QElapsedTimer timer;
+    for (auto itr = std::lower_bound(matches.begin(), end, firstExtension); itr != end; ++itr) {
+        auto *extension = extensions.at(*itr);
+        if (offloadableExtensions.contains(extension)) {
+            offloadStanza(extension, element);
+            return true;
+        }
+
+        timer.start();
+        const bool handled = extension->handleStanza(element);
+        recordHandlingTime(extension, element, timer.nsecsElapsed());
+        if (handled) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// Hands a stanza to an offloadable extension in the thread pool.
+///
+/// The result is returned to the thread of the server, which passes the
+/// stanza on to the next extensions if it hasn't been handled.
+///
+/// \param extension
+/// \param element
+
+void QXmppServerPrivate::offloadStanza(QXmppServerExtension *extension, const QDomElement &element)
+{
+    // the copy doesn't share any nodes with the document of the stream
+    QDomDocument document;
+    document.appendChild(document.importNode(element, true));
+
+    QXMPP_TRACE_ASYNC_SPAN(span, "server", "offload");
+    QXMPP_TRACE_STANZA(span, element.attribute(QStringLiteral("id")), element.tagName());
+
+    // the executor is idle before the server is destroyed, see close()
+    extensionExecutor.run(element.attribute(QStringLiteral("from")), [this, extension, document, span = std::make_shared<QXmpp::Private::TraceSpan>(std::move(span))]() mutable {
+        QElapsedTimer timer;
+        timer.start();
+        const bool handled = extension->handleStanza(document.documentElement());
+        const auto elapsed = timer.nsecsElapsed();
+        span.reset();
+
+        QMetaObject::invokeMethod(q, [this, extension, document = std::move(document), handled, elapsed] {
+            const auto stanza = document.documentElement();
+            recordHandlingTime(extension, stanza, elapsed);
+            if (handled) {
+                return;
+            }
+
+            if (!handleByExtensions(stanza, extensions.indexOf(extension) + 1)) {
+                handleStanza(stanza);
+            }
+        });
+    });
+}
+
+static QString extensionLabel(const QXmppServerExtension *extension)
+{
+    auto name = extension->extensionName();
+    if (name.isEmpty()) {
+        name = QString::fromLatin1(extension->metaObject()->className());
+    }
+    return name;
+}
+
+/// Counts a stanza handled by an extension and reports the extension if it
+/// took longer than the slow handler threshold.
+///
+/// \param extension
+/// \param stanza
+/// \param nsecs time the extension needed to handle the stanza
+
+void QXmppServerPrivate::recordHandlingTime(QXmppServerExtension *extension, const QDomElement &stanza, qint64 nsecs)
+{
+    auto &counters = extensionCounters[extension];
+    counters.stanzas++;
+    counters.handlingTime += nsecs;
+
+    if (slowHandlerThreshold <= 0) {
+        return;
+    }
+    const auto name = extensionLabel(extension);
+    QXmppMetrics::observe(QXmppMetrics::ExtensionHandlingTime, name, nsecs);
+    if (nsecs > qint64(slowHandlerThreshold) * 1'000'000) {
+        auto kind = stanza.tagName();
+        if (const auto payload = stanza.firstChildElement(); !payload.isNull()) {
+            kind += QStringLiteral(" (") + payload.namespaceURI() + QLatin1Char(')');
+        }
+        warning(QStringLiteral("Extension %1 took %2 ms to handle %3 from %4")
+                    .arg(name, QString::number(nsecs / 1'000'000), kind, stanza.attribute(QStringLiteral("from"))));
+    }
+}
+
+/// Start the server's extensions.
+
+void QXmppServerPrivate::startExtensions()
+{
+    if (!started) {
+        for (auto *extension : std::as_const(extensions)) {
+            if (!extension->start()) {
+                warning(QString("Could not start extension %1").arg(extension->extensionName()));
+            }
+        }
+        started = true;
+    }
+}
+
+/// Stop the server's extensions (in reverse order).
+///
+
+void QXmppServerPrivate::stopExtensions()
+{
+    if (started) {
+        for (int i = extensions.size() - 1; i >= 0; --i) {
+            extensions[i]->stop();
+        }
+        started = false;
+    }
+}
+
+/// Constructs a new XMPP server instance.
+///
+/// \param parent
+
+QXmppServer::QXmppServer(QObject *parent)
+    : QXmppLoggable(parent), d(new QXmppServerPrivate(this))
+{
+    qRegisterMetaType<QDomElement>("QDomElement");
+    qRegisterMetaType<QXmppDialback>();
+}
+
+/// Destroys an XMPP server instance.
+///
+
+QXmppServer::~QXmppServer()
+{
+    close();
+    d->stopWorkers();
+    delete d;
+}
+
+/// Registers a new extension with the server.
+///
+/// \param extension
+
+void QXmppServer::addExtension(QXmppServerExtension *extension)
+{
+    if (!extension || d->extensions.contains(extension)) {
+        return;
+    }
+    d->info(QString("Added extension %1").arg(extension->extensionName()));
+    extension->setParent(this);
+    extension->setServer(this);
+    d->extensionFilters.insert(extension, extension->stanzaFilters());
+    if (extension->isOffloadable()) {
+        d->offloadableExtensions.insert(extension);
+    }
+    d->extensionIndexValid = false;
+
+    // keep extensions sorted by priority
+    for (int i = 0; i < d->extensions.size(); ++i) {
+        QXmppServerExtension *other = d->extensions[i];
+        if (other->extensionPriority() < extension->extensionPriority()) {
+            d->extensions.insert(i, extension);
+            return;
+        }
+    }
+    d->extensions << extension;
+}
+
+/// Returns the list of loaded extensions.
+///
+
+QList<QXmppServerExtension *> QXmppServer::extensions()
+{
+    d->loadExtensions(this);
+    return d->extensions;
+}
+
+/// Returns the server's domain.
+///
+
+QString QXmppServer::domain() const
+{
+    return d->domain;
+}
+
+/// Sets the server's domain.
+///
+/// \param domain
+
+void QXmppServer::setDomain(const QString &domain)
+{
+    d->domain = domain;
+    d->routeCache.clear();
+}
+
+QXmppLogger *QXmppServer::logger()
+{
+    return d->logger;
+}
+
+/// Sets the QXmppLogger associated with the server.
+///
+/// \param logger
+
+void QXmppServer::setLogger(QXmppLogger *logger)
+{
+    if (logger != d->logger) {
+        if (d->logger) {
+            disconnect(this, &QXmppLoggable::setGauge,
+                       d->logger, &QXmppLogger::setGauge);
+            disconnect(this, &QXmppLoggable::updateCounter,
+                       d->logger, &QXmppLogger::updateCounter);
+        }
+
+        d->logger = logger;
+        // log messages are passed directly, also from the extensions
+        setLogSink(d->logger);
+        if (d->logger) {
+            connect(this, &QXmppLoggable::setGauge,
+                    d->logger, &QXmppLogger::setGauge);
+            connect(this, &QXmppLoggable::updateCounter,
+                    d->logger, &QXmppLogger::updateCounter);
+        }
+
+        Q_EMIT loggerChanged(d->logger);
+    }
+}
+
+/// Returns the password checker used to verify client credentials.
+///
+
+QXmppPasswordChecker *QXmppServer::passwordChecker()
+{
+    return d->passwordChecker;
+}
+
+/// Sets the password checker used to verify client credentials.
+///
+/// \param checker
+///
+
+void QXmppServer::setPasswordChecker(QXmppPasswordChecker *checker)
+{
+    d->passwordChecker = checker;
+}
+
+///
+/// Returns the number of worker threads for the connections.
+///
+/// \since QXmpp 1.6
+///
+int QXmppServer::workerThreadCount() const
+{
+    return d->workerThreadCount;
+}
+
+///
+/// Sets the number of worker threads for the connections.
+///
+/// By default, the count is 0 and all connections are handled by the thread of
+/// the server. Otherwise each new connection is handed to the worker thread
+/// with the fewest connections, which then does the TLS encryption, the XML
+/// parsing and the serialization for the connection. Routing and the server
+/// extensions still run in the thread of the server.
+///
+/// This needs to be set before the server starts listening for connections.
+///
+/// \note With worker threads, the password checker is called from the worker
+/// threads and needs to be thread-safe.
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setWorkerThreadCount(int count)
+{
+    if (!d->workers.isEmpty()) {
+        d->warning(QStringLiteral("Cannot change the number of worker threads while the server is running"));
+        return;
+    }
+    d->workerThreadCount = qMax(0, count);
+}
+
+///
+/// Returns the maximum number of threads handling the stanzas of offloadable
+/// extensions.
+///
+/// \sa QXmppServerExtension::isOffloadable()
+///
+/// \since QXmpp 1.6
+///
+int QXmppServer::extensionThreadCount() const
+{
+    return d->extensionExecutor.maxThreadCount();
+}
+
+///
+/// Sets the maximum number of threads handling the stanzas of offloadable
+/// extensions.
+///
+/// The stanzas of one sender are handled one after another, so a sender can
+/// only occupy one of the threads. The default is the number of CPU cores.
+///
+/// \sa QXmppServerExtension::isOffloadable()
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setExtensionThreadCount(int count)
+{
+    d->extensionExecutor.setMaxThreadCount(qMax(1, count));
+}
+
+///
+/// Returns the maximum number of bytes the streams buffer before writing them
+/// to the socket.
+///
+/// \since QXmpp 1.6
+///
+int QXmppServer::writeBatchSize() const
+{
+    return d->writeBatchSize;
+}
+
+///
+/// Sets the maximum number of bytes the streams buffer before writing them to
+/// the socket.
+///
+/// With write batching, stanzas routed to a stream in the same event loop
+/// iteration (or within the writeBatchDelay()) are written at once. This saves
+/// system calls and TLS records, e.g. for presence floods. The setting applies
+/// to new connections.
+///
+/// The counters "stream.write.saved" and "stream.write.coalesced-bytes" of the
+/// logger report the number of saved writes and the number of bytes written in
+/// combined writes.
+///
+/// The default value is 0, which disables write batching.
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setWriteBatchSize(int bytes)
+{
+    d->writeBatchSize = bytes;
+}
+
+///
+/// Returns the maximum time in milliseconds the streams buffer outgoing data.
+///
+/// \since QXmpp 1.6
+///
+int QXmppServer::writeBatchDelay() const
+{
+    return d->writeBatchDelay;
+}
+
+///
+/// Sets the maximum time in milliseconds the streams buffer outgoing data.
+///
+/// The default value is 0, so only stanzas sent in the same event loop
+/// iteration are combined.
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setWriteBatchDelay(int msecs)
+{
+    d->writeBatchDelay = msecs;
+}
+
+///
+/// Returns the maximum number of stanzas per second read from a client.
+///
+/// \since QXmpp 1.6
+///
+double QXmppServer::clientStanzaRateLimit() const
+{
+    return d->clientStanzaRateLimit;
+}
+
+///
+/// Returns the maximum number of bytes per second read from a client.
+///
+/// \since QXmpp 1.6
+///
+qint64 QXmppServer::clientByteRateLimit() const
+{
+    return d->clientByteRateLimit;
+}
+
+///
+/// Limits the rate of incoming data per client connection.
+///
+/// A client exceeding the limit is not disconnected, the server stops reading
+/// from its socket until its budget has been refilled. This way one flooding
+/// client cannot starve the other connections. See
+/// QXmppStream::setReceiveRateLimit() for details and the reported counters.
+/// The setting applies to new connections.
+///
+/// \param stanzasPerSecond maximum number of stanzas per second, 0 for no limit
+/// \param bytesPerSecond maximum number of bytes per second, 0 for no limit
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setClientRateLimit(double stanzasPerSecond, qint64 bytesPerSecond)
+{
+    d->clientStanzaRateLimit = stanzasPerSecond;
+    d->clientByteRateLimit = bytesPerSecond;
+}
+
+///
+/// Returns the maximum number of client connections that have not completed
+/// their setup yet.
+///
+/// \since QXmpp 1.6
+///
+int QXmppServer::maximumPendingClients() const
+{
+    return d->maximumPendingClients;
+}
+
+///
+/// Limits the number of client connections that have not completed their
+/// setup, i.e. that have neither bound a resource nor resumed a session yet.
+///
+/// Setting up a connection, i.e. the TLS handshake and the authentication, is
+/// much more expensive than serving an established one. When many clients
+/// connect at the same time, e.g. after a failover, further connections wait in
+/// the admission queue until one of the pending clients has completed its
+/// setup or disconnected. See setAdmissionQueueLimit().
+///
+/// The default value is 0, which means no limit.
+///
+/// \since QXmpp 1.6
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+void QXmppServer::setMaximumPendingClients(int clients)
+{
+    d->maximumPendingClients = clients;
+    d->processAdmissionQueue();
+}
+
+///
+/// Returns the maximum number of client connections started per second.
+///
+/// \since QXmpp 1.6
+///
+double QXmppServer::clientAcceptRate() const
+{
+    return d->acceptBucket.rate();
+}
+
+///
+/// Limits the rate client connections are started at.
+///
+/// Up to one second worth of connections can be started at once, further
+/// connections wait in the admission queue. See setAdmissionQueueLimit().
+///
+/// \param connectionsPerSecond maximum number of connections per second, 0 for
+/// no limit
+///
+/// \since QXmpp 1.6
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+void QXmppServer::setClientAcceptRate(double connectionsPerSecond)
+{
+    d->acceptBucket.setRate(connectionsPerSecond, std::max(1.0, connectionsPerSecond));
+    d->acceptClock.start();
+    d->processAdmissionQueue();
+}
+
+///
+/// Returns the maximum number of client connections waiting for admission.
+///
+/// \since QXmpp 1.6
+///
+int QXmppServer::admissionQueueSize() const
+{
+    return d->admissionQueueSize;
+}
+
+///
+/// Returns the time in milliseconds client connections wait for admission at
+/// most.
+///
+/// \since QXmpp 1.6
+///
+int QXmppServer::admissionQueueTimeout() const
+{
+    return d->admissionQueueTimeout;
+}
+
+///
+/// Sets the limits of the queue of client connections waiting for admission.
+///
+/// Connections exceeding setMaximumPendingClients() or setClientAcceptRate()
+/// are queued and started in the order they have been accepted. Connections
+/// that don't fit into the queue or that have waited for too long are closed
+/// with a stream error right away, without any TLS handshake: a
+/// \c <see-other-host/> error if an overloadRedirectHost() is set, a
+/// \c <resource-constraint/> error otherwise. Queued connections are closed
+/// with a \c <system-shutdown/> error when the server is closed.
+///
+/// The length of the queue is reported as the
+/// QXmppMetrics::ClientAdmissionQueueLength gauge, rejected connections are
+/// counted by QXmppMetrics::RejectedClientConnections.
+///
+/// \param connections maximum number of queued connections, 0 to reject
+/// connections exceeding the limits right away (default: 1000)
+/// \param msecs maximum time in milliseconds a connection is queued, a
+/// negative value to wait forever (default: 10000)
+///
+/// \since QXmpp 1.6
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+void QXmppServer::setAdmissionQueueLimit(int connections, int msecs)
+{
+    d->admissionQueueSize = connections;
+    d->admissionQueueTimeout = msecs;
+
+    // the most recently queued connections no longer fit
+    while (int(d->admissionQueue.size()) > std::max(connections, 0)) {
+        auto *socket = d->admissionQueue.back().socket;
+        d->admissionQueue.pop_back();
+        d->rejectConnection(socket, false);
+    }
+    d->processAdmissionQueue();
+}
+
+///
+/// Returns the host overloaded clients are redirected to.
+///
+/// \since QXmpp 1.6
+///
+QString QXmppServer::overloadRedirectHost() const
+{
+    return d->overloadRedirectHost;
+}
+
+///
+/// Sets the host client connections are redirected to when they are rejected
+/// by the admission control.
+///
+/// The value is sent in a \c <see-other-host/> stream error, e.g.
+/// \c "xmpp2.example.org" or \c "xmpp2.example.org:5222". The default value is
+/// empty, so connections are rejected with a \c <resource-constraint/> error.
+///
+/// \since QXmpp 1.6
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+void QXmppServer::setOverloadRedirectHost(const QString &host)
+{
+    d->overloadRedirectHost = host;
+}
+
+///
+/// Returns the maximum size of received stanzas in bytes.
+///
+/// \since QXmpp 1.6
+///
+qint64 QXmppServer::maximumStanzaSize() const
+{
+    return d->maximumStanzaSize;
+}
+
+///
+/// Sets the maximum size of stanzas received from clients and servers.
+///
+/// A stream sending a larger stanza is closed with a \c <policy-violation/>
+/// stream error before the stanza has been buffered completely. See
+/// QXmppStream::setMaximumStanzaSize(). The setting applies to new connections.
+///
+/// The default value is 0, which means no limit.
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setMaximumStanzaSize(qint64 bytes)
+{
+    d->maximumStanzaSize = bytes;
+}
+
+///
+/// Returns the time in milliseconds after which unused outgoing
+/// server-to-server connections are closed.
+///
+/// \since QXmpp 1.6
+///
+int QXmppServer::outgoingServerIdleTimeout() const
+{
+    return d->outgoingServerIdleTimeout;
+}
+
+///
+/// Sets the time in milliseconds after which unused outgoing server-to-server
+/// connections are closed.
+///
+/// A connection is unused if no data has been routed over it. Connections are
+/// checked periodically, so they may stay open for up to one and a half
+/// timeouts. A new connection is established when there is data for the
+/// remote domain again.
+///
+/// The default value is 0, which keeps the connections open.
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setOutgoingServerIdleTimeout(int msecs)
+{
+    d->outgoingServerIdleTimeout = msecs;
+
+    if (msecs <= 0) {
+        delete d->idleTimer;
+        d->idleTimer = nullptr;
+        return;
+    }
+
+    if (!d->idleTimer) {
+        d->idleTimer = new QTimer(this);
+        connect(d->idleTimer, &QTimer::timeout, this, [this] {
+            d->closeIdleOutgoingServers();
+        });
+    }
+    d->idleTimer->start(std::max(msecs / 2, 1));
+}
+
+///
+/// Returns the maximum number of bytes queued for a remote domain until the
+/// outgoing server-to-server stream is ready.
+///
+/// \since QXmpp 1.6
+///
+qint64 QXmppServer::outgoingServerQueueSize() const
+{
+    return d->outgoingServerQueueSize;
+}
+
+///
+/// Returns the maximum time in milliseconds stanzas are queued for a remote
+/// domain until the outgoing server-to-server stream is ready.
+///
+/// \since QXmpp 1.6
+///
+int QXmppServer::outgoingServerQueueTimeout() const
+{
+    return d->outgoingServerQueueTimeout;
+}
+
+///
+/// Sets the limits of the queues of stanzas routed to remote domains while
+/// the dialback of their outgoing streams is pending.
+///
+/// Presences are dropped first when a queue is full, IQ responses last. See
+/// QXmppOutgoingServer::setQueueLimit(). The settings apply to new
+/// connections.
+///
+/// The default values are 1 MiB and 60 seconds, 0 means no limit.
+///
+/// \param bytes maximum number of queued bytes per remote domain
+/// \param msecs maximum time in milliseconds a stanza is queued
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setOutgoingServerQueueLimit(qint64 bytes, int msecs)
+{
+    d->outgoingServerQueueSize = bytes;
+    d->outgoingServerQueueTimeout = msecs;
+}
+
+///
+/// Returns what happens to stanzas that don't fit into the queue of an
+/// outgoing server-to-server stream.
+///
+/// \since QXmpp 1.6
+///
+QXmppOutgoingServer::QueueOverflowPolicy QXmppServer::outgoingServerQueueOverflowPolicy() const
+{
+    return d->outgoingServerQueueOverflowPolicy;
+}
+
+///
+/// Sets what happens to stanzas that don't fit into the queue of an outgoing
+/// server-to-server stream.
+///
+/// With QXmppOutgoingServer::Bounce, the senders of dropped messages and IQ
+/// requests get a \c <remote-server-timeout/> error. This applies to stanzas
+/// that have been queued for too long as well. The setting applies to new
+/// connections.
+///
+/// The default is QXmppOutgoingServer::Bounce.
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setOutgoingServerQueueOverflowPolicy(QXmppOutgoingServer::QueueOverflowPolicy policy)
+{
+    d->outgoingServerQueueOverflowPolicy = policy;
+}
+
+///
+/// Returns the time in milliseconds successful dialback verifications are
+/// cached for.
+///
+/// \since QXmpp 1.6
+///
+int QXmppServer::dialbackCacheTimeToLive() const
+{
+    return d->dialbackCache ? d->dialbackCache->timeToLive() : 0;
 }
 
-void QXmppServerPrivate::info(const QString &message)
+///
+/// Sets the time in milliseconds successful dialback verifications are cached
+/// for.
+///
+/// A remote server presenting a dialback key that has been verified with its
+/// authoritative server before is accepted without verifying the key again.
+/// This avoids new connections to the authoritative server when a remote
+/// server reconnects many streams at once. The setting applies to new
+/// incoming server connections.
+///
+/// The default value is 0, which disables the cache.
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setDialbackCacheTimeToLive(int msecs)
 {
-    if (logger) {
-        logger->log(QXmppLogger::InformationMessage, message);
+    if (msecs > 0) {
+        d->dialbackCache = std::make_shared<QXmpp::Private::DialbackCache>(msecs);
+    } else {
+        d->dialbackCache.reset();
     }
 }
 
-void QXmppServerPrivate::warning(const QString &message)
+///
+/// Returns the storage for messages to offline users.
+///
+/// \since QXmpp 1.6
+///
+QXmppOfflineMessageStorage *QXmppServer::offlineMessageStorage() const
 {
-    if (logger) {
-        logger->log(QXmppLogger::WarningMessage, message);
-    }
+    return d->offlineMessageStorage;
 }
 
-/// Load the server's extensions.
 ///
-/// \param server
-
-void QXmppServerPrivate::loadExtensions(QXmppServer *server)
+/// Sets the storage for messages to offline users.
+///
+/// Messages of type normal or chat to a local user without online resources
+/// are stored with a XEP-0203 delay and sent when the user comes online
+/// again. The messages are added to the storage in batches. When the user
+/// logs in, the stored messages are sent in one write to the new stream.
+///
+/// The storage is not owned by the server. The default value is nullptr,
+/// which disables offline messages.
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setOfflineMessageStorage(QXmppOfflineMessageStorage *storage)
 {
-    if (!loaded) {
-        const auto pluginLoaders = QPluginLoader::staticInstances();
-        for (auto *object : pluginLoaders) {
-            auto *plugin = qobject_cast<QXmppServerPlugin *>(object);
-            if (!plugin) {
-                continue;
-            }
-
-            const auto &keys = plugin->keys();
-            for (const auto &key : keys) {
-                server->addExtension(plugin->create(key));
-            }
-        }
-        loaded = true;
-    }
+    d->flushOfflineMessages();
+    d->offlineMessageStorage = storage;
 }
 
-/// Start the server's extensions.
-
-void QXmppServerPrivate::startExtensions()
+///
+/// Returns the maximum number of offline messages stored per user.
+///
+/// \since QXmpp 1.6
+///
+int QXmppServer::offlineMessageQuota() const
 {
-    if (!started) {
-        for (auto *extension : std::as_const(extensions)) {
-            if (!extension->start()) {
-                warning(QString("Could not start extension %1").arg(extension->extensionName()));
-            }
-        }
-        started = true;
-    }
+    return d->offlineMessageQuota;
 }
 
-/// Stop the server's extensions (in reverse order).
 ///
-
-void QXmppServerPrivate::stopExtensions()
+/// Sets the maximum number of offline messages stored per user.
+///
+/// Messages exceeding the quota are dropped. The default value is 100, 0
+/// disables the limit.
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setOfflineMessageQuota(int messages)
 {
-    if (started) {
-        for (int i = extensions.size() - 1; i >= 0; --i) {
-            extensions[i]->stop();
-        }
-        started = false;
-    }
+    d->offlineMessageQuota = std::max(messages, 0);
 }
 
-/// Constructs a new XMPP server instance.
 ///
-/// \param parent
-
-QXmppServer::QXmppServer(QObject *parent)
-    : QXmppLoggable(parent), d(new QXmppServerPrivate(this))
+/// Returns the number of seconds the stream management sessions of clients
+/// are kept after their connection has been lost (\xep{0198}).
+///
+/// \since QXmpp 1.6
+///
+int QXmppServer::streamResumptionTimeout() const
 {
-    qRegisterMetaType<QDomElement>("QDomElement");
+    return d->streamResumptionTimeout;
 }
 
-/// Destroys an XMPP server instance.
 ///
-
-QXmppServer::~QXmppServer()
+/// Sets the number of seconds the stream management sessions of clients are
+/// kept after their connection has been lost (\xep{0198}).
+///
+/// Clients that enabled stream resumption stay available while their session
+/// is kept and stanzas for them are queued. When a client resumes the session
+/// on a new connection, the new stream takes over and the queued stanzas are
+/// delivered without a login or a change of presence. See
+/// QXmppIncomingClient::setStreamResumptionTimeout(). The setting applies to
+/// new connections.
+///
+/// The default value is 300 seconds, 0 disables stream resumption.
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setStreamResumptionTimeout(int secs)
 {
-    close();
-    delete d;
+    d->streamResumptionTimeout = std::max(secs, 0);
 }
 
-/// Registers a new extension with the server.
 ///
-/// \param extension
-
-void QXmppServer::addExtension(QXmppServerExtension *extension)
+/// Returns the maximum size in bytes of the stanzas that may wait for an
+/// acknowledgement by a client (\xep{0198}).
+///
+/// \since QXmpp 1.6
+///
+qint64 QXmppServer::streamManagementQueueLimit() const
 {
-    if (!extension || d->extensions.contains(extension)) {
-        return;
-    }
-    d->info(QString("Added extension %1").arg(extension->extensionName()));
-    extension->setParent(this);
-    extension->setServer(this);
-
-    // keep extensions sorted by priority
-    for (int i = 0; i < d->extensions.size(); ++i) {
-        QXmppServerExtension *other = d->extensions[i];
-        if (other->extensionPriority() < extension->extensionPriority()) {
-            d->extensions.insert(i, extension);
-            return;
-        }
-    }
-    d->extensions << extension;
+    return d->streamManagementQueueLimit;
 }
 
-/// Returns the list of loaded extensions.
 ///
-
-QList<QXmppServerExtension *> QXmppServer::extensions()
+/// Sets the maximum size in bytes of the stanzas that may wait for an
+/// acknowledgement by a client (\xep{0198}).
+///
+/// This bounds the memory used for each stream, also while the session is
+/// kept for resumption. A stream exceeding the limit is closed. See
+/// QXmppIncomingClient::setStreamManagementQueueLimit(). The setting applies
+/// to new connections.
+///
+/// The default value is 1 MiB, 0 disables the limit.
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setStreamManagementQueueLimit(qint64 bytes)
 {
-    d->loadExtensions(this);
-    return d->extensions;
+    d->streamManagementQueueLimit = bytes;
 }
 
-/// Returns the server's domain.
 ///
-
-QString QXmppServer::domain() const
+/// Returns whether roster versioning is announced to clients (\xep{0237}).
+///
+/// \since QXmpp 1.6
+///
+bool QXmppServer::isRosterVersioningSupported() const
 {
-    return d->domain;
+    return d->rosterVersioningSupported;
 }
 
-/// Sets the server's domain.
 ///
-/// \param domain
+/// Sets whether roster versioning is announced to clients (\xep{0237}).
+///
+/// This is set by QXmppRosterExtension, which serves the rosters. The setting
+/// applies to new connections.
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setRosterVersioningSupported(bool supported)
+{
+    d->rosterVersioningSupported = supported;
+}
 
-void QXmppServer::setDomain(const QString &domain)
+///
+/// Returns the name of this node in a cluster serving the domain.
+///
+/// \since QXmpp 1.6
+///
+QString QXmppServer::clusterNode() const
 {
-    d->domain = domain;
+    return d->clusterNode;
 }
 
-QXmppLogger *QXmppServer::logger()
+///
+/// Sets the name of this node in a cluster serving the domain and the secret
+/// shared by the nodes.
+///
+/// All nodes of a cluster serve the same domain and share a session registry,
+/// see setSessionRegistry(). Stanzas for clients connected to other nodes are
+/// forwarded on persistent links, one per peer, carrying the stanzas for all
+/// sessions on the peer. The peers are added with addClusterPeer() and accept
+/// the links of the other nodes with listenForClusterPeers().
+///
+/// The secret authenticates the nodes opening links. The links are not
+/// encrypted, so they should only be used on a trusted network.
+///
+/// This needs to be set before the registry is.
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setClusterNode(const QString &node, const QByteArray &secret)
 {
-    return d->logger;
+    d->clusterNode = node;
+    d->clusterSecret = secret;
 }
 
-/// Sets the QXmppLogger associated with the server.
 ///
-/// \param logger
+/// Returns the registry of the client sessions of the cluster.
+///
+/// \since QXmpp 1.6
+///
+QXmppSessionRegistry *QXmppServer::sessionRegistry() const
+{
+    return d->sessionRegistry;
+}
 
-void QXmppServer::setLogger(QXmppLogger *logger)
+///
+/// Sets the registry of the client sessions of the cluster.
+///
+/// The sessions of this node are added to the registry, and the sessions of
+/// the other nodes are mirrored, so stanzas are routed without waiting for
+/// the registry.
+///
+/// The registry is not owned by the server. The default value is nullptr,
+/// which disables clustering.
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setSessionRegistry(QXmppSessionRegistry *registry)
 {
-    if (logger != d->logger) {
-        if (d->logger) {
-            disconnect(this, &QXmppLoggable::logMessage,
-                       d->logger, &QXmppLogger::log);
-            disconnect(this, &QXmppLoggable::setGauge,
-                       d->logger, &QXmppLogger::setGauge);
-            disconnect(this, &QXmppLoggable::updateCounter,
-                       d->logger, &QXmppLogger::updateCounter);
-        }
+    if (d->sessionRegistry) {
+        disconnect(d->sessionRegistry, nullptr, this, nullptr);
+        d->remoteSessions.clear();
+        d->remoteNodesByBareJid.clear();
+        d->routeCache.clear();
+    }
+    d->sessionRegistry = registry;
+    if (!registry) {
+        return;
+    }
 
-        d->logger = logger;
-        if (d->logger) {
-            connect(this, &QXmppLoggable::logMessage,
-                    d->logger, &QXmppLogger::log);
-            connect(this, &QXmppLoggable::setGauge,
-                    d->logger, &QXmppLogger::setGauge);
-            connect(this, &QXmppLoggable::updateCounter,
-                    d->logger, &QXmppLogger::updateCounter);
+    connect(registry, &QXmppSessionRegistry::sessionAdded, this, [this](const QString &jid, const QString &node) {
+        d->addRemoteSession(jid, node);
+    });
+    connect(registry, &QXmppSessionRegistry::sessionRemoved, this, [this](const QString &jid, const QString &node) {
+        d->removeRemoteSession(jid, node);
+    });
+    registry->sessions().then(this, [this, registry](QVector<QXmppSessionRegistry::Session> &&sessions) {
+        if (d->sessionRegistry != registry) {
+            return;
         }
-
-        Q_EMIT loggerChanged(d->logger);
+        for (const auto &session : std::as_const(sessions)) {
+            d->addRemoteSession(session.jid, session.node);
+        }
+    });
+    for (auto itr = d->incomingClientsByJid.cbegin(); itr != d->incomingClientsByJid.cend(); ++itr) {
+        registry->addSession(itr.key(), d->clusterNode);
     }
 }
 
-/// Returns the password checker used to verify client credentials.
 ///
-
-QXmppPasswordChecker *QXmppServer::passwordChecker()
-{
-    return d->passwordChecker;
-}
-
-/// Sets the password checker used to verify client credentials.
+/// Adds another node of the cluster.
 ///
-/// \param checker
+/// The link to the node is opened when the first stanza for one of its
+/// sessions is routed, and opened again when it is lost.
 ///
-
-void QXmppServer::setPasswordChecker(QXmppPasswordChecker *checker)
+/// \param node name of the node as reported to the session registry
+/// \param host
+/// \param port port the node listens on with listenForClusterPeers()
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::addClusterPeer(const QString &node, const QString &host, quint16 port)
 {
-    d->passwordChecker = checker;
+    delete d->clusterLinks.take(node);
+    d->clusterLinks.insert(node, new QXmpp::Private::ClusterLink(d->clusterNode, d->clusterSecret, host, port, this));
+    d->routeCache.clear();
 }
 
 /// Returns the statistics for the server.
+///
+/// Since QXmpp 1.6, the statistics contain the ten busiest connections by
+/// traffic as "busiest-connections", see busiestConnections(), and the number
+/// of stanzas passed to each extension with the time spent handling them in
+/// nanoseconds as "extensions". The memory used by the buffers of the
+/// connections, including the stanzas waiting for an acknowledgement
+/// (\xep{0198}), is reported as "buffered-bytes" and
+/// "buffered-bytes-per-connection".
 
 QVariantMap QXmppServer::statistics() const
 {
@@ -423,9 +2549,140 @@ QVariantMap QXmppServer::statistics() const
     stats["incoming-clients"] = d->incomingClients.size();
     stats["incoming-servers"] = d->incomingServers.size();
     stats["outgoing-servers"] = d->outgoingServers.size();
+
+    qint64 bufferedBytes = 0;
+    const auto addBufferedBytes = [&bufferedBytes](const auto &streams) {
+        for (const auto *stream : streams) {
+            const auto statistics = stream->statistics();
+            bufferedBytes += statistics.bufferedBytes + statistics.streamManagementQueuedBytes;
+        }
+    };
+    addBufferedBytes(d->incomingClients);
+    addBufferedBytes(d->incomingServers);
+    addBufferedBytes(d->outgoingServers);
+    const auto connectionCount = d->incomingClients.size() + d->incomingServers.size() + d->outgoingServers.size();
+    stats["buffered-bytes"] = bufferedBytes;
+    stats["buffered-bytes-per-connection"] = connectionCount ? bufferedBytes / connectionCount : 0;
+
+    static const char *typeNames[] = { "incoming-client", "incoming-server", "outgoing-server" };
+    QVariantList connections;
+    const auto busiest = busiestConnections(10);
+    for (const auto &connection : busiest) {
+        const auto &counters = connection.statistics;
+        QVariantMap map;
+        map["type"] = QString::fromLatin1(typeNames[connection.type]);
+        map["remote"] = connection.remote;
+        map["bytes-received"] = counters.bytesReceived;
+        map["bytes-sent"] = counters.bytesSent;
+        map["received-messages"] = counters.receivedMessages;
+        map["received-presences"] = counters.receivedPresences;
+        map["received-iqs"] = counters.receivedIqs;
+        map["received-nonzas"] = counters.receivedNonzas;
+        map["sent-messages"] = counters.sentMessages;
+        map["sent-presences"] = counters.sentPresences;
+        map["sent-iqs"] = counters.sentIqs;
+        map["sent-nonzas"] = counters.sentNonzas;
+        map["parse-time"] = counters.parseTime;
+        map["sm-queued-stanzas"] = counters.streamManagementQueuedStanzas;
+        map["sm-queued-bytes"] = counters.streamManagementQueuedBytes;
+        map["buffered-bytes"] = counters.bufferedBytes;
+        map["last-activity"] = counters.lastActivity;
+        connections << map;
+    }
+    stats["busiest-connections"] = connections;
+
+    QVariantMap extensions;
+    for (auto itr = d->extensionCounters.cbegin(); itr != d->extensionCounters.cend(); ++itr) {
+        extensions[extensionLabel(itr.key())] = QVariantMap {
+            { QStringLiteral("stanzas"), itr->stanzas },
+            { QStringLiteral("handling-time"), itr->handlingTime },
+        };
+    }
+    stats["extensions"] = extensions;
     return stats;
 }
 
+///
+/// Returns the time in milliseconds above which the handling of a stanza by
+/// an extension is reported.
+///
+/// \since QXmpp 1.6
+///
+int QXmppServer::slowHandlerThreshold() const
+{
+    return d->slowHandlerThreshold;
+}
+
+///
+/// Sets the time in milliseconds above which the handling of a stanza by an
+/// extension is reported.
+///
+/// Extensions run in the thread of the server unless they are offloadable, so
+/// one that blocks while handling a stanza delays the routing of all others.
+/// If enabled, the durations of QXmppServerExtension::handleStanza() are
+/// recorded in the QXmppMetrics::ExtensionHandlingTime histogram labelled by
+/// the name of the extension, and calls taking longer than the threshold are
+/// logged as a warning with the extension and the kind of stanza.
+///
+/// The default value is 0, which disables the reports. The number of stanzas
+/// and the total handling time of each extension are always available from
+/// statistics().
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setSlowHandlerThreshold(int msecs)
+{
+    d->slowHandlerThreshold = std::max(msecs, 0);
+}
+
+///
+/// Returns the counters of the connections with the most traffic, sorted by
+/// the bytes received and sent.
+///
+/// The counters are read from the connections without stopping them, so this
+/// can be called periodically, e.g. to find abusive clients.
+///
+/// \param count maximum number of connections to return
+///
+/// \since QXmpp 1.6
+///
+QVector<QXmppServer::ConnectionStatistics> QXmppServer::busiestConnections(int count) const
+{
+    // the names are only known by the routing tables of the server's thread
+    QHash<const QXmppStream *, QString> names;
+    for (auto itr = d->incomingClientsByJid.cbegin(); itr != d->incomingClientsByJid.cend(); ++itr) {
+        names.insert(itr.value(), itr.key());
+    }
+    for (auto itr = d->bidirectionalServersByDomain.cbegin(); itr != d->bidirectionalServersByDomain.cend(); ++itr) {
+        names.insert(itr.value(), itr.key());
+    }
+    for (auto itr = d->outgoingServersByDomain.cbegin(); itr != d->outgoingServersByDomain.cend(); ++itr) {
+        names.insert(itr.value(), itr.key());
+    }
+
+    QVector<ConnectionStatistics> connections;
+    connections.reserve(d->incomingClients.size() + d->incomingServers.size() + d->outgoingServers.size());
+    const auto addConnection = [&](const QXmppStream *stream, ConnectionStatistics::Type type) {
+        connections.push_back({ type, names.value(stream), stream->statistics() });
+    };
+    for (auto *stream : std::as_const(d->incomingClients)) {
+        addConnection(stream, ConnectionStatistics::IncomingClient);
+    }
+    for (auto *stream : std::as_const(d->incomingServers)) {
+        addConnection(stream, ConnectionStatistics::IncomingServer);
+    }
+    for (auto *stream : std::as_const(d->outgoingServers)) {
+        addConnection(stream, ConnectionStatistics::OutgoingServer);
+    }
+
+    const auto end = connections.begin() + std::clamp(count, 0, int(connections.size()));
+    std::partial_sort(connections.begin(), end, connections.end(), [](const auto &a, const auto &b) {
+        return a.statistics.totalBytes() > b.statistics.totalBytes();
+    });
+    connections.erase(end, connections.end());
+    return connections;
+}
+
 /// Sets the path for additional SSL CA certificates.
 ///
 /// \param path
@@ -552,35 +2809,61 @@ void QXmppServer::setPrivateKey(const QSslKey &key)
 
 bool QXmppServer::listenForClients(const QHostAddress &address, quint16 port)
 {
-    bool check;
-    Q_UNUSED(check)
-
-    if (d->domain.isEmpty()) {
-        d->warning("No domain was specified!");
-        return false;
-    }
-
-    // create new server
-    auto *server = new QXmppSslServer(this);
-    server->addCaCertificates(d->caCertificates);
-    server->setLocalCertificate(d->localCertificate);
-    server->setPrivateKey(d->privateKey);
+    return d->listen(true, false, address, port);
+}
 
-    check = connect(server, SIGNAL(newConnection(QSslSocket *)),
-                    this, SLOT(_q_clientConnection(QSslSocket *)));
-    Q_ASSERT(check);
+///
+/// Listens for incoming XMPP client connections using direct TLS
+/// (\xep{0368}).
+///
+/// Unlike listenForClients(), the TLS handshake is started right after the
+/// connection has been accepted instead of after STARTTLS, which saves a
+/// round-trip and a stream restart per login. The \c xmpp-client protocol is
+/// offered using ALPN. The port is usually announced using an
+/// \c _xmpps-client SRV record.
+///
+/// A local certificate and a private key need to be set before.
+///
+/// \param address
+/// \param port
+///
+/// \since QXmpp 1.6
+///
+bool QXmppServer::listenForClientsWithDirectTls(const QHostAddress &address, quint16 port)
+{
+    return d->listen(true, true, address, port);
+}
 
-    if (!server->listen(address, port)) {
-        d->warning(QString("Could not start listening for C2S on %1 %2").arg(address.toString(), QString::number(port)));
-        delete server;
-        return false;
-    }
-    d->serversForClients.insert(server);
+///
+/// Accepts client connections on a listening socket that has been created by
+/// another process, e.g. the previous process of the server on a restart.
+///
+/// The descriptor can be inherited when the new process is started or passed
+/// over a Unix domain socket, see clientListenerDescriptors().
+///
+/// \param socketDescriptor
+/// \param directTls whether the socket has been listening for direct TLS
+/// connections (\xep{0368})
+///
+/// \since QXmpp 1.6
+///
+bool QXmppServer::adoptClientListener(qintptr socketDescriptor, bool directTls)
+{
+    return d->adoptListener(true, directTls, socketDescriptor);
+}
 
-    // start extensions
-    d->loadExtensions(this);
-    d->startExtensions();
-    return true;
+///
+/// Returns the descriptors of the sockets listening for client connections,
+/// so they can be passed to another process, see adoptClientListener().
+///
+/// \param directTls whether the descriptors of the sockets listening for
+/// direct TLS connections are returned (\xep{0368})
+///
+/// \since QXmpp 1.6
+///
+QVector<qintptr> QXmppServer::clientListenerDescriptors(bool directTls) const
+{
+    return d->listenerDescriptors(true, directTls);
 }
 
 /// Closes the server.
@@ -595,25 +2878,194 @@ void QXmppServer::close()
     for (auto *server : std::as_const(d->serversForServers)) {
         server->close();
     }
+    for (auto *server : std::as_const(d->serversForPeers)) {
+        server->close();
+    }
     qDeleteAll(d->serversForClients);
     qDeleteAll(d->serversForServers);
+    qDeleteAll(d->serversForPeers);
+    qDeleteAll(std::exchange(d->clusterConnections, {}));
     d->serversForClients.clear();
     d->serversForServers.clear();
+    d->serversForPeers.clear();
+    d->routeCache.clear();
+    d->rejectQueuedConnections();
 
-    // stop extensions
+    // stop extensions, once they have handled the offloaded stanzas
+    d->extensionExecutor.waitForDone();
     d->stopExtensions();
 
-    // close XMPP streams
-    QSetIterator<QXmppIncomingClient *> itr(d->incomingClients);
-    while (itr.hasNext()) {
-        itr.next()->disconnectFromHost();
+    // write pending offline messages
+    d->flushOfflineMessages();
+
+    // close XMPP streams, they may live in worker threads
+    const auto disconnectStream = [](QXmppStream *stream) {
+        QMetaObject::invokeMethod(stream, [stream] { stream->disconnectFromHost(); });
+    };
+    for (auto *stream : std::as_const(d->incomingClients)) {
+        disconnectStream(stream);
     }
     for (auto *stream : std::as_const(d->incomingServers)) {
-        stream->disconnectFromHost();
+        disconnectStream(stream);
     }
     for (auto *stream : std::as_const(d->outgoingServers)) {
-        stream->disconnectFromHost();
+        disconnectStream(stream);
+    }
+}
+
+///
+/// Hands the client sessions over to another process of the server, e.g. a
+/// new version of it replacing this one without downtime.
+///
+/// The listening sockets stop accepting connections, but they stay open, so
+/// the other process can accept them using adoptClientListener() and
+/// adoptServerListener(). The descriptors need to be passed to it before,
+/// e.g. by starting it with inherited descriptors or over a Unix domain
+/// socket.
+///
+/// Sessions that can be resumed are detached from their connections, which
+/// are aborted without closing the stream (\xep{0198}). The returned data
+/// needs to be passed to adoptSessions() of the other process, the clients
+/// then resume their sessions there instead of logging in again. The other
+/// clients are sent a \c <see-other-host/> stream error if \a redirectHost
+/// is set, otherwise a \c <system-shutdown/> error.
+///
+/// close() needs to be called afterwards to close the remaining streams. It
+/// only closes the listening descriptors of this process.
+///
+/// \param redirectHost
+///
+/// \since QXmpp 1.6
+///
+QByteArray QXmppServer::handOver(const QString &redirectHost)
+{
+    for (auto *server : std::as_const(d->serversForClients)) {
+        server->pauseAccepting();
+    }
+    for (auto *server : std::as_const(d->serversForServers)) {
+        server->pauseAccepting();
+    }
+    d->rejectQueuedConnections();
+
+    const auto streamError = redirectHost.isEmpty()
+        ? QByteArrayLiteral("<stream:error><system-shutdown xmlns='urn:ietf:params:xml:ns:xmpp-streams'/></stream:error>")
+        : QStringLiteral("<stream:error><see-other-host xmlns='urn:ietf:params:xml:ns:xmpp-streams'>%1</see-other-host></stream:error>")
+              .arg(redirectHost.toHtmlEscaped())
+              .toUtf8();
+
+    struct Session
+    {
+        QString id;
+        QByteArray state;
+        QByteArray presence;
+    };
+    QVector<Session> sessions;
+
+    const auto clients = d->incomingClients;
+    for (auto *client : clients) {
+        Session session;
+        d->runInThreadOf(client, [&] {
+            session.id = client->streamManagementId();
+            const QString jid = client->jid();
+            session.state = client->detachStreamResumptionState();
+            if (!session.state.isEmpty()) {
+                // the stream is deleted once this returns, the server's
+                // thread waits meanwhile
+                d->unregisterIncomingClient(client);
+                session.presence = d->lastPresences.take(jid);
+            }
+        });
+
+        if (session.state.isEmpty()) {
+            QMetaObject::invokeMethod(client, [client, streamError] {
+                client->sendData(streamError);
+                client->disconnectFromHost();
+            });
+            continue;
+        }
+
+        // the user stays available, the session continues in the other
+        // process
+        d->incomingClients.remove(client);
+        d->pendingClients.remove(client);
+        d->releaseWorker(client);
+        sessions.append(std::move(session));
+    }
+    QXmppMetrics::setGauge(QXmppMetrics::IncomingClients, d->incomingClients.size());
+    d->info(QStringLiteral("Handed over %1 client sessions").arg(sessions.size()));
+
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << HAND_OVER_FORMAT_VERSION << quint32(sessions.size());
+    for (const auto &session : std::as_const(sessions)) {
+        stream << session.id << session.state << session.presence;
+    }
+    return data;
+}
+
+///
+/// Takes over the client sessions handed over by another process of the
+/// server using handOver().
+///
+/// The sessions are kept for the streamResumptionTimeout(), so their clients
+/// can resume them. Stanzas routed to them meanwhile are queued, clientConnected()
+/// is emitted for each of them.
+///
+/// Returns the number of sessions that have been taken over.
+///
+/// \param sessions
+///
+/// \since QXmpp 1.6
+///
+int QXmppServer::adoptSessions(const QByteArray &sessions)
+{
+    QDataStream stream(sessions);
+    quint32 version = 0;
+    quint32 count = 0;
+    stream >> version >> count;
+    if (stream.status() != QDataStream::Ok || version != HAND_OVER_FORMAT_VERSION) {
+        d->warning(QStringLiteral("Could not read the handed over sessions"));
+        return 0;
+    }
+
+    int adopted = 0;
+    for (quint32 i = 0; i < count; ++i) {
+        QString id;
+        QByteArray state;
+        QByteArray presence;
+        stream >> id >> state >> presence;
+        if (stream.status() != QDataStream::Ok) {
+            d->warning(QStringLiteral("Could not read the handed over sessions"));
+            break;
+        }
+
+        // the sessions don't have a connection, so they don't need a worker
+        auto *client = new QXmppIncomingClient(nullptr, d->domain, this);
+        d->setupIncomingClient(client);
+        const QString jid = client->restoreStreamResumptionState(id, state) ? client->jid() : QString();
+        if (jid.isEmpty() || d->incomingClientsByJid.contains(jid) || d->incomingClientsByStreamManagementId.contains(id)) {
+            delete client;
+            continue;
+        }
+
+        d->incomingClients.insert(client);
+        d->incomingClientsByStreamManagementId.insert(id, client);
+        d->incomingClientsByJid.insert(jid, client);
+        d->incomingClientsByBareJid[QXmppUtils::jidToBareJid(jid)].insert(client);
+        if (!presence.isEmpty()) {
+            d->lastPresences.insert(jid, presence);
+        }
+        if (d->sessionRegistry) {
+            d->sessionRegistry->addSession(jid, d->clusterNode);
+        }
+        d->routeCache.clear();
+        adopted++;
+
+        Q_EMIT clientConnected(jid);
     }
+    QXmppMetrics::setGauge(QXmppMetrics::IncomingClients, d->incomingClients.size());
+    d->info(QStringLiteral("Took over %1 client sessions").arg(adopted));
+    return adopted;
 }
 
 /// Listen for incoming XMPP server connections.
@@ -623,39 +3075,106 @@ void QXmppServer::close()
 
 bool QXmppServer::listenForServers(const QHostAddress &address, quint16 port)
 {
-    bool check;
-    Q_UNUSED(check)
+    return d->listen(false, false, address, port);
+}
+
+///
+/// Listens for incoming XMPP server connections using direct TLS
+/// (\xep{0368}).
+///
+/// The \c xmpp-server protocol is offered using ALPN. The port is usually
+/// announced using an \c _xmpps-server SRV record.
+///
+/// \sa listenForClientsWithDirectTls()
+///
+/// \param address
+/// \param port
+///
+/// \since QXmpp 1.6
+///
+bool QXmppServer::listenForServersWithDirectTls(const QHostAddress &address, quint16 port)
+{
+    return d->listen(false, true, address, port);
+}
+
+///
+/// Accepts server connections on a listening socket that has been created by
+/// another process.
+///
+/// \sa adoptClientListener()
+///
+/// \param socketDescriptor
+/// \param directTls whether the socket has been listening for direct TLS
+/// connections (\xep{0368})
+///
+/// \since QXmpp 1.6
+///
+bool QXmppServer::adoptServerListener(qintptr socketDescriptor, bool directTls)
+{
+    return d->adoptListener(false, directTls, socketDescriptor);
+}
+
+///
+/// Returns the descriptors of the sockets listening for server connections,
+/// so they can be passed to another process, see adoptServerListener().
+///
+/// \param directTls whether the descriptors of the sockets listening for
+/// direct TLS connections are returned (\xep{0368})
+///
+/// \since QXmpp 1.6
+///
+QVector<qintptr> QXmppServer::serverListenerDescriptors(bool directTls) const
+{
+    return d->listenerDescriptors(false, directTls);
+}
 
-    if (d->domain.isEmpty()) {
-        d->warning("No domain was specified!");
+///
+/// Listens for the links of the other nodes of the cluster.
+///
+/// The stanzas received on the links are only delivered to the clients of
+/// this node.
+///
+/// \param address
+/// \param port
+///
+/// \since QXmpp 1.6
+///
+bool QXmppServer::listenForClusterPeers(const QHostAddress &address, quint16 port)
+{
+    if (d->clusterNode.isEmpty()) {
+        d->warning(QStringLiteral("No cluster node was specified!"));
         return false;
     }
 
-    // create new server
-    auto *server = new QXmppSslServer(this);
-    server->addCaCertificates(d->caCertificates);
-    server->setLocalCertificate(d->localCertificate);
-    server->setPrivateKey(d->privateKey);
-
-    check = connect(server, SIGNAL(newConnection(QSslSocket *)),
-                    this, SLOT(_q_serverConnection(QSslSocket *)));
-    Q_ASSERT(check);
+    auto *server = new QTcpServer(this);
+    connect(server, &QTcpServer::newConnection, this, [this, server] {
+        const auto deliver = [this](const QString &to, const QByteArray &data) {
+            d->deliverFromPeer(to, data);
+        };
+        while (auto *socket = server->nextPendingConnection()) {
+            auto *connection = new QXmpp::Private::ClusterConnection(socket, d->clusterSecret, deliver, this);
+            d->clusterConnections.insert(connection);
+            connect(connection, &QObject::destroyed, this, [this, connection] {
+                d->clusterConnections.remove(connection);
+            });
+        }
+    });
 
     if (!server->listen(address, port)) {
-        d->warning(QString("Could not start listening for S2S on %1 %2").arg(address.toString(), QString::number(port)));
+        d->warning(QStringLiteral("Could not start listening for cluster peers on %1 %2").arg(address.toString(), QString::number(port)));
         delete server;
         return false;
     }
-    d->serversForServers.insert(server);
-
-    // start extensions
-    d->loadExtensions(this);
-    d->startExtensions();
+    d->serversForPeers.insert(server);
     return true;
 }
 
 /// Route an XMPP stanza.
 ///
+/// This may be called from any thread, e.g. by offloadable extensions. The
+/// stanza is then serialized in the calling thread and routed in the thread of
+/// the server, and true is returned.
+///
 /// \param element
 
 bool QXmppServer::sendElement(const QDomElement &element)
@@ -667,11 +3186,13 @@ bool QXmppServer::sendElement(const QDomElement &element)
     helperToXmlAddDomElement(&xmlStream, element, omitNamespaces);
 
     // route data
-    return d->routeData(element.attribute("to"), data);
+    return d->routeFromAnyThread(element.attribute("to"), std::move(data));
 }
 
 /// Route an XMPP packet.
 ///
+/// This may be called from any thread, like sendElement().
+///
 /// \param packet
 
 bool QXmppServer::sendPacket(const QXmppStanza &packet)
@@ -682,31 +3203,169 @@ bool QXmppServer::sendPacket(const QXmppStanza &packet)
     packet.toXml(&xmlStream);
 
     // route data
-    return d->routeData(packet.to(), data);
+    return d->routeFromAnyThread(packet.to(), std::move(data));
 }
 
-/// Add a new incoming client \a stream.
+
 ///
-/// This method can be used for instance to implement BOSH support
-/// as a server extension.
+/// Routes a stanza to several recipients, e.g. a presence to all subscribers
+/// of a contact.
+///
+/// The stanza is only serialized once. For each recipient, only the start of
+/// the element with its 'to' address is created, and it is joined with the
+/// shared rest of the stanza in the thread of the connection. The 'to'
+/// address of the stanza itself is ignored.
+///
+/// This may be called from any thread, like sendElement(). The stanza is then
+/// routed in the thread of the server, and the number of recipients is
+/// returned.
+///
+/// \param stanza
+/// \param recipients The JIDs the stanza is addressed to.
+///
+/// \return the number of recipients the stanza could be routed to
+///
+/// \since QXmpp 1.6
+///
+int QXmppServer::broadcastPacket(const QXmppStanza &stanza, const QStringList &recipients)
+{
+    // serialize data
+    QByteArray data;
+    QXmlStreamWriter xmlStream(&data);
+    stanza.toXml(&xmlStream);
 
-void QXmppServer::addIncomingClient(QXmppIncomingClient *stream)
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this, data = std::move(data), recipients] {
+            const auto [name, body] = splitStanza(QByteArray(data));
+            for (const auto &to : recipients) {
+                d->routeData(to, name + " to=\"" + to.toHtmlEscaped().toUtf8() + '"', body);
+            }
+        });
+        return recipients.size();
+    }
+
+    const auto [name, body] = splitStanza(std::move(data));
+
+    int routed = 0;
+    for (const auto &to : recipients) {
+        const auto head = name + " to=\"" + to.toHtmlEscaped().toUtf8() + '"';
+        if (d->routeData(to, head, body)) {
+            routed++;
+        }
+    }
+    return routed;
+}
+
+///
+/// Returns the bare JIDs of the users that receive the presences of a contact.
+///
+/// \param bareJid bare JID of the contact
+///
+/// \since QXmpp 1.6
+///
+QStringList QXmppServer::presenceSubscribers(const QString &bareJid) const
+{
+    return d->subscriberIndex.subscriberJids(bareJid);
+}
+
+///
+/// Returns the bare JIDs of the contacts whose presences a user receives.
+///
+/// This is the reverse of presenceSubscribers() and is looked up without
+/// going through all contacts.
+///
+/// \param bareJid bare JID of the user
+///
+/// \since QXmpp 1.6
+///
+QStringList QXmppServer::presenceSubscriptions(const QString &bareJid) const
+{
+    return d->subscriberIndex.subscriptionJids(bareJid);
+}
+
+///
+/// Sets the bare JIDs of the users that receive the presences of a contact.
+///
+/// This is usually done by an extension managing the rosters, once the
+/// roster of a user has been loaded. Subscribers may be local users or users
+/// of remote servers.
+///
+/// \param bareJid bare JID of the contact
+/// \param subscribers bare JIDs of the subscribers
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::setPresenceSubscribers(const QString &bareJid, const QStringList &subscribers)
+{
+    d->subscriberIndex.setSubscribers(bareJid, subscribers);
+}
+
+///
+/// Adds a user that receives the presences of a contact.
+///
+/// \param bareJid bare JID of the contact
+/// \param subscriber bare JID of the subscriber
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::addPresenceSubscriber(const QString &bareJid, const QString &subscriber)
+{
+    d->subscriberIndex.addSubscriber(bareJid, subscriber);
+}
+
+///
+/// Removes a user that receives the presences of a contact.
+///
+/// \param bareJid bare JID of the contact
+/// \param subscriber bare JID of the subscriber
+///
+/// \since QXmpp 1.6
+///
+void QXmppServer::removePresenceSubscriber(const QString &bareJid, const QString &subscriber)
 {
+    d->subscriberIndex.removeSubscriber(bareJid, subscriber);
+}
 
-    stream->setPasswordChecker(d->passwordChecker);
+///
+/// Sends a presence to all online resources of the subscribers of its sender.
+///
+/// The presence is serialized once and sent like broadcastPacket(). A
+/// presence equal to the last one broadcast for the same full JID is not
+/// sent again.
+///
+/// Broadcast presences without a 'to' address sent by local users are
+/// handled the same way, unless an extension handles them. When a user
+/// disconnects without sending an unavailable presence, one is broadcast for
+/// them.
+///
+/// \param presence presence with the full JID of its sender as 'from'
+///
+/// \return the number of subscribers the presence could be routed to
+///
+/// \since QXmpp 1.6
+///
+int QXmppServer::broadcastPresence(const QXmppPresence &presence)
+{
+    QByteArray data;
+    QXmlStreamWriter xmlStream(&data);
+    presence.toXml(&xmlStream);
 
-    connect(stream, &QXmppStream::connected,
-            this, &QXmppServer::_q_clientConnected);
+    return d->broadcastPresence(presence.from(), std::move(data), presence.type() == QXmppPresence::Available);
+}
 
-    connect(stream, &QXmppStream::disconnected,
-            this, &QXmppServer::_q_clientDisconnected);
+/// Add a new incoming client \a stream.
+///
+/// This method can be used for instance to implement BOSH support
+/// as a server extension.
 
-    connect(stream, &QXmppIncomingClient::elementReceived,
-            this, &QXmppServer::handleElement);
+void QXmppServer::addIncomingClient(QXmppIncomingClient *stream)
+{
+    d->setupIncomingClient(stream);
 
     // add stream
     d->incomingClients.insert(stream);
-    Q_EMIT setGauge("incoming-client.count", d->incomingClients.size());
+    d->pendingClients.insert(stream);
+    QXmppMetrics::setGauge(QXmppMetrics::IncomingClients, d->incomingClients.size());
 }
 
 /// Handle a new incoming TCP connection from a client.
@@ -721,10 +3380,32 @@ void QXmppServer::_q_clientConnection(QSslSocket *socket)
         return;
     }
 
-    auto *stream = new QXmppIncomingClient(socket, d->domain, this);
-    stream->setInactivityTimeout(120);
-    socket->setParent(stream);
-    addIncomingClient(stream);
+    // queued connections are started first
+    if (d->admissionQueue.empty() && d->canAdmitClient()) {
+        d->startIncomingClient(socket);
+        return;
+    }
+
+    if (int(d->admissionQueue.size()) >= d->admissionQueueSize) {
+        d->rejectConnection(socket, false);
+        return;
+    }
+
+    // wait for the limits to allow the connection, the socket buffers the
+    // data received in the meantime
+    socket->setParent(this);
+    connect(socket, &QAbstractSocket::disconnected, this, [this, socket] {
+        const auto itr = std::find_if(d->admissionQueue.begin(), d->admissionQueue.end(), [socket](const auto &queued) {
+            return queued.socket == socket;
+        });
+        if (itr != d->admissionQueue.end()) {
+            d->admissionQueue.erase(itr);
+            QXmppMetrics::setGauge(QXmppMetrics::ClientAdmissionQueueLength, qint64(d->admissionQueue.size()));
+        }
+        socket->deleteLater();
+    });
+    d->admissionQueue.push_back({ socket, QDeadlineTimer(d->admissionQueueTimeout) });
+    d->processAdmissionQueue();
 }
 
 /// Handle a successful stream connection for a client.
@@ -737,17 +3418,39 @@ void QXmppServer::_q_clientConnected()
         return;
     }
 
+    // the client doesn't count against the limit of pending clients anymore
+    if (d->pendingClients.remove(client) && !d->admissionQueue.empty()) {
+        d->processAdmissionQueue();
+    }
+
     // FIXME: at this point the JID must contain a resource, assert it?
     const QString jid = client->jid();
+    d->incomingClientsByStreamManagementId.insert(client->streamManagementId(), client);
+
+    // a resumed session has already taken over the routes of its old stream
+    if (d->resumedClients.remove(client)) {
+        return;
+    }
 
     // check whether the connection conflicts with another one
     QXmppIncomingClient *old = d->incomingClientsByJid.value(jid);
     if (old && old != client) {
-        old->sendData("<stream:error><conflict xmlns='urn:ietf:params:xml:ns:xmpp-streams'/><text xmlns='urn:ietf:params:xml:ns:xmpp-streams'>Replaced by new connection</text></stream:error>");
-        old->disconnectFromHost();
+        QMetaObject::invokeMethod(old, [old] {
+            old->sendData("<stream:error><conflict xmlns='urn:ietf:params:xml:ns:xmpp-streams'/><text xmlns='urn:ietf:params:xml:ns:xmpp-streams'>Replaced by new connection</text></stream:error>");
+            old->disconnectFromHost();
+        });
     }
     d->incomingClientsByJid.insert(jid, client);
     d->incomingClientsByBareJid[QXmppUtils::jidToBareJid(jid)].insert(client);
+    d->routeCache.clear();
+    if (d->sessionRegistry) {
+        d->sessionRegistry->addSession(jid, d->clusterNode);
+    }
+
+    // send messages received while the user was offline
+    if (d->incomingClientsByBareJid.value(QXmppUtils::jidToBareJid(jid)).size() == 1) {
+        d->replayOfflineMessages(client);
+    }
 
     // emit signal
     Q_EMIT clientConnected(jid);
@@ -765,30 +3468,72 @@ void QXmppServer::_q_clientDisconnected()
     if (d->incomingClients.remove(client)) {
         // remove stream from routing tables
         const QString jid = client->jid();
-        if (!jid.isEmpty()) {
-            if (d->incomingClientsByJid.value(jid) == client) {
-                d->incomingClientsByJid.remove(jid);
-            }
-            const QString bareJid = QXmppUtils::jidToBareJid(jid);
-            if (d->incomingClientsByBareJid.contains(bareJid)) {
-                d->incomingClientsByBareJid[bareJid].remove(client);
-                if (d->incomingClientsByBareJid[bareJid].isEmpty()) {
-                    d->incomingClientsByBareJid.remove(bareJid);
-                }
-            }
-        }
+        const bool wasAvailable = d->unregisterIncomingClient(client);
 
         // destroy client
+        d->releaseWorker(client);
         client->deleteLater();
 
+        // the user has gone offline without an unavailable presence
+        if (wasAvailable) {
+            QXmppPresence presence(QXmppPresence::Unavailable);
+            presence.setFrom(jid);
+            broadcastPresence(presence);
+        }
+
         // emit signal
         if (!jid.isEmpty()) {
             Q_EMIT clientDisconnected(jid);
         }
 
         // update counter
-        Q_EMIT setGauge("incoming-client.count", d->incomingClients.size());
+        QXmppMetrics::setGauge(QXmppMetrics::IncomingClients, d->incomingClients.size());
+
+        if (d->pendingClients.remove(client) && !d->admissionQueue.empty()) {
+            d->processAdmissionQueue();
+        }
+    }
+}
+
+/// Hands a stream management session kept by another stream over to the
+/// client that asked to resume it (\xep{0198}).
+///
+/// \param id
+
+void QXmppServer::_q_clientStreamResumptionRequested(const QString &id)
+{
+    auto *client = qobject_cast<QXmppIncomingClient *>(sender());
+    if (!client || !d->incomingClients.contains(client)) {
+        return;
+    }
+
+    // sessions can only be resumed by the same user
+    QByteArray state;
+    auto *old = d->incomingClientsByStreamManagementId.value(id);
+    if (old && old != client && QXmppUtils::jidToBareJid(old->jid()) == client->jid()) {
+        d->runInThreadOf(old, [&state, old, id] { state = old->takeStreamResumptionState(id); });
+    }
+
+    if (!state.isEmpty()) {
+        // the old stream deletes itself, its routes are taken over before
+        // more data is routed, so the new stream receives it after the
+        // resumed stanzas
+        const QString jid = old->jid();
+        d->incomingClients.remove(old);
+        d->unregisterIncomingClient(old);
+        d->releaseWorker(old);
+
+        d->incomingClientsByJid.insert(jid, client);
+        d->incomingClientsByBareJid[QXmppUtils::jidToBareJid(jid)].insert(client);
+        d->resumedClients.insert(client);
+        d->routeCache.clear();
+        if (d->sessionRegistry) {
+            d->sessionRegistry->addSession(jid, d->clusterNode);
+        }
+        QXmppMetrics::setGauge(QXmppMetrics::IncomingClients, d->incomingClients.size());
     }
+
+    QMetaObject::invokeMethod(client, [client, state] { client->resumeStream(state); });
 }
 
 void QXmppServer::_q_dialbackRequestReceived(const QXmppDialback &dialback)
@@ -800,11 +3545,7 @@ void QXmppServer::_q_dialbackRequestReceived(const QXmppDialback &dialback)
 
     if (dialback.command() == QXmppDialback::Verify) {
         // handle a verify request
-        for (auto *out : std::as_const(d->outgoingServers)) {
-            if (out->remoteDomain() != dialback.from()) {
-                continue;
-            }
-
+        if (auto *out = d->outgoingServersByDomain.value(dialback.from())) {
             bool isValid = dialback.key() == out->localStreamKey();
             QXmppDialback verify;
             verify.setCommand(QXmppDialback::Verify);
@@ -812,17 +3553,36 @@ void QXmppServer::_q_dialbackRequestReceived(const QXmppDialback &dialback)
             verify.setTo(dialback.from());
             verify.setFrom(d->domain);
             verify.setType(isValid ? "valid" : "invalid");
-            stream->sendPacket(verify);
-            return;
+            QMetaObject::invokeMethod(stream, [stream, verify] { stream->sendPacket(verify); });
         }
     }
 }
 
+/// Handle a domain verified on a bidirectional incoming server stream.
+///
+/// \param domain
+
+void QXmppServer::_q_bidirectionalDomainVerified(const QString &domain)
+{
+    auto *stream = qobject_cast<QXmppIncomingServer *>(sender());
+    if (!stream || !d->incomingServers.contains(stream)) {
+        return;
+    }
+
+    // new data for the domain is sent over the incoming stream, the outgoing
+    // stream is closed once it is idle
+    d->bidirectionalServersByDomain.insert(domain, stream);
+    d->routeCache.clear();
+}
+
 /// Handle an incoming XML element.
 
 void QXmppServer::handleElement(const QDomElement &element)
 {
-    handleStanza(this, element);
+    if (d->handleByExtensions(element)) {
+        return;
+    }
+    d->handleStanza(element);
 }
 
 /// Handle a stream disconnection for an outgoing server.
@@ -834,10 +3594,7 @@ void QXmppServer::_q_outgoingServerDisconnected()
         return;
     }
 
-    if (d->outgoingServers.remove(outgoing)) {
-        outgoing->deleteLater();
-        Q_EMIT setGauge("outgoing-server.count", d->outgoingServers.size());
-    }
+    d->removeOutgoingServer(outgoing);
 }
 
 /// Handle a new incoming TCP connection from a server.
@@ -853,21 +3610,27 @@ void QXmppServer::_q_serverConnection(QSslSocket *socket)
         return;
     }
 
-    auto *stream = new QXmppIncomingServer(socket, d->domain, this);
-    socket->setParent(stream);
-
-    connect(stream, &QXmppStream::disconnected,
-            this, &QXmppServer::_q_serverDisconnected);
-
-    connect(stream, &QXmppIncomingServer::dialbackRequestReceived,
-            this, &QXmppServer::_q_dialbackRequestReceived);
-
-    connect(stream, &QXmppIncomingServer::elementReceived,
-            this, &QXmppServer::handleElement);
+    QXmppIncomingServer *stream = nullptr;
+    const int worker = d->acquireWorker();
+    if (worker < 0) {
+        stream = new QXmppIncomingServer(socket, d->domain, this);
+        socket->setParent(stream);
+        d->setupIncomingServer(stream);
+    } else {
+        // create the stream in the worker, so all of its members live there
+        socket->moveToThread(d->workers[worker].thread);
+        d->runInWorker(worker, [&] {
+            stream = new QXmppIncomingServer(socket, d->domain, nullptr);
+            socket->setParent(stream);
+            relayLogging(stream, this);
+            d->setupIncomingServer(stream);
+        });
+        d->workerByStream.insert(stream, worker);
+    }
 
     // add stream
     d->incomingServers.insert(stream);
-    Q_EMIT setGauge("incoming-server.count", d->incomingServers.size());
+    QXmppMetrics::setGauge(QXmppMetrics::IncomingServers, d->incomingServers.size());
 }
 
 /// Handle a stream disconnection for an incoming server.
@@ -880,19 +3643,52 @@ void QXmppServer::_q_serverDisconnected()
     }
 
     if (d->incomingServers.remove(incoming)) {
+        for (auto itr = d->bidirectionalServersByDomain.begin(); itr != d->bidirectionalServersByDomain.end();) {
+            if (itr.value() == incoming) {
+                itr = d->bidirectionalServersByDomain.erase(itr);
+            } else {
+                ++itr;
+            }
+        }
+        d->routeCache.clear();
+        d->releaseWorker(incoming);
         incoming->deleteLater();
-        Q_EMIT setGauge("incoming-server.count", d->incomingServers.size());
+        QXmppMetrics::setGauge(QXmppMetrics::IncomingServers, d->incomingServers.size());
     }
 }
 
 class QXmppSslServerPrivate
 {
 public:
+    const QSslConfiguration &sslConfiguration();
+
     QList<QSslCertificate> caCertificates;
     QSslCertificate localCertificate;
     QSslKey privateKey;
+    // XEP-0368: the handshake is started right away, without STARTTLS
+    bool directTls = false;
+    QList<QByteArray> alpnProtocols;
+
+    // shared by all accepted sockets, rebuilt when the certificates change
+    std::optional<QSslConfiguration> cachedSslConfiguration;
 };
 
+const QSslConfiguration &QXmppSslServerPrivate::sslConfiguration()
+{
+    if (!cachedSslConfiguration) {
+        auto config = QSslConfiguration::defaultConfiguration();
+        config.setCaCertificates(config.caCertificates() + caCertificates);
+        config.setProtocol(QSsl::AnyProtocol);
+        config.setLocalCertificate(localCertificate);
+        config.setPrivateKey(privateKey);
+        if (!alpnProtocols.isEmpty()) {
+            config.setAllowedNextProtocols(alpnProtocols);
+        }
+        cachedSslConfiguration = std::move(config);
+    }
+    return *cachedSslConfiguration;
+}
+
 /// Constructs a new SSL server instance.
 ///
 /// \param parent
@@ -919,14 +3715,21 @@ void QXmppSslServer::incomingConnection(qintptr socketDescriptor)
         return;
     }
 
-    if (!d->localCertificate.isNull() && !d->privateKey.isNull()) {
-        auto sslConfig = socket->sslConfiguration();
-        sslConfig.setCaCertificates(sslConfig.caCertificates() + d->caCertificates);
-        socket->setSslConfiguration(sslConfig);
+    const bool hasCertificate = !d->localCertificate.isNull() && !d->privateKey.isNull();
+    if (hasCertificate) {
+        // implicitly shared, so this doesn't copy the certificates
+        socket->setSslConfiguration(d->sslConfiguration());
+    }
 
-        socket->setProtocol(QSsl::AnyProtocol);
-        socket->setLocalCertificate(d->localCertificate);
-        socket->setPrivateKey(d->privateKey);
+    if (d->directTls) {
+        // clients expect a TLS handshake, a plain stream error couldn't be
+        // read either
+        if (!hasCertificate) {
+            delete socket;
+            return;
+        }
+        // the stream header is read once the handshake is done
+        socket->startServerEncryption();
     }
     Q_EMIT newConnection(socket);
 }
@@ -939,6 +3742,7 @@ void QXmppSslServer::incomingConnection(qintptr socketDescriptor)
 void QXmppSslServer::addCaCertificates(const QList<QSslCertificate> &certificates)
 {
     d->caCertificates += certificates;
+    d->cachedSslConfiguration.reset();
 }
 
 /// Sets the local certificate to be used for incoming connections.
@@ -948,6 +3752,7 @@ void QXmppSslServer::addCaCertificates(const QList<QSslCertificate> &certificate
 void QXmppSslServer::setLocalCertificate(const QSslCertificate &certificate)
 {
     d->localCertificate = certificate;
+    d->cachedSslConfiguration.reset();
 }
 
 /// Sets the local private key to be used for incoming connections.
@@ -957,4 +3762,53 @@ void QXmppSslServer::setLocalCertificate(const QSslCertificate &certificate)
 void QXmppSslServer::setPrivateKey(const QSslKey &key)
 {
     d->privateKey = key;
+    d->cachedSslConfiguration.reset();
+}
+
+///
+/// Returns whether the TLS handshake is started right after a connection has
+/// been accepted (\xep{0368}).
+///
+/// \since QXmpp 1.6
+///
+bool QXmppSslServer::isDirectTls() const
+{
+    return d->directTls;
+}
+
+///
+/// Sets whether the TLS handshake is started right after a connection has
+/// been accepted, instead of after the client has requested STARTTLS in the
+/// stream (\xep{0368}).
+///
+/// This saves a round-trip and a stream restart per connection. Connections
+/// are closed if no local certificate and private key are set.
+///
+/// \since QXmpp 1.6
+///
+void QXmppSslServer::setDirectTls(bool directTls)
+{
+    d->directTls = directTls;
+}
+
+///
+/// Returns the application protocols offered in the TLS handshake (ALPN).
+///
+/// \since QXmpp 1.6
+///
+QList<QByteArray> QXmppSslServer::alpnProtocols() const
+{
+    return d->alpnProtocols;
+}
+
+///
+/// Sets the application protocols offered in the TLS handshake (ALPN), e.g.
+/// \c xmpp-client for direct TLS client connections (\xep{0368}).
+///
+/// \since QXmpp 1.6
+///
+void QXmppSslServer::setAlpnProtocols(const QList<QByteArray> &protocols)
+{
+    d->alpnProtocols = protocols;
+    d->cachedSslConfiguration.reset();
 }
@@ -6,9 +6,13 @@
 #define QXMPPSERVER_H
 
 #include "QXmppLogger.h"
+#include "QXmppOutgoingServer.h"
+#include "QXmppStream.h"
 
+#include <QStringList>
 #include <QTcpServer>
 #include <QVariantMap>
+#include <QVector>
 
 class QDomElement;
 class QSslCertificate;
@@ -17,14 +21,15 @@ class QSslSocket;
 
 class QXmppDialback;
 class QXmppIncomingClient;
+class QXmppOfflineMessageStorage;
 class QXmppOutgoingServer;
 class QXmppPasswordChecker;
 class QXmppPresence;
 class QXmppServerExtension;
 class QXmppServerPrivate;
+class QXmppSessionRegistry;
 class QXmppSslServer;
 class QXmppStanza;
-class QXmppStream;
 
 /// \brief The QXmppServer class represents an XMPP server.
 ///
@@ -44,6 +49,29 @@ class QXMPP_EXPORT QXmppServer : public QXmppLoggable
     Q_PROPERTY(QXmppLogger *logger READ logger WRITE setLogger NOTIFY loggerChanged)
 
 public:
+    ///
+    /// Traffic counters of a connection of the server.
+    ///
+    /// \since QXmpp 1.6
+    ///
+    struct ConnectionStatistics
+    {
+        /// Kind of a connection
+        enum Type {
+            IncomingClient,  ///< Stream of a client
+            IncomingServer,  ///< Stream opened by a remote server
+            OutgoingServer,  ///< Stream opened to a remote server
+        };
+
+        /// Kind of the connection
+        Type type = IncomingClient;
+        /// Full JID of the client or domain of the remote server, empty if it
+        /// is not known yet
+        QString remote;
+        /// Counters of the stream
+        QXmppStreamStatistics statistics;
+    };
+
     QXmppServer(QObject *parent = nullptr);
     ~QXmppServer() override;
 
@@ -61,7 +89,68 @@ public:
     QXmppPasswordChecker *passwordChecker();
     void setPasswordChecker(QXmppPasswordChecker *checker);
 
+    int workerThreadCount() const;
+    void setWorkerThreadCount(int count);
+    int extensionThreadCount() const;
+    void setExtensionThreadCount(int count);
+
+    int writeBatchSize() const;
+    void setWriteBatchSize(int bytes);
+    int writeBatchDelay() const;
+    void setWriteBatchDelay(int msecs);
+
+    double clientStanzaRateLimit() const;
+    qint64 clientByteRateLimit() const;
+    void setClientRateLimit(double stanzasPerSecond, qint64 bytesPerSecond);
+
+    int maximumPendingClients() const;
+    void setMaximumPendingClients(int clients);
+    double clientAcceptRate() const;
+    void setClientAcceptRate(double connectionsPerSecond);
+    int admissionQueueSize() const;
+    int admissionQueueTimeout() const;
+    void setAdmissionQueueLimit(int connections, int msecs);
+    QString overloadRedirectHost() const;
+    void setOverloadRedirectHost(const QString &host);
+
+    qint64 maximumStanzaSize() const;
+    void setMaximumStanzaSize(qint64 bytes);
+
+    int outgoingServerIdleTimeout() const;
+    void setOutgoingServerIdleTimeout(int msecs);
+    qint64 outgoingServerQueueSize() const;
+    int outgoingServerQueueTimeout() const;
+    void setOutgoingServerQueueLimit(qint64 bytes, int msecs);
+    QXmppOutgoingServer::QueueOverflowPolicy outgoingServerQueueOverflowPolicy() const;
+    void setOutgoingServerQueueOverflowPolicy(QXmppOutgoingServer::QueueOverflowPolicy policy);
+
+    int dialbackCacheTimeToLive() const;
+    void setDialbackCacheTimeToLive(int msecs);
+
+    QXmppOfflineMessageStorage *offlineMessageStorage() const;
+    void setOfflineMessageStorage(QXmppOfflineMessageStorage *storage);
+
+    int offlineMessageQuota() const;
+    void setOfflineMessageQuota(int messages);
+
+    int streamResumptionTimeout() const;
+    void setStreamResumptionTimeout(int secs);
+    qint64 streamManagementQueueLimit() const;
+    void setStreamManagementQueueLimit(qint64 bytes);
+
+    bool isRosterVersioningSupported() const;
+    void setRosterVersioningSupported(bool supported);
+
+    QString clusterNode() const;
+    void setClusterNode(const QString &node, const QByteArray &secret);
+    QXmppSessionRegistry *sessionRegistry() const;
+    void setSessionRegistry(QXmppSessionRegistry *registry);
+    void addClusterPeer(const QString &node, const QString &host, quint16 port);
+
     QVariantMap statistics() const;
+    QVector<ConnectionStatistics> busiestConnections(int count) const;
+    int slowHandlerThreshold() const;
+    void setSlowHandlerThreshold(int msecs);
 
     void addCaCertificates(const QString &caCertificates);
     void setLocalCertificate(const QString &path);
@@ -72,9 +161,27 @@ public:
     void close();
     bool listenForClients(const QHostAddress &address = QHostAddress::Any, quint16 port = 5222);
     bool listenForServers(const QHostAddress &address = QHostAddress::Any, quint16 port = 5269);
+    bool listenForClientsWithDirectTls(const QHostAddress &address = QHostAddress::Any, quint16 port = 5223);
+    bool listenForServersWithDirectTls(const QHostAddress &address = QHostAddress::Any, quint16 port = 5270);
+    bool listenForClusterPeers(const QHostAddress &address, quint16 port);
+
+    bool adoptClientListener(qintptr socketDescriptor, bool directTls = false);
+    bool adoptServerListener(qintptr socketDescriptor, bool directTls = false);
+    QVector<qintptr> clientListenerDescriptors(bool directTls = false) const;
+    QVector<qintptr> serverListenerDescriptors(bool directTls = false) const;
+    QByteArray handOver(const QString &redirectHost = QString());
+    int adoptSessions(const QByteArray &sessions);
 
     bool sendElement(const QDomElement &element);
     bool sendPacket(const QXmppStanza &stanza);
+    int broadcastPacket(const QXmppStanza &stanza, const QStringList &recipients);
+
+    QStringList presenceSubscribers(const QString &bareJid) const;
+    QStringList presenceSubscriptions(const QString &bareJid) const;
+    void setPresenceSubscribers(const QString &bareJid, const QStringList &subscribers);
+    void addPresenceSubscriber(const QString &bareJid, const QString &subscriber);
+    void removePresenceSubscriber(const QString &bareJid, const QString &subscriber);
+    int broadcastPresence(const QXmppPresence &presence);
 
     void addIncomingClient(QXmppIncomingClient *stream);
 
@@ -88,6 +195,12 @@ Q_SIGNALS:
     /// This signal is emitted when the logger changes.
     void loggerChanged(QXmppLogger *logger);
 
+    /// This signal is emitted when a message for a local user without online
+    /// resources has been queued for the offline message storage.
+    ///
+    /// \since QXmpp 1.6
+    void offlineMessageStored(const QString &bareJid, const QDomElement &message);
+
 public Q_SLOTS:
     void handleElement(const QDomElement &element);
 
@@ -95,7 +208,9 @@ private Q_SLOTS:
     void _q_clientConnection(QSslSocket *socket);
     void _q_clientConnected();
     void _q_clientDisconnected();
+    void _q_clientStreamResumptionRequested(const QString &id);
     void _q_dialbackRequestReceived(const QXmppDialback &dialback);
+    void _q_bidirectionalDomainVerified(const QString &domain);
     void _q_outgoingServerDisconnected();
     void _q_serverConnection(QSslSocket *socket);
     void _q_serverDisconnected();
@@ -122,6 +237,11 @@ public:
     void setLocalCertificate(const QSslCertificate &certificate);
     void setPrivateKey(const QSslKey &key);
 
+    bool isDirectTls() const;
+    void setDirectTls(bool directTls);
+    QList<QByteArray> alpnProtocols() const;
+    void setAlpnProtocols(const QList<QByteArray> &protocols);
+
 Q_SIGNALS:
     /// This signal is emitted when a new connection is established.
     void newConnection(QSslSocket *socket);
@@ -69,6 +69,51 @@ int QXmppServerExtension::extensionPriority() const
     return 0;
 }
 
+///
+/// Returns the stanzas the extension handles.
+///
+/// The server only passes stanzas matching at least one of the filters to
+/// handleStanza(), so stanzas e.g. routed to local users don't need to be
+/// looked at by every extension. The filters are read when the extension is
+/// added to the server.
+///
+/// The default implementation returns no filters, which means that all
+/// stanzas are passed to the extension.
+///
+/// \since QXmpp 1.6
+///
+QVector<QXmppServerExtension::StanzaFilter> QXmppServerExtension::stanzaFilters() const
+{
+    return {};
+}
+
+///
+/// Returns whether the server may call handleStanza() in a thread pool.
+///
+/// Extensions doing slow work, e.g. waiting for a database, would otherwise
+/// block the routing of all stanzas. The stanzas of offloadable extensions are
+/// handled in the threads of the pool, one after another for each sender JID
+/// in the order they have been received, and stanzas of different senders in
+/// parallel. The number of threads is set by
+/// QXmppServer::setExtensionThreadCount().
+///
+/// handleStanza() must then be thread-safe. It gets its own copy of the
+/// stanza, and it may only use the thread-safe parts of the server, i.e.
+/// QXmppServer::sendElement(), QXmppServer::sendPacket() and
+/// QXmppServer::broadcastPacket(). If it returns false, the stanza is passed
+/// to the next extension in the thread of the server. Other stanzas may have
+/// been routed in the meantime, so the order is only kept among the stanzas
+/// handled by the extension.
+///
+/// The default implementation returns false.
+///
+/// \since QXmpp 1.6
+///
+bool QXmppServerExtension::isOffloadable() const
+{
+    return false;
+}
+
 /// Handles an incoming XMPP stanza.
 ///
 /// Return true if no further processing should occur, false otherwise.
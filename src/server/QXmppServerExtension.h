@@ -8,6 +8,7 @@
 #include "QXmppLogger.h"
 
 #include <QVariant>
+#include <QVector>
 
 class QDomElement;
 
@@ -30,10 +31,29 @@ class QXMPP_EXPORT QXmppServerExtension : public QXmppLoggable
     Q_OBJECT
 
 public:
+    ///
+    /// Describes stanzas handled by an extension. Empty fields match any
+    /// value.
+    ///
+    /// \since QXmpp 1.6
+    ///
+    struct StanzaFilter
+    {
+        /// Tag name of the stanza, e.g. "iq"
+        QString tagName;
+        /// Namespace of the first child element of the stanza, e.g.
+        /// "http://jabber.org/protocol/disco#info"
+        QString payloadNamespace;
+        /// Domain of the 'to' address of the stanza
+        QString to;
+    };
+
     QXmppServerExtension();
     ~QXmppServerExtension() override;
     virtual QString extensionName() const;
     virtual int extensionPriority() const;
+    virtual QVector<StanzaFilter> stanzaFilters() const;
+    virtual bool isOffloadable() const;
 
     virtual QStringList discoveryFeatures() const;
     virtual QStringList discoveryItems() const;
@@ -0,0 +1,37 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+///
+/// \class QXmppServerRosterStorage
+///
+/// \brief The QXmppServerRosterStorage class persists the rosters of the
+/// users of a QXmppServer.
+///
+/// QXmppRosterExtension keeps all rosters in memory and answers every request
+/// from there. The storage is only read once when the extension is started,
+/// and changed rosters are written behind in batches, so a database
+/// implementation can write each batch in one transaction. Implement this
+/// interface and pass it to QXmppRosterExtension::setStorage().
+///
+/// The batches must be applied in the order they are passed.
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+
+///
+/// \fn QXmppServerRosterStorage::loadRosters()
+///
+/// Returns all stored rosters.
+///
+
+///
+/// \fn QXmppServerRosterStorage::storeRosters(const QVector<Roster> &rosters)
+///
+/// Stores a batch of changes.
+///
+/// \param rosters rosters that have been changed, each replacing the stored
+/// roster of the same owner including all of its contacts
+///
@@ -0,0 +1,56 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPSERVERROSTERSTORAGE_H
+#define QXMPPSERVERROSTERSTORAGE_H
+
+#include "QXmppRosterIq.h"
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+template<typename T>
+class QXmppTask;
+
+class QXMPP_EXPORT QXmppServerRosterStorage
+{
+public:
+    ///
+    /// Contact in the roster of a user
+    ///
+    struct Contact
+    {
+        /// bare JID of the contact
+        QString jid;
+        /// name given by the user
+        QString name;
+        /// groups of the contact, sorted
+        QStringList groups;
+        /// presence subscription state
+        QXmppRosterIq::Item::SubscriptionType subscriptionType = QXmppRosterIq::Item::None;
+        /// whether the user has asked the contact for a subscription
+        bool subscriptionPending = false;
+    };
+
+    ///
+    /// Roster of a user
+    ///
+    struct Roster
+    {
+        /// bare JID of the owner
+        QString owner;
+        /// version of the roster, increased on every change (\xep{0237})
+        quint64 version = 0;
+        /// contacts sorted by their JID
+        QVector<Contact> contacts;
+    };
+
+    virtual ~QXmppServerRosterStorage() = default;
+
+    virtual QXmppTask<QVector<Roster>> loadRosters() = 0;
+    virtual QXmppTask<void> storeRosters(const QVector<Roster> &rosters) = 0;
+};
+
+#endif  // QXMPPSERVERROSTERSTORAGE_H
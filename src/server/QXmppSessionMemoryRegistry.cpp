@@ -0,0 +1,78 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppSessionMemoryRegistry.h"
+
+#include "QXmppFutureUtils_p.h"
+
+#include <QHash>
+
+using namespace QXmpp::Private;
+
+///
+/// \class QXmppSessionMemoryRegistry
+///
+/// \brief The QXmppSessionMemoryRegistry class records the client sessions of
+/// a cluster in the memory.
+///
+/// It can only be shared by nodes running in the same process, e.g. servers
+/// listening on several interfaces or tests. The sessions are lost when the
+/// registry is destroyed.
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+
+class QXmppSessionMemoryRegistryPrivate
+{
+public:
+    // nodes by full JID
+    QHash<QString, QString> sessions;
+};
+
+///
+/// Constructs a session memory registry.
+///
+QXmppSessionMemoryRegistry::QXmppSessionMemoryRegistry(QObject *parent)
+    : QXmppSessionRegistry(parent),
+      d(std::make_unique<QXmppSessionMemoryRegistryPrivate>())
+{
+}
+
+QXmppSessionMemoryRegistry::~QXmppSessionMemoryRegistry() = default;
+
+/// \cond
+QXmppTask<QVector<QXmppSessionRegistry::Session>> QXmppSessionMemoryRegistry::sessions()
+{
+    QVector<Session> sessions;
+    sessions.reserve(d->sessions.size());
+    for (auto itr = d->sessions.cbegin(); itr != d->sessions.cend(); ++itr) {
+        sessions.append({ itr.key(), itr.value() });
+    }
+    return makeReadyTask(std::move(sessions));
+}
+
+void QXmppSessionMemoryRegistry::addSession(const QString &jid, const QString &node)
+{
+    const auto previous = d->sessions.value(jid);
+    if (previous == node) {
+        return;
+    }
+    if (!previous.isEmpty()) {
+        Q_EMIT sessionRemoved(jid, previous);
+    }
+    d->sessions.insert(jid, node);
+    Q_EMIT sessionAdded(jid, node);
+}
+
+void QXmppSessionMemoryRegistry::removeSession(const QString &jid, const QString &node)
+{
+    const auto itr = d->sessions.find(jid);
+    if (itr != d->sessions.end() && itr.value() == node) {
+        d->sessions.erase(itr);
+        Q_EMIT sessionRemoved(jid, node);
+    }
+}
+/// \endcond
@@ -0,0 +1,32 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPSESSIONMEMORYREGISTRY_H
+#define QXMPPSESSIONMEMORYREGISTRY_H
+
+#include "QXmppSessionRegistry.h"
+
+#include <memory>
+
+class QXmppSessionMemoryRegistryPrivate;
+
+class QXMPP_EXPORT QXmppSessionMemoryRegistry : public QXmppSessionRegistry
+{
+    Q_OBJECT
+
+public:
+    explicit QXmppSessionMemoryRegistry(QObject *parent = nullptr);
+    ~QXmppSessionMemoryRegistry() override;
+
+    /// \cond
+    QXmppTask<QVector<Session>> sessions() override;
+    void addSession(const QString &jid, const QString &node) override;
+    void removeSession(const QString &jid, const QString &node) override;
+    /// \endcond
+
+private:
+    const std::unique_ptr<QXmppSessionMemoryRegistryPrivate> d;
+};
+
+#endif  // QXMPPSESSIONMEMORYREGISTRY_H
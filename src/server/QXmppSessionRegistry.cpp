@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppSessionRegistry.h"
+
+///
+/// \class QXmppSessionRegistry
+///
+/// \brief The QXmppSessionRegistry class records the client sessions of the
+/// nodes of a QXmppServer cluster.
+///
+/// All nodes serving a domain share a registry. Each node adds the sessions
+/// of its clients and removes them when the clients disconnect. The registry
+/// reports the changes of all nodes with sessionAdded() and sessionRemoved(),
+/// so each node can keep a local view of the sessions of the others and route
+/// without waiting for the registry.
+///
+/// Implementations may keep the sessions in an external key-value store and
+/// report the changes of other nodes from its notifications. They should
+/// drop the sessions of nodes that have stopped without removing them.
+///
+/// \warning THIS API IS NOT FINALIZED YET!
+///
+/// \since QXmpp 1.6
+///
+
+///
+/// \fn QXmppSessionRegistry::sessions
+///
+/// Returns the sessions of all nodes, for a node that has just joined the
+/// cluster.
+///
+
+///
+/// \fn QXmppSessionRegistry::addSession
+///
+/// Adds the session of a client with the full \a jid connected to \a node.
+///
+/// A later session with the same JID replaces the earlier one.
+///
+
+///
+/// \fn QXmppSessionRegistry::removeSession
+///
+/// Removes the session of a client with the full \a jid connected to \a node.
+///
+/// Sessions of the JID on other nodes are not removed.
+///
+
+///
+/// Constructs a session registry.
+///
+QXmppSessionRegistry::QXmppSessionRegistry(QObject *parent)
+    : QObject(parent)
+{
+}
+
+QXmppSessionRegistry::~QXmppSessionRegistry() = default;
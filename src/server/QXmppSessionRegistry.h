@@ -0,0 +1,48 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPSESSIONREGISTRY_H
+#define QXMPPSESSIONREGISTRY_H
+
+#include "QXmppGlobal.h"
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+template<typename T>
+class QXmppTask;
+
+class QXMPP_EXPORT QXmppSessionRegistry : public QObject
+{
+    Q_OBJECT
+
+public:
+    ///
+    /// Client session on a node of the cluster
+    ///
+    struct Session
+    {
+        /// full JID of the client
+        QString jid;
+        /// name of the node the client is connected to
+        QString node;
+    };
+
+    explicit QXmppSessionRegistry(QObject *parent = nullptr);
+    ~QXmppSessionRegistry() override;
+
+    virtual QXmppTask<QVector<Session>> sessions() = 0;
+    virtual void addSession(const QString &jid, const QString &node) = 0;
+    virtual void removeSession(const QString &jid, const QString &node) = 0;
+
+Q_SIGNALS:
+    /// This signal is emitted when a session has been added on any node.
+    void sessionAdded(const QString &jid, const QString &node);
+
+    /// This signal is emitted when a session has been removed on any node.
+    void sessionRemoved(const QString &jid, const QString &node);
+};
+
+#endif  // QXMPPSESSIONREGISTRY_H
@@ -0,0 +1,173 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef QXMPPSUBSCRIBERINDEX_P_H
+#define QXMPPSUBSCRIBERINDEX_P_H
+
+#include "QXmppJid.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include <QByteArray>
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the QXmpp API. It exists for the convenience
+// of QXmppServer.
+//
+// This header file may change from version to version without notice,
+// or even be removed.
+//
+// We mean it.
+//
+
+namespace QXmpp::Private {
+
+//
+// Presence subscribers by contact.
+//
+// Bare JIDs are numbered once, the subscribers of a contact and the contacts
+// a JID is subscribed to are sorted arrays of those numbers. Each JID also keeps its serialized 'to' attribute,
+// so broadcasts don't need to escape and encode the address again.
+//
+class SubscriberIndex
+{
+public:
+    struct Node
+    {
+        QXmppJid jid;
+        // ' to="jid"'
+        QByteArray toAttribute;
+        QVector<quint32> subscribers;
+        // contacts whose presences the JID receives
+        QVector<quint32> subscriptions;
+    };
+
+    const Node &node(quint32 id) const { return m_nodes[id]; }
+
+    // Returns the subscribers of a contact, or nullptr if it has none.
+    const QVector<quint32> *subscribers(const QString &bareJid) const
+    {
+        const auto itr = m_ids.constFind(bareJid);
+        if (itr == m_ids.constEnd() || m_nodes[*itr].subscribers.isEmpty()) {
+            return nullptr;
+        }
+        return &m_nodes[*itr].subscribers;
+    }
+
+    QStringList subscriberJids(const QString &bareJid) const
+    {
+        return jids(subscribers(bareJid));
+    }
+
+    QStringList subscriptionJids(const QString &bareJid) const
+    {
+        const auto itr = m_ids.constFind(bareJid);
+        return itr == m_ids.constEnd() ? QStringList() : jids(&m_nodes[*itr].subscriptions);
+    }
+
+    void setSubscribers(const QString &bareJid, const QStringList &subscribers)
+    {
+        QVector<quint32> ids;
+        ids.reserve(subscribers.size());
+        for (const auto &subscriber : subscribers) {
+            ids << id(subscriber);
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        ids.squeeze();
+
+        const auto contactId = id(bareJid);
+        const auto previous = std::exchange(m_nodes[contactId].subscribers, ids);
+        QVector<quint32> changed;
+        std::set_difference(previous.cbegin(), previous.cend(), ids.cbegin(), ids.cend(), std::back_inserter(changed));
+        for (const auto subscriberId : std::as_const(changed)) {
+            removeSorted(m_nodes[subscriberId].subscriptions, contactId);
+        }
+        changed.clear();
+        std::set_difference(ids.cbegin(), ids.cend(), previous.cbegin(), previous.cend(), std::back_inserter(changed));
+        for (const auto subscriberId : std::as_const(changed)) {
+            insertSorted(m_nodes[subscriberId].subscriptions, contactId);
+        }
+    }
+
+    void addSubscriber(const QString &bareJid, const QString &subscriber)
+    {
+        const auto subscriberId = id(subscriber);
+        const auto contactId = id(bareJid);
+        if (insertSorted(m_nodes[contactId].subscribers, subscriberId)) {
+            insertSorted(m_nodes[subscriberId].subscriptions, contactId);
+        }
+    }
+
+    void removeSubscriber(const QString &bareJid, const QString &subscriber)
+    {
+        const auto contact = m_ids.constFind(bareJid);
+        const auto subscriberId = m_ids.constFind(subscriber);
+        if (contact == m_ids.constEnd() || subscriberId == m_ids.constEnd()) {
+            return;
+        }
+        if (removeSorted(m_nodes[*contact].subscribers, *subscriberId)) {
+            removeSorted(m_nodes[*subscriberId].subscriptions, *contact);
+        }
+    }
+
+private:
+    static bool insertSorted(QVector<quint32> &ids, quint32 id)
+    {
+        const auto itr = std::lower_bound(ids.begin(), ids.end(), id);
+        if (itr != ids.end() && *itr == id) {
+            return false;
+        }
+        ids.insert(itr, id);
+        return true;
+    }
+
+    static bool removeSorted(QVector<quint32> &ids, quint32 id)
+    {
+        const auto itr = std::lower_bound(ids.begin(), ids.end(), id);
+        if (itr == ids.end() || *itr != id) {
+            return false;
+        }
+        ids.erase(itr);
+        return true;
+    }
+
+    QStringList jids(const QVector<quint32> *ids) const
+    {
+        QStringList jids;
+        if (ids) {
+            jids.reserve(ids->size());
+            for (const auto id : *ids) {
+                jids << m_nodes[id].jid.toString();
+            }
+        }
+        return jids;
+    }
+
+    quint32 id(const QString &bareJid)
+    {
+        if (const auto itr = m_ids.constFind(bareJid); itr != m_ids.constEnd()) {
+            return *itr;
+        }
+        const auto id = quint32(m_nodes.size());
+        m_nodes.append({ QXmppJid(bareJid), " to=\"" + bareJid.toHtmlEscaped().toUtf8() + '"', {} });
+        m_ids.insert(bareJid, id);
+        return id;
+    }
+
+    QHash<QString, quint32> m_ids;
+    QVector<Node> m_nodes;
+};
+
+}  // namespace QXmpp::Private
+
+#endif  // QXMPPSUBSCRIBERINDEX_P_H
@@ -23,6 +23,7 @@ public:
         // clear extensions
         qDeleteAll(d->extensions);
         d->extensions.clear();
+        d->lazyExtensions.clear();
         // enable stream management (so IQ requests are not stopped)
         d->stream->enableStreamManagement(true);
         // setup logging (for expect())
@@ -49,6 +50,10 @@ public:
         QCOMPARE(m_sentPackets.takeFirst(), packet.replace(u'\'', u'"'));
         resetIdCount();
     }
+    void expectNoPacket()
+    {
+        QVERIFY2(m_sentPackets.empty(), "Unexpected packet was sent!");
+    }
     QString takePacket()
     {
         [this]() { QVERIFY(!m_sentPackets.isEmpty()); }();
@@ -0,0 +1,144 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#ifndef ALLOCATIONS_H
+#define ALLOCATIONS_H
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <QTest>
+
+//
+// Counting of heap allocations
+//
+// On glibc, malloc() and friends are replaced to count the allocations of Qt
+// containers and of operator new. On other platforms, only the replaceable
+// global operator new is hooked, so allocations of Qt containers are missed.
+//
+// This may only be included by one source file of a benchmark.
+//
+static std::atomic<bool> allocationCountingEnabled = false;
+static std::atomic<qint64> allocationCount = 0;
+static std::atomic<qint64> allocationBytes = 0;
+
+#if defined(__GLIBC__)
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size) noexcept
+{
+    if (allocationCountingEnabled.load(std::memory_order_relaxed)) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocationBytes.fetch_add(qint64(size), std::memory_order_relaxed);
+    }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) noexcept
+{
+    if (allocationCountingEnabled.load(std::memory_order_relaxed)) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocationBytes.fetch_add(qint64(count * size), std::memory_order_relaxed);
+    }
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) noexcept
+{
+    if (allocationCountingEnabled.load(std::memory_order_relaxed)) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocationBytes.fetch_add(qint64(size), std::memory_order_relaxed);
+    }
+    return __libc_realloc(pointer, size);
+}
+}
+#else
+
+// operator new calls malloc() on glibc, so it is only replaced on the other
+// platforms
+void *operator new(std::size_t size)
+{
+    if (allocationCountingEnabled.load(std::memory_order_relaxed)) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocationBytes.fetch_add(qint64(size), std::memory_order_relaxed);
+    }
+    if (auto *pointer = std::malloc(size ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete[](void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+#endif
+
+//
+// Counts the heap allocations while it exists, e.g. to compare the costs of a
+// subsystem in a benchmark or to check that a hot path doesn't allocate.
+// Counters can't be nested.
+//
+class AllocationCounter
+{
+public:
+    AllocationCounter()
+    {
+        allocationCount = 0;
+        allocationBytes = 0;
+        allocationCountingEnabled = true;
+    }
+    ~AllocationCounter() { stop(); }
+
+    AllocationCounter(const AllocationCounter &) = delete;
+    AllocationCounter &operator=(const AllocationCounter &) = delete;
+
+    // Stops counting, the counts are kept.
+    void stop() { allocationCountingEnabled = false; }
+
+    qint64 count() const { return allocationCount.load(); }
+    qint64 bytes() const { return allocationBytes.load(); }
+};
+
+// Prints the number of heap allocations and the allocated bytes of one call of
+// the function. Reallocations count with their new size.
+template<typename Function>
+static void reportAllocations(Function function, const char *unit = "stanza")
+{
+    AllocationCounter counter;
+    function();
+    counter.stop();
+    qInfo().noquote() << QStringLiteral("%1: %2 allocations (%3 bytes) per %4")
+                             .arg(QString::fromLatin1(QTest::currentTestFunction()))
+                             .arg(counter.count())
+                             .arg(counter.bytes())
+                             .arg(QString::fromLatin1(unit));
+}
+
+#endif  // ALLOCATIONS_H
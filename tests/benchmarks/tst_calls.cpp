@@ -0,0 +1,260 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppCall.h"
+#include "QXmppCallManager.h"
+#include "QXmppCallStream.h"
+#include "QXmppClient.h"
+#include "QXmppServer.h"
+
+#include "util.h"
+
+#include <algorithm>
+#include <memory>
+
+#include <gst/gst.h>
+
+#include <QElapsedTimer>
+#include <QFile>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+//
+// Benchmark of concurrent calls between two in-process clients
+//
+// Every call has an audio stream in both directions, fed by a live test source
+// and consumed by a fake sink. The CPU time, the memory and the threads are
+// those of the whole process, i.e. both ends of the calls. The workload can be
+// configured using environment variables:
+//
+//  QXMPP_BENCH_CALLS    number of concurrent calls (10)
+//  QXMPP_BENCH_SECONDS  duration of the calls in seconds (3)
+//  QXMPP_BENCH_PORT     port of the server (12410)
+//
+
+static int environmentValue(const char *name, int defaultValue)
+{
+    bool ok = false;
+    const int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok ? value : defaultValue;
+}
+
+// user and system CPU time of the process in microseconds
+static qint64 cpuTime()
+{
+#ifdef Q_OS_UNIX
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return (qint64(usage.ru_utime.tv_sec) + usage.ru_stime.tv_sec) * 1000000 +
+            usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+    }
+#endif
+    return -1;
+}
+
+// value of a field of /proc/self/status, e.g. the number of threads
+static qint64 processStatus(const QByteArray &field)
+{
+#ifdef Q_OS_LINUX
+    QFile file(QStringLiteral("/proc/self/status"));
+    if (file.open(QIODevice::ReadOnly)) {
+        const auto lines = file.readAll().split('\n');
+        for (const auto &line : lines) {
+            if (line.startsWith(field + ':')) {
+                return line.mid(field.size() + 1).trimmed().split(' ').constFirst().toLongLong();
+            }
+        }
+    }
+#else
+    Q_UNUSED(field)
+#endif
+    return -1;
+}
+
+// feeds the audio stream of a call with a test signal and discards the received audio
+static void connectTestMedia(QXmppCall *call)
+{
+    auto *pipeline = call->pipeline();
+    auto *stream = call->audioStream();
+    QVERIFY(stream);
+
+    stream->setSendPadCallback([pipeline](GstPad *pad) {
+        auto *source = gst_parse_bin_from_description("audiotestsrc is-live=true ! audioconvert ! audioresample", true, nullptr);
+        if (!source) {
+            qFatal("Failed to create test source");
+        }
+        gst_bin_add(GST_BIN(pipeline), source);
+        auto *sourcePad = gst_element_get_static_pad(source, "src");
+        if (gst_pad_link(sourcePad, pad) != GST_PAD_LINK_OK) {
+            qFatal("Failed to link test source");
+        }
+        gst_object_unref(sourcePad);
+        gst_element_sync_state_with_parent(source);
+    });
+    // called from a streaming thread
+    stream->setReceivePadCallback([pipeline](GstPad *pad) {
+        auto *sink = gst_element_factory_make("fakesink", nullptr);
+        if (!sink) {
+            qFatal("Failed to create fake sink");
+        }
+        g_object_set(sink, "async", false, "sync", false, nullptr);
+        gst_bin_add(GST_BIN(pipeline), sink);
+        auto *sinkPad = gst_element_get_static_pad(sink, "sink");
+        if (gst_pad_link(pad, sinkPad) != GST_PAD_LINK_OK) {
+            qFatal("Failed to link fake sink");
+        }
+        gst_object_unref(sinkPad);
+        gst_element_sync_state_with_parent(sink);
+    });
+}
+
+class tst_Calls : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void initTestCase();
+    Q_SLOT void cleanupTestCase();
+    Q_SLOT void calls_data();
+    Q_SLOT void calls();
+
+    std::unique_ptr<QXmppClient> connectClient(const QString &user);
+
+    int m_callCount = 0;
+    int m_seconds = 0;
+    quint16 m_port = 0;
+    TestPasswordChecker m_passwordChecker;
+    std::unique_ptr<QXmppServer> m_server;
+};
+
+void tst_Calls::initTestCase()
+{
+    if (!qEnvironmentVariableIsEmpty("QXMPP_TESTS_SKIP_CALL_MANAGER")) {
+        QSKIP("Skipping because 'QXMPP_TESTS_SKIP_CALL_MANAGER' was set.");
+    }
+
+    m_callCount = std::max(1, environmentValue("QXMPP_BENCH_CALLS", 10));
+    m_seconds = std::max(1, environmentValue("QXMPP_BENCH_SECONDS", 3));
+    m_port = quint16(environmentValue("QXMPP_BENCH_PORT", 12410));
+
+    m_passwordChecker.addCredentials(QStringLiteral("caller"), QStringLiteral("password"));
+    m_passwordChecker.addCredentials(QStringLiteral("callee"), QStringLiteral("password"));
+
+    m_server = std::make_unique<QXmppServer>();
+    m_server->setDomain(QStringLiteral("localhost"));
+    m_server->setPasswordChecker(&m_passwordChecker);
+    QVERIFY(m_server->listenForClients(QHostAddress::LocalHost, m_port));
+}
+
+void tst_Calls::cleanupTestCase()
+{
+    m_server.reset();
+}
+
+void tst_Calls::calls_data()
+{
+    QTest::addColumn<bool>("sharedPipeline");
+
+    QTest::newRow("separate pipelines") << false;
+    QTest::newRow("shared pipeline") << true;
+}
+
+void tst_Calls::calls()
+{
+    QFETCH(bool, sharedPipeline);
+
+    // the calls are deleted by the managers
+    auto callerManager = new QXmppCallManager;
+    auto calleeManager = new QXmppCallManager;
+    callerManager->setSharedPipelineEnabled(sharedPipeline);
+    calleeManager->setSharedPipelineEnabled(sharedPipeline);
+
+    int connected = 0;
+    int finished = 0;
+    const auto watchCall = [&](QXmppCall *call) {
+        connect(call, &QXmppCall::connected, this, [&connected]() { connected++; });
+        connect(call, &QXmppCall::finished, this, [&finished]() { finished++; });
+    };
+    connect(calleeManager, &QXmppCallManager::callReceived, this, [&](QXmppCall *call) {
+        watchCall(call);
+        connectTestMedia(call);
+        call->accept();
+    });
+
+    auto caller = connectClient(QStringLiteral("caller"));
+    auto callee = connectClient(QStringLiteral("callee"));
+    caller->addExtension(callerManager);
+    callee->addExtension(calleeManager);
+    QTRY_VERIFY_WITH_TIMEOUT(caller->isConnected() && callee->isConnected(), 10000);
+
+    const auto threadsBefore = processStatus("Threads");
+    const auto rssBefore = processStatus("VmRSS");
+    QElapsedTimer timer;
+    timer.start();
+
+    QList<QXmppCall *> calls;
+    for (int i = 0; i < m_callCount; i++) {
+        auto *call = callerManager->call(callee->configuration().jid());
+        QVERIFY(call);
+        watchCall(call);
+        connectTestMedia(call);
+        calls << call;
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(connected, 2 * m_callCount, 60000);
+    const auto setupTime = timer.elapsed();
+
+    // let the media flow
+    const auto cpuBefore = cpuTime();
+    timer.restart();
+    QTest::qWait(m_seconds * 1000);
+    const auto cpuAfter = cpuTime();
+    const auto talkTime = timer.elapsed();
+
+    const auto tag = QString::fromLatin1(QTest::currentDataTag());
+    qInfo().noquote() << QStringLiteral("%1: %2 calls set up in %3 ms")
+                             .arg(tag)
+                             .arg(m_callCount)
+                             .arg(setupTime);
+    if (cpuBefore >= 0) {
+        qInfo().noquote() << QStringLiteral("%1: %2 % CPU per call")
+                                 .arg(tag)
+                                 .arg(100.0 * double(cpuAfter - cpuBefore) / double(talkTime * 1000) / m_callCount, 0, 'f', 2);
+    }
+    if (threadsBefore >= 0 && rssBefore >= 0) {
+        qInfo().noquote() << QStringLiteral("%1: %2 threads and %3 kB RSS per call")
+                                 .arg(tag)
+                                 .arg(double(processStatus("Threads") - threadsBefore) / m_callCount, 0, 'f', 1)
+                                 .arg((processStatus("VmRSS") - rssBefore) / m_callCount);
+    }
+
+    for (auto *call : std::as_const(calls)) {
+        call->hangup();
+    }
+    QTRY_COMPARE_WITH_TIMEOUT(finished, 2 * m_callCount, 30000);
+
+    caller->disconnectFromServer();
+    callee->disconnectFromServer();
+}
+
+std::unique_ptr<QXmppClient> tst_Calls::connectClient(const QString &user)
+{
+    auto client = std::make_unique<QXmppClient>(QXmppClient::NoExtensions);
+
+    QXmppConfiguration config;
+    config.setDomain(QStringLiteral("localhost"));
+    config.setHost(QStringLiteral("127.0.0.1"));
+    config.setPort(m_port);
+    config.setUser(user);
+    config.setPassword(QStringLiteral("password"));
+    config.setResource(QStringLiteral("bench"));
+    config.setAutoReconnectionEnabled(false);
+    config.setStreamSecurityMode(QXmppConfiguration::TLSDisabled);
+    client->connectToServer(config);
+    return client;
+}
+
+QTEST_MAIN(tst_Calls)
+#include "tst_calls.moc"
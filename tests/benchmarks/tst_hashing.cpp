@@ -0,0 +1,94 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppHash.h"
+#include "QXmppHashing_p.h"
+
+#include "util.h"
+
+#include <QElapsedTimer>
+#include <QTemporaryFile>
+#include <QThreadPool>
+
+using namespace QXmpp;
+using namespace QXmpp::Private;
+
+Q_DECLARE_METATYPE(QXmpp::HashAlgorithm);
+
+//
+// Benchmark of hashing a local file, as done when sharing files
+//
+// The file is memory mapped by calculateHashes(). Its size in MB can be
+// configured using the environment variable QXMPP_BENCH_FILE_SIZE (256).
+//
+
+class tst_Hashing : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void initTestCase();
+    Q_SLOT void file_data();
+    Q_SLOT void file();
+
+    QTemporaryFile m_file;
+    qint64 m_size = 0;
+};
+
+void tst_Hashing::initTestCase()
+{
+    bool ok = false;
+    const auto megabytes = qEnvironmentVariableIntValue("QXMPP_BENCH_FILE_SIZE", &ok);
+    m_size = qint64(ok && megabytes > 0 ? megabytes : 256) * 1024 * 1024;
+
+    QVERIFY(m_file.open());
+    QByteArray block(1024 * 1024, Qt::Uninitialized);
+    for (int i = 0; i < block.size(); i++) {
+        block[i] = char(i % 251);
+    }
+    for (qint64 written = 0; written < m_size; written += block.size()) {
+        QCOMPARE(m_file.write(block), qint64(block.size()));
+    }
+    QVERIFY(m_file.flush());
+
+    qInfo() << "Threads:" << QThreadPool::globalInstance()->maxThreadCount();
+}
+
+void tst_Hashing::file_data()
+{
+    QTest::addColumn<QXmpp::HashAlgorithm>("algorithm");
+
+    QTest::newRow("sha-256") << HashAlgorithm::Sha256;
+    QTest::newRow("blake3") << HashAlgorithm::Blake3;
+}
+
+void tst_Hashing::file()
+{
+    QFETCH(QXmpp::HashAlgorithm, algorithm);
+
+    qint64 elapsed = 0;
+    int iterations = 0;
+    QBENCHMARK {
+        auto file = std::make_unique<QFile>(m_file.fileName());
+        QVERIFY(file->open(QIODevice::ReadOnly));
+
+        QElapsedTimer timer;
+        timer.start();
+        auto resultPtr = wait(calculateHashes(std::move(file), { algorithm }));
+        elapsed += timer.elapsed();
+        iterations++;
+
+        auto hashes = expectVariant<std::vector<QXmppHash>>(std::move(resultPtr->result));
+        QCOMPARE(int(hashes.size()), 1);
+    }
+
+    if (elapsed > 0) {
+        qInfo().noquote() << QStringLiteral("%1: %2 MB/s")
+                                 .arg(QString::fromLatin1(QTest::currentDataTag()))
+                                 .arg(double(m_size) * iterations / 1024 / 1024 / (double(elapsed) / 1000), 0, 'f', 0);
+    }
+}
+
+QTEST_MAIN(tst_Hashing)
+#include "tst_hashing.moc"
@@ -0,0 +1,243 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppStanzaView.h"
+#include "QXmppStream.h"
+
+#include "allocations.h"
+#include "util.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <QDomElement>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+
+//
+// Benchmark of the receive pipeline of QXmppStream
+//
+// Typical traffic is fed to processData() in the chunks a TCP connection may
+// deliver it in: single bytes, segments of the size of an Ethernet MSS and
+// random sizes of up to 4 KiB. The stanzas are handled as views, so no DOM is
+// created.
+//
+// For each combination, the throughput, the peak number of bytes of
+// incomplete stanzas held by the parser after a read and the number of reads
+// per stanza are reported. With an incremental parser, the time per byte must
+// not depend on the fragmentation.
+//
+
+constexpr qsizetype MSS = 1448;
+constexpr qsizetype RANDOM_MAXIMUM_SIZE = 4096;
+
+static const QByteArray streamHeader = QByteArrayLiteral(
+    "<?xml version='1.0' encoding='UTF-8'?>"
+    "<stream:stream from='capulet.lit' to='juliet@capulet.lit' id='c2s-1' version='1.0' xml:lang='en' "
+    "xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams'>");
+
+// one page of a message archive (XEP-0313)
+static QByteArray mamPage()
+{
+    QByteArray data;
+    for (int i = 0; i < 100; i++) {
+        const auto index = QByteArray::number(i);
+        data += "<message to='juliet@capulet.lit/balcony' id='mam" + index + "'>"
+                "<result xmlns='urn:xmpp:mam:2' queryid='f27' id='28482-98726-" + index + "'>"
+                "<forwarded xmlns='urn:xmpp:forward:0'>"
+                "<delay xmlns='urn:xmpp:delay' stamp='2010-07-10T23:08:25Z'/>"
+                "<message xmlns='jabber:client' to='juliet@capulet.lit/balcony' from='romeo@montague.lit/orchard' type='chat' id='" + index + "'>"
+                "<body>Call me but love, and I'll be new baptized; henceforth I never will be Romeo. (" + index + ")</body>"
+                "<origin-id xmlns='urn:xmpp:sid:0' id='de305d54-75b4-431b-adb2-eb6b9e54" + index + "'/>"
+                "</message></forwarded></result></message>";
+    }
+    data += "<iq type='result' id='juliet1'><fin xmlns='urn:xmpp:mam:2' complete='true'>"
+            "<set xmlns='http://jabber.org/protocol/rsm'><first index='0'>28482-98726-0</first><last>28482-98726-99</last></set>"
+            "</fin></iq>";
+    return data;
+}
+
+static QByteArray roster()
+{
+    QByteArray data = "<iq to='juliet@capulet.lit/balcony' type='result' id='roster1'><query xmlns='jabber:iq:roster' ver='ver14'>";
+    for (int i = 0; i < 500; i++) {
+        const auto index = QByteArray::number(i);
+        data += "<item jid='contact" + index + "@montague.lit' name='Contact " + index + "' subscription='both'>"
+                "<group>Friends</group></item>";
+    }
+    data += "</query></iq>";
+    return data;
+}
+
+// avatar data (XEP-0084) of 64 KiB
+static QByteArray pubSubItems()
+{
+    QByteArray payload(48 * 1024, Qt::Uninitialized);
+    for (qsizetype i = 0; i < payload.size(); i++) {
+        payload[i] = char(i * 7 % 256);
+    }
+
+    QByteArray data;
+    for (int i = 0; i < 4; i++) {
+        const auto index = QByteArray::number(i);
+        data += "<message from='romeo@montague.lit' to='juliet@capulet.lit/balcony' type='headline' id='avatar" + index + "'>"
+                "<event xmlns='http://jabber.org/protocol/pubsub#event'><items node='urn:xmpp:avatar:data'>"
+                "<item id='111f4b3c50d7b0df729d299bc6f8e9ef9066971f'><data xmlns='urn:xmpp:avatar:data'>" +
+            payload.toBase64() +
+            "</data></item></items></event></message>";
+    }
+    return data;
+}
+
+// initial presences of a large roster or chat room
+static QByteArray presenceFlood()
+{
+    QByteArray data;
+    for (int i = 0; i < 1000; i++) {
+        const auto index = QByteArray::number(i);
+        data += "<presence from='contact" + index + "@montague.lit/mobile' to='juliet@capulet.lit/balcony'>"
+                "<show>away</show><priority>5</priority>"
+                "<c xmlns='http://jabber.org/protocol/caps' hash='sha-1' node='https://qxmpp.org' ver='QgayPKawpkPSDYmwT/WM94uAlu0='/>"
+                "<x xmlns='vcard-temp:x:update'><photo>73b908bc3b0a05a722f4190ca954e1aa10ea2bd5</photo></x>"
+                "</presence>";
+    }
+    return data;
+}
+
+enum class Fragmentation {
+    SingleBytes,
+    Segments,
+    Random,
+};
+
+static std::vector<QByteArray> split(const QByteArray &data, Fragmentation fragmentation)
+{
+    // the same boundaries in every run
+    QRandomGenerator random(42);
+
+    std::vector<QByteArray> chunks;
+    for (qsizetype position = 0; position < data.size();) {
+        qsizetype size = 1;
+        switch (fragmentation) {
+        case Fragmentation::SingleBytes:
+            break;
+        case Fragmentation::Segments:
+            size = MSS;
+            break;
+        case Fragmentation::Random:
+            size = qsizetype(random.bounded(1, int(RANDOM_MAXIMUM_SIZE) + 1));
+            break;
+        }
+        size = std::min(size, data.size() - position);
+        chunks.push_back(data.mid(position, size));
+        position += size;
+    }
+    return chunks;
+}
+
+class ReceiveStream : public QXmppStream
+{
+    Q_OBJECT
+
+public:
+    using QXmppStream::QXmppStream;
+
+    void handleStream(const QDomElement &) override { }
+    void handleStanza(const QDomElement &) override { }
+    void handleStanza(const QXmppStanzaView &) override { stanzas++; }
+
+    qint64 stanzas = 0;
+};
+
+Q_DECLARE_METATYPE(Fragmentation)
+
+class tst_Receive : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void processData_data();
+    Q_SLOT void processData();
+};
+
+void tst_Receive::processData_data()
+{
+    QTest::addColumn<QByteArray>("traffic");
+    QTest::addColumn<Fragmentation>("fragmentation");
+
+    const std::pair<const char *, QByteArray> traffic[] = {
+        { "mam", mamPage() },
+        { "roster", roster() },
+        { "pubsub", pubSubItems() },
+        { "presences", presenceFlood() },
+    };
+    const std::pair<const char *, Fragmentation> fragmentations[] = {
+        { "1-byte", Fragmentation::SingleBytes },
+        { "mss", Fragmentation::Segments },
+        { "random", Fragmentation::Random },
+    };
+
+    for (const auto &[trafficName, data] : traffic) {
+        for (const auto &[fragmentationName, fragmentation] : fragmentations) {
+            QTest::addRow("%s/%s", trafficName, fragmentationName) << data << fragmentation;
+        }
+    }
+}
+
+void tst_Receive::processData()
+{
+    QFETCH(QByteArray, traffic);
+    QFETCH(Fragmentation, fragmentation);
+
+    const auto chunks = split(traffic, fragmentation);
+
+    qint64 elapsed = 0;
+    int iterations = 0;
+    qint64 stanzas = 0;
+    qint64 peakPendingBytes = 0;
+    QBENCHMARK {
+        ReceiveStream stream(nullptr);
+        stream.processData(streamHeader);
+
+        // bytes received up to the read that completed the last stanza
+        qint64 received = 0;
+        qint64 completed = 0;
+
+        QElapsedTimer timer;
+        timer.start();
+        for (const auto &chunk : chunks) {
+            const auto stanzaCount = stream.stanzas;
+            stream.processData(chunk);
+            received += chunk.size();
+            if (stream.stanzas != stanzaCount) {
+                completed = received;
+            }
+            peakPendingBytes = std::max(peakPendingBytes, received - completed);
+        }
+        elapsed += timer.nsecsElapsed();
+        iterations++;
+        stanzas = stream.stanzas;
+    }
+    QVERIFY(stanzas > 0);
+
+    if (elapsed > 0) {
+        qInfo().noquote() << QStringLiteral("%1: %2 MB/s, %3 stanzas, %4 bytes pending at most, %5 reads per stanza")
+                                 .arg(QString::fromLatin1(QTest::currentDataTag()))
+                                 .arg(double(traffic.size()) * iterations / 1024 / 1024 / (double(elapsed) / 1e9), 0, 'f', 1)
+                                 .arg(stanzas)
+                                 .arg(peakPendingBytes)
+                                 .arg(double(chunks.size()) / double(stanzas), 0, 'f', 1);
+    }
+
+    reportAllocations([&]() {
+        ReceiveStream stream(nullptr);
+        stream.processData(streamHeader);
+        for (const auto &chunk : chunks) {
+            stream.processData(chunk);
+        }
+    }, "run");
+}
+
+QTEST_MAIN(tst_Receive)
+#include "tst_receive.moc"
@@ -0,0 +1,398 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppDataForm.h"
+#include "QXmppElement.h"
+#include "QXmppJingleData.h"
+#include "QXmppMessage.h"
+#include "QXmppPresence.h"
+#include "QXmppPubSubBaseItem.h"
+#include "QXmppPubSubIq_p.h"
+
+#include "allocations.h"
+#include "util.h"
+
+#include <QObject>
+
+using namespace QXmpp::Private;
+
+template<typename T>
+static void benchmarkParse(const QByteArray &xml)
+{
+    const auto element = xmlToDom(xml);
+    QVERIFY(!element.isNull());
+
+    QBENCHMARK {
+        T packet;
+        packet.parse(element);
+    }
+
+    reportAllocations([&]() {
+        T packet;
+        packet.parse(element);
+    });
+}
+
+template<typename T>
+static void benchmarkSerialize(const QByteArray &xml)
+{
+    T packet;
+    packet.parse(xmlToDom(xml));
+
+    QBENCHMARK {
+        QByteArray data;
+        QXmlStreamWriter writer(&data);
+        packet.toXml(&writer);
+    }
+
+    reportAllocations([&]() {
+        QByteArray data;
+        QXmlStreamWriter writer(&data);
+        packet.toXml(&writer);
+    });
+}
+
+static QByteArray messageXml()
+{
+    return QByteArrayLiteral(
+        "<message xmlns=\"jabber:client\" id=\"8b21d4f2\" to=\"juliet@capulet.lit/balcony\" from=\"romeo@montague.lit/orchard\" type=\"chat\">"
+        "<subject>Balcony</subject>"
+        "<body>Art thou not Romeo, and a Montague?</body>"
+        "<thread>e0ffe42b28561960c6b12b944a092794b9683a38</thread>"
+        "<active xmlns=\"http://jabber.org/protocol/chatstates\"/>"
+        "<request xmlns=\"urn:xmpp:receipts\"/>"
+        "<markable xmlns=\"urn:xmpp:chat-markers:0\"/>"
+        "<origin-id xmlns=\"urn:xmpp:sid:0\" id=\"de305d54-75b4-431b-adb2-eb6b9e546013\"/>"
+        "<stanza-id xmlns=\"urn:xmpp:sid:0\" id=\"5f3dbc5e-e1d3-4077-a492-693f3769c7ad\" by=\"juliet@capulet.lit\"/>"
+        "<replace xmlns=\"urn:xmpp:message-correct:0\" id=\"bad1\"/>"
+        "<delay xmlns=\"urn:xmpp:delay\" stamp=\"2010-06-29T08:23:06Z\"/>"
+        "<store xmlns=\"urn:xmpp:hints\"/>"
+        "<x xmlns=\"jabber:x:oob\"><url>https://capulet.lit/balcony.jpg</url><desc>The balcony</desc></x>"
+        "<encryption xmlns=\"urn:xmpp:eme:0\" namespace=\"urn:xmpp:otr:0\"/>"
+        "<spoiler xmlns=\"urn:xmpp:spoiler:0\">Love story</spoiler>"
+        "<reactions xmlns=\"urn:xmpp:reactions:0\" id=\"744f6e18\"><reaction>🐢</reaction><reaction>👋</reaction></reactions>"
+        "<html xmlns=\"http://jabber.org/protocol/xhtml-im\"><body xmlns=\"http://www.w3.org/1999/xhtml\"><p>Art thou not <em>Romeo</em>?</p></body></html>"
+        "</message>");
+}
+
+static QByteArray bareMessageXml()
+{
+    return QByteArrayLiteral(
+        "<message xmlns=\"jabber:client\" id=\"8b21d4f2\" to=\"juliet@capulet.lit/balcony\" from=\"romeo@montague.lit/orchard\" type=\"chat\">"
+        "<body>Art thou not Romeo, and a Montague?</body>"
+        "</message>");
+}
+
+#ifdef BUILD_OMEMO
+// the stanza part of OMEMO encryption and decryption
+static QByteArray omemoMessageXml()
+{
+    return QByteArrayLiteral(
+        "<message xmlns=\"jabber:client\" id=\"258bb4d0\" to=\"juliet@capulet.lit\" from=\"romeo@montague.lit/orchard\" type=\"chat\">"
+        "<encrypted xmlns=\"urn:xmpp:omemo:2\">"
+        "<header sid=\"27183\">"
+        "<keys jid=\"juliet@capulet.lit\">"
+        "<key rid=\"31415\">Oy5TSG9vVVV4Wz9wUkUvI1lUXiVLIU5bbGIsUV0wRngK</key>"
+        "</keys>"
+        "<keys jid=\"romeo@montague.lit\">"
+        "<key rid=\"1337\">PTEoSk91VnRZSXBzcFlPXy4jZ3NKcGVZZ2d3YVJbVj8K</key>"
+        "<key rid=\"12321\" kex=\"true\">a012U0R9WixWKUYhYipucnZOWG06akFOR3Q1NGNOOmUK</key>"
+        "</keys>"
+        "</header>"
+        "<payload>"
+        "Vk9NPi99bHFWKmErOUVTTkAwW1VcZjJvPlElZWUoOk90Kz03YUF7OHc/WjpaQz9ieFdsZjBsSH1w"
+        "R1d2Zzt1bEFAMSZqP0dVJj9oaygmcWRPKGU3Kjc8aV4sJSlpSXBqaENCT2NUVFFmaFNXbCxQaHsj"
+        "</payload>"
+        "</encrypted>"
+        "<encryption xmlns=\"urn:xmpp:eme:0\" namespace=\"urn:xmpp:omemo:2\"/>"
+        "<store xmlns=\"urn:xmpp:hints\"/>"
+        "</message>");
+}
+#endif
+
+static QByteArray presenceXml()
+{
+    return QByteArrayLiteral(
+        "<presence xmlns=\"jabber:client\" id=\"n13mt3l\" to=\"crone1@shakespeare.lit/desktop\" from=\"coven@chat.shakespeare.lit/thirdwitch\">"
+        "<show>away</show>"
+        "<status>In a meeting</status>"
+        "<priority>5</priority>"
+        "<c xmlns=\"http://jabber.org/protocol/caps\" hash=\"sha-1\" node=\"https://qxmpp.org\" ver=\"QgayPKawpkPSDYmwT/WM94uAlu0=\"/>"
+        "<x xmlns=\"vcard-temp:x:update\"><photo>73b908bc3b0a05a722f4190ca954e1aa10ea2bd5</photo></x>"
+        "<x xmlns=\"http://jabber.org/protocol/muc#user\">"
+        "<item affiliation=\"member\" role=\"participant\" jid=\"hag66@shakespeare.lit/pda\" nick=\"thirdwitch\">"
+        "<actor jid=\"crone1@shakespeare.lit\"/>"
+        "<reason>Welcome</reason>"
+        "</item>"
+        "<status code=\"100\"/>"
+        "<status code=\"110\"/>"
+        "</x>"
+        "<idle xmlns=\"urn:xmpp:idle:1\" since=\"1969-07-21T02:56:15Z\"/>"
+        "</presence>");
+}
+
+static QByteArray dataFormXml()
+{
+    QByteArray xml = "<x xmlns=\"jabber:x:data\" type=\"form\"><title>Configuration</title><instructions>Fill out this form.</instructions>";
+    for (int i = 0; i < 50; i++) {
+        const auto index = QByteArray::number(i);
+        switch (i % 4) {
+        case 0:
+            xml += "<field type=\"text-single\" var=\"text" + index + "\" label=\"Text " + index + "\"><value>value " + index + "</value></field>";
+            break;
+        case 1:
+            xml += "<field type=\"boolean\" var=\"boolean" + index + "\"><value>1</value></field>";
+            break;
+        case 2:
+            xml += "<field type=\"list-single\" var=\"list" + index + "\"><desc>Choose one</desc>"
+                   "<option label=\"A\"><value>a</value></option>"
+                   "<option label=\"B\"><value>b</value></option>"
+                   "<option label=\"C\"><value>c</value></option>"
+                   "<value>b</value><required/></field>";
+            break;
+        case 3:
+            xml += "<field type=\"jid-multi\" var=\"jids" + index + "\">"
+                   "<value>juliet@capulet.lit</value><value>romeo@montague.lit</value></field>";
+            break;
+        }
+    }
+    xml += "</x>";
+    return xml;
+}
+
+static QByteArray jingleIqXml()
+{
+    QByteArray xml =
+        "<iq id=\"zid615d9\" to=\"juliet@capulet.lit/balcony\" from=\"romeo@montague.lit/orchard\" type=\"set\">"
+        "<jingle xmlns=\"urn:xmpp:jingle:1\" action=\"session-initiate\" initiator=\"romeo@montague.lit/orchard\" sid=\"a73sjjvkla37jfea\">"
+        "<content creator=\"initiator\" name=\"voice\">"
+        "<description xmlns=\"urn:xmpp:jingle:apps:rtp:1\" media=\"audio\">"
+        "<payload-type id=\"96\" name=\"speex\" clockrate=\"16000\"/>"
+        "<payload-type id=\"97\" name=\"speex\" clockrate=\"8000\"/>"
+        "<payload-type id=\"18\" name=\"G729\"/>"
+        "<payload-type id=\"0\" name=\"PCMU\"/>"
+        "</description>"
+        "<transport xmlns=\"urn:xmpp:jingle:transports:ice-udp:1\" ufrag=\"8hhy\" pwd=\"asd88fgpdd777uzjYhagZg\">";
+    for (int i = 0; i < 100; i++) {
+        const auto index = QByteArray::number(i);
+        xml += "<candidate component=\"1\" foundation=\"" + index + "\" generation=\"0\" id=\"el0747fg" + index + "\""
+               " ip=\"10.0." + QByteArray::number(i / 250) + "." + QByteArray::number(i % 250 + 1) + "\""
+               " network=\"1\" port=\"" + QByteArray::number(8998 + i) + "\" priority=\"2130706431\" protocol=\"udp\" type=\"host\"/>";
+    }
+    xml += "</transport></content></jingle></iq>";
+    return xml;
+}
+
+static QString contentSdp()
+{
+    QString sdp = QStringLiteral(
+        "m=audio 8998 RTP/AVP 96 97 18 0 103 98 100\r\n"
+        "c=IN IP4 10.0.1.1\r\n"
+        "a=rtpmap:96 speex/16000\r\n"
+        "a=fmtp:96 cng=on; vbr=on\r\n"
+        "a=rtpmap:97 speex/8000\r\n"
+        "a=rtpmap:18 G729/0\r\n"
+        "a=rtpmap:0 PCMU/0\r\n"
+        "a=rtpmap:103 L16/16000/2\r\n"
+        "a=rtpmap:98 x-ISAC/8000\r\n"
+        "a=rtpmap:100 telephone-event/8000\r\n"
+        "a=fmtp:100 0-15,66,70\r\n");
+    for (int i = 0; i < 20; i++) {
+        sdp += QStringLiteral("a=candidate:%1 1 udp %2 10.0.1.%3 %4 typ host generation 0\r\n")
+                   .arg(QString::number(i), QString::number(2130706431 - i), QString::number(i + 1), QString::number(8998 + i));
+    }
+    sdp += QStringLiteral(
+        "a=ice-ufrag:8hhy\r\n"
+        "a=ice-pwd:asd88fgpdd777uzjYhagZg\r\n"
+        "a=fingerprint:sha-256 02:1A:CC:54:27:AB:EB:9C:53:3F:3E:4B:65:2E:7D:46:3F:54:42:CD:54:F1:7A:03:A2:7D:F9:B0:7F:46:19:B2\r\n"
+        "a=setup:actpass\r\n");
+    return sdp;
+}
+
+static QByteArray pubSubItemsXml()
+{
+    QByteArray xml =
+        "<iq id=\"items1\" to=\"francisco@denmark.lit/barracks\" from=\"pubsub.shakespeare.lit\" type=\"result\">"
+        "<pubsub xmlns=\"http://jabber.org/protocol/pubsub\">"
+        "<items node=\"princely_musings\">";
+    for (int i = 0; i < 1000; i++) {
+        xml += "<item id=\"item" + QByteArray::number(i) + "\" publisher=\"hamlet@denmark.lit\">"
+               "<entry xmlns=\"http://www.w3.org/2005/Atom\"><title>Soliloquy</title>"
+               "<summary>To be, or not to be: that is the question.</summary></entry>"
+               "</item>";
+    }
+    xml += "</items></pubsub></iq>";
+    return xml;
+}
+
+class tst_Serialization : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void parseMessage();
+    Q_SLOT void serializeMessage();
+    Q_SLOT void parseBareMessage();
+    Q_SLOT void parseMessageDom();
+    Q_SLOT void parseMessageElement();
+    Q_SLOT void serializeMessageElement();
+#ifdef BUILD_OMEMO
+    Q_SLOT void parseOmemoMessage();
+    Q_SLOT void serializeOmemoMessage();
+#endif
+    Q_SLOT void parsePresence();
+    Q_SLOT void serializePresence();
+    Q_SLOT void parseDataForm();
+    Q_SLOT void serializeDataForm();
+    Q_SLOT void parseJingleIq();
+    Q_SLOT void serializeJingleIq();
+    Q_SLOT void parseSdp();
+    Q_SLOT void serializeSdp();
+    Q_SLOT void parsePubSubItems();
+    Q_SLOT void serializePubSubItems();
+};
+
+void tst_Serialization::parseMessage()
+{
+    benchmarkParse<QXmppMessage>(messageXml());
+}
+
+void tst_Serialization::serializeMessage()
+{
+    benchmarkSerialize<QXmppMessage>(messageXml());
+}
+
+void tst_Serialization::parseBareMessage()
+{
+    benchmarkParse<QXmppMessage>(bareMessageXml());
+}
+
+void tst_Serialization::parseMessageDom()
+{
+    const auto xml = messageXml();
+    const auto run = [&]() {
+        QDomDocument document;
+        document.setContent(xml, true);
+    };
+
+    QBENCHMARK {
+        run();
+    }
+    reportAllocations(run);
+}
+
+void tst_Serialization::parseMessageElement()
+{
+    const auto element = xmlToDom(messageXml());
+    const auto run = [&]() {
+        QXmppElement packet(element);
+    };
+
+    QBENCHMARK {
+        run();
+    }
+    reportAllocations(run);
+}
+
+void tst_Serialization::serializeMessageElement()
+{
+    const QXmppElement packet(xmlToDom(messageXml()));
+    const auto run = [&]() {
+        QByteArray data;
+        QXmlStreamWriter writer(&data);
+        packet.toXml(&writer);
+    };
+
+    QBENCHMARK {
+        run();
+    }
+    reportAllocations(run);
+}
+
+#ifdef BUILD_OMEMO
+void tst_Serialization::parseOmemoMessage()
+{
+    benchmarkParse<QXmppMessage>(omemoMessageXml());
+}
+
+void tst_Serialization::serializeOmemoMessage()
+{
+    benchmarkSerialize<QXmppMessage>(omemoMessageXml());
+}
+#endif
+
+void tst_Serialization::parsePresence()
+{
+    benchmarkParse<QXmppPresence>(presenceXml());
+}
+
+void tst_Serialization::serializePresence()
+{
+    benchmarkSerialize<QXmppPresence>(presenceXml());
+}
+
+void tst_Serialization::parseDataForm()
+{
+    benchmarkParse<QXmppDataForm>(dataFormXml());
+}
+
+void tst_Serialization::serializeDataForm()
+{
+    benchmarkSerialize<QXmppDataForm>(dataFormXml());
+}
+
+void tst_Serialization::parseJingleIq()
+{
+    benchmarkParse<QXmppJingleIq>(jingleIqXml());
+}
+
+void tst_Serialization::serializeJingleIq()
+{
+    benchmarkSerialize<QXmppJingleIq>(jingleIqXml());
+}
+
+void tst_Serialization::parseSdp()
+{
+    const auto sdp = contentSdp();
+    const auto run = [&]() {
+        QXmppJingleIq::Content content;
+        content.parseSdp(sdp);
+    };
+
+    QBENCHMARK {
+        run();
+    }
+    reportAllocations(run, "SDP");
+}
+
+void tst_Serialization::serializeSdp()
+{
+    QXmppJingleIq::Content content;
+    QVERIFY(content.parseSdp(contentSdp()));
+    QCOMPARE(content.transportCandidates().size(), 20);
+
+    QString sdp;
+    const auto run = [&]() {
+        sdp = content.toSdp();
+    };
+
+    QBENCHMARK {
+        run();
+    }
+    reportAllocations(run, "SDP");
+    QCOMPARE(sdp, contentSdp());
+}
+
+void tst_Serialization::parsePubSubItems()
+{
+    benchmarkParse<PubSubIq<QXmppPubSubBaseItem>>(pubSubItemsXml());
+}
+
+void tst_Serialization::serializePubSubItems()
+{
+    benchmarkSerialize<PubSubIq<QXmppPubSubBaseItem>>(pubSubItemsXml());
+}
+
+QTEST_MAIN(tst_Serialization)
+#include "tst_serialization.moc"
@@ -0,0 +1,389 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppClient.h"
+#include "QXmppMessage.h"
+#include "QXmppMetrics.h"
+#include "QXmppMucExtension.h"
+#include "QXmppMucManager.h"
+#include "QXmppOutgoingClient.h"
+#include "QXmppPasswordChecker.h"
+#include "QXmppPepExtension.h"
+#include "QXmppPubSubManager.h"
+#include "QXmppServer.h"
+#include "QXmppTransferManager.h"
+#include "QXmppUserTuneItem.h"
+
+#include "util.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <QBuffer>
+#include <QDeadlineTimer>
+#include <QFile>
+#include <QTimer>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+//
+// Soak benchmark of two clients connected to an in-process server
+//
+// In each cycle, alice sends a chat message, a room message, an IQ request, a
+// PubSub item and a file via in-band bytestreams to bob. Then alice loses her
+// connection and resumes her stream (XEP-0198), or in every other cycle logs
+// out and in again. After a warm-up, the resident set size of the process and
+// the sizes of the containers reported by the gauges of QXmppMetrics are
+// sampled. The benchmark fails if they grow with the number of cycles:
+//
+//  QXMPP_BENCH_CYCLES      number of measured cycles (2000)
+//  QXMPP_BENCH_WARMUP      number of cycles before the first sample (100)
+//  QXMPP_BENCH_MAX_GROWTH  maximum growth of the RSS in bytes per cycle (512)
+//  QXMPP_BENCH_PORT        port of the server (12410)
+//
+// The containers may not grow by more than one entry every ten cycles.
+//
+
+static const auto RoomJid = QStringLiteral("soak@conference.localhost");
+static const auto TuneNode = QStringLiteral("http://jabber.org/protocol/tune");
+
+static int environmentValue(const char *name, int defaultValue)
+{
+    bool ok = false;
+    const int value = qEnvironmentVariableIntValue(name, &ok);
+    return ok ? value : defaultValue;
+}
+
+// resident set size of the process in bytes
+static qint64 residentSetSize()
+{
+#ifdef Q_OS_LINUX
+    QFile file(QStringLiteral("/proc/self/statm"));
+    if (file.open(QIODevice::ReadOnly)) {
+        const auto fields = file.readAll().split(' ');
+        if (fields.size() > 1) {
+            return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+#endif
+    return -1;
+}
+
+// Processes events until the condition is met. Unlike QTRY_VERIFY, this
+// doesn't sleep between the checks, which would dominate the cycles.
+template<typename Condition>
+static bool waitUntil(Condition condition, int msecs = 10000)
+{
+    QDeadlineTimer deadline(msecs);
+    // wakes up the event loop to check the deadline
+    QTimer wakeUp;
+    wakeUp.start(50);
+    while (!condition()) {
+        if (deadline.hasExpired()) {
+            return false;
+        }
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+        QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+    }
+    return true;
+}
+
+struct Peer
+{
+    QXmppClient client;
+    QXmppConfiguration config;
+    QXmppMucRoom *room = nullptr;
+    QXmppPubSubManager *pubSub = nullptr;
+    QXmppTransferManager *transfers = nullptr;
+};
+
+// sizes of containers that must not grow with the cycles
+struct Sample
+{
+    QString name;
+    qint64 size;
+};
+
+class tst_Soak : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void initTestCase();
+    Q_SLOT void cleanupTestCase();
+    Q_SLOT void soak();
+
+    std::unique_ptr<Peer> createPeer(const QString &user);
+    void connectPeer(Peer &peer, QXmppClient::StreamManagementState expectedState);
+    void runCycle(int cycle);
+    std::vector<Sample> sample() const;
+
+    TestPasswordChecker m_passwordChecker;
+    std::unique_ptr<QXmppServer> m_server;
+    std::unique_ptr<Peer> m_alice;
+    std::unique_ptr<Peer> m_bob;
+    QByteArray m_file;
+
+    // deliveries of the running cycle
+    QString m_tag;
+    int m_chatMessages = 0;
+    int m_roomMessages = 0;
+    int m_iqResponses = 0;
+    int m_items = 0;
+    int m_sentFiles = 0;
+    int m_receivedFiles = 0;
+};
+
+void tst_Soak::initTestCase()
+{
+    const auto port = quint16(environmentValue("QXMPP_BENCH_PORT", 12410));
+    m_file = QByteArray(16 * 1024, 'x');
+
+    auto *muc = new QXmppMucExtension;
+    muc->setJid(QStringLiteral("conference.localhost"));
+    muc->setHistorySize(10);
+
+    m_server = std::make_unique<QXmppServer>();
+    m_server->setDomain(QStringLiteral("localhost"));
+    m_server->setPasswordChecker(&m_passwordChecker);
+    m_server->setStreamResumptionTimeout(60);
+    m_server->addExtension(muc);
+    m_server->addExtension(new QXmppPepExtension);
+    QVERIFY(m_server->listenForClients(QHostAddress::LocalHost, port));
+
+    // bob may read the items of alice
+    m_server->setPresenceSubscribers(QStringLiteral("alice@localhost"), { QStringLiteral("bob@localhost") });
+
+    m_alice = createPeer(QStringLiteral("alice"));
+    m_bob = createPeer(QStringLiteral("bob"));
+    m_alice->config.setPort(port);
+    m_bob->config.setPort(port);
+
+    connect(&m_bob->client, &QXmppClient::messageReceived, this, [this](const QXmppMessage &message) {
+        if (message.type() == QXmppMessage::Chat && message.body() == m_tag) {
+            m_chatMessages++;
+        }
+    });
+    connect(m_bob->room, &QXmppMucRoom::messageReceived, this, [this](const QXmppMessage &message) {
+        if (message.body() == m_tag) {
+            m_roomMessages++;
+        }
+    });
+    connect(m_bob->transfers, &QXmppTransferManager::fileReceived, this, [this](QXmppTransferJob *job) {
+        auto *output = new QBuffer(job);
+        output->open(QIODevice::WriteOnly);
+        connect(job, &QXmppTransferJob::finished, this, [this, job, output] {
+            if (job->error() == QXmppTransferJob::NoError && output->data() == m_file) {
+                m_receivedFiles++;
+            }
+            job->deleteLater();
+        });
+        job->accept(output);
+    });
+
+    connectPeer(*m_bob, QXmppClient::NewStream);
+    connectPeer(*m_alice, QXmppClient::NewStream);
+}
+
+void tst_Soak::cleanupTestCase()
+{
+    m_alice.reset();
+    m_bob.reset();
+    m_server.reset();
+}
+
+void tst_Soak::soak()
+{
+    const int cycles = std::max(1, environmentValue("QXMPP_BENCH_CYCLES", 2000));
+    const int warmUp = std::max(1, environmentValue("QXMPP_BENCH_WARMUP", 100));
+    const qint64 maxGrowth = environmentValue("QXMPP_BENCH_MAX_GROWTH", 512);
+
+    // the caches and pools have reached their size after the warm-up
+    for (int cycle = 0; cycle < warmUp; cycle++) {
+        runCycle(cycle);
+        if (QTest::currentTestFailed()) {
+            return;
+        }
+    }
+
+    const auto before = sample();
+    const auto rssBefore = residentSetSize();
+
+    for (int cycle = warmUp; cycle < warmUp + cycles; cycle++) {
+        runCycle(cycle);
+        if (QTest::currentTestFailed()) {
+            return;
+        }
+    }
+
+    const auto after = sample();
+    const auto rssAfter = residentSetSize();
+
+    if (rssBefore >= 0) {
+        const auto growth = double(rssAfter - rssBefore) / cycles;
+        qInfo().noquote() << QStringLiteral("%1 cycles: %2 bytes RSS growth per cycle")
+                                 .arg(cycles)
+                                 .arg(growth, 0, 'f', 1);
+        QVERIFY2(growth <= maxGrowth,
+                 qPrintable(QStringLiteral("RSS grows by %1 bytes per cycle").arg(growth, 0, 'f', 1)));
+    }
+
+    for (size_t i = 0; i < before.size(); i++) {
+        const auto &name = before.at(i).name;
+        const auto growth = after.at(i).size - before.at(i).size;
+        qInfo().noquote() << QStringLiteral("%1: %2 -> %3")
+                                 .arg(name)
+                                 .arg(before.at(i).size)
+                                 .arg(after.at(i).size);
+        QVERIFY2(growth * 10 <= cycles,
+                 qPrintable(QStringLiteral("%1 grow by %2 in %3 cycles").arg(name).arg(growth).arg(cycles)));
+    }
+}
+
+std::unique_ptr<Peer> tst_Soak::createPeer(const QString &user)
+{
+    m_passwordChecker.addCredentials(user, QStringLiteral("password"));
+
+    auto peer = std::make_unique<Peer>();
+    auto *muc = new QXmppMucManager;
+    peer->pubSub = new QXmppPubSubManager;
+    peer->transfers = new QXmppTransferManager;
+    peer->transfers->setSupportedMethods(QXmppTransferJob::InBandMethod);
+    peer->client.addExtension(muc);
+    peer->client.addExtension(peer->pubSub);
+    peer->client.addExtension(peer->transfers);
+    peer->room = muc->addRoom(RoomJid);
+    peer->room->setNickName(user);
+
+    peer->config.setDomain(QStringLiteral("localhost"));
+    peer->config.setHost(QHostAddress(QHostAddress::LocalHost).toString());
+    peer->config.setUser(user);
+    peer->config.setPassword(QStringLiteral("password"));
+    peer->config.setResource(QStringLiteral("soak"));
+    peer->config.setAutoReconnectionEnabled(false);
+    peer->config.setStreamSecurityMode(QXmppConfiguration::TLSDisabled);
+    return peer;
+}
+
+// Connects a peer and joins the room, which is left by the client whenever
+// the connection is lost.
+void tst_Soak::connectPeer(Peer &peer, QXmppClient::StreamManagementState expectedState)
+{
+    peer.client.connectToServer(peer.config);
+    QVERIFY2(waitUntil([&] { return peer.client.isConnected(); }), "Could not connect");
+    QCOMPARE(peer.client.streamManagementState(), expectedState);
+
+    QVERIFY(peer.room->join());
+    QVERIFY2(waitUntil([&] { return peer.room->isJoined(); }), "Could not join the room");
+}
+
+void tst_Soak::runCycle(int cycle)
+{
+    m_tag = QString::number(cycle);
+    m_chatMessages = 0;
+    m_roomMessages = 0;
+    m_iqResponses = 0;
+    m_items = 0;
+    m_sentFiles = 0;
+    m_receivedFiles = 0;
+
+    auto &alice = *m_alice;
+    const auto bobJid = m_bob->client.configuration().jid();
+
+    QXmppMessage message({}, bobJid, m_tag);
+    message.setType(QXmppMessage::Chat);
+    alice.client.sendPacket(message);
+
+    QVERIFY(alice.room->sendMessage(m_tag));
+
+    // answered with an error by bob
+    const auto sendIq = [&] {
+        QXmppIq iq(QXmppIq::Get);
+        iq.setTo(bobJid);
+        alice.client.sendIq(std::move(iq)).then(this, [this](QXmppClient::IqResult &&) {
+            m_iqResponses++;
+        });
+    };
+    sendIq();
+
+    QXmppTuneItem tune;
+    tune.setId(QStringLiteral("current"));
+    tune.setTitle(m_tag);
+    alice.pubSub->publishOwnPepItem(TuneNode, tune).then(this, [this](QXmppPubSubManager::PublishItemResult &&result) {
+        if (std::holds_alternative<QXmppError>(result)) {
+            return;
+        }
+        m_bob->pubSub->requestItems<QXmppTuneItem>(QStringLiteral("alice@localhost"), TuneNode).then(this, [this](QXmppPubSubManager::ItemsResult<QXmppTuneItem> &&result) {
+            if (const auto *items = std::get_if<QXmppPubSubManager::Items<QXmppTuneItem>>(&result);
+                items && !items->items.isEmpty() && items->items.constFirst().title() == m_tag) {
+                m_items++;
+            }
+        });
+    });
+
+    auto *input = new QBuffer;
+    input->setData(m_file);
+    input->open(QIODevice::ReadOnly);
+    QXmppTransferFileInfo fileInfo;
+    fileInfo.setName(QStringLiteral("soak.txt"));
+    fileInfo.setSize(m_file.size());
+    auto *job = alice.transfers->sendFile(bobJid, input, fileInfo);
+    QVERIFY(job);
+    input->setParent(job);
+    connect(job, &QXmppTransferJob::finished, this, [this, job] {
+        if (job->error() == QXmppTransferJob::NoError) {
+            m_sentFiles++;
+        }
+        job->deleteLater();
+    });
+
+    QVERIFY2(waitUntil([this] {
+                 return m_chatMessages == 1 && m_roomMessages == 1 && m_iqResponses == 1 &&
+                     m_items == 1 && m_sentFiles == 1 && m_receivedFiles == 1;
+             }),
+             qPrintable(QStringLiteral("Cycle %1 has not been completed").arg(cycle)));
+
+    if (cycle % 2 == 0) {
+        // the connection is lost with a request in flight, which is answered
+        // on the resumed stream
+        sendIq();
+        alice.client.findChild<QXmppOutgoingClient *>()->socket()->abort();
+        QVERIFY(waitUntil([&] { return !alice.client.isConnected(); }));
+        connectPeer(alice, QXmppClient::ResumedStream);
+        if (QTest::currentTestFailed()) {
+            return;
+        }
+        QVERIFY2(waitUntil([this] { return m_iqResponses == 2; }),
+                 qPrintable(QStringLiteral("Cycle %1: no response on the resumed stream").arg(cycle)));
+    } else {
+        alice.client.disconnectFromServer();
+        QVERIFY(waitUntil([&] { return alice.client.state() == QXmppClient::DisconnectedState; }));
+        connectPeer(alice, QXmppClient::NewStream);
+    }
+}
+
+std::vector<Sample> tst_Soak::sample() const
+{
+    // let the requests sent after connecting finish
+    QTest::qWait(200);
+
+    const auto jobCount = [](const Peer &peer) {
+        return qint64(peer.transfers->findChildren<QXmppTransferJob *>().size());
+    };
+    return {
+        { QStringLiteral("pending IQs"), QXmppMetrics::value(QXmppMetrics::PendingIqs) },
+        { QStringLiteral("transfer jobs"), QXmppMetrics::value(QXmppMetrics::TransferJobs) },
+        { QStringLiteral("transfer job objects"), jobCount(*m_alice) + jobCount(*m_bob) },
+        { QStringLiteral("MUC rooms"), QXmppMetrics::value(QXmppMetrics::MucRooms) },
+        { QStringLiteral("MUC participants"), qint64(m_bob->room->participants().size()) },
+        { QStringLiteral("unacknowledged stanzas"), QXmppMetrics::value(QXmppMetrics::StreamManagementQueuedStanzas) },
+        { QStringLiteral("incoming clients"), QXmppMetrics::value(QXmppMetrics::IncomingClients) },
+    };
+}
+
+QTEST_MAIN(tst_Soak)
+#include "tst_soak.moc"
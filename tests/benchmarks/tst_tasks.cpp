@@ -0,0 +1,101 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppPacket_p.h"
+#include "QXmppPromise.h"
+#include "QXmppStream.h"
+#include "QXmppTask.h"
+
+#include "allocations.h"
+#include "util.h"
+
+#include <QObject>
+
+class NullStream : public QXmppStream
+{
+    Q_OBJECT
+
+public:
+    NullStream()
+        : QXmppStream(nullptr)
+    {
+    }
+
+    bool sendData(const QByteArray &) override
+    {
+        return true;
+    }
+
+protected:
+    void handleStanza(const QDomElement &) override { }
+    void handleStream(const QDomElement &) override { }
+};
+
+class tst_Tasks : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void continuationBeforeFinish();
+    Q_SLOT void continuationAfterFinish();
+    Q_SLOT void streamSend();
+};
+
+void tst_Tasks::continuationBeforeFinish()
+{
+    int calls = 0;
+    const auto run = [&]() {
+        QXmppPromise<QXmpp::SendResult> promise;
+        promise.task().then(this, [&calls](QXmpp::SendResult &&) {
+            calls++;
+        });
+        promise.finish(QXmpp::SendResult(QXmpp::SendSuccess()));
+    };
+
+    QBENCHMARK {
+        run();
+    }
+    reportAllocations(run, "task");
+    QVERIFY(calls > 0);
+}
+
+void tst_Tasks::continuationAfterFinish()
+{
+    int calls = 0;
+    const auto run = [&]() {
+        QXmppPromise<QXmpp::SendResult> promise;
+        promise.finish(QXmpp::SendResult(QXmpp::SendSuccess()));
+        promise.task().then(this, [&calls](QXmpp::SendResult &&) {
+            calls++;
+        });
+    };
+
+    QBENCHMARK {
+        run();
+    }
+    reportAllocations(run, "task");
+    QVERIFY(calls > 0);
+}
+
+void tst_Tasks::streamSend()
+{
+    NullStream stream;
+    const auto data = QByteArrayLiteral("<message xmlns=\"jabber:client\" to=\"juliet@capulet.lit\" type=\"chat\"><body>Hi</body></message>");
+
+    int calls = 0;
+    const auto run = [&]() {
+        stream.send(QXmppPacket(data, true)).then(&stream, [&calls](QXmpp::SendResult &&) {
+            calls++;
+        });
+    };
+
+    QBENCHMARK {
+        run();
+    }
+    reportAllocations(run, "send");
+    QVERIFY(calls > 0);
+}
+
+QTEST_MAIN(tst_Tasks)
+#include "tst_tasks.moc"
@@ -45,6 +45,7 @@ private:
     Q_SLOT void testMakeTrustDecisions();
     Q_SLOT void testHandleMessage_data();
     Q_SLOT void testHandleMessage();
+    Q_SLOT void testHandleMessages();
     Q_SLOT void testMakeTrustDecisionsNoKeys();
     Q_SLOT void testMakeTrustDecisionsOwnKeys();
     Q_SLOT void testMakeTrustDecisionsOwnKeysNoOwnEndpoints();
@@ -996,6 +997,85 @@ void tst_QXmppAtmManager::testHandleMessage()
     }
 }
 
+void tst_QXmppAtmManager::testHandleMessages()
+{
+    clearTrustStorage();
+
+    const auto createMessage = [](const QString &from, const QByteArray &senderKey, const QList<QXmppTrustMessageKeyOwner> &keyOwners) {
+        QXmppE2eeMetadata e2eeMetadata;
+        e2eeMetadata.setSenderKey(senderKey);
+
+        QXmppTrustMessageElement trustMessageElement;
+        trustMessageElement.setUsage(ns_atm);
+        trustMessageElement.setEncryption(ns_omemo);
+        trustMessageElement.setKeyOwners(keyOwners);
+
+        QXmppMessage message;
+        message.setFrom(from);
+        message.setE2eeMetadata(e2eeMetadata);
+        message.setTrustMessageElement(trustMessageElement);
+        return message;
+    };
+
+    const auto createKeyOwner = [](const QString &jid, const QList<QByteArray> &trustedKeys, const QList<QByteArray> &distrustedKeys) {
+        QXmppTrustMessageKeyOwner keyOwner;
+        keyOwner.setJid(jid);
+        keyOwner.setTrustedKeys(trustedKeys);
+        keyOwner.setDistrustedKeys(distrustedKeys);
+        return keyOwner;
+    };
+
+    const auto alice = QStringLiteral("alice@example.org");
+    const auto bob = QStringLiteral("bob@example.com");
+
+    m_manager.addKeys(ns_omemo, alice, { QByteArrayLiteral("alice-1") }, TrustLevel::Authenticated);
+
+    const QVector<QXmppMessage> messages = {
+        // The authenticated own endpoint authenticates another own endpoint.
+        createMessage(QStringLiteral("alice@example.org/desktop"),
+                      QByteArrayLiteral("alice-1"),
+                      { createKeyOwner(alice, { QByteArrayLiteral("alice-2") }, {}),
+                        createKeyOwner(bob, { QByteArrayLiteral("bob-2") }, { QByteArrayLiteral("bob-1") }) }),
+        // The own endpoint authenticated by the previous trust message
+        // overrides a trust decision of it.
+        createMessage(QStringLiteral("alice@example.org/tablet"),
+                      QByteArrayLiteral("alice-2"),
+                      { createKeyOwner(bob, {}, { QByteArrayLiteral("bob-2") }) }),
+        // The trust decisions of an unauthenticated endpoint are postponed.
+        createMessage(QStringLiteral("bob@example.com/notebook"),
+                      QByteArrayLiteral("bob-3"),
+                      { createKeyOwner(bob, { QByteArrayLiteral("bob-4") }, {}) }),
+        // Messages without trust message elements are ignored.
+        QXmppMessage(QStringLiteral("bob@example.com/notebook"), QStringLiteral("alice@example.org"), QStringLiteral("Hi")),
+    };
+
+    auto futureVoid = m_manager.handleMessages(messages);
+    while (!futureVoid.isFinished()) {
+        QCoreApplication::processEvents();
+    }
+
+    auto future = m_manager.keys(ns_omemo);
+    QVERIFY(future.isFinished());
+    QCOMPARE(
+        future.result(),
+        QHash({ std::pair(
+                    TrustLevel::Authenticated,
+                    QMultiHash<QString, QByteArray>({ { alice, QByteArrayLiteral("alice-1") },
+                                                      { alice, QByteArrayLiteral("alice-2") } })),
+                std::pair(
+                    TrustLevel::ManuallyDistrusted,
+                    QMultiHash<QString, QByteArray>({ { bob, QByteArrayLiteral("bob-1") },
+                                                      { bob, QByteArrayLiteral("bob-2") } })) }));
+
+    auto futurePostponed = m_trustStorage.keysForPostponedTrustDecisions(ns_omemo, { QByteArrayLiteral("bob-3") });
+    QVERIFY(futurePostponed.isFinished());
+    QCOMPARE(
+        futurePostponed.result(),
+        QHash({ std::pair(
+            true,
+            QMultiHash<QString, QByteArray>({ { bob, QByteArrayLiteral("bob-4") } })) }));
+}
+
 void tst_QXmppAtmManager::testMakeTrustDecisionsNoKeys()
 {
     clearTrustStorage();
@@ -0,0 +1,193 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppBitsOfBinaryContentId.h"
+#include "QXmppBitsOfBinaryDataList.h"
+#include "QXmppBitsOfBinaryManager.h"
+#include "QXmppMessage.h"
+
+#include "TestClient.h"
+#include "util.h"
+
+#include <QMimeDatabase>
+#include <QTemporaryDir>
+
+static const auto Jid = QStringLiteral("ladymacbeth@shakespeare.lit/castle");
+
+class tst_QXmppBitsOfBinaryManager : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testRequest();
+    Q_SLOT void testInvalidData();
+    Q_SLOT void testMessage();
+    Q_SLOT void testEviction();
+    Q_SLOT void testCacheDirectory();
+};
+
+static QXmppBitsOfBinaryData bobData(const QByteArray &bytes, int maxAge = -1)
+{
+    auto data = QXmppBitsOfBinaryData::fromByteArray(bytes);
+    data.setContentType(QMimeDatabase().mimeTypeForName(QStringLiteral("image/png")));
+    data.setMaxAge(maxAge);
+    return data;
+}
+
+void tst_QXmppBitsOfBinaryManager::testRequest()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppBitsOfBinaryManager>();
+
+    const auto cid = bobData("Hello World").cid();
+    const auto contentId = cid.toContentId();
+
+    // concurrent requests for the data are sent once
+    auto task = manager->requestData(Jid, cid);
+    auto otherTask = manager->requestData(Jid, cid);
+    test.expect(QStringLiteral("<iq id='qxmpp1' to='%1' type='get'><data xmlns='urn:xmpp:bob' cid='%2'></data></iq>").arg(Jid, contentId));
+    test.expectNoPacket();
+
+    test.inject(QStringLiteral("<iq id='qxmpp1' from='%1' type='result'><data xmlns='urn:xmpp:bob' cid='%2' max-age='86400' type='image/png'>SGVsbG8gV29ybGQ=</data></iq>").arg(Jid, contentId));
+    QTRY_VERIFY(task.isFinished());
+    QTRY_VERIFY(otherTask.isFinished());
+    auto data = expectFutureVariant<QXmppBitsOfBinaryData>(task);
+    QCOMPARE(data.data(), QByteArray("Hello World"));
+    QCOMPARE(data.contentType().name(), QStringLiteral("image/png"));
+    QCOMPARE(expectFutureVariant<QXmppBitsOfBinaryData>(otherTask).data(), QByteArray("Hello World"));
+
+    // the cached data is returned without a request
+    auto cachedTask = manager->requestData(Jid, cid);
+    QVERIFY(cachedTask.isFinished());
+    QCOMPARE(expectFutureVariant<QXmppBitsOfBinaryData>(cachedTask).data(), QByteArray("Hello World"));
+    test.expectNoPacket();
+
+    // data forms reference the data with cid: URLs
+    QXmppDataForm::MediaSource source(QUrl(cid.toCidUrl()), QMimeDatabase().mimeTypeForName(QStringLiteral("image/png")));
+    auto mediaTask = manager->requestData(Jid, source);
+    QVERIFY(mediaTask.isFinished());
+    QCOMPARE(expectFutureVariant<QXmppBitsOfBinaryData>(mediaTask).data(), QByteArray("Hello World"));
+
+    manager->clearCache();
+    QVERIFY(!manager->cachedData(cid));
+
+    // errors are reported to all requests
+    auto errorTask = manager->requestData(Jid, cid);
+    auto otherErrorTask = manager->requestData(Jid, cid);
+    test.expect(QStringLiteral("<iq id='qxmpp2' to='%1' type='get'><data xmlns='urn:xmpp:bob' cid='%2'></data></iq>").arg(Jid, contentId));
+    test.inject(QStringLiteral("<iq id='qxmpp2' from='%1' type='error'><error type='cancel'><item-not-found xmlns='urn:ietf:params:xml:ns:xmpp-stanzas'/></error></iq>").arg(Jid));
+    QTRY_VERIFY(errorTask.isFinished());
+    expectFutureVariant<QXmppError>(errorTask);
+    expectFutureVariant<QXmppError>(otherErrorTask);
+    QVERIFY(!manager->cachedData(cid));
+}
+
+void tst_QXmppBitsOfBinaryManager::testInvalidData()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppBitsOfBinaryManager>();
+
+    const auto cid = bobData("Hello World").cid();
+    const auto contentId = cid.toContentId();
+
+    // data that doesn't match the content ID isn't cached
+    auto task = manager->requestData(Jid, cid);
+    test.expect(QStringLiteral("<iq id='qxmpp1' to='%1' type='get'><data xmlns='urn:xmpp:bob' cid='%2'></data></iq>").arg(Jid, contentId));
+    test.inject(QStringLiteral("<iq id='qxmpp1' from='%1' type='result'><data xmlns='urn:xmpp:bob' cid='%2' type='image/png'>SGVsbG8gTW9vbg==</data></iq>").arg(Jid, contentId));
+    QTRY_VERIFY(task.isFinished());
+    expectFutureVariant<QXmppError>(task);
+    QVERIFY(!manager->cachedData(cid));
+
+    // data with a max-age of zero isn't cached
+    auto uncachedTask = manager->requestData(Jid, cid);
+    test.expect(QStringLiteral("<iq id='qxmpp2' to='%1' type='get'><data xmlns='urn:xmpp:bob' cid='%2'></data></iq>").arg(Jid, contentId));
+    test.inject(QStringLiteral("<iq id='qxmpp2' from='%1' type='result'><data xmlns='urn:xmpp:bob' cid='%2' max-age='0' type='image/png'>SGVsbG8gV29ybGQ=</data></iq>").arg(Jid, contentId));
+    QTRY_VERIFY(uncachedTask.isFinished());
+    QCOMPARE(expectFutureVariant<QXmppBitsOfBinaryData>(uncachedTask).data(), QByteArray("Hello World"));
+    QVERIFY(!manager->cachedData(cid));
+
+    auto invalidTask = manager->requestData(Jid, QXmppBitsOfBinaryContentId());
+    QVERIFY(invalidTask.isFinished());
+    expectFutureVariant<QXmppError>(invalidTask);
+    test.expectNoPacket();
+}
+
+void tst_QXmppBitsOfBinaryManager::testMessage()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppBitsOfBinaryManager>();
+
+    const auto data = bobData("Sticker");
+    QXmppMessage message;
+    message.setFrom(Jid);
+    message.setBitsOfBinaryData({ data });
+
+    // the data included in messages is cached
+    QVERIFY(!manager->handleMessage(message));
+    QTRY_VERIFY(manager->cachedData(data.cid()));
+    QCOMPARE(manager->cachedData(data.cid())->data(), QByteArray("Sticker"));
+
+    auto task = manager->requestData(Jid, data.cid());
+    QVERIFY(task.isFinished());
+    test.expectNoPacket();
+}
+
+void tst_QXmppBitsOfBinaryManager::testEviction()
+{
+    QXmppBitsOfBinaryManager manager;
+    manager.setMemoryCacheSize(10);
+
+    const auto first = bobData("12345");
+    const auto second = bobData("67890");
+    const auto third = bobData("abcde");
+    manager.addData(first);
+    manager.addData(second);
+    QTRY_VERIFY(manager.cachedData(first.cid()) && manager.cachedData(second.cid()));
+
+    // the least recently used data is removed
+    QVERIFY(manager.cachedData(first.cid()));
+    manager.addData(third);
+    QTRY_VERIFY(manager.cachedData(third.cid()));
+    QVERIFY(manager.cachedData(first.cid()));
+    QVERIFY(!manager.cachedData(second.cid()));
+
+    manager.setMemoryCacheSize(5);
+    QVERIFY(!manager.cachedData(third.cid()));
+    QVERIFY(manager.cachedData(first.cid()));
+}
+
+void tst_QXmppBitsOfBinaryManager::testCacheDirectory()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    const auto data = bobData("Hello World");
+    const auto expiring = bobData("Goodbye", 1);
+    {
+        QXmppBitsOfBinaryManager manager;
+        manager.setCacheDirectory(dir.path());
+        manager.addData(data);
+        manager.addData(expiring);
+        QTRY_VERIFY(manager.cachedData(data.cid()) && manager.cachedData(expiring.cid()));
+    }
+
+    // the data is kept on disk until it expires
+    QXmppBitsOfBinaryManager manager;
+    manager.setCacheDirectory(dir.path());
+    const auto cached = manager.cachedData(data.cid());
+    QVERIFY(cached);
+    QCOMPARE(cached->data(), QByteArray("Hello World"));
+    QCOMPARE(cached->contentType().name(), QStringLiteral("image/png"));
+
+    QTest::qWait(1100);
+    QVERIFY(!manager.cachedData(expiring.cid()));
+
+    manager.clearCache();
+    QXmppBitsOfBinaryManager otherManager;
+    otherManager.setCacheDirectory(dir.path());
+    QVERIFY(!otherManager.cachedData(data.cid()));
+}
+
+QTEST_MAIN(tst_QXmppBitsOfBinaryManager)
+#include "tst_qxmppbitsofbinarymanager.moc"
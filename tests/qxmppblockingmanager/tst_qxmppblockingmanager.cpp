@@ -100,6 +100,7 @@ void tst_QXmppBlockingManager::pushBlocked()
 
     auto blocklist = std::get<QXmppBlocklist>(m->fetchBlocklist().result()).entries();
     QCOMPARE(blocklist, QVector<QString> { "iago@shakespeare.lit" });
+    expectVariant<QXmppBlocklist::NotBlocked>(std::get<QXmppBlocklist>(m->fetchBlocklist().result()).blockingState("montague.net"));
 
     dom = xmlToDom("<iq to='juliet@capulet.com/balcony' type='set' id='push3'><block xmlns='urn:xmpp:blocking'><item jid='romeo@montague.net'/></block></iq>");
     QVERIFY(m->handleStanza(dom, {}));
@@ -111,6 +112,10 @@ void tst_QXmppBlockingManager::pushBlocked()
     blocklist = std::get<QXmppBlocklist>(m->fetchBlocklist().result()).entries();
     auto expected = QVector<QString> { "iago@shakespeare.lit", "romeo@montague.net" };
     QCOMPARE(blocklist, expected);
+
+    auto state = std::get<QXmppBlocklist>(m->fetchBlocklist().result()).blockingState("montague.net");
+    auto partially = expectVariant<QXmppBlocklist::PartiallyBlocked>(state);
+    QCOMPARE(partially.partiallyBlockingEntries, QVector<QString> { "romeo@montague.net" });
 }
 
 void tst_QXmppBlockingManager::blockedState()
@@ -141,6 +146,23 @@ void tst_QXmppBlockingManager::blockedState()
 
     state = l.blockingState("qxmpp.org");
     expectVariant<L::NotBlocked>(state);
+
+    // domains that are only a prefix of a blocked domain are not affected
+    state = l.blockingState("shakespeare.li");
+    expectVariant<L::NotBlocked>(state);
+
+    l = QXmppBlocklist({ "iago@shakespeare.lit", "romeo@montague.net", "romeo@montague.net/orchard", "montague.net/balcony" });
+    QVERIFY(l.containsEntry(u"montague.net/balcony"));
+
+    state = l.blockingState("romeo@montague.net");
+    blocked = expectVariant<L::Blocked>(state);
+    QCOMPARE(blocked.blockingEntries, QVector<QString> { "romeo@montague.net" });
+    QCOMPARE(blocked.partiallyBlockingEntries, QVector<QString> { "romeo@montague.net/orchard" });
+
+    state = l.blockingState("montague.net");
+    partially = expectVariant<L::PartiallyBlocked>(state);
+    auto expectedPartially = QVector<QString> { "romeo@montague.net", "romeo@montague.net/orchard", "montague.net/balcony" };
+    QCOMPARE(partially.partiallyBlockingEntries, expectedPartially);
 }
 
 QTEST_MAIN(tst_QXmppBlockingManager)
@@ -0,0 +1,98 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppBookmarkManager.h"
+#include "QXmppBookmarkSet.h"
+#include "QXmppPubSubManager.h"
+
+#include "TestClient.h"
+
+class tst_QXmppBookmarkManager : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testPepBookmarks();
+};
+
+void tst_QXmppBookmarkManager::testPepBookmarks()
+{
+    TestClient test;
+    test.configuration().setJid("juliet@capulet.lit");
+    auto *psManager = test.addNewExtension<QXmppPubSubManager>();
+    auto *manager = test.addNewExtension<QXmppBookmarkManager>();
+    manager->setPepEnabled(true);
+    QCOMPARE(manager->discoveryFeatures(), QStringList { "urn:xmpp:bookmarks:1+notify" });
+
+    int received = 0;
+    connect(manager, &QXmppBookmarkManager::bookmarksReceived, this, [&received] { received++; });
+
+    // the bookmarks are requested on connect
+    Q_EMIT test.connected();
+    test.expect("<iq id='qxmpp1' to='juliet@capulet.lit' type='get'>"
+                "<pubsub xmlns='http://jabber.org/protocol/pubsub'><items node='urn:xmpp:bookmarks:1'/></pubsub></iq>");
+    test.inject(QStringLiteral("<iq id='qxmpp1' from='juliet@capulet.lit' type='result'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                               "<items node='urn:xmpp:bookmarks:1'>"
+                               "<item id='theplay@conference.shakespeare.lit'>"
+                               "<conference xmlns='urn:xmpp:bookmarks:1' name='The Play' autojoin='true'><nick>JC</nick></conference>"
+                               "</item></items></pubsub></iq>"));
+
+    QVERIFY(manager->areBookmarksReceived());
+    QCOMPARE(received, 1);
+    auto conferences = manager->bookmarks().conferences();
+    QCOMPARE(conferences.size(), 1);
+    QCOMPARE(conferences.constFirst().jid(), QStringLiteral("theplay@conference.shakespeare.lit"));
+    QCOMPARE(conferences.constFirst().name(), QStringLiteral("The Play"));
+    QCOMPARE(conferences.constFirst().nickName(), QStringLiteral("JC"));
+    QVERIFY(conferences.constFirst().autoJoin());
+
+    // only the new bookmark is published
+    QXmppBookmarkConference conference;
+    conference.setJid("orchard@conference.shakespeare.lit");
+    conference.setNickName("Juliet");
+    auto task = manager->addBookmark(conference);
+
+    const auto packet = test.takePacket();
+    QVERIFY(packet.contains(QStringLiteral("<publish node=\"urn:xmpp:bookmarks:1\">"
+                                           "<item id=\"orchard@conference.shakespeare.lit\">"
+                                           "<conference xmlns=\"urn:xmpp:bookmarks:1\"><nick>Juliet</nick></conference>"
+                                           "</item></publish>")));
+    QVERIFY(!packet.contains(QStringLiteral("theplay@conference.shakespeare.lit")));
+    test.inject(QStringLiteral("<iq type='result' from='juliet@capulet.lit' id='qxmpp1'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                               "<publish node='urn:xmpp:bookmarks:1'><item id='orchard@conference.shakespeare.lit'/></publish>"
+                               "</pubsub></iq>"));
+    expectFutureVariant<QXmpp::Success>(task);
+    QCOMPARE(manager->bookmarks().conferences().size(), 2);
+    QCOMPARE(received, 2);
+
+    // the notification of the own publication doesn't change anything
+    psManager->handleStanza(xmlToDom(QStringLiteral("<message from='juliet@capulet.lit' to='juliet@capulet.lit/balcony'>"
+                                                    "<event xmlns='http://jabber.org/protocol/pubsub#event'>"
+                                                    "<items node='urn:xmpp:bookmarks:1'>"
+                                                    "<item id='orchard@conference.shakespeare.lit'>"
+                                                    "<conference xmlns='urn:xmpp:bookmarks:1'><nick>Juliet</nick></conference>"
+                                                    "</item></items></event></message>")));
+    QCOMPARE(received, 2);
+
+    // bookmarks removed by other clients
+    psManager->handleStanza(xmlToDom(QStringLiteral("<message from='juliet@capulet.lit' to='juliet@capulet.lit/balcony'>"
+                                                    "<event xmlns='http://jabber.org/protocol/pubsub#event'>"
+                                                    "<items node='urn:xmpp:bookmarks:1'>"
+                                                    "<retract id='theplay@conference.shakespeare.lit'/>"
+                                                    "</items></event></message>")));
+    QCOMPARE(received, 3);
+    conferences = manager->bookmarks().conferences();
+    QCOMPARE(conferences.size(), 1);
+    QCOMPARE(conferences.constFirst().jid(), QStringLiteral("orchard@conference.shakespeare.lit"));
+
+    // the bookmarks are kept between sessions
+    Q_EMIT test.disconnected();
+    QVERIFY(manager->areBookmarksReceived());
+    QCOMPARE(manager->bookmarks().conferences().size(), 1);
+}
+
+QTEST_MAIN(tst_QXmppBookmarkManager)
+#include "tst_qxmppbookmarkmanager.moc"
@@ -9,6 +9,7 @@
 
 #include "IntegrationTesting.h"
 #include "util.h"
+#include <QSignalSpy>
 #include <QTest>
 
 using CallInviteType = QXmppCallInviteElement::Type;
@@ -23,6 +24,8 @@ private:
 
     Q_SLOT void testClear();
     Q_SLOT void testClearAll();
+    Q_SLOT void testChangeId();
+    Q_SLOT void testExpiry();
 
     Q_SLOT void testAccept();
     Q_SLOT void testReject();
@@ -86,6 +89,51 @@ void tst_QXmppCallInviteManager::testClearAll()
     QCOMPARE(m_manager.callInvites().size(), 0);
 }
 
+void tst_QXmppCallInviteManager::testChangeId()
+{
+    QXmppCallInviteElement callInviteElement;
+    callInviteElement.setType(CallInviteType::Accept);
+    callInviteElement.setId("id1_testChangeId");
+
+    auto callInvite { m_manager.addCallInvite("maraTestChangeId@example.com") };
+    QVERIFY(!m_manager.handleCallInviteElement(QXmppCallInviteElement(callInviteElement), "maraTestChangeId@example.com/phone"));
+
+    // the Call Invite is found by its new ID
+    callInvite->setId("id1_testChangeId");
+    QSignalSpy acceptedSpy(callInvite.get(), &QXmppCallInvite::accepted);
+    QVERIFY(m_manager.handleCallInviteElement(QXmppCallInviteElement(callInviteElement), "maraTestChangeId@example.com/phone"));
+    QCOMPARE(acceptedSpy.count(), 1);
+    QVERIFY(!m_manager.handleCallInviteElement(QXmppCallInviteElement(callInviteElement), "other@example.com/phone"));
+
+    // the Call Invite is removed by its new ID
+    m_manager.clear(callInvite);
+    QCOMPARE(m_manager.callInvites().size(), 0);
+}
+
+void tst_QXmppCallInviteManager::testExpiry()
+{
+    auto callInvite { m_manager.addCallInvite("maraTestExpiry@example.com") };
+    callInvite->setId("id1_testExpiry");
+    auto acceptedCallInvite { m_manager.addCallInvite("maraTestExpiryAccepted@example.com") };
+    acceptedCallInvite->setId("id2_testExpiry");
+    acceptedCallInvite->setIsAccepted(true);
+
+    QSignalSpy closedSpy(callInvite.get(), &QXmppCallInvite::closed);
+    QSignalSpy acceptedClosedSpy(acceptedCallInvite.get(), &QXmppCallInvite::closed);
+    m_manager.setExpiryTimeout(1);
+    QCOMPARE(m_manager.expiryTimeout(), 1);
+
+    // only the Call Invite that hasn't been accepted expires
+    QTRY_COMPARE(closedSpy.count(), 1);
+    QVERIFY(std::holds_alternative<QXmppError>(closedSpy.constFirst().constFirst().value<Result>()));
+    QCOMPARE(m_manager.callInvites().size(), 1);
+    QCOMPARE(m_manager.callInvites().constFirst(), acceptedCallInvite);
+    QCOMPARE(acceptedClosedSpy.count(), 0);
+
+    m_manager.setExpiryTimeout(0);
+    m_manager.clearAll();
+}
+
 void tst_QXmppCallInviteManager::testAccept()
 {
     auto callInvite { m_manager.addCallInvite("maraTestAccept@example.com") };
@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
 #include "QXmppCallManager.h"
+#include "QXmppCallRateControl_p.h"
 #include "QXmppClient.h"
 #include "QXmppServer.h"
 
@@ -15,6 +16,7 @@ class tst_QXmppCallManager : public QObject
 
 private:
     Q_SLOT void testCall();
+    Q_SLOT void testRateControl();
 };
 
 void tst_QXmppCallManager::testCall()
@@ -115,5 +117,45 @@ void tst_QXmppCallManager::testCall()
     QCOMPARE(receiverCall->state(), QXmppCall::FinishedState);
 }
 
+void tst_QXmppCallManager::testRateControl()
+{
+    using namespace QXmpp::Private;
+
+    // the jitter buffer grows at once and shrinks slowly
+    JitterBufferSizer sizer;
+    QCOMPARE(sizer.latency(), JitterBufferSizer::MinimumLatency);
+    QVERIFY(!sizer.update(2));
+    QVERIFY(sizer.update(30));
+    QCOMPARE(sizer.latency(), 120);
+    QVERIFY(sizer.update(5));
+    QVERIFY(sizer.latency() < 120);
+    QVERIFY(sizer.latency() > 100);
+    QVERIFY(sizer.update(1000));
+    QCOMPARE(sizer.latency(), JitterBufferSizer::MaximumLatency);
+
+    // the bitrate is increased without losses and decreased with high losses
+    BitrateController controller(100000, 500000, 1000000);
+    QVERIFY(controller.update(0, 50));
+    QCOMPARE(controller.bitrate(), 525000);
+    QVERIFY(!controller.update(0.05, 50));
+    QCOMPARE(controller.bitrate(), 525000);
+    QVERIFY(controller.update(0.5, 50));
+    QCOMPARE(controller.bitrate(), 393750);
+
+    // it isn't increased while packets are queued
+    QVERIFY(!controller.update(0, 400));
+    QCOMPARE(controller.bitrate(), 393750);
+
+    // it stays within the limits
+    for (int i = 0; i < 20; i++) {
+        controller.update(1, 50);
+    }
+    QCOMPARE(controller.bitrate(), 100000);
+    for (int i = 0; i < 50; i++) {
+        controller.update(0, 50);
+    }
+    QCOMPARE(controller.bitrate(), 1000000);
+}
+
 QTEST_MAIN(tst_QXmppCallManager)
 #include "tst_qxmppcallmanager.moc"
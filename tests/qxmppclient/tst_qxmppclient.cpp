@@ -4,10 +4,14 @@
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
 #include "QXmppClient.h"
+#include "QXmppClientExtension.h"
+#include "QXmppDiscoveryManager.h"
 #include "QXmppE2eeExtension.h"
+#include "QXmppE2eeMetadata.h"
 #include "QXmppFutureUtils_p.h"
 #include "QXmppLogger.h"
 #include "QXmppMessage.h"
+#include "QXmppMetrics.h"
 #include "QXmppPromise.h"
 #include "QXmppRegisterIq.h"
 #include "QXmppRosterManager.h"
@@ -16,6 +20,8 @@
 
 #include "util.h"
 #include <QObject>
+#include <QSignalSpy>
+#include <QThread>
 
 using namespace QXmpp::Private;
 
@@ -29,9 +35,14 @@ private:
     Q_SLOT void handleMessageSent(QXmppLogger::MessageType type, const QString &text) const;
     Q_SLOT void testSendMessage();
     Q_SLOT void testIndexOfExtension();
+    Q_SLOT void testStanzaFilters();
+    Q_SLOT void testLazyExtensions();
     Q_SLOT void testE2eeExtension();
+    Q_SLOT void testSendOrder();
     Q_SLOT void testTaskDirect();
     Q_SLOT void testTaskStore();
+    Q_SLOT void testMessageDeduplication();
+    Q_SLOT void testSlowHandlers();
 
     QXmppClient *client;
 };
@@ -92,6 +103,144 @@ void tst_QXmppClient::testIndexOfExtension()
     QCOMPARE(client->indexOfExtension<QXmppVCardManager>(), 1);
 }
 
+class FilteredExtension : public QXmppClientExtension
+{
+public:
+    FilteredExtension(const QString &name, const QVector<StanzaFilter> &filters, QStringList &log, bool handles = false)
+        : name(name), filters(filters), log(log), handles(handles)
+    {
+    }
+
+    QVector<StanzaFilter> stanzaFilters() const override
+    {
+        return filters;
+    }
+
+    bool handleStanza(const QDomElement &) override
+    {
+        log << name;
+        return handles;
+    }
+
+    void inject(const QByteArray &xml)
+    {
+        injectIq(xmlToDom(xml), std::nullopt);
+    }
+
+private:
+    QString name;
+    QVector<StanzaFilter> filters;
+    QStringList &log;
+    bool handles;
+};
+
+void tst_QXmppClient::testStanzaFilters()
+{
+    QXmppClient client(QXmppClient::NoExtensions);
+    QStringList log;
+
+    auto *wildcard = new FilteredExtension(QStringLiteral("wildcard"), {}, log);
+    auto *query = new FilteredExtension(QStringLiteral("query"), { { QStringLiteral("iq"), QStringLiteral("urn:query") } }, log);
+    auto *anyIq = new FilteredExtension(QStringLiteral("anyIq"), { { QStringLiteral("iq"), {} } }, log);
+    auto *message = new FilteredExtension(QStringLiteral("message"), { { QStringLiteral("message"), QStringLiteral("urn:query") } }, log);
+    client.addExtension(wildcard);
+    client.addExtension(query);
+    client.addExtension(anyIq);
+    client.addExtension(message);
+
+    wildcard->inject("<iq type='result' id='1'><query xmlns='urn:query'/></iq>");
+    QCOMPARE(log, QStringList({ "wildcard", "query", "anyIq" }));
+
+    log.clear();
+    wildcard->inject("<iq type='result' id='2'><query xmlns='urn:other'/></iq>");
+    QCOMPARE(log, QStringList({ "wildcard", "anyIq" }));
+
+    // the priority of the extensions is kept
+    auto *first = new FilteredExtension(QStringLiteral("first"), { { QStringLiteral("iq"), QStringLiteral("urn:other") }, { QStringLiteral("iq"), QStringLiteral("urn:query") } }, log, true);
+    client.insertExtension(0, first);
+
+    log.clear();
+    wildcard->inject("<iq type='result' id='3'><query xmlns='urn:query'/><other xmlns='urn:other'/></iq>");
+    QCOMPARE(log, QStringList({ "first" }));
+
+    client.removeExtension(first);
+
+    log.clear();
+    wildcard->inject("<iq type='result' id='4'><query xmlns='urn:other'/><query xmlns='urn:query'/></iq>");
+    QCOMPARE(log, QStringList({ "wildcard", "query", "anyIq" }));
+}
+
+class LazyTestExtension : public QXmppClientExtension
+{
+    Q_OBJECT
+
+public:
+    LazyTestExtension() { instances++; }
+
+    QStringList discoveryFeatures() const override
+    {
+        return { QStringLiteral("urn:lazy") };
+    }
+
+    QVector<StanzaFilter> stanzaFilters() const override
+    {
+        return { { QStringLiteral("iq"), QStringLiteral("urn:lazy") } };
+    }
+
+    bool handleStanza(const QDomElement &) override
+    {
+        handled++;
+        return true;
+    }
+
+    static int instances;
+    int handled = 0;
+};
+
+int LazyTestExtension::instances = 0;
+
+void tst_QXmppClient::testLazyExtensions()
+{
+    QStringList log;
+
+    // the first instance of the type is created right away
+    QXmppClient first(QXmppClient::NoExtensions);
+    first.addLazyExtension<LazyTestExtension>();
+    QCOMPARE(LazyTestExtension::instances, 1);
+    QVERIFY(first.indexOfExtension<LazyTestExtension>() >= 0);
+
+    QXmppClient client(QXmppClient::NoExtensions);
+    auto *injector = new FilteredExtension(QStringLiteral("injector"), { { QStringLiteral("presence"), QStringLiteral("urn:none") } }, log);
+    client.addExtension(injector);
+    auto *discoveryManager = client.addNewExtension<QXmppDiscoveryManager>();
+    client.addLazyExtension<LazyTestExtension>();
+    QCOMPARE(LazyTestExtension::instances, 1);
+    QCOMPARE(client.indexOfExtension<LazyTestExtension>(), -1);
+
+    // the features are known without an instance
+    QVERIFY(discoveryManager->capabilities().features().contains(QStringLiteral("urn:lazy")));
+
+    injector->inject("<iq type='get' id='1' from='juliet@capulet.lit/balcony'><query xmlns='urn:other'/></iq>");
+    QCOMPARE(LazyTestExtension::instances, 1);
+
+    // created for a matching stanza
+    injector->inject("<iq type='get' id='2' from='juliet@capulet.lit/balcony'><query xmlns='urn:lazy'/></iq>");
+    QCOMPARE(LazyTestExtension::instances, 2);
+    auto *extension = client.findExtension<LazyTestExtension>();
+    QVERIFY(extension);
+    QCOMPARE(extension->handled, 1);
+    QCOMPARE(LazyTestExtension::instances, 2);
+    QCOMPARE(discoveryManager->capabilities().features().count(QStringLiteral("urn:lazy")), 1);
+
+    // created by findExtension()
+    QXmppClient other(QXmppClient::NoExtensions);
+    other.addLazyExtension<LazyTestExtension>();
+    QCOMPARE(LazyTestExtension::instances, 2);
+    QVERIFY(other.findExtension<LazyTestExtension>());
+    QCOMPARE(LazyTestExtension::instances, 3);
+    QVERIFY(other.indexOfExtension<LazyTestExtension>() >= 0);
+}
+
 class EncryptionExtension : public QXmppE2eeExtension
 {
 public:
@@ -165,6 +314,75 @@ void tst_QXmppClient::testE2eeExtension()
     encrypter.iqCalled = false;
 }
 
+// encrypts messages when the test finishes the promises
+class DelayedEncryptionExtension : public EncryptionExtension
+{
+public:
+    QXmppTask<MessageEncryptResult> encryptMessage(QXmppMessage &&message, const std::optional<QXmppSendStanzaParams> &) override
+    {
+        messages << message;
+        promises << QXmppPromise<MessageEncryptResult>();
+        return promises.last().task();
+    }
+
+    void finish(int index)
+    {
+        promises[index].finish(std::make_unique<QXmppMessage>(messages.at(index)));
+    }
+
+    QList<QXmppMessage> messages;
+    QList<QXmppPromise<MessageEncryptResult>> promises;
+};
+
+void tst_QXmppClient::testSendOrder()
+{
+    QXmppClient client(QXmppClient::NoExtensions);
+    DelayedEncryptionExtension encrypter;
+    client.setEncryptionExtension(&encrypter);
+
+    QXmppLogger logger;
+    logger.setLoggingType(QXmppLogger::SignalLogging);
+    client.setLogger(&logger);
+    QStringList bodies;
+    connect(&logger, &QXmppLogger::message, this, [&](QXmppLogger::MessageType type, const QString &text) {
+        QXmppMessage message;
+        if (type == QXmppLogger::SentMessage && text.startsWith(u"<message")) {
+            parsePacket(message, text.toUtf8());
+            bodies << message.body();
+        }
+    });
+
+    const auto message = [](const QString &body) {
+        return QXmppMessage({}, QStringLiteral("juliet@capulet.lit"), body);
+    };
+
+    // a plain stanza waits for the encrypted stanza before it
+    client.sendSensitive(message("one"));
+    client.send(message("two"));
+    client.sendSensitive(message("three"));
+    QCOMPARE(encrypter.promises.size(), 2);
+    QVERIFY(bodies.isEmpty());
+
+    encrypter.finish(1);
+    QVERIFY(bodies.isEmpty());
+    encrypter.finish(0);
+    QCOMPARE(bodies, (QStringList { "one", "two", "three" }));
+
+    // failed encryptions don't block the stanzas after them
+    auto failed = client.sendSensitive(message("four"));
+    client.send(message("five"));
+    QCOMPARE(bodies.size(), 3);
+    encrypter.promises.last().finish(QXmppError { "it's only a test", QXmpp::SendError::EncryptionError });
+    expectFutureVariant<QXmppError>(failed);
+    QCOMPARE(bodies, (QStringList { "one", "two", "three", "five" }));
+
+    // without a pending stanza, plain stanzas are written right away
+    client.send(message("six"));
+    QCOMPARE(bodies.last(), QStringLiteral("six"));
+
+    client.setLogger(nullptr);
+}
+
 void tst_QXmppClient::testTaskDirect()
 {
     QXmppPromise<QXmppIq> p;
@@ -228,5 +446,111 @@ void tst_QXmppClient::testTaskStore()
     QVERIFY(!p.task().hasResult());
 }
 
+void tst_QXmppClient::testMessageDeduplication()
+{
+    QXmppClient client(QXmppClient::NoExtensions);
+    QSignalSpy spy(&client, &QXmppClient::messageReceived);
+
+    auto message = [](const QString &stanzaId, const QString &originId) {
+        QXmppMessage message;
+        message.setFrom(QStringLiteral("romeo@montague.lit/orchard"));
+        message.setBody(QStringLiteral("Hi"));
+        if (!stanzaId.isEmpty()) {
+            message.setStanzaId(stanzaId);
+            message.setStanzaIdBy(QStringLiteral("juliet@capulet.lit"));
+        }
+        message.setOriginId(originId);
+        return message;
+    };
+
+    // disabled by default
+    client.injectMessage(message("1", {}));
+    client.injectMessage(message("1", {}));
+    QCOMPARE(spy.size(), 2);
+
+    spy.clear();
+    client.configuration().setMessageDeduplicationCacheSize(2);
+    QVERIFY(!client.injectMessage(message("1", {})));
+    QVERIFY(client.injectMessage(message("1", {})));
+    QCOMPARE(spy.size(), 1);
+
+    // known origin-id
+    QVERIFY(!client.injectMessage(message({}, "a")));
+    QVERIFY(client.injectMessage(message("2", "a")));
+    QCOMPARE(spy.size(), 2);
+
+    // messages without IDs are never dropped
+    QVERIFY(!client.injectMessage(message({}, {})));
+    QVERIFY(!client.injectMessage(message({}, {})));
+    QCOMPARE(spy.size(), 4);
+
+    // the least recently seen ID is discarded
+    QVERIFY(!client.injectMessage(message("3", {})));
+    QVERIFY(!client.injectMessage(message("2", {})));
+    QVERIFY(client.injectMessage(message("3", {})));
+    QCOMPARE(spy.size(), 6);
+
+    // decrypted messages are not checked
+    auto decrypted = message("1", {});
+    decrypted.setE2eeMetadata(QXmppE2eeMetadata());
+    QVERIFY(!client.injectMessage(std::move(decrypted)));
+    QCOMPARE(spy.size(), 7);
+}
+
+class SlowExtension : public QXmppClientExtension
+{
+    Q_OBJECT
+
+public:
+    bool handleStanza(const QDomElement &) override
+    {
+        QThread::msleep(20);
+        return true;
+    }
+
+    void inject(const QByteArray &xml)
+    {
+        injectIq(xmlToDom(xml), std::nullopt);
+    }
+};
+
+void tst_QXmppClient::testSlowHandlers()
+{
+    QXmppMetrics::reset();
+
+    QXmppLogger logger;
+    logger.setLoggingType(QXmppLogger::SignalLogging);
+    QStringList warnings;
+    connect(&logger, &QXmppLogger::message, this, [&](QXmppLogger::MessageType type, const QString &text) {
+        if (type == QXmppLogger::WarningMessage) {
+            warnings << text;
+        }
+    });
+
+    QXmppClient client(QXmppClient::NoExtensions);
+    client.setLogger(&logger);
+    auto *slow = new SlowExtension;
+    client.addExtension(slow);
+
+    // disabled by default
+    slow->inject("<iq type='get' id='1'><query xmlns='urn:slow'/></iq>");
+    QVERIFY(warnings.isEmpty());
+    QCOMPARE(QXmppMetrics::count(QXmppMetrics::ExtensionHandlingTime), quint64(0));
+
+    client.configuration().setSlowHandlerThreshold(5);
+    QCOMPARE(client.configuration().slowHandlerThreshold(), 5);
+    slow->inject("<iq type='get' id='2'><query xmlns='urn:slow'/></iq>");
+    QCOMPARE(warnings.size(), 1);
+    QVERIFY(warnings.constFirst().startsWith(QStringLiteral("SlowExtension took ")));
+    QVERIFY(warnings.constFirst().endsWith(QStringLiteral("to handle iq (urn:slow)")));
+    QCOMPARE(QXmppMetrics::count(QXmppMetrics::ExtensionHandlingTime, QStringLiteral("SlowExtension")), quint64(1));
+
+    // calls below the threshold are only recorded
+    client.configuration().setSlowHandlerThreshold(1000);
+    slow->inject("<iq type='get' id='3'><query xmlns='urn:slow'/></iq>");
+    QCOMPARE(warnings.size(), 1);
+    QCOMPARE(QXmppMetrics::count(QXmppMetrics::ExtensionHandlingTime, QStringLiteral("SlowExtension")), quint64(2));
+}
+
 QTEST_MAIN(tst_QXmppClient)
 #include "tst_qxmppclient.moc"
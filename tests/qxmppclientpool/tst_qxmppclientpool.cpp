@@ -0,0 +1,75 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppClient.h"
+#include "QXmppClientPool.h"
+#include "QXmppDiscoveryManager.h"
+
+#include "util.h"
+#include <atomic>
+
+#include <QNetworkAccessManager>
+#include <QObject>
+
+class tst_QXmppClientPool : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testAddClients();
+};
+
+void tst_QXmppClientPool::testAddClients()
+{
+    QVector<QXmppClient *> clients;
+    // the clients are deleted in their threads
+    std::atomic<int> deletedClients { 0 };
+    auto createClient = [&deletedClients] {
+        auto *client = new QXmppClient(QXmppClient::NoExtensions);
+        connect(client, &QObject::destroyed, [&deletedClients] { deletedClients++; });
+        return client;
+    };
+
+    {
+        QXmppClientPool pool(2);
+        QCOMPARE(pool.threadCount(), 2);
+
+        for (int i = 0; i < 4; i++) {
+            auto *client = createClient();
+            client->addNewExtension<QXmppDiscoveryManager>();
+            pool.addClient(client);
+            clients << client;
+        }
+        QCOMPARE(pool.clientCount(), 4);
+
+        // the clients are distributed evenly
+        QVERIFY(clients[0]->thread() != QThread::currentThread());
+        QVERIFY(clients[0]->thread() != clients[1]->thread());
+        QCOMPARE(clients[0]->thread(), clients[2]->thread());
+        QCOMPARE(clients[1]->thread(), clients[3]->thread());
+
+        // resources are shared by the clients of a thread
+        QCOMPARE(pool.networkAccessManager(clients[0])->thread(), clients[0]->thread());
+        QCOMPARE(pool.networkAccessManager(clients[0]), pool.networkAccessManager(clients[2]));
+        QVERIFY(pool.networkAccessManager(clients[0]) != pool.networkAccessManager(clients[1]));
+        QCOMPARE(clients[3]->findExtension<QXmppDiscoveryManager>()->capabilitiesStorage(), pool.capabilitiesStorage());
+
+        pool.removeClient(clients[0]);
+        QCOMPARE(pool.clientCount(), 3);
+        QVERIFY(!pool.networkAccessManager(clients[0]));
+        QTRY_COMPARE(deletedClients.load(), 1);
+
+        // new clients go to the thread with the fewest clients
+        auto *client = createClient();
+        pool.addClient(client);
+        QCOMPARE(client->thread(), clients[2]->thread());
+        clients << client;
+    }
+
+    // all clients are deleted with the pool
+    QCOMPARE(deletedClients.load(), 5);
+}
+
+QTEST_MAIN(tst_QXmppClientPool)
+#include "tst_qxmppclientpool.moc"
@@ -25,6 +25,7 @@ private:
     Q_SLOT void testMedia();
     Q_SLOT void testMediaSource();
     Q_SLOT void testFormType();
+    Q_SLOT void testFieldLookup();
 };
 
 void tst_QXmppDataForm::testSimple()
@@ -216,5 +217,35 @@ void tst_QXmppDataForm::testFormType()
     QCOMPARE(form.formType(), QStringLiteral("http://jabber.org/protocol/pubsub#subscribe_options"));
 }
 
+void tst_QXmppDataForm::testFieldLookup()
+{
+    const auto xml = QByteArrayLiteral(R"(<x xmlns='jabber:x:data' type='form'>
+    <field var='FORM_TYPE' type='hidden'>
+        <value>http://jabber.org/protocol/pubsub#node_config</value>
+    </field>
+    <field var='pubsub#title'><value>Princely Musings</value></field>
+    <field var='pubsub#max_items'><value>10</value></field>
+    <field var='pubsub#max_items'><value>20</value></field>
+</x>)");
+
+    QXmppDataForm form;
+    parsePacket(form, xml);
+
+    QVERIFY(!form.field(QStringLiteral("pubsub#description")));
+    QCOMPARE(form.field(QStringLiteral("pubsub#title"))->value().toString(), QStringLiteral("Princely Musings"));
+    // the first field is returned for duplicate keys
+    QCOMPARE(form.field(QStringLiteral("pubsub#max_items"))->value().toString(), QStringLiteral("10"));
+
+    // modified fields are found without the index
+    form.fields().removeFirst();
+    form.fields() << QXmppDataForm::Field(QXmppDataForm::Field::TextSingleField, QStringLiteral("pubsub#description"), QStringLiteral("Hamlet's thoughts"));
+    QVERIFY(form.formType().isNull());
+    QCOMPARE(form.field(QStringLiteral("pubsub#description"))->value().toString(), QStringLiteral("Hamlet's thoughts"));
+
+    form.setFields(form.fields());
+    QCOMPARE(form.field(QStringLiteral("pubsub#description"))->value().toString(), QStringLiteral("Hamlet's thoughts"));
+    QCOMPARE(form.field(QStringLiteral("pubsub#title"))->value().toString(), QStringLiteral("Princely Musings"));
+}
+
 QTEST_MAIN(tst_QXmppDataForm)
 #include "tst_qxmppdataform.moc"
@@ -0,0 +1,154 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppDatagramChannel_p.h"
+
+#include "util.h"
+#include <QTimer>
+
+// Delivers the datagrams of a channel to its peer after a delay, dropping
+// some of them.
+static QXmppDatagramChannel::SendFunction link(QXmppDatagramChannel **peer, std::function<bool()> drop = {})
+{
+    return [peer, drop](const QByteArray &datagram) {
+        if (drop && drop()) {
+            return;
+        }
+        auto *receiver = *peer;
+        QTimer::singleShot(1, receiver, [receiver, datagram] {
+            receiver->handleDatagram(datagram);
+        });
+    };
+}
+
+static QByteArray testData(int size)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    for (int i = 0; i < size; i++) {
+        data[i] = char(i * 7 + i / 1024);
+    }
+    return data;
+}
+
+class tst_QXmppDatagramChannel : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testPacketTypes();
+    Q_SLOT void testTransfer();
+    Q_SLOT void testLoss();
+    Q_SLOT void testDuplicates();
+};
+
+void tst_QXmppDatagramChannel::testPacketTypes()
+{
+    QByteArray sent;
+    QXmppDatagramChannel channel([&sent](const QByteArray &datagram) {
+        sent = datagram;
+    });
+    channel.write(QByteArrayLiteral("moin"));
+    QVERIFY(QXmppDatagramChannel::isDatagramChannelPacket(sent));
+    QVERIFY(sent.endsWith("moin"));
+
+    // STUN binding request
+    QVERIFY(!QXmppDatagramChannel::isDatagramChannelPacket(QByteArray::fromHex("000100002112a442")));
+    QVERIFY(!QXmppDatagramChannel::isDatagramChannelPacket(QByteArray()));
+}
+
+void tst_QXmppDatagramChannel::testTransfer()
+{
+    QXmppDatagramChannel *senderPeer = nullptr;
+    QXmppDatagramChannel *receiverPeer = nullptr;
+    QXmppDatagramChannel sender(link(&senderPeer));
+    QXmppDatagramChannel receiver(link(&receiverPeer));
+    senderPeer = &receiver;
+    receiverPeer = &sender;
+
+    QByteArray received;
+    connect(&receiver, &QXmppDatagramChannel::dataReceived, this, [&received](const QByteArray &data) {
+        received += data;
+    });
+    qint64 written = 0;
+    connect(&sender, &QXmppDatagramChannel::bytesWritten, this, [&written](qint64 bytes) {
+        written += bytes;
+    });
+
+    const auto data = testData(1024 * 1024);
+    sender.write(data);
+    QCOMPARE(sender.bytesToWrite(), qint64(data.size()));
+
+    QTRY_COMPARE_WITH_TIMEOUT(received.size(), data.size(), 20000);
+    QCOMPARE(received, data);
+    QTRY_COMPARE(sender.bytesToWrite(), qint64(0));
+    QCOMPARE(written, qint64(data.size()));
+
+    // the window grew without losses, the round-trip time has been measured
+    QVERIFY(sender.congestionWindow() > 10);
+    QVERIFY(sender.smoothedRoundTripTime() >= 0);
+}
+
+void tst_QXmppDatagramChannel::testLoss()
+{
+    int dataPackets = 0;
+    int acks = 0;
+    QXmppDatagramChannel *senderPeer = nullptr;
+    QXmppDatagramChannel *receiverPeer = nullptr;
+    // every 20th packet and every 10th acknowledgement is lost
+    QXmppDatagramChannel sender(link(&senderPeer, [&dataPackets] { return ++dataPackets % 20 == 0; }));
+    QXmppDatagramChannel receiver(link(&receiverPeer, [&acks] { return ++acks % 10 == 0; }));
+    senderPeer = &receiver;
+    receiverPeer = &sender;
+
+    QByteArray received;
+    connect(&receiver, &QXmppDatagramChannel::dataReceived, this, [&received](const QByteArray &data) {
+        received += data;
+    });
+
+    const auto data = testData(256 * 1024);
+    sender.write(data.left(100 * 1024));
+    sender.write(data.mid(100 * 1024));
+
+    QTRY_COMPARE_WITH_TIMEOUT(received.size(), data.size(), 30000);
+    QCOMPARE(received, data);
+    QTRY_COMPARE_WITH_TIMEOUT(sender.bytesToWrite(), qint64(0), 10000);
+}
+
+void tst_QXmppDatagramChannel::testDuplicates()
+{
+    QList<QByteArray> sent;
+    QXmppDatagramChannel sender([&sent](const QByteArray &datagram) {
+        sent << datagram;
+    });
+    QList<QByteArray> acks;
+    QXmppDatagramChannel receiver([&acks](const QByteArray &datagram) {
+        acks << datagram;
+    });
+    QByteArray received;
+    connect(&receiver, &QXmppDatagramChannel::dataReceived, this, [&received](const QByteArray &data) {
+        received += data;
+    });
+
+    sender.write(QByteArrayLiteral("a"));
+    sender.write(QByteArrayLiteral("b"));
+    QCOMPARE(sent.size(), 2);
+
+    // out of order and duplicated
+    receiver.handleDatagram(sent[1]);
+    QCOMPARE(received, QByteArray());
+    receiver.handleDatagram(sent[1]);
+    receiver.handleDatagram(sent[0]);
+    receiver.handleDatagram(sent[0]);
+    QCOMPARE(received, QByteArrayLiteral("ab"));
+
+    // every packet is acknowledged
+    QCOMPARE(acks.size(), 4);
+    for (const auto &ack : std::as_const(acks)) {
+        sender.handleDatagram(ack);
+    }
+    QCOMPARE(sender.bytesToWrite(), qint64(0));
+}
+
+QTEST_MAIN(tst_QXmppDatagramChannel)
+#include "tst_qxmppdatagramchannel.moc"
@@ -2,7 +2,9 @@
 //
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#include "QXmppCapabilitiesMemoryStorage.h"
 #include "QXmppDiscoveryManager.h"
+#include "QXmppUploadRequestManager.h"
 
 #include "TestClient.h"
 
@@ -13,6 +15,9 @@ private:
     Q_SLOT void testInfo();
     Q_SLOT void testItems();
     Q_SLOT void testRequests();
+    Q_SLOT void testCapabilities();
+    Q_SLOT void testServerDiscovery();
+    Q_SLOT void testCrawl();
 };
 
 void tst_QXmppDiscoveryManager::testInfo()
@@ -66,6 +71,15 @@ void tst_QXmppDiscoveryManager::testItems()
     QCOMPARE(items.at(3).name(), QStringLiteral("ae890ac52d0df67ed7cfdf51b644e901"));
 }
 
+class FeatureExtension : public QXmppClientExtension
+{
+public:
+    QStringList discoveryFeatures() const override
+    {
+        return { QStringLiteral("urn:example:feature") };
+    }
+};
+
 void tst_QXmppDiscoveryManager::testRequests()
 {
     TestClient test;
@@ -78,6 +92,200 @@ void tst_QXmppDiscoveryManager::testRequests()
 </iq>)"));
 
     test.expect("<iq id='info1' to='romeo@montague.net/orchard' type='result'><query xmlns='http://jabber.org/protocol/disco#info'><identity category='client' name='tst_qxmppdiscoverymanager ' type='pc'/><feature var='jabber:x:data'/><feature var='http://jabber.org/protocol/rsm'/><feature var='jabber:x:oob'/><feature var='http://jabber.org/protocol/xhtml-im'/><feature var='http://jabber.org/protocol/chatstates'/><feature var='http://jabber.org/protocol/caps'/><feature var='urn:xmpp:ping'/><feature var='jabber:x:conference'/><feature var='urn:xmpp:message-correct:0'/><feature var='urn:xmpp:chat-markers:0'/><feature var='urn:xmpp:hints'/><feature var='urn:xmpp:sid:0'/><feature var='urn:xmpp:message-attaching:1'/><feature var='urn:xmpp:eme:0'/><feature var='urn:xmpp:spoiler:0'/><feature var='urn:xmpp:fallback:0'/><feature var='urn:xmpp:reactions:0'/><feature var='http://jabber.org/protocol/disco#info'/></query></iq>");
+
+    // the cached response follows the client identity and the extensions
+    discoManager->setClientName(QStringLiteral("Bot"));
+    test.addNewExtension<FeatureExtension>();
+    discoManager->handleStanza(xmlToDom("<iq type='get' from='romeo@montague.net/orchard' id='info2'><query xmlns='http://jabber.org/protocol/disco#info'/></iq>"));
+    auto packet = test.takePacket();
+    QVERIFY(packet.startsWith(QStringLiteral("<iq id=\"info2\" to=\"romeo@montague.net/orchard\" type=\"result\">")));
+    QVERIFY(packet.contains(QStringLiteral("name=\"Bot\"")));
+    QVERIFY(packet.contains(QStringLiteral("<feature var=\"urn:example:feature\"/>")));
+
+    // the node of the current capabilities
+    const auto node = discoManager->clientCapabilitiesNode() + u'#' + QString::fromLatin1(discoManager->capabilities().verificationString().toBase64());
+    discoManager->handleStanza(xmlToDom(QStringLiteral("<iq type='get' from='romeo@montague.net/orchard' id='info3'><query xmlns='http://jabber.org/protocol/disco#info' node='%1'/></iq>").arg(node)));
+    packet = test.takePacket();
+    QVERIFY(packet.startsWith(QStringLiteral("<iq id=\"info3\" to=\"romeo@montague.net/orchard\" type=\"result\">")));
+    QVERIFY(packet.contains(QStringLiteral("node=\"%1\"").arg(node)));
+    QVERIFY(packet.contains(QStringLiteral("<feature var=\"urn:example:feature\"/>")));
+}
+
+void tst_QXmppDiscoveryManager::testCapabilities()
+{
+    TestClient test;
+    auto *discoManager = test.addNewExtension<QXmppDiscoveryManager>();
+    QXmppCapabilitiesMemoryStorage storage;
+    discoManager->setCapabilitiesStorage(&storage);
+
+    const QString node = QStringLiteral("http://code.google.com/p/exodus");
+    const auto ver = QByteArray::fromBase64("QgayPKawpkPSDYmwT/WM94uAlu0=");
+    const QString response = QStringLiteral(
+        "<iq id='qxmpp1' from='%1' type='result'>"
+        "<query xmlns='http://jabber.org/protocol/disco#info' node='http://code.google.com/p/exodus#%2'>"
+        "<identity category='client' name='Exodus 0.9.1' type='pc'/>"
+        "<feature var='http://jabber.org/protocol/caps'/>"
+        "<feature var='http://jabber.org/protocol/disco#info'/>"
+        "<feature var='http://jabber.org/protocol/disco#items'/>"
+        "<feature var='http://jabber.org/protocol/muc'/>"
+        "</query>"
+        "</iq>");
+
+    // concurrent requests for the same capabilities are sent only once
+    auto task1 = discoManager->requestCapabilities("benvolio@capulet.lit/230193", node, ver, "sha-1");
+    auto task2 = discoManager->requestCapabilities("romeo@montague.lit/orchard", node, ver, "sha-1");
+    test.expect("<iq id='qxmpp1' to='benvolio@capulet.lit/230193' type='get'><query xmlns='http://jabber.org/protocol/disco#info' node='http://code.google.com/p/exodus#QgayPKawpkPSDYmwT/WM94uAlu0='/></iq>");
+    test.expectNoPacket();
+    QVERIFY(!task1.isFinished());
+    QVERIFY(!task2.isFinished());
+
+    test.inject(response.arg("benvolio@capulet.lit/230193", "QgayPKawpkPSDYmwT/WM94uAlu0="));
+    QCOMPARE(expectFutureVariant<QXmppDiscoveryIq>(task1).features().size(), 4);
+    QCOMPARE(expectFutureVariant<QXmppDiscoveryIq>(task2).features().size(), 4);
+
+    // verified capabilities are cached
+    auto cachedInfo = storage.info(node, ver, "sha-1");
+    QVERIFY(cachedInfo.isFinished());
+    QVERIFY(cachedInfo.result().has_value());
+    QVERIFY(cachedInfo.result()->from().isEmpty());
+
+    auto task3 = discoManager->requestCapabilities("juliet@capulet.lit/balcony", node, ver, "sha-1");
+    test.expectNoPacket();
+    QCOMPARE(expectFutureVariant<QXmppDiscoveryIq>(task3).identities().size(), 1);
+
+    // capabilities not matching the verification string are not cached
+    const auto invalidVer = QByteArray::fromBase64("q07IKJEyjvHSyhy//CH0CxmKi8w=");
+    auto task4 = discoManager->requestCapabilities("benvolio@capulet.lit/230193", node, invalidVer, "sha-1");
+    test.expect("<iq id='qxmpp1' to='benvolio@capulet.lit/230193' type='get'><query xmlns='http://jabber.org/protocol/disco#info' node='http://code.google.com/p/exodus#q07IKJEyjvHSyhy//CH0CxmKi8w='/></iq>");
+    test.inject(response.arg("benvolio@capulet.lit/230193", "q07IKJEyjvHSyhy//CH0CxmKi8w="));
+    expectFutureVariant<QXmppError>(task4);
+
+    auto missingInfo = storage.info(node, invalidVer, "sha-1");
+    QVERIFY(missingInfo.isFinished());
+    QVERIFY(!missingInfo.result().has_value());
+}
+
+void tst_QXmppDiscoveryManager::testServerDiscovery()
+{
+    TestClient test;
+    test.configuration().setJid("user@qxmpp.org/a");
+    auto *discoManager = test.addNewExtension<QXmppDiscoveryManager>();
+    auto *uploadManager = test.addNewExtension<QXmppUploadRequestManager>();
+    discoManager->setServerDiscoveryEnabled(true);
+
+    int finished = 0;
+    connect(discoManager, &QXmppDiscoveryManager::serverDiscoveryFinished, this, [&]() {
+        finished++;
+    });
+
+    Q_EMIT test.connected();
+    test.expect("<iq id='qxmpp1' to='qxmpp.org' type='get'><query xmlns='http://jabber.org/protocol/disco#info'/></iq>");
+    test.expect("<iq id='qxmpp2' to='user@qxmpp.org' type='get'><query xmlns='http://jabber.org/protocol/disco#info'/></iq>");
+    test.expect("<iq id='qxmpp3' to='qxmpp.org' type='get'><query xmlns='http://jabber.org/protocol/disco#items'/></iq>");
+
+    // subscribers are served by the same discovery
+    auto task = discoManager->requestServerDiscovery();
+    test.expectNoPacket();
+
+    test.inject<QString>("<iq id='qxmpp1' from='qxmpp.org' type='result'><query xmlns='http://jabber.org/protocol/disco#info'>"
+                         "<identity category='server' type='im'/><feature var='urn:xmpp:carbons:2'/></query></iq>");
+    test.inject<QString>("<iq id='qxmpp2' type='result'><query xmlns='http://jabber.org/protocol/disco#info'>"
+                         "<identity category='pubsub' type='pep'/><feature var='http://jabber.org/protocol/pubsub#publish'/></query></iq>");
+    test.inject<QString>("<iq id='qxmpp3' from='qxmpp.org' type='result'><query xmlns='http://jabber.org/protocol/disco#items'>"
+                         "<item jid='upload.qxmpp.org'/></query></iq>");
+
+    // the items are crawled after that
+    test.expect("<iq id='qxmpp1' to='upload.qxmpp.org' type='get'><query xmlns='http://jabber.org/protocol/disco#info'/></iq>");
+    QVERIFY(!task.isFinished());
+    QCOMPARE(finished, 0);
+
+    test.inject<QString>("<iq id='qxmpp1' from='upload.qxmpp.org' type='result'><query xmlns='http://jabber.org/protocol/disco#info'>"
+                         "<identity category='store' type='file'/><feature var='urn:xmpp:http:upload:0'/></query></iq>");
+
+    QCOMPARE(finished, 1);
+    QVERIFY(task.isFinished());
+    const auto discovery = discoManager->serverDiscovery();
+    QVERIFY(discovery);
+    QVERIFY(discovery->serverInfo.features().contains(QStringLiteral("urn:xmpp:carbons:2")));
+    QCOMPARE(discovery->accountInfo.from(), QStringLiteral("user@qxmpp.org"));
+    QCOMPARE(discovery->accountInfo.features(), QStringList { QStringLiteral("http://jabber.org/protocol/pubsub#publish") });
+    QCOMPARE(discovery->itemsInfo.size(), 1);
+    QCOMPARE(discovery->itemsInfo.first().from(), QStringLiteral("upload.qxmpp.org"));
+
+    // the upload manager uses the result
+    QVERIFY(uploadManager->serviceFound());
+    QCOMPARE(uploadManager->uploadServices().first().jid(), QStringLiteral("upload.qxmpp.org"));
+
+    // available right away until the next stream
+    QVERIFY(discoManager->requestServerDiscovery().isFinished());
+    test.expectNoPacket();
+}
+
+void tst_QXmppDiscoveryManager::testCrawl()
+{
+    TestClient test;
+    auto *discoManager = test.addNewExtension<QXmppDiscoveryManager>();
+    discoManager->setMaxCrawlRequests(2);
+
+    // concurrent crawls share the requests
+    auto task = discoManager->crawl("qxmpp.org");
+    auto otherTask = discoManager->crawl("qxmpp.org");
+    test.expect("<iq id='qxmpp1' to='qxmpp.org' type='get'><query xmlns='http://jabber.org/protocol/disco#info'/></iq>");
+    test.expect("<iq id='qxmpp2' to='qxmpp.org' type='get'><query xmlns='http://jabber.org/protocol/disco#items'/></iq>");
+    test.expectNoPacket();
+
+    test.inject<QString>("<iq id='qxmpp1' from='qxmpp.org' type='result'><query xmlns='http://jabber.org/protocol/disco#info'>"
+                         "<identity category='server' type='im'/></query></iq>");
+    test.inject<QString>("<iq id='qxmpp2' from='qxmpp.org' type='result'><query xmlns='http://jabber.org/protocol/disco#items'>"
+                         "<item jid='upload.qxmpp.org'/><item jid='muc.qxmpp.org'/><item jid='upload.qxmpp.org'/>"
+                         "<item jid='qxmpp.org'/><item jid='pubsub.qxmpp.org'/></query></iq>");
+
+    // the items are requested once each, at most two at once
+    test.expect("<iq id='qxmpp1' to='upload.qxmpp.org' type='get'><query xmlns='http://jabber.org/protocol/disco#info'/></iq>");
+    test.expect("<iq id='qxmpp2' to='muc.qxmpp.org' type='get'><query xmlns='http://jabber.org/protocol/disco#info'/></iq>");
+    test.expectNoPacket();
+
+    test.inject<QString>("<iq id='qxmpp1' from='upload.qxmpp.org' type='result'><query xmlns='http://jabber.org/protocol/disco#info'>"
+                         "<identity category='store' type='file'/><feature var='urn:xmpp:http:upload:0'/></query></iq>");
+    test.expect("<iq id='qxmpp1' to='pubsub.qxmpp.org' type='get'><query xmlns='http://jabber.org/protocol/disco#info'/></iq>");
+    test.expectNoPacket();
+
+    test.inject<QString>("<iq id='qxmpp2' from='muc.qxmpp.org' type='error'><error type='cancel'>"
+                         "<service-unavailable xmlns='urn:ietf:params:xml:ns:xmpp-stanzas'/></error></iq>");
+    QVERIFY(!task.isFinished());
+    test.inject<QString>("<iq id='qxmpp1' from='pubsub.qxmpp.org' type='result'><query xmlns='http://jabber.org/protocol/disco#info'>"
+                         "<identity category='pubsub' type='service'/></query></iq>");
+
+    // the entities that couldn't be requested are left out
+    QTRY_VERIFY(task.isFinished());
+    QTRY_VERIFY(otherTask.isFinished());
+    const auto infos = task.takeResult();
+    QCOMPARE(infos.size(), 3);
+    QCOMPARE(infos.at(0).from(), QStringLiteral("qxmpp.org"));
+    QCOMPARE(infos.at(1).from(), QStringLiteral("upload.qxmpp.org"));
+    QCOMPARE(infos.at(2).from(), QStringLiteral("pubsub.qxmpp.org"));
+    QCOMPARE(otherTask.takeResult().size(), 3);
+
+    // the services are found in the cached result
+    auto servicesTask = discoManager->requestServices("qxmpp.org", "pubsub", "service");
+    QTRY_VERIFY(servicesTask.isFinished());
+    const auto services = servicesTask.takeResult();
+    QCOMPARE(services.size(), 1);
+    QCOMPARE(services.first().from(), QStringLiteral("pubsub.qxmpp.org"));
+
+    auto featureTask = discoManager->requestServicesByFeature("qxmpp.org", "urn:xmpp:http:upload:0");
+    QTRY_VERIFY(featureTask.isFinished());
+    const auto uploadServices = featureTask.takeResult();
+    QCOMPARE(uploadServices.size(), 1);
+    QCOMPARE(uploadServices.first().from(), QStringLiteral("upload.qxmpp.org"));
+    test.expectNoPacket();
+
+    // without the cache the entity is crawled again
+    discoManager->clearCrawlCache();
+    discoManager->setCrawlDepth(0);
+    auto uncachedTask = discoManager->crawl("qxmpp.org");
+    test.expect("<iq id='qxmpp1' to='qxmpp.org' type='get'><query xmlns='http://jabber.org/protocol/disco#info'/></iq>");
+    test.expectNoPacket();
 }
 
 QTEST_MAIN(tst_QXmppDiscoveryManager)
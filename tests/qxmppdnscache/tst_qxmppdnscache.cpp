@@ -0,0 +1,212 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppDnsCache_p.h"
+#include "QXmppFutureUtils_p.h"
+#include "QXmppPromise.h"
+
+#include "util.h"
+
+using namespace QXmpp::Private;
+using ServiceResult = DnsCache::ServiceResult;
+
+static ServiceResult serviceResult(quint32 timeToLive)
+{
+    ServiceResult result;
+    result.records.push_back({ QStringLiteral("xmpp1.example.org"), 5222, 0, 5, timeToLive });
+    result.records.push_back({ QStringLiteral("xmpp2.example.org"), 5223, 10, 5, timeToLive * 2 });
+    return result;
+}
+
+static ServiceResult errorResult(QDnsLookup::Error error)
+{
+    ServiceResult result;
+    result.error = error;
+    result.errorString = QStringLiteral("error");
+    return result;
+}
+
+class tst_QXmppDnsCache : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testCache();
+    Q_SLOT void testCaseInsensitive();
+    Q_SLOT void testExpiry();
+    Q_SLOT void testSharedLookup();
+    Q_SLOT void testNegativeCache();
+    Q_SLOT void testTemporaryError();
+    Q_SLOT void testRefresh();
+    Q_SLOT void testClear();
+};
+
+void tst_QXmppDnsCache::testCache()
+{
+    DnsCache cache;
+    QStringList queries;
+    cache.setServiceResolver([&](const QString &name) {
+        queries << name;
+        return makeReadyTask(serviceResult(3600));
+    });
+
+    auto task = cache.lookupService(QStringLiteral("_xmpp-client._tcp.example.org"));
+    QVERIFY(task.isFinished());
+    auto result = task.result();
+    QCOMPARE(result.error, QDnsLookup::NoError);
+    QCOMPARE(result.records.size(), 2);
+    QCOMPARE(result.records.at(0).target, QStringLiteral("xmpp1.example.org"));
+    QCOMPARE(result.records.at(1).port, quint16(5223));
+
+    task = cache.lookupService(QStringLiteral("_xmpp-client._tcp.example.org"));
+    QVERIFY(task.isFinished());
+    QCOMPARE(task.result().records.size(), 2);
+    QCOMPARE(queries, QStringList { QStringLiteral("_xmpp-client._tcp.example.org") });
+
+    // other names are looked up
+    cache.lookupService(QStringLiteral("_xmpp-server._tcp.example.org"));
+    QCOMPARE(queries.size(), 2);
+}
+
+void tst_QXmppDnsCache::testCaseInsensitive()
+{
+    DnsCache cache;
+    int queries = 0;
+    cache.setServiceResolver([&](const QString &) {
+        queries++;
+        return makeReadyTask(serviceResult(3600));
+    });
+
+    cache.lookupService(QStringLiteral("_xmpp-client._tcp.example.org"));
+    cache.lookupService(QStringLiteral("_xmpp-client._tcp.EXAMPLE.org"));
+    QCOMPARE(queries, 1);
+}
+
+void tst_QXmppDnsCache::testExpiry()
+{
+    DnsCache cache;
+    int queries = 0;
+    cache.setServiceResolver([&](const QString &) {
+        queries++;
+        return makeReadyTask(serviceResult(0));
+    });
+
+    // the shortest TTL of the records is used
+    cache.lookupService(QStringLiteral("_xmpp-client._tcp.example.org"));
+    cache.lookupService(QStringLiteral("_xmpp-client._tcp.example.org"));
+    QCOMPARE(queries, 2);
+}
+
+void tst_QXmppDnsCache::testSharedLookup()
+{
+    DnsCache cache;
+    QXmppPromise<ServiceResult> promise;
+    int queries = 0;
+    cache.setServiceResolver([&](const QString &) {
+        queries++;
+        return promise.task();
+    });
+
+    auto task1 = cache.lookupService(QStringLiteral("_xmpp-client._tcp.example.org"));
+    auto task2 = cache.lookupService(QStringLiteral("_xmpp-client._tcp.example.org"));
+    QCOMPARE(queries, 1);
+    QVERIFY(!task1.isFinished());
+    QVERIFY(!task2.isFinished());
+
+    promise.finish(serviceResult(3600));
+    QVERIFY(task1.isFinished());
+    QVERIFY(task2.isFinished());
+    QCOMPARE(task1.result().records.size(), 2);
+    QCOMPARE(task2.result().records.size(), 2);
+}
+
+void tst_QXmppDnsCache::testNegativeCache()
+{
+    DnsCache cache;
+    int queries = 0;
+    cache.setServiceResolver([&](const QString &) {
+        queries++;
+        return makeReadyTask(errorResult(QDnsLookup::NotFoundError));
+    });
+
+    auto task = cache.lookupService(QStringLiteral("_xmpps-client._tcp.example.org"));
+    QCOMPARE(task.result().error, QDnsLookup::NotFoundError);
+
+    task = cache.lookupService(QStringLiteral("_xmpps-client._tcp.example.org"));
+    QVERIFY(task.isFinished());
+    QCOMPARE(task.result().error, QDnsLookup::NotFoundError);
+    QCOMPARE(queries, 1);
+}
+
+void tst_QXmppDnsCache::testTemporaryError()
+{
+    DnsCache cache;
+    int queries = 0;
+    cache.setServiceResolver([&](const QString &) {
+        queries++;
+        return makeReadyTask(errorResult(QDnsLookup::ServerFailureError));
+    });
+
+    auto task = cache.lookupService(QStringLiteral("_xmpp-client._tcp.example.org"));
+    QCOMPARE(task.result().error, QDnsLookup::ServerFailureError);
+
+    cache.lookupService(QStringLiteral("_xmpp-client._tcp.example.org"));
+    QCOMPARE(queries, 2);
+}
+
+void tst_QXmppDnsCache::testRefresh()
+{
+    DnsCache cache;
+    int queries = 0;
+    QXmppPromise<ServiceResult> refreshPromise;
+    cache.setServiceResolver([&](const QString &) {
+        if (queries++ == 0) {
+            return makeReadyTask(serviceResult(1));
+        }
+        return refreshPromise.task();
+    });
+
+    cache.lookupService(QStringLiteral("_xmpp-client._tcp.example.org"));
+    QCOMPARE(queries, 1);
+
+    // the entry is refreshed when three quarters of the TTL have passed
+    QTest::qWait(800);
+    auto task = cache.lookupService(QStringLiteral("_xmpp-client._tcp.example.org"));
+    QVERIFY(task.isFinished());
+    QCOMPARE(task.result().records.size(), 2);
+    QCOMPARE(queries, 2);
+
+    // only one refresh is started
+    cache.lookupService(QStringLiteral("_xmpp-client._tcp.example.org"));
+    QCOMPARE(queries, 2);
+
+    // the refreshed entry is used afterwards
+    auto refreshed = serviceResult(3600);
+    refreshed.records.removeLast();
+    refreshPromise.finish(std::move(refreshed));
+
+    QTest::qWait(300);
+    task = cache.lookupService(QStringLiteral("_xmpp-client._tcp.example.org"));
+    QVERIFY(task.isFinished());
+    QCOMPARE(task.result().records.size(), 1);
+    QCOMPARE(queries, 2);
+}
+
+void tst_QXmppDnsCache::testClear()
+{
+    DnsCache cache;
+    int queries = 0;
+    cache.setServiceResolver([&](const QString &) {
+        queries++;
+        return makeReadyTask(serviceResult(3600));
+    });
+
+    cache.lookupService(QStringLiteral("_xmpp-client._tcp.example.org"));
+    cache.clear();
+    cache.lookupService(QStringLiteral("_xmpp-client._tcp.example.org"));
+    QCOMPARE(queries, 2);
+}
+
+QTEST_MAIN(tst_QXmppDnsCache)
+#include "tst_qxmppdnscache.moc"
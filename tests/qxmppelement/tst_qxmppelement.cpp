@@ -0,0 +1,118 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppElement.h"
+
+#include "util.h"
+#include <QDomElement>
+#include <QObject>
+
+static QByteArray serialize(const QXmppElement &element)
+{
+    QByteArray data;
+    QXmlStreamWriter writer(&data);
+    element.toXml(&writer);
+    return data;
+}
+
+class tst_QXmppElement : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testLazySerialization_data();
+    Q_SLOT void testLazySerialization();
+    Q_SLOT void testAccess();
+    Q_SLOT void testModification();
+    Q_SLOT void testSourceDomElement();
+};
+
+void tst_QXmppElement::testLazySerialization_data()
+{
+    QTest::addColumn<QByteArray>("xml");
+
+    QTest::newRow("empty")
+        << QByteArray("<x xmlns=\"urn:example\"/>");
+    QTest::newRow("attributes")
+        << QByteArray("<x xmlns=\"urn:example\" b=\"2\" a=\"1\"/>");
+    QTest::newRow("children")
+        << QByteArray("<x xmlns=\"urn:example\"><item id=\"1\">text</item><item id=\"2\"><y xmlns=\"urn:other\"/></item></x>");
+    QTest::newRow("mixed")
+        << QByteArray("<x xmlns=\"urn:example\">a<item/>b</x>");
+}
+
+void tst_QXmppElement::testLazySerialization()
+{
+    QFETCH(QByteArray, xml);
+
+    const auto dom = xmlToDom(xml);
+    QXmppElement lazy(dom);
+
+    // the same output as a materialized element
+    QXmppElement materialized(dom);
+    materialized.attributeNames();
+    for (auto child = materialized.firstChildElement(); !child.isNull(); child = child.nextSiblingElement()) {
+        child.value();
+    }
+
+    QCOMPARE(serialize(lazy), serialize(materialized));
+}
+
+void tst_QXmppElement::testAccess()
+{
+    QXmppElement element(xmlToDom(QByteArrayLiteral("<x xmlns='urn:example' a='1'>"
+                                                    "<item id='1'>first</item>"
+                                                    "<other/>"
+                                                    "<item id='2'>second</item>"
+                                                    "</x>")));
+    QVERIFY(!element.isNull());
+    QCOMPARE(element.tagName(), QStringLiteral("x"));
+    QCOMPARE(element.attribute(QStringLiteral("a")), QStringLiteral("1"));
+    QCOMPARE(element.attribute(QStringLiteral("xmlns")), QStringLiteral("urn:example"));
+
+    auto item = element.firstChildElement(QStringLiteral("item"));
+    QCOMPARE(item.attribute(QStringLiteral("id")), QStringLiteral("1"));
+    QCOMPARE(item.value(), QStringLiteral("first"));
+
+    item = item.nextSiblingElement(QStringLiteral("item"));
+    QCOMPARE(item.attribute(QStringLiteral("id")), QStringLiteral("2"));
+    QCOMPARE(item.value(), QStringLiteral("second"));
+    QVERIFY(item.nextSiblingElement().isNull());
+}
+
+void tst_QXmppElement::testModification()
+{
+    QXmppElement element(xmlToDom(QByteArrayLiteral("<x xmlns='urn:example' a='1'><item/></x>")));
+    element.setAttribute(QStringLiteral("b"), QStringLiteral("2"));
+
+    QXmppElement child;
+    child.setTagName(QStringLiteral("child"));
+    element.appendChild(child);
+    element.removeChild(element.firstChildElement(QStringLiteral("item")));
+
+    QCOMPARE(serialize(element), QByteArrayLiteral("<x xmlns=\"urn:example\" a=\"1\" b=\"2\"><child/></x>"));
+
+    // children of a lazy element can be modified
+    QXmppElement parent(xmlToDom(QByteArrayLiteral("<x xmlns='urn:example'><item/></x>")));
+    parent.firstChildElement().setValue(QStringLiteral("text"));
+    QCOMPARE(serialize(parent), QByteArrayLiteral("<x xmlns=\"urn:example\"><item>text</item></x>"));
+}
+
+void tst_QXmppElement::testSourceDomElement()
+{
+    QVERIFY(QXmppElement().sourceDomElement().isNull());
+
+    QXmppElement element(xmlToDom(QByteArrayLiteral("<x xmlns='urn:example' a='1'><item/></x>")));
+    element.setAttribute(QStringLiteral("a"), QStringLiteral("2"));
+
+    // contains the original content
+    const auto source = element.sourceDomElement();
+    QCOMPARE(source.tagName(), QStringLiteral("x"));
+    QCOMPARE(source.namespaceURI(), QStringLiteral("urn:example"));
+    QCOMPARE(source.attribute(QStringLiteral("a")), QStringLiteral("1"));
+    QVERIFY(!source.firstChildElement(QStringLiteral("item")).isNull());
+}
+
+QTEST_MAIN(tst_QXmppElement)
+#include "tst_qxmppelement.moc"
@@ -3,6 +3,7 @@
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
 #include "QXmppExternalServiceDiscoveryManager.h"
+#include "QXmppUtils.h"
 
 #include "TestClient.h"
 #include "util.h"
@@ -16,6 +17,7 @@ class tst_QXmppExternalServiceDiscoveryManager : public QObject
 
 private:
     Q_SLOT void testRequestServices();
+    Q_SLOT void testServicesCache();
     Q_SLOT void testDiscoveryFeatures();
 };
 
@@ -75,6 +77,57 @@ void tst_QXmppExternalServiceDiscoveryManager::testRequestServices()
     QCOMPARE(items.at(4).host(), QStringLiteral("ftp.shakespeare.lit"));
 }
 
+void tst_QXmppExternalServiceDiscoveryManager::testServicesCache()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppExternalServiceDiscoveryManager>();
+    QSignalSpy servicesReceived(manager, &QXmppExternalServiceDiscoveryManager::servicesReceived);
+
+    const auto servicesXml = [](const QDateTime &expires) {
+        return QStringLiteral("<iq id='qxmpp1' from='shakespeare.lit' type='result'>"
+                              "<services xmlns='urn:xmpp:extdisco:2'>"
+                              "<service host='192.0.2.1' port='8889' password='93jn3bakj9s832lrjbbz' transport='udp' type='turn'"
+                              " username='auu98sjl2wk3e9fjdsl7' expires='%1'/>"
+                              "<service host='192.0.2.1' port='8888' transport='udp' type='stun'/>"
+                              "</services>"
+                              "</iq>")
+            .arg(QXmppUtils::datetimeToString(expires));
+    };
+
+    // concurrent requests share the IQ
+    auto first = manager->requestServices("shakespeare.lit");
+    auto second = manager->requestServices("shakespeare.lit");
+    QVERIFY(!manager->cachedServices("shakespeare.lit"));
+    test.expect("<iq id='qxmpp1' to='shakespeare.lit' type='get'><services xmlns='urn:xmpp:extdisco:2'/></iq>");
+    test.expectNoPacket();
+
+    test.inject(servicesXml(QDateTime::currentDateTimeUtc().addSecs(3600)));
+    QCOMPARE(expectFutureVariant<QVector<QXmppExternalService>>(first.toFuture(this)).size(), 2);
+    QCOMPARE(expectFutureVariant<QVector<QXmppExternalService>>(second.toFuture(this)).size(), 2);
+    QCOMPARE(servicesReceived.size(), 1);
+
+    // served from the cache
+    auto cached = manager->requestServices("shakespeare.lit");
+    QVERIFY(cached.isFinished());
+    test.expectNoPacket();
+    const auto services = expectFutureVariant<QVector<QXmppExternalService>>(cached.toFuture(this));
+    QCOMPARE(services.first().username(), QStringLiteral("auu98sjl2wk3e9fjdsl7"));
+    QVERIFY(manager->cachedServices("shakespeare.lit"));
+    QVERIFY(!manager->cachedServices("shakespeare.lit", "other"));
+
+    // expired services are not cached
+    manager->clearCache();
+    QVERIFY(!manager->cachedServices("shakespeare.lit"));
+    auto expired = manager->requestServices("shakespeare.lit");
+    test.expect("<iq id='qxmpp1' to='shakespeare.lit' type='get'><services xmlns='urn:xmpp:extdisco:2'/></iq>");
+    test.inject(servicesXml(QDateTime::currentDateTimeUtc().addSecs(-10)));
+    QCOMPARE(expectFutureVariant<QVector<QXmppExternalService>>(expired.toFuture(this)).size(), 2);
+    QVERIFY(!manager->cachedServices("shakespeare.lit"));
+
+    manager->requestServices("shakespeare.lit");
+    test.expect("<iq id='qxmpp1' to='shakespeare.lit' type='get'><services xmlns='urn:xmpp:extdisco:2'/></iq>");
+}
+
 void tst_QXmppExternalServiceDiscoveryManager::testDiscoveryFeatures()
 {
     TestClient test;
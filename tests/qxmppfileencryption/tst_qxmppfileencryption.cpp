@@ -21,6 +21,9 @@ private:
     Q_SLOT void deviceEncrypt();
     Q_SLOT void deviceDecrypt_data();
     Q_SLOT void deviceDecrypt();
+    Q_SLOT void deviceDecryptChunked_data();
+    Q_SLOT void deviceDecryptChunked();
+    Q_SLOT void deviceEncryptChunked();
     Q_SLOT void paddingSize();
 };
 
@@ -123,6 +126,74 @@ void tst_QXmppFileEncryption::deviceDecrypt()
     QCOMPARE(decrypted, data);
 }
 
+void tst_QXmppFileEncryption::deviceDecryptChunked_data()
+{
+    deviceDecrypt_data();
+}
+
+void tst_QXmppFileEncryption::deviceDecryptChunked()
+{
+    QFETCH(int, cipherId);
+    QFETCH(QByteArray, key);
+    auto cipher = Cipher(cipherId);
+
+    QcaInitializer encInit;
+
+    QByteArray data;
+    for (int i = 0; i < 1024 * 1024 + 100; i++) {
+        data.append(char(i % 251));
+    }
+    QByteArray iv = "12345678901234567890123456789012";
+    const auto encrypted = process(data, cipher, Encode, key, iv);
+
+    QByteArray decrypted;
+    auto buffer = std::make_unique<QBuffer>(&decrypted);
+    buffer->open(QIODevice::WriteOnly);
+
+    // write small chunks that are collected and large chunks that are no
+    // multiple of the block size
+    DecryptionDevice decDev(std::move(buffer), cipher, key, iv);
+    auto written = 0;
+    for (auto chunkSize : { 1, 1000, 300000, 37, 500001 }) {
+        QCOMPARE(decDev.write(encrypted.mid(written, chunkSize)), qint64(chunkSize));
+        written += chunkSize;
+    }
+    decDev.write(encrypted.mid(written));
+    decDev.close();
+
+    QCOMPARE(decrypted, data);
+}
+
+void tst_QXmppFileEncryption::deviceEncryptChunked()
+{
+    QcaInitializer encInit;
+
+    QByteArray data;
+    for (int i = 0; i < 10000; i++) {
+        data.append(char(i % 256));
+    }
+    QByteArray key = "12345678901234567890123456789012";
+    QByteArray iv = "12345678901234567890123456789012";
+
+    auto buffer = std::make_unique<QBuffer>(&data);
+    buffer->open(QIODevice::ReadOnly);
+
+    // read chunks of varying sizes that are no multiple of the block size
+    EncryptionDevice encDev(std::move(buffer), Aes256CbcPkcs7, key, iv);
+    QByteArray encrypted;
+    for (int chunkSize = 1;; chunkSize = chunkSize % 700 + 37) {
+        auto chunk = encDev.read(chunkSize);
+        if (chunk.isEmpty()) {
+            break;
+        }
+        QVERIFY(chunk.size() <= chunkSize);
+        encrypted += chunk;
+    }
+
+    QCOMPARE(qint64(encrypted.size()), encDev.size());
+    QCOMPARE(encrypted, process(data, Aes256CbcPkcs7, Encode, key, iv));
+}
+
 void tst_QXmppFileEncryption::paddingSize()
 {
     constexpr auto MAX_BYTES_TEST = 1024;
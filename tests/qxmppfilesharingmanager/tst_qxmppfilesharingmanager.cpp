@@ -0,0 +1,179 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppFileMetadata.h"
+#include "QXmppFileSharingManager.h"
+#include "QXmppHttpFileSource.h"
+
+#include "util.h"
+
+#include <QFutureInterface>
+#include <QTemporaryDir>
+
+// Uploads files by reading them and returning a new URL for each upload.
+class TestProvider : public QXmppFileSharingProvider
+{
+public:
+    using SourceType = QXmppHttpFileSource;
+
+    struct TestUpload : Upload
+    {
+        void cancel() override { }
+    };
+
+    auto downloadFile(const std::any &, std::unique_ptr<QIODevice>, std::function<void(quint64, quint64)>, std::function<void(DownloadResult)> reportFinished) -> std::shared_ptr<Download> override
+    {
+        reportFinished(QXmppError { QStringLiteral("Not supported"), {} });
+        return {};
+    }
+
+    auto uploadFile(std::unique_ptr<QIODevice> source, const QXmppFileMetadata &, std::function<void(quint64, quint64)> reportProgress, std::function<void(UploadResult)> reportFinished) -> std::shared_ptr<Upload> override
+    {
+        const auto data = source->readAll();
+        reportProgress(data.size(), data.size());
+        uploads++;
+        reportFinished(QXmppHttpFileSource(QUrl(QStringLiteral("https://upload.example.org/%1").arg(uploads))));
+        return std::make_shared<TestUpload>();
+    }
+
+    int uploads = 0;
+};
+
+class tst_QXmppFileSharingManager : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testUploadCache();
+    Q_SLOT void testMetadataJobs();
+};
+
+static QString writeFile(const QString &path, const QByteArray &data)
+{
+    QFile file(path);
+    file.open(QIODevice::WriteOnly);
+    file.write(data);
+    return path;
+}
+
+// Returns the URL the file has been uploaded to.
+static QUrl shareFile(QXmppFileSharingManager &manager, const std::shared_ptr<TestProvider> &provider, const QString &path)
+{
+    auto upload = manager.uploadFile(provider, path, QStringLiteral("Meme"));
+    [&]() {
+        QTRY_VERIFY(upload->isFinished());
+    }();
+    if (!upload->isFinished()) {
+        return {};
+    }
+
+    auto result = upload->result();
+    [&]() {
+        QVERIFY(std::holds_alternative<QXmppFileUpload::FileResult>(result));
+    }();
+    if (!std::holds_alternative<QXmppFileUpload::FileResult>(result)) {
+        return {};
+    }
+
+    const auto fileShare = std::get<QXmppFileUpload::FileResult>(result).fileShare;
+    [&]() {
+        QCOMPARE(fileShare.metadata().description().value_or(QString()), QStringLiteral("Meme"));
+        QCOMPARE(fileShare.metadata().hashes().size(), 2);
+        QCOMPARE(fileShare.httpSources().size(), 1);
+    }();
+    return fileShare.httpSources().isEmpty() ? QUrl() : fileShare.httpSources().constFirst().url();
+}
+
+void tst_QXmppFileSharingManager::testUploadCache()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto path = writeFile(dir.filePath(QStringLiteral("meme.png")), "meme");
+
+    QXmppFileSharingManager manager;
+    auto provider = std::make_shared<TestProvider>();
+
+    // the files are uploaded each time by default
+    QCOMPARE(shareFile(manager, provider, path), QUrl(QStringLiteral("https://upload.example.org/1")));
+    QCOMPARE(shareFile(manager, provider, path), QUrl(QStringLiteral("https://upload.example.org/2")));
+    QCOMPARE(provider->uploads, 2);
+
+    manager.setUploadCacheSize(10);
+    QCOMPARE(shareFile(manager, provider, path), QUrl(QStringLiteral("https://upload.example.org/3")));
+    QCOMPARE(shareFile(manager, provider, path), QUrl(QStringLiteral("https://upload.example.org/3")));
+    QCOMPARE(provider->uploads, 3);
+
+    // copies of the file are recognized by their hashes
+    const auto copy = writeFile(dir.filePath(QStringLiteral("copy.png")), "meme");
+    QCOMPARE(shareFile(manager, provider, copy), QUrl(QStringLiteral("https://upload.example.org/3")));
+    QCOMPARE(provider->uploads, 3);
+
+    // other files of the same size are uploaded
+    const auto other = writeFile(dir.filePath(QStringLiteral("other.png")), "mime");
+    QCOMPARE(shareFile(manager, provider, other), QUrl(QStringLiteral("https://upload.example.org/4")));
+
+    // the uploads of other providers aren't reused
+    auto otherProvider = std::make_shared<TestProvider>();
+    QCOMPARE(shareFile(manager, otherProvider, path), QUrl(QStringLiteral("https://upload.example.org/1")));
+
+    manager.clearUploadCache();
+    QCOMPARE(shareFile(manager, provider, path), QUrl(QStringLiteral("https://upload.example.org/5")));
+
+    // expired uploads aren't reused
+    manager.setUploadCacheLifetime(0);
+    manager.clearUploadCache();
+    QCOMPARE(shareFile(manager, provider, path), QUrl(QStringLiteral("https://upload.example.org/6")));
+    QCOMPARE(shareFile(manager, provider, path), QUrl(QStringLiteral("https://upload.example.org/7")));
+}
+
+void tst_QXmppFileSharingManager::testMetadataJobs()
+{
+    using MetadataResult = std::shared_ptr<QXmppFileSharingManager::MetadataGeneratorResult>;
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    QXmppFileSharingManager manager;
+    manager.setMaxMetadataJobs(2);
+    std::vector<QFutureInterface<MetadataResult>> jobs;
+    manager.setMetadataGenerator([&](std::unique_ptr<QIODevice>) {
+        jobs.emplace_back(QFutureInterfaceBase::Started);
+        return jobs.back().future();
+    });
+    auto finishJob = [&](std::size_t i) {
+        jobs[i].reportResult(std::make_shared<QXmppFileSharingManager::MetadataGeneratorResult>());
+        jobs[i].reportFinished();
+    };
+
+    auto provider = std::make_shared<TestProvider>();
+    std::vector<std::shared_ptr<QXmppFileUpload>> uploads;
+    for (int i = 0; i < 4; i++) {
+        const auto path = writeFile(dir.filePath(QStringLiteral("%1.png").arg(i)), QByteArray::number(i));
+        uploads.push_back(manager.uploadFile(provider, path));
+    }
+
+    // the other uploads wait until a metadata job has finished
+    QCOMPARE(jobs.size(), std::size_t(2));
+    QCOMPARE(provider->uploads, 2);
+
+    // cancelled uploads are skipped
+    uploads[2]->cancel();
+    QTRY_VERIFY(uploads[2]->isFinished());
+    QVERIFY(std::holds_alternative<QXmpp::Cancelled>(uploads[2]->result()));
+
+    finishJob(0);
+    QTRY_VERIFY(uploads[0]->isFinished());
+    QTRY_COMPARE(jobs.size(), std::size_t(3));
+    QCOMPARE(provider->uploads, 3);
+
+    finishJob(1);
+    finishJob(2);
+    QTRY_VERIFY(uploads[1]->isFinished());
+    QTRY_VERIFY(uploads[3]->isFinished());
+    QCOMPARE(jobs.size(), std::size_t(3));
+    QVERIFY(std::holds_alternative<QXmppFileUpload::FileResult>(uploads[3]->result()));
+}
+
+QTEST_MAIN(tst_QXmppFileSharingManager)
+#include "tst_qxmppfilesharingmanager.moc"
@@ -0,0 +1,167 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppHappyEyeballs_p.h"
+
+#include "util.h"
+#include <QTcpServer>
+#include <QTcpSocket>
+
+using namespace QXmpp::Private;
+
+// Returns a local port nobody is listening on.
+static quint16 closedPort()
+{
+    QTcpServer server;
+    server.listen(QHostAddress::LocalHost);
+    return server.serverPort();
+}
+
+class tst_QXmppHappyEyeballs : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void initTestCase();
+    Q_SLOT void testConnect();
+    Q_SLOT void testFallback();
+    Q_SLOT void testHostName();
+    Q_SLOT void testFailure();
+    Q_SLOT void testAbort();
+    Q_SLOT void testMoveConnection();
+};
+
+void tst_QXmppHappyEyeballs::initTestCase()
+{
+    qRegisterMetaType<QHostAddress>();
+}
+
+void tst_QXmppHappyEyeballs::testConnect()
+{
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    HappyEyeballs connector;
+    QSignalSpy connectedSpy(&connector, &HappyEyeballs::connected);
+    QSignalSpy failedSpy(&connector, &HappyEyeballs::failed);
+
+    connector.connectToHosts({ { QStringLiteral("127.0.0.1"), server.serverPort() } });
+    QVERIFY(connector.isConnecting());
+    QVERIFY(connectedSpy.wait());
+
+    QCOMPARE(connectedSpy.first().at(0).value<QHostAddress>(), QHostAddress(QHostAddress::LocalHost));
+    QCOMPARE(connectedSpy.first().at(1).value<quint16>(), server.serverPort());
+    QVERIFY(!connector.isConnecting());
+    QVERIFY(failedSpy.isEmpty());
+}
+
+void tst_QXmppHappyEyeballs::testFallback()
+{
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    HappyEyeballs connector;
+    // the failure of the first host must not wait for the attempt delay
+    connector.setConnectionAttemptDelay(60000);
+    QSignalSpy connectedSpy(&connector, &HappyEyeballs::connected);
+    QSignalSpy failedSpy(&connector, &HappyEyeballs::failed);
+
+    connector.connectToHosts({
+        { QStringLiteral("127.0.0.1"), closedPort() },
+        { QStringLiteral("127.0.0.1"), server.serverPort() },
+    });
+    QVERIFY(connectedSpy.wait());
+
+    QCOMPARE(connectedSpy.first().at(1).value<quint16>(), server.serverPort());
+    QVERIFY(failedSpy.isEmpty());
+}
+
+void tst_QXmppHappyEyeballs::testHostName()
+{
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::Any));
+
+    HappyEyeballs connector;
+    QSignalSpy connectedSpy(&connector, &HappyEyeballs::connected);
+
+    connector.connectToHosts({ { QStringLiteral("localhost"), server.serverPort() } });
+    QVERIFY(connectedSpy.wait());
+
+    QVERIFY(connectedSpy.first().at(0).value<QHostAddress>().isLoopback());
+}
+
+void tst_QXmppHappyEyeballs::testFailure()
+{
+    HappyEyeballs connector;
+    QSignalSpy connectedSpy(&connector, &HappyEyeballs::connected);
+    QSignalSpy failedSpy(&connector, &HappyEyeballs::failed);
+
+    connector.connectToHosts({
+        { QStringLiteral("127.0.0.1"), closedPort() },
+        { QStringLiteral("127.0.0.1"), closedPort() },
+    });
+    QVERIFY(failedSpy.wait());
+
+    QVERIFY(!failedSpy.first().at(0).toString().isEmpty());
+    QVERIFY(connectedSpy.isEmpty());
+    QVERIFY(!connector.isConnecting());
+
+    // no targets
+    failedSpy.clear();
+    connector.connectToHosts({});
+    QCOMPARE(failedSpy.size(), 1);
+}
+
+void tst_QXmppHappyEyeballs::testAbort()
+{
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    HappyEyeballs connector;
+    QSignalSpy connectedSpy(&connector, &HappyEyeballs::connected);
+    QSignalSpy failedSpy(&connector, &HappyEyeballs::failed);
+
+    connector.connectToHosts({ { QStringLiteral("127.0.0.1"), server.serverPort() } });
+    connector.abort();
+    QVERIFY(!connector.isConnecting());
+
+    QVERIFY(!connectedSpy.wait(200));
+    QVERIFY(failedSpy.isEmpty());
+}
+
+void tst_QXmppHappyEyeballs::testMoveConnection()
+{
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    HappyEyeballs connector;
+    QSignalSpy connectedSpy(&connector, &HappyEyeballs::connected);
+
+    connector.connectToHosts({ { QStringLiteral("127.0.0.1"), server.serverPort() } });
+    QVERIFY(connectedSpy.wait());
+    QVERIFY(server.waitForNewConnection(1000));
+    auto *serverSocket = server.nextPendingConnection();
+    QVERIFY(serverSocket);
+
+    QTcpSocket socket;
+#ifdef Q_OS_UNIX
+    QVERIFY(connector.moveConnectionTo(&socket));
+    QCOMPARE(socket.state(), QAbstractSocket::ConnectedState);
+    QCOMPARE(socket.peerPort(), server.serverPort());
+
+    // the connection stays open
+    socket.write("<stream/>");
+    QVERIFY(serverSocket->waitForReadyRead(1000));
+    QCOMPARE(serverSocket->readAll(), QByteArray("<stream/>"));
+#else
+    QVERIFY(!connector.moveConnectionTo(&socket));
+#endif
+
+    // the connection can only be moved once
+    QTcpSocket otherSocket;
+    QVERIFY(!connector.moveConnectionTo(&otherSocket));
+}
+
+QTEST_MAIN(tst_QXmppHappyEyeballs)
+#include "tst_qxmpphappyeyeballs.moc"
@@ -5,6 +5,7 @@
 
 #include "QXmppClient.h"
 #include "QXmppDiscoveryManager.h"
+#include "QXmppHttpFileSharingProvider.h"
 #include "QXmppHttpUploadIq.h"
 #include "QXmppHttpUploadManager.h"
 #include "QXmppTlsManager_p.h"
@@ -14,6 +15,7 @@
 #include "TestClient.h"
 #include "util.h"
 #include <QMimeDatabase>
+#include <QNetworkAccessManager>
 
 static const auto UPLOAD_SERVICE_NAME = QStringLiteral("upload.montague.tld");
 constexpr quint64 MAX_FILE_SIZE = 500UL * 1024UL * 1024UL;
@@ -60,8 +62,11 @@ private:
     Q_SLOT void testSendingFuture_data();
     Q_SLOT void testSendingFuture();
     Q_SLOT void testUploadService();
+    Q_SLOT void testPrefetchSlot();
+    Q_SLOT void testRediscoverService();
 
     // HttpUploadManager
+    Q_SLOT void testNetworkAccessManager();
     Q_SLOT void testUpload();
 };
 
@@ -357,6 +362,75 @@ void tst_QXmppHttpUploadManager::testUploadService()
     QCOMPARE(service.jid(), QStringLiteral("upload.shakespeare.lit"));
 }
 
+void tst_QXmppHttpUploadManager::testPrefetchSlot()
+{
+    const auto mimeType = QMimeDatabase().mimeTypeForName(QStringLiteral("image/jpeg"));
+    auto slotReply = [](const QXmppHttpUploadRequestIq &iq) {
+        return QStringLiteral("<iq from='%1' id='%2' type='result'>"
+                              "<slot xmlns='urn:xmpp:http:upload:0'>"
+                              "<put url='https://upload.montague.tld/%3'/>"
+                              "<get url='https://download.montague.tld/%3'/>"
+                              "</slot>"
+                              "</iq>")
+            .arg(iq.to(), iq.id(), iq.fileName());
+    };
+
+    TestClient test;
+    test.addNewExtension<QXmppDiscoveryManager>();
+    auto *manager = test.addNewExtension<QXmppUploadRequestManager>();
+    addUploadService(test);
+
+    // response arrives before the slot is requested
+    manager->prefetchSlot(QStringLiteral("a.jpg"), 1000, mimeType);
+    QXmppHttpUploadRequestIq iq;
+    parsePacket(iq, test.takePacket().toUtf8());
+    QCOMPARE(iq.fileName(), QStringLiteral("a.jpg"));
+    test.inject(slotReply(iq));
+
+    auto task = manager->requestSlot(QStringLiteral("a.jpg"), 1000, mimeType);
+    test.expectNoPacket();
+    QVERIFY(task.isFinished());
+    auto slot = expectFutureVariant<QXmppHttpUploadSlotIq>(task);
+    QCOMPARE(slot.getUrl(), QUrl(QStringLiteral("https://download.montague.tld/a.jpg")));
+
+    // the slot is only used once
+    manager->requestSlot(QStringLiteral("a.jpg"), 1000, mimeType);
+    parsePacket(iq, test.takePacket().toUtf8());
+    QCOMPARE(iq.fileName(), QStringLiteral("a.jpg"));
+
+    // slot is requested while the prefetch is pending
+    manager->prefetchSlot(QStringLiteral("b.jpg"), 2000, mimeType);
+    parsePacket(iq, test.takePacket().toUtf8());
+    task = manager->requestSlot(QStringLiteral("b.jpg"), 2000, mimeType);
+    test.expectNoPacket();
+    QVERIFY(!task.isFinished());
+
+    test.inject(slotReply(iq));
+    slot = expectFutureVariant<QXmppHttpUploadSlotIq>(task);
+    QCOMPARE(slot.getUrl(), QUrl(QStringLiteral("https://download.montague.tld/b.jpg")));
+
+    // other files are not matched
+    manager->prefetchSlot(QStringLiteral("c.jpg"), 3000, mimeType);
+    test.takePacket();
+    manager->requestSlot(QStringLiteral("c.jpg"), 3001, mimeType);
+    parsePacket(iq, test.takePacket().toUtf8());
+    QCOMPARE(iq.size(), 3001LL);
+}
+
+void tst_QXmppHttpUploadManager::testRediscoverService()
+{
+    TestClient test;
+    test.addNewExtension<QXmppDiscoveryManager>();
+    auto *manager = test.addNewExtension<QXmppUploadRequestManager>();
+
+    QSignalSpy foundSpy(manager, &QXmppUploadRequestManager::serviceFoundChanged);
+    addUploadService(test);
+    addUploadService(test);
+
+    QCOMPARE(manager->uploadServices().size(), 1);
+    QCOMPARE(foundSpy.size(), 1);
+}
+
 void tst_QXmppHttpUploadManager::testUpload()
 {
     using DiscoInfoResult = QXmppDiscoveryManager::InfoResult;
@@ -435,5 +509,17 @@ void tst_QXmppHttpUploadManager::testUpload()
     qDebug() << "Uploaded file to" << url.toDisplayString();
 }
 
+void tst_QXmppHttpUploadManager::testNetworkAccessManager()
+{
+    // a manager is created if none is given
+    QXmppHttpUploadManager manager;
+    QVERIFY(manager.networkAccessManager());
+    QCOMPARE(manager.networkAccessManager()->parent(), &manager);
+
+    QNetworkAccessManager netManager;
+    QXmppHttpUploadManager sharedManager(&netManager);
+    QCOMPARE(sharedManager.networkAccessManager(), &netManager);
+}
+
 QTEST_MAIN(tst_QXmppHttpUploadManager)
 #include "tst_qxmpphttpuploadmanager.moc"
@@ -2,7 +2,7 @@
 //
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
-#include "QXmppStun.h"
+#include "QXmppStun_p.h"
 
 #include "util.h"
 #include <QHostInfo>
@@ -15,6 +15,9 @@ private:
     Q_SLOT void testBind();
     Q_SLOT void testBindStun();
     Q_SLOT void testConnect();
+    Q_SLOT void testRemoveComponent();
+    Q_SLOT void testPortPool();
+    Q_SLOT void testTurnAllocationCache();
 };
 
 void tst_QXmppIceConnection::testBind()
@@ -146,5 +149,94 @@ void tst_QXmppIceConnection::testConnect()
     QVERIFY(clientR.isConnected());
 }
 
+void tst_QXmppIceConnection::testTurnAllocationCache()
+{
+    const QHostAddress host(QHostAddress::LocalHost);
+
+    QXmppTurnAllocationCache cache;
+    QCOMPARE(cache.timeout(), 60);
+    QVERIFY(!cache.take(host, 3478, QStringLiteral("user"), QStringLiteral("password")));
+
+    // allocations which are not connected are not cached
+    QXmppTurnAllocation allocation;
+    allocation.setServer(host, 3478);
+    allocation.setUser(QStringLiteral("user"));
+    allocation.setPassword(QStringLiteral("password"));
+    QVERIFY(!cache.release(&allocation));
+    QVERIFY(!cache.take(host, 3478, QStringLiteral("user"), QStringLiteral("password")));
+
+    cache.setTimeout(-1);
+    QCOMPARE(cache.timeout(), 0);
+
+    // binding with an empty cache still allocates
+    QXmppIceConnection client;
+    client.setTurnAllocationCache(&cache);
+    client.setTurnServer(host, 3478);
+    client.addComponent(1);
+    QVERIFY(client.bind({ host }));
+    QCOMPARE(client.gatheringState(), QXmppIceConnection::BusyGatheringState);
+    client.close();
+}
+
+void tst_QXmppIceConnection::testRemoveComponent()
+{
+    QXmppIceConnection client;
+    client.setIceControlling(true);
+    client.addComponent(1);
+    client.addComponent(2);
+    client.bind(QXmppIceComponent::discoverAddresses());
+    QVERIFY(!client.localCandidates().isEmpty());
+
+    QSignalSpy candidatesChanged(&client, &QXmppIceConnection::localCandidatesChanged);
+    client.removeComponent(2);
+    QVERIFY(!client.component(2));
+    QVERIFY(client.component(1));
+    QCOMPARE(candidatesChanged.size(), 1);
+    QCOMPARE(client.gatheringState(), QXmppIceConnection::CompleteGatheringState);
+
+    const auto candidates = client.localCandidates();
+    QVERIFY(!candidates.isEmpty());
+    for (const auto &candidate : candidates) {
+        QCOMPARE(candidate.component(), 1);
+    }
+}
+
+void tst_QXmppIceConnection::testPortPool()
+{
+    const QList<QHostAddress> addresses { QHostAddress(QHostAddress::LocalHost) };
+
+    QXmppIcePortPool pool(2);
+    pool.setAddresses(addresses);
+    QCOMPARE(pool.size(), 0);
+    QVERIFY(pool.take(addresses, 2).isEmpty());
+
+    // the pool is filled from the event loop
+    pool.setSize(2);
+    QCOMPARE(pool.availableCount(), 0);
+    QTRY_COMPARE(pool.availableCount(), 2);
+
+    // sockets are only handed out for matching connections
+    QVERIFY(pool.take(addresses, 1).isEmpty());
+    QVERIFY(pool.take({ QHostAddress(QHostAddress::LocalHostIPv6) }, 2).isEmpty());
+
+    // binding takes the sockets out of the pool
+    QXmppIceConnection client;
+    client.setPortPool(&pool);
+    client.addComponent(1);
+    client.addComponent(2);
+    QVERIFY(client.bind(addresses));
+    QCOMPARE(pool.availableCount(), 1);
+    QCOMPARE(client.component(1)->localCandidates().size(), 1);
+    QCOMPARE(client.component(2)->localCandidates().size(), 1);
+    QCOMPARE(client.component(2)->localCandidates().constFirst().port(),
+             client.component(1)->localCandidates().constFirst().port() + 1);
+
+    // and the pool is refilled afterwards
+    QTRY_COMPARE(pool.availableCount(), 2);
+
+    pool.setSize(0);
+    QCOMPARE(pool.availableCount(), 0);
+}
+
 QTEST_MAIN(tst_QXmppIceConnection)
 #include "tst_qxmppiceconnection.moc"
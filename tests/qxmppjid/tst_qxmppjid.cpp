@@ -0,0 +1,107 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppJid.h"
+
+#include "util.h"
+
+#include <QHash>
+
+class tst_QXmppJid : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testParts_data();
+    Q_SLOT void testParts();
+    Q_SLOT void testBare();
+    Q_SLOT void testHash();
+    Q_SLOT void testInterned();
+};
+
+void tst_QXmppJid::testParts_data()
+{
+    QTest::addColumn<QString>("jid");
+    QTest::addColumn<QString>("node");
+    QTest::addColumn<QString>("domain");
+    QTest::addColumn<QString>("resource");
+    QTest::addColumn<QString>("bare");
+
+#define ROW(name, jid, node, domain, resource, bare) \
+    QTest::newRow(name) << QStringLiteral(jid) << QStringLiteral(node) << QStringLiteral(domain) << QStringLiteral(resource) << QStringLiteral(bare)
+
+    ROW("full", "foo@example.com/resource", "foo", "example.com", "resource", "foo@example.com");
+    ROW("bare", "foo@example.com", "foo", "example.com", "", "foo@example.com");
+    ROW("domain", "example.com", "", "example.com", "", "example.com");
+    ROW("domain-resource", "example.com/resource", "", "example.com", "resource", "example.com");
+    ROW("resource-separators", "foo@example.com/res@ource/1", "foo", "example.com", "res@ource/1", "foo@example.com");
+    ROW("empty", "", "", "", "", "");
+
+#undef ROW
+}
+
+void tst_QXmppJid::testParts()
+{
+    QFETCH(QString, jid);
+    QFETCH(QString, node);
+    QFETCH(QString, domain);
+    QFETCH(QString, resource);
+    QFETCH(QString, bare);
+
+    const QXmppJid parsed(jid);
+    QCOMPARE(parsed.toString(), jid);
+    QCOMPARE(parsed.node().toString(), node);
+    QCOMPARE(parsed.domain().toString(), domain);
+    QCOMPARE(parsed.resource().toString(), resource);
+    QCOMPARE(parsed.bare().toString(), bare);
+    QCOMPARE(parsed.isBare(), resource.isEmpty());
+    QCOMPARE(parsed.isEmpty(), jid.isEmpty());
+}
+
+void tst_QXmppJid::testBare()
+{
+    const QXmppJid jid(QStringLiteral("foo@example.com/resource"));
+    const auto bare = jid.toBare();
+    QCOMPARE(bare.toString(), QStringLiteral("foo@example.com"));
+    QCOMPARE(bare.node().toString(), QStringLiteral("foo"));
+    QCOMPARE(bare.domain().toString(), QStringLiteral("example.com"));
+    QVERIFY(bare.isBare());
+    QCOMPARE(bare, QXmppJid(QStringLiteral("foo@example.com")));
+
+    // bare JIDs are shared
+    QVERIFY(bare.toBare().toString().constData() == bare.toString().constData());
+}
+
+void tst_QXmppJid::testHash()
+{
+    const QXmppJid a(QStringLiteral("foo@example.com/a"));
+    const QXmppJid b(QStringLiteral("foo@example.com/b"));
+    QCOMPARE(a.hash(), QXmppJid(QStringLiteral("foo@example.com/a")).hash());
+    QVERIFY(a != b);
+
+    QHash<QXmppJid, int> hash;
+    hash.insert(a, 1);
+    hash.insert(b, 2);
+    hash.insert(a.toBare(), 3);
+    QCOMPARE(hash.size(), 3);
+    QCOMPARE(hash.value(QXmppJid(QStringLiteral("foo@example.com/b"))), 2);
+    QCOMPARE(hash.value(QXmppJid(QStringLiteral("foo@example.com"))), 3);
+}
+
+void tst_QXmppJid::testInterned()
+{
+    // strings built at runtime, so they don't share any data
+    const QXmppJid a(QStringLiteral("foo@example.com") + QStringLiteral("/a"));
+    const QXmppJid b(QStringLiteral("foo@example.com") + QStringLiteral("/a"));
+    QVERIFY(a.toString().constData() != b.toString().constData());
+
+    const auto internedA = a.interned();
+    const auto internedB = b.interned();
+    QCOMPARE(internedA, a);
+    QCOMPARE(internedA.resource().toString(), QStringLiteral("a"));
+    QVERIFY(internedA.toString().constData() == internedB.toString().constData());
+}
+
+QTEST_MAIN(tst_QXmppJid)
+#include "tst_qxmppjid.moc"
@@ -4,9 +4,11 @@
 //
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#include "QXmppHash.h"
 #include "QXmppJingleData.h"
 
 #include "util.h"
+#include <QMimeType>
 #include <QObject>
 
 class tst_QXmppJingleData : public QObject
@@ -41,6 +43,7 @@ private:
     Q_SLOT void testCandidate();
     Q_SLOT void testContent();
     Q_SLOT void testContentFingerprint();
+    Q_SLOT void testContentFileTransfer();
     Q_SLOT void testContentSdp();
     Q_SLOT void testContentSdpReflexive();
     Q_SLOT void testContentSdpFingerprint();
@@ -48,6 +51,7 @@ private:
     Q_SLOT void testContentRtpFeedbackNegotiation();
     Q_SLOT void testContentRtpHeaderExtensionsNegotiation();
     Q_SLOT void testSession();
+    Q_SLOT void testSessionContentGroups();
     Q_SLOT void testTerminate();
     Q_SLOT void testRtpSessionState_data();
     Q_SLOT void testRtpSessionState();
@@ -743,6 +747,52 @@ void tst_QXmppJingleData::testContentFingerprint()
     serializePacket(content, xml);
 }
 
+void tst_QXmppJingleData::testContentFileTransfer()
+{
+    const QByteArray xml(
+        "<content creator=\"initiator\" name=\"a-file-offer\" senders=\"initiator\">"
+        "<description xmlns=\"urn:xmpp:jingle:apps:file-transfer:5\">"
+        "<file>"
+        "<date>1969-07-21T02:56:15Z</date>"
+        "<desc>This is a test. If this were a real file...</desc>"
+        "<hash xmlns=\"urn:xmpp:hashes:2\" algo=\"md5\">OixHJUGW8Y3O6y5ESvzjvA==</hash>"
+        "<media-type>text/plain</media-type>"
+        "<name>test.txt</name>"
+        "<size>6144</size>"
+        "</file>"
+        "</description>"
+        "<transport xmlns=\"urn:xmpp:jingle:transports:ice-udp:1\" ufrag=\"8hhy\" pwd=\"asd88fgpdd777uzjYhagZg\"/>"
+        "</content>");
+
+    QXmppJingleIq::Content content;
+    parsePacket(content, xml);
+
+    QCOMPARE(content.name(), QLatin1String("a-file-offer"));
+    QCOMPARE(content.description().type(), QLatin1String("urn:xmpp:jingle:apps:file-transfer:5"));
+    QVERIFY(content.description().payloadTypes().isEmpty());
+    QVERIFY(content.fileTransferFile());
+    const auto file = *content.fileTransferFile();
+    QCOMPARE(*file.lastModified(), QDateTime(QDate(1969, 7, 21), QTime(2, 56, 15), Qt::UTC));
+    QCOMPARE(*file.description(), QStringLiteral("This is a test. If this were a real file..."));
+    QCOMPARE(file.hashes().size(), 1);
+    QCOMPARE(file.hashes().first().algorithm(), QXmpp::HashAlgorithm::Md5);
+    QCOMPARE(file.hashes().first().hash(), QByteArray::fromBase64("OixHJUGW8Y3O6y5ESvzjvA=="));
+    QCOMPARE(file.mediaType()->name(), QStringLiteral("text/plain"));
+    QCOMPARE(*file.filename(), QStringLiteral("test.txt"));
+    QCOMPARE(*file.size(), uint64_t(6144));
+    QCOMPARE(content.transportUser(), QLatin1String("8hhy"));
+    QCOMPARE(content.transportPassword(), QLatin1String("asd88fgpdd777uzjYhagZg"));
+
+    serializePacket(content, xml);
+
+    // RTP contents have no file
+    QXmppJingleIq::Content rtpContent;
+    parsePacket(rtpContent, QByteArrayLiteral("<content creator=\"initiator\" name=\"voice\">"
+                                              "<description xmlns=\"urn:xmpp:jingle:apps:rtp:1\" media=\"audio\"/>"
+                                              "</content>"));
+    QVERIFY(!rtpContent.fileTransferFile());
+}
+
 void tst_QXmppJingleData::testContentSdp()
 {
     const QString sdp(
@@ -1075,6 +1125,45 @@ void tst_QXmppJingleData::testSession()
     serializePacket(session, xml);
 }
 
+void tst_QXmppJingleData::testSessionContentGroups()
+{
+    const QByteArray xml(
+        "<iq"
+        " id=\"zid615d9\""
+        " to=\"juliet@capulet.lit/balcony\""
+        " from=\"romeo@montague.lit/orchard\""
+        " type=\"set\">"
+        "<jingle xmlns=\"urn:xmpp:jingle:1\""
+        " action=\"session-initiate\""
+        " initiator=\"romeo@montague.lit/orchard\""
+        " sid=\"a73sjjvkla37jfea\">"
+        "<content creator=\"initiator\" name=\"voice\">"
+        "<description xmlns=\"urn:xmpp:jingle:apps:stub:0\"/>"
+        "<transport xmlns=\"urn:xmpp:jingle:transports:stub:0\"/>"
+        "</content>"
+        "<content creator=\"initiator\" name=\"webcam\">"
+        "<description xmlns=\"urn:xmpp:jingle:apps:stub:0\"/>"
+        "<transport xmlns=\"urn:xmpp:jingle:transports:stub:0\"/>"
+        "</content>"
+        "<group xmlns=\"urn:xmpp:jingle:apps:grouping:0\" semantics=\"BUNDLE\">"
+        "<content name=\"voice\"/>"
+        "<content name=\"webcam\"/>"
+        "</group>"
+        "</jingle>"
+        "</iq>");
+
+    QXmppJingleIq session;
+    parsePacket(session, xml);
+    QCOMPARE(session.contents().size(), 2);
+    QCOMPARE(session.contentGroups().size(), 1);
+    QCOMPARE(session.contentGroups()[0].semantics, QStringLiteral("BUNDLE"));
+    QCOMPARE(session.contentGroups()[0].contentNames, (QStringList { QStringLiteral("voice"), QStringLiteral("webcam") }));
+    serializePacket(session, xml);
+
+    session.setContentGroups({});
+    QVERIFY(session.contentGroups().isEmpty());
+}
+
 void tst_QXmppJingleData::testTerminate()
 {
     const QByteArray xml(
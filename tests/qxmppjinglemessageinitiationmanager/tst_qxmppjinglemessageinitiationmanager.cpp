@@ -25,6 +25,8 @@ private:
 
     Q_SLOT void testClear();
     Q_SLOT void testClearAll();
+    Q_SLOT void testChangeId();
+    Q_SLOT void testExpiry();
 
     Q_SLOT void testRing();
     Q_SLOT void testProceed();
@@ -92,6 +94,55 @@ void tst_QXmppJingleMessageInitiationManager::testClearAll()
     QCOMPARE(m_manager.jmis().size(), 0);
 }
 
+void tst_QXmppJingleMessageInitiationManager::testChangeId()
+{
+    QXmppJingleMessageInitiationElement jmiElement;
+    jmiElement.setType(JmiType::Ringing);
+    jmiElement.setId("ca3cf894-5325-482f-a412-a6e9f832298d");
+
+    auto jmi { m_manager.addJmi("julietChangeId@capulet.example") };
+    QVERIFY(!m_manager.handleJmiElement(QXmppJingleMessageInitiationElement(jmiElement), "julietChangeId@capulet.example/phone"));
+
+    // the JMI is found by its new ID
+    jmi->setId("ca3cf894-5325-482f-a412-a6e9f832298d");
+    QSignalSpy ringingSpy(jmi.get(), &QXmppJingleMessageInitiation::ringing);
+    QVERIFY(m_manager.handleJmiElement(QXmppJingleMessageInitiationElement(jmiElement), "julietChangeId@capulet.example/phone"));
+    QCOMPARE(ringingSpy.count(), 1);
+    QVERIFY(!m_manager.handleJmiElement(QXmppJingleMessageInitiationElement(jmiElement), "romeo@montague.example/orchard"));
+
+    jmi->setId("989a46a6-f202-4910-a7c3-83c6ba3f3947");
+    QVERIFY(!m_manager.handleJmiElement(QXmppJingleMessageInitiationElement(jmiElement), "julietChangeId@capulet.example/phone"));
+    QCOMPARE(m_manager.jmis().size(), 1);
+
+    // the JMI is removed by its new ID
+    m_manager.clear(jmi);
+    QCOMPARE(m_manager.jmis().size(), 0);
+}
+
+void tst_QXmppJingleMessageInitiationManager::testExpiry()
+{
+    auto jmi { m_manager.addJmi("julietExpiry@capulet.example") };
+    jmi->setId("ca3cf894-5325-482f-a412-a6e9f832298d");
+    auto proceededJmi { m_manager.addJmi("romeoExpiry@montague.example") };
+    proceededJmi->setId("989a46a6-f202-4910-a7c3-83c6ba3f3947");
+    proceededJmi->setIsProceeded(true);
+
+    QSignalSpy closedSpy(jmi.get(), &QXmppJingleMessageInitiation::closed);
+    QSignalSpy proceededClosedSpy(proceededJmi.get(), &QXmppJingleMessageInitiation::closed);
+    m_manager.setExpiryTimeout(1);
+    QCOMPARE(m_manager.expiryTimeout(), 1);
+
+    // only the JMI that hasn't been proceeded expires
+    QTRY_COMPARE(closedSpy.count(), 1);
+    QVERIFY(std::holds_alternative<QXmppError>(closedSpy.constFirst().constFirst().value<Result>()));
+    QCOMPARE(m_manager.jmis().size(), 1);
+    QCOMPARE(m_manager.jmis().constFirst(), proceededJmi);
+    QCOMPARE(proceededClosedSpy.count(), 0);
+
+    m_manager.setExpiryTimeout(0);
+    m_manager.clearAll();
+}
+
 void tst_QXmppJingleMessageInitiationManager::testRing()
 {
     auto jmi { m_manager.addJmi("julietRing@capulet.example") };
@@ -0,0 +1,275 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppLogger.h"
+
+#include "util.h"
+#include <QDir>
+#include <QRegularExpression>
+#include <QTemporaryDir>
+
+static QByteArrayList readLines(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+    auto lines = file.readAll().split('\n');
+    if (!lines.isEmpty() && lines.last().isEmpty()) {
+        lines.removeLast();
+    }
+    return lines;
+}
+
+class TestLoggable : public QXmppLoggable
+{
+    Q_OBJECT
+
+public:
+    using QXmppLoggable::QXmppLoggable;
+    using QXmppLoggable::isLoggingEnabled;
+    using QXmppLoggable::setLogSink;
+    using QXmppLoggable::warning;
+};
+
+class tst_QXmppLogger : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testFileLogging_data();
+    Q_SLOT void testFileLogging();
+    Q_SLOT void testMessageTypes();
+    Q_SLOT void testDroppedMessages();
+    Q_SLOT void testRotation_data();
+    Q_SLOT void testRotation();
+    Q_SLOT void testLoggingEnabled();
+    Q_SLOT void testLogSink();
+};
+
+void tst_QXmppLogger::testFileLogging_data()
+{
+    QTest::addColumn<bool>("asynchronous");
+
+    QTest::newRow("synchronous") << false;
+    QTest::newRow("asynchronous") << true;
+}
+
+void tst_QXmppLogger::testFileLogging()
+{
+    QFETCH(bool, asynchronous);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto path = dir.filePath(QStringLiteral("test.log"));
+
+    QXmppLogger logger;
+    logger.setLogFilePath(path);
+    logger.setLoggingType(QXmppLogger::FileLogging);
+    logger.setAsynchronousFileLoggingEnabled(asynchronous);
+    QCOMPARE(logger.isAsynchronousFileLoggingEnabled(), asynchronous);
+
+    for (int i = 0; i < 1000; i++) {
+        logger.log(QXmppLogger::SentMessage, QStringLiteral("<message id='%1'/>").arg(i));
+    }
+    logger.log(QXmppLogger::ReceivedMessage, QStringLiteral("<presence>ä</presence>"));
+
+    // writes all queued messages
+    logger.reopen();
+
+    const auto lines = readLines(path);
+    QCOMPARE(lines.size(), 1001);
+    QVERIFY(lines.first().endsWith(" SENT <message id='0'/>"));
+    QVERIFY(lines.at(999).endsWith(" SENT <message id='999'/>"));
+    QVERIFY(lines.last().endsWith(QStringLiteral(" RECEIVED <presence>ä</presence>").toUtf8()));
+
+    // messages are appended after reopening
+    logger.log(QXmppLogger::WarningMessage, QStringLiteral("warning"));
+    logger.reopen();
+    QCOMPARE(readLines(path).size(), 1002);
+}
+
+void tst_QXmppLogger::testMessageTypes()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto path = dir.filePath(QStringLiteral("test.log"));
+
+    QXmppLogger logger;
+    logger.setLogFilePath(path);
+    logger.setLoggingType(QXmppLogger::FileLogging);
+    logger.setAsynchronousFileLoggingEnabled(true);
+    logger.setMessageTypes(QXmppLogger::WarningMessage);
+
+    logger.log(QXmppLogger::DebugMessage, QStringLiteral("debug"));
+    logger.log(QXmppLogger::WarningMessage, QStringLiteral("warning"));
+    logger.reopen();
+
+    const auto lines = readLines(path);
+    QCOMPARE(lines.size(), 1);
+    QVERIFY(lines.first().endsWith(" WARNING warning"));
+}
+
+void tst_QXmppLogger::testDroppedMessages()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto path = dir.filePath(QStringLiteral("test.log"));
+
+    QXmppLogger logger;
+    logger.setLogFilePath(path);
+    logger.setLoggingType(QXmppLogger::FileLogging);
+    logger.setAsynchronousFileLoggingEnabled(true);
+    logger.setMaximumQueuedMessages(1);
+    QCOMPARE(logger.maximumQueuedMessages(), 1);
+
+    const int count = 10000;
+    for (int i = 0; i < count; i++) {
+        logger.log(QXmppLogger::DebugMessage, QStringLiteral("message"));
+    }
+    logger.reopen();
+
+    // every message is either written or counted as dropped
+    static const QRegularExpression droppedRegex(QStringLiteral(" WARNING (\\d+) log messages have been dropped$"));
+    int written = 0;
+    int dropped = 0;
+    const auto lines = readLines(path);
+    for (const auto &line : lines) {
+        if (const auto match = droppedRegex.match(QString::fromUtf8(line)); match.hasMatch()) {
+            dropped += match.captured(1).toInt();
+        } else {
+            QVERIFY(line.endsWith(" DEBUG message"));
+            written++;
+        }
+    }
+    QCOMPARE(written + dropped, count);
+}
+
+void tst_QXmppLogger::testRotation_data()
+{
+    QTest::addColumn<bool>("asynchronous");
+
+    QTest::newRow("synchronous") << false;
+    QTest::newRow("asynchronous") << true;
+}
+
+void tst_QXmppLogger::testRotation()
+{
+    QFETCH(bool, asynchronous);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const auto path = dir.filePath(QStringLiteral("test.log"));
+
+    QXmppLogger logger;
+    logger.setLogFilePath(path);
+    logger.setLoggingType(QXmppLogger::FileLogging);
+    logger.setAsynchronousFileLoggingEnabled(asynchronous);
+    logger.setMaximumLogFileSize(1024);
+    QCOMPARE(logger.maximumLogFileSize(), qint64(1024));
+
+    const auto message = QString(100, QLatin1Char('a'));
+    for (int i = 0; i < 50; i++) {
+        logger.log(QXmppLogger::DebugMessage, message);
+    }
+    logger.reopen();
+
+    const auto files = QDir(dir.path()).entryList(QDir::Files);
+    QVERIFY(files.size() > 1);
+    int lines = 0;
+    for (const auto &file : files) {
+        QVERIFY(file.startsWith(QStringLiteral("test.log")));
+        QVERIFY(QFileInfo(dir.filePath(file)).size() <= 1024);
+        lines += readLines(dir.filePath(file)).size();
+    }
+    QCOMPARE(lines, 50);
+
+    logger.setLogFileRotationInterval(3600);
+    QCOMPARE(logger.logFileRotationInterval(), 3600);
+}
+
+void tst_QXmppLogger::testLoggingEnabled()
+{
+    TestLoggable loggable;
+    QVERIFY(!loggable.isLoggingEnabled(QXmppLogger::SentMessage));
+
+    QXmppLogger logger;
+    connect(&loggable, &QXmppLoggable::logMessage, &logger, &QXmppLogger::log);
+    QVERIFY(!loggable.isLoggingEnabled(QXmppLogger::SentMessage));
+
+    logger.setLoggingType(QXmppLogger::SignalLogging);
+    QVERIFY(loggable.isLoggingEnabled(QXmppLogger::SentMessage));
+    QVERIFY(loggable.isLoggingEnabled(QXmppLogger::WarningMessage));
+
+    logger.setMessageTypes(QXmppLogger::WarningMessage);
+    QVERIFY(!loggable.isLoggingEnabled(QXmppLogger::SentMessage));
+    QVERIFY(loggable.isLoggingEnabled(QXmppLogger::WarningMessage));
+
+    // the message types of all loggers are combined
+    {
+        QXmppLogger otherLogger;
+        otherLogger.setLoggingType(QXmppLogger::FileLogging);
+        otherLogger.setMessageTypes(QXmppLogger::SentMessage);
+        QVERIFY(loggable.isLoggingEnabled(QXmppLogger::SentMessage));
+    }
+    QVERIFY(!loggable.isLoggingEnabled(QXmppLogger::SentMessage));
+
+    // nothing is connected
+    disconnect(&loggable, &QXmppLoggable::logMessage, &logger, &QXmppLogger::log);
+    QVERIFY(!loggable.isLoggingEnabled(QXmppLogger::WarningMessage));
+
+    logger.setLoggingType(QXmppLogger::NoLogging);
+}
+
+void tst_QXmppLogger::testLogSink()
+{
+    QXmppLogger logger;
+    logger.setLoggingType(QXmppLogger::SignalLogging);
+    QStringList messages;
+    connect(&logger, &QXmppLogger::message, this, [&](QXmppLogger::MessageType, const QString &text) {
+        messages << text;
+    });
+
+    TestLoggable parent;
+    auto *child = new TestLoggable(&parent);
+    auto *grandChild = new TestLoggable;
+    grandChild->setParent(child);
+    QVERIFY(!grandChild->isLoggingEnabled(QXmppLogger::WarningMessage));
+
+    // messages of descendants are passed to the logger of the ancestor
+    parent.setLogSink(&logger);
+    QVERIFY(grandChild->isLoggingEnabled(QXmppLogger::WarningMessage));
+    grandChild->warning(QStringLiteral("grandchild"));
+    child->warning(QStringLiteral("child"));
+    QCOMPARE(messages, (QStringList { QStringLiteral("grandchild"), QStringLiteral("child") }));
+
+    // receivers of the signal still get the messages of the descendants
+    QStringList signalMessages;
+    connect(&parent, &QXmppLoggable::logMessage, this, [&](QXmppLogger::MessageType, const QString &text) {
+        signalMessages << text;
+    });
+    grandChild->warning(QStringLiteral("signal"));
+    QCOMPARE(signalMessages, QStringList { QStringLiteral("signal") });
+    QCOMPARE(messages.last(), QStringLiteral("signal"));
+
+    // reparented objects are not attached anymore
+    messages.clear();
+    grandChild->setParent(nullptr);
+    QVERIFY(!grandChild->isLoggingEnabled(QXmppLogger::WarningMessage));
+    grandChild->warning(QStringLiteral("detached"));
+    QVERIFY(messages.isEmpty());
+    delete grandChild;
+
+    // the sink is cleared when the logger is deleted
+    {
+        QXmppLogger otherLogger;
+        otherLogger.setLoggingType(QXmppLogger::SignalLogging);
+        child->setLogSink(&otherLogger);
+    }
+    child->warning(QStringLiteral("after deletion"));
+    QCOMPARE(messages, QStringList { QStringLiteral("after deletion") });
+}
+
+QTEST_MAIN(tst_QXmppLogger)
+#include "tst_qxmpplogger.moc"
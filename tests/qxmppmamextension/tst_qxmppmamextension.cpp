@@ -0,0 +1,236 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppArchiveLog_p.h"
+#include "QXmppClient.h"
+#include "QXmppMamExtension.h"
+#include "QXmppMamManager.h"
+#include "QXmppMessage.h"
+#include "QXmppServer.h"
+
+#include "util.h"
+
+#include <QDir>
+#include <QDomDocument>
+#include <QFile>
+#include <QTemporaryDir>
+
+using namespace QXmpp::Private;
+
+class tst_QXmppMamExtension : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testArchiveLog();
+    Q_SLOT void testTornRecord();
+    Q_SLOT void testQueries();
+};
+
+static QStringList recordIds(const ArchiveLog::Page &page)
+{
+    QStringList ids;
+    for (const auto &record : page.records) {
+        ids << QString::number(record.id);
+    }
+    return ids;
+}
+
+void tst_QXmppMamExtension::testArchiveLog()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    {
+        ArchiveLog log(dir.path(), 4096);
+        QVERIFY(log.open());
+        // every third message is with carol, one message per second
+        for (int i = 1; i <= 200; ++i) {
+            const auto with = i % 3 == 0 ? QStringLiteral("carol@localhost/phone") : QStringLiteral("alice@remote.example/home");
+            QCOMPARE(log.append(i * 1000, with, QByteArray(40, 'x')), quint64(i));
+        }
+        // the segments are started at the record boundaries
+        QVERIFY(log.segmentCount() > 1);
+
+        ArchiveLog::Query query;
+        query.max = 10;
+        auto page = log.query(query);
+        QCOMPARE(page.records.size(), 10);
+        QCOMPARE(page.records.first().id, quint64(1));
+        QVERIFY(!page.complete);
+
+        // the next page
+        query.after = page.records.last().id;
+        page = log.query(query);
+        QCOMPARE(page.records.first().id, quint64(11));
+
+        // the last page
+        query.after = 0;
+        query.before = log.lastId() + 1;
+        page = log.query(query);
+        QCOMPARE(page.records.first().id, quint64(191));
+        QCOMPARE(page.records.last().id, quint64(200));
+        QVERIFY(!page.complete);
+
+        // the page before an ID, across the index entries
+        query.before = 40;
+        page = log.query(query);
+        QCOMPARE(page.records.first().id, quint64(30));
+        QCOMPARE(page.records.last().id, quint64(39));
+
+        query.before = 5;
+        page = log.query(query);
+        QCOMPARE(recordIds(page), QStringList({ QStringLiteral("1"), QStringLiteral("2"), QStringLiteral("3"), QStringLiteral("4") }));
+        QVERIFY(page.complete);
+
+        // bare JIDs match all resources
+        query = {};
+        query.with = QStringLiteral("carol@localhost");
+        query.start = 100 * 1000;
+        query.end = 112 * 1000;
+        page = log.query(query);
+        QCOMPARE(recordIds(page), QStringList({ QStringLiteral("102"), QStringLiteral("105"), QStringLiteral("108"), QStringLiteral("111") }));
+        QVERIFY(page.complete);
+
+        query.with = QStringLiteral("carol@localhost/tablet");
+        QVERIFY(log.query(query).records.isEmpty());
+
+        query.with = QStringLiteral("carol@localhost");
+        query.before = log.lastId() + 1;
+        query.max = 2;
+        page = log.query(query);
+        QCOMPARE(recordIds(page), QStringList({ QStringLiteral("108"), QStringLiteral("111") }));
+        QVERIFY(!page.complete);
+
+        // timestamps never decrease
+        QCOMPARE(log.append(0, QStringLiteral("alice@remote.example"), QByteArray("late")), quint64(201));
+        query = {};
+        query.start = 200 * 1000;
+        QCOMPARE(recordIds(log.query(query)), QStringList({ QStringLiteral("200"), QStringLiteral("201") }));
+    }
+
+    // the index is rebuilt from the segments
+    ArchiveLog log(dir.path(), 4096);
+    QVERIFY(log.open());
+    QCOMPARE(log.lastId(), quint64(201));
+    ArchiveLog::Query query;
+    query.after = 150;
+    query.max = 1;
+    const auto page = log.query(query);
+    QCOMPARE(page.records.first().id, quint64(151));
+    QCOMPARE(page.records.first().timestamp, qint64(151 * 1000));
+    QCOMPARE(page.records.first().with, QStringLiteral("alice@remote.example/home"));
+    QCOMPARE(page.records.first().payload, QByteArray(40, 'x'));
+    QCOMPARE(log.append(202 * 1000, QStringLiteral("alice@remote.example/home"), QByteArray("new")), quint64(202));
+}
+
+void tst_QXmppMamExtension::testTornRecord()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    {
+        ArchiveLog log(dir.path(), 1024 * 1024);
+        QVERIFY(log.open());
+        log.append(1000, QStringLiteral("alice@remote.example"), QByteArray("one"));
+        log.append(2000, QStringLiteral("alice@remote.example"), QByteArray("two"));
+        QVERIFY(log.commit());
+    }
+
+    // a crash while writing the third record
+    const auto files = QDir(dir.path()).entryList({ QStringLiteral("*.seg") }, QDir::Files);
+    QCOMPARE(files.size(), 1);
+    QFile file(QDir(dir.path()).filePath(files.first()));
+    QVERIFY(file.open(QIODevice::Append));
+    file.write(QByteArray::fromHex("40000000deadbeef0300"));
+    file.close();
+
+    ArchiveLog log(dir.path(), 1024 * 1024);
+    QVERIFY(log.open());
+    QCOMPARE(log.lastId(), quint64(2));
+    QCOMPARE(log.append(3000, QStringLiteral("alice@remote.example"), QByteArray("three")), quint64(3));
+    QCOMPARE(log.query({}).records.size(), 3);
+}
+
+void tst_QXmppMamExtension::testQueries()
+{
+    const QString testDomain("localhost");
+    const QHostAddress testHost(QHostAddress::LocalHost);
+    const quint16 testPort = 12352;
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+
+    TestPasswordChecker passwordChecker;
+    passwordChecker.addCredentials("bob", "testpwd");
+
+    auto *mam = new QXmppMamExtension;
+    mam->setArchiveDirectory(dir.path());
+    mam->setMaximumPageSize(2);
+
+    QXmppServer server;
+    server.setDomain(testDomain);
+    server.setPasswordChecker(&passwordChecker);
+    server.addExtension(mam);
+    QVERIFY(server.listenForClients(testHost, testPort));
+
+    const auto element = [](const QString &xml) {
+        QDomDocument doc;
+        doc.setContent(xml, true);
+        return doc.documentElement();
+    };
+
+    // group chat messages, messages without body and messages not to be
+    // stored are not archived
+    for (const auto &body : { "one", "two", "three" }) {
+        server.handleElement(element(QStringLiteral("<message xmlns='jabber:client' from='alice@remote.example/home' to='bob@localhost/phone' type='chat'><body>%1</body></message>").arg(QLatin1String(body))));
+    }
+    server.handleElement(element(QStringLiteral("<message xmlns='jabber:client' from='room@muc.remote.example/alice' to='bob@localhost/phone' type='groupchat'><body>hello</body></message>")));
+    server.handleElement(element(QStringLiteral("<message xmlns='jabber:client' from='alice@remote.example/home' to='bob@localhost/phone' type='chat'><composing xmlns='http://jabber.org/protocol/chatstates'/></message>")));
+    server.handleElement(element(QStringLiteral("<message xmlns='jabber:client' from='alice@remote.example/home' to='bob@localhost/phone' type='chat'><body>secret</body><no-store xmlns='urn:xmpp:hints'/></message>")));
+    QCOMPARE(mam->messageCount(QStringLiteral("bob@localhost")), quint64(3));
+    QCOMPARE(mam->messageCount(QStringLiteral("alice@remote.example")), quint64(0));
+
+    auto *manager = new QXmppMamManager;
+    QXmppClient bob;
+    bob.addExtension(manager);
+
+    QXmppConfiguration config;
+    config.setDomain(testDomain);
+    config.setHost(testHost.toString());
+    config.setPort(testPort);
+    config.setUser("bob");
+    config.setPassword("testpwd");
+    bob.connectToServer(config);
+    QTRY_VERIFY(bob.isConnected());
+
+    // the page size is limited by the server
+    auto task = manager->retrieveMessages();
+    QTRY_VERIFY(task.isFinished());
+    auto retrieved = expectFutureVariant<QXmppMamManager::RetrievedMessages>(task);
+    QCOMPARE(retrieved.messages.size(), 2);
+    QCOMPARE(retrieved.messages.at(0).body(), QStringLiteral("one"));
+    QCOMPARE(retrieved.messages.at(0).from(), QStringLiteral("alice@remote.example/home"));
+    QCOMPARE(retrieved.messages.at(0).stanzaId(), QStringLiteral("1"));
+    QVERIFY(retrieved.messages.at(0).stamp().isValid());
+    QCOMPARE(retrieved.messages.at(1).body(), QStringLiteral("two"));
+    QVERIFY(!retrieved.result.complete());
+
+    QXmppResultSetQuery resultSet;
+    resultSet.setAfter(retrieved.result.resultSetReply().last());
+    task = manager->retrieveMessages({}, {}, QStringLiteral("alice@remote.example"), {}, {}, resultSet);
+    QTRY_VERIFY(task.isFinished());
+    retrieved = expectFutureVariant<QXmppMamManager::RetrievedMessages>(task);
+    QCOMPARE(retrieved.messages.size(), 1);
+    QCOMPARE(retrieved.messages.at(0).body(), QStringLiteral("three"));
+    QVERIFY(retrieved.result.complete());
+
+    // unknown archive IDs
+    resultSet.setAfter(QStringLiteral("42"));
+    task = manager->retrieveMessages({}, {}, {}, {}, {}, resultSet);
+    QTRY_VERIFY(task.isFinished());
+    expectFutureVariant<QXmppError>(task);
+}
+
+QTEST_MAIN(tst_QXmppMamExtension)
+#include "tst_qxmppmamextension.moc"
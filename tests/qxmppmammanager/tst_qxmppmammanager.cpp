@@ -4,7 +4,9 @@
 
 #include "QXmppMamManager.h"
 #include "QXmppMessage.h"
+#include "QXmppMessageArchiveMemoryStorage.h"
 
+#include "TestClient.h"
 #include "util.h"
 #include <QObject>
 
@@ -39,6 +41,11 @@ private:
     Q_SLOT void testHandleResultIq_data();
     Q_SLOT void testHandleResultIq();
 
+    Q_SLOT void testStreamMessages();
+    Q_SLOT void testSynchronizeArchive();
+    Q_SLOT void testLoadArchivedMessages();
+    Q_SLOT void testArchiveMemoryStorage();
+
     QXmppMamTestHelper m_helper;
     QXmppMamManager m_manager;
 };
@@ -247,5 +254,262 @@ void QXmppMamTestHelper::compareResultSetReplys(const QXmppResultSetReply &lhs,
     QCOMPARE(lhs.isNull(), rhs.isNull());
 }
 
+static QString mamResultMessage(const QString &queryId, const QString &id, const QString &body)
+{
+    return QStringLiteral(
+               "<message to='juliet@capulet.lit/chamber'>"
+               "<result xmlns='urn:xmpp:mam:2' queryid='%1' id='%2'>"
+               "<forwarded xmlns='urn:xmpp:forward:0'>"
+               "<message xmlns='jabber:client' from='romeo@montague.lit/orchard' type='chat'><body>%3</body></message>"
+               "</forwarded>"
+               "</result>"
+               "</message>")
+        .arg(queryId, id, body);
+}
+
+void tst_QXmppMamManager::testStreamMessages()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppMamManager>();
+
+    QStringList bodies;
+    auto task = manager->streamMessages([&](QXmppMessage &&message) {
+        bodies << message.body();
+    },
+                                        {}, {}, {}, {}, {}, 2);
+
+    // first page
+    QXmppMamQueryIq query;
+    parsePacket(query, test.takePacket().toUtf8());
+    QCOMPARE(query.resultSetQuery().max(), 2);
+    QVERIFY(query.resultSetQuery().after().isNull());
+
+    QVERIFY(manager->handleStanza(xmlToDom(mamResultMessage(query.queryId(), QStringLiteral("a1"), QStringLiteral("one")))));
+    // messages are delivered immediately
+    QCOMPARE(bodies, QStringList { QStringLiteral("one") });
+    QVERIFY(manager->handleStanza(xmlToDom(mamResultMessage(query.queryId(), QStringLiteral("a2"), QStringLiteral("two")))));
+    test.inject(QStringLiteral("<iq id='%1' type='result'><fin xmlns='urn:xmpp:mam:2'>"
+                               "<set xmlns='http://jabber.org/protocol/rsm'><first>a1</first><last>a2</last></set>"
+                               "</fin></iq>")
+                    .arg(query.id()));
+    QVERIFY(!task.isFinished());
+
+    // the next page is requested automatically
+    parsePacket(query, test.takePacket().toUtf8());
+    QCOMPARE(query.resultSetQuery().after(), QStringLiteral("a2"));
+
+    QVERIFY(manager->handleStanza(xmlToDom(mamResultMessage(query.queryId(), QStringLiteral("a3"), QStringLiteral("three")))));
+    test.inject(QStringLiteral("<iq id='%1' type='result'><fin xmlns='urn:xmpp:mam:2' complete='true'>"
+                               "<set xmlns='http://jabber.org/protocol/rsm'><first>a3</first><last>a3</last></set>"
+                               "</fin></iq>")
+                    .arg(query.id()));
+
+    QVERIFY(task.isFinished());
+    const auto reply = expectFutureVariant<QXmppResultSetReply>(task);
+    QCOMPARE(reply.last(), QStringLiteral("a3"));
+    QCOMPARE(bodies, (QStringList { QStringLiteral("one"), QStringLiteral("two"), QStringLiteral("three") }));
+    test.expectNoPacket();
+}
+
+// archived message with a stamp at 12:<minute>
+static QString mamResultMessage(const QString &queryId, const QString &id, const QString &body, int minute)
+{
+    return QStringLiteral(
+               "<message to='juliet@capulet.lit/chamber'>"
+               "<result xmlns='urn:xmpp:mam:2' queryid='%1' id='%2'>"
+               "<forwarded xmlns='urn:xmpp:forward:0'>"
+               "<delay xmlns='urn:xmpp:delay' stamp='2026-01-01T12:%4:00Z'/>"
+               "<message xmlns='jabber:client' from='romeo@montague.lit/orchard' type='chat'><body>%3</body></message>"
+               "</forwarded>"
+               "</result>"
+               "</message>")
+        .arg(queryId, id, body, QStringLiteral("%1").arg(minute, 2, 10, QLatin1Char('0')));
+}
+
+static QStringList bodies(const QVector<QXmppMessage> &messages)
+{
+    QStringList bodies;
+    for (const auto &message : messages) {
+        bodies << message.body();
+    }
+    return bodies;
+}
+
+static QString mamFin(const QString &id, const QString &first, const QString &last, bool complete)
+{
+    return QStringLiteral("<iq id='%1' type='result'><fin xmlns='urn:xmpp:mam:2' complete='%4'>"
+                          "<set xmlns='http://jabber.org/protocol/rsm'><first>%2</first><last>%3</last></set>"
+                          "</fin></iq>")
+        .arg(id, first, last, complete ? QStringLiteral("true") : QStringLiteral("false"));
+}
+
+void tst_QXmppMamManager::testSynchronizeArchive()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppMamManager>();
+    const auto romeo = QStringLiteral("romeo@montague.lit");
+
+    // no storage
+    auto task = manager->synchronizeArchive(romeo);
+    QVERIFY(task.isFinished());
+    expectFutureVariant<QXmppError>(task);
+
+    QXmppMessageArchiveMemoryStorage storage;
+    manager->setArchiveStorage(&storage);
+
+    // nothing stored: only the last page is fetched
+    task = manager->synchronizeArchive(romeo, {}, 2);
+    auto packet = test.takePacket();
+    QVERIFY(packet.contains(QStringLiteral("<before/>")));
+    QXmppMamQueryIq query;
+    parsePacket(query, packet.toUtf8());
+    QCOMPARE(query.resultSetQuery().max(), 2);
+
+    QVERIFY(manager->handleStanza(xmlToDom(mamResultMessage(query.queryId(), QStringLiteral("a2"), QStringLiteral("two"), 2))));
+    QVERIFY(manager->handleStanza(xmlToDom(mamResultMessage(query.queryId(), QStringLiteral("a3"), QStringLiteral("three"), 3))));
+    test.inject(mamFin(query.id(), QStringLiteral("a2"), QStringLiteral("a3"), false));
+
+    QVERIFY(task.isFinished());
+    QCOMPARE(bodies(expectFutureVariant<QVector<QXmppMessage>>(task)), (QStringList { QStringLiteral("two"), QStringLiteral("three") }));
+    test.expectNoPacket();
+
+    auto last = storage.lastMessage(romeo);
+    QVERIFY(last.isFinished());
+    QCOMPARE(last.result()->stanzaId(), QStringLiteral("a3"));
+
+    // the gap since the last stored message is filled page by page
+    task = manager->synchronizeArchive(romeo, {}, 2);
+    parsePacket(query, test.takePacket().toUtf8());
+    QCOMPARE(query.resultSetQuery().after(), QStringLiteral("a3"));
+    QVERIFY(manager->handleStanza(xmlToDom(mamResultMessage(query.queryId(), QStringLiteral("a4"), QStringLiteral("four"), 4))));
+    QVERIFY(manager->handleStanza(xmlToDom(mamResultMessage(query.queryId(), QStringLiteral("a5"), QStringLiteral("five"), 5))));
+    test.inject(mamFin(query.id(), QStringLiteral("a4"), QStringLiteral("a5"), false));
+    QVERIFY(!task.isFinished());
+
+    parsePacket(query, test.takePacket().toUtf8());
+    QCOMPARE(query.resultSetQuery().after(), QStringLiteral("a5"));
+    QVERIFY(manager->handleStanza(xmlToDom(mamResultMessage(query.queryId(), QStringLiteral("a6"), QStringLiteral("six"), 6))));
+    test.inject(mamFin(query.id(), QStringLiteral("a6"), QStringLiteral("a6"), true));
+
+    QVERIFY(task.isFinished());
+    QCOMPARE(bodies(expectFutureVariant<QVector<QXmppMessage>>(task)), (QStringList { QStringLiteral("four"), QStringLiteral("five"), QStringLiteral("six") }));
+    test.expectNoPacket();
+
+    QXmppMessageArchiveStorage::Query all;
+    auto stored = storage.messages(romeo, all);
+    QCOMPARE(bodies(stored.result()).size(), 5);
+}
+
+void tst_QXmppMamManager::testLoadArchivedMessages()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppMamManager>();
+    const auto romeo = QStringLiteral("romeo@montague.lit");
+
+    QXmppMessageArchiveMemoryStorage storage;
+    manager->setArchiveStorage(&storage);
+
+    QVector<QXmppMessage> messages;
+    for (int i = 3; i <= 5; i++) {
+        QXmppMessage message;
+        message.setStanzaId(QStringLiteral("a%1").arg(i));
+        message.setStamp(QDateTime(QDate(2026, 1, 1), QTime(12, i), Qt::UTC));
+        message.setBody(message.stanzaId());
+        messages << message;
+    }
+    storage.addMessages(romeo, messages);
+
+    // stored messages are returned without querying the server
+    auto task = manager->loadArchivedMessages(romeo, {}, 2);
+    QVERIFY(task.isFinished());
+    QCOMPARE(bodies(expectFutureVariant<QVector<QXmppMessage>>(task)), (QStringList { QStringLiteral("a4"), QStringLiteral("a5") }));
+    test.expectNoPacket();
+
+    // missing older messages are fetched and stored
+    task = manager->loadArchivedMessages(romeo, QStringLiteral("a4"), 3);
+    QVERIFY(!task.isFinished());
+    QXmppMamQueryIq query;
+    parsePacket(query, test.takePacket().toUtf8());
+    QCOMPARE(query.resultSetQuery().before(), QStringLiteral("a3"));
+    QCOMPARE(query.resultSetQuery().max(), 2);
+
+    QVERIFY(manager->handleStanza(xmlToDom(mamResultMessage(query.queryId(), QStringLiteral("a1"), QStringLiteral("a1"), 1))));
+    QVERIFY(manager->handleStanza(xmlToDom(mamResultMessage(query.queryId(), QStringLiteral("a2"), QStringLiteral("a2"), 2))));
+    test.inject(mamFin(query.id(), QStringLiteral("a1"), QStringLiteral("a2"), false));
+
+    QVERIFY(task.isFinished());
+    QCOMPARE(bodies(expectFutureVariant<QVector<QXmppMessage>>(task)), (QStringList { QStringLiteral("a1"), QStringLiteral("a2"), QStringLiteral("a3") }));
+
+    auto first = storage.firstMessage(romeo);
+    QCOMPARE(first.result()->stanzaId(), QStringLiteral("a1"));
+    test.expectNoPacket();
+}
+
+void tst_QXmppMamManager::testArchiveMemoryStorage()
+{
+    const auto romeo = QStringLiteral("romeo@montague.lit");
+    const auto start = QDateTime(QDate(2026, 1, 1), QTime(12, 0), Qt::UTC);
+    const auto message = [&](const QString &id, int minutes, const QString &body) {
+        QXmppMessage message;
+        message.setStanzaId(id);
+        message.setStamp(start.addSecs(minutes * 60));
+        message.setBody(body);
+        return message;
+    };
+
+    QXmppMessageArchiveMemoryStorage storage;
+    // added out of order and twice
+    storage.addMessages(romeo, { message(QStringLiteral("b"), 2, QStringLiteral("Wherefore art thou?")), message(QStringLiteral("c"), 3, QStringLiteral("Deny thy father")) });
+    storage.addMessages(romeo, { message(QStringLiteral("a"), 1, QStringLiteral("O Romeo, Romeo!")), message(QStringLiteral("b"), 2, QStringLiteral("duplicate")) });
+    storage.addMessages(romeo, { QXmppMessage() });
+
+    const auto query = [&](const QXmppMessageArchiveStorage::Query &query) {
+        auto task = storage.messages(romeo, query);
+        return bodies(task.result());
+    };
+
+    QXmppMessageArchiveStorage::Query filter;
+    QCOMPARE(query(filter), (QStringList { QStringLiteral("O Romeo, Romeo!"), QStringLiteral("Wherefore art thou?"), QStringLiteral("Deny thy father") }));
+
+    // time range
+    filter.start = start.addSecs(120);
+    filter.end = start.addSecs(180);
+    QCOMPARE(query(filter), (QStringList { QStringLiteral("Wherefore art thou?"), QStringLiteral("Deny thy father") }));
+    filter.end = start.addSecs(150);
+    QCOMPARE(query(filter), QStringList { QStringLiteral("Wherefore art thou?") });
+
+    // pages
+    filter = {};
+    filter.resultSetQuery.setAfter(QStringLiteral("a"));
+    filter.resultSetQuery.setMax(1);
+    QCOMPARE(query(filter), QStringList { QStringLiteral("Wherefore art thou?") });
+    filter = {};
+    filter.resultSetQuery.setBefore(QStringLiteral("c"));
+    QCOMPARE(query(filter), (QStringList { QStringLiteral("O Romeo, Romeo!"), QStringLiteral("Wherefore art thou?") }));
+    filter.resultSetQuery.setMax(1);
+    QCOMPARE(query(filter), QStringList { QStringLiteral("Wherefore art thou?") });
+    filter.resultSetQuery.setBefore(QStringLiteral("unknown"));
+    QVERIFY(query(filter).isEmpty());
+
+    // full-text search with and without index
+    for (bool indexed : { false, true }) {
+        storage.setFullTextIndexEnabled(indexed);
+        filter = {};
+        filter.text = QStringLiteral("romeo");
+        QCOMPARE(query(filter), QStringList { QStringLiteral("O Romeo, Romeo!") });
+        filter.text = QStringLiteral("thy FATHER");
+        QCOMPARE(query(filter), QStringList { QStringLiteral("Deny thy father") });
+        filter.text = QStringLiteral("thy mother");
+        QVERIFY(query(filter).isEmpty());
+    }
+    storage.addMessages(romeo, { message(QStringLiteral("d"), 4, QStringLiteral("Romeo, doff thy name")) });
+    filter.text = QStringLiteral("romeo");
+    QCOMPARE(query(filter).size(), 2);
+
+    QCOMPARE(storage.lastMessage(romeo).result()->stanzaId(), QStringLiteral("d"));
+    storage.removeConversation(romeo);
+    QVERIFY(!storage.firstMessage(romeo).result().has_value());
+}
+
 QTEST_MAIN(tst_QXmppMamManager)
 #include "tst_qxmppmammanager.moc"
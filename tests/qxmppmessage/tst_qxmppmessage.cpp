@@ -61,6 +61,7 @@ private:
     Q_SLOT void testFileSharing();
     Q_SLOT void testEncryptedFileSource();
     Q_SLOT void testJingleMessageInitiationElement();
+    Q_SLOT void testParsedNamespaces();
 };
 
 void tst_QXmppMessage::testBasic_data()
@@ -1309,5 +1310,38 @@ void tst_QXmppMessage::testJingleMessageInitiationElement()
     QVERIFY(message2.jingleMessageInitiationElement());
 }
 
+void tst_QXmppMessage::testParsedNamespaces()
+{
+    const QByteArray xml(
+        "<message to=\"foo@example.com/QXmpp\" from=\"bar@example.com/QXmpp\" type=\"chat\">"
+        "<body>Hi!</body>"
+        "<thread>thread1</thread>"
+        "<active xmlns=\"http://jabber.org/protocol/chatstates\"/>"
+        "<request xmlns=\"urn:xmpp:receipts\"/>"
+        "<markable xmlns=\"urn:xmpp:chat-markers:0\"/>"
+        "</message>");
+
+    QXmppMessage message;
+    message.parse(xmlToDom(xml), QXmpp::SceAll, { QStringLiteral("http://jabber.org/protocol/chatstates") });
+    QCOMPARE(message.type(), QXmppMessage::Chat);
+    QCOMPARE(message.body(), QStringLiteral("Hi!"));
+    QCOMPARE(message.thread(), QStringLiteral("thread1"));
+    QCOMPARE(message.state(), QXmppMessage::Active);
+    QVERIFY(!message.isReceiptRequested());
+    QVERIFY(!message.isMarkable());
+
+    // the other extensions are kept unparsed
+    const auto extensions = message.extensions();
+    QCOMPARE(extensions.size(), 2);
+    QCOMPARE(extensions.at(0).tagName(), QStringLiteral("request"));
+    QCOMPARE(extensions.at(1).tagName(), QStringLiteral("markable"));
+
+    // the filter is not used for later parsing
+    message.parse(xmlToDom(xml));
+    QVERIFY(message.isReceiptRequested());
+    QVERIFY(message.isMarkable());
+    QVERIFY(message.extensions().isEmpty());
+}
+
 QTEST_MAIN(tst_QXmppMessage)
 #include "tst_qxmppmessage.moc"
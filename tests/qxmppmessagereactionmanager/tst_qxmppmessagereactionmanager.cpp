@@ -0,0 +1,111 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppMessage.h"
+#include "QXmppMessageReaction.h"
+#include "QXmppMessageReactionManager.h"
+
+#include "TestClient.h"
+#include "util.h"
+
+#include <QSignalSpy>
+
+class tst_QXmppMessageReactionManager : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testCounts();
+    Q_SLOT void testConversations();
+};
+
+static QXmppMessage reactionMessage(const QString &from, const QString &to, QXmppMessage::Type type, const QString &messageId, const QVector<QString> &emojis)
+{
+    QXmppMessageReaction reaction;
+    reaction.setMessageId(messageId);
+    reaction.setEmojis(emojis);
+
+    QXmppMessage message;
+    message.setFrom(from);
+    message.setTo(to);
+    message.setType(type);
+    message.setReaction(reaction);
+    return message;
+}
+
+void tst_QXmppMessageReactionManager::testCounts()
+{
+    const QString room = QStringLiteral("coven@chat.shakespeare.lit");
+
+    TestClient client;
+    auto *manager = client.addNewExtension<QXmppMessageReactionManager>();
+    QSignalSpy changedSpy(manager, &QXmppMessageReactionManager::reactionsChanged);
+
+    // the message is passed on to the other handlers
+    QVERIFY(!manager->handleMessage(reactionMessage(room + QStringLiteral("/firstwitch"), {}, QXmppMessage::GroupChat, QStringLiteral("1"), { QStringLiteral("👍"), QStringLiteral("🐢"), QStringLiteral("👍") })));
+    manager->handleMessage(reactionMessage(room + QStringLiteral("/secondwitch"), {}, QXmppMessage::GroupChat, QStringLiteral("1"), { QStringLiteral("👍") }));
+
+    auto counts = manager->reactionCounts(room, QStringLiteral("1"));
+    QCOMPARE(counts.size(), 2);
+    QCOMPARE(counts.value(QStringLiteral("👍")), 2);
+    QCOMPARE(counts.value(QStringLiteral("🐢")), 1);
+    QCOMPARE(manager->reactions(room, QStringLiteral("1"), room + QStringLiteral("/firstwitch")), QVector<QString>({ QStringLiteral("👍"), QStringLiteral("🐢") }));
+    QCOMPARE(manager->senders(room, QStringLiteral("1"), QStringLiteral("🐢")), QVector<QString> { room + QStringLiteral("/firstwitch") });
+    QCOMPARE(changedSpy.size(), 2);
+
+    // a reaction replaces the previous ones of the sender
+    changedSpy.clear();
+    manager->handleMessage(reactionMessage(room + QStringLiteral("/firstwitch"), {}, QXmppMessage::GroupChat, QStringLiteral("1"), { QStringLiteral("🐢"), QStringLiteral("❤") }));
+    QCOMPARE(changedSpy.size(), 1);
+    const auto arguments = changedSpy.takeFirst();
+    QCOMPARE(arguments.at(0).toString(), room);
+    QCOMPARE(arguments.at(1).toString(), QStringLiteral("1"));
+    QCOMPARE(arguments.at(2).toString(), room + QStringLiteral("/firstwitch"));
+    QCOMPARE(arguments.at(3).value<QVector<QString>>(), QVector<QString> { QStringLiteral("❤") });
+    QCOMPARE(arguments.at(4).value<QVector<QString>>(), QVector<QString> { QStringLiteral("👍") });
+
+    counts = manager->reactionCounts(room, QStringLiteral("1"));
+    QCOMPARE(counts.value(QStringLiteral("👍")), 1);
+    QCOMPARE(counts.value(QStringLiteral("🐢")), 1);
+    QCOMPARE(counts.value(QStringLiteral("❤")), 1);
+
+    // the same reactions again don't change anything
+    manager->handleMessage(reactionMessage(room + QStringLiteral("/firstwitch"), {}, QXmppMessage::GroupChat, QStringLiteral("1"), { QStringLiteral("❤"), QStringLiteral("🐢") }));
+    QCOMPARE(changedSpy.size(), 0);
+
+    // removing all reactions
+    manager->handleMessage(reactionMessage(room + QStringLiteral("/firstwitch"), {}, QXmppMessage::GroupChat, QStringLiteral("1"), {}));
+    manager->handleMessage(reactionMessage(room + QStringLiteral("/secondwitch"), {}, QXmppMessage::GroupChat, QStringLiteral("1"), {}));
+    QCOMPARE(changedSpy.size(), 2);
+    QVERIFY(manager->reactionCounts(room, QStringLiteral("1")).isEmpty());
+    QVERIFY(manager->reactions(room, QStringLiteral("1"), room + QStringLiteral("/firstwitch")).isEmpty());
+}
+
+void tst_QXmppMessageReactionManager::testConversations()
+{
+    TestClient client;
+    client.configuration().setJid(QStringLiteral("romeo@montague.example/orchard"));
+    auto *manager = client.addNewExtension<QXmppMessageReactionManager>();
+
+    const QString romeo = QStringLiteral("romeo@montague.example");
+    const QString juliet = QStringLiteral("juliet@capulet.example");
+
+    manager->handleMessage(reactionMessage(juliet + QStringLiteral("/balcony"), romeo, QXmppMessage::Chat, QStringLiteral("a"), { QStringLiteral("❤") }));
+    // sent from another device of the account
+    manager->handleMessage(reactionMessage(romeo + QStringLiteral("/garden"), juliet, QXmppMessage::Chat, QStringLiteral("a"), { QStringLiteral("❤") }));
+
+    QCOMPARE(manager->reactionCounts(juliet, QStringLiteral("a")).value(QStringLiteral("❤")), 2);
+    QCOMPARE(manager->senders(juliet, QStringLiteral("a"), QStringLiteral("❤")).size(), 2);
+    QVERIFY(manager->reactionCounts(romeo, QStringLiteral("a")).isEmpty());
+
+    // errors are ignored
+    manager->handleMessage(reactionMessage(QStringLiteral("tybalt@capulet.example"), romeo, QXmppMessage::Error, QStringLiteral("b"), { QStringLiteral("👎") }));
+    QVERIFY(manager->reactionCounts(QStringLiteral("tybalt@capulet.example"), QStringLiteral("b")).isEmpty());
+
+    manager->clear(juliet);
+    QVERIFY(manager->reactionCounts(juliet, QStringLiteral("a")).isEmpty());
+}
+
+QTEST_MAIN(tst_QXmppMessageReactionManager)
+#include "tst_qxmppmessagereactionmanager.moc"
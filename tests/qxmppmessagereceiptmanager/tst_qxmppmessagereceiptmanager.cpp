@@ -3,8 +3,10 @@
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
 #include "QXmppClient.h"
+#include "QXmppMessage.h"
 #include "QXmppMessageReceiptManager.h"
 
+#include "TestClient.h"
 #include "util.h"
 #include <QObject>
 
@@ -17,6 +19,7 @@ private:
 
     Q_SLOT void testReceipt_data();
     Q_SLOT void testReceipt();
+    Q_SLOT void testAggregation();
 
     void handleMessageDelivered(const QString &, const QString &)
     {
@@ -172,5 +175,66 @@ void tst_QXmppMessageReceiptManager::testReceipt()
     QCOMPARE(m_receiptSent, sent);
 }
 
+void tst_QXmppMessageReceiptManager::testAggregation()
+{
+    TestClient client;
+    auto *manager = client.addNewExtension<QXmppMessageReceiptManager>();
+    manager->setAggregationDelay(10);
+
+    auto message = [](const QString &from, const QString &id, bool markable) {
+        QXmppMessage message;
+        message.setFrom(from);
+        message.setId(id);
+        message.setType(QXmppMessage::Chat);
+        message.setReceiptRequested(true);
+        message.setMarkable(markable);
+        return message;
+    };
+    auto takeMessages = [&client](int count) {
+        QMap<QString, QXmppMessage> messages;
+        for (int i = 0; i < count; i++) {
+            QXmppMessage message;
+            parsePacket(message, client.takePacket().toUtf8());
+            messages.insert(message.markerId().isEmpty() ? message.receiptId() : message.markerId(), message);
+        }
+        client.expectNoPacket();
+        return messages;
+    };
+
+    QVERIFY(!manager->handleMessage(message("romeo@montague.lit/orchard", "1", true)));
+    QVERIFY(!manager->handleMessage(message("romeo@montague.lit/orchard", "2", true)));
+    QVERIFY(!manager->handleMessage(message("romeo@montague.lit/orchard", "3", false)));
+    QVERIFY(!manager->handleMessage(message("juliet@capulet.lit/balcony", "a", true)));
+    client.expectNoPacket();
+
+    QTest::qWait(50);
+    auto messages = takeMessages(3);
+    QCOMPARE(messages.keys(), QList<QString>({ "2", "3", "a" }));
+    QCOMPARE(messages["2"].to(), QStringLiteral("romeo@montague.lit/orchard"));
+    QCOMPARE(messages["2"].marker(), QXmppMessage::Received);
+    QCOMPARE(messages["2"].receiptId(), QStringLiteral("2"));
+    QCOMPARE(messages["3"].marker(), QXmppMessage::NoMarker);
+    QCOMPARE(messages["3"].receiptId(), QStringLiteral("3"));
+    QCOMPARE(messages["a"].to(), QStringLiteral("juliet@capulet.lit/balcony"));
+    QCOMPARE(messages["a"].marker(), QXmppMessage::Received);
+
+    // the displayed marker replaces the received marker of the same message
+    QVERIFY(!manager->handleMessage(message("romeo@montague.lit/orchard", "4", true)));
+    manager->markAsDisplayed(message("romeo@montague.lit/orchard", "4", true));
+    manager->markAsDisplayed(message("juliet@capulet.lit/balcony", "b", false));
+
+    QTest::qWait(50);
+    messages = takeMessages(1);
+    QCOMPARE(messages["4"].marker(), QXmppMessage::Displayed);
+    QCOMPARE(messages["4"].receiptId(), QStringLiteral("4"));
+
+    // without aggregation, markers are sent immediately
+    manager->setAggregationDelay(0);
+    manager->markAsDisplayed(message("juliet@capulet.lit/balcony", "c", true));
+    messages = takeMessages(1);
+    QCOMPARE(messages["c"].marker(), QXmppMessage::Displayed);
+    QVERIFY(messages["c"].receiptId().isEmpty());
+}
+
 QTEST_MAIN(tst_QXmppMessageReceiptManager)
 #include "tst_qxmppmessagereceiptmanager.moc"
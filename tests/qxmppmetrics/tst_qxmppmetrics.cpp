@@ -0,0 +1,136 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppMetrics.h"
+
+#include "util.h"
+#include <thread>
+#include <vector>
+
+class tst_QXmppMetrics : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void init();
+    Q_SLOT void testCounters();
+    Q_SLOT void testCountersOfThreads();
+    Q_SLOT void testGauges();
+    Q_SLOT void testHistograms();
+    Q_SLOT void testOpenMetrics();
+};
+
+void tst_QXmppMetrics::init()
+{
+    QXmppMetrics::reset();
+}
+
+void tst_QXmppMetrics::testCounters()
+{
+    QCOMPARE(QXmppMetrics::value(QXmppMetrics::ReceivedMessages), quint64(0));
+
+    QXmppMetrics::increment(QXmppMetrics::ReceivedMessages);
+    QXmppMetrics::increment(QXmppMetrics::ReceivedMessages, 4);
+    QXmppMetrics::increment(QXmppMetrics::SentIqs);
+    QCOMPARE(QXmppMetrics::value(QXmppMetrics::ReceivedMessages), quint64(5));
+    QCOMPARE(QXmppMetrics::value(QXmppMetrics::SentIqs), quint64(1));
+    QCOMPARE(QXmppMetrics::value(QXmppMetrics::SentMessages), quint64(0));
+
+    QXmppMetrics::reset();
+    QCOMPARE(QXmppMetrics::value(QXmppMetrics::ReceivedMessages), quint64(0));
+}
+
+void tst_QXmppMetrics::testCountersOfThreads()
+{
+    constexpr int ThreadCount = 4;
+    constexpr int Increments = 10000;
+
+    QXmppMetrics::increment(QXmppMetrics::RoutingFailures);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < ThreadCount; i++) {
+        threads.emplace_back([] {
+            for (int j = 0; j < Increments; j++) {
+                QXmppMetrics::increment(QXmppMetrics::RoutingFailures);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // values of finished threads are kept
+    QCOMPARE(QXmppMetrics::value(QXmppMetrics::RoutingFailures), quint64(ThreadCount * Increments + 1));
+}
+
+void tst_QXmppMetrics::testGauges()
+{
+    QXmppMetrics::setGauge(QXmppMetrics::IncomingClients, 3);
+    QCOMPARE(QXmppMetrics::value(QXmppMetrics::IncomingClients), qint64(3));
+
+    QXmppMetrics::addToGauge(QXmppMetrics::StreamManagementQueuedStanzas, 5);
+    QXmppMetrics::addToGauge(QXmppMetrics::StreamManagementQueuedStanzas, -2);
+    QCOMPARE(QXmppMetrics::value(QXmppMetrics::StreamManagementQueuedStanzas), qint64(3));
+}
+
+void tst_QXmppMetrics::testHistograms()
+{
+    QXmppMetrics::observe(QXmppMetrics::IqRoundTripTime, 2'000'000);
+    QXmppMetrics::observe(QXmppMetrics::IqRoundTripTime, 3'000'000);
+    QCOMPARE(QXmppMetrics::count(QXmppMetrics::IqRoundTripTime), quint64(2));
+    QCOMPARE(QXmppMetrics::sum(QXmppMetrics::IqRoundTripTime), qint64(5'000'000));
+    QCOMPARE(QXmppMetrics::count(QXmppMetrics::StanzaParseTime), quint64(0));
+
+    // observations with labels are part of the totals
+    QXmppMetrics::observe(QXmppMetrics::IqRoundTripTime, QStringLiteral("jabber:iq:roster"), 1'000'000);
+    QCOMPARE(QXmppMetrics::count(QXmppMetrics::IqRoundTripTime), quint64(3));
+    QCOMPARE(QXmppMetrics::count(QXmppMetrics::IqRoundTripTime, QStringLiteral("jabber:iq:roster")), quint64(1));
+    QCOMPARE(QXmppMetrics::sum(QXmppMetrics::IqRoundTripTime), qint64(6'000'000));
+}
+
+void tst_QXmppMetrics::testOpenMetrics()
+{
+    QXmppMetrics::increment(QXmppMetrics::ReceivedPresences, 2);
+    QXmppMetrics::setGauge(QXmppMetrics::IncomingServers, 1);
+    // 2 ms, 20 ms and one minute
+    QXmppMetrics::observe(QXmppMetrics::IqRoundTripTime, 2'000'000);
+    QXmppMetrics::observe(QXmppMetrics::IqRoundTripTime, 20'000'000);
+    QXmppMetrics::observe(QXmppMetrics::IqRoundTripTime, 60'000'000'000);
+
+    const auto output = QXmppMetrics::toOpenMetrics();
+    const auto lines = output.split('\n');
+
+    QVERIFY(output.endsWith("# EOF\n"));
+
+    // one type declaration per family
+    QCOMPARE(output.count("# TYPE qxmpp_stanzas_received counter\n"), 1);
+    QVERIFY(lines.contains("qxmpp_stanzas_received_total{type=\"message\"} 0"));
+    QVERIFY(lines.contains("qxmpp_stanzas_received_total{type=\"presence\"} 2"));
+
+    QVERIFY(lines.contains("# TYPE qxmpp_server_streams gauge"));
+    QVERIFY(lines.contains("qxmpp_server_streams{type=\"incoming-server\"} 1"));
+
+    // buckets are cumulative
+    QVERIFY(lines.contains("# TYPE qxmpp_iq_round_trip_seconds histogram"));
+    QVERIFY(lines.contains("qxmpp_iq_round_trip_seconds_bucket{le=\"0.001\"} 0"));
+    QVERIFY(lines.contains("qxmpp_iq_round_trip_seconds_bucket{le=\"0.005\"} 1"));
+    QVERIFY(lines.contains("qxmpp_iq_round_trip_seconds_bucket{le=\"0.025\"} 2"));
+    QVERIFY(lines.contains("qxmpp_iq_round_trip_seconds_bucket{le=\"30\"} 2"));
+    QVERIFY(lines.contains("qxmpp_iq_round_trip_seconds_bucket{le=\"+Inf\"} 3"));
+    QVERIFY(lines.contains("qxmpp_iq_round_trip_seconds_count 3"));
+    QVERIFY(lines.contains("qxmpp_iq_round_trip_seconds_sum 60.022"));
+
+    // series with labels
+    QXmppMetrics::observe(QXmppMetrics::IqRoundTripTime, QStringLiteral("urn:xmpp:\"ping\""), 2'000'000);
+    const auto labelledLines = QXmppMetrics::toOpenMetrics().split('\n');
+    QVERIFY(labelledLines.contains("qxmpp_iq_round_trip_seconds_bucket{namespace=\"urn:xmpp:\\\"ping\\\"\",le=\"0.005\"} 1"));
+    QVERIFY(labelledLines.contains("qxmpp_iq_round_trip_seconds_count{namespace=\"urn:xmpp:\\\"ping\\\"\"} 1"));
+    QVERIFY(labelledLines.contains("qxmpp_iq_round_trip_seconds_count 3"));
+
+    // histograms without labels are always exported
+    QVERIFY(labelledLines.contains("qxmpp_stanza_parse_seconds_count 0"));
+}
+
+QTEST_MAIN(tst_QXmppMetrics)
+#include "tst_qxmppmetrics.moc"
@@ -0,0 +1,142 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppClient.h"
+#include "QXmppMessage.h"
+#include "QXmppMetrics.h"
+#include "QXmppMucExtension.h"
+#include "QXmppMucManager.h"
+#include "QXmppServer.h"
+
+#include "util.h"
+
+#include <QSignalSpy>
+#include <QTemporaryDir>
+
+static const auto RoomJid = QStringLiteral("room@conference.localhost");
+
+class tst_QXmppMucExtension : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testRoom();
+};
+
+void tst_QXmppMucExtension::testRoom()
+{
+    const QString testDomain("localhost");
+    const QHostAddress testHost(QHostAddress::LocalHost);
+    const quint16 testPort = 12354;
+
+    QTemporaryDir archiveDir;
+    QVERIFY(archiveDir.isValid());
+
+    TestPasswordChecker passwordChecker;
+    passwordChecker.addCredentials("alice", "testpwd");
+    passwordChecker.addCredentials("bob", "testpwd");
+    passwordChecker.addCredentials("carol", "testpwd");
+
+    auto *muc = new QXmppMucExtension;
+    muc->setJid(QStringLiteral("conference.localhost"));
+    muc->setShardCount(2);
+    muc->setArchiveDirectory(archiveDir.path());
+
+    QXmppServer server;
+    server.setDomain(testDomain);
+    server.setPasswordChecker(&passwordChecker);
+    server.addExtension(muc);
+    QVERIFY(server.listenForClients(testHost, testPort));
+
+    struct Occupant
+    {
+        QXmppClient client;
+        QXmppMucRoom *room = nullptr;
+    };
+    const auto connectOccupant = [&](Occupant &occupant, const QString &username) {
+        auto *manager = new QXmppMucManager;
+        occupant.client.addExtension(manager);
+        occupant.room = manager->addRoom(RoomJid);
+        occupant.room->setNickName(username);
+
+        QSignalSpy connected(&occupant.client, &QXmppClient::connected);
+        QXmppConfiguration config;
+        config.setDomain(testDomain);
+        config.setHost(testHost.toString());
+        config.setPort(testPort);
+        config.setUser(username);
+        config.setPassword("testpwd");
+        occupant.client.connectToServer(config);
+        QTRY_COMPARE(connected.size(), 1);
+    };
+
+    // the first occupant creates the room
+    const auto roomsBefore = QXmppMetrics::value(QXmppMetrics::MucRooms);
+    Occupant alice;
+    connectOccupant(alice, "alice");
+    QSignalSpy aliceJoined(alice.room, &QXmppMucRoom::joined);
+    QVERIFY(alice.room->join());
+    QTRY_COMPARE(aliceJoined.size(), 1);
+    QCOMPARE(QXmppMetrics::value(QXmppMetrics::MucRooms), roomsBefore + 1);
+    QVERIFY(alice.room->allowedActions().testFlag(QXmppMucRoom::ConfigurationAction));
+
+    Occupant bob;
+    connectOccupant(bob, "bob");
+    QSignalSpy aliceAdded(alice.room, &QXmppMucRoom::participantAdded);
+    QVERIFY(bob.room->join());
+    QTRY_VERIFY(bob.room->isJoined());
+    QTRY_COMPARE(aliceAdded.size(), 1);
+    QCOMPARE(aliceAdded.at(0).at(0).toString(), RoomJid + QStringLiteral("/bob"));
+    QCOMPARE(bob.room->participants().size(), 2);
+    QCOMPARE(bob.room->allowedActions(), QXmppMucRoom::Actions(QXmppMucRoom::NoAction));
+
+    // messages are sent to all occupants
+    QSignalSpy aliceMessages(alice.room, &QXmppMucRoom::messageReceived);
+    QSignalSpy bobMessages(bob.room, &QXmppMucRoom::messageReceived);
+    QVERIFY(alice.room->sendMessage(QStringLiteral("Hello")));
+    QTRY_COMPARE(aliceMessages.size(), 1);
+    QTRY_COMPARE(bobMessages.size(), 1);
+    const auto message = bobMessages.at(0).at(0).value<QXmppMessage>();
+    QCOMPARE(message.from(), RoomJid + QStringLiteral("/alice"));
+    QCOMPARE(message.body(), QStringLiteral("Hello"));
+
+    // nicknames are unique
+    Occupant carol;
+    connectOccupant(carol, "carol");
+    QSignalSpy carolLeft(carol.room, &QXmppMucRoom::left);
+    carol.room->setNickName(QStringLiteral("alice"));
+    QVERIFY(carol.room->join());
+    QTRY_COMPARE(carolLeft.size(), 1);
+    QVERIFY(!carol.room->isJoined());
+
+    // new occupants receive the history from the archive
+    QSignalSpy carolMessages(carol.room, &QXmppMucRoom::messageReceived);
+    carol.room->setNickName(QStringLiteral("carol"));
+    QVERIFY(carol.room->join());
+    QTRY_VERIFY(carol.room->isJoined());
+    QTRY_COMPARE(carolMessages.size(), 1);
+    const auto history = carolMessages.at(0).at(0).value<QXmppMessage>();
+    QCOMPARE(history.body(), QStringLiteral("Hello"));
+    QCOMPARE(history.from(), RoomJid + QStringLiteral("/alice"));
+    QVERIFY(history.stamp().isValid());
+    QCOMPARE(carol.room->participants().size(), 3);
+
+    // occupants who disconnect leave the room
+    QSignalSpy aliceRemoved(alice.room, &QXmppMucRoom::participantRemoved);
+    bob.client.disconnectFromServer();
+    QTRY_COMPARE(aliceRemoved.size(), 1);
+    QCOMPARE(aliceRemoved.at(0).at(0).toString(), RoomJid + QStringLiteral("/bob"));
+
+    QVERIFY(carol.room->leave());
+    QTRY_VERIFY(!carol.room->isJoined());
+    QTRY_COMPARE(aliceRemoved.size(), 2);
+    QCOMPARE(alice.room->participants().size(), 1);
+
+    // the room is destroyed with its last occupant
+    QVERIFY(alice.room->leave());
+    QTRY_COMPARE(QXmppMetrics::value(QXmppMetrics::MucRooms), roomsBefore);
+}
+
+QTEST_MAIN(tst_QXmppMucExtension)
+#include "tst_qxmppmucextension.moc"
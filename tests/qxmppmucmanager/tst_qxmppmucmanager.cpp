@@ -0,0 +1,228 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppClient.h"
+#include "QXmppMamManager.h"
+#include "QXmppMucManager.h"
+
+#include "TestClient.h"
+#include "util.h"
+
+class tst_QXmppMucManager : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testJoinBatching_data();
+    Q_SLOT void testJoinBatching();
+    Q_SLOT void testMinimalPresences();
+    Q_SLOT void testJoinHistory();
+    Q_SLOT void testMamCatchUp();
+    Q_SLOT void testRouting();
+};
+
+static QXmppPresence occupantPresence(const QString &nick, QXmppPresence::Type type = QXmppPresence::Available)
+{
+    QXmppMucItem item;
+    item.setAffiliation(QXmppMucItem::MemberAffiliation);
+    item.setRole(QXmppMucItem::ParticipantRole);
+
+    QXmppPresence presence(type);
+    presence.setFrom(QStringLiteral("coven@chat.shakespeare.lit/") + nick);
+    presence.setMucItem(item);
+    presence.setMucSupported(true);
+    return presence;
+}
+
+void tst_QXmppMucManager::testJoinBatching_data()
+{
+    QTest::addColumn<bool>("batching");
+
+    QTest::newRow("single") << false;
+    QTest::newRow("batched") << true;
+}
+
+void tst_QXmppMucManager::testJoinBatching()
+{
+    QFETCH(bool, batching);
+
+    QXmppClient client;
+    auto *manager = new QXmppMucManager;
+    client.addExtension(manager);
+
+    auto *room = manager->addRoom(QStringLiteral("coven@chat.shakespeare.lit"));
+    room->setNickName(QStringLiteral("thirdwitch"));
+    room->setJoinBatchingEnabled(batching);
+    QCOMPARE(room->isJoinBatchingEnabled(), batching);
+
+    QStringList added;
+    QList<QStringList> batches;
+    int joinedCount = 0;
+    connect(room, &QXmppMucRoom::participantAdded, this, [&](const QString &jid) {
+        added << jid;
+    });
+    connect(room, &QXmppMucRoom::participantsAdded, this, [&](const QStringList &jids) {
+        batches << jids;
+    });
+    connect(room, &QXmppMucRoom::joined, this, [&]() {
+        // all occupants are known when joined() is emitted
+        QCOMPARE(room->participants().size(), 2);
+        joinedCount++;
+    });
+
+    room->join();
+    Q_EMIT client.presenceReceived(occupantPresence(QStringLiteral("firstwitch")));
+    Q_EMIT client.presenceReceived(occupantPresence(QStringLiteral("secondwitch")));
+    Q_EMIT client.presenceReceived(occupantPresence(QStringLiteral("secondwitch"), QXmppPresence::Unavailable));
+    Q_EMIT client.presenceReceived(occupantPresence(QStringLiteral("thirdwitch")));
+    QCOMPARE(joinedCount, 1);
+    QVERIFY(room->isJoined());
+
+    if (batching) {
+        QVERIFY(added.isEmpty());
+        QCOMPARE(batches.size(), 1);
+        QCOMPARE(batches.first(), (QStringList { QStringLiteral("coven@chat.shakespeare.lit/firstwitch"), QStringLiteral("coven@chat.shakespeare.lit/thirdwitch") }));
+    } else {
+        QCOMPARE(added.size(), 3);
+        QVERIFY(batches.isEmpty());
+    }
+
+    // after joining, occupants are reported one by one
+    added.clear();
+    Q_EMIT client.presenceReceived(occupantPresence(QStringLiteral("fourthwitch")));
+    QCOMPARE(added, QStringList { QStringLiteral("coven@chat.shakespeare.lit/fourthwitch") });
+    QCOMPARE(batches.size(), batching ? 1 : 0);
+}
+
+void tst_QXmppMucManager::testMinimalPresences()
+{
+    QXmppClient client;
+    auto *manager = new QXmppMucManager;
+    client.addExtension(manager);
+
+    auto *room = manager->addRoom(QStringLiteral("coven@chat.shakespeare.lit"));
+    QVERIFY(room->isFullPresenceStorageEnabled());
+    room->setFullPresenceStorageEnabled(false);
+
+    auto presence = occupantPresence(QStringLiteral("firstwitch"));
+    presence.setStatusText(QStringLiteral("Brewing"));
+    presence.setPriority(5);
+    Q_EMIT client.presenceReceived(presence);
+
+    const auto stored = room->participantPresence(QStringLiteral("coven@chat.shakespeare.lit/firstwitch"));
+    QCOMPARE(stored.type(), QXmppPresence::Available);
+    QCOMPARE(stored.statusText(), QStringLiteral("Brewing"));
+    QCOMPARE(stored.mucItem().role(), QXmppMucItem::ParticipantRole);
+    QCOMPARE(stored.priority(), 0);
+}
+
+void tst_QXmppMucManager::testJoinHistory()
+{
+    TestClient test;
+    test.configuration().setJid(QStringLiteral("hag66@shakespeare.lit/pda"));
+    auto *manager = test.addNewExtension<QXmppMucManager>();
+
+    auto *room = manager->addRoom(QStringLiteral("coven@chat.shakespeare.lit"));
+    room->setNickName(QStringLiteral("thirdwitch"));
+    room->setHistoryMaxStanzas(20);
+    room->setHistorySeconds(180);
+    room->join();
+
+    QXmppPresence presence;
+    parsePacket(presence, test.takePacket().toUtf8());
+    QCOMPARE(presence.to(), QStringLiteral("coven@chat.shakespeare.lit/thirdwitch"));
+    QVERIFY(presence.isMucSupported());
+    QCOMPARE(presence.mucHistoryMaxStanzas(), std::optional<int>(20));
+    QCOMPARE(presence.mucHistorySeconds(), std::optional<int>(180));
+    QVERIFY(!presence.mucHistorySince().isValid());
+}
+
+void tst_QXmppMucManager::testMamCatchUp()
+{
+    TestClient test;
+    test.configuration().setJid(QStringLiteral("hag66@shakespeare.lit/pda"));
+    auto *manager = test.addNewExtension<QXmppMucManager>();
+    test.addNewExtension<QXmppMamManager>();
+
+    auto *room = manager->addRoom(QStringLiteral("coven@chat.shakespeare.lit"));
+    room->setNickName(QStringLiteral("thirdwitch"));
+    room->setHistoryMaxStanzas(20);
+    room->setMamCatchUpEnabled(true);
+
+    // the last stanza ID is taken from live messages
+    QXmppMessage message;
+    message.setFrom(QStringLiteral("coven@chat.shakespeare.lit/firstwitch"));
+    message.setType(QXmppMessage::GroupChat);
+    message.setStanzaId(QStringLiteral("stanza-1"));
+    message.setStanzaIdBy(QStringLiteral("coven@chat.shakespeare.lit"));
+    Q_EMIT test.messageReceived(message);
+    QCOMPARE(room->lastStanzaId(), QStringLiteral("stanza-1"));
+
+    // no history is requested from the room
+    room->join();
+    QXmppPresence presence;
+    parsePacket(presence, test.takePacket().toUtf8());
+    QCOMPARE(presence.mucHistoryMaxStanzas(), std::optional<int>(0));
+
+    // the archive is queried once the room has been joined
+    Q_EMIT test.presenceReceived(occupantPresence(QStringLiteral("thirdwitch")));
+    QVERIFY(room->isJoined());
+    const auto query = test.takeLastPacket();
+    QVERIFY(query.contains(QStringLiteral("to=\"coven@chat.shakespeare.lit\"")));
+    QVERIFY(query.contains(QStringLiteral("<after>stanza-1</after>")));
+
+    QXmppIq queryIq;
+    parsePacket(queryIq, query.toUtf8());
+    test.inject(QStringLiteral(
+                    "<iq id='%1' from='coven@chat.shakespeare.lit' type='result'>"
+                    "<fin xmlns='urn:xmpp:mam:2' complete='true'>"
+                    "<set xmlns='http://jabber.org/protocol/rsm'><first>stanza-2</first><last>stanza-5</last></set>"
+                    "</fin></iq>")
+                    .arg(queryIq.id()));
+    QCOMPARE(room->lastStanzaId(), QStringLiteral("stanza-5"));
+}
+
+void tst_QXmppMucManager::testRouting()
+{
+    QXmppClient client;
+    auto *manager = new QXmppMucManager;
+    client.addExtension(manager);
+
+    auto *coven = manager->addRoom(QStringLiteral("coven@chat.shakespeare.lit"));
+    auto *globe = manager->addRoom(QStringLiteral("globe@chat.shakespeare.lit"));
+
+    int covenMessages = 0;
+    int globeMessages = 0;
+    connect(coven, &QXmppMucRoom::messageReceived, this, [&]() { covenMessages++; });
+    connect(globe, &QXmppMucRoom::messageReceived, this, [&]() { globeMessages++; });
+
+    // stanzas only reach the room they are from
+    Q_EMIT client.presenceReceived(occupantPresence(QStringLiteral("firstwitch")));
+    QCOMPARE(coven->participants().size(), 1);
+    QVERIFY(globe->participants().isEmpty());
+
+    QXmppMessage message;
+    message.setFrom(QStringLiteral("coven@chat.shakespeare.lit/firstwitch"));
+    message.setType(QXmppMessage::GroupChat);
+    message.setSubject(QStringLiteral("Fire Burn and Cauldron Bubble!"));
+    Q_EMIT client.messageReceived(message);
+    QCOMPARE(covenMessages, 1);
+    QCOMPARE(globeMessages, 0);
+    QCOMPARE(coven->subject(), QStringLiteral("Fire Burn and Cauldron Bubble!"));
+    QVERIFY(globe->subject().isEmpty());
+
+    message.setFrom(QStringLiteral("stage@chat.shakespeare.lit/firstwitch"));
+    Q_EMIT client.messageReceived(message);
+    QCOMPARE(covenMessages, 1);
+    QCOMPARE(globeMessages, 0);
+
+    // destroyed rooms are not routed to anymore
+    delete coven;
+    QCOMPARE(manager->rooms(), QList<QXmppMucRoom *> { globe });
+    Q_EMIT client.presenceReceived(occupantPresence(QStringLiteral("secondwitch")));
+    QVERIFY(globe->participants().isEmpty());
+}
+
+QTEST_MAIN(tst_QXmppMucManager)
+#include "tst_qxmppmucmanager.moc"
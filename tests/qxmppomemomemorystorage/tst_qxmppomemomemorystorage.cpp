@@ -15,6 +15,7 @@ private:
     Q_SLOT void testSignedPreKeyPairs();
     Q_SLOT void testPreKeyPairs();
     Q_SLOT void testDevices();
+    Q_SLOT void testAddDevices();
     Q_SLOT void testResetAll();
 
     QXmppOmemoMemoryStorage m_omemoStorage;
@@ -279,6 +280,57 @@ void tst_QXmppOmemoMemoryStorage::testDevices()
     QCOMPARE(resultDeviceAlice.removalFromDeviceListDate, QDateTime(QDate(2022, 01, 01), QTime()));
 }
 
+void tst_QXmppOmemoMemoryStorage::testAddDevices()
+{
+    QXmppOmemoMemoryStorage storage;
+
+    QXmppOmemoStorage::Device deviceAlice;
+    deviceAlice.label = QStringLiteral("Desktop");
+    deviceAlice.unrespondedSentStanzasCount = 1;
+    storage.addDevice(QStringLiteral("alice@example.org"), 1, deviceAlice);
+
+    QXmppOmemoStorage::Device deviceAlice2;
+    deviceAlice2.label = QStringLiteral("Laptop");
+
+    QXmppOmemoStorage::Device deviceBob;
+    deviceBob.label = QStringLiteral("Phone");
+
+    deviceAlice.unrespondedSentStanzasCount = 2;
+
+    QHash<QString, QHash<uint32_t, QXmppOmemoStorage::Device>> devices;
+    devices[QStringLiteral("alice@example.org")].insert(1, deviceAlice);
+    devices[QStringLiteral("alice@example.org")].insert(2, deviceAlice2);
+    devices[QStringLiteral("bob@example.com")].insert(1, deviceBob);
+
+    auto task = storage.addDevices(devices);
+    QVERIFY(task.isFinished());
+
+    auto future = storage.allData();
+    QVERIFY(future.isFinished());
+    const auto result = future.result().devices;
+    QCOMPARE(result.size(), 2);
+
+    const auto resultDevicesAlice = result.value(QStringLiteral("alice@example.org"));
+    QCOMPARE(resultDevicesAlice.size(), 2);
+    QCOMPARE(resultDevicesAlice.value(1).label, QStringLiteral("Desktop"));
+    QCOMPARE(resultDevicesAlice.value(1).unrespondedSentStanzasCount, 2);
+    QCOMPARE(resultDevicesAlice.value(2).label, QStringLiteral("Laptop"));
+
+    const auto resultDevicesBob = result.value(QStringLiteral("bob@example.com"));
+    QCOMPARE(resultDevicesBob.size(), 1);
+    QCOMPARE(resultDevicesBob.value(1).label, QStringLiteral("Phone"));
+
+    auto devicesTask = storage.devices(QStringLiteral("alice@example.org"));
+    QVERIFY(devicesTask.isFinished());
+    const auto jidDevices = devicesTask.result();
+    QCOMPARE(jidDevices.size(), 2);
+    QCOMPARE(jidDevices.value(2).label, QStringLiteral("Laptop"));
+
+    devicesTask = storage.devices(QStringLiteral("carol@example.net"));
+    QVERIFY(devicesTask.isFinished());
+    QVERIFY(devicesTask.result().isEmpty());
+}
+
 void tst_QXmppOmemoMemoryStorage::testResetAll()
 {
     m_omemoStorage.setOwnDevice(QXmppOmemoStorage::OwnDevice());
@@ -0,0 +1,171 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppClient.h"
+#include "QXmppFutureUtils_p.h"
+#include "QXmppPepExtension.h"
+#include "QXmppPepStorage.h"
+#include "QXmppPubSubManager.h"
+#include "QXmppServer.h"
+#include "QXmppUserTuneItem.h"
+#include "QXmppUserTuneManager.h"
+
+#include "util.h"
+
+#include <algorithm>
+
+#include <QSignalSpy>
+
+using namespace QXmpp::Private;
+
+static const auto TuneNode = QStringLiteral("http://jabber.org/protocol/tune");
+
+class TestPepStorage : public QXmppPepStorage
+{
+public:
+    QXmppTask<QVector<Node>> loadNodes() override
+    {
+        return makeReadyTask(QVector<Node>(nodes));
+    }
+
+    QXmppTask<void> storeNodes(const QVector<Node> &changed, const QVector<NodeKey> &removed) override
+    {
+        batches++;
+        const auto erase = [this](const QString &owner, const QString &name) {
+            nodes.erase(std::remove_if(nodes.begin(), nodes.end(), [&](const Node &node) {
+                            return node.owner == owner && node.name == name;
+                        }),
+                        nodes.end());
+        };
+        for (const auto &key : removed) {
+            erase(key.first, key.second);
+        }
+        for (const auto &node : changed) {
+            erase(node.owner, node.name);
+            nodes << node;
+        }
+        return makeReadyTask();
+    }
+
+    QVector<Node> nodes;
+    int batches = 0;
+};
+
+class tst_QXmppPepExtension : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testPep();
+};
+
+void tst_QXmppPepExtension::testPep()
+{
+    const QString testDomain("localhost");
+    const QHostAddress testHost(QHostAddress::LocalHost);
+    const quint16 testPort = 12353;
+
+    TestPepStorage storage;
+    storage.nodes << QXmppPepStorage::Node {
+        QStringLiteral("alice@localhost"),
+        TuneNode,
+        QStringLiteral("presence"),
+        1,
+        { { QStringLiteral("current"), QByteArrayLiteral("<tune xmlns=\"http://jabber.org/protocol/tune\"><artist>Yes</artist></tune>") } },
+    };
+
+    TestPasswordChecker passwordChecker;
+    passwordChecker.addCredentials("alice", "testpwd");
+    passwordChecker.addCredentials("bob", "testpwd");
+
+    auto *pep = new QXmppPepExtension;
+    pep->setStorage(&storage);
+    pep->setWriteBehindDelay(10);
+
+    QXmppServer server;
+    server.setDomain(testDomain);
+    server.setPasswordChecker(&passwordChecker);
+    server.addExtension(pep);
+    server.setPresenceSubscribers(QStringLiteral("alice@localhost"), { QStringLiteral("bob@localhost") });
+    QCOMPARE(server.presenceSubscriptions(QStringLiteral("bob@localhost")), QStringList { QStringLiteral("alice@localhost") });
+    QVERIFY(server.listenForClients(testHost, testPort));
+    QCOMPARE(pep->nodeCount(QStringLiteral("alice@localhost")), 1);
+
+    const auto connectClient = [&](QXmppClient &client, const QString &username) {
+        QXmppConfiguration config;
+        config.setDomain(testDomain);
+        config.setHost(testHost.toString());
+        config.setPort(testPort);
+        config.setUser(username);
+        config.setPassword("testpwd");
+        client.connectToServer(config);
+    };
+
+    // the last item of alice is sent to bob, whose capabilities announce
+    // interest in tunes
+    QXmppClient bob;
+    auto *bobPubSub = new QXmppPubSubManager;
+    auto *bobTunes = new QXmppUserTuneManager;
+    bob.addExtension(bobPubSub);
+    bob.addExtension(bobTunes);
+    QSignalSpy bobReceived(bobTunes, &QXmppUserTuneManager::itemReceived);
+    connectClient(bob, "bob");
+    QTRY_COMPARE(bobReceived.size(), 1);
+    QCOMPARE(bobReceived.at(0).at(0).toString(), QStringLiteral("alice@localhost"));
+    QCOMPARE(bobReceived.at(0).at(1).value<QXmppTuneItem>().artist(), QStringLiteral("Yes"));
+
+    // publications are sent to bob and to alice
+    QXmppClient alice;
+    auto *alicePubSub = new QXmppPubSubManager;
+    auto *aliceTunes = new QXmppUserTuneManager;
+    alice.addExtension(alicePubSub);
+    alice.addExtension(aliceTunes);
+    QSignalSpy aliceReceived(aliceTunes, &QXmppUserTuneManager::itemReceived);
+    connectClient(alice, "alice");
+    QTRY_COMPARE(aliceReceived.size(), 1);
+
+    QXmppTuneItem tune;
+    tune.setArtist(QStringLiteral("Genesis"));
+    auto publishTask = aliceTunes->publish(tune);
+    QTRY_VERIFY(publishTask.isFinished());
+    expectFutureVariant<QString>(publishTask);
+    QTRY_COMPARE(bobReceived.size(), 2);
+    QCOMPARE(bobReceived.at(1).at(1).value<QXmppTuneItem>().artist(), QStringLiteral("Genesis"));
+    QTRY_COMPARE(aliceReceived.size(), 2);
+
+    // the node keeps one item and is written behind
+    QTRY_COMPARE(storage.batches, 1);
+    QCOMPARE(storage.nodes.size(), 1);
+    QCOMPARE(storage.nodes.first().items.size(), 1);
+    QVERIFY(storage.nodes.first().items.first().payload.contains("Genesis"));
+
+    // the items are answered from memory
+    auto itemsTask = bobPubSub->requestItems<QXmppTuneItem>(QStringLiteral("alice@localhost"), TuneNode);
+    QTRY_VERIFY(itemsTask.isFinished());
+    auto items = expectFutureVariant<QXmppPubSubManager::Items<QXmppTuneItem>>(itemsTask);
+    QCOMPARE(items.items.size(), 1);
+    QCOMPARE(items.items.first().artist(), QStringLiteral("Genesis"));
+
+    // only users with a presence subscription have access
+    server.removePresenceSubscriber(QStringLiteral("alice@localhost"), QStringLiteral("bob@localhost"));
+    QVERIFY(server.presenceSubscriptions(QStringLiteral("bob@localhost")).isEmpty());
+    itemsTask = bobPubSub->requestItems<QXmppTuneItem>(QStringLiteral("alice@localhost"), TuneNode);
+    QTRY_VERIFY(itemsTask.isFinished());
+    expectFutureVariant<QXmppError>(itemsTask);
+
+    // deleted nodes are removed from the storage
+    auto deleteTask = alicePubSub->deleteOwnPepNode(TuneNode);
+    QTRY_VERIFY(deleteTask.isFinished());
+    expectFutureVariant<QXmpp::Success>(deleteTask);
+    QCOMPARE(pep->nodeCount(QStringLiteral("alice@localhost")), 0);
+    QTRY_COMPARE(storage.batches, 2);
+    QVERIFY(storage.nodes.isEmpty());
+
+    itemsTask = alicePubSub->requestOwnPepItems<QXmppTuneItem>(TuneNode);
+    QTRY_VERIFY(itemsTask.isFinished());
+    expectFutureVariant<QXmppError>(itemsTask);
+}
+
+QTEST_MAIN(tst_QXmppPepExtension)
+#include "tst_qxmpppepextension.moc"
@@ -22,10 +22,12 @@ private:
     Q_SLOT void testPresenceWithMucItem();
     Q_SLOT void testPresenceWithMucPassword();
     Q_SLOT void testPresenceWithMucSupport();
+    Q_SLOT void testPresenceWithMucHistory();
     Q_SLOT void testPresenceWithMuji();
     Q_SLOT void testPresenceWithLastUserInteraction();
     Q_SLOT void testPresenceWithMix();
     Q_SLOT void testPresenceWithVCard();
+    Q_SLOT void testLazyExtensions();
 };
 
 void tst_QXmppPresence::testPresence_data()
@@ -252,6 +254,34 @@ void tst_QXmppPresence::testPresenceWithMucSupport()
     serializePacket(presence, xml);
 }
 
+void tst_QXmppPresence::testPresenceWithMucHistory()
+{
+    const QByteArray xml(
+        "<presence to=\"coven@chat.shakespeare.lit/thirdwitch\" "
+        "from=\"hag66@shakespeare.lit/pda\">"
+        "<x xmlns=\"http://jabber.org/protocol/muc\">"
+        "<history maxstanzas=\"20\" seconds=\"180\" since=\"1970-01-01T00:00:00Z\"/>"
+        "</x>"
+        "</presence>");
+
+    QXmppPresence presence;
+    QVERIFY(!presence.mucHistoryMaxStanzas());
+    QVERIFY(!presence.mucHistorySeconds());
+    QVERIFY(!presence.mucHistorySince().isValid());
+
+    parsePacket(presence, xml);
+    QVERIFY(presence.isMucSupported());
+    QCOMPARE(presence.mucHistoryMaxStanzas(), std::optional<int>(20));
+    QCOMPARE(presence.mucHistorySeconds(), std::optional<int>(180));
+    QCOMPARE(presence.mucHistorySince(), QDateTime(QDate(1970, 1, 1), QTime(0, 0, 0), Qt::UTC));
+    serializePacket(presence, xml);
+
+    presence = QXmppPresence();
+    presence.setMucSupported(true);
+    presence.setMucHistoryMaxStanzas(0);
+    serializePacket(presence, "<presence><x xmlns=\"http://jabber.org/protocol/muc\"><history maxstanzas=\"0\"/></x></presence>");
+}
+
 void tst_QXmppPresence::testPresenceWithMuji()
 {
     const QByteArray xml(
@@ -341,5 +371,39 @@ void tst_QXmppPresence::testPresenceWithVCard()
 {
 }
 
+void tst_QXmppPresence::testLazyExtensions()
+{
+    const QByteArray xml(
+        "<presence to=\"pistol@shakespeare.lit/harfleur\" "
+        "from=\"harfleur@henryv.shakespeare.lit/pistol\">"
+        "<x xmlns=\"http://jabber.org/protocol/muc#user\">"
+        "<item affiliation=\"member\" role=\"participant\"/>"
+        "<status code=\"110\"/>"
+        "</x>"
+        "<c xmlns=\"http://jabber.org/protocol/caps\" hash=\"sha-1\" node=\"https://qxmpp.org\" ver=\"QgayPKawpkPSDYmwT/WM94uAlu0=\"/>"
+        "<x xmlns=\"vcard-temp:x:update\"><photo>73b908bc</photo></x>"
+        "</presence>");
+
+    QXmppPresence presence;
+    parsePacket(presence, xml);
+    QCOMPARE(presence.capabilityNode(), QStringLiteral("https://qxmpp.org"));
+
+    // copies share the unparsed extensions, but not the changes
+    auto copy = presence;
+    copy.setMucStatusCodes({ 307 });
+    QCOMPARE(copy.mucItem().affiliation(), QXmppMucItem::MemberAffiliation);
+    QCOMPARE(copy.vCardUpdateType(), QXmppPresence::VCardUpdateValidPhoto);
+    QCOMPARE(copy.mucStatusCodes(), QList<int>() << 307);
+    QCOMPARE(presence.mucStatusCodes(), QList<int>() << 110);
+    QCOMPARE(presence.photoHash(), QByteArray::fromHex("73b908bc"));
+    QVERIFY(presence.extensions().isEmpty());
+    serializePacket(presence, xml);
+
+    // the extensions are serialized without accessing them
+    QXmppPresence other;
+    parsePacket(other, xml);
+    serializePacket(other, xml);
+}
+
 QTEST_MAIN(tst_QXmppPresence)
 #include "tst_qxmpppresence.moc"
@@ -0,0 +1,90 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppProxy65Extension.h"
+#include "QXmppServer.h"
+#include "QXmppSocks.h"
+
+#include "util.h"
+
+#include <QCryptographicHash>
+#include <QDomDocument>
+#include <QSignalSpy>
+
+class tst_QXmppProxy65Extension : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testRelay_data();
+    Q_SLOT void testRelay();
+};
+
+void tst_QXmppProxy65Extension::testRelay_data()
+{
+    QTest::addColumn<qint64>("bandwidthLimit");
+
+    QTest::newRow("unlimited") << qint64(0);
+    QTest::newRow("limited") << qint64(100 * 1024);
+}
+
+void tst_QXmppProxy65Extension::testRelay()
+{
+    QFETCH(qint64, bandwidthLimit);
+
+    const quint16 proxyPort = 17777;
+    const QString initiator = QStringLiteral("alice@localhost/home");
+    const QString target = QStringLiteral("bob@localhost/phone");
+    const QString sid = QStringLiteral("session1");
+
+    auto *proxy = new QXmppProxy65Extension;
+    proxy->setPort(proxyPort);
+    proxy->setBandwidthLimit(bandwidthLimit);
+
+    QXmppServer server;
+    server.setDomain(QStringLiteral("localhost"));
+    server.addExtension(proxy);
+    QVERIFY(server.listenForClients(QHostAddress::LocalHost, 12349));
+    QCOMPARE(proxy->jid(), QStringLiteral("proxy.localhost"));
+
+    const auto hostName = QString::fromLatin1(QCryptographicHash::hash((sid + initiator + target).toUtf8(), QCryptographicHash::Sha1).toHex());
+
+    // the target connects first
+    QXmppSocksClient targetSocket(QStringLiteral("127.0.0.1"), proxyPort);
+    QSignalSpy targetReady(&targetSocket, &QXmppSocksClient::ready);
+    targetSocket.connectToHost(hostName, 0);
+    QVERIFY(targetReady.wait());
+
+    QXmppSocksClient initiatorSocket(QStringLiteral("127.0.0.1"), proxyPort);
+    QSignalSpy initiatorReady(&initiatorSocket, &QXmppSocksClient::ready);
+    initiatorSocket.connectToHost(hostName, 0);
+    QVERIFY(initiatorReady.wait());
+
+    QDomDocument doc;
+    doc.setContent(QStringLiteral("<iq xmlns='jabber:client' type='set' id='activate1' from='%1' to='proxy.localhost'>"
+                                  "<query xmlns='http://jabber.org/protocol/bytestreams' sid='%2'><activate>%3</activate></query>"
+                                  "</iq>")
+                       .arg(initiator, sid, target),
+                   true);
+    server.handleElement(doc.documentElement());
+    QTRY_COMPARE(proxy->activeRelayCount(), 1);
+
+    // data is forwarded in both directions
+    QByteArray data(150 * 1024, 'x');
+    initiatorSocket.write(data);
+    QByteArray received;
+    QTRY_VERIFY_WITH_TIMEOUT((received += targetSocket.readAll()).size() >= data.size(), 10000);
+    QCOMPARE(received, data);
+
+    targetSocket.write("ack");
+    QTRY_COMPARE(initiatorSocket.readAll(), QByteArray("ack"));
+
+    // closing one side closes the other one
+    initiatorSocket.disconnectFromHost();
+    QTRY_COMPARE(targetSocket.state(), QAbstractSocket::UnconnectedState);
+    QTRY_COMPARE(proxy->activeRelayCount(), 0);
+}
+
+QTEST_MAIN(tst_QXmppProxy65Extension)
+#include "tst_qxmppproxy65extension.moc"
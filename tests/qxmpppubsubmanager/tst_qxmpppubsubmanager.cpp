@@ -82,6 +82,7 @@ private:
     Q_SLOT void testDeleteNodes();
     Q_SLOT void testPublishItems_data();
     Q_SLOT void testPublishItems();
+    Q_SLOT void testPepPublishInterval();
     Q_SLOT void testRetractCurrentItem();
     Q_SLOT void testRetractItem_data();
     Q_SLOT void testRetractItem();
@@ -97,6 +98,10 @@ private:
     Q_SLOT void testRequestPepItem();
     Q_SLOT void testRequestPepItems();
     Q_SLOT void testRequestItemNotFound();
+    Q_SLOT void testItemCache();
+    Q_SLOT void testItemCacheRefresh();
+    Q_SLOT void testRequestItemsBatch();
+    Q_SLOT void testRequestLazyItems();
     Q_SLOT void testRequestNodeAffiliations();
     Q_SLOT void testRequestAffiliations();
     Q_SLOT void testRequestAffiliationsNode();
@@ -568,6 +573,58 @@ void tst_QXmppPubSubManager::testPublishItems()
     }
 }
 
+void tst_QXmppPubSubManager::testPepPublishInterval()
+{
+    const QString node = QStringLiteral("http://jabber.org/protocol/tune");
+
+    TestClient test;
+    test.configuration().setJid(QStringLiteral("juliet@capulet.lit"));
+    auto *psManager = test.addNewExtension<PSManager>();
+    psManager->setPepPublishInterval(node, 100);
+    QCOMPARE(psManager->pepPublishInterval(node), 100);
+
+    const auto expectPublish = [&](const QString &iqId, const QString &itemId) {
+        test.expect(QStringLiteral("<iq id='%1' to='juliet@capulet.lit' type='set'>"
+                                   "<pubsub xmlns='http://jabber.org/protocol/pubsub'><publish node='%2'><item id='%3'/></publish></pubsub>"
+                                   "</iq>")
+                        .arg(iqId, node, itemId));
+        test.inject(QStringLiteral("<iq id='%1' from='juliet@capulet.lit' type='result'>"
+                                   "<pubsub xmlns='http://jabber.org/protocol/pubsub'><publish node='%2'><item id='%3'/></publish></pubsub>"
+                                   "</iq>")
+                        .arg(iqId, node, itemId));
+    };
+
+    // the first item is published right away
+    auto first = psManager->publishOwnPepItem(node, QXmppPubSubBaseItem(QStringLiteral("1")));
+    expectPublish(QStringLiteral("qxmpp1"), QStringLiteral("1"));
+    QCOMPARE(expectFutureVariant<QString>(first), QStringLiteral("1"));
+
+    // within the interval, only the latest item is published
+    auto second = psManager->publishOwnPepItem(node, QXmppPubSubBaseItem(QStringLiteral("2")));
+    auto third = psManager->publishOwnPepItem(node, QXmppPubSubBaseItem(QStringLiteral("3")));
+    test.expectNoPacket();
+    QVERIFY(!second.isFinished());
+
+    QTest::qWait(150);
+    expectPublish(QStringLiteral("qxmpp2"), QStringLiteral("3"));
+    QCOMPARE(expectFutureVariant<QString>(second), QStringLiteral("3"));
+    QCOMPARE(expectFutureVariant<QString>(third), QStringLiteral("3"));
+
+    // other nodes are not affected
+    auto other = psManager->publishOwnPepItem(QStringLiteral("other"), QXmppPubSubBaseItem(QStringLiteral("4")));
+    test.expect(QStringLiteral("<iq id='qxmpp3' to='juliet@capulet.lit' type='set'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'><publish node='other'><item id='4'/></publish></pubsub>"
+                               "</iq>"));
+
+    // disabling the interval publishes the pending item
+    auto fifth = psManager->publishOwnPepItem(node, QXmppPubSubBaseItem(QStringLiteral("5")));
+    test.expectNoPacket();
+    psManager->setPepPublishInterval(node, 0);
+    QCOMPARE(psManager->pepPublishInterval(node), 0);
+    expectPublish(QStringLiteral("qxmpp4"), QStringLiteral("5"));
+    QCOMPARE(expectFutureVariant<QString>(fifth), QStringLiteral("5"));
+}
+
 void tst_QXmppPubSubManager::testRetractCurrentItem()
 {
     auto [test, psManager] = Client();
@@ -956,6 +1013,212 @@ void tst_QXmppPubSubManager::testRequestItemNotFound()
     auto error = expectFutureVariant<QXmppError>(future);
 }
 
+void tst_QXmppPubSubManager::testItemCache()
+{
+    auto [test, psManager] = Client();
+    psManager->setItemCacheLimit(1024 * 1024);
+    QCOMPARE(psManager->itemCacheLimit(), qint64(1024 * 1024));
+
+    auto future = psManager->requestItems<QXmppTuneItem>("pubsub.shakespeare.lit", "tunes");
+    test.expect(QStringLiteral("<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='get'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'><items node='tunes'/></pubsub>"
+                               "</iq>"));
+    test.inject(QStringLiteral("<iq type='result' from='pubsub.shakespeare.lit' id='qxmpp1'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                               "<items node='tunes'>"
+                               "<item id='a'><tune xmlns='http://jabber.org/protocol/tune'><title>Heart of the Sunrise</title></tune></item>"
+                               "<item id='b'><tune xmlns='http://jabber.org/protocol/tune'><title>Roundabout</title></tune></item>"
+                               "</items>"
+                               "</pubsub></iq>"));
+    auto items = expectFutureVariant<PSManager::Items<QXmppTuneItem>>(future).items;
+    QCOMPARE(items.size(), 2);
+
+    // answered from the cache
+    future = psManager->requestItems<QXmppTuneItem>("pubsub.shakespeare.lit", "tunes");
+    test.expectNoPacket();
+    items = expectFutureVariant<PSManager::Items<QXmppTuneItem>>(future).items;
+    QCOMPARE(items.size(), 2);
+    QCOMPARE(items.at(0).id(), QStringLiteral("a"));
+    QCOMPARE(items.at(1).title(), QStringLiteral("Roundabout"));
+
+    auto itemFuture = psManager->requestItem<QXmppTuneItem>("pubsub.shakespeare.lit", "tunes", "b");
+    test.expectNoPacket();
+    QCOMPARE(expectFutureVariant<QXmppTuneItem>(itemFuture).title(), QStringLiteral("Roundabout"));
+
+    // notifications update the cache
+    psManager->handleStanza(xmlToDom(QStringLiteral(
+        "<message from='pubsub.shakespeare.lit' to='francisco@denmark.lit' id='foo'>"
+        "<event xmlns='http://jabber.org/protocol/pubsub#event'>"
+        "<items node='tunes'>"
+        "<item id='b'><tune xmlns='http://jabber.org/protocol/tune'><title>Close to the Edge</title></tune></item>"
+        "<retract id='a'/>"
+        "</items>"
+        "</event>"
+        "</message>")));
+
+    itemFuture = psManager->requestItem<QXmppTuneItem>("pubsub.shakespeare.lit", "tunes", "b");
+    test.expectNoPacket();
+    QCOMPARE(expectFutureVariant<QXmppTuneItem>(itemFuture).title(), QStringLiteral("Close to the Edge"));
+
+    future = psManager->requestItems<QXmppTuneItem>("pubsub.shakespeare.lit", "tunes");
+    test.expectNoPacket();
+    items = expectFutureVariant<PSManager::Items<QXmppTuneItem>>(future).items;
+    QCOMPARE(items.size(), 1);
+    QCOMPARE(items.at(0).id(), QStringLiteral("b"));
+
+    // items of own requests are requested again
+    psManager->purgeItems("pubsub.shakespeare.lit", "tunes");
+    test.ignore();
+    future = psManager->requestItems<QXmppTuneItem>("pubsub.shakespeare.lit", "tunes");
+    test.expect(QStringLiteral("<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='get'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'><items node='tunes'/></pubsub>"
+                               "</iq>"));
+
+    // disabling the cache clears it
+    psManager->setItemCacheLimit(0);
+    itemFuture = psManager->requestItem<QXmppTuneItem>("pubsub.shakespeare.lit", "tunes", "b");
+    test.ignore();
+}
+
+void tst_QXmppPubSubManager::testItemCacheRefresh()
+{
+    auto [test, psManager] = Client();
+    psManager->setItemCacheLimit(1024 * 1024);
+
+    auto future = psManager->requestItems<QXmppTuneItem>("pubsub.shakespeare.lit", "tunes");
+    test.ignore();
+    test.inject(QStringLiteral("<iq type='result' from='pubsub.shakespeare.lit' id='qxmpp1'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                               "<items node='tunes'>"
+                               "<item id='a'><tune xmlns='http://jabber.org/protocol/tune'><title>Heart of the Sunrise</title></tune></item>"
+                               "<item id='b'><tune xmlns='http://jabber.org/protocol/tune'><title>Roundabout</title></tune></item>"
+                               "</items>"
+                               "</pubsub></iq>"));
+    expectFutureVariant<PSManager::Items<QXmppTuneItem>>(future);
+
+    // notifications may have been missed while disconnected
+    Q_EMIT test.connected();
+
+    // only the new item is requested
+    future = psManager->requestItems<QXmppTuneItem>("pubsub.shakespeare.lit", "tunes");
+    test.expect(QStringLiteral("<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='get'>"
+                               "<query xmlns='http://jabber.org/protocol/disco#items' node='tunes'/>"
+                               "</iq>"));
+    test.inject(QStringLiteral("<iq type='result' from='pubsub.shakespeare.lit' id='qxmpp1'>"
+                               "<query xmlns='http://jabber.org/protocol/disco#items' node='tunes'>"
+                               "<item jid='pubsub.shakespeare.lit' name='c'/>"
+                               "<item jid='pubsub.shakespeare.lit' name='b'/>"
+                               "</query></iq>"));
+    test.expect(QStringLiteral("<iq id='qxmpp2' to='pubsub.shakespeare.lit' type='get'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                               "<items node='tunes'><item id='c'/></items>"
+                               "</pubsub></iq>"));
+    test.inject(QStringLiteral("<iq type='result' from='pubsub.shakespeare.lit' id='qxmpp2'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                               "<items node='tunes'>"
+                               "<item id='c'><tune xmlns='http://jabber.org/protocol/tune'><title>South Side of the Sky</title></tune></item>"
+                               "</items>"
+                               "</pubsub></iq>"));
+
+    auto items = expectFutureVariant<PSManager::Items<QXmppTuneItem>>(future).items;
+    QCOMPARE(items.size(), 2);
+    QCOMPARE(items.at(0).title(), QStringLiteral("South Side of the Sky"));
+    QCOMPARE(items.at(1).title(), QStringLiteral("Roundabout"));
+
+    // the node is complete again
+    future = psManager->requestItems<QXmppTuneItem>("pubsub.shakespeare.lit", "tunes");
+    test.expectNoPacket();
+    QCOMPARE(expectFutureVariant<PSManager::Items<QXmppTuneItem>>(future).items.size(), 2);
+}
+
+void tst_QXmppPubSubManager::testRequestItemsBatch()
+{
+    auto [test, psManager] = Client();
+    psManager->setMaximumConcurrentRequests(2);
+    QCOMPARE(psManager->maximumConcurrentRequests(), 2);
+
+    auto future = psManager->requestItemsBatch<QXmppPubSubBaseItem>({
+        { QStringLiteral("pubsub.shakespeare.lit"), QStringLiteral("node1") },
+        { QStringLiteral("pubsub.shakespeare.lit"), QStringLiteral("node2") },
+        { QStringLiteral("pubsub.shakespeare.lit"), QStringLiteral("node3") },
+    });
+
+    // only two requests at the same time
+    test.expect(QStringLiteral("<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='get'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'><items node='node1'/></pubsub>"
+                               "</iq>"));
+    test.expect(QStringLiteral("<iq id='qxmpp2' to='pubsub.shakespeare.lit' type='get'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'><items node='node2'/></pubsub>"
+                               "</iq>"));
+    test.expectNoPacket();
+
+    test.inject(QStringLiteral("<iq type='result' from='pubsub.shakespeare.lit' id='qxmpp1'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                               "<items node='node1'><item id='a'/></items>"
+                               "</pubsub></iq>"));
+    test.expect(QStringLiteral("<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='get'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'><items node='node3'/></pubsub>"
+                               "</iq>"));
+    test.inject(QStringLiteral("<iq type='result' from='pubsub.shakespeare.lit' id='qxmpp1'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                               "<items node='node3'><item id='c'/></items>"
+                               "</pubsub></iq>"));
+
+    // throttled requests are repeated after a delay
+    test.inject(QStringLiteral("<iq type='error' from='pubsub.shakespeare.lit' id='qxmpp2'>"
+                               "<error type='wait'><resource-constraint xmlns='urn:ietf:params:xml:ns:xmpp-stanzas'/></error>"
+                               "</iq>"));
+    test.expectNoPacket();
+    QVERIFY(!future.isFinished());
+
+    QTest::qWait(1100);
+    test.expect(QStringLiteral("<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='get'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'><items node='node2'/></pubsub>"
+                               "</iq>"));
+    test.inject(QStringLiteral("<iq type='result' from='pubsub.shakespeare.lit' id='qxmpp1'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                               "<items node='node2'><item id='b'/></items>"
+                               "</pubsub></iq>"));
+
+    QVERIFY(future.isFinished());
+    const auto results = future.result();
+    QCOMPARE(results.size(), 3);
+    QCOMPARE(std::get<PSManager::Items<QXmppPubSubBaseItem>>(results.at(0)).items.constFirst().id(), QStringLiteral("a"));
+    QCOMPARE(std::get<PSManager::Items<QXmppPubSubBaseItem>>(results.at(1)).items.constFirst().id(), QStringLiteral("b"));
+    QCOMPARE(std::get<PSManager::Items<QXmppPubSubBaseItem>>(results.at(2)).items.constFirst().id(), QStringLiteral("c"));
+}
+
+void tst_QXmppPubSubManager::testRequestLazyItems()
+{
+    auto [test, psManager] = Client();
+
+    auto future = psManager->requestLazyItems<QXmppTuneItem>(QStringLiteral("pubsub.shakespeare.lit"), QStringLiteral("tunes"));
+    test.expect(QStringLiteral("<iq id='qxmpp1' to='pubsub.shakespeare.lit' type='get'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'><items node='tunes'/></pubsub>"
+                               "</iq>"));
+    test.inject(QStringLiteral("<iq type='result' from='pubsub.shakespeare.lit' id='qxmpp1'>"
+                               "<pubsub xmlns='http://jabber.org/protocol/pubsub'>"
+                               "<items node='tunes'>"
+                               "<item id='a' publisher='juliet@capulet.lit'><tune xmlns='http://jabber.org/protocol/tune'><title>Heart of the Sunrise</title></tune></item>"
+                               "<item id='b'/>"
+                               "</items>"
+                               "</pubsub></iq>"));
+
+    const auto items = expectFutureVariant<PSManager::Items<QXmppPubSubLazyItem<QXmppTuneItem>>>(future).items;
+    QCOMPARE(items.size(), 2);
+    QCOMPARE(items.at(0).id(), QStringLiteral("a"));
+    QCOMPARE(items.at(0).publisher(), QStringLiteral("juliet@capulet.lit"));
+    QVERIFY(items.at(0).hasPayload());
+    QVERIFY(!items.at(1).hasPayload());
+    QVERIFY(!items.at(0).isParsed());
+
+    // copies share the parsed item
+    const auto copy = items.at(0);
+    QCOMPARE(copy.item().title(), QStringLiteral("Heart of the Sunrise"));
+    QVERIFY(items.at(0).isParsed());
+    QVERIFY(!items.at(1).isParsed());
+}
+
 void tst_QXmppPubSubManager::testRequestNodeAffiliations()
 {
     auto [test, psManager] = Client();
@@ -0,0 +1,111 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppMetrics.h"
+#include "QXmppOfflineMessageMemoryStorage.h"
+#include "QXmppPushNotificationExtension.h"
+#include "QXmppServer.h"
+
+#include "util.h"
+
+#include <QDomDocument>
+
+class tst_QXmppPushNotificationExtension : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testRegistration();
+    Q_SLOT void testCoalescing();
+};
+
+static QDomElement element(const QString &xml)
+{
+    QDomDocument doc;
+    doc.setContent(xml, true);
+    return doc.documentElement();
+}
+
+static QDomElement enableIq(const QString &node)
+{
+    return element(QStringLiteral("<iq xmlns='jabber:client' type='set' id='enable' from='bob@localhost/phone'>"
+                                  "<enable xmlns='urn:xmpp:push:0' jid='push.example.net' node='%1'/>"
+                                  "</iq>")
+                       .arg(node));
+}
+
+static QDomElement chatMessage(const QString &body)
+{
+    return element(QStringLiteral("<message xmlns='jabber:client' from='alice@remote.example/home' to='bob@localhost' type='chat'><body>%1</body></message>").arg(body));
+}
+
+void tst_QXmppPushNotificationExtension::testRegistration()
+{
+    auto *push = new QXmppPushNotificationExtension;
+
+    QXmppServer server;
+    server.setDomain(QStringLiteral("localhost"));
+    server.addExtension(push);
+
+    // registering the same node again replaces the device
+    server.handleElement(enableIq(QStringLiteral("node1")));
+    server.handleElement(enableIq(QStringLiteral("node1")));
+    server.handleElement(enableIq(QStringLiteral("node2")));
+    QCOMPARE(push->deviceCount(QStringLiteral("bob@localhost")), 2);
+
+    // users of other servers can't register
+    server.handleElement(element(QStringLiteral("<iq xmlns='jabber:client' type='set' id='enable' from='alice@remote.example/home' to='bob@localhost'>"
+                                                "<enable xmlns='urn:xmpp:push:0' jid='push.example.net' node='node3'/>"
+                                                "</iq>")));
+    QCOMPARE(push->deviceCount(QStringLiteral("bob@localhost")), 2);
+    QCOMPARE(push->deviceCount(QStringLiteral("alice@remote.example")), 0);
+
+    server.handleElement(element(QStringLiteral("<iq xmlns='jabber:client' type='set' id='disable' from='bob@localhost/phone'>"
+                                                "<disable xmlns='urn:xmpp:push:0' jid='push.example.net' node='node1'/>"
+                                                "</iq>")));
+    QCOMPARE(push->deviceCount(QStringLiteral("bob@localhost")), 1);
+
+    // without a node, all devices of the app server are removed
+    server.handleElement(element(QStringLiteral("<iq xmlns='jabber:client' type='set' id='disable' from='bob@localhost/phone'>"
+                                                "<disable xmlns='urn:xmpp:push:0' jid='push.example.net'/>"
+                                                "</iq>")));
+    QCOMPARE(push->deviceCount(QStringLiteral("bob@localhost")), 0);
+}
+
+void tst_QXmppPushNotificationExtension::testCoalescing()
+{
+    QXmppMetrics::reset();
+
+    auto *push = new QXmppPushNotificationExtension;
+    push->setCoalescingWindow(100);
+    push->setDeviceRateLimit(0.5, 1);
+
+    QXmppOfflineMessageMemoryStorage storage;
+    QXmppServer server;
+    server.setDomain(QStringLiteral("localhost"));
+    server.setOfflineMessageStorage(&storage);
+    server.addExtension(push);
+    QVERIFY(server.listenForClients(QHostAddress::LocalHost, 12351));
+
+    server.handleElement(enableIq(QStringLiteral("node1")));
+    QCOMPARE(push->deviceCount(QStringLiteral("bob@localhost")), 1);
+
+    // the messages within the window result in one notification
+    for (const auto &body : { "one", "two", "three" }) {
+        server.handleElement(chatMessage(QLatin1String(body)));
+    }
+    QCOMPARE(QXmppMetrics::value(QXmppMetrics::CoalescedPushMessages), quint64(2));
+    QTRY_COMPARE(QXmppMetrics::value(QXmppMetrics::PushNotifications), quint64(1));
+
+    // the next notification is delayed by the rate limit
+    server.handleElement(chatMessage(QStringLiteral("four")));
+    QTest::qWait(500);
+    server.handleElement(chatMessage(QStringLiteral("five")));
+    QCOMPARE(QXmppMetrics::value(QXmppMetrics::PushNotifications), quint64(1));
+    QCOMPARE(QXmppMetrics::value(QXmppMetrics::CoalescedPushMessages), quint64(3));
+    QTRY_COMPARE_WITH_TIMEOUT(QXmppMetrics::value(QXmppMetrics::PushNotifications), quint64(2), 5000);
+}
+
+QTEST_MAIN(tst_QXmppPushNotificationExtension)
+#include "tst_qxmpppushnotificationextension.moc"
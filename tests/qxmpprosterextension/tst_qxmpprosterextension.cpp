@@ -0,0 +1,178 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppClient.h"
+#include "QXmppFutureUtils_p.h"
+#include "QXmppLogger.h"
+#include "QXmppRosterExtension.h"
+#include "QXmppRosterManager.h"
+#include "QXmppRosterMemoryStorage.h"
+#include "QXmppServer.h"
+#include "QXmppServerRosterStorage.h"
+
+#include "util.h"
+
+#include <algorithm>
+
+#include <QSignalSpy>
+
+using namespace QXmpp::Private;
+
+class TestRosterStorage : public QXmppServerRosterStorage
+{
+public:
+    QXmppTask<QVector<Roster>> loadRosters() override
+    {
+        return makeReadyTask(QVector<Roster>(rosters));
+    }
+
+    QXmppTask<void> storeRosters(const QVector<Roster> &changed) override
+    {
+        batches++;
+        for (const auto &roster : changed) {
+            rosters.erase(std::remove_if(rosters.begin(), rosters.end(), [&](const Roster &stored) {
+                              return stored.owner == roster.owner;
+                          }),
+                          rosters.end());
+            rosters << roster;
+        }
+        return makeReadyTask();
+    }
+
+    Roster roster(const QString &owner) const
+    {
+        for (const auto &roster : rosters) {
+            if (roster.owner == owner) {
+                return roster;
+            }
+        }
+        return {};
+    }
+
+    QVector<Roster> rosters;
+    int batches = 0;
+};
+
+class tst_QXmppRosterExtension : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testRoster();
+};
+
+void tst_QXmppRosterExtension::testRoster()
+{
+    const QString testDomain("localhost");
+    const QHostAddress testHost(QHostAddress::LocalHost);
+    const quint16 testPort = 12364;
+
+    TestRosterStorage storage;
+    storage.rosters << QXmppServerRosterStorage::Roster {
+        QStringLiteral("alice@localhost"),
+        3,
+        { { QStringLiteral("bob@localhost"), QStringLiteral("Bob"), { QStringLiteral("Friends") }, QXmppRosterIq::Item::Both, false } },
+    };
+    storage.rosters << QXmppServerRosterStorage::Roster {
+        QStringLiteral("bob@localhost"),
+        1,
+        { { QStringLiteral("alice@localhost"), {}, {}, QXmppRosterIq::Item::Both, false } },
+    };
+
+    TestPasswordChecker passwordChecker;
+    passwordChecker.addCredentials("alice", "testpwd");
+
+    auto *roster = new QXmppRosterExtension;
+    roster->setStorage(&storage);
+    roster->setWriteBehindDelay(10);
+
+    QXmppServer server;
+    server.setDomain(testDomain);
+    server.setPasswordChecker(&passwordChecker);
+    server.addExtension(roster);
+    QVERIFY(server.listenForClients(testHost, testPort));
+    QVERIFY(server.isRosterVersioningSupported());
+    QCOMPARE(roster->rosterVersion(QStringLiteral("alice@localhost")), QStringLiteral("3"));
+
+    // the presence subscribers are taken from the rosters
+    QCOMPARE(server.presenceSubscribers(QStringLiteral("alice@localhost")), QStringList { QStringLiteral("bob@localhost") });
+
+    const auto connectClient = [&](QXmppClient &client, const QString &resource) {
+        QXmppConfiguration config;
+        config.setDomain(testDomain);
+        config.setHost(testHost.toString());
+        config.setPort(testPort);
+        config.setUser(QStringLiteral("alice"));
+        config.setPassword("testpwd");
+        config.setResource(resource);
+        client.connectToServer(config);
+    };
+
+    // the full roster is sent to clients without a version
+    QXmppRosterMemoryStorage phoneStorage;
+    QXmppClient phone;
+    auto *phoneRoster = phone.findExtension<QXmppRosterManager>();
+    phoneRoster->setRosterStorage(&phoneStorage);
+    QSignalSpy phoneReceived(phoneRoster, &QXmppRosterManager::rosterReceived);
+    connectClient(phone, QStringLiteral("phone"));
+    QTRY_COMPARE(phoneReceived.size(), 1);
+    QCOMPARE(phoneRoster->getRosterBareJids(), QStringList { QStringLiteral("bob@localhost") });
+    QCOMPARE(phoneRoster->getRosterEntry(QStringLiteral("bob@localhost")).name(), QStringLiteral("Bob"));
+
+    // added contacts are pushed and written behind
+    auto addTask = phoneRoster->addRosterItem(QStringLiteral("carol@localhost"), QStringLiteral("Carol"));
+    QTRY_VERIFY(addTask.isFinished());
+    expectFutureVariant<QXmpp::Success>(addTask);
+    QTRY_VERIFY(phoneRoster->getRosterBareJids().contains(QStringLiteral("carol@localhost")));
+    QCOMPARE(roster->rosterVersion(QStringLiteral("alice@localhost")), QStringLiteral("4"));
+    QTRY_COMPARE(storage.batches, 1);
+    QCOMPARE(storage.roster(QStringLiteral("alice@localhost")).version, quint64(4));
+    QCOMPARE(storage.roster(QStringLiteral("alice@localhost")).contacts.size(), 2);
+
+    phone.disconnectFromServer();
+    QTRY_VERIFY(!phone.isConnected());
+
+    // another resource removes bob, which ends the subscriptions in both
+    // directions
+    QXmppClient laptop;
+    auto *laptopRoster = laptop.findExtension<QXmppRosterManager>();
+    QSignalSpy laptopReceived(laptopRoster, &QXmppRosterManager::rosterReceived);
+    connectClient(laptop, QStringLiteral("laptop"));
+    QTRY_COMPARE(laptopReceived.size(), 1);
+    auto removeTask = laptopRoster->removeRosterItem(QStringLiteral("bob@localhost"));
+    QTRY_VERIFY(removeTask.isFinished());
+    expectFutureVariant<QXmpp::Success>(removeTask);
+    QVERIFY(server.presenceSubscribers(QStringLiteral("alice@localhost")).isEmpty());
+    const auto bobItems = roster->rosterItems(QStringLiteral("bob@localhost"));
+    QCOMPARE(bobItems.size(), 1);
+    QCOMPARE(bobItems.first().subscriptionType(), QXmppRosterIq::Item::None);
+
+    // the phone only gets the removal of bob, not the whole roster
+    QXmppLogger logger;
+    logger.setLoggingType(QXmppLogger::SignalLogging);
+    QStringList received;
+    connect(&logger, &QXmppLogger::message, this, [&](QXmppLogger::MessageType type, const QString &text) {
+        if (type == QXmppLogger::ReceivedMessage) {
+            received << text;
+        }
+    });
+    phone.setLogger(&logger);
+    QSignalSpy phoneRemoved(phoneRoster, &QXmppRosterManager::itemRemoved);
+    connectClient(phone, QStringLiteral("phone"));
+    QTRY_COMPARE(phoneReceived.size(), 2);
+    QTRY_COMPARE(phoneRemoved.size(), 1);
+    QCOMPARE(phoneRoster->getRosterBareJids(), QStringList { QStringLiteral("carol@localhost") });
+    QVERIFY(std::none_of(received.cbegin(), received.cend(), [](const QString &data) {
+        return data.contains(QStringLiteral("carol@localhost"));
+    }));
+
+    QTRY_COMPARE(storage.roster(QStringLiteral("alice@localhost")).contacts.size(), 1);
+    QCOMPARE(storage.roster(QStringLiteral("bob@localhost")).contacts.first().subscriptionType, QXmppRosterIq::Item::None);
+
+    server.close();
+    QVERIFY(!server.isRosterVersioningSupported());
+}
+
+QTEST_MAIN(tst_QXmppRosterExtension)
+#include "tst_qxmpprosterextension.moc"
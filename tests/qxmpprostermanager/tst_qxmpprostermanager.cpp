@@ -6,6 +6,7 @@
 #include "QXmppClient.h"
 #include "QXmppDiscoveryManager.h"
 #include "QXmppRosterManager.h"
+#include "QXmppRosterMemoryStorage.h"
 
 #include "TestClient.h"
 
@@ -19,8 +20,10 @@ private:
     Q_SLOT void testDiscoFeatures();
     Q_SLOT void testRenameItem();
     Q_SLOT void subscriptionRequestReceived();
+    Q_SLOT void testPresencesChanged();
     Q_SLOT void testAddItem();
     Q_SLOT void testRemoveItem();
+    Q_SLOT void testRosterVersioning();
 
 private:
     QXmppClient client;
@@ -110,6 +113,48 @@ void tst_QXmppRosterManager::subscriptionRequestReceived()
     QVERIFY(subscriptionRequestReceived);
 }
 
+void tst_QXmppRosterManager::testPresencesChanged()
+{
+    TestClient test;
+    auto *rosterManager = test.addNewExtension<QXmppRosterManager>(&test);
+
+    auto receivePresence = [&](const QString &from, QXmppPresence::Type type) {
+        QXmppPresence presence(type);
+        presence.setFrom(from);
+        Q_EMIT test.presenceReceived(presence);
+    };
+
+    int presenceChangedCount = 0;
+    QVector<QVector<std::pair<QString, QString>>> batches;
+    connect(rosterManager, &QXmppRosterManager::presenceChanged, this, [&]() {
+        presenceChangedCount++;
+    });
+    connect(rosterManager, &QXmppRosterManager::presencesChanged, this, [&](const QVector<std::pair<QString, QString>> &changes) {
+        batches.append(changes);
+    });
+
+    receivePresence(QStringLiteral("alice@example.org/phone"), QXmppPresence::Available);
+    receivePresence(QStringLiteral("bob@example.org/laptop"), QXmppPresence::Available);
+    receivePresence(QStringLiteral("alice@example.org/phone"), QXmppPresence::Unavailable);
+
+    // single changes are reported immediately, the batch is delayed
+    QCOMPARE(presenceChangedCount, 3);
+    QVERIFY(batches.isEmpty());
+
+    QTRY_COMPARE(batches.size(), 1);
+    const QVector<std::pair<QString, QString>> expected {
+        { QStringLiteral("alice@example.org"), QStringLiteral("phone") },
+        { QStringLiteral("bob@example.org"), QStringLiteral("laptop") },
+    };
+    QCOMPARE(batches.first(), expected);
+    QCOMPARE(rosterManager->getResources(QStringLiteral("alice@example.org")), QStringList());
+    QCOMPARE(rosterManager->getPresence(QStringLiteral("bob@example.org"), QStringLiteral("laptop")).type(), QXmppPresence::Available);
+
+    receivePresence(QStringLiteral("alice@example.org/phone"), QXmppPresence::Available);
+    QTRY_COMPARE(batches.size(), 2);
+    QCOMPARE(batches.last().size(), 1);
+}
+
 void tst_QXmppRosterManager::testAddItem()
 {
     TestClient test;
@@ -162,5 +207,63 @@ void tst_QXmppRosterManager::testRemoveItem()
     QCOMPARE(error.text(), QStringLiteral("Not found"));
 }
 
+void tst_QXmppRosterManager::testRosterVersioning()
+{
+    TestClient test;
+    test.configuration().setJid(QStringLiteral("juliet@capulet.lit"));
+    auto *rosterManager = test.addNewExtension<QXmppRosterManager>(&test);
+
+    QXmppRosterMemoryStorage storage;
+    rosterManager->setRosterStorage(&storage);
+    QCOMPARE(rosterManager->rosterStorage(), &storage);
+
+    const auto features = xmlToDom(QStringLiteral("<stream:features xmlns:stream='http://etherx.jabber.org/streams'><ver xmlns='urn:xmpp:features:rosterver'/></stream:features>"));
+
+    int rosterReceivedCount = 0;
+    connect(rosterManager, &QXmppRosterManager::rosterReceived, this, [&]() {
+        rosterReceivedCount++;
+    });
+
+    // first session: nothing has been stored, the full roster is requested
+    QVERIFY(!rosterManager->handleStanza(features));
+    Q_EMIT test.connected();
+    test.expect("<iq id='qxmpp1' from='juliet@capulet.lit' type='get'><query xmlns='jabber:iq:roster' ver=''><annotate xmlns='urn:xmpp:mix:roster:0'/></query></iq>");
+    test.inject<QString>(
+        "<iq id='qxmpp1' type='result'><query xmlns='jabber:iq:roster' ver='ver1'>"
+        "<item jid='romeo@montague.lit' subscription='both'/>"
+        "<item jid='nurse@capulet.lit' subscription='from'/>"
+        "</query></iq>");
+    QCOMPARE(rosterReceivedCount, 1);
+    QCOMPARE(rosterManager->getRosterBareJids().size(), 2);
+
+    // roster pushes are applied to the storage
+    QVERIFY(rosterManager->handleStanza(xmlToDom(QStringLiteral(
+        "<iq id='push1' type='set'><query xmlns='jabber:iq:roster' ver='ver2'>"
+        "<item jid='nurse@capulet.lit' subscription='remove'/>"
+        "</query></iq>"))));
+    test.expect("<iq id='push1' type='result'/>");
+
+    auto task = storage.roster();
+    QVERIFY(task.isFinished());
+    const auto stored = task.takeResult();
+    QCOMPARE(stored.version, QStringLiteral("ver2"));
+    QCOMPARE(stored.items.size(), 1);
+    QCOMPARE(stored.items.first().bareJid(), QStringLiteral("romeo@montague.lit"));
+
+    // second session: the server confirms that the stored roster is up to date
+    Q_EMIT test.disconnected();
+    QVERIFY(!rosterManager->handleStanza(features));
+    Q_EMIT test.connected();
+    QVERIFY(rosterManager->getRosterBareJids().isEmpty());
+    test.expect("<iq id='qxmpp1' from='juliet@capulet.lit' type='get'><query xmlns='jabber:iq:roster' ver='ver2'><annotate xmlns='urn:xmpp:mix:roster:0'/></query></iq>");
+    test.inject<QString>("<iq id='qxmpp1' type='result'/>");
+    QCOMPARE(rosterReceivedCount, 2);
+    QCOMPARE(rosterManager->getRosterBareJids(), QStringList { QStringLiteral("romeo@montague.lit") });
+    QCOMPARE(rosterManager->getRosterEntry(QStringLiteral("romeo@montague.lit")).subscriptionType(), QXmppRosterIq::Item::Both);
+
+    rosterManager->setRosterStorage(nullptr);
+    QVERIFY(rosterManager->rosterStorage() != &storage);
+}
+
 QTEST_MAIN(tst_QXmppRosterManager)
 #include "tst_qxmpprostermanager.moc"
@@ -0,0 +1,136 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppPresence.h"
+#include "QXmppRosterIq.h"
+#include "QXmppRosterManager.h"
+#include "QXmppRosterModel.h"
+
+#include "TestClient.h"
+
+#include <QSignalSpy>
+
+class tst_QXmppRosterModel : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testItems();
+    Q_SLOT void testPresences();
+};
+
+static QXmppRosterIq::Item rosterItem(const QString &bareJid, const QString &name = {})
+{
+    QXmppRosterIq::Item item;
+    item.setBareJid(bareJid);
+    item.setName(name);
+    item.setSubscriptionType(QXmppRosterIq::Item::Both);
+    return item;
+}
+
+static void pushItems(QXmppRosterManager *manager, const QVector<QXmppRosterIq::Item> &items)
+{
+    QXmppRosterIq push;
+    push.setType(QXmppIq::Set);
+    for (const auto &item : items) {
+        push.addItem(item);
+    }
+    QVERIFY(manager->handleStanza(writePacketToDom(push)));
+}
+
+void tst_QXmppRosterModel::testItems()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppRosterManager>(&test);
+    QXmppRosterModel model(manager);
+    QCOMPARE(model.rosterManager(), manager);
+    QCOMPARE(model.rowCount(), 0);
+
+    QSignalSpy insertedSpy(&model, &QAbstractItemModel::rowsInserted);
+    QSignalSpy removedSpy(&model, &QAbstractItemModel::rowsRemoved);
+    QSignalSpy changedSpy(&model, &QAbstractItemModel::dataChanged);
+
+    // the contacts are sorted by their bare JIDs
+    pushItems(manager, { rosterItem("carol@example.org"), rosterItem("alice@example.org"), rosterItem("bob@example.org") });
+    QCOMPARE(insertedSpy.size(), 3);
+    QCOMPARE(model.rowCount(), 3);
+    QCOMPARE(model.rowOf("alice@example.org"), 0);
+    QCOMPARE(model.rowOf("bob@example.org"), 1);
+    QCOMPARE(model.rowOf("carol@example.org"), 2);
+    QCOMPARE(model.rowOf("dave@example.org"), -1);
+    QCOMPARE(model.index(0).data(Qt::DisplayRole).toString(), QStringLiteral("alice@example.org"));
+    QCOMPARE(model.index(0).data(QXmppRosterModel::SubscriptionTypeRole).toInt(), int(QXmppRosterIq::Item::Both));
+
+    // changed contacts keep their row
+    pushItems(manager, { rosterItem("alice@example.org", "Alice") });
+    QCOMPARE(insertedSpy.size(), 3);
+    QCOMPARE(changedSpy.size(), 1);
+    QCOMPARE(changedSpy.constFirst().at(0).toModelIndex().row(), 0);
+    QCOMPARE(model.index(0).data(QXmppRosterModel::NameRole).toString(), QStringLiteral("Alice"));
+    QCOMPARE(model.index(0).data(Qt::DisplayRole).toString(), QStringLiteral("Alice"));
+
+    auto removal = rosterItem("bob@example.org");
+    removal.setSubscriptionType(QXmppRosterIq::Item::Remove);
+    pushItems(manager, { removal });
+    QCOMPARE(removedSpy.size(), 1);
+    QCOMPARE(removedSpy.constFirst().at(1).toInt(), 1);
+    QCOMPARE(model.rowCount(), 2);
+    QCOMPARE(model.rowOf("bob@example.org"), -1);
+    QCOMPARE(model.rowOf("carol@example.org"), 1);
+
+    QVERIFY(model.roleNames().value(QXmppRosterModel::BareJidRole) == "bareJid");
+}
+
+void tst_QXmppRosterModel::testPresences()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppRosterManager>(&test);
+    QXmppRosterModel model(manager);
+    pushItems(manager, { rosterItem("alice@example.org"), rosterItem("bob@example.org"), rosterItem("carol@example.org") });
+
+    auto receivePresence = [&](const QString &from, QXmppPresence::AvailableStatusType status, int priority) {
+        QXmppPresence presence;
+        presence.setFrom(from);
+        presence.setAvailableStatusType(status);
+        presence.setPriority(priority);
+        presence.setStatusText(from);
+        Q_EMIT test.presenceReceived(presence);
+    };
+
+    QSignalSpy changedSpy(&model, &QAbstractItemModel::dataChanged);
+    receivePresence("alice@example.org/phone", QXmppPresence::Online, 1);
+    receivePresence("alice@example.org/laptop", QXmppPresence::Away, 5);
+    receivePresence("bob@example.org/phone", QXmppPresence::DND, 0);
+    receivePresence("stranger@example.org/phone", QXmppPresence::Online, 0);
+
+    // adjacent rows are reported at once
+    QTRY_COMPARE(changedSpy.size(), 1);
+    QCOMPARE(changedSpy.constFirst().at(0).toModelIndex().row(), 0);
+    QCOMPARE(changedSpy.constFirst().at(1).toModelIndex().row(), 1);
+
+    // the resource with the highest priority is used
+    const auto alice = model.index(0);
+    QVERIFY(alice.data(QXmppRosterModel::AvailableRole).toBool());
+    QCOMPARE(alice.data(QXmppRosterModel::ResourceCountRole).toInt(), 2);
+    QCOMPARE(alice.data(QXmppRosterModel::AvailableStatusTypeRole).toInt(), int(QXmppPresence::Away));
+    QCOMPARE(alice.data(QXmppRosterModel::StatusTextRole).toString(), QStringLiteral("alice@example.org/laptop"));
+    QCOMPARE(alice.data(QXmppRosterModel::PresenceRole).value<QXmppPresence>().priority(), 5);
+    QVERIFY(!model.index(2).data(QXmppRosterModel::AvailableRole).toBool());
+
+    changedSpy.clear();
+    QXmppPresence unavailable(QXmppPresence::Unavailable);
+    unavailable.setFrom("alice@example.org/laptop");
+    Q_EMIT test.presenceReceived(unavailable);
+    receivePresence("carol@example.org/phone", QXmppPresence::Chat, 0);
+
+    // rows that aren't adjacent are reported separately
+    QTRY_COMPARE(changedSpy.size(), 2);
+    QCOMPARE(changedSpy.at(0).at(0).toModelIndex().row(), 0);
+    QCOMPARE(changedSpy.at(1).at(0).toModelIndex().row(), 2);
+    QCOMPARE(alice.data(QXmppRosterModel::ResourceCountRole).toInt(), 1);
+    QCOMPARE(alice.data(QXmppRosterModel::AvailableStatusTypeRole).toInt(), int(QXmppPresence::Online));
+}
+
+QTEST_MAIN(tst_QXmppRosterModel)
+#include "tst_qxmpprostermodel.moc"
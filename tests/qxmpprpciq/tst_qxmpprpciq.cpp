@@ -50,6 +50,8 @@ private:
     Q_SLOT void testInvoke();
     Q_SLOT void testResponse();
     Q_SLOT void testResponseFault();
+
+    Q_SLOT void benchmarkStructArray();
 };
 void tst_QXmppRpcIq::testBase64()
 {
@@ -212,5 +214,36 @@ void tst_QXmppRpcIq::testResponseFault()
     serializePacket(iq, xml);
 }
 
+void tst_QXmppRpcIq::benchmarkStructArray()
+{
+    QVariantList records;
+    for (int i = 0; i < 2000; ++i) {
+        QMap<QString, QVariant> record;
+        record["id"] = i;
+        record["name"] = QStringLiteral("record %1").arg(i);
+        record["score"] = double(i) / 4;
+        record["enabled"] = bool(i % 2);
+        record["data"] = QByteArray(32, char(i));
+        records << QVariant(record);
+    }
+
+    QBuffer buffer;
+    buffer.open(QIODevice::ReadWrite);
+    QXmlStreamWriter writer(&buffer);
+    QXmppRpcMarshaller::marshall(&writer, records);
+
+    QDomDocument doc;
+    QVERIFY(doc.setContent(buffer.data(), true));
+    const QDomElement element = doc.documentElement();
+
+    QVariant value;
+    QBENCHMARK {
+        QStringList errors;
+        value = QXmppRpcMarshaller::demarshall(element, errors);
+        QVERIFY(errors.isEmpty());
+    }
+    QCOMPARE(value, QVariant(records));
+}
+
 QTEST_MAIN(tst_QXmppRpcIq)
 #include "tst_qxmpprpciq.moc"
@@ -21,6 +21,10 @@ private:
     Q_SLOT void testResponse_data();
     Q_SLOT void testResponse();
     Q_SLOT void testSuccess();
+    Q_SLOT void testSasl2Authenticate();
+    Q_SLOT void testSasl2AuthenticateFast();
+    Q_SLOT void testSasl2Success();
+    Q_SLOT void testSasl2Failure();
 
     // client
     Q_SLOT void testClientAvailableMechanisms();
@@ -31,10 +35,13 @@ private:
     Q_SLOT void testDigestMd5ParseMessage();
     Q_SLOT void testClientFacebook();
     Q_SLOT void testClientGoogle();
+    Q_SLOT void testClientHt();
+    Q_SLOT void testClientHt_bad();
     Q_SLOT void testClientPlain();
     Q_SLOT void testClientScramSha1();
     Q_SLOT void testClientScramSha1_bad();
     Q_SLOT void testClientScramSha256();
+    Q_SLOT void testClientScramKeys();
     Q_SLOT void testClientWindowsLive();
 
     // server
@@ -43,6 +50,8 @@ private:
     Q_SLOT void testServerDigestMd5();
     Q_SLOT void testServerPlain();
     Q_SLOT void testServerPlainChallenge();
+    Q_SLOT void testServerScramSha256();
+    Q_SLOT void testServerScramSha256_bad();
 };
 
 void tst_QXmppSasl::testParsing()
@@ -170,6 +179,121 @@ void tst_QXmppSasl::testSuccess()
     serializePacket(stanza, xml);
 }
 
+void tst_QXmppSasl::testSasl2Authenticate()
+{
+    const QByteArray xml =
+        "<authenticate xmlns=\"urn:xmpp:sasl:2\" mechanism=\"SCRAM-SHA-256\">"
+        "<initial-response>biwsbj11c2VyLHI9YWJj</initial-response>"
+        "<user-agent id=\"d4565fa7-4d72-4749-b3d3-740edbf87770\">"
+        "<software>AwesomeXMPP</software>"
+        "<device>Kiva Phone</device>"
+        "</user-agent>"
+        "<bind xmlns=\"urn:xmpp:bind:0\">"
+        "<tag>AwesomeXMPP</tag>"
+        "<enable xmlns=\"urn:xmpp:sm:3\" resume=\"true\"/>"
+        "</bind>"
+        "<resume xmlns=\"urn:xmpp:sm:3\" h=\"5\" previd=\"some-id\"/>"
+        "<request-token xmlns=\"urn:xmpp:fast:0\" mechanism=\"HT-SHA-256-NONE\"/>"
+        "</authenticate>";
+
+    QXmpp::Private::Sasl2::Authenticate authenticate;
+    parsePacket(authenticate, xml);
+    QCOMPARE(authenticate.mechanism, QStringLiteral("SCRAM-SHA-256"));
+    QCOMPARE(authenticate.initialResponse, QByteArray("n,,n=user,r=abc"));
+    QVERIFY(authenticate.userAgent);
+    QCOMPARE(authenticate.userAgent->id, QStringLiteral("d4565fa7-4d72-4749-b3d3-740edbf87770"));
+    QCOMPARE(authenticate.userAgent->software, QStringLiteral("AwesomeXMPP"));
+    QCOMPARE(authenticate.userAgent->device, QStringLiteral("Kiva Phone"));
+    QVERIFY(authenticate.bindRequest);
+    QCOMPARE(authenticate.bindRequest->tag, QStringLiteral("AwesomeXMPP"));
+    QVERIFY(authenticate.bindRequest->enableStreamManagement);
+    QVERIFY(authenticate.resume);
+    QCOMPARE(authenticate.resume->h(), 5u);
+    QCOMPARE(authenticate.resume->prevId(), QStringLiteral("some-id"));
+    QCOMPARE(authenticate.tokenRequestMechanism, QStringLiteral("HT-SHA-256-NONE"));
+    QVERIFY(!authenticate.fastCount);
+    serializePacket(authenticate, xml);
+}
+
+void tst_QXmppSasl::testSasl2AuthenticateFast()
+{
+    const QByteArray xml =
+        "<authenticate xmlns=\"urn:xmpp:sasl:2\" mechanism=\"HT-SHA-256-NONE\">"
+        "<initial-response>dXNlcgA/bekrRc3cUMYBrRZkWPe1h0Vl45nzAGsa+wPwuwP/iA==</initial-response>"
+        "<fast xmlns=\"urn:xmpp:fast:0\" count=\"3\"/>"
+        "</authenticate>";
+
+    QXmpp::Private::Sasl2::Authenticate authenticate;
+    parsePacket(authenticate, xml);
+    QCOMPARE(authenticate.mechanism, QStringLiteral("HT-SHA-256-NONE"));
+    QVERIFY(!authenticate.userAgent);
+    QVERIFY(!authenticate.bindRequest);
+    QVERIFY(!authenticate.resume);
+    QVERIFY(authenticate.tokenRequestMechanism.isEmpty());
+    QVERIFY(authenticate.fastCount);
+    QCOMPARE(*authenticate.fastCount, quint64(3));
+    serializePacket(authenticate, xml);
+}
+
+void tst_QXmppSasl::testSasl2Success()
+{
+    const QByteArray xml =
+        "<success xmlns=\"urn:xmpp:sasl:2\">"
+        "<additional-data>dj1zaWduYXR1cmU=</additional-data>"
+        "<authorization-identifier>user@example.org/AwesomeXMPP.abc</authorization-identifier>"
+        "<bound xmlns=\"urn:xmpp:bind:0\">"
+        "<enabled xmlns=\"urn:xmpp:sm:3\" id=\"sm-id\" resume=\"true\"/>"
+        "</bound>"
+        "<token xmlns=\"urn:xmpp:fast:0\" expiry=\"2026-03-12T14:36:15Z\" token=\"secret-token\"/>"
+        "</success>";
+
+    QXmpp::Private::Sasl2::Success success;
+    parsePacket(success, xml);
+    QCOMPARE(success.additionalData, QByteArray("v=signature"));
+    QCOMPARE(success.authorizationIdentifier, QStringLiteral("user@example.org/AwesomeXMPP.abc"));
+    QVERIFY(success.bound);
+    QVERIFY(success.enabled);
+    QCOMPARE(success.enabled->id(), QStringLiteral("sm-id"));
+    QVERIFY(success.enabled->resume());
+    QVERIFY(!success.resumed);
+    QVERIFY(success.token);
+    QCOMPARE(success.token->secret, QStringLiteral("secret-token"));
+    QCOMPARE(success.token->expiry, QDateTime(QDate(2026, 3, 12), QTime(14, 36, 15), Qt::UTC));
+    serializePacket(success, xml);
+
+    // resumed stream without binding
+    const QByteArray xml2 =
+        "<success xmlns=\"urn:xmpp:sasl:2\">"
+        "<authorization-identifier>user@example.org</authorization-identifier>"
+        "<resumed xmlns=\"urn:xmpp:sm:3\" h=\"7\" previd=\"sm-id\"/>"
+        "</success>";
+
+    QXmpp::Private::Sasl2::Success success2;
+    parsePacket(success2, xml2);
+    QVERIFY(success2.additionalData.isEmpty());
+    QVERIFY(!success2.bound);
+    QVERIFY(success2.resumed);
+    QCOMPARE(success2.resumed->h(), 7u);
+    QCOMPARE(success2.resumed->prevId(), QStringLiteral("sm-id"));
+    QVERIFY(!success2.token);
+    serializePacket(success2, xml2);
+}
+
+void tst_QXmppSasl::testSasl2Failure()
+{
+    const QByteArray xml =
+        "<failure xmlns=\"urn:xmpp:sasl:2\">"
+        "<not-authorized xmlns=\"urn:ietf:params:xml:ns:xmpp-sasl\"/>"
+        "<text>Wrong password</text>"
+        "</failure>";
+
+    QXmpp::Private::Sasl2::Failure failure;
+    parsePacket(failure, xml);
+    QCOMPARE(failure.condition, QStringLiteral("not-authorized"));
+    QCOMPARE(failure.text, QStringLiteral("Wrong password"));
+    serializePacket(failure, xml);
+}
+
 void tst_QXmppSasl::testClientAvailableMechanisms()
 {
     const QStringList expectedMechanisms = {
@@ -306,6 +430,50 @@ void tst_QXmppSasl::testClientGoogle()
     delete client;
 }
 
+void tst_QXmppSasl::testClientHt()
+{
+    QCOMPARE(QXmppSaslClientHt::availableMechanisms(),
+             QStringList({ "HT-SHA3-512-NONE", "HT-SHA-512-NONE", "HT-SHA-256-NONE" }));
+
+    QXmppSaslClient *client = QXmppSaslClient::create("HT-SHA-256-NONE");
+    QVERIFY(client != 0);
+    QCOMPARE(client->mechanism(), QLatin1String("HT-SHA-256-NONE"));
+
+    client->setUsername("user");
+    client->setPassword("secret-token");
+
+    // initial step returns the user and the hashed token
+    QByteArray response;
+    QVERIFY(client->respond(QByteArray(), response));
+    QCOMPARE(response, QByteArray("user\0", 5) + QByteArray::fromHex("3f6de92b45cddc50c601ad166458f7b5874565e399f3006b1afb03f0bb03ff88"));
+
+    // verify the server
+    QVERIFY(client->respond(QByteArray::fromHex("5572a63e0496195609273c23be8a50b9bee64e0369324079e73245bf4472a5b1"), response));
+    QCOMPARE(response, QByteArray());
+
+    // any further step is an error
+    QVERIFY(!client->respond(QByteArray(), response));
+
+    delete client;
+}
+
+void tst_QXmppSasl::testClientHt_bad()
+{
+    QXmppSaslClient *client = QXmppSaslClient::create("HT-SHA-256-NONE");
+    QVERIFY(client != 0);
+
+    client->setUsername("user");
+    client->setPassword("secret-token");
+
+    QByteArray response;
+    QVERIFY(client->respond(QByteArray(), response));
+
+    // the server does not know the token
+    QVERIFY(!client->respond(QByteArray::fromHex("00"), response));
+
+    delete client;
+}
+
 void tst_QXmppSasl::testClientPlain()
 {
     QXmppSaslClient *client = QXmppSaslClient::create("PLAIN");
@@ -414,6 +582,44 @@ void tst_QXmppSasl::testClientScramSha256()
     delete client;
 }
 
+void tst_QXmppSasl::testClientScramKeys()
+{
+    QXmppSaslDigestMd5::setNonce("fyko+d2lbbFgONRv9qkxdawL");
+    const QByteArray serverFirst("r=fyko+d2lbbFgONRv9qkxdawL3rfcNHYJY1ZVvWVs7j,s=QSXCR+Q6sek8bf92,i=4096");
+
+    QXmppSaslClientScram::Keys keys;
+    {
+        QXmppSaslClientScram client(QCryptographicHash::Sha1);
+        client.setUsername("user");
+        client.setPassword("pencil");
+
+        QByteArray response;
+        QVERIFY(client.respond(QByteArray(), response));
+        QVERIFY(client.respond(serverFirst, response));
+        keys = client.keys();
+        QCOMPARE(keys.salt, QByteArray::fromBase64("QSXCR+Q6sek8bf92"));
+        QCOMPARE(keys.iterations, 4096);
+    }
+
+    // the keys replace the password
+    QXmppSaslClientScram client(QCryptographicHash::Sha1);
+    client.setUsername("user");
+    client.setKeys(keys);
+
+    QByteArray response;
+    QVERIFY(client.respond(QByteArray(), response));
+    QVERIFY(client.respond(serverFirst, response));
+    QCOMPARE(response, QByteArray("c=biws,r=fyko+d2lbbFgONRv9qkxdawL3rfcNHYJY1ZVvWVs7j,p=v0X8v3Bz2T0CJGbJQyF0X+HI4Ts="));
+    QVERIFY(client.respond(QByteArray("v=rmF9pqV8S7suAoZWja4dJRkFsKQ"), response));
+
+    // without the password, other salts can't be used
+    QXmppSaslClientScram otherSalt(QCryptographicHash::Sha1);
+    otherSalt.setUsername("user");
+    otherSalt.setKeys(keys);
+    QVERIFY(otherSalt.respond(QByteArray(), response));
+    QVERIFY(!otherSalt.respond(QByteArray("r=fyko+d2lbbFgONRv9qkxdawL3rfcNHYJY1ZVvWVs7j,s=W22ZaJ0SNY7soEsUEjb6gQ==,i=4096"), response));
+}
+
 void tst_QXmppSasl::testClientWindowsLive()
 {
     QXmppSaslClient *client = QXmppSaslClient::create("X-MESSENGER-OAUTH2");
@@ -531,5 +737,65 @@ void tst_QXmppSasl::testServerPlainChallenge()
     delete server;
 }
 
+void tst_QXmppSasl::testServerScramSha256()
+{
+    QXmppSaslDigestMd5::setNonce("%hvYDpWUa2RaTCAfuxFIlj)hNlF$k0");
+
+    QXmppSaslServer *server = QXmppSaslServer::create("SCRAM-SHA-256");
+    QVERIFY(server != 0);
+    QCOMPARE(server->mechanism(), QLatin1String("SCRAM-SHA-256"));
+
+    // credentials needed
+    QByteArray response;
+    const QByteArray request("n,,n=user,r=rOprNGfwEbeRWgbNEkqO");
+    QCOMPARE(server->respond(request, response), QXmppSaslServer::InputNeeded);
+    QCOMPARE(server->username(), QLatin1String("user"));
+
+    const QByteArray salt = QByteArray::fromBase64("W22ZaJ0SNY7soEsUEjb6gQ==");
+    QByteArray storedKey, serverKey;
+    QXmppSaslServerScram::deriveKeys(QCryptographicHash::Sha256, "pencil", salt, 4096, storedKey, serverKey);
+    static_cast<QXmppSaslServerScram *>(server)->setCredentials(salt, 4096, storedKey, serverKey);
+
+    // first challenge
+    QCOMPARE(server->respond(request, response), QXmppSaslServer::Challenge);
+    QCOMPARE(response, QByteArray("r=rOprNGfwEbeRWgbNEkqO%hvYDpWUa2RaTCAfuxFIlj)hNlF$k0,s=W22ZaJ0SNY7soEsUEjb6gQ==,i=4096"));
+
+    // second challenge
+    QCOMPARE(server->respond(QByteArray("c=biws,r=rOprNGfwEbeRWgbNEkqO%hvYDpWUa2RaTCAfuxFIlj)hNlF$k0,p=dHzbZapWIk4jUhN+Ute9ytag9zjfMHgsqmmiz7AndVQ="), response), QXmppSaslServer::Challenge);
+    QCOMPARE(response, QByteArray("v=6rriTRBi23WpRR/wtup+mMhUZUn/dB5nLTJRsjl95G4="));
+
+    // success
+    QCOMPARE(server->respond(QByteArray(), response), QXmppSaslServer::Succeeded);
+    QCOMPARE(response, QByteArray());
+
+    // any further step is an error
+    QCOMPARE(server->respond(QByteArray(), response), QXmppSaslServer::Failed);
+
+    delete server;
+}
+
+void tst_QXmppSasl::testServerScramSha256_bad()
+{
+    QXmppSaslDigestMd5::setNonce("%hvYDpWUa2RaTCAfuxFIlj)hNlF$k0");
+
+    QXmppSaslServer *server = QXmppSaslServer::create("SCRAM-SHA-256");
+    QVERIFY(server != 0);
+
+    QByteArray response;
+    const QByteArray request("n,,n=user,r=rOprNGfwEbeRWgbNEkqO");
+    QCOMPARE(server->respond(request, response), QXmppSaslServer::InputNeeded);
+
+    const QByteArray salt = QByteArray::fromBase64("W22ZaJ0SNY7soEsUEjb6gQ==");
+    QByteArray storedKey, serverKey;
+    QXmppSaslServerScram::deriveKeys(QCryptographicHash::Sha256, "wrong", salt, 4096, storedKey, serverKey);
+    static_cast<QXmppSaslServerScram *>(server)->setCredentials(salt, 4096, storedKey, serverKey);
+    QCOMPARE(server->respond(request, response), QXmppSaslServer::Challenge);
+
+    // proof does not match
+    QCOMPARE(server->respond(QByteArray("c=biws,r=rOprNGfwEbeRWgbNEkqO%hvYDpWUa2RaTCAfuxFIlj)hNlF$k0,p=dHzbZapWIk4jUhN+Ute9ytag9zjfMHgsqmmiz7AndVQ="), response), QXmppSaslServer::Failed);
+
+    delete server;
+}
+
 QTEST_MAIN(tst_QXmppSasl)
 #include "tst_qxmppsasl.moc"
@@ -13,6 +13,7 @@ class tst_QXmppSceEnvelope : public QObject
 
 private:
     Q_SLOT void testReader();
+    Q_SLOT void testReaderFromXml();
     Q_SLOT void testWriter();
 };
 
@@ -34,6 +35,29 @@ void tst_QXmppSceEnvelope::testReader()
     QCOMPARE(reader.contentElement().firstChildElement().tagName(), QStringLiteral("body"));
 }
 
+void tst_QXmppSceEnvelope::testReaderFromXml()
+{
+    const QByteArray xml(
+        "<envelope xmlns=\"urn:xmpp:sce:1\">"
+        "<rpad>C1DHN9HK-9A25tSmwK4hU!Jji9%GKYK^syIlHJT9TnI4</rpad>"
+        "<from jid=\"opportunity@mars.planet\"/>"
+        "<to jid=\"missioncontrol@houston.nasa.gov\"/>"
+        "<content><body xmlns=\"jabber:client\">Hello</body></content>"
+        "<from jid=\"spirit@mars.planet\"/>"
+        "</envelope>");
+
+    const auto reader = QXmppSceEnvelopeReader::fromXml(xml);
+    QVERIFY(reader);
+    // the first affix element is used
+    QCOMPARE(reader->from(), QStringLiteral("opportunity@mars.planet"));
+    QCOMPARE(reader->to(), QStringLiteral("missioncontrol@houston.nasa.gov"));
+    QVERIFY(!reader->timestamp().isValid());
+    QCOMPARE(reader->contentElement().firstChildElement().text(), QStringLiteral("Hello"));
+
+    QVERIFY(!QXmppSceEnvelopeReader::fromXml("<envelope xmlns=\"urn:xmpp:sce:0\"/>"));
+    QVERIFY(!QXmppSceEnvelopeReader::fromXml("<envelope xmlns=\"urn:xmpp:sce:1\">"));
+}
+
 void tst_QXmppSceEnvelope::testWriter()
 {
     const auto expectedXml = QStringLiteral(
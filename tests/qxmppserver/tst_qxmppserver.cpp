@@ -3,10 +3,153 @@
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
 #include "QXmppClient.h"
+#include "QXmppLogger.h"
+#include "QXmppMessage.h"
+#include "QXmppMetrics.h"
+#include "QXmppOutgoingClient.h"
+#include "QXmppOfflineMessageMemoryStorage.h"
+#include "QXmppOutgoingServer.h"
+#include "QXmppPresence.h"
 #include "QXmppServer.h"
+#include "QXmppServerExtension.h"
+#include "QXmppSessionMemoryRegistry.h"
 
 #include "util.h"
 
+#include <atomic>
+
+#include <QMutex>
+#include <QSignalSpy>
+#include <QTcpSocket>
+#include <QThread>
+
+class CountingPasswordChecker : public TestPasswordChecker
+{
+public:
+    QXmppPasswordReply::Error getPassword(const QXmppPasswordRequest &request, QString &password) override
+    {
+        lookups++;
+        return TestPasswordChecker::getPassword(request, password);
+    }
+
+    std::atomic<int> lookups { 0 };
+};
+
+class RecordingExtension : public QXmppServerExtension
+{
+public:
+    RecordingExtension(int priority, QVector<StanzaFilter> filters, QStringList *calls)
+        : m_priority(priority), m_filters(std::move(filters)), m_calls(calls)
+    {
+    }
+
+    QString extensionName() const override { return QStringLiteral("recording%1").arg(m_priority); }
+    int extensionPriority() const override { return m_priority; }
+    QVector<StanzaFilter> stanzaFilters() const override { return m_filters; }
+    bool handleStanza(const QDomElement &stanza) override
+    {
+        *m_calls << extensionName() + u':' + stanza.tagName();
+        return false;
+    }
+
+private:
+    int m_priority;
+    QVector<StanzaFilter> m_filters;
+    QStringList *m_calls;
+};
+
+// Extension handling messages in the thread pool, messages without body are
+// passed on.
+class OffloadedExtension : public QXmppServerExtension
+{
+public:
+    QString extensionName() const override { return QStringLiteral("offloaded"); }
+    int extensionPriority() const override { return 1; }
+    QVector<StanzaFilter> stanzaFilters() const override { return { { QStringLiteral("message"), {}, {} } }; }
+    bool isOffloadable() const override { return true; }
+    bool handleStanza(const QDomElement &stanza) override
+    {
+        const auto body = stanza.firstChildElement(QStringLiteral("body")).text();
+        if (body.isEmpty()) {
+            return false;
+        }
+        // give the other sender a chance to overtake
+        QThread::msleep(5);
+
+        QMutexLocker locker(&mutex);
+        calls << stanza.attribute(QStringLiteral("from")) + u':' + body;
+        if (QThread::currentThread() == thread()) {
+            inServerThread = true;
+        }
+        return true;
+    }
+
+    QMutex mutex;
+    QStringList calls;
+    bool inServerThread = false;
+};
+
+// Extension blocking the thread of the server while handling messages.
+class SlowExtension : public QXmppServerExtension
+{
+public:
+    QString extensionName() const override { return QStringLiteral("slow"); }
+    QVector<StanzaFilter> stanzaFilters() const override { return { { QStringLiteral("message"), {}, {} } }; }
+    bool handleStanza(const QDomElement &) override
+    {
+        QThread::msleep(20);
+        return true;
+    }
+};
+
+// Client writing raw XML, so the connection can be lost without closing the
+// stream.
+class RawClient
+{
+public:
+    void connectToServer(quint16 port, const QString &username, const QString &password)
+    {
+        socket.connectToHost(QHostAddress::LocalHost, port);
+        QVERIFY(socket.waitForConnected());
+
+        openStream();
+        QVERIFY(waitFor(QStringLiteral("</stream:features>")).hasMatch());
+        const auto credentials = QByteArray('\0' + username.toUtf8() + '\0' + password.toUtf8()).toBase64();
+        write(QStringLiteral("<auth xmlns='urn:ietf:params:xml:ns:xmpp-sasl' mechanism='PLAIN'>%1</auth>").arg(QString::fromLatin1(credentials)));
+        QVERIFY(waitFor(QStringLiteral("<success")).hasMatch());
+
+        openStream();
+        QVERIFY(waitFor(QStringLiteral("urn:xmpp:sm:3.*</stream:features>")).hasMatch());
+    }
+
+    void openStream()
+    {
+        buffer.clear();
+        write(QStringLiteral("<?xml version='1.0'?><stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams' to='localhost' version='1.0'>"));
+    }
+
+    void write(const QString &xml)
+    {
+        socket.write(xml.toUtf8());
+    }
+
+    // waits until the received data matches the pattern
+    QRegularExpressionMatch waitFor(const QString &pattern)
+    {
+        const QRegularExpression regex(pattern, QRegularExpression::DotMatchesEverythingOption);
+        QRegularExpressionMatch match;
+        QTest::qWaitFor([&] {
+            buffer += QString::fromUtf8(socket.readAll());
+            match = regex.match(buffer);
+            return match.hasMatch();
+        });
+        return match;
+    }
+
+    QTcpSocket socket;
+    QString buffer;
+};
+
 class tst_QXmppServer : public QObject
 {
     Q_OBJECT
@@ -14,6 +157,22 @@ class tst_QXmppServer : public QObject
 private:
     Q_SLOT void testConnect_data();
     Q_SLOT void testConnect();
+    Q_SLOT void testPasswordCache();
+    Q_SLOT void testBroadcast();
+    Q_SLOT void testExtensionDispatch();
+    Q_SLOT void testOffloadedExtension();
+    Q_SLOT void testSlowHandlers();
+    Q_SLOT void testOfflineMessages();
+    Q_SLOT void testPresenceBroadcast();
+    Q_SLOT void testStreamResumption_data();
+    Q_SLOT void testStreamResumption();
+    Q_SLOT void testHandOver();
+    Q_SLOT void testDirectTls();
+    Q_SLOT void testAdmissionControl();
+    Q_SLOT void testRetryHint();
+    Q_SLOT void testOutgoingServerQueue();
+    Q_SLOT void testOutgoingServerQueueTimeout();
+    Q_SLOT void testCluster();
 };
 
 void tst_QXmppServer::testConnect_data()
@@ -22,26 +181,47 @@ void tst_QXmppServer::testConnect_data()
     QTest::addColumn<QString>("password");
     QTest::addColumn<QString>("mechanism");
     QTest::addColumn<bool>("connected");
+    QTest::addColumn<int>("workerThreads");
 
     QTest::newRow("plain-good") << "testuser"
                                 << "testpwd"
-                                << "PLAIN" << true;
+                                << "PLAIN" << true << 0;
     QTest::newRow("plain-bad-username") << "baduser"
                                         << "testpwd"
-                                        << "PLAIN" << false;
+                                        << "PLAIN" << false << 0;
     QTest::newRow("plain-bad-password") << "testuser"
                                         << "badpwd"
-                                        << "PLAIN" << false;
+                                        << "PLAIN" << false << 0;
 
     QTest::newRow("digest-good") << "testuser"
                                  << "testpwd"
-                                 << "DIGEST-MD5" << true;
+                                 << "DIGEST-MD5" << true << 0;
     QTest::newRow("digest-bad-username") << "baduser"
                                          << "testpwd"
-                                         << "DIGEST-MD5" << false;
+                                         << "DIGEST-MD5" << false << 0;
     QTest::newRow("digest-bad-password") << "testuser"
                                          << "badpwd"
-                                         << "DIGEST-MD5" << false;
+                                         << "DIGEST-MD5" << false << 0;
+
+    QTest::newRow("scram-sha256-good") << "testuser"
+                                       << "testpwd"
+                                       << "SCRAM-SHA-256" << true << 0;
+    QTest::newRow("scram-sha256-bad-username") << "baduser"
+                                               << "testpwd"
+                                               << "SCRAM-SHA-256" << false << 0;
+    QTest::newRow("scram-sha256-bad-password") << "testuser"
+                                               << "badpwd"
+                                               << "SCRAM-SHA-256" << false << 0;
+    QTest::newRow("scram-sha512-good-workers") << "testuser"
+                                               << "testpwd"
+                                               << "SCRAM-SHA-512" << true << 2;
+
+    QTest::newRow("plain-good-workers") << "testuser"
+                                        << "testpwd"
+                                        << "PLAIN" << true << 2;
+    QTest::newRow("plain-bad-password-workers") << "testuser"
+                                                << "badpwd"
+                                                << "PLAIN" << false << 2;
 }
 
 void tst_QXmppServer::testConnect()
@@ -50,6 +230,7 @@ void tst_QXmppServer::testConnect()
     QFETCH(QString, password);
     QFETCH(QString, mechanism);
     QFETCH(bool, connected);
+    QFETCH(int, workerThreads);
 
     const QString testDomain("localhost");
     const QHostAddress testHost(QHostAddress::LocalHost);
@@ -66,6 +247,7 @@ void tst_QXmppServer::testConnect()
     server.setDomain(testDomain);
     server.setLogger(&logger);
     server.setPasswordChecker(&passwordChecker);
+    server.setWorkerThreadCount(workerThreads);
     server.listenForClients(testHost, testPort);
 
     // prepare client
@@ -90,5 +272,738 @@ void tst_QXmppServer::testConnect()
     QCOMPARE(client.isConnected(), connected);
 }
 
+void tst_QXmppServer::testPasswordCache()
+{
+    CountingPasswordChecker checker;
+    checker.addCredentials("testuser", "testpwd");
+    checker.setCacheTimeout(60);
+    checker.setMaximumThreadCount(2);
+
+    const auto check = [&](const QString &username, const QString &password) {
+        QXmppPasswordRequest request;
+        request.setDomain("localhost");
+        request.setUsername(username);
+        request.setPassword(password);
+        return checker.checkPassword(request);
+    };
+
+    // concurrent requests share one lookup
+    std::unique_ptr<QXmppPasswordReply> first(check("testuser", "testpwd"));
+    std::unique_ptr<QXmppPasswordReply> second(check("testuser", "badpwd"));
+    QTRY_VERIFY(first->isFinished() && second->isFinished());
+    QCOMPARE(first->error(), QXmppPasswordReply::NoError);
+    QCOMPARE(second->error(), QXmppPasswordReply::AuthorizationError);
+    QCOMPARE(checker.lookups.load(), 1);
+
+    // cached password
+    std::unique_ptr<QXmppPasswordReply> cached(check("testuser", "testpwd"));
+    QTRY_VERIFY(cached->isFinished());
+    QCOMPARE(cached->error(), QXmppPasswordReply::NoError);
+    QCOMPARE(checker.lookups.load(), 1);
+
+    // cached unknown user
+    std::unique_ptr<QXmppPasswordReply> unknown(check("baduser", "testpwd"));
+    QTRY_VERIFY(unknown->isFinished());
+    std::unique_ptr<QXmppPasswordReply> cachedUnknown(check("baduser", "testpwd"));
+    QTRY_VERIFY(cachedUnknown->isFinished());
+    QCOMPARE(cachedUnknown->error(), QXmppPasswordReply::AuthorizationError);
+    QCOMPARE(checker.lookups.load(), 2);
+
+    checker.clearCache();
+    std::unique_ptr<QXmppPasswordReply> uncached(check("testuser", "testpwd"));
+    QTRY_VERIFY(uncached->isFinished());
+    QCOMPARE(uncached->error(), QXmppPasswordReply::NoError);
+    QCOMPARE(checker.lookups.load(), 3);
+}
+
+void tst_QXmppServer::testBroadcast()
+{
+    const QString testDomain("localhost");
+    const QHostAddress testHost(QHostAddress::LocalHost);
+    const quint16 testPort = 12346;
+
+    TestPasswordChecker passwordChecker;
+    passwordChecker.addCredentials("alice", "testpwd");
+    passwordChecker.addCredentials("bob", "testpwd");
+
+    QXmppServer server;
+    server.setDomain(testDomain);
+    server.setPasswordChecker(&passwordChecker);
+    QVERIFY(server.listenForClients(testHost, testPort));
+
+    const auto connectClient = [&](QXmppClient &client, const QString &username) {
+        QXmppConfiguration config;
+        config.setDomain(testDomain);
+        config.setHost(testHost.toString());
+        config.setPort(testPort);
+        config.setUser(username);
+        config.setPassword("testpwd");
+        client.connectToServer(config);
+    };
+
+    QXmppClient alice;
+    QXmppClient bob;
+    QList<QXmppMessage> aliceMessages;
+    QList<QXmppMessage> bobMessages;
+    connect(&alice, &QXmppClient::messageReceived, this, [&](const QXmppMessage &message) {
+        aliceMessages << message;
+    });
+    connect(&bob, &QXmppClient::messageReceived, this, [&](const QXmppMessage &message) {
+        bobMessages << message;
+    });
+    connectClient(alice, "alice");
+    connectClient(bob, "bob");
+    QTRY_VERIFY(alice.isConnected() && bob.isConnected());
+
+    QXmppMessage message;
+    message.setFrom(QStringLiteral("localhost"));
+    // the address of the stanza is replaced
+    message.setTo(QStringLiteral("nobody@localhost"));
+    message.setBody(QStringLiteral("Hello \"everyone\" <3"));
+
+    const QStringList recipients {
+        alice.configuration().jid(),
+        bob.configuration().jidBare(),
+        QStringLiteral("nobody@localhost"),
+    };
+    QCOMPARE(server.broadcastPacket(message, recipients), 2);
+
+    QTRY_COMPARE(aliceMessages.size(), 1);
+    QTRY_COMPARE(bobMessages.size(), 1);
+    QCOMPARE(aliceMessages.first().to(), alice.configuration().jid());
+    QCOMPARE(aliceMessages.first().from(), QStringLiteral("localhost"));
+    QCOMPARE(aliceMessages.first().body(), message.body());
+    QCOMPARE(bobMessages.first().to(), bob.configuration().jidBare());
+    QCOMPARE(bobMessages.first().body(), message.body());
+}
+
+void tst_QXmppServer::testExtensionDispatch()
+{
+    QStringList calls;
+    QXmppServer server;
+    server.setDomain(QStringLiteral("localhost"));
+    server.addExtension(new RecordingExtension(0, {}, &calls));
+    server.addExtension(new RecordingExtension(1, { { QStringLiteral("iq"), QStringLiteral("http://jabber.org/protocol/disco#info"), QStringLiteral("localhost") } }, &calls));
+    server.addExtension(new RecordingExtension(2, { { {}, QStringLiteral("urn:xmpp:ping"), {} }, { QStringLiteral("iq"), {}, {} } }, &calls));
+
+    const auto element = [](const QString &xml) {
+        QDomDocument doc;
+        doc.setContent(xml, true);
+        return doc.documentElement();
+    };
+
+    // only extensions without filters see messages
+    server.handleElement(element(QStringLiteral("<message xmlns='jabber:client' to='bob@localhost'/>")));
+    QCOMPARE(calls, QStringList { QStringLiteral("recording0:message") });
+
+    // extensions are called in the order of their priority, and only once
+    calls.clear();
+    server.handleElement(element(QStringLiteral("<iq xmlns='jabber:client' type='get' id='1' to='localhost'><query xmlns='http://jabber.org/protocol/disco#info'/></iq>")));
+    QCOMPARE(calls, QStringList({ QStringLiteral("recording2:iq"), QStringLiteral("recording1:iq"), QStringLiteral("recording0:iq") }));
+
+    calls.clear();
+    server.handleElement(element(QStringLiteral("<iq xmlns='jabber:client' type='get' id='2' to='remote.example'><ping xmlns='urn:xmpp:ping'/></iq>")));
+    QCOMPARE(calls, QStringList({ QStringLiteral("recording2:iq"), QStringLiteral("recording0:iq") }));
+
+    const auto extensions = server.statistics().value(QStringLiteral("extensions")).toMap();
+    QCOMPARE(extensions.value(QStringLiteral("recording0")).toMap().value(QStringLiteral("stanzas")).toULongLong(), 3ULL);
+    QCOMPARE(extensions.value(QStringLiteral("recording1")).toMap().value(QStringLiteral("stanzas")).toULongLong(), 1ULL);
+    QCOMPARE(extensions.value(QStringLiteral("recording2")).toMap().value(QStringLiteral("stanzas")).toULongLong(), 2ULL);
+}
+
+void tst_QXmppServer::testOffloadedExtension()
+{
+    QStringList calls;
+    auto *offloaded = new OffloadedExtension;
+    QXmppServer server;
+    server.setDomain(QStringLiteral("localhost"));
+    server.setExtensionThreadCount(2);
+    QCOMPARE(server.extensionThreadCount(), 2);
+    server.addExtension(offloaded);
+    server.addExtension(new RecordingExtension(0, {}, &calls));
+
+    const auto element = [](const QString &xml) {
+        QDomDocument doc;
+        doc.setContent(xml, true);
+        return doc.documentElement();
+    };
+
+    for (int i = 0; i < 5; ++i) {
+        for (const auto *from : { "alice@localhost/home", "carol@localhost/work" }) {
+            server.handleElement(element(QStringLiteral("<message xmlns='jabber:client' from='%1' to='bob@localhost'><body>%2</body></message>").arg(QLatin1String(from)).arg(i)));
+        }
+    }
+    // passed on to the next extension in the thread of the server
+    server.handleElement(element(QStringLiteral("<message xmlns='jabber:client' from='alice@localhost/home' to='bob@localhost'/>")));
+    // not handled by the offloadable extension at all
+    server.handleElement(element(QStringLiteral("<presence xmlns='jabber:client' from='alice@localhost/home'/>")));
+    QCOMPARE(calls, QStringList { QStringLiteral("recording0:presence") });
+
+    QTRY_COMPARE(calls.size(), 2);
+    QCOMPARE(calls.last(), QStringLiteral("recording0:message"));
+
+    QMutexLocker locker(&offloaded->mutex);
+    QVERIFY(!offloaded->inServerThread);
+    QCOMPARE(offloaded->calls.size(), 10);
+    for (const auto &from : { QStringLiteral("alice@localhost/home"), QStringLiteral("carol@localhost/work") }) {
+        QStringList bodies;
+        for (const auto &call : std::as_const(offloaded->calls)) {
+            if (call.startsWith(from)) {
+                bodies << call.mid(from.size() + 1);
+            }
+        }
+        QCOMPARE(bodies, QStringList({ QStringLiteral("0"), QStringLiteral("1"), QStringLiteral("2"), QStringLiteral("3"), QStringLiteral("4") }));
+    }
+    locker.unlock();
+
+    QTRY_COMPARE(server.statistics().value(QStringLiteral("extensions")).toMap().value(QStringLiteral("offloaded")).toMap().value(QStringLiteral("stanzas")).toULongLong(), 11ULL);
+}
+
+void tst_QXmppServer::testSlowHandlers()
+{
+    QXmppMetrics::reset();
+
+    QXmppLogger logger;
+    logger.setLoggingType(QXmppLogger::SignalLogging);
+    QStringList warnings;
+    connect(&logger, &QXmppLogger::message, this, [&](QXmppLogger::MessageType type, const QString &text) {
+        if (type == QXmppLogger::WarningMessage) {
+            warnings << text;
+        }
+    });
+
+    QXmppServer server;
+    server.setDomain(QStringLiteral("localhost"));
+    server.setLogger(&logger);
+    server.addExtension(new SlowExtension);
+
+    const auto element = [](const QString &xml) {
+        QDomDocument doc;
+        doc.setContent(xml, true);
+        return doc.documentElement();
+    };
+    const auto message = element(QStringLiteral("<message xmlns='jabber:client' from='alice@localhost/home' to='bob@localhost'><body>Hi</body></message>"));
+
+    // disabled by default
+    server.handleElement(message);
+    QVERIFY(warnings.isEmpty());
+    QCOMPARE(QXmppMetrics::count(QXmppMetrics::ExtensionHandlingTime), quint64(0));
+
+    server.setSlowHandlerThreshold(5);
+    QCOMPARE(server.slowHandlerThreshold(), 5);
+    server.handleElement(message);
+    QCOMPARE(warnings.size(), 1);
+    QVERIFY(warnings.constFirst().startsWith(QStringLiteral("Extension slow took ")));
+    QVERIFY(warnings.constFirst().endsWith(QStringLiteral("to handle message (jabber:client) from alice@localhost/home")));
+    QCOMPARE(QXmppMetrics::count(QXmppMetrics::ExtensionHandlingTime, QStringLiteral("slow")), quint64(1));
+
+    // the counters of the statistics are kept anyway
+    const auto extensions = server.statistics().value(QStringLiteral("extensions")).toMap();
+    QCOMPARE(extensions.value(QStringLiteral("slow")).toMap().value(QStringLiteral("stanzas")).toULongLong(), 2ULL);
+}
+
+void tst_QXmppServer::testOfflineMessages()
+{
+    const QString testDomain("localhost");
+    const QHostAddress testHost(QHostAddress::LocalHost);
+    const quint16 testPort = 12347;
+
+    TestPasswordChecker passwordChecker;
+    passwordChecker.addCredentials("bob", "testpwd");
+
+    QXmppOfflineMessageMemoryStorage storage;
+    QXmppServer server;
+    server.setDomain(testDomain);
+    server.setPasswordChecker(&passwordChecker);
+    server.setOfflineMessageStorage(&storage);
+    server.setOfflineMessageQuota(2);
+    QVERIFY(server.listenForClients(testHost, testPort));
+
+    const auto element = [](const QString &xml) {
+        QDomDocument doc;
+        doc.setContent(xml, true);
+        return doc.documentElement();
+    };
+
+    // the third message exceeds the quota, headlines are not stored
+    for (const auto &body : { "one", "two", "three" }) {
+        server.handleElement(element(QStringLiteral("<message xmlns='jabber:client' from='alice@remote.example/home' to='bob@localhost/phone' type='chat'><body>%1</body></message>").arg(QLatin1String(body))));
+    }
+    server.handleElement(element(QStringLiteral("<message xmlns='jabber:client' to='bob@localhost' type='headline'><body>news</body></message>")));
+
+    QXmppClient bob;
+    QList<QXmppMessage> messages;
+    connect(&bob, &QXmppClient::messageReceived, this, [&](const QXmppMessage &message) {
+        messages << message;
+    });
+
+    QXmppConfiguration config;
+    config.setDomain(testDomain);
+    config.setHost(testHost.toString());
+    config.setPort(testPort);
+    config.setUser("bob");
+    config.setPassword("testpwd");
+    bob.connectToServer(config);
+
+    QTRY_COMPARE(messages.size(), 2);
+    QCOMPARE(messages.at(0).body(), QStringLiteral("one"));
+    QCOMPARE(messages.at(1).body(), QStringLiteral("two"));
+    QCOMPARE(messages.at(0).from(), QStringLiteral("alice@remote.example/home"));
+    QVERIFY(messages.at(0).stamp().isValid());
+}
+
+void tst_QXmppServer::testPresenceBroadcast()
+{
+    const QString testDomain("localhost");
+    const QHostAddress testHost(QHostAddress::LocalHost);
+    const quint16 testPort = 12348;
+
+    TestPasswordChecker passwordChecker;
+    passwordChecker.addCredentials("alice", "testpwd");
+    passwordChecker.addCredentials("bob", "testpwd");
+
+    QXmppServer server;
+    server.setDomain(testDomain);
+    server.setPasswordChecker(&passwordChecker);
+    server.setPresenceSubscribers(QStringLiteral("alice@localhost"), { QStringLiteral("bob@localhost"), QStringLiteral("carol@localhost"), QStringLiteral("bob@localhost") });
+    QCOMPARE(server.presenceSubscribers(QStringLiteral("alice@localhost")), QStringList({ QStringLiteral("bob@localhost"), QStringLiteral("carol@localhost") }));
+    server.removePresenceSubscriber(QStringLiteral("alice@localhost"), QStringLiteral("carol@localhost"));
+    QCOMPARE(server.presenceSubscribers(QStringLiteral("alice@localhost")), QStringList { QStringLiteral("bob@localhost") });
+    QVERIFY(server.listenForClients(testHost, testPort));
+
+    const auto connectClient = [&](QXmppClient &client, const QString &username) {
+        QXmppConfiguration config;
+        config.setDomain(testDomain);
+        config.setHost(testHost.toString());
+        config.setPort(testPort);
+        config.setUser(username);
+        config.setPassword("testpwd");
+        client.connectToServer(config);
+    };
+
+    QXmppClient bob;
+    QList<QXmppPresence> presences;
+    connect(&bob, &QXmppClient::presenceReceived, this, [&](const QXmppPresence &presence) {
+        presences << presence;
+    });
+    connectClient(bob, "bob");
+    QTRY_VERIFY(bob.isConnected());
+
+    // the initial presence of alice is broadcast
+    QXmppClient alice;
+    connectClient(alice, "alice");
+    QTRY_COMPARE(presences.size(), 1);
+    QCOMPARE(presences.first().from(), alice.configuration().jid());
+    QCOMPARE(presences.first().to(), QStringLiteral("bob@localhost"));
+    QCOMPARE(presences.first().type(), QXmppPresence::Available);
+
+    // unchanged presences are skipped
+    QXmppPresence away;
+    away.setFrom(alice.configuration().jid());
+    away.setAvailableStatusType(QXmppPresence::Away);
+    QCOMPARE(server.broadcastPresence(away), 1);
+    QCOMPARE(server.broadcastPresence(away), 0);
+    QTRY_COMPARE(presences.size(), 2);
+    QCOMPARE(presences.last().availableStatusType(), QXmppPresence::Away);
+
+    // subscribers are told when alice goes offline
+    alice.disconnectFromServer();
+    QTRY_COMPARE(presences.size(), 3);
+    QCOMPARE(presences.last().type(), QXmppPresence::Unavailable);
+}
+
+void tst_QXmppServer::testStreamResumption_data()
+{
+    QTest::addColumn<int>("workerThreads");
+
+    QTest::newRow("main thread") << 0;
+    QTest::newRow("worker threads") << 2;
+}
+
+void tst_QXmppServer::testStreamResumption()
+{
+    QFETCH(int, workerThreads);
+
+    const QString testDomain("localhost");
+    const QHostAddress testHost(QHostAddress::LocalHost);
+    const quint16 testPort = 12349;
+
+    TestPasswordChecker passwordChecker;
+    passwordChecker.addCredentials("bob", "testpwd");
+
+    QXmppServer server;
+    server.setDomain(testDomain);
+    server.setPasswordChecker(&passwordChecker);
+    server.setWorkerThreadCount(workerThreads);
+    server.setStreamResumptionTimeout(60);
+    QVERIFY(server.listenForClients(testHost, testPort));
+
+    QSignalSpy connectedSpy(&server, &QXmppServer::clientConnected);
+    QSignalSpy disconnectedSpy(&server, &QXmppServer::clientDisconnected);
+
+    const auto sendMessage = [&](const QString &body) {
+        QXmppMessage message(QStringLiteral("alice@localhost/home"), QStringLiteral("bob@localhost/phone"), body);
+        QVERIFY(server.sendPacket(message));
+    };
+
+    // enable stream management with resumption
+    RawClient first;
+    first.connectToServer(testPort, "bob", "testpwd");
+    first.write(QStringLiteral("<iq type='set' id='bind1'><bind xmlns='urn:ietf:params:xml:ns:xmpp-bind'><resource>phone</resource></bind></iq>"));
+    QVERIFY(first.waitFor(QStringLiteral("bob@localhost/phone")).hasMatch());
+    first.write(QStringLiteral("<enable xmlns='urn:xmpp:sm:3' resume='true'/>"));
+    const auto enabled = first.waitFor(QStringLiteral("<enabled [^>]*id=\"([^\"]+)\"[^>]*/>"));
+    QVERIFY(enabled.hasMatch());
+    QVERIFY(enabled.captured().contains(QStringLiteral("resume=\"true\"")));
+    const auto id = enabled.captured(1);
+    QTRY_COMPARE(connectedSpy.count(), 1);
+
+    // the session is kept when the connection is lost
+    sendMessage(QStringLiteral("one"));
+    QVERIFY(first.waitFor(QStringLiteral("<body>one</body>")).hasMatch());
+    first.socket.abort();
+    QTest::qWait(100);
+    sendMessage(QStringLiteral("two"));
+    QCOMPARE(disconnectedSpy.count(), 0);
+
+    // unknown sessions can't be resumed
+    RawClient other;
+    other.connectToServer(testPort, "bob", "testpwd");
+    other.write(QStringLiteral("<resume xmlns='urn:xmpp:sm:3' h='0' previd='unknown'/>"));
+    QVERIFY(other.waitFor(QStringLiteral("<failed .*item-not-found")).hasMatch());
+
+    // the unacknowledged stanzas are resent on the new connection
+    server.setStreamResumptionTimeout(1);
+    RawClient second;
+    second.connectToServer(testPort, "bob", "testpwd");
+    second.write(QStringLiteral("<resume xmlns='urn:xmpp:sm:3' h='0' previd='%1'/>").arg(id));
+    QVERIFY(second.waitFor(QStringLiteral("<resumed [^>]*previd=\"%1\".*<body>one</body>.*<body>two</body>").arg(id)).hasMatch());
+    sendMessage(QStringLiteral("three"));
+    QVERIFY(second.waitFor(QStringLiteral("<body>three</body>")).hasMatch());
+    QCOMPARE(connectedSpy.count(), 1);
+    QCOMPARE(disconnectedSpy.count(), 0);
+
+    // the session is given up after the timeout
+    second.socket.abort();
+    QTRY_COMPARE(disconnectedSpy.count(), 1);
+    QCOMPARE(disconnectedSpy.first().first().toString(), QStringLiteral("bob@localhost/phone"));
+}
+
+void tst_QXmppServer::testHandOver()
+{
+    const quint16 oldPort = 12360;
+    const quint16 newPort = 12361;
+
+    TestPasswordChecker passwordChecker;
+    passwordChecker.addCredentials("bob", "testpwd");
+
+    QXmppServer oldServer;
+    oldServer.setDomain(QStringLiteral("localhost"));
+    oldServer.setPasswordChecker(&passwordChecker);
+    oldServer.setStreamResumptionTimeout(60);
+    QVERIFY(oldServer.listenForClients(QHostAddress::LocalHost, oldPort));
+    QCOMPARE(oldServer.clientListenerDescriptors().size(), 1);
+    QVERIFY(oldServer.clientListenerDescriptors().constFirst() >= 0);
+
+    QSignalSpy oldDisconnectedSpy(&oldServer, &QXmppServer::clientDisconnected);
+
+    RawClient resumable;
+    resumable.connectToServer(oldPort, "bob", "testpwd");
+    resumable.write(QStringLiteral("<iq type='set' id='bind1'><bind xmlns='urn:ietf:params:xml:ns:xmpp-bind'><resource>phone</resource></bind></iq>"));
+    QVERIFY(resumable.waitFor(QStringLiteral("bob@localhost/phone")).hasMatch());
+    resumable.write(QStringLiteral("<enable xmlns='urn:xmpp:sm:3' resume='true'/>"));
+    const auto enabled = resumable.waitFor(QStringLiteral("<enabled [^>]*id=\"([^\"]+)\"[^>]*/>"));
+    QVERIFY(enabled.hasMatch());
+    const auto id = enabled.captured(1);
+
+    RawClient other;
+    other.connectToServer(oldPort, "bob", "testpwd");
+    other.write(QStringLiteral("<iq type='set' id='bind1'><bind xmlns='urn:ietf:params:xml:ns:xmpp-bind'><resource>laptop</resource></bind></iq>"));
+    QVERIFY(other.waitFor(QStringLiteral("bob@localhost/laptop")).hasMatch());
+
+    QXmppMessage message(QStringLiteral("alice@localhost/home"), QStringLiteral("bob@localhost/phone"), QStringLiteral("one"));
+    QVERIFY(oldServer.sendPacket(message));
+    QVERIFY(resumable.waitFor(QStringLiteral("<body>one</body>")).hasMatch());
+
+    // the resumable session is detached without closing the stream, the
+    // other client is told to reconnect
+    const auto sessions = oldServer.handOver();
+    QVERIFY(other.waitFor(QStringLiteral("<system-shutdown xmlns='urn:ietf:params:xml:ns:xmpp-streams'/>")).hasMatch());
+    QTRY_COMPARE(resumable.socket.state(), QAbstractSocket::UnconnectedState);
+    resumable.buffer += QString::fromUtf8(resumable.socket.readAll());
+    QVERIFY(!resumable.buffer.contains(QStringLiteral("</stream:stream>")));
+    QTRY_COMPARE(oldDisconnectedSpy.count(), 1);
+    QCOMPARE(oldDisconnectedSpy.first().first().toString(), QStringLiteral("bob@localhost/laptop"));
+    oldServer.close();
+
+    QXmppServer newServer;
+    newServer.setDomain(QStringLiteral("localhost"));
+    newServer.setPasswordChecker(&passwordChecker);
+    newServer.setStreamResumptionTimeout(60);
+    QVERIFY(newServer.listenForClients(QHostAddress::LocalHost, newPort));
+
+    QSignalSpy newConnectedSpy(&newServer, &QXmppServer::clientConnected);
+    QCOMPARE(newServer.adoptSessions(QByteArrayLiteral("invalid")), 0);
+    QCOMPARE(newServer.adoptSessions(sessions), 1);
+    QCOMPARE(newConnectedSpy.count(), 1);
+    QCOMPARE(newConnectedSpy.first().first().toString(), QStringLiteral("bob@localhost/phone"));
+
+    // stanzas are queued until the client resumes its session
+    message.setBody(QStringLiteral("two"));
+    QVERIFY(newServer.sendPacket(message));
+
+    RawClient resumed;
+    resumed.connectToServer(newPort, "bob", "testpwd");
+    resumed.write(QStringLiteral("<resume xmlns='urn:xmpp:sm:3' h='0' previd='%1'/>").arg(id));
+    QVERIFY(resumed.waitFor(QStringLiteral("<resumed [^>]*previd=\"%1\".*<body>one</body>.*<body>two</body>").arg(id)).hasMatch());
+    QCOMPARE(newConnectedSpy.count(), 1);
+}
+
+void tst_QXmppServer::testDirectTls()
+{
+    QXmppSslServer sslServer;
+    QVERIFY(!sslServer.isDirectTls());
+    QVERIFY(sslServer.alpnProtocols().isEmpty());
+    sslServer.setDirectTls(true);
+    sslServer.setAlpnProtocols({ QByteArrayLiteral("xmpp-client") });
+    QVERIFY(sslServer.isDirectTls());
+    QCOMPARE(sslServer.alpnProtocols(), QList<QByteArray> { QByteArrayLiteral("xmpp-client") });
+
+    // TLS can't be started without a certificate
+    QXmppServer server;
+    server.setDomain(QStringLiteral("localhost"));
+    QVERIFY(!server.listenForClientsWithDirectTls(QHostAddress::LocalHost, 12362));
+    QVERIFY(!server.listenForServersWithDirectTls(QHostAddress::LocalHost, 12363));
+    QVERIFY(server.clientListenerDescriptors(true).isEmpty());
+
+    // the listeners are told apart
+    QVERIFY(server.listenForClients(QHostAddress::LocalHost, 12362));
+    QCOMPARE(server.clientListenerDescriptors().size(), 1);
+    QVERIFY(server.clientListenerDescriptors(true).isEmpty());
+}
+
+void tst_QXmppServer::testAdmissionControl()
+{
+    const quint16 testPort = 12350;
+    QXmppMetrics::reset();
+
+    TestPasswordChecker passwordChecker;
+    passwordChecker.addCredentials("bob", "testpwd");
+
+    QXmppServer server;
+    server.setDomain(QStringLiteral("localhost"));
+    server.setPasswordChecker(&passwordChecker);
+    server.setMaximumPendingClients(1);
+    server.setAdmissionQueueLimit(1, 10000);
+    server.setOverloadRedirectHost(QStringLiteral("xmpp2.localhost"));
+    QVERIFY(server.listenForClients(QHostAddress::LocalHost, testPort));
+
+    RawClient first;
+    first.connectToServer(testPort, "bob", "testpwd");
+
+    // the second connection waits for the first client to bind a resource
+    RawClient second;
+    second.socket.connectToHost(QHostAddress::LocalHost, testPort);
+    QVERIFY(second.socket.waitForConnected());
+    second.openStream();
+    QTRY_COMPARE(QXmppMetrics::value(QXmppMetrics::ClientAdmissionQueueLength), qint64(1));
+    QTest::qWait(100);
+    QVERIFY(second.socket.readAll().isEmpty());
+
+    // the queue is full, the third connection is redirected
+    RawClient third;
+    third.socket.connectToHost(QHostAddress::LocalHost, testPort);
+    QVERIFY(third.socket.waitForConnected());
+    QVERIFY(third.waitFor(QStringLiteral("<stream:error><see-other-host xmlns='urn:ietf:params:xml:ns:xmpp-streams'>xmpp2.localhost</see-other-host></stream:error>")).hasMatch());
+    QCOMPARE(QXmppMetrics::value(QXmppMetrics::RejectedClientConnections), quint64(1));
+
+    // the queued connection reads the stream header sent while it was waiting
+    first.write(QStringLiteral("<iq type='set' id='bind1'><bind xmlns='urn:ietf:params:xml:ns:xmpp-bind'><resource>phone</resource></bind></iq>"));
+    QVERIFY(first.waitFor(QStringLiteral("bob@localhost/phone")).hasMatch());
+    QVERIFY(second.waitFor(QStringLiteral("</stream:features>")).hasMatch());
+    QCOMPARE(QXmppMetrics::value(QXmppMetrics::ClientAdmissionQueueLength), qint64(0));
+}
+
+void tst_QXmppServer::testRetryHint()
+{
+    const quint16 testPort = 12359;
+
+    QXmppServer server;
+    server.setDomain(QStringLiteral("localhost"));
+    server.setMaximumPendingClients(1);
+    server.setAdmissionQueueLimit(0, 5000);
+    QVERIFY(server.listenForClients(QHostAddress::LocalHost, testPort));
+
+    RawClient pending;
+    pending.socket.connectToHost(QHostAddress::LocalHost, testPort);
+    QVERIFY(pending.socket.waitForConnected());
+    pending.openStream();
+    QVERIFY(pending.waitFor(QStringLiteral("</stream:features>")).hasMatch());
+
+    // the overloaded server tells the client how long to wait
+    QXmppOutgoingClient stream(nullptr);
+    stream.configuration().setDomain(QStringLiteral("localhost"));
+    stream.configuration().setHost(QStringLiteral("127.0.0.1"));
+    stream.configuration().setPort(testPort);
+    QList<QXmppClient::Error> errors;
+    connect(&stream, &QXmppOutgoingClient::error, this, [&](QXmppClient::Error error) {
+        errors << error;
+    });
+    stream.connectToHost();
+    QTRY_COMPARE(errors, QList<QXmppClient::Error> { QXmppClient::XmppStreamError });
+    QCOMPARE(stream.streamErrorRetryDelay(), 5000);
+
+    // the backoff is configurable
+    QXmppConfiguration config;
+    QCOMPARE(config.reconnectionBaseDelay(), 10000);
+    QCOMPARE(config.reconnectionMaximumDelay(), 60000);
+    config.setReconnectionDelay(500, 100);
+    QCOMPARE(config.reconnectionBaseDelay(), 500);
+    QCOMPARE(config.reconnectionMaximumDelay(), 500);
+}
+
+void tst_QXmppServer::testOutgoingServerQueue()
+{
+    const QByteArray presence("<presence from='a@example.com' to='b@example.org'><show>away</show></presence>");
+    const QByteArray message("<message from='a@example.com' to='b@example.org' id='1'/>");
+    const QByteArray result("<iq from='a@example.com' to='b@example.org' id='2' type='result'/>");
+
+    QXmppOutgoingServer stream(QStringLiteral("example.com"), nullptr);
+    QCOMPARE(stream.queueSize(), qint64(0));
+    QCOMPARE(stream.queueOverflowPolicy(), QXmppOutgoingServer::DropOldest);
+    stream.setQueueLimit(presence.size() + message.size() + result.size(), 0);
+
+    QList<QPair<QByteArray, bool>> dropped;
+    connect(&stream, &QXmppOutgoingServer::queuedDataDropped, this, [&](const QByteArray &data, bool bounce) {
+        dropped.append({ data, bounce });
+    });
+
+    stream.queueData(presence);
+    stream.queueData(message);
+    stream.queueData(result);
+    QVERIFY(dropped.isEmpty());
+    QCOMPARE(stream.queuedBytes(), stream.queueSize());
+
+    // presences are dropped first
+    const QByteArray message2("<message from='a@example.com' to='b@example.org' id='3'/>");
+    stream.queueData(message2);
+    QCOMPARE(dropped.size(), 1);
+    QCOMPARE(dropped.last().first, presence);
+    QVERIFY(!dropped.last().second);
+
+    // then the oldest stanzas of the same priority
+    stream.queueData(message2);
+    QCOMPARE(dropped.size(), 2);
+    QCOMPARE(dropped.last().first, message);
+
+    // new stanzas are bounced
+    stream.setQueueOverflowPolicy(QXmppOutgoingServer::Bounce);
+    stream.queueData(message2);
+    QCOMPARE(dropped.size(), 3);
+    QCOMPARE(dropped.last().first, message2);
+    QVERIFY(dropped.last().second);
+    QCOMPARE(stream.queuedBytes(), qint64(2 * message2.size() + result.size()));
+}
+
+void tst_QXmppServer::testOutgoingServerQueueTimeout()
+{
+    QXmppOutgoingServer stream(QStringLiteral("example.com"), nullptr);
+    stream.setQueueOverflowPolicy(QXmppOutgoingServer::Bounce);
+    stream.setQueueLimit(0, 50);
+
+    QList<QByteArray> dropped;
+    connect(&stream, &QXmppOutgoingServer::queuedDataDropped, this, [&](const QByteArray &data, bool bounce) {
+        QVERIFY(bounce);
+        dropped.append(data);
+    });
+
+    const QByteArray message("<message from='a@example.com' to='b@example.org' id='1'/>");
+    stream.queueData(message);
+    QVERIFY(dropped.isEmpty());
+    QTRY_COMPARE(dropped, QList<QByteArray> { message });
+    QCOMPARE(stream.queuedBytes(), qint64(0));
+}
+
+void tst_QXmppServer::testCluster()
+{
+    const QString testDomain("localhost");
+    const QHostAddress testHost(QHostAddress::LocalHost);
+
+    TestPasswordChecker passwordChecker;
+    passwordChecker.addCredentials("alice", "testpwd");
+    passwordChecker.addCredentials("bob", "testpwd");
+
+    // two nodes serving the same domain
+    QXmppSessionMemoryRegistry registry;
+    QXmppServer node1;
+    QXmppServer node2;
+    const auto setupNode = [&](QXmppServer &server, const QString &name, quint16 clientPort, quint16 peerPort) {
+        server.setDomain(testDomain);
+        server.setPasswordChecker(&passwordChecker);
+        server.setClusterNode(name, QByteArrayLiteral("secret"));
+        server.setSessionRegistry(&registry);
+        QVERIFY(server.listenForClients(testHost, clientPort));
+        QVERIFY(server.listenForClusterPeers(testHost, peerPort));
+    };
+    setupNode(node1, QStringLiteral("node1"), 12355, 12357);
+    setupNode(node2, QStringLiteral("node2"), 12356, 12358);
+    node1.addClusterPeer(QStringLiteral("node2"), testHost.toString(), 12358);
+    node2.addClusterPeer(QStringLiteral("node1"), testHost.toString(), 12357);
+    node1.setPresenceSubscribers(QStringLiteral("alice@localhost"), { QStringLiteral("bob@localhost") });
+
+    const auto connectClient = [&](QXmppClient &client, const QString &username, quint16 port) {
+        QXmppConfiguration config;
+        config.setDomain(testDomain);
+        config.setHost(testHost.toString());
+        config.setPort(port);
+        config.setUser(username);
+        config.setPassword("testpwd");
+        client.connectToServer(config);
+    };
+
+    QXmppClient bob;
+    QList<QXmppMessage> bobMessages;
+    QList<QXmppPresence> bobPresences;
+    connect(&bob, &QXmppClient::messageReceived, this, [&](const QXmppMessage &message) {
+        bobMessages << message;
+    });
+    connect(&bob, &QXmppClient::presenceReceived, this, [&](const QXmppPresence &presence) {
+        bobPresences << presence;
+    });
+    connectClient(bob, "bob", 12356);
+    QTRY_VERIFY(bob.isConnected());
+
+    // the presence of alice on the first node reaches her subscriber on the
+    // second one
+    QXmppClient alice;
+    QList<QXmppMessage> aliceMessages;
+    connect(&alice, &QXmppClient::messageReceived, this, [&](const QXmppMessage &message) {
+        aliceMessages << message;
+    });
+    connectClient(alice, "alice", 12355);
+    QTRY_VERIFY(alice.isConnected());
+    QTRY_COMPARE(bobPresences.size(), 1);
+    QCOMPARE(bobPresences.first().from(), alice.configuration().jid());
+
+    // messages to bare and full JIDs are forwarded
+    QVERIFY(alice.sendPacket(QXmppMessage(QString(), QStringLiteral("bob@localhost"), QStringLiteral("bare"))));
+    QVERIFY(alice.sendPacket(QXmppMessage(QString(), bob.configuration().jid(), QStringLiteral("full"))));
+    QTRY_COMPARE(bobMessages.size(), 2);
+    QCOMPARE(bobMessages.at(0).body(), QStringLiteral("bare"));
+    QCOMPARE(bobMessages.at(1).body(), QStringLiteral("full"));
+    QCOMPARE(bobMessages.at(1).from(), alice.configuration().jid());
+
+    QVERIFY(bob.sendPacket(QXmppMessage(QString(), alice.configuration().jid(), QStringLiteral("reply"))));
+    QTRY_COMPARE(aliceMessages.size(), 1);
+    QCOMPARE(aliceMessages.first().body(), QStringLiteral("reply"));
+
+    // sessions are removed from the registry when the clients disconnect
+    QSignalSpy removed(&registry, &QXmppSessionRegistry::sessionRemoved);
+    bob.disconnectFromServer();
+    QTRY_COMPARE(removed.size(), 1);
+    QCOMPARE(removed.first().at(0).toString(), bob.configuration().jid());
+    QCOMPARE(removed.first().at(1).toString(), QStringLiteral("node2"));
+}
+
 QTEST_MAIN(tst_QXmppServer)
 #include "tst_qxmppserver.moc"
@@ -2,10 +2,24 @@
 //
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#ifdef WITH_ZLIB
+#include "QXmppCompression_p.h"
+#endif
+#include "QXmppDiscoveryIq.h"
+#include "QXmppFutureUtils_p.h"
+#include "QXmppMetrics.h"
+#include "QXmppPacket_p.h"
+#include "QXmppStanzaView.h"
 #include "QXmppStream.h"
+#include "QXmppStreamManagementPolicy.h"
+#include "QXmppTokenBucket_p.h"
+#include "QXmppTask.h"
 
 #include "util.h"
 
+#include <QSslSocket>
+#include <QTcpServer>
+
 Q_DECLARE_METATYPE(QDomElement)
 
 class TestStream : public QXmppStream
@@ -39,6 +53,42 @@ public:
     Q_SIGNAL void stanzaReceived(const QDomElement &element);
 };
 
+class ViewStream : public TestStream
+{
+    Q_OBJECT
+
+public:
+    using TestStream::TestStream;
+
+    void handleStanza(const QDomElement &element) override
+    {
+        TestStream::handleStanza(element);
+    }
+
+    void handleStanza(const QXmppStanzaView &stanza) override
+    {
+        views.append(stanza);
+    }
+
+    QList<QXmppStanzaView> views;
+};
+
+class RecordingStream : public TestStream
+{
+    Q_OBJECT
+
+public:
+    using TestStream::TestStream;
+
+    bool sendData(const QByteArray &data) override
+    {
+        sent.append(data);
+        return true;
+    }
+
+    QList<QByteArray> sent;
+};
+
 class tst_QXmppStream : public QObject
 {
     Q_OBJECT
@@ -46,6 +96,23 @@ class tst_QXmppStream : public QObject
 private:
     Q_SLOT void initTestCase();
     Q_SLOT void testProcessData();
+    Q_SLOT void testProcessDataIncremental();
+    Q_SLOT void testStanzaView();
+    Q_SLOT void testStreamManagementQueue();
+    Q_SLOT void testStreamManagementPolicy();
+    Q_SLOT void testStreamManagementState();
+    Q_SLOT void testStreamManagementReplay();
+    Q_SLOT void testIqCoalescing();
+    Q_SLOT void testIqTimeout();
+    Q_SLOT void testIqCancellation();
+    Q_SLOT void testTokenBucket();
+    Q_SLOT void testStanzaLimits();
+    Q_SLOT void testBackgroundParsing();
+    Q_SLOT void testStatistics();
+    Q_SLOT void testBulkLane();
+#ifdef WITH_ZLIB
+    Q_SLOT void testCompression();
+#endif
 };
 
 void tst_QXmppStream::initTestCase()
@@ -118,5 +185,664 @@ void tst_QXmppStream::testProcessData()
     stream.processData(R"(</stream:stream>)");
 }
 
+void tst_QXmppStream::testProcessDataIncremental()
+{
+    TestStream stream(this);
+
+    QSignalSpy onStreamReceived(&stream, &TestStream::streamReceived);
+    QSignalSpy onStanzaReceived(&stream, &TestStream::stanzaReceived);
+
+    stream.processData(R"(<?xml version="1.0" encoding="UTF-8"?><stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams' version='1.0'>)");
+    QCOMPARE(onStreamReceived.size(), 1);
+
+    // complete stanzas are handed off immediately, without waiting for the next one
+    stream.processData(R"(<message id="1"><body>a</body></message><message id="2"><body>b</body></message><message id="3"><bo)");
+    QCOMPARE(onStanzaReceived.size(), 2);
+    QCOMPARE(onStanzaReceived[0][0].value<QDomElement>().attribute("id"), QStringLiteral("1"));
+    QCOMPARE(onStanzaReceived[1][0].value<QDomElement>().attribute("id"), QStringLiteral("2"));
+
+    // a stanza split into many small reads
+    // (also splits the UTF-8 encoded characters)
+    const QByteArray rest = R"(dy>Hello &amp; <![CDATA[<world>]]> moin )" + QStringLiteral("\u00e4\u20ac").toUtf8() + R"(</body><x xmlns="urn:example"><y a='1'/></x></message>)";
+    for (const auto byte : rest) {
+        QCOMPARE(onStanzaReceived.size(), 2);
+        stream.processData(QByteArray(1, byte));
+    }
+    QCOMPARE(onStanzaReceived.size(), 3);
+
+    const auto message = onStanzaReceived[2][0].value<QDomElement>();
+    QCOMPARE(message.tagName(), QStringLiteral("message"));
+    QCOMPARE(message.namespaceURI(), QStringLiteral("jabber:client"));
+    QCOMPARE(message.attribute("id"), QStringLiteral("3"));
+    QCOMPARE(message.firstChildElement("body").text(), QStringLiteral("Hello & <world> moin \u00e4\u20ac"));
+    QCOMPARE(message.firstChildElement("body").namespaceURI(), QStringLiteral("jabber:client"));
+
+    const auto x = message.firstChildElement("x");
+    QCOMPARE(x.namespaceURI(), QStringLiteral("urn:example"));
+    QCOMPARE(x.firstChildElement("y").namespaceURI(), QStringLiteral("urn:example"));
+    QCOMPARE(x.firstChildElement("y").attribute("a"), QStringLiteral("1"));
+
+    stream.processData(R"(</stream:stream>)");
+}
+
+void tst_QXmppStream::testStanzaView()
+{
+    ViewStream stream(this);
+    QSignalSpy onStanzaReceived(&stream, &TestStream::stanzaReceived);
+
+    stream.processData(R"(<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams'>)");
+    stream.processData(R"(<iq type='get' id='a1' xml:lang='en'><query xmlns='urn:x'><item n='1'>one</item><!-- c --><item n='2'>two</item></query></iq>)");
+
+    // the DOM overload is not called if the view overload is reimplemented
+    QCOMPARE(onStanzaReceived.size(), 0);
+    QCOMPARE(stream.views.size(), 1);
+
+    const auto iq = stream.views.first();
+    QVERIFY(!iq.isNull());
+    QCOMPARE(iq.tagName().toString(), QStringLiteral("iq"));
+    QCOMPARE(iq.namespaceUri().toString(), QStringLiteral("jabber:client"));
+    QCOMPARE(iq.attribute(u"type").toString(), QStringLiteral("get"));
+    QCOMPARE(iq.attribute(u"lang").toString(), QStringLiteral("en"));
+    QVERIFY(iq.hasAttribute(u"id"));
+    QVERIFY(!iq.hasAttribute(u"to"));
+    QVERIFY(iq.attribute(u"to").isEmpty());
+
+    const auto query = iq.firstChildElement(u"query", u"urn:x");
+    QVERIFY(!query.isNull());
+    QVERIFY(iq.firstChildElement(u"query", u"urn:y").isNull());
+
+    auto item = query.firstChildElement(u"item");
+    QCOMPARE(item.attribute(u"n").toString(), QStringLiteral("1"));
+    QCOMPARE(item.namespaceUri().toString(), QStringLiteral("urn:x"));
+    QCOMPARE(item.text(), QStringLiteral("one"));
+    item = item.nextSiblingElement(u"item");
+    QCOMPARE(item.attribute(u"n").toString(), QStringLiteral("2"));
+    QVERIFY(item.nextSiblingElement().isNull());
+    QCOMPARE(query.text(), QStringLiteral("onetwo"));
+
+    // lazy DOM conversion
+    const auto dom = iq.toDomElement();
+    QCOMPARE(dom.tagName(), QStringLiteral("iq"));
+    QCOMPARE(dom.namespaceURI(), QStringLiteral("jabber:client"));
+    QCOMPARE(dom.attribute("id"), QStringLiteral("a1"));
+    const auto domQuery = dom.firstChildElement("query");
+    QCOMPARE(domQuery.namespaceURI(), QStringLiteral("urn:x"));
+    QCOMPARE(domQuery.firstChildElement("item").text(), QStringLiteral("one"));
+    QCOMPARE(domQuery.lastChildElement("item").attribute("n"), QStringLiteral("2"));
+
+    // views of the same stanza share their DOM
+    QVERIFY(query.toDomElement() == domQuery);
+}
+
+static bool isAcknowledged(const QXmppTask<QXmpp::SendResult> &task)
+{
+    return task.isFinished() && std::get<QXmpp::SendSuccess>(task.result()).acknowledged;
+}
+
+void tst_QXmppStream::testStreamManagementQueue()
+{
+    TestStream stream(nullptr);
+    QXmppStream &base = stream;
+
+    QXmppMetrics::reset();
+    const auto queuedStanzas = [] { return QXmppMetrics::value(QXmppMetrics::StreamManagementQueuedStanzas); };
+    const auto queuedBytes = [] { return QXmppMetrics::value(QXmppMetrics::StreamManagementQueuedBytes); };
+
+    const auto stanza = QByteArrayLiteral("<message xmlns='jabber:client'/>");
+    std::vector<QXmppTask<QXmpp::SendResult>> tasks;
+    const auto send = [&](int count) {
+        for (int i = 0; i < count; i++) {
+            tasks.push_back(base.send(QXmppPacket(stanza, true)));
+        }
+    };
+
+    base.enableStreamManagement(true);
+    send(40);
+    QCOMPARE(queuedStanzas(), qint64(40));
+    QCOMPARE(queuedBytes(), qint64(40 * stanza.size()));
+
+    // acknowledge multiple stanzas at once
+    base.setAcknowledgedSequenceNumber(10);
+    QCOMPARE(queuedStanzas(), qint64(30));
+    QVERIFY(isAcknowledged(tasks[9]));
+    QVERIFY(!tasks[10].isFinished());
+
+    // outdated acknowledgements are ignored
+    base.setAcknowledgedSequenceNumber(5);
+    QCOMPARE(queuedStanzas(), qint64(30));
+
+    send(10);
+    QCOMPARE(queuedStanzas(), qint64(40));
+    base.setAcknowledgedSequenceNumber(50);
+    QCOMPARE(queuedStanzas(), qint64(0));
+    QCOMPARE(queuedBytes(), qint64(0));
+    QVERIFY(std::all_of(tasks.begin(), tasks.end(), isAcknowledged));
+
+    // the oldest stanzas are dropped when the limit is reached
+    tasks.clear();
+    base.setStreamManagementQueueLimit(3 * stanza.size(), false);
+    send(5);
+    QCOMPARE(queuedStanzas(), qint64(3));
+    QVERIFY(tasks[1].isFinished());
+    QVERIFY(!isAcknowledged(tasks[1]));
+    QVERIFY(!tasks[2].isFinished());
+
+    base.setAcknowledgedSequenceNumber(55);
+    QCOMPARE(queuedStanzas(), qint64(0));
+    QVERIFY(isAcknowledged(tasks[4]));
+}
+
+void tst_QXmppStream::testStreamManagementState()
+{
+    TestStream stream(nullptr);
+    QXmppStream &base = stream;
+
+    const auto stanza = [](int i) {
+        return QStringLiteral("<message xmlns='jabber:client' id='%1'/>").arg(i).toUtf8();
+    };
+    base.enableStreamManagement(true);
+    for (int i = 1; i <= 3; i++) {
+        base.send(QXmppPacket(stanza(i), true));
+    }
+    base.setAcknowledgedSequenceNumber(1);
+
+    QByteArray state;
+    QDataStream out(&state, QIODevice::WriteOnly);
+    base.saveStreamManagementState(out);
+
+    // restored by another stream
+    RecordingStream restored(nullptr);
+    QXmppStream &restoredBase = restored;
+    QDataStream in(state);
+    QVERIFY(restoredBase.restoreStreamManagementState(in));
+
+    // the sequence numbers continue
+    restoredBase.setAcknowledgedSequenceNumber(2);
+    restoredBase.enableStreamManagement(false);
+    QCOMPARE(restored.sent.size(), 2);
+    QCOMPARE(restored.sent.at(0), stanza(3));
+
+    // truncated state
+    RecordingStream broken(nullptr);
+    QXmppStream &brokenBase = broken;
+    QDataStream truncated(state.left(state.size() - 1));
+    QVERIFY(!brokenBase.restoreStreamManagementState(truncated));
+}
+
+void tst_QXmppStream::testStreamManagementReplay()
+{
+    RecordingStream stream(nullptr);
+    QXmppStream &base = stream;
+    QXmppMetrics::reset();
+
+    const auto stanza = [](int i) {
+        return QStringLiteral("<message xmlns='jabber:client' id='%1'/>").arg(i).toUtf8();
+    };
+    base.enableStreamManagement(true);
+    for (int i = 1; i <= 3000; i++) {
+        base.send(QXmppPacket(stanza(i), true));
+    }
+
+    // the acknowledgement of <resumed/> is applied before the stanzas are
+    // resent
+    base.setAcknowledgedSequenceNumber(1000);
+    stream.sent.clear();
+    base.enableStreamManagement(false);
+
+    QByteArray expected;
+    for (int i = 1001; i <= 3000; i++) {
+        expected += stanza(i);
+    }
+
+    // the stanzas are resent in a few large writes, followed by a request
+    QCOMPARE(stream.sent.size(), 3);
+    QVERIFY(stream.sent.at(0).size() <= 64 * 1024);
+    QCOMPARE(stream.sent.at(0) + stream.sent.at(1), expected);
+    QCOMPARE(stream.sent.at(2), QByteArrayLiteral("<r xmlns=\"urn:xmpp:sm:3\"/>"));
+
+    QCOMPARE(QXmppMetrics::value(QXmppMetrics::ReplayedStanzas), quint64(2000));
+    QCOMPARE(QXmppMetrics::value(QXmppMetrics::ReplayedBytes), quint64(expected.size()));
+    QCOMPARE(QXmppMetrics::count(QXmppMetrics::StreamResumptionReplayTime), quint64(1));
+}
+
+void tst_QXmppStream::testStreamManagementPolicy()
+{
+    RecordingStream stream(nullptr);
+    QXmppStream &base = stream;
+
+    const auto request = QByteArrayLiteral("<r xmlns=\"urn:xmpp:sm:3\"/>");
+    const auto stanza = QByteArrayLiteral("<message xmlns='jabber:client'/>");
+
+    QXmppStreamManagementPolicy policy;
+    policy.setRequestStanzaCount(3);
+    policy.setRequestInterval(50);
+    policy.setAcknowledgementDelay(50);
+    stream.setStreamManagementPolicy(policy);
+
+    stream.processData(R"(<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams'>)");
+    base.enableStreamManagement(true);
+
+    // acknowledgements are requested after three stanzas
+    base.send(QXmppPacket(stanza, true));
+    base.send(QXmppPacket(stanza, true));
+    QCOMPARE(stream.sent.count(request), 0);
+    base.send(QXmppPacket(stanza, true));
+    QCOMPARE(stream.sent.count(request), 1);
+
+    // or after the request interval
+    base.send(QXmppPacket(stanza, true));
+    QCOMPARE(stream.sent.count(request), 1);
+    QTRY_COMPARE(stream.sent.count(request), 2);
+
+    // requests of the peer are answered after the delay
+    stream.sent.clear();
+    stream.processData(R"(<message xmlns='jabber:client'/><r xmlns='urn:xmpp:sm:3'/>)");
+    QVERIFY(stream.sent.isEmpty());
+    QTRY_COMPARE(stream.sent, QList<QByteArray> { QByteArrayLiteral("<a xmlns=\"urn:xmpp:sm:3\" h=\"1\"/>") });
+
+    // or together with the next stanza
+    stream.sent.clear();
+    stream.processData(R"(<r xmlns='urn:xmpp:sm:3'/>)");
+    base.send(QXmppPacket(stanza, true));
+    QCOMPARE(stream.sent.size(), 2);
+    QCOMPARE(stream.sent.last(), QByteArrayLiteral("<a xmlns=\"urn:xmpp:sm:3\" h=\"1\"/>"));
+
+    // relaxed policy, e.g. while the client is inactive
+    QTRY_COMPARE(stream.sent.count(request), 1);
+    stream.sent.clear();
+    auto relaxed = policy;
+    relaxed.setRequestStanzaCount(0);
+    relaxed.setRequestInterval(0);
+    stream.setStreamManagementPolicy(relaxed);
+    for (int i = 0; i < 5; i++) {
+        base.send(QXmppPacket(stanza, true));
+    }
+    QTest::qWait(100);
+    QCOMPARE(stream.sent.count(request), 0);
+
+    // the pending stanzas are requested when the old policy is restored
+    stream.setStreamManagementPolicy(policy);
+    QCOMPARE(stream.sent.count(request), 1);
+}
+
+void tst_QXmppStream::testIqCoalescing()
+{
+    RecordingStream stream(nullptr);
+    stream.setIqCoalescingEnabled(true);
+    stream.processData(R"(<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams'>)");
+
+    const auto request = [](QXmppIq::Type type = QXmppIq::Get) {
+        QXmppDiscoveryIq iq;
+        iq.setType(type);
+        iq.setQueryNode(QStringLiteral("urn:xmpp:mix:nodes:info"));
+        return iq;
+    };
+
+    auto iq1 = request();
+    const auto id = iq1.id();
+    auto task1 = stream.sendIq(std::move(iq1), "mix.example.org");
+    auto task2 = stream.sendIq(request(), "mix.example.org");
+    QCOMPARE(stream.sent.size(), 1);
+
+    // other recipients and set requests are not coalesced
+    auto task3 = stream.sendIq(request(), "pubsub.example.org");
+    auto task4 = stream.sendIq(request(QXmppIq::Set), "mix.example.org");
+    QCOMPARE(stream.sent.size(), 3);
+
+    stream.processData(QStringLiteral("<iq xmlns='jabber:client' id='%1' from='mix.example.org' type='result'/>").arg(id).toUtf8());
+    QVERIFY(task1.isFinished());
+    QVERIFY(task2.isFinished());
+    QCOMPARE(expectVariant<QDomElement>(task1.result()).attribute("id"), id);
+    QCOMPARE(expectVariant<QDomElement>(task2.result()).attribute("id"), id);
+    QVERIFY(!task3.isFinished());
+    QVERIFY(!task4.isFinished());
+
+    // the response finished the coalesced request
+    auto task5 = stream.sendIq(request(), "mix.example.org");
+    QCOMPARE(stream.sent.size(), 4);
+
+    stream.cancelOngoingIqs();
+    QVERIFY(task3.isFinished());
+    QVERIFY(task5.isFinished());
+}
+
+void tst_QXmppStream::testIqTimeout()
+{
+    RecordingStream stream(nullptr);
+    stream.setIqTimeout(50);
+    stream.processData(R"(<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams'>)");
+    QXmppMetrics::reset();
+
+    QXmppDiscoveryIq unanswered;
+    auto task1 = stream.sendIq(std::move(unanswered), "example.org");
+    QXmppDiscoveryIq answered;
+    const auto id = answered.id();
+    auto task2 = stream.sendIq(std::move(answered), "example.org");
+
+    stream.processData(QStringLiteral("<iq xmlns='jabber:client' id='%1' from='example.org' type='result'/>").arg(id).toUtf8());
+    QVERIFY(task2.isFinished());
+    QVERIFY(!task1.isFinished());
+
+    // the round-trip time is recorded by the namespace of the request
+    QCOMPARE(QXmppMetrics::count(QXmppMetrics::IqRoundTripTime, QStringLiteral("http://jabber.org/protocol/disco#info")), quint64(1));
+
+    QTRY_VERIFY(task1.isFinished());
+    const auto error = expectVariant<QXmppError>(task1.result());
+    QVERIFY(error.value<QXmpp::SendError>() == QXmpp::SendError::Timeout);
+    QVERIFY(!stream.hasIqId(id));
+    QCOMPARE(QXmppMetrics::count(QXmppMetrics::IqRoundTripTime), quint64(1));
+}
+
+void tst_QXmppStream::testIqCancellation()
+{
+    RecordingStream stream(nullptr);
+    stream.setIqCoalescingEnabled(true);
+    stream.processData(R"(<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams'>)");
+    QSignalSpy onStanzaReceived(&stream, &TestStream::stanzaReceived);
+
+    QXmppDiscoveryIq request;
+    const auto id = request.id();
+    auto task = stream.sendIq(QXmppDiscoveryIq(request), "example.org");
+    auto coalesced = stream.sendIq(QXmppDiscoveryIq(request), "example.org");
+    QCOMPARE(stream.sent.size(), 1);
+
+    // the request keeps running while a coalesced request waits for it
+    task.cancel();
+    QVERIFY(stream.hasIqId(id));
+    coalesced.cancel();
+    QVERIFY(!stream.hasIqId(id));
+
+    // responses from other senders are not dropped
+    const auto response = QStringLiteral("<iq xmlns='jabber:client' id='%1' from='%2' type='result'/>");
+    stream.processData(response.arg(id, QStringLiteral("evil.example.org")).toUtf8());
+    QCOMPARE(onStanzaReceived.size(), 1);
+
+    // the response is dropped once
+    stream.processData(response.arg(id, QStringLiteral("example.org")).toUtf8());
+    QCOMPARE(onStanzaReceived.size(), 1);
+    QVERIFY(!task.isFinished());
+    QVERIFY(!coalesced.isFinished());
+    stream.processData(response.arg(id, QStringLiteral("example.org")).toUtf8());
+    QCOMPARE(onStanzaReceived.size(), 2);
+
+    // cancellation is forwarded to the IQ request
+    QXmppDiscoveryIq chained;
+    const auto chainedId = chained.id();
+    auto parsed = QXmpp::Private::chainIq<std::variant<QXmppDiscoveryIq, QXmppError>>(stream.sendIq(std::move(chained), "example.org"), this);
+    QVERIFY(stream.hasIqId(chainedId));
+    parsed.cancel();
+    QVERIFY(!stream.hasIqId(chainedId));
+}
+
+void tst_QXmppStream::testTokenBucket()
+{
+    QXmpp::Private::TokenBucket bucket;
+    QVERIFY(!bucket.isEnabled());
+    QCOMPARE(bucket.msecsUntilAvailable(), qint64(0));
+
+    // 10 tokens per second, bursts of 20 tokens
+    bucket.setRate(10, 20);
+    QVERIFY(bucket.isEnabled());
+    QCOMPARE(bucket.available(), 20.0);
+
+    bucket.consume(25);
+    QCOMPARE(bucket.available(), -5.0);
+    QCOMPARE(bucket.msecsUntilAvailable(), qint64(600));
+
+    bucket.refill(300);
+    QCOMPARE(bucket.available(), -2.0);
+    QCOMPARE(bucket.msecsUntilAvailable(), qint64(300));
+
+    // the burst size is not exceeded
+    bucket.refill(10000);
+    QCOMPARE(bucket.available(), 20.0);
+    QCOMPARE(bucket.msecsUntilAvailable(), qint64(0));
+}
+
+void tst_QXmppStream::testStanzaLimits()
+{
+    const auto streamHeader = QByteArrayLiteral("<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams'>");
+
+    // oversized stanza in one chunk
+    {
+        RecordingStream stream(nullptr);
+        stream.setMaximumStanzaSize(100);
+        QSignalSpy onStanzaReceived(&stream, &TestStream::stanzaReceived);
+        stream.processData(streamHeader);
+        stream.processData("<message xmlns='jabber:client'><body>short</body></message>");
+        QCOMPARE(onStanzaReceived.size(), 1);
+
+        stream.processData("<message xmlns='jabber:client'><body>" + QByteArray(200, 'a') + "</body></message>");
+        QCOMPARE(onStanzaReceived.size(), 1);
+        QCOMPARE(stream.sent.size(), 1);
+        QVERIFY(stream.sent.first().startsWith("<stream:error><policy-violation xmlns='urn:ietf:params:xml:ns:xmpp-streams'/>"));
+
+        // further data is ignored
+        stream.processData("<message xmlns='jabber:client'/>");
+        QCOMPARE(onStanzaReceived.size(), 1);
+        QCOMPARE(stream.sent.size(), 1);
+    }
+
+    // oversized stanza in small chunks
+    {
+        RecordingStream stream(nullptr);
+        stream.setMaximumStanzaSize(100);
+        stream.processData(streamHeader);
+        stream.processData("<message xmlns='jabber:client'><body>");
+        for (int i = 0; i < 10 && stream.sent.isEmpty(); i++) {
+            stream.processData(QByteArray(20, 'a'));
+        }
+        QCOMPARE(stream.sent.size(), 1);
+        QVERIFY(stream.sent.first().startsWith("<stream:error><policy-violation "));
+    }
+
+    // malformed XML
+    {
+        RecordingStream stream(nullptr);
+        stream.processData(streamHeader);
+        stream.processData("<message xmlns='jabber:client'></presence>");
+        QCOMPARE(stream.sent.size(), 1);
+        QVERIFY(stream.sent.first().startsWith("<stream:error><not-well-formed "));
+    }
+
+    // restricted XML
+    {
+        RecordingStream stream(nullptr);
+        stream.processData(streamHeader);
+        stream.processData("<?php echo 1; ?>");
+        QCOMPARE(stream.sent.size(), 1);
+        QVERIFY(stream.sent.first().startsWith("<stream:error><restricted-xml "));
+    }
+}
+
+void tst_QXmppStream::testBackgroundParsing()
+{
+    const auto streamHeader = QByteArrayLiteral("<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams'>");
+
+    RecordingStream stream(nullptr);
+    stream.setBackgroundParsingEnabled(true);
+    stream.handleStart();
+    QSignalSpy onStreamReceived(&stream, &TestStream::streamReceived);
+    QSignalSpy onStanzaReceived(&stream, &TestStream::stanzaReceived);
+
+    stream.processData(streamHeader);
+    stream.processData("<message xmlns='jabber:client' id='1'><body>one</bo");
+    stream.processData("dy></message><presence xmlns='jabber:client' id='2'/>");
+    // the data is parsed in the worker thread
+    QCOMPARE(onStanzaReceived.size(), 0);
+    QTRY_COMPARE(onStanzaReceived.size(), 2);
+    QCOMPARE(onStreamReceived.size(), 1);
+
+    auto message = onStanzaReceived[0][0].value<QDomElement>();
+    QCOMPARE(message.tagName(), QStringLiteral("message"));
+    QCOMPARE(message.firstChildElement(QStringLiteral("body")).text(), QStringLiteral("one"));
+    QCOMPARE(onStanzaReceived[1][0].value<QDomElement>().attribute(QStringLiteral("id")), QStringLiteral("2"));
+
+    // events of the previous stream are dropped after a restart
+    stream.processData("<iq xmlns='jabber:client' id='3' type='get'/>");
+    stream.handleStart();
+    stream.processData(streamHeader);
+    QTRY_COMPARE(onStreamReceived.size(), 2);
+    QCOMPARE(onStanzaReceived.size(), 2);
+
+    // errors are reported in the thread of the stream
+    stream.processData("<message xmlns='jabber:client'><</message>");
+    QTRY_COMPARE(stream.sent.size(), 1);
+    QVERIFY(stream.sent.first().startsWith("<stream:error><not-well-formed"));
+
+    // the setting is applied when the stream starts
+    stream.setBackgroundParsingEnabled(false);
+    stream.handleStart();
+    stream.processData(streamHeader);
+    QCOMPARE(onStreamReceived.size(), 3);
+}
+
+void tst_QXmppStream::testStatistics()
+{
+    RecordingStream stream(nullptr);
+    QXmppStream &base = stream;
+    QCOMPARE(stream.statistics().lastActivity, qint64(0));
+
+    const auto streamHeader = QByteArrayLiteral("<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams'>");
+    const auto stanzas = QByteArrayLiteral("<message xmlns='jabber:client'/><presence xmlns='jabber:client'/><iq xmlns='jabber:client' type='get' id='1'/>");
+    stream.processData(streamHeader);
+    stream.processData(stanzas);
+    stream.processData(R"(<r xmlns='urn:xmpp:sm:3'/>)");
+
+    base.send(QXmppPacket(QByteArrayLiteral("<message xmlns=\"jabber:client\"/>"), true));
+    base.send(QXmppPacket(QByteArrayLiteral("<iq xmlns=\"jabber:client\" type=\"result\" id=\"1\"/>"), true));
+    base.send(QXmppPacket(QByteArrayLiteral("<a xmlns=\"urn:xmpp:sm:3\" h=\"0\"/>"), false));
+
+    const auto statistics = stream.statistics();
+    QCOMPARE(statistics.bytesReceived, quint64(streamHeader.size() + stanzas.size() + 26));
+    QCOMPARE(statistics.receivedMessages, quint64(1));
+    QCOMPARE(statistics.receivedPresences, quint64(1));
+    QCOMPARE(statistics.receivedIqs, quint64(1));
+    QCOMPARE(statistics.receivedNonzas, quint64(1));
+    QCOMPARE(statistics.sentMessages, quint64(1));
+    QCOMPARE(statistics.sentPresences, quint64(0));
+    QCOMPARE(statistics.sentIqs, quint64(1));
+    QCOMPARE(statistics.sentNonzas, quint64(1));
+    QVERIFY(statistics.parseTime > 0);
+    QCOMPARE(statistics.streamManagementQueuedStanzas, qint64(0));
+    QVERIFY(statistics.lastActivity > 0);
+
+    // the buffers kept for reuse are released
+    stream.squeeze();
+    QCOMPARE(stream.statistics().bufferedBytes, qint64(0));
+}
+
+void tst_QXmppStream::testBulkLane()
+{
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost));
+
+    TestStream stream(nullptr);
+    QXmppStream &base = stream;
+    auto *socket = new QSslSocket(&stream);
+    base.setSocket(socket);
+    stream.setBulkWriteThreshold(1000);
+    QCOMPARE(stream.bulkWriteThreshold(), qint64(1000));
+
+    QSignalSpy started(&stream, &TestStream::started);
+    socket->connectToHost(server.serverAddress(), server.serverPort());
+    QVERIFY(server.waitForNewConnection(5000));
+    auto *peer = server.nextPendingConnection();
+    QTRY_COMPARE(started.size(), 1);
+
+    const auto ibbData = [](int seq) {
+        return QByteArrayLiteral("<iq xmlns=\"jabber:client\" type=\"set\" id=\"ibb") + QByteArray::number(seq) +
+            QByteArrayLiteral("\" to=\"bob@example.org/a\"><data xmlns=\"http://jabber.org/protocol/ibb\" seq=\"") + QByteArray::number(seq) +
+            QByteArrayLiteral("\" sid=\"s1\">") + QByteArray(2000, 'A') + QByteArrayLiteral("</data></iq>");
+    };
+
+    // the first chunk is written, the second one waits for the socket
+    auto first = base.send(QXmppPacket(ibbData(0), true));
+    QVERIFY(first.isFinished());
+    auto second = base.send(QXmppPacket(ibbData(1), true));
+    QVERIFY(!second.isFinished());
+
+    // messages and other IQs are written before it
+    const auto message = QByteArrayLiteral("<message xmlns=\"jabber:client\" to=\"bob@example.org\"><body>Hi</body></message>");
+    const auto ping = QByteArrayLiteral("<iq xmlns=\"jabber:client\" type=\"get\" id=\"p1\"><ping xmlns=\"urn:xmpp:ping\"/></iq>");
+    QVERIFY(base.send(QXmppPacket(message, true)).isFinished());
+    QVERIFY(base.send(QXmppPacket(ping, true)).isFinished());
+
+    QByteArray received;
+    QTRY_VERIFY((received += peer->readAll()).endsWith(ibbData(1)));
+    QCOMPARE(received, ibbData(0) + message + ping + ibbData(1));
+    QVERIFY(second.isFinished());
+    QVERIFY(std::holds_alternative<QXmpp::SendSuccess>(second.result()));
+
+    // held back stanzas fail without stream management when disconnecting
+    base.send(QXmppPacket(ibbData(2), true));
+    auto held = base.send(QXmppPacket(ibbData(3), true));
+    QVERIFY(!held.isFinished());
+    stream.disconnectFromHost();
+    QVERIFY(held.isFinished());
+    QVERIFY(std::holds_alternative<QXmppError>(held.result()));
+}
+
 QTEST_MAIN(tst_QXmppStream)
+#ifdef WITH_ZLIB
+void tst_QXmppStream::testCompression()
+{
+    using namespace QXmpp::Private;
+
+    ZlibCompressor compressor;
+    ZlibDecompressor decompressor;
+    QVERIFY(compressor.isValid());
+    QVERIFY(decompressor.isValid());
+
+    // the context is kept, so repeated stanzas compress well
+    const QByteArray stanza = R"(<message to="juliet@im.example.com" type="chat"><body>Moin</body></message>)";
+    QByteArray compressed;
+    for (int i = 0; i < 100; i++) {
+        const auto data = compressor.compress(stanza);
+        QVERIFY(!data.isEmpty());
+        compressed += data;
+    }
+    QVERIFY(compressed.size() < stanza.size() * 10);
+
+    // each part can be decompressed on its own (sync flush), in small chunks
+    decompressor.addData(compressed);
+    QByteArray decompressed;
+    while (true) {
+        const auto output = decompressor.read(100);
+        QVERIFY(output.has_value());
+        QVERIFY(output->size() <= 100);
+        if (output->isEmpty()) {
+            break;
+        }
+        decompressed += *output;
+    }
+    QCOMPARE(decompressed, stanza.repeated(100));
+
+    // compressed data received by the stream
+    RecordingStream stream(nullptr);
+    QSignalSpy onStreamReceived(&stream, &TestStream::streamReceived);
+    QSignalSpy onStanzaReceived(&stream, &TestStream::stanzaReceived);
+
+    QVERIFY(!stream.isCompressionEnabled());
+    QVERIFY(stream.enableCompression());
+    QVERIFY(stream.isCompressionEnabled());
+
+    ZlibCompressor peer;
+    const auto data = peer.compress(R"(<stream:stream xmlns='jabber:client' xmlns:stream='http://etherx.jabber.org/streams' version='1.0'>)") +
+        peer.compress(stanza) + peer.compress(stanza);
+    for (const auto byte : data) {
+        stream.processReceivedData(QByteArray(1, byte));
+    }
+    QCOMPARE(onStreamReceived.size(), 1);
+    QCOMPARE(onStanzaReceived.size(), 2);
+    QCOMPARE(onStanzaReceived[1][0].value<QDomElement>().firstChildElement("body").text(), QStringLiteral("Moin"));
+
+    // invalid data
+    QVERIFY(stream.sent.isEmpty());
+    stream.processReceivedData(QByteArrayLiteral("\xff\xff\xff\xff"));
+    QCOMPARE(stream.sent.size(), 1);
+    QVERIFY(stream.sent.first().startsWith("<stream:error><undefined-condition "));
+}
+#endif
+
 #include "tst_qxmppstream.moc"
@@ -32,6 +32,8 @@ private:
     Q_SLOT void testEmpty();
     Q_SLOT void testRequired();
     Q_SLOT void testFull();
+    Q_SLOT void testBidi();
+    Q_SLOT void testSasl2();
     Q_SLOT void testSetters();
 };
 
@@ -111,6 +113,74 @@ void tst_QXmppStreamFeatures::testFull()
     serializePacket(features, xml);
 }
 
+void tst_QXmppStreamFeatures::testBidi()
+{
+    const QByteArray xml("<stream:features>"
+                         "<starttls xmlns=\"urn:ietf:params:xml:ns:xmpp-tls\"/>"
+                         "<bidi xmlns=\"urn:xmpp:features:bidi\"/>"
+                         "</stream:features>");
+
+    QXmppStreamFeatures features;
+    parsePacketWithStream(features, xml);
+    QVERIFY(features.bidirectionalStreamsSupported());
+    serializePacket(features, xml);
+
+    features = QXmppStreamFeatures();
+    features.setTlsMode(QXmppStreamFeatures::Enabled);
+    features.setBidirectionalStreamsSupported(true);
+    serializePacket(features, xml);
+}
+
+void tst_QXmppStreamFeatures::testSasl2()
+{
+    const QByteArray xml("<stream:features>"
+                         "<mechanisms xmlns=\"urn:ietf:params:xml:ns:xmpp-sasl\"><mechanism>PLAIN</mechanism></mechanisms>"
+                         "<authentication xmlns=\"urn:xmpp:sasl:2\">"
+                         "<mechanism>SCRAM-SHA-256</mechanism>"
+                         "<mechanism>PLAIN</mechanism>"
+                         "<inline>"
+                         "<bind xmlns=\"urn:xmpp:bind:0\">"
+                         "<inline><feature var=\"urn:xmpp:sm:3\"/><feature var=\"urn:xmpp:carbons:2\"/></inline>"
+                         "</bind>"
+                         "<fast xmlns=\"urn:xmpp:fast:0\"><mechanism>HT-SHA-256-NONE</mechanism></fast>"
+                         "<sm xmlns=\"urn:xmpp:sm:3\"/>"
+                         "</inline>"
+                         "</authentication>"
+                         "</stream:features>");
+
+    QXmppStreamFeatures features;
+    parsePacketWithStream(features, xml);
+    QCOMPARE(features.authMechanisms(), QStringList { "PLAIN" });
+    QCOMPARE(features.sasl2Mechanisms(), QStringList({ "SCRAM-SHA-256", "PLAIN" }));
+    QVERIFY(features.sasl2StreamResumptionSupported());
+    QVERIFY(features.bind2Supported());
+    QCOMPARE(features.bind2InlineFeatures(), QStringList({ "urn:xmpp:sm:3", "urn:xmpp:carbons:2" }));
+    QCOMPARE(features.fastMechanisms(), QStringList { "HT-SHA-256-NONE" });
+    serializePacket(features, xml);
+
+    features = QXmppStreamFeatures();
+    features.setAuthMechanisms({ QStringLiteral("PLAIN") });
+    features.setSasl2Mechanisms({ QStringLiteral("SCRAM-SHA-256"), QStringLiteral("PLAIN") });
+    features.setSasl2StreamResumptionSupported(true);
+    features.setBind2Supported(true);
+    features.setBind2InlineFeatures({ QStringLiteral("urn:xmpp:sm:3"), QStringLiteral("urn:xmpp:carbons:2") });
+    features.setFastMechanisms({ QStringLiteral("HT-SHA-256-NONE") });
+    serializePacket(features, xml);
+
+    // SASL 2 without inline features
+    const QByteArray xml2("<stream:features>"
+                          "<authentication xmlns=\"urn:xmpp:sasl:2\"><mechanism>PLAIN</mechanism></authentication>"
+                          "</stream:features>");
+
+    QXmppStreamFeatures features2;
+    parsePacketWithStream(features2, xml2);
+    QCOMPARE(features2.sasl2Mechanisms(), QStringList { "PLAIN" });
+    QVERIFY(!features2.sasl2StreamResumptionSupported());
+    QVERIFY(!features2.bind2Supported());
+    QVERIFY(features2.fastMechanisms().isEmpty());
+    serializePacket(features2, xml2);
+}
+
 void tst_QXmppStreamFeatures::testSetters()
 {
     QXmppStreamFeatures features;
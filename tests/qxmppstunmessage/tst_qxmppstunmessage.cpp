@@ -14,6 +14,7 @@ class tst_QXmppStunMessage : public QObject
 private:
     Q_SLOT void testFingerprint();
     Q_SLOT void testIntegrity();
+    Q_SLOT void testTruncatedAttribute();
     Q_SLOT void testIPv4Address();
     Q_SLOT void testIPv6Address();
     Q_SLOT void testXorIPv4Address();
@@ -31,6 +32,16 @@ void tst_QXmppStunMessage::testFingerprint()
     // with fingerprint
     QCOMPARE(msg.encode(QByteArray(), true),
              QByteArray("\x00\x01\x00\x08\x21\x12\xA4\x42\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x80\x28\x00\x04\xB2\xAA\xF9\xF6", 28));
+
+    // decode
+    QByteArray packet = msg.encode(QByteArray(), true);
+    QXmppStunMessage msg2;
+    QVERIFY(msg2.decode(packet));
+
+    packet[27] = packet[27] ^ 0x01;
+    QStringList errors;
+    QVERIFY(!msg2.decode(packet, QByteArray(), &errors));
+    QCOMPARE(errors, QStringList { QStringLiteral("Bad fingerprint") });
 }
 
 void tst_QXmppStunMessage::testIntegrity()
@@ -39,6 +50,27 @@ void tst_QXmppStunMessage::testIntegrity()
     msg.setType(0x0001);
     QCOMPARE(msg.encode(QByteArray("somesecret"), false),
              QByteArray("\x00\x01\x00\x18\x21\x12\xA4\x42\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x08\x00\x14\x96\x4B\x40\xD1\x84\x67\x6A\xFD\xB5\xE0\x7C\xC5\x1F\xFB\xBD\xA2\x61\xAF\xB1\x26", 44));
+
+    // decode, checking the integrity with the right and a wrong key
+    msg.setUsername(QStringLiteral("user"));
+    const QByteArray packet = msg.encode(QByteArray("somesecret"), true);
+    QXmppStunMessage msg2;
+    QVERIFY(msg2.decode(packet, QByteArray("somesecret")));
+    QCOMPARE(msg2.username(), QStringLiteral("user"));
+
+    QStringList errors;
+    QVERIFY(!msg2.decode(packet, QByteArray("othersecret"), &errors));
+    QCOMPARE(errors, QStringList { QStringLiteral("Bad message integrity") });
+}
+
+void tst_QXmppStunMessage::testTruncatedAttribute()
+{
+    // the USERNAME attribute claims to be longer than the message
+    const QByteArray packet("\x00\x01\x00\x08\x21\x12\xA4\x42\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x06\x00\x10user", 28);
+    QXmppStunMessage msg;
+    QStringList errors;
+    QVERIFY(!msg.decode(packet, QByteArray(), &errors));
+    QCOMPARE(errors, QStringList { QStringLiteral("Received a truncated STUN attribute") });
 }
 
 void tst_QXmppStunMessage::testIPv4Address()
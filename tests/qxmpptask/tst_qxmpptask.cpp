@@ -0,0 +1,467 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppAsync_p.h"
+#include "QXmppFutureUtils_p.h"
+#include "QXmppPromise.h"
+#include "QXmppTask.h"
+
+#include "util.h"
+#include <array>
+
+#include <QObject>
+#include <QThread>
+#include <QThreadPool>
+
+using namespace QXmpp::Private;
+
+// counts its living instances, to check that captures are destroyed
+struct Tracker
+{
+    explicit Tracker(int *count)
+        : count(count)
+    {
+        (*count)++;
+    }
+    Tracker(const Tracker &other)
+        : count(other.count)
+    {
+        (*count)++;
+    }
+    Tracker(Tracker &&other) noexcept
+        : count(other.count)
+    {
+        (*count)++;
+    }
+    ~Tracker()
+    {
+        (*count)--;
+    }
+
+    int *count;
+};
+
+#ifdef QXMPP_COROUTINES
+static QXmppTask<int> addOne(QXmppTask<int> task)
+{
+    const auto value = co_await task;
+    co_return value + 1;
+}
+
+static QXmppTask<void> awaitWithContext(QXmppTask<QString> task, QObject *context, QString *result, int *trackers)
+{
+    Tracker tracker(trackers);
+    *result = co_await task.withContext(context);
+}
+
+static QXmppTask<void> awaitInThread(QXmppTask<QString> task, QObject *context, QString *result, QThread **thread)
+{
+    *result = co_await task.withContext(context);
+    *thread = QThread::currentThread();
+    QThread::currentThread()->quit();
+}
+#endif
+
+class tst_QXmppTask : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testContinuation();
+    Q_SLOT void testLargeContinuation();
+    Q_SLOT void testContinuationMove();
+    Q_SLOT void testThenAfterFinished();
+    Q_SLOT void testSharedState();
+    Q_SLOT void testCapturedTask();
+    Q_SLOT void testDeletedContext();
+    Q_SLOT void testVoid();
+    Q_SLOT void testNullContext();
+    Q_SLOT void testCancel();
+    Q_SLOT void testCancelChain();
+    Q_SLOT void testRunAsync();
+    Q_SLOT void testRunAsyncVoid();
+    Q_SLOT void testRunAsyncDeletedContext();
+#ifdef QXMPP_COROUTINES
+    Q_SLOT void testCoroutine();
+    Q_SLOT void testCoroutineFinishedTask();
+    Q_SLOT void testCoroutineDeletedContext();
+    Q_SLOT void testCoroutineContextThread();
+#endif
+};
+
+void tst_QXmppTask::testContinuation()
+{
+    QXmppPromise<QString> promise;
+    auto task = promise.task();
+    QVERIFY(!task.isFinished());
+
+    QString result;
+    task.then(this, [&](QString &&value) {
+        result = std::move(value);
+    });
+    promise.finish(QStringLiteral("result"));
+
+    QVERIFY(task.isFinished());
+    QCOMPARE(result, QStringLiteral("result"));
+    // the result has been passed to the continuation
+    QVERIFY(!task.hasResult());
+}
+
+void tst_QXmppTask::testLargeContinuation()
+{
+    // too large to be stored inline
+    int trackers = 0;
+    std::array<qint64, 32> values {};
+    values.back() = 42;
+
+    QXmppPromise<int> promise;
+    qint64 result = 0;
+    promise.task().then(this, [&result, values, tracker = Tracker(&trackers)](int &&value) {
+        result = values.back() + value;
+    });
+    QCOMPARE(trackers, 1);
+
+    promise.finish(1);
+    QCOMPARE(result, qint64(43));
+    // the continuation is destroyed after it has been called
+    QCOMPARE(trackers, 0);
+}
+
+void tst_QXmppTask::testContinuationMove()
+{
+    int trackers = 0;
+    int calls = 0;
+    TaskContinuation continuation([&calls, tracker = Tracker(&trackers)](TaskPrivate &, void *) {
+        calls++;
+    });
+    QVERIFY(bool(continuation));
+    QCOMPARE(trackers, 1);
+
+    auto moved = std::move(continuation);
+    QVERIFY(!continuation);
+    QVERIFY(bool(moved));
+    QCOMPARE(trackers, 1);
+
+    TaskPrivate state(nullptr);
+    moved(state, nullptr);
+    QCOMPARE(calls, 1);
+
+    moved.reset();
+    QVERIFY(!moved);
+    QCOMPARE(trackers, 0);
+}
+
+void tst_QXmppTask::testThenAfterFinished()
+{
+    QXmppPromise<QString> promise;
+    promise.finish(QStringLiteral("early"));
+
+    auto task = promise.task();
+    QVERIFY(task.isFinished());
+    QVERIFY(task.hasResult());
+    QCOMPARE(task.result(), QStringLiteral("early"));
+
+    QString result;
+    task.then(this, [&](QString &&value) {
+        result = std::move(value);
+    });
+    QCOMPARE(result, QStringLiteral("early"));
+    QVERIFY(!task.hasResult());
+}
+
+void tst_QXmppTask::testSharedState()
+{
+    QXmppPromise<int> promise;
+    auto task = promise.task();
+    {
+        // copies of the promise and the task share their state
+        auto promiseCopy = promise;
+        auto taskCopy = task;
+        taskCopy = promise.task();
+        promiseCopy.finish(5);
+        QVERIFY(taskCopy.isFinished());
+    }
+    QVERIFY(task.isFinished());
+    QCOMPARE(task.result(), 5);
+}
+
+void tst_QXmppTask::testCapturedTask()
+{
+    int trackers = 0;
+    bool called = false;
+    {
+        QXmppPromise<int> promise;
+        auto task = promise.task();
+        task.then(this, [&called, task, tracker = Tracker(&trackers)](int &&) mutable {
+            called = true;
+        });
+        promise.finish(1);
+    }
+    QVERIFY(called);
+    // the continuation did not keep the state alive
+    QCOMPARE(trackers, 0);
+}
+
+void tst_QXmppTask::testDeletedContext()
+{
+    auto *context = new QObject;
+    bool called = false;
+
+    QXmppPromise<int> promise;
+    promise.task().then(context, [&](int &&) {
+        called = true;
+    });
+    delete context;
+
+    promise.finish(1);
+    QVERIFY(!called);
+}
+
+void tst_QXmppTask::testVoid()
+{
+    QXmppPromise<void> promise;
+    bool called = false;
+    promise.task().then(this, [&]() {
+        called = true;
+    });
+    promise.finish();
+    QVERIFY(called);
+}
+
+void tst_QXmppTask::testNullContext()
+{
+    QXmppPromise<int> promise;
+    int result = 0;
+    promise.task().then(nullptr, [&](int &&value) {
+        result = value;
+    });
+    promise.finish(3);
+    QCOMPARE(result, 3);
+}
+
+void tst_QXmppTask::testCancel()
+{
+    int trackers = 0;
+    int cancellations = 0;
+    bool called = false;
+
+    QXmppPromise<QString> promise;
+    promise.onCancelled([&cancellations, tracker = Tracker(&trackers)]() {
+        cancellations++;
+    });
+    auto task = promise.task();
+    task.then(this, [&called, tracker = Tracker(&trackers)](QString &&) {
+        called = true;
+    });
+
+    task.cancel();
+    QVERIFY(task.isCancelled());
+    QVERIFY(promise.isCancelled());
+    QCOMPARE(cancellations, 1);
+    // the continuation and the handler are released
+    QCOMPARE(trackers, 0);
+
+    // cancelling again has no effect and the result is discarded
+    task.cancel();
+    QCOMPARE(cancellations, 1);
+    promise.finish(QStringLiteral("late"));
+    QVERIFY(!called);
+    QVERIFY(!task.isFinished());
+    QVERIFY(!task.hasResult());
+    task.then(this, [&](QString &&) {
+        called = true;
+    });
+    QVERIFY(!called);
+
+    // finished tasks can't be cancelled
+    QXmppPromise<int> finishedPromise;
+    finishedPromise.onCancelled([&]() {
+        cancellations++;
+    });
+    finishedPromise.finish(1);
+    auto finishedTask = finishedPromise.task();
+    finishedTask.cancel();
+    QVERIFY(!finishedTask.isCancelled());
+    QCOMPARE(cancellations, 1);
+    QCOMPARE(finishedTask.result(), 1);
+}
+
+void tst_QXmppTask::testCancelChain()
+{
+    bool sourceCancelled = false;
+    QXmppPromise<int> source;
+    source.onCancelled([&]() {
+        sourceCancelled = true;
+    });
+
+    auto task = chain<QString>(source.task(), this, [](int &&value) {
+        return QString::number(value);
+    });
+    task.cancel();
+    QVERIFY(sourceCancelled);
+    source.finish(1);
+    QVERIFY(!task.isFinished());
+
+    // the forwarding doesn't keep the source alive
+    int trackers = 0;
+    std::optional<QXmppTask<QString>> derived;
+    {
+        QXmppPromise<int> promise;
+        promise.onCancelled([tracker = Tracker(&trackers)]() {});
+        QXmppPromise<QString> derivedPromise;
+        derivedPromise.forwardCancellation(promise.task());
+        derived = derivedPromise.task();
+    }
+    QCOMPARE(trackers, 0);
+    derived->cancel();
+    QVERIFY(derived->isCancelled());
+}
+
+void tst_QXmppTask::testRunAsync()
+{
+    QThreadPool pool;
+    QThread *workerThread = nullptr;
+    QThread *resultThread = nullptr;
+    QString result;
+
+    runAsync(&pool, [&workerThread]() {
+        workerThread = QThread::currentThread();
+        return QStringLiteral("result");
+    }).then(this, [&](QString &&value) {
+        resultThread = QThread::currentThread();
+        result = std::move(value);
+    });
+
+    // the result is delivered by the event loop of the calling thread
+    QVERIFY(result.isNull());
+    QTRY_COMPARE(result, QStringLiteral("result"));
+    QCOMPARE(resultThread, QThread::currentThread());
+    QVERIFY(workerThread != QThread::currentThread());
+
+    // many operations at once
+    constexpr int Count = 100;
+    int sum = 0;
+    int finished = 0;
+    for (int i = 0; i < Count; i++) {
+        runAsync(&pool, [i]() {
+            return i;
+        }).then(this, [&](int &&value) {
+            sum += value;
+            finished++;
+        });
+    }
+    QTRY_COMPARE(finished, Count);
+    QCOMPARE(sum, Count * (Count - 1) / 2);
+}
+
+void tst_QXmppTask::testRunAsyncVoid()
+{
+    QThreadPool pool;
+    QAtomicInt calls;
+    bool finished = false;
+
+    auto task = runAsync(&pool, [&calls]() {
+        calls.ref();
+    });
+    task.then(this, [&]() {
+        finished = true;
+    });
+
+    QTRY_VERIFY(finished);
+    QCOMPARE(calls.loadRelaxed(), 1);
+}
+
+void tst_QXmppTask::testRunAsyncDeletedContext()
+{
+    QThreadPool pool;
+    bool called = false;
+    int trackers = 0;
+
+    auto *context = new QObject;
+    runAsync(&pool, [tracker = Tracker(&trackers)]() {
+        return 1;
+    }).then(context, [&](int &&) {
+        called = true;
+    });
+    delete context;
+
+    // the function has been destroyed by the worker
+    pool.waitForDone();
+    QCOMPARE(trackers, 0);
+
+    QCoreApplication::processEvents();
+    QVERIFY(!called);
+}
+
+#ifdef QXMPP_COROUTINES
+void tst_QXmppTask::testCoroutine()
+{
+    QXmppPromise<int> promise;
+    auto task = addOne(promise.task());
+    QVERIFY(!task.isFinished());
+
+    promise.finish(1);
+    QVERIFY(task.isFinished());
+    QCOMPARE(task.result(), 2);
+
+    // coroutines can await each other
+    QXmppPromise<int> other;
+    auto chained = addOne(addOne(other.task()));
+    other.finish(1);
+    QCOMPARE(chained.result(), 3);
+}
+
+void tst_QXmppTask::testCoroutineFinishedTask()
+{
+    QXmppPromise<int> promise;
+    promise.finish(41);
+
+    // the coroutine does not suspend
+    auto task = addOne(promise.task());
+    QVERIFY(task.isFinished());
+    QCOMPARE(task.result(), 42);
+}
+
+void tst_QXmppTask::testCoroutineDeletedContext()
+{
+    int trackers = 0;
+    QString result;
+
+    QXmppPromise<QString> promise;
+    auto *context = new QObject;
+    auto task = awaitWithContext(promise.task(), context, &result, &trackers);
+    QCOMPARE(trackers, 1);
+
+    delete context;
+    promise.finish(QStringLiteral("result"));
+
+    // the coroutine has been destroyed without being resumed
+    QCOMPARE(trackers, 0);
+    QVERIFY(result.isNull());
+    QVERIFY(!task.isFinished());
+}
+
+void tst_QXmppTask::testCoroutineContextThread()
+{
+    QString result;
+    QThread *resumedThread = nullptr;
+
+    QThread thread;
+    QObject context;
+    context.moveToThread(&thread);
+    thread.start();
+
+    QXmppPromise<QString> promise;
+    auto task = awaitInThread(promise.task(), &context, &result, &resumedThread);
+    promise.finish(QStringLiteral("result"));
+
+    // resumed in the thread of the context, which is stopped by the coroutine
+    QVERIFY(thread.wait(5000));
+    QCOMPARE(result, QStringLiteral("result"));
+    QCOMPARE(resumedThread, &thread);
+}
+#endif
+
+QTEST_MAIN(tst_QXmppTask)
+#include "tst_qxmpptask.moc"
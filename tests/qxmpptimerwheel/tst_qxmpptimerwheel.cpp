@@ -0,0 +1,120 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppTimerWheel_p.h"
+
+#include "util.h"
+
+#include <memory>
+
+#include <QElapsedTimer>
+
+using namespace QXmpp::Private;
+
+class tst_QXmppTimerWheel : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void testStartStop();
+    Q_SLOT void testTouch();
+    Q_SLOT void testRestartEarlier();
+    Q_SLOT void testOrder();
+    Q_SLOT void testDeleteInCallback();
+};
+
+void tst_QXmppTimerWheel::testStartStop()
+{
+    int fired = 0;
+    WheelTimer timer([&] { fired++; });
+    QVERIFY(!timer.isActive());
+    QCOMPARE(timer.remainingTime(), qint64(-1));
+
+    timer.start(50);
+    QVERIFY(timer.isActive());
+    QCOMPARE(timer.interval(), 50);
+    QVERIFY(timer.remainingTime() <= 50);
+    QTRY_COMPARE(fired, 1);
+    QVERIFY(!timer.isActive());
+
+    // single-shot
+    QTest::qWait(100);
+    QCOMPARE(fired, 1);
+
+    timer.start(50);
+    timer.stop();
+    QVERIFY(!timer.isActive());
+    QTest::qWait(100);
+    QCOMPARE(fired, 1);
+}
+
+void tst_QXmppTimerWheel::testTouch()
+{
+    int fired = 0;
+    WheelTimer timer([&] { fired++; });
+
+    QElapsedTimer elapsed;
+    elapsed.start();
+    timer.start(100);
+    while (elapsed.elapsed() < 300) {
+        QTest::qWait(20);
+        timer.touch();
+    }
+    QCOMPARE(fired, 0);
+
+    // fires after the interval since the last touch
+    elapsed.restart();
+    QTRY_COMPARE(fired, 1);
+    QVERIFY(elapsed.elapsed() >= 80);
+}
+
+void tst_QXmppTimerWheel::testRestartEarlier()
+{
+    int fired = 0;
+    WheelTimer timer([&] { fired++; });
+
+    timer.start(60000);
+    timer.start(20);
+    QTRY_COMPARE_WITH_TIMEOUT(fired, 1, 1000);
+}
+
+void tst_QXmppTimerWheel::testOrder()
+{
+    QList<int> order;
+    // the longer timeouts are in the upper levels of the wheel
+    const QList<int> intervals = { 1500, 10, 700, 50, 0, 660 };
+
+    std::vector<std::unique_ptr<WheelTimer>> timers;
+    for (const auto interval : intervals) {
+        timers.push_back(std::make_unique<WheelTimer>([&order, interval] { order.push_back(interval); }));
+        timers.back()->start(interval);
+    }
+
+    QTRY_COMPARE_WITH_TIMEOUT(order.size(), intervals.size(), 5000);
+    QCOMPARE(order, (QList<int> { 0, 10, 50, 660, 700, 1500 }));
+}
+
+void tst_QXmppTimerWheel::testDeleteInCallback()
+{
+    int fired = 0;
+    std::unique_ptr<WheelTimer> first;
+    std::unique_ptr<WheelTimer> second;
+    // the timer that fires first deletes both, the other one must not fire
+    const auto callback = [&] {
+        fired++;
+        first.reset();
+        second.reset();
+    };
+    first = std::make_unique<WheelTimer>(callback);
+    second = std::make_unique<WheelTimer>(callback);
+    first->start(30);
+    second->start(30);
+
+    QTRY_VERIFY(!first);
+    QTest::qWait(50);
+    QCOMPARE(fired, 1);
+}
+
+QTEST_MAIN(tst_QXmppTimerWheel)
+#include "tst_qxmpptimerwheel.moc"
@@ -0,0 +1,112 @@
+// SPDX-FileCopyrightText: 2026 QXmpp contributors
+//
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+#include "QXmppTracing.h"
+#include "QXmppTracing_p.h"
+
+#include "util.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+class tst_QXmppTracing : public QObject
+{
+    Q_OBJECT
+
+private:
+    Q_SLOT void init();
+    Q_SLOT void cleanup();
+    Q_SLOT void testDisabled();
+    Q_SLOT void testSpans();
+    Q_SLOT void testMaximumEventCount();
+};
+
+static QJsonArray traceEvents()
+{
+    const auto document = QJsonDocument::fromJson(QXmppTracing::toChromeTraceJson());
+    return document.object().value(QStringLiteral("traceEvents")).toArray();
+}
+
+void tst_QXmppTracing::init()
+{
+    QXmppTracing::clear();
+}
+
+void tst_QXmppTracing::cleanup()
+{
+    QXmppTracing::setEnabled(false);
+}
+
+void tst_QXmppTracing::testDisabled()
+{
+    QVERIFY(!QXmppTracing::isEnabled());
+    {
+        QXMPP_TRACE_SPAN(span, "test", "disabled");
+    }
+    QCOMPARE(QXmppTracing::eventCount(), 0);
+    QVERIFY(traceEvents().isEmpty());
+}
+
+void tst_QXmppTracing::testSpans()
+{
+    QXmppTracing::setEnabled(true);
+    QCOMPARE(QXmppTracing::isEnabled(), QXmppTracing::isAvailable());
+    if (!QXmppTracing::isAvailable()) {
+        QSKIP("QXmpp has been built without WITH_TRACING");
+    }
+
+    {
+        QXMPP_TRACE_SPAN(span, "stream", "dispatch");
+        QXMPP_TRACE_STANZA(span, QStringLiteral("id1"), QStringLiteral("message"));
+    }
+    QXMPP_TRACE_ASYNC_SPAN(async, "client", "encrypt");
+    QXMPP_TRACE_END(async);
+    QXMPP_TRACE_RECORD("stream", "parse", 2000, QStringLiteral("id2"), QStringLiteral("iq"));
+    QCOMPARE(QXmppTracing::eventCount(), 3);
+
+    const auto events = traceEvents();
+    QCOMPARE(events.size(), 4);
+    QCOMPARE(QXmppTracing::eventCount(), 0);
+
+    const auto dispatch = events.at(0).toObject();
+    QCOMPARE(dispatch.value(QStringLiteral("name")).toString(), QStringLiteral("dispatch"));
+    QCOMPARE(dispatch.value(QStringLiteral("cat")).toString(), QStringLiteral("stream"));
+    QCOMPARE(dispatch.value(QStringLiteral("ph")).toString(), QStringLiteral("X"));
+    QVERIFY(dispatch.contains(QStringLiteral("dur")));
+    QCOMPARE(dispatch.value(QStringLiteral("args")).toObject().value(QStringLiteral("id")).toString(), QStringLiteral("id1"));
+    QCOMPARE(dispatch.value(QStringLiteral("args")).toObject().value(QStringLiteral("type")).toString(), QStringLiteral("message"));
+
+    const auto begin = events.at(1).toObject();
+    const auto end = events.at(2).toObject();
+    QCOMPARE(begin.value(QStringLiteral("ph")).toString(), QStringLiteral("b"));
+    QCOMPARE(end.value(QStringLiteral("ph")).toString(), QStringLiteral("e"));
+    QCOMPARE(begin.value(QStringLiteral("id")), end.value(QStringLiteral("id")));
+    QVERIFY(end.value(QStringLiteral("ts")).toDouble() >= begin.value(QStringLiteral("ts")).toDouble());
+
+    const auto parse = events.at(3).toObject();
+    QCOMPARE(parse.value(QStringLiteral("name")).toString(), QStringLiteral("parse"));
+    QCOMPARE(parse.value(QStringLiteral("dur")).toDouble(), 2.0);
+}
+
+void tst_QXmppTracing::testMaximumEventCount()
+{
+    QXmppTracing::setEnabled(true);
+    if (!QXmppTracing::isAvailable()) {
+        QSKIP("QXmpp has been built without WITH_TRACING");
+    }
+
+    const auto maximum = QXmppTracing::maximumEventCount();
+    QXmppTracing::setMaximumEventCount(2);
+    for (int i = 0; i < 5; i++) {
+        QXMPP_TRACE_SPAN(span, "test", "span");
+    }
+    QCOMPARE(QXmppTracing::eventCount(), 2);
+
+    const auto document = QJsonDocument::fromJson(QXmppTracing::toChromeTraceJson());
+    QCOMPARE(document.object().value(QStringLiteral("otherData")).toObject().value(QStringLiteral("droppedEvents")).toInt(), 3);
+    QXmppTracing::setMaximumEventCount(maximum);
+}
+
+QTEST_MAIN(tst_QXmppTracing)
+#include "tst_qxmpptracing.moc"
@@ -18,6 +18,8 @@ private:
     Q_SLOT void init();
     Q_SLOT void testSendFile_data();
     Q_SLOT void testSendFile();
+    Q_SLOT void testSendJingleFile_data();
+    Q_SLOT void testSendJingleFile();
 
     Q_SLOT void acceptFile(QXmppTransferJob *job);
 
@@ -44,18 +46,22 @@ void tst_QXmppTransferManager::testSendFile_data()
     QTest::addColumn<QXmppTransferJob::Method>("senderMethods");
     QTest::addColumn<QXmppTransferJob::Method>("receiverMethods");
     QTest::addColumn<bool>("works");
+    QTest::addColumn<int>("ibbBlockSize");
+    QTest::addColumn<int>("ibbWindowSize");
 
-    QTest::newRow("any - any") << QXmppTransferJob::AnyMethod << QXmppTransferJob::AnyMethod << true;
-    QTest::newRow("any - inband") << QXmppTransferJob::AnyMethod << QXmppTransferJob::InBandMethod << true;
-    QTest::newRow("any - socks") << QXmppTransferJob::AnyMethod << QXmppTransferJob::SocksMethod << true;
+    QTest::newRow("any - any") << QXmppTransferJob::AnyMethod << QXmppTransferJob::AnyMethod << true << 4096 << 1;
+    QTest::newRow("any - inband") << QXmppTransferJob::AnyMethod << QXmppTransferJob::InBandMethod << true << 4096 << 1;
+    QTest::newRow("any - socks") << QXmppTransferJob::AnyMethod << QXmppTransferJob::SocksMethod << true << 4096 << 1;
 
-    QTest::newRow("inband - any") << QXmppTransferJob::InBandMethod << QXmppTransferJob::AnyMethod << true;
-    QTest::newRow("inband - inband") << QXmppTransferJob::InBandMethod << QXmppTransferJob::InBandMethod << true;
-    QTest::newRow("inband - socks") << QXmppTransferJob::InBandMethod << QXmppTransferJob::SocksMethod << false;
+    QTest::newRow("inband - any") << QXmppTransferJob::InBandMethod << QXmppTransferJob::AnyMethod << true << 4096 << 1;
+    QTest::newRow("inband - inband") << QXmppTransferJob::InBandMethod << QXmppTransferJob::InBandMethod << true << 4096 << 1;
+    QTest::newRow("inband - inband (window)") << QXmppTransferJob::InBandMethod << QXmppTransferJob::InBandMethod << true << 1024 << 4;
+    QTest::newRow("inband - inband (block size fallback)") << QXmppTransferJob::InBandMethod << QXmppTransferJob::InBandMethod << true << 16384 << 2;
+    QTest::newRow("inband - socks") << QXmppTransferJob::InBandMethod << QXmppTransferJob::SocksMethod << false << 4096 << 1;
 
-    QTest::newRow("socks - any") << QXmppTransferJob::SocksMethod << QXmppTransferJob::AnyMethod << true;
-    QTest::newRow("socks - inband") << QXmppTransferJob::SocksMethod << QXmppTransferJob::InBandMethod << false;
-    QTest::newRow("socks - socks") << QXmppTransferJob::SocksMethod << QXmppTransferJob::SocksMethod << true;
+    QTest::newRow("socks - any") << QXmppTransferJob::SocksMethod << QXmppTransferJob::AnyMethod << true << 4096 << 1;
+    QTest::newRow("socks - inband") << QXmppTransferJob::SocksMethod << QXmppTransferJob::InBandMethod << false << 4096 << 1;
+    QTest::newRow("socks - socks") << QXmppTransferJob::SocksMethod << QXmppTransferJob::SocksMethod << true << 4096 << 1;
 }
 
 void tst_QXmppTransferManager::testSendFile()
@@ -63,6 +69,8 @@ void tst_QXmppTransferManager::testSendFile()
     QFETCH(QXmppTransferJob::Method, senderMethods);
     QFETCH(QXmppTransferJob::Method, receiverMethods);
     QFETCH(bool, works);
+    QFETCH(int, ibbBlockSize);
+    QFETCH(int, ibbWindowSize);
 
     const QString testDomain("localhost");
     const QHostAddress testHost(QHostAddress::LocalHost);
@@ -86,6 +94,8 @@ void tst_QXmppTransferManager::testSendFile()
     QXmppClient sender;
     auto *senderManager = new QXmppTransferManager;
     senderManager->setSupportedMethods(senderMethods);
+    senderManager->setIbbBlockSize(ibbBlockSize);
+    senderManager->setIbbWindowSize(ibbWindowSize);
     sender.addExtension(senderManager);
     sender.setLogger(&logger);
 
@@ -157,5 +167,93 @@ void tst_QXmppTransferManager::testSendFile()
     }
 }
 
+void tst_QXmppTransferManager::testSendJingleFile_data()
+{
+    QTest::addColumn<int>("receiverMethods");
+    QTest::addColumn<bool>("works");
+
+    QTest::newRow("jingle") << int(QXmppTransferJob::AnyMethod | QXmppTransferJob::JingleMethod) << true;
+    QTest::newRow("no jingle") << int(QXmppTransferJob::AnyMethod) << false;
+}
+
+void tst_QXmppTransferManager::testSendJingleFile()
+{
+    QFETCH(int, receiverMethods);
+    QFETCH(bool, works);
+
+    const QString testDomain("localhost");
+    const QHostAddress testHost(QHostAddress::LocalHost);
+    const quint16 testPort = 12345;
+
+    QXmppLogger logger;
+    // logger.setLoggingType(QXmppLogger::StdoutLogging);
+
+    // prepare server
+    TestPasswordChecker passwordChecker;
+    passwordChecker.addCredentials("sender", "testpwd");
+    passwordChecker.addCredentials("receiver", "testpwd");
+
+    QXmppServer server;
+    server.setDomain(testDomain);
+    server.setLogger(&logger);
+    server.setPasswordChecker(&passwordChecker);
+    server.listenForClients(testHost, testPort);
+
+    QXmppConfiguration config;
+    config.setDomain(testDomain);
+    config.setHost(testHost.toString());
+    config.setPort(testPort);
+    config.setPassword("testpwd");
+
+    // prepare sender
+    QXmppClient sender;
+    auto *senderManager = new QXmppTransferManager;
+    senderManager->setSupportedMethods(QXmppTransferJob::AnyMethod | QXmppTransferJob::JingleMethod);
+    sender.addExtension(senderManager);
+    sender.setLogger(&logger);
+
+    config.setUser("sender");
+    sender.connectToServer(config);
+    QTRY_VERIFY(sender.isConnected());
+
+    // prepare receiver
+    QXmppClient receiver;
+    auto *receiverManager = new QXmppTransferManager;
+    receiverManager->setSupportedMethods(QXmppTransferJob::Methods(receiverMethods));
+    connect(receiverManager, &QXmppTransferManager::fileReceived,
+            this, &tst_QXmppTransferManager::acceptFile);
+    receiver.addExtension(receiverManager);
+    receiver.setLogger(&logger);
+
+    config.setUser("receiver");
+    receiver.connectToServer(config);
+    QTRY_VERIFY(receiver.isConnected());
+
+    // send file
+    QXmppTransferJob *senderJob = senderManager->sendJingleFile("receiver@localhost/QXmpp", ":/test.svg");
+    QVERIFY(senderJob);
+    QCOMPARE(senderJob->method(), QXmppTransferJob::JingleMethod);
+    QTRY_COMPARE_WITH_TIMEOUT(senderJob->state(), QXmppTransferJob::FinishedState, 10000);
+
+    if (works) {
+        QCOMPARE(senderJob->error(), QXmppTransferJob::NoError);
+
+        QVERIFY(receiverJob);
+        QCOMPARE(receiverJob->method(), QXmppTransferJob::JingleMethod);
+        QCOMPARE(receiverJob->fileName(), QStringLiteral("test.svg"));
+        QTRY_COMPARE(receiverJob->state(), QXmppTransferJob::FinishedState);
+        QCOMPARE(receiverJob->error(), QXmppTransferJob::NoError);
+
+        // check received file
+        QFile expectedFile(":/test.svg");
+        QVERIFY(expectedFile.open(QIODevice::ReadOnly));
+        QCOMPARE(receiverBuffer.data(), expectedFile.readAll());
+    } else {
+        // the receiver does not know the session
+        QCOMPARE(senderJob->error(), QXmppTransferJob::AbortError);
+        QVERIFY(!receiverJob);
+    }
+}
+
 QTEST_MAIN(tst_QXmppTransferManager)
 #include "tst_qxmpptransfermanager.moc"
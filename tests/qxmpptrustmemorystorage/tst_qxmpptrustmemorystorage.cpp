@@ -24,6 +24,7 @@ private:
     Q_SLOT void testKeys();
     Q_SLOT void testTrustLevels();
     Q_SLOT void testResetAll();
+    Q_SLOT void benchmarkKeys();
 
     // QXmppAtmTrustMemoryStorage
     Q_SLOT void atmTestKeysForPostponedTrustDecisions();
@@ -615,6 +616,26 @@ void tst_QXmppTrustMemoryStorage::testTrustLevels()
     result = future.result();
     QCOMPARE(result, TrustLevel::Undecided);
 
+    // Retrieve the trust levels of several keys at once.
+    auto futureForKeyIds = m_trustStorage.trustLevels(
+        ns_omemo,
+        { { QStringLiteral("alice@example.org"),
+            QByteArray::fromBase64(QByteArrayLiteral("AZ/cF4OrUOILKO1gQBf62pQevOhBJ2NyHnXLwM4FDZU=")) },
+          { QStringLiteral("alice@example.org"),
+            QByteArray::fromBase64(QByteArrayLiteral("aFABnX7Q/rbTgjBySYzrT2FsYCVYb49mbca5yB734KQ=")) },
+          { QStringLiteral("alice@example.org"),
+            QByteArray::fromBase64(QByteArrayLiteral("wE06Gwf8f4DvDLFDoaCsGs8ibcUjf84WIOA2FAjPI3o=")) },
+          { QStringLiteral("bob@example.com"),
+            QByteArray::fromBase64(QByteArrayLiteral("9E51lG3vVmUn8CM7/AIcmIlLP2HPl6Ao0/VSf4VT/oA=")) } });
+    QVERIFY(futureForKeyIds.isFinished());
+    const auto resultForKeyIds = futureForKeyIds.result();
+    QCOMPARE(resultForKeyIds.size(), 2);
+    QCOMPARE(resultForKeyIds.value(QStringLiteral("alice@example.org")).size(), 3);
+    QCOMPARE(resultForKeyIds.value(QStringLiteral("alice@example.org")).value(QByteArray::fromBase64(QByteArrayLiteral("AZ/cF4OrUOILKO1gQBf62pQevOhBJ2NyHnXLwM4FDZU="))), TrustLevel::ManuallyDistrusted);
+    QCOMPARE(resultForKeyIds.value(QStringLiteral("alice@example.org")).value(QByteArray::fromBase64(QByteArrayLiteral("aFABnX7Q/rbTgjBySYzrT2FsYCVYb49mbca5yB734KQ="))), TrustLevel::ManuallyTrusted);
+    QCOMPARE(resultForKeyIds.value(QStringLiteral("alice@example.org")).value(QByteArray::fromBase64(QByteArrayLiteral("wE06Gwf8f4DvDLFDoaCsGs8ibcUjf84WIOA2FAjPI3o="))), TrustLevel::Undecided);
+    QCOMPARE(resultForKeyIds.value(QStringLiteral("bob@example.com")).value(QByteArray::fromBase64(QByteArrayLiteral("9E51lG3vVmUn8CM7/AIcmIlLP2HPl6Ao0/VSf4VT/oA="))), TrustLevel::ManuallyDistrusted);
+
     m_trustStorage.removeKeys(ns_ox);
     m_trustStorage.removeKeys(ns_omemo);
 }
@@ -713,6 +734,57 @@ void tst_QXmppTrustMemoryStorage::testResetAll()
             authenticatedKeys) }));
 }
 
+void tst_QXmppTrustMemoryStorage::benchmarkKeys()
+{
+    // 20000 keys of 2000 owners
+    QXmppTrustMemoryStorage storage;
+    const auto ownerJid = [](int i) {
+        return QStringLiteral("contact%1@example.org").arg(i);
+    };
+    const auto keyId = [](int i, int j) {
+        return QByteArray::number(i) + '-' + QByteArray::number(j);
+    };
+    for (int i = 0; i < 2000; i++) {
+        QList<QByteArray> keyIds;
+        for (int j = 0; j < 10; j++) {
+            keyIds << keyId(i, j);
+        }
+        storage.addKeys(ns_omemo, ownerJid(i), keyIds, i % 2 ? TrustLevel::Authenticated : TrustLevel::ManuallyTrusted);
+    }
+
+    QBENCHMARK {
+        auto future = storage.trustLevel(ns_omemo, ownerJid(1000), keyId(1000, 5));
+        QCOMPARE(future.result(), TrustLevel::ManuallyTrusted);
+    }
+
+    QBENCHMARK {
+        auto future = storage.keys(ns_omemo, { ownerJid(1000), ownerJid(1001) }, TrustLevel::ManuallyTrusted);
+        const auto result = future.result();
+        QCOMPARE(result.size(), 1);
+        QCOMPARE(result.value(ownerJid(1000)).size(), 10);
+    }
+
+    QBENCHMARK {
+        auto future = storage.hasKey(ns_omemo, ownerJid(1001), TrustLevel::Authenticated);
+        QVERIFY(future.result());
+    }
+
+    QBENCHMARK {
+        auto future = storage.setTrustLevel(ns_omemo, { ownerJid(1000) }, TrustLevel::ManuallyTrusted, TrustLevel::ManuallyDistrusted);
+        future.result();
+        future = storage.setTrustLevel(ns_omemo, { ownerJid(1000) }, TrustLevel::ManuallyDistrusted, TrustLevel::ManuallyTrusted);
+        QCOMPARE(future.result().value(ns_omemo).size(), 10);
+    }
+
+    QBENCHMARK {
+        storage.removeKeys(ns_omemo, QList { keyId(1000, 0) });
+        storage.addKeys(ns_omemo, ownerJid(1000), { keyId(1000, 0) }, TrustLevel::ManuallyTrusted);
+    }
+
+    auto future = storage.keys(ns_omemo, TrustLevel::Authenticated);
+    QCOMPARE(future.result().value(TrustLevel::Authenticated).size(), 10000);
+}
+
 void tst_QXmppTrustMemoryStorage::atmTestKeysForPostponedTrustDecisions()
 {
     // The key 7y1t0LnmNBeXJka43XejFPLrKtQlSFATrYmy7xHaKYU=
@@ -3,13 +3,24 @@
 //
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
+#include "QXmppBase64_p.h"
+#include "QXmppBlake3_p.h"
+#include "QXmppEnumStrings_p.h"
 #include "QXmppError.h"
 #include "QXmppHash.h"
 #include "QXmppHashing_p.h"
+#include "QXmppStringPool_p.h"
 #include "QXmppUtils.h"
+#include "QXmppUtils_p.h"
 
 #include "util.h"
+#include <thread>
+
+#include <QBuffer>
 #include <QObject>
+#include <QRegularExpression>
+#include <QSet>
+#include <QTemporaryFile>
 
 using namespace QXmpp;
 using namespace QXmpp::Private;
@@ -21,16 +32,80 @@ class tst_QXmppUtils : public QObject
     Q_OBJECT
 
 private:
+    Q_SLOT void testBase64();
+    Q_SLOT void testBase64Data();
     Q_SLOT void testCrc32();
     Q_SLOT void testHmac();
     Q_SLOT void testJid();
     Q_SLOT void testMime();
+    Q_SLOT void testProgressThrottle();
     Q_SLOT void testTimezoneOffset();
     Q_SLOT void testStanzaHash();
+    Q_SLOT void testStanzaId();
     Q_SLOT void testCalculateHashes_data();
     Q_SLOT void testCalculateHashes();
+    Q_SLOT void testCalculateHashesLarge();
+    Q_SLOT void testBlake3_data();
+    Q_SLOT void testBlake3();
+    Q_SLOT void testHashingDevice();
+    Q_SLOT void testIsElement();
+    Q_SLOT void testEnumStrings();
+    Q_SLOT void testStringPool();
 };
 
+void tst_QXmppUtils::testBase64()
+{
+    QCOMPARE(decodeBase64(u""), QByteArray());
+    QCOMPARE(decodeBase64(u"Zg=="), QByteArrayLiteral("f"));
+    QCOMPARE(decodeBase64(u"Zm8="), QByteArrayLiteral("fo"));
+    QCOMPARE(decodeBase64(u"Zm9v"), QByteArrayLiteral("foo"));
+    // whitespace is skipped
+    QCOMPARE(decodeBase64(u"Zm9v\nYm\r\n Fy"), QByteArrayLiteral("foobar"));
+
+    // same results as Qt for all lengths
+    for (int length = 0; length < 100; length++) {
+        const auto data = QXmppUtils::generateRandomBytes(length);
+        auto text = QString::fromLatin1(data.toBase64());
+        QCOMPARE(decodeBase64(text), data);
+
+        // line breaks like in vCards
+        for (int i = 76; i < text.size(); i += 77) {
+            text.insert(i, u'\n');
+        }
+        QCOMPARE(decodeBase64(text), data);
+    }
+}
+
+void tst_QXmppUtils::testBase64Data()
+{
+    const auto photo = QXmppUtils::generateRandomBytes(1000);
+    const auto text = QString::fromLatin1(photo.toBase64());
+
+    auto data = Base64Data::fromBase64(text);
+    QVERIFY(!data.isEmpty());
+    // the text is written again without decoding
+    QCOMPARE(data.toBase64(), text);
+
+    const auto copy = data;
+    QCOMPARE(copy.data(), photo);
+    QCOMPARE(data.data(), photo);
+
+    // decoded in another thread
+    QByteArray result;
+    Base64Data::fromBase64(text).decodeAsync().then(this, [&](QByteArray &&decoded) {
+        result = std::move(decoded);
+    });
+    QTRY_COMPARE(result, photo);
+
+    // already decoded
+    auto task = data.decodeAsync();
+    QVERIFY(task.isFinished());
+    QCOMPARE(task.result(), photo);
+
+    QCOMPARE(Base64Data(photo).toBase64(), text);
+    QVERIFY(Base64Data().isEmpty());
+}
+
 void tst_QXmppUtils::testCrc32()
 {
     quint32 crc = QXmppUtils::generateCrc32(QByteArray());
@@ -38,6 +113,10 @@ void tst_QXmppUtils::testCrc32()
 
     crc = QXmppUtils::generateCrc32(QByteArray("Hi There"));
     QCOMPARE(crc, 0xDB143BBEu);
+
+    // longer than the eight bytes processed at once
+    crc = QXmppUtils::generateCrc32(QByteArray("The quick brown fox jumps over the lazy dog"));
+    QCOMPARE(crc, 0x414FA339u);
 }
 
 void tst_QXmppUtils::testHmac()
@@ -50,6 +129,13 @@ void tst_QXmppUtils::testHmac()
 
     hmac = QXmppUtils::generateHmacMd5(QByteArray(16, '\xaa'), QByteArray(50, '\xdd'));
     QCOMPARE(hmac, QByteArray::fromHex("56be34521d144c88dbb8c733f0e8b3f6"));
+
+    hmac = QXmppUtils::generateHmacSha1(QByteArray(20, '\x0b'), QByteArray("Hi There"));
+    QCOMPARE(hmac, QByteArray::fromHex("b617318655057264e28bc0b6fb378c8ef146be00"));
+
+    // keys longer than the block size are hashed first
+    hmac = QXmppUtils::generateHmacSha1(QByteArray(80, '\xaa'), QByteArray("Test Using Larger Than Block-Size Key - Hash Key First"));
+    QCOMPARE(hmac, QByteArray::fromHex("aa4ae5e15272d00e95705637ce8a3b55ed402112"));
 }
 
 void tst_QXmppUtils::testJid()
@@ -63,6 +149,8 @@ void tst_QXmppUtils::testJid()
     QCOMPARE(QXmppUtils::jidToDomain("foo@example.com"), QLatin1String("example.com"));
     QCOMPARE(QXmppUtils::jidToDomain("example.com"), QLatin1String("example.com"));
     QCOMPARE(QXmppUtils::jidToDomain(QString()), QString());
+    QCOMPARE(QXmppUtils::jidToDomain("example.com/user@host"), QLatin1String("example.com"));
+    QCOMPARE(QXmppUtils::jidToDomain("/resource"), QString());
 
     QCOMPARE(QXmppUtils::jidToResource("foo@example.com/resource"), QLatin1String("resource"));
     QCOMPARE(QXmppUtils::jidToResource("foo@example.com"), QString());
@@ -104,6 +192,39 @@ void tst_QXmppUtils::testMime()
 }
 #endif
 
+void tst_QXmppUtils::testProgressThrottle()
+{
+    // by default every change is reported
+    ProgressThrottle throttle;
+    QVERIFY(throttle.shouldReport(0, 100));
+    QVERIFY(throttle.shouldReport(1, 100));
+    QVERIFY(!throttle.shouldReport(1, 100));
+
+    // granularity
+    throttle = ProgressThrottle();
+    throttle.setGranularity(0.1f);
+    QVERIFY(throttle.shouldReport(1, 100));
+    QVERIFY(!throttle.shouldReport(5, 100));
+    QVERIFY(!throttle.shouldReport(10, 100));
+    QVERIFY(throttle.shouldReport(11, 100));
+    // the end and restarts are always reported
+    QVERIFY(throttle.shouldReport(100, 100));
+    QVERIFY(throttle.shouldReport(0, 100));
+
+    // interval
+    throttle = ProgressThrottle();
+    throttle.setInterval(60000);
+    QCOMPARE(throttle.interval(), 60000);
+    QVERIFY(throttle.shouldReport(1, 100));
+    QVERIFY(!throttle.shouldReport(50, 100));
+    QVERIFY(throttle.shouldReport(100, 100));
+
+    throttle.setInterval(-1);
+    QCOMPARE(throttle.interval(), 0);
+    throttle.setGranularity(2);
+    QCOMPARE(throttle.granularity(), 1.0f);
+}
+
 void tst_QXmppUtils::testTimezoneOffset()
 {
     // parsing
@@ -135,6 +256,31 @@ void tst_QXmppUtils::testStanzaHash()
     QCOMPARE(hash.count('-'), 4);
 }
 
+void tst_QXmppUtils::testStanzaId()
+{
+    const QRegularExpression base64Url(QStringLiteral("^[A-Za-z0-9_-]+$"));
+
+    // random prefix of eleven characters and a counter
+    const auto prefix = QXmppUtils::generateStanzaId().left(11);
+
+    QSet<QString> ids;
+    for (int i = 0; i < 10000; i++) {
+        const auto id = QXmppUtils::generateStanzaId();
+        QVERIFY(base64Url.match(id).hasMatch());
+        QVERIFY(id.size() > 11);
+        QCOMPARE(id.left(11), prefix);
+        ids.insert(id);
+    }
+    QCOMPARE(ids.size(), 10000);
+
+    // other threads use other prefixes
+    QString otherId;
+    std::thread([&otherId] {
+        otherId = QXmppUtils::generateStanzaId();
+    }).join();
+    QVERIFY(otherId.left(11) != prefix);
+}
+
 void tst_QXmppUtils::testCalculateHashes_data()
 {
     QTest::addColumn<QString>("filePath");
@@ -179,6 +325,10 @@ void tst_QXmppUtils::testCalculateHashes_data()
         << QByteArray::fromHex("a5e86044842e4c8306e9e2ee041fc26d57d172d5cb32346d5ee467c97c5a0b0b2350bc5a4a3dc76b92c48585c2ebbb01cf47fa59a88420fe7bba8f2a18af6f07")
         << HashAlgorithm::Blake2b_512;
 #endif
+    QTest::newRow("svg/blake3")
+        << QStringLiteral(":/test.svg")
+        << QByteArray::fromHex("0762a759dda2e20910ed6fa473f872c30098185c4adcb0d0874339566d9336c8")
+        << HashAlgorithm::Blake3;
     QTest::newRow("bmp/sha3-256")
         << QStringLiteral(":/test.bmp")
         << QByteArray::fromHex("e50ffd13bb279932923ee10ba6847bec7546f77747074d1a7eeeb82228daf257")
@@ -201,5 +351,183 @@ void tst_QXmppUtils::testCalculateHashes()
     QCOMPARE(hashes.front().hash(), hash);
 }
 
+void tst_QXmppUtils::testCalculateHashesLarge()
+{
+    QByteArray data;
+    for (int i = 0; i < 100000; i++) {
+        data.append(char(i % 251));
+    }
+    const auto sha256 = QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+    const auto sha512 = QCryptographicHash::hash(data, QCryptographicHash::Sha512);
+    const auto blake3 = QByteArray::fromHex("d93c23eedaf165a7e0be908ba86f1a7a520d568d2d13cde787c8580c5c72cc54");
+
+    auto checkHashes = [&](std::unique_ptr<QIODevice> device) {
+        // small buffers, so the data is processed in multiple iterations
+        auto resultPtr = wait(calculateHashes(std::move(device), { HashAlgorithm::Sha256, HashAlgorithm::Sha512, HashAlgorithm::Blake3 }, 4096));
+        auto &[result, _] = *resultPtr;
+        auto hashes = expectVariant<std::vector<QXmppHash>>(std::move(result));
+        QCOMPARE(int(hashes.size()), 3);
+        QCOMPARE(hashes[0].hash(), sha256);
+        QCOMPARE(hashes[1].hash(), sha512);
+        QCOMPARE(hashes[2].hash(), blake3);
+    };
+
+    // read from the device
+    auto buffer = std::make_unique<QBuffer>();
+    buffer->setData(data);
+    QVERIFY(buffer->open(QIODevice::ReadOnly));
+    checkHashes(std::move(buffer));
+
+    // memory mapped file
+    auto file = std::make_unique<QTemporaryFile>();
+    QVERIFY(file->open());
+    QCOMPARE(file->write(data), qint64(data.size()));
+    QVERIFY(file->seek(0));
+    checkHashes(std::move(file));
+}
+
+void tst_QXmppUtils::testBlake3_data()
+{
+    QTest::addColumn<int>("size");
+    QTest::addColumn<QByteArray>("hash");
+
+    // input of the official test vectors
+    QTest::newRow("empty")
+        << 0
+        << QByteArray::fromHex("af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262");
+    QTest::newRow("two chunks")
+        << 1025
+        << QByteArray::fromHex("d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444");
+    QTest::newRow("subtrees")
+        << 102400
+        << QByteArray::fromHex("bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085");
+    // large enough to be hashed in parallel
+    QTest::newRow("parallel")
+        << 300000
+        << QByteArray::fromHex("6cc9dce05d4cff8c5bef5c5a24681e42b13f03e34a0bc5e66f65a91d48c944fa");
+}
+
+void tst_QXmppUtils::testBlake3()
+{
+    QFETCH(int, size);
+    QFETCH(QByteArray, hash);
+
+    QByteArray data;
+    for (int i = 0; i < size; i++) {
+        data.append(char(i % 251));
+    }
+    QCOMPARE(Blake3Hasher::hash(data), hash);
+
+    // incremental hashing with parts that are not aligned to chunks
+    Blake3Hasher hasher;
+    for (int offset = 0; offset < size; offset += 7777) {
+        const auto part = data.mid(offset, 7777);
+        hasher.addData(part.constData(), std::size_t(part.size()));
+    }
+    QCOMPARE(hasher.result(), hash);
+}
+
+void tst_QXmppUtils::testHashingDevice()
+{
+    const QByteArray data(10000, 'x');
+    const auto sha256 = QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+
+    auto makeDevice = [&]() {
+        auto buffer = std::make_unique<QBuffer>();
+        buffer->setData(data);
+        buffer->open(QIODevice::ReadOnly);
+        return std::make_unique<HashingDevice>(std::move(buffer), std::vector { HashAlgorithm::Sha256 });
+    };
+
+    // read once
+    auto device = makeDevice();
+    QCOMPARE(device->readAll(), data);
+    auto state = device->state();
+    device.reset();
+    QVERIFY(state->result().has_value());
+    QCOMPARE(state->result()->front().hash(), sha256);
+
+    // data read again after seeking back is hashed once
+    device = makeDevice();
+    device->read(6000);
+    QVERIFY(device->seek(1000));
+    QVERIFY(!device->state()->result().has_value());
+    QCOMPARE(device->readAll(), data.mid(1000));
+    QCOMPARE(device->state()->result()->front().hash(), sha256);
+
+    // skipped data
+    device = makeDevice();
+    QVERIFY(device->seek(100));
+    device->readAll();
+    QVERIFY(!device->state()->result().has_value());
+}
+
+void tst_QXmppUtils::testIsElement()
+{
+    const auto element = xmlToDom(QStringLiteral("<hash xmlns='urn:xmpp:hashes:2' algo='sha-256'/>"));
+    QVERIFY(isElement(element, u"hash", QLatin1String("urn:xmpp:hashes:2")));
+    QVERIFY(!isElement(element, u"hash-used", QLatin1String("urn:xmpp:hashes:2")));
+    QVERIFY(!isElement(element, u"hash", QLatin1String("urn:xmpp:hashes:1")));
+    QVERIFY(!isElement(QDomElement(), u"hash", QLatin1String("urn:xmpp:hashes:2")));
+}
+
+void tst_QXmppUtils::testEnumStrings()
+{
+    enum Color {
+        None,
+        Red,
+        Green,
+        Blue,
+        Yellow,
+    };
+    constexpr auto colors = enumStrings<Color>(u"", u"red", u"green", u"blue", u"yellow");
+    static_assert(colors.toStringView(Green).size() == 5);
+
+    for (auto color : { None, Red, Green, Blue, Yellow }) {
+        QCOMPARE(colors.fromString(colors.toString(color)), std::optional(color));
+    }
+    QCOMPARE(colors.toString(Blue), QStringLiteral("blue"));
+    QCOMPARE(colors.toString(Color(-1)), QString());
+    QCOMPARE(colors.toString(Color(5)), QString());
+    QCOMPARE(colors.fromString(QString()), std::optional(None));
+    QVERIFY(!colors.fromString(u"purple"));
+    QVERIFY(!colors.fromString(u"gree"));
+    QVERIFY(!colors.fromString(u"Red"));
+}
+
+void tst_QXmppUtils::testStringPool()
+{
+    StringPool pool;
+    const auto jid = QStringLiteral("alice@example.org");
+
+    // the first string is pooled without copying
+    const auto first = pool.intern(jid);
+    QCOMPARE(first.constData(), jid.constData());
+
+    const auto second = pool.intern(QString(jid.constData(), jid.size()));
+    QCOMPARE(second, jid);
+    QCOMPARE(second.constData(), jid.constData());
+    QCOMPARE(pool.intern(QStringView(jid)).constData(), jid.constData());
+    QCOMPARE(pool.size(), 1);
+
+    QVERIFY(pool.intern(QString()).isNull());
+    QCOMPARE(pool.size(), 1);
+
+    // long strings are not pooled
+    const QString longString(StringPool::MaximumLength + 1, u'a');
+    QCOMPARE(pool.intern(longString), longString);
+    QCOMPARE(pool.size(), 1);
+
+    // the pool is bounded
+    for (int i = 0; i < 2 * StringPool::MaximumSize; i++) {
+        pool.intern(QString::number(i));
+    }
+    QVERIFY(pool.size() <= StringPool::MaximumSize);
+
+    pool.clear();
+    QCOMPARE(pool.size(), 0);
+    QCOMPARE(first, jid);
+}
+
 QTEST_MAIN(tst_QXmppUtils)
 #include "tst_qxmpputils.moc"
@@ -4,13 +4,16 @@
 // SPDX-License-Identifier: LGPL-2.1-or-later
 
 #include "QXmppClient.h"
+#include "QXmppPresence.h"
 #include "QXmppVCardIq.h"
 #include "QXmppVCardManager.h"
 
 #include <memory>
 
 #include "IntegrationTesting.h"
+#include "TestClient.h"
 #include "util.h"
+#include <QCryptographicHash>
 #include <QObject>
 
 Q_DECLARE_METATYPE(QXmppVCardIq);
@@ -22,6 +25,7 @@ class tst_QXmppVCardManager : public QObject
 private:
     Q_SLOT void testHandleStanza_data();
     Q_SLOT void testHandleStanza();
+    Q_SLOT void testFetchVCard();
 
     // integration tests
     Q_SLOT void testSetClientVCard();
@@ -91,6 +95,56 @@ void tst_QXmppVCardManager::testHandleStanza()
     m_client.removeExtension(manager);
 }
 
+void tst_QXmppVCardManager::testFetchVCard()
+{
+    TestClient test;
+    auto *manager = test.addNewExtension<QXmppVCardManager>();
+    const auto photo = QByteArrayLiteral("avatar");
+    const auto photoHash = QCryptographicHash::hash(photo, QCryptographicHash::Sha1);
+
+    auto requestVCard = [&]() {
+        auto task = manager->fetchVCard(QStringLiteral("juliet@capulet.lit"));
+        // concurrent requests share the request
+        auto concurrentTask = manager->fetchVCard(QStringLiteral("juliet@capulet.lit"));
+
+        const auto packet = test.takePacket();
+        QVERIFY(packet.contains(u"vcard-temp"));
+        QVERIFY(packet.contains(u"to=\"juliet@capulet.lit\""));
+        test.expectNoPacket();
+        test.inject(QStringLiteral("<iq id='qxmpp1' from='juliet@capulet.lit' type='result'>"
+                                   "<vCard xmlns='vcard-temp'><FN>Juliet</FN><PHOTO><TYPE>image/png</TYPE><BINVAL>%1</BINVAL></PHOTO></vCard>"
+                                   "</iq>")
+                        .arg(QString::fromLatin1(photo.toBase64())));
+
+        QCOMPARE(expectFutureVariant<QXmppVCardIq>(task).fullName(), QStringLiteral("Juliet"));
+        QCOMPARE(expectFutureVariant<QXmppVCardIq>(concurrentTask).photo(), photo);
+    };
+
+    requestVCard();
+
+    // cached
+    auto task = manager->fetchVCard(QStringLiteral("juliet@capulet.lit"));
+    test.expectNoPacket();
+    QCOMPARE(expectFutureVariant<QXmppVCardIq>(task).photo(), photo);
+
+    // same photo advertised
+    QXmppPresence presence;
+    presence.setFrom(QStringLiteral("juliet@capulet.lit/balcony"));
+    presence.setVCardUpdateType(QXmppPresence::VCardUpdateValidPhoto);
+    presence.setPhotoHash(photoHash);
+    Q_EMIT test.presenceReceived(presence);
+
+    task = manager->fetchVCard(QStringLiteral("juliet@capulet.lit"));
+    test.expectNoPacket();
+    expectFutureVariant<QXmppVCardIq>(task);
+
+    // other photo advertised
+    presence.setPhotoHash(QCryptographicHash::hash(QByteArrayLiteral("new avatar"), QCryptographicHash::Sha1));
+    Q_EMIT test.presenceReceived(presence);
+
+    requestVCard();
+}
+
 void tst_QXmppVCardManager::testSetClientVCard()
 {
     SKIP_IF_INTEGRATION_TESTS_DISABLED();